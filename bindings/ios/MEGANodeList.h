@@ -54,6 +54,8 @@
  *
  * If the index is >= the size of the list, this function returns nil.
  *
+ * The MEGANode is created on the first call for each index and the same object is returned afterwards.
+ *
  * @param index Position of the MEGANode that we want to get for the list.
  * @return MEGANode at the position index in the list.
  */
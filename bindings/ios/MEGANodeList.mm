@@ -27,6 +27,8 @@ using namespace mega;
 
 @property MegaNodeList *nodeList;
 @property BOOL cMemoryOwn;
+// MEGANode objects already returned, by index
+@property NSMutableDictionary *nodes;
 
 @end
 
@@ -58,7 +60,26 @@ using namespace mega;
 }
 
 - (MEGANode *)nodeAtIndex:(NSInteger)index {
-    return  self.nodeList ? [[MEGANode alloc] initWithMegaNode:self.nodeList->get((int)index)->copy() cMemoryOwn:YES] : nil;
+    if (!self.nodeList) return nil;
+    
+    MegaNode *node = self.nodeList->get((int)index);
+    if (!node) return nil;
+    
+    @synchronized(self) {
+        if (!self.nodes) {
+            self.nodes = [[NSMutableDictionary alloc] init];
+        }
+        
+        NSNumber *key = [[NSNumber alloc] initWithInteger:index];
+        MEGANode *ret = [self.nodes objectForKey:key];
+        
+        if (!ret) {
+            ret = [[MEGANode alloc] initWithMegaNode:node->copy() cMemoryOwn:YES];
+            [self.nodes setObject:ret forKey:key];
+        }
+        
+        return ret;
+    }
 }
 
 - (NSNumber *)size {
@@ -2450,6 +2450,23 @@ typedef NS_ENUM(NSInteger, MEGAPaymentMethod) {
  */
 - (MEGANodeList *)childrenForParent:(MEGANode *)parent;
 
+/**
+ * @brief Get the handles of the children of a MEGANode.
+ *
+ * Unlike [MEGASdk childrenForParent:order:], the child nodes aren't copied, which makes this
+ * function suitable for large folders: the MEGANode objects can be got lazily with
+ * [MEGASdk nodeForHandle:], e.g. only for the visible cells of a table view.
+ *
+ * If the parent node doesn't exist or it isn't a folder, this function
+ * returns an empty array.
+ *
+ * @param parent Parent node.
+ * @param order Order for the returned list (see [MEGASdk childrenForParent:order:]).
+ *
+ * @return Array with the handles (NSNumber) of the children.
+ */
+- (NSArray *)childHandlesForParent:(MEGANode *)parent order:(NSInteger)order;
+
 /**
  * @brief Get the child node with the provided name.
  *
@@ -2533,6 +2550,10 @@ typedef NS_ENUM(NSInteger, MEGAPaymentMethod) {
  * It is needed to be logged in and to have successfully completed a fetchNodes
  * request before calling this function. Otherwise, it will return nil.
  *
+ * The MEGANode objects are cached by handle, so repeated calls for the same node return
+ * the same object until the node changes (the cache is invalidated before
+ * [MEGAGlobalDelegate onNodesUpdate:nodeList:] is called).
+ *
  * @param handle Node handle to check.
  * @return MEGANode object with the handle, otherwise nil.
  */
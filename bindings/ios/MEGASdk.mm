@@ -22,6 +22,7 @@
 #import "MEGASdk.h"
 #import "megaapi.h"
 #import "MEGANode+init.h"
+#import "MEGASdk+init.h"
 #import "MEGAUser+init.h"
 #import "MEGATransfer+init.h"
 #import "MEGATransferList+init.h"
@@ -43,10 +44,47 @@
 
 using namespace mega;
 
+// drops the cached MEGANode objects of the nodes that change, on the thread
+// of the SDK (the delegates also do it before dispatching onNodesUpdate, as
+// the order of the listeners isn't defined)
+class NodeCacheListener : public MegaGlobalListener {
+public:
+    NodeCacheListener(MEGASdk *megaSDK) : megaSDK(megaSDK) {}
+
+    void onNodesUpdate(MegaApi *api, MegaNodeList *nodeList) {
+        [megaSDK invalidateCachedNodes:nodeList];
+    }
+
+private:
+    __weak MEGASdk *megaSDK;
+};
+
+// collects the handles of the children without copying the nodes
+class ChildHandlesProcessor : public MegaNodeViewProcessor {
+public:
+    ChildHandlesProcessor(NSMutableArray *handles) : handles(handles) {}
+
+    bool processNodeView(MegaNodeView *node) {
+        [handles addObject:[[NSNumber alloc] initWithUnsignedLongLong:node->getHandle()]];
+        return true;
+    }
+
+private:
+    NSMutableArray *handles;
+};
+
 @interface MEGASdk () {
     pthread_mutex_t listenerMutex;
+
+    // guards nodeCacheGeneration, bumped on every invalidation so that a
+    // node fetched before it isn't cached after it
+    pthread_mutex_t nodeCacheMutex;
+    NSUInteger nodeCacheGeneration;
+    NodeCacheListener *nodeCacheListener;
 }
 
+@property (nonatomic, strong) NSCache *nodeCache;
+
 @property (nonatomic, assign) std::set<DelegateMEGARequestListener *>activeRequestListeners;
 @property (nonatomic, assign) std::set<DelegateMEGATransferListener *>activeTransferListeners;
 @property (nonatomic, assign) std::set<DelegateMEGAGlobalListener *>activeGlobalListeners;
@@ -134,6 +172,10 @@ static DelegateMEGALogerListener *externalLogger = new DelegateMEGALogerListener
         return nil;
     }
     
+    if (![self createNodeCache]) {
+        return nil;
+    }
+    
     return self;
 }
 
@@ -144,12 +186,32 @@ static DelegateMEGALogerListener *externalLogger = new DelegateMEGALogerListener
         return nil;
     }
     
+    if (![self createNodeCache]) {
+        return nil;
+    }
+    
     return self;
 }
 
+- (BOOL)createNodeCache {
+    if (pthread_mutex_init(&nodeCacheMutex, NULL)) {
+        return NO;
+    }
+    
+    _nodeCache = [[NSCache alloc] init];
+    _nodeCache.countLimit = 1000;
+    
+    nodeCacheListener = new NodeCacheListener(self);
+    _megaApi->addGlobalListener(nodeCacheListener);
+    return YES;
+}
+
 - (void)dealloc {
+    _megaApi->removeGlobalListener(nodeCacheListener);
+    delete nodeCacheListener;
     delete _megaApi;
     pthread_mutex_destroy(&listenerMutex);
+    pthread_mutex_destroy(&nodeCacheMutex);
 }
 
 - (MegaApi *)getCPtr {
@@ -807,6 +869,16 @@ static DelegateMEGALogerListener *externalLogger = new DelegateMEGALogerListener
     return [[MEGANodeList alloc] initWithNodeList:self.megaApi->getChildren((parent != nil) ? [parent getCPtr] : NULL) cMemoryOwn:YES];
 }
 
+- (NSArray *)childHandlesForParent:(MEGANode *)parent order:(NSInteger)order {
+    if (parent == nil) return nil;
+    
+    NSMutableArray *handles = [[NSMutableArray alloc] init];
+    ChildHandlesProcessor processor(handles);
+    
+    self.megaApi->processChildViews([parent getCPtr], &processor, (int)order);
+    return handles;
+}
+
 - (MEGANode *)childNodeForParent:(MEGANode *)parent name:(NSString *)name {
     if (parent == nil || name == nil) return nil;
     
@@ -854,9 +926,40 @@ static DelegateMEGALogerListener *externalLogger = new DelegateMEGALogerListener
 - (MEGANode *)nodeForHandle:(uint64_t)handle {
     if (handle == ::mega::INVALID_HANDLE) return nil;
     
+    NSNumber *key = [[NSNumber alloc] initWithUnsignedLongLong:handle];
+    MEGANode *ret = [self.nodeCache objectForKey:key];
+    if (ret) return ret;
+    
+    pthread_mutex_lock(&nodeCacheMutex);
+    NSUInteger generation = nodeCacheGeneration;
+    pthread_mutex_unlock(&nodeCacheMutex);
+    
     MegaNode *node = self.megaApi->getNodeByHandle(handle);
+    if (!node) return nil;
     
-    return node ? [[MEGANode alloc] initWithMegaNode:node cMemoryOwn:YES] : nil;
+    ret = [[MEGANode alloc] initWithMegaNode:node cMemoryOwn:YES];
+    
+    pthread_mutex_lock(&nodeCacheMutex);
+    if (generation == nodeCacheGeneration) {
+        [self.nodeCache setObject:ret forKey:key];
+    }
+    pthread_mutex_unlock(&nodeCacheMutex);
+    
+    return ret;
+}
+
+- (void)invalidateCachedNodes:(MegaNodeList *)nodeList {
+    pthread_mutex_lock(&nodeCacheMutex);
+    nodeCacheGeneration++;
+    
+    if (!nodeList) {
+        [self.nodeCache removeAllObjects];
+    } else {
+        for (int i = 0; i < nodeList->size(); i++) {
+            [self.nodeCache removeObjectForKey:[[NSNumber alloc] initWithUnsignedLongLong:nodeList->get(i)->getHandle()]];
+        }
+    }
+    pthread_mutex_unlock(&nodeCacheMutex);
 }
 
 - (MEGAUserList *)contacts {
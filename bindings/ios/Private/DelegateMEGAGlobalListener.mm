@@ -21,6 +21,7 @@
 #import "DelegateMEGAGlobalListener.h"
 #import "MEGAUserList+init.h"
 #import "MEGANodeList+init.h"
+#import "MEGASdk+init.h"
 #import "MEGAContactRequestList+init.h"
 
 using namespace mega;
@@ -48,6 +49,8 @@ void DelegateMEGAGlobalListener::onUsersUpdate(mega::MegaApi *api, mega::MegaUse
 }
 
 void DelegateMEGAGlobalListener::onNodesUpdate(mega::MegaApi *api, mega::MegaNodeList *nodeList) {
+    [this->megaSDK invalidateCachedNodes:nodeList];
+    
     if (listener !=nil && [listener respondsToSelector:@selector(onNodesUpdate:nodeList:)]) {
         MegaNodeList *tempNodesList = NULL;
         if (nodeList) {
@@ -23,6 +23,7 @@
 #import "MEGAError+init.h"
 #import "MEGARequest+init.h"
 #import "MEGANodeList+init.h"
+#import "MEGASdk+init.h"
 #import "MEGAUserList+init.h"
 #import "MEGAContactRequestList+init.h"
 
@@ -128,6 +129,8 @@ void DelegateMEGAListener::onUsersUpdate(mega::MegaApi *api, mega::MegaUserList
 }
 
 void DelegateMEGAListener::onNodesUpdate(mega::MegaApi *api, mega::MegaNodeList *nodeList) {
+    [this->megaSDK invalidateCachedNodes:nodeList];
+    
     if (listener !=nil && [listener respondsToSelector:@selector(onNodesUpdate:nodeList:)]) {
         MegaNodeList *tempNodesList = NULL;
         if (nodeList) {
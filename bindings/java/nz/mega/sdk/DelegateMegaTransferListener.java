@@ -15,6 +15,8 @@
  */
 package nz.mega.sdk;
 
+import java.nio.ByteBuffer;
+
 import nz.mega.sdk.MegaApi;
 import nz.mega.sdk.MegaTransfer;
 
@@ -182,4 +184,20 @@ class DelegateMegaTransferListener extends MegaTransferListener {
         }
         return false;
     }
+
+    /**
+     * This function is called when a buffer of a streaming download started with
+     * MegaApiJava.startStreamingToBuffers() has been filled.
+     * <p>
+     * The buffer is passed as is to listeners that implement MegaStreamingListenerInterface.
+     *
+     * @see MegaStreamingListenerInterface#onTransferBuffer(MegaApiJava api, MegaTransfer transfer, int buffer, ByteBuffer data, long position)
+     */
+    @Override
+    public void onTransferBuffer(MegaApi api, MegaTransfer transfer, int buffer, ByteBuffer bufferData, long position, long size) {
+        if (listener instanceof MegaStreamingListenerInterface) {
+            final MegaTransfer megaTransfer = transfer.copy();
+            ((MegaStreamingListenerInterface)listener).onTransferBuffer(megaApi, megaTransfer, buffer, bufferData, position);
+        }
+    }
 }
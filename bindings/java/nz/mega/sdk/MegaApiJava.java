@@ -2739,6 +2739,45 @@ public class MegaApiJava {
         megaApi.startStreaming(node, startPos, size, createDelegateTransferListener(listener));
     }
 
+    /**
+     * Start a streaming download into buffers lent to the app.
+     * <p>
+     * The SDK allocates numBuffers buffers of bufferSize bytes and fills them in order. Each filled
+     * buffer is passed to MegaStreamingListenerInterface.onTransferBuffer() as a direct ByteBuffer,
+     * without copying the data, and it is not reused until it is returned with
+     * MegaApiJava.releaseStreamingBuffer().
+     *
+     * @param node
+     *            MegaNode that identifies the file (public nodes are not supported yet).
+     * @param startPos
+     *            First byte to download from the file.
+     * @param size
+     *            Size of the data to download.
+     * @param numBuffers
+     *            Number of buffers.
+     * @param bufferSize
+     *            Size of each buffer.
+     * @param listener
+     *            MegaStreamingListenerInterface to track this transfer.
+     */
+    public void startStreamingToBuffers(MegaNode node, long startPos, long size, int numBuffers, long bufferSize, MegaStreamingListenerInterface listener) {
+        megaApi.startStreamingToBuffers(node, startPos, size, null, numBuffers, bufferSize, createDelegateTransferListener(listener));
+    }
+
+    /**
+     * Return a buffer lent by MegaStreamingListenerInterface.onTransferBuffer().
+     * <p>
+     * The ByteBuffer that wraps it must not be used after calling this function.
+     *
+     * @param transferTag
+     *            Tag of the transfer (MegaTransfer.getTag()).
+     * @param buffer
+     *            Index of the buffer.
+     */
+    public void releaseStreamingBuffer(int transferTag, int buffer) {
+        megaApi.releaseStreamingBuffer(transferTag, buffer);
+    }
+
     /**
      * Cancel a transfer.
      * <p>
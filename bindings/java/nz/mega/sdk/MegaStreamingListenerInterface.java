@@ -0,0 +1,47 @@
+/*
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,\
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * @copyright Simplified (2-clause) BSD License.
+ * You should have received a copy of the license along with this
+ * program.
+ */
+package nz.mega.sdk;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Interface to receive the data of streaming downloads started with
+ * MegaApiJava.startStreamingToBuffers() without copying it.
+ *
+ * @see MegaTransferListenerInterface
+ */
+public interface MegaStreamingListenerInterface extends MegaTransferListenerInterface {
+    /**
+     * This function is called when one of the buffers of the transfer has been filled.
+     * <p>
+     * The data is a direct ByteBuffer that wraps the native buffer, so it is not copied. The buffer
+     * is lent to the app until it is returned with MegaApiJava.releaseStreamingBuffer(), so it can
+     * be consumed later and from any thread, but the ByteBuffer must not be used after that.
+     * This function is called on the thread of the SDK and should return quickly.
+     *
+     * @param api
+     *          MegaApi object that started the transfer.
+     * @param transfer
+     *          Information about the transfer.
+     * @param buffer
+     *          Index of the buffer, to release it.
+     * @param data
+     *          Data of the buffer. Its capacity is the number of bytes of data.
+     * @param position
+     *          Offset of the data in the file.
+     */
+    public void onTransferBuffer(MegaApiJava api, MegaTransfer transfer, int buffer, ByteBuffer data, long position);
+}
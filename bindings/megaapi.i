@@ -84,6 +84,32 @@
 %apply (char *STRING, size_t LENGTH) {(char *buffer, size_t size)};
 %typemap(directorargout) (char *buffer, size_t size)
 %{ jenv->DeleteLocalRef($input); %}
+
+//Buffers lent by MegaTransferListener::onTransferBuffer are wrapped
+//in a direct ByteBuffer instead of being copied
+%typemap(jni) char *bufferData "jobject"
+%typemap(jtype) char *bufferData "java.nio.ByteBuffer"
+%typemap(jstype) char *bufferData "java.nio.ByteBuffer"
+%typemap(javain) char *bufferData "$javainput"
+%typemap(javadirectorin) char *bufferData "$jniinput"
+%typemap(in) char *bufferData
+%{ $1 = $input ? (char *)jenv->GetDirectBufferAddress($input) : NULL; %}
+%typemap(directorin, descriptor="Ljava/nio/ByteBuffer;") char *bufferData
+%{ $input = jenv->NewDirectByteBuffer($1, (jlong)size); %}
+%typemap(directorargout) char *bufferData
+%{ jenv->DeleteLocalRef($input); %}
+#endif
+
+#ifdef SWIGPYTHON
+//Same for Python, with a read-only memoryview
+%typemap(directorin) char *bufferData
+%{
+#if PY_VERSION_HEX >= 0x03030000
+    $input = PyMemoryView_FromMemory($1, (Py_ssize_t)size, PyBUF_READ);
+#else
+    $input = PyBuffer_FromMemory($1, (Py_ssize_t)size);
+#endif
+%}
 #endif
 
 
@@ -184,6 +210,7 @@
 %newobject mega::MegaApi::hasFingerprint;
 %newobject mega::MegaApi::exportMasterKey;
 %newobject mega::MegaApi::getTransferByTag;
+%newobject mega::MegaApi::getTransfersChangedSince;
 %newobject mega::MegaApi::getCRC;
 %newobject mega::MegaApi::getNodeByCRC;
 %newobject mega::MegaApi::getSessionTransferURL;
@@ -202,4 +229,68 @@ typedef long long time_t;
 typedef long long uint64_t;
 typedef long long int64_t;
 
+//Bulk accessors of lists (MegaNodeList::getHandles and similar) fill an
+//array supplied by the caller in a single call
+#ifdef SWIGJAVA
+%define BULK_ARRAY(CTYPE, JARRAY, JELEMENT, JTYPE, JNAME)
+%typemap(jni) (CTYPE *BULK, int LENGTH) #JARRAY
+%typemap(jtype) (CTYPE *BULK, int LENGTH) JTYPE
+%typemap(jstype) (CTYPE *BULK, int LENGTH) JTYPE
+%typemap(javain) (CTYPE *BULK, int LENGTH) "$javainput"
+%typemap(in) (CTYPE *BULK, int LENGTH)
+%{
+    $2 = $input ? (int)jenv->GetArrayLength($input) : 0;
+    $1 = $2 ? (CTYPE *)jenv->Get##JNAME##ArrayElements($input, NULL) : NULL;
+%}
+%typemap(freearg) (CTYPE *BULK, int LENGTH)
+%{
+    if ($1) jenv->Release##JNAME##ArrayElements($input, (JELEMENT *)$1, 0);
+%}
+%enddef
+#endif
+
+#ifdef SWIGPYTHON
+//A writable buffer of the right item size: array.array('q'), array.array('i')
+//or bytearray
+%define BULK_ARRAY(CTYPE)
+%typemap(in) (CTYPE *BULK, int LENGTH) (Py_buffer view = Py_buffer())
+{
+    if (PyObject_GetBuffer($input, &view, PyBUF_WRITABLE) < 0)
+    {
+        SWIG_fail;
+    }
+
+    if (view.itemsize != sizeof(CTYPE))
+    {
+        PyBuffer_Release(&view);
+        PyErr_SetString(PyExc_TypeError, "Buffer of the wrong item size");
+        SWIG_fail;
+    }
+
+    $1 = (CTYPE *)view.buf;
+    $2 = (int)(view.len / sizeof(CTYPE));
+}
+%typemap(freearg) (CTYPE *BULK, int LENGTH)
+{
+    if (view$argnum.obj) PyBuffer_Release(&view$argnum);
+}
+%enddef
+#endif
+
+#if defined(SWIGJAVA) || defined(SWIGPYTHON)
+#ifdef SWIGJAVA
+BULK_ARRAY(long long, jlongArray, jlong, "long[]", Long)
+BULK_ARRAY(int, jintArray, jint, "int[]", Int)
+BULK_ARRAY(char, jbyteArray, jbyte, "byte[]", Byte)
+#else
+BULK_ARRAY(long long)
+BULK_ARRAY(int)
+BULK_ARRAY(char)
+#endif
+
+%apply (long long *BULK, int LENGTH) {(MegaHandle *handles, int count), (int64_t *sizes, int count), (int64_t *mtimes, int count)};
+%apply (int *BULK, int LENGTH) {(int *types, int count)};
+%apply (char *BULK, int LENGTH) {(char *names, int size)};
+#endif
+
 %include "megaapi.h"
@@ -23,7 +23,8 @@ public:
         OnUsersUpdate,
         OnNodesUpdate,
         OnAccountUpdate,
-        OnReloadNeeded
+        OnReloadNeeded,
+        OnCoalescedEvents
 #if ENABLE_SYNC
         ,
         OnSyncStateChanged,
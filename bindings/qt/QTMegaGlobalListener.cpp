@@ -1,7 +1,9 @@
 #include "QTMegaGlobalListener.h"
 #include "QTMegaEvent.h"
+#include "megaapi_impl.h"
 
 #include <QCoreApplication>
+#include <QTimerEvent>
 
 using namespace mega;
 
@@ -9,12 +11,24 @@ QTMegaGlobalListener::QTMegaGlobalListener(MegaApi *megaApi, MegaGlobalListener
 {
     this->megaApi = megaApi;
     this->listener = listener;
+    coalescing = 0;
+    flushPosted = false;
+    pendingAllNodes = false;
+    flushTimer = 0;
 }
 
 QTMegaGlobalListener::~QTMegaGlobalListener()
 {
     this->listener = NULL;
     megaApi->removeGlobalListener(this);
+    qDeleteAll(pendingNodes);
+}
+
+void QTMegaGlobalListener::setCoalescing(int interval)
+{
+    mutex.lock();
+    coalescing = interval > 0 ? interval : 0;
+    mutex.unlock();
 }
 
 void QTMegaGlobalListener::onUsersUpdate(MegaApi *api, MegaUserList *users)
@@ -26,6 +40,40 @@ void QTMegaGlobalListener::onUsersUpdate(MegaApi *api, MegaUserList *users)
 
 void QTMegaGlobalListener::onNodesUpdate(MegaApi *api, MegaNodeList *nodes)
 {
+    mutex.lock();
+    if (coalescing)
+    {
+        // a NULL list (too many changes to report) covers the others
+        if (!nodes)
+        {
+            pendingAllNodes = true;
+        }
+
+        if (pendingAllNodes)
+        {
+            qDeleteAll(pendingNodes);
+            pendingNodes.clear();
+        }
+        else
+        {
+            for (int i = 0; i < nodes->size(); i++)
+            {
+                pendingNodes.push_back(nodes->get(i)->copy());
+            }
+        }
+
+        bool post = !flushPosted;
+        flushPosted = true;
+        mutex.unlock();
+
+        if (post)
+        {
+            QCoreApplication::postEvent(this, new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnCoalescedEvents), INT_MIN);
+        }
+        return;
+    }
+    mutex.unlock();
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnNodesUpdate);
     event->setNodes(nodes ? nodes->copy() : NULL);
     QCoreApplication::postEvent(this, event, INT_MIN);
@@ -60,7 +108,56 @@ void QTMegaGlobalListener::customEvent(QEvent *e)
         case QTMegaEvent::OnReloadNeeded:
             if(listener) listener->onReloadNeeded(event->getMegaApi());
             break;
+        case QTMegaEvent::OnCoalescedEvents:
+        {
+            mutex.lock();
+            qint64 wait = lastDelivery.isValid() ? coalescing - lastDelivery.elapsed() : 0;
+            mutex.unlock();
+
+            if (wait > 0)
+            {
+                if (!flushTimer) flushTimer = startTimer((int)wait);
+            }
+            else
+            {
+                deliverNodes();
+            }
+            break;
+        }
         default:
             break;
     }
 }
+
+void QTMegaGlobalListener::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != flushTimer)
+    {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    killTimer(flushTimer);
+    flushTimer = 0;
+    deliverNodes();
+}
+
+void QTMegaGlobalListener::deliverNodes()
+{
+    std::vector<MegaNode *> nodes;
+
+    mutex.lock();
+    nodes.swap(pendingNodes);
+    bool all = pendingAllNodes;
+    pendingAllNodes = false;
+    flushPosted = false;
+    mutex.unlock();
+
+    lastDelivery.start();
+
+    // the list takes the ownership of the nodes
+    MegaNodeList *list = all ? NULL : new MegaNodeListPrivate(&nodes);
+
+    if(listener) listener->onNodesUpdate(megaApi, list);
+    delete list;
+}
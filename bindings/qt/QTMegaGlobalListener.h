@@ -2,6 +2,9 @@
 #define QTMEGAGLOBALLISTENER_H
 
 #include <QObject>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <vector>
 #include "megaapi.h"
 
 namespace mega
@@ -19,11 +22,27 @@ public:
     virtual void onAccountUpdate(MegaApi* api);
     virtual void onReloadNeeded(MegaApi* api);
 
+    // aggregate node updates into a single onNodesUpdate delivered at most
+    // once every interval ms (0, the default, posts every update)
+    void setCoalescing(int interval);
+
 protected:
     virtual void customEvent(QEvent * event);
+    virtual void timerEvent(QTimerEvent * event);
+    void deliverNodes();
 
     MegaApi *megaApi;
     MegaGlobalListener *listener;
+
+    // guards the members below, shared with the thread of the SDK
+    QMutex mutex;
+    int coalescing;
+    bool flushPosted;
+    std::vector<MegaNode *> pendingNodes;
+    bool pendingAllNodes;
+
+    int flushTimer;
+    QElapsedTimer lastDelivery;
 };
 }
 
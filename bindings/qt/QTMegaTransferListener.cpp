@@ -1,5 +1,6 @@
 #include "QTMegaTransferListener.h"
 #include <QCoreApplication>
+#include <QTimerEvent>
 #include "QTMegaEvent.h"
 
 using namespace mega;
@@ -8,12 +9,23 @@ QTMegaTransferListener::QTMegaTransferListener(MegaApi *megaApi, MegaTransferLis
 {
     this->megaApi = megaApi;
     this->listener = listener;
+    coalescing = 0;
+    flushPosted = false;
+    flushTimer = 0;
 }
 
 QTMegaTransferListener::~QTMegaTransferListener()
 {
     this->listener = NULL;
     megaApi->removeTransferListener(this);
+    qDeleteAll(pendingUpdates);
+}
+
+void QTMegaTransferListener::setCoalescing(int interval)
+{
+    mutex.lock();
+    coalescing = interval > 0 ? interval : 0;
+    mutex.unlock();
 }
 
 
@@ -26,6 +38,11 @@ void QTMegaTransferListener::onTransferStart(MegaApi *api, MegaTransfer *transfe
 
 void QTMegaTransferListener::onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e)
 {
+    // a pending update would be delivered after the end of the transfer
+    mutex.lock();
+    delete pendingUpdates.take(transfer->getTag());
+    mutex.unlock();
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnTransferFinish);
     event->setTransfer(transfer->copy());
     event->setError(e->copy());
@@ -34,6 +51,25 @@ void QTMegaTransferListener::onTransferFinish(MegaApi *api, MegaTransfer *transf
 
 void QTMegaTransferListener::onTransferUpdate(MegaApi *api, MegaTransfer *transfer)
 {
+    mutex.lock();
+    if (coalescing)
+    {
+        MegaTransfer *&pending = pendingUpdates[transfer->getTag()];
+        delete pending;
+        pending = transfer->copy();
+
+        bool post = !flushPosted;
+        flushPosted = true;
+        mutex.unlock();
+
+        if (post)
+        {
+            QCoreApplication::postEvent(this, new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnCoalescedEvents), INT_MIN);
+        }
+        return;
+    }
+    mutex.unlock();
+
     QTMegaEvent *event = new QTMegaEvent(api, (QEvent::Type)QTMegaEvent::OnTransferUpdate);
     event->setTransfer(transfer->copy());
     QCoreApplication::postEvent(this, event, INT_MIN);
@@ -64,7 +100,56 @@ void QTMegaTransferListener::customEvent(QEvent *e)
         case QTMegaEvent::OnTransferFinish:
             if(listener) listener->onTransferFinish(event->getMegaApi(), event->getTransfer(), event->getError());
             break;
+        case QTMegaEvent::OnCoalescedEvents:
+        {
+            // rate limit: wait for the rest of the interval if the previous
+            // updates were delivered recently
+            mutex.lock();
+            qint64 wait = lastDelivery.isValid() ? coalescing - lastDelivery.elapsed() : 0;
+            mutex.unlock();
+
+            if (wait > 0)
+            {
+                if (!flushTimer) flushTimer = startTimer((int)wait);
+            }
+            else
+            {
+                deliverUpdates();
+            }
+            break;
+        }
         default:
             break;
     }
 }
+
+void QTMegaTransferListener::timerEvent(QTimerEvent *event)
+{
+    if (event->timerId() != flushTimer)
+    {
+        QObject::timerEvent(event);
+        return;
+    }
+
+    killTimer(flushTimer);
+    flushTimer = 0;
+    deliverUpdates();
+}
+
+void QTMegaTransferListener::deliverUpdates()
+{
+    QMap<int, MegaTransfer *> updates;
+
+    mutex.lock();
+    updates.swap(pendingUpdates);
+    flushPosted = false;
+    mutex.unlock();
+
+    lastDelivery.start();
+
+    for (QMap<int, MegaTransfer *>::iterator it = updates.begin(); it != updates.end(); it++)
+    {
+        if(listener) listener->onTransferUpdate(megaApi, it.value());
+        delete it.value();
+    }
+}
@@ -2,6 +2,9 @@
 #define QTMEGATRANSFERLISTENER_H
 
 #include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QElapsedTimer>
 #include <megaapi.h>
 
 namespace mega
@@ -20,11 +23,26 @@ public:
 	virtual void onTransferUpdate(MegaApi *api, MegaTransfer *transfer);
 	virtual void onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError* e);
 
+    // merge the pending updates of each transfer and deliver them at most
+    // once every interval ms (0, the default, posts every update)
+    void setCoalescing(int interval);
+
 protected:
     virtual void customEvent(QEvent * event);
+    virtual void timerEvent(QTimerEvent * event);
+    void deliverUpdates();
 
     MegaApi *megaApi;
 	MegaTransferListener *listener;
+
+    // guards the members below, shared with the thread of the SDK
+    QMutex mutex;
+    int coalescing;
+    bool flushPosted;
+    QMap<int, MegaTransfer *> pendingUpdates;
+
+    int flushTimer;
+    QElapsedTimer lastDelivery;
 };
 }
 
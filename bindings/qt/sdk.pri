@@ -30,8 +30,10 @@ SOURCES += src/attrmap.cpp \
     src/utils.cpp \
     src/logging.cpp \
     src/waiterbase.cpp  \
+    src/thread.cpp  \
     src/proxy.cpp \
     src/pendingcontactrequest.cpp \
+    src/nodemap.cpp \
     src/crypto/cryptopp.cpp  \
     src/db/sqlite.cpp  \
     src/gfx/qt.cpp \
@@ -109,6 +111,7 @@ HEADERS  += include/mega.h \
             include/mega/waiter.h \
             include/mega/proxy.h \
             include/mega/pendingcontactrequest.h \
+            include/mega/nodemap.h \
             include/mega/crypto/cryptopp.h  \
             include/mega/db/sqlite.h  \
             include/mega/gfx/qt.h \
@@ -20,10 +20,14 @@
  */
 
 // This example implements the following operations: getattr, readdir,
-// open, read, mkdir, rmdir, unlink and rename.
-// File writes are NOT supported yet.
-// There isn't any caching nor the implementation does any prefetching
-// to improve read performance.
+// open, create, read, write, truncate, ftruncate, fsync, release, mkdir,
+// rmdir, unlink and rename.
+// Written files are spooled locally and uploaded in the background when
+// closed (fsync waits for the upload). Existing files can only be rewritten
+// from scratch (O_TRUNC), not modified in place.
+// Attributes are cached (and filled in bulk by readdir) and the kernel is
+// allowed to keep them and the file contents; open files are read through
+// MegaFileHandle, served from the SDK streaming cache when possible.
 
 #define FUSE_USE_VERSION 30
 #include <fuse.h>
@@ -37,6 +41,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <iostream>
+#include <map>
+#include <vector>
+#include <set>
+#include <chrono>
+#include <stdlib.h>
 
 using namespace mega;
 using namespace std;
@@ -44,100 +53,408 @@ using namespace std;
 MegaApi* megaApi;
 string megaBasePath;
 
-class SynchronousRequestListener : public MegaRequestListener
+// seconds the kernel and the attribute cache keep attributes and lookups
+static const int ATTR_TIMEOUT = 60;
+static const int NEGATIVE_TIMEOUT = 10;
+
+// attributes by MEGA path, filled by getattr and readdir (which gives the
+// attributes of a whole folder at once, so "ls -l" doesn't resolve every
+// entry) and emptied upon any change in the account
+class AttrCache : public MegaGlobalListener
 {
 	public:
-		SynchronousRequestListener()
+		// false if not cached, otherwise found tells whether the path exists
+		bool get(const string &path, struct stat *stbuf, bool *found)
 		{
-			request = NULL;
-			error = NULL;
-			notified = false;
+			unique_lock<mutex> lock(m);
+			map<string, Entry>::iterator it = entries.find(path);
+			if (it == entries.end() || it->second.expires < chrono::steady_clock::now())
+			{
+				return false;
+			}
+			
+			*found = it->second.found;
+			*stbuf = it->second.st;
+			return true;
 		}
 		
-		~SynchronousRequestListener()
+		void put(const string &path, const struct stat *stbuf)
 		{
-			delete request;
-			delete error;
+			unique_lock<mutex> lock(m);
+			Entry &e = entries[path];
+			e.found = stbuf != NULL;
+			if (stbuf)
+			{
+				e.st = *stbuf;
+			}
+			e.expires = chrono::steady_clock::now() + chrono::seconds(stbuf ? ATTR_TIMEOUT : NEGATIVE_TIMEOUT);
 		}
 		
-		void onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *error) 
+		void clear()
 		{
-			this->error = error->copy();
-			this->request = request->copy();
+			unique_lock<mutex> lock(m);
+			entries.clear();
+		}
+		
+		void onNodesUpdate(MegaApi *, MegaNodeList *)
+		{
+			clear();
+		}
+		
+		void onReloadNeeded(MegaApi *)
+		{
+			clear();
+		}
+		
+	private:
+		struct Entry
+		{
+			bool found;
+			struct stat st;
+			chrono::steady_clock::time_point expires;
+		};
+		
+		map<string, Entry> entries;
+		mutex m;
+};
+
+AttrCache attrCache;
+
+// node handle of the last open of each path: the kernel can keep the cached
+// contents when a path is opened again and still refers to the same node
+// (MEGA files are immutable, but a path can get a new file)
+map<string, MegaHandle> openedNodes;
+mutex openedNodesMutex;
+
+static void fillStat(MegaNode *n, struct stat *stbuf)
+{
+	memset(stbuf, 0, sizeof *stbuf);
+	stbuf->st_uid = getuid();
+	stbuf->st_gid = getgid();
+	stbuf->st_mode = n->isFile() ? S_IFREG | 0444 : S_IFDIR | 0755;
+	stbuf->st_nlink = 1;
+	stbuf->st_size = n->isFile() ? n->getSize() : 4096;
+	stbuf->st_blocks = (stbuf->st_size + 511) / 512;
+	stbuf->st_mtime = n->isFile() ? n->getModificationTime() : n->getCreationTime();
+}
+
+// files being written go to local spool files that are uploaded in the
+// background once closed. A version closed while the previous one of the
+// same path is still uploading waits for it, replacing any older waiting
+// version, so rapid rewrites cost at most one more upload
+class Spooler
+{
+	public:
+		Spooler()
+		{
+			counter = 0;
+		}
+		
+		void init(const string &dir)
+		{
+			this->dir = dir;
+		}
+		
+		string newFile()
+		{
+			unique_lock<mutex> lock(m);
+			return dir + "/" + to_string(++counter);
+		}
+		
+		// spool file of a path open for writing
+		string create(const string &path)
+		{
+			string spool = newFile();
+			unique_lock<mutex> lock(m);
+			states[path].writer = spool;
+			return spool;
+		}
+		
+		// the file was closed without changes
+		void discard(const string &path, const string &spool)
+		{
+			unique_lock<mutex> lock(m);
+			unlink(spool.c_str());
+			map<string, State>::iterator it = states.find(path);
+			if (it != states.end() && it->second.writer == spool)
+			{
+				it->second.writer.clear();
+				if (it->second.uploading.empty() && it->second.pending.empty() && !it->second.failed)
+				{
+					states.erase(it);
+				}
+			}
+		}
+		
+		// the spool file of a closed file is uploaded (and deleted afterwards)
+		void commit(const string &path, const string &spool)
+		{
+			unique_lock<mutex> lock(m);
+			State &st = states[path];
+			if (st.writer == spool)
+			{
+				st.writer.clear();
+			}
 			
+			if (st.uploading.size())
 			{
-				unique_lock<mutex> lock(m);
-				notified = true;
+				if (st.pending.size())
+				{
+					unlink(st.pending.c_str());
+				}
+				st.pending = spool;
+				return;
 			}
-			cv.notify_all();
+			
+			st.uploading = spool;
+			lock.unlock();
+			start(path, spool);
 		}
 		
-		void wait() 
+		void finished(const string &path, bool ok)
 		{
 			unique_lock<mutex> lock(m);
-			cv.wait(lock, [this]{return notified;});
+			State &st = states[path];
+			st.uploading.clear();
+			st.failed |= !ok;
+			
+			if (st.pending.size())
+			{
+				st.uploading.swap(st.pending);
+				string next = st.uploading;
+				lock.unlock();
+				start(path, next);
+				return;
+			}
+			
+			if (st.writer.empty() && !st.failed)
+			{
+				states.erase(path);
+			}
+			cv.notify_all();
 		}
 		
-		void reset()
+		// wait until every closed version of the path is uploaded
+		bool sync(const string &path)
 		{
-			delete request;
-			delete error;
-			request = NULL;
-			error = NULL;
-			notified = false;
+			unique_lock<mutex> lock(m);
+			cv.wait(lock, [this, &path]{
+				map<string, State>::iterator it = states.find(path);
+				return it == states.end() || (it->second.uploading.empty() && it->second.pending.empty());
+			});
+			
+			map<string, State>::iterator it = states.find(path);
+			if (it == states.end())
+			{
+				return true;
+			}
+			
+			bool ok = !it->second.failed;
+			it->second.failed = false;
+			if (it->second.writer.empty())
+			{
+				states.erase(it);
+			}
+			return ok;
 		}
 		
-		MegaRequest *getRequest()
+		// attributes of the newest local version of the path, if any
+		bool localStat(const string &path, struct stat *stbuf)
 		{
-			return request;
+			unique_lock<mutex> lock(m);
+			map<string, State>::iterator it = states.find(path);
+			if (it == states.end())
+			{
+				return false;
+			}
+			
+			const string &file = it->second.writer.size() ? it->second.writer
+								: it->second.pending.size() ? it->second.pending : it->second.uploading;
+			struct stat st;
+			if (file.empty() || stat(file.c_str(), &st))
+			{
+				return false;
+			}
+			
+			memset(stbuf, 0, sizeof *stbuf);
+			stbuf->st_uid = getuid();
+			stbuf->st_gid = getgid();
+			stbuf->st_mode = S_IFREG | 0644;
+			stbuf->st_nlink = 1;
+			stbuf->st_size = st.st_size;
+			stbuf->st_blocks = st.st_blocks;
+			stbuf->st_mtime = st.st_mtime;
+			return true;
 		}
 		
-		MegaError *getError()
+		// names of the local files in a folder (path ending with '/')
+		void localNames(const string &folder, vector<string> *names)
 		{
-			return error;
+			unique_lock<mutex> lock(m);
+			for (map<string, State>::iterator it = states.lower_bound(folder);
+				 it != states.end() && !it->first.compare(0, folder.size(), folder); it++)
+			{
+				if (it->first.find('/', folder.size()) == string::npos)
+				{
+					names->push_back(it->first.substr(folder.size()));
+				}
+			}
 		}
 		
 	private:
-		bool notified;
-		MegaError *error;
-		MegaRequest *request;
+		struct State
+		{
+			string writer;
+			string pending;
+			string uploading;
+			bool failed;
+			
+			State()
+			{
+				failed = false;
+			}
+		};
+		
+		void start(const string &path, const string &spool);
+		
+		map<string, State> states;
+		string dir;
+		unsigned counter;
 		condition_variable cv;
 		mutex m;
 };
 
-class SynchronousTransferListener : public MegaTransferListener
+Spooler spooler;
+
+class UploadJob : public MegaTransferListener
 {
 	public:
-		SynchronousTransferListener()
+		UploadJob(const string &path, const string &spool, MegaHandle previous)
+		{
+			this->path = path;
+			this->spool = spool;
+			this->previous = previous;
+		}
+		
+		void onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *error)
 		{
-			transfer = NULL;
+			bool ok = error->getErrorCode() == MegaError::API_OK;
+			
+			// the new version replaces the previous one
+			if (ok && previous != INVALID_HANDLE && previous != transfer->getNodeHandle())
+			{
+				MegaNode *n = api->getNodeByHandle(previous);
+				if (n)
+				{
+					api->remove(n);
+					delete n;
+				}
+			}
+			
+			if (!ok)
+			{
+				MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Upload error");
+				MegaApi::log(MegaApi::LOG_LEVEL_ERROR, path.c_str());
+			}
+			
+			unlink(spool.c_str());
+			attrCache.clear();
+			spooler.finished(path, ok);
+			delete this;
+		}
+		
+	private:
+		string path;
+		string spool;
+		MegaHandle previous;
+};
+
+void Spooler::start(const string &path, const string &spool)
+{
+	size_t index = path.find_last_of('/');
+	string name = path.substr(index + 1);
+	MegaNode *parent = megaApi->getNodeByPath(index ? path.substr(0, index).c_str() : "/");
+	if (!parent || parent->isFile())
+	{
+		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Upload folder not found");
+		delete parent;
+		unlink(spool.c_str());
+		finished(path, false);
+		return;
+	}
+	
+	MegaHandle previous = INVALID_HANDLE;
+	MegaNode *old = megaApi->getChildNode(parent, name.c_str());
+	if (old && old->isFile())
+	{
+		// unchanged contents, the file is already there
+		char *localFingerprint = megaApi->getFingerprint(spool.c_str());
+		char *nodeFingerprint = megaApi->getFingerprint(old);
+		bool same = localFingerprint && nodeFingerprint && !strcmp(localFingerprint, nodeFingerprint);
+		delete [] localFingerprint;
+		delete [] nodeFingerprint;
+		
+		if (same)
+		{
+			delete old;
+			delete parent;
+			unlink(spool.c_str());
+			finished(path, true);
+			return;
+		}
+		
+		previous = old->getHandle();
+	}
+	delete old;
+	
+	megaApi->startUpload(spool.c_str(), parent, name.c_str(), new UploadJob(path, spool, previous));
+	delete parent;
+}
+
+// open file: reads of an existing file go through a MegaFileHandle, files
+// opened for writing use a spool file
+struct OpenFile
+{
+	MegaFileHandle *file;
+	int fd;
+	string spool;
+	bool dirty;
+	
+	OpenFile()
+	{
+		file = NULL;
+		fd = -1;
+		dirty = false;
+	}
+};
+
+class SynchronousRequestListener : public MegaRequestListener
+{
+	public:
+		SynchronousRequestListener()
+		{
+			request = NULL;
 			error = NULL;
 			notified = false;
 		}
 		
-		~SynchronousTransferListener()
+		~SynchronousRequestListener()
 		{
-			delete transfer;
+			delete request;
 			delete error;
 		}
 		
-		void onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *error) 
+		void onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *error) 
 		{
 			this->error = error->copy();
-			this->transfer = transfer->copy();
-		
+			this->request = request->copy();
+			
 			{
 				unique_lock<mutex> lock(m);
 				notified = true;
 			}
 			cv.notify_all();
 		}
-				
-		bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t s)
-		{
-			data.append(buffer, s);
-			return true;
-		}
 		
 		void wait() 
 		{
@@ -147,16 +464,16 @@ class SynchronousTransferListener : public MegaTransferListener
 		
 		void reset()
 		{
-			delete transfer;
+			delete request;
 			delete error;
-			transfer = NULL;
+			request = NULL;
 			error = NULL;
 			notified = false;
 		}
 		
-		MegaTransfer *getTransfer()
+		MegaRequest *getRequest()
 		{
-			return transfer;
+			return request;
 		}
 		
 		MegaError *getError()
@@ -164,21 +481,10 @@ class SynchronousTransferListener : public MegaTransferListener
 			return error;
 		}
 		
-		const char *getData()
-		{
-			return data.data();
-		}
-		
-		long long getDataSize()
-		{
-			return data.size();
-		}
-		
 	private:
 		bool notified;
 		MegaError *error;
-		MegaTransfer *transfer;
-		string data;
+		MegaRequest *request;
 		condition_variable cv;
 		mutex m;
 };
@@ -186,6 +492,18 @@ class SynchronousTransferListener : public MegaTransferListener
 static int MEGAgetattr(const char *p, struct stat *stbuf)
 {
 	string path = megaBasePath + p;
+	bool found;
+	
+	if (spooler.localStat(path, stbuf))
+	{
+		return 0;
+	}
+	
+	if (attrCache.get(path, stbuf, &found))
+	{
+		return found ? 0 : -ENOENT;
+	}
+	
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Getting attributes:");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
 
@@ -193,15 +511,12 @@ static int MEGAgetattr(const char *p, struct stat *stbuf)
 	if (!n)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Node not found");
+		attrCache.put(path, NULL);
 		return -ENOENT;
 	}
 	
-	stbuf->st_uid = getuid();
-	stbuf->st_gid = getgid();
-	stbuf->st_mode = n->isFile() ? S_IFREG | 0444 : S_IFDIR | 0755;
-	stbuf->st_nlink = 1;
-	stbuf->st_size = n->isFile() ? n->getSize() : 4096;
-	stbuf->st_mtime = n->isFile() ? n->getModificationTime() : n->getCreationTime();
+	fillStat(n, stbuf);
+	attrCache.put(path, stbuf);
 		
 	delete n;
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Attributes read OK");
@@ -251,6 +566,7 @@ static int MEGAmkdir(const char *p, mode_t mode)
 		return -EIO;
 	}
 
+	attrCache.clear();
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Folder created OK");
 	return 0;
 }
@@ -293,6 +609,7 @@ static int MEGArmdir(const char *p)
 		return -EIO;
 	}
 
+	attrCache.clear();
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Folder deleted OK");
 	return 0;
 }
@@ -329,6 +646,7 @@ static int MEGAunlink(const char *p)
 		return -EIO;
 	}
 
+	attrCache.clear();
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File deleted OK");
 	return 0;
 }
@@ -368,6 +686,7 @@ static int MEGArename(const char *f, const char *t)
 			delete source;
 			delete dest;
 			
+			attrCache.clear();
 			if (listener.getError()->getErrorCode() != MegaError::API_OK)
 			{
 				MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Error moving file/folder");
@@ -420,6 +739,7 @@ static int MEGArename(const char *f, const char *t)
 	megaApi->moveNode(source, dest, &listener);
 	listener.wait();
 	delete dest;
+	attrCache.clear();
 	
 	if (listener.getError()->getErrorCode() != MegaError::API_OK)
 	{
@@ -434,6 +754,7 @@ static int MEGArename(const char *f, const char *t)
 		listener.reset();
 		megaApi->renameNode(source, destname.c_str(), &listener);
 		listener.wait();
+		attrCache.clear();
 		
 		if(listener.getError()->getErrorCode() != MegaError::API_OK)
 		{
@@ -466,11 +787,27 @@ static int MEGAreaddir(const char *p, void *buf, fuse_fill_dir_t filler,
 	filler(buf, ".", NULL, 0);
 	filler(buf, "..", NULL, 0);
 	MegaNodeList *children = megaApi->getChildren(node);
+	string prefix = path.size() && path[path.size()-1] == '/' ? path : path + "/";
+	set<string> names;
 	for (int i=0; i<children->size(); i++)
 	{
 		MegaNode *n = children->get(i);
-		filler(buf, n->getName(), NULL, 0);
-		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, n->getName());
+		struct stat st;
+		fillStat(n, &st);
+		attrCache.put(prefix + n->getName(), &st);
+		filler(buf, n->getName(), &st, 0);
+		names.insert(n->getName());
+	}
+	
+	// files written but not uploaded yet
+	vector<string> local;
+	spooler.localNames(prefix, &local);
+	for (unsigned i = 0; i < local.size(); i++)
+	{
+		if (!names.count(local[i]))
+		{
+			filler(buf, local[i].c_str(), NULL, 0);
+		}
 	}
 	
 	delete node;
@@ -480,55 +817,286 @@ static int MEGAreaddir(const char *p, void *buf, fuse_fill_dir_t filler,
 	return 0;
 }
 
-static int MEGAopen(const char *path, struct fuse_file_info *fi)
+// receives the data of a read straight into the FUSE buffer
+class FileReadListener : public MegaTransferListener
 {
-    return 0;
+	public:
+		FileReadListener(char *buffer)
+		{
+			this->buffer = buffer;
+			received = 0;
+			errorCode = MegaError::API_OK;
+			notified = false;
+		}
+		
+		bool onTransferData(MegaApi *, MegaTransfer *, char *data, size_t s)
+		{
+			memcpy(buffer + received, data, s);
+			received += s;
+			return true;
+		}
+		
+		void onTransferFinish(MegaApi *, MegaTransfer *, MegaError *error)
+		{
+			unique_lock<mutex> lock(m);
+			errorCode = error->getErrorCode();
+			notified = true;
+			cv.notify_all();
+		}
+		
+		void wait()
+		{
+			unique_lock<mutex> lock(m);
+			cv.wait(lock, [this]{return notified;});
+		}
+		
+		char *buffer;
+		size_t received;
+		int errorCode;
+		
+	private:
+		bool notified;
+		condition_variable cv;
+		mutex m;
+};
+
+// new empty spool file for a path
+static int openSpool(const string &path, struct fuse_file_info *fi)
+{
+	OpenFile *of = new OpenFile();
+	of->spool = spooler.create(path);
+	of->fd = open(of->spool.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (of->fd < 0)
+	{
+		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Unable to create spool file");
+		spooler.discard(path, of->spool);
+		delete of;
+		return -EIO;
+	}
+	
+	// even an empty file has to be created
+	of->dirty = true;
+	fi->fh = (uint64_t)of;
+	return 0;
 }
 
-static int MEGAread(const char *p, char *buf, size_t size, off_t offset,
-                      struct fuse_file_info *fi)
+static int MEGAcreate(const char *p, mode_t mode, struct fuse_file_info *fi)
+{
+	string path = megaBasePath + p;
+	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Creating file:");
+	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
+	
+	size_t index = path.find_last_of('/');
+	MegaNode *parent = megaApi->getNodeByPath(index ? path.substr(0, index).c_str() : "/");
+	if (!parent || parent->isFile())
+	{
+		delete parent;
+		return -ENOENT;
+	}
+	delete parent;
+	
+	return openSpool(path, fi);
+}
+
+static int MEGAopen(const char *p, struct fuse_file_info *fi)
 {
 	string path = megaBasePath + p;
-	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Reading file:");
+	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "Opening file:");
 	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, path.c_str());
-        	
+	
 	MegaNode *node = megaApi->getNodeByPath(path.c_str());
+	if (node && !node->isFile())
+	{
+		delete node;
+		return -EISDIR;
+	}
+	
+	if ((fi->flags & O_ACCMODE) != O_RDONLY)
+	{
+		delete node;
+		
+		// in-place modifications would need the whole file first
+		if (!(fi->flags & O_TRUNC))
+		{
+			return -EACCES;
+		}
+		return openSpool(path, fi);
+	}
+	
 	if (!node)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File not found");
 		return -ENOENT;
-	}	
+	}
 	
-	if (offset >= node->getSize())
+	MegaFileHandle *file = megaApi->openFile(node);
+	if (!file)
 	{
 		delete node;
+		return -EIO;
+	}
+	
+	{
+		unique_lock<mutex> lock(openedNodesMutex);
+		map<string, MegaHandle>::iterator it = openedNodes.find(path);
+		fi->keep_cache = it != openedNodes.end() && it->second == node->getHandle();
+		openedNodes[path] = node->getHandle();
+	}
+	
+	// the caller wants to bypass the page cache
+	fi->direct_io = (fi->flags & O_DIRECT) != 0;
+	
+	OpenFile *of = new OpenFile();
+	of->file = file;
+	fi->fh = (uint64_t)of;
+	delete node;
+	return 0;
+}
+
+static int MEGAread(const char *p, char *buf, size_t size, off_t offset,
+                      struct fuse_file_info *fi)
+{
+	OpenFile *of = (OpenFile *)fi->fh;
+	
+	if (of->fd >= 0)
+	{
+		ssize_t r = pread(of->fd, buf, size, offset);
+		return r < 0 ? -errno : r;
+	}
+	
+	MegaFileHandle *file = of->file;
+	if (offset >= file->getSize())
+	{
 		return 0;
 	}
 	
-	if (offset + size > node->getSize())
+	if (offset + size > (unsigned long long)file->getSize())
 	{
-		size = node->getSize() - offset;
+		size = file->getSize() - offset;
 	}
 	
-	SynchronousTransferListener listener;
-	megaApi->startStreaming(node, offset, size, &listener);
+	FileReadListener listener(buf);
+	megaApi->readFile(file, offset, size, &listener);
 	listener.wait();
-	delete node;
-	if (listener.getError()->getErrorCode() != MegaError::API_OK)
+	if (listener.errorCode != MegaError::API_OK)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Transfer error");
 		return -EIO;
 	}
 	
-	if (listener.getDataSize() != size)
+	if (listener.received != size)
 	{
 		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Internal error");
 		return -EIO;
 	}
 	
-	memcpy(buf, listener.getData(), size);
-	MegaApi::log(MegaApi::LOG_LEVEL_DEBUG, "File read OK");
-    return size;
+	return size;
+}
+
+static int MEGAwrite(const char *p, const char *buf, size_t size, off_t offset,
+                       struct fuse_file_info *fi)
+{
+	OpenFile *of = (OpenFile *)fi->fh;
+	if (of->fd < 0)
+	{
+		return -EBADF;
+	}
+	
+	ssize_t r = pwrite(of->fd, buf, size, offset);
+	if (r < 0)
+	{
+		return -errno;
+	}
+	
+	of->dirty = true;
+	return r;
+}
+
+static int MEGAftruncate(const char *p, off_t size, struct fuse_file_info *fi)
+{
+	OpenFile *of = (OpenFile *)fi->fh;
+	if (of->fd < 0)
+	{
+		return -EACCES;
+	}
+	
+	if (ftruncate(of->fd, size))
+	{
+		return -errno;
+	}
+	
+	of->dirty = true;
+	return 0;
+}
+
+static int MEGAtruncate(const char *p, off_t size)
+{
+	// only files being written can be truncated (open with O_TRUNC is
+	// passed through thanks to atomic_o_trunc)
+	return -EACCES;
+}
+
+static int MEGAfsync(const char *p, int datasync, struct fuse_file_info *fi)
+{
+	string path = megaBasePath + p;
+	OpenFile *of = (OpenFile *)fi->fh;
+	
+	if (of->fd >= 0 && of->dirty)
+	{
+		// upload a snapshot, the file stays open for writing
+		string snapshot = spooler.newFile();
+		int out = open(snapshot.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		char data[65536];
+		off_t pos = 0;
+		ssize_t r;
+		
+		while (out >= 0 && (r = pread(of->fd, data, sizeof data, pos)) > 0)
+		{
+			if (write(out, data, r) != r)
+			{
+				close(out);
+				out = -1;
+				break;
+			}
+			pos += r;
+		}
+		
+		if (out < 0)
+		{
+			unlink(snapshot.c_str());
+			return -EIO;
+		}
+		close(out);
+		
+		spooler.commit(path, snapshot);
+		of->dirty = false;
+	}
+	
+	return spooler.sync(path) ? 0 : -EIO;
+}
+
+static int MEGArelease(const char *p, struct fuse_file_info *fi)
+{
+	string path = megaBasePath + p;
+	OpenFile *of = (OpenFile *)fi->fh;
+	
+	if (of->fd >= 0)
+	{
+		close(of->fd);
+		
+		if (of->dirty)
+		{
+			spooler.commit(path, of->spool);
+		}
+		else
+		{
+			spooler.discard(path, of->spool);
+		}
+	}
+	
+	delete of->file;
+	delete of;
+	return 0;
 }
 
 int main(int argc, char *argv[])
@@ -617,6 +1185,16 @@ int main(int argc, char *argv[])
 		
 	MegaApi::log(MegaApi::LOG_LEVEL_INFO, "MEGA initialization complete!");	
 	megaApi->setLogLevel(MegaApi::LOG_LEVEL_WARNING);
+	megaApi->addGlobalListener(&attrCache);
+	
+	char spoolDir[] = "/tmp/megafuse-XXXXXX";
+	if (!mkdtemp(spoolDir))
+	{
+		MegaApi::log(MegaApi::LOG_LEVEL_ERROR, "Unable to create the spool folder");
+		return 0;
+	}
+	spooler.init(spoolDir);
+	megaApi->setStreamingCacheSize(64 * 1024 * 1024);
 
 	//Start FUSE
 	struct fuse_operations ops = {0};
@@ -624,11 +1202,22 @@ int main(int argc, char *argv[])
     ops.readdir     = MEGAreaddir;
     ops.open        = MEGAopen;
     ops.read		= MEGAread;
+    ops.release		= MEGArelease;
+    ops.create		= MEGAcreate;
+    ops.write		= MEGAwrite;
+    ops.truncate	= MEGAtruncate;
+    ops.ftruncate	= MEGAftruncate;
+    ops.fsync		= MEGAfsync;
     ops.mkdir		= MEGAmkdir;
     ops.rmdir		= MEGArmdir;
     ops.unlink		= MEGAunlink;
 	ops.rename		= MEGArename;
     
-	char *fuseargv[3] = { argv[0], (char *)"-f", (char *)mountpoint.c_str()};
-    return fuse_main(3, fuseargv, &ops, NULL);
+	// multi-threaded dispatch (no -s): operations block on the SDK, not on
+	// each other
+	char options[128];
+	snprintf(options, sizeof options, "attr_timeout=%d,entry_timeout=%d,negative_timeout=%d,atomic_o_trunc,big_writes",
+			 ATTR_TIMEOUT, ATTR_TIMEOUT, NEGATIVE_TIMEOUT);
+	char *fuseargv[5] = { argv[0], (char *)"-f", (char *)"-o", options, (char *)mountpoint.c_str()};
+    return fuse_main(5, fuseargv, &ops, NULL);
 }
@@ -27,6 +27,7 @@
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <iomanip>
+#include <fstream>
 
 using namespace mega;
 
@@ -108,11 +109,124 @@ const char* errorstring(error e)
     }
 }
 
+// batch mode: commands read from a file, several of them in flight at once,
+// with latency and throughput statistics per command
+struct BatchOp
+{
+    int tag;
+    string command;
+    int64_t started;
+
+    // outstanding requests and transfers (and the issuing command)
+    int pending;
+
+    m_off_t bytes;
+    bool failed;
+};
+
+struct BatchStats
+{
+    unsigned count;
+    unsigned failed;
+    int64_t total, min, max;
+    m_off_t bytes;
+
+    BatchStats() : count(0), failed(0), total(0), min(0), max(0), bytes(0) { }
+};
+
+// operations in flight, by request tag
+static map<int, BatchOp*> batchops;
+static map<string, BatchStats> batchstats;
+
+// operation whose command is being issued (new files are accounted to it)
+static BatchOp* batchcurrent;
+
+static void batchrelease(BatchOp* op, error e)
+{
+    if (e)
+    {
+        op->failed = true;
+    }
+
+    if (--op->pending > 0)
+    {
+        return;
+    }
+
+    BatchStats* s = &batchstats[op->command];
+    int64_t latency = Metrics::now() - op->started;
+
+    if (!s->count || latency < s->min)
+    {
+        s->min = latency;
+    }
+
+    if (latency > s->max)
+    {
+        s->max = latency;
+    }
+
+    s->count++;
+    s->total += latency;
+    s->bytes += op->bytes;
+
+    if (op->failed)
+    {
+        s->failed++;
+    }
+
+    batchops.erase(op->tag);
+    delete op;
+}
+
+static BatchOp* batchfind(int tag)
+{
+    map<int, BatchOp*>::iterator it = batchops.find(tag);
+
+    return it == batchops.end() ? NULL : it->second;
+}
+
+// a request of a batch operation completed
+static void batchresult(error e)
+{
+    BatchOp* op = batchfind(client->restag);
+
+    if (op)
+    {
+        batchrelease(op, e);
+    }
+}
+
 AppFile::AppFile()
 {
     static int nextseqno;
 
     seqno = ++nextseqno;
+
+    if ((batchop = batchcurrent))
+    {
+        batchop->pending++;
+    }
+}
+
+AppFile::~AppFile()
+{
+    if (batchop)
+    {
+        batchrelease(batchop, API_OK);
+    }
+}
+
+// the transfer was cancelled or failed permanently
+void AppFile::terminated()
+{
+    if (batchop)
+    {
+        BatchOp* op = batchop;
+
+        batchop = NULL;
+        batchrelease(op, API_EFAILED);
+    }
 }
 
 // transfer start
@@ -131,14 +245,30 @@ bool AppFile::failed(error e)
 }
 
 // transfer completion
-void AppFileGet::completed(Transfer*, LocalNode*)
+void AppFileGet::completed(Transfer* t, LocalNode*)
 {
+    if (batchop)
+    {
+        batchop->bytes += t->size;
+    }
+
     // (at this time, the file has already been placed in the final location)
     delete this;
 }
 
 void AppFilePut::completed(Transfer* t, LocalNode*)
 {
+    // the batch operation also waits for the new node (putnodes_result())
+    if (batchop)
+    {
+        batchop->bytes += t->size;
+
+        if (t->tag == batchop->tag)
+        {
+            batchop->pending++;
+        }
+    }
+
     // perform standard completion (place node in user filesystem etc.)
     File::completed(t, NULL);
 
@@ -528,6 +658,8 @@ void DemoApp::setattr_result(handle, error e)
     {
         cout << "Node attribute update failed (" << errorstring(e) << ")" << endl;
     }
+
+    batchresult(e);
 }
 
 void DemoApp::rename_result(handle, error e)
@@ -536,6 +668,8 @@ void DemoApp::rename_result(handle, error e)
     {
         cout << "Node move failed (" << errorstring(e) << ")" << endl;
     }
+
+    batchresult(e);
 }
 
 void DemoApp::unlink_result(handle, error e)
@@ -544,6 +678,8 @@ void DemoApp::unlink_result(handle, error e)
     {
         cout << "Node deletion failed (" << errorstring(e) << ")" << endl;
     }
+
+    batchresult(e);
 }
 
 void DemoApp::fetchnodes_result(error e)
@@ -570,6 +706,8 @@ void DemoApp::putnodes_result(error e, targettype_t t, NewNode* nn)
     {
         cout << "Node addition failed (" << errorstring(e) << ")" << endl;
     }
+
+    batchresult(e);
 }
 
 void DemoApp::share_result(error e)
@@ -743,17 +881,17 @@ static void listtrees()
 
     for (user_map::iterator uit = client->users.begin(); uit != client->users.end(); uit++)
     {
-        User* u = &uit->second;
+        User* u = &*uit;
         Node* n;
 
         if (u->show == VISIBLE || u->sharing.size())
         {
             for (handle_set::iterator sit = u->sharing.begin(); sit != u->sharing.end(); sit++)
             {
-                if ((n = client->nodebyhandle(*sit)) && n->inshare)
+                if ((n = client->nodebyhandle(*sit)) && n->inshare())
                 {
                     cout << "INSHARE on " << u->email << ":" << n->displayname() << " ("
-                         << accesslevels[n->inshare->access] << ")" << endl;
+                         << accesslevels[n->inshare()->access] << ")" << endl;
                 }
             }
         }
@@ -982,9 +1120,9 @@ static Node* nodebypath(const char* ptr, string* user = NULL, string* namepart =
 
 static void listnodeshares(Node* n)
 {
-    if(n->outshares)
+    if(n->outshares())
     {
-        for (share_map::iterator it = n->outshares->begin(); it != n->outshares->end(); it++)
+        for (share_map::iterator it = n->outshares()->begin(); it != n->outshares()->end(); it++)
         {
             cout << "\t" << n->displayname();
 
@@ -1033,10 +1171,10 @@ static void dumptree(Node* n, int recurse, int depth = 0, const char* title = NU
                     cout << ", has attributes " << p + 1;
                 }
 
-                if (n->plink)
+                if (n->plink())
                 {
                     cout << ", shared as exported";
-                    if (n->plink->ets)
+                    if (n->plink()->ets)
                     {
                         cout << " temporal";
                     }
@@ -1051,9 +1189,9 @@ static void dumptree(Node* n, int recurse, int depth = 0, const char* title = NU
             case FOLDERNODE:
                 cout << "folder";
 
-                if(n->outshares)
+                if(n->outshares())
                 {
-                    for (share_map::iterator it = n->outshares->begin(); it != n->outshares->end(); it++)
+                    for (share_map::iterator it = n->outshares()->begin(); it != n->outshares()->end(); it++)
                     {
                         if (it->first)
                         {
@@ -1062,10 +1200,10 @@ static void dumptree(Node* n, int recurse, int depth = 0, const char* title = NU
                         }
                     }
 
-                    if (n->plink)
+                    if (n->plink())
                     {
                         cout << ", shared as exported";
-                        if (n->plink->ets)
+                        if (n->plink()->ets)
                         {
                             cout << " temporal";
                         }
@@ -1077,9 +1215,9 @@ static void dumptree(Node* n, int recurse, int depth = 0, const char* title = NU
                     }
                 }
 
-                if (n->pendingshares)
+                if (n->pendingshares())
                 {
-                    for (share_map::iterator it = n->pendingshares->begin(); it != n->pendingshares->end(); it++)
+                    for (share_map::iterator it = n->pendingshares()->begin(); it != n->pendingshares()->end(); it++)
                     {
                         if (it->first)
                         {
@@ -1089,9 +1227,9 @@ static void dumptree(Node* n, int recurse, int depth = 0, const char* title = NU
                     }
                 }
 
-                if (n->inshare)
+                if (n->inshare())
                 {
-                    cout << ", inbound " << accesslevels[n->inshare->access] << " share";
+                    cout << ", inbound " << accesslevels[n->inshare()->access] << " share";
                 }
                 break;
 
@@ -1135,12 +1273,12 @@ static void nodepath(handle h, string* path)
             case FOLDERNODE:
                 path->insert(0, n->displayname());
 
-                if (n->inshare)
+                if (n->inshare())
                 {
                     path->insert(0, ":");
-                    if (n->inshare->user)
+                    if (n->inshare()->user)
                     {
-                        path->insert(0, n->inshare->user->email);
+                        path->insert(0, n->inshare()->user->email);
                     }
                     else
                     {
@@ -1338,6 +1476,135 @@ void xferq(direction_t d, int cancel)
     }
 }
 
+// batch file being run, maximum number of operations in flight
+static ifstream batchfile;
+static unsigned batchconcurrency;
+static int64_t batchstarted;
+static int batchtag = 1 << 24;
+
+// next command, held back until it can be issued
+static string batchline;
+
+static void batchreport()
+{
+    double elapsed = (Metrics::now() - batchstarted) / 1000000.0;
+    streamsize precision = cout.precision();
+
+    cout << "Batch completed in " << fixed << setprecision(2) << elapsed << " s" << endl;
+
+    for (map<string, BatchStats>::iterator it = batchstats.begin(); it != batchstats.end(); it++)
+    {
+        BatchStats* s = &it->second;
+
+        cout << "      " << it->first << ": " << s->count << " done, " << s->failed << " failed, latency "
+             << s->total / s->count / 1000.0 << " ms avg, " << s->min / 1000.0 << " ms min, "
+             << s->max / 1000.0 << " ms max, " << s->count / elapsed << " ops/s";
+
+        if (s->bytes)
+        {
+            cout << ", " << s->bytes / elapsed / 1048576 << " MB/s";
+        }
+
+        cout << endl;
+    }
+
+    cout.unsetf(ios::fixed);
+    cout.precision(precision);
+}
+
+// issue the commands of the batch file while less than batchconcurrency
+// operations are in flight - commands that are not measured are run alone,
+// once the operations before them have completed
+// returns true if any command was issued
+static bool batchpump()
+{
+    bool issued = false;
+
+    while (batchfile.is_open() && prompt == COMMAND)
+    {
+        if (!batchline.size())
+        {
+            if (!getline(batchfile, batchline))
+            {
+                batchfile.close();
+                batchline.clear();
+                break;
+            }
+
+            size_t start = batchline.find_first_not_of(" \t");
+            size_t end = batchline.find_last_not_of(" \t\r");
+
+            if (start == string::npos || batchline[start] == '#')
+            {
+                batchline.clear();
+                continue;
+            }
+
+            batchline = batchline.substr(start, end - start + 1);
+        }
+
+        string command = batchline.substr(0, batchline.find_first_of(" \t"));
+        bool measured = command == "put" || command == "get" || command == "ls"
+                     || command == "cp" || command == "mv" || command == "import";
+
+        if (batchops.size() && (!measured || batchops.size() >= batchconcurrency))
+        {
+            break;
+        }
+
+        char* l = strdup(batchline.c_str());
+        batchline.clear();
+        issued = true;
+
+        cout << "batch> " << l << endl;
+
+        if (!measured)
+        {
+            process_line(l);
+            free(l);
+            continue;
+        }
+
+        BatchOp* op = new BatchOp;
+
+        op->tag = ++batchtag;
+        op->command = command;
+        op->started = Metrics::now();
+        op->pending = 1;
+        op->bytes = 0;
+        op->failed = false;
+        batchops[op->tag] = op;
+
+        // requests and transfers started by the command carry its tag
+        int cmds = client->reqs.cmdspending();
+
+        batchcurrent = op;
+        client->reqtag = op->tag;
+
+        process_line(l);
+
+        client->reqtag = 0;
+        batchcurrent = NULL;
+
+        // transfers are accounted for by their files
+        if (command != "put" && command != "ls")
+        {
+            op->pending += client->reqs.cmdspending() - cmds;
+        }
+
+        batchrelease(op, API_OK);
+        free(l);
+    }
+
+    if (batchstarted && !batchfile.is_open() && batchops.empty())
+    {
+        batchreport();
+        batchstarted = 0;
+    }
+
+    return issued;
+}
+
 // password change-related state information
 static byte pwkey[SymmCipher::KEYLENGTH];
 static byte pwkeybuf[SymmCipher::KEYLENGTH];
@@ -1551,6 +1818,7 @@ static void process_line(char* l)
                 cout << "      rm remotepath" << endl;
                 cout << "      mv srcremotepath dstremotepath" << endl;
                 cout << "      cp srcremotepath dstremotepath|dstemail:" << endl;
+                cout << "      batch commandfile [concurrency]" << endl;
 #ifdef ENABLE_SYNC
                 cout << "      sync [localpath dstremotepath|cancelslot]" << endl;
 #endif
@@ -1921,8 +2189,6 @@ static void process_line(char* l)
                     }
                     else if (words[0] == "du")
                     {
-                        TreeProcDU du;
-
                         if (words.size() > 1)
                         {
                             if (!(n = nodebypath(words[1].c_str())))
@@ -1939,11 +2205,9 @@ static void process_line(char* l)
 
                         if (n)
                         {
-                            client->proctree(n, &du);
-
-                            cout << "Total storage used: " << (du.numbytes / 1048576) << " MB" << endl;
-                            cout << "Total # of files: " << du.numfiles << endl;
-                            cout << "Total # of folders: " << du.numfolders << endl;
+                            cout << "Total storage used: " << (n->subtree.storage / 1048576) << " MB" << endl;
+                            cout << "Total # of files: " << n->subtree.files << endl;
+                            cout << "Total # of folders: " << n->subtree.folders << endl;
                         }
 
                         return;
@@ -2241,7 +2505,40 @@ static void process_line(char* l)
                     break;
 
                 case 5:
-                    if (words[0] == "login")
+                    if (words[0] == "batch")
+                    {
+                        if (words.size() > 1)
+                        {
+                            if (batchstarted)
+                            {
+                                cout << "A batch is already running" << endl;
+                                return;
+                            }
+
+                            batchfile.clear();
+                            batchfile.open(words[1].c_str());
+
+                            if (!batchfile.is_open())
+                            {
+                                cout << words[1] << ": Can't open file" << endl;
+                                return;
+                            }
+
+                            batchconcurrency = (words.size() > 2 && atoi(words[2].c_str()) > 0) ? atoi(words[2].c_str()) : 1;
+                            batchstats.clear();
+                            batchstarted = Metrics::now();
+
+                            cout << "Running " << words[1] << " with up to " << batchconcurrency
+                                 << " command(s) in flight..." << endl;
+                        }
+                        else
+                        {
+                            cout << "      batch commandfile [concurrency]" << endl;
+                        }
+
+                        return;
+                    }
+                    else if (words[0] == "login")
                     {
                         if (client->loggedin() == NOTLOGGEDIN)
                         {
@@ -2364,7 +2661,7 @@ static void process_line(char* l)
                                     for (user_map::iterator uit = client->users.begin();
                                          uit != client->users.end(); uit++)
                                     {
-                                        User* u = &uit->second;
+                                        User* u = &*uit;
                                         Node* n;
 
                                         if (u->show == VISIBLE && u->sharing.size())
@@ -2377,7 +2674,7 @@ static void process_line(char* l)
                                                 if ((n = client->nodebyhandle(*sit)))
                                                 {
                                                     cout << "\t" << n->displayname() << " ("
-                                                         << accesslevels[n->inshare->access] << ")" << endl;
+                                                         << accesslevels[n->inshare()->access] << ")" << endl;
                                                 }
                                             }
                                         }
@@ -2446,33 +2743,33 @@ static void process_line(char* l)
                     {
                         for (user_map::iterator it = client->users.begin(); it != client->users.end(); it++)
                         {
-                            if (it->second.email.size())
+                            if (it->email.size())
                             {
-                                cout << "\t" << it->second.email;
+                                cout << "\t" << it->email;
 
-                                if (it->second.show == VISIBLE)
+                                if (it->show == VISIBLE)
                                 {
                                     cout << ", visible";
                                 }
-                                else if (it->second.show == HIDDEN)
+                                else if (it->show == HIDDEN)
                                 {
                                     cout << ", hidden";
                                 }
-                                else if (it->second.show == ME)
+                                else if (it->show == ME)
                                 {
                                     cout << ", session user";
                                 }
                                 else
                                 {
-                                    cout << ", unknown visibility (" << it->second.show << ")";
+                                    cout << ", unknown visibility (" << it->show << ")";
                                 }
 
-                                if (it->second.sharing.size())
+                                if (it->sharing.size())
                                 {
-                                    cout << ", sharing " << it->second.sharing.size() << " folder(s)";
+                                    cout << ", sharing " << it->sharing.size() << " folder(s)";
                                 }
 
-                                if (it->second.pubk.isvalid())
+                                if (it->pubk.isvalid())
                                 {
                                     cout << ", public key cached";
                                 }
@@ -3117,6 +3414,10 @@ static void process_line(char* l)
                         cout << "* Berkeley DB" << endl;
 #endif
 
+#ifdef USE_LMDB
+                        cout << "* LMDB" << endl;
+#endif
+
 #ifdef USE_INOTIFY
                         cout << "* inotify" << endl;
 #endif
@@ -3405,9 +3706,9 @@ void DemoApp::exportnode_result(handle h, handle ph)
         {
             Base64::btoa((const byte*) n->nodekey.data(), FILENODEKEYLENGTH, key);
         }
-        else if (n->sharekey)
+        else if (n->sharekey())
         {
-            Base64::btoa(n->sharekey->key, FOLDERNODEKEYLENGTH, key);
+            Base64::btoa(n->sharekey()->key, FOLDERNODEKEYLENGTH, key);
         }
         else
         {
@@ -3430,6 +3731,8 @@ void DemoApp::openfilelink_result(error e)
     {
         cout << "Failed to open link: " << errorstring(e) << endl;
     }
+
+    batchresult(e);
 }
 
 // the requested link was opened successfully - import to cwd
@@ -3452,17 +3755,34 @@ void DemoApp::openfilelink_result(handle ph, const byte* key, m_off_t size,
 
         newnode->attrstring = new string(*a);
 
+        // the import of a batch operation completes with putnodes_result()
+        BatchOp* op = batchfind(client->restag);
+        int creqtag = client->reqtag;
+
+        if (op)
+        {
+            op->pending++;
+            client->reqtag = op->tag;
+        }
+
         client->putnodes(n->nodehandle, newnode, 1);
+        client->reqtag = creqtag;
+
+        batchresult(API_OK);
     }
     else
     {
         cout << "Need to be logged in to import file links." << endl;
+
+        batchresult(API_EACCESS);
     }
 }
 
 void DemoApp::checkfile_result(handle h, error e)
 {
     cout << "Link check failed: " << errorstring(e) << endl;
+
+    batchresult(e);
 }
 
 void DemoApp::checkfile_result(handle h, error e, byte* filekey, m_off_t size, m_time_t ts, m_time_t tm, string* filename,
@@ -3490,10 +3810,16 @@ void DemoApp::checkfile_result(handle h, error e, byte* filekey, m_off_t size, m
     {
         cout << "Initiating download..." << endl;
 
+        batchcurrent = batchfind(client->restag);
+
         AppFileGet* f = new AppFileGet(NULL, h, filekey, size, tm, filename, fingerprint);
         f->appxfer_it = appxferq[GET].insert(appxferq[GET].end(), f);
         client->startxfer(GET, f);
+
+        batchcurrent = NULL;
     }
+
+    batchresult(e);
 }
 
 bool DemoApp::pread_data(byte* data, m_off_t len, m_off_t pos, void* appdata)
@@ -3891,6 +4217,12 @@ void megacli()
 
         // pass the CPU to the engine (nonblocking)
         client->exec();
+
+        // issue the batch commands whose turn has come
+        if (batchpump())
+        {
+            client->exec();
+        }
     }
 }
 
@@ -38,12 +38,17 @@ struct AppFile : public File
     // app-internal sequence number for queue management
     int seqno;
 
+    // batch operation this file belongs to (or NULL)
+    struct BatchOp* batchop;
+
     bool failed(error);
     void progress();
+    void terminated();
 
     appfile_list::iterator appxfer_it;
 
     AppFile();
+    ~AppFile();
 };
 
 // application-managed GET and PUT queues (only pending and active files)
@@ -1,6 +1,6 @@
 /**
  * @file examples/megasimplesync.cpp
- * @brief sample daemon, which synchronizes local and remote folders
+ * @brief sample daemon, which synchronizes pairs of local and remote folders
  *
  * (c) 2013-2014 by Mega Limited, Wellsford, New Zealand
  *
@@ -21,6 +21,9 @@
 
 #include "mega.h"
 
+#include <signal.h>
+#include <fstream>
+
 #ifdef _WIN32
 #include <conio.h>
 #endif
@@ -29,11 +32,14 @@ using namespace mega;
 
 class SyncApp : public MegaApp
 {
-    string local_folder;
-    string remote_folder;
+    // local and remote folder of each sync (the index is the sync's tag)
+    vector<pair<string, string> > folders;
     handle cwd;
     bool initial_fetch;
 
+    // syncs that have not failed
+    int running;
+
     void login_result(error e);
 
     void fetchnodes_result(error e);
@@ -62,12 +68,16 @@ class SyncApp : public MegaApp
 
     Node* nodebypath(const char* ptr, string* user, string* namepart);
 public:
-    SyncApp(string local_folder_, string remote_folder_);
+    SyncApp(const vector<pair<string, string> >& folders_);
 };
 
 // globals
 MegaClient* client;
 
+// metrics requested (SIGUSR1), written to this file
+static volatile sig_atomic_t metricsrequested;
+static const char* metricsfile;
+
 // returns node pointer determined by path relative to cwd
 // Path naming conventions:
 // path is relative to cwd
@@ -288,8 +298,8 @@ Node* SyncApp::nodebypath(const char* ptr, string* user = NULL, string* namepart
     return n;
 }
 
-SyncApp:: SyncApp(string local_folder_, string remote_folder_) :
-    local_folder(local_folder_), remote_folder(remote_folder_), cwd(UNDEF), initial_fetch(true)
+SyncApp:: SyncApp(const vector<pair<string, string> >& folders_) :
+    folders(folders_), cwd(UNDEF), initial_fetch(true), running(0)
 {}
 
 // this callback function is called when we have login result (success or
@@ -322,38 +332,50 @@ void SyncApp::fetchnodes_result(error e)
             cwd = client->rootnodes[0];
         }
 
-        Node* n = nodebypath(remote_folder.c_str());
-        if (client->checkaccess(n, FULL))
+        // a folder pair that can't be synced is skipped, the daemon only
+        // gives up if none can
+        for (size_t i = 0; i < folders.size(); i++)
         {
-            string localname;
+            const string& local_folder = folders[i].first;
+            const string& remote_folder = folders[i].second;
 
-            client->fsaccess->path2local(&local_folder, &localname);
-
-            if (!n)
-            {
-                LOG_err << remote_folder << ": Not found.";
-                exit(1);
-            }
-            else if (n->type == FILENODE)
-            {
-                LOG_err << remote_folder << ": Remote sync root must be folder.";
-                exit(1);
-            }
-            else
+            Node* n = nodebypath(remote_folder.c_str());
+            if (client->checkaccess(n, FULL))
             {
-                error e = client->addsync(&localname, DEBRISFOLDER, NULL, n, 0);
-                if (e)
+                string localname;
+
+                client->fsaccess->path2local((string*)&local_folder, &localname);
+
+                if (!n)
                 {
-                    LOG_err << "Sync could not be added! ";
-                    exit(1);
+                    LOG_err << remote_folder << ": Not found.";
+                }
+                else if (n->type == FILENODE)
+                {
+                    LOG_err << remote_folder << ": Remote sync root must be folder.";
                 }
+                else
+                {
+                    error e = client->addsync(&localname, DEBRISFOLDER, NULL, n, 0, (int)i);
+                    if (e)
+                    {
+                        LOG_err << "Sync " << i << " could not be added! ";
+                        continue;
+                    }
 
-                LOG_info << "Sync started !";
+                    running++;
+                    LOG_info << "Sync " << i << " started: " << local_folder << " <-> " << remote_folder;
+                }
+            }
+            else
+            {
+                LOG_err << remote_folder << ": Syncing requires full access to path.";
             }
         }
-        else
+
+        if (!running)
         {
-            LOG_err << remote_folder << ": Syncing requires full access to path.";
+            LOG_err << "FATAL: No sync could be started, exiting";
             exit(1);
         }
     }
@@ -367,16 +389,21 @@ void SyncApp::request_error(error e)
 }
 
 #ifdef ENABLE_SYNC
-void SyncApp::syncupdate_state(Sync*, syncstate_t state)
+void SyncApp::syncupdate_state(Sync* sync, syncstate_t state)
 {
     if (( state == SYNC_CANCELED ) || ( state == SYNC_FAILED ))
     {
-        LOG_err << "FATAL: Sync failed !";
-        exit(1);
+        LOG_err << "Sync " << sync->tag << " failed !";
+
+        if (!--running)
+        {
+            LOG_err << "FATAL: All syncs failed, exiting";
+            exit(1);
+        }
     }
     else if (state == SYNC_ACTIVE)
     {
-        LOG_info << "Sync is now active";
+        LOG_info << "Sync " << sync->tag << " is now active";
     }
 }
 
@@ -478,12 +505,93 @@ static const char* treestatename(treestate_t ts)
     return "UNKNOWN";
 }
 
+// one per node and state change: debug output only
 void SyncApp::syncupdate_treestate(LocalNode* l)
 {
-    LOG_info << "Sync - state change of node " << l->name << " to " << treestatename(l->ts);
+    LOG_debug << "Sync - state change of node " << l->name << " to " << treestatename(l->ts);
+}
+
+#endif
+#ifndef _WIN32
+// only flags the request, the file is written by the main loop
+static void requestmetrics(int)
+{
+    metricsrequested = 1;
+
+    if (client)
+    {
+        client->waiter->notify();
+    }
 }
+#endif
+
+// engine metrics followed by one series per sync, in the Prometheus text
+// format - written to a temporary file and renamed, so that a collector
+// never reads a partial dump
+static void writemetrics()
+{
+    string text;
+
+    client->getmetrics(&text);
+
+#ifdef ENABLE_SYNC
+    static const char* families[][2] = {
+        { "mega_sync_state", "sync state (syncstate_t)" },
+        { "mega_sync_files", "local files" },
+        { "mega_sync_folders", "local folders" },
+        { "mega_sync_notifications_pending", "filesystem notifications queued" },
+        { "mega_sync_notifications_failed", "filesystem notifications unavailable, rescanning instead" },
+        { "mega_sync_fullscans_total", "full scans of the local folder" },
+        { "mega_sync_uploads_total", "uploads started" },
+        { "mega_sync_downloads_total", "downloads started" },
+        { "mega_sync_putnodes_pending", "new nodes waiting for the server" },
+    };
+
+    for (unsigned i = 0; i < sizeof families / sizeof *families; i++)
+    {
+        ostringstream oss;
+
+        oss << "# HELP " << families[i][0] << " " << families[i][1] << "\n";
+        oss << "# TYPE " << families[i][0] << (strstr(families[i][0], "_total") ? " counter" : " gauge") << "\n";
+
+        for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+        {
+            Sync* sync = *it;
+            m_off_t value = 0;
 
+            switch (i)
+            {
+                case 0: value = sync->state; break;
+                case 1: value = sync->localnodes[FILENODE]; break;
+                case 2: value = sync->localnodes[FOLDERNODE]; break;
+                case 3: value = sync->dirnotify->notifyq[DirNotify::DIREVENTS].size()
+                              + sync->dirnotify->notifyq[DirNotify::RETRY].size(); break;
+                case 4: value = sync->dirnotify->failed || sync->dirnotify->error; break;
+                case 5: value = sync->metrics.fullscans; break;
+                case 6: value = sync->metrics.uploads; break;
+                case 7: value = sync->metrics.downloads; break;
+                case 8: value = sync->metrics.putnodespending; break;
+            }
+
+            oss << families[i][0] << "{sync=\"" << sync->tag << "\"} " << value << "\n";
+        }
+
+        text.append(oss.str());
+    }
 #endif
+
+    string tmpname = string(metricsfile) + ".tmp";
+    ofstream out(tmpname.c_str());
+
+    out << text;
+    out.close();
+
+    if (!out || rename(tmpname.c_str(), metricsfile))
+    {
+        LOG_err << "Unable to write metrics to " << metricsfile;
+    }
+}
+
 int main(int argc, char *argv[])
 {
 #ifndef ENABLE_SYNC
@@ -499,15 +607,23 @@ int main(int argc, char *argv[])
     // set output to stdout
     SimpleLogger::setAllOutputs(&std::cout);
 
-    if (argc < 3)
+    if (argc < 3 || !(argc & 1))
     {
-        LOG_info << "Usage: " << argv[0] << " [local folder] [remote folder]";
+        LOG_info << "Usage: " << argv[0] << " [local folder] [remote folder] [[local folder] [remote folder] ...]";
         LOG_info << "Please set both MEGA_EMAIL and MEGA_PWD (password) env variables!";
         LOG_info << "   (set MEGA_DEBUG to 1 or 2 to see debug output.";
+        LOG_info << "   (set MEGA_METRICS_FILE to a path to dump metrics there on SIGUSR1.";
         return 1;
     }
 
-    app = new SyncApp(argv[1], argv[2]);
+    vector<pair<string, string> > folders;
+
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        folders.push_back(pair<string, string>(argv[i], argv[i + 1]));
+    }
+
+    app = new SyncApp(folders);
 
     if (!getenv("MEGA_EMAIL") || !getenv("MEGA_PWD"))
     {
@@ -533,14 +649,32 @@ int main(int argc, char *argv[])
     // uncomment this line if you want to follow symbolic links
     //client->followsymlinks = true;
 
+    metricsfile = getenv("MEGA_METRICS_FILE");
+
+#ifndef _WIN32
+    if (metricsfile)
+    {
+        signal(SIGUSR1, requestmetrics);
+    }
+#endif
+
     // get values from env
     client->pw_key(getenv("MEGA_PWD"), pwkey);
     client->login(getenv("MEGA_EMAIL"), pwkey);
 
+    // no periodic work here: between filesystem notifications, server
+    // events and transfers, the process sleeps in wait()
     while (true)
     {
         // pass the CPU to the engine (nonblocking)
         client->exec();
+
+        if (metricsrequested)
+        {
+            metricsrequested = 0;
+            writemetrics();
+        }
+
         client->wait();
     }
 
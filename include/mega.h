@@ -52,9 +52,11 @@
 #include "mega/treeproc.h"
 #include "mega/user.h"
 #include "mega/pendingcontactrequest.h"
+#include "mega/nodemap.h"
 #include "mega/utils.h"
 #include "mega/logging.h"
 #include "mega/waiter.h"
+#include "mega/thread.h"
 
 #include "mega/node.h"
 #include "mega/sync.h"
@@ -71,6 +73,7 @@
 #include "megaconsolewaiter.h"
 
 #include "mega/db/sqlite.h"
+#include "mega/db/lmdb.h"
 #include "mega/db/bdb.h"
 
 #include "mega/gfx/freeimage.h"
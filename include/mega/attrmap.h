@@ -27,7 +27,47 @@
 namespace mega {
 
 // maps attribute names to attribute values
-typedef map<nameid, string> attr_map;
+// sorted flat array of name-value pairs with a map-like interface: nodes
+// carry only a handful of attributes (typically 'n' and 'c'), so a contiguous
+// array beats a tree in memory and lookup time. values use the string's
+// inline small-string storage. unlike map, insertion invalidates iterators
+// and references to other elements.
+class MEGA_API AttrFlatMap
+{
+public:
+    typedef pair<nameid, string> value_type;
+    typedef vector<value_type>::iterator iterator;
+    typedef vector<value_type>::const_iterator const_iterator;
+
+    iterator begin() { return pairs.begin(); }
+    iterator end() { return pairs.end(); }
+    const_iterator begin() const { return pairs.begin(); }
+    const_iterator end() const { return pairs.end(); }
+
+    size_t size() const { return pairs.size(); }
+    bool empty() const { return pairs.empty(); }
+    void clear() { pairs.clear(); }
+
+    iterator find(nameid);
+    const_iterator find(nameid) const;
+    size_t count(nameid id) const { return find(id) != end(); }
+
+    // insert an empty value for the name if not present
+    string& operator[](nameid);
+
+    size_t erase(nameid);
+    void erase(iterator it) { pairs.erase(it); }
+
+    // heap memory used by the pairs and values in bytes
+    size_t allocated() const;
+
+private:
+    vector<value_type> pairs;
+
+    iterator lowerbound(nameid);
+};
+
+typedef AttrFlatMap attr_map;
 
 struct MEGA_API AttrMap
 {
@@ -25,13 +25,43 @@
 #include "types.h"
 
 namespace mega {
+// deadlines of a set of timers in order, so that the next one is known
+// without scanning all the timers
+class MEGA_API BackoffTimerQueue
+{
+    friend class BackoffTimer;
+
+    backofftimer_map timers;
+
+public:
+    // drop the timers that are due, returns true if there were any
+    bool expire();
+
+    // earliest deadline of the remaining timers, NEVER if there are none
+    dstime nextds() const;
+};
+
 // generic timer facility with exponential backoff
 class MEGA_API BackoffTimer
 {
+    friend class BackoffTimerQueue;
+
     dstime next;
     dstime delta;
     dstime base;
 
+    // if set, the deadline is kept in this queue instead of being polled
+    BackoffTimerQueue* queue;
+    backofftimer_map::iterator queued_it;
+    bool queued;
+
+    void setnext(dstime);
+    void unqueue();
+
+    // non-copyable (the queue refers to the timer)
+    BackoffTimer(const BackoffTimer&);
+    BackoffTimer& operator=(const BackoffTimer&);
+
 public:
     // reset timer
     void reset();
@@ -63,7 +93,8 @@ public:
     // update time to wait
     void update(dstime*);
 
-    BackoffTimer();
+    BackoffTimer(BackoffTimerQueue* = NULL);
+    ~BackoffTimer();
 };
 } // namespace
 
@@ -34,6 +34,9 @@ class MEGA_API Base64
 public:
     static int btoa(const byte*, int, char*);
     static int atob(const char*, byte*, int);
+
+    // decode at most alen characters (faster for long input)
+    static int atob(const char*, int, byte*, int);
 };
 
 // lowercase base32 encoding
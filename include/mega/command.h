@@ -43,6 +43,9 @@ protected:
 
     string json;
 
+    // base64-encode binary data directly into json
+    void appendbinary(const byte*, int);
+
 public:
     MegaClient* client;
 
@@ -51,6 +54,25 @@ public:
     char level;
     bool persistent;
 
+    // read-only and independent of the other queued commands: may be sent
+    // ahead of them while a slow request is in flight
+    bool independent;
+
+    // the response carries a node array at "f" that can be processed while
+    // it is still being received
+    bool streamable;
+
+    // not urgent: may be held back in batched network mode
+    bool deferrable;
+
+    // merge a later command into this one while neither has been sent (see
+    // Request::coalesce()): 1 if merged, 0 if the later one may be moved
+    // ahead of this one to find a match, -1 if it must stay behind
+    virtual int coalesce(Command*) { return -1; }
+
+    // command name, for the metrics
+    const char* name;
+
     void cmd(const char*);
     void notself(MegaClient*);
     virtual void cancel(void);
@@ -59,6 +81,10 @@ public:
     void arg(const char*, const byte*, int);
     void arg(const char*, m_off_t);
     void addcomma();
+
+    // preallocate for the given number of additional bytes
+    void reserve(size_t);
+
     void appendraw(const char*);
     void appendraw(const char*, int);
     void beginarray();
@@ -312,13 +338,17 @@ class MEGA_API CommandGetFile : public Command
 {
     TransferSlot* tslot;
     handle ph;
+    bool priv;
+    bool prefetch;
     byte filekey[FILENODEKEYLENGTH];
 
+    MegaApp* app();
+
 public:
     void cancel();
     void procresult();
 
-    CommandGetFile(TransferSlot*, byte*, handle, bool, const char* = NULL);
+    CommandGetFile(TransferSlot*, byte*, handle, bool, const char* = NULL, bool = false);
 };
 
 class MEGA_API CommandPutFile : public Command
@@ -351,10 +381,26 @@ class MEGA_API CommandPutNodes : public Command
     targettype_t type;
     putsource_t source;
 
+    // batch of uploads: transfer tag of each node
+    vector<int> tags;
+    void batchresult(error);
+
+    // report to the app, the upload transfers or the tree
+    void appresult(error);
+
+    void init(MegaClient*, handle, const char*);
+
 public:
     void procresult();
 
+    // slice of a large tree (see MegaClient::putnodestree())
+    PutNodesTree* tree;
+    int slice;
+
     CommandPutNodes(MegaClient*, handle, const char*, NewNode*, int, int, putsource_t = PUTNODES_APP);
+
+    // upload nodes of several transfers (into the same folder)
+    CommandPutNodes(MegaClient*, handle, NewNode*, int, vector<int>*);
 };
 
 class MEGA_API CommandSetAttr : public Command
@@ -363,8 +409,12 @@ class MEGA_API CommandSetAttr : public Command
     string pa;
     bool syncop;
 
+    // tags of later setattr() calls merged into this command
+    vector<int> tags;
+
 public:
     void procresult();
+    int coalesce(Command*);
 
     CommandSetAttr(MegaClient*, Node*, SymmCipher*, const char* = NULL);
 };
@@ -377,6 +427,9 @@ class MEGA_API CommandSetShare : public Command
     string msg;
     string personal_representation;
 
+    // the node keys are uploaded in slices after the share is created
+    bool slicedkeys;
+
     bool procuserresult(MegaClient*);
 
 public:
@@ -385,6 +438,15 @@ public:
     CommandSetShare(MegaClient*, Node*, User*, accesslevel_t, int, const char*, const char* = NULL);
 };
 
+// node keys of a slice of a large share (see MegaClient::execsharekeys())
+class MEGA_API CommandShareNodeKeys : public Command
+{
+public:
+    void procresult();
+
+    CommandShareNodeKeys(MegaClient*, ShareNodeKeys*);
+};
+
 class MEGA_API CommandGetUserData : public Command
 {
 public:
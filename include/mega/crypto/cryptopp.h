@@ -37,6 +37,10 @@
 #include <cryptopp/algparam.h>
 #include <cryptopp/hmac.h>
 
+#ifdef USE_OPENSSL_CRYPTO
+#include <openssl/evp.h>
+#endif
+
 namespace mega {
 using namespace std;
 
@@ -68,6 +72,48 @@ public:
     static uint32_t genuint32(uint64_t max);
 };
 
+#ifdef USE_OPENSSL_CRYPTO
+// OpenSSL EVP context for one AES-128 mode and direction without padding
+// (--with-crypto-backend=openssl): EVP dispatches to AES-NI / ARMv8 / VPAES
+// kernels at runtime, which outperform Crypto++'s on most targets
+class MEGA_API EvpCipher
+{
+    EVP_CIPHER_CTX* ctx;
+
+    EvpCipher(const EvpCipher&);
+    EvpCipher& operator=(const EvpCipher&);
+
+public:
+    void setkey(const EVP_CIPHER*, const byte*, bool);
+
+    // restart the chaining (modes with an IV only)
+    void setiv(const byte*);
+
+    // len must be a multiple of the block size, in-place permitted
+    void process(byte*, const byte*, unsigned);
+
+    EvpCipher();
+    ~EvpCipher();
+};
+
+// incremental EVP message digest, restarted after each get()
+class MEGA_API EvpHash
+{
+    EVP_MD_CTX* ctx;
+    const EVP_MD* md;
+
+    EvpHash(const EvpHash&);
+    EvpHash& operator=(const EvpHash&);
+
+public:
+    void add(const byte*, unsigned);
+    void get(string*);
+
+    EvpHash(const EVP_MD*);
+    ~EvpHash();
+};
+#endif
+
 // symmetric cryptography: AES-128
 class MEGA_API SymmCipher
 {
@@ -79,9 +125,18 @@ public:
     static const int TAG_SIZE = 12;
 
 private:
+#ifdef USE_OPENSSL_CRYPTO
+    EvpCipher evpecb_e;
+    EvpCipher evpecb_d;
+
+    EvpCipher evpcbc_e;
+    EvpCipher evpcbc_d;
+#else
     CryptoPP::ECB_Mode<CryptoPP::AES>::Encryption aesecb_e;
     CryptoPP::ECB_Mode<CryptoPP::AES>::Decryption aesecb_d;
+#endif
 
+    // keyed on demand for the PKCS-padded variants with the OpenSSL backend
     CryptoPP::CBC_Mode<CryptoPP::AES>::Encryption aescbc_e;
     CryptoPP::CBC_Mode<CryptoPP::AES>::Decryption aescbc_d;
 
@@ -91,6 +146,11 @@ private:
     CryptoPP::GCM<CryptoPP::AES>::Encryption aesgcm_e;
     CryptoPP::GCM<CryptoPP::AES>::Decryption aesgcm_d;
 
+    // blocks processed per keystream / MAC call in ctr_crypt()
+    static const unsigned CTRBATCH = 32;
+
+    void cbc_mac(const byte*, unsigned, byte*, byte*);
+
 public:
     static byte zeroiv[CryptoPP::AES::BLOCKSIZE];
 
@@ -262,6 +322,22 @@ public:
 
     void ctr_crypt(byte *, unsigned, m_off_t, ctr_iv, byte *, bool);
 
+    // ctr_crypt() of several independent chunks of a file with their MACs:
+    // the MAC chains advance in lockstep, MACLANES blocks per AES call
+    static const unsigned MACLANES = 8;
+    void ctr_crypt(unsigned, byte* const*, const unsigned*, const m_off_t*, ctr_iv, byte* const*, bool);
+
+    // cbc_decrypt() with a zero IV of several independent buffers, each under
+    // its own key (e.g. node attributes): only the decryption key schedule is
+    // expanded per buffer instead of all of setkey()'s, and each buffer is
+    // deciphered with a single multi-block AES call
+    static void cbc_decrypt(unsigned, const byte* const*, byte* const*, const unsigned*);
+
+    // encrypt the block with each of the keys in turn, the given number of
+    // times (password key derivation) - straight through the block cipher,
+    // without the ECB mode layer
+    static void encryptrounds(const byte*, int, byte*, int);
+
     static void setint64(int64_t, byte*);
 
     static void xorblock(const byte*, byte*);
@@ -381,29 +457,56 @@ public:
 
 class MEGA_API Hash
 {
+#ifdef USE_OPENSSL_CRYPTO
+    EvpHash hash;
+#else
     CryptoPP::SHA512 hash;
+#endif
 
 public:
     void add(const byte*, unsigned);
     void get(string*);
+
+#ifdef USE_OPENSSL_CRYPTO
+    Hash();
+#endif
 };
 
 class MEGA_API HashSHA256
 {
+#ifdef USE_OPENSSL_CRYPTO
+    EvpHash hash;
+#else
     CryptoPP::SHA256 hash;
+#endif
 
 public:
     void add(const byte*, unsigned int);
     void get(string*);
+
+#ifdef USE_OPENSSL_CRYPTO
+    HashSHA256();
+#endif
 };
 
 class MEGA_API HashCRC32
 {
+#ifndef USE_OPENSSL_CRYPTO
     CryptoPP::CRC32 hash;
+#endif
+
+    // running CRC-32 of the hardware path (or of zlib's with the OpenSSL
+    // backend), used instead of the library's when the CPU supports it
+    uint32_t crc;
 
 public:
     void add(const byte*, unsigned);
     void get(byte*);
+
+    // PCLMULQDQ folding (x86) or the ARMv8 CRC32 instructions are used
+    static bool hwsupported();
+
+    HashCRC32();
 };
 
 /**
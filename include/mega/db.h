@@ -24,13 +24,33 @@
 
 #include "filesystem.h"
 
+struct z_stream_s;
+
 namespace mega {
+// lookup columns as stored next to an encrypted record: handles and
+// fingerprint are encrypted deterministically under a key derived from the
+// table key, so that they can be matched, but not read
+struct MEGA_API DbIndex
+{
+    string nodehandle;
+    string parenthandle;
+    string fingerprint;
+    int type;
+
+    // false: the record has no lookup columns
+    bool set;
+
+    DbIndex() : type(0), set(false) { }
+};
+
 // generic host transactional database access interface
 class MEGA_API DbTable
 {
     static const int IDSPACING = 16;
 
 public:
+    enum { COLUMN_NODEHANDLE, COLUMN_PARENTHANDLE, COLUMN_FINGERPRINT };
+
     // for a full sequential get: rewind to first record
     virtual void rewind() = 0;
 
@@ -41,14 +61,68 @@ public:
     // get specific record by key
     virtual bool get(uint32_t, string*) = 0;
 
+    // read up to the given number of records through the cursor and decrypt
+    // them on the workers (if any) in slices of DECODESLICE - returns the
+    // number read, with ok[i] false for records that failed to decrypt
+    // records of the given type (unless negative) are skipped
+    unsigned nextbatch(unsigned, uint32_t*, string*, bool*, SymmCipher*, ParallelRunner*, int = -1);
+    static const unsigned DECODESLICE = 256;
+
     // update or add specific record
     virtual bool put(uint32_t, char*, unsigned) = 0;
     bool put(uint32_t, string*);
     bool put(uint32_t, Cachable *, SymmCipher*);
 
+    // update or add specific record with lookup columns (default: without)
+    virtual bool put(uint32_t, char*, unsigned, const DbIndex*);
+
+    // update or add several records at once (default: one put() each)
+    virtual bool putbatch(unsigned, const uint32_t*, const string*, const DbIndex*);
+
+    // ids of the records whose column matches the value (from
+    // indexvalue()), false if the backend has no lookup columns
+    virtual bool lookup(int, const string*, vector<uint32_t>*);
+
+    // stored form of a handle column or of a fingerprint (size and sparse
+    // CRC - mtime is not part of it) under the given table key
+    void indexvalue(handle, SymmCipher*, string*);
+    void indexvalue(const FileFingerprint*, SymmCipher*, string*);
+
+    // set by the backend if the lookup columns of existing records are
+    // missing (after a schema upgrade) - cleared by the consumer once
+    // the records have been rewritten
+    bool reindex;
+
+    // buffered put of Cachable records: serialized and assigned their dbid
+    // right away, written through putbatch() in groups of PUTBATCH -
+    // flushbatch() writes the rest and must precede any other access
+    static const unsigned PUTBATCH = 64;
+    bool putbatched(uint32_t, Cachable*, SymmCipher*);
+    bool flushbatch();
+
+    // a fresh record id of the given type, for records that are written
+    // later (with their dbid preset)
+    uint32_t reserveid(uint32_t);
+
+    // Cachable records that are worth it are deflated before encryption
+    // (default: on) - records are flagged individually, so compressed and
+    // uncompressed ones coexist - returns false if unavailable
+    bool setcompression(bool);
+    bool compressrecords;
+
+    // minimum serialized record size worth compressing
+    static const unsigned MINCOMPRESS = 64;
+
+    // sanity limit for the size of an uncompressed record
+    static const unsigned MAXRECORDSIZE = 1 << 24;
+
     // delete specific record
     virtual bool del(uint32_t) = 0;
 
+    // delete several records at once (default: one del() each)
+    virtual bool delbatch(unsigned, const uint32_t*);
+    static const unsigned DELBATCH = 256;
+
     // delete all records
     virtual void truncate() = 0;
 
@@ -64,11 +138,128 @@ public:
     // permanantly remove all database info
     virtual void remove() = 0;
 
+    // UTF-8 path of a file kept next to the table and removed with it
+    // (false if the backend has none)
+    virtual bool sidecar(string*);
+
     // autoincrement
     uint32_t nextid;
 
+    // encrypted bytes of the Cachable records written so far
+    m_off_t byteswritten;
+
+private:
+    uint32_t batchids[PUTBATCH];
+    string batchdata[PUTBATCH];
+    DbIndex batchindex[PUTBATCH];
+    unsigned batched;
+
+    // derived from the table key for the lookup columns
+    SymmCipher* indexkey;
+    SymmCipher* columnkey(SymmCipher*);
+
+    void index(Cachable*, SymmCipher*, DbIndex*);
+
+    // raw deflate streams, reused across records
+    z_stream_s* zdeflate;
+    z_stream_s* zinflate;
+
+    // serialize, compress, pad and encrypt / decrypt, unpad and uncompress
+    // (the latter with a caller-owned inflate stream, see decodeslice())
+    bool encrypt(Cachable*, SymmCipher*, string*);
+    static bool decrypt(string*, SymmCipher*, z_stream_s**);
+
+    bool compress(string*);
+    static bool uncompress(string*, z_stream_s**);
+    static void inflateend(z_stream_s*);
+
+    static void decodeslice(unsigned, void*);
+
+public:
+
     DbTable();
-    virtual ~DbTable() { }
+    virtual ~DbTable();
+};
+
+// write-behind wrapper of a table: writes and transaction boundaries are
+// queued (up to MAXQUEUED) and executed in order on a writer thread, so
+// that slow commits do not hold up the caller - reads wait for the queue
+// to drain unless they can be served from it
+// a commit is a barrier: it is executed only if all writes since begin()
+// succeeded (otherwise the transaction is rolled back), so a persisted
+// scsn never runs ahead of the records it covers - once a queued write
+// has failed, further writes report it and nothing else is written
+// thread, mutex and semaphores are supplied by the application and owned
+// by the wrapper, as is the wrapped table
+class MEGA_API AsyncDbTable : public DbTable
+{
+public:
+    static const unsigned MAXQUEUED = 4096;
+
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool put(uint32_t, char*, unsigned, const DbIndex*);
+    bool putbatch(unsigned, const uint32_t*, const string*, const DbIndex*);
+    bool lookup(int, const string*, vector<uint32_t>*);
+    bool del(uint32_t);
+    bool delbatch(unsigned, const uint32_t*);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+    bool sidecar(string*);
+
+    // wait until all queued operations have been executed - false if any
+    // of them failed
+    bool sync();
+
+    AsyncDbTable(DbTable*, Thread*, Mutex*, Semaphore*, Semaphore*, Semaphore*);
+    ~AsyncDbTable();
+
+private:
+    enum { OP_PUT, OP_PUTBATCH, OP_DEL, OP_DELBATCH, OP_TRUNCATE, OP_BEGIN, OP_COMMIT, OP_ABORT, OP_SYNC, OP_STOP };
+
+    struct Op
+    {
+        int type;
+        vector<uint32_t> ids;
+        vector<string> data;
+        vector<DbIndex> columns;
+
+        Op(int t) : type(t) { }
+    };
+
+    DbTable* table;
+    Thread* thread;
+
+    // guards queue and failed
+    Mutex* mutex;
+
+    // queued operations and free queue slots
+    Semaphore* items;
+    Semaphore* slots;
+
+    // released by OP_SYNC
+    Semaphore* synced;
+
+    deque<Op*> queue;
+    bool failed;
+
+    // operations queued since the last sync() - if none, the writer is idle
+    // and the wrapped table can be read directly
+    unsigned pending;
+
+    // queue an operation (blocking while the queue is full) - false if a
+    // previous write failed
+    bool enqueue(Op*);
+
+    // writer thread
+    static void* writerentry(void*);
+    void write();
+    bool execute(Op*);
 };
 
 struct MEGA_API DbAccess
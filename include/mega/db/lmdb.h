@@ -0,0 +1,104 @@
+/**
+ * @file lmdb.h
+ * @brief LMDB access layer
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifdef USE_LMDB
+#ifndef DBACCESS_CLASS
+#define DBACCESS_CLASS LmdbDbAccess
+
+#include <lmdb.h>
+
+namespace mega {
+class MEGA_API LmdbDbAccess : public DbAccess
+{
+    string dbpath;
+
+public:
+    // size of the memory map and thus the maximum size of a table (the
+    // file only grows as needed)
+    static const size_t MAPSIZE = sizeof(size_t) > 4 ? (size_t)1 << 34 : (size_t)1 << 29;
+
+    DbTable* open(FileSystemAccess*, string*);
+
+    LmdbDbAccess(string* = NULL);
+    ~LmdbDbAccess();
+};
+
+// a single-file environment per table holding the records (keyed by id),
+// the lookup columns of each record and one duplicate-sorted index (value
+// to id) per lookup column
+// operations outside begin() / commit() run in a transaction of their own
+class MEGA_API LmdbDbTable : public DbTable
+{
+    MDB_env* env;
+    string dbfile;
+    FileSystemAccess *fsaccess;
+
+    MDB_dbi records;
+    MDB_dbi columns;
+    MDB_dbi indexes[3];
+
+    // transaction of begin()
+    MDB_txn* txn;
+
+    // cursor of rewind() / next() and its read-only transaction if it was
+    // opened outside of begin()
+    MDB_cursor* cursor;
+    MDB_txn* cursortxn;
+    MDB_cursor_op cursorop;
+
+    // the transaction of begin(), or a new one to be passed to end()
+    bool start(MDB_txn**, bool);
+    bool end(MDB_txn*, bool);
+
+    void closecursor();
+
+    // remove the index entries of the record's current lookup columns
+    bool unindex(MDB_txn*, uint32_t);
+
+    // log and pass on LMDB errors
+    bool check(int, const char*);
+
+public:
+    void rewind();
+    bool next(uint32_t*, string*);
+    bool get(uint32_t, string*);
+    bool put(uint32_t, char*, unsigned);
+    bool put(uint32_t, char*, unsigned, const DbIndex*);
+    bool putbatch(unsigned, const uint32_t*, const string*, const DbIndex*);
+    bool lookup(int, const string*, vector<uint32_t>*);
+    bool del(uint32_t);
+    void truncate();
+    void begin();
+    void commit();
+    void abort();
+    void remove();
+    bool sidecar(string*);
+
+    // open the table's databases, false if that failed
+    bool init();
+
+    LmdbDbTable(MDB_env*, FileSystemAccess *fs, string *filepath);
+    ~LmdbDbTable();
+};
+} // namespace
+
+#endif
+#endif
@@ -30,6 +30,13 @@ class MEGA_API SqliteDbAccess : public DbAccess
 {
     string dbpath;
 
+    // version of the statecache table layout (PRAGMA user_version):
+    // 1 - lookup columns nodehandle, parenthandle, type and fingerprint
+    static const int SCHEMA_VERSION = 1;
+
+    static int schemaversion(sqlite3*);
+    static bool isempty(sqlite3*);
+
 public:
     DbTable* open(FileSystemAccess*, string*);
 
@@ -44,17 +51,40 @@ class MEGA_API SqliteDbTable : public DbTable
     string dbfile;
     FileSystemAccess *fsaccess;
 
+    // the cursor of rewind() / next() is active
+    bool iterating;
+
+    // prepared statements, reused for the lifetime of the table
+    sqlite3_stmt* getStmt;
+    sqlite3_stmt* putStmt;
+    sqlite3_stmt* putBatchStmt;
+    sqlite3_stmt* delStmt;
+    sqlite3_stmt* delBatchStmt;
+    sqlite3_stmt* lookupStmt[3];
+
+    // prepare on first use
+    bool prepare(sqlite3_stmt**, const char*);
+    void finalize();
+
+    // bind the lookup columns (NULL if none) starting at the given parameter
+    bool bindcolumns(sqlite3_stmt*, int, const DbIndex*);
+
 public:
     void rewind();
     bool next(uint32_t*, string*);
     bool get(uint32_t, string*);
     bool put(uint32_t, char*, unsigned);
+    bool put(uint32_t, char*, unsigned, const DbIndex*);
+    bool putbatch(unsigned, const uint32_t*, const string*, const DbIndex*);
+    bool lookup(int, const string*, vector<uint32_t>*);
     bool del(uint32_t);
+    bool delbatch(unsigned, const uint32_t*);
     void truncate();
     void begin();
     void commit();
     void abort();
     void remove();
+    bool sidecar(string*);
 
     SqliteDbTable(sqlite3*, FileSystemAccess *fs, string *filepath);
     ~SqliteDbTable();
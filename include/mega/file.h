@@ -77,6 +77,10 @@ struct MEGA_API File: public FileFingerprint
     // for remote file drops: uid or e-mail address of recipient
     string targetuser;
 
+    // downloads: deliver the data to this sink (owned by the File) rather
+    // than to localname
+    TransferSink* sink;
+
     // transfer linkage
     Transfer* transfer;
     file_list::iterator file_it;
@@ -29,29 +29,66 @@
 namespace mega {
 
 // file attribute fetching for a specific source cluster
+// several requests can be in flight at once, each carrying a batch of the
+// most recently requested attributes, so that fetches for what the user is
+// looking at now do not queue behind stale ones
 struct MEGA_API FileAttributeFetchChannel
 {
+    // concurrent requests per channel
+    static const int MAXREQS = 3;
+
+    // attributes per request
+    static const unsigned MAXBATCH = 16;
+
     handle fahref;
 
     BackoffTimer bt;
-    BackoffTimer timeout;
 
-    HttpReq req;
     dstime urltime;
     string posturl;
-    size_t inbytes;
-    
+
+    // set while the POST URL is being requested
+    bool urlpending;
+
+    // request slots
+    HttpReq req[MAXREQS];
+    BackoffTimer timeout[MAXREQS];
+    size_t inbytes[MAXREQS];
+    error e[MAXREQS];
+
+    // fresh / in flight
     faf_map fafs[2];
-    error e;
 
-    // dispatch new and retrying attributes by POSTing to existing URL
+    // priority of the most recent fetch
+    unsigned seq;
+
+    // dispatch new and retrying attributes to idle slots by POSTing to
+    // existing URL, most recently requested first
     void dispatch(MegaClient*);
 
-    // parse fetch result and remove completed attributes from pending
+    // parse fetch result of a slot and remove completed attributes from
+    // pending
     void parse(MegaClient*, int, bool);
 
-    // notify app of nodes that failed to receive their requested attribute
-    void failed(MegaClient*);
+    // notify app of nodes in a slot that failed to receive their requested
+    // attribute
+    void failed(MegaClient*, int);
+
+    // notify app of fresh nodes whose attribute could not be requested
+    void urlfailed(MegaClient*, error);
+
+    // remove an attribute fetch, tearing down its request if nothing else
+    // is pending on it
+    bool cancel(handle);
+
+    // number of attributes pending on a slot
+    unsigned pending(int);
+
+    // is any slot in flight?
+    bool inflight();
+
+    // is any fresh fetch not a background one?
+    bool urgent();
 
     FileAttributeFetchChannel();
 };
@@ -64,8 +101,53 @@ struct MEGA_API FileAttributeFetch
     int retries;
     int tag;
 
+    // request slot while in flight
+    int slot;
+
+    // higher is more urgent
+    unsigned seq;
+
     FileAttributeFetch(handle, fatype, int);
 };
+
+// on-disk cache of fetched file attributes, one file per file attribute
+// handle (attributes never change under their handle), stored as received
+// (encrypted with the file's key) - beyond the size budget, the least
+// recently used ones are evicted (recency survives restarts as the files'
+// mtime)
+class MEGA_API FileAttributeCache
+{
+    FileSystemAccess* fsaccess;
+    string localdir;
+    m_off_t budget;
+    m_off_t total;
+
+    // set once the directory has been listed
+    bool loaded;
+
+    struct Entry
+    {
+        m_off_t size;
+        list<handle>::iterator lru;
+    };
+
+    // least recently used first
+    list<handle> lru;
+    map<handle, Entry> entries;
+
+    void load();
+    void localname(handle, string*);
+    void evict();
+
+public:
+    // read the attribute stored under the handle
+    bool get(handle, string*);
+
+    // store an attribute under its handle
+    void put(handle, const char*, unsigned);
+
+    FileAttributeCache(FileSystemAccess*, string*, m_off_t);
+};
 } // namespace
 
 #endif
@@ -69,6 +69,14 @@ struct MEGA_API FileAccess
     // absolute position read to byte buffer
     bool frawread(byte *, unsigned, m_off_t);
 
+    // vectored read of equally sized blocks at ascending positions into
+    // consecutive slices of the buffer: the file is opened once and blocks
+    // less than MAXREADGAP apart are fetched with a single read
+    bool frawread(byte *, unsigned, const m_off_t *, unsigned);
+
+    static const int MAXREADGAP = 4096;
+    static const int MAXREADSPAN = 262144;
+
     // non-locking ops: open/close temporary hFile
     bool openf();
     void closef();
@@ -76,6 +84,10 @@ struct MEGA_API FileAccess
     // absolute position write
     virtual bool fwrite(const byte *, unsigned, m_off_t) = 0;
 
+    // reserve disk space for the given size without changing the file size
+    // (where supported by the platform and filesystem)
+    virtual bool preallocate(m_off_t) { return false; }
+
     // system-specific raw read/open/close
     virtual bool sysread(byte *, unsigned, m_off_t) = 0;
     virtual bool sysstat(m_time_t*, m_off_t*) = 0;
@@ -101,6 +113,10 @@ struct MEGA_API DirAccess
     // get next record
     virtual bool dnext(string*, string*, bool = true, nodetype_t* = NULL) = 0;
 
+    // size, mtime and fsid of the record last returned by dnext(), where
+    // the listing provides them (saves opening the record to check it)
+    virtual bool dstat(m_off_t*, m_time_t*, handle*) { return false; }
+
     virtual ~DirAccess() { }
 };
 
@@ -128,6 +144,21 @@ struct MEGA_API DirNotify
 
     void notify(notifyqueue, LocalNode *, const char*, size_t, bool = false);
 
+    // queued DIREVENTS by full local path (as sequence numbers, counted
+    // from the first DIREVENTS item ever queued): notifications of a path
+    // that is still queued are dropped, as are those below a queued folder
+    // that has no LocalNode yet (its scan will pick them up)
+    map<string, uint64_t> queued;
+    uint64_t popped;
+    Notification* queueditem(const string*);
+
+    // remove the front item of a queue
+    void pop(notifyqueue);
+
+    // DIREVENTS notifications received, dropped as duplicates and dropped
+    // as covered by a pending folder scan
+    m_off_t notifications, coalesced, collapsed;
+
     // filesystem fingerprint
     virtual fsfp_t fsfingerprint();
 
@@ -135,6 +166,7 @@ struct MEGA_API DirNotify
     string ignore;
 
     DirNotify(string*, string*);
+    virtual ~DirNotify() { }
 };
 
 // generic host filesystem access interface
@@ -25,10 +25,24 @@
 namespace mega {
 using namespace std;
 
+// file attribute generation, decoded and resized on a worker and attached
+// through putfa() by the client thread
+struct MEGA_API GfxJob
+{
+    string localfilename;
+    handle th;
+    byte key[SymmCipher::KEYLENGTH];
+    int missing;
+
+    // generated JPEGs by meta_t (NULL if not generated)
+    vector<string*> images;
+};
+
 // bitmap graphics processor
 class MEGA_API GfxProc
 {
-    // read and store bitmap
+    // read and store bitmap, needed at (at least) the given size - see
+    // decodesize()
     virtual bool readbitmap(FileAccess*, string*, int) = 0;
 
     // resize stored bitmap and store result as JPEG
@@ -37,10 +51,40 @@ class MEGA_API GfxProc
     // free stored bitmap
     virtual void freebitmap() = 0;
 
+    // bitmap size needed for the given dimensions (the readbitmap() hint)
+    static int decodesize(int);
+
+    // generate the missing dimensions of the job's file
+    void process(GfxJob*);
+
+    // worker threads, each with its own GfxProc (the bitmap state is per
+    // instance) - the pool's GfxProc itself stays with the client thread
+    vector<Thread*> workers;
+    vector<GfxProc*> workerprocs;
+    GfxProc* pool;
+
+    // guards jobs, results and stopping
+    Mutex* jobmutex;
+
+    // queued jobs (plus one per worker to stop)
+    Semaphore* jobsready;
+
+    deque<GfxJob*> jobs;
+    deque<GfxJob*> results;
+    bool stopping;
+
+    static void* workerentry(void*);
+    void work();
+
 protected:
     // coordinate transformation
     static void transform(int&, int&, int&, int&, int&, int&);
 
+    // images whose decoded bitmap would exceed this are not decoded (none
+    // of the backends can decode in tiles or scanlines, so this is checked
+    // on the header before decoding)
+    static const m_off_t MAXBITMAPBYTES;
+
     // list of supported extensions (NULL if no pre-filtering is needed)
     virtual const char* supportedformats();
 
@@ -52,8 +96,18 @@ public:
     // handle is uploadhandle or nodehandle
     // - must respect JPEG EXIF rotation tag
     // - must save at 85% quality (120*120 pixel result: ~4 KB)
+    // with workers, the dimensions are generated in the background and the
+    // number of dimensions requested is returned
     int gendimensionsputfa(FileAccess*, string*, handle, SymmCipher*, int = -1);
 
+    // generate dimensions on n worker threads instead of the client thread,
+    // each using one of the n GfxProcs supplied - the pool takes ownership
+    // of the GfxProcs, threads, mutex and semaphore
+    void startworkers(unsigned n, GfxProc**, Thread**, Mutex*, Semaphore*);
+
+    // attach the dimensions generated by the workers (from MegaClient::exec())
+    void checkjobs();
+
     // FIXME: read dynamically from API server
     typedef enum { THUMBNAIL120X120, PREVIEW1000x1000 } meta_t;
 
@@ -67,7 +121,7 @@ public:
     MegaClient* client;
 
     GfxProc();
-    virtual ~GfxProc() { }
+    virtual ~GfxProc();
 };
 } // namespace
 
@@ -16,10 +16,13 @@
 class MEGA_API GfxProcCG : public mega::GfxProc
 {
     CGImageSourceRef imageSource;
+    // last bounding box result - square thumbnails are derived from it
+    CGImageRef derived;
     CFDictionaryRef imageParams;
     CFMutableDictionaryRef thumbnailParams;
     CGFloat w, h;
     CGImageRef createThumbnailWithMaxSize(int size);
+    CGImageRef squareFromImage(CGImageRef image, int rw);
     int maxSizeForThumbnail(const int rw, const int rh);
 private: // mega::GfxProc implementations
     const char* supportedformats();
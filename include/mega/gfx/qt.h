@@ -48,6 +48,10 @@ class MEGA_API GfxProcQT : public GfxProc
     };
 
     QImageReader *image;
+
+    // last bounding box result - smaller dimensions are derived from it
+    QImage derived;
+
     int orientation;
     int w, h;
 
@@ -89,6 +89,65 @@ namespace mega {
                          "2403:9800:c020::43,122.56.56.216," \
                          "2405:f900:3e6a:1::103,103.244.183.5"
 
+// token-bucket limits for transfer data per direction (PUT/GET): a total
+// budget, optionally replaced by time-of-day schedules, and a budget per
+// transfer priority class - enforced by the HttpIO implementation as data is
+// sent/received, rates in bytes/s (0 = unlimited)
+class MEGA_API BandwidthShaper
+{
+public:
+    static const int NUMCLASSES = 3;
+
+    void setlimit(direction_t, m_off_t);
+    void setclasslimit(direction_t, int, m_off_t);
+
+    // total budget from startminute to endminute (local time, minutes since
+    // midnight, wrapping around if endminute < startminute)
+    void addschedule(direction_t, int, int, m_off_t);
+    void clearschedules(direction_t);
+
+    // is data of the direction and class limited at all?
+    bool limited(direction_t, int);
+
+    // bytes that may be transferred now, 0 if the request has to wait
+    m_off_t available(direction_t, int);
+
+    // account for transferred data (can overdraw the buckets)
+    void consume(direction_t, int, m_off_t);
+
+    BandwidthShaper();
+
+private:
+    struct Bucket
+    {
+        m_off_t rate;
+        m_off_t tokens;
+        dstime refilled;
+
+        void setrate(m_off_t);
+        void refill();
+        Bucket();
+    };
+
+    struct Schedule
+    {
+        int start;
+        int end;
+        m_off_t rate;
+    };
+
+    Bucket total[2];
+    Bucket classes[2][NUMCLASSES];
+
+    // total budget outside the schedules
+    m_off_t baserate[2];
+    vector<Schedule> schedules[2];
+
+    // schedules are re-evaluated every minute
+    dstime scheduled[2];
+    void applyschedules(direction_t);
+};
+
 // generic host HTTP I/O interface
 struct MEGA_API HttpIO : public EventTrigger
 {
@@ -126,6 +185,13 @@ struct MEGA_API HttpIO : public EventTrigger
     // (WinHTTP on XP does not)
     bool chunkedok;
 
+    // can responses be consumed while they arrive? (requires all received
+    // data to be stored through HttpReq::put())
+    bool streamingok;
+
+    // transfer bandwidth limits
+    BandwidthShaper shaper;
+
     // timestamp of last data received (across all connections)
     dstime lastdata;
 
@@ -135,6 +201,20 @@ struct MEGA_API HttpIO : public EventTrigger
     // set useragent (must be called exactly once)
     virtual void setuseragent(string*) = 0;
 
+    // multiplex requests to the same host over HTTP/2 where the server
+    // supports it (opt-in), returns false if the implementation can't
+    virtual bool sethttp2(bool) { return false; }
+
+    // gzip API request bodies (opt-in, dropped again if the API server
+    // rejects a compressed request), returns false if unavailable
+    bool setcompression(bool);
+    bool compressrequests;
+
+    // bytes not sent / not received thanks to request body compression
+    // and compressed response encodings
+    m_off_t compressionsavedout;
+    m_off_t compressionsavedin;
+
     void getMEGADNSservers(string*, bool = true);
 
     HttpIO();
@@ -160,6 +240,18 @@ struct MEGA_API HttpReq
     string in;
     size_t inpurge;
 
+    // the response is consumed (and purged) while it arrives - don't
+    // preallocate it in full
+    bool streaming;
+
+    // the request body in out is gzip-compressed
+    bool gzipped;
+
+    // time of the last post() and TCP connect time of the connection in ms
+    // (-1: connection reused or not reported by the HttpIO implementation)
+    dstime posttime;
+    int rtt;
+
     string outbuf;
     string chunkedout;
 
@@ -181,6 +273,12 @@ struct MEGA_API HttpReq
 
     // post request to the network
     void post(MegaClient*, const char* = NULL, unsigned = 0);
+
+    // replace the body in out with its gzip compression if that is smaller
+    bool compressout();
+
+    // minimum body size worth compressing
+    static const unsigned MINCOMPRESS = 1024;
     void postchunked(MegaClient*);
 
     // store chunk of incoming data with optional purging
@@ -193,6 +291,10 @@ struct MEGA_API HttpReq
     // set amount of purgeable data at 0
     void purge(size_t);
 
+    // drop purged data from the receive buffer (amortized), returns the
+    // number of bytes dropped
+    size_t compactin();
+
     // set response content length
     void setcontentlength(m_off_t);
     
@@ -211,29 +313,210 @@ struct MEGA_API HttpReq
     // prevent raw data from being dumped in debug mode
     bool binary;
 
+    // transfer data: direction and priority class for bandwidth shaping
+    // (shapedir < 0: not shaped)
+    int shapedir;
+    int shapeclass;
+
     HttpReq(bool = false);
     virtual ~HttpReq();
 };
 
+// page-aligned transfer chunk buffers in size classes of CLASSSIZE bytes,
+// recycled across chunk requests instead of being reallocated whenever the
+// chunk size changes - buffers beyond the largest class are not pooled
+class MEGA_API ChunkBufferPool
+{
+public:
+    static const unsigned CLASSSIZE = 131072;
+    static const unsigned NUMCLASSES = 8;
+
+    // idle buffers kept per class
+    static const unsigned MAXIDLE = 16;
+
+    // buffer of at least len bytes, its actual size is stored in *capacity
+    byte* get(unsigned len, unsigned* capacity);
+
+    // return a buffer obtained from get() with its capacity
+    void release(byte*, unsigned capacity);
+
+    // free the idle buffers
+    void clear();
+
+    // number of get() calls and those served from idle buffers
+    uint64_t requests;
+    uint64_t hits;
+
+    // bytes in buffers handed out / kept idle, and the peak of their sum
+    size_t inuse;
+    size_t idle;
+    size_t peak;
+
+    // unpooled page-aligned allocation
+    static byte* allocate(unsigned);
+    static void deallocate(byte*);
+
+    ChunkBufferPool();
+    ~ChunkBufferPool();
+
+private:
+    static const unsigned PAGESIZE = 4096;
+
+    vector<byte*> idlebufs[NUMCLASSES];
+
+    ChunkBufferPool(const ChunkBufferPool&);
+    ChunkBufferPool& operator=(const ChunkBufferPool&);
+};
+
+// network quality of the storage servers, per host[:port]: exponentially
+// weighted TCP connect time, per-connection throughput and error rate of
+// the chunk requests, plus request counters and the last success/failure
+class MEGA_API HostStats
+{
+public:
+    struct Host
+    {
+        // ms / bytes per second, -1: no sample yet
+        int rtt;
+        m_off_t throughput;
+
+        // fraction of failed requests (0..1)
+        float errorrate;
+
+        unsigned requests;
+        unsigned failures;
+        m_off_t bytes;
+
+        dstime lastsuccess;
+        dstime lastfailure;
+        dstime lastreported;
+
+        // scheme://host[:port]/ of the first request
+        string base;
+
+        Host();
+    };
+
+    typedef map<string, Host> host_map;
+    host_map hosts;
+
+    // host[:port] of a URL
+    static string hostof(const string& url);
+
+    // chunk request completed with the given number of bytes / failed
+    void success(const HttpReq*, m_off_t);
+    void failure(const string& url);
+
+    // entry for the URL's host or NULL
+    const Host* find(const string& url) const;
+
+    // most recent requests to the host failed (and none succeeded since)
+    bool degraded(const string& url) const;
+
+    // may a failure of the host be reported to the API? (at most once per
+    // REPORTINTERVAL) - records the report
+    bool report(const string& url);
+
+    // JSON array of all hosts, times in seconds since (-1: never)
+    void getjson(string*) const;
+
+    // base URLs of up to the given number of hosts, most recent success
+    // first (hosts that never succeeded are skipped)
+    void recent(vector<string>*, unsigned) const;
+
+    static const dstime REPORTINTERVAL = 6000;
+
+    // the exponential averages give each new sample a weight of 1/WEIGHT
+    static const int WEIGHT = 8;
+
+    // hosts not used for that long are dropped
+    static const dstime EXPIRY = 36000;
+
+    // hosts tracked at most
+    static const unsigned MAXHOSTS = 256;
+
+private:
+    Host& get(const string& url);
+};
+
 // file chunk I/O
 struct MEGA_API HttpReqXfer : public HttpReq
 {
     unsigned size;
 
+    // source of the chunk buffers (NULL: no pooling)
+    ChunkBufferPool* pool;
+
     virtual bool prepare(FileAccess*, const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t) = 0;
     virtual void finalize(FileAccess*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t) { }
 
-    HttpReqXfer() : HttpReq(true), size(0) { }
+    // (re)send the prepared request
+    virtual void send(MegaClient* client) { post(client); }
+
+    // the AES-CTR and MAC step of prepare()/finalize() on its own: it only
+    // touches the request's buffer, so the chunks of a transfer can be
+    // processed on worker threads (each with its own cipher)
+    virtual void crypt(SymmCipher*, uint64_t) { }
+
+    // crypt() several chunks of a transfer together, interleaving their MACs
+    static void crypt(vector<HttpReqXfer*>*, SymmCipher*, uint64_t);
+
+    // AES-CTR and MAC of a buffer at a chunk boundary of the file, which may
+    // span several chunks (ChunkedHash boundaries) - one MAC per chunk
+    static void cryptspan(SymmCipher*, byte*, unsigned, m_off_t, uint64_t, chunkmac_map*, bool);
+
+    // MACs computed by crypt(), one per chunk the request spans, and whether
+    // crypt() has run on the data
+    chunkmac_map chunkmacs;
+    bool crypted;
+
+protected:
+    // the padded buffer, length and file position crypt() works on, and its
+    // direction
+    virtual byte* cryptbuf(unsigned*, m_off_t*, bool*) { return NULL; }
+
+public:
+
+    HttpReqXfer(ChunkBufferPool* p = NULL) : HttpReq(true), size(0), pool(p), crypted(false) { }
 };
 
 // file chunk upload
+// chunks are read into a page-aligned (pooled) buffer that is reused for
+// all chunks of the transfer, encrypted in place and posted straight from there (the
+// HttpIO implementations don't copy raw POST data)
 struct MEGA_API HttpReqUL : public HttpReqXfer
 {
+    m_off_t ulpos;
+
     bool prepare(FileAccess*, const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
 
+    // prepare() in steps: read the padded chunk, crypt(), then store the MAC
+    bool read(FileAccess*, const char*, m_off_t, m_off_t);
+
+    // instead of read() and crypt(): take over a padded chunk buffer from
+    // the pool that was read and encrypted elsewhere, with its MACs (the
+    // previous buffer goes back to the pool)
+    void adopt(byte*, unsigned, chunkmac_map*, const char*, m_off_t, m_off_t);
+    void crypt(SymmCipher*, uint64_t);
+    void seal(chunkmac_map*);
+
+    byte* cryptbuf(unsigned*, m_off_t*, bool*);
+
+    void send(MegaClient*);
+
     m_off_t transferred(MegaClient*);
 
-    ~HttpReqUL() { }
+    HttpReqUL(ChunkBufferPool* = NULL);
+    ~HttpReqUL();
+
+private:
+    byte* chunkbuf;
+    unsigned chunkbuflen;
+
+    void settarget(const char*, m_off_t);
+
+    HttpReqUL(const HttpReqUL&);
+    HttpReqUL& operator=(const HttpReqUL&);
 };
 
 // file chunk download
@@ -242,9 +525,114 @@ struct MEGA_API HttpReqDL : public HttpReqXfer
     m_off_t dlpos;
 
     bool prepare(FileAccess*, const char*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
+
+    // crypt() unless done already, then write and store the MAC
     void finalize(FileAccess*, SymmCipher*, chunkmac_map*, uint64_t, m_off_t, m_off_t);
+    void crypt(SymmCipher*, uint64_t);
+
+    byte* cryptbuf(unsigned*, m_off_t*, bool*);
+
+    // crypt() unless done already and hand over the buffer (and its
+    // capacity) to the caller, who returns it to the pool
+    byte* detach(SymmCipher*, uint64_t, unsigned*);
+
+    HttpReqDL(ChunkBufferPool* = NULL);
+    ~HttpReqDL();
+
+private:
+    // capacity of buf (which can exceed buflen)
+    unsigned bufcapacity;
+
+    HttpReqDL(const HttpReqDL&);
+    HttpReqDL& operator=(const HttpReqDL&);
+};
+
+// LRU cache of decrypted DirectRead data shared by all nodes, in blocks of
+// BLOCKSIZE (chunk boundaries are multiples of it), and the detection of
+// sequential reads that drives the per-node read-ahead window
+class MEGA_API DirectReadCache
+{
+public:
+    static const unsigned BLOCKSIZE = 131072;
+
+    // read-ahead grows from one block up to MAXREADAHEAD on sequential reads
+    static const m_off_t MAXREADAHEAD = 8388608;
+
+    // cached block (its last one may be short) or NULL
+    const string* get(handle, m_off_t);
+    void put(handle, m_off_t, const char*, unsigned);
+
+    // record a read of the node, return the read-ahead to use for it
+    m_off_t access(handle, m_off_t, m_off_t);
 
-    ~HttpReqDL() { }
+    // set the capacity in bytes (0 disables caching and read-ahead)
+    void setmaxbytes(m_off_t);
+    m_off_t maxbytes() const { return capacity; }
+
+    void clear();
+
+    // statistics: lookups served, lookups missed, bytes cached
+    uint64_t hits;
+    uint64_t misses;
+    m_off_t bytes;
+
+    DirectReadCache();
+
+private:
+    typedef pair<handle, m_off_t> blockid;
+    typedef list<blockid> blockid_list;
+
+    struct Block
+    {
+        string data;
+        blockid_list::iterator lru_it;
+    };
+
+    // least recently used first
+    blockid_list lru;
+    map<blockid, Block> blocks;
+
+    // end of the last read and current read-ahead by node (bounded)
+    static const unsigned MAXSTREAMS = 64;
+    map<handle, pair<m_off_t, m_off_t> > streams;
+
+    m_off_t capacity;
+
+    void evict(m_off_t);
+};
+
+// temporary download URLs (with the file size) shared by transfers and
+// direct reads, keyed by node handle encoded with its type (see
+// MegaClient::encodehandletype)
+class MEGA_API TempUrlCache
+{
+public:
+    // URLs are reused for a limited time - the storage servers reject expired
+    // ones with 403 / 404, which invalidates them earlier
+    static const dstime TTL = 3000;
+    static const unsigned MAXENTRIES = 256;
+
+    // fresh URL or NULL, the file size goes to *size
+    const string* get(handle, m_off_t* size);
+    void put(handle, const string*, m_off_t);
+    void invalidate(handle);
+    void clear();
+
+    // statistics: lookups served, lookups missed
+    uint64_t hits;
+    uint64_t misses;
+
+    TempUrlCache();
+
+private:
+    struct Entry
+    {
+        string url;
+        m_off_t size;
+        dstime ts;
+    };
+
+    map<handle, Entry> entries;
 };
 
 // file attribute get
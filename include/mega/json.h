@@ -37,7 +37,9 @@ struct MEGA_API JSON
 
     m_off_t getint();
     double getfloat();
-    const char* getvalue();
+    // value in place (strings without quotes and not unescaped), optionally
+    // with its length - valid as long as the JSON buffer
+    const char* getvalue(size_t* = NULL);
 
     nameid getnameid();
     nameid getnameid(const char*) const;
@@ -60,6 +62,8 @@ struct MEGA_API JSON
     bool storestring(string*);
     bool storeobject(string* = NULL);
 
+    static const char* skipstring(const char*);
+
     static void unescape(string*);
 
     /**
@@ -72,6 +76,53 @@ struct MEGA_API JSON
     static bool extractstringvalue(const string & json, const string & name, string* value);
 };
 
+// incremental scanner for an API response that arrives in pieces: locates
+// the array at "f" of the object at a given index of the result array and
+// hands out its elements as soon as they are complete
+struct MEGA_API JSONSplitter
+{
+    // start over, looking for the array in result element elem (-1: none)
+    void reset(int elem);
+
+    // continue scanning the unreleased data, return the next complete
+    // element of the array (data must start at the first unreleased byte)
+    bool next(const char* data, size_t len, const char** element, size_t* elementlen);
+
+    // number of leading bytes that are no longer needed (the head up to and
+    // including the array's opening bracket and all returned elements) -
+    // the caller must drop exactly that many bytes before the next call
+    size_t release();
+
+    // the array was found / its closing bracket was reached
+    bool started;
+    bool finished;
+
+    // set by the consumer if an element could not be processed
+    bool failed;
+
+    // response up to the array's opening bracket, followed by the rest of
+    // the unreleased data this forms the response with an empty array
+    string head;
+
+    JSONSplitter();
+
+private:
+    int target;
+    int depth;
+    int element;
+    int arraydepth;
+    bool intarget;
+    bool instring;
+    bool escaped;
+    bool expectkey;
+    bool fkey;
+
+    size_t pos;
+    size_t keystart;
+    size_t elementstart;
+    size_t releasable;
+};
+
 } // namespace
 
 #endif
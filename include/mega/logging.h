@@ -119,7 +119,7 @@ class MEGA_API SimpleLogger {
     std::string t;
     std::string fname;
 
-    OutputStreams getOutput(enum LogLevel ll)
+    const OutputStreams& getOutput(enum LogLevel ll)
     {
         return outputs[ll];
     }
@@ -217,54 +217,66 @@ public:
 
 };
 
+// logs more verbose than MEGA_MAX_LOG_LEVEL are compiled out (configure
+// --with-max-log-level), the remaining ones are filtered at runtime
+#ifndef MEGA_MAX_LOG_LEVEL
+#define MEGA_MAX_LOG_LEVEL logMax
+#endif
+
+// true if logs of this level are compiled in and enabled - the arguments
+// of LOG_* statements are only evaluated in that case, use it to guard
+// expensive preparation that doesn't fit in the statement itself
+#define LOG_enabled(level) \
+    ((level) <= MEGA_MAX_LOG_LEVEL && SimpleLogger::logCurrentLevel >= (level))
+
 // output VERBOSE log with line break
 #define LOG_verbose \
-    if (SimpleLogger::logCurrentLevel < logMax) ;\
+    if (!LOG_enabled(logMax)) ;\
     else \
         SimpleLogger(logMax, __FILE__, __LINE__)
 
 // output VERBOSE log without line break
 #define LOGn_verbose \
-    if (SimpleLogger::logCurrentLevel < logMax) ;\
+    if (!LOG_enabled(logMax)) ;\
     else \
         SimpleLogger(logMax, __FILE__, __LINE__, false)
 
 // output DEBUG log with line break
 #define LOG_debug \
-    if (SimpleLogger::logCurrentLevel < logDebug) ;\
+    if (!LOG_enabled(logDebug)) ;\
     else \
         SimpleLogger(logDebug, __FILE__, __LINE__)
 
 // output DEBUG log without line break
 #define LOGn_debug \
-    if (SimpleLogger::logCurrentLevel < logDebug) ;\
+    if (!LOG_enabled(logDebug)) ;\
     else \
         SimpleLogger(logDebug, __FILE__, __LINE__, false)
 
 #define LOG_info \
-    if (SimpleLogger::logCurrentLevel < logInfo) ;\
+    if (!LOG_enabled(logInfo)) ;\
     else \
         SimpleLogger(logInfo, __FILE__, __LINE__)
 #define LOGn_info \
-    if (SimpleLogger::logCurrentLevel < logInfo) ;\
+    if (!LOG_enabled(logInfo)) ;\
     else \
         SimpleLogger(logInfo, __FILE__, __LINE__, false)
 
 #define LOG_warn \
-    if (SimpleLogger::logCurrentLevel < logWarning) ;\
+    if (!LOG_enabled(logWarning)) ;\
     else \
         SimpleLogger(logWarning, __FILE__, __LINE__)
 #define LOGn_warn \
-    if (SimpleLogger::logCurrentLevel < logWarning) ;\
+    if (!LOG_enabled(logWarning)) ;\
     else \
         SimpleLogger(logWarning, __FILE__, __LINE__, false)
 
 #define LOG_err \
-    if (SimpleLogger::logCurrentLevel < logError) ;\
+    if (!LOG_enabled(logError)) ;\
     else \
         SimpleLogger(logError, __FILE__, __LINE__)
 #define LOGn_err \
-    if (SimpleLogger::logCurrentLevel < logError) ;\
+    if (!LOG_enabled(logError)) ;\
     else \
         SimpleLogger(logError, __FILE__, __LINE__, false)
 
@@ -34,6 +34,10 @@ struct MEGA_API MegaApp
     // request response progress
     virtual void request_response_progress(m_off_t, m_off_t) { }
 
+    // the response to a command with the given tag is about to be processed,
+    // with the sending and response time of its API request (Metrics::now())
+    virtual void command_response(int, int64_t, int64_t) { }
+
     // login result
     virtual void login_result(error) { }
 
@@ -75,7 +79,8 @@ struct MEGA_API MegaApp
     // node deletion failed (not invoked unless error != API_OK)
     virtual void unlink_result(handle, error) { }
 
-    // nodes have been updated
+    // nodes have been updated (a removed node stands for its whole subtree,
+    // which is freed with it after this call)
     virtual void nodes_updated(Node**, int) { }
 
     // nodes have been updated
@@ -96,6 +101,10 @@ struct MEGA_API MegaApp
     // node fetch result
     virtual void fetchnodes_result(error) { }
 
+    // the root nodes of a streamed node fetch are available, the rest of
+    // the tree is still arriving
+    virtual void fetchnodes_partial() { }
+
     // nodes now (nearly) current
     virtual void nodes_current() { }
 
@@ -194,6 +203,10 @@ struct MEGA_API MegaApp
     virtual void syncupdate_remote_rename(Sync*, Node*, const char*) { }
     virtual void syncupdate_treestate(LocalNode*) { }
 
+    // the local path of the node (and of its subtree, if set) is about to
+    // change or go away
+    virtual void syncupdate_local_unlink(LocalNode*, bool) { }
+
     // sync filename filter
     virtual bool sync_syncable(Node*)
     {
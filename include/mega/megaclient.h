@@ -34,9 +34,48 @@
 #include "http.h"
 #include "pubkeyaction.h"
 #include "pendingcontactrequest.h"
+#include "nodemap.h"
+#include "user.h"
 
 namespace mega {
 
+// a tree of new nodes too large for one putnodes command, created in slices
+// of at most MegaClient::MAX_NEWNODES nodes with one root each - all slices
+// whose parent exists are sent together, and slices are retried on their
+// own after transient errors
+struct MEGA_API PutNodesTree
+{
+    struct Slice
+    {
+        // indexes into nn, parents before children (the first is the root)
+        vector<int> nodes;
+
+        // index of the root's parent in nn (-1: the target)
+        int parent;
+
+        int retries;
+        bool sent;
+    };
+
+    handle target;
+    NewNode* nn;
+    int numnodes;
+    int tag;
+
+    vector<Slice> slices;
+
+    // handle of the created node for each of nn (UNDEF until created)
+    vector<handle> created;
+
+    int inflight;
+
+    // first permanent error
+    error e;
+
+    // split the nodes (parents must precede their children)
+    PutNodesTree(handle, NewNode*, int, int, int);
+};
+
 class MEGA_API MegaClient
 {
 public:
@@ -49,6 +88,12 @@ public:
     // all nodes
     node_map nodes;
 
+    // storage for all Node objects, released by purgenodesusersabortsc()
+    SlabAllocator nodeslab;
+
+    // Nodes allocated per slab chunk
+    static const size_t NODESLABCHUNK = 4096;
+
     // all users
     user_map users;
 
@@ -58,6 +103,9 @@ public:
     // wait for I/O or other events
     int wait();
 
+    // time the application layer needs exec() to run at (NEVER if none)
+    dstime appwakeup;
+
     // abort exponential backoff
     bool abortbackoff(bool = true);
 
@@ -67,6 +115,11 @@ public:
     // corresponding ID tag of the currently executing callback
     int restag;
 
+    // sending and response time of the API request whose results are being
+    // processed (Metrics::now(), 0 outside of result processing)
+    int64_t ressent;
+    int64_t resreceived;
+
     // ephemeral session support
     void createephemeral();
     void resumeephemeral(handle, const byte*, int = 0);
@@ -134,6 +187,18 @@ public:
     // retrieve user details
     void getaccountdetails(AccountDetails*, bool, bool, bool, bool, bool, bool);
 
+    // quota details (storage, transfer, pro) of the last getaccountdetails()
+    // are served locally for accountcachettl deciseconds (0: always fetched),
+    // with the storage figures kept current from the local tree
+    dstime accountcachettl;
+    AccountDetails accountcache;
+    int accountcacheparts;
+    dstime accountcachetime;
+    m_off_t accountcachelocal;
+    void cacheaccountdetails(AccountDetails*, bool, bool, bool);
+    void invalidateaccountdetails();
+    m_off_t localstorage();
+
     // update node attributes
     error setattr(Node*, const char** = NULL, const char* prevattr = NULL);
 
@@ -163,6 +228,20 @@ public:
     void preadabort(Node*, m_off_t = -1, m_off_t = -1);
     void preadabort(handle, m_off_t = -1, m_off_t = -1);
 
+    // fetch a range into the direct read block cache (if enabled) and get the
+    // temporary URL ready, at most half the cache size - idle prefetches only
+    // run while no app read is waiting
+    void prefetch(Node*, m_off_t, m_off_t, bool idle);
+    void prefetch(handle, SymmCipher* key, int64_t, m_off_t, m_off_t, bool idle);
+    void prefetchabort(Node*);
+    void prefetchabort(handle);
+
+    // keep the direct read state of a node (and its temporary URL) around
+    // between reads, e.g. for an open file handle
+    void preadopen(Node*);
+    void preadopen(handle, SymmCipher* key, int64_t);
+    void preadclose(handle, bool privatenode);
+
     // pause flags
     bool xferpaused[2];
 
@@ -179,9 +258,136 @@ public:
     // (give the user ample warning about possible sync repercussions)
     bool followsymlinks;
 
+    // if set, node keys and attributes received by fetchnodes are only
+    // decrypted on first access (display name, lookups by name or
+    // fingerprint, syncs, cache writes)
+    bool lazydecrypt;
+
+    // decrypt deferred nodes below (and including) the node, or all if NULL
+    void decryptnodes(Node* = NULL);
+
+    // decrypt deferred children of the node
+    void decryptchildren(Node*);
+
+    // if set (before fetchnodes), at most nodecachelimit file nodes are kept
+    // in memory with an indexed statecache - the others are loaded on access
+    // by handle, parent or fingerprint (folders and file nodes that are
+    // synced, shared, being read or have pending changes stay resident)
+    bool pagednodes;
+    unsigned nodecachelimit;
+
+    static const unsigned NODECACHELIMIT = 100000;
+
+    // paged mode: reload the evicted children of a folder or of a subtree
+    void loadchildren(Node*);
+    void loadtree(Node*);
+
+    // if set, all nodes are written to a snapshot file next to the
+    // statecache when the client is destroyed while the nodes match the
+    // committed statecache - the next fetchsc() reads them from there in
+    // one go instead of record by record (the snapshot is consumed)
+    bool snapshotnodes;
+
+    // heap memory used by the nodes (walks all nodes)
+    void nodememoryusage(NodeMemoryUsage*);
+
+    // release memory on pressure from the OS, returns the bytes freed:
+    // TRIM_CACHES drops what is rebuilt on demand (sorted views and name
+    // indexes of children, RSA-decrypted keys, idle chunk buffers),
+    // TRIM_ALL also the direct read block cache and, in paged mode, all
+    // evictable file nodes
+    enum { TRIM_CACHES = 1, TRIM_ALL = 2 };
+    m_off_t trimmemory(int);
+
+    // if set, node keys and attributes are decrypted in parallel batches
+    // when applykeys() has at least MINPARALLELKEYS nodes to process, or
+    // MINPARALLELRSAKEYS RSA-encrypted node keys (one per job)
+    ParallelRunner* workers;
+    static const unsigned MINPARALLELKEYS = 4096;
+    static const unsigned PARALLELKEYBATCH = 512;
+    static const unsigned MINPARALLELRSAKEYS = 4;
+
+    // RSA-decrypted node and share keys by their encrypted form (emptied
+    // when MAXRSAKEYS is reached)
+    map<string, string> rsakeys;
+    static const unsigned MAXRSAKEYS = 4096;
+
+    // key resolution statistics: RSA decryptions (and how many of them ran
+    // on the workers), RSA decryptions saved by rsakeys, processor time
+    // spent in applykeys() in microseconds
+    uint64_t rsadecrypts;
+    uint64_t rsaparallel;
+    uint64_t rsacachehits;
+    uint64_t keytime;
+
+    // expanded key schedules of the MAXNODECIPHERS most recently used node
+    // keys (Node::nodecipher()), each revalidated against the current key
+    struct NodeCipher
+    {
+        handle h;
+        string key;
+        SymmCipher cipher;
+        uint64_t lastuse;
+    };
+
+    static const unsigned MAXNODECIPHERS = 64;
+    NodeCipher nodeciphers[MAXNODECIPHERS];
+    map<handle, unsigned> nodecipherslots;
+    uint64_t nodecipheruse;
+
+    // cached (or freshly expanded) cipher for the node's key, or NULL if
+    // the key is invalid
+    SymmCipher* getnodecipher(Node*);
+    void clearnodeciphers();
+
+    // if set, the chunks of a transfer that are ready in the same doio()
+    // pass are encrypted/decrypted and MACed in parallel
+    ParallelRunner* cryptoworkers;
+
+    // if set, syncs open, fingerprint and list the queued items of a scan
+    // on these workers in batches (see Sync::prefetchscan())
+    ParallelRunner* scanworkers;
+
+    // if set, background tasks of the client run on this pool, and the
+    // worker runners above can be backed by it
+    ThreadPool* threadpool;
+
+    // recycled chunk buffers of all transfers
+    ChunkBufferPool chunkbuffers;
+
     // number of parallel connections per transfer (PUT/GET)
     unsigned char connections[2];
 
+    // range the connections of large transfers are adapted in (PUT/GET),
+    // fixed at connections[] by default
+    unsigned char minconnections[2];
+    unsigned char maxconnections[2];
+
+    // queued upload nodes by target folder, with their transfer tags, the
+    // time the oldest was queued and their number
+    map<handle, vector<pair<NewNode*, int> > > uploadnodes;
+    dstime uploadnodesds;
+    int numuploadnodes;
+
+    // dispatch limits per direction (PUT/GET), 0 for the defaults:
+    // - concurrent transfers (default: MAXTRANSFERS shared by both directions)
+    // - bytes in flight: more transfers are started while the active ones
+    //   have less than this, or less than two seconds at their measured
+    //   speed, left (default: the MINPIPELINE heuristic of moretransfers())
+    // - total connections of the active transfers (default: unlimited)
+    unsigned maxtransfers[2];
+    m_off_t maxinflight[2];
+    unsigned maxxferconnections[2];
+
+    // cap on the bytes of out-of-order download chunks buffered per transfer
+    // to write them sequentially (0: write chunks as they complete) - also
+    // enables the preallocation of download temp files
+    m_off_t writebackmax;
+
+    // last mtime handed out to keep a download to a sink unique (see
+    // startxfer())
+    m_time_t sinkmtime;
+
     // generate & return next upload handle
     handle uploadhandle(int);
 
@@ -192,15 +398,34 @@ public:
     // send files/folders to user
     void putnodes(const char*, NewNode*, int);
 
+    // add a tree of nodes of any size to the specified parent node, with
+    // one putnodes_result() for the whole tree
+    void putnodestree(handle, NewNode*, int);
+
+    // slices of a tree pending at the same time / attempts after transient
+    // errors
+    static const int MAXTREESLICES = 4;
+    static const int MAXSLICERETRIES = 3;
+
+    // trees being created
+    set<PutNodesTree*> putnodestrees;
+
+    void putnodestree_result(PutNodesTree*, int, NewNode*, error);
+
     // attach file attribute to upload or node handle
     void putfa(handle, fatype, SymmCipher*, string*);
 
-    // queue file attribute retrieval
-    error getfa(Node*, fatype, int = 0);
+    // queue file attribute retrieval (background fetches queue behind all
+    // others)
+    error getfa(Node*, fatype, int = 0, bool = false);
     
     // notify delayed upload completion subsystem about new file attribute
     void checkfacompletion(handle, Transfer* = NULL);
 
+    // file attributes announced for an upload (Transfer::minfa) that could
+    // not be generated after all
+    void dropfa(handle, int);
+
     // attach/update/delete a user attribute
     void putua(const char* an, const byte* av = NULL, unsigned avl = 0);
 
@@ -320,6 +545,12 @@ private:
     HttpReq* pendingsc;
     BackoffTimer btsc;
 
+    // the following server-client request, issued with the scsn found at
+    // the end of pendingsc's response while that is being processed
+    HttpReq* nextsc;
+    string nextscsn;
+    void prefetchsc();
+
     // badhost report
     HttpReq* badhostcs;
     HttpReq* loadbalancingcs;
@@ -330,6 +561,28 @@ private:
     // unique request ID
     char reqid[10];
 
+    // independent commands sent on a parallel request while pendingcs is in
+    // flight, so that they don't wait for a slow one (e.g. fetchnodes)
+    Request fastreq;
+    HttpReq* pendingfastcs;
+    BackoffTimer btfastcs;
+    char fastreqid[10];
+
+    // sending time of pendingcs / pendingfastcs and arrival time of the
+    // server-client packets being processed (Metrics::now())
+    int64_t csstarted;
+    int64_t fastcsstarted;
+    int64_t scarrived;
+
+    void execfastcs();
+
+    void procnodestream();
+    bool nodestreamroots();
+
+    // sc response completed: decide on catch-up mode
+    bool catchup();
+    void cachenodestream(node_vector*);
+
     // auth URI component for API requests
     string auth;
 
@@ -353,14 +606,14 @@ private:
     // determine if more transfers fit in the pipeline
     bool moretransfers(direction_t);
 
-    // update time at which next deferred transfer retry kicks in
-    void nexttransferretry(direction_t d, dstime*);
-
     // a TransferSlot chunk failed
     bool chunkfailed;
 
     // open/create state cache database table
     void opensctable();
+
+    // open/create the transfer cache table and restore its partial downloads
+    void opentctable();
     
     // fetch state serialize from local cache
     bool fetchsc(DbTable*);
@@ -403,10 +656,6 @@ private:
     // was the app notified of a retrying CS request?
     bool csretrying;
 
-    // encode/query handle type
-    void encodehandletype(handle*, bool);
-    bool isprivatehandle(handle*);
-    
     // add direct read
     void queueread(handle, bool, SymmCipher*, int64_t, m_off_t, m_off_t, void*);
     
@@ -419,12 +668,25 @@ private:
     // abort queued direct read(s)
     void abortreads(handle, bool, m_off_t, m_off_t);
 
+    // pin the direct read node of a handle
+    void openreads(handle, bool, SymmCipher*, int64_t);
+
+    void queueprefetch(handle, bool, SymmCipher*, int64_t, m_off_t, m_off_t, bool);
+    void abortprefetches(handle, bool);
+
+    // maximum number of slots for idle prefetches
+    static const int MAXIDLEPREFETCHSLOTS = 2;
+
     static const char PAYMENT_PUBKEY[];
 
 public:
     // application callbacks
     struct MegaApp* app;
 
+    // retry deadlines of the transfers and their slots, which wait()
+    // doesn't need to scan
+    BackoffTimerQueue transfertimers;
+
     // event waiter
     Waiter* waiter;
 
@@ -446,22 +708,105 @@ public:
     // scsn as read from sctable
     handle cachedscsn;
 
+    // transfer cache table for logged in user (state of partial downloads)
+    DbTable* tctable;
+
+    // persist/forget the state of a transfer
+    void cachetransfer(Transfer*);
+    void uncachetransfer(Transfer*);
+
+    // forget all persisted transfer state (upon logout)
+    void purgetransfercache();
+
+    // records of queued, not yet started transfers, opaque to the client
+    // (kept by the application layer) - ids are reserved up front, so that
+    // writes and deletes can be batched in a single transaction (0 if
+    // there is no transfer cache)
+    uint32_t reservequeuedtransfer();
+    void cachequeuedtransfers(map<uint32_t, string>*, vector<uint32_t>*);
+
+    // name of the session's state cache table (as used by opensctable()),
+    // false if there is no full session
+    bool sctablename(string*);
+
+    // if set (before login), a session with a cached state resumes from
+    // the statecache without contacting the API, and fetchnodes loads the
+    // cached tree right away - the session is verified, and the tree
+    // caught up, as soon as the API is reachable
+    bool offlinestart;
+
+    // master key, session key, own handle and private key of the session,
+    // kept in the statecache under a key derived from the session ID (if
+    // offlinestart is set)
+    void cachesession();
+    bool restoresession();
+    void sessioncipher(SymmCipher*);
+
     // have we just completed fetching new nodes?
     bool statecurrent;
 
     // pending file attribute writes
     putfa_list newfa;
 
-    // current attribute being sent
-    putfa_list::iterator curfa;
+    // attributes being sent (up to MAXACTIVEFA - their upload URLs are
+    // requested in the same API request)
+    putfa_list activefa;
+    static const unsigned MAXACTIVEFA = 8;
+
+    // send queued file attributes, up to MAXACTIVEFA
+    void sendfa();
 
     // API request queue double buffering:
     // reqs[r] is open for adding commands
     // reqs[r^1] is being processed on the API server
     HttpReq* pendingcs;
 
+    // after a login, the next API request is held until then (0: not held)
+    // so that the commands the app issues in response (fetchnodes, user
+    // attributes...) share it
+    dstime csbatchuntil;
+    static const dstime STARTUPBATCHDS = 2;
+
+    // batched network mode: non-urgent requests (deferrable commands,
+    // background file attribute fetches) wait for other traffic to wake up
+    // the radio, for at most deferlimit (0: disabled)
+    dstime deferlimit;
+
+    // since when non-urgent requests are held back (0: none)
+    dstime deferredsince;
+
+    // end of the window opened by the latency limit
+    dstime txwindowuntil;
+
+    // the radio stays in its high-power state for a while after traffic
+    static const dstime RADIOTAILDS = 50;
+
+    // can non-urgent requests be sent now?
+    bool txwindow();
+
+    // requests to the storage servers used most recently, sent along with
+    // fetchnodes only to have DNS, TCP and TLS ready for the first transfers
+    list<HttpReq*> warmupreqs;
+    static const unsigned WARMUPHOSTS = 4;
+    void warmup();
+
+    // incremental processing of the nodes of a fetchnodes response while
+    // it is being received (started: the old tree has been purged)
+    JSONSplitter nodestream;
+
+    // fetchnodes_partial() was sent for the current stream
+    bool nodestreampartial;
+
+    // paged folder link: file nodes are evicted while the stream is still
+    // being received, so that the tree never has to fit in memory
+    bool nodestreampaging;
+
+    // nodes read (and decrypted and written to the statecache) per batch
+    // of a streamed fetchnodes response
+    static const unsigned NODESTREAMBATCH = 2048;
+
     // record type indicator for sctable
-    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR } sctablerectype;
+    enum { CACHEDSCSN, CACHEDNODE, CACHEDUSER, CACHEDLOCALNODE, CACHEDPCR, CACHEDTRANSFER, CACHEDFINGERPRINT, CACHEDQUEUEDTRANSFER, CACHEDSESSION } sctablerectype;
 
     // initialize/update state cache referenced sctable
     void initsc();
@@ -475,6 +820,20 @@ public:
     JSON jsonsc;
     bool insca;
 
+    // the current sc response: packets read so far, "w" element seen (no
+    // further updates are queued on the server)
+    unsigned scpackets;
+    bool scwaitseen;
+
+    // catch-up mode: while a backlog of at least CATCHUPPACKETS packets per
+    // response is replayed, notifypurge() accumulates the notifications of
+    // consecutive responses (up to CATCHUPMAXNOTIFY nodes), so that
+    // repeatedly updated nodes are notified and written once, in a single
+    // statecache transaction and app callback
+    bool catchingup;
+    static const unsigned CATCHUPPACKETS = 500;
+    static const unsigned CATCHUPMAXNOTIFY = 50000;
+
     // no two interrelated client instances should ever have the same sessionid
     char sessionid[10];
 
@@ -506,6 +865,10 @@ public:
     // file attribute fetch channels
     fafc_map fafcs;
 
+    // if set, fetched file attributes are kept here and getfa() serves
+    // them from it without network activity (owned by the client)
+    FileAttributeCache* facache;
+
     // generate attribute string based on the pending attributes for this upload
     void pendingattrstring(handle, string*);
 
@@ -515,13 +878,74 @@ public:
     dr_list drq;
     drs_list drss;
 
+    // decrypted direct read data and read-ahead state
+    DirectReadCache drcache;
+
+    // temporary download URLs
+    TempUrlCache tempurls;
+
+    // request the missing temporary URLs of the given files in one batch
+    void prefetchtempurls(handle_vector*);
+
+    // encode/query handle type
+    void encodehandletype(handle*, bool);
+    bool isprivatehandle(handle*);
+
+    // parallel connections per direct read (1: one request for the range)
+    unsigned drconnections;
+
     // merge newly received share into nodes
     void mergenewshares(bool);
     void mergenewshare(NewShare *s, bool notify);    // merge only the given share
 
+    // nodes with outgoing, pending outgoing and incoming shares - updated by
+    // mergenewshare() and on node deletion
+    handle_set outsharenodes;
+    handle_set pendingsharenodes;
+    handle_set insharenodes;
+    void indexshares(Node*);
+
+    // node keys of new shares of large trees: the share is created with the
+    // key of its root only, the keys of the other nodes follow in slices of
+    // SHAREKEYSLICE nodes, one "k" command at a time
+    struct ShareKeyUpload
+    {
+        handle sh;
+
+        // nodes still to visit (depth-first)
+        handle_vector pending;
+    };
+
+    list<ShareKeyUpload> sharekeyuploads;
+    bool sharekeyinflight;
+    static const unsigned SHAREKEYSLICE = 10000;
+    void queuesharekeys(handle);
+    void execsharekeys();
+
     // transfer queues (PUT/GET)
     transfer_map transfers[2];
 
+    // partial downloads restored from tctable, resumed by the first matching
+    // startxfer()
+    transfer_map cachedtransfers[2];
+
+    // queued transfer records restored from tctable, by id - taken over by
+    // the application layer
+    map<uint32_t, string> queuedtransfers;
+
+    // dispatch order of the queued transfers (PUT/GET) by priority class
+    static const int NUMPRIORITIES = 3;
+    transfer_list transferqueue[2][NUMPRIORITIES];
+
+    // (re)queue a transfer at the back or the front of a priority class
+    void queuetransfer(Transfer*, transferpriority_t, bool = false);
+
+    // move a transfer in front of another one of the same direction (and
+    // into its priority class)
+    void movetransferbefore(Transfer*, Transfer*);
+
+    void unqueuetransfer(Transfer*);
+
     // transfer tslots
     transferslot_list tslots;
 
@@ -535,6 +959,10 @@ public:
     handle_vector nodekeyrewrite;
     handle_vector sharekeyrewrite;
 
+    // RSA-decrypted key from rsakeys
+    bool cachedrsakey(const string*, byte*, int);
+    void cachersakey(const string*, const byte*, int);
+
     static const char* const EXPORTEDLINK;
 
     // minimum number of bytes in transit for upload/download pipelining
@@ -542,6 +970,9 @@ public:
 
     // initial state load in progress?
     bool fetchingnodes;
+
+    // nodes with deferred decryption are present
+    bool nodesdeferred;
     int fetchnodestag;
 
     // server-client request sequence number
@@ -562,16 +993,59 @@ public:
     node_vector nodenotify;
     void notifynode(Node*);
 
+    // previous state of the nodes changed since the last notification -
+    // must be recorded before the change (prevname overrides the name)
+    map<handle, NodeDelta> nodedeltas;
+    void recordnodedelta(Node*, const char* prevname = NULL);
+
+    // descendants of removed subtrees: dropped from the DB cache and freed
+    // with their root, but not notified individually
+    node_vector nodepurge;
+
     // write changed/added/deleted users to the DB cache and notify the
     // application
     void notifypurge();
 
-    // remove node subtree
-    void deltree(handle);
+    // remove node subtree (iteratively) - only its root is notified
+    void deltree(Node*, bool skipinshares = false);
 
     Node* nodebyhandle(handle);
     Node* nodebyfingerprint(FileFingerprint*);
 
+#ifdef ENABLE_SYNC
+    // unchanged synced local file with the content of the node, or NULL
+    LocalNode* localnodebyfingerprint(Node*);
+#endif
+
+    // resident file nodes, least recently used first (paged mode)
+    node_lru pagedlru;
+
+    // all nodes are in the statecache, evicted nodes can be loaded
+    bool nodepaging;
+
+    // the nodes have not changed since the last statecache commit
+    bool sccommitted;
+
+    // snapshot file: header, then the AES-CTR encrypted records (dbid,
+    // length and Node::serialize() form of each node) - the scsn in the
+    // header must match the statecache's
+    static const char SNAPSHOTMAGIC[];
+    static const unsigned SNAPSHOTHEADER = 48;
+    static const unsigned SNAPSHOTCHUNK = 1048576;
+
+    void writesnapshot();
+    bool readsnapshot(node_vector*);
+    void snapshotcrypt(string*, handle, byte*, bool);
+
+    // load a node record (or return the resident node)
+    Node* loadnode(uint32_t);
+
+    // load the records matching a statecache lookup column
+    void loadnodes(int, const string*);
+
+    // evict least recently used file nodes down to nodecachelimit
+    void trimnodes();
+
     // generate & return upload handle
     handle getuploadhandle();
 
@@ -669,8 +1143,8 @@ public:
     // update paths of all PUT transfers
     void updateputs();
 
-    // determine if all transfer slots are full
-    bool slotavail() const;
+    // determine if all transfer slots of the direction are full
+    bool slotavail(direction_t) const;
 
     // dispatch as many queued transfers as possible
     void dispatchmore(direction_t);
@@ -692,12 +1166,33 @@ public:
     // transfer chunk failed
     void setchunkfailed(string*);
     string badhosts;
+
+    // storage server network quality, fed by the transfer slots
+    HostStats hoststats;
+
+    // runtime metrics (see Metrics::metric_t)
+    Metrics metrics;
+
+    // refresh the gauges and export the metrics in the Prometheus text format
+    void getmetrics(string*);
+
+    // commit the local cache, timed for the metrics
+    void sccommit();
+
+    // spans of the client loop (see TraceSpan), with the stall watchdog
+    // enabled by default at STALLTHRESHOLD ms
+    Tracer tracer;
+    static const int STALLTHRESHOLD = 2000;
+
+    // httpio->doio(), traced
+    bool doio();
     
     // queue for load balancing requests
     std::queue<CommandLoadBalancing*> loadbalancingreqs;
 
     // process object arrays by the API server
-    int readnodes(JSON*, int, putsource_t = PUTNODES_APP, NewNode* = NULL, int = 0, int = 0);
+    // (newly created nodes are appended to the vector, if given)
+    int readnodes(JSON*, int, putsource_t = PUTNODES_APP, NewNode* = NULL, int = 0, int = 0, node_vector* = NULL);
 
     void readok(JSON*);
     void readokelement(JSON*);
@@ -738,6 +1233,21 @@ public:
     // max new nodes per request
     static const int MAX_NEWNODES = 2000;
 
+    // if set, the nodes of completed uploads are added with one putnodes
+    // call per target folder for all uploads completing within
+    // UPLOADBATCHDS (or until no more uploads are active)
+    bool batchuploadnodes;
+    static const dstime UPLOADBATCHDS = 5;
+
+    // queue the new node of a completed upload (transfer tag) for a batch
+    void queueuploadnode(handle, NewNode*, int);
+
+    // send the queued upload nodes
+    void senduploadnodes();
+
+    // send the slices of the tree whose parent exists
+    void sendtreeslices(PutNodesTree*);
+
     // session ID length (binary)
     static const unsigned SIDLEN = 2 * SymmCipher::KEYLENGTH + USERHANDLE * 4 / 3 + 1;
 
@@ -762,6 +1272,10 @@ public:
     // apply keys
     int applykeys();
 
+    // apply pending node keys and decrypt attributes in batches (on the
+    // workers, if any) - of all nodes or of the given ones only
+    int applykeysparallel(node_vector* = NULL);
+
     // symmetric password challenge
     int checktsid(byte* sidbuf, unsigned len);
 
@@ -791,7 +1305,10 @@ public:
     void proctree(Node*, TreeProc*, bool skipinshares = false);
 
     // hash password
-    error pw_key(const char*, byte*) const;
+    static error pw_key(const char*, byte*);
+
+    // hash several passwords (keys: KEYLENGTH bytes each)
+    static void pw_keys(ParallelRunner*, unsigned, const char* const*, byte*, error*);
 
     // load balancing request
     void loadbalancing(const char *);
@@ -25,6 +25,7 @@
 #include "filefingerprint.h"
 #include "file.h"
 #include "attrmap.h"
+#include "nodemap.h"
 
 namespace mega {
 struct MEGA_API NodeCore
@@ -65,10 +66,14 @@ struct MEGA_API NewNode : public NodeCore
 
     bool added;
 
+    // handle of the created node (if added)
+    handle addedhandle;
+
     NewNode()
     {
         syncid = UNDEF;
         added = false;
+        addedhandle = UNDEF;
         source = NEW_NODE;
         uploadhandle = UNDEF;
         localnode = NULL;
@@ -92,6 +97,213 @@ struct MEGA_API PublicLink
     bool isExpired();
 };
 
+// a folder's children: vector storage with O(1) removal (the last child is
+// moved into the vacated position), a lazily built name index for large
+// folders and sorted views built on demand
+class MEGA_API NodeChildren
+{
+    node_vector nodes;
+
+    // children by type (folders include anything that isn't a file)
+    size_t numfiles;
+    size_t numfolders;
+
+    // sorted copies of the children by caller-defined order id - present
+    // views are never modified, only discarded as a whole
+    typedef map<int, node_vector> view_map;
+    view_map* views;
+
+    void dropviews();
+
+    // open-addressing name index: (name hash, child), NULL child = empty slot
+    typedef pair<uint32_t, Node*> nameslot;
+    vector<nameslot> index;
+
+    // index size is a power of two, empty if not built
+    bool indexed() const { return !index.empty(); }
+
+    void buildindex();
+    void indexadd(Node*, uint32_t);
+    void indexremove(Node*);
+
+    // indexed name of a child, or NULL if undecrypted or unnamed
+    static const string* childname(const Node*);
+
+public:
+    // folders below this size are searched linearly
+    static const size_t MININDEXED = 32;
+
+    // FNV-1a (also used by LocalNodeChildren)
+    static uint32_t namehash(const char*, size_t);
+
+    typedef node_vector::iterator iterator;
+    typedef node_vector::const_iterator const_iterator;
+
+    iterator begin() { return nodes.begin(); }
+    iterator end() { return nodes.end(); }
+    const_iterator begin() const { return nodes.begin(); }
+    const_iterator end() const { return nodes.end(); }
+
+    size_t size() const { return nodes.size(); }
+    bool empty() const { return nodes.empty(); }
+
+    size_t files() const { return numfiles; }
+    size_t folders() const { return numfolders; }
+
+    Node* operator[](size_t i) const { return nodes[i]; }
+
+    // append child / remove child in O(1) (does not preserve order)
+    void add(Node*);
+    void remove(Node*);
+
+    // first child with the given (normalized) display name or NULL
+    Node* childbyname(const char*);
+
+    // strict weak ordering of children (must be total for sorted views to
+    // be deterministic)
+    typedef bool (*comparator)(Node*, Node*);
+
+    // children sorted by comp, cached under the order id until the children
+    // or their attributes change
+    const node_vector* sorted(int order, comparator comp);
+
+    // the attributes of a child changed - discard the name index and the
+    // sorted views
+    void invalidate();
+
+    // heap memory used by the child vector, the name index and the sorted
+    // views in bytes
+    size_t allocated() const;
+
+    NodeChildren();
+    ~NodeChildren();
+
+private:
+    NodeChildren(const NodeChildren&);
+    NodeChildren& operator=(const NodeChildren&);
+};
+
+#ifdef ENABLE_SYNC
+// a LocalNode's children by local name: ordered for the reconciliation
+// passes, with a hash index over the same entries for lookups by name
+class MEGA_API LocalNodeChildren
+{
+    localnode_map nodes;
+
+    // open-addressing name index: (cached name hash, entry), nodes.end() =
+    // empty slot - map iterators stay valid while other entries come and go
+    typedef pair<uint32_t, localnode_map::iterator> nameslot;
+    vector<nameslot> index;
+
+    // occupied slots
+    size_t indexcount;
+
+    bool indexed() const { return !index.empty(); }
+
+    void buildindex();
+    void indexadd(localnode_map::iterator, uint32_t);
+    void indexremove(localnode_map::iterator, uint32_t);
+    size_t indexfind(const string*, uint32_t) const;
+
+public:
+    typedef localnode_map::iterator iterator;
+    typedef localnode_map::const_iterator const_iterator;
+
+    iterator begin() { return nodes.begin(); }
+    iterator end() { return nodes.end(); }
+    const_iterator begin() const { return nodes.begin(); }
+    const_iterator end() const { return nodes.end(); }
+
+    size_t size() const { return nodes.size(); }
+    bool empty() const { return nodes.empty(); }
+
+    // child by exact local name or end()
+    iterator find(const string*);
+
+    // link/unlink a child under the given name (must point to the child's
+    // own name string, which must not change while linked)
+    void set(const string*, LocalNode*);
+    void erase(const string*);
+
+    LocalNodeChildren();
+
+private:
+    LocalNodeChildren(const LocalNodeChildren&);
+    LocalNodeChildren& operator=(const LocalNodeChildren&);
+};
+#endif
+
+// share and public link state - only allocated for the few nodes that are
+// (or were) shared or exported
+struct MEGA_API NodeSharing
+{
+    // inbound share
+    Share* inshare;
+
+    // outbound shares by user
+    share_map *outshares;
+
+    // outbound pending shares
+    share_map *pendingshares;
+
+    // incoming/outgoing share key
+    SymmCipher* sharekey;
+
+    // handle of public link for the node
+    PublicLink *plink;
+
+    NodeSharing();
+    ~NodeSharing();
+};
+
+// storage and node counts of a subtree (including its root)
+struct MEGA_API NodeCounter
+{
+    m_off_t storage;
+    uint32_t files;
+    uint32_t folders;
+
+    void operator+=(const NodeCounter&);
+    void operator-=(const NodeCounter&);
+
+    NodeCounter();
+};
+
+// state of a node before its first change since the last notification
+struct MEGA_API NodeDelta
+{
+    handle parenthandle;
+    string name;
+    m_off_t storage;
+};
+
+// heap memory used by the client's nodes in bytes, by category
+struct MEGA_API NodeMemoryUsage
+{
+    // Node objects (slab chunks)
+    size_t nodes;
+
+    // handle and fingerprint indexes
+    size_t nodeindex;
+    size_t fingerprints;
+
+    // attribute maps and values
+    size_t attrs;
+
+    // node keys, pending encrypted attributes and file attribute strings
+    size_t strings;
+
+    // child vectors and name indexes
+    size_t children;
+
+    // share and public link state
+    size_t sharing;
+
+    size_t total() const;
+
+    NodeMemoryUsage();
+};
+
 // filesystem node
 struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
 {
@@ -106,12 +318,22 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     // try to resolve node key string
     bool applykey();
 
+    // encrypted key usable by this client and its unwrapping cipher
+    const char* findkey(SymmCipher**);
+
     // set up nodekey in a static SymmCipher
     SymmCipher* nodecipher();
 
     // decrypt attribute string and set fileattrs
     void setattr();
 
+    // set attributes from the decrypted attribute string
+    void setattr(byte*);
+
+    // resolve the key and decrypt the attributes if still pending, returns
+    // whether the node is decrypted
+    bool decrypt();
+
     // display name (UTF-8)
     const char* displayname() const;
 
@@ -133,17 +355,37 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     // decrypt node attribute string
     static byte* decryptattr(SymmCipher*, const char*, int);
 
+    // the same into a buffer of at least attrstrlen * 3 / 4 + 3 bytes
+    static bool decryptattr(SymmCipher*, const char*, int, byte*);
+
+    // attribute strings up to this size are decrypted on the stack
+    static const int ATTRSTACKBUF = 512;
+
+    // decryptattr() for several nodes with their unwrapped node keys through
+    // the batched CBC decryption - the decrypted attribute strings (or NULL)
+    // are returned in the last parameter
+    static void decryptattrs(unsigned, Node* const*, const byte* const*, byte**);
+
+    // share and public link state or NULL
+    NodeSharing* sharing;
+
+    // sharing state, allocated on first use - only for setting members
+    NodeSharing* sharingstate();
+
     // inbound share
-    Share* inshare;
+    Share* inshare() const { return sharing ? sharing->inshare : NULL; }
 
     // outbound shares by user
-    share_map *outshares;
+    share_map* outshares() const { return sharing ? sharing->outshares : NULL; }
 
     // outbound pending shares
-    share_map *pendingshares;
+    share_map* pendingshares() const { return sharing ? sharing->pendingshares : NULL; }
 
     // incoming/outgoing share key
-    SymmCipher* sharekey;
+    SymmCipher* sharekey() const { return sharing ? sharing->sharekey : NULL; }
+
+    // handle of public link for the node
+    PublicLink* plink() const { return sharing ? sharing->plink : NULL; }
 
     // app-private pointer
     void* appdata;
@@ -162,7 +404,10 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
         bool pendingshares : 1;
         bool parent : 1;
     } changed;
-    
+
+    // source tag
+    int tag;
+
     void setkey(const byte* = NULL);
 
     void setfingerprint();
@@ -176,11 +421,22 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     node_list children;
 
     // own position in parent's children
-    node_list::iterator child_it;
+    size_t child_index;
+
+    // totals of this subtree, maintained incrementally as nodes are linked,
+    // moved and deleted
+    NodeCounter subtree;
 
     // own position in fingerprint set (only valid for file nodes)
     fingerprint_set::iterator fingerprint_it;
 
+    // own position in MegaClient::pagedlru (file nodes in paged mode)
+    node_lru::iterator paged_it;
+
+    // paged mode: children have been evicted and must be reloaded from the
+    // statecache, see MegaClient::loadchildren()
+    bool childrenpaged;
+
 #ifdef ENABLE_SYNC
     // related synced item or NULL
     LocalNode* localnode;
@@ -199,20 +455,54 @@ struct MEGA_API Node : public NodeCore, Cachable, FileFingerprint
     node_set::iterator tounlink_it;
 #endif
 
-    // source tag
-    int tag;
-
     // check if node is below this node
     bool isbelow(Node*) const;
 
-    // handle of public link for the node
-    PublicLink *plink;
-
+    // records are written in the compact format, legacy fixed-width records
+    // are still read (and rewritten by MegaClient::fetchsc())
     bool serialize(string*);
     static Node* unserialize(MegaClient*, string*, node_vector*);
 
+    // statecache lookup columns: handle, parent handle, type and (files
+    // only) fingerprint
+    bool dbcolumns(DbColumns*);
+
+    // true for records in the legacy fixed-width format
+    static bool legacyrecord(const string*);
+
+    // node handle of a record (either format) without unserializing it,
+    // UNDEF if malformed
+    static handle recordhandle(const string*);
+
+    // leading marker of compact records (never a valid legacy size/type)
+    static const m_off_t COMPACTRECORD = -0x101;
+
+    // presence bits of compact records
+    enum { COMPACT_PARENT = 1, COMPACT_OWNER = 2, COMPACT_FILEATTRS = 4, COMPACT_SHARES = 8,
+           COMPACT_INSHARE = 16, COMPACT_PLINK = 32, COMPACT_TAKENDOWN = 64 };
+
+    static Node* unserializecompact(MegaClient*, const char*, const char*, node_vector*);
+
+    // nodes are allocated from the owning client's node slab:
+    // new (client) Node(client, ...)
+    static void* operator new(size_t, MegaClient*);
+    static void* operator new(size_t);
+    static void operator delete(void*, MegaClient*);
+    static void operator delete(void*);
+
     Node(MegaClient*, vector<Node*>*, handle, handle, nodetype_t, m_off_t, handle, const char*, m_time_t);
     ~Node();
+
+private:
+    // precedes each Node in memory: the slab it was taken from (NULL: heap)
+    union AllocHeader
+    {
+        SlabAllocator* slab;
+        uint64_t align;
+    };
+
+public:
+    static const size_t ALLOCSIZE;
 };
 
 #ifdef ENABLE_SYNC
@@ -227,11 +517,11 @@ struct MEGA_API LocalNode : public File, Cachable
     int32_t parent_dbid;
 
     // children by name
-    localnode_map children;
+    LocalNodeChildren children;
 
     // for botched filesystems with legacy secondary ("short") names
     string slocalname;
-    localnode_map schildren;
+    LocalNodeChildren schildren;
 
     // local filesystem node ID (inode...) for rename/move detection
     handle fsid;
@@ -255,6 +545,11 @@ struct MEGA_API LocalNode : public File, Cachable
     // global sync reference
     handle syncid;
 
+    // CRC32 of the record last written to (or read from) the statecache,
+    // valid if dbid is set - unchanged records are not rewritten
+    uint32_t dbcrc;
+    bool cachechanged(const string*);
+
     struct
     {
         // was actively deleted
@@ -283,6 +578,14 @@ struct MEGA_API LocalNode : public File, Cachable
     dstime nagleds;
     void bumpnagleds();
 
+    // this node or one below it changed locally or remotely since the last
+    // syncdown()/syncup() pass - clean subtrees are not descended into
+    enum { DIRTY_SYNCDOWN = 1, DIRTY_SYNCUP = 2 };
+    unsigned char dirty;
+
+    // flag this node and all of its ancestors
+    void setdirty(int = DIRTY_SYNCDOWN | DIRTY_SYNCUP);
+
     // if delage > 0, own iterator inside MegaClient::localsyncnotseen
     localnode_set::iterator notseen_it;
 
@@ -300,6 +603,7 @@ struct MEGA_API LocalNode : public File, Cachable
 
     void prepare();
     void completed(Transfer*, LocalNode*);
+    void terminated();
 
     void setnode(Node*);
 
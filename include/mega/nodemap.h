@@ -0,0 +1,181 @@
+/**
+ * @file mega/nodemap.h
+ * @brief Hash indexes of nodes by node handle and by fingerprint
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_NODEMAP_H
+#define MEGA_NODEMAP_H 1
+
+#include "types.h"
+
+namespace mega {
+
+// open-addressing (linear probing) hash index of Node pointers keyed by the
+// 48-bit node handle - drop-in replacement for map<handle, Node*>
+// iteration order is unspecified; erasing an element does not invalidate
+// iterators to other elements, inserting may
+class MEGA_API NodeHandleMap
+{
+public:
+    typedef pair<handle, Node*> value_type;
+
+    class MEGA_API iterator
+    {
+        value_type* slot;
+        value_type* last;
+
+        void skip();
+
+        friend class NodeHandleMap;
+
+    public:
+        value_type& operator*() const { return *slot; }
+        value_type* operator->() const { return slot; }
+
+        iterator& operator++();
+        iterator operator++(int);
+
+        bool operator==(const iterator& it) const { return slot == it.slot; }
+        bool operator!=(const iterator& it) const { return slot != it.slot; }
+
+        iterator();
+        iterator(value_type*, value_type*);
+    };
+
+    iterator begin();
+    iterator end();
+
+    iterator find(handle);
+
+    // insert an empty slot for the handle if not present
+    Node*& operator[](handle);
+
+    // remove by handle, returns the number of removed elements (0 or 1)
+    size_t erase(handle);
+    void erase(iterator);
+
+    void clear();
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+    // preallocate for the given number of elements
+    void reserve(size_t);
+
+    // heap memory used by the index in bytes
+    size_t allocated() const;
+
+    NodeHandleMap();
+    ~NodeHandleMap();
+
+private:
+    // slot markers - real node handles never exceed 48 bits, and UNDEF
+    // (which callers look up) must not match either
+    static const handle EMPTYSLOT = ~(handle)0 << 48;
+    static const handle DELETEDSLOT = (~(handle)0 << 48) + 1;
+
+    // minimum table size (power of two)
+    static const size_t MINSLOTS = 64;
+
+    value_type* slots;
+
+    // mask of the power-of-two table size
+    size_t mask;
+
+    // occupied slots
+    size_t count;
+
+    // occupied plus deleted slots (probe chain length bound)
+    size_t used;
+
+    static size_t hash(handle);
+
+    // slot for the handle or NULL
+    value_type* lookup(handle) const;
+
+    void rehash(size_t);
+
+    NodeHandleMap(const NodeHandleMap&);
+    NodeHandleMap& operator=(const NodeHandleMap&);
+};
+
+// hash index of file nodes by fingerprint content (size and sparse CRC),
+// replacing the ordered multiset: lookups accept the mtime deviation
+// tolerated by operator==(FileFingerprint&, FileFingerprint&)
+// each indexed node's fingerprint_it tracks its slot and is updated when
+// entries move
+class MEGA_API FingerprintIndex
+{
+public:
+    struct iterator
+    {
+        size_t slot;
+
+        bool operator==(const iterator& it) const { return slot == it.slot; }
+        bool operator!=(const iterator& it) const { return slot != it.slot; }
+    };
+
+    iterator end() const;
+
+    iterator insert(FileFingerprint*);
+    void erase(iterator);
+    void clear();
+
+    size_t size() const { return count; }
+
+    // file node matching the fingerprint, preferring an identical mtime over
+    // a tolerated deviation, or NULL
+    Node* find(FileFingerprint*);
+
+    // all file nodes with the content of the fingerprint (size and CRC),
+    // regardless of mtime
+    void findall(FileFingerprint*, node_vector*);
+
+    // lookup statistics: lookups, successful lookups and the subset of those
+    // that only matched thanks to the mtime tolerance
+    uint64_t lookups;
+    uint64_t hits;
+    uint64_t tolerancehits;
+
+    // heap memory used by the index in bytes
+    size_t allocated() const;
+
+    FingerprintIndex();
+    ~FingerprintIndex();
+
+private:
+    static const size_t MINSLOTS = 64;
+
+    Node** slots;
+    size_t mask;
+    size_t count;
+
+    static size_t hash(const FileFingerprint*);
+
+    // place the node at the first free slot of its probe sequence
+    void place(Node*);
+
+    void rehash(size_t);
+
+    FingerprintIndex(const FingerprintIndex&);
+    FingerprintIndex& operator=(const FingerprintIndex&);
+};
+} // namespace
+
+#endif
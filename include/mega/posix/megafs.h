@@ -66,6 +66,21 @@ public:
     string lastname;
 #endif
 
+#ifdef USE_FANOTIFY
+    // filesystem-wide notification (Linux 5.9+, CAP_SYS_ADMIN): syncs
+    // whose filesystem could be marked need no per-directory watches
+    int fanotifyfd;
+
+    // a move source is not notified if followed by the move target
+    Sync* fanotifyfromsync;
+    string fanotifyfrom;
+
+    // path of the directory identified by an event's file handle,
+    // relative to the root of the fanotify sync it belongs to
+    Sync* fanotifypath(struct fanotify_event_info_fid*, string*);
+    void fanotifyflush(int*);
+#endif
+
     bool notifyerr;
 
     FileAccess* newfileaccess();
@@ -115,6 +130,7 @@ public:
     bool fread(string *, unsigned, unsigned, m_off_t);
     bool frawread(byte *, unsigned, m_off_t);
     bool fwrite(const byte *, unsigned, m_off_t);
+    bool preallocate(m_off_t);
 
     bool sysread(byte *, unsigned, m_off_t);
     bool sysstat(m_time_t*, m_off_t*);
@@ -130,6 +146,17 @@ class MEGA_API PosixDirNotify : public DirNotify
 public:
     PosixFileSystemAccess* fsaccess;
 
+#ifdef USE_FANOTIFY
+    // set if the filesystem is covered by fanotify: canonical root path,
+    // filesystem id and a descriptor for open_by_handle_at()
+    bool fanotify;
+    string realbasepath;
+    int32_t fsid[2];
+    int mountfd;
+
+    ~PosixDirNotify();
+#endif
+
     void addnotify(LocalNode*, string*);
     void delnotify(LocalNode*);
 
@@ -67,7 +67,15 @@ class CurlHttpIO: public HttpIO
 protected:
     string useragent;
     CURLM* curlm;
-    CURLSH* curlsh;
+
+    // TLS sessions and cURL's DNS cache are shared by all instances in the
+    // process (e.g. one MegaApi per account on a server), so that only the
+    // first of them pays the full handshake with each host - connections
+    // are not, libcurl does not support sharing them across threads
+    static CURLSH* curlsh;
+    static int curlshusers;
+    static void share_lock(CURL*, curl_lock_data, curl_lock_access, void*);
+    static void share_unlock(CURL*, curl_lock_data, void*);
     ares_channel ares;
     string proxyurl;
     string proxyscheme;
@@ -84,15 +92,23 @@ protected:
     std::queue<CurlHttpContext *> pendingrequests;
     std::map<string, CurlDNSEntry> dnscache;
 
+    // connections paused by the bandwidth shaper
+    std::set<CurlHttpContext*> shaperpaused;
+    void resumeshaped();
+
     void send_pending_requests();
     void drop_pending_requests();
 
     static size_t read_data(void*, size_t, size_t, void*);
+    static size_t read_shaped(void*, size_t, size_t, void*);
     static size_t write_data(void*, size_t, size_t, void*);
     static size_t check_header(void*, size_t, size_t, void*);
 
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+#ifndef WINDOWS_PHONE
     static int socket_callback(CURL *e, curl_socket_t s, int what, void *userp, void *socketp);
+#endif
+
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
     static int timer_callback(CURLM *multi, long timeout_ms, void *userp);
 #endif
 
@@ -109,9 +125,17 @@ protected:
     static bool crackurl(string*, string*, string*, int*);
     static int debug_callback(CURL*, curl_infotype, char*, size_t, void*);
     bool ipv6available();
+    bool resolveaddresses(CurlHttpContext*);
+    void racecompleted(CurlHttpContext*, CURL*, bool);
     void filterDNSservers();
 
     bool curlipv6;
+
+    // HTTP/2 requested by the app, supported by libcurl and currently
+    // configured on curlm
+    bool http2;
+    bool curlhttp2;
+    bool http2multiplex;
     bool reset;
     bool statechange;
     string dnsservers;
@@ -128,6 +152,17 @@ protected:
     m_time_t arestimeoutds;
 #endif
 
+#ifndef _WIN32
+    // with an epoll/kqueue waiter: curl sockets as reported by
+    // socket_callback(), those changed since the last addevents() and the
+    // c-ares sockets registered by the last addevents()
+    std::map<int, int> pollsockets;
+    std::set<int> pollchanged;
+    std::map<int, int> pollares;
+    void addpollevents();
+    void pollready(std::vector<std::pair<int, int> >*);
+#endif
+
 public:
     void post(HttpReq*, const char* = 0, unsigned = 0);
     void cancel(HttpReq*);
@@ -143,6 +178,7 @@ public:
     void setproxy(Proxy*);
     Proxy* getautoproxy();
     void setdnsservers(const char*);
+    bool sethttp2(bool);
     void disconnect();
 
     CurlHttpIO();
@@ -158,6 +194,11 @@ struct MEGA_API CurlHttpContext
 
     struct curl_slist *headers;
     bool isIPv6;
+
+    // CURLOPT_RESOLVE entries with the address(es) of the host, and the
+    // family cURL tries first when racing IPv6 and IPv4 (Happy Eyeballs)
+    struct curl_slist *resolve;
+    bool raceipv6first;
     string hostname;
     string scheme;
     int port;
@@ -167,6 +208,9 @@ struct MEGA_API CurlHttpContext
     unsigned len;
     const char* data;
     int ares_pending;
+
+    // shaped upload: bytes handed to cURL so far
+    unsigned sent;
 };
 
 struct MEGA_API CurlDNSEntry
@@ -177,6 +221,10 @@ struct MEGA_API CurlDNSEntry
     dstime ipv4timestamp;
     string ipv6;
     dstime ipv6timestamp;
+
+    // IPv4 won a connection race against IPv6 (or IPv6 failed) at this
+    // time: IPv4 goes first in races until IPV6_RETRY_INTERVAL_DS passes
+    dstime ipv6losttime;
 };
 
 } // namespace
@@ -102,6 +102,11 @@
     #include <sys/inotify.h>
 #endif
 
+#ifdef USE_FANOTIFY
+    #include <sys/fanotify.h>
+    #include <sys/statfs.h>
+#endif
+
 #include <sys/select.h>
 
 #include <curl/curl.h>
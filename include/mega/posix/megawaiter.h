@@ -28,6 +28,7 @@ namespace mega {
 struct PosixWaiter : public Waiter
 {
     PosixWaiter();
+    ~PosixWaiter();
 
     int maxfd;
     fd_set rfds, wfds, efds;
@@ -41,8 +42,63 @@ struct PosixWaiter : public Waiter
 
     void notify();
 
+    // readiness backends: select() over the fd_sets, or epoll (Linux) /
+    // kqueue (macOS, BSD) with persistent registrations made via watch()
+    // the fd_sets keep working with all of them (the poll backends mirror
+    // rfds/wfds into their registrations; efds is not supported there)
+    enum { BACKEND_SELECT, BACKEND_EPOLL, BACKEND_KQUEUE };
+
+    // backend of subsequently constructed waiters (select() is used if the
+    // requested one is not available on this platform)
+    static int defaultbackend;
+
+    // epoll or kqueue as available, else select()
+    static int nativebackend();
+
+    int backend;
+
+    // true if the backend honours watch()
+    bool persistent() const { return backend != BACKEND_SELECT; }
+
+    static const int WATCHREAD = 1;
+    static const int WATCHWRITE = 2;
+
+    // (re)register fd for the given WATCH* events until changed, 0 removes it
+    void watch(int fd, int events);
+
+    // watched fds with the WATCH* events they were ready for in the last
+    // wait() - consumers erase the entries they have handled
+    map<int, int> readyfds;
+
 protected:
+    // wakeup descriptors written by notify() and watched by wait(): an
+    // eventfd (Linux, both ends are the same descriptor) or a pipe
     int m_pipe[2];
+
+    // set by the first notify() since the last wait(), which is the only
+    // one to write - cleared by wait() before it reads
+    volatile int notified;
+
+    // drain the wakeup descriptor, returns true if notify() was called
+    // since the last wait()
+    bool clearnotify();
+
+    // epoll or kqueue descriptor
+    int pollfd;
+
+    // registrations made via watch() and mirrored from the fd_sets
+    map<int, int> watched;
+    map<int, int> mirrored;
+
+    // mirrored fds the backend refuses (e.g. regular files), treated as
+    // always ready like select() does
+    set<int> unpollable;
+
+    void initbackend(int);
+    bool setwatch(int fd, int oldevents, int newevents);
+    void mirrorfdsets();
+    bool report(int fd, int events);
+    int pollwait();
 };
 } // namespace
 
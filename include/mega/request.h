@@ -40,6 +40,26 @@ public:
     void procresult(MegaClient*);
 
     void clear();
+
+    // move the non-persistent independent commands to another request,
+    // preserving their order
+    void moveindependent(Request*);
+
+    // index of the first streamable command or -1
+    int streamindex() const;
+
+    // all commands are deferrable
+    bool deferrable() const;
+
+    // send the streamable commands after the others, whose responses would
+    // otherwise wait for the whole streamed response
+    void movestreamablelast();
+
+    // record the response time of the commands
+    void observe(Metrics*, double) const;
+
+    // merge the command into a queued one (see Command::coalesce())
+    bool coalesce(Command*);
 };
 
 class MEGA_API RequestDispatcher
@@ -60,6 +80,7 @@ public:
 
     void nextRequest();
 
+    // the command may be merged into a queued one and deleted
     void add(Command*);
 
     int cmdspending() const;
@@ -69,6 +90,22 @@ public:
     void procresult(MegaClient*);
 
     void clear();
+
+    // take the independent commands out of the buffer that has not been
+    // sent yet
+    void extractindependent(Request*);
+
+    // index of the first streamable command of the buffer about to be sent
+    int streamindex() const;
+
+    // the buffer about to be sent can be held back (see Command::deferrable)
+    bool deferrable() const;
+
+    // reorder the buffer about to be sent (see Request::movestreamablelast())
+    void movestreamablelast();
+
+    // record the response time of the commands of the buffer being processed
+    void observe(Metrics*, double) const;
 };
 
 } // namespace
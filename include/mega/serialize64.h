@@ -30,6 +30,10 @@ struct MEGA_API Serialize64
 {
     static int serialize(byte *, uint64_t);
     static int unserialize(byte*, int, uint64_t*);
+
+    // append to a string / read and advance a pointer within [ptr, end)
+    static void serialize(string*, uint64_t);
+    static bool unserialize(const char**, const char*, uint64_t*);
 };
 } // namespace
 
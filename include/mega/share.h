@@ -42,6 +42,11 @@ struct MEGA_API Share
     void serialize(string*);
     static bool unserialize(MegaClient *, int, handle, const byte *, const char**, const char*);
 
+    // compact form used by compact Node records: the timestamp is stored as
+    // a delta from the given base (the node's creation time)
+    void serialize(string*, m_time_t);
+    static bool unserialize(MegaClient *, int, handle, const byte *, const char**, const char*, m_time_t);
+
     Share(User*, accesslevel_t, m_time_t, PendingContactRequest* = NULL);
 };
 
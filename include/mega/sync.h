@@ -26,6 +26,42 @@
 #include "megaclient.h"
 
 namespace mega {
+// performance counters of a sync (exposed by MegaApi::getSyncStats())
+struct MEGA_API SyncMetrics
+{
+    // procscanq(): items processed and processor time spent (us)
+    m_off_t scanitems;
+    uint64_t scantime;
+
+    // full scans (initial scan and rescans) and the duration of the last
+    // completed one
+    m_off_t fullscans;
+    dstime fullscanstart;
+    dstime fullscands;
+
+    // sync putnodes() in flight, transfers started
+    int putnodespending;
+    m_off_t uploads, downloads;
+
+    // items moved to the local debris folder and to the remote SyncDebris
+    m_off_t localdebris, remotedebris;
+
+    // syncdown()/syncup() passes from the sync root: number of passes and
+    // processor time (us) in total, of the last and of the slowest pass
+    struct PassTimes
+    {
+        m_off_t passes;
+        uint64_t total, last, max;
+
+        // account for a pass that started at the given clock()
+        void add(clock_t);
+    };
+
+    PassTimes syncdown, syncup;
+
+    SyncMetrics();
+};
+
 class MEGA_API Sync
 {
 public:
@@ -58,8 +94,22 @@ public:
     // recursively add children
     void addstatecachechildren(uint32_t, idlocalnode_map*, string*, LocalNode*, int);
     
-    // Caches all synchronized LocalNode
-    void cachenodes();
+    // Caches all synchronized LocalNode - while the sync is active, writes
+    // are coalesced for CACHEFLUSHDS unless forced or CACHEFLUSHMAX changes
+    // are pending, and records that serialize unchanged are skipped
+    void cachenodes(bool = false);
+
+    static const dstime CACHEFLUSHDS = 10;
+    static const unsigned CACHEFLUSHMAX = 1000;
+
+    // time of the last flush and when the next one is due (NEVER if
+    // nothing is queued)
+    dstime cacheflushds;
+    dstime nextcacheflush();
+
+    // statecache write accounting: queued changes, records written,
+    // records skipped as unchanged, deletions and bytes written
+    m_off_t cachechanges, cacheputs, cacheskipped, cachedels, cachebytes;
 
     // change state, signal to application
     void changestate(syncstate_t);
@@ -79,6 +129,8 @@ public:
     m_off_t localbytes;
     unsigned localnodes[2];
 
+    SyncMetrics metrics;
+
     // look up LocalNode relative to localroot
     LocalNode* localnodebypath(LocalNode*, string*, LocalNode** = NULL, string* = NULL);
 
@@ -86,6 +138,87 @@ public:
     // LocalNode
     bool scan(string*, FileAccess*);
 
+    // parallel scan: with client->scanworkers set, the next SCANPREFETCH
+    // queued paths are opened on the workers, files fingerprinted (unless
+    // they match their LocalNode) and folders listed - checkpath() and
+    // scan() use the results if the item is unchanged when they open it
+    struct ScanPrefetch
+    {
+        string path;
+
+        // state of the existing LocalNode, if any
+        bool known;
+        handle knownfsid;
+        m_off_t knownsize;
+        m_time_t knownmtime;
+
+        bool opened;
+        nodetype_t type;
+        handle fsid;
+        bool fsidvalid;
+        m_off_t size;
+        m_time_t mtime;
+
+        // valid if fingerprint.isvalid
+        FileFingerprint fingerprint;
+
+        bool listed;
+        vector<string> names;
+
+        ScanPrefetch() : known(false), opened(false), listed(false) { }
+    };
+
+    static const unsigned SCANPREFETCH = 256;
+    map<string, ScanPrefetch> prefetched;
+
+    // queued items covered by the current prefetch batch
+    size_t prefetchpending;
+
+    void prefetchscan(int);
+    static void prefetchjob(unsigned, void*);
+
+    // prefetched state of the opened item, NULL if none or outdated
+    ScanPrefetch* prefetchedentry(string*, FileAccess*);
+
+    // LocalNode::genfingerprint(), with the prefetched or cached
+    // fingerprint if valid
+    bool genfingerprint(LocalNode*, FileAccess*, string*);
+
+    // last fingerprint computed for a file, by fsid, persisted in the
+    // statecache (CACHEDFINGERPRINT records) and reused while size and
+    // mtime match - files are not rehashed when their LocalNode record is
+    // missing or was invalidated
+    struct CachedFingerprint : public FileFingerprint, public Cachable
+    {
+        handle fsid;
+
+        bool serialize(string*);
+        bool unserialize(string*);
+    };
+
+    map<handle, CachedFingerprint> fingerprints;
+
+    // records to write with the next cachenodes()
+    set<CachedFingerprint*> fingerprintq;
+
+    // cached fingerprint of the opened file, NULL if none or outdated
+    CachedFingerprint* cachedfingerprint(FileAccess*);
+    void addfingerprint(FileAccess*, FileFingerprint*);
+
+    // after a full scan: drop the fingerprints of files without LocalNode
+    void prunefingerprints();
+
+    // fingerprints taken from the cache instead of hashing the file
+    m_off_t fingerprinthits;
+
+    // scan progress: items prefetched, prefetched fingerprints and
+    // listings used
+    m_off_t scanprefetched, scanfingerprints, scanlistings;
+
+    // files matched by the size, mtime and fsid from their directory
+    // listing (DirAccess::dstat()) without being opened
+    m_off_t scanlisted;
+
     // own position in session sync list
     sync_list::iterator sync_it;
 
@@ -22,12 +22,16 @@
 #ifndef MEGA_THREAD_H
 #define MEGA_THREAD_H 1
 
+#include "types.h"
+
 namespace mega {
 class Thread
 {
 public:
     virtual void start(void *(*start_routine)(void*), void *parameter) = 0;
     virtual void join() = 0;
+
+    virtual ~Thread() { }
 };
 
 class Mutex
@@ -36,6 +40,150 @@ public:
     virtual void init(bool recursive) = 0;
     virtual void lock() = 0;
     virtual void unlock() = 0;
+
+    virtual ~Mutex() { }
+};
+
+// reader/writer lock: any number of threads may hold it shared, one thread
+// exclusively; both modes are recursive and the exclusive owner may also
+// take it shared, but a shared holder must not request it exclusively
+class SharedMutex
+{
+public:
+    virtual void init() = 0;
+    virtual void lock() = 0;
+    virtual void unlock() = 0;
+    virtual void lockshared() = 0;
+    virtual void unlockshared() = 0;
+
+    virtual ~SharedMutex() { }
+};
+
+// counting semaphore: wait() blocks until the count is positive and
+// decrements it, release() increments it
+class Semaphore
+{
+public:
+    virtual void init(unsigned count) = 0;
+    virtual void release() = 0;
+    virtual void wait() = 0;
+
+    virtual ~Semaphore() { }
+};
+
+// concurrent execution of independent jobs, supplied by the application
+// (MegaClient itself never creates threads)
+class ParallelRunner
+{
+public:
+    // invoke job(i, param) for every i in [0, n) and return once all of
+    // them have completed
+    virtual void run(unsigned n, void (*job)(unsigned, void*), void* param) = 0;
+
+    virtual ~ParallelRunner() { }
+};
+
+// fixed set of worker threads for background work of the client: tasks are
+// queued to the workers in turn, each worker runs its own queue (highest
+// priority first) and, once that is empty, steals from the back of the
+// others' - finished tasks are handed back to the client thread, which is
+// woken up to run their completion in complete()
+// threads and mutexes (one each per worker, plus one for the pool) and the
+// semaphores are supplied by the application and owned by the pool
+class MEGA_API ThreadPool : public ParallelRunner
+{
+public:
+    enum { PRIORITY_HIGH, PRIORITY_NORMAL, PRIORITY_LOW, NUMPRIORITIES };
+
+    struct Task
+    {
+        // on a worker thread
+        virtual void run() = 0;
+
+        // on the client thread once run() has returned - the task is
+        // deleted afterwards
+        virtual void completed() { }
+
+        virtual ~Task() { }
+    };
+
+    // queue a task (the pool takes ownership)
+    void submit(Task*, int = PRIORITY_NORMAL);
+
+    // complete the finished tasks (from MegaClient::exec())
+    void complete();
+
+    // ParallelRunner: the jobs are queued at high priority and the calling
+    // thread takes part in running them (one batch at a time)
+    void run(unsigned n, void (*job)(unsigned, void*), void* param);
+
+    struct Stats
+    {
+        // tasks queued, taken from another worker's queue, run
+        uint64_t submitted;
+        uint64_t stolen;
+        uint64_t finished;
+
+        // tasks waiting and running
+        unsigned queued;
+        unsigned running;
+
+        // microseconds spent running tasks
+        uint64_t busytime;
+    };
+
+    void getstats(Stats*);
+
+    unsigned size() const;
+
+    ThreadPool(unsigned n, Thread**, Mutex**, Mutex*, Semaphore*, Semaphore*, Waiter*);
+
+    // waits for running tasks, queued and unfinished ones are discarded
+    ~ThreadPool();
+
+private:
+    struct Worker
+    {
+        ThreadPool* pool;
+        unsigned index;
+        Thread* thread;
+
+        // guards queues
+        Mutex* mutex;
+        deque<Task*> queues[NUMPRIORITIES];
+    };
+
+    vector<Worker> workers;
+
+    // round-robin position of submit()
+    unsigned nextworker;
+
+    // guards finished, the stats and stopping
+    Mutex* mutex;
+
+    // one per queued task (plus one per worker to stop)
+    Semaphore* ready;
+
+    // released when the last job of a run() batch finishes on a worker
+    Semaphore* batchdone;
+
+    deque<Task*> finished;
+    Stats stats;
+    bool stopping;
+
+    Waiter* waiter;
+
+    struct Batch;
+    struct BatchTask;
+
+    void runbatch(Batch*);
+    void releasebatch(Batch*);
+
+    // dequeue the next task for a worker, from its own queues or another's
+    Task* take(unsigned, bool*);
+
+    static void* workerentry(void*);
+    void work(Worker*);
 };
 
 } // namespace
@@ -28,6 +28,7 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
 
 namespace mega {
 
@@ -58,6 +59,38 @@ protected:
 	std::recursive_mutex *rmutex;
 };
 
+// std::shared_mutex is not available to this toolchain, so shared requests
+// are served exclusively
+class CppSharedMutex : public SharedMutex
+{
+public:
+    CppSharedMutex();
+    virtual void init();
+    virtual void lock();
+    virtual void unlock();
+    virtual void lockshared();
+    virtual void unlockshared();
+    virtual ~CppSharedMutex();
+
+protected:
+    std::recursive_mutex *rmutex;
+};
+
+class CppSemaphore : public Semaphore
+{
+public:
+    CppSemaphore();
+    virtual void init(unsigned count);
+    virtual void release();
+    virtual void wait();
+    virtual ~CppSemaphore();
+
+protected:
+    std::mutex *mutex;
+    std::condition_variable *cond;
+    unsigned count;
+};
+
 } // namespace
 
 #endif
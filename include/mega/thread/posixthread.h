@@ -54,6 +54,47 @@ protected:
     pthread_mutexattr_t *attr;
 };
 
+class PosixSharedMutex : public SharedMutex
+{
+public:
+    PosixSharedMutex();
+    virtual void init();
+    virtual void lock();
+    virtual void unlock();
+    virtual void lockshared();
+    virtual void unlockshared();
+    virtual ~PosixSharedMutex();
+
+protected:
+    pthread_rwlock_t *rwlock;
+
+    // exclusive owner and its recursion depth
+    pthread_t owner;
+    volatile bool owned;
+    int depth;
+
+    // per-thread shared recursion depth
+    pthread_key_t readers;
+
+    bool ownedbyself();
+};
+
+// unnamed POSIX semaphores are not available everywhere (macOS)
+class PosixSemaphore : public Semaphore
+{
+public:
+    PosixSemaphore();
+    virtual void init(unsigned count);
+    virtual void release();
+    virtual void wait();
+    virtual ~PosixSemaphore();
+
+protected:
+    pthread_mutex_t *mutex;
+    pthread_cond_t *cond;
+    unsigned count;
+};
+
 } // namespace
 
 #endif
@@ -27,6 +27,8 @@
 #include "mega/thread.h"
 #include <QThread>
 #include <QMutex>
+#include <QReadWriteLock>
+#include <QSemaphore>
 
 namespace mega {
 class QtThread : public QThread, public Thread
@@ -57,6 +59,34 @@ protected:
     QMutex *mutex;
 };
 
+class QtSharedMutex : public SharedMutex
+{
+public:
+    QtSharedMutex();
+    virtual void init();
+    virtual void lock();
+    virtual void unlock();
+    virtual void lockshared();
+    virtual void unlockshared();
+    virtual ~QtSharedMutex();
+
+protected:
+    QReadWriteLock *rwlock;
+};
+
+class QtSemaphore : public Semaphore
+{
+public:
+    QtSemaphore();
+    virtual void init(unsigned count);
+    virtual void release();
+    virtual void wait();
+    virtual ~QtSemaphore();
+
+protected:
+    QSemaphore *semaphore;
+};
+
 } // namespace
 
 #endif
@@ -56,6 +56,36 @@ protected:
     CRITICAL_SECTION mutex;
 };
 
+// slim reader/writer locks are not available on Windows XP, so shared
+// requests are served exclusively
+class Win32SharedMutex : public SharedMutex
+{
+public:
+    Win32SharedMutex();
+    virtual void init();
+    virtual void lock();
+    virtual void unlock();
+    virtual void lockshared();
+    virtual void unlockshared();
+    virtual ~Win32SharedMutex();
+
+protected:
+    CRITICAL_SECTION mutex;
+};
+
+class Win32Semaphore : public Semaphore
+{
+public:
+    Win32Semaphore();
+    virtual void init(unsigned count);
+    virtual void release();
+    virtual void wait();
+    virtual ~Win32Semaphore();
+
+protected:
+    HANDLE semaphore;
+};
+
 } // namespace
 
 #endif
@@ -27,8 +27,19 @@
 #include "command.h"
 
 namespace mega {
+// destination of a download that bypasses the filesystem: receives the
+// decrypted data in file order, as it arrives - the transfer completes once
+// the meta MAC of the delivered data has been verified
+struct MEGA_API TransferSink
+{
+    // false: refuse the data and fail the transfer with API_EWRITE
+    virtual bool write(const byte*, unsigned, m_off_t) = 0;
+
+    virtual ~TransferSink() { }
+};
+
 // pending/active up/download ordered by file fingerprint (size - mtime - sparse CRC)
-struct MEGA_API Transfer : public FileFingerprint
+struct MEGA_API Transfer : public FileFingerprint, Cachable
 {
     // PUT or GET
     direction_t type;
@@ -47,6 +58,13 @@ struct MEGA_API Transfer : public FileFingerprint
     // representative local filename for this transfer
     string localfilename;
 
+    // temp file of a partial download restored from the transfer cache
+    string cachedlocalfilename;
+
+    // downloads: data goes to this sink instead of localfilename (see
+    // File::sink) - such transfers are neither shared nor cached
+    TransferSink* sink;
+
     m_off_t pos;
 
     byte filekey[FILENODEKEYLENGTH];
@@ -62,6 +80,14 @@ struct MEGA_API Transfer : public FileFingerprint
 
     chunkmac_map chunkmacs;
 
+    // meta MAC folded incrementally over the contiguous chunk MACs from the
+    // start of the file up to metamacpos (see TransferSlot::foldmacs())
+    m_off_t metamacpos;
+    byte metamacstate[SymmCipher::BLOCKSIZE];
+
+    // discard the chunk MACs and the meta MAC folding state
+    void clearmacs();
+
     // upload handle for file attribute attachment (only set if file attribute queued)
     handle uploadhandle;
 
@@ -71,6 +97,12 @@ struct MEGA_API Transfer : public FileFingerprint
     // position in transfers[type]
     transfer_map::iterator transfers_it;
 
+    // priority class and position in client->transferqueue[type][priority]
+    // (if queued)
+    transferpriority_t priority;
+    bool queued;
+    transfer_list::iterator queue_it;
+
     // position in faputcompletion[uploadhandle]
     handletransfer_map::iterator faputcompletion_it;
     
@@ -92,6 +124,10 @@ struct MEGA_API Transfer : public FileFingerprint
 
     // previous wrong fingerprint
     FileFingerprint badfp;
+
+    // persisted state of partial downloads (transfer cache)
+    bool serialize(string*);
+    static Transfer* unserialize(MegaClient*, string*, transfer_map*);
    
     Transfer(MegaClient*, direction_t);
     virtual ~Transfer();
@@ -101,8 +137,43 @@ struct MEGA_API DirectReadSlot
 {
     m_off_t pos;
 
+    // the slot is done once the apps have received their ranges, the
+    // remainder of the request (block alignment and read-ahead) only feeds
+    // the cache
+    bool delivered;
+
+    // queued reads of the same node that overlap or follow the range of dr
+    // ride along in its request, the slot delivers their slices too
+    vector<DirectRead*> riders;
+
+    // pass a chunk of decrypted data to every read it concerns - false if
+    // dr was aborted (and the slot deleted)
+    bool deliver(const char*, m_off_t, m_off_t);
+
+    void detach(DirectRead*);
+
+    // whole blocks are passed to the cache, starting at blockpos
+    bool caching;
+    m_off_t blockpos;
+    string block;
+
+    void cachedata(const char*, unsigned);
+
+    // with client->drconnections > 1, the range is fetched in PARTSIZE parts
+    // over parallel requests: reqs.front() (at pos) is decrypted and passed
+    // on as its data arrives, the others buffer their part until they are next
+    static const m_off_t PARTSIZE = 1048576;
+
+    deque<HttpReq*> reqs;
+
+    // start of the next part to request and end of the range (0: until EOF)
+    m_off_t nextpos;
+    m_off_t end;
+
+    // issue requests for the next parts while connections are available
+    void request();
+
     DirectRead* dr;
-    HttpReq* req;
 
     drs_list::iterator drs_it;
 
@@ -127,6 +198,18 @@ struct MEGA_API DirectRead
 
     int reqtag;
 
+    // bytes requested beyond the range
+    m_off_t readahead;
+
+    // bytes of the range received by the app, and whether that's all of it
+    m_off_t done;
+    bool delivered;
+
+    // prefetches only feed the block cache (no appdata, no app callbacks),
+    // idle ones only get a slot while no app read is waiting
+    bool prefetch;
+    bool idle;
+
     void abort();
 
     DirectRead(DirectReadNode*, m_off_t, m_off_t, int, void*);
@@ -151,6 +234,9 @@ struct MEGA_API DirectReadNode
 
     dr_list reads;
 
+    // open handles keeping the node alive while it has no reads
+    int pins;
+
     MegaClient* client;
 
     handledrn_map::iterator hdrn_it;
@@ -160,7 +246,7 @@ struct MEGA_API DirectReadNode
     void cmdresult(error);
     
     // enqueue new read
-    void enqueue(m_off_t, m_off_t, int, void*);
+    DirectRead* enqueue(m_off_t, m_off_t, int, void*);
 
     // dispatch all reads
     void dispatch();
@@ -53,16 +53,99 @@ struct MEGA_API TransferSlot
     // file attribute string
     string fileattrstring;
 
+    // the state of partial downloads is persisted at most every CACHEINTERVAL
+    // (ds) to allow for resumption after a restart
+    static const dstime CACHEINTERVAL = 100;
+    dstime cachetime;
+    m_off_t progresscached;
+
+    // download write-back (if client->writebackmax is set): chunks that
+    // complete out of order are buffered up to the cap and written in
+    // sequential runs continuing at writepos - downloads to a sink always
+    // buffer, without a cap, as they can only be written in order
+    struct WriteBackChunk
+    {
+        byte* buf;
+        unsigned len;
+        unsigned capacity;
+        chunkmac_map macs;
+    };
+
+    map<m_off_t, WriteBackChunk> writeback;
+    m_off_t writebackbytes;
+    m_off_t writepos;
+
+    // buffer a completed chunk / write buffered chunks (all of them or as
+    // needed to respect the cap, on this thread if sync is set) - false if
+    // the sink refused the data
+    bool storechunk(HttpReqDL*);
+    bool flushwriteback(bool, bool = false);
+
+    // with a client->threadpool, the file I/O runs on its workers, one task
+    // per slot at a time (FileAccess isn't thread-safe): uploads read and
+    // encrypt chunks ahead into pooled buffers, downloads queue all their
+    // chunks for writing through the write-back above (chunk MACs are
+    // recorded once written)
+    struct IoTask;
+    IoTask* iotask;
+
+    // chunks read and encrypted ahead (with their MACs), by position, and
+    // the next position to read
+    map<m_off_t, WriteBackChunk> readahead;
+    m_off_t readpos;
+
+    // uploads prepare up to two chunks per connection ahead, beyond one per
+    // connection only within that many bytes
+    static const m_off_t MAXPREPARED = 8388608;
+
+    // downloads stop requesting chunks while that much data waits for writing
+    static const m_off_t MAXQUEUEDWRITES = 16777216;
+
+    // error of the last task, and when to retry a transiently failed read
+    error ioerror;
+    dstime ioretryds;
+
+    // all data has arrived, waiting for the writes to complete
+    bool finishing;
+
+    bool asyncio() const;
+    void startread();
+    void iodone(IoTask*);
+
     // file attributes mutable
     int fileattrsmutable;
 
-    // storage server access URL
+    // storage server access URL and its MegaClient::tempurls key (downloads)
     string tempurl;
+    handle tempurlh;
 
     // maximum number of parallel connections and connection aray
     int connections;
     HttpReqXfer** reqs;
 
+    // connections used for new chunks, adapted between minconnections and
+    // connections to the goodput measured every ADAPTINTERVAL
+    int activeconnections;
+    int minconnections;
+
+    static const dstime ADAPTINTERVAL = 30;
+
+    // intervals without increases after a decrease
+    static const int ADAPTHOLD = 5;
+
+    // new requests span consecutive chunks up to requestsize (at least one
+    // chunk, the chunk MACs stay the same), set to REQUESTBDPS times the
+    // bandwidth-delay product of a connection to the storage server, so
+    // that the round trip between requests doesn't leave it idle on fast,
+    // distant links
+    m_off_t requestsize;
+
+    static const int REQUESTBDPS = 8;
+    static const m_off_t MAXREQUESTSIZE = 8388608;
+
+    // end of the request starting at the given position
+    m_off_t requestend(m_off_t);
+
     // handle I/O for this slot
     void doio(MegaClient*);
 
@@ -75,6 +158,10 @@ struct MEGA_API TransferSlot
     // compute the meta MAC based on the chunk MACs
     int64_t macsmac(chunkmac_map*);
 
+    // fold the chunk MACs that extend the contiguous prefix into the
+    // transfer's meta MAC state, so that macsmac() only has to finish off
+    void foldmacs();
+
     // tslots list position
     transferslot_list::iterator slots_it;
 
@@ -90,6 +177,33 @@ struct MEGA_API TransferSlot
 
 protected:
     void toggleport(HttpReqXfer* req);
+    static void toggleport(string*, bool);
+
+    // is the other port of the URL's host failing according to the client's
+    // HostStats?
+    bool altportdegraded(const string&);
+
+    const string* posturl();
+
+    // goodput measurement: start of the interval, progress at its start,
+    // rate (bytes/ds) of the previous interval and failures during this one
+    dstime adapttime;
+    m_off_t adaptprogress;
+    m_off_t adaptrate;
+    unsigned adapterrors;
+
+    // > 0: last change was an increase, < 0: intervals left to hold
+    int adaptstep;
+
+    void adaptconnections(m_off_t);
+
+    // requestsize update, at most every ADAPTINTERVAL
+    dstime requesttime;
+    void adaptrequestsize();
+
+    // chunk encryption/decryption and MAC computation
+    static void cryptchunk(unsigned, void*);
+    void cryptchunks(MegaClient*, vector<HttpReqXfer*>*);
 
 };
 } // namespace
@@ -37,12 +37,6 @@ public:
     virtual ~TreeProc() { }
 };
 
-class MEGA_API TreeProcDel : public TreeProc
-{
-public:
-    void proc(MegaClient*, Node*);
-};
-
 class MEGA_API TreeProcApplyKey : public TreeProc
 {
 public:
@@ -70,25 +70,36 @@ struct DirectReadNode;
 struct DirectReadSlot;
 struct FileAccess;
 struct FileAttributeFetch;
+class FileAttributeCache;
 struct FileAttributeFetchChannel;
 struct FileFingerprint;
 struct FileFingerprintCmp;
+struct FileSystemAccess;
 struct HttpReq;
 struct HttpReqCommandPutFA;
 struct LocalNode;
+struct MegaApp;
 class MegaClient;
+class Metrics;
 struct NewNode;
 struct Node;
 struct NodeCore;
+class ParallelRunner;
+class ThreadPool;
+class Thread;
+class Mutex;
+class Semaphore;
 class PubKeyAction;
 class Request;
 struct Transfer;
+struct TransferSink;
 class TreeProc;
 class LocalTreeProc;
 struct User;
 struct Waiter;
 struct Proxy;
 struct PendingContactRequest;
+struct PutNodesTree;
 
 #define EOO 0
 
@@ -186,10 +197,25 @@ const int FOLDERNODEKEYLENGTH = 16;
 typedef list<class Sync*> sync_list;
 
 // persistent resource cache storage
+// plain values of the lookup columns of a cached record - stored
+// encrypted, see DbIndex
+struct DbColumns
+{
+    handle nodehandle;
+    handle parenthandle;
+    int type;
+
+    // NULL: none
+    const FileFingerprint* fingerprint;
+};
+
 struct Cachable
 {
     virtual bool serialize(string*) = 0;
 
+    // lookup columns of the record (default: none)
+    virtual bool dbcolumns(DbColumns*) { return false; }
+
     int32_t dbid;
 
     bool notified;
@@ -216,6 +242,9 @@ typedef enum { IPCA_ACCEPT = 0, IPCA_DENY, IPCA_IGNORE} ipcactions_t;
 
 typedef vector<struct Node*> node_vector;
 
+// resident file nodes in least recently used order (paged mode)
+typedef list<struct Node*> node_lru;
+
 // contact visibility:
 // HIDDEN - not shown
 // VISIBLE - shown
@@ -243,9 +272,9 @@ typedef multimap<int32_t, LocalNode*> idlocalnode_map;
 
 typedef set<Node*> node_set;
 
-// enumerates a node's children
-// FIXME: switch to forward_list once C++11 becomes more widely available
-typedef list<Node*> node_list;
+// enumerates a node's children (contiguous storage, see NodeChildren)
+class NodeChildren;
+typedef NodeChildren node_list;
 
 // undefined node handle
 const handle UNDEF = ~(handle)0;
@@ -263,8 +292,9 @@ typedef map<FileFingerprint*, Transfer*, FileFingerprintCmp> transfer_map;
 // map an upload handle to the corresponding transer
 typedef map<handle, Transfer*> handletransfer_map;
 
-// maps node handles to Node pointers
-typedef map<handle, Node*> node_map;
+// maps node handles to Node pointers (hash index, see nodemap.h)
+class NodeHandleMap;
+typedef NodeHandleMap node_map;
 
 // maps node handles to Share pointers
 typedef map<handle, struct Share*> share_map;
@@ -283,14 +313,17 @@ typedef vector<struct NodeCore*> nodecore_vector;
 typedef vector<struct User*> user_vector;
 typedef vector<struct PendingContactRequest*> pcr_vector;
 
-// actual user data (indexed by userid)
-typedef map<int, User> user_map;
+// actual user data (userid n at position n - 1) - a deque, so that users
+// don't move when others are added
+typedef deque<User> user_map;
 
-// maps user handles to userids
-typedef map<handle, int> uh_map;
+// maps user handles to userids (hash index, see user.h)
+class UserHandleIndex;
+typedef UserHandleIndex uh_map;
 
-// maps lowercase user e-mail addresses to userids
-typedef map<string, int> um_map;
+// maps lowercase user e-mail addresses to userids (hash index, see user.h)
+class UserEmailIndex;
+typedef UserEmailIndex um_map;
 
 // file attribute data
 typedef map<unsigned, string> fadata_map;
@@ -313,6 +346,11 @@ typedef map<int, FileAttributeFetchChannel*> fafc_map;
 // transfer type
 typedef enum { GET, PUT } direction_t;
 
+// transfer priority classes, dispatched in this order
+typedef enum { PRIORITY_INTERACTIVE, PRIORITY_NORMAL, PRIORITY_BACKGROUND } transferpriority_t;
+
+typedef list<struct Transfer*> transfer_list;
+
 typedef set<pair<int, handle> > fareq_set;
 
 struct StringCmp
@@ -325,6 +363,7 @@ struct StringCmp
 
 typedef map<handle, DirectReadNode*> handledrn_map;
 typedef multimap<dstime, DirectReadNode*> dsdrn_map;
+typedef multimap<dstime, BackoffTimer*> backofftimer_map;
 typedef list<DirectRead*> dr_list;
 typedef list<DirectReadSlot*> drs_list;
 
@@ -339,8 +378,9 @@ typedef map<handle, NewNode*> handlenewnode_map;
 
 typedef map<handle, char> handlecount_map;
 
-// maps FileFingerprints to node
-typedef multiset<FileFingerprint*, FileFingerprintCmp> fingerprint_set;
+// maps FileFingerprints to node (hash index, see nodemap.h)
+class FingerprintIndex;
+typedef FingerprintIndex fingerprint_set;
 
 typedef enum { TREESTATE_NONE = 0, TREESTATE_SYNCED, TREESTATE_PENDING, TREESTATE_SYNCING } treestate_t;
 
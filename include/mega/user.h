@@ -73,6 +73,72 @@ struct MEGA_API User : public Cachable
 
     User(const char* = NULL);
 };
+
+// open-addressing (linear probing) hash index of userids by user handle -
+// users are only removed all at once, so there are no deletions
+class MEGA_API UserHandleIndex
+{
+public:
+    // userid or 0
+    int find(handle) const;
+
+    void set(handle, int);
+    void clear();
+
+    size_t size() const { return count; }
+
+    UserHandleIndex();
+
+private:
+    struct Slot
+    {
+        handle uh;
+
+        // 0: empty
+        int userid;
+    };
+
+    static const size_t MINSLOTS = 64;
+
+    vector<Slot> slots;
+    size_t count;
+
+    static size_t hash(handle);
+    void rehash();
+};
+
+// same, by lowercase e-mail address
+class MEGA_API UserEmailIndex
+{
+public:
+    // userid or 0
+    int find(const string&) const;
+
+    void set(const string&, int);
+    void clear();
+
+    size_t size() const { return count; }
+
+    UserEmailIndex();
+
+private:
+    struct Slot
+    {
+        string email;
+        size_t hash;
+
+        // 0: empty
+        int userid;
+    };
+
+    static const size_t MINSLOTS = 64;
+
+    vector<Slot> slots;
+    size_t count;
+
+    static size_t hash(const string&);
+    void rehash();
+};
 } // namespace
 
 #endif
@@ -190,6 +190,265 @@ public:
     bool hybridEncrypt(const string *cleartext, const byte *pubkdata, int pubkdatalen, string *result, bool randompadding = true);
 };
 
+// fixed-size block allocator: blocks are carved out of large chunks and
+// recycled through a free list. chunks are only returned to the heap by
+// release() once no block is in use.
+class MEGA_API SlabAllocator
+{
+    size_t blocksize;
+    size_t blocksperchunk;
+
+    vector<char*> chunks;
+
+    // number of blocks handed out from the most recent chunk
+    size_t chunkused;
+
+    // singly linked list of freed blocks
+    void* freelist;
+
+public:
+    // blocks currently in use
+    size_t inuse;
+
+    // cumulative block allocations and frees
+    uint64_t allocs;
+    uint64_t frees;
+
+    void* alloc();
+    void free(void*);
+
+    // free all chunks if no block is in use, returns whether released
+    bool release();
+
+    // heap memory held in chunks in bytes
+    size_t allocated() const;
+
+    size_t size() const { return blocksize; }
+
+    SlabAllocator(size_t, size_t = 1024);
+    ~SlabAllocator();
+
+private:
+    SlabAllocator(const SlabAllocator&);
+    SlabAllocator& operator=(const SlabAllocator&);
+};
+
+// runtime metrics of the client: counters, gauges and latency histograms,
+// optionally split by the value of one label, exported in the Prometheus
+// text format
+class MEGA_API Metrics
+{
+public:
+    enum metric_t
+    {
+        REQUEST_TIME,       // ms from sending an API request to its response, by command
+        ACTIONPACKET_LAG,   // ms from receiving server-client packets to processing them
+        TRANSFER_BYTES,     // bytes of completed chunks, by direction
+        TRANSFER_SLOTS,     // active transfer slots, by direction
+        DB_COMMIT_TIME,     // ms per commit of the local cache
+        LOOP_TIME,          // ms per iteration of the client loop
+        PHASE_TIME,         // ms per traced phase or callback, by phase (see Tracer::setwatchdog())
+        QUEUE_DEPTH,        // items waiting, by queue
+        ALLOC_BYTES,        // heap bytes in use, by subsystem (see AllocTags)
+        ALLOC_COUNT,        // heap allocations, by subsystem
+        POOL_TASKS,         // tasks of the thread pool, by event (see ThreadPool::Stats)
+        POOL_BUSY_TIME,     // ms spent running tasks of the thread pool
+        NUMMETRICS
+    };
+
+    // counter
+    void inc(metric_t, const char* = "", double = 1);
+
+    // gauge
+    void set(metric_t, const char*, double);
+
+    // histogram sample (ms)
+    void observe(metric_t, const char*, double);
+
+    void gettext(string*) const;
+
+    // time in microseconds, for measuring intervals
+    static int64_t now();
+
+private:
+    // histogram bucket upper bounds (ms), +Inf is implicit
+    static const int NUMBUCKETS = 12;
+    static const double bucketbounds[NUMBUCKETS];
+
+    struct Series
+    {
+        // counter / gauge value, or sum of the histogram samples
+        double value;
+
+        uint64_t count;
+        uint64_t buckets[NUMBUCKETS];
+
+        Series();
+    };
+
+    struct Info
+    {
+        const char* name;
+        const char* type;
+        const char* label;
+        const char* help;
+    };
+
+    static const Info info[NUMMETRICS];
+
+    // by label value ("" for metrics without a label)
+    map<string, Series> series[NUMMETRICS];
+};
+
+// spans of the client loop, recorded into a ring buffer while enabled and
+// exported as Chrome trace-event JSON (chrome://tracing, Perfetto), and
+// checked by the watchdog against a stall threshold
+class MEGA_API Tracer
+{
+    struct Event
+    {
+        // static string
+        const char* name;
+
+        // microseconds (Metrics::now())
+        int64_t start;
+        int64_t duration;
+    };
+
+    vector<Event> events;
+
+    // slot of the next event / number of recorded events
+    size_t next;
+    size_t count;
+
+    // watchdog threshold (us, 0: off) and the metrics fed with the spans
+    int64_t slowthreshold;
+    Metrics* metrics;
+
+public:
+    // recording into the ring
+    bool enabled;
+
+    // spans are timed (recording or watchdog)
+    bool timing;
+
+    // start recording into a ring of the given number of events, or stop
+    void enable(size_t);
+    void disable();
+
+    // watchdog: every span feeds Metrics::PHASE_TIME, and spans of at least
+    // the given number of ms are logged as warnings (0: off)
+    void setwatchdog(Metrics*, int);
+
+    void record(const char*, int64_t, int64_t);
+
+    void getjson(string*) const;
+
+    Tracer();
+};
+
+// records a span from its construction to end() or its destruction,
+// only reads a flag when tracing and the watchdog are disabled
+class MEGA_API TraceSpan
+{
+    Tracer* tracer;
+    const char* name;
+    int64_t start;
+
+public:
+    TraceSpan(Tracer* t, const char* n)
+    {
+        tracer = t->timing ? t : NULL;
+
+        if (tracer)
+        {
+            name = n;
+            start = Metrics::now();
+        }
+    }
+
+    void end()
+    {
+        if (tracer)
+        {
+            tracer->record(name, start, Metrics::now() - start);
+            tracer = NULL;
+        }
+    }
+
+    ~TraceSpan()
+    {
+        end();
+    }
+};
+
+// heap usage by subsystem: configured with --enable-alloc-tags, the library
+// replaces the global operator new / delete and attributes every allocation
+// to the subsystem of the innermost AllocScope active on the calling thread
+// (OTHER outside of any scope) - without it, scopes compile to nothing and
+// all counters stay at 0
+class MEGA_API AllocTags
+{
+public:
+    enum tag_t
+    {
+        OTHER,
+        NODES,      // Node objects and their keys and indexes
+        ATTRS,      // node attribute decryption and maps
+        JSON,       // API request bodies and result processing
+        HTTP,       // network buffers
+        TRANSFERS,  // transfer slots and chunk buffers
+        SYNC,       // sync scans, LocalNodes and sync passes
+        CACHE,      // local state cache reads and writes
+        NUMTAGS
+    };
+
+    struct Counters
+    {
+        // bytes currently allocated, cumulative allocations and bytes
+        int64_t inuse;
+        uint64_t allocs;
+        uint64_t bytes;
+    };
+
+    // whether the counting operator new is compiled in
+    static bool enabled();
+
+    static void get(tag_t, Counters*);
+
+    // lowercase name, for the metrics
+    static const char* name(tag_t);
+
+    // set the calling thread's tag, returns the previous one
+    static tag_t swap(tag_t);
+};
+
+// attributes the allocations of the calling thread to a subsystem for the
+// lifetime of the scope
+class MEGA_API AllocScope
+{
+#ifdef ENABLE_ALLOC_TAGS
+    AllocTags::tag_t previous;
+
+public:
+    AllocScope(AllocTags::tag_t tag)
+    {
+        previous = AllocTags::swap(tag);
+    }
+
+    ~AllocScope()
+    {
+        AllocTags::swap(previous);
+    }
+#else
+public:
+    AllocScope(AllocTags::tag_t) { }
+#endif
+};
+
+// heap memory held by a string's buffer (0 if stored inline)
+size_t stringallocated(const string*);
+
 // read/write multibyte words
 struct MEGA_API MemAccess
 {
@@ -24,6 +24,12 @@
 
 #define DEBRISFOLDER "Rubbish"
 
+// directories are listed in bulk with GetFileInformationByHandleEx()
+// (Vista and later), which also returns file IDs, sizes and mtimes
+#if !defined(WINDOWS_PHONE) && defined(_WIN32_WINNT) && _WIN32_WINNT >= 0x0600
+#define USE_BULK_DIRINFO 1
+#endif
+
 namespace mega {
 struct MEGA_API WinDirAccess : public DirAccess
 {
@@ -32,9 +38,25 @@ struct MEGA_API WinDirAccess : public DirAccess
     HANDLE hFind;
     string globbase;
 
+#ifdef USE_BULK_DIRINFO
+    // directory handle and buffer of FILE_ID_BOTH_DIR_INFO records
+    static const DWORD DIRINFOBUFSIZE = 65536;
+    HANDLE hDirectory;
+    LONGLONG* dirinfobuf;
+    FILE_ID_BOTH_DIR_INFO* dirinfo;
+    bool nextdirinfo(bool);
+#endif
+
+    // attributes of the last record
+    bool statvalid;
+    m_off_t statsize;
+    m_time_t statmtime;
+    handle statfsid;
+
 public:
     bool dopen(string*, FileAccess*, bool);
     bool dnext(string*, string*, bool, nodetype_t*);
+    bool dstat(m_off_t*, m_time_t*, handle*);
 
     WinDirAccess();
     virtual ~WinDirAccess();
@@ -45,6 +67,9 @@ class MEGA_API WinFileSystemAccess : public FileSystemAccess
 public:
     unsigned pendingevents;
 
+    // waiter of the client (known after the first addevents())
+    WinWaiter* waiter;
+
     FileAccess* newfileaccess();
     DirAccess* newdiraccess();
     DirNotify* newdirnotify(string*, string*);
@@ -82,7 +107,7 @@ public:
     WinFileSystemAccess();
 };
 
-struct MEGA_API WinDirNotify : public DirNotify
+struct MEGA_API WinDirNotify : public DirNotify, public WinIOCompletion
 {
     WinFileSystemAccess* fsaccess;
 
@@ -98,6 +123,11 @@ struct MEGA_API WinDirNotify : public DirNotify
 
     static VOID CALLBACK completion(DWORD, DWORD, LPOVERLAPPED);
 
+    // completions via the waiter's I/O completion port (iocpkey set)
+    WinWaiter* waiter;
+    ULONG_PTR iocpkey;
+    void completed(DWORD);
+
     void addnotify(LocalNode*, string*);
 
     void process(DWORD wNumberOfBytesTransfered);
@@ -105,7 +135,7 @@ struct MEGA_API WinDirNotify : public DirNotify
 
     fsfp_t fsfingerprint();
 
-    WinDirNotify(string*, string*);
+    WinDirNotify(string*, string*, WinWaiter* = NULL);
     ~WinDirNotify();
 };
 
@@ -43,6 +43,9 @@ class MEGA_API WinHttpIO: public HttpIO
     CRITICAL_SECTION csHTTP;
     HANDLE hWakeupEvent;
 
+    // flags of the wakeup, posted directly to an I/O completion port waiter
+    int wakeupflags;
+
 protected:
     WinWaiter* waiter;
     HINTERNET hSession;
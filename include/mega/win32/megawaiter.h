@@ -26,13 +26,64 @@ typedef ULONGLONG (WINAPI * PGTC)();
 
 extern PGTC pGTC;
 
+// OVERLAPPED_ENTRY and GetQueuedCompletionStatusEx() (Vista or greater,
+// resolved at runtime)
+struct WinOverlappedEntry
+{
+    ULONG_PTR lpCompletionKey;
+    LPOVERLAPPED lpOverlapped;
+    ULONG_PTR Internal;
+    DWORD dwNumberOfBytesTransferred;
+};
+
+typedef BOOL (WINAPI * PGQCSEX)(HANDLE, WinOverlappedEntry*, ULONG, PULONG, DWORD, BOOL);
+
 namespace mega {
+// receives the completions of an overlapped handle associated with the
+// I/O completion port of a WinWaiter (called from wait())
+struct MEGA_API WinIOCompletion
+{
+    virtual void completed(DWORD bytes) = 0;
+    virtual ~WinIOCompletion() { }
+};
+
 class MEGA_API WinWaiter : public Waiter
 {
     vector<HANDLE> handles;
     vector<int> flags;
 
+    // BACKEND_IOCP: handles passed to addhandle() are watched by thread pool
+    // waits (not limited to MAXIMUM_WAIT_OBJECTS) that post to the port
+    struct HandleWait
+    {
+        WinWaiter* waiter;
+        int flag;
+        HANDLE wait;
+    };
+
+    vector<HandleWait> handlewaits;
+    static VOID CALLBACK handlesignaled(PVOID, BOOLEAN);
+
+    // completion keys of associated handles (0 is used for wakeups)
+    map<ULONG_PTR, WinIOCompletion*> targets;
+    ULONG_PTR nexttarget;
+
+    static const ULONG MAXENTRIES = 64;
+
+    int iocpwait();
+
 public:
+    // events: WaitForMultipleObjectsEx() on the added handles (at most
+    // MAXIMUM_WAIT_OBJECTS); IOCP: a completion port receiving wakeups,
+    // signaled handles and directory notifications
+    enum { BACKEND_EVENTS, BACKEND_IOCP };
+
+    // backend of subsequently created waiters
+    static int defaultbackend;
+    int backend;
+
+    HANDLE iocp;
+
     PCRITICAL_SECTION pcsHTTP;
     unsigned pendingfsevents;
 
@@ -41,7 +92,18 @@ public:
     bool addhandle(HANDLE handle, int);
     void notify();
 
+    // wake up wait() with the given flags - can be called from any thread
+    void post(int);
+
+    // BACKEND_IOCP: route the completions of an overlapped handle to the
+    // target, returns the key for dissociate() (0: not possible)
+    ULONG_PTR associate(HANDLE, WinIOCompletion*);
+
+    // ignore any further completions for the key
+    void dissociate(ULONG_PTR);
+
     WinWaiter();
+    ~WinWaiter();
 
 
 protected:
@@ -51,8 +51,11 @@ typedef uint64_t MegaHandle;
 class MegaListener;
 class MegaRequestListener;
 class MegaTransferListener;
+class MegaTransferProgress;
 class MegaGlobalListener;
 class MegaTreeProcessor;
+class MegaNodeViewProcessor;
+class MegaNodeView;
 class MegaAccountDetails;
 class MegaPricing;
 class MegaNode;
@@ -65,6 +68,11 @@ class MegaTransfer;
 class MegaSync;
 class MegaStringList;
 class MegaNodeList;
+class MegaHandleList;
+class MegaNodeQuery;
+class MegaChildrenCursor;
+class MegaNodeSnapshot;
+class MegaFolderLinkSession;
 class MegaUserList;
 class MegaContactRequestList;
 class MegaShareList;
@@ -313,6 +321,124 @@ private:
     const char *password;
 };
 
+/**
+ * @brief List of uploads to be started together
+ *
+ * Fill an object of this class with MegaUploadBatch::add and pass it to
+ * MegaApi::startUploads.
+ */
+class MegaUploadBatch
+{
+public:
+    MegaUploadBatch();
+    virtual ~MegaUploadBatch();
+
+    /**
+     * @brief Add an upload to the batch
+     * @param localPath Local path of the file or folder
+     * @param parent Parent node for the file or folder in the MEGA account
+     * @param fileName Custom file name in MEGA, or NULL to use the local one
+     * @param mtime Custom modification time for the file in MEGA (in seconds since the epoch),
+     * or -1 to use the local one
+     * @param fingerprint Fingerprint of the local file as returned by MegaApi::getFingerprint,
+     * or NULL. If the size and the modification time of the file still match it, the file
+     * isn't read again to fingerprint it (see MegaApi::startUploadWithFingerprint)
+     */
+    void add(const char *localPath, MegaNode *parent, const char *fileName = NULL, int64_t mtime = -1,
+             const char *fingerprint = NULL);
+
+    /**
+     * @brief Returns the number of uploads in the batch
+     * @return Number of uploads in the batch
+     */
+    int size();
+
+    /**
+     * @brief Returns the local path of an upload
+     *
+     * The MegaUploadBatch object retains the ownership of the returned value.
+     *
+     * @param i Position of the upload in the batch
+     * @return Local path of the upload, or NULL if the position is invalid
+     */
+    const char *getLocalPath(int i);
+
+    /**
+     * @brief Returns the handle of the parent node of an upload
+     * @param i Position of the upload in the batch
+     * @return Handle of the parent node, or INVALID_HANDLE
+     */
+    MegaHandle getParentHandle(int i);
+
+    /**
+     * @brief Returns the custom file name of an upload
+     *
+     * The MegaUploadBatch object retains the ownership of the returned value.
+     *
+     * @param i Position of the upload in the batch
+     * @return Custom file name, or NULL if the local name is used
+     */
+    const char *getFileName(int i);
+
+    /**
+     * @brief Returns the custom modification time of an upload
+     * @param i Position of the upload in the batch
+     * @return Custom modification time, or -1 if the local one is used
+     */
+    int64_t getTime(int i);
+
+    /**
+     * @brief Returns the fingerprint passed for an upload
+     *
+     * The MegaUploadBatch object retains the ownership of the returned value.
+     *
+     * @param i Position of the upload in the batch
+     * @return Fingerprint of the local file, or NULL if none was passed
+     */
+    const char *getFingerprint(int i);
+
+private:
+    struct Upload
+    {
+        std::string localPath;
+        MegaHandle parentHandle;
+        std::string fileName;
+        bool customName;
+        int64_t mtime;
+        std::string fingerprint;
+    };
+
+    std::vector<Upload> uploads;
+};
+
+/**
+ * @brief Open file for random access reads
+ *
+ * Objects of this class are returned by MegaApi::openFile and used with MegaApi::readFile.
+ * While a file is open, the SDK keeps what it needs to read it (for example, its download
+ * URL), so each read only costs a range request, or nothing if the data is in the
+ * streaming cache (MegaApi::setStreamingCacheSize).
+ *
+ * Deleting the object closes the file. Reads in progress complete normally.
+ */
+class MegaFileHandle
+{
+public:
+    virtual ~MegaFileHandle();
+
+    /**
+     * @brief Returns the handle of the open node
+     * @return Handle of the node
+     */
+    virtual MegaHandle getNodeHandle() const;
+
+    /**
+     * @brief Returns the size of the open file
+     * @return Size of the file in bytes
+     */
+    virtual long long getSize() const;
+};
+
 /**
  * @brief Interface to receive SDK logs
  *
@@ -703,6 +829,53 @@ class MegaNode
          */
         virtual int getChanges();
 
+        /**
+         * @brief Returns the handle of the parent of the node before the notified changes
+         *
+         * This value is only useful for nodes notified by MegaListener::onNodesUpdate or
+         * MegaGlobalListener::onNodesUpdate. If the node was moved (MegaNode::CHANGE_TYPE_PARENT),
+         * it allows to remove it from the previous folder without reloading it.
+         *
+         * If the parent didn't change, the value is the same as MegaNode::getParentHandle.
+         * For new nodes and in other cases, this function returns INVALID_HANDLE.
+         *
+         * @return Handle of the previous parent of the node
+         */
+        virtual MegaHandle getPreviousParentHandle();
+
+        /**
+         * @brief Returns the name of the node before the notified changes
+         *
+         * This value is only useful for nodes notified by MegaListener::onNodesUpdate or
+         * MegaGlobalListener::onNodesUpdate. If the node was renamed (MegaNode::CHANGE_TYPE_ATTRIBUTES),
+         * it allows to find it in lists sorted by name.
+         *
+         * If the name didn't change, the value is the same as MegaNode::getName.
+         * For new nodes and in other cases, this function returns NULL.
+         *
+         * The MegaNode object retains the ownership of the returned string, it will be valid until
+         * the MegaNode object is deleted.
+         *
+         * @return Name of the node before the notified changes
+         */
+        virtual const char* getPreviousName();
+
+        /**
+         * @brief Returns the change of the size of the node caused by the notified changes
+         *
+         * This value is only useful for nodes notified by MegaListener::onNodesUpdate or
+         * MegaGlobalListener::onNodesUpdate. It is the difference of the bytes stored in the
+         * node and its descendants: the total size for new nodes, minus the total size for
+         * removed nodes and usually 0 for other changes.
+         *
+         * Subtracting it from the previous parent and adding it to the new parent (and their
+         * ancestors) keeps folder sizes up to date without scanning the folders again.
+         * Note that for moved nodes the size delta is 0, but their total size moves with them.
+         *
+         * @return Size delta of the node in bytes
+         */
+        virtual int64_t getSizeDelta();
+
         /**
          * @brief Returns true if the node has an associated thumbnail
          * @return true if the node has an associated thumbnail
@@ -1156,6 +1329,216 @@ class MegaNodeList
          * @return Number of MegaNode objects in the list
          */
         virtual int size();
+
+        /**
+         * @brief Copy the handles of consecutive nodes of the list into an array
+         *
+         * These bulk accessors are intended for language bindings, where reading the list
+         * node by node costs several calls across the language boundary per node.
+         *
+         * @param start Position of the first node
+         * @param handles Array that receives the handles
+         * @param count Size of the array
+         * @return Number of handles copied (less than count at the end of the list)
+         */
+        virtual int getHandles(int start, MegaHandle *handles, int count);
+
+        /**
+         * @brief Copy the sizes of consecutive nodes of the list into an array
+         *
+         * Folders have a size of 0.
+         *
+         * @param start Position of the first node
+         * @param sizes Array that receives the sizes
+         * @param count Size of the array
+         * @return Number of sizes copied (less than count at the end of the list)
+         */
+        virtual int getSizes(int start, int64_t *sizes, int count);
+
+        /**
+         * @brief Copy the modification times of consecutive nodes of the list into an array
+         *
+         * See MegaNode::getModificationTime.
+         *
+         * @param start Position of the first node
+         * @param mtimes Array that receives the modification times
+         * @param count Size of the array
+         * @return Number of modification times copied (less than count at the end of the list)
+         */
+        virtual int getModificationTimes(int start, int64_t *mtimes, int count);
+
+        /**
+         * @brief Copy the types (MegaNode::TYPE_*) of consecutive nodes of the list into an array
+         *
+         * @param start Position of the first node
+         * @param types Array that receives the types
+         * @param count Size of the array
+         * @return Number of types copied (less than count at the end of the list)
+         */
+        virtual int getTypes(int start, int *types, int count);
+
+        /**
+         * @brief Copy the names of consecutive nodes of the list into a buffer
+         *
+         * The names are packed in UTF-8, each one followed by a null character. Nodes without
+         * a name get an empty one. Copying stops at the end of the list or at the first name
+         * that doesn't fit entirely.
+         *
+         * @param start Position of the first node
+         * @param names Buffer that receives the names
+         * @param size Size of the buffer in bytes
+         * @return Number of names copied
+         */
+        virtual int getNames(int start, char *names, int size);
+};
+
+/**
+ * @brief List of MegaHandle objects
+ *
+ * Objects of this class are immutable.
+ *
+ * @see MegaApi::queryNodes
+ */
+class MegaHandleList
+{
+    public:
+        virtual ~MegaHandleList();
+
+        virtual MegaHandleList *copy();
+
+        /**
+         * @brief Returns the MegaHandle at the position i in the MegaHandleList
+         *
+         * If the index is >= the size of the list, this function returns INVALID_HANDLE.
+         *
+         * @param i Position of the MegaHandle that we want to get for the list
+         * @return MegaHandle at the position i in the list
+         */
+        virtual MegaHandle get(int i);
+
+        /**
+         * @brief Returns the number of MegaHandle objects in the list
+         * @return Number of MegaHandle objects in the list
+         */
+        virtual int size();
+};
+
+/**
+ * @brief Cursor over the children of a folder in a specific sorting order
+ *
+ * Each call to MegaChildrenCursor::next returns the following window of children,
+ * so only the requested nodes are copied. The cursor doesn't keep a snapshot of the
+ * folder: if children are added or removed while iterating, windows can overlap
+ * or skip nodes.
+ *
+ * @see MegaApi::getChildrenCursor
+ */
+class MegaChildrenCursor
+{
+    public:
+        virtual ~MegaChildrenCursor();
+
+        virtual MegaChildrenCursor *copy();
+
+        /**
+         * @brief Returns the next window of children and advances the cursor
+         *
+         * You take the ownership of the returned value. When there are no more
+         * children, the returned list is empty.
+         *
+         * @param count Maximum number of children to return
+         * @return List with the next children
+         */
+        virtual MegaNodeList *next(int count);
+
+        /**
+         * @brief Returns the index of the next child that will be returned
+         * @return Current position of the cursor
+         */
+        virtual int getPosition();
+
+        /**
+         * @brief Moves the cursor to a specific index
+         * @param position Index of the next child to return
+         */
+        virtual void setPosition(int position);
+};
+
+/**
+ * @brief Immutable copy of a part of the node tree at one point in time
+ *
+ * All the nodes of the snapshot are copied at once, at the same sequence number of the
+ * account, so that the results of several calls are consistent with each other, which
+ * isn't the case for consecutive calls to MegaApi (e.g. MegaApi::getNumChildren and
+ * MegaApi::getChildren). Queries don't take any lock of the SDK, and the snapshot can be
+ * used from any number of threads at the same time. Changes made after its creation are
+ * not reflected.
+ *
+ * The snapshot holds a copy of every node it contains, so its size is proportional
+ * to the number of nodes.
+ *
+ * @see MegaApi::getNodeSnapshot
+ */
+class MegaNodeSnapshot
+{
+    public:
+        virtual ~MegaNodeSnapshot();
+
+        virtual MegaNodeSnapshot *copy();
+
+        /**
+         * @brief Returns the sequence number of the account when the snapshot was taken
+         *
+         * The returned value is owned by the snapshot, and valid as long as it exists.
+         *
+         * @return Sequence number, or an empty string if the nodes weren't loaded yet
+         */
+        virtual const char *getSequenceNumber();
+
+        /**
+         * @brief Returns the number of nodes in the snapshot
+         * @return Number of nodes
+         */
+        virtual int getNumNodes();
+
+        /**
+         * @brief Get a node of the snapshot by its handle
+         *
+         * You take the ownership of the returned value
+         *
+         * @param handle Handle of the node
+         * @return Node, or NULL if it isn't in the snapshot
+         */
+        virtual MegaNode *getNodeByHandle(MegaHandle handle);
+
+        /**
+         * @brief Get the parent of a node of the snapshot
+         *
+         * You take the ownership of the returned value
+         *
+         * @param node Node
+         * @return Parent node, or NULL if the node or its parent aren't in the snapshot
+         */
+        virtual MegaNode *getParentNode(MegaNode *node);
+
+        /**
+         * @brief Get the number of children of a node of the snapshot
+         * @param parent Parent node
+         * @return Number of children, 0 if the node isn't in the snapshot
+         */
+        virtual int getNumChildren(MegaNode *parent);
+
+        /**
+         * @brief Get the children of a node of the snapshot
+         *
+         * The children are in the order requested in MegaApi::getNodeSnapshot.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @return List of the children, empty if the node isn't in the snapshot
+         */
+        virtual MegaNodeList *getChildren(MegaNode *parent);
 };
 
 /**
@@ -1347,7 +1730,15 @@ class MegaRequest
             TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS, TYPE_GET_SESSION_TRANSFER_URL,
             TYPE_GET_PAYMENT_METHODS, TYPE_INVITE_CONTACT, TYPE_REPLY_CONTACT_REQUEST,
             TYPE_SUBMIT_FEEDBACK, TYPE_SEND_EVENT, TYPE_CLEAN_RUBBISH_BIN,
-            TYPE_SET_ATTR_NODE
+            TYPE_SET_ATTR_NODE, TYPE_SET_TRANSFER_PRIORITY,
+            TYPE_MOVE_TRANSFER, TYPE_PREFETCH_THUMBNAILS,
+            TYPE_MOVE_NODES, TYPE_COPY_NODES, TYPE_REMOVE_NODES,
+            TYPE_SET_ATTR_NODES
+        };
+
+        enum {
+            TIMING_QUEUED = 0, TIMING_DISPATCHED, TIMING_SENT, TIMING_RECEIVED,
+            TIMING_PROCESSED, TIMING_CALLBACK
         };
 
         virtual ~MegaRequest();
@@ -1435,6 +1826,7 @@ class MegaRequest
          * - MegaApi::removeSync - Returns the handle of the folder in MEGA
          * - MegaApi::upgradeAccount - Returns that handle of the product
          * - MegaApi::replyContactRequest - Returns the handle of the contact request
+         * - MegaApi::prefetchThumbnails - Returns the handle of the last node processed
          *
          * This value is valid for these requests in onRequestFinish when the
          * error code is MegaError::API_OK:
@@ -1730,6 +2122,7 @@ class MegaRequest
          * - MegaApi::replyContactRequest - Returns the action to do with the contact request
          * - MegaApi::inviteContact - Returns the action to do with the contact request
          * - MegaApi::sendEvent - Returns the event type
+         * - MegaApi::prefetchThumbnails - Returns the priority of the fetches
          *
          * This value is valid for these request in onRequestFinish when the
          * error code is MegaError::API_OK:
@@ -1812,6 +2205,22 @@ class MegaRequest
          */
         virtual int getNumDetails() const;
 
+        /**
+         * @brief Returns the result of a node of a bulk request
+         *
+         * This value is valid for these requests:
+         * - MegaApi::moveNodes, MegaApi::copyNodes, MegaApi::removeNodes and
+         * MegaApi::setCustomNodesAttribute - Returns the error code of the node at the
+         * position i of the list passed to the function
+         *
+         * @param i Position of the node in the list
+         * @return MegaError::API_OK if the node was processed successfully, otherwise
+         * the error code of the node (MegaError::API_EINCOMPLETE if it hasn't been
+         * processed yet). If the index is out of range, this function returns
+         * MegaError::API_EARGS.
+         */
+        virtual int getNodeErrorCode(int i) const;
+
         /**
          * @brief Returns the tag that identifies this request
          *
@@ -1820,6 +2229,31 @@ class MegaRequest
          * @return Unique tag that identifies this request
          */
         virtual int getTag() const;
+
+        /**
+         * @brief Returns the time when the request reached a phase of its processing
+         *
+         * The phases are:
+         * - TIMING_QUEUED: The request was created and queued for the SDK thread
+         * - TIMING_DISPATCHED: The SDK thread took the request from the queue (under the SDK mutex)
+         * and started it
+         * - TIMING_SENT: The API request carrying the first command of the request was sent
+         * (commands are batched with the others pending at that time)
+         * - TIMING_RECEIVED: The response to the last command of the request was received
+         * - TIMING_PROCESSED: The SDK finished the request
+         * - TIMING_CALLBACK: The onRequestFinish callbacks were called
+         *
+         * The difference between consecutive phases tells the time spent waiting for the SDK
+         * thread, batching commands, on the server and in the SDK. Requests completed without
+         * contacting the API don't have TIMING_SENT and TIMING_RECEIVED.
+         *
+         * The values are only complete in onRequestFinish.
+         *
+         * @param phase Phase of the request (TIMING_QUEUED ... TIMING_CALLBACK)
+         * @return Timestamp in microseconds, without a defined starting point, or 0 if the
+         * request hasn't reached the phase
+         */
+        virtual int64_t getTiming(int phase) const;
 };
 
 /**
@@ -1839,6 +2273,16 @@ class MegaTransfer
 	public:
         enum {TYPE_DOWNLOAD = 0,
               TYPE_UPLOAD};
+
+        enum {PRIORITY_INTERACTIVE = 0,
+              PRIORITY_NORMAL,
+              PRIORITY_BACKGROUND};
+
+        enum {TIMING_QUEUED = 0,
+              TIMING_DISPATCHED,
+              TIMING_STARTED,
+              TIMING_FINISHED,
+              TIMING_CALLBACK};
         
         virtual ~MegaTransfer();
 
@@ -2113,6 +2557,92 @@ class MegaTransfer
          * @return Tag of the associated folder transfer.
          */
         virtual int getFolderTransferTag() const;
+
+        /**
+         * @brief Returns the time when the transfer reached a phase of its processing
+         *
+         * The phases are:
+         * - TIMING_QUEUED: The transfer was created and queued for the SDK thread
+         * - TIMING_DISPATCHED: The SDK thread took the transfer from the queue
+         * - TIMING_STARTED: The transfer got a transfer slot and requested its URL
+         * - TIMING_FINISHED: The SDK finished the transfer
+         * - TIMING_CALLBACK: The onTransferFinish callbacks were called
+         *
+         * The values are only complete in onTransferFinish.
+         *
+         * @param phase Phase of the transfer (TIMING_QUEUED ... TIMING_CALLBACK)
+         * @return Timestamp in microseconds, without a defined starting point (the same as
+         * MegaRequest::getTiming), or 0 if the transfer hasn't reached the phase
+         */
+        virtual int64_t getTiming(int phase) const;
+};
+
+/**
+ * @brief Provides a summary of the progress of all active transfers
+ *
+ * MegaTransferProgress objects are provided in MegaListener::onTransfersProgress and
+ * MegaTransferListener::onTransfersProgress, at the interval set with
+ * MegaApi::setTransfersProgressInterval.
+ *
+ * Folder transfers aren't counted, only the file transfers that they start.
+ *
+ * Objects of this class aren't live, they are snapshots of the state of the transfers
+ * when the object is created, they are immutable.
+ *
+ */
+class MegaTransferProgress
+{
+    public:
+        virtual ~MegaTransferProgress();
+
+        /**
+         * @brief Creates a copy of this MegaTransferProgress object
+         *
+         * The resulting object is fully independent of the source MegaTransferProgress,
+         * it contains a copy of all internal attributes, so it will be valid after
+         * the original object is deleted.
+         *
+         * You are the owner of the returned object
+         *
+         * @return Copy of the MegaTransferProgress object
+         */
+        virtual MegaTransferProgress *copy();
+
+        /**
+         * @brief Returns the number of active transfers of a type
+         *
+         * @param type Type of the transfers
+         * Valid values for this parameter are:
+         * - MegaTransfer::TYPE_DOWNLOAD = 0
+         * - MegaTransfer::TYPE_UPLOAD = 1
+         *
+         * @return Number of active transfers
+         */
+        virtual int getNumTransfers(int type) const;
+
+        /**
+         * @brief Returns the transferred bytes of the active transfers of a type
+         *
+         * @param type Type of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @return Transferred bytes
+         */
+        virtual long long getTransferredBytes(int type) const;
+
+        /**
+         * @brief Returns the total size of the active transfers of a type
+         *
+         * @param type Type of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @return Total bytes
+         */
+        virtual long long getTotalBytes(int type) const;
+
+        /**
+         * @brief Returns the current speed of the transfers of a type
+         *
+         * @param type Type of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @return Speed in bytes per second
+         */
+        virtual long long getSpeed(int type) const;
 };
 
 /**
@@ -2473,6 +3003,17 @@ public:
      * @return State of the synchronization
      */
     virtual int getState() const;
+
+    /**
+     * @brief Get a performance statistic of the synchronization
+     *
+     * The values are those of the time this MegaSync object was created. Use
+     * MegaApi::getSyncStats to get current values.
+     *
+     * @param type Statistic to return (see MegaApi::getSyncStats)
+     * @return Value of the statistic, or -1 if the type is invalid
+     */
+    virtual long long getStats(int type) const;
 };
 
 #endif
@@ -2640,12 +3181,261 @@ class MegaTreeProcessor
 };
 
 /**
- * @brief Interface to receive information about requests
+ * @brief Read-only view of a node in the account
  *
- * All requests allows to pass a pointer to an implementation of this interface in the last parameter.
- * You can also get information about all requests using MegaApi::addRequestListener
- *
- * MegaListener objects can also receive information about requests
+ * Unlike MegaNode, a MegaNodeView doesn't copy any data: its getters read the
+ * SDK's internal node directly. Views are only handed to MegaNodeViewProcessor::processNodeView
+ * and are only valid until it returns, as are the strings they return. Use
+ * MegaNodeView::copy to get a MegaNode that can be kept.
+ *
+ * @see MegaApi::processNodeViews, MegaApi::processChildViews
+ */
+class MegaNodeView
+{
+    public:
+        virtual ~MegaNodeView();
+
+        /**
+         * @brief Creates a MegaNode with the current state of the node
+         *
+         * You take the ownership of the returned value
+         *
+         * @return Copy of the node
+         */
+        virtual MegaNode *copy();
+
+        /**
+         * @brief Returns the type of the node (see MegaNode::getType)
+         * @return Type of the node
+         */
+        virtual int getType();
+
+        /**
+         * @brief Returns the name of the node
+         *
+         * The string is only valid until MegaNodeViewProcessor::processNodeView returns.
+         *
+         * @return Name of the node
+         */
+        virtual const char *getName();
+
+        /**
+         * @brief Returns the handle of the node
+         * @return Handle of the node
+         */
+        virtual MegaHandle getHandle();
+
+        /**
+         * @brief Returns the handle of the parent node
+         * @return Handle of the parent node, or INVALID_HANDLE for root nodes
+         */
+        virtual MegaHandle getParentHandle();
+
+        /**
+         * @brief Returns the size of the node (0 for folders)
+         * @return Size of the node
+         */
+        virtual int64_t getSize();
+
+        /**
+         * @brief Returns the creation time of the node in MEGA (in seconds since the epoch)
+         * @return Creation time of the node
+         */
+        virtual int64_t getCreationTime();
+
+        /**
+         * @brief Returns the modification time of the file that was uploaded (in seconds since the epoch)
+         * @return Modification time of the file
+         */
+        virtual int64_t getModificationTime();
+
+        /**
+         * @brief Returns the fingerprint of a file node (as returned by MegaApi::getFingerprint)
+         *
+         * The string is only valid until MegaNodeViewProcessor::processNodeView returns.
+         *
+         * @return Fingerprint of the file, or NULL for folders and files without a valid fingerprint
+         */
+        virtual const char *getFingerprint();
+
+        /**
+         * @brief Returns true if this node represents a file
+         * @return true if the node is a file
+         */
+        virtual bool isFile();
+
+        /**
+         * @brief Returns true if this node represents a folder or a root node
+         * @return true if the node is a folder or a root node
+         */
+        virtual bool isFolder();
+
+        /**
+         * @brief Returns true if the node has an associated thumbnail
+         * @return true if the node has an associated thumbnail
+         */
+        virtual bool hasThumbnail();
+
+        /**
+         * @brief Returns true if the node has an associated preview
+         * @return true if the node has an associated preview
+         */
+        virtual bool hasPreview();
+};
+
+/**
+ * @brief Interface to process node trees without copying the nodes
+ *
+ * An implementation of this class can be used to process a node tree passing a pointer to
+ * MegaApi::processNodeViews or MegaApi::processChildViews
+ *
+ * The callbacks are made synchronously, in the caller's thread, while the SDK holds its lock;
+ * they must not call MegaApi functions that modify the account or wait for other threads
+ * that do.
+ */
+class MegaNodeViewProcessor
+{
+    public:
+        /**
+         * @brief Function that will be called for all nodes being processed
+         * @param node View of the node, only valid during this call
+         * @return true to continue processing nodes, false to stop
+         */
+        virtual bool processNodeView(MegaNodeView* node);
+        virtual ~MegaNodeViewProcessor();
+};
+
+/**
+ * @brief Conditions on the nodes returned by MegaApi::queryNodes
+ *
+ * A node matches if it meets all the conditions that have been set. A new
+ * MegaNodeQuery has no conditions and matches every node.
+ */
+class MegaNodeQuery
+{
+public:
+    enum {
+        SHARE_ANY = 0,
+        SHARE_NONE = 1,
+        SHARE_OUTSHARE = 2,
+        SHARE_INSHARE = 3,
+        SHARE_EXPORTED = 4
+    };
+
+    MegaNodeQuery();
+    virtual ~MegaNodeQuery();
+
+    /**
+     * @brief Only match nodes of a type
+     * @param type MegaNode::TYPE_FILE, MegaNode::TYPE_FOLDER or -1 for any type (default)
+     */
+    void setType(int type);
+
+    /**
+     * @brief Only match nodes whose name matches a string
+     * @param name String to match, or NULL to match any name (default)
+     * @param matchType How the string is matched (MegaApi::SEARCH_SUBSTRING,
+     * MegaApi::SEARCH_PREFIX or MegaApi::SEARCH_EXTENSION)
+     */
+    void setName(const char *name, int matchType);
+
+    /**
+     * @brief Only match files with a size in a range
+     *
+     * Folders never match a size range.
+     *
+     * @param minSize Minimum size in bytes, or -1 for no minimum
+     * @param maxSize Maximum size in bytes, or -1 for no maximum
+     */
+    void setSizeRange(int64_t minSize, int64_t maxSize);
+
+    /**
+     * @brief Only match nodes created in a time range
+     * @param from Minimum creation time (in seconds since the epoch), or -1 for no minimum
+     * @param to Maximum creation time (in seconds since the epoch), or -1 for no maximum
+     */
+    void setCreationTimeRange(int64_t from, int64_t to);
+
+    /**
+     * @brief Only match files modified in a time range
+     *
+     * Folders never match a modification time range.
+     *
+     * @param from Minimum modification time (in seconds since the epoch), or -1 for no minimum
+     * @param to Maximum modification time (in seconds since the epoch), or -1 for no maximum
+     */
+    void setModificationTimeRange(int64_t from, int64_t to);
+
+    /**
+     * @brief Only match nodes with or without a thumbnail
+     * @param thumbnail 1 to require a thumbnail, 0 to require no thumbnail, -1 for either (default)
+     */
+    void setThumbnail(int thumbnail);
+
+    /**
+     * @brief Only match nodes with or without a preview
+     * @param preview 1 to require a preview, 0 to require no preview, -1 for either (default)
+     */
+    void setPreview(int preview);
+
+    /**
+     * @brief Only match nodes in a sharing state
+     *
+     * Valid values are:
+     * - SHARE_ANY = 0 (default)
+     * - SHARE_NONE = 1: nodes that are not shared nor exported themselves
+     * - SHARE_OUTSHARE = 2: nodes shared with other users
+     * - SHARE_INSHARE = 3: root nodes of incoming shares
+     * - SHARE_EXPORTED = 4: nodes with a public link
+     *
+     * @param shareState Sharing state to match
+     */
+    void setShareState(int shareState);
+
+    /**
+     * @brief Only match the children of the queried node, not the whole subtree (default false)
+     * @param childrenOnly True to only match the children of the queried node
+     */
+    void setChildrenOnly(bool childrenOnly);
+
+    int getType();
+    const char *getName();
+    int getMatchType();
+    int64_t getMinSize();
+    int64_t getMaxSize();
+    int64_t getMinCreationTime();
+    int64_t getMaxCreationTime();
+    int64_t getMinModificationTime();
+    int64_t getMaxModificationTime();
+    int getThumbnail();
+    int getPreview();
+    int getShareState();
+    bool isChildrenOnly();
+
+private:
+    int type;
+    std::string name;
+    bool hasName;
+    int matchType;
+    int64_t minSize;
+    int64_t maxSize;
+    int64_t minCtime;
+    int64_t maxCtime;
+    int64_t minMtime;
+    int64_t maxMtime;
+    int thumbnail;
+    int preview;
+    int shareState;
+    bool childrenOnly;
+};
+
+/**
+ * @brief Interface to receive information about requests
+ *
+ * All requests allows to pass a pointer to an implementation of this interface in the last parameter.
+ * You can also get information about all requests using MegaApi::addRequestListener
+ *
+ * MegaListener objects can also receive information about requests
  *
  * This interface uses MegaRequest objects to provide information of requests. Take into account that not all
  * fields of MegaRequest objects are valid for all requests. See the documentation about each request to know
@@ -2806,6 +3596,20 @@ class MegaTransferListener
          */
         virtual void onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError* error);
 
+        /**
+         * @brief This function is called periodically with a summary of the active transfers
+         *
+         * It is only called if an interval has been set with MegaApi::setTransfersProgressInterval,
+         * while there are active transfers.
+         *
+         * The SDK retains the ownership of the progress parameter.
+         * Don't use it after this functions returns.
+         *
+         * @param api MegaApi object that is running the transfers
+         * @param progress Summary of the active transfers
+         */
+        virtual void onTransfersProgress(MegaApi *api, MegaTransferProgress *progress);
+
         virtual ~MegaTransferListener();
 
         /**
@@ -2829,6 +3633,32 @@ class MegaTransferListener
          * @see MegaApi::startStreaming
          */
         virtual bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size);
+
+        /**
+         * @brief This function is called when data of a streaming download started with
+         * MegaApi::startStreamingToBuffers has been placed into one of its buffers
+         *
+         * The buffer is lent to the app: the SDK won't write into it again until it is released
+         * with MegaApi::releaseStreamingBuffer, so the data can be consumed later and from
+         * any thread without copying it. Buffers are filled in order and MegaTransferListener::onTransferData
+         * is not called for these transfers.
+         *
+         * The SDK retains the ownership of the transfer parameter.
+         * Don't use it after this functions returns.
+         *
+         * @param api MegaApi object that started the transfer
+         * @param transfer Information about the transfer
+         * @param buffer Index of the buffer
+         * @param bufferData Start of the data, at the beginning of the buffer. The Java bindings
+         * provide it as a direct java.nio.ByteBuffer and the Python bindings as a read-only memoryview,
+         * both wrapping the memory of the buffer without copying it, so they must not be used
+         * after the buffer is released
+         * @param position Offset of the data in the file
+         * @param size Number of bytes of data
+         *
+         * @see MegaApi::startStreamingToBuffers
+         */
+        virtual void onTransferBuffer(MegaApi *api, MegaTransfer *transfer, int buffer, char *bufferData, long long position, size_t size);
 };
 
 /**
@@ -2862,6 +3692,9 @@ class MegaGlobalListener
          * When the full account is reloaded or a large number of server notifications arrives at once, the
          * second parameter will be NULL.
          *
+         * When a folder is removed, only the folder itself is reported (with MegaNode::CHANGE_TYPE_REMOVED).
+         * Its files and subfolders are removed with it and are not reported individually.
+         *
          * The SDK retains the ownership of the MegaNodeList in the second parameter. The list and all the
          * MegaNode objects that it contains will be valid until this function returns. If you want to save the
          * list, use MegaNodeList::copy. If you want to save only some of the MegaNode objects, use MegaNode::copy
@@ -3066,6 +3899,20 @@ class MegaListener
          */
         virtual void onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError* error);
 
+        /**
+         * @brief This function is called periodically with a summary of the active transfers
+         *
+         * It is only called if an interval has been set with MegaApi::setTransfersProgressInterval,
+         * while there are active transfers.
+         *
+         * The SDK retains the ownership of the progress parameter.
+         * Don't use it after this functions returns.
+         *
+         * @param api MegaApi object that is running the transfers
+         * @param progress Summary of the active transfers
+         */
+        virtual void onTransfersProgress(MegaApi *api, MegaTransferProgress *progress);
+
         /**
          * @brief This function is called when there are new or updated contacts in the account
          *
@@ -3085,6 +3932,9 @@ class MegaListener
          * When the full account is reloaded or a large number of server notifications arrives at once, the
          * second parameter will be NULL.
          *
+         * When a folder is removed, only the folder itself is reported (with MegaNode::CHANGE_TYPE_REMOVED).
+         * Its files and subfolders are removed with it and are not reported individually.
+         *
          * The SDK retains the ownership of the MegaNodeList in the second parameter. The list and all the
          * MegaNode objects that it contains will be valid until this function returns. If you want to save the
          * list, use MegaNodeList::copy. If you want to save only some of the MegaNode objects, use MegaNode::copy
@@ -3194,6 +4044,30 @@ public:
     virtual ~MegaInputStream();
 };
 
+/**
+ * @brief Destination of a download that doesn't use the local filesystem
+ *
+ * @see MegaApi::startDownloadToStream
+ */
+class MegaOutputStream
+{
+public:
+    /**
+     * @brief Receive the next part of the downloaded file
+     *
+     * Parts arrive decrypted and in file order, starting at the beginning of the file.
+     * This function is called from the SDK thread, so it shouldn't block. The buffer
+     * is only valid until this function returns.
+     *
+     * @param buffer Data of the file
+     * @param size Size of the data in bytes
+     * @return true to continue, false to cancel the download. In that case, it finishes
+     * with the error code MegaError::API_EWRITE
+     */
+    virtual bool write(const char *buffer, size_t size);
+    virtual ~MegaOutputStream();
+};
+
 class MegaApiImpl;
 
 /**
@@ -3244,6 +4118,11 @@ class MegaApi
             ATTR_TYPE_PREVIEW = 1
         };
 
+        enum {
+            PREFETCH_PRIORITY_BACKGROUND = 0,
+            PREFETCH_PRIORITY_NORMAL = 1
+        };
+
         enum {
             USER_ATTR_AVATAR = 0,
             USER_ATTR_FIRSTNAME = 1,
@@ -3272,6 +4151,86 @@ class MegaApi
             TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
         };
 
+        enum {
+            MEMORY_TOTAL = 0,
+            MEMORY_NODES = 1,
+            MEMORY_NODE_INDEX = 2,
+            MEMORY_FINGERPRINTS = 3,
+            MEMORY_ATTRIBUTES = 4,
+            MEMORY_STRINGS = 5,
+            MEMORY_CHILDREN = 6,
+            MEMORY_SHARING = 7
+        };
+
+        enum {
+            BUFFER_POOL_REQUESTS = 0,
+            BUFFER_POOL_HITS = 1,
+            BUFFER_POOL_IN_USE = 2,
+            BUFFER_POOL_IDLE = 3,
+            BUFFER_POOL_PEAK = 4
+        };
+
+        enum {
+            STREAMING_CACHE_HITS = 0,
+            STREAMING_CACHE_MISSES = 1,
+            STREAMING_CACHE_SIZE = 2
+        };
+
+        enum {
+            KEY_STATS_RSA_DECRYPTIONS = 0,
+            KEY_STATS_RSA_PARALLEL = 1,
+            KEY_STATS_RSA_CACHE_HITS = 2,
+            KEY_STATS_TIME = 3
+        };
+
+        enum {
+            LOW_MEMORY_MODERATE = 1,
+            LOW_MEMORY_CRITICAL = 2
+        };
+
+        enum {
+            SYNC_STATS_NOTIFICATIONS_PENDING = 0,
+            SYNC_STATS_SCANNED = 1,
+            SYNC_STATS_SCAN_TIME = 2,
+            SYNC_STATS_FULL_SCANS = 3,
+            SYNC_STATS_FULL_SCAN_DURATION = 4,
+            SYNC_STATS_FILES = 5,
+            SYNC_STATS_FOLDERS = 6,
+            SYNC_STATS_PUTNODES_PENDING = 7,
+            SYNC_STATS_UPLOADS = 8,
+            SYNC_STATS_DOWNLOADS = 9,
+            SYNC_STATS_LOCAL_DEBRIS = 10,
+            SYNC_STATS_REMOTE_DEBRIS = 11,
+            SYNC_STATS_SYNCDOWN_PASSES = 12,
+            SYNC_STATS_SYNCDOWN_TIME = 13,
+            SYNC_STATS_SYNCDOWN_LAST = 14,
+            SYNC_STATS_SYNCDOWN_MAX = 15,
+            SYNC_STATS_SYNCUP_PASSES = 16,
+            SYNC_STATS_SYNCUP_TIME = 17,
+            SYNC_STATS_SYNCUP_LAST = 18,
+            SYNC_STATS_SYNCUP_MAX = 19
+        };
+
+        enum {
+            COMPRESSION_STATS_SENT_SAVED = 0,
+            COMPRESSION_STATS_RECEIVED_SAVED = 1
+        };
+
+        enum {
+            CALLBACK_STATS_QUEUED = 0,
+            CALLBACK_STATS_MAX_QUEUED = 1,
+            CALLBACK_STATS_DELIVERED = 2,
+            CALLBACK_STATS_BACKPRESSURE_WAITS = 3,
+            CALLBACK_STATS_LISTENER_TIME = 4,
+            CALLBACK_STATS_LISTENER_TIME_MAX = 5,
+            CALLBACK_STATS_DELAY_MAX = 6
+        };
+
+        enum {
+            EVENT_BACKEND_SELECT = 0,
+            EVENT_BACKEND_NATIVE = 1
+        };
+
         /**
          * @brief Constructor suitable for most applications
          * @param appKey AppKey of your application
@@ -3519,6 +4478,22 @@ class MegaApi
          */
         char* getBase64PwKey(const char *password);
 
+        /**
+         * @brief Generates the private keys of several passwords
+         *
+         * Like MegaApi::getBase64PwKey, for many passwords at once, spread over the given
+         * number of threads. This function blocks until all keys are ready, run it in a
+         * background thread.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param passwords Access passwords
+         * @param threads Number of threads to use
+         * @return Base64-encoded private keys, in the order of the passwords (an empty
+         * string for a password that could not be processed)
+         */
+        MegaStringList *getBase64PwKeys(MegaStringList *passwords, int threads = 4);
+
         /**
          * @brief Generates a hash based in the provided private key and email
          *
@@ -3633,6 +4608,25 @@ class MegaApi
          */
         void retryPendingConnections(bool disconnect = false, bool includexfers = false, MegaRequestListener* listener = NULL);
 
+        /**
+         * @brief Batch non-urgent network requests to save energy on mobile networks
+         *
+         * Each network request keeps the radio of a mobile device in a high-power state for
+         * several seconds. In batched network mode, requests that are not urgent are held back
+         * until other traffic wakes up the radio anyway, or until they have waited for the
+         * specified time, so that they share that wakeup.
+         *
+         * These requests are considered non-urgent:
+         * - Events (MegaApi::sendEvent and the reports of the SDK)
+         * - Thumbnail prefetches with MegaApi::PREFETCH_PRIORITY_BACKGROUND
+         *
+         * Other requests are sent immediately, and they take the held back ones with them.
+         *
+         * @param maxDelayMs Maximum time to hold back non-urgent requests in milliseconds,
+         * 0 to disable the batched network mode (default)
+         */
+        void setNetworkBatching(int maxDelayMs);
+
         /**
          * @brief Log in to a MEGA account
          *
@@ -3697,6 +4691,24 @@ class MegaApi
          */
         void fastLogin(const char* session, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Start sessions from the local cache without network access
+         *
+         * With this option, MegaApi::fastLogin with a session that has a local cache finishes
+         * right away, without contacting MEGA, and MegaApi::fetchNodes then loads the cached
+         * nodes, so that they can be browsed even without connectivity. The session is verified
+         * and the nodes are updated in the background as soon as MEGA can be reached. If the
+         * session was closed in the meantime, the SDK logs out at that point.
+         *
+         * The keys needed to open the cache without MEGA are stored in it after each complete
+         * login with this option enabled. They are protected by the session key only, so anyone
+         * with the session key and the files of the local cache can decrypt the cache. Disabling
+         * the option removes them upon the next login.
+         *
+         * @param enable True to start sessions from the local cache, false otherwise (default)
+         */
+        void setOfflineStartup(bool enable);
+
         /**
          * @brief Close a MEGA session
          *
@@ -3978,6 +4990,50 @@ class MegaApi
          */
         static void setLoggerObject(MegaLogger *megaLogger);
 
+        /**
+         * @brief Deliver logs to the MegaLogger on a thread of its own
+         *
+         * By default, MegaLogger::log is called on the thread that generates each log, so
+         * a slow logger delays the SDK. When enabled, logs are queued and delivered in the
+         * same order on a dedicated thread. If more than maxQueued logs are waiting, new ones
+         * are dropped, and the logger receives a warning with the number of dropped logs
+         * before the next delivered one. Fatal logs are always delivered synchronously.
+         *
+         * When disabled, this function waits until the queued logs have been delivered.
+         * It must not be called from MegaLogger::log.
+         *
+         * @param enable True to deliver logs on a dedicated thread
+         * @param maxQueued Maximum number of logs waiting to be delivered
+         */
+        static void setAsyncLogging(bool enable, int maxQueued = 10000);
+
+        /**
+         * @brief Get the number of logs dropped because the queue of MegaApi::setAsyncLogging was full
+         * @return Number of dropped logs
+         */
+        static long long getDroppedLogs();
+
+        /**
+         * @brief Set the mechanism used to wait for network and filesystem events
+         *
+         * MegaApi::EVENT_BACKEND_NATIVE uses epoll on Linux and kqueue on macOS and BSD,
+         * which keeps sockets registered between iterations of the SDK loop and is not
+         * limited to 1024 file descriptors. It is recommended for applications with many
+         * concurrent transfers. On Windows, it uses an I/O completion port, which is not
+         * limited to 64 wait handles per iteration. On other platforms, or if the native
+         * mechanism can't be initialized, the SDK keeps using select() (or
+         * WaitForMultipleObjectsEx() on Windows).
+         *
+         * This setting only applies to MegaApi objects created after the call.
+         *
+         * @param backend Event backend
+         *
+         * These are the valid values for this parameter:
+         * - MegaApi::EVENT_BACKEND_SELECT = 0 (default)
+         * - MegaApi::EVENT_BACKEND_NATIVE = 1
+         */
+        static void setEventBackend(int backend);
+
         /**
          * @brief Send a log to the logging system
          *
@@ -4026,6 +5082,29 @@ class MegaApi
          */
         void moveNode(MegaNode* node, MegaNode* newParent, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Move a list of nodes to the same folder
+         *
+         * All the nodes are checked at once and moved with a single request, much faster
+         * than calling MegaApi::moveNode for each of them. Nodes that are already in the
+         * new parent succeed without changes.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_MOVE_NODES
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getParentHandle - Returns the handle of the new parent for the nodes
+         * - MegaRequest::getTotalBytes - Returns the number of nodes
+         * - MegaRequest::getTransferredBytes - Returns the number of nodes processed so far
+         * - MegaRequest::getNumDetails - Returns the number of nodes that failed
+         *
+         * The request finishes with MegaError::API_OK once all nodes have been processed, the
+         * result of each node is available with MegaRequest::getNodeErrorCode.
+         *
+         * @param nodes Nodes to move
+         * @param newParent New parent for the nodes
+         * @param listener MegaRequestListener to track this request
+         */
+        void moveNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Copy a node in the MEGA account
          *
@@ -4072,11 +5151,35 @@ class MegaApi
         void copyNode(MegaNode* node, MegaNode *newParent, const char* newName, MegaRequestListener *listener = NULL);
 
         /**
-         * @brief Rename a node in the MEGA account
+         * @brief Copy a list of nodes to the same folder
          *
-         * The associated request type with this request is MegaRequest::TYPE_RENAME
+         * The trees of all the nodes are created in the new parent with a single request
+         * (split in several commands for very large trees only). Nodes that are inside
+         * another node of the list are copied with it and fail with MegaError::API_EARGS on
+         * their own.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_COPY_NODES
          * Valid data in the MegaRequest object received on callbacks:
-         * - MegaRequest::getNodeHandle - Returns the handle of the node to rename
+         * - MegaRequest::getParentHandle - Returns the handle of the new parent for the nodes
+         * - MegaRequest::getTotalBytes - Returns the number of nodes
+         * - MegaRequest::getTransferredBytes - Returns the number of nodes processed so far
+         * - MegaRequest::getNumDetails - Returns the number of nodes that failed
+         *
+         * The request finishes with MegaError::API_OK once all nodes have been processed, the
+         * result of each node is available with MegaRequest::getNodeErrorCode.
+         *
+         * @param nodes Nodes to copy
+         * @param newParent Parent for the new nodes
+         * @param listener MegaRequestListener to track this request
+         */
+        void copyNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Rename a node in the MEGA account
+         *
+         * The associated request type with this request is MegaRequest::TYPE_RENAME
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNodeHandle - Returns the handle of the node to rename
          * - MegaRequest::getName - Returns the new name for the node
          *
          * @param node Node to modify
@@ -4100,6 +5203,27 @@ class MegaApi
          */
         void remove(MegaNode* node, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Remove a list of nodes from the MEGA account
+         *
+         * Like MegaApi::remove, the nodes are fully removed, not moved to the Rubbish Bin.
+         * All of them are checked at once and removed with a single request. Nodes that are
+         * inside another node of the list are removed with it and succeed on their own.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_REMOVE_NODES
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTotalBytes - Returns the number of nodes
+         * - MegaRequest::getTransferredBytes - Returns the number of nodes processed so far
+         * - MegaRequest::getNumDetails - Returns the number of nodes that failed
+         *
+         * The request finishes with MegaError::API_OK once all nodes have been processed, the
+         * result of each node is available with MegaRequest::getNodeErrorCode.
+         *
+         * @param nodes Nodes to remove
+         * @param listener MegaRequestListener to track this request
+         */
+        void removeNodes(MegaNodeList *nodes, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Clean the Rubbish Bin in the MEGA account
          *
@@ -4395,6 +5519,44 @@ class MegaApi
          */
         void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Fetch the thumbnails of a list of nodes into the local cache
+         *
+         * The thumbnails are requested in batches per storage cluster and stored in the
+         * local file attribute cache, so that later calls to MegaApi::getThumbnail for these
+         * nodes are served locally. The local cache is only available when a base path was
+         * passed to the constructor of MegaApi, otherwise the request fails with
+         * MegaError::API_EACCESS.
+         *
+         * Nodes without a thumbnail and nodes whose thumbnail is already being fetched are
+         * skipped.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_PREFETCH_THUMBNAILS
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getNumber - Returns the priority
+         * - MegaRequest::getTotalBytes - Returns the number of thumbnails to fetch
+         * - MegaRequest::getTransferredBytes - Returns the number of thumbnails processed so far
+         * - MegaRequest::getNumDetails - Returns the number of thumbnails that failed
+         *
+         * Valid data in the MegaRequest object received in onRequestUpdate, which is called
+         * once per thumbnail:
+         * - MegaRequest::getNodeHandle - Returns the handle of the node
+         * - MegaRequest::getFlag - Returns true if the thumbnail is now in the cache, false
+         * if it could not be fetched
+         *
+         * onRequestFinish is called once all thumbnails have been processed.
+         *
+         * @param nodes Nodes to fetch the thumbnails
+         * @param priority Priority of the fetches. Valid values are:
+         * - MegaApi::PREFETCH_PRIORITY_BACKGROUND = 0
+         * The thumbnails are fetched after those requested in any other way
+         * - MegaApi::PREFETCH_PRIORITY_NORMAL = 1
+         * The thumbnails are fetched like those requested with MegaApi::getThumbnail
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void prefetchThumbnails(MegaNodeList *nodes, int priority = PREFETCH_PRIORITY_BACKGROUND, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Set the thumbnail of a MegaNode
          *
@@ -4480,6 +5642,31 @@ class MegaApi
          */
         void setCustomNodeAttribute(MegaNode *node, const char *attrName, const char* value,  MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Set a custom attribute for a list of nodes
+         *
+         * The attribute is set like with MegaApi::setCustomNodeAttribute, for all the nodes
+         * with a single request.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_SET_ATTR_NODES
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getName - Returns the name of the custom attribute
+         * - MegaRequest::getText - Returns the text for the attribute
+         * - MegaRequest::getTotalBytes - Returns the number of nodes
+         * - MegaRequest::getTransferredBytes - Returns the number of nodes processed so far
+         * - MegaRequest::getNumDetails - Returns the number of nodes that failed
+         *
+         * The request finishes with MegaError::API_OK once all nodes have been processed, the
+         * result of each node is available with MegaRequest::getNodeErrorCode.
+         *
+         * @param nodes Nodes that will receive the attribute
+         * @param attrName Name of the custom attribute.
+         * The length of this parameter must be between 1 and 7 UTF8 bytes
+         * @param value Value for the attribute (NULL to remove it)
+         * @param listener MegaRequestListener to track this request
+         */
+        void setCustomNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Generate a public link of a file/folder in MEGA
          *
@@ -4538,10 +5725,36 @@ class MegaApi
          *
          * The associated request type with this request is MegaRequest::TYPE_FETCH_NODES
          *
+         * While the nodes are being received, MegaRequestListener::onRequestUpdate reports the
+         * progress of the download. When the response is processed as it arrives, one of these
+         * updates has MegaRequest::getFlag set to true as soon as the root node (or the root,
+         * inbox and rubbish bin of an account) is available. From then on, the upper levels of
+         * the tree can be browsed (MegaApi::getRootNode, MegaApi::getChildren...) while the rest
+         * of the nodes keep being added, until MegaRequestListener::onRequestFinish is received.
+         * Nodes in incoming shares may be missing or undecryptable until then.
+         *
          * @param listener MegaRequestListener to track this request
          */
         void fetchNodes(MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Keep only part of the file nodes in memory
+         *
+         * In paged mode, the nodes are kept in the local cache and at most 100000 file nodes
+         * stay in memory. The others are loaded again when they are accessed by handle, by
+         * fingerprint or by listing their folder. It has to be enabled before MegaApi::fetchNodes.
+         *
+         * For public folders (MegaApi::loginToFolder), the file nodes are moved out of memory
+         * while the folder is still being received, so that huge folders can be opened with
+         * little memory. As with accounts, the upper levels can be browsed as soon as
+         * MegaRequestListener::onRequestUpdate reports them; until the request finishes,
+         * MegaApi::getNodeByHandle does not find the file nodes that were moved out of memory
+         * (MegaApi::getChildren does).
+         *
+         * @param enable True to enable paged mode, false to disable it (default)
+         */
+        void setNodePaging(bool enable);
+
         /**
          * @brief Get details about the MEGA account
          *
@@ -4573,6 +5786,24 @@ class MegaApi
          */
         void getExtendedAccountDetails(bool sessions = false, bool purchases = false, bool transactions = false, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Set how long account details are served from a local cache
+         *
+         * The storage, transfer and Pro details obtained by MegaApi::getAccountDetails (and by
+         * MegaApi::getExtendedAccountDetails without sessions, purchases and transactions)
+         * are kept, and later calls within this time finish with them without contacting MEGA.
+         * The storage used by the account and by its root nodes is kept current from the
+         * local tree in the meantime. Transfer quota figures are as they were fetched.
+         *
+         * The cache is dropped when a payment is received (MegaGlobalListener::onAccountUpdate),
+         * when a transfer fails with MegaError::API_EOVERQUOTA and on logout.
+         *
+         * The default is 60 seconds.
+         *
+         * @param seconds Time to serve cached account details, 0 to always fetch them
+         */
+        void setAccountDetailsCacheTtl(int seconds);
+
         /**
          * @brief Get the available pricing plans to upgrade a MEGA account
          *
@@ -4935,6 +6166,52 @@ class MegaApi
          */
         void startUpload(const char* localPath, MegaNode* parent, const char* fileName, int64_t mtime, MegaTransferListener *listener = NULL);
 
+        /**
+         * @brief Upload a file whose fingerprint is already known
+         *
+         * Before an upload starts, the SDK reads the file to fingerprint it. An app that has
+         * just fingerprinted the file with MegaApi::getFingerprint (for example, to look for
+         * it in the account with MegaApi::getNodeByFingerprint) can pass that fingerprint
+         * here so that the file isn't read twice.
+         *
+         * The fingerprint is trusted as long as the size and the modification time of the
+         * file match it. Otherwise, or if it can't be parsed, the file is fingerprinted
+         * again as usual.
+         *
+         * @param localPath Local path of the file
+         * @param parent Parent node for the file in the MEGA account
+         * @param fingerprint Fingerprint of the local file as returned by MegaApi::getFingerprint
+         * @param fileName Custom file name for the file in MEGA, or NULL to use the local one
+         * @param mtime Custom modification time for the file in MEGA (in seconds since the epoch),
+         * or -1 to use the local one
+         * @param listener MegaTransferListener to track this transfer
+         */
+        void startUploadWithFingerprint(const char* localPath, MegaNode* parent, const char* fingerprint,
+                                        const char* fileName = NULL, int64_t mtime = -1,
+                                        MegaTransferListener *listener = NULL);
+
+        /**
+         * @brief Upload a batch of files and folders
+         *
+         * This is equivalent to calling MegaApi::startUpload for every upload in the batch,
+         * but the SDK handles the whole batch at once: the files are fingerprinted in
+         * parallel without blocking other operations and all transfers are started
+         * together.
+         *
+         * If copyDuplicates is true, files whose fingerprint matches a file already in the
+         * account aren't uploaded again. The existing file is copied to the target folder
+         * instead (or left as is if it's already there with the same name) and the transfer
+         * finishes when the copy does.
+         *
+         * Every upload in the batch is reported as a separate MegaTransfer.
+         *
+         * @param uploads Uploads to start. The SDK doesn't take the ownership of this object.
+         * @param copyDuplicates True to copy files that already exist in the account instead
+         * of uploading them
+         * @param listener MegaTransferListener to track these transfers
+         */
+        void startUploads(MegaUploadBatch *uploads, bool copyDuplicates = false, MegaTransferListener *listener = NULL);
+
         /**
          * @brief Download a file from MEGA
          * @param node MegaNode that identifies the file
@@ -4943,10 +6220,39 @@ class MegaApi
          * in MEGA will be used to store a file inside that folder. If the path doesn't finish with
          * one of these characters, the file will be downloaded to a file in that path.
          *
+         * If the node is a folder, the whole tree is downloaded as a single folder transfer
+         * (see MegaTransfer::isFolderTransfer) that reports the aggregated progress of its files.
+         * The local folders are created first, then the files are downloaded, smallest first.
+         * Each file is also reported as a separate MegaTransfer with
+         * MegaTransfer::getFolderTransferTag set to the tag of the folder transfer.
+         *
          * @param listener MegaTransferListener to track this transfer
          */
         void startDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
 
+        /**
+         * @brief Download a file from MEGA to a stream
+         *
+         * The file is downloaded like with MegaApi::startDownload (with the same parallel
+         * connections, retries and progress reports), but its data is passed to the stream
+         * instead of being written to a local file. No temporary file is created.
+         *
+         * The integrity of the file can only be verified once all of its data has been
+         * received, so the data passed to the stream must be considered untrusted until
+         * the transfer finishes with MegaError::API_OK. If it finishes with any other error
+         * code (for example, MegaError::API_EKEY if the verification fails), the data
+         * received so far must be discarded.
+         *
+         * After a temporary error, the download resumes where the stream left off, so the
+         * stream never receives the same data twice.
+         *
+         * @param node MegaNode that identifies the file (folders aren't supported)
+         * @param stream Destination of the data. The SDK doesn't take the ownership of this
+         * object, which must remain valid until MegaTransferListener::onTransferFinish is called.
+         * @param listener MegaTransferListener to track this transfer
+         */
+        void startDownloadToStream(MegaNode* node, MegaOutputStream* stream, MegaTransferListener *listener = NULL);
+
         /**
          * @brief Start an streaming download
          *
@@ -4966,6 +6272,109 @@ class MegaApi
          */
         void startStreaming(MegaNode* node, int64_t startPos, int64_t size, MegaTransferListener *listener);
 
+        /**
+         * @brief Start an streaming download into a ring of buffers
+         *
+         * The downloaded data is placed into the buffers and each filled buffer is lent to the
+         * MegaTransferListener passed to this function with MegaTransferListener::onTransferBuffer,
+         * until it is returned with MegaApi::releaseStreamingBuffer. Bindings can wrap the
+         * buffers once (for example, in direct byte buffers) instead of copying every chunk.
+         *
+         * Progress is reported separately with MegaTransferListener::onTransferUpdate, at most
+         * once per second, and MegaTransfer::getLastBytes is not available for these transfers.
+         *
+         * While all buffers are lent, received data waits in an internal buffer, so the
+         * transfer finishes only after all data has been placed into buffers. Buffers that
+         * are still lent when the transfer finishes remain valid until they are released.
+         *
+         * @param node MegaNode that identifies the file (public nodes aren't supported yet)
+         * @param startPos First byte to download from the file
+         * @param size Size of the data to download
+         * @param buffers Array of numBuffers buffers of bufferSize bytes provided by the app,
+         * which must keep them valid until they are all released after the transfer finishes,
+         * or NULL to use buffers allocated by the SDK
+         * @param numBuffers Number of buffers
+         * @param bufferSize Size of each buffer
+         * @param listener MegaTransferListener to track this transfer
+         */
+        void startStreamingToBuffers(MegaNode* node, int64_t startPos, int64_t size, char **buffers, int numBuffers, size_t bufferSize, MegaTransferListener *listener);
+
+        /**
+         * @brief Return a buffer lent by MegaTransferListener::onTransferBuffer
+         *
+         * The SDK can reuse the buffer once this function returns.
+         *
+         * @param transferTag Tag of the transfer (MegaTransfer::getTag)
+         * @param buffer Index of the buffer
+         */
+        void releaseStreamingBuffer(int transferTag, int buffer);
+
+        /**
+         * @brief Open a file for random access reads
+         *
+         * You take the ownership of the returned value. Delete it to close the file.
+         *
+         * @param node MegaNode that identifies the file
+         * @return Open file, or NULL if the node is not a file of the account or a public node
+         *
+         * @see MegaApi::readFile
+         */
+        MegaFileHandle *openFile(MegaNode *node);
+
+        /**
+         * @brief Read a range of an open file
+         *
+         * The read is reported like a streaming download (MegaApi::startStreaming): the data
+         * arrives in MegaTransferListener::onTransferData and the read ends with
+         * MegaTransferListener::onTransferFinish.
+         *
+         * Identical reads (same offset and size) started while another is waiting for its
+         * first data are served by the same request. The listeners joining that way don't
+         * receive MegaTransferListener::onTransferStart if the read had already started,
+         * and returning false in MegaTransferListener::onTransferData only stops the data to
+         * that listener, the read is aborted when no listener wants more.
+         *
+         * @param file Open file (MegaApi::openFile)
+         * @param offset First byte to read
+         * @param size Number of bytes to read
+         * @param listener MegaTransferListener to receive the data
+         */
+        void readFile(MegaFileHandle *file, int64_t offset, int64_t size, MegaTransferListener *listener);
+
+        /**
+         * @brief Hint that a range of a file will be read soon
+         *
+         * The SDK fetches the range into the streaming cache (MegaApi::setStreamingCacheSize)
+         * and gets the download URL of the file ready, so that a later streaming download or
+         * MegaApi::readFile of the range starts without delay. Nothing is reported to the app.
+         *
+         * The hint is ignored if the streaming cache is disabled, and at most half of the cache
+         * size is prefetched. Parts of the range that are already cached are not fetched again.
+         *
+         * Prefetches with MegaTransfer::PRIORITY_BACKGROUND only use connections that no
+         * streaming download or read is waiting for, other priorities compete with them.
+         *
+         * @param node MegaNode that identifies the file
+         * @param offset First byte of the range
+         * @param size Number of bytes of the range
+         * @param priority MegaTransfer::PRIORITY_INTERACTIVE, MegaTransfer::PRIORITY_NORMAL
+         * or MegaTransfer::PRIORITY_BACKGROUND
+         *
+         * @see MegaApi::cancelPrefetch
+         */
+        void prefetch(MegaNode *node, int64_t offset, int64_t size, int priority = MegaTransfer::PRIORITY_BACKGROUND);
+
+        /**
+         * @brief Cancel the pending prefetches of a file
+         *
+         * The data already prefetched stays in the streaming cache.
+         *
+         * @param node MegaNode that identifies the file
+         *
+         * @see MegaApi::prefetch
+         */
+        void cancelPrefetch(MegaNode *node);
+
         /**
          * @brief Cancel a transfer
          *
@@ -5003,6 +6412,76 @@ class MegaApi
          */
         void cancelTransferByTag(int transferTag, MegaRequestListener *listener = NULL);
 
+        /**
+         * @brief Set the priority class of a queued transfer
+         *
+         * Queued transfers are started by priority class first and by their position in
+         * the class second, so interactive transfers don't wait behind large background
+         * ones. New transfers are added at the end of MegaTransfer::PRIORITY_NORMAL.
+         * Changing the class moves the transfer to the end of the new class. Transfers that
+         * are already in progress aren't affected.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_SET_TRANSFER_PRIORITY
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTransferTag - Returns the tag of the transfer
+         * - MegaRequest::getNumber - Returns the priority class
+         *
+         * @param transferTag Tag that identifies the transfer (MegaTransfer::getTag)
+         * @param priority Priority class
+         * Valid values are:
+         * - MegaTransfer::PRIORITY_INTERACTIVE = 0
+         * - MegaTransfer::PRIORITY_NORMAL = 1
+         * - MegaTransfer::PRIORITY_BACKGROUND = 2
+         *
+         * @param listener MegaRequestListener to track this request
+         */
+        void setTransferPriority(int transferTag, int priority, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Move a queued transfer to the front of its priority class
+         *
+         * The associated request type with this request is MegaRequest::TYPE_MOVE_TRANSFER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTransferTag - Returns the tag of the transfer
+         * - MegaRequest::getFlag - Returns true
+         *
+         * @param transferTag Tag that identifies the transfer (MegaTransfer::getTag)
+         * @param listener MegaRequestListener to track this request
+         */
+        void moveTransferToFirst(int transferTag, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Move a queued transfer to the end of its priority class
+         *
+         * The associated request type with this request is MegaRequest::TYPE_MOVE_TRANSFER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTransferTag - Returns the tag of the transfer
+         * - MegaRequest::getFlag - Returns false
+         * - MegaRequest::getNumber - Returns 0
+         *
+         * @param transferTag Tag that identifies the transfer (MegaTransfer::getTag)
+         * @param listener MegaRequestListener to track this request
+         */
+        void moveTransferToLast(int transferTag, MegaRequestListener *listener = NULL);
+
+        /**
+         * @brief Move a queued transfer in front of another one
+         *
+         * Both transfers must have the same direction. The moved transfer takes the
+         * priority class of the other one.
+         *
+         * The associated request type with this request is MegaRequest::TYPE_MOVE_TRANSFER
+         * Valid data in the MegaRequest object received on callbacks:
+         * - MegaRequest::getTransferTag - Returns the tag of the transfer
+         * - MegaRequest::getFlag - Returns false
+         * - MegaRequest::getNumber - Returns the tag of the other transfer
+         *
+         * @param transferTag Tag that identifies the transfer to move (MegaTransfer::getTag)
+         * @param nextTransferTag Tag of the transfer that will follow it
+         * @param listener MegaRequestListener to track this request
+         */
+        void moveTransferBefore(int transferTag, int nextTransferTag, MegaRequestListener *listener = NULL);
+
         /**
          * @brief Cancel all transfers of the same type
          *
@@ -5071,6 +6550,232 @@ class MegaApi
          */
         void setUploadLimit(int bpslimit);
 
+        /**
+         * @brief Set the range of parallel connections used by each transfer
+         *
+         * By default, files larger than 128 KB are transferred with a fixed number of connections
+         * (3 for uploads and 4 for downloads). If the range allows it, the SDK adapts the number of
+         * connections of each transfer to its measured throughput: it adds connections while that
+         * doesn't slow the transfer down and removes them when it does or when connections fail.
+         *
+         * The range applies to transfers started after this call.
+         *
+         * @param direction Direction of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @param minConnections Minimum number of connections (at least 1)
+         * @param maxConnections Maximum number of connections (at most 32)
+         */
+        void setTransferConnections(int direction, int minConnections, int maxConnections);
+
+        /**
+         * @brief Set the limits used to decide how many transfers run at the same time
+         *
+         * By default, up to 12 transfers run at the same time, shared by both directions.
+         * New transfers are started while less than 64 KB remain to be transferred by the
+         * running ones, or while at most one large transfer runs and it would finish in
+         * less than two seconds at its current speed.
+         *
+         * Servers with fast connections can allow many more concurrent transfers of small
+         * files, while mobile devices may want fewer. With a limit of bytes in flight, new
+         * transfers are started while the running transfers of the direction have less
+         * than that amount, or less than two seconds at their measured combined speed,
+         * left to transfer.
+         *
+         * @param direction Direction of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @param maxTransfers Maximum number of concurrent transfers of the direction, 0 for the default
+         * @param maxBytesInFlight Bytes in flight to keep, 0 for the default
+         * @param maxConnections Maximum number of connections used by the transfers of the direction,
+         * 0 for no limit
+         */
+        void setTransferLimits(int direction, int maxTransfers, long long maxBytesInFlight, int maxConnections);
+
+        /**
+         * @brief Create the nodes of completed uploads in batches
+         *
+         * By default, the node of each uploaded file is created with its own request as soon
+         * as the upload finishes. With batching, the nodes of all uploads that finish within
+         * half a second (or until no uploads are running anymore) are created with one request
+         * per target folder. That makes uploading large numbers of small files much faster,
+         * especially in combination with MegaApi::startUploads and MegaApi::setTransferLimits.
+         *
+         * MegaTransferListener::onTransferFinish is still called for each upload separately.
+         *
+         * @param enable True to enable batching, false to disable it (default)
+         */
+        void setUploadNodeBatching(bool enable);
+
+        /**
+         * @brief Limit the number of uploads held by the transfer engine
+         *
+         * Each upload in the engine keeps its transfer state in memory, which adds up when
+         * hundreds of thousands of files are queued at once. With a limit, uploads started
+         * while that many uploads are in the engine wait in a compact queue (local path,
+         * target folder, name and modification time) and enter the engine in order as the
+         * running ones finish. The files are only opened and fingerprinted at that point.
+         *
+         * MegaTransferListener::onTransferStart is called for a waiting upload when it enters
+         * the engine, and MegaApi::getTransfers only returns it from then on.
+         * MegaApi::getNumPendingUploads includes the waiting uploads, and
+         * MegaApi::cancelTransfers cancels them as well.
+         *
+         * @param limit Maximum number of uploads in the engine, 0 for no limit (default)
+         */
+        void setUploadQueueLimit(int limit);
+
+        /**
+         * @brief Keep the queue of transfers across restarts
+         *
+         * With this option, the file uploads and downloads started by the app are recorded in
+         * the local cache of the session until they finish. When the session is resumed and
+         * MegaApi::fetchNodes succeeds, the transfers that had not finished are started again
+         * in bulk. Uploads keep the fingerprint of their file, which is not computed again as
+         * long as the size and modification time of the file are unchanged.
+         *
+         * Folder transfers, streaming transfers, downloads of public nodes and the transfers
+         * of synced folders are not recorded. Restored transfers have no MegaTransferListener
+         * of their own, they are reported to the listeners registered with
+         * MegaApi::addTransferListener and MegaApi::addListener only.
+         *
+         * The option has to be enabled before MegaApi::fetchNodes for the recorded transfers
+         * to be restored. Without it, the recorded transfers are discarded then.
+         *
+         * @param enable True to keep the queue, false to discard it (default)
+         */
+        void setPersistentTransferQueue(bool enable);
+
+        /**
+         * @brief Write downloaded data sequentially
+         *
+         * Downloads use several connections, so their chunks complete out of order. By default,
+         * each chunk is written to the temporary file as soon as it completes. With a write buffer,
+         * chunks that complete ahead of the current write position are kept in memory (up to the
+         * given number of bytes per download) and written in sequential runs. Additionally, the
+         * disk space of new downloads is reserved in advance where the filesystem supports it.
+         *
+         * This is recommended for network shares and spinning disks.
+         *
+         * @param maxBufferedBytes Maximum number of bytes buffered per download, 0 to disable
+         * the write buffer (default)
+         */
+        void setDownloadWriteBuffer(long long maxBufferedBytes);
+
+        /**
+         * @brief Limit the bandwidth used by all transfers of a direction
+         *
+         * The limit is enforced smoothly while data is sent or received, for all transfers of
+         * the direction together (unlike MegaApi::setUploadLimit). Time-of-day schedules set with
+         * MegaApi::addBandwidthSchedule take precedence over this limit while they apply.
+         *
+         * This limit is only enforced by the cURL network layer.
+         *
+         * @param direction Direction of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @param bytesPerSecond Maximum bandwidth, 0 for no limit
+         */
+        void setBandwidthLimit(int direction, long long bytesPerSecond);
+
+        /**
+         * @brief Limit the bandwidth used by the transfers of a priority class
+         *
+         * The class limits apply in addition to the total limit of the direction. The priority
+         * class of a transfer is set with MegaApi::setTransferPriority. The limit applies to
+         * transfers started after the change.
+         *
+         * @param direction Direction of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @param priority Priority class (MegaTransfer::PRIORITY_INTERACTIVE, MegaTransfer::PRIORITY_NORMAL
+         * or MegaTransfer::PRIORITY_BACKGROUND)
+         * @param bytesPerSecond Maximum bandwidth, 0 for no limit
+         */
+        void setBandwidthClassLimit(int direction, int priority, long long bytesPerSecond);
+
+        /**
+         * @brief Use a different total bandwidth limit during a time of the day
+         *
+         * Times are minutes since midnight in local time. A schedule whose end is before its start
+         * wraps around midnight. If several schedules apply, the first one added wins.
+         *
+         * @param direction Direction of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         * @param startMinute Start of the schedule (0 - 1439)
+         * @param endMinute End of the schedule (0 - 1440)
+         * @param bytesPerSecond Maximum bandwidth while the schedule applies, 0 for no limit
+         */
+        void addBandwidthSchedule(int direction, int startMinute, int endMinute, long long bytesPerSecond);
+
+        /**
+         * @brief Remove all time-of-day bandwidth schedules of a direction
+         * @param direction Direction of the transfers (MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD)
+         */
+        void clearBandwidthSchedules(int direction);
+
+        /**
+         * @brief Set the number of threads used to decrypt nodes
+         *
+         * Node keys and attributes received when fetching nodes are decrypted on this number
+         * of worker threads. That speeds up the initial load of large accounts on multi-core
+         * devices. The setting applies to the next batch of nodes to decrypt.
+         *
+         * @param threads Number of decryption threads, 0 or 1 to decrypt on the SDK thread (default)
+         */
+        void setNodeDecryptionThreads(int threads);
+
+        /**
+         * @brief Set the number of threads used to encrypt and decrypt transfer chunks
+         *
+         * By default, the chunks of uploads and downloads are encrypted/decrypted and
+         * their MACs computed on the SDK thread. With worker threads, the chunks of a
+         * transfer that are ready at the same time are processed in parallel, which helps
+         * to saturate fast connections on multi-core devices. Disk access stays on the
+         * SDK thread.
+         *
+         * @param threads Number of crypto threads, 0 or 1 to use the SDK thread (default)
+         */
+        void setTransferCryptoThreads(int threads);
+
+        /**
+         * @brief Set the number of threads used to scan synced folders
+         *
+         * By default, synced folders are scanned item by item on the SDK thread. With scan
+         * threads, the items waiting to be scanned are opened, fingerprinted (files) and
+         * listed (folders) in parallel batches, so that the initial scan of large folders
+         * on network or other high-latency storage is not bound by one operation at a time.
+         * The SDK logs the progress of the scan after each batch.
+         *
+         * @param threads Number of scan threads, 0 or 1 to scan on the SDK thread (default)
+         */
+        void setSyncScanThreads(int threads);
+
+        /**
+         * @brief Set the number of threads of the shared worker pool
+         *
+         * The pool runs background work of the SDK on a fixed set of threads, which take
+         * work from each other when they run out. Node decryption, transfer crypto and sync
+         * scans run on the pool unless dedicated threads were set for them with
+         * MegaApi::setNodeDecryptionThreads, MegaApi::setTransferCryptoThreads or
+         * MegaApi::setSyncScanThreads, which spares the creation of threads for every batch.
+         *
+         * Changing the size waits for the tasks running on the current pool.
+         *
+         * @param threads Number of worker threads, 0 to disable the pool (default)
+         */
+        void setWorkerThreads(int threads);
+
+        /**
+         * @brief Coalesce node update notifications
+         *
+         * By default, MegaListener::onNodesUpdate and MegaGlobalListener::onNodesUpdate
+         * are called once per batch of changes received from MEGA. Large operations can
+         * produce thousands of small batches. With a coalescing window, updates are held
+         * back for up to that time after the first one and delivered together, with the
+         * repeated changes of a node merged into a single entry whose change flags are
+         * those of all its updates (see MegaNode::getChanges).
+         *
+         * A full reload of the nodes (onNodesUpdate with a NULL list) always delivers the
+         * updates held back first.
+         *
+         * @param milliseconds Coalescing window, 0 to deliver every batch immediately (default).
+         * The window is applied with a resolution of 100 milliseconds.
+         * @param maxBatchSize Maximum number of nodes in a coalesced notification, 0 for no limit
+         */
+        void setNodeUpdateCoalescing(int milliseconds, int maxBatchSize = 0);
+
         /**
          * @brief Set the transfer method for downloads
          *
@@ -5104,18 +6809,246 @@ class MegaApi
          * - TRANSFER_METHOD_ALTERNATIVE_PORT = 1
          * HTTP transfers using port 8080. Data is already encrypted.
          *
-         * - TRANSFER_METHOD_AUTO = 2
-         * The SDK selects the transfer method automatically
+         * - TRANSFER_METHOD_AUTO = 2
+         * The SDK selects the transfer method automatically
+         *
+         * - TRANSFER_METHOD_AUTO_NORMAL = 3
+         * The SDK selects the transfer method automatically starting with port 80.
+         *
+         * - TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
+         * The SDK selects the transfer method automatically starting with alternative port 8080.
+         *
+         * @param method Selected transfer method for uploads
+         */
+        void setUploadMethod(int method);
+
+        /**
+         * @brief Enable or disable HTTP/2 for API and transfer connections
+         *
+         * When enabled, requests to the same server are multiplexed over a single
+         * HTTP/2 connection instead of opening one connection per request, which
+         * saves connection setup time with many small transfers and thumbnails.
+         * Servers that don't support HTTP/2 keep being used with HTTP/1.1, and the
+         * SDK goes back to HTTP/1.1 by itself after an HTTP/2 protocol error.
+         *
+         * HTTP/2 is disabled by default.
+         *
+         * @param enable True to use HTTP/2 where possible, false to use HTTP/1.1 only
+         * @return False if HTTP/2 is not supported by the network layer of the SDK
+         */
+        bool setHttp2(bool enable);
+
+        /**
+         * @brief Enable or disable the compression of API requests
+         *
+         * When enabled, request bodies of at least 1 KB sent to the MEGA API (batches of
+         * commands, node and share key uploads) are gzip-compressed. If the API server rejects
+         * a compressed request, compression is disabled again and the request is repeated
+         * uncompressed.
+         *
+         * Compressed responses (gzip and deflate) are always accepted, regardless of this setting.
+         *
+         * Compression of API requests is disabled by default.
+         *
+         * @param enable True to compress API requests, false to send them uncompressed
+         * @return False if compression is not available in this build of the SDK
+         */
+        bool setRequestCompression(bool enable);
+
+        /**
+         * @brief Get the number of bytes saved by compression
+         *
+         * @param type Statistic to return
+         * Valid values for this parameter are:
+         * - MegaApi::COMPRESSION_STATS_SENT_SAVED = 0: Bytes not sent thanks to request compression
+         * - MegaApi::COMPRESSION_STATS_RECEIVED_SAVED = 1: Bytes not received thanks to compressed API responses
+         *
+         * @return Value of the statistic, or -1 if the type is invalid
+         */
+        long long getCompressionStats(int type);
+
+        /**
+         * @brief Deliver listener callbacks on a dedicated thread
+         *
+         * By default, listeners are called on the thread of the SDK, so a slow listener
+         * delays network activity and transfers. When enabled, callbacks are queued and
+         * delivered on a thread of their own, in the same order. Each listener receives copies
+         * of the MegaRequest, MegaTransfer, MegaError and list objects, which are valid until
+         * the callback returns as usual.
+         *
+         * If more than maxPending callbacks are waiting to be delivered, the SDK stops
+         * processing until the listeners catch up.
+         *
+         * With the callback thread, MegaApi::getCurrentRequest, MegaApi::getCurrentTransfer
+         * and similar functions return NULL. MegaTransferListener::onTransferData and
+         * MegaTransferListener::onTransferBuffer are still called on the thread of the SDK,
+         * because their result and arguments are only valid there.
+         *
+         * When the callback thread is disabled, this function waits until the queued callbacks
+         * have been delivered. It must not be called from a listener in that case.
+         *
+         * The callback thread is disabled by default.
+         *
+         * @param enable True to deliver callbacks on a dedicated thread
+         * @param maxPending Maximum number of queued callbacks before the SDK waits for the
+         * listeners (0 for no limit)
+         */
+        void setCallbackThread(bool enable, int maxPending = 1000);
+
+        /**
+         * @brief Get statistics about the delivery of callbacks on the callback thread
+         *
+         * Times are in microseconds.
+         *
+         * @param type Statistic to return
+         * Valid values for this parameter are:
+         * - MegaApi::CALLBACK_STATS_QUEUED = 0: Callbacks waiting to be delivered
+         * - MegaApi::CALLBACK_STATS_MAX_QUEUED = 1: Largest number of callbacks waiting to be delivered
+         * - MegaApi::CALLBACK_STATS_DELIVERED = 2: Callbacks delivered
+         * - MegaApi::CALLBACK_STATS_BACKPRESSURE_WAITS = 3: Times the SDK waited for the listeners
+         * - MegaApi::CALLBACK_STATS_LISTENER_TIME = 4: Time spent in listeners
+         * - MegaApi::CALLBACK_STATS_LISTENER_TIME_MAX = 5: Time of the slowest callback
+         * - MegaApi::CALLBACK_STATS_DELAY_MAX = 6: Longest time between queueing a callback and
+         * calling the listener
+         *
+         * @return Value of the statistic, or -1 if the type is invalid
+         * @see MegaApi::setCallbackThread
+         */
+        long long getCallbackStats(int type);
+
+        /**
+         * @brief Set the minimum interval between progress callbacks of a transfer
+         *
+         * MegaListener::onTransferUpdate and MegaTransferListener::onTransferUpdate are
+         * called at most once per interval for each transfer, except for the first and the
+         * last update. MegaTransfer::getDeltaSize returns the bytes transferred since the
+         * previous update that was delivered.
+         *
+         * For streaming transfers without a ring buffer, every chunk is delivered unless
+         * an interval is set here. In that case, use MegaTransfer::getDeltaSize to know
+         * the bytes accumulated since the previous update.
+         *
+         * The interval has a resolution of 100 ms. By default, at most one update per
+         * transfer is sent every 100 ms.
+         *
+         * @param ms Minimum interval in milliseconds (0 to restore the default)
+         */
+        void setTransferUpdateInterval(int ms);
+
+        /**
+         * @brief Set the interval of the aggregated transfer progress callback
+         *
+         * While there are active transfers, MegaListener::onTransfersProgress and
+         * MegaTransferListener::onTransfersProgress are called at this interval with a
+         * summary of all of them. Apps that only show global progress can combine this
+         * callback with a large interval in MegaApi::setTransferUpdateInterval to bound
+         * the number of callbacks, whatever the number of transfers.
+         *
+         * The interval has a resolution of 100 ms. The aggregated callback is disabled by default.
+         *
+         * @param ms Interval in milliseconds (0 to disable the callback)
+         */
+        void setTransfersProgressInterval(int ms);
+
+        /**
+         * @brief Get the network quality of the storage servers used in this session
+         *
+         * The SDK measures every storage server (and port) that transfers use. It uses
+         * these measurements to avoid switching to a port that is failing as well, to stop
+         * adding connections to a failing server and to limit how often a failing server is
+         * reported to MEGA.
+         *
+         * The result is a JSON array with one object per server, with these fields:
+         * - "host": Hostname, followed by the port if it's not the default one
+         * - "rtt": Average TCP connection setup time in milliseconds (-1 if unknown)
+         * - "throughput": Average throughput of a connection in bytes per second (-1 if unknown)
+         * - "errorrate": Weighted fraction of recent requests that failed (0 to 1)
+         * - "requests", "failures", "bytes": Totals for the session
+         * - "lastsuccess", "lastfailure": Seconds since the last successful / failed request (-1 if none)
+         *
+         * You take the ownership of the returned value. Use delete [] to free it.
+         *
+         * @return JSON array with the statistics of the storage servers
+         */
+        char *getStorageHostStats();
+
+        /**
+         * @brief Get runtime metrics of the SDK in the Prometheus text exposition format
+         *
+         * The result contains these metrics:
+         * - mega_api_request_duration_ms: Histogram of the time from sending an API request
+         * to its response, by command
+         * - mega_actionpacket_lag_ms: Histogram of the time from receiving server-client
+         * packets to processing them
+         * - mega_transfer_bytes_total: Bytes of completed transfer chunks, by direction
+         * - mega_transfer_slots: Active transfers, by direction
+         * - mega_db_commit_duration_ms: Histogram of the time of the commits of the local cache
+         * - mega_loop_duration_ms: Histogram of the time of the iterations of the SDK loop
+         * - mega_phase_duration_ms: Histogram of the time of the phases of the SDK loop and of
+         * the listener callbacks, by phase (while the watchdog is enabled, see MegaApi::setWatchdog)
+         * - mega_queue_depth: Items waiting, by queue (commands, uploads, downloads,
+         * file_attributes, node_notifications, callbacks, pool_tasks)
+         * - mega_pool_tasks_total, mega_pool_busy_ms_total: Tasks submitted to, stolen by and
+         * finished on the workers, and the time spent running them (while the worker pool is
+         * enabled, see MegaApi::setWorkerThreads)
+         * - mega_alloc_bytes, mega_alloc_total: Heap bytes in use and allocations made, by
+         * subsystem (nodes, attrs, json, http, transfers, sync, cache, other). Only reported if
+         * the SDK was configured with --enable-alloc-tags
+         *
+         * Counters and histograms accumulate since the creation of the MegaApi object.
+         *
+         * You take the ownership of the returned value. Use delete [] to free it.
+         *
+         * @return Metrics in the Prometheus text format
+         */
+        char *getMetrics();
+
+        /**
+         * @brief Record spans of the SDK loop for MegaApi::getTrace
+         *
+         * When enabled, the SDK records the duration of the phases of its loop (network I/O,
+         * processing of server-client packets, transfer slots, dispatching of transfers, syncs,
+         * node notifications, commits of the local cache) and of the listener callbacks.
+         * Only the most recent maxEvents spans are kept.
+         *
+         * Enabling the tracing again discards the recorded spans. The tracing is disabled by
+         * default, and has a negligible cost in that case.
+         *
+         * @param enable True to record spans
+         * @param maxEvents Maximum number of spans kept
+         */
+        void setTracing(bool enable, int maxEvents = 100000);
+
+        /**
+         * @brief Get the spans recorded since MegaApi::setTracing was enabled
+         *
+         * The result is in the Chrome trace-event JSON format, which can be loaded in
+         * chrome://tracing or https://ui.perfetto.dev. Timestamps are in microseconds.
+         *
+         * You take the ownership of the returned value. Use delete [] to free it.
+         *
+         * @return JSON object with the recorded spans
+         * @see MegaApi::setTracing
+         */
+        char *getTrace();
+
+        /**
+         * @brief Set the threshold of the SDK loop watchdog
+         *
+         * While the watchdog is enabled, the SDK times the phases of its loop (the same ones
+         * recorded by MegaApi::setTracing, and the processing of new nodes) and the listener
+         * callbacks. A phase or callback that takes at least the given time is logged as a
+         * warning of the form "Stall: phase=<name> ms=<duration> threshold_ms=<threshold>".
+         * The durations are also available as the mega_phase_duration_ms histogram of
+         * MegaApi::getMetrics.
          *
-         * - TRANSFER_METHOD_AUTO_NORMAL = 3
-         * The SDK selects the transfer method automatically starting with port 80.
+         * Stalls of the SDK thread delay the action packets and can make transfers time out.
          *
-         * - TRANSFER_METHOD_AUTO_ALTERNATIVE = 4
-         * The SDK selects the transfer method automatically starting with alternative port 8080.
+         * The watchdog is enabled by default with a threshold of 2000 ms.
          *
-         * @param method Selected transfer method for uploads
+         * @param thresholdMs Threshold in milliseconds, 0 to disable the watchdog
          */
-        void setUploadMethod(int method);
+        void setWatchdog(int thresholdMs);
 
         /**
          * @brief Get the active transfer method for downloads
@@ -5199,6 +7132,77 @@ class MegaApi
          */
         MegaTransferList *getTransfers(int type);
 
+        /**
+         * @brief Get a page of the active transfers
+         *
+         * Transfers are returned in ascending order of tag, starting after the tag
+         * passed in \c fromTag. To get the next page, pass the tag of the last
+         * transfer of the previous one. The end is reached when the returned list
+         * has less than \c limit transfers.
+         *
+         * Unlike MegaApi::getTransfers, this function doesn't copy the whole transfer
+         * queue, so it's suitable for apps that show large queues.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param type MegaTransfer::TYPE_DOWNLOAD, MegaTransfer::TYPE_UPLOAD or -1 for both
+         * @param fromTag Transfers with this tag or a lower one aren't returned (0 for the first page)
+         * @param limit Maximum number of transfers to return
+         * @return List with up to \c limit transfers of the desired type
+         */
+        MegaTransferList *getTransfers(int type, int fromTag, int limit);
+
+        /**
+         * @brief Get the number of active transfers of a specific type
+         *
+         * The result is the size of the list returned by MegaApi::getTransfers(int)
+         * without building it.
+         *
+         * @param type MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD
+         * @return Number of queued and in progress transfers of the desired type
+         */
+        int getNumTransfers(int type);
+
+        /**
+         * @brief Get the number of transfers of a specific type that are in progress
+         *
+         * Active transfers that aren't in progress are waiting in the queue
+         * for a free slot.
+         *
+         * @param type MegaTransfer::TYPE_DOWNLOAD or MegaTransfer::TYPE_UPLOAD
+         * @return Number of transfers of the desired type that are being transferred
+         */
+        int getNumTransfersInProgress(int type);
+
+        /**
+         * @brief Get the sequence number of the last change of the active transfers
+         *
+         * The sequence number increases every time a transfer starts, is updated or
+         * gets a temporary error. Use it with MegaApi::getTransfersChangedSince to poll
+         * only the transfers that changed.
+         *
+         * Get the sequence number before calling MegaApi::getTransfersChangedSince, so
+         * that changes between both calls are returned again on the next poll instead
+         * of being missed.
+         *
+         * @return Sequence number of the last change (0 if there wasn't any)
+         */
+        long long getTransfersSequence();
+
+        /**
+         * @brief Get the active transfers that changed after a sequence number
+         *
+         * Transfers are returned in the order of their last change. Finished transfers
+         * aren't returned, they are reported by MegaTransferListener::onTransferFinish
+         * and MegaApi::getTransferByTag returns NULL for them.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param sequence Sequence number got from MegaApi::getTransfersSequence (0 for all)
+         * @return List with the transfers that changed after the sequence number
+         */
+        MegaTransferList *getTransfersChangedSince(long long sequence);
+
         /**
          * @brief Get a list of transfers that belong to a folder transfer
          *
@@ -5408,6 +7412,44 @@ class MegaApi
          */
         bool isScanning();
 
+        /**
+         * @brief Get a performance statistic of a synchronization
+         *
+         * Times are processor time in microseconds unless stated otherwise. A pass of
+         * the reconciliation of local and remote changes (syncdown: remote to local,
+         * syncup: local to remote) is timed each time it runs over a synchronization.
+         *
+         * @param sync Synchronization (identified by its tag)
+         * @param type Statistic to return
+         * Valid values for this parameter are:
+         * - MegaApi::SYNC_STATS_NOTIFICATIONS_PENDING = 0: Filesystem notifications waiting to be processed
+         * - MegaApi::SYNC_STATS_SCANNED = 1: Notifications processed
+         * - MegaApi::SYNC_STATS_SCAN_TIME = 2: Time spent processing notifications
+         * - MegaApi::SYNC_STATS_FULL_SCANS = 3: Full scans started (the initial scan and rescans)
+         * - MegaApi::SYNC_STATS_FULL_SCAN_DURATION = 4: Wall clock duration of the last completed
+         * full scan, in milliseconds
+         * - MegaApi::SYNC_STATS_FILES = 5: Local files known to the synchronization
+         * - MegaApi::SYNC_STATS_FOLDERS = 6: Local folders known to the synchronization
+         * - MegaApi::SYNC_STATS_PUTNODES_PENDING = 7: Node creation requests waiting for a response
+         * - MegaApi::SYNC_STATS_UPLOADS = 8: Uploads started
+         * - MegaApi::SYNC_STATS_DOWNLOADS = 9: Downloads started
+         * - MegaApi::SYNC_STATS_LOCAL_DEBRIS = 10: Local items moved to the local debris folder
+         * - MegaApi::SYNC_STATS_REMOTE_DEBRIS = 11: Nodes moved to the SyncDebris folder
+         * - MegaApi::SYNC_STATS_SYNCDOWN_PASSES = 12: Number of syncdown passes
+         * - MegaApi::SYNC_STATS_SYNCDOWN_TIME = 13: Time spent in syncdown passes
+         * - MegaApi::SYNC_STATS_SYNCDOWN_LAST = 14: Time of the last syncdown pass
+         * - MegaApi::SYNC_STATS_SYNCDOWN_MAX = 15: Time of the slowest syncdown pass
+         * - MegaApi::SYNC_STATS_SYNCUP_PASSES = 16: Number of syncup passes
+         * - MegaApi::SYNC_STATS_SYNCUP_TIME = 17: Time spent in syncup passes
+         * - MegaApi::SYNC_STATS_SYNCUP_LAST = 18: Time of the last syncup pass
+         * - MegaApi::SYNC_STATS_SYNCUP_MAX = 19: Time of the slowest syncup pass
+         *
+         * @return Value of the statistic, or -1 if the synchronization isn't running or
+         * the type is invalid
+         * @see MegaSync::getStats
+         */
+        long long getSyncStats(MegaSync *sync, int type);
+
         /**
          * @brief Check if the MegaNode is synchronized with a local file
          * @param MegaNode to check
@@ -5678,6 +7720,59 @@ class MegaApi
 		 */
         MegaNodeList* getChildren(MegaNode *parent, int order = 1);
 
+        /**
+         * @brief Get a window of the children of a MegaNode
+         *
+         * Returns the children at positions [offset, offset + limit) of the list that
+         * MegaApi::getChildren would return with the same order. Only those nodes are
+         * copied, and the sorted order is cached by the SDK until the folder changes, so
+         * repeated calls for a large folder cost time proportional to the window.
+         *
+         * If the parent node doesn't exist, or the window is empty or out of range,
+         * this function returns an empty list.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the returned list (see MegaApi::getChildren)
+         * @param offset Position of the first child to return
+         * @param limit Maximum number of children to return
+         * @return List with the requested child MegaNode objects
+         */
+        MegaNodeList* getChildren(MegaNode *parent, int order, int offset, int limit);
+
+        /**
+         * @brief Get a cursor to iterate the children of a MegaNode window by window
+         *
+         * If the parent node is NULL, this function returns NULL
+         *
+         * You take the ownership of the returned value
+         *
+         * @param parent Parent node
+         * @param order Order for the iteration (see MegaApi::getChildren)
+         * @return Cursor positioned at the first child
+         */
+        MegaChildrenCursor* getChildrenCursor(MegaNode *parent, int order = 1);
+
+        /**
+         * @brief Take an immutable snapshot of a part of the node tree
+         *
+         * The snapshot contains the node and all the nodes below it, or the root, inbox and
+         * rubbish bin trees if the node is NULL, as they are at the time of the call. It can
+         * then be queried from any thread without locking the SDK, and without changes made
+         * by the SDK in the meantime showing up between calls.
+         *
+         * Taking the snapshot copies all the nodes it contains while the SDK thread is
+         * blocked, so prefer snapshots of the subtree of interest on large accounts.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param node Root of the snapshot, or NULL for the whole account
+         * @param order Order of the children in the snapshot (see MegaApi::getChildren)
+         * @return Snapshot, or NULL if the node doesn't exist
+         */
+        MegaNodeSnapshot* getNodeSnapshot(MegaNode *node = NULL, int order = 1);
+
         /**
          * @brief Get the current index of the node in the parent folder for a specific sorting order
          *
@@ -5964,6 +8059,196 @@ class MegaApi
          */
         long long getSize(MegaNode *node);
 
+        /**
+         * @brief Get the number of files in a node tree
+         *
+         * If the MegaNode is a file, this function returns 1.
+         * If it's a folder, this function returns the number of files in the whole node tree.
+         *
+         * The value is maintained as nodes are added, moved and removed, so this function
+         * doesn't traverse the tree.
+         *
+         * @param node Parent node
+         * @return Number of files in the node tree
+         */
+        int getNumTreeFiles(MegaNode *node);
+
+        /**
+         * @brief Get the number of folders in a node tree
+         *
+         * Returns the number of folders below the node (the node itself is not counted),
+         * or 0 if the node is a file.
+         *
+         * The value is maintained as nodes are added, moved and removed, so this function
+         * doesn't traverse the tree.
+         *
+         * @param node Parent node
+         * @return Number of folders in the node tree
+         */
+        int getNumTreeFolders(MegaNode *node);
+
+        /**
+         * @brief Get the memory used by the loaded nodes
+         *
+         * The value is an estimation of the heap memory used by the SDK for the nodes
+         * of the account. It's computed by visiting all nodes, so don't call this
+         * function too often with big accounts.
+         *
+         * @param type Category of memory to return
+         * Valid values for this parameter are:
+         * - MegaApi::MEMORY_TOTAL = 0: Sum of all categories
+         * - MegaApi::MEMORY_NODES = 1: Node objects
+         * - MegaApi::MEMORY_NODE_INDEX = 2: Index of nodes by handle
+         * - MegaApi::MEMORY_FINGERPRINTS = 3: Index of files by fingerprint
+         * - MegaApi::MEMORY_ATTRIBUTES = 4: Node attributes
+         * - MegaApi::MEMORY_STRINGS = 5: Node keys and file attribute strings
+         * - MegaApi::MEMORY_CHILDREN = 6: Child lists and name indexes of folders
+         * - MegaApi::MEMORY_SHARING = 7: Shares and public links
+         *
+         * @return Memory used in bytes, or -1 if the type is invalid
+         */
+        long long getMemoryUsage(int type = MEMORY_TOTAL);
+
+        /**
+         * @brief Get statistics of the pool of transfer chunk buffers
+         *
+         * Uploads and downloads take their chunk buffers from a pool shared by all
+         * transfers, so that buffers are recycled instead of being reallocated whenever
+         * the chunk size changes.
+         *
+         * @param type Statistic to return
+         * Valid values for this parameter are:
+         * - MegaApi::BUFFER_POOL_REQUESTS = 0: Number of buffers requested
+         * - MegaApi::BUFFER_POOL_HITS = 1: Number of requests served by a recycled buffer
+         * - MegaApi::BUFFER_POOL_IN_USE = 2: Bytes in buffers used by transfers
+         * - MegaApi::BUFFER_POOL_IDLE = 3: Bytes in buffers kept for reuse
+         * - MegaApi::BUFFER_POOL_PEAK = 4: Peak of the bytes in use and kept for reuse
+         *
+         * @return Value of the statistic, or -1 if the type is invalid
+         */
+        long long getTransferBufferPoolStats(int type);
+
+        /**
+         * @brief Set the size of the streaming cache
+         *
+         * The streaming cache keeps decrypted data read by MegaApi::startStreaming, shared by all
+         * nodes and evicting the least recently used data first. Rereads of cached ranges (for
+         * example, when a media player seeks backwards or reads headers again) are served without
+         * contacting the storage servers. While the cache is enabled, sequential reads of a node
+         * additionally read ahead, doubling the read-ahead up to 8 MB (and at most a quarter of
+         * the cache) with each sequential read.
+         *
+         * The cache is emptied upon logout.
+         *
+         * @param bytes Size of the cache in bytes, 0 to disable it (default)
+         */
+        void setStreamingCacheSize(long long bytes);
+
+        /**
+         * @brief Set the number of parallel connections per stream
+         *
+         * By default, each read started by MegaApi::startStreaming uses a single connection.
+         * With more connections, the range is split into parts of 1 MB that are fetched in
+         * parallel and delivered in order. This helps with high-latency links, at the cost of
+         * buffering up to one part per additional connection.
+         *
+         * @param connections Maximum number of connections per stream (1 by default)
+         */
+        void setStreamingConnections(int connections);
+
+        /**
+         * @brief Start an HTTP server to stream files
+         *
+         * The server answers GET and HEAD requests for the links returned by
+         * MegaApi::httpServerGetLocalLink, including single byte ranges, so media players can
+         * seek without downloading the whole file. Connections are kept alive and any number of
+         * clients can read the same file at once. Data is downloaded with MegaApi::startStreaming
+         * in parts of 4 MB, so the streaming cache and connections (MegaApi::setStreamingCacheSize,
+         * MegaApi::setStreamingConnections) apply to it as well.
+         *
+         * The server is not available on Windows.
+         *
+         * @param localOnly true to listen on the loopback interface only
+         * @param port TCP port to listen on
+         * @return true if the server is running on that port
+         */
+        bool httpServerStart(bool localOnly = true, int port = 4443);
+
+        /**
+         * @brief Stop the HTTP server
+         *
+         * Open connections are closed and the local links returned until now are no longer
+         * valid.
+         */
+        void httpServerStop();
+
+        /**
+         * @brief Check if the HTTP server is running
+         * @return Port of the server, or 0 if it is not running
+         */
+        int httpServerIsRunning();
+
+        /**
+         * @brief Get a URL to stream a file through the HTTP server
+         *
+         * Only files for which a link was requested are served.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node File node
+         * @return URL of the file, or NULL if the server is not running or the node is not a file
+         */
+        char *httpServerGetLocalLink(MegaNode *node);
+
+        /**
+         * @brief Get statistics of the streaming cache
+         *
+         * @param type Statistic to return
+         * Valid values for this parameter are:
+         * - MegaApi::STREAMING_CACHE_HITS = 0: Number of blocks served from the cache
+         * - MegaApi::STREAMING_CACHE_MISSES = 1: Number of reads that had to be fetched
+         * - MegaApi::STREAMING_CACHE_SIZE = 2: Bytes in the cache
+         *
+         * @return Value of the statistic, or -1 if the type is invalid
+         */
+        long long getStreamingCacheStats(int type);
+
+        /**
+         * @brief Get statistics of the resolution of node and share keys
+         *
+         * Keys wrapped with the RSA key of the account are decrypted once and cached for the
+         * session. When MegaApi::setNodeDecryptionThreads is enabled, the RSA-encrypted
+         * node keys found together are decrypted in parallel.
+         *
+         * @param type Statistic to return
+         * Valid values for this parameter are:
+         * - MegaApi::KEY_STATS_RSA_DECRYPTIONS = 0: Number of RSA key decryptions
+         * - MegaApi::KEY_STATS_RSA_PARALLEL = 1: Number of those that ran on the decryption threads
+         * - MegaApi::KEY_STATS_RSA_CACHE_HITS = 2: Number of RSA key decryptions saved by the cache
+         * - MegaApi::KEY_STATS_TIME = 3: Processor time spent applying keys to nodes, in microseconds
+         *
+         * @return Value of the statistic, or -1 if the type is invalid
+         */
+        long long getKeyResolutionStats(int type);
+
+        /**
+         * @brief Release memory when the operating system signals memory pressure
+         *
+         * Call it from the low memory notifications of the platform (for example,
+         * onTrimMemory on Android or didReceiveMemoryWarning on iOS). Everything released
+         * is rebuilt or fetched again on demand, at some cost in speed:
+         * - MegaApi::LOW_MEMORY_MODERATE = 1: Drops the cached path resolutions, the sorted
+         * views and name indexes of folders, the cached RSA-decrypted keys and the transfer
+         * buffers kept for reuse
+         * - MegaApi::LOW_MEMORY_CRITICAL = 2: Additionally empties the streaming cache
+         * (MegaApi::setStreamingCacheSize) and, when file nodes are paged in from the local
+         * cache, evicts all file nodes that aren't in use
+         *
+         * @param level Severity of the memory pressure
+         * @return Approximate number of bytes freed
+         */
+        long long onLowMemory(int level);
+
         /**
          * @brief Get a Base64-encoded fingerprint for a local file
          *
@@ -6189,6 +8474,60 @@ class MegaApi
          */
         MegaNodeList* search(MegaNode* node, const char* searchString, bool recursive = 1);
 
+        enum { SEARCH_SUBSTRING = 0, SEARCH_PREFIX, SEARCH_EXTENSION };
+
+        /**
+         * @brief Search nodes by name with a specific kind of match
+         *
+         * The search is case-insensitive. If the name index is enabled (see
+         * MegaApi::enableNameIndex) it is used to answer the query, otherwise the
+         * node tree is explored.
+         *
+         * You take the ownership of the returned value
+         *
+         * @param node The parent node of the tree to explore
+         * @param searchString Search string
+         * @param matchType Kind of match
+         * Valid values for this parameter are:
+         * - MegaApi::SEARCH_SUBSTRING = 0
+         * The name contains the search string
+         *
+         * - MegaApi::SEARCH_PREFIX = 1
+         * The name starts with the search string
+         *
+         * - MegaApi::SEARCH_EXTENSION = 2
+         * The name has the search string as extension (with or without the leading dot)
+         *
+         * @param limit Maximum number of results, 0 for no limit
+         * @param recursive True if you want to seach recursively in the node tree.
+         * False if you want to seach in the children of the node only
+         *
+         * @return List of nodes whose names match, in no specific order
+         */
+        MegaNodeList* search(MegaNode* node, const char* searchString, int matchType, int limit, bool recursive = 1);
+
+        /**
+         * @brief Enable or disable the name index used by MegaApi::search
+         *
+         * The index keeps the decrypted names of all nodes, so searches don't need
+         * to explore the node tree. It is updated as nodes change and, for full
+         * sessions, saved encrypted next to the local cache so that it survives
+         * restarts. Building it the first time requires the names of all nodes, so
+         * it cancels the benefit of lazy node decryption once.
+         *
+         * Disabling the index deletes its saved copy. The index is disabled by default.
+         *
+         * @param enable True to enable the name index, false to disable it
+         */
+        void enableNameIndex(bool enable);
+
+        /**
+         * @brief Check if the name index is enabled
+         * @return True if the name index is enabled
+         * @see MegaApi::enableNameIndex
+         */
+        bool isNameIndexEnabled();
+
         /**
          * @brief Process a node tree using a MegaTreeProcessor implementation
          * @param node The parent node of the tree to explore
@@ -6201,6 +8540,55 @@ class MegaApi
          */
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
 
+        /**
+         * @brief Process a node tree without copying the nodes
+         *
+         * Like MegaApi::processMegaTree but the processor receives MegaNodeView objects that read
+         * the SDK's nodes directly, which avoids allocating a MegaNode per node when enumerating
+         * large trees. The nodes are visited in the same order as by MegaApi::processMegaTree.
+         *
+         * @param node The parent node of the tree to explore
+         * @param processor MegaNodeViewProcessor that will receive callbacks for every node in the tree
+         * @param recursive True if you want to recursively process the whole node tree.
+         * False if you want to process the children of the node only
+         *
+         * @return True if all nodes were processed. False otherwise (the operation can be
+         * cancelled by MegaNodeViewProcessor::processNodeView())
+         */
+        bool processNodeViews(MegaNode* node, MegaNodeViewProcessor* processor, bool recursive = 1);
+
+        /**
+         * @brief Process the children of a node in a specific order without copying them
+         *
+         * @param parent Parent node
+         * @param processor MegaNodeViewProcessor that will receive a callback for every child
+         * @param order Order in which the children are processed (see MegaApi::getChildren)
+         *
+         * @return True if all children were processed. False otherwise (the operation can be
+         * cancelled by MegaNodeViewProcessor::processNodeView())
+         */
+        bool processChildViews(MegaNode* parent, MegaNodeViewProcessor* processor, int order = 1);
+
+        /**
+         * @brief Get the handles of the nodes below a node that match a query
+         *
+         * The conditions of the query are evaluated by the SDK while it explores the tree,
+         * in parallel for independent subtrees, so only the matching handles are returned.
+         * The node itself is never part of the results.
+         *
+         * Results are returned in a stable order as long as the tree doesn't change, so
+         * they can be requested page by page with the offset and limit parameters.
+         *
+         * You take the ownership of the returned value.
+         *
+         * @param node Node whose subtree (or children, see MegaNodeQuery::setChildrenOnly) is queried
+         * @param query Conditions that the nodes must meet
+         * @param offset Number of matching nodes to skip
+         * @param limit Maximum number of handles to return, 0 for no limit
+         * @return List of handles of the matching nodes
+         */
+        MegaHandleList* queryNodes(MegaNode* node, MegaNodeQuery* query, int offset = 0, int limit = 0);
+
         /**
          * @brief Create a MegaNode that represents a file of a different account
          *
@@ -6450,6 +8838,128 @@ private:
 	MegaHashSignatureImpl *pImpl;    
 };
 
+/**
+ * @brief Read-only session on a public folder, obtained from a MegaFolderLinkStore
+ *
+ * Sessions on the same folder link share its nodes and the MegaApi instance that loaded
+ * them, so a session itself has no thread, network connection or node tree of its own.
+ * Its methods can be called from any thread.
+ *
+ * Deleting the session releases the folder, and the last session on it frees the folder.
+ * Don't delete a session from a callback of its own transfers.
+ *
+ * @see MegaFolderLinkStore::openSession
+ */
+class MegaFolderLinkSession
+{
+    public:
+        enum
+        {
+            STATE_LOADING = 0,
+            STATE_READY = 1,
+            STATE_FAILED = 2
+        };
+
+        virtual ~MegaFolderLinkSession();
+
+        /**
+         * @brief Returns the state of the folder
+         *
+         * The folder is loading while its nodes are being fetched (once for all its sessions),
+         * and ready when they can be queried with MegaFolderLinkSession::getNodes.
+         *
+         * @return MegaFolderLinkSession::STATE_LOADING, MegaFolderLinkSession::STATE_READY or
+         * MegaFolderLinkSession::STATE_FAILED
+         */
+        virtual int getState();
+
+        /**
+         * @brief Wait until the folder is not loading anymore
+         * @return MegaFolderLinkSession::STATE_READY or MegaFolderLinkSession::STATE_FAILED
+         */
+        virtual int waitReady();
+
+        /**
+         * @brief Returns the nodes of the folder
+         *
+         * The snapshot is shared by all the sessions on the folder and can be queried from
+         * any number of threads at the same time. It is owned by the store, and valid as long
+         * as the session exists - don't delete it.
+         *
+         * @return Nodes of the folder, or NULL if it isn't ready
+         */
+        virtual MegaNodeSnapshot *getNodes();
+
+        /**
+         * @brief Read a file of the folder
+         *
+         * The data is delivered as with MegaApi::startStreaming, through the MegaApi instance
+         * that loaded the folder (passed to the callbacks of the listener).
+         *
+         * @param node File node of the folder (see MegaFolderLinkSession::getNodes)
+         * @param startPos First byte to read
+         * @param size Number of bytes to read
+         * @param listener MegaTransferListener to receive the data
+         */
+        virtual void startStreaming(MegaNode *node, int64_t startPos, int64_t size, MegaTransferListener *listener);
+};
+
+class MegaFolderLinkStoreImpl;
+
+/**
+ * @brief Shared, read-only access to many public folders
+ *
+ * For services that open many folder links at the same time: each distinct folder link
+ * (by folder handle and key) is loaded once, by a MegaApi instance owned by the store, and
+ * an immutable snapshot of its nodes is shared by all the sessions opened on it. The folder
+ * stays loaded while it has sessions.
+ *
+ * Memory use grows with the number of distinct folders, not with the number of sessions.
+ */
+class MegaFolderLinkStore
+{
+public:
+    /**
+     * @brief Create a store
+     *
+     * The MegaApi instances of the folders are created with these parameters and without a
+     * local cache (see MegaApi::MegaApi).
+     *
+     * @param appKey AppKey of your application
+     * @param userAgent User agent to use in network requests
+     */
+    MegaFolderLinkStore(const char *appKey, const char *userAgent = NULL);
+
+    /**
+     * @brief Destroy the store
+     *
+     * All the sessions opened from the store must be deleted before.
+     */
+    ~MegaFolderLinkStore();
+
+    /**
+     * @brief Open a read-only session on a public folder
+     *
+     * If the folder is already loaded or loading for other sessions, the new session shares
+     * it, otherwise its loading starts. A folder that failed to load is loaded again.
+     *
+     * You take the ownership of the returned value
+     *
+     * @param megaFolderLink Public link to a folder in MEGA
+     * @return Session on the folder
+     */
+    MegaFolderLinkSession *openSession(const char *megaFolderLink);
+
+    /**
+     * @brief Returns the number of folders held by the sessions of the store
+     * @return Number of folders
+     */
+    int getNumFolders();
+
+private:
+    MegaFolderLinkStoreImpl *pImpl;
+};
+
 /**
  * @brief Details about a MEGA balance
  */
@@ -69,15 +69,23 @@ namespace mega
 #ifdef USE_QT
 typedef QtThread MegaThread;
 typedef QtMutex MegaMutex;
+typedef QtSharedMutex MegaSharedMutex;
+typedef QtSemaphore MegaSemaphore;
 #elif USE_PTHREAD
 typedef PosixThread MegaThread;
 typedef PosixMutex MegaMutex;
+typedef PosixSharedMutex MegaSharedMutex;
+typedef PosixSemaphore MegaSemaphore;
 #elif defined(_WIN32) && !defined(WINDOWS_PHONE)
 typedef Win32Thread MegaThread;
 typedef Win32Mutex MegaMutex;
+typedef Win32SharedMutex MegaSharedMutex;
+typedef Win32Semaphore MegaSemaphore;
 #else
 typedef CppThread MegaThread;
 typedef CppMutex MegaMutex;
+typedef CppSharedMutex MegaSharedMutex;
+typedef CppSemaphore MegaSemaphore;
 #endif
 
 #ifdef USE_QT
@@ -117,10 +125,13 @@ class MegaGfxProc : public GfxProcExternal {};
     #endif
 #endif
 
-class MegaDbAccess : public SqliteDbAccess
+// tables are written through an AsyncDbTable, so that commits do not block
+// the SDK thread
+class MegaDbAccess : public DBACCESS_CLASS
 {
 	public:
-		MegaDbAccess(string *basePath = NULL) : SqliteDbAccess(basePath){}
+		MegaDbAccess(string *basePath = NULL) : DBACCESS_CLASS(basePath){}
+		DbTable* open(FileSystemAccess *fsAccess, string *name);
 };
 
 class ExternalLogger : public Logger
@@ -132,42 +143,469 @@ public:
     void postLog(int logLevel, const char *message, const char *filename, int line);
     virtual void log(const char *time, int loglevel, const char *source, const char *message);
 
+    // deliver logs to the MegaLogger on a thread of its own, through a
+    // ring of maxQueued records - logs that don't fit are dropped
+    void setAsync(bool enable, int maxQueued);
+    long long getDropped();
+
 private:
     MegaMutex mutex;
     MegaLogger *megaLogger;
+
+    struct Record
+    {
+        string time;
+        int level;
+        string source;
+        string message;
+    };
+
+    // the records are swapped out rather than copied, so that their
+    // buffers are reused and queueing doesn't allocate in steady state
+    vector<Record> ring;
+    size_t first;
+    size_t count;
+    MegaMutex queueMutex;
+    MegaSemaphore ready;
+    MegaThread *thread;
+    bool async;
+    bool exiting;
+    long long dropped;
+
+    static void *threadEntryPoint(void *param);
+    void drain();
+    void deliver(const char *time, int loglevel, const char *source, const char *message);
+};
+
+class MegaRequestPrivate;
+
+// open-addressing (linear probing) hash index of the requests in flight by
+// tag - drop-in replacement for map<int, MegaRequestPrivate*> without an
+// allocation per request
+// iteration order is unspecified; erasing an element does not invalidate
+// iterators to other elements, inserting may
+class MegaRequestMap
+{
+public:
+    typedef pair<int, MegaRequestPrivate *> value_type;
+
+    class iterator
+    {
+        value_type *slot;
+        value_type *last;
+
+        void skip();
+
+        friend class MegaRequestMap;
+
+    public:
+        value_type& operator*() const { return *slot; }
+        value_type* operator->() const { return slot; }
+
+        iterator& operator++();
+        iterator operator++(int);
+
+        bool operator==(const iterator& it) const { return slot == it.slot; }
+        bool operator!=(const iterator& it) const { return slot != it.slot; }
+
+        iterator();
+        iterator(value_type *, value_type *);
+    };
+
+    iterator begin();
+    iterator end();
+
+    iterator find(int);
+
+    // the request with the tag, which must be present
+    MegaRequestPrivate *at(int) const;
+
+    // insert an empty slot for the tag if not present
+    MegaRequestPrivate *&operator[](int);
+
+    size_t erase(int);
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+    MegaRequestMap();
+    ~MegaRequestMap();
+
+private:
+    // slot markers - request tags are positive
+    static const int EMPTYSLOT = -1;
+    static const int DELETEDSLOT = -2;
+
+    static const size_t MINSLOTS = 64;
+
+    value_type *slots;
+    size_t mask;
+    size_t count;
+
+    // occupied plus deleted slots
+    size_t used;
+
+    static size_t hash(int);
+
+    // slot for the tag or NULL
+    value_type *lookup(int) const;
+
+    void rehash(size_t);
+
+    MegaRequestMap(const MegaRequestMap&);
+    MegaRequestMap& operator=(const MegaRequestMap&);
+};
+
+#ifdef ENABLE_SYNC
+// tree state of synced local paths by full local path, kept by the SDK
+// thread from syncupdate_treestate() and readable from any thread without
+// the SDK lock - the paths are spread over shards by hash, each with a
+// shared lock, so readers don't block each other and rarely meet the writer
+class SyncStateIndex
+{
+public:
+    void set(const string& path, int state);
+    bool get(const string& path, int* state);
+    void erase(const string& path);
+
+    SyncStateIndex();
+
+private:
+    static const unsigned NUMSHARDS = 32;
+
+    struct Shard
+    {
+        MegaSharedMutex mutex;
+        map<string, int> states;
+    };
+
+    Shard shards[NUMSHARDS];
+
+    Shard *shard(const string& path);
+};
+#endif
+
+// runs parallel jobs of the MegaClient (e.g. node decryption) on a set of
+// short-lived MegaThreads that pick up job indexes in turn
+class MegaThreadRunner : public ParallelRunner
+{
+public:
+    MegaThreadRunner(int threads);
+    void run(unsigned n, void (*job)(unsigned, void*), void* param);
+
+private:
+    struct Batch
+    {
+        MegaMutex mutex;
+        unsigned next;
+        unsigned n;
+        void (*job)(unsigned, void*);
+        void* param;
+    };
+
+    int threads;
+
+    static void *threadEntryPoint(void *param);
+};
+
+// optional index of decrypted node names for searches by substring, prefix
+// or extension: the lowercase name of every node plus trigram postings over
+// them, persisted (encrypted with the master key) in its own table next to
+// the state cache
+class MegaNameIndex
+{
+public:
+    MegaNameIndex();
+    ~MegaNameIndex();
+
+    // index a node under its current name (decrypting it if necessary), or
+    // drop it if it has no usable name
+    void add(Node *n);
+    void remove(handle h);
+
+    bool contains(handle h) const;
+
+    // drop the entries of nodes that no longer exist
+    void prune(node_map *nodes);
+
+    // handles of the indexed nodes whose names match, unordered
+    void find(const char *query, int matchType, handle_vector *results) const;
+
+    // postings are only sorted at the end of a bulk build
+    void beginBuild();
+    void endBuild();
+
+    // bind to a table and load its entries if they were saved at scsn,
+    // otherwise empty it - returns whether entries were loaded
+    bool open(DbTable *table, SymmCipher *key, handle scsn);
+
+    // write pending changes and the scsn they correspond to
+    void flush(handle scsn);
+
+    // drop all entries, optionally deleting the table, and unbind it
+    void clear(bool removeTable = false);
+
+    size_t size() const { return entries.size(); }
+
+    // minimum query length served by the trigram postings - shorter queries
+    // scan all names
+    static const unsigned GRAM = 3;
+
+private:
+    struct Entry : public Cachable
+    {
+        handle h;
+        string name;
+
+        bool serialize(string *d);
+    };
+
+    typedef map<handle, Entry> entry_map;
+    entry_map entries;
+
+    // trigram -> handles of the nodes whose names contain it (sorted unless
+    // building)
+    typedef map<uint32_t, handle_vector> gram_map;
+    gram_map grams;
+
+    bool building;
+
+    DbTable *table;
+    SymmCipher *key;
+    handle savedscsn;
+    handle_set dirty;
+    vector<int32_t> deleted;
+
+    static void lowercase(const char *name, string *lower);
+    static uint32_t gram(const char *p);
+    static bool matches(const string &name, const string &query, int matchType);
+
+    void addGrams(handle h, const string &name);
+    void removeGrams(handle h, const string &name);
+
+    MegaNameIndex(const MegaNameIndex&);
+    MegaNameIndex& operator=(const MegaNameIndex&);
+};
+
+// SDK-wide reader/writer lock: the SDK thread and state-changing calls take it
+// exclusively, read-only getters share it
+// keeps wait and hold time statistics (in microseconds) and logs slow locks;
+// hold times are only measured for exclusive holds
+class MegaSdkMutex
+{
+public:
+    // waits and exclusive holds longer than this are logged
+    static const long long SLOWLOCK = 100000;
+
+    struct Stats
+    {
+        long long exclusiveLocks;
+        long long sharedLocks;
+        long long waitTime;
+        long long maxWaitTime;
+        long long holdTime;
+        long long maxHoldTime;
+    };
+
+    MegaSdkMutex();
+    void init();
+
+    void lock();
+    void unlock();
+    void lockShared();
+    void unlockShared();
+
+    void getStats(Stats *stats);
+
+    // monotonic clock in microseconds
+    static long long now();
+
+private:
+    MegaSharedMutex mutex;
+    MegaMutex statsMutex;
+    Stats stats;
+
+    // exclusive recursion depth and time of the outermost acquisition, only
+    // accessed by the exclusive owner
+    int depth;
+    long long lockedAt;
+
+    void recordWait(long long waited, bool shared);
+};
+
+// bounded, direct-mapped cache of path <-> node handle resolutions - a
+// colliding entry replaces the previous one, and the whole cache is flushed
+// when nodes are added, renamed, moved or removed
+class MegaPathCache
+{
+public:
+    static const unsigned SLOTS = 4096;
+
+    MegaPathCache();
+
+    bool findNode(handle cwd, const char *path, handle *h);
+    void addNode(handle cwd, const char *path, handle h);
+
+    bool findPath(handle h, string *path);
+    void addPath(handle h, const string *path);
+
+    void clear();
+
+    // heap memory used by the cached paths in bytes
+    size_t allocated() const;
+
+private:
+    struct NodeEntry
+    {
+        handle cwd;
+        string path;
+        handle h;
+    };
+
+    struct PathEntry
+    {
+        handle h;
+        string path;
+    };
+
+    vector<NodeEntry> nodes;
+    vector<PathEntry> paths;
+
+    static unsigned hash(handle h, const char *path);
 };
 
 class MegaTransferPrivate;
-class MegaFolderUploadController : public MegaRequestListener, public MegaTransferListener
+struct UploadBatch;
+
+// uploads a local folder tree as a single transfer: the tree is listed on a
+// worker thread, the missing folders are created with one putnodes tree per
+// existing parent, then all files are started as one upload batch (see
+// MegaApiImpl::sendPendingUploads)
+class MegaFolderUploadController : public MegaTransferListener
 {
 public:
     MegaFolderUploadController(MegaApiImpl *megaApi, MegaTransferPrivate *transfer);
     void start();
 
+    // result of a putnodes tree sent with the given tag (the NewNode array
+    // is deleted here)
+    void onTreeCreated(int treeTag, error e, NewNode *nn);
+
 protected:
-    void onFolderAvailable(MegaHandle handle);
+    struct FolderEntry
+    {
+        // UTF-8 path and normalized name
+        string path;
+        string name;
+
+        int parent;
+        handle h;
+
+        // children, listed together
+        size_t firstFolder, numFolders;
+        size_t firstFile, numFiles;
+    };
+
+    struct FileEntry
+    {
+        string path;
+        string name;
+        m_off_t size;
+        bool exists;
+    };
+
+    struct ScanTask;
+
+    void scan(FileSystemAccess *fsaccess, size_t folder);
+    void onScanned();
+    void startUploads();
     void checkCompletion();
 
-    std::list<std::string> pendingFolders;
-    std::list<MegaTransferPrivate *> pendingSkippedTransfers;
+    // folders parents first (the first is the root)
+    vector<FolderEntry> folders;
+    vector<FileEntry> files;
+
+    // created folders by tag of their putnodes tree
+    map<int, vector<int> > trees;
 
     MegaApiImpl *megaApi;
     MegaClient *client;
-    const char* name;
     handle parenthandle;
     MegaTransferPrivate *transfer;
-    MegaTransferListener *listener;
-    int recursive;
+    bool followsymlinks;
+    bool creatingFolders;
+    bool submitted;
     int tag;
     int pendingTransfers;
 
 public:
-    virtual void onRequestFinish(MegaApi* api, MegaRequest *request, MegaError *e);
     virtual void onTransferStart(MegaApi *api, MegaTransfer *transfer);
     virtual void onTransferUpdate(MegaApi *api, MegaTransfer *transfer);
     virtual void onTransferFinish(MegaApi* api, MegaTransfer *transfer, MegaError *e);
 };
 
+// downloads a folder tree as a single transfer: the local folders are
+// created on a worker thread first, then the files are queued smallest first
+// with their temporary URLs requested ahead in batches
+class MegaFolderDownloadController : public MegaTransferListener
+{
+public:
+    MegaFolderDownloadController(MegaApiImpl *megaApi, MegaTransferPrivate *transfer);
+    void start();
+
+    // temporary URLs requested per batch, the next one when half of the
+    // previous one has been used
+    static const unsigned TEMPURLBATCH = 32;
+
+protected:
+    struct FileEntry
+    {
+        handle h;
+        m_off_t size;
+        unsigned folder;
+    };
+
+    struct FolderTask;
+
+    void scan(Node *node, const string *path);
+    void onFoldersCreated(error e);
+    void prefetch();
+    void checkCompletion();
+
+    static bool smaller(const FileEntry &a, const FileEntry &b);
+
+    // local paths (UTF-8) of the folders, parents first
+    vector<string> folders;
+    vector<FileEntry> files;
+    string separator;
+
+    MegaApiImpl *megaApi;
+    MegaClient *client;
+    MegaTransferPrivate *transfer;
+    int tag;
+    int pendingTransfers;
+    size_t finished;
+    size_t prefetched;
+
+public:
+    virtual void onTransferStart(MegaApi *api, MegaTransfer *transfer);
+    virtual void onTransferUpdate(MegaApi *api, MegaTransfer *transfer);
+    virtual void onTransferFinish(MegaApi* api, MegaTransfer *transfer, MegaError *e);
+};
+
+// finishes an upload that was satisfied by copying an existing node with the
+// same fingerprint (see MegaApi::startUploads)
+class MegaUploadCopyListener : public MegaRequestListener
+{
+public:
+    MegaUploadCopyListener(MegaApiImpl *megaApi, MegaTransferPrivate *transfer);
+    virtual void onRequestFinish(MegaApi* api, MegaRequest *request, MegaError *e);
+
+protected:
+    MegaApiImpl *megaApi;
+    MegaTransferPrivate *transfer;
+};
+
 class MegaNodePrivate : public MegaNode
 {
     public:
@@ -200,6 +638,9 @@ class MegaNodePrivate : public MegaNode
         bool isRemoved();
         virtual bool hasChanged(int changeType);
         virtual int getChanges();
+        virtual MegaHandle getPreviousParentHandle();
+        virtual const char *getPreviousName();
+        virtual int64_t getSizeDelta();
         virtual bool hasThumbnail();
         virtual bool hasPreview();
         virtual bool isPublic();
@@ -219,6 +660,9 @@ class MegaNodePrivate : public MegaNode
         static MegaNode *fromNode(Node *node);
         virtual MegaNode *copy();
 
+        // add the changes of an earlier notification of the same node
+        void mergeChanges(MegaNodePrivate *previous);
+
     protected:
         MegaNodePrivate(Node *node);
         int type;
@@ -234,6 +678,9 @@ class MegaNodePrivate : public MegaNode
         std::string auth;
         int tag;
         int changed;
+        MegaHandle prevParentHandle;
+        const char *prevName;
+        int64_t sizeDelta;
         struct {
             bool thumbnailAvailable : 1;
             bool previewAvailable : 1;
@@ -249,6 +696,35 @@ class MegaNodePrivate : public MegaNode
 #endif
 };
 
+// MegaNodeView over an internal Node, retargeted to each visited node
+class MegaNodeViewPrivate : public MegaNodeView
+{
+    public:
+        MegaNodeViewPrivate();
+        void setNode(Node *node);
+
+        virtual MegaNode *copy();
+        virtual int getType();
+        virtual const char *getName();
+        virtual MegaHandle getHandle();
+        virtual MegaHandle getParentHandle();
+        virtual int64_t getSize();
+        virtual int64_t getCreationTime();
+        virtual int64_t getModificationTime();
+        virtual const char *getFingerprint();
+        virtual bool isFile();
+        virtual bool isFolder();
+        virtual bool hasThumbnail();
+        virtual bool hasPreview();
+
+    protected:
+        Node *node;
+
+        // computed on demand, reused across nodes
+        string fingerprint;
+        bool fingerprintValid;
+};
+
 
 class MegaUserPrivate : public MegaUser
 {
@@ -293,6 +769,8 @@ class MegaSharePrivate : public MegaShare
 		int64_t ts;
 };
 
+class MegaStreamingRing;
+
 class MegaTransferPrivate : public MegaTransfer
 {
 	public:
@@ -327,6 +805,22 @@ class MegaTransferPrivate : public MegaTransfer
         void setLastBytes(char *lastBytes);
         void setLastErrorCode(error errorCode);
         void setFolderTransferTag(int tag);
+        void setStreamingRing(MegaStreamingRing *ring);
+        MegaStreamingRing *getStreamingRing() const;
+        void setOutputStream(MegaOutputStream *stream);
+        MegaOutputStream *getOutputStream() const;
+        void setQueueRecord(uint32_t record);
+        uint32_t getQueueRecord() const;
+        void setUpdateSequence(long long sequence);
+        long long getUpdateSequence() const;
+        void setKnownFingerprint(FileFingerprint *fingerprint);
+        FileFingerprint *getKnownFingerprint();
+        void setReported(long long bytes, int64_t time);
+        long long getReportedBytes() const;
+        int64_t getReportedTime() const;
+
+        // record a phase (MegaTransfer::TIMING_*) at the current time
+        void setTiming(int phase);
 
 		virtual int getType() const;
 		virtual const char * getTransferString() const;
@@ -359,6 +853,7 @@ class MegaTransferPrivate : public MegaTransfer
         virtual error getLastErrorCode() const;
         virtual bool isFolderTransfer() const;
         virtual int getFolderTransferTag() const;
+        virtual int64_t getTiming(int phase) const;
 
 	protected:		
 		int type;
@@ -387,6 +882,45 @@ class MegaTransferPrivate : public MegaTransfer
         Transfer *transfer;
         error lastError;
         int folderTransferTag;
+        MegaStreamingRing *streamingRing;
+        MegaOutputStream *outputStream;
+
+        // transfer cache record of the transfer (0: not persisted)
+        uint32_t queueRecord;
+
+        // MegaApiImpl::transferSequence at the last change of the transfer
+        long long updateSequence;
+
+        // fingerprint of the file to upload passed by the app (invalid:
+        // none), used while the size and mtime of the file match - not
+        // copied, only the SDK's own instance starts the upload
+        FileFingerprint knownFingerprint;
+
+        // bytes and time of the last onTransferUpdate of a throttled
+        // streaming transfer
+        long long reportedBytes;
+        int64_t reportedTime;
+
+        // MegaSdkMutex::now() by MegaTransfer::TIMING_*
+        int64_t timings[MegaTransfer::TIMING_CALLBACK + 1];
+};
+
+class MegaTransferProgressPrivate : public MegaTransferProgress
+{
+public:
+    MegaTransferProgressPrivate();
+
+    virtual MegaTransferProgress *copy();
+    virtual int getNumTransfers(int type) const;
+    virtual long long getTransferredBytes(int type) const;
+    virtual long long getTotalBytes(int type) const;
+    virtual long long getSpeed(int type) const;
+
+    // indexed by MegaTransfer::TYPE_DOWNLOAD / TYPE_UPLOAD
+    int numTransfers[2];
+    long long transferredBytes[2];
+    long long totalBytes[2];
+    long long speed[2];
 };
 
 class MegaContactRequestPrivate : public MegaContactRequest
@@ -473,6 +1007,7 @@ public:
     MegaSyncListener *getListener();
     virtual int getState() const;
     void setState(int state);
+    virtual long long getStats(int type) const;
 
 protected:
     MegaHandle megaHandle;
@@ -481,6 +1016,9 @@ protected:
     long long fingerprint;
     MegaSyncListener *listener;
     int state;
+
+    // snapshot of MegaApiImpl::getSyncStats() by type
+    vector<long long> stats;
 };
 
 #endif
@@ -518,9 +1056,20 @@ class MegaRequestPrivate : public MegaRequest
         void setTotalBytes(long long totalBytes);
         void setTransferredBytes(long long transferredBytes);
         void setTag(int tag);
+        void setNodeHandles(MegaNodeList *nodes);
+        const handle_vector& getNodeHandles() const;
+
+        // results of the nodes of bulk requests: all pending (duplicates
+        // fail), then set by handle - false if the node isn't pending
+        void initNodeResults();
+        bool setNodeResult(handle h, error e);
+        bool hasPendingNodes() const;
         void addProduct(handle product, int proLevel, int gbStorage, int gbTransfer,
                         int months, int amount, const char *currency, const char *description, const char *iosid, const char *androidid);
 
+        // record a phase (MegaRequest::TIMING_*), at the current time if 0
+        void setTiming(int phase, int64_t time = 0);
+
 		virtual int getType() const;
 		virtual const char *getRequestString() const;
 		virtual const char* toString() const;
@@ -550,8 +1099,10 @@ class MegaRequestPrivate : public MegaRequest
 		virtual MegaAccountDetails *getMegaAccountDetails() const;
         virtual int getTransferTag() const;
         virtual int getNumDetails() const;
+        virtual int getNodeErrorCode(int i) const;
         virtual int getTag() const;
         virtual MegaPricing *getPricing() const;
+        virtual int64_t getTiming(int phase) const;
 	    AccountDetails * getAccountDetails() const;
 
 #ifdef ENABLE_SYNC
@@ -589,6 +1140,16 @@ class MegaRequestPrivate : public MegaRequest
         MegaNode* publicNode;
 		int numRetry;
         int tag;
+
+        // nodes of bulk requests (not copied to the callback copies)
+        handle_vector nodeHandles;
+
+        // results by position in nodeHandles, positions still pending
+        vector<int> nodeErrors;
+        map<handle, size_t> pendingNodes;
+
+        // MegaSdkMutex::now() by MegaRequest::TIMING_*
+        int64_t timings[MegaRequest::TIMING_CALLBACK + 1];
 };
 
 class MegaAccountBalancePrivate : public MegaAccountBalance
@@ -758,17 +1319,88 @@ class MegaNodeListPrivate : public MegaNodeList
 	public:
         MegaNodeListPrivate();
         MegaNodeListPrivate(Node** newlist, int size);
+        MegaNodeListPrivate(vector<MegaNode*> *newlist);
         virtual ~MegaNodeListPrivate();
 		virtual MegaNodeList *copy();
 		virtual MegaNode* get(int i);
 		virtual int size();
+        virtual int getHandles(int start, MegaHandle *handles, int count);
+        virtual int getSizes(int start, int64_t *sizes, int count);
+        virtual int getModificationTimes(int start, int64_t *mtimes, int count);
+        virtual int getTypes(int start, int *types, int count);
+        virtual int getNames(int start, char *names, int size);
 	
 	protected:
         MegaNodeListPrivate(MegaNodeListPrivate *nodeList);
+
+        // number of nodes from start that fit in count (0 if out of range)
+        int span(int start, int count);
 		MegaNode** list;
 		int s;
 };
 
+class MegaHandleListPrivate : public MegaHandleList
+{
+    public:
+        MegaHandleListPrivate();
+        MegaHandleListPrivate(const MegaHandle *newlist, int size);
+        virtual ~MegaHandleListPrivate();
+        virtual MegaHandleList *copy();
+        virtual MegaHandle get(int i);
+        virtual int size();
+
+    protected:
+        vector<MegaHandle> list;
+};
+
+class MegaChildrenCursorPrivate : public MegaChildrenCursor
+{
+    public:
+        MegaChildrenCursorPrivate(MegaApiImpl *api, MegaHandle parentHandle, int order);
+        virtual MegaChildrenCursor *copy();
+        virtual MegaNodeList *next(int count);
+        virtual int getPosition();
+        virtual void setPosition(int position);
+
+    protected:
+        MegaApiImpl *api;
+        MegaHandle parentHandle;
+        int order;
+        int position;
+};
+
+// nodes in breadth-first order, so that the children of each node are
+// contiguous - only read after construction
+class MegaNodeSnapshotPrivate : public MegaNodeSnapshot
+{
+    public:
+        // copy the trees of the roots, with the SDK lock held by the caller
+        MegaNodeSnapshotPrivate(MegaApiImpl *api, const char *scsn, vector<Node *> *roots, int order);
+        MegaNodeSnapshotPrivate(MegaNodeSnapshotPrivate *snapshot);
+        virtual ~MegaNodeSnapshotPrivate();
+
+        virtual MegaNodeSnapshot *copy();
+        virtual const char *getSequenceNumber();
+        virtual int getNumNodes();
+        virtual MegaNode *getNodeByHandle(MegaHandle handle);
+        virtual MegaNode *getParentNode(MegaNode *node);
+        virtual int getNumChildren(MegaNode *parent);
+        virtual MegaNodeList *getChildren(MegaNode *parent);
+
+    protected:
+        string scsn;
+        vector<MegaNode *> nodes;
+
+        // position of the first child and number of children of each node
+        vector<int> firstChild;
+        vector<int> numChildren;
+
+        // position of each node by handle
+        map<MegaHandle, int> positions;
+
+        int find(MegaHandle handle) const;
+};
+
 class MegaUserListPrivate : public MegaUserList
 {
 	public:
@@ -845,9 +1477,14 @@ struct MegaFileGet : public MegaFile
     void progress();
     void completed(Transfer*, LocalNode*);
     void terminated();
+    bool failed(error e);
+
+    // deliver the data to a stream instead of localname
+    void setOutputStream(MegaOutputStream *stream);
+
 	MegaFileGet(MegaClient *client, Node* n, string dstPath);
     MegaFileGet(MegaClient *client, MegaNode* n, string dstPath);
-	~MegaFileGet() {}
+    ~MegaFileGet();
 };
 
 struct MegaFilePut : public MegaFile
@@ -871,42 +1508,42 @@ class TreeProcessor
 class SearchTreeProcessor : public TreeProcessor
 {
     public:
-        SearchTreeProcessor(const char *search);
+        SearchTreeProcessor(const char *search, int matchType = MegaApi::SEARCH_SUBSTRING, int limit = 0);
         virtual bool processNode(Node* node);
         virtual ~SearchTreeProcessor() {}
         vector<Node *> &getResults();
 
+        static bool matches(const char *name, const char *search, int matchType);
+
     protected:
         const char *search;
+        int matchType;
+        int limit;
         vector<Node *> results;
 };
 
-class OutShareProcessor : public TreeProcessor
-{
-    public:
-        OutShareProcessor();
-        virtual bool processNode(Node* node);
-        virtual ~OutShareProcessor() {}
-        vector<Share *> &getShares();
-        vector<handle> &getHandles();
-
-    protected:
-        vector<Share *> shares;
-        vector<handle> handles;
-};
-
-class PendingOutShareProcessor : public TreeProcessor
+// the conditions of a MegaNodeQuery evaluated on the SDK's nodes - read
+// only, so that it can be shared by the query threads
+class NodeQueryFilter
 {
     public:
-        PendingOutShareProcessor();
-        virtual bool processNode(Node* node);
-        virtual ~PendingOutShareProcessor() {}
-        vector<Share *> &getShares();
-        vector<handle> &getHandles();
+        NodeQueryFilter(MegaNodeQuery *query);
+        bool matches(Node *node) const;
 
     protected:
-        vector<Share *> shares;
-        vector<handle> handles;
+        int type;
+        string name;
+        bool hasName;
+        int matchType;
+        int64_t minSize;
+        int64_t maxSize;
+        int64_t minCtime;
+        int64_t maxCtime;
+        int64_t minMtime;
+        int64_t maxMtime;
+        int thumbnail;
+        int preview;
+        int shareState;
 };
 
 class SizeProcessor : public TreeProcessor
@@ -920,18 +1557,151 @@ class SizeProcessor : public TreeProcessor
         long long getTotalBytes();
 };
 
-//Thread safe request queue
-class RequestQueue
+// pointer compare-and-swap, returns the previous value (full barrier)
+inline void* atomicCompareSwap(void* volatile* target, void* expected, void* desired)
+{
+#ifdef _MSC_VER
+    return InterlockedCompareExchangePointer(target, desired, expected);
+#else
+    return __sync_val_compare_and_swap(target, expected, desired);
+#endif
+}
+
+// lock-free multi-producer single-consumer queue
+// producers push onto a linked stack with compare-and-swap and never block;
+// the consumer takes the whole stack at once and restores the FIFO order
+// in a private deque, so push() can report the empty-to-non-empty
+// transition and the caller only wakes up the consumer once per batch
+// the consumer-side mutex is only contended by operations that need to
+// see every pending item (see RequestQueue::removeListener)
+template <class T>
+class MegaMPSCQueue
 {
     protected:
-        std::deque<MegaRequestPrivate *> requests;
+        struct Item
+        {
+            T* value;
+            Item* next;
+        };
+
+        Item* volatile head;
+        std::deque<T*> items;
         MegaMutex mutex;
 
+        // move the pushed items to the deque - called with mutex held
+        void drain()
+        {
+            Item* item = head;
+
+            // take the stack, retrying while producers keep pushing onto it
+            while (item)
+            {
+                Item* current = (Item*)atomicCompareSwap((void* volatile*)&head, item, NULL);
+
+                if (current == item)
+                {
+                    break;
+                }
+
+                item = current;
+            }
+
+            // the stack is newest first
+            Item* oldest = NULL;
+
+            while (item)
+            {
+                Item* next = item->next;
+                item->next = oldest;
+                oldest = item;
+                item = next;
+            }
+
+            while (oldest)
+            {
+                Item* next = oldest->next;
+                items.push_back(oldest->value);
+                delete oldest;
+                oldest = next;
+            }
+        }
+
+    public:
+        MegaMPSCQueue()
+        {
+            head = NULL;
+            mutex.init(false);
+        }
+
+        ~MegaMPSCQueue()
+        {
+            mutex.lock();
+            drain();
+            mutex.unlock();
+        }
+
+        // returns true if the queue was empty, so the consumer must be woken up
+        bool push(T* value)
+        {
+            Item* item = new Item;
+            Item* top = head;
+
+            item->value = value;
+
+            for (;;)
+            {
+                item->next = top;
+
+                Item* current = (Item*)atomicCompareSwap((void* volatile*)&head, top, item);
+
+                if (current == top)
+                {
+                    return !top;
+                }
+
+                top = current;
+            }
+        }
+
+        // not lock-free - requeues an item ahead of all others
+        void push_front(T* value)
+        {
+            mutex.lock();
+            drain();
+            items.push_front(value);
+            mutex.unlock();
+        }
+
+        // consumer only
+        T* pop()
+        {
+            T* value = NULL;
+
+            mutex.lock();
+            if (items.empty())
+            {
+                drain();
+            }
+
+            if (!items.empty())
+            {
+                value = items.front();
+                items.pop_front();
+            }
+            mutex.unlock();
+
+            return value;
+        }
+
+    private:
+        MegaMPSCQueue(const MegaMPSCQueue&);
+        MegaMPSCQueue& operator=(const MegaMPSCQueue&);
+};
+
+//Thread safe request queue
+class RequestQueue : public MegaMPSCQueue<MegaRequestPrivate>
+{
     public:
-        RequestQueue();
-        void push(MegaRequestPrivate *request);
-        void push_front(MegaRequestPrivate *request);
-        MegaRequestPrivate * pop();
         void removeListener(MegaRequestListener *listener);
 #ifdef ENABLE_SYNC
         void removeListener(MegaSyncListener *listener);
@@ -940,18 +1710,355 @@ class RequestQueue
 
 
 //Thread safe transfer queue
-class TransferQueue
+class TransferQueue : public MegaMPSCQueue<MegaTransferPrivate>
 {
-    protected:
-        std::deque<MegaTransferPrivate *> transfers;
-        MegaMutex mutex;
+};
 
-    public:
-        TransferQueue();
-        void push(MegaTransferPrivate *transfer);
-        void push_front(MegaTransferPrivate *transfer);
-        MegaTransferPrivate * pop();
+// uploads submitted together with MegaApi::startUploads
+struct UploadBatch
+{
+    vector<MegaTransferPrivate *> transfers;
+    bool copyDuplicates;
+
+    // fingerprints of the files by index, reused while size and mtime
+    // match (empty: none known)
+    vector<FileFingerprint> fingerprints;
+};
+
+class UploadBatchQueue : public MegaMPSCQueue<UploadBatch>
+{
+};
+
+// an upload beyond the limit of MegaApi::setUploadQueueLimit, kept in this
+// compact form until the running uploads make room for it
+struct QueuedUpload
+{
+    string localPath;
+    string fileName;
+    MegaHandle parentHandle;
+    int64_t mtime;
+    int folderTransferTag;
+    MegaTransferListener *listener;
+    bool copyDuplicates;
+
+    // transfer cache record (0: none) and fingerprint of the file, if known
+    uint32_t record;
+    FileFingerprint fingerprint;
+};
+
+// buffers lent to the app by a streaming transfer started with
+// startStreamingToBuffers: decrypted data is copied into available buffers,
+// what does not fit waits in overflow until the app releases one
+// (the core can not pause a direct read)
+class MegaStreamingRing
+{
+public:
+    MegaStreamingRing(char **buffers, int count, size_t size);
+    ~MegaStreamingRing();
+
+    vector<char *> buffers;
+    vector<bool> lent;
+    deque<int> available;
+    size_t bufferSize;
+    bool owned;
+
+    string overflow;
+    m_off_t overflowPos;
+
+    // all data received, the finish waits for the overflow to be delivered
+    bool finishing;
+
+    // the transfer finished, the ring is deleted when all buffers are back
+    bool finished;
+
+    dstime lastUpdate;
+};
+
+// derives the password keys of a login or password change on a thread of
+// its own, so that the SDK loop keeps running - the request queue waits for
+// it to keep the order of the requests
+class MegaPwKeyDerivation
+{
+public:
+    MegaPwKeyDerivation(MegaRequestPrivate *request, MegaWaiter *waiter);
+    ~MegaPwKeyDerivation();
+
+    // requests that derive password keys
+    static bool needed(MegaRequestPrivate *request);
+
+    bool isDone();
+
+    MegaRequestPrivate *request;
+    byte pwkey[SymmCipher::KEYLENGTH];
+    byte newpwkey[SymmCipher::KEYLENGTH];
+    error e;
+
+protected:
+    MegaWaiter *waiter;
+    MegaThread thread;
+    MegaMutex mutex;
+    bool done;
+
+    static void *threadEntryPoint(void *param);
+};
+
+// a listener callback to be delivered by the callback thread, with copies
+// of the objects the SDK passes to listeners - shared by all the listeners
+// it is queued for
+class MegaCallbackEvent
+{
+public:
+    enum {
+        REQUEST_START, REQUEST_FINISH, REQUEST_UPDATE, REQUEST_TEMPORARY_ERROR,
+        TRANSFER_START, TRANSFER_FINISH, TRANSFER_UPDATE, TRANSFER_TEMPORARY_ERROR,
+        TRANSFERS_PROGRESS,
+        USERS_UPDATE, CONTACT_REQUESTS_UPDATE, NODES_UPDATE, ACCOUNT_UPDATE, RELOAD_NEEDED,
+        GLOBAL_SYNC_STATE_CHANGED,
+        SYNC_STATE_CHANGED, SYNC_EVENT, SYNC_FILE_STATE_CHANGED
+    };
+
+    MegaCallbackEvent(int type);
+    ~MegaCallbackEvent();
+
+    int type;
+    MegaRequest *request;
+    MegaTransfer *transfer;
+    MegaError *error;
+    MegaUserList *users;
+    MegaContactRequestList *contactRequests;
+    MegaNodeList *nodes;
+    MegaTransferProgress *progress;
+#ifdef ENABLE_SYNC
+    MegaSync *sync;
+    MegaSyncEvent *syncEvent;
+#endif
+    string path;
+    int state;
+
+    // time of queueing (MegaSdkMutex::now())
+    long long queued;
+
+    // listeners still to deliver to, plus one while being queued
+    int refs;
+};
+
+// delivers listener callbacks on a thread of its own, in the order they were
+// queued, so that slow listeners don't stall the SDK thread - the SDK thread
+// waits (outside the SDK mutex) while more than maxPending callbacks are
+// queued
+class MegaCallbackExecutor
+{
+public:
+    enum { LISTENER, REQUEST_LISTENER, TRANSFER_LISTENER, GLOBAL_LISTENER, SYNC_LISTENER };
+
+    MegaCallbackExecutor(MegaApi *api);
+    ~MegaCallbackExecutor();
+
+    // start delivering queued callbacks (enabled is only changed by the
+    // SDK mutex holder)
+    void start(int maxPending);
+    void disable();
+    bool isEnabled();
+
+    // deliver what is queued and stop the thread
+    void stop();
+
+    // queue an event for a listener, or a set of them
+    void add(MegaCallbackEvent *event, int kind, void *listener);
+
+    template <class L>
+    void add(MegaCallbackEvent *event, int kind, const set<L *>& ls)
+    {
+        for (typename set<L *>::const_iterator it = ls.begin(); it != ls.end(); it++)
+        {
+            add(event, kind, *it);
+        }
+    }
+
+    // drop the queueing reference
+    void done(MegaCallbackEvent *event);
+
+    // block while the queue is full
+    void waitForSpace();
+
+    // drop queued callbacks for a listener and wait until no listener is
+    // being called (unless from the callback thread)
+    void removeListener(void *listener);
+
+    long long getStats(int type);
+
+protected:
+    struct Entry
+    {
+        MegaCallbackEvent *event;
+        int kind;
+        void *listener;
+    };
+
+    MegaApi *api;
+    MegaThread *thread;
+    MegaMutex mutex;
+    MegaSemaphore ready;
+    MegaSemaphore space;
+    deque<Entry> queue;
+    bool enabled;
+    bool running;
+    bool stopping;
+    bool producerWaiting;
+    int maxPending;
+
+    // held (recursively) while calling a listener
+    MegaMutex deliverMutex;
+
+    long long maxQueued;
+    long long delivered;
+    long long backpressureWaits;
+    long long listenerTime;
+    long long maxListenerTime;
+    long long maxDelay;
+
+    void release(MegaCallbackEvent *event);
+    void deliver(Entry *entry);
+    void run();
+    static void *threadEntryPoint(void *param);
+};
+
+class MegaFileRead;
+
+class MegaFileHandlePrivate : public MegaFileHandle
+{
+public:
+    MegaFileHandlePrivate(MegaApiImpl *api, MegaNode *node);
+    virtual ~MegaFileHandlePrivate();
+
+    virtual MegaHandle getNodeHandle() const;
+    virtual long long getSize() const;
+
+    MegaApiImpl *api;
+    MegaNode *node;
+
+    // reads in progress by offset and size (guarded by the SDK mutex)
+    map<pair<m_off_t, m_off_t>, MegaFileRead *> reads;
+};
+
+// read of an open file, shared by the identical reads started before its
+// first data arrived
+class MegaFileRead : public MegaTransferListener
+{
+public:
+    MegaFileRead(MegaFileHandlePrivate *file, m_off_t offset, m_off_t size);
+
+    virtual void onTransferStart(MegaApi *api, MegaTransfer *transfer);
+    virtual void onTransferUpdate(MegaApi *api, MegaTransfer *transfer);
+    virtual void onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError *e);
+    virtual bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size);
+    virtual void onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e);
+
+    // NULL once the file is closed
+    MegaFileHandlePrivate *file;
+    pair<m_off_t, m_off_t> range;
+
+    vector<MegaTransferListener *> listeners;
+
+    // listeners that still want data
+    vector<bool> active;
+
+    bool receiving;
+};
+
+class MegaHTTPServer;
+
+#ifndef _WIN32
+// client connection of the embedded HTTP server: requests are parsed by the
+// server thread, the decrypted data arrives in onTransferData on the SDK
+// thread and is written to the socket right away, only the part the socket
+// does not take is queued
+class MegaHTTPConnection : public MegaTransferListener
+{
+public:
+    MegaHTTPConnection(MegaHTTPServer *server, int fd);
+    ~MegaHTTPConnection();
+
+    virtual bool onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size);
+    virtual void onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e);
+
+private:
+    friend class MegaHTTPServer;
+
+    // the server thread and the SDK thread share the socket, the output
+    // queue and the state of the streaming window
+    MegaMutex mutex;
+    MegaHTTPServer *server;
+    int fd;
+    deque<string> output;
+    size_t outputOffset;
+    size_t outputBytes;
+    bool streaming;
+    bool failed;
+    bool closed;
+
+    // server thread only: pending request data and the response in progress
+    string input;
+    bool responding;
+    bool keepAlive;
+    MegaNode *node;
+    int64_t streamPos;
+    int64_t streamEnd;
+
+    // write queued data followed by the given buffer (if any) with one
+    // writev() and queue what the socket did not take
+    bool send(const char *data, size_t len);
+};
+
+// embedded HTTP/1.1 server for the nodes that have a local link
+// (MegaApi::httpServerGetLocalLink): GET and HEAD with single byte ranges,
+// keep-alive and any number of connections, each served by its own
+// startStreaming() reads of at most WINDOWSIZE bytes
+class MegaHTTPServer
+{
+public:
+    static const int64_t WINDOWSIZE = 4194304;
+    static const size_t MAXHEADERSIZE = 16384;
+
+    MegaHTTPServer(MegaApiImpl *api);
+    ~MegaHTTPServer();
+
+    bool start(int port, bool localOnly);
+    void stop();
+    int getPort();
+
+    // nodes accessible through the server
+    void allow(MegaHandle h);
+
+    // wake the server thread up
+    void notify();
+
+private:
+    friend class MegaHTTPConnection;
+
+    MegaApiImpl *api;
+    MegaThread thread;
+    MegaMutex mutex;
+    set<MegaHandle> allowed;
+    list<MegaHTTPConnection *> connections;
+    int listenFd;
+    int wakeFds[2];
+    int port;
+    bool exiting;
+
+    static void *threadEntryPoint(void *param);
+    void loop();
+
+    // handle the complete request at the beginning of the input, if any
+    void processRequest(MegaHTTPConnection *c);
+    void sendStatus(MegaHTTPConnection *c, int status, const char *reason, const char *headers = NULL);
+
+    // start the next streaming window of the response, or finish it
+    void continueResponse(MegaHTTPConnection *c);
+
+    static const char *contentType(const char *name);
 };
+#endif
 
 class MegaApiImpl : public MegaApp
 {
@@ -983,6 +2090,7 @@ class MegaApiImpl : public MegaApp
 
         //Utils
         char *getBase64PwKey(const char *password);
+        MegaStringList *getBase64PwKeys(MegaStringList *passwords, int threads);
         char *getStringHash(const char* base64pwkey, const char* inBuf);
         void getSessionTransferURL(const char *path, MegaRequestListener *listener);
         static MegaHandle base32ToHandle(const char* base32Handle);
@@ -991,6 +2099,7 @@ class MegaApiImpl : public MegaApp
         static char *userHandleToBase64(MegaHandle handle);
         static const char* ebcEncryptKey(const char* encryptionKey, const char* plainKey);
         void retryPendingConnections(bool disconnect = false, bool includexfers = false, MegaRequestListener* listener = NULL);
+        void setNetworkBatching(int maxDelayMs);
         static void addEntropy(char* data, unsigned int size);
 
         //API requests
@@ -1004,6 +2113,7 @@ class MegaApiImpl : public MegaApp
         void getUserData(MegaUser *user, MegaRequestListener *listener = NULL);
         void getUserData(const char *user, MegaRequestListener *listener = NULL);
         void getAccountDetails(bool storage, bool transfer, bool pro, bool sessions, bool purchases, bool transactions, MegaRequestListener *listener = NULL);
+        void setAccountDetailsCacheTtl(int seconds);
         void createAccount(const char* email, const char* password, const char* name, MegaRequestListener *listener = NULL);
         void fastCreateAccount(const char* email, const char *base64pwkey, const char* name, MegaRequestListener *listener = NULL);
         void querySignupLink(const char* link, MegaRequestListener *listener = NULL);
@@ -1017,14 +2127,20 @@ class MegaApiImpl : public MegaApp
         char* getMyXMPPJid();
         static void setLogLevel(int logLevel);
         static void setLoggerClass(MegaLogger *megaLogger);
+        static void setAsyncLogging(bool enable, int maxQueued);
+        static long long getDroppedLogs();
+        static void setEventBackend(int backend);
         static void log(int logLevel, const char* message, const char *filename = NULL, int line = -1);
 
         void createFolder(const char* name, MegaNode *parent, MegaRequestListener *listener = NULL);
         void moveNode(MegaNode* node, MegaNode* newParent, MegaRequestListener *listener = NULL);
+        void moveNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener = NULL);
+        void copyNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener = NULL);
         void copyNode(MegaNode* node, MegaNode *newParent, MegaRequestListener *listener = NULL);
         void copyNode(MegaNode* node, MegaNode *newParent, const char* newName, MegaRequestListener *listener = NULL);
         void renameNode(MegaNode* node, const char* newName, MegaRequestListener *listener = NULL);
         void remove(MegaNode* node, MegaRequestListener *listener = NULL);
+        void removeNodes(MegaNodeList *nodes, MegaRequestListener *listener = NULL);
         void cleanRubbishBin(MegaRequestListener *listener = NULL);
         void sendFileToUser(MegaNode *node, MegaUser *user, MegaRequestListener *listener = NULL);
         void sendFileToUser(MegaNode *node, const char* email, MegaRequestListener *listener = NULL);
@@ -1038,12 +2154,14 @@ class MegaApiImpl : public MegaApp
         void setThumbnail(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetPreview(MegaNode* node, MegaRequestListener *listener = NULL);
+        void prefetchThumbnails(MegaNodeList *nodes, int priority, MegaRequestListener *listener = NULL);
         void setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener = NULL);
         void getUserAvatar(MegaUser* user, const char *dstFilePath, MegaRequestListener *listener = NULL);
         void setAvatar(const char *dstFilePath, MegaRequestListener *listener = NULL);
         void getUserAttribute(MegaUser* user, int type, MegaRequestListener *listener = NULL);
         void setUserAttribute(int type, const char* value, MegaRequestListener *listener = NULL);
         void setCustomNodeAttribute(MegaNode *node, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
+        void setCustomNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener = NULL);
         void exportNode(MegaNode *node, int64_t expireTime, MegaRequestListener *listener = NULL);
         void disableExport(MegaNode *node, MegaRequestListener *listener = NULL);
         void fetchNodes(MegaRequestListener *listener = NULL);
@@ -1081,22 +2199,70 @@ class MegaApiImpl : public MegaApp
         void startUpload(const char* localPath, MegaNode *parent, int64_t mtime, MegaTransferListener *listener=NULL);
         void startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener = NULL);
         void startUpload(const char* localPath, MegaNode* parent, const char* fileName,  int64_t mtime, int folderTransferTag = 0, MegaTransferListener *listener = NULL);
+        void startUploadWithFingerprint(const char* localPath, MegaNode* parent, const char* fingerprint, const char* fileName = NULL, int64_t mtime = -1, MegaTransferListener *listener = NULL);
+        void startUploads(MegaUploadBatch *uploads, bool copyDuplicates = false, MegaTransferListener *listener = NULL);
         void startDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
+        void startDownload(MegaHandle nodeHandle, const char* parentPath, int folderTransferTag, MegaTransferListener *listener = NULL);
+        void startUploads(UploadBatch *batch);
+        void startDownloadToStream(MegaNode* node, MegaOutputStream* stream, MegaTransferListener *listener);
         void startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener);
+        void startStreamingToBuffers(MegaNode* node, m_off_t startPos, m_off_t size, char **buffers, int numBuffers, size_t bufferSize, MegaTransferListener *listener);
+        void releaseStreamingBuffer(int transferTag, int buffer);
+        MegaFileHandle *openFile(MegaNode *node);
+        void readFile(MegaFileHandle *file, int64_t offset, int64_t size, MegaTransferListener *listener);
+        void closeFile(MegaFileHandlePrivate *file);
+        void prefetch(MegaNode *node, int64_t offset, int64_t size, int priority);
+        void cancelPrefetch(MegaNode *node);
         void startPublicDownload(MegaNode* node, const char* localPath, MegaTransferListener *listener = NULL);
         void cancelTransfer(MegaTransfer *transfer, MegaRequestListener *listener=NULL);
         void cancelTransferByTag(int transferTag, MegaRequestListener *listener = NULL);
+        void setTransferPriority(int transferTag, int priority, MegaRequestListener *listener = NULL);
+        void moveTransferToFirst(int transferTag, MegaRequestListener *listener = NULL);
+        void moveTransferToLast(int transferTag, MegaRequestListener *listener = NULL);
+        void moveTransferBefore(int transferTag, int nextTransferTag, MegaRequestListener *listener = NULL);
         void cancelTransfers(int direction, MegaRequestListener *listener=NULL);
         void pauseTransfers(bool pause, int direction, MegaRequestListener* listener=NULL);
         bool areTransfersPaused(int direction);
         void setUploadLimit(int bpslimit);
+        void setTransferConnections(int direction, int minConnections, int maxConnections);
+        void setTransferLimits(int direction, int maxTransfers, long long maxBytesInFlight, int maxConnections);
+        void setUploadNodeBatching(bool enable);
+        void setUploadQueueLimit(int limit);
+        void setPersistentTransferQueue(bool enable);
+        void setDownloadWriteBuffer(long long maxBufferedBytes);
+        void setBandwidthLimit(int direction, long long bytesPerSecond);
+        void setBandwidthClassLimit(int direction, int priority, long long bytesPerSecond);
+        void addBandwidthSchedule(int direction, int startMinute, int endMinute, long long bytesPerSecond);
+        void clearBandwidthSchedules(int direction);
+        void setNodeDecryptionThreads(int threads);
+        void setTransferCryptoThreads(int threads);
+        void setSyncScanThreads(int threads);
+        void setWorkerThreads(int threads);
+        void setNodeUpdateCoalescing(int milliseconds, int maxBatchSize);
         void setDownloadMethod(int method);
         void setUploadMethod(int method);
+        bool setHttp2(bool enable);
+        bool setRequestCompression(bool enable);
+        long long getCompressionStats(int type);
+        void setCallbackThread(bool enable, int maxPending);
+        long long getCallbackStats(int type);
+        void setTransferUpdateInterval(int ms);
+        void setTransfersProgressInterval(int ms);
+        char *getStorageHostStats();
+        char *getMetrics();
+        void setTracing(bool enable, int maxEvents);
+        char *getTrace();
+        void setWatchdog(int thresholdMs);
         int getDownloadMethod();
         int getUploadMethod();
         MegaTransferList *getTransfers();
         MegaTransfer* getTransferByTag(int transferTag);
         MegaTransferList *getTransfers(int type);
+        MegaTransferList *getTransfers(int type, int fromTag, int limit);
+        int getNumTransfers(int type);
+        int getNumTransfersInProgress(int type);
+        long long getTransfersSequence();
+        MegaTransferList *getTransfersChangedSince(long long sequence);
         MegaTransferList *getChildTransfers(int transferTag);
 
 #ifdef ENABLE_SYNC
@@ -1118,6 +2284,8 @@ class MegaApiImpl : public MegaApp
         bool is_syncable(const char* name);
         bool is_syncable(long long size);
         bool isIndexing();
+        long long getSyncStats(int tag, int type);
+        static long long getSyncStats(Sync *sync, int type);
 #endif
         void update();
         bool isWaiting();
@@ -1138,6 +2306,10 @@ class MegaApiImpl : public MegaApp
 		int getNumChildFiles(MegaNode* parent);
 		int getNumChildFolders(MegaNode* parent);
         MegaNodeList* getChildren(MegaNode *parent, int order=1);
+        MegaNodeList* getChildren(MegaNode *parent, int order, int offset, int limit);
+        MegaNodeList* getChildWindow(MegaHandle parentHandle, int order, int offset, int limit);
+        MegaChildrenCursor* getChildrenCursor(MegaNode *parent, int order=1);
+        MegaNodeSnapshot* getNodeSnapshot(MegaNode *node, int order);
         int getIndex(MegaNode* node, int order=1);
         MegaNode *getChildNode(MegaNode *parent, const char* name);
         MegaNode *getParentNode(MegaNode *node);
@@ -1160,6 +2332,21 @@ class MegaApiImpl : public MegaApp
 
         int getAccess(MegaNode* node);
         long long getSize(MegaNode *node);
+        int getNumTreeFiles(MegaNode *node);
+        int getNumTreeFolders(MegaNode *node);
+        long long getMemoryUsage(int type);
+        long long getTransferBufferPoolStats(int type);
+        void setStreamingCacheSize(long long bytes);
+        void setStreamingConnections(int connections);
+        long long getStreamingCacheStats(int type);
+        long long getKeyResolutionStats(int type);
+        long long onLowMemory(int level);
+        void setNodePaging(bool enable);
+        void setOfflineStartup(bool enable);
+        bool httpServerStart(bool localOnly, int port);
+        void httpServerStop();
+        int httpServerIsRunning();
+        char *httpServerGetLocalLink(MegaNode *node);
         static void removeRecursively(const char *path);
 
         //Fingerprint
@@ -1185,7 +2372,15 @@ class MegaApiImpl : public MegaApp
         MegaNode* getInboxNode();
         MegaNode *getRubbishNode();
         MegaNodeList* search(MegaNode* node, const char* searchString, bool recursive = 1);
+        MegaNodeList* search(MegaNode* node, const char* searchString, int matchType, int limit, bool recursive = 1);
+        void enableNameIndex(bool enable);
+        bool isNameIndexEnabled();
         bool processMegaTree(MegaNode* node, MegaTreeProcessor* processor, bool recursive = 1);
+        bool processNodeViews(MegaNode* node, MegaNodeViewProcessor* processor, bool recursive = 1);
+        bool processChildViews(MegaNode* parent, MegaNodeViewProcessor* processor, int order = 1);
+        MegaHandleList* queryNodes(MegaNode* node, MegaNodeQuery* query, int offset, int limit);
+        static void getNodeFingerprint(Node *node, string *result);
+        static bool parseFingerprint(const char *fingerprint, FileFingerprint *fp);
 
         MegaNode *createPublicFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime, MegaHandle parentHandle, const char *auth);
         MegaNode *createPublicFolderNode(MegaHandle handle, const char *name, MegaHandle parentHandle, const char *auth);
@@ -1207,6 +2402,8 @@ class MegaApiImpl : public MegaApp
         static bool nodeComparatorModificationDESC  (Node *i, Node *j);
         static bool nodeComparatorAlphabeticalASC  (Node *i, Node *j);
         static bool nodeComparatorAlphabeticalDESC  (Node *i, Node *j);
+        static NodeChildren::comparator getComparator(int order);
+        const node_vector *getSortedChildren(Node *parent, int order);
         static bool userComparatorDefaultASC (User *i, User *j);
 
         char* escapeFsIncompatible(const char *filename);
@@ -1221,8 +2418,17 @@ class MegaApiImpl : public MegaApp
         void fireOnTransferFinish(MegaTransferPrivate *transfer, MegaError e);
         void fireOnTransferUpdate(MegaTransferPrivate *transfer);
         void fireOnTransferTemporaryError(MegaTransferPrivate *transfer, MegaError e);
+        void fireOnTransfersProgress();
+        void touchTransfer(MegaTransferPrivate *transfer);
         map<int, MegaTransferPrivate *> transferMap;
 
+        // tags of the transfers by the sequence number of their last change
+        map<long long, int> transferChanges;
+        long long transferSequence;
+
+        // folder uploads waiting for their folders by tag of the putnodes tree
+        map<int, MegaFolderUploadController *> folderUploadTrees;
+
         MegaClient *getMegaClient();
 
 protected:
@@ -1238,13 +2444,21 @@ protected:
         void fireOnRequestUpdate(MegaRequestPrivate *request);
         void fireOnRequestTemporaryError(MegaRequestPrivate *request, MegaError e);
         bool fireOnTransferData(MegaTransferPrivate *transfer);
+        void fireOnTransferBuffer(MegaTransferPrivate *transfer, int buffer, m_off_t position, size_t size);
         void fireOnUsersUpdate(MegaUserList *users);
         void fireOnNodesUpdate(MegaNodeList *nodes);
         void fireOnAccountUpdate();
         void fireOnContactRequestsUpdate(MegaContactRequestList *requests);
         void fireOnReloadNeeded();
 
+        // queue a callback for the listeners of a request, a transfer or
+        // global events (with the callback thread)
+        void queueRequestCallback(MegaCallbackEvent *event, MegaRequestPrivate *request);
+        void queueTransferCallback(MegaCallbackEvent *event, MegaTransferPrivate *transfer);
+        void queueGlobalCallback(MegaCallbackEvent *event);
+
 #ifdef ENABLE_SYNC
+        void queueSyncCallback(MegaCallbackEvent *event, MegaSyncPrivate *sync);
         void fireOnGlobalSyncStateChanged();
         void fireOnSyncStateChanged(MegaSyncPrivate *sync);
         void fireOnSyncEvent(MegaSyncPrivate *sync, MegaSyncEvent *event);
@@ -1259,10 +2473,78 @@ protected:
         MegaFileSystemAccess *fsAccess;
         MegaDbAccess *dbAccess;
         GfxProc *gfxAccess;
+
+        // threads generating thumbnails and previews (built-in processor only)
+        static const int GFXTHREADS = 2;
+
+        // size budget of the thumbnail and preview cache under the base path
+        static const m_off_t FACACHESIZE = 64 * 1048576;
+        MegaThreadRunner *decryptionRunner;
+        MegaThreadRunner *cryptoRunner;
+        MegaThreadRunner *scanRunner;
+        ThreadPool *threadPool;
+        MegaHTTPServer *httpServer;
+        MegaPwKeyDerivation *pwKeyDerivation;
+        MegaCallbackExecutor *callbackExecutor;
+
+        // buffer rings of streaming transfers by transfer tag
+        map<int, MegaStreamingRing *> streamingRings;
+        bool streamingBuffersReleased;
+        void fillStreamingBuffers(MegaTransferPrivate *transfer, MegaStreamingRing *ring, const char *data, m_off_t len, m_off_t pos);
+        void deliverStreamingOverflow();
+        MegaPathCache pathCache;
+        MegaMutex viewsMutex;
+        MegaNameIndex *nameIndex;
+
+        // node update notifications held back for coalescing: the latest
+        // snapshot of each node, in order of first change, with the change
+        // flags of all its updates OR-ed in
+        dstime nodeUpdateWindow;
+        int nodeUpdateMaxBatch;
+        dstime nodeUpdateDeadline;
+        map<handle, MegaNodePrivate*> pendingNodeUpdates;
+        vector<handle> pendingNodeOrder;
+
+        // minimum interval between onTransferUpdate of a transfer, and
+        // interval of the aggregated onTransfersProgress (0 = disabled)
+        dstime transferUpdateInterval;
+        dstime transfersProgressInterval;
+        dstime transfersProgressDeadline;
+
+        // wake up the SDK thread for the earliest of the deadlines above
+        void updateAppWakeup();
 		
         RequestQueue requestQueue;
         TransferQueue transferQueue;
-        map<int, MegaRequestPrivate *> requestMap;
+        UploadBatchQueue uploadBatchQueue;
+
+        // uploads waiting in compact form while uploadQueueLimit uploads are
+        // in the engine (0: no limit) - only used by the SDK thread, the
+        // count is also read by getNumPendingUploads()
+        deque<QueuedUpload> queuedUploads;
+        unsigned uploadQueueLimit;
+        int numQueuedUploads;
+
+        // MegaApi::setPersistentTransferQueue: transfer cache records to
+        // write and to delete after the next exec() - only used by the SDK
+        // thread
+        bool persistTransfers;
+        map<uint32_t, string> queueWrites;
+        vector<uint32_t> queueDeletes;
+        MegaRequestMap requestMap;
+
+        // thumbnail prefetches: tag of the prefetch request by node, and
+        // the first TYPE_GET_ATTR_FILE request that joined the fetch
+        map<handle, int> thumbnailPrefetches;
+        map<handle, int> prefetchWaiters;
+
+        // prefetch request being dispatched (cached thumbnails complete
+        // synchronously, it must not finish before all are queued)
+        int prefetchDispatchTag;
+
+        // account a prefetched thumbnail, returns the tag of the first
+        // request that joined its fetch
+        int prefetchedThumbnail(MegaRequestPrivate *request, handle h, bool available);
 
         vector<m_time_t> downloadTimes;
         vector<int64_t> downloadBytes;
@@ -1276,6 +2558,10 @@ protected:
 
 #ifdef ENABLE_SYNC
         map<int, MegaSyncPrivate *> syncMap;
+
+        // answers syncPathState() for known paths without the SDK lock
+        SyncStateIndex syncStateIndex;
+        void unindexSyncPaths(LocalNode *l, string *localpath, bool subtree);
 #endif
 
         int pendingUploads;
@@ -1298,7 +2584,7 @@ protected:
         vector<string> excludedNames;
         long long syncLowerSizeLimit;
         long long syncUpperSizeLimit;
-        MegaMutex sdkMutex;
+        MegaSdkMutex sdkMutex;
         MegaTransferPrivate *currentTransfer;
         MegaRequestPrivate *activeRequest;
         MegaTransferPrivate *activeTransfer;
@@ -1310,11 +2596,34 @@ protected:
         int threadExit;
         void loop();
 
+        // shared lock for read-only getters, falling back to the exclusive
+        // lock while node decryption is deferred - returns whether the lock
+        // was taken exclusively, to be passed to unlockRead()
+        bool lockRead();
+        void unlockRead(bool exclusive);
+
+        // (re)build the name index after a full node load, reusing the
+        // persisted entries if they are current
+        void buildNameIndex();
+        void removeFromNameIndex(Node *n);
+        handle currentScsn();
+        MegaNodeList *searchIndexed(Node *node, const char *searchString, int matchType, int limit, bool recursive);
+
+        void bulkNodeResult(MegaRequestPrivate *request, handle h, error e);
+
+        // nodes of the list with an ancestor in the list
+        static vector<bool> nestedNodes(MegaClient *client, const handle_vector &handles);
+
+        // deliver (or drop) the coalesced node updates
+        void flushNodeUpdates();
+        void clearNodeUpdates();
+
         int maxRetries;
 
         // a request-level error occurred
         virtual void request_error(error);
         virtual void request_response_progress(m_off_t, m_off_t);
+        virtual void command_response(int, int64_t, int64_t);
 
         // login result
         virtual void login_result(error);
@@ -1353,6 +2662,7 @@ protected:
 
 
         virtual void fetchnodes_result(error);
+        virtual void fetchnodes_partial();
         virtual void putnodes_result(error, targettype_t, NewNode*);
 
         // share update result
@@ -1442,6 +2752,7 @@ protected:
         virtual void syncupdate_remote_move(Sync *sync, Node *n, Node* prevparent);
         virtual void syncupdate_remote_rename(Sync*sync, Node* n, const char* prevname);
         virtual void syncupdate_treestate(LocalNode*);
+        virtual void syncupdate_local_unlink(LocalNode*, bool subtree);
         virtual bool sync_syncable(Node*);
         virtual bool sync_syncable(const char*name, string*, string*);
         virtual void syncupdate_local_lockretry(bool);
@@ -1458,6 +2769,43 @@ protected:
 
         void sendPendingRequests();
         void sendPendingTransfers();
+        void sendPendingUploads();
+        void processUploadBatch(UploadBatch *batch);
+
+        // uploadQueueLimit: park the uploads there is no room for (the SDK
+        // lock must be held), start parked ones as the running uploads finish,
+        // finish the parked ones with an error
+        bool uploadsQueued();
+        void queueUpload(MegaTransferPrivate *transfer, bool copyDuplicates);
+        void promoteQueuedUploads();
+        void abortQueuedUploads(error e);
+
+        // record a top-level file transfer in the transfer cache (again, with
+        // the fingerprint of its file if known), forget it once finished,
+        // resubmit the recorded ones after fetchnodes
+        void persistTransfer(MegaTransferPrivate *transfer, FileFingerprint *fingerprint, bool copyDuplicates);
+        void unpersistTransfer(MegaTransferPrivate *transfer);
+        void restoreQueuedTransfers();
+
+        // upper bound for setTransferConnections()
+        static const int MAXCONNECTIONS = 32;
+
+        // threads fingerprinting the files of an upload batch
+        static const int FINGERPRINTTHREADS = 4;
+
+        struct UploadJob
+        {
+            MegaTransferPrivate *transfer;
+            FileSystemAccess *fsaccess;
+            string localname;
+            nodetype_t type;
+            error e;
+            FileFingerprint fingerprint;
+        };
+
+        static void fingerprintUpload(unsigned i, void *param);
+        MegaTransferPrivate *createUpload(const char *localPath, MegaHandle parentHandle, const char *fileName, int64_t mtime, int folderTransferTag, MegaTransferListener *listener);
+        void startFilePut(MegaTransferPrivate *transfer, MegaFilePut *f, int nextTag);
         char *stringToArray(string &buffer);
 
         //Internal
@@ -1465,6 +2813,22 @@ protected:
         Node *getNodeByFingerprintInternal(const char *fingerprint, Node *parent);
 
         bool processTree(Node* node, TreeProcessor* processor, bool recursive = 1);
+        bool processViewTree(Node* node, MegaNodeViewPrivate* view, MegaNodeViewProcessor* processor, bool recursive);
+
+        // threads exploring independent subtrees in queryNodes()
+        static const int QUERYTHREADS = 4;
+
+        struct QueryJob
+        {
+            const node_vector *roots;
+            const NodeQueryFilter *filter;
+            bool recursive;
+            size_t cap;
+            vector<handle_vector> results;
+        };
+
+        static void queryJob(unsigned i, void *param);
+        static void queryTree(Node *node, const NodeQueryFilter *filter, bool recursive, size_t cap, handle_vector *results);
         MegaNodeList* search(Node* node, const char* searchString, bool recursive = 1);
         void getNodeAttribute(MegaNode* node, int type, const char *dstFilePath, MegaRequestListener *listener = NULL);
 		void cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener = NULL);
@@ -1488,6 +2852,79 @@ class MegaHashSignatureImpl
 		AsymmCipher* asymmCypher;
 };
 
+class MegaFolderLinkStoreImpl;
+
+// a folder link loaded once for all the sessions on it: its MegaApi logs in
+// and fetches the nodes, then publishes a snapshot of the tree, which is only
+// read from then on
+class SharedFolderLink : public MegaRequestListener
+{
+    public:
+        SharedFolderLink(MegaFolderLinkStoreImpl *store, const string &id, const char *link);
+        virtual ~SharedFolderLink();
+
+        virtual void onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *e);
+
+        int getState();
+        int waitReady();
+
+        MegaFolderLinkStoreImpl *store;
+        string id;
+        MegaApi *api;
+        MegaNodeSnapshot *snapshot;
+
+        // sessions on the folder (guarded by the store's mutex)
+        int refs;
+
+    protected:
+        // state and number of threads in waitReady()
+        MegaMutex mutex;
+        MegaSemaphore loaded;
+        int state;
+        int waiters;
+
+        void finish(int state);
+};
+
+class MegaFolderLinkSessionPrivate : public MegaFolderLinkSession
+{
+    public:
+        MegaFolderLinkSessionPrivate(SharedFolderLink *folder);
+        virtual ~MegaFolderLinkSessionPrivate();
+
+        virtual int getState();
+        virtual int waitReady();
+        virtual MegaNodeSnapshot *getNodes();
+        virtual void startStreaming(MegaNode *node, int64_t startPos, int64_t size, MegaTransferListener *listener);
+
+    protected:
+        SharedFolderLink *folder;
+};
+
+// folders by the handle and key part of their link
+class MegaFolderLinkStoreImpl
+{
+    public:
+        MegaFolderLinkStoreImpl(const char *appKey, const char *userAgent);
+        ~MegaFolderLinkStoreImpl();
+
+        MegaFolderLinkSession *openSession(const char *megaFolderLink);
+        int getNumFolders();
+
+        // drop a session's reference, the last one frees the folder
+        void release(SharedFolderLink *folder);
+
+        string appKey;
+        string userAgent;
+
+    protected:
+        MegaMutex mutex;
+        map<string, SharedFolderLink *> folders;
+
+        // failed folders replaced in folders, until their sessions are gone
+        set<SharedFolderLink *> orphans;
+};
+
 class ExternalInputStream : public InputStreamAccess
 {
     MegaInputStream *inputStream;
@@ -1498,6 +2935,15 @@ public:
     virtual bool read(byte *buffer, unsigned size);
 };
 
+class ExternalOutputStream : public TransferSink
+{
+    MegaOutputStream *outputStream;
+
+public:
+    ExternalOutputStream(MegaOutputStream *outputStream);
+    virtual bool write(const byte *buffer, unsigned size, m_off_t pos);
+};
+
 class FileInputStream : public InputStreamAccess
 {
     FileAccess *fileAccess;
@@ -22,6 +22,81 @@
 #include "mega/attrmap.h"
 
 namespace mega {
+AttrFlatMap::iterator AttrFlatMap::lowerbound(nameid id)
+{
+    iterator it = pairs.begin();
+    size_t n = pairs.size();
+
+    // binary search - linear would do for the usual one or two elements, but
+    // user attribute maps can grow
+    while (n)
+    {
+        size_t half = n >> 1;
+
+        if (it[half].first < id)
+        {
+            it += half + 1;
+            n -= half + 1;
+        }
+        else
+        {
+            n = half;
+        }
+    }
+
+    return it;
+}
+
+AttrFlatMap::iterator AttrFlatMap::find(nameid id)
+{
+    iterator it = lowerbound(id);
+
+    return (it != pairs.end() && it->first == id) ? it : pairs.end();
+}
+
+AttrFlatMap::const_iterator AttrFlatMap::find(nameid id) const
+{
+    return const_cast<AttrFlatMap*>(this)->find(id);
+}
+
+string& AttrFlatMap::operator[](nameid id)
+{
+    iterator it = lowerbound(id);
+
+    if (it == pairs.end() || it->first != id)
+    {
+        it = pairs.insert(it, value_type(id, string()));
+    }
+
+    return it->second;
+}
+
+size_t AttrFlatMap::erase(nameid id)
+{
+    iterator it = find(id);
+
+    if (it == pairs.end())
+    {
+        return 0;
+    }
+
+    pairs.erase(it);
+
+    return 1;
+}
+
+size_t AttrFlatMap::allocated() const
+{
+    size_t t = pairs.capacity() * sizeof(value_type);
+
+    for (const_iterator it = pairs.begin(); it != pairs.end(); it++)
+    {
+        t += stringallocated(&it->second);
+    }
+
+    return t;
+}
+
 // approximate raw storage size of serialized AttrMap, not taking JSON escaping
 // or name length into account
 unsigned AttrMap::storagesize(int perrecord) const
@@ -51,42 +126,27 @@ int AttrMap::nameid2string(nameid id, char* buf)
     return ptr - buf;
 }
 
+// packed like JSON::getnameid() does, 0 for names longer than 8 characters
 nameid AttrMap::string2nameid(const char *a)
 {
-    int len;
+    nameid id = 0;
+
     if (!a)
     {
         return 0;
     }
 
-    len = strlen(a);
-    if (len > 8)
+    for (int i = 0; a[i]; i++)
     {
-        return 0;
-    }
+        if (i == 8)
+        {
+            return 0;
+        }
 
-    switch (len)
-    {
-        case 1:
-            return *a;
-        case 2:
-            return MAKENAMEID2(a[0], a[1]);
-        case 3:
-            return MAKENAMEID3(a[0], a[1], a[2]);
-        case 4:
-            return MAKENAMEID4(a[0], a[1], a[2], a[3]);
-        case 5:
-            return MAKENAMEID5(a[0], a[1], a[2], a[3], a[4]);
-        case 6:
-            return MAKENAMEID6(a[0], a[1], a[2], a[3], a[4], a[5]);
-        case 7:
-            return MAKENAMEID7(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
-        case 8:
-            return MAKENAMEID8(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
-        default:
-            break;
+        id = (id << 8) + a[i];
     }
-    return 0;
+
+    return id;
 }
 
 // generate binary serialize of attr_map name-value pairs
@@ -24,21 +24,51 @@
 
 namespace mega {
 // timer with capped exponential backoff
-BackoffTimer::BackoffTimer()
+BackoffTimer::BackoffTimer(BackoffTimerQueue* cqueue)
 {
+    queue = cqueue;
+    queued = false;
     reset();
 }
 
+BackoffTimer::~BackoffTimer()
+{
+    unqueue();
+}
+
+// the deadline is mirrored in the queue, if any
+void BackoffTimer::setnext(dstime newnext)
+{
+    unqueue();
+
+    next = newnext;
+
+    if (queue && next)
+    {
+        queued_it = queue->timers.insert(pair<dstime, BackoffTimer*>(next, this));
+        queued = true;
+    }
+}
+
+void BackoffTimer::unqueue()
+{
+    if (queued)
+    {
+        queue->timers.erase(queued_it);
+        queued = false;
+    }
+}
+
 void BackoffTimer::reset()
 {
-    next = 0;
+    setnext(0);
     delta = 1;
     base = 1;
 }
 
 void BackoffTimer::backoff()
 {
-    next = Waiter::ds + delta;
+    setnext(Waiter::ds + delta);
 
     base <<= 1;
 
@@ -52,7 +82,7 @@ void BackoffTimer::backoff()
 
 void BackoffTimer::backoff(dstime newdelta)
 {
-    next = Waiter::ds + newdelta;
+    setnext(Waiter::ds + newdelta);
     delta = newdelta;
     base = newdelta;
 }
@@ -66,7 +96,7 @@ bool BackoffTimer::arm()
 {
     if (next + delta > Waiter::ds)
     {
-        next = Waiter::ds;
+        setnext(Waiter::ds);
         delta = 1;
         base = 1;
 
@@ -80,7 +110,7 @@ void BackoffTimer::set(dstime newds)
 {
     if (newds < next)
     {
-        next = newds;
+        setnext(newds);
     }
 }
 
@@ -113,6 +143,7 @@ void BackoffTimer::update(dstime* waituntil)
         if (next <= Waiter::ds)
         {
             *waituntil = 0;
+            unqueue();
             next = 1;
             base = 1;
         }
@@ -122,4 +153,24 @@ void BackoffTimer::update(dstime* waituntil)
         }
     }
 }
+
+// due timers stay armed, they only leave the queue
+bool BackoffTimerQueue::expire()
+{
+    bool r = false;
+
+    while (!timers.empty() && timers.begin()->first <= Waiter::ds)
+    {
+        timers.begin()->second->queued = false;
+        timers.erase(timers.begin());
+        r = true;
+    }
+
+    return r;
+}
+
+dstime BackoffTimerQueue::nextds() const
+{
+    return timers.empty() ? NEVER : timers.begin()->first;
+}
 } // namespace
@@ -21,6 +21,20 @@
 
 #include "mega/base64.h"
 
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) \
+    && (defined(_MSC_VER) || defined(__clang__) \
+        || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define BASE64_SSSE3 1
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define BASE64_TARGET
+#else
+#include <cpuid.h>
+#define BASE64_TARGET __attribute__((target("ssse3")))
+#endif
+#endif
+
 namespace mega {
 // modified base64 conversion (no trailing '=' and '-_' instead of '+/')
 unsigned char Base64::to64(byte c)
@@ -80,11 +94,128 @@ unsigned char Base64::from64(byte c)
     return 255;
 }
 
-int Base64::atob(const char* a, byte* b, int blen)
+static const char enctable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+// from64() of every byte value
+static const byte dectable[256] = {
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,  62, 255, 255,
+     52,  53,  54,  55,  56,  57,  58,  59,  60,  61, 255, 255, 255, 255, 255, 255,
+    255,   0,   1,   2,   3,   4,   5,   6,   7,   8,   9,  10,  11,  12,  13,  14,
+     15,  16,  17,  18,  19,  20,  21,  22,  23,  24,  25, 255, 255, 255, 255,  63,
+    255,  26,  27,  28,  29,  30,  31,  32,  33,  34,  35,  36,  37,  38,  39,  40,
+     41,  42,  43,  44,  45,  46,  47,  48,  49,  50,  51, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255
+};
+
+#ifdef BASE64_SSSE3
+static bool base64detect()
+{
+    unsigned regs[4];
+
+#ifdef _MSC_VER
+    __cpuid((int*)regs, 1);
+#else
+    if (!__get_cpuid(1, regs, regs + 1, regs + 2, regs + 3))
+    {
+        return false;
+    }
+#endif
+
+    // ECX: SSSE3
+    return (regs[2] & (1 << 9)) != 0;
+}
+
+static const bool base64ssse3 = base64detect();
+
+// 12 bytes to 16 characters per iteration while 16 bytes can be loaded,
+// returns the number of bytes encoded (W. Mula's multiply-shift unpacking)
+BASE64_TARGET static int encodessse3(const byte* b, int blen, char* a)
+{
+    const __m128i shuf = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+
+    // offsets to the characters of the classes computed below: 26..51,
+    // 52..61, 62, 63, 0..25
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '-' - 62,
+                                          '_' - 63, 'A', 0, 0);
+    int n = 0;
+
+    while (n + 16 <= blen)
+    {
+        __m128i in = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(b + n)), shuf);
+        __m128i hi = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i lo = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i sextets = _mm_or_si128(hi, lo);
+        __m128i cls = _mm_subs_epu8(sextets, _mm_set1_epi8(51));
+
+        cls = _mm_or_si128(cls, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), sextets), _mm_set1_epi8(13)));
+
+        _mm_storeu_si128((__m128i*)(a + n / 3 * 4), _mm_add_epi8(_mm_shuffle_epi8(offsets, cls), sextets));
+
+        n += 12;
+    }
+
+    return n;
+}
+
+// 16 characters to 12 bytes per iteration while all are valid and 16
+// bytes can be stored, returns the number of characters decoded
+BASE64_TARGET static int decodessse3(const char* a, int alen, byte* b, int blen)
+{
+    const __m128i shuf = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    int n = 0;
+
+    while (n + 16 <= alen && n / 4 * 3 + 16 <= blen)
+    {
+        __m128i c = _mm_loadu_si128((const __m128i*)(a + n));
+
+        // bytes >= 0x80 compare as negative and fall into no class
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(c, _mm_set1_epi8('9' + 1)));
+        __m128i dash = _mm_cmpeq_epi8(c, _mm_set1_epi8('-'));
+        __m128i underscore = _mm_cmpeq_epi8(c, _mm_set1_epi8('_'));
+
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, dash)), underscore)) != 0xffff)
+        {
+            break;
+        }
+
+        __m128i offset = _mm_or_si128(_mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-'A')),
+                                                   _mm_and_si128(lower, _mm_set1_epi8(26 - 'a'))),
+                                      _mm_or_si128(_mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(52 - '0')),
+                                                                _mm_and_si128(dash, _mm_set1_epi8(62 - '-'))),
+                                                   _mm_and_si128(underscore, _mm_set1_epi8(63 - '_'))));
+
+        // merge pairs of sextets, then pairs of 12-bit values, into 24-bit
+        // groups and pack them big-endian
+        __m128i packed = _mm_maddubs_epi16(_mm_add_epi8(c, offset), _mm_set1_epi32(0x01400140));
+
+        packed = _mm_shuffle_epi8(_mm_madd_epi16(packed, _mm_set1_epi32(0x00011000)), shuf);
+
+        _mm_storeu_si128((__m128i*)(b + n / 4 * 3), packed);
+
+        n += 16;
+    }
+
+    return n;
+}
+#endif
+
+// decode until the first non-base64 character, end (if not NULL) or blen bytes
+static int decode(const char* a, const char* end, byte* b, int blen, int p)
 {
     byte c[4];
     int i;
-    int p = 0;
 
     c[3] = 0;
 
@@ -92,7 +223,13 @@ int Base64::atob(const char* a, byte* b, int blen)
     {
         for (i = 0; i < 4; i++)
         {
-            if ((c[i] = from64(*a++)) == 255)
+            if (a == end)
+            {
+                c[i] = 255;
+                break;
+            }
+
+            if ((c[i] = dectable[(byte)*a++]) == 255)
             {
                 break;
             }
@@ -119,40 +256,59 @@ int Base64::atob(const char* a, byte* b, int blen)
 
         b[p++] = (c[2] << 6) | c[3];
     }
+}
 
-    return p;
+int Base64::atob(const char* a, byte* b, int blen)
+{
+    return decode(a, NULL, b, blen, 0);
+}
+
+int Base64::atob(const char* a, int alen, byte* b, int blen)
+{
+    int n = 0;
+
+#ifdef BASE64_SSSE3
+    if (base64ssse3)
+    {
+        n = decodessse3(a, alen, b, blen);
+    }
+#endif
+
+    return decode(a + n, a + alen, b, blen, n / 4 * 3);
 }
 
 int Base64::btoa(const byte* b, int blen, char* a)
 {
     int p = 0;
 
-    for (;;)
+#ifdef BASE64_SSSE3
+    if (base64ssse3)
     {
-        if (blen <= 0)
-        {
-            break;
-        }
+        int n = encodessse3(b, blen, a);
 
-        a[p++] = to64(*b >> 2);
-        a[p++] = to64((*b << 4) | (((blen > 1) ? b[1] : 0) >> 4));
+        b += n;
+        blen -= n;
+        p = n / 3 * 4;
+    }
+#endif
 
-        if (blen < 2)
-        {
-            break;
-        }
+    for (; blen >= 3; blen -= 3, b += 3)
+    {
+        a[p++] = enctable[b[0] >> 2];
+        a[p++] = enctable[((b[0] << 4) | (b[1] >> 4)) & 63];
+        a[p++] = enctable[((b[1] << 2) | (b[2] >> 6)) & 63];
+        a[p++] = enctable[b[2] & 63];
+    }
 
-        a[p++] = to64(b[1] << 2 | (((blen > 2) ? b[2] : 0) >> 6));
+    if (blen)
+    {
+        a[p++] = enctable[b[0] >> 2];
+        a[p++] = enctable[((b[0] << 4) | ((blen > 1) ? b[1] >> 4 : 0)) & 63];
 
-        if (blen < 3)
+        if (blen > 1)
         {
-            break;
+            a[p++] = enctable[(b[1] << 2) & 63];
         }
-
-        a[p++] = to64(b[2]);
-
-        blen -= 3;
-        b += 3;
     }
 
     a[p] = 0;
@@ -26,6 +26,10 @@ namespace mega {
 Command::Command()
 {
     persistent = false;
+    independent = false;
+    streamable = false;
+    deferrable = false;
+    name = "";
     level = -1;
     canceled = false;
     result = API_OK;
@@ -47,6 +51,7 @@ const char* Command::getstring() const
 // add opcode
 void Command::cmd(const char* cmd)
 {
+    name = cmd;
     json.append("\"a\":\"");
     json.append(cmd);
     json.append("\"");
@@ -85,13 +90,12 @@ void Command::arg(const char* name, const char* value, int quotes)
 // binary data
 void Command::arg(const char* name, const byte* value, int len)
 {
-    char* buf = new char[len * 4 / 3 + 4];
-
-    Base64::btoa(value, len, buf);
-
-    arg(name, buf);
-
-    delete[] buf;
+    addcomma();
+    json.append("\"");
+    json.append(name);
+    json.append("\":\"");
+    appendbinary(value, len);
+    json.append("\"");
 }
 
 // 64-bit signed integer
@@ -104,6 +108,23 @@ void Command::arg(const char* name, m_off_t n)
     arg(name, buf, 0);
 }
 
+void Command::appendbinary(const byte* data, int len)
+{
+    size_t p = json.size();
+
+    json.resize(p + len * 4 / 3 + 4);
+    json.resize(p + Base64::btoa(data, len, (char*)json.data() + p));
+}
+
+// (never shrinks - reserve() may on some implementations)
+void Command::reserve(size_t n)
+{
+    if (json.size() + n > json.capacity())
+    {
+        json.reserve(json.size() + n);
+    }
+}
+
 // raw JSON data
 void Command::appendraw(const char* s)
 {
@@ -183,15 +204,8 @@ void Command::element(handle h, int len)
 // add binary data
 void Command::element(const byte* data, int len)
 {
-    char* buf = new char[len * 4 / 3 + 4];
-
-    len = Base64::btoa(data, len, buf);
-
     json.append(elements() ? ",\"" : "\"");
-    json.append(buf, len);
-
-    delete[] buf;
-
+    appendbinary(data, len);
     json.append("\"");
 }
 
@@ -114,17 +114,8 @@ void CommandGetFA::procresult()
     if (client->json.isnumeric())
     {
         if (it != client->fafcs.end())
-        {            
-            faf_map::iterator fafsit;
-            for (fafsit = it->second->fafs[0].begin(); fafsit != it->second->fafs[0].end(); )
-            {
-                // move from fresh to pending
-                it->second->fafs[1][fafsit->first] = fafsit->second;
-                it->second->fafs[0].erase(fafsit++);
-            }
-
-            it->second->e = (error)client->json.getint();
-            it->second->req.status = REQ_FAILURE;
+        {
+            it->second->urlfailed(client, (error)client->json.getint());
         }
 
         return;
@@ -147,11 +138,12 @@ void CommandGetFA::procresult()
                     {
                         Node::copystring(&it->second->posturl, p);
                         it->second->urltime = Waiter::ds;
+                        it->second->urlpending = false;
                         it->second->dispatch(client);
                     }
                     else
                     {
-                        it->second->req.status = REQ_FAILURE;
+                        it->second->urlfailed(client, API_EINTERNAL);
                     }
                 }
 
@@ -160,7 +152,11 @@ void CommandGetFA::procresult()
             default:
                 if (!client->json.storeobject())
                 {
-                    it->second->req.status = REQ_FAILURE;
+                    if (it != client->fafcs.end())
+                    {
+                        it->second->urlfailed(client, API_EINTERNAL);
+                    }
+
                     return;
                 }
         }
@@ -210,6 +206,7 @@ void CommandAttachFA::procresult()
 CommandPutFile::CommandPutFile(TransferSlot* ctslot, int ms)
 {
     tslot = ctslot;
+    independent = true;
 
     cmd("u");
     arg("s", tslot->fa->size);
@@ -283,6 +280,7 @@ void CommandPutFile::procresult()
 CommandDirectRead::CommandDirectRead(DirectReadNode* cdrn)
 {
     drn = cdrn;
+    independent = true;
 
     cmd("g");
     arg(drn->p ? "n" : "p", (byte*)&drn->h, MegaClient::NODEHANDLE);
@@ -340,6 +338,11 @@ void CommandDirectRead::procresult()
                 case EOO:
                     if (!canceled && drn)
                     {
+                        if (e == API_OK)
+                        {
+                            client->tempurls.put(drn->hdrn_it->first, &drn->tempurl, drn->size);
+                        }
+
                         drn->cmdresult(e);
                     }
                     
@@ -360,9 +363,12 @@ void CommandDirectRead::procresult()
     } 
 }
 
-// request temporary source URL for full-file access (p == private node)
-CommandGetFile::CommandGetFile(TransferSlot* ctslot, byte* key, handle h, bool p, const char *auth)
+// request temporary source URL for full-file access (p == private node,
+// pf == prefetch into the temporary URL cache only)
+CommandGetFile::CommandGetFile(TransferSlot* ctslot, byte* key, handle h, bool p, const char *auth, bool pf)
 {
+    independent = true;
+
     cmd("g");
     arg(p || auth ? "n" : "p", (byte*)&h, MegaClient::NODEHANDLE);
     arg("g", 1);
@@ -381,6 +387,8 @@ CommandGetFile::CommandGetFile(TransferSlot* ctslot, byte* key, handle h, bool p
 
     tslot = ctslot;
     ph = h;
+    priv = p || auth;
+    prefetch = pf;
 
     if (!tslot)
     {
@@ -388,6 +396,14 @@ CommandGetFile::CommandGetFile(TransferSlot* ctslot, byte* key, handle h, bool p
     }
 }
 
+// prefetched URLs are not reported to the app
+MegaApp* CommandGetFile::app()
+{
+    static MegaApp noapp;
+
+    return prefetch ? &noapp : client->app;
+}
+
 void CommandGetFile::cancel()
 {
     Command::cancel();
@@ -416,12 +432,13 @@ void CommandGetFile::procresult()
             return tslot->transfer->failed(e);
         }
 
-        return client->app->checkfile_result(ph, e);
+        return app()->checkfile_result(ph, e);
     }
 
     const char* at = NULL;
     error e = API_EINTERNAL;
     m_off_t s = -1;
+    string tempurl;
     int d = 0;
     byte* buf;
     time_t ts = 0, tm = 0;
@@ -436,7 +453,7 @@ void CommandGetFile::procresult()
         switch (client->json.getnameid())
         {
             case 'g':
-                client->json.storeobject(tslot ? &tslot->tempurl : NULL);
+                client->json.storeobject(&tempurl);
                 e = API_OK;
                 break;
 
@@ -497,7 +514,7 @@ void CommandGetFile::procresult()
                         return tslot->transfer->failed(e);
                     }
 
-                    return client->app->checkfile_result(ph, e);
+                    return app()->checkfile_result(ph, e);
                 }
                 else
                 {
@@ -528,7 +545,7 @@ void CommandGetFile::procresult()
                                             return tslot->transfer->failed(API_EINTERNAL);
                                         }
 
-                                        return client->app->checkfile_result(ph, API_EINTERNAL);
+                                        return app()->checkfile_result(ph, API_EINTERNAL);
                                     }
                                     break;
 
@@ -542,15 +559,24 @@ void CommandGetFile::procresult()
                                             return tslot->transfer->failed(API_EINTERNAL);
                                         }
 
-                                        return client->app->checkfile_result(ph, API_EINTERNAL);
+                                        return app()->checkfile_result(ph, API_EINTERNAL);
                                     }
                                     break;
 
                                 case EOO:
                                     delete[] buf;
 
+                                    if (e == API_OK)
+                                    {
+                                        handle h = ph;
+
+                                        client->encodehandletype(&h, priv);
+                                        client->tempurls.put(h, &tempurl, s);
+                                    }
+
                                     if (tslot)
                                     {
+                                        tslot->tempurl = tempurl;
                                         tslot->starttime = tslot->lastdata = client->waiter->ds;
 
                                         if (tslot->tempurl.size() && s >= 0)
@@ -562,7 +588,7 @@ void CommandGetFile::procresult()
                                     }
                                     else
                                     {
-                                        return client->app->checkfile_result(ph, e, filekey, s, ts, tm,
+                                        return app()->checkfile_result(ph, e, filekey, s, ts, tm,
                                                                              &filenamestring,
                                                                              &filefingerprint,
                                                                              &fileattrstring);
@@ -579,7 +605,7 @@ void CommandGetFile::procresult()
                                         }
                                         else
                                         {
-                                            return client->app->checkfile_result(ph, API_EINTERNAL);
+                                            return app()->checkfile_result(ph, API_EINTERNAL);
                                         }
                                     }
                             }
@@ -597,7 +623,7 @@ void CommandGetFile::procresult()
                     }
                     else
                     {
-                        return client->app->checkfile_result(ph, API_EKEY);
+                        return app()->checkfile_result(ph, API_EKEY);
                     }
                 }
 
@@ -610,7 +636,7 @@ void CommandGetFile::procresult()
                     }
                     else
                     {
-                        return client->app->checkfile_result(ph, API_EINTERNAL);
+                        return app()->checkfile_result(ph, API_EINTERNAL);
                     }
                 }
         }
@@ -669,27 +695,110 @@ void CommandSetAttr::procresult()
         }
 #endif
         client->app->setattr_result(h, e);
+
+        for (unsigned i = 0; i < tags.size(); i++)
+        {
+            client->restag = tags[i];
+            client->app->setattr_result(h, e);
+        }
     }
     else
     {
         client->json.storeobject();
         client->app->setattr_result(h, API_EINTERNAL);
+
+        for (unsigned i = 0; i < tags.size(); i++)
+        {
+            client->restag = tags[i];
+            client->app->setattr_result(h, API_EINTERNAL);
+        }
     }
 }
 
+// a later update of the same node's attributes replaces this one's (each
+// command carries the complete attribute set); updates of other nodes are
+// independent of it - sync renames are left alone
+int CommandSetAttr::coalesce(Command* c)
+{
+    if (strcmp(c->name, name))
+    {
+        return -1;
+    }
+
+    CommandSetAttr* later = (CommandSetAttr*)c;
+
+    if (later->h != h)
+    {
+        return 0;
+    }
+
+    if (syncop || later->syncop)
+    {
+        return -1;
+    }
+
+    json.swap(later->json);
+    tags.push_back(later->tag);
+
+    LOG_debug << "Attribute update merged into a queued one";
+    return 1;
+}
+
 // (the result is not processed directly - we rely on the server-client
 // response)
 CommandPutNodes::CommandPutNodes(MegaClient* client, handle th,
                                  const char* userhandle, NewNode* newnodes,
                                  int numnodes, int ctag, putsource_t csource)
 {
-    byte key[FILENODEKEYLENGTH];
-    int i;
-
     nn = newnodes;
     nnsize = numnodes;
     type = userhandle ? USER_HANDLE : NODE_HANDLE;
     source = csource;
+    tree = NULL;
+    slice = 0;
+
+    init(client, th, userhandle);
+
+    tag = ctag;
+}
+
+CommandPutNodes::CommandPutNodes(MegaClient* client, handle th, NewNode* newnodes,
+                                 int numnodes, vector<int>* ctags)
+{
+    nn = newnodes;
+    nnsize = numnodes;
+    type = NODE_HANDLE;
+    source = PUTNODES_APP;
+    tags.swap(*ctags);
+    tree = NULL;
+    slice = 0;
+
+    init(client, th, NULL);
+
+    tag = tags.front();
+}
+
+void CommandPutNodes::init(MegaClient* client, handle th, const char* userhandle)
+{
+    byte key[FILENODEKEYLENGTH];
+    int i;
+    int numnodes = nnsize;
+
+    // size estimate: framing and short fields plus the base64 of the
+    // attributes, keys and upload tokens
+    size_t estimate = 64;
+
+    for (i = 0; i < numnodes; i++)
+    {
+        estimate += 96 + (nn[i].attrstring->size() + nn[i].nodekey.size()) * 4 / 3;
+
+        if (nn[i].source == NEW_UPLOAD)
+        {
+            estimate += sizeof nn->uploadtoken * 4 / 3;
+        }
+    }
+
+    reserve(estimate);
 
     cmd("p");
     notself(client);
@@ -707,6 +816,9 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, handle th,
 
     beginarray("n");
 
+    // reused for the pending file attributes of each upload
+    string fa;
+
     for (i = 0; i < numnodes; i++)
     {
         beginobject();
@@ -725,13 +837,12 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, handle th,
                 arg("h", nn[i].uploadtoken, sizeof nn->uploadtoken);
 
                 // include pending file attributes for this upload
-                string s;
-
-                client->pendingattrstring(nn[i].uploadhandle, &s);
+                fa.clear();
+                client->pendingattrstring(nn[i].uploadhandle, &fa);
 
-                if (s.size())
+                if (fa.size())
                 {
-                    arg("fa", s.c_str(), 1);
+                    arg("fa", fa.c_str(), 1);
                 }
         }
 
@@ -787,8 +898,44 @@ CommandPutNodes::CommandPutNodes(MegaClient* client, handle th,
             snk.get(this);
         }
     }
+}
 
-    tag = ctag;
+// report each node of a batch to its transfer (the app takes ownership of
+// the NewNode array passed to putnodes_result())
+void CommandPutNodes::batchresult(error e)
+{
+    int creqtag = client->restag;
+
+    for (int i = 0; i < nnsize; i++)
+    {
+        NewNode* single = new NewNode[1];
+
+        *single = nn[i];
+        nn[i].attrstring = NULL;
+
+        client->restag = tags[i];
+        client->app->putnodes_result(e ? e : (single->added ? API_OK : API_EINTERNAL), type, single);
+    }
+
+    client->restag = creqtag;
+
+    delete[] nn;
+}
+
+void CommandPutNodes::appresult(error e)
+{
+    if (tree)
+    {
+        client->putnodestree_result(tree, slice, nn, e);
+    }
+    else if (tags.size())
+    {
+        batchresult(e);
+    }
+    else
+    {
+        client->app->putnodes_result(e, type, nn);
+    }
 }
 
 // add new nodes and handle->node handle mapping
@@ -828,7 +975,7 @@ void CommandPutNodes::procresult()
 #endif
         if (source == PUTNODES_APP)
         {
-            return client->app->putnodes_result(e, type, nn);
+            return appresult(e);
         }
 #ifdef ENABLE_SYNC
         else
@@ -878,7 +1025,7 @@ void CommandPutNodes::procresult()
 #endif
                 if (source == PUTNODES_APP)
                 {
-                    client->app->putnodes_result(e, type, nn);
+                    appresult(e);
                 }
 #ifdef ENABLE_SYNC
                 else
@@ -924,45 +1071,60 @@ void CommandMoveNode::procresult()
             {
                 if (e == API_OK)
                 {
-                    Node* n;
+                    Sync* sync = NULL;
+
+                    if (syncop)
+                    {
+                        for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+                        {
+                            if ((*it)->tag == tag)
+                            {
+                                sync = *it;
+                                break;
+                            }
+                        }
+                    }
 
-                    // update all todebris records in the subtree
-                    for (node_set::iterator it = client->todebris.begin(); it != client->todebris.end(); it++)
+                    // walk the moved subtree: nodes deleted by the sync were
+                    // carried along and are reported here. only queued
+                    // records keep their state (the queue is cleaned up by
+                    // execmovetosyncdebris())
+                    node_vector pending;
+                    pending.push_back(syncn);
+
+                    while (pending.size())
                     {
-                        n = *it;
+                        Node* n = pending.back();
+                        pending.pop_back();
 
-                        do {
-                            if (n == syncn)
+                        if (n->syncdeleted != SYNCDEL_NONE)
+                        {
+                            if (sync)
                             {
-                                if(syncop)
+                                if (n->type == FOLDERNODE)
                                 {
-                                    Sync* sync = NULL;
-                                    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
-                                    {
-                                        if((*it)->tag == tag)
-                                        {
-                                            sync = (*it);
-                                            break;
-                                        }
-                                    }
-
-                                    if(sync)
-                                    {
-                                        if (n->type == FOLDERNODE)
-                                        {
-                                            sync->client->app->syncupdate_remote_folder_deletion(sync, n);
-                                        }
-                                        else
-                                        {
-                                            sync->client->app->syncupdate_remote_file_deletion(sync, n);
-                                        }
-                                    }
+                                    client->app->syncupdate_remote_folder_deletion(sync, n);
+                                }
+                                else
+                                {
+                                    client->app->syncupdate_remote_file_deletion(sync, n);
                                 }
+                            }
 
-                                (*it)->syncdeleted = syncdel;
-                                break;
+                            if (n->todebris_it != client->todebris.end())
+                            {
+                                n->syncdeleted = syncdel;
+                            }
+                            else if (n != syncn)
+                            {
+                                n->syncdeleted = SYNCDEL_NONE;
                             }
-                        } while ((n = n->parent));
+                        }
+
+                        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+                        {
+                            pending.push_back(*it);
+                        }
                     }
                 }
                 else
@@ -1106,6 +1268,8 @@ void CommandLogout::procresult()
             client->sctable->remove();
         }
 
+        client->purgetransfercache();
+
 #ifdef ENABLE_SYNC
         for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
         {
@@ -1315,6 +1479,8 @@ void CommandLogin::procresult()
                     client->sessionkey.assign((const char *)sek, sizeof(sek));
                 }
 
+                client->csbatchuntil = Waiter::ds + MegaClient::STARTUPBATCHDS;
+
                 return client->app->login_result(API_OK);
 
             default:
@@ -1343,6 +1509,9 @@ CommandShareKeyUpdate::CommandShareKeyUpdate(MegaClient* client, handle_vector*
     Node* n;
     byte sharekey[SymmCipher::KEYLENGTH];
 
+    // handle, user handle and key per share
+    reserve(16 + v->size() * 56);
+
     cmd("k");
     beginarray("sr");
 
@@ -1350,9 +1519,9 @@ CommandShareKeyUpdate::CommandShareKeyUpdate(MegaClient* client, handle_vector*
     {
         handle h = (*v)[i];
 
-        if ((n = client->nodebyhandle(h)) && n->sharekey)
+        if ((n = client->nodebyhandle(h)) && n->sharekey())
         {
-            client->key.ecb_encrypt(n->sharekey->key, sharekey, SymmCipher::KEYLENGTH);
+            client->key.ecb_encrypt(n->sharekey()->key, sharekey, SymmCipher::KEYLENGTH);
 
             element(h, MegaClient::NODEHANDLE);
             element(client->me, MegaClient::USERHANDLE);
@@ -1398,7 +1567,7 @@ CommandSetShare::CommandSetShare(MegaClient* client, Node* n, User* u, accesslev
         // securely store/transmit share key
         // by creating a symmetrically (for the sharer) and an asymmetrically
         // (for the sharee) encrypted version
-        memcpy(key, n->sharekey->key, sizeof key);
+        memcpy(key, n->sharekey()->key, sizeof key);
         memcpy(asymmkey, key, sizeof key);
 
         client->key.ecb_encrypt(key);
@@ -1432,14 +1601,28 @@ CommandSetShare::CommandSetShare(MegaClient* client, Node* n, User* u, accesslev
     endobject();
     endarray();
 
+    slicedkeys = false;
+
     // only for a fresh share: add cr element with all node keys encrypted to
     // the share key
     if (newshare)
     {
-        // the new share's nodekeys for this user: generate node list
-        TreeProcShareKeys tpsk(n);
-        client->proctree(n, &tpsk);
-        tpsk.get(this);
+        if (n->subtree.files + n->subtree.folders > MegaClient::SHAREKEYSLICE)
+        {
+            // large tree: only the root's key, so that the command stays
+            // small and the SDK thread isn't blocked building it
+            ShareNodeKeys snk;
+            snk.add(n, n, 1);
+            snk.get(this);
+            slicedkeys = true;
+        }
+        else
+        {
+            // the new share's nodekeys for this user: generate node list
+            TreeProcShareKeys tpsk(n);
+            client->proctree(n, &tpsk);
+            tpsk.get(this);
+        }
     }
 }
 
@@ -1503,10 +1686,10 @@ void CommandSetShare::procresult()
                 {
                     Node* n;
 
-                    if ((n = client->nodebyhandle(sh)) && n->sharekey)
+                    if ((n = client->nodebyhandle(sh)) && n->sharekey())
                     {
                         client->key.ecb_decrypt(key);
-                        n->sharekey->setkey(key);
+                        n->sharekey()->setkey(key);
 
                         // repeat attempt with corrected share key
                         client->restag = tag;
@@ -1552,6 +1735,11 @@ void CommandSetShare::procresult()
                 break;
 
             case EOO:
+                if (slicedkeys)
+                {
+                    client->queuesharekeys(sh);
+                }
+
                 client->app->share_result(API_OK);
                 return;
 
@@ -1565,6 +1753,21 @@ void CommandSetShare::procresult()
 }
 
 
+CommandShareNodeKeys::CommandShareNodeKeys(MegaClient* client, ShareNodeKeys* snk)
+{
+    cmd("k");
+    snk->get(this);
+
+    tag = client->reqtag;
+}
+
+void CommandShareNodeKeys::procresult()
+{
+    client->sharekeyinflight = false;
+
+    Command::procresult();
+}
+
 CommandSetPendingContact::CommandSetPendingContact(MegaClient* client, const char* temail, opcactions_t action, const char* msg, const char* oemail)
 {
     cmd("upc");
@@ -1948,6 +2151,7 @@ CommandGetUA::CommandGetUA(MegaClient* client, const char* uid, const char* an)
 {
     user = client->finduser((char*)uid);
     attributename = an;
+    independent = true;
 
     cmd("uga");
     arg("u", uid);
@@ -2275,6 +2479,7 @@ void CommandGetUserData::procresult()
 CommandGetUserQuota::CommandGetUserQuota(MegaClient* client, AccountDetails* ad, bool storage, bool transfer, bool pro)
 {
     details = ad;
+    independent = true;
 
     cmd("uq");
     if (storage)
@@ -2514,6 +2719,7 @@ void CommandGetUserQuota::procresult()
                 break;
 
             case EOO:
+                client->cacheaccountdetails(details, got_storage, got_transfer, got_pro);
                 client->app->account_details(details, got_storage, got_transfer, got_pro, false, false, false);
                 return;
 
@@ -2680,6 +2886,8 @@ void CommandSetPH::procresult()
 
 CommandGetPH::CommandGetPH(MegaClient* client, handle cph, const byte* ckey, int cop)
 {
+    independent = true;
+
     cmd("g");
     arg("p", (byte*)&cph, MegaClient::NODEHANDLE);
 
@@ -2975,13 +3183,19 @@ CommandFetchNodes::CommandFetchNodes(MegaClient* client)
     arg("r", 1);
     arg("ca", 1);
 
+    streamable = true;
+
     tag = client->reqtag;
 }
 
 // purge and rebuild node/user tree
 void CommandFetchNodes::procresult()
 {
-    client->purgenodesusersabortsc();
+    // the nodes have already been read while the response was arriving
+    if (!client->nodestream.started)
+    {
+        client->purgenodesusersabortsc();
+    }
 
     if (client->json.isnumeric())
     {
@@ -2995,7 +3209,7 @@ void CommandFetchNodes::procresult()
         {
             case 'f':
                 // nodes
-                if (!client->readnodes(&client->json, 0))
+                if (!client->readnodes(&client->json, 0) || client->nodestream.failed)
                 {
                     client->fetchingnodes = false;
                     return client->app->fetchnodes_result(API_EINTERNAL);
@@ -3091,6 +3305,7 @@ CommandReportEvent::CommandReportEvent(MegaClient *client, const char *event, co
         arg("v", details);
     }
 
+    deferrable = true;
     tag = client->reqtag;
 }
 
@@ -3428,6 +3643,7 @@ CommandSendEvent::CommandSendEvent(MegaClient *client, int type, const char *des
     arg("e", type);
     arg("m", desc);
 
+    deferrable = true;
     tag = client->reqtag;
 }
 
@@ -21,6 +21,30 @@
 
 #include "mega.h"
 
+#ifdef USE_OPENSSL_CRYPTO
+#include <zlib.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) \
+    && (defined(_MSC_VER) || defined(__clang__) \
+        || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))))
+#define CRC32_PCLMUL 1
+#include <wmmintrin.h>
+#include <smmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CRC32_TARGET
+#define CRC32_ALIGN __declspec(align(16))
+#else
+#include <cpuid.h>
+#define CRC32_TARGET __attribute__((target("pclmul,sse4.1")))
+#define CRC32_ALIGN __attribute__((aligned(16)))
+#endif
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#define CRC32_ARMV8 1
+#include <arm_acle.h>
+#endif
+
 namespace mega {
 #ifndef htobe64
 #define htobe64(x) (((uint64_t)htonl((uint32_t)((x) >> 32))) | (((uint64_t)htonl((uint32_t)x)) << 32))
@@ -30,6 +54,76 @@ using namespace CryptoPP;
 
 AutoSeededRandomPool PrnGen::rng;
 
+#ifdef USE_OPENSSL_CRYPTO
+#if OPENSSL_VERSION_NUMBER < 0x10100000L
+#define EVP_MD_CTX_new EVP_MD_CTX_create
+#define EVP_MD_CTX_free EVP_MD_CTX_destroy
+#endif
+
+EvpCipher::EvpCipher()
+{
+    ctx = NULL;
+}
+
+EvpCipher::~EvpCipher()
+{
+    if (ctx)
+    {
+        EVP_CIPHER_CTX_free(ctx);
+    }
+}
+
+void EvpCipher::setkey(const EVP_CIPHER* cipher, const byte* key, bool encrypt)
+{
+    if (!ctx)
+    {
+        ctx = EVP_CIPHER_CTX_new();
+    }
+
+    EVP_CipherInit_ex(ctx, cipher, NULL, key, SymmCipher::zeroiv, encrypt ? 1 : 0);
+    EVP_CIPHER_CTX_set_padding(ctx, 0);
+}
+
+void EvpCipher::setiv(const byte* iv)
+{
+    // keeps the key schedule
+    EVP_CipherInit_ex(ctx, NULL, NULL, NULL, iv, -1);
+}
+
+void EvpCipher::process(byte* out, const byte* in, unsigned len)
+{
+    int outlen;
+
+    EVP_CipherUpdate(ctx, out, &outlen, in, (int)len);
+}
+
+EvpHash::EvpHash(const EVP_MD* type)
+{
+    md = type;
+    ctx = EVP_MD_CTX_new();
+    EVP_DigestInit_ex(ctx, md, NULL);
+}
+
+EvpHash::~EvpHash()
+{
+    EVP_MD_CTX_free(ctx);
+}
+
+void EvpHash::add(const byte* data, unsigned len)
+{
+    EVP_DigestUpdate(ctx, data, len);
+}
+
+void EvpHash::get(string* out)
+{
+    unsigned len;
+
+    out->resize(EVP_MD_size(md));
+    EVP_DigestFinal_ex(ctx, (byte*)out->data(), &len);
+    EVP_DigestInit_ex(ctx, md, NULL);
+}
+#endif
+
 // cryptographically strong random byte sequence
 void PrnGen::genblock(byte* buf, int len)
 {
@@ -62,11 +156,19 @@ void SymmCipher::setkey(const byte* newkey, int type)
         xorblock(newkey + KEYLENGTH, key);
     }
 
+#ifdef USE_OPENSSL_CRYPTO
+    evpecb_e.setkey(EVP_aes_128_ecb(), key, true);
+    evpecb_d.setkey(EVP_aes_128_ecb(), key, false);
+
+    evpcbc_e.setkey(EVP_aes_128_cbc(), key, true);
+    evpcbc_d.setkey(EVP_aes_128_cbc(), key, false);
+#else
     aesecb_e.SetKey(key, KEYLENGTH);
     aesecb_d.SetKey(key, KEYLENGTH);
 
     aescbc_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
     aescbc_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
+#endif
 
     aesccm_e.SetKeyWithIV(key, KEYLENGTH, zeroiv);
     aesccm_d.SetKeyWithIV(key, KEYLENGTH, zeroiv);
@@ -96,8 +198,13 @@ bool SymmCipher::setkey(const string* key)
  */
 void SymmCipher::cbc_encrypt(byte* data, unsigned len, const byte* iv)
 {
+#ifdef USE_OPENSSL_CRYPTO
+    evpcbc_e.setiv(iv ? iv : zeroiv);
+    evpcbc_e.process(data, data, len);
+#else
     aescbc_e.Resynchronize(iv ? iv : zeroiv);
     aescbc_e.ProcessData(data, data, len);
+#endif
 }
 
 /**
@@ -112,8 +219,13 @@ void SymmCipher::cbc_encrypt(byte* data, unsigned len, const byte* iv)
  */
 void SymmCipher::cbc_decrypt(byte* data, unsigned len, const byte* iv)
 {
+#ifdef USE_OPENSSL_CRYPTO
+    evpcbc_d.setiv(iv ? iv : zeroiv);
+    evpcbc_d.process(data, data, len);
+#else
     aescbc_d.Resynchronize(iv ? iv : zeroiv);
     aescbc_d.ProcessData(data, data, len);
+#endif
 }
 
 /**
@@ -128,7 +240,11 @@ void SymmCipher::cbc_decrypt(byte* data, unsigned len, const byte* iv)
  */
 void SymmCipher::cbc_encrypt_pkcs_padding(const string *data, const byte *iv, string *result)
 {
+#ifdef USE_OPENSSL_CRYPTO
+    aescbc_e.SetKeyWithIV(key, KEYLENGTH, iv ? iv : zeroiv);
+#else
     aescbc_e.Resynchronize(iv ? iv : zeroiv);
+#endif
     StringSource(*data, true,
            new CryptoPP::StreamTransformationFilter( aescbc_e, new StringSink( *result ),
                                                      CryptoPP::StreamTransformationFilter::PKCS_PADDING));
@@ -146,7 +262,11 @@ void SymmCipher::cbc_encrypt_pkcs_padding(const string *data, const byte *iv, st
  */
 void SymmCipher::cbc_decrypt_pkcs_padding(const std::string *data, const byte *iv, string *result)
 {
+#ifdef USE_OPENSSL_CRYPTO
+    aescbc_d.SetKeyWithIV(key, KEYLENGTH, iv ? iv : zeroiv);
+#else
     aescbc_d.Resynchronize(iv ? iv : zeroiv);
+#endif
     StringSource(*data, true,
            new CryptoPP::StreamTransformationFilter( aescbc_d, new StringSink( *result ),
                                                      CryptoPP::StreamTransformationFilter::PKCS_PADDING));
@@ -163,7 +283,11 @@ void SymmCipher::cbc_decrypt_pkcs_padding(const std::string *data, const byte *i
  */
 void SymmCipher::ecb_encrypt(byte* data, byte* dst, unsigned len)
 {
+#ifdef USE_OPENSSL_CRYPTO
+    evpecb_e.process(dst ? dst : data, data, len);
+#else
     aesecb_e.ProcessData(dst ? dst : data, data, len);
+#endif
 }
 
 /**
@@ -176,7 +300,11 @@ void SymmCipher::ecb_encrypt(byte* data, byte* dst, unsigned len)
  */
 void SymmCipher::ecb_decrypt(byte* data, unsigned len)
 {
+#ifdef USE_OPENSSL_CRYPTO
+    evpecb_d.process(data, data, len);
+#else
     aesecb_d.ProcessData(data, data, len);
+#endif
 }
 
 /**
@@ -300,6 +428,26 @@ void SymmCipher::serializekeyforjs(string *d)
     *d = ss.str();
 }
 
+void SymmCipher::encryptrounds(const byte* keys, int n, byte* block, int rounds)
+{
+    CryptoPP::AES::Encryption* aes = new CryptoPP::AES::Encryption[n];
+
+    for (int i = 0; i < n; i++)
+    {
+        aes[i].SetKey(keys + i * KEYLENGTH, KEYLENGTH);
+    }
+
+    while (rounds--)
+    {
+        for (int i = 0; i < n; i++)
+        {
+            aes[i].ProcessBlock(block);
+        }
+    }
+
+    delete[] aes;
+}
+
 void SymmCipher::setint64(int64_t value, byte* data)
 {
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -353,14 +501,75 @@ SymmCipher& SymmCipher::operator=(const SymmCipher& ref)
     return *this;
 }
 
+void SymmCipher::cbc_decrypt(unsigned n, const byte* const* keys, byte* const* data, const unsigned* lens)
+{
+#ifdef USE_OPENSSL_CRYPTO
+    EvpCipher aes;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        aes.setkey(EVP_aes_128_cbc(), keys[i], false);
+        aes.process(data[i], data[i], lens[i]);
+    }
+#else
+    CryptoPP::AES::Decryption aes;
+    string tmp;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        unsigned len = lens[i];
+        byte* d = data[i];
+
+        if (!len)
+        {
+            continue;
+        }
+
+        aes.SetKey(keys[i], KEYLENGTH);
+        tmp.resize(len);
+
+        // P[0] = D(C[0]) (zero IV), P[i] = D(C[i]) ^ C[i - 1]
+        byte* out = (byte*)tmp.data();
+
+        aes.ProcessBlock(d, out);
+
+        if (len > (unsigned)BLOCKSIZE)
+        {
+            aes.AdvancedProcessBlocks(d + BLOCKSIZE, d, out + BLOCKSIZE, len - BLOCKSIZE,
+                                      BlockTransformation::BT_AllowParallel);
+        }
+
+        memcpy(d, out, len);
+    }
+#endif
+}
+
+// CBC-MAC of whole blocks, chained from mac
+void SymmCipher::cbc_mac(const byte* data, unsigned len, byte* mac, byte* tmp)
+{
+#ifdef USE_OPENSSL_CRYPTO
+    evpcbc_e.setiv(mac);
+    evpcbc_e.process(tmp, data, len);
+#else
+    aescbc_e.Resynchronize(mac);
+    aescbc_e.ProcessData(tmp, data, len);
+#endif
+    memcpy(mac, tmp + len - BLOCKSIZE, BLOCKSIZE);
+}
+
 // encryption: data must be NUL-padded to BLOCKSIZE
 // decryption: data must be padded to BLOCKSIZE
 // len must be < 2^31
+// the keystream of up to CTRBATCH blocks and the MAC over them are computed
+// with one call each, which lets Crypto++ (or OpenSSL EVP) use its multi-block
+// AES-NI / ARMv8 kernels (selected at runtime, with a portable fallback)
+// instead of going through the mode objects once per block
 void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv, byte* mac, bool encrypt)
 {
     assert(!(pos & (KEYLENGTH - 1)));
 
-    byte ctr[BLOCKSIZE], tmp[BLOCKSIZE];
+    byte ctr[BLOCKSIZE];
+    byte ctrs[CTRBATCH * BLOCKSIZE], keystream[CTRBATCH * BLOCKSIZE];
 
     MemAccess::set<int64_t>(ctr,ctriv);
     setint64(pos / BLOCKSIZE, ctr + sizeof ctriv);
@@ -373,41 +582,148 @@ void SymmCipher::ctr_crypt(byte* data, unsigned len, m_off_t pos, ctr_iv ctriv,
 
     while ((int)len > 0)
     {
+        unsigned blocks = (len + BLOCKSIZE - 1) / BLOCKSIZE;
+
+        if (blocks > CTRBATCH)
+        {
+            blocks = CTRBATCH;
+        }
+
+        unsigned batch = blocks * BLOCKSIZE;
+
+        for (unsigned i = 0; i < blocks; i++)
+        {
+            memcpy(ctrs + i * BLOCKSIZE, ctr, BLOCKSIZE);
+            incblock(ctr);
+        }
+
+        ecb_encrypt(ctrs, keystream, batch);
+
         if (encrypt)
         {
-            if(mac)
+            if (mac)
             {
-                xorblock(data, mac);
-                ecb_encrypt(mac);
+                // the plaintext is NUL-padded
+                cbc_mac(data, batch, mac, ctrs);
             }
 
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+            for (unsigned i = 0; i < batch; i += BLOCKSIZE)
+            {
+                xorblock(keystream + i, data + i);
+            }
         }
         else
         {
-            ecb_encrypt(ctr, tmp);
-            xorblock(tmp, data);
+            for (unsigned i = 0; i < batch; i += BLOCKSIZE)
+            {
+                xorblock(keystream + i, data + i);
+            }
 
             if (mac)
             {
-                if (len >= (unsigned)BLOCKSIZE)
+                // a trailing partial block is MACed NUL-padded
+                unsigned whole = len < batch ? batch - BLOCKSIZE : batch;
+
+                if (whole)
+                {
+                    cbc_mac(data, whole, mac, ctrs);
+                }
+
+                if (whole < batch)
                 {
-                    xorblock(data, mac);
+                    xorblock(data + whole, mac, len - whole);
+                    ecb_encrypt(mac);
+                }
+            }
+        }
+
+        len -= batch;
+        data += batch;
+    }
+}
+
+// a single CBC-MAC chain can't keep the AES pipeline busy, but the chains of
+// different chunks are independent: their blocks are MACed side by side
+// (chunks sorted by length, so that the chains still running are always a
+// prefix of the lanes), the keystream is batched per chunk as usual
+void SymmCipher::ctr_crypt(unsigned n, byte* const* data, const unsigned* len, const m_off_t* pos,
+                           ctr_iv ctriv, byte* const* macs, bool encrypt)
+{
+    if (!encrypt)
+    {
+        for (unsigned i = 0; i < n; i++)
+        {
+            ctr_crypt(data[i], len[i], pos[i], ctriv, NULL, false);
+        }
+    }
+
+    byte states[MACLANES * BLOCKSIZE];
+    unsigned lane[MACLANES];
+
+    for (unsigned first = 0; first < n; first += MACLANES)
+    {
+        unsigned lanes = n - first < MACLANES ? n - first : MACLANES;
+
+        for (unsigned l = 0; l < lanes; l++)
+        {
+            unsigned k = l;
+
+            // insertion sort, longest first
+            while (k && len[lane[k - 1]] < len[first + l])
+            {
+                lane[k] = lane[k - 1];
+                k--;
+            }
+
+            lane[k] = first + l;
+        }
+
+        for (unsigned l = 0; l < lanes; l++)
+        {
+            byte* state = states + l * BLOCKSIZE;
+
+            MemAccess::set<int64_t>(state, ctriv);
+            MemAccess::set<int64_t>(state + sizeof ctriv, ctriv);
+        }
+
+        for (unsigned offset = 0; offset < len[lane[0]]; offset += BLOCKSIZE)
+        {
+            unsigned active = 0;
+
+            while (active < lanes && len[lane[active]] > offset)
+            {
+                unsigned remaining = len[lane[active]] - offset;
+                const byte* block = data[lane[active]] + offset;
+                byte* state = states + active * BLOCKSIZE;
+
+                // the plaintext is NUL-padded, for data and MAC alike
+                if (remaining >= (unsigned)BLOCKSIZE)
+                {
+                    xorblock(block, state);
                 }
                 else
                 {
-                    xorblock(data, mac, len);
+                    xorblock(block, state, remaining);
                 }
 
-                ecb_encrypt(mac);
+                active++;
             }
+
+            ecb_encrypt(states, NULL, active * BLOCKSIZE);
         }
 
-        len -= BLOCKSIZE;
-        data += BLOCKSIZE;
+        for (unsigned l = 0; l < lanes; l++)
+        {
+            memcpy(macs[lane[l]], states + l * BLOCKSIZE, BLOCKSIZE);
+        }
+    }
 
-        incblock(ctr);
+    if (encrypt)
+    {
+        for (unsigned i = 0; i < n; i++)
+        {
+            ctr_crypt(data[i], len[i], pos[i], ctriv, NULL, true);
+        }
     }
 }
 
@@ -647,6 +963,36 @@ void AsymmCipher::genkeypair(Integer* privk, Integer* pubk, int size)
     privk[PRIV_U] = privk[PRIV_P].InverseMod(privk[PRIV_Q]);
 }
 
+#ifdef USE_OPENSSL_CRYPTO
+Hash::Hash() : hash(EVP_sha512())
+{
+}
+
+void Hash::add(const byte* data, unsigned len)
+{
+    hash.add(data, len);
+}
+
+void Hash::get(string* out)
+{
+    hash.get(out);
+}
+
+HashSHA256::HashSHA256() : hash(EVP_sha256())
+{
+}
+
+void HashSHA256::add(const byte *data, unsigned int len)
+{
+    hash.add(data, len);
+}
+
+void HashSHA256::get(std::string *retStr)
+{
+    hash.get(retStr);
+}
+
+#else
 void Hash::add(const byte* data, unsigned len)
 {
     hash.Update(data, len);
@@ -669,14 +1015,226 @@ void HashSHA256::get(std::string *retStr)
     hash.Final((byte*)retStr->data());
 }
 
+#endif
+
+// CRC-32 (IEEE 802.3, reflected), continuing from a non-inverted crc
+// the sparse fingerprint samples are 64 bytes - one fold of the x86 kernel
+#ifdef CRC32_PCLMUL
+static uint32_t crc32table[256];
+
+static bool crc32detect()
+{
+    unsigned regs[4];
+
+#ifdef _MSC_VER
+    __cpuid((int*)regs, 1);
+#else
+    if (!__get_cpuid(1, regs, regs + 1, regs + 2, regs + 3))
+    {
+        return false;
+    }
+#endif
+
+    // ECX: PCLMULQDQ, SSE4.1
+    if (!(regs[2] & (1 << 1)) || !(regs[2] & (1 << 19)))
+    {
+        return false;
+    }
+
+    // for the unfolded tail
+    for (uint32_t i = 0; i < 256; i++)
+    {
+        uint32_t c = i;
+
+        for (int j = 0; j < 8; j++)
+        {
+            c = (c >> 1) ^ (0xedb88320 & (0 - (c & 1)));
+        }
+
+        crc32table[i] = c;
+    }
+
+    return true;
+}
+
+static const bool crc32hw = crc32detect();
+
+// carry-less multiplication folding (Intel, "Fast CRC Computation for Generic
+// Polynomials Using PCLMULQDQ"), operates on the inverted crc
+// len must be >= 64 and a multiple of 16
+CRC32_TARGET static uint32_t crc32fold(uint32_t crc, const byte* buf, unsigned len)
+{
+    static const uint64_t CRC32_ALIGN k1k2[] = { 0x0154442bd4ULL, 0x01c6e41596ULL };
+    static const uint64_t CRC32_ALIGN k3k4[] = { 0x01751997d0ULL, 0x00ccaa009eULL };
+    static const uint64_t CRC32_ALIGN k5k0[] = { 0x0163cd6124ULL, 0 };
+    static const uint64_t CRC32_ALIGN poly[] = { 0x01db710641ULL, 0x01f7011641ULL };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)buf);
+    x2 = _mm_loadu_si128((const __m128i*)(buf + 16));
+    x3 = _mm_loadu_si128((const __m128i*)(buf + 32));
+    x4 = _mm_loadu_si128((const __m128i*)(buf + 48));
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+    x0 = _mm_load_si128((const __m128i*)k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    // fold four lanes by 512 bits
+    while (len >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((const __m128i*)buf));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((const __m128i*)(buf + 16)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((const __m128i*)(buf + 32)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((const __m128i*)(buf + 48)));
+
+        buf += 64;
+        len -= 64;
+    }
+
+    // fold the lanes into one, then the remaining blocks of 128 bits
+    x0 = _mm_load_si128((const __m128i*)k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    while (len >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)buf);
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    // 128 -> 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)k5k0);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i*)poly);
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+
+static uint32_t crc32update(uint32_t crc, const byte* data, unsigned len)
+{
+    crc = ~crc;
+
+    if (len >= 64)
+    {
+        unsigned folded = len & ~15U;
+
+        crc = crc32fold(crc, data, folded);
+        data += folded;
+        len -= folded;
+    }
+
+    while (len--)
+    {
+        crc = crc32table[(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+#elif defined(CRC32_ARMV8)
+static const bool crc32hw = true;
+
+static uint32_t crc32update(uint32_t crc, const byte* data, unsigned len)
+{
+    crc = ~crc;
+
+    for (; len >= 8; data += 8, len -= 8)
+    {
+        crc = __crc32d(crc, MemAccess::get<uint64_t>((const char*)data));
+    }
+
+    while (len--)
+    {
+        crc = __crc32b(crc, *data++);
+    }
+
+    return ~crc;
+}
+#else
+static const bool crc32hw = false;
+#endif
+
+bool HashCRC32::hwsupported()
+{
+    return crc32hw;
+}
+
+HashCRC32::HashCRC32()
+{
+    crc = 0;
+}
+
 void HashCRC32::add(const byte* data, unsigned len)
 {
+#if defined(CRC32_PCLMUL) || defined(CRC32_ARMV8)
+    if (crc32hw)
+    {
+        crc = crc32update(crc, data, len);
+        return;
+    }
+#endif
+
+#ifdef USE_OPENSSL_CRYPTO
+    crc = (uint32_t)crc32(crc, data, len);
+#else
     hash.Update(data, len);
+#endif
 }
 
 void HashCRC32::get(byte* out)
 {
-    hash.Final(out);
+#ifndef USE_OPENSSL_CRYPTO
+    if (!crc32hw)
+    {
+        hash.Final(out);
+        return;
+    }
+#endif
+
+    // little-endian, as Crypto++'s CRC32 emits it
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = (byte)(crc >> (8 * i));
+    }
+
+    crc = 0;
 }
 
 HMACSHA256::HMACSHA256(const byte *key, size_t length)
@@ -21,11 +21,58 @@
 
 #include "mega/db.h"
 #include "mega/utils.h"
+#include "mega/filefingerprint.h"
+#include "mega/serialize64.h"
+#include "mega/logging.h"
+#include "mega/thread.h"
+
+#if defined(HAVE_ZLIB_H) || (defined(_WIN32) && !defined(WINDOWS_PHONE))
+#include <zlib.h>
+#define HAVE_GZIP 1
+#endif
 
 namespace mega {
 DbTable::DbTable()
 {
     nextid = 0;
+    byteswritten = 0;
+    batched = 0;
+    indexkey = NULL;
+    reindex = false;
+    zdeflate = NULL;
+    zinflate = NULL;
+
+#ifdef HAVE_GZIP
+    compressrecords = true;
+#else
+    compressrecords = false;
+#endif
+}
+
+DbTable::~DbTable()
+{
+    delete indexkey;
+
+#ifdef HAVE_GZIP
+    if (zdeflate)
+    {
+        deflateEnd(zdeflate);
+        delete zdeflate;
+    }
+#endif
+
+    inflateend(zinflate);
+}
+
+bool DbTable::setcompression(bool enable)
+{
+#ifdef HAVE_GZIP
+    compressrecords = enable;
+    return true;
+#else
+    compressrecords = false;
+    return !enable;
+#endif
 }
 
 // add or update record from string
@@ -39,21 +86,168 @@ bool DbTable::put(uint32_t type, Cachable* record, SymmCipher* key)
 {
     string data;
 
-    if (!record->serialize(&data))
+    if (!encrypt(record, key, &data))
     {
         //Don't return false if there are errors in the serialization
         //to let the SDK continue and save the rest of records
         return true;
     }
 
-    PaddedCBC::encrypt(&data, key);
+    if (!record->dbid)
+    {
+        record->dbid = (nextid += IDSPACING) | type;
+    }
+
+    DbIndex columns;
+
+    index(record, key, &columns);
+
+    byteswritten += data.size();
+
+    return put(record->dbid, (char*)data.data(), data.size(), &columns);
+}
+
+bool DbTable::put(uint32_t index, char* data, unsigned len, const DbIndex*)
+{
+    return put(index, data, len);
+}
+
+bool DbTable::putbatch(unsigned count, const uint32_t* index, const string* data, const DbIndex* columns)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!put(index[i], (char*)data[i].data(), data[i].size(), columns + i))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DbTable::delbatch(unsigned count, const uint32_t* index)
+{
+    for (unsigned i = 0; i < count; i++)
+    {
+        if (!del(index[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool DbTable::putbatched(uint32_t type, Cachable* record, SymmCipher* key)
+{
+    string* data = batchdata + batched;
+
+    data->clear();
+
+    if (!encrypt(record, key, data))
+    {
+        // as put(): skip the record, but continue with the rest
+        return true;
+    }
 
     if (!record->dbid)
     {
         record->dbid = (nextid += IDSPACING) | type;
     }
 
-    return put(record->dbid, &data);
+    index(record, key, batchindex + batched);
+    batchids[batched++] = record->dbid;
+    byteswritten += data->size();
+
+    return batched < PUTBATCH || flushbatch();
+}
+
+uint32_t DbTable::reserveid(uint32_t type)
+{
+    return (nextid += IDSPACING) | type;
+}
+
+bool DbTable::flushbatch()
+{
+    unsigned count = batched;
+
+    batched = 0;
+
+    return !count || putbatch(count, batchids, batchdata, batchindex);
+}
+
+bool DbTable::lookup(int, const string*, vector<uint32_t>*)
+{
+    return false;
+}
+
+bool DbTable::sidecar(string*)
+{
+    return false;
+}
+
+// column values of the record (if any)
+void DbTable::index(Cachable* record, SymmCipher* key, DbIndex* columns)
+{
+    DbColumns c;
+
+    columns->set = record->dbcolumns(&c);
+
+    if (columns->set)
+    {
+        indexvalue(c.nodehandle, key, &columns->nodehandle);
+        indexvalue(c.parenthandle, key, &columns->parenthandle);
+        columns->type = c.type;
+
+        if (c.fingerprint)
+        {
+            indexvalue(c.fingerprint, key, &columns->fingerprint);
+        }
+        else
+        {
+            columns->fingerprint.clear();
+        }
+    }
+}
+
+// a handle is padded to one block and ECB-encrypted under a key derived
+// from the table key (the same for node and parent handles, so that
+// children can be looked up by their parent's node handle)
+SymmCipher* DbTable::columnkey(SymmCipher* key)
+{
+    if (!indexkey)
+    {
+        byte buf[SymmCipher::BLOCKSIZE] = "statecacheindex";
+
+        key->ecb_encrypt(buf);
+        indexkey = new SymmCipher(buf);
+    }
+
+    return indexkey;
+}
+
+void DbTable::indexvalue(handle h, SymmCipher* key, string* value)
+{
+    byte buf[SymmCipher::BLOCKSIZE];
+
+    memset(buf, 0, sizeof buf);
+    MemAccess::set<handle>(buf, h);
+    columnkey(key)->ecb_encrypt(buf);
+
+    value->assign((char*)buf, sizeof buf);
+}
+
+// size and sparse CRC in two blocks, CBC-encrypted with a zero IV
+void DbTable::indexvalue(const FileFingerprint* fp, SymmCipher* key, string* value)
+{
+    byte buf[2 * SymmCipher::BLOCKSIZE];
+
+    memset(buf, 0, sizeof buf);
+    MemAccess::set<int64_t>(buf, fp->size);
+    memcpy(buf + sizeof(int64_t), fp->crc, sizeof fp->crc);
+    columnkey(key)->cbc_encrypt(buf, sizeof buf);
+
+    value->assign((char*)buf, sizeof buf);
 }
 
 // get next record, decrypt and unpad
@@ -61,7 +255,8 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
 {
     if (next(type, data))
     {
-        if (!*type)
+        // records below the first Cachable id are not encrypted
+        if (*type < (uint32_t)IDSPACING)
         {
             return true;
         }
@@ -71,10 +266,575 @@ bool DbTable::next(uint32_t* type, string* data, SymmCipher* key)
             nextid = *type & - IDSPACING;
         }
 
-        return PaddedCBC::decrypt(data, key);
+        return decrypt(data, key, &zinflate);
+    }
+
+    return false;
+}
+
+struct DecodeJob
+{
+    unsigned count;
+    uint32_t* ids;
+    string* data;
+    bool* ok;
+    SymmCipher* key;
+};
+
+// worker side: one slice of records with its own cipher and inflate stream
+void DbTable::decodeslice(unsigned slice, void* param)
+{
+    DecodeJob* job = (DecodeJob*)param;
+    unsigned first = slice * DECODESLICE;
+    unsigned last = first + DECODESLICE < job->count ? first + DECODESLICE : job->count;
+    SymmCipher key(*job->key);
+    z_stream_s* z = NULL;
+
+    for (unsigned i = first; i < last; i++)
+    {
+        // the scsn and session records are not encrypted
+        job->ok[i] = job->ids[i] < (uint32_t)IDSPACING || decrypt(job->data + i, &key, &z);
+    }
+
+    inflateend(z);
+}
+
+unsigned DbTable::nextbatch(unsigned max, uint32_t* ids, string* data, bool* ok, SymmCipher* key, ParallelRunner* workers, int skip)
+{
+    DecodeJob job;
+
+    for (job.count = 0; job.count < max && next(ids + job.count, data + job.count); )
+    {
+        uint32_t id = ids[job.count];
+
+        if (id > nextid)
+        {
+            nextid = id & - IDSPACING;
+        }
+
+        if (skip < 0 || (int)(id & (IDSPACING - 1)) != skip)
+        {
+            job.count++;
+        }
+    }
+
+    job.ids = ids;
+    job.data = data;
+    job.ok = ok;
+    job.key = key;
+
+    unsigned slices = (job.count + DECODESLICE - 1) / DECODESLICE;
+
+    if (workers && slices > 1)
+    {
+        workers->run(slices, decodeslice, &job);
+    }
+    else
+    {
+        for (unsigned i = 0; i < slices; i++)
+        {
+            decodeslice(i, &job);
+        }
+    }
+
+    return job.count;
+}
+
+// records are padded as by PaddedCBC, but terminated by 'Z' instead of 'E'
+// if compressed (uncompressed ones remain readable by PaddedCBC::decrypt())
+bool DbTable::encrypt(Cachable* record, SymmCipher* key, string* data)
+{
+    if (!record->serialize(data))
+    {
+        return false;
+    }
+
+    bool compressed = compressrecords && data->size() >= MINCOMPRESS && compress(data);
+
+    data->append(1, compressed ? 'Z' : 'E');
+    data->resize((data->size() + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE, 'P');
+    key->cbc_encrypt((byte*)data->data(), data->size());
+
+    return true;
+}
+
+bool DbTable::decrypt(string* data, SymmCipher* key, z_stream_s** z)
+{
+    if (data->size() & (SymmCipher::BLOCKSIZE - 1))
+    {
+        return false;
+    }
+
+    key->cbc_decrypt((byte*)data->data(), data->size());
+
+    size_t p = data->find_last_not_of('P');
+
+    if (p == string::npos)
+    {
+        return false;
+    }
+
+    char terminator = (*data)[p];
+
+    data->resize(p);
+
+    if (terminator == 'Z')
+    {
+        return uncompress(data, z);
+    }
+
+    return terminator == 'E';
+}
+
+// replace with the uncompressed size and the raw deflate stream if that is
+// smaller
+bool DbTable::compress(string* data)
+{
+#ifdef HAVE_GZIP
+    if (!zdeflate)
+    {
+        zdeflate = new z_stream;
+        memset(zdeflate, 0, sizeof *zdeflate);
+
+        // records are small: a 4 KB window and little state suffice
+        if (deflateInit2(zdeflate, Z_BEST_SPEED, Z_DEFLATED, -12, 5, Z_DEFAULT_STRATEGY) != Z_OK)
+        {
+            delete zdeflate;
+            zdeflate = NULL;
+            compressrecords = false;
+            return false;
+        }
+    }
+    else
+    {
+        deflateReset(zdeflate);
+    }
+
+    string compressed;
+
+    Serialize64::serialize(&compressed, data->size());
+
+    size_t header = compressed.size();
+
+    compressed.resize(header + deflateBound(zdeflate, data->size()));
+
+    zdeflate->next_in = (Bytef*)data->data();
+    zdeflate->avail_in = data->size();
+    zdeflate->next_out = (Bytef*)compressed.data() + header;
+    zdeflate->avail_out = compressed.size() - header;
+
+    if (deflate(zdeflate, Z_FINISH) != Z_STREAM_END)
+    {
+        return false;
+    }
+
+    compressed.resize(compressed.size() - zdeflate->avail_out);
+
+    if (compressed.size() >= data->size())
+    {
+        return false;
+    }
+
+    data->swap(compressed);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool DbTable::uncompress(string* data, z_stream_s** z)
+{
+#ifdef HAVE_GZIP
+    const char* ptr = data->data();
+    const char* end = ptr + data->size();
+    uint64_t size;
+
+    if (!Serialize64::unserialize(&ptr, end, &size) || size > DbTable::MAXRECORDSIZE)
+    {
+        return false;
+    }
+
+    if (!*z)
+    {
+        *z = new z_stream;
+        memset(*z, 0, sizeof **z);
+
+        if (inflateInit2(*z, -12) != Z_OK)
+        {
+            delete *z;
+            *z = NULL;
+            return false;
+        }
+    }
+    else
+    {
+        inflateReset(*z);
+    }
+
+    string uncompressed((size_t)size, 0);
+
+    (*z)->next_in = (Bytef*)ptr;
+    (*z)->avail_in = end - ptr;
+    (*z)->next_out = (Bytef*)uncompressed.data();
+    (*z)->avail_out = uncompressed.size();
+
+    if (inflate(*z, Z_FINISH) != Z_STREAM_END || (*z)->avail_out)
+    {
+        LOG_err << "Corrupt compressed cache record";
+        return false;
     }
 
+    data->swap(uncompressed);
+
+    return true;
+#else
+    LOG_err << "Compressed cache record, but no zlib support";
     return false;
+#endif
+}
+
+void DbTable::inflateend(z_stream_s* z)
+{
+#ifdef HAVE_GZIP
+    if (z)
+    {
+        inflateEnd(z);
+        delete z;
+    }
+#endif
+}
+
+AsyncDbTable::AsyncDbTable(DbTable* t, Thread* th, Mutex* m, Semaphore* i, Semaphore* s, Semaphore* y)
+{
+    table = t;
+    thread = th;
+    mutex = m;
+    items = i;
+    slots = s;
+    synced = y;
+
+    mutex->init(false);
+    items->init(0);
+    slots->init(MAXQUEUED);
+    synced->init(0);
+
+    failed = false;
+    pending = 0;
+    reindex = table->reindex;
+    nextid = table->nextid;
+
+    thread->start(writerentry, this);
+}
+
+// the writer finishes the queue before it stops
+AsyncDbTable::~AsyncDbTable()
+{
+    enqueue(new Op(OP_STOP));
+    thread->join();
+
+    delete table;
+    delete thread;
+    delete mutex;
+    delete items;
+    delete slots;
+    delete synced;
+}
+
+bool AsyncDbTable::enqueue(Op* op)
+{
+    slots->wait();
+
+    mutex->lock();
+    queue.push_back(op);
+    bool result = !failed;
+    mutex->unlock();
+
+    items->release();
+    pending++;
+
+    return result;
+}
+
+bool AsyncDbTable::sync()
+{
+    enqueue(new Op(OP_SYNC));
+    synced->wait();
+    pending = 0;
+
+    mutex->lock();
+    bool result = !failed;
+    mutex->unlock();
+
+    return result;
+}
+
+void* AsyncDbTable::writerentry(void* param)
+{
+    ((AsyncDbTable*)param)->write();
+    return NULL;
+}
+
+void AsyncDbTable::write()
+{
+    for (;;)
+    {
+        items->wait();
+
+        mutex->lock();
+        Op* op = queue.front();
+        queue.pop_front();
+        mutex->unlock();
+
+        if (op->type == OP_STOP)
+        {
+            delete op;
+            return;
+        }
+
+        if (!execute(op))
+        {
+            LOG_err << "Queued DB write failed - discarding further writes";
+
+            mutex->lock();
+            failed = true;
+            mutex->unlock();
+        }
+
+        delete op;
+        slots->release();
+    }
+}
+
+// only the writer sets failed, so it reads it without locking
+bool AsyncDbTable::execute(Op* op)
+{
+    switch (op->type)
+    {
+        case OP_PUT:
+            return failed || table->put(op->ids[0], (char*)op->data[0].data(), op->data[0].size(), &op->columns[0]);
+
+        case OP_PUTBATCH:
+            return failed || table->putbatch(op->ids.size(), &op->ids[0], &op->data[0], &op->columns[0]);
+
+        case OP_DEL:
+            return failed || table->del(op->ids[0]);
+
+        case OP_DELBATCH:
+            return failed || table->delbatch(op->ids.size(), &op->ids[0]);
+
+        case OP_TRUNCATE:
+            if (!failed)
+            {
+                table->truncate();
+            }
+            break;
+
+        case OP_BEGIN:
+            table->begin();
+            break;
+
+        case OP_COMMIT:
+            if (failed)
+            {
+                LOG_err << "Rolling back a transaction with failed writes";
+                table->abort();
+            }
+            else
+            {
+                table->commit();
+            }
+            break;
+
+        case OP_ABORT:
+            table->abort();
+            break;
+
+        case OP_SYNC:
+            synced->release();
+            break;
+    }
+
+    return true;
+}
+
+void AsyncDbTable::rewind()
+{
+    if (pending)
+    {
+        sync();
+    }
+
+    table->rewind();
+}
+
+bool AsyncDbTable::next(uint32_t* index, string* data)
+{
+    if (pending)
+    {
+        sync();
+    }
+
+    return table->next(index, data);
+}
+
+// the latest queued write of the record answers the read, unless a
+// rollback is queued after it
+bool AsyncDbTable::get(uint32_t index, string* data)
+{
+    bool decided = false;
+    bool found = false;
+
+    mutex->lock();
+
+    for (deque<Op*>::reverse_iterator it = queue.rbegin(); !decided && it != queue.rend(); it++)
+    {
+        Op* op = *it;
+
+        if (op->type == OP_ABORT)
+        {
+            break;
+        }
+
+        if (op->type == OP_TRUNCATE)
+        {
+            decided = true;
+            break;
+        }
+
+        for (size_t i = op->ids.size(); i--; )
+        {
+            if (op->ids[i] == index)
+            {
+                decided = true;
+
+                if ((found = op->type != OP_DEL && op->type != OP_DELBATCH))
+                {
+                    *data = op->data[i];
+                }
+
+                break;
+            }
+        }
+    }
+
+    mutex->unlock();
+
+    if (decided)
+    {
+        return found;
+    }
+
+    if (pending)
+    {
+        sync();
+    }
+
+    return table->get(index, data);
+}
+
+bool AsyncDbTable::put(uint32_t index, char* data, unsigned len)
+{
+    return put(index, data, len, NULL);
+}
+
+bool AsyncDbTable::put(uint32_t index, char* data, unsigned len, const DbIndex* columns)
+{
+    Op* op = new Op(OP_PUT);
+
+    op->ids.push_back(index);
+    op->data.push_back(string(data, len));
+    op->columns.push_back(columns ? *columns : DbIndex());
+
+    return enqueue(op);
+}
+
+bool AsyncDbTable::putbatch(unsigned count, const uint32_t* index, const string* data, const DbIndex* columns)
+{
+    if (!count)
+    {
+        return true;
+    }
+
+    Op* op = new Op(OP_PUTBATCH);
+
+    op->ids.assign(index, index + count);
+    op->data.assign(data, data + count);
+
+    if (columns)
+    {
+        op->columns.assign(columns, columns + count);
+    }
+    else
+    {
+        op->columns.resize(count);
+    }
+
+    return enqueue(op);
+}
+
+bool AsyncDbTable::lookup(int column, const string* value, vector<uint32_t>* ids)
+{
+    if (pending)
+    {
+        sync();
+    }
+
+    return table->lookup(column, value, ids);
+}
+
+bool AsyncDbTable::del(uint32_t index)
+{
+    Op* op = new Op(OP_DEL);
+
+    op->ids.push_back(index);
+
+    return enqueue(op);
+}
+
+bool AsyncDbTable::delbatch(unsigned count, const uint32_t* index)
+{
+    if (!count)
+    {
+        return true;
+    }
+
+    Op* op = new Op(OP_DELBATCH);
+
+    op->ids.assign(index, index + count);
+
+    return enqueue(op);
+}
+
+void AsyncDbTable::truncate()
+{
+    enqueue(new Op(OP_TRUNCATE));
+}
+
+void AsyncDbTable::begin()
+{
+    enqueue(new Op(OP_BEGIN));
+}
+
+void AsyncDbTable::commit()
+{
+    enqueue(new Op(OP_COMMIT));
+}
+
+void AsyncDbTable::abort()
+{
+    enqueue(new Op(OP_ABORT));
+}
+
+void AsyncDbTable::remove()
+{
+    sync();
+    table->remove();
+}
+
+bool AsyncDbTable::sidecar(string* path)
+{
+    return table->sidecar(path);
 }
 
 DbAccess::DbAccess()
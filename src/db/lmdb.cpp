@@ -0,0 +1,590 @@
+/**
+ * @file lmdb.cpp
+ * @brief LMDB access layer
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega.h"
+
+#ifdef USE_LMDB
+namespace mega {
+LmdbDbAccess::LmdbDbAccess(string* path)
+{
+    if (path)
+    {
+        dbpath = *path;
+    }
+}
+
+LmdbDbAccess::~LmdbDbAccess()
+{
+}
+
+// each table is an environment of its own, in a single file (plus its lock
+// file)
+DbTable* LmdbDbAccess::open(FileSystemAccess* fsaccess, string* name)
+{
+    ostringstream oss;
+    oss << dbpath;
+    oss << "megaclient_statecache";
+    oss << DB_VERSION;
+    oss << "_" << *name << ".lmdb";
+
+    string dbfile = oss.str();
+    currentDbVersion = DB_VERSION;
+
+    MDB_env* env;
+    int rc;
+
+    if ((rc = mdb_env_create(&env)))
+    {
+        LOG_err << "Unable to create the LMDB environment: " << mdb_strerror(rc);
+        return NULL;
+    }
+
+    // MDB_NOTLS: the read-only transaction of an iteration may coexist
+    // with those of get() and lookup()
+    if ((rc = mdb_env_set_maxdbs(env, 5))
+     || (rc = mdb_env_set_mapsize(env, MAPSIZE))
+     || (rc = mdb_env_open(env, dbfile.c_str(), MDB_NOSUBDIR | MDB_NOTLS, 0644)))
+    {
+        LOG_err << "Unable to open " << dbfile << ": " << mdb_strerror(rc);
+        mdb_env_close(env);
+        return NULL;
+    }
+
+    LmdbDbTable* table = new LmdbDbTable(env, fsaccess, &dbfile);
+
+    if (!table->init())
+    {
+        delete table;
+        return NULL;
+    }
+
+    return table;
+}
+
+LmdbDbTable::LmdbDbTable(MDB_env* cenv, FileSystemAccess *fs, string *filepath)
+{
+    env = cenv;
+    txn = NULL;
+    cursor = NULL;
+    cursortxn = NULL;
+    cursorop = MDB_FIRST;
+    records = 0;
+    columns = 0;
+    memset(indexes, 0, sizeof indexes);
+    fsaccess = fs;
+    dbfile = *filepath;
+}
+
+LmdbDbTable::~LmdbDbTable()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    closecursor();
+    abort();
+    mdb_env_close(env);
+    LOG_debug << "Database closed " << dbfile;
+}
+
+bool LmdbDbTable::init()
+{
+    static const char* names[] = { "nodehandle", "parenthandle", "fingerprint" };
+    MDB_txn* t;
+
+    if (!check(mdb_txn_begin(env, NULL, 0, &t), "begin"))
+    {
+        return false;
+    }
+
+    bool result = check(mdb_dbi_open(t, "statecache", MDB_CREATE | MDB_INTEGERKEY, &records), "open")
+               && check(mdb_dbi_open(t, "columns", MDB_CREATE | MDB_INTEGERKEY, &columns), "open");
+
+    for (unsigned i = 0; result && i < sizeof indexes / sizeof *indexes; i++)
+    {
+        result = check(mdb_dbi_open(t, names[i], MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED | MDB_INTEGERDUP, indexes + i), "open");
+    }
+
+    if (!result)
+    {
+        mdb_txn_abort(t);
+        return false;
+    }
+
+    return check(mdb_txn_commit(t), "commit");
+}
+
+bool LmdbDbTable::check(int rc, const char* what)
+{
+    if (rc)
+    {
+        LOG_err << "LMDB " << what << " failed: " << mdb_strerror(rc) << " " << dbfile;
+        return false;
+    }
+
+    return true;
+}
+
+bool LmdbDbTable::start(MDB_txn** t, bool write)
+{
+    if (txn)
+    {
+        *t = txn;
+        return true;
+    }
+
+    return check(mdb_txn_begin(env, NULL, write ? 0 : MDB_RDONLY, t), "begin");
+}
+
+// commit (or abort, if the operation failed) a transaction of start() that
+// is not the one of begin()
+bool LmdbDbTable::end(MDB_txn* t, bool result)
+{
+    if (t == txn)
+    {
+        return result;
+    }
+
+    if (!result)
+    {
+        mdb_txn_abort(t);
+        return false;
+    }
+
+    return check(mdb_txn_commit(t), "commit");
+}
+
+void LmdbDbTable::closecursor()
+{
+    if (cursor)
+    {
+        mdb_cursor_close(cursor);
+        cursor = NULL;
+    }
+
+    if (cursortxn)
+    {
+        mdb_txn_abort(cursortxn);
+        cursortxn = NULL;
+    }
+}
+
+// set cursor to first record
+void LmdbDbTable::rewind()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    closecursor();
+
+    MDB_txn* t;
+
+    if (!start(&t, false))
+    {
+        return;
+    }
+
+    if (t != txn)
+    {
+        cursortxn = t;
+    }
+
+    if (!check(mdb_cursor_open(t, records, &cursor), "cursor"))
+    {
+        cursor = NULL;
+        closecursor();
+        return;
+    }
+
+    cursorop = MDB_FIRST;
+}
+
+// retrieve next record through cursor
+bool LmdbDbTable::next(uint32_t* index, string* data)
+{
+    if (!env || !cursor)
+    {
+        return false;
+    }
+
+    MDB_val key, value;
+    int rc = mdb_cursor_get(cursor, &key, &value, cursorop);
+
+    if (rc || key.mv_size != sizeof *index)
+    {
+        if (rc != MDB_NOTFOUND)
+        {
+            check(rc ? rc : MDB_BAD_VALSIZE, "next");
+        }
+
+        closecursor();
+        return false;
+    }
+
+    cursorop = MDB_NEXT;
+
+    memcpy(index, key.mv_data, sizeof *index);
+    data->assign((char*)value.mv_data, value.mv_size);
+
+    return true;
+}
+
+// retrieve record by index
+bool LmdbDbTable::get(uint32_t index, string* data)
+{
+    MDB_txn* t;
+
+    if (!env || !start(&t, false))
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof index, &index }, value;
+    int rc = mdb_get(t, records, &key, &value);
+
+    if (!rc)
+    {
+        data->assign((char*)value.mv_data, value.mv_size);
+    }
+    else if (rc != MDB_NOTFOUND)
+    {
+        check(rc, "get");
+    }
+
+    if (t != txn)
+    {
+        mdb_txn_abort(t);
+    }
+
+    return !rc;
+}
+
+// the lookup columns of a record are stored as length-prefixed values in the
+// order of the indexes
+bool LmdbDbTable::unindex(MDB_txn* t, uint32_t index)
+{
+    MDB_val key = { sizeof index, &index }, value;
+    int rc = mdb_get(t, columns, &key, &value);
+
+    if (rc == MDB_NOTFOUND)
+    {
+        return true;
+    }
+
+    if (!check(rc, "get"))
+    {
+        return false;
+    }
+
+    // the deletions below may invalidate the value
+    string stored((char*)value.mv_data, value.mv_size);
+    size_t pos = 0;
+
+    for (unsigned i = 0; i < sizeof indexes / sizeof *indexes && pos < stored.size(); i++)
+    {
+        size_t len = (byte)stored[pos++];
+
+        if (len && pos + len <= stored.size())
+        {
+            MDB_val column = { len, (char*)stored.data() + pos };
+
+            rc = mdb_del(t, indexes[i], &column, &key);
+
+            if (rc && rc != MDB_NOTFOUND && !check(rc, "del"))
+            {
+                return false;
+            }
+        }
+
+        pos += len;
+    }
+
+    return check(mdb_del(t, columns, &key, NULL), "del");
+}
+
+// add/update record by index
+bool LmdbDbTable::put(uint32_t index, char* data, unsigned len)
+{
+    return put(index, data, len, NULL);
+}
+
+// add/update record and its lookup columns by index
+bool LmdbDbTable::put(uint32_t index, char* data, unsigned len, const DbIndex* cols)
+{
+    MDB_txn* t;
+
+    if (!env || !start(&t, true))
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof index, &index }, value = { len, data };
+    bool result = unindex(t, index) && check(mdb_put(t, records, &key, &value, 0), "put");
+
+    if (result && cols && cols->set)
+    {
+        const string* values[] = { &cols->nodehandle, &cols->parenthandle, &cols->fingerprint };
+        string stored;
+
+        for (unsigned i = 0; i < sizeof values / sizeof *values; i++)
+        {
+            stored.append(1, (char)values[i]->size());
+            stored.append(*values[i]);
+        }
+
+        MDB_val column = { stored.size(), (char*)stored.data() };
+
+        result = check(mdb_put(t, columns, &key, &column, 0), "put");
+
+        for (unsigned i = 0; result && i < sizeof values / sizeof *values; i++)
+        {
+            if (values[i]->size())
+            {
+                column.mv_size = values[i]->size();
+                column.mv_data = (char*)values[i]->data();
+
+                result = check(mdb_put(t, indexes[i], &column, &key, 0), "put");
+            }
+        }
+    }
+
+    return end(t, result);
+}
+
+// a single transaction for the whole batch outside begin()
+bool LmdbDbTable::putbatch(unsigned count, const uint32_t* index, const string* data, const DbIndex* cols)
+{
+    if (!env)
+    {
+        return false;
+    }
+
+    if (txn)
+    {
+        return DbTable::putbatch(count, index, data, cols);
+    }
+
+    if (!start(&txn, true))
+    {
+        txn = NULL;
+        return false;
+    }
+
+    bool result = DbTable::putbatch(count, index, data, cols);
+
+    MDB_txn* t = txn;
+    txn = NULL;
+
+    return end(t, result);
+}
+
+// ids of the records with a matching lookup column
+bool LmdbDbTable::lookup(int column, const string* value, vector<uint32_t>* ids)
+{
+    if (!env || column < COLUMN_NODEHANDLE || column > COLUMN_FINGERPRINT)
+    {
+        return false;
+    }
+
+    // LMDB keys cannot be empty - and no record has an empty column value
+    if (!value->size())
+    {
+        return true;
+    }
+
+    MDB_txn* t;
+    MDB_cursor* c;
+
+    if (!start(&t, false))
+    {
+        return false;
+    }
+
+    if (!check(mdb_cursor_open(t, indexes[column], &c), "cursor"))
+    {
+        end(t, false);
+        return false;
+    }
+
+    MDB_val key = { value->size(), (char*)value->data() }, id;
+    uint32_t index;
+    int rc;
+
+    for (rc = mdb_cursor_get(c, &key, &id, MDB_SET_KEY); !rc; rc = mdb_cursor_get(c, &key, &id, MDB_NEXT_DUP))
+    {
+        memcpy(&index, id.mv_data, sizeof index);
+        ids->push_back(index);
+    }
+
+    mdb_cursor_close(c);
+
+    if (t != txn)
+    {
+        mdb_txn_abort(t);
+    }
+
+    return rc == MDB_NOTFOUND || check(rc, "lookup");
+}
+
+// delete record by index
+bool LmdbDbTable::del(uint32_t index)
+{
+    MDB_txn* t;
+
+    if (!env || !start(&t, true))
+    {
+        return false;
+    }
+
+    MDB_val key = { sizeof index, &index };
+    bool result = unindex(t, index);
+
+    if (result)
+    {
+        int rc = mdb_del(t, records, &key, NULL);
+
+        result = rc == MDB_NOTFOUND || check(rc, "del");
+    }
+
+    return end(t, result);
+}
+
+// truncate table
+void LmdbDbTable::truncate()
+{
+    MDB_txn* t;
+
+    if (!env)
+    {
+        return;
+    }
+
+    closecursor();
+
+    if (!start(&t, true))
+    {
+        return;
+    }
+
+    bool result = check(mdb_drop(t, records, 0), "drop")
+               && check(mdb_drop(t, columns, 0), "drop");
+
+    for (unsigned i = 0; result && i < sizeof indexes / sizeof *indexes; i++)
+    {
+        result = check(mdb_drop(t, indexes[i], 0), "drop");
+    }
+
+    end(t, result);
+}
+
+// begin transaction
+void LmdbDbTable::begin()
+{
+    if (!env || txn)
+    {
+        return;
+    }
+
+    LOG_debug << "DB transaction BEGIN " << dbfile;
+
+    if (!check(mdb_txn_begin(env, NULL, 0, &txn), "begin"))
+    {
+        txn = NULL;
+    }
+}
+
+// commit transaction
+void LmdbDbTable::commit()
+{
+    if (!env || !txn)
+    {
+        return;
+    }
+
+    // a cursor opened inside the transaction ends with it
+    if (cursor && !cursortxn)
+    {
+        closecursor();
+    }
+
+    LOG_debug << "DB transaction COMMIT " << dbfile;
+
+    MDB_txn* t = txn;
+    txn = NULL;
+
+    check(mdb_txn_commit(t), "commit");
+}
+
+// abort transaction
+void LmdbDbTable::abort()
+{
+    if (!env || !txn)
+    {
+        return;
+    }
+
+    if (cursor && !cursortxn)
+    {
+        closecursor();
+    }
+
+    LOG_debug << "DB transaction ROLLBACK " << dbfile;
+
+    mdb_txn_abort(txn);
+    txn = NULL;
+}
+
+void LmdbDbTable::remove()
+{
+    if (!env)
+    {
+        return;
+    }
+
+    closecursor();
+    abort();
+    mdb_env_close(env);
+
+    env = NULL;
+
+    string paths[3] = { dbfile, dbfile + "-lock" };
+    string localpath;
+
+    sidecar(paths + 2);
+
+    for (unsigned i = 0; i < sizeof paths / sizeof *paths; i++)
+    {
+        fsaccess->path2local(paths + i, &localpath);
+        fsaccess->unlinklocal(&localpath);
+    }
+}
+
+bool LmdbDbTable::sidecar(string* path)
+{
+    *path = dbfile + ".snapshot";
+    return true;
+}
+} // namespace
+
+#endif
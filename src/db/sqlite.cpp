@@ -23,6 +23,8 @@
 
 #ifdef USE_SQLITE
 namespace mega {
+const int SqliteDbAccess::SCHEMA_VERSION;
+
 SqliteDbAccess::SqliteDbAccess(string* path)
 {
     if (path)
@@ -93,22 +95,104 @@ DbTable* SqliteDbAccess::open(FileSystemAccess* fsaccess, string* name)
     sqlite3_exec(db, "PRAGMA journal_mode=WAL;", NULL, NULL, NULL);
 #endif
 
-    const char *sql = "CREATE TABLE IF NOT EXISTS statecache (id INTEGER PRIMARY KEY ASC NOT NULL, content BLOB NOT NULL)";
+    const char *sql = "CREATE TABLE IF NOT EXISTS statecache (id INTEGER PRIMARY KEY ASC NOT NULL, content BLOB NOT NULL, "
+                      "nodehandle BLOB, parenthandle BLOB, type INTEGER, fingerprint BLOB)";
 
     rc = sqlite3_exec(db, sql, NULL, NULL, NULL);
 
     if (rc)
     {
+        sqlite3_close(db);
         return NULL;
     }
 
-    return new SqliteDbTable(db, fsaccess, &dbfile);
+    bool reindex = false;
+
+    if (schemaversion(db) < SCHEMA_VERSION)
+    {
+        // tables created without the lookup columns get them added (this
+        // fails harmlessly on new tables) and their records rewritten
+        static const char* upgrade[] = {
+            "ALTER TABLE statecache ADD COLUMN nodehandle BLOB",
+            "ALTER TABLE statecache ADD COLUMN parenthandle BLOB",
+            "ALTER TABLE statecache ADD COLUMN type INTEGER",
+            "ALTER TABLE statecache ADD COLUMN fingerprint BLOB"
+        };
+
+        for (unsigned i = 0; i < sizeof upgrade / sizeof *upgrade; i++)
+        {
+            sqlite3_exec(db, upgrade[i], NULL, NULL, NULL);
+        }
+
+        if (sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecache_nodehandle ON statecache (nodehandle)", NULL, NULL, NULL)
+         || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecache_parenthandle ON statecache (parenthandle)", NULL, NULL, NULL)
+         || sqlite3_exec(db, "CREATE INDEX IF NOT EXISTS statecache_fingerprint ON statecache (fingerprint)", NULL, NULL, NULL))
+        {
+            LOG_err << "Unable to create the statecache indexes " << dbfile;
+            sqlite3_close(db);
+            return NULL;
+        }
+
+        reindex = !isempty(db);
+
+        ostringstream version;
+        version << "PRAGMA user_version = " << SCHEMA_VERSION;
+        sqlite3_exec(db, version.str().c_str(), NULL, NULL, NULL);
+
+        LOG_info << "Statecache schema upgraded to version " << SCHEMA_VERSION << (reindex ? " (reindexing)" : "");
+    }
+
+    SqliteDbTable* table = new SqliteDbTable(db, fsaccess, &dbfile);
+
+    table->reindex = reindex;
+
+    return table;
+}
+
+int SqliteDbAccess::schemaversion(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    int version = 0;
+
+    if (sqlite3_prepare_v2(db, "PRAGMA user_version", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            version = sqlite3_column_int(stmt, 0);
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    return version;
+}
+
+bool SqliteDbAccess::isempty(sqlite3* db)
+{
+    sqlite3_stmt* stmt;
+    bool empty = true;
+
+    if (sqlite3_prepare_v2(db, "SELECT 1 FROM statecache LIMIT 1", -1, &stmt, NULL) == SQLITE_OK)
+    {
+        empty = sqlite3_step(stmt) != SQLITE_ROW;
+    }
+
+    sqlite3_finalize(stmt);
+
+    return empty;
 }
 
 SqliteDbTable::SqliteDbTable(sqlite3* cdb, FileSystemAccess *fs, string *filepath)
 {
     db = cdb;
     pStmt = NULL;
+    getStmt = NULL;
+    putStmt = NULL;
+    putBatchStmt = NULL;
+    delStmt = NULL;
+    delBatchStmt = NULL;
+    memset(lookupStmt, 0, sizeof lookupStmt);
+    iterating = false;
     fsaccess = fs;
     dbfile = *filepath;
 }
@@ -120,31 +204,54 @@ SqliteDbTable::~SqliteDbTable()
         return;
     }
 
-    if (pStmt)
-    {
-        sqlite3_finalize(pStmt);
-    }
+    finalize();
     abort();
     sqlite3_close(db);
     LOG_debug << "Database closed " << dbfile;
 }
 
-// set cursor to first record
-void SqliteDbTable::rewind()
+bool SqliteDbTable::prepare(sqlite3_stmt** stmt, const char* sql)
 {
-    if (!db)
+    if (*stmt)
     {
-        return;
+        sqlite3_reset(*stmt);
+        return true;
     }
 
-    if (pStmt)
+    if (sqlite3_prepare_v2(db, sql, -1, stmt, NULL) != SQLITE_OK)
     {
-        sqlite3_reset(pStmt);
+        sqlite3_finalize(*stmt);
+        *stmt = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void SqliteDbTable::finalize()
+{
+    sqlite3_stmt** stmts[] = { &pStmt, &getStmt, &putStmt, &putBatchStmt, &delStmt, &delBatchStmt,
+                               lookupStmt, lookupStmt + 1, lookupStmt + 2 };
+
+    for (unsigned i = 0; i < sizeof stmts / sizeof *stmts; i++)
+    {
+        if (*stmts[i])
+        {
+            sqlite3_finalize(*stmts[i]);
+            *stmts[i] = NULL;
+        }
     }
-    else
+}
+
+// set cursor to first record
+void SqliteDbTable::rewind()
+{
+    if (!db)
     {
-        sqlite3_prepare(db, "SELECT id, content FROM statecache", -1, &pStmt, NULL);
+        return;
     }
+
+    iterating = prepare(&pStmt, "SELECT id, content FROM statecache");
 }
 
 // retrieve next record through cursor
@@ -155,7 +262,7 @@ bool SqliteDbTable::next(uint32_t* index, string* data)
         return false;
     }
 
-    if (!pStmt)
+    if (!iterating)
     {
         return false;
     }
@@ -164,8 +271,8 @@ bool SqliteDbTable::next(uint32_t* index, string* data)
 
     if (rc != SQLITE_ROW)
     {
-        sqlite3_finalize(pStmt);
-        pStmt = NULL;
+        sqlite3_reset(pStmt);
+        iterating = false;
         return false;
     }
 
@@ -184,55 +291,154 @@ bool SqliteDbTable::get(uint32_t index, string* data)
         return false;
     }
 
-    sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "SELECT content FROM statecache WHERE id = ?", -1, &stmt, NULL) == SQLITE_OK)
+    if (prepare(&getStmt, "SELECT content FROM statecache WHERE id = ?"))
     {
-        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        if (sqlite3_bind_int(getStmt, 1, index) == SQLITE_OK)
         {
-            if (sqlite3_step(stmt) == SQLITE_ROW)
+            if (sqlite3_step(getStmt) == SQLITE_ROW)
             {
-                data->assign((char*)sqlite3_column_blob(stmt, 0), sqlite3_column_bytes(stmt, 0));
+                data->assign((char*)sqlite3_column_blob(getStmt, 0), sqlite3_column_bytes(getStmt, 0));
 
                 result = true;
             }
         }
+
+        sqlite3_reset(getStmt);
     }
 
-    sqlite3_finalize(stmt);
     return result;
 }
 
+bool SqliteDbTable::bindcolumns(sqlite3_stmt* stmt, int first, const DbIndex* columns)
+{
+    if (!columns || !columns->set)
+    {
+        return sqlite3_bind_null(stmt, first) == SQLITE_OK
+            && sqlite3_bind_null(stmt, first + 1) == SQLITE_OK
+            && sqlite3_bind_null(stmt, first + 2) == SQLITE_OK
+            && sqlite3_bind_null(stmt, first + 3) == SQLITE_OK;
+    }
+
+    return sqlite3_bind_blob(stmt, first, columns->nodehandle.data(), columns->nodehandle.size(), SQLITE_STATIC) == SQLITE_OK
+        && sqlite3_bind_blob(stmt, first + 1, columns->parenthandle.data(), columns->parenthandle.size(), SQLITE_STATIC) == SQLITE_OK
+        && sqlite3_bind_int(stmt, first + 2, columns->type) == SQLITE_OK
+        && (columns->fingerprint.size()
+            ? sqlite3_bind_blob(stmt, first + 3, columns->fingerprint.data(), columns->fingerprint.size(), SQLITE_STATIC)
+            : sqlite3_bind_null(stmt, first + 3)) == SQLITE_OK;
+}
+
 // add/update record by index
 bool SqliteDbTable::put(uint32_t index, char* data, unsigned len)
+{
+    return put(index, data, len, NULL);
+}
+
+// add/update record and its lookup columns by index
+bool SqliteDbTable::put(uint32_t index, char* data, unsigned len, const DbIndex* columns)
 {
     if (!db)
     {
         return false;
     }
 
-    sqlite3_stmt *stmt;
     bool result = false;
 
-    if (sqlite3_prepare(db, "INSERT OR REPLACE INTO statecache (id, content) VALUES (?, ?)", -1, &stmt, NULL) == SQLITE_OK)
+    if (prepare(&putStmt, "INSERT OR REPLACE INTO statecache (id, content, nodehandle, parenthandle, type, fingerprint) "
+                          "VALUES (?, ?, ?, ?, ?, ?)"))
+    {
+        result = sqlite3_bind_int(putStmt, 1, index) == SQLITE_OK
+              && sqlite3_bind_blob(putStmt, 2, data, len, SQLITE_STATIC) == SQLITE_OK
+              && bindcolumns(putStmt, 3, columns)
+              && sqlite3_step(putStmt) == SQLITE_DONE;
+
+        sqlite3_reset(putStmt);
+    }
+
+    return result;
+}
+
+// add/update full batches with a single multi-row statement, the rest one
+// by one
+bool SqliteDbTable::putbatch(unsigned count, const uint32_t* index, const string* data, const DbIndex* columns)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    if (count != PUTBATCH)
     {
-        if (sqlite3_bind_int(stmt, 1, index) == SQLITE_OK)
+        return DbTable::putbatch(count, index, data, columns);
+    }
+
+    if (!putBatchStmt)
+    {
+        string sql = "INSERT OR REPLACE INTO statecache (id, content, nodehandle, parenthandle, type, fingerprint) "
+                     "VALUES (?, ?, ?, ?, ?, ?)";
+
+        for (unsigned i = 1; i < PUTBATCH; i++)
         {
-            if (sqlite3_bind_blob(stmt, 2, data, len, SQLITE_STATIC) == SQLITE_OK)
-            {
-                if (sqlite3_step(stmt) == SQLITE_DONE)
-                {
-                    result = true;
-                }
-            }
+            sql.append(", (?, ?, ?, ?, ?, ?)");
+        }
+
+        if (!prepare(&putBatchStmt, sql.c_str()))
+        {
+            return DbTable::putbatch(count, index, data, columns);
         }
     }
 
-    sqlite3_finalize(stmt);
+    bool result = true;
+
+    for (unsigned i = 0; result && i < count; i++)
+    {
+        result = sqlite3_bind_int(putBatchStmt, 6 * i + 1, index[i]) == SQLITE_OK
+              && sqlite3_bind_blob(putBatchStmt, 6 * i + 2, data[i].data(), data[i].size(), SQLITE_STATIC) == SQLITE_OK
+              && bindcolumns(putBatchStmt, 6 * i + 3, columns + i);
+    }
+
+    result = result && sqlite3_step(putBatchStmt) == SQLITE_DONE;
+
+    sqlite3_reset(putBatchStmt);
+
     return result;
 }
 
+// ids of the records with a matching lookup column
+bool SqliteDbTable::lookup(int column, const string* value, vector<uint32_t>* ids)
+{
+    static const char* sql[] = {
+        "SELECT id FROM statecache WHERE nodehandle = ?",
+        "SELECT id FROM statecache WHERE parenthandle = ?",
+        "SELECT id FROM statecache WHERE fingerprint = ?"
+    };
+
+    if (!db || column < COLUMN_NODEHANDLE || column > COLUMN_FINGERPRINT)
+    {
+        return false;
+    }
+
+    sqlite3_stmt** stmt = lookupStmt + column;
+
+    if (!prepare(stmt, sql[column])
+     || sqlite3_bind_blob(*stmt, 1, value->data(), value->size(), SQLITE_STATIC) != SQLITE_OK)
+    {
+        return false;
+    }
+
+    int rc;
+
+    while ((rc = sqlite3_step(*stmt)) == SQLITE_ROW)
+    {
+        ids->push_back(sqlite3_column_int(*stmt, 0));
+    }
+
+    sqlite3_reset(*stmt);
+
+    return rc == SQLITE_DONE;
+}
+
 // delete record by index
 bool SqliteDbTable::del(uint32_t index)
 {
@@ -241,11 +447,59 @@ bool SqliteDbTable::del(uint32_t index)
         return false;
     }
 
-    char buf[64];
+    bool result = false;
+
+    if (prepare(&delStmt, "DELETE FROM statecache WHERE id = ?"))
+    {
+        result = sqlite3_bind_int(delStmt, 1, index) == SQLITE_OK
+              && sqlite3_step(delStmt) == SQLITE_DONE;
+
+        sqlite3_reset(delStmt);
+    }
+
+    return result;
+}
+
+// delete full batches with a single statement, the rest one by one
+bool SqliteDbTable::delbatch(unsigned count, const uint32_t* index)
+{
+    if (!db)
+    {
+        return false;
+    }
+
+    if (!delBatchStmt)
+    {
+        string sql = "DELETE FROM statecache WHERE id IN (?";
+
+        for (unsigned i = 1; i < DELBATCH; i++)
+        {
+            sql.append(", ?");
+        }
+
+        sql.append(")");
+
+        if (!prepare(&delBatchStmt, sql.c_str()))
+        {
+            return DbTable::delbatch(count, index);
+        }
+    }
+
+    bool result = true;
+
+    for (; result && count >= DELBATCH; count -= DELBATCH, index += DELBATCH)
+    {
+        for (unsigned i = 0; result && i < DELBATCH; i++)
+        {
+            result = sqlite3_bind_int(delBatchStmt, i + 1, index[i]) == SQLITE_OK;
+        }
+
+        result = result && sqlite3_step(delBatchStmt) == SQLITE_DONE;
 
-    sprintf(buf, "DELETE FROM statecache WHERE id = %" PRIu32, index);
+        sqlite3_reset(delBatchStmt);
+    }
 
-    return !sqlite3_exec(db, buf, 0, 0, NULL);
+    return result && DbTable::delbatch(count, index);
 }
 
 // truncate table
@@ -302,10 +556,7 @@ void SqliteDbTable::remove()
         return;
     }
 
-    if (pStmt)
-    {
-        sqlite3_finalize(pStmt);
-    }
+    finalize();
     abort();
     sqlite3_close(db);
 
@@ -314,6 +565,17 @@ void SqliteDbTable::remove()
     string localpath;
     fsaccess->path2local(&dbfile, &localpath);
     fsaccess->unlinklocal(&localpath);
+
+    string path;
+    sidecar(&path);
+    fsaccess->path2local(&path, &localpath);
+    fsaccess->unlinklocal(&localpath);
+}
+
+bool SqliteDbTable::sidecar(string* path)
+{
+    *path = dbfile + ".snapshot";
+    return true;
 }
 } // namespace
 
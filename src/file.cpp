@@ -34,6 +34,7 @@ File::File()
     hprivate = true;
     syncxfer = false;
     h = UNDEF;
+    sink = NULL;
 }
 
 File::~File()
@@ -121,7 +122,14 @@ void File::completed(Transfer* t, LocalNode* l)
             {
                 t->client->syncadding++;
             }
+            else
 #endif
+            if (t->client->batchuploadnodes)
+            {
+                t->client->queueuploadnode(th, newnode, t->tag);
+                return;
+            }
+
             t->client->reqs.add(new CommandPutNodes(t->client,
                                                                   th, NULL,
                                                                   newnode, 1,
@@ -308,6 +316,12 @@ void SyncFileGet::completed(Transfer* t, LocalNode* n)
 
 void SyncFileGet::terminated()
 {
+    // have syncdown() reconsider the download
+    if (n->parent && n->parent->localnode)
+    {
+        n->parent->localnode->setdirty(LocalNode::DIRTY_SYNCDOWN);
+    }
+
     delete this;
 }
 #endif
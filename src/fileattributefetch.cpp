@@ -26,12 +26,18 @@
 namespace mega {
 FileAttributeFetchChannel::FileAttributeFetchChannel()
 {
-    req.binary = true;
-    req.status = REQ_READY;
+    for (int i = MAXREQS; i--; )
+    {
+        req[i].binary = true;
+        req[i].status = REQ_READY;
+        inbytes[i] = 0;
+        e[i] = API_EINTERNAL;
+    }
+
     urltime = 0;
+    urlpending = false;
     fahref = UNDEF;
-    inbytes = 0;
-    e = API_EINTERNAL;
+    seq = 0;
 }
 
 FileAttributeFetch::FileAttributeFetch(handle h, fatype t, int ctag)
@@ -40,53 +46,69 @@ FileAttributeFetch::FileAttributeFetch(handle h, fatype t, int ctag)
     type = t;
     retries = 0;
     tag = ctag;
+    slot = -1;
+    seq = 0;
+}
+
+static bool fafmoreurgent(const pair<unsigned, handle>& a, const pair<unsigned, handle>& b)
+{
+    return a.first > b.first;
 }
 
 void FileAttributeFetchChannel::dispatch(MegaClient* client)
 {
-    faf_map::iterator it;
- 
-    // reserve space
-    req.outbuf.clear();
-    req.outbuf.reserve((fafs[0].size() + fafs[1].size()) * sizeof(handle));
+    if (!fafs[0].size())
+    {
+        return;
+    }
+
+    // order fresh fetches by priority
+    vector<pair<unsigned, handle> > fresh;
+    fresh.reserve(fafs[0].size());
+
+    for (faf_map::iterator it = fafs[0].begin(); it != fafs[0].end(); it++)
+    {
+        fresh.push_back(pair<unsigned, handle>(it->second->seq, it->first));
+    }
+
+    std::sort(fresh.begin(), fresh.end(), fafmoreurgent);
 
-    for (int i = 2; i--; )
+    vector<pair<unsigned, handle> >::iterator fit = fresh.begin();
+
+    for (int i = 0; i < MAXREQS && fit != fresh.end(); i++)
     {
-        for (it = fafs[i].begin(); it != fafs[i].end(); )
+        if (req[i].status == REQ_INFLIGHT)
         {
-            req.outbuf.append((char*)&it->first, sizeof(handle));
+            continue;
+        }
 
-            if (!i)
-            {
-                // move from fresh to pending
-                fafs[1][it->first] = it->second;
-                fafs[0].erase(it++);
-            }
-            else
-            {
-                it++;
-            }
+        req[i].outbuf.clear();
+        req[i].outbuf.reserve(MAXBATCH * sizeof(handle));
+
+        for (unsigned n = 0; n < MAXBATCH && fit != fresh.end(); n++, fit++)
+        {
+            faf_map::iterator it = fafs[0].find(fit->second);
+
+            req[i].outbuf.append((char*)&it->first, sizeof(handle));
+
+            // move from fresh to pending
+            it->second->slot = i;
+            fafs[1][it->first] = it->second;
+            fafs[0].erase(it);
         }
-    }
 
-    if (req.outbuf.size())
-    {
-        e = API_EFAILED;
-        inbytes = 0;
-        req.in.clear();
-        req.posturl = posturl;
-        req.post(client);
+        e[i] = API_EFAILED;
+        inbytes[i] = 0;
+        req[i].in.clear();
+        req[i].posturl = posturl;
+        req[i].post(client);
 
-        timeout.backoff(150);
-    }
-    else
-    {
-        timeout.reset();
+        timeout[i].backoff(150);
     }
 }
 
 // communicate received file attributes to the application
-void FileAttributeFetchChannel::parse(MegaClient* client, int fac, bool final)
+void FileAttributeFetchChannel::parse(MegaClient* client, int slot, bool final)
 {
 #pragma pack(push,1)
     struct FaHeader
@@ -96,8 +118,9 @@ void FileAttributeFetchChannel::parse(MegaClient* client, int fac, bool final)
     };
 #pragma pack(pop)
 
-    const char* ptr = req.data();
-    const char* endptr = ptr + req.size();
+    HttpReq* r = req + slot;
+    const char* ptr = r->data();
+    const char* endptr = ptr + r->size();
     Node* n;
     SymmCipher* cipher;
     faf_map::iterator it;
@@ -117,7 +140,7 @@ void FileAttributeFetchChannel::parse(MegaClient* client, int fac, bool final)
             }
             else
             {
-                req.purge(ptr - req.data());
+                r->purge(ptr - r->data());
             }
 
             break;
@@ -139,6 +162,11 @@ void FileAttributeFetchChannel::parse(MegaClient* client, int fac, bool final)
                 {
                     if ((cipher = n->nodecipher()))
                     {
+                        if (client->facache)
+                        {
+                            client->facache->put(it->first, ptr, falen);
+                        }
+
                         cipher->cbc_decrypt((byte*)ptr, falen);
                         client->app->fa_complete(n, it->second->type, ptr, falen);
                     }
@@ -154,13 +182,19 @@ void FileAttributeFetchChannel::parse(MegaClient* client, int fac, bool final)
 }
 
 // notify the application of the request failure and remove records no longer needed
-void FileAttributeFetchChannel::failed(MegaClient* client)
+void FileAttributeFetchChannel::failed(MegaClient* client, int slot)
 {
     for (faf_map::iterator it = fafs[1].begin(); it != fafs[1].end(); )
     {
+        if (it->second->slot != slot)
+        {
+            it++;
+            continue;
+        }
+
         client->restag = it->second->tag;
 
-        if (client->app->fa_failed(it->second->nodehandle, it->second->type, it->second->retries, e))
+        if (client->app->fa_failed(it->second->nodehandle, it->second->type, it->second->retries, e[slot]))
         {
             // no retry desired
             delete it->second;
@@ -170,12 +204,283 @@ void FileAttributeFetchChannel::failed(MegaClient* client)
         {
             // retry
             it->second->retries++;
+            it->second->slot = -1;
 
             // move from pending to fresh
             fafs[0][it->first] = it->second;
             fafs[1].erase(it++);
-            req.status = REQ_PREPARED;
         }
     }
 }
+
+// the POST URL could not be obtained: fail or keep the fresh fetches
+void FileAttributeFetchChannel::urlfailed(MegaClient* client, error err)
+{
+    urlpending = false;
+
+    for (faf_map::iterator it = fafs[0].begin(); it != fafs[0].end(); )
+    {
+        client->restag = it->second->tag;
+
+        if (client->app->fa_failed(it->second->nodehandle, it->second->type, it->second->retries, err))
+        {
+            delete it->second;
+            fafs[0].erase(it++);
+        }
+        else
+        {
+            it->second->retries++;
+            it++;
+        }
+    }
+
+    bt.backoff();
+}
+
+bool FileAttributeFetchChannel::cancel(handle fah)
+{
+    faf_map::iterator it;
+
+    if ((it = fafs[0].find(fah)) != fafs[0].end())
+    {
+        delete it->second;
+        fafs[0].erase(it);
+        return true;
+    }
+
+    if ((it = fafs[1].find(fah)) != fafs[1].end())
+    {
+        int slot = it->second->slot;
+
+        delete it->second;
+        fafs[1].erase(it);
+
+        // none left on this request: tear it down to free the slot
+        if (req[slot].status == REQ_INFLIGHT && !pending(slot))
+        {
+            req[slot].disconnect();
+            req[slot].status = REQ_READY;
+            timeout[slot].reset();
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+unsigned FileAttributeFetchChannel::pending(int slot)
+{
+    unsigned n = 0;
+
+    for (faf_map::iterator it = fafs[1].begin(); it != fafs[1].end(); it++)
+    {
+        if (it->second->slot == slot)
+        {
+            n++;
+        }
+    }
+
+    return n;
+}
+
+bool FileAttributeFetchChannel::inflight()
+{
+    for (int i = MAXREQS; i--; )
+    {
+        if (req[i].status == REQ_INFLIGHT)
+        {
+            return true;
+        }
+    }
+
+    return urlpending;
+}
+
+bool FileAttributeFetchChannel::urgent()
+{
+    for (faf_map::iterator it = fafs[0].begin(); it != fafs[0].end(); it++)
+    {
+        if (it->second->seq)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+FileAttributeCache::FileAttributeCache(FileSystemAccess* fsa, string* dir, m_off_t size)
+{
+    fsaccess = fsa;
+    localdir = *dir;
+    budget = size;
+    total = 0;
+    loaded = false;
+}
+
+void FileAttributeCache::localname(handle fah, string* name)
+{
+    char buf[17];
+    string path;
+
+    sprintf(buf, "%016llx", (unsigned long long)fah);
+    path = buf;
+
+    fsaccess->path2local(&path, name);
+    name->insert(0, fsaccess->localseparator);
+    name->insert(0, localdir);
+}
+
+// list the stored attributes, oldest first
+void FileAttributeCache::load()
+{
+    loaded = true;
+
+    fsaccess->mkdirlocal(&localdir);
+
+    DirAccess* da = fsaccess->newdiraccess();
+    string dir = localdir;
+    string name, path, fullname;
+    multimap<m_time_t, pair<handle, m_off_t> > found;
+
+    if (da->dopen(&dir, NULL, false))
+    {
+        while (da->dnext(&dir, &name, false))
+        {
+            fsaccess->local2path(&name, &path);
+
+            if (path.size() != 16 || path.find_first_not_of("0123456789abcdef") != string::npos)
+            {
+                continue;
+            }
+
+            handle fah = (handle)strtoull(path.c_str(), NULL, 16);
+
+            localname(fah, &fullname);
+
+            FileAccess* fa = fsaccess->newfileaccess();
+
+            if (fa->fopen(&fullname, true, false))
+            {
+                found.insert(pair<m_time_t, pair<handle, m_off_t> >(fa->mtime, pair<handle, m_off_t>(fah, fa->size)));
+            }
+
+            delete fa;
+        }
+    }
+
+    delete da;
+
+    for (multimap<m_time_t, pair<handle, m_off_t> >::iterator it = found.begin(); it != found.end(); it++)
+    {
+        Entry* e = &entries[it->second.first];
+
+        e->size = it->second.second;
+        e->lru = lru.insert(lru.end(), it->second.first);
+        total += e->size;
+    }
+
+    evict();
+}
+
+void FileAttributeCache::evict()
+{
+    string name;
+
+    while (total > budget && lru.size())
+    {
+        handle fah = lru.front();
+        map<handle, Entry>::iterator it = entries.find(fah);
+
+        localname(fah, &name);
+        fsaccess->unlinklocal(&name);
+
+        total -= it->second.size;
+        entries.erase(it);
+        lru.pop_front();
+    }
+}
+
+bool FileAttributeCache::get(handle fah, string* data)
+{
+    if (!loaded)
+    {
+        load();
+    }
+
+    map<handle, Entry>::iterator it = entries.find(fah);
+
+    if (it == entries.end())
+    {
+        return false;
+    }
+
+    string name;
+    localname(fah, &name);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool ok = fa->fopen(&name, true, false) && fa->size == it->second.size;
+
+    if (ok)
+    {
+        data->resize(fa->size);
+        ok = fa->frawread((byte*)data->data(), data->size(), 0);
+    }
+
+    delete fa;
+
+    if (!ok)
+    {
+        // gone or damaged
+        fsaccess->unlinklocal(&name);
+        total -= it->second.size;
+        lru.erase(it->second.lru);
+        entries.erase(it);
+        return false;
+    }
+
+    // most recently used (on disk as well)
+    lru.splice(lru.end(), lru, it->second.lru);
+    fsaccess->setmtimelocal(&name, time(NULL));
+
+    return true;
+}
+
+void FileAttributeCache::put(handle fah, const char* data, unsigned len)
+{
+    if (!loaded)
+    {
+        load();
+    }
+
+    if (len > budget || entries.count(fah))
+    {
+        return;
+    }
+
+    string name;
+    localname(fah, &name);
+
+    fsaccess->unlinklocal(&name);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool ok = fa->fopen(&name, false, true) && fa->fwrite((const byte*)data, len, 0);
+
+    delete fa;
+
+    if (!ok)
+    {
+        fsaccess->unlinklocal(&name);
+        return;
+    }
+
+    Entry* e = &entries[fah];
+
+    e->size = len;
+    e->lru = lru.insert(lru.end(), fah);
+    total += len;
+
+    evict();
+}
 } // namespace
@@ -23,6 +23,7 @@
 #include "mega/filesystem.h"
 #include "mega/node.h"
 #include "mega/megaclient.h"
+#include "mega/sync.h"
 
 namespace mega {
 void FileSystemAccess::captimestamp(m_time_t* t)
@@ -37,33 +38,67 @@ bool FileSystemAccess::islchex(char c) const
     return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
 }
 
+// bitmap of the bytes not allowed in local fs names: control characters
+// and \/:?"<>|*
+static const uint32_t fsincompatible[8] = {
+    0xffffffff,
+    (1u << ('"' - 32)) | (1u << ('*' - 32)) | (1u << ('/' - 32)) | (1u << (':' - 32))
+        | (1u << ('<' - 32)) | (1u << ('>' - 32)) | (1u << ('?' - 32)),
+    1u << ('\\' - 64),
+    1u << ('|' - 96),
+    0, 0, 0, 0
+};
+
 // is c allowed in local fs names?
 bool FileSystemAccess::islocalfscompatible(unsigned char c) const
 {
-    return c >= ' ' && !strchr("\\/:?\"<>|*", c);
+    return !((fsincompatible[c >> 5] >> (c & 31)) & 1);
 }
 
 // replace characters that are not allowed in local fs names with a %xx escape sequence
 void FileSystemAccess::escapefsincompatible(string* name) const
 {
+    size_t i, len = name->size();
+
+    // most names need no escaping
+    for (i = 0; i < len && islocalfscompatible((unsigned char)(*name)[i]); i++);
+
+    if (i == len)
+    {
+        return;
+    }
+
+    string t(*name, 0, i);
     char buf[4];
-    unsigned char c;
+
+    t.reserve(len + 8);
 
     // replace all occurrences of a badchar with %xx
-    for (int i = name->size(); i--; )
+    for (; i < len; i++)
     {
-        c = (unsigned char)(*name)[i];
+        unsigned char c = (unsigned char)(*name)[i];
 
-        if (!islocalfscompatible(c))
+        if (islocalfscompatible(c))
+        {
+            t.append(1, (char)c);
+        }
+        else
         {
             sprintf(buf, "%%%02x", c);
-            name->replace(i, 1, buf);
+            t.append(buf, 3);
         }
     }
+
+    name->swap(t);
 }
 
 void FileSystemAccess::unescapefsincompatible(string* name) const
 {
+    if (name->find('%') == string::npos)
+    {
+        return;
+    }
+
     for (int i = name->size() - 2; i-- > 0; )
     {
         // conditions for unescaping: %xx must be well-formed and encode an incompatible character
@@ -89,10 +124,67 @@ void FileSystemAccess::name2local(string* filename) const
     path2local(&t, filename);
 }
 
+// is the string known to be unaffected by NFC? true for ASCII and for code
+// points without decompositions that can neither combine with nor reorder
+// against their neighbours (Hangul jamo compose algorithmically) - invalid
+// UTF-8 is left to utf8proc
+static bool isnfc(const char* s, size_t len)
+{
+    const char* end = s + len;
+
+    // ASCII eight bytes at a time
+    for (; s + sizeof(uint64_t) <= end; s += sizeof(uint64_t))
+    {
+        uint64_t w;
+
+        memcpy(&w, s, sizeof w);
+
+        if (w & 0x8080808080808080ULL)
+        {
+            break;
+        }
+    }
+
+    while (s < end)
+    {
+        if (!(*s & 0x80))
+        {
+            s++;
+            continue;
+        }
+
+        int32_t uc;
+        ssize_t l = utf8proc_iterate((const uint8_t*)s, end - s, &uc);
+
+        if (l <= 0)
+        {
+            return false;
+        }
+
+        const utf8proc_property_t* p = utf8proc_get_property(uc);
+
+        if (p->decomp_mapping || p->combining_class || p->comb2nd_index >= 0
+         || (uc >= 0x1100 && uc < 0x1200))
+        {
+            return false;
+        }
+
+        s += l;
+    }
+
+    return true;
+}
+
 void FileSystemAccess::normalize(string* filename) const
 {
     if (!filename) return;
 
+    // almost all names are ASCII or already normalized
+    if (isnfc(filename->data(), filename->size()))
+    {
+        return;
+    }
+
     const char* cfilename = filename->c_str();
     size_t fnsize = filename->size();
     string result;
@@ -143,15 +235,135 @@ DirNotify::DirNotify(string* clocalbasepath, string* cignore)
 
     failed = true;
     error = false;
+
+    notifications = 0;
+    coalesced = 0;
+    collapsed = 0;
+    popped = 0;
 }
 
 // notify base LocalNode + relative path/filename
 void DirNotify::notify(notifyqueue q, LocalNode* l, const char* localpath, size_t len, bool immediate)
 {
+#ifdef ENABLE_SYNC
+    string key;
+
+    if (q == DIREVENTS)
+    {
+        notifications++;
+
+        // full path, as checkpath() constructs it
+        if (l && l != (LocalNode*)~0)
+        {
+            l->getlocalpath(&key);
+
+            if (len)
+            {
+                key.append(l->sync->client->fsaccess->localseparator);
+            }
+        }
+
+        key.append(localpath, len);
+
+        if (queueditem(&key))
+        {
+            coalesced++;
+            return;
+        }
+
+        if (!immediate && l && l != (LocalNode*)~0 && queued.size())
+        {
+            Sync* sync = l->sync;
+            const string& separator = sync->client->fsaccess->localseparator;
+            size_t rootlen = sync->localroot.localname.size();
+            size_t pos = key.size();
+            Notification* n;
+
+            while (pos > rootlen + separator.size()
+                && (pos = key.rfind(separator, pos - 1)) != string::npos
+                && pos > rootlen)
+            {
+                if (pos % separator.size())
+                {
+                    continue;
+                }
+
+                string parentkey(key, 0, pos);
+
+                if ((n = queueditem(&parentkey)) && !sync->localnodebypath(n->localnode, &n->path))
+                {
+                    collapsed++;
+                    return;
+                }
+            }
+        }
+    }
+#endif
+
     notifyq[q].resize(notifyq[q].size() + 1);
     notifyq[q].back().timestamp = immediate ? 0 : Waiter::ds;
     notifyq[q].back().localnode = l;
     notifyq[q].back().path.assign(localpath, len);
+
+#ifdef ENABLE_SYNC
+    if (q == DIREVENTS)
+    {
+        queued[key] = popped + notifyq[q].size() - 1;
+    }
+#endif
+}
+
+// queued and active DIREVENTS item for the path, if any
+Notification* DirNotify::queueditem(const string* key)
+{
+    map<string, uint64_t>::iterator it = queued.find(*key);
+
+    if (it == queued.end())
+    {
+        return NULL;
+    }
+
+    if (it->second < popped)
+    {
+        // processed in the meantime
+        queued.erase(it);
+        return NULL;
+    }
+
+    Notification* n = &notifyq[DIREVENTS][it->second - popped];
+
+    // deactivated because its base LocalNode went away
+    return n->localnode == (LocalNode*)~0 ? NULL : n;
+}
+
+void DirNotify::pop(notifyqueue q)
+{
+    notifyq[q].pop_front();
+
+    if (q == DIREVENTS)
+    {
+        popped++;
+
+        // drop the entries of processed items (if not looked up again)
+        if (!notifyq[q].size())
+        {
+            queued.clear();
+        }
+        else if (queued.size() > 2 * notifyq[q].size() + 1024)
+        {
+            for (map<string, uint64_t>::iterator it = queued.begin(); it != queued.end(); )
+            {
+                if (it->second < popped)
+                {
+                    queued.erase(it++);
+                }
+                else
+                {
+                    it++;
+                }
+            }
+        }
+    }
 }
 
 // default: no fingerprint
@@ -235,4 +447,50 @@ bool FileAccess::frawread(byte* dst, unsigned len, m_off_t pos)
 
     return r;
 }
+
+bool FileAccess::frawread(byte* dst, unsigned len, const m_off_t* pos, unsigned n)
+{
+    if (!openf())
+    {
+        return false;
+    }
+
+    bool r = true;
+    string span;
+
+    for (unsigned i = 0; r && i < n; )
+    {
+        unsigned j = i + 1;
+
+        while (j < n && pos[j] >= pos[j - 1]
+               && pos[j] - pos[j - 1] - len <= MAXREADGAP
+               && pos[j] + len - pos[i] <= MAXREADSPAN)
+        {
+            j++;
+        }
+
+        if (j == i + 1)
+        {
+            r = sysread(dst + i * len, len, pos[i]);
+        }
+        else
+        {
+            span.resize((size_t)(pos[j - 1] + len - pos[i]));
+
+            if ((r = sysread((byte*)span.data(), (unsigned)span.size(), pos[i])))
+            {
+                for (unsigned k = i; k < j; k++)
+                {
+                    memcpy(dst + k * len, span.data() + (pos[k] - pos[i]), len);
+                }
+            }
+        }
+
+        i = j;
+    }
+
+    closef();
+
+    return r;
+}
 } // namespace
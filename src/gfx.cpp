@@ -28,6 +28,8 @@ const int GfxProc::dimensions[][2] = {
     { 1000, 1000 }  // PREVIEW1000x1000: scaled version inside 1000x1000 bounding square
 };
 
+const m_off_t GfxProc::MAXBITMAPBYTES = 128 * 1048576;
+
 bool GfxProc::isgfx(string* localfilename)
 {
     char ext[8];
@@ -100,21 +102,63 @@ void GfxProc::transform(int& w, int& h, int& rw, int& rh, int& px, int& py)
     }
 }
 
+// the bitmap only needs to be decoded at the size of the largest dimension
+// requested - a backend may decode smaller images straight away
+int GfxProc::decodesize(int missing)
+{
+    int size = 0;
+
+    for (int i = sizeof dimensions/sizeof dimensions[0]; i--; )
+    {
+        if (missing & (1 << i) && dimensions[i][0] > size)
+        {
+            size = dimensions[i][0];
+        }
+    }
+
+    return size;
+}
+
 // load bitmap image, generate all designated sizes, attach to specified upload/node handle
-// FIXME: move to a worker thread to keep the engine nonblocking
+// (on the workers, if started)
 int GfxProc::gendimensionsputfa(FileAccess* fa, string* localfilename, handle th, SymmCipher* key, int missing)
 {
     int numputs = 0;
 
-    if (SimpleLogger::logCurrentLevel >= logDebug)
+    if (LOG_enabled(logDebug))
     {
         string utf8path;
         client->fsaccess->local2path(localfilename, &utf8path);
         LOG_debug << "Creating thumb/preview for " << utf8path;
     }
 
-    // (this assumes that the width of the largest dimension is max)
-    if (readbitmap(fa, localfilename, dimensions[sizeof dimensions/sizeof dimensions[0]-1][0]))
+    if (workers.size())
+    {
+        GfxJob* job = new GfxJob;
+
+        job->localfilename = *localfilename;
+        job->th = th;
+        memcpy(job->key, key->key, sizeof job->key);
+        job->missing = missing;
+
+        for (int i = sizeof dimensions/sizeof dimensions[0]; i--; )
+        {
+            if (missing & (1 << i))
+            {
+                numputs++;
+            }
+        }
+
+        jobmutex->lock();
+        jobs.push_back(job);
+        jobmutex->unlock();
+
+        jobsready->release();
+
+        return numputs;
+    }
+
+    if (readbitmap(fa, localfilename, decodesize(missing)))
     {
         string* jpeg = NULL;
 
@@ -155,8 +199,7 @@ int GfxProc::gendimensionsputfa(FileAccess* fa, string* localfilename, handle th
 bool GfxProc::savefa(string *localfilepath, GfxProc::meta_t type, string *localdstpath)
 {
     if (!isgfx(localfilepath)
-            // (this assumes that the width of the largest dimension is max)
-            || !readbitmap(NULL, localfilepath, dimensions[sizeof dimensions/sizeof dimensions[0]-1][0]))
+            || !readbitmap(NULL, localfilepath, decodesize(1 << type)))
     {
         return false;
     }
@@ -188,8 +231,188 @@ bool GfxProc::savefa(string *localfilepath, GfxProc::meta_t type, string *locald
     return true;
 }
 
+void GfxProc::process(GfxJob* job)
+{
+    job->images.resize(sizeof dimensions/sizeof dimensions[0]);
+
+    if (readbitmap(NULL, &job->localfilename, decodesize(job->missing)))
+    {
+        string* jpeg = NULL;
+
+        // successively downscale the original image
+        for (int i = sizeof dimensions/sizeof dimensions[0]; i--; )
+        {
+            if (!jpeg)
+            {
+                jpeg = new string;
+            }
+
+            if (job->missing & (1 << i) && resizebitmap(dimensions[i][0], dimensions[i][1], jpeg))
+            {
+                job->images[i] = jpeg;
+                jpeg = NULL;
+            }
+        }
+
+        delete jpeg;
+
+        freebitmap();
+    }
+}
+
+void GfxProc::startworkers(unsigned n, GfxProc** procs, Thread** threads, Mutex* mutex, Semaphore* ready)
+{
+    jobmutex = mutex;
+    jobsready = ready;
+
+    jobmutex->init(false);
+    jobsready->init(0);
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        procs[i]->client = client;
+        procs[i]->pool = this;
+        workerprocs.push_back(procs[i]);
+        workers.push_back(threads[i]);
+        threads[i]->start(workerentry, procs[i]);
+    }
+}
+
+void* GfxProc::workerentry(void* param)
+{
+    ((GfxProc*)param)->work();
+    return NULL;
+}
+
+// runs on a worker's own GfxProc, taking jobs from the pool
+void GfxProc::work()
+{
+    for (;;)
+    {
+        pool->jobsready->wait();
+
+        pool->jobmutex->lock();
+
+        if (pool->stopping)
+        {
+            pool->jobmutex->unlock();
+            break;
+        }
+
+        GfxJob* job = pool->jobs.front();
+        pool->jobs.pop_front();
+        pool->jobmutex->unlock();
+
+        process(job);
+
+        pool->jobmutex->lock();
+        pool->results.push_back(job);
+        pool->jobmutex->unlock();
+
+        pool->client->waiter->notify();
+    }
+}
+
+void GfxProc::checkjobs()
+{
+    if (!workers.size())
+    {
+        return;
+    }
+
+    deque<GfxJob*> done;
+
+    jobmutex->lock();
+    done.swap(results);
+    jobmutex->unlock();
+
+    while (done.size())
+    {
+        GfxJob* job = done.front();
+        done.pop_front();
+
+        SymmCipher key;
+        key.setkey(job->key);
+
+        int failed = 0;
+
+        for (int i = job->images.size(); i--; )
+        {
+            if (job->images[i])
+            {
+                // store the file attribute data - it will be attached to the file
+                // immediately if the upload has already completed; otherwise, once
+                // the upload completes
+                int creqtag = client->reqtag;
+                client->reqtag = 0;
+                client->putfa(job->th, (meta_t)i, &key, job->images[i]);
+                client->reqtag = creqtag;
+            }
+            else if (job->missing & (1 << i))
+            {
+                failed++;
+            }
+        }
+
+        if (failed)
+        {
+            LOG_warn << "Unable to create " << failed << " thumb/preview(s) for " << job->th;
+            client->dropfa(job->th, failed);
+        }
+
+        delete job;
+    }
+}
+
 GfxProc::GfxProc()
 {
     client = NULL;
+    pool = NULL;
+    jobmutex = NULL;
+    jobsready = NULL;
+    stopping = false;
+}
+
+// unfinished jobs are discarded
+GfxProc::~GfxProc()
+{
+    if (!workers.size())
+    {
+        return;
+    }
+
+    jobmutex->lock();
+    stopping = true;
+    jobmutex->unlock();
+
+    for (unsigned i = workers.size(); i--; )
+    {
+        jobsready->release();
+    }
+
+    for (unsigned i = 0; i < workers.size(); i++)
+    {
+        workers[i]->join();
+        delete workers[i];
+        delete workerprocs[i];
+    }
+
+    for (deque<GfxJob*>::iterator it = jobs.begin(); it != jobs.end(); it++)
+    {
+        delete *it;
+    }
+
+    for (deque<GfxJob*>::iterator it = results.begin(); it != results.end(); it++)
+    {
+        for (unsigned i = 0; i < (*it)->images.size(); i++)
+        {
+            delete (*it)->images[i];
+        }
+
+        delete *it;
+    }
+
+    delete jobmutex;
+    delete jobsready;
 }
 } // namespace
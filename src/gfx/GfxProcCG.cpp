@@ -17,6 +17,7 @@ using namespace mega;
 GfxProcCG::GfxProcCG()
     : GfxProc()
     , imageSource(NULL)
+    , derived(NULL)
     , w(0)
     , h(0)
 {
@@ -110,6 +111,35 @@ static inline CGRect tileRect(size_t w, size_t h)
     return res;
 }
 
+CGImageRef GfxProcCG::squareFromImage(CGImageRef image, int rw) {
+    size_t iw = CGImageGetWidth(image);
+    size_t ih = CGImageGetHeight(image);
+    if (std::min(iw, ih) < (size_t)rw) { // would be upscaled
+        return NULL;
+    }
+
+    CGImageRef tile = CGImageCreateWithImageInRect(image, tileRect(iw, ih));
+    if (!tile) {
+        return NULL;
+    }
+
+    CGColorSpaceRef colorSpace = CGColorSpaceCreateDeviceRGB();
+    CGContextRef context = CGBitmapContextCreate(NULL, rw, rw, 8, 0, colorSpace, kCGImageAlphaNoneSkipLast);
+    CGColorSpaceRelease(colorSpace);
+    if (!context) {
+        CGImageRelease(tile);
+        return NULL;
+    }
+
+    CGContextSetInterpolationQuality(context, kCGInterpolationHigh);
+    CGContextDrawImage(context, CGRectMake(0, 0, rw, rw), tile);
+    CGImageRelease(tile);
+
+    CGImageRef result = CGBitmapContextCreateImage(context);
+    CGContextRelease(context);
+    return result;
+}
+
 int GfxProcCG::maxSizeForThumbnail(const int rw, const int rh) {
     if (rh) { // rectangular rw*rh bounding box
         return std::max(rw, rh);
@@ -125,13 +155,27 @@ bool GfxProcCG::resizebitmap(int rw, int rh, string* jpegout) {
 
     jpegout->clear();
 
-    CGImageRef image = createThumbnailWithMaxSize(maxSizeForThumbnail(rw, rh));
-    if (!rh) { // Make square image
-        CGImageRef newImage = CGImageCreateWithImageInRect(image, tileRect(CGImageGetWidth(image), CGImageGetHeight(image)));
-        if (image) {
-            CGImageRelease(image);
+    CGImageRef image = NULL;
+    if (!rh && derived) { // square image from the previous (larger) one
+        image = squareFromImage(derived, rw);
+    }
+    if (!image) {
+        image = createThumbnailWithMaxSize(maxSizeForThumbnail(rw, rh));
+        if (!rh) { // Make square image
+            CGImageRef newImage = CGImageCreateWithImageInRect(image, tileRect(CGImageGetWidth(image), CGImageGetHeight(image)));
+            if (image) {
+                CGImageRelease(image);
+            }
+            image = newImage;
+        } else if (image) { // keep it for the smaller dimensions
+            if (derived) {
+                CGImageRelease(derived);
+            }
+            derived = CGImageRetain(image);
         }
-        image = newImage;
+    }
+    if (!image) {
+        return false;
     }
     CFMutableDataRef data = CFDataCreateMutable(kCFAllocatorDefault, 0);
     if (!data) {
@@ -156,5 +200,9 @@ void GfxProcCG::freebitmap() {
         CFRelease(imageSource);
         imageSource = NULL;
     }
+    if (derived) {
+        CGImageRelease(derived);
+        derived = NULL;
+    }
     w = h = 0;
 }
@@ -59,6 +59,23 @@ const char* GfxProcFreeImage::supportedformats()
            ".xbm.xpm.jp2.j2k.jpf.jpx.";
 }
 
+// size of the decoded bitmap - JPEGs are decoded at the smallest scale of
+// 1/1 to 1/8 that keeps the longer side at or above the size hint
+static m_off_t decodedbytes(int w, int h, int bpp, int size)
+{
+    int n = 1;
+
+    if (size > 0)
+    {
+        while (n < 8 && std::max(w, h) / (n * 2) >= size)
+        {
+            n *= 2;
+        }
+    }
+
+    return (m_off_t)(w / n) * (h / n) * ((bpp + 7) / 8);
+}
+
 bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
 {
 #ifdef _WIN32
@@ -76,6 +93,32 @@ bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
         return false;
     }
 
+#ifdef FIF_LOAD_NOPIXELS
+    // refuse images too large to decode within the budget, reading only the
+    // header (RAW formats are decoded from their embedded preview)
+    if (fif != FIF_RAW && FreeImage_FIFSupportsNoPixels(fif))
+    {
+        FIBITMAP* hdib = FreeImage_LoadX(fif, (freeimage_filename_char_t*)localname->data(), FIF_LOAD_NOPIXELS);
+
+        if (hdib)
+        {
+            m_off_t bytes = decodedbytes(FreeImage_GetWidth(hdib), FreeImage_GetHeight(hdib),
+                                         FreeImage_GetBPP(hdib), fif == FIF_JPEG ? size : 0);
+
+            FreeImage_Unload(hdib);
+
+            if (bytes > MAXBITMAPBYTES)
+            {
+                LOG_warn << "Image too large to decode: " << bytes << " bytes";
+#ifdef _WIN32
+                localname->resize(localname->size()-1);
+#endif
+                return false;
+            }
+        }
+    }
+#endif
+
  #ifndef OLD_FREEIMAGE
     if (fif == FIF_JPEG)
     {
@@ -108,6 +151,38 @@ bool GfxProcFreeImage::readbitmap(FileAccess* fa, string* localname, int size)
         {
             h = FreeImage_GetHeight(dib);
         }
+
+        // the size hint is met by the longer side - if the shorter side was
+        // scaled below it (square crops of elongated images), decode again
+        // at the scale that keeps the shorter side at the requested size
+        int dw = FreeImage_GetWidth(dib);
+        int dh = FreeImage_GetHeight(dib);
+
+        if (std::min(dw, dh) < std::min(size, std::min(w, h)) && std::max(dw, dh) < std::max(w, h))
+        {
+            int fsize = size * std::max(w, h) / std::min(w, h);
+
+            // (no hint: full size)
+            if (fsize >= std::max(w, h) || fsize > 0x7fff)
+            {
+                fsize = 0;
+            }
+
+            FIBITMAP* fdib = NULL;
+
+            // (beyond the budget, make do with the smaller bitmap)
+            if (decodedbytes(w, h, 24, fsize) <= MAXBITMAPBYTES)
+            {
+                fdib = FreeImage_LoadX(fif, (freeimage_filename_char_t*)localname->data(),
+                                       JPEG_EXIFROTATE | JPEG_FAST | (fsize << 16));
+            }
+
+            if (fdib)
+            {
+                FreeImage_Unload(dib);
+                dib = fdib;
+            }
+        }
     }
     else
 #endif
@@ -153,16 +228,25 @@ bool GfxProcFreeImage::resizebitmap(int rw, int rh, string* jpegout)
 
         dib = tdib;
 
-        if ((tdib = FreeImage_Copy(dib, px, py, px + rw, py + rh)))
+        // (bounding box results need no crop)
+        if (!px && !py && rw == w && rh == h)
+        {
+            tdib = dib;
+        }
+        else if ((tdib = FreeImage_Copy(dib, px, py, px + rw, py + rh)))
         {
             FreeImage_Unload(dib);
+        }
 
+        if (tdib)
+        {
             dib = tdib;
 
             WORD bpp = (WORD)FreeImage_GetBPP(dib);
             if (bpp != 24) {
                 if ((tdib = FreeImage_ConvertTo24Bits(dib)) == NULL) {
                     FreeImage_Unload(dib);
+                    dib = NULL;
                     return 0;
                 }
                 FreeImage_Unload(dib);
@@ -356,6 +356,7 @@ bool GfxProcQT::readbitmap(FileAccess*, string* localname, int)
 #endif
 
     image = readbitmapQT(w, h, orientation, imagePath);
+    derived = QImage();
 
 #ifdef _WIN32
     localname->resize(localname->size()-1);
@@ -366,8 +367,36 @@ bool GfxProcQT::readbitmap(FileAccess*, string* localname, int)
 
 bool GfxProcQT::resizebitmap(int rw, int rh, string* jpegout)
 {
-    QImage result = resizebitmapQT(image, orientation, w, h, rw, rh);
-    if(result.isNull()) return false;
+    QImage result;
+
+    // derive smaller dimensions from the last bounding box result instead
+    // of decoding the file again (unless that would upscale it)
+    if(!derived.isNull())
+    {
+        int dw = derived.width();
+        int dh = derived.height();
+        int drw = rw;
+        int drh = rh;
+        int px, py;
+
+        transform(dw, dh, drw, drh, px, py);
+        if(dw && dh && dw <= derived.width() && dh <= derived.height())
+        {
+            result = derived.scaled(dw, dh, Qt::IgnoreAspectRatio, Qt::SmoothTransformation).copy(px, py, drw, drh);
+        }
+    }
+
+    if(result.isNull())
+    {
+        result = resizebitmapQT(image, orientation, w, h, rw, rh);
+        if(result.isNull()) return false;
+
+        if(rh)
+        {
+            derived = result;
+        }
+    }
+
     jpegout->clear();
 
     QByteArray ba;
@@ -381,6 +410,7 @@ bool GfxProcQT::resizebitmap(int rw, int rh, string* jpegout)
 void GfxProcQT::freebitmap()
 {
     delete image;
+    derived = QImage();
 }
 
 QImage GfxProcQT::createThumbnail(QString imagePath)
@@ -414,6 +444,14 @@ QImageReader *GfxProcQT::readbitmapQT(int &w, int &h, int &orientation, QString
         return NULL;
     }
 
+    //Formats that can't decode at a reduced size are decoded in full (32 bpp)
+    if(!image->supportsOption(QImageIOHandler::ScaledSize)
+            && (m_off_t)s.width() * s.height() * 4 > MAXBITMAPBYTES)
+    {
+        delete image;
+        return NULL;
+    }
+
     orientation = getExifOrientation(imagePath);
     if(orientation < ROTATION_LEFT_MIRRORED)
     {
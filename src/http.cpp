@@ -23,6 +23,11 @@
 #include "mega/megaclient.h"
 #include "mega/logging.h"
 
+#if defined(HAVE_ZLIB_H) || (defined(_WIN32) && !defined(WINDOWS_PHONE))
+#include <zlib.h>
+#define HAVE_GZIP 1
+#endif
+
 namespace mega {
 
 #ifdef _WIN32
@@ -68,6 +73,191 @@ HttpIO::HttpIO()
     inetback = false;
     lastdata = NEVER;
     chunkedok = true;
+    streamingok = true;
+    compressrequests = false;
+    compressionsavedout = 0;
+    compressionsavedin = 0;
+}
+
+bool HttpIO::setcompression(bool enable)
+{
+#ifdef HAVE_GZIP
+    compressrequests = enable;
+    return true;
+#else
+    compressrequests = false;
+    return !enable;
+#endif
+}
+
+BandwidthShaper::Bucket::Bucket()
+{
+    rate = 0;
+    tokens = 0;
+    refilled = 0;
+}
+
+void BandwidthShaper::Bucket::setrate(m_off_t r)
+{
+    rate = r;
+    tokens = 0;
+    refilled = Waiter::ds;
+}
+
+// a full bucket holds 200 ms worth of data (at least 16 KB)
+void BandwidthShaper::Bucket::refill()
+{
+    if (!rate || Waiter::ds == refilled)
+    {
+        return;
+    }
+
+    m_off_t burst = rate / 5;
+
+    if (burst < 16384)
+    {
+        burst = 16384;
+    }
+
+    tokens += rate * (m_off_t)(Waiter::ds - refilled) / 10;
+    refilled = Waiter::ds;
+
+    if (tokens > burst)
+    {
+        tokens = burst;
+    }
+}
+
+BandwidthShaper::BandwidthShaper()
+{
+    for (int d = 2; d--; )
+    {
+        baserate[d] = 0;
+        scheduled[d] = 0;
+    }
+}
+
+void BandwidthShaper::setlimit(direction_t d, m_off_t bps)
+{
+    baserate[d] = bps;
+    scheduled[d] = 0;
+    applyschedules(d);
+}
+
+void BandwidthShaper::setclasslimit(direction_t d, int c, m_off_t bps)
+{
+    if (c >= 0 && c < NUMCLASSES)
+    {
+        classes[d][c].setrate(bps);
+    }
+}
+
+void BandwidthShaper::addschedule(direction_t d, int start, int end, m_off_t bps)
+{
+    Schedule s;
+
+    s.start = start;
+    s.end = end;
+    s.rate = bps;
+    schedules[d].push_back(s);
+
+    scheduled[d] = 0;
+    applyschedules(d);
+}
+
+void BandwidthShaper::clearschedules(direction_t d)
+{
+    schedules[d].clear();
+    scheduled[d] = 0;
+    applyschedules(d);
+}
+
+// the first schedule covering the current time of day wins
+void BandwidthShaper::applyschedules(direction_t d)
+{
+    if (scheduled[d] && Waiter::ds - scheduled[d] < 600)
+    {
+        return;
+    }
+
+    scheduled[d] = Waiter::ds ? Waiter::ds : 1;
+
+    m_off_t rate = baserate[d];
+
+    if (schedules[d].size())
+    {
+        time_t ts = time(NULL);
+        struct tm* ptm = localtime(&ts);
+        int minute = ptm->tm_hour * 60 + ptm->tm_min;
+
+        for (unsigned i = 0; i < schedules[d].size(); i++)
+        {
+            const Schedule& s = schedules[d][i];
+
+            if (s.start <= s.end ? (minute >= s.start && minute < s.end)
+                                 : (minute >= s.start || minute < s.end))
+            {
+                rate = s.rate;
+                break;
+            }
+        }
+    }
+
+    if (rate != total[d].rate)
+    {
+        total[d].setrate(rate);
+    }
+}
+
+bool BandwidthShaper::limited(direction_t d, int c)
+{
+    applyschedules(d);
+
+    return total[d].rate || (c >= 0 && c < NUMCLASSES && classes[d][c].rate);
+}
+
+m_off_t BandwidthShaper::available(direction_t d, int c)
+{
+    m_off_t a = -1;
+
+    applyschedules(d);
+
+    if (total[d].rate)
+    {
+        total[d].refill();
+        a = total[d].tokens;
+    }
+
+    if (c >= 0 && c < NUMCLASSES && classes[d][c].rate)
+    {
+        classes[d][c].refill();
+
+        if (a < 0 || classes[d][c].tokens < a)
+        {
+            a = classes[d][c].tokens;
+        }
+    }
+
+    if (a < 0)
+    {
+        // unlimited
+        return ~(uint32_t)0;
+    }
+
+    return a > 0 ? a : 0;
+}
+
+void BandwidthShaper::consume(direction_t d, int c, m_off_t n)
+{
+    if (total[d].rate)
+    {
+        total[d].tokens -= n;
+    }
+
+    if (c >= 0 && c < NUMCLASSES && classes[d][c].rate)
+    {
+        classes[d][c].tokens -= n;
+    }
 }
 
 // signal Internet status - if the Internet was down for more than one minute,
@@ -178,10 +368,71 @@ void HttpReq::post(MegaClient* client, const char* data, unsigned len)
     bufpos = 0;
     inpurge = 0;
     contentlength = -1;
+    posttime = Waiter::ds;
+    rtt = -1;
+
+    // only the API servers are known to accept compressed request bodies
+    if (httpio->compressrequests && !data && !chunked && !gzipped && type == REQ_JSON
+     && !posturl.compare(0, MegaClient::APIURL.size(), MegaClient::APIURL))
+    {
+        compressout();
+    }
 
     httpio->post(this, data, len);
 }
 
+bool HttpReq::compressout()
+{
+#ifdef HAVE_GZIP
+    if (out->size() < MINCOMPRESS)
+    {
+        return false;
+    }
+
+    z_stream z;
+    string compressed;
+
+    memset(&z, 0, sizeof z);
+
+    // windowBits + 16: gzip wrapper
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, MAX_WBITS + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+
+    compressed.resize(deflateBound(&z, out->size()));
+
+    z.next_in = (Bytef*)out->data();
+    z.avail_in = out->size();
+    z.next_out = (Bytef*)compressed.data();
+    z.avail_out = compressed.size();
+
+    int t = deflate(&z, Z_FINISH);
+
+    compressed.resize(compressed.size() - z.avail_out);
+    deflateEnd(&z);
+
+    if (t != Z_STREAM_END || compressed.size() >= out->size())
+    {
+        return false;
+    }
+
+    if (httpio)
+    {
+        httpio->compressionsavedout += out->size() - compressed.size();
+    }
+
+    LOG_debug << "Request body compressed from " << out->size() << " to " << compressed.size() << " bytes";
+
+    out->swap(compressed);
+    gzipped = true;
+
+    return true;
+#else
+    return false;
+#endif
+}
+
 // attempt to send chunked data, remove from out
 void HttpReq::postchunked(MegaClient* client)
 {
@@ -223,6 +474,10 @@ HttpReq::HttpReq(bool b)
     out = &outbuf;
 
     inpurge = 0;
+    streaming = false;
+    gzipped = false;
+    posttime = 0;
+    rtt = -1;
     
     chunked = false;
     sslcheckfailed = false;
@@ -232,6 +487,8 @@ HttpReq::HttpReq(bool b)
     bufpos = 0;
     contentlength = 0;
     lastdata = 0;
+    shapedir = -1;
+    shapeclass = 0;
 }
 
 HttpReq::~HttpReq()
@@ -257,6 +514,8 @@ void HttpReq::setreq(const char* u, contenttype_t t)
 // add data to fixed or variable buffer
 void HttpReq::put(void* data, unsigned len, bool purge)
 {
+    AllocScope allocscope(AllocTags::HTTP);
+
     if (buf)
     {
         if (bufpos + len > buflen)
@@ -268,10 +527,9 @@ void HttpReq::put(void* data, unsigned len, bool purge)
     }
     else
     {
-        if (inpurge && purge)
+        if (purge)
         {
-            in.erase(0, inpurge);
-            inpurge = 0;
+            compactin();
         }
 
         in.append((char*)data, len);
@@ -296,10 +554,28 @@ void HttpReq::purge(size_t numbytes)
     inpurge += numbytes;
 }
 
+// drop the purged data only once it makes up at least half of the buffer:
+// the unpurged rest that has to be moved is then never larger than what is
+// dropped, so every received byte is moved at most once on average (instead
+// of the whole buffer on every receive callback)
+size_t HttpReq::compactin()
+{
+    size_t dropped = 0;
+
+    if (inpurge && inpurge * 2 >= in.size())
+    {
+        in.erase(0, inpurge);
+        dropped = inpurge;
+        inpurge = 0;
+    }
+
+    return dropped;
+}
+
 // set total response size
 void HttpReq::setcontentlength(m_off_t len)
 {
-    if (!buf && type != REQ_BINARY)
+    if (!buf && type != REQ_BINARY && !streaming)
     {
         in.reserve(len);
     }
@@ -321,13 +597,8 @@ byte* HttpReq::reserveput(unsigned* len)
     }
     else
     {
-        if (inpurge)
-        {
-            // FIXME: optimize erase()/resize() -> single copy/resize()
-            in.erase(0, inpurge);
-            bufpos -= inpurge;
-            inpurge = 0;
-        }
+        // bufpos is the write position in in here
+        bufpos -= compactin();
 
         if (bufpos + *len > in.size())
         {
@@ -365,29 +636,166 @@ bool HttpReqDL::prepare(FileAccess* fa, const char* tempurl, SymmCipher* key,
 
     dlpos = pos;
     size = (unsigned)(npos - pos);
+    crypted = false;
 
-    if (!buf || buflen != size)
+    unsigned len = (size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE;
+
+    if (!buf || len > bufcapacity || (!pool && buflen != size))
     {
         // (re)allocate buffer
-        if (buf)
+        if (pool)
+        {
+            if (buf)
+            {
+                pool->release(buf, bufcapacity);
+            }
+
+            buf = pool->get(len, &bufcapacity);
+        }
+        else
         {
             delete[] buf;
+            buf = new byte[len];
+            bufcapacity = len;
         }
-
-        buf = new byte[(size + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE];
-        buflen = size;
     }
 
+    buflen = size;
+
     return true;
 }
 
+HttpReqDL::HttpReqDL(ChunkBufferPool* p) : HttpReqXfer(p)
+{
+    dlpos = 0;
+    bufcapacity = 0;
+}
+
+// pooled buffers go back to the pool instead of being deleted by ~HttpReq()
+HttpReqDL::~HttpReqDL()
+{
+    if (pool && buf)
+    {
+        if (httpio)
+        {
+            httpio->cancel(this);
+            httpio = NULL;
+        }
+
+        pool->release(buf, bufcapacity);
+        buf = NULL;
+    }
+}
+
+void HttpReqXfer::crypt(vector<HttpReqXfer*>* chunks, SymmCipher* key, uint64_t ctriv)
+{
+    size_t n = chunks->size();
+
+    if (n < 2)
+    {
+        if (n)
+        {
+            (*chunks)[0]->crypt(key, ctriv);
+        }
+
+        return;
+    }
+
+    // requests spanning several chunks contribute one lane per chunk
+    vector<byte*> bufs, macs;
+    vector<unsigned> lens;
+    vector<m_off_t> positions;
+    bool encrypt = false;
+
+    for (size_t i = 0; i < n; i++)
+    {
+        HttpReqXfer* req = (*chunks)[i];
+        unsigned len;
+        m_off_t pos;
+        byte* buf = req->cryptbuf(&len, &pos, &encrypt);
+
+        req->chunkmacs.clear();
+        req->crypted = true;
+
+        m_off_t end = pos + len;
+
+        do {
+            m_off_t np = ChunkedHash::chunkceil(pos);
+
+            if (np > end)
+            {
+                np = end;
+            }
+
+            byte* mac = req->chunkmacs[pos].mac;
+
+            memset(mac, 0, SymmCipher::BLOCKSIZE);
+
+            bufs.push_back(buf);
+            lens.push_back((unsigned)(np - pos));
+            positions.push_back(pos);
+            macs.push_back(mac);
+
+            buf += np - pos;
+            pos = np;
+        } while (pos < end);
+    }
+
+    key->ctr_crypt((unsigned)bufs.size(), &bufs[0], &lens[0], &positions[0], ctriv, &macs[0], encrypt);
+}
+
+void HttpReqXfer::cryptspan(SymmCipher* key, byte* buf, unsigned len, m_off_t pos, uint64_t ctriv,
+                            chunkmac_map* macs, bool encrypt)
+{
+    m_off_t end = pos + len;
+
+    macs->clear();
+
+    // (an empty buffer still gets the MAC of its chunk)
+    do {
+        m_off_t np = ChunkedHash::chunkceil(pos);
+
+        if (np > end)
+        {
+            np = end;
+        }
+
+        byte* mac = (*macs)[pos].mac;
+
+        memset(mac, 0, SymmCipher::BLOCKSIZE);
+        key->ctr_crypt(buf, (unsigned)(np - pos), pos, ctriv, mac, encrypt);
+
+        buf += np - pos;
+        pos = np;
+    } while (pos < end);
+}
+
+byte* HttpReqDL::cryptbuf(unsigned* len, m_off_t* pos, bool* encrypt)
+{
+    *len = bufpos;
+    *pos = dlpos;
+    *encrypt = false;
+
+    return buf;
+}
+
+// decrypt and mac downloaded chunk
+void HttpReqDL::crypt(SymmCipher* key, uint64_t ctriv)
+{
+    cryptspan(key, buf, bufpos, dlpos, ctriv, &chunkmacs, false);
+    crypted = true;
+}
+
 // decrypt, mac and write downloaded chunk
 void HttpReqDL::finalize(FileAccess* fa, SymmCipher* key, chunkmac_map* macs,
                          uint64_t ctriv, m_off_t startpos, m_off_t endpos)
 {
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    if (!crypted)
+    {
+        crypt(key, ctriv);
+    }
 
-    key->ctr_crypt(buf, bufpos, dlpos, ctriv, mac, 0);
+    crypted = false;
 
     unsigned skip;
     unsigned prune;
@@ -420,7 +828,29 @@ void HttpReqDL::finalize(FileAccess* fa, SymmCipher* key, chunkmac_map* macs,
 
     fa->fwrite(buf + skip, bufpos - skip - prune, dlpos + skip);
 
-    memcpy((*macs)[dlpos].mac, mac, sizeof mac);
+    for (chunkmac_map::iterator it = chunkmacs.begin(); it != chunkmacs.end(); it++)
+    {
+        (*macs)[it->first] = it->second;
+    }
+}
+
+byte* HttpReqDL::detach(SymmCipher* key, uint64_t ctriv, unsigned* capacity)
+{
+    if (!crypted)
+    {
+        crypt(key, ctriv);
+    }
+
+    crypted = false;
+
+    byte* b = buf;
+
+    *capacity = bufcapacity;
+    buf = NULL;
+    buflen = 0;
+    bufcapacity = 0;
+
+    return b;
 }
 
 // prepare chunk for uploading: mac and encrypt
@@ -428,37 +858,666 @@ bool HttpReqUL::prepare(FileAccess* fa, const char* tempurl, SymmCipher* key,
                         chunkmac_map* macs, uint64_t ctriv, m_off_t pos,
                         m_off_t npos)
 {
-    size = (unsigned)(npos - pos);
-
-    if (!fa->fread(out, size, (-(int)size) & (SymmCipher::BLOCKSIZE - 1), pos))
+    if (!read(fa, tempurl, pos, npos))
     {
         return false;
     }
 
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
-    char buf[256];
+    crypt(key, ctriv);
+    seal(macs);
 
-    snprintf(buf, sizeof buf, "%s/%" PRIu64, tempurl, pos);
-    setreq(buf, REQ_BINARY);
+    return true;
+}
+
+// read chunk (padded to the cipher block size)
+bool HttpReqUL::read(FileAccess* fa, const char* tempurl, m_off_t pos, m_off_t npos)
+{
+    size = (unsigned)(npos - pos);
+    crypted = false;
+
+    unsigned pad = (-(int)size) & (SymmCipher::BLOCKSIZE - 1);
+
+    if (size + pad > chunkbuflen)
+    {
+        // buffers only grow (requests of up to MAXREQUESTSIZE)
+        if (pool)
+        {
+            if (chunkbuf)
+            {
+                pool->release(chunkbuf, chunkbuflen);
+            }
+
+            chunkbuf = pool->get(size + pad, &chunkbuflen);
+        }
+        else
+        {
+            ChunkBufferPool::deallocate(chunkbuf);
+            chunkbuflen = size + pad;
+            chunkbuf = ChunkBufferPool::allocate(chunkbuflen);
+        }
+    }
 
-    key->ctr_crypt((byte*)out->data(), size, pos, ctriv, mac, 1);
+    if (size && !fa->frawread(chunkbuf, size, pos))
+    {
+        return false;
+    }
 
-    memcpy((*macs)[pos].mac, mac, sizeof mac);
+    memset(chunkbuf + size, 0, pad);
 
-    // unpad for POSTing
-    out->resize(size);
+    settarget(tempurl, pos);
 
     return true;
 }
 
-// number of bytes sent in this request
-m_off_t HttpReqUL::transferred(MegaClient* client)
+void HttpReqUL::adopt(byte* buf, unsigned capacity, chunkmac_map* macs, const char* tempurl, m_off_t pos, m_off_t npos)
 {
-    if (httpiohandle)
+    size = (unsigned)(npos - pos);
+    chunkmacs.swap(*macs);
+    crypted = true;
+
+    if (chunkbuf)
     {
-        return client->httpio->postpos(httpiohandle);
+        if (pool)
+        {
+            pool->release(chunkbuf, chunkbuflen);
+        }
+        else
+        {
+            ChunkBufferPool::deallocate(chunkbuf);
+        }
     }
 
-    return 0;
+    chunkbuf = buf;
+    chunkbuflen = capacity;
+
+    settarget(tempurl, pos);
+}
+
+void HttpReqUL::settarget(const char* tempurl, m_off_t pos)
+{
+    char buf[256];
+
+    snprintf(buf, sizeof buf, "%s/%" PRIu64, tempurl, pos);
+    setreq(buf, REQ_BINARY);
+
+    ulpos = pos;
+}
+
+// mac and encrypt the read chunk
+void HttpReqUL::crypt(SymmCipher* key, uint64_t ctriv)
+{
+    cryptspan(key, chunkbuf, size, ulpos, ctriv, &chunkmacs, true);
+    crypted = true;
+}
+
+byte* HttpReqUL::cryptbuf(unsigned* len, m_off_t* pos, bool* encrypt)
+{
+    *len = size;
+    *pos = ulpos;
+    *encrypt = true;
+
+    return chunkbuf;
+}
+
+void HttpReqUL::seal(chunkmac_map* macs)
+{
+    for (chunkmac_map::iterator it = chunkmacs.begin(); it != chunkmacs.end(); it++)
+    {
+        (*macs)[it->first] = it->second;
+    }
+}
+
+// POST the unpadded chunk without copying it
+void HttpReqUL::send(MegaClient* client)
+{
+    post(client, (const char*)chunkbuf, size);
+}
+
+HttpReqUL::HttpReqUL(ChunkBufferPool* p) : HttpReqXfer(p)
+{
+    ulpos = 0;
+    chunkbuf = NULL;
+    chunkbuflen = 0;
+}
+
+HttpReqUL::~HttpReqUL()
+{
+    if (httpio)
+    {
+        // the connection may still be reading from the chunk buffer
+        httpio->cancel(this);
+        httpio = NULL;
+    }
+
+    if (!chunkbuf)
+    {
+        return;
+    }
+
+    if (pool)
+    {
+        pool->release(chunkbuf, chunkbuflen);
+    }
+    else
+    {
+        ChunkBufferPool::deallocate(chunkbuf);
+    }
+}
+
+HostStats::Host::Host()
+{
+    rtt = -1;
+    throughput = -1;
+    errorrate = 0;
+    requests = 0;
+    failures = 0;
+    bytes = 0;
+    lastsuccess = NEVER;
+    lastfailure = NEVER;
+    lastreported = NEVER;
+}
+
+string HostStats::hostof(const string& url)
+{
+    size_t start = url.find("://");
+
+    start = start == string::npos ? 0 : start + 3;
+
+    return url.substr(start, url.find('/', start) - start);
+}
+
+HostStats::Host& HostStats::get(const string& url)
+{
+    string host = hostof(url);
+    host_map::iterator it = hosts.find(host);
+
+    if (it != hosts.end())
+    {
+        return it->second;
+    }
+
+    if (hosts.size() >= MAXHOSTS)
+    {
+        // make room: drop the hosts that have not been used for a while, or
+        // start over if all of them have
+        for (it = hosts.begin(); it != hosts.end(); )
+        {
+            dstime last = EVER(it->second.lastsuccess) ? it->second.lastsuccess : 0;
+
+            if (EVER(it->second.lastfailure) && it->second.lastfailure > last)
+            {
+                last = it->second.lastfailure;
+            }
+
+            if (Waiter::ds - last > EXPIRY)
+            {
+                hosts.erase(it++);
+            }
+            else
+            {
+                it++;
+            }
+        }
+
+        if (hosts.size() >= MAXHOSTS)
+        {
+            hosts.clear();
+        }
+    }
+
+    Host& h = hosts[host];
+
+    size_t start = url.find("://");
+    h.base = url.substr(0, (start == string::npos ? 0 : start + 3) + host.size());
+    h.base.append("/");
+
+    return h;
+}
+
+void HostStats::recent(vector<string>* urls, unsigned max) const
+{
+    multimap<dstime, const string*> bytime;
+
+    for (host_map::const_iterator it = hosts.begin(); it != hosts.end(); it++)
+    {
+        if (EVER(it->second.lastsuccess))
+        {
+            bytime.insert(pair<dstime, const string*>(it->second.lastsuccess, &it->second.base));
+        }
+    }
+
+    for (multimap<dstime, const string*>::reverse_iterator it = bytime.rbegin(); it != bytime.rend() && urls->size() < max; it++)
+    {
+        urls->push_back(*it->second);
+    }
+}
+
+void HostStats::success(const HttpReq* req, m_off_t len)
+{
+    Host& h = get(req->posturl);
+
+    h.requests++;
+    h.bytes += len;
+    h.lastsuccess = Waiter::ds;
+    h.errorrate -= h.errorrate / WEIGHT;
+
+    if (req->rtt >= 0)
+    {
+        h.rtt = h.rtt < 0 ? req->rtt : h.rtt + (req->rtt - h.rtt) / WEIGHT;
+    }
+
+    // requests shorter than a decisecond carry no throughput information
+    dstime elapsed = Waiter::ds - req->posttime;
+
+    if (len && elapsed > 0)
+    {
+        m_off_t rate = len * 10 / elapsed;
+
+        h.throughput = h.throughput < 0 ? rate : h.throughput + (rate - h.throughput) / WEIGHT;
+    }
+}
+
+void HostStats::failure(const string& url)
+{
+    Host& h = get(url);
+
+    h.requests++;
+    h.failures++;
+    h.lastfailure = Waiter::ds;
+    h.errorrate += (1 - h.errorrate) / WEIGHT;
+}
+
+const HostStats::Host* HostStats::find(const string& url) const
+{
+    host_map::const_iterator it = hosts.find(hostof(url));
+
+    return it == hosts.end() ? NULL : &it->second;
+}
+
+bool HostStats::degraded(const string& url) const
+{
+    const Host* h = find(url);
+
+    // two consecutive failures on a fresh entry already reach 0.23
+    return h && h->errorrate > 0.2f && EVER(h->lastfailure)
+            && (!EVER(h->lastsuccess) || h->lastfailure > h->lastsuccess);
+}
+
+bool HostStats::report(const string& url)
+{
+    Host& h = get(url);
+
+    if (EVER(h.lastreported) && Waiter::ds - h.lastreported < REPORTINTERVAL)
+    {
+        return false;
+    }
+
+    h.lastreported = Waiter::ds;
+
+    return true;
+}
+
+void HostStats::getjson(string* json) const
+{
+    char buf[256];
+
+    *json = "[";
+
+    for (host_map::const_iterator it = hosts.begin(); it != hosts.end(); it++)
+    {
+        const Host& h = it->second;
+
+        if (json->size() > 1)
+        {
+            json->append(",");
+        }
+
+        json->append("{\"host\":\"");
+        json->append(it->first);
+
+        snprintf(buf, sizeof buf,
+                 "\",\"rtt\":%d,\"throughput\":%" PRId64 ",\"errorrate\":%.3f,"
+                 "\"requests\":%u,\"failures\":%u,\"bytes\":%" PRId64 ","
+                 "\"lastsuccess\":%d,\"lastfailure\":%d}",
+                 h.rtt, (int64_t)h.throughput, h.errorrate,
+                 h.requests, h.failures, (int64_t)h.bytes,
+                 EVER(h.lastsuccess) ? (int)((Waiter::ds - h.lastsuccess) / 10) : -1,
+                 EVER(h.lastfailure) ? (int)((Waiter::ds - h.lastfailure) / 10) : -1);
+        json->append(buf);
+    }
+
+    json->append("]");
+}
+
+ChunkBufferPool::ChunkBufferPool()
+{
+    requests = 0;
+    hits = 0;
+    inuse = 0;
+    idle = 0;
+    peak = 0;
+}
+
+ChunkBufferPool::~ChunkBufferPool()
+{
+    clear();
+}
+
+// page-aligned allocation: the pointer returned by new[] is stored in front
+// of the aligned block
+byte* ChunkBufferPool::allocate(unsigned len)
+{
+    byte* raw = new byte[len + PAGESIZE + sizeof(byte*)];
+    byte* aligned = (byte*)(((uintptr_t)raw + sizeof(byte*) + PAGESIZE - 1) & ~(uintptr_t)(PAGESIZE - 1));
+
+    memcpy(aligned - sizeof(byte*), &raw, sizeof raw);
+
+    return aligned;
+}
+
+void ChunkBufferPool::deallocate(byte* aligned)
+{
+    if (aligned)
+    {
+        byte* raw;
+
+        memcpy(&raw, aligned - sizeof(byte*), sizeof raw);
+        delete[] raw;
+    }
+}
+
+byte* ChunkBufferPool::get(unsigned len, unsigned* capacity)
+{
+    unsigned c = (len + CLASSSIZE - 1) / CLASSSIZE;
+    byte* b;
+
+    requests++;
+
+    if (!c || c > NUMCLASSES)
+    {
+        // not pooled
+        *capacity = len;
+        b = allocate(len);
+    }
+    else
+    {
+        *capacity = c * CLASSSIZE;
+
+        if (idlebufs[c - 1].size())
+        {
+            hits++;
+            b = idlebufs[c - 1].back();
+            idlebufs[c - 1].pop_back();
+            idle -= *capacity;
+        }
+        else
+        {
+            b = allocate(*capacity);
+        }
+    }
+
+    inuse += *capacity;
+
+    if (inuse + idle > peak)
+    {
+        peak = inuse + idle;
+    }
+
+    return b;
+}
+
+void ChunkBufferPool::release(byte* b, unsigned capacity)
+{
+    unsigned c = capacity / CLASSSIZE;
+
+    inuse -= capacity;
+
+    if (capacity % CLASSSIZE || !c || c > NUMCLASSES || idlebufs[c - 1].size() >= MAXIDLE)
+    {
+        deallocate(b);
+    }
+    else
+    {
+        idlebufs[c - 1].push_back(b);
+        idle += capacity;
+    }
+}
+
+void ChunkBufferPool::clear()
+{
+    for (unsigned i = 0; i < NUMCLASSES; i++)
+    {
+        for (unsigned j = 0; j < idlebufs[i].size(); j++)
+        {
+            deallocate(idlebufs[i][j]);
+        }
+
+        idlebufs[i].clear();
+    }
+
+    idle = 0;
+}
+
+// number of bytes sent in this request
+m_off_t HttpReqUL::transferred(MegaClient* client)
+{
+    if (httpiohandle)
+    {
+        return client->httpio->postpos(httpiohandle);
+    }
+
+    return 0;
+}
+
+DirectReadCache::DirectReadCache()
+{
+    hits = 0;
+    misses = 0;
+    bytes = 0;
+    capacity = 0;
+}
+
+const string* DirectReadCache::get(handle h, m_off_t n)
+{
+    if (!capacity)
+    {
+        return NULL;
+    }
+
+    map<blockid, Block>::iterator it = blocks.find(blockid(h, n));
+
+    if (it == blocks.end())
+    {
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+
+    // most recently used last
+    lru.splice(lru.end(), lru, it->second.lru_it);
+
+    return &it->second.data;
+}
+
+void DirectReadCache::put(handle h, m_off_t n, const char* data, unsigned len)
+{
+    if (!capacity || len > capacity)
+    {
+        return;
+    }
+
+    blockid id(h, n);
+    map<blockid, Block>::iterator it = blocks.find(id);
+
+    if (it != blocks.end())
+    {
+        bytes -= it->second.data.size();
+        lru.splice(lru.end(), lru, it->second.lru_it);
+    }
+    else
+    {
+        it = blocks.insert(pair<blockid, Block>(id, Block())).first;
+        it->second.lru_it = lru.insert(lru.end(), id);
+    }
+
+    it->second.data.assign(data, len);
+    bytes += len;
+
+    evict(capacity);
+}
+
+// sequential reads double the read-ahead, any other read resets it
+m_off_t DirectReadCache::access(handle h, m_off_t offset, m_off_t end)
+{
+    if (!capacity)
+    {
+        return 0;
+    }
+
+    map<handle, pair<m_off_t, m_off_t> >::iterator it = streams.find(h);
+
+    if (it == streams.end())
+    {
+        if (streams.size() >= MAXSTREAMS)
+        {
+            streams.erase(streams.begin());
+        }
+
+        it = streams.insert(pair<handle, pair<m_off_t, m_off_t> >(h, pair<m_off_t, m_off_t>(-1, 0))).first;
+    }
+
+    if (it->second.first == offset)
+    {
+        it->second.second = it->second.second ? it->second.second * 2 : BLOCKSIZE;
+
+        if (it->second.second > MAXREADAHEAD)
+        {
+            it->second.second = MAXREADAHEAD;
+        }
+    }
+    else
+    {
+        it->second.second = 0;
+    }
+
+    it->second.first = end;
+
+    // sequential reads must not be able to flush the whole cache
+    return it->second.second < capacity / 4 ? it->second.second : capacity / 4;
+}
+
+void DirectReadCache::setmaxbytes(m_off_t n)
+{
+    capacity = n;
+
+    evict(capacity);
+
+    if (!capacity)
+    {
+        streams.clear();
+    }
+}
+
+void DirectReadCache::clear()
+{
+    blocks.clear();
+    lru.clear();
+    streams.clear();
+    bytes = 0;
+}
+
+TempUrlCache::TempUrlCache()
+{
+    hits = 0;
+    misses = 0;
+}
+
+const string* TempUrlCache::get(handle h, m_off_t* size)
+{
+    map<handle, Entry>::iterator it = entries.find(h);
+
+    if (it == entries.end())
+    {
+        misses++;
+        return NULL;
+    }
+
+    if (Waiter::ds - it->second.ts >= TTL)
+    {
+        entries.erase(it);
+        misses++;
+        return NULL;
+    }
+
+    hits++;
+    *size = it->second.size;
+
+    return &it->second.url;
+}
+
+void TempUrlCache::put(handle h, const string* url, m_off_t size)
+{
+    if (!url->size() || size < 0)
+    {
+        return;
+    }
+
+    if (entries.size() >= MAXENTRIES && entries.find(h) == entries.end())
+    {
+        // drop expired entries, or the oldest one if none is
+        for (map<handle, Entry>::iterator it = entries.begin(); it != entries.end(); )
+        {
+            if (Waiter::ds - it->second.ts >= TTL)
+            {
+                entries.erase(it++);
+            }
+            else it++;
+        }
+
+        if (entries.size() >= MAXENTRIES)
+        {
+            map<handle, Entry>::iterator oldest = entries.begin();
+
+            for (map<handle, Entry>::iterator it = entries.begin(); it != entries.end(); it++)
+            {
+                if (it->second.ts < oldest->second.ts)
+                {
+                    oldest = it;
+                }
+            }
+
+            entries.erase(oldest);
+        }
+    }
+
+    Entry& e = entries[h];
+
+    e.url = *url;
+    e.size = size;
+    e.ts = Waiter::ds;
+}
+
+void TempUrlCache::invalidate(handle h)
+{
+    entries.erase(h);
+}
+
+void TempUrlCache::clear()
+{
+    entries.clear();
+}
+
+// drop least recently used blocks until at most n bytes are cached
+void DirectReadCache::evict(m_off_t n)
+{
+    while (bytes > n && lru.size())
+    {
+        map<blockid, Block>::iterator it = blocks.find(lru.front());
+
+        bytes -= it->second.data.size();
+        blocks.erase(it);
+        lru.pop_front();
+    }
 }
 } // namespace
@@ -24,14 +24,94 @@
 #include "mega/megaclient.h"
 #include "mega/logging.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define JSON_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define JSON_NEON 1
+#include <arm_neon.h>
+#endif
+
 namespace mega {
+#if defined(JSON_SSE2) || defined(JSON_NEON)
+// skip aligned 16-byte blocks without quotes, backslashes or NULs and return
+// the first block containing one (aligned loads never cross a page boundary,
+// so reading past the terminating NUL is safe)
+static inline const char* skipplainblocks(const char* ptr)
+{
+#ifdef JSON_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i zero = _mm_setzero_si128();
+
+    for (;;)
+    {
+        __m128i b = _mm_load_si128((const __m128i*)ptr);
+
+        if (_mm_movemask_epi8(_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(b, quote),
+                                                        _mm_cmpeq_epi8(b, backslash)),
+                                           _mm_cmpeq_epi8(b, zero))))
+        {
+            return ptr;
+        }
+
+        ptr += 16;
+    }
+#else
+    const uint8x16_t quote = vdupq_n_u8('"');
+    const uint8x16_t backslash = vdupq_n_u8('\\');
+
+    for (;;)
+    {
+        uint8x16_t b = vld1q_u8((const uint8_t*)ptr);
+
+        if (vmaxvq_u8(vorrq_u8(vorrq_u8(vceqq_u8(b, quote), vceqq_u8(b, backslash)),
+                               vceqzq_u8(b))))
+        {
+            return ptr;
+        }
+
+        ptr += 16;
+    }
+#endif
+}
+#endif
+
+// skip the contents of a string, return the position of the closing quote
+// (or the terminating NUL if there is none)
+const char* JSON::skipstring(const char* ptr)
+{
+    for (;;)
+    {
+#if defined(JSON_SSE2) || defined(JSON_NEON)
+        if (!((uintptr_t)ptr & 15))
+        {
+            ptr = skipplainblocks(ptr);
+        }
+#endif
+        if (*ptr == '\\')
+        {
+            // the escaped character is skipped unconditionally
+            if (!*++ptr)
+            {
+                return ptr;
+            }
+        }
+        else if (!*ptr || *ptr == '"')
+        {
+            return ptr;
+        }
+
+        ptr++;
+    }
+}
+
 // store array or object in string s
 // reposition after object
 bool JSON::storeobject(string* s)
 {
     int openobject[2] = { 0 };
     const char* ptr;
-    bool escaped = false;
 
     while (*pos > 0 && *pos <= ' ')
     {
@@ -66,13 +146,7 @@ bool JSON::storeobject(string* s)
         }
         else if (*ptr == '"')
         {
-            ptr++;
-
-            while (*ptr && (escaped || *ptr != '"'))
-            {
-                escaped = *ptr == '\\' && !escaped;
-                ptr++;
-            }
+            ptr = skipstring(ptr + 1);
 
             if (!*ptr)
             {
@@ -239,7 +313,7 @@ bool JSON::storebinary(string* dst)
         }
 
         dst->resize((ptr - pos - 1) / 4 * 3 + 3);
-        dst->resize(Base64::atob(pos + 1, (byte*)dst->data(), dst->size()));
+        dst->resize(Base64::atob(pos + 1, ptr - pos - 1, (byte*)dst->data(), dst->size()));
 
         // skip string
         storeobject();
@@ -343,16 +417,17 @@ double JSON::getfloat()
 }
 
 // return pointer to JSON payload data
-const char* JSON::getvalue()
+const char* JSON::getvalue(size_t* len)
 {
     const char* r;
+    bool quoted;
 
     if (*pos == ':' || *pos == ',')
     {
         pos++;
     }
 
-    if (*pos == '"')
+    if ((quoted = *pos == '"'))
     {
         r = pos + 1;
     }
@@ -361,7 +436,17 @@ const char* JSON::getvalue()
         r = pos;
     }
 
-            storeobject();
+    if (storeobject())
+    {
+        if (len)
+        {
+            *len = pos - r - quoted;
+        }
+    }
+    else if (len)
+    {
+        *len = 0;
+    }
 
     return r;
 }
@@ -536,4 +621,173 @@ void JSON::begin(const char* json)
 {
     pos = json;
 }
+
+JSONSplitter::JSONSplitter()
+{
+    reset(-1);
+}
+
+void JSONSplitter::reset(int elem)
+{
+    target = elem;
+    depth = 0;
+    element = 0;
+    arraydepth = 0;
+    intarget = false;
+    instring = false;
+    escaped = false;
+    expectkey = false;
+    fkey = false;
+    pos = 0;
+    keystart = 0;
+    elementstart = 0;
+    releasable = 0;
+    started = false;
+    finished = target < 0;
+    failed = false;
+    head.clear();
+}
+
+bool JSONSplitter::next(const char* data, size_t len, const char** elementptr, size_t* elementlen)
+{
+    while (!finished && pos < len)
+    {
+        char c = data[pos++];
+
+        if (instring)
+        {
+            if (escaped)
+            {
+                escaped = false;
+            }
+            else if (c == '\\')
+            {
+                escaped = true;
+            }
+            else if (c == '"')
+            {
+                instring = false;
+
+                // name in the target object?
+                if (intarget && depth == 2 && expectkey)
+                {
+                    expectkey = false;
+                    fkey = pos - keystart == 3 && data[keystart + 1] == 'f';
+                }
+            }
+
+            continue;
+        }
+
+        switch (c)
+        {
+            case '"':
+                instring = true;
+                keystart = pos - 1;
+
+                if (!(intarget && depth == 2 && expectkey))
+                {
+                    fkey = false;
+                }
+                break;
+
+            case '{':
+            case '[':
+                if (depth == 1 && c == '{' && element == target)
+                {
+                    intarget = true;
+                    expectkey = true;
+                }
+                else if (intarget && depth == 2 && !arraydepth)
+                {
+                    if (fkey && c == '[')
+                    {
+                        // the array starts: keep everything up to here
+                        arraydepth = 3;
+                        started = true;
+                        head.assign(data, pos);
+                        releasable = pos;
+                    }
+
+                    fkey = false;
+                }
+                else if (arraydepth && depth == arraydepth)
+                {
+                    elementstart = pos - 1;
+                }
+
+                depth++;
+                break;
+
+            case '}':
+            case ']':
+                depth--;
+
+                if (arraydepth)
+                {
+                    if (depth == arraydepth)
+                    {
+                        *elementptr = data + elementstart;
+                        *elementlen = pos - elementstart;
+                        releasable = pos;
+                        return true;
+                    }
+
+                    if (depth < arraydepth)
+                    {
+                        // end of the array: the rest is processed as usual
+                        finished = true;
+                        releasable = pos - 1;
+                    }
+                }
+                else if (depth < 2 && intarget)
+                {
+                    // no array in the target object
+                    finished = true;
+                }
+                break;
+
+            case ',':
+                if (depth == 1)
+                {
+                    element++;
+                }
+                else if (intarget && depth == 2)
+                {
+                    expectkey = true;
+                }
+
+                fkey = false;
+                break;
+
+            case ':':
+                break;
+
+            default:
+                if (intarget && depth == 2 && !isspace((unsigned char)c))
+                {
+                    fkey = false;
+                }
+        }
+
+        if (depth == 1 && element > target)
+        {
+            finished = true;
+        }
+    }
+
+    return false;
+}
+
+size_t JSONSplitter::release()
+{
+    size_t r = releasable;
+
+    pos -= r;
+    keystart -= r;
+    elementstart -= r;
+    releasable = 0;
+
+    return r;
+}
 } // namespace
@@ -36,41 +36,47 @@ SimpleLogger::SimpleLogger(enum LogLevel ll, char const* filename, int line, boo
     level = ll;
     lineBreak = lBreak;
 
+    // the same timestamp for the streams and the external logger
+    if (settings.enableTime || logger)
+        t = getTime();
+
     if (settings.enableTime)
-        ostr << "[" << getTime() << "] ";
+        ostr << "[" << t << "] ";
     if (settings.enableLevel)
         ostr << "[" << toStr(ll) << "] ";
     if (settings.enableSource)
         ostr << filename << ":" << line << " ";
 
     if (logger) {
-        t = getTime();
-        std::ostringstream oss;
-        oss << filename;
+        fname = filename;
         if(line >= 0)
         {
-            oss << ":" << line;
+            char buf[16];
+            sprintf(buf, ":%d", line);
+            fname.append(buf);
         }
-        fname = oss.str();
     }
 }
 
 SimpleLogger::~SimpleLogger()
 {
-    OutputStreams::iterator iter;
-    OutputStreams vec;
+    OutputStreams::const_iterator iter;
+    const OutputStreams& vec = getOutput(level);
 
     if (logger)
         logger->log(t.c_str(), level, fname.c_str(), ostr.str().c_str());
 
+    if (vec.empty())
+        return;
+
     if (lineBreak)
         ostr << std::endl;
 
-    vec = getOutput(level);
+    string line = ostr.str();
 
     for (iter = vec.begin(); iter != vec.end(); iter++)
     {
-        **iter << ostr.str();
+        **iter << line;
     }
 }
 
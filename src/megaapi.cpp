@@ -90,6 +90,235 @@ const char *MegaProxy::getPassword()
     return password;
 }
 
+MegaFileHandle::~MegaFileHandle()
+{
+
+}
+
+MegaHandle MegaFileHandle::getNodeHandle() const
+{
+    return INVALID_HANDLE;
+}
+
+long long MegaFileHandle::getSize() const
+{
+    return 0;
+}
+
+MegaUploadBatch::MegaUploadBatch()
+{
+
+}
+
+MegaUploadBatch::~MegaUploadBatch()
+{
+
+}
+
+void MegaUploadBatch::add(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime, const char *fingerprint)
+{
+    Upload upload;
+    upload.localPath = localPath ? localPath : "";
+    upload.parentHandle = parent ? parent->getHandle() : INVALID_HANDLE;
+    upload.customName = (fileName != NULL);
+    upload.fileName = fileName ? fileName : "";
+    upload.mtime = mtime;
+    upload.fingerprint = fingerprint ? fingerprint : "";
+    uploads.push_back(upload);
+}
+
+int MegaUploadBatch::size()
+{
+    return int(uploads.size());
+}
+
+const char *MegaUploadBatch::getLocalPath(int i)
+{
+    if (i < 0 || i >= size())
+    {
+        return NULL;
+    }
+
+    return uploads[i].localPath.c_str();
+}
+
+MegaHandle MegaUploadBatch::getParentHandle(int i)
+{
+    if (i < 0 || i >= size())
+    {
+        return INVALID_HANDLE;
+    }
+
+    return uploads[i].parentHandle;
+}
+
+const char *MegaUploadBatch::getFileName(int i)
+{
+    if (i < 0 || i >= size() || !uploads[i].customName)
+    {
+        return NULL;
+    }
+
+    return uploads[i].fileName.c_str();
+}
+
+int64_t MegaUploadBatch::getTime(int i)
+{
+    if (i < 0 || i >= size())
+    {
+        return -1;
+    }
+
+    return uploads[i].mtime;
+}
+
+const char *MegaUploadBatch::getFingerprint(int i)
+{
+    if (i < 0 || i >= size() || !uploads[i].fingerprint.size())
+    {
+        return NULL;
+    }
+
+    return uploads[i].fingerprint.c_str();
+}
+
+MegaNodeQuery::MegaNodeQuery()
+{
+    type = -1;
+    hasName = false;
+    matchType = MegaApi::SEARCH_SUBSTRING;
+    minSize = -1;
+    maxSize = -1;
+    minCtime = -1;
+    maxCtime = -1;
+    minMtime = -1;
+    maxMtime = -1;
+    thumbnail = -1;
+    preview = -1;
+    shareState = SHARE_ANY;
+    childrenOnly = false;
+}
+
+MegaNodeQuery::~MegaNodeQuery()
+{
+
+}
+
+void MegaNodeQuery::setType(int type)
+{
+    this->type = type;
+}
+
+void MegaNodeQuery::setName(const char *name, int matchType)
+{
+    this->hasName = (name != NULL);
+    this->name = name ? name : "";
+    this->matchType = matchType;
+}
+
+void MegaNodeQuery::setSizeRange(int64_t minSize, int64_t maxSize)
+{
+    this->minSize = minSize;
+    this->maxSize = maxSize;
+}
+
+void MegaNodeQuery::setCreationTimeRange(int64_t from, int64_t to)
+{
+    this->minCtime = from;
+    this->maxCtime = to;
+}
+
+void MegaNodeQuery::setModificationTimeRange(int64_t from, int64_t to)
+{
+    this->minMtime = from;
+    this->maxMtime = to;
+}
+
+void MegaNodeQuery::setThumbnail(int thumbnail)
+{
+    this->thumbnail = thumbnail;
+}
+
+void MegaNodeQuery::setPreview(int preview)
+{
+    this->preview = preview;
+}
+
+void MegaNodeQuery::setShareState(int shareState)
+{
+    this->shareState = shareState;
+}
+
+void MegaNodeQuery::setChildrenOnly(bool childrenOnly)
+{
+    this->childrenOnly = childrenOnly;
+}
+
+int MegaNodeQuery::getType()
+{
+    return type;
+}
+
+const char *MegaNodeQuery::getName()
+{
+    return hasName ? name.c_str() : NULL;
+}
+
+int MegaNodeQuery::getMatchType()
+{
+    return matchType;
+}
+
+int64_t MegaNodeQuery::getMinSize()
+{
+    return minSize;
+}
+
+int64_t MegaNodeQuery::getMaxSize()
+{
+    return maxSize;
+}
+
+int64_t MegaNodeQuery::getMinCreationTime()
+{
+    return minCtime;
+}
+
+int64_t MegaNodeQuery::getMaxCreationTime()
+{
+    return maxCtime;
+}
+
+int64_t MegaNodeQuery::getMinModificationTime()
+{
+    return minMtime;
+}
+
+int64_t MegaNodeQuery::getMaxModificationTime()
+{
+    return maxMtime;
+}
+
+int MegaNodeQuery::getThumbnail()
+{
+    return thumbnail;
+}
+
+int MegaNodeQuery::getPreview()
+{
+    return preview;
+}
+
+int MegaNodeQuery::getShareState()
+{
+    return shareState;
+}
+
+bool MegaNodeQuery::isChildrenOnly()
+{
+    return childrenOnly;
+}
+
 MegaStringList::~MegaStringList()
 {
 
@@ -127,6 +356,107 @@ int MegaNodeList::size()
     return 0;
 }
 
+int MegaNodeList::getHandles(int start, MegaHandle *handles, int count)
+{
+    return 0;
+}
+
+int MegaNodeList::getSizes(int start, int64_t *sizes, int count)
+{
+    return 0;
+}
+
+int MegaNodeList::getModificationTimes(int start, int64_t *mtimes, int count)
+{
+    return 0;
+}
+
+int MegaNodeList::getTypes(int start, int *types, int count)
+{
+    return 0;
+}
+
+int MegaNodeList::getNames(int start, char *names, int size)
+{
+    return 0;
+}
+
+MegaHandleList::~MegaHandleList() { }
+
+MegaHandleList *MegaHandleList::copy()
+{
+    return NULL;
+}
+
+MegaHandle MegaHandleList::get(int i)
+{
+    return INVALID_HANDLE;
+}
+
+int MegaHandleList::size()
+{
+    return 0;
+}
+
+MegaChildrenCursor::~MegaChildrenCursor() { }
+
+MegaChildrenCursor *MegaChildrenCursor::copy()
+{
+    return NULL;
+}
+
+MegaNodeList *MegaChildrenCursor::next(int count)
+{
+    return NULL;
+}
+
+int MegaChildrenCursor::getPosition()
+{
+    return 0;
+}
+
+void MegaChildrenCursor::setPosition(int position)
+{
+
+}
+
+MegaNodeSnapshot::~MegaNodeSnapshot() { }
+
+MegaNodeSnapshot *MegaNodeSnapshot::copy()
+{
+    return NULL;
+}
+
+const char *MegaNodeSnapshot::getSequenceNumber()
+{
+    return NULL;
+}
+
+int MegaNodeSnapshot::getNumNodes()
+{
+    return 0;
+}
+
+MegaNode *MegaNodeSnapshot::getNodeByHandle(MegaHandle handle)
+{
+    return NULL;
+}
+
+MegaNode *MegaNodeSnapshot::getParentNode(MegaNode *node)
+{
+    return NULL;
+}
+
+int MegaNodeSnapshot::getNumChildren(MegaNode *parent)
+{
+    return 0;
+}
+
+MegaNodeList *MegaNodeSnapshot::getChildren(MegaNode *parent)
+{
+    return NULL;
+}
+
 MegaTransferList::~MegaTransferList() { }
 
 MegaTransfer *MegaTransferList::get(int i)
@@ -302,6 +632,21 @@ int MegaNode::getChanges()
     return 0;
 }
 
+MegaHandle MegaNode::getPreviousParentHandle()
+{
+    return INVALID_HANDLE;
+}
+
+const char *MegaNode::getPreviousName()
+{
+    return NULL;
+}
+
+int64_t MegaNode::getSizeDelta()
+{
+    return 0;
+}
+
 bool MegaNode::hasThumbnail()
 {
     return false;
@@ -589,11 +934,21 @@ int MegaRequest::getNumDetails() const
     return 0;
 }
 
+int MegaRequest::getNodeErrorCode(int) const
+{
+    return MegaError::API_EARGS;
+}
+
 int MegaRequest::getTag() const
 {
     return 0;
 }
 
+int64_t MegaRequest::getTiming(int) const
+{
+    return 0;
+}
+
 
 MegaTransfer::~MegaTransfer() { }
 
@@ -742,6 +1097,38 @@ int MegaTransfer::getFolderTransferTag() const
     return 0;
 }
 
+int64_t MegaTransfer::getTiming(int) const
+{
+    return 0;
+}
+
+MegaTransferProgress::~MegaTransferProgress() { }
+
+MegaTransferProgress *MegaTransferProgress::copy()
+{
+    return NULL;
+}
+
+int MegaTransferProgress::getNumTransfers(int) const
+{
+    return 0;
+}
+
+long long MegaTransferProgress::getTransferredBytes(int) const
+{
+    return 0;
+}
+
+long long MegaTransferProgress::getTotalBytes(int) const
+{
+    return 0;
+}
+
+long long MegaTransferProgress::getSpeed(int) const
+{
+    return 0;
+}
+
 
 MegaError::MegaError(int errorCode)
 {
@@ -930,8 +1317,12 @@ void MegaTransferListener::onTransferUpdate(MegaApi *, MegaTransfer *)
 { }
 bool MegaTransferListener::onTransferData(MegaApi *, MegaTransfer *, char *, size_t)
 { return true; }
+void MegaTransferListener::onTransferBuffer(MegaApi *, MegaTransfer *, int, char *, long long, size_t)
+{ }
 void MegaTransferListener::onTransferTemporaryError(MegaApi *, MegaTransfer *, MegaError*)
 { }
+void MegaTransferListener::onTransfersProgress(MegaApi *, MegaTransferProgress *)
+{ }
 MegaTransferListener::~MegaTransferListener()
 { }
 
@@ -966,6 +1357,8 @@ void MegaListener::onTransferUpdate(MegaApi *, MegaTransfer *)
 { }
 void MegaListener::onTransferTemporaryError(MegaApi *, MegaTransfer *, MegaError *)
 { }
+void MegaListener::onTransfersProgress(MegaApi *, MegaTransferProgress *)
+{ }
 void MegaListener::onUsersUpdate(MegaApi *, MegaUserList *)
 { }
 void MegaListener::onNodesUpdate(MegaApi *, MegaNodeList *)
@@ -997,6 +1390,78 @@ bool MegaTreeProcessor::processMegaNode(MegaNode*)
 MegaTreeProcessor::~MegaTreeProcessor()
 { }
 
+bool MegaNodeViewProcessor::processNodeView(MegaNodeView*)
+{ return false; /* Stops the processing */ }
+MegaNodeViewProcessor::~MegaNodeViewProcessor()
+{ }
+
+MegaNodeView::~MegaNodeView() { }
+
+MegaNode *MegaNodeView::copy()
+{
+    return NULL;
+}
+
+int MegaNodeView::getType()
+{
+    return MegaNode::TYPE_UNKNOWN;
+}
+
+const char *MegaNodeView::getName()
+{
+    return NULL;
+}
+
+MegaHandle MegaNodeView::getHandle()
+{
+    return INVALID_HANDLE;
+}
+
+MegaHandle MegaNodeView::getParentHandle()
+{
+    return INVALID_HANDLE;
+}
+
+int64_t MegaNodeView::getSize()
+{
+    return 0;
+}
+
+int64_t MegaNodeView::getCreationTime()
+{
+    return 0;
+}
+
+int64_t MegaNodeView::getModificationTime()
+{
+    return 0;
+}
+
+const char *MegaNodeView::getFingerprint()
+{
+    return NULL;
+}
+
+bool MegaNodeView::isFile()
+{
+    return false;
+}
+
+bool MegaNodeView::isFolder()
+{
+    return false;
+}
+
+bool MegaNodeView::hasThumbnail()
+{
+    return false;
+}
+
+bool MegaNodeView::hasPreview()
+{
+    return false;
+}
+
 MegaApi::MegaApi(const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent)
 {
     pImpl = new MegaApiImpl(this, appKey, processor, basePath, userAgent);
@@ -1049,6 +1514,21 @@ void MegaApi::setLoggerObject(MegaLogger *megaLogger)
     MegaApiImpl::setLoggerClass(megaLogger);
 }
 
+void MegaApi::setAsyncLogging(bool enable, int maxQueued)
+{
+    MegaApiImpl::setAsyncLogging(enable, maxQueued);
+}
+
+long long MegaApi::getDroppedLogs()
+{
+    return MegaApiImpl::getDroppedLogs();
+}
+
+void MegaApi::setEventBackend(int backend)
+{
+    MegaApiImpl::setEventBackend(backend);
+}
+
 void MegaApi::log(int logLevel, const char *message, const char *filename, int line)
 {
     MegaApiImpl::log(logLevel, message, filename, line);
@@ -1059,6 +1539,11 @@ char *MegaApi::getBase64PwKey(const char *password)
     return pImpl->getBase64PwKey(password);
 }
 
+MegaStringList *MegaApi::getBase64PwKeys(MegaStringList *passwords, int threads)
+{
+    return pImpl->getBase64PwKeys(passwords, threads);
+}
+
 char *MegaApi::getStringHash(const char* base64pwkey, const char* inBuf)
 {
     return pImpl->getStringHash(base64pwkey, inBuf);
@@ -1094,6 +1579,11 @@ void MegaApi::retryPendingConnections(bool disconnect, bool includexfers, MegaRe
     pImpl->retryPendingConnections(disconnect, includexfers, listener);
 }
 
+void MegaApi::setNetworkBatching(int maxDelayMs)
+{
+    pImpl->setNetworkBatching(maxDelayMs);
+}
+
 void MegaApi::addEntropy(char *data, unsigned int size)
 {
     MegaApiImpl::addEntropy(data, size);
@@ -1189,6 +1679,16 @@ void MegaApi::moveNode(MegaNode *node, MegaNode *newParent, MegaRequestListener
     pImpl->moveNode(node, newParent, listener);
 }
 
+void MegaApi::moveNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener)
+{
+    pImpl->moveNodes(nodes, newParent, listener);
+}
+
+void MegaApi::copyNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener)
+{
+    pImpl->copyNodes(nodes, newParent, listener);
+}
+
 void MegaApi::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener *listener)
 {
     pImpl->copyNode(node, target, listener);
@@ -1209,6 +1709,11 @@ void MegaApi::remove(MegaNode *node, MegaRequestListener *listener)
     pImpl->remove(node, listener);
 }
 
+void MegaApi::removeNodes(MegaNodeList *nodes, MegaRequestListener *listener)
+{
+    pImpl->removeNodes(nodes, listener);
+}
+
 void MegaApi::cleanRubbishBin(MegaRequestListener *listener)
 {
     pImpl->cleanRubbishBin(listener);
@@ -1274,6 +1779,11 @@ void MegaApi::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
 	pImpl->cancelGetPreview(node, listener);
 }
 
+void MegaApi::prefetchThumbnails(MegaNodeList *nodes, int priority, MegaRequestListener *listener)
+{
+    pImpl->prefetchThumbnails(nodes, priority, listener);
+}
+
 void MegaApi::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
 {
     pImpl->setPreview(node, srcFilePath, listener);
@@ -1314,6 +1824,11 @@ void MegaApi::setCustomNodeAttribute(MegaNode *node, const char *attrName, const
     pImpl->setCustomNodeAttribute(node, attrName, value, listener);
 }
 
+void MegaApi::setCustomNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    pImpl->setCustomNodesAttribute(nodes, attrName, value, listener);
+}
+
 void MegaApi::exportNode(MegaNode *node, MegaRequestListener *listener)
 {
     pImpl->exportNode(node, 0, listener);
@@ -1344,6 +1859,11 @@ void MegaApi::getExtendedAccountDetails(bool sessions, bool purchases, bool tran
     pImpl->getAccountDetails(true, true, true, sessions, purchases, transactions, listener);
 }
 
+void MegaApi::setAccountDetailsCacheTtl(int seconds)
+{
+    pImpl->setAccountDetailsCacheTtl(seconds);
+}
+
 void MegaApi::getPricing(MegaRequestListener *listener)
 {
     pImpl->getPricing(listener);
@@ -1470,6 +1990,81 @@ void MegaApi::setUploadLimit(int bpslimit)
     pImpl->setUploadLimit(bpslimit);
 }
 
+void MegaApi::setTransferConnections(int direction, int minConnections, int maxConnections)
+{
+    pImpl->setTransferConnections(direction, minConnections, maxConnections);
+}
+
+void MegaApi::setTransferLimits(int direction, int maxTransfers, long long maxBytesInFlight, int maxConnections)
+{
+    pImpl->setTransferLimits(direction, maxTransfers, maxBytesInFlight, maxConnections);
+}
+
+void MegaApi::setUploadNodeBatching(bool enable)
+{
+    pImpl->setUploadNodeBatching(enable);
+}
+
+void MegaApi::setUploadQueueLimit(int limit)
+{
+    pImpl->setUploadQueueLimit(limit);
+}
+
+void MegaApi::setPersistentTransferQueue(bool enable)
+{
+    pImpl->setPersistentTransferQueue(enable);
+}
+
+void MegaApi::setDownloadWriteBuffer(long long maxBufferedBytes)
+{
+    pImpl->setDownloadWriteBuffer(maxBufferedBytes);
+}
+
+void MegaApi::setBandwidthLimit(int direction, long long bytesPerSecond)
+{
+    pImpl->setBandwidthLimit(direction, bytesPerSecond);
+}
+
+void MegaApi::setBandwidthClassLimit(int direction, int priority, long long bytesPerSecond)
+{
+    pImpl->setBandwidthClassLimit(direction, priority, bytesPerSecond);
+}
+
+void MegaApi::addBandwidthSchedule(int direction, int startMinute, int endMinute, long long bytesPerSecond)
+{
+    pImpl->addBandwidthSchedule(direction, startMinute, endMinute, bytesPerSecond);
+}
+
+void MegaApi::clearBandwidthSchedules(int direction)
+{
+    pImpl->clearBandwidthSchedules(direction);
+}
+
+void MegaApi::setNodeDecryptionThreads(int threads)
+{
+    pImpl->setNodeDecryptionThreads(threads);
+}
+
+void MegaApi::setTransferCryptoThreads(int threads)
+{
+    pImpl->setTransferCryptoThreads(threads);
+}
+
+void MegaApi::setSyncScanThreads(int threads)
+{
+    pImpl->setSyncScanThreads(threads);
+}
+
+void MegaApi::setWorkerThreads(int threads)
+{
+    pImpl->setWorkerThreads(threads);
+}
+
+void MegaApi::setNodeUpdateCoalescing(int milliseconds, int maxBatchSize)
+{
+    pImpl->setNodeUpdateCoalescing(milliseconds, maxBatchSize);
+}
+
 void MegaApi::setDownloadMethod(int method)
 {
     pImpl->setDownloadMethod(method);
@@ -1480,6 +2075,66 @@ void MegaApi::setUploadMethod(int method)
     pImpl->setUploadMethod(method);
 }
 
+bool MegaApi::setHttp2(bool enable)
+{
+    return pImpl->setHttp2(enable);
+}
+
+bool MegaApi::setRequestCompression(bool enable)
+{
+    return pImpl->setRequestCompression(enable);
+}
+
+long long MegaApi::getCompressionStats(int type)
+{
+    return pImpl->getCompressionStats(type);
+}
+
+void MegaApi::setCallbackThread(bool enable, int maxPending)
+{
+    pImpl->setCallbackThread(enable, maxPending);
+}
+
+long long MegaApi::getCallbackStats(int type)
+{
+    return pImpl->getCallbackStats(type);
+}
+
+void MegaApi::setTransferUpdateInterval(int ms)
+{
+    pImpl->setTransferUpdateInterval(ms);
+}
+
+void MegaApi::setTransfersProgressInterval(int ms)
+{
+    pImpl->setTransfersProgressInterval(ms);
+}
+
+char *MegaApi::getStorageHostStats()
+{
+    return pImpl->getStorageHostStats();
+}
+
+char *MegaApi::getMetrics()
+{
+    return pImpl->getMetrics();
+}
+
+void MegaApi::setTracing(bool enable, int maxEvents)
+{
+    pImpl->setTracing(enable, maxEvents);
+}
+
+char *MegaApi::getTrace()
+{
+    return pImpl->getTrace();
+}
+
+void MegaApi::setWatchdog(int thresholdMs)
+{
+    pImpl->setWatchdog(thresholdMs);
+}
+
 int MegaApi::getDownloadMethod()
 {
     return pImpl->getDownloadMethod();
@@ -1505,6 +2160,31 @@ MegaTransferList *MegaApi::getTransfers(int type)
     return pImpl->getTransfers(type);
 }
 
+MegaTransferList *MegaApi::getTransfers(int type, int fromTag, int limit)
+{
+    return pImpl->getTransfers(type, fromTag, limit);
+}
+
+int MegaApi::getNumTransfers(int type)
+{
+    return pImpl->getNumTransfers(type);
+}
+
+int MegaApi::getNumTransfersInProgress(int type)
+{
+    return pImpl->getNumTransfersInProgress(type);
+}
+
+long long MegaApi::getTransfersSequence()
+{
+    return pImpl->getTransfersSequence();
+}
+
+MegaTransferList *MegaApi::getTransfersChangedSince(long long sequence)
+{
+    return pImpl->getTransfersChangedSince(sequence);
+}
+
 MegaTransferList *MegaApi::getChildTransfers(int transferTag)
 {
     return pImpl->getChildTransfers(transferTag);
@@ -1530,6 +2210,16 @@ void MegaApi::startUpload(const char *localPath, MegaNode *parent, const char *f
     pImpl->startUpload(localPath, parent, fileName, mtime, 0, listener);
 }
 
+void MegaApi::startUploadWithFingerprint(const char *localPath, MegaNode *parent, const char *fingerprint, const char *fileName, int64_t mtime, MegaTransferListener *listener)
+{
+    pImpl->startUploadWithFingerprint(localPath, parent, fingerprint, fileName, mtime, listener);
+}
+
+void MegaApi::startUploads(MegaUploadBatch *uploads, bool copyDuplicates, MegaTransferListener *listener)
+{
+    pImpl->startUploads(uploads, copyDuplicates, listener);
+}
+
 void MegaApi::startDownload(MegaNode *node, const char* localFolder, MegaTransferListener *listener)
 {
     pImpl->startDownload(node, localFolder, listener);
@@ -1545,16 +2235,71 @@ void MegaApi::cancelTransferByTag(int transferTag, MegaRequestListener *listener
     pImpl->cancelTransferByTag(transferTag, listener);
 }
 
+void MegaApi::setTransferPriority(int transferTag, int priority, MegaRequestListener *listener)
+{
+    pImpl->setTransferPriority(transferTag, priority, listener);
+}
+
+void MegaApi::moveTransferToFirst(int transferTag, MegaRequestListener *listener)
+{
+    pImpl->moveTransferToFirst(transferTag, listener);
+}
+
+void MegaApi::moveTransferToLast(int transferTag, MegaRequestListener *listener)
+{
+    pImpl->moveTransferToLast(transferTag, listener);
+}
+
+void MegaApi::moveTransferBefore(int transferTag, int nextTransferTag, MegaRequestListener *listener)
+{
+    pImpl->moveTransferBefore(transferTag, nextTransferTag, listener);
+}
+
 void MegaApi::cancelTransfers(int direction, MegaRequestListener *listener)
 {
     pImpl->cancelTransfers(direction, listener);
 }
 
+void MegaApi::startDownloadToStream(MegaNode *node, MegaOutputStream *stream, MegaTransferListener *listener)
+{
+    pImpl->startDownloadToStream(node, stream, listener);
+}
+
 void MegaApi::startStreaming(MegaNode* node, int64_t startPos, int64_t size, MegaTransferListener *listener)
 {
     pImpl->startStreaming(node, startPos, size, listener);
 }
 
+void MegaApi::startStreamingToBuffers(MegaNode *node, int64_t startPos, int64_t size, char **buffers, int numBuffers, size_t bufferSize, MegaTransferListener *listener)
+{
+    pImpl->startStreamingToBuffers(node, startPos, size, buffers, numBuffers, bufferSize, listener);
+}
+
+void MegaApi::releaseStreamingBuffer(int transferTag, int buffer)
+{
+    pImpl->releaseStreamingBuffer(transferTag, buffer);
+}
+
+MegaFileHandle *MegaApi::openFile(MegaNode *node)
+{
+    return pImpl->openFile(node);
+}
+
+void MegaApi::readFile(MegaFileHandle *file, int64_t offset, int64_t size, MegaTransferListener *listener)
+{
+    pImpl->readFile(file, offset, size, listener);
+}
+
+void MegaApi::prefetch(MegaNode *node, int64_t offset, int64_t size, int priority)
+{
+    pImpl->prefetch(node, offset, size, priority);
+}
+
+void MegaApi::cancelPrefetch(MegaNode *node)
+{
+    pImpl->cancelPrefetch(node);
+}
+
 #ifdef ENABLE_SYNC
 
 //Move local files inside synced folders to the "Rubbish" folder.
@@ -1623,6 +2368,11 @@ bool MegaApi::isScanning()
     return pImpl->isIndexing();
 }
 
+long long MegaApi::getSyncStats(MegaSync *sync, int type)
+{
+    return sync ? pImpl->getSyncStats(sync->getTag(), type) : -1;
+}
+
 bool MegaApi::isSynced(MegaNode *n)
 {
     return pImpl->isSynced(n);
@@ -1795,6 +2545,21 @@ bool MegaApi::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool re
     return pImpl->processMegaTree(n, processor, recursive);
 }
 
+bool MegaApi::processNodeViews(MegaNode* n, MegaNodeViewProcessor* processor, bool recursive)
+{
+    return pImpl->processNodeViews(n, processor, recursive);
+}
+
+bool MegaApi::processChildViews(MegaNode* parent, MegaNodeViewProcessor* processor, int order)
+{
+    return pImpl->processChildViews(parent, processor, order);
+}
+
+MegaHandleList *MegaApi::queryNodes(MegaNode *node, MegaNodeQuery *query, int offset, int limit)
+{
+    return pImpl->queryNodes(node, query, offset, limit);
+}
+
 MegaNode *MegaApi::createPublicFileNode(MegaHandle handle, const char *key,
                                     const char *name, int64_t size, int64_t mtime,
                                         MegaHandle parentHandle, const char *auth)
@@ -1868,11 +2633,101 @@ MegaNodeList* MegaApi::search(MegaNode* n, const char* searchString, bool recurs
     return pImpl->search(n, searchString, recursive);
 }
 
+MegaNodeList* MegaApi::search(MegaNode* n, const char* searchString, int matchType, int limit, bool recursive)
+{
+    return pImpl->search(n, searchString, matchType, limit, recursive);
+}
+
+void MegaApi::enableNameIndex(bool enable)
+{
+    pImpl->enableNameIndex(enable);
+}
+
+bool MegaApi::isNameIndexEnabled()
+{
+    return pImpl->isNameIndexEnabled();
+}
+
 long long MegaApi::getSize(MegaNode *n)
 {
     return pImpl->getSize(n);
 }
 
+int MegaApi::getNumTreeFiles(MegaNode *n)
+{
+    return pImpl->getNumTreeFiles(n);
+}
+
+int MegaApi::getNumTreeFolders(MegaNode *n)
+{
+    return pImpl->getNumTreeFolders(n);
+}
+
+long long MegaApi::getMemoryUsage(int type)
+{
+    return pImpl->getMemoryUsage(type);
+}
+
+long long MegaApi::getTransferBufferPoolStats(int type)
+{
+    return pImpl->getTransferBufferPoolStats(type);
+}
+
+void MegaApi::setStreamingCacheSize(long long bytes)
+{
+    pImpl->setStreamingCacheSize(bytes);
+}
+
+void MegaApi::setStreamingConnections(int connections)
+{
+    pImpl->setStreamingConnections(connections);
+}
+
+bool MegaApi::httpServerStart(bool localOnly, int port)
+{
+    return pImpl->httpServerStart(localOnly, port);
+}
+
+void MegaApi::httpServerStop()
+{
+    pImpl->httpServerStop();
+}
+
+int MegaApi::httpServerIsRunning()
+{
+    return pImpl->httpServerIsRunning();
+}
+
+char *MegaApi::httpServerGetLocalLink(MegaNode *node)
+{
+    return pImpl->httpServerGetLocalLink(node);
+}
+
+long long MegaApi::getStreamingCacheStats(int type)
+{
+    return pImpl->getStreamingCacheStats(type);
+}
+
+long long MegaApi::getKeyResolutionStats(int type)
+{
+    return pImpl->getKeyResolutionStats(type);
+}
+
+long long MegaApi::onLowMemory(int level)
+{
+    return pImpl->onLowMemory(level);
+}
+
+void MegaApi::setNodePaging(bool enable)
+{
+    pImpl->setNodePaging(enable);
+}
+
+void MegaApi::setOfflineStartup(bool enable)
+{
+    pImpl->setOfflineStartup(enable);
+}
+
 char *MegaApi::getFingerprint(const char *filePath)
 {
     return pImpl->getFingerprint(filePath);
@@ -2035,6 +2890,21 @@ MegaNodeList *MegaApi::getChildren(MegaNode* p, int order)
     return pImpl->getChildren(p, order);
 }
 
+MegaNodeList *MegaApi::getChildren(MegaNode *p, int order, int offset, int limit)
+{
+    return pImpl->getChildren(p, order, offset, limit);
+}
+
+MegaChildrenCursor *MegaApi::getChildrenCursor(MegaNode *p, int order)
+{
+    return pImpl->getChildrenCursor(p, order);
+}
+
+MegaNodeSnapshot *MegaApi::getNodeSnapshot(MegaNode *node, int order)
+{
+    return pImpl->getNodeSnapshot(node, order);
+}
+
 int MegaApi::getIndex(MegaNode *node, int order)
 {
     return pImpl->getIndex(node, order);
@@ -2203,6 +3073,48 @@ bool MegaHashSignature::checkSignature(const char *base64Signature)
     return pImpl->checkSignature(base64Signature);
 }
 
+MegaFolderLinkSession::~MegaFolderLinkSession() { }
+
+int MegaFolderLinkSession::getState()
+{
+    return STATE_FAILED;
+}
+
+int MegaFolderLinkSession::waitReady()
+{
+    return STATE_FAILED;
+}
+
+MegaNodeSnapshot *MegaFolderLinkSession::getNodes()
+{
+    return NULL;
+}
+
+void MegaFolderLinkSession::startStreaming(MegaNode *, int64_t, int64_t, MegaTransferListener *)
+{
+
+}
+
+MegaFolderLinkStore::MegaFolderLinkStore(const char *appKey, const char *userAgent)
+{
+    pImpl = new MegaFolderLinkStoreImpl(appKey, userAgent);
+}
+
+MegaFolderLinkStore::~MegaFolderLinkStore()
+{
+    delete pImpl;
+}
+
+MegaFolderLinkSession *MegaFolderLinkStore::openSession(const char *megaFolderLink)
+{
+    return pImpl->openSession(megaFolderLink);
+}
+
+int MegaFolderLinkStore::getNumFolders()
+{
+    return pImpl->getNumFolders();
+}
+
 MegaAccountDetails::~MegaAccountDetails() { }
 
 int MegaAccountDetails::getProLevel()
@@ -2448,6 +3360,11 @@ int MegaSync::getState() const
     return MegaSync::SYNC_FAILED;
 }
 
+long long MegaSync::getStats(int) const
+{
+    return -1;
+}
+
 
 void MegaSyncListener::onSyncFileStateChanged(MegaApi *, MegaSync *, const char *, int )
 { }
@@ -2633,3 +3550,13 @@ MegaInputStream::~MegaInputStream()
 {
 
 }
+
+bool MegaOutputStream::write(const char *buffer, size_t size)
+{
+    return false;
+}
+
+MegaOutputStream::~MegaOutputStream()
+{
+
+}
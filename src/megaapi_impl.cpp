@@ -36,6 +36,7 @@
 #include <algorithm>
 #include <functional>
 #include <cctype>
+#include <climits>
 #include <locale>
 
 #ifndef _WIN32
@@ -43,6 +44,14 @@
     #define _LARGEFILE64_SOURCE
 #endif
 #include <signal.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 
@@ -84,6 +93,9 @@ MegaNodePrivate::MegaNodePrivate(const char *name, int type, int64_t size, int64
     this->attrstring.assign(attrstring->data(), attrstring->size());
     this->nodekey.assign(nodekey->data(),nodekey->size());
     this->changed = 0;
+    this->prevParentHandle = INVALID_HANDLE;
+    this->prevName = NULL;
+    this->sizeDelta = 0;
     this->thumbnailAvailable = false;
     this->previewAvailable = false;
     this->tag = 0;
@@ -118,6 +130,9 @@ MegaNodePrivate::MegaNodePrivate(MegaNode *node)
     string *nodekey = node->getNodeKey();
     this->nodekey.assign(nodekey->data(),nodekey->size());
     this->changed = node->getChanges();
+    this->prevParentHandle = node->getPreviousParentHandle();
+    this->prevName = MegaApi::strdup(node->getPreviousName());
+    this->sizeDelta = node->getSizeDelta();
     this->thumbnailAvailable = node->hasThumbnail();
     this->previewAvailable = node->hasPreview();
     this->tag = node->getTag();
@@ -223,6 +238,30 @@ MegaNodePrivate::MegaNodePrivate(Node *node)
         this->changed |= MegaNode::CHANGE_TYPE_REMOVED;
     }
 
+    this->prevParentHandle = INVALID_HANDLE;
+    this->prevName = NULL;
+    this->sizeDelta = 0;
+    if (node->notified)
+    {
+        map<handle, NodeDelta>::iterator it = node->client->nodedeltas.find(node->nodehandle);
+        if (it != node->client->nodedeltas.end())
+        {
+            this->prevParentHandle = it->second.parenthandle;
+            this->prevName = MegaApi::strdup(it->second.name.c_str());
+            this->sizeDelta = (node->changed.removed ? 0 : node->subtree.storage) - it->second.storage;
+        }
+        else if (this->changed)
+        {
+            // changes that don't affect the location, name or size
+            this->prevParentHandle = this->parenthandle;
+            this->prevName = MegaApi::strdup(this->name);
+        }
+        else
+        {
+            // new node
+            this->sizeDelta = node->subtree.storage;
+        }
+    }
 
 #ifdef ENABLE_SYNC
 	this->syncdeleted = (node->syncdeleted != SYNCDEL_NONE);
@@ -238,9 +277,9 @@ MegaNodePrivate::MegaNodePrivate(Node *node)
     this->tag = node->tag;
     this->isPublicNode = false;
     // if there's only one share and it has no user --> public link
-    this->outShares = (node->outshares) ? (node->outshares->size() > 1 || node->outshares->begin()->second->user) : false;
-    this->inShare = (node->inshare != NULL) && !node->parent;
-    this->plink = node->plink ? new PublicLink(node->plink) : NULL;
+    this->outShares = (node->outshares()) ? (node->outshares()->size() > 1 || node->outshares()->begin()->second->user) : false;
+    this->inShare = (node->inshare() != NULL) && !node->parent;
+    this->plink = node->plink() ? new PublicLink(node->plink()) : NULL;
 }
 
 MegaNode *MegaNodePrivate::copy()
@@ -248,6 +287,104 @@ MegaNode *MegaNodePrivate::copy()
 	return new MegaNodePrivate(this);
 }
 
+MegaNodeViewPrivate::MegaNodeViewPrivate()
+{
+    node = NULL;
+    fingerprintValid = false;
+}
+
+void MegaNodeViewPrivate::setNode(Node *node)
+{
+    this->node = node;
+    fingerprintValid = false;
+}
+
+MegaNode *MegaNodeViewPrivate::copy()
+{
+    return MegaNodePrivate::fromNode(node);
+}
+
+int MegaNodeViewPrivate::getType()
+{
+    return node->type;
+}
+
+const char *MegaNodeViewPrivate::getName()
+{
+    switch(node->type)
+    {
+        case ROOTNODE:
+            return "Cloud Drive";
+        case INCOMINGNODE:
+            return "Inbox";
+        case RUBBISHNODE:
+            return "Rubbish Bin";
+        default:
+            return node->displayname();
+    }
+}
+
+MegaHandle MegaNodeViewPrivate::getHandle()
+{
+    return node->nodehandle;
+}
+
+MegaHandle MegaNodeViewPrivate::getParentHandle()
+{
+    return node->parent ? node->parent->nodehandle : INVALID_HANDLE;
+}
+
+int64_t MegaNodeViewPrivate::getSize()
+{
+    return node->size;
+}
+
+int64_t MegaNodeViewPrivate::getCreationTime()
+{
+    return node->ctime;
+}
+
+int64_t MegaNodeViewPrivate::getModificationTime()
+{
+    return node->mtime;
+}
+
+const char *MegaNodeViewPrivate::getFingerprint()
+{
+    if(node->type != FILENODE || node->size < 0 || !node->isvalid)
+    {
+        return NULL;
+    }
+
+    if(!fingerprintValid)
+    {
+        MegaApiImpl::getNodeFingerprint(node, &fingerprint);
+        fingerprintValid = true;
+    }
+
+    return fingerprint.c_str();
+}
+
+bool MegaNodeViewPrivate::isFile()
+{
+    return node->type == FILENODE;
+}
+
+bool MegaNodeViewPrivate::isFolder()
+{
+    return node->type != FILENODE && node->type != TYPE_UNKNOWN;
+}
+
+bool MegaNodeViewPrivate::hasThumbnail()
+{
+    return node->hasfileattribute(0) != 0;
+}
+
+bool MegaNodeViewPrivate::hasPreview()
+{
+    return node->hasfileattribute(1) != 0;
+}
+
 char *MegaNodePrivate::getBase64Handle()
 {
     char *base64Handle = new char[12];
@@ -460,6 +597,30 @@ int MegaNodePrivate::getChanges()
     return changed;
 }
 
+void MegaNodePrivate::mergeChanges(MegaNodePrivate *previous)
+{
+    changed |= previous->changed;
+    prevParentHandle = previous->prevParentHandle;
+    delete [] prevName;
+    prevName = MegaApi::strdup(previous->prevName);
+    sizeDelta += previous->sizeDelta;
+}
+
+MegaHandle MegaNodePrivate::getPreviousParentHandle()
+{
+    return prevParentHandle;
+}
+
+const char *MegaNodePrivate::getPreviousName()
+{
+    return prevName;
+}
+
+int64_t MegaNodePrivate::getSizeDelta()
+{
+    return sizeDelta;
+}
+
 
 const unsigned int MegaApiImpl::MAX_SESSION_LENGTH = 64;
 
@@ -606,6 +767,76 @@ bool MegaApiImpl::isIndexing()
     sdkMutex.unlock();
     return indexing;
 }
+
+long long MegaApiImpl::getSyncStats(int tag, int type)
+{
+    long long value = -1;
+
+    sdkMutex.lock();
+    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+    {
+        if ((*it)->tag == tag)
+        {
+            value = getSyncStats(*it, type);
+            break;
+        }
+    }
+    sdkMutex.unlock();
+
+    return value;
+}
+
+long long MegaApiImpl::getSyncStats(Sync *sync, int type)
+{
+    SyncMetrics *m = &sync->metrics;
+
+    switch (type)
+    {
+        case MegaApi::SYNC_STATS_NOTIFICATIONS_PENDING:
+            return sync->dirnotify->notifyq[DirNotify::DIREVENTS].size()
+                 + sync->dirnotify->notifyq[DirNotify::RETRY].size();
+        case MegaApi::SYNC_STATS_SCANNED:
+            return m->scanitems;
+        case MegaApi::SYNC_STATS_SCAN_TIME:
+            return m->scantime;
+        case MegaApi::SYNC_STATS_FULL_SCANS:
+            return m->fullscans;
+        case MegaApi::SYNC_STATS_FULL_SCAN_DURATION:
+            return m->fullscands * 100LL;
+        case MegaApi::SYNC_STATS_FILES:
+            return sync->localnodes[FILENODE];
+        case MegaApi::SYNC_STATS_FOLDERS:
+            return sync->localnodes[FOLDERNODE];
+        case MegaApi::SYNC_STATS_PUTNODES_PENDING:
+            return m->putnodespending;
+        case MegaApi::SYNC_STATS_UPLOADS:
+            return m->uploads;
+        case MegaApi::SYNC_STATS_DOWNLOADS:
+            return m->downloads;
+        case MegaApi::SYNC_STATS_LOCAL_DEBRIS:
+            return m->localdebris;
+        case MegaApi::SYNC_STATS_REMOTE_DEBRIS:
+            return m->remotedebris;
+        case MegaApi::SYNC_STATS_SYNCDOWN_PASSES:
+            return m->syncdown.passes;
+        case MegaApi::SYNC_STATS_SYNCDOWN_TIME:
+            return m->syncdown.total;
+        case MegaApi::SYNC_STATS_SYNCDOWN_LAST:
+            return m->syncdown.last;
+        case MegaApi::SYNC_STATS_SYNCDOWN_MAX:
+            return m->syncdown.max;
+        case MegaApi::SYNC_STATS_SYNCUP_PASSES:
+            return m->syncup.passes;
+        case MegaApi::SYNC_STATS_SYNCUP_TIME:
+            return m->syncup.total;
+        case MegaApi::SYNC_STATS_SYNCUP_LAST:
+            return m->syncup.last;
+        case MegaApi::SYNC_STATS_SYNCUP_MAX:
+            return m->syncup.max;
+    }
+
+    return -1;
+}
 #endif
 
 bool MegaNodePrivate::hasThumbnail()
@@ -661,6 +892,7 @@ string *MegaNodePrivate::getAuth()
 MegaNodePrivate::~MegaNodePrivate()
 {
  	delete[] name;
+    delete[] prevName;
     delete customAttrs;
     delete plink;
 }
@@ -831,6 +1063,14 @@ MegaTransferPrivate::MegaTransferPrivate(int type, MegaTransferListener *listene
     this->syncTransfer = false;
     this->lastError = API_OK;
     this->folderTransferTag = 0;
+    this->streamingRing = NULL;
+    this->outputStream = NULL;
+    this->queueRecord = 0;
+    this->updateSequence = 0;
+    this->reportedBytes = 0;
+    this->reportedTime = 0;
+    memset(timings, 0, sizeof timings);
+    timings[TIMING_QUEUED] = MegaSdkMutex::now();
 }
 
 MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
@@ -840,6 +1080,10 @@ MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
     fileName = NULL;
     publicNode = NULL;
 	lastBytes = NULL;
+    streamingRing = NULL;
+    outputStream = NULL;
+    reportedBytes = 0;
+    reportedTime = 0;
 
     this->listener = transfer->getListener();
     this->transfer = transfer->getTransfer();
@@ -866,6 +1110,9 @@ MegaTransferPrivate::MegaTransferPrivate(const MegaTransferPrivate *transfer)
     this->setSyncTransfer(transfer->isSyncTransfer());
     this->setLastErrorCode(transfer->getLastErrorCode());
     this->setFolderTransferTag(transfer->getFolderTransferTag());
+    this->setQueueRecord(transfer->getQueueRecord());
+    this->setUpdateSequence(transfer->getUpdateSequence());
+    memcpy(timings, transfer->timings, sizeof timings);
 }
 
 MegaTransfer* MegaTransferPrivate::copy()
@@ -1018,6 +1265,37 @@ int MegaTransferPrivate::getFolderTransferTag() const
     return this->folderTransferTag;
 }
 
+void MegaTransferPrivate::setReported(long long bytes, int64_t time)
+{
+    reportedBytes = bytes;
+    reportedTime = time;
+}
+
+long long MegaTransferPrivate::getReportedBytes() const
+{
+    return reportedBytes;
+}
+
+int64_t MegaTransferPrivate::getReportedTime() const
+{
+    return reportedTime;
+}
+
+void MegaTransferPrivate::setTiming(int phase)
+{
+    timings[phase] = MegaSdkMutex::now();
+}
+
+int64_t MegaTransferPrivate::getTiming(int phase) const
+{
+    if (phase < TIMING_QUEUED || phase > TIMING_CALLBACK)
+    {
+        return 0;
+    }
+
+    return timings[phase];
+}
+
 void MegaTransferPrivate::setTag(int tag)
 {
 	this->tag = tag;
@@ -1083,6 +1361,63 @@ void MegaTransferPrivate::setFolderTransferTag(int tag)
     this->folderTransferTag = tag;
 }
 
+void MegaTransferPrivate::setStreamingRing(MegaStreamingRing *ring)
+{
+    this->streamingRing = ring;
+}
+
+MegaStreamingRing *MegaTransferPrivate::getStreamingRing() const
+{
+    return streamingRing;
+}
+
+void MegaTransferPrivate::setOutputStream(MegaOutputStream *stream)
+{
+    this->outputStream = stream;
+}
+
+MegaOutputStream *MegaTransferPrivate::getOutputStream() const
+{
+    return outputStream;
+}
+
+void MegaTransferPrivate::setQueueRecord(uint32_t record)
+{
+    queueRecord = record;
+}
+
+uint32_t MegaTransferPrivate::getQueueRecord() const
+{
+    return queueRecord;
+}
+
+void MegaTransferPrivate::setUpdateSequence(long long sequence)
+{
+    updateSequence = sequence;
+}
+
+long long MegaTransferPrivate::getUpdateSequence() const
+{
+    return updateSequence;
+}
+
+void MegaTransferPrivate::setKnownFingerprint(FileFingerprint *fingerprint)
+{
+    if (fingerprint)
+    {
+        knownFingerprint = *fingerprint;
+    }
+    else
+    {
+        knownFingerprint.isvalid = false;
+    }
+}
+
+FileFingerprint *MegaTransferPrivate::getKnownFingerprint()
+{
+    return knownFingerprint.isvalid ? &knownFingerprint : NULL;
+}
+
 void MegaTransferPrivate::setPath(const char* path)
 {
 	if(this->path) delete [] this->path;
@@ -1192,6 +1527,42 @@ const char *MegaTransferPrivate::__toString() const
 	return getTransferString();
 }
 
+MegaTransferProgressPrivate::MegaTransferProgressPrivate()
+{
+    for (int i = 0; i < 2; i++)
+    {
+        numTransfers[i] = 0;
+        transferredBytes[i] = 0;
+        totalBytes[i] = 0;
+        speed[i] = 0;
+    }
+}
+
+MegaTransferProgress *MegaTransferProgressPrivate::copy()
+{
+    return new MegaTransferProgressPrivate(*this);
+}
+
+int MegaTransferProgressPrivate::getNumTransfers(int type) const
+{
+    return (type == MegaTransfer::TYPE_DOWNLOAD || type == MegaTransfer::TYPE_UPLOAD) ? numTransfers[type] : 0;
+}
+
+long long MegaTransferProgressPrivate::getTransferredBytes(int type) const
+{
+    return (type == MegaTransfer::TYPE_DOWNLOAD || type == MegaTransfer::TYPE_UPLOAD) ? transferredBytes[type] : 0;
+}
+
+long long MegaTransferProgressPrivate::getTotalBytes(int type) const
+{
+    return (type == MegaTransfer::TYPE_DOWNLOAD || type == MegaTransfer::TYPE_UPLOAD) ? totalBytes[type] : 0;
+}
+
+long long MegaTransferProgressPrivate::getSpeed(int type) const
+{
+    return (type == MegaTransfer::TYPE_DOWNLOAD || type == MegaTransfer::TYPE_UPLOAD) ? speed[type] : 0;
+}
+
 MegaContactRequestPrivate::MegaContactRequestPrivate(PendingContactRequest *request)
 {
     handle = request->id;
@@ -1346,6 +1717,8 @@ MegaRequestPrivate::MegaRequestPrivate(int type, MegaRequestListener *listener)
     this->totalBytes = -1;
     this->transferredBytes = 0;
     this->number = 0;
+    memset(timings, 0, sizeof timings);
+    timings[TIMING_QUEUED] = MegaSdkMutex::now();
 
     if(type == MegaRequest::TYPE_ACCOUNT_DETAILS)
     {
@@ -1409,6 +1782,8 @@ MegaRequestPrivate::MegaRequestPrivate(MegaRequestPrivate *request)
     this->syncListener = request->getSyncListener();
 #endif
     this->megaPricing = (MegaPricingPrivate *)request->getPricing();
+    this->nodeErrors = request->nodeErrors;
+    memcpy(timings, request->timings, sizeof timings);
 
     this->accountDetails = NULL;
     if(request->getAccountDetails())
@@ -1570,6 +1945,21 @@ MegaPricing *MegaRequestPrivate::getPricing() const
     return megaPricing ? megaPricing->copy() : NULL;
 }
 
+void MegaRequestPrivate::setTiming(int phase, int64_t time)
+{
+    timings[phase] = time ? time : MegaSdkMutex::now();
+}
+
+int64_t MegaRequestPrivate::getTiming(int phase) const
+{
+    if (phase < TIMING_QUEUED || phase > TIMING_CALLBACK)
+    {
+        return 0;
+    }
+
+    return timings[phase];
+}
+
 void MegaRequestPrivate::setNumDetails(int numDetails)
 {
 	this->numDetails = numDetails;
@@ -1712,6 +2102,80 @@ void MegaRequestPrivate::setTag(int tag)
     this->tag = tag;
 }
 
+void MegaRequestPrivate::setNodeHandles(MegaNodeList *nodes)
+{
+    nodeHandles.clear();
+    if(!nodes) return;
+
+    nodeHandles.reserve(nodes->size());
+    for(int i = 0; i < nodes->size(); i++)
+    {
+        nodeHandles.push_back(nodes->get(i)->getHandle());
+    }
+}
+
+const handle_vector& MegaRequestPrivate::getNodeHandles() const
+{
+    return nodeHandles;
+}
+
+// the progress is kept in totalBytes / transferredBytes and the failures in
+// numDetails, as for thumbnail prefetches
+void MegaRequestPrivate::initNodeResults()
+{
+    nodeErrors.assign(nodeHandles.size(), API_EINCOMPLETE);
+    pendingNodes.clear();
+    totalBytes = nodeHandles.size();
+    transferredBytes = 0;
+    numDetails = 0;
+
+    for (size_t i = 0; i < nodeHandles.size(); i++)
+    {
+        if (!pendingNodes.insert(pair<handle, size_t>(nodeHandles[i], i)).second)
+        {
+            nodeErrors[i] = API_EARGS;
+            transferredBytes++;
+            numDetails++;
+        }
+    }
+}
+
+bool MegaRequestPrivate::setNodeResult(handle h, error e)
+{
+    map<handle, size_t>::iterator it = pendingNodes.find(h);
+
+    if (it == pendingNodes.end())
+    {
+        return false;
+    }
+
+    nodeErrors[it->second] = e;
+    pendingNodes.erase(it);
+    transferredBytes++;
+
+    if (e)
+    {
+        numDetails++;
+    }
+
+    return true;
+}
+
+bool MegaRequestPrivate::hasPendingNodes() const
+{
+    return !pendingNodes.empty();
+}
+
+int MegaRequestPrivate::getNodeErrorCode(int i) const
+{
+    if (i < 0 || (size_t)i >= nodeErrors.size())
+    {
+        return API_EARGS;
+    }
+
+    return nodeErrors[i];
+}
+
 void MegaRequestPrivate::addProduct(handle product, int proLevel, int gbStorage, int gbTransfer, int months, int amount, const char *currency, const char* description, const char* iosid, const char* androidid)
 {
     if(megaPricing)
@@ -1787,6 +2251,13 @@ const char *MegaRequestPrivate::getRequestString() const
         case TYPE_SEND_EVENT: return "SEND_EVENT";
         case TYPE_CLEAN_RUBBISH_BIN: return "CLEAN_RUBBISH_BIN";
         case TYPE_SET_ATTR_NODE: return "SET_ATTR_NODE";
+        case TYPE_SET_TRANSFER_PRIORITY: return "SET_TRANSFER_PRIORITY";
+        case TYPE_MOVE_TRANSFER: return "MOVE_TRANSFER";
+        case TYPE_PREFETCH_THUMBNAILS: return "PREFETCH_THUMBNAILS";
+        case TYPE_MOVE_NODES: return "MOVE_NODES";
+        case TYPE_COPY_NODES: return "COPY_NODES";
+        case TYPE_REMOVE_NODES: return "REMOVE_NODES";
+        case TYPE_SET_ATTR_NODES: return "SET_ATTR_NODES";
 	}
     return "UNKNOWN";
 }
@@ -1894,6 +2365,17 @@ MegaNodeListPrivate::MegaNodeListPrivate(Node** newlist, int size)
 		list[i] = MegaNodePrivate::fromNode(newlist[i]);
 }
 
+// takes ownership of the nodes
+MegaNodeListPrivate::MegaNodeListPrivate(vector<MegaNode*> *newlist)
+{
+    list = NULL; s = int(newlist->size());
+    if(!s) return;
+
+    list = new MegaNode*[s];
+    for(int i=0; i<s; i++)
+        list[i] = (*newlist)[i];
+}
+
 MegaNodeListPrivate::MegaNodeListPrivate(MegaNodeListPrivate *nodeList)
 {
     s = nodeList->size();
@@ -1936,36 +2418,313 @@ int MegaNodeListPrivate::size()
 	return s;
 }
 
-MegaUserListPrivate::MegaUserListPrivate()
+int MegaNodeListPrivate::span(int start, int count)
 {
-	list = NULL;
-	s = 0;
+    if (!list || start < 0 || start >= s || count <= 0)
+    {
+        return 0;
+    }
+
+    return (count < s - start) ? count : s - start;
 }
 
-MegaUserListPrivate::MegaUserListPrivate(User** newlist, int size)
+int MegaNodeListPrivate::getHandles(int start, MegaHandle *handles, int count)
 {
-	list = NULL;
-	s = size;
+    int n = span(start, count);
 
-	if(!size)
-		return;
+    for (int i = 0; i < n; i++)
+    {
+        handles[i] = list[start + i]->getHandle();
+    }
 
-	list = new MegaUser*[size];
-	for(int i=0; i<size; i++)
-		list[i] = MegaUserPrivate::fromUser(newlist[i]);
+    return n;
 }
 
-MegaUserListPrivate::MegaUserListPrivate(MegaUserListPrivate *userList)
+int MegaNodeListPrivate::getSizes(int start, int64_t *sizes, int count)
 {
-    s = userList->size();
-	if (!s)
-	{
-		list = NULL;
-		return;
-	}
-	list = new MegaUser*[s];
-	for (int i = 0; i<s; i++)
-        list[i] = new MegaUserPrivate(userList->get(i));
+    int n = span(start, count);
+
+    for (int i = 0; i < n; i++)
+    {
+        sizes[i] = list[start + i]->getSize();
+    }
+
+    return n;
+}
+
+int MegaNodeListPrivate::getModificationTimes(int start, int64_t *mtimes, int count)
+{
+    int n = span(start, count);
+
+    for (int i = 0; i < n; i++)
+    {
+        mtimes[i] = list[start + i]->getModificationTime();
+    }
+
+    return n;
+}
+
+int MegaNodeListPrivate::getTypes(int start, int *types, int count)
+{
+    int n = span(start, count);
+
+    for (int i = 0; i < n; i++)
+    {
+        types[i] = list[start + i]->getType();
+    }
+
+    return n;
+}
+
+int MegaNodeListPrivate::getNames(int start, char *names, int size)
+{
+    int n = span(start, s);
+    int pos = 0;
+    int i;
+
+    for (i = 0; i < n; i++)
+    {
+        const char *name = list[start + i]->getName();
+        int len = name ? (int)strlen(name) : 0;
+
+        if (len >= size - pos)
+        {
+            break;
+        }
+
+        if (len)
+        {
+            memcpy(names + pos, name, len);
+        }
+
+        names[pos + len] = 0;
+        pos += len + 1;
+    }
+
+    return i;
+}
+
+MegaHandleListPrivate::MegaHandleListPrivate()
+{
+
+}
+
+MegaHandleListPrivate::MegaHandleListPrivate(const MegaHandle *newlist, int size)
+{
+    if (size > 0)
+    {
+        list.assign(newlist, newlist + size);
+    }
+}
+
+MegaHandleListPrivate::~MegaHandleListPrivate()
+{
+
+}
+
+MegaHandleList *MegaHandleListPrivate::copy()
+{
+    return new MegaHandleListPrivate(list.size() ? &list[0] : NULL, int(list.size()));
+}
+
+MegaHandle MegaHandleListPrivate::get(int i)
+{
+    if (i < 0 || i >= size())
+    {
+        return INVALID_HANDLE;
+    }
+
+    return list[i];
+}
+
+int MegaHandleListPrivate::size()
+{
+    return int(list.size());
+}
+
+MegaChildrenCursorPrivate::MegaChildrenCursorPrivate(MegaApiImpl *api, MegaHandle parentHandle, int order)
+{
+    this->api = api;
+    this->parentHandle = parentHandle;
+    this->order = order;
+    this->position = 0;
+}
+
+MegaChildrenCursor *MegaChildrenCursorPrivate::copy()
+{
+    MegaChildrenCursorPrivate *cursor = new MegaChildrenCursorPrivate(api, parentHandle, order);
+    cursor->position = position;
+    return cursor;
+}
+
+MegaNodeList *MegaChildrenCursorPrivate::next(int count)
+{
+    MegaNodeList *window = api->getChildWindow(parentHandle, order, position, count);
+    position += window->size();
+    return window;
+}
+
+int MegaChildrenCursorPrivate::getPosition()
+{
+    return position;
+}
+
+void MegaChildrenCursorPrivate::setPosition(int position)
+{
+    this->position = position < 0 ? 0 : position;
+}
+
+MegaNodeSnapshotPrivate::MegaNodeSnapshotPrivate(MegaApiImpl *api, const char *scsn, vector<Node *> *roots, int order)
+{
+    this->scsn = scsn ? scsn : "";
+
+    // the queue of the traversal is the snapshot itself
+    vector<Node *> queue(*roots);
+
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        Node *node = queue[i];
+
+        firstChild.push_back(int(queue.size()));
+        numChildren.push_back(int(node->children.size()));
+
+        if (!order || order > MegaApi::ORDER_ALPHABETICAL_DESC)
+        {
+            queue.insert(queue.end(), node->children.begin(), node->children.end());
+        }
+        else
+        {
+            const node_vector *view = api->getSortedChildren(node, order);
+            queue.insert(queue.end(), view->begin(), view->end());
+        }
+    }
+
+    nodes.reserve(queue.size());
+
+    for (size_t i = 0; i < queue.size(); i++)
+    {
+        nodes.push_back(MegaNodePrivate::fromNode(queue[i]));
+        positions[queue[i]->nodehandle] = int(i);
+    }
+}
+
+MegaNodeSnapshotPrivate::MegaNodeSnapshotPrivate(MegaNodeSnapshotPrivate *snapshot)
+{
+    scsn = snapshot->scsn;
+    firstChild = snapshot->firstChild;
+    numChildren = snapshot->numChildren;
+    positions = snapshot->positions;
+
+    nodes.reserve(snapshot->nodes.size());
+
+    for (size_t i = 0; i < snapshot->nodes.size(); i++)
+    {
+        nodes.push_back(snapshot->nodes[i]->copy());
+    }
+}
+
+MegaNodeSnapshotPrivate::~MegaNodeSnapshotPrivate()
+{
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        delete nodes[i];
+    }
+}
+
+MegaNodeSnapshot *MegaNodeSnapshotPrivate::copy()
+{
+    return new MegaNodeSnapshotPrivate(this);
+}
+
+const char *MegaNodeSnapshotPrivate::getSequenceNumber()
+{
+    return scsn.c_str();
+}
+
+int MegaNodeSnapshotPrivate::getNumNodes()
+{
+    return int(nodes.size());
+}
+
+int MegaNodeSnapshotPrivate::find(MegaHandle handle) const
+{
+    map<MegaHandle, int>::const_iterator it = positions.find(handle);
+    return it == positions.end() ? -1 : it->second;
+}
+
+MegaNode *MegaNodeSnapshotPrivate::getNodeByHandle(MegaHandle handle)
+{
+    int i = find(handle);
+    return i < 0 ? NULL : nodes[i]->copy();
+}
+
+MegaNode *MegaNodeSnapshotPrivate::getParentNode(MegaNode *node)
+{
+    if (!node || find(node->getHandle()) < 0)
+    {
+        return NULL;
+    }
+
+    int i = find(node->getParentHandle());
+    return i < 0 ? NULL : nodes[i]->copy();
+}
+
+int MegaNodeSnapshotPrivate::getNumChildren(MegaNode *parent)
+{
+    int i = parent ? find(parent->getHandle()) : -1;
+    return i < 0 ? 0 : numChildren[i];
+}
+
+MegaNodeList *MegaNodeSnapshotPrivate::getChildren(MegaNode *parent)
+{
+    int i = parent ? find(parent->getHandle()) : -1;
+    if (i < 0)
+    {
+        return new MegaNodeListPrivate();
+    }
+
+    // the list takes the ownership of the nodes
+    vector<MegaNode *> children;
+    children.reserve(numChildren[i]);
+
+    for (int j = firstChild[i]; j < firstChild[i] + numChildren[i]; j++)
+    {
+        children.push_back(nodes[j]->copy());
+    }
+
+    return new MegaNodeListPrivate(&children);
+}
+
+MegaUserListPrivate::MegaUserListPrivate()
+{
+	list = NULL;
+	s = 0;
+}
+
+MegaUserListPrivate::MegaUserListPrivate(User** newlist, int size)
+{
+	list = NULL;
+	s = size;
+
+	if(!size)
+		return;
+
+	list = new MegaUser*[size];
+	for(int i=0; i<size; i++)
+		list[i] = MegaUserPrivate::fromUser(newlist[i]);
+}
+
+MegaUserListPrivate::MegaUserListPrivate(MegaUserListPrivate *userList)
+{
+    s = userList->size();
+	if (!s)
+	{
+		list = NULL;
+		return;
+	}
+	list = new MegaUser*[s];
+	for (int i = 0; i<s; i++)
+        list[i] = new MegaUserPrivate(userList->get(i));
 }
 
 MegaUserListPrivate::~MegaUserListPrivate()
@@ -2268,6 +3027,23 @@ void MegaFileGet::completed(Transfer*, LocalNode*)
     delete this;
 }
 
+// a stream that refused the data is not retried
+bool MegaFileGet::failed(error e)
+{
+    return !(sink && e == API_EWRITE) && MegaFile::failed(e);
+}
+
+void MegaFileGet::setOutputStream(MegaOutputStream *stream)
+{
+    localname.clear();
+    sink = new ExternalOutputStream(stream);
+}
+
+MegaFileGet::~MegaFileGet()
+{
+    delete sink;
+}
+
 void MegaFileGet::terminated()
 {
     delete this;
@@ -2330,5928 +3106,11497 @@ void *MegaApiImpl::threadEntryPoint(void *param)
 
 ExternalLogger *MegaApiImpl::externalLogger = NULL;
 
-MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent)
+MegaPathCache::MegaPathCache()
 {
-	init(api, appKey, processor, basePath, userAgent);
+    clear();
 }
 
-MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent)
+// FNV-1a over the handle and the path
+unsigned MegaPathCache::hash(handle h, const char *path)
 {
-	init(api, appKey, NULL, basePath, userAgent);
+    uint32_t v = 2166136261U;
+
+    for (unsigned i = 0; i < sizeof h; i++)
+    {
+        v = (v ^ (byte)(h >> (i * 8))) * 16777619U;
+    }
+
+    while (path && *path)
+    {
+        v = (v ^ (byte)*path++) * 16777619U;
+    }
+
+    return v & (SLOTS - 1);
 }
 
-MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent, int fseventsfd)
+bool MegaPathCache::findNode(handle cwd, const char *path, handle *h)
 {
-	init(api, appKey, NULL, basePath, userAgent, fseventsfd);
+    NodeEntry *e = &nodes[hash(cwd, path)];
+
+    if (ISUNDEF(e->h) || e->cwd != cwd || e->path != path)
+    {
+        return false;
+    }
+
+    *h = e->h;
+    return true;
 }
 
-void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent, int fseventsfd)
+void MegaPathCache::addNode(handle cwd, const char *path, handle h)
 {
-    this->api = api;
+    NodeEntry *e = &nodes[hash(cwd, path)];
 
-    sdkMutex.init(true);
-    maxRetries = 10;
-	currentTransfer = NULL;
-    pendingUploads = 0;
-    pendingDownloads = 0;
-    totalUploads = 0;
-    totalDownloads = 0;
-    client = NULL;
-    waiting = false;
-    waitingRequest = false;
-    totalDownloadedBytes = 0;
-    totalUploadedBytes = 0;
-    activeRequest = NULL;
-    activeTransfer = NULL;
-    activeError = NULL;
-    activeNodes = NULL;
-    activeUsers = NULL;
-    syncLowerSizeLimit = 0;
-    syncUpperSizeLimit = 0;
-    downloadSpeed = 0;
-    uploadSpeed = 0;
-    uploadPartialBytes = 0;
-    downloadPartialBytes = 0;
+    e->cwd = cwd;
+    e->path = path;
+    e->h = h;
+}
 
-    httpio = new MegaHttpIO();
-    waiter = new MegaWaiter();
+bool MegaPathCache::findPath(handle h, string *path)
+{
+    PathEntry *e = &paths[hash(h, NULL)];
 
-#ifndef __APPLE__
-    (void)fseventsfd;
-    fsAccess = new MegaFileSystemAccess();
-#else
-    fsAccess = new MegaFileSystemAccess(fseventsfd);
-#endif
+    if (ISUNDEF(e->h) || e->h != h)
+    {
+        return false;
+    }
 
-	if (basePath)
-	{
-		string sBasePath = basePath;
-		int lastIndex = sBasePath.size() - 1;
-		if (sBasePath[lastIndex] != '/' && sBasePath[lastIndex] != '\\')
-		{
-			string utf8Separator;
-			fsAccess->local2path(&fsAccess->localseparator, &utf8Separator);
-			sBasePath.append(utf8Separator);
-		}
-		dbAccess = new MegaDbAccess(&sBasePath);
-	}
-	else dbAccess = NULL;
+    *path = e->path;
+    return true;
+}
 
-	gfxAccess = NULL;
-	if(processor)
-	{
-		GfxProcExternal *externalGfx = new GfxProcExternal();
-		externalGfx->setProcessor(processor);
-		gfxAccess = externalGfx;
-	}
-	else
-	{
-		gfxAccess = new MegaGfxProc();
-	}
+void MegaPathCache::addPath(handle h, const string *path)
+{
+    PathEntry *e = &paths[hash(h, NULL)];
 
-	if(!userAgent)
-	{
-		userAgent = "";
-	}
+    e->h = h;
+    e->path = *path;
+}
 
-    client = new MegaClient(this, waiter, httpio, fsAccess, dbAccess, gfxAccess, appKey, userAgent);
+void MegaPathCache::clear()
+{
+    NodeEntry node;
+    node.cwd = UNDEF;
+    node.h = UNDEF;
 
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-    httpio->unlock();
-#endif
+    PathEntry path;
+    path.h = UNDEF;
 
-    //Start blocking thread
-	threadExit = 0;
-    thread.start(threadEntryPoint, this);
+    vector<NodeEntry>(SLOTS, node).swap(nodes);
+    vector<PathEntry>(SLOTS, path).swap(paths);
 }
 
-MegaApiImpl::~MegaApiImpl()
+size_t MegaPathCache::allocated() const
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_DELETE);
-    requestQueue.push(request);
-    waiter->notify();
-    thread.join();
+    size_t size = 0;
+
+    for (unsigned i = 0; i < SLOTS; i++)
+    {
+        size += stringallocated(&nodes[i].path) + stringallocated(&paths[i].path);
+    }
+
+    return size;
 }
 
-int MegaApiImpl::isLoggedIn()
+MegaNameIndex::MegaNameIndex()
 {
-    sdkMutex.lock();
-    int result = client->loggedin();
-    sdkMutex.unlock();
-	return result;
+    building = false;
+    table = NULL;
+    key = NULL;
+    savedscsn = UNDEF;
 }
 
-char* MegaApiImpl::getMyEmail()
+MegaNameIndex::~MegaNameIndex()
 {
-	User* u;
-    sdkMutex.lock();
-	if (!client->loggedin() || !(u = client->finduser(client->me)))
-	{
-		sdkMutex.unlock();
-		return NULL;
-	}
+    delete table;
+}
 
-    char *result = MegaApi::strdup(u->email.c_str());
-    sdkMutex.unlock();
-    return result;
+bool MegaNameIndex::Entry::serialize(string *d)
+{
+    d->append((const char*)&h, sizeof h);
+    d->append(name);
+    return true;
 }
 
-char *MegaApiImpl::getMyUserHandle()
+// ASCII only, matching the case-insensitivity of the tree search
+void MegaNameIndex::lowercase(const char *name, string *lower)
 {
-    sdkMutex.lock();
-    if (ISUNDEF(client->me))
+    lower->assign(name);
+
+    for (size_t i = lower->size(); i--; )
     {
-        sdkMutex.unlock();
-        return NULL;
+        char c = (*lower)[i];
+        if (c >= 'A' && c <= 'Z')
+        {
+            (*lower)[i] = c + ('a' - 'A');
+        }
     }
+}
 
-    char buf[12];
-    Base64::btoa((const byte*)&client->me, MegaClient::USERHANDLE, buf);
-    char *result = MegaApi::strdup(buf);
-    sdkMutex.unlock();
-    return result;
+uint32_t MegaNameIndex::gram(const char *p)
+{
+    return ((uint32_t)(byte)p[0] << 16) | ((uint32_t)(byte)p[1] << 8) | (byte)p[2];
 }
 
-char *MegaApiImpl::getMyXMPPJid()
+bool MegaNameIndex::matches(const string &name, const string &query, int matchType)
 {
-    sdkMutex.lock();
-    if (ISUNDEF(client->me))
+    switch (matchType)
     {
-        sdkMutex.unlock();
-        return NULL;
-    }
+        case MegaApi::SEARCH_PREFIX:
+            return !name.compare(0, query.size(), query);
 
-    char jid[16];
-    Base32::btoa((const byte *)&client->me, MegaClient::USERHANDLE, jid);
-    char *result = MegaApi::strdup(jid);
+        case MegaApi::SEARCH_EXTENSION:
+            // query includes the dot
+            return name.size() > query.size() && !name.compare(name.size() - query.size(), query.size(), query);
 
-    sdkMutex.unlock();
-    return result;
+        default:
+            return name.find(query) != string::npos;
+    }
 }
 
-void MegaApiImpl::setLogLevel(int logLevel)
+void MegaNameIndex::addGrams(handle h, const string &name)
 {
-    if(!externalLogger)
+    for (size_t i = 0; i + GRAM <= name.size(); i++)
     {
-        externalLogger = new ExternalLogger();
+        handle_vector *postings = &grams[gram(name.data() + i)];
+
+        if (building)
+        {
+            postings->push_back(h);
+        }
+        else
+        {
+            handle_vector::iterator it = std::lower_bound(postings->begin(), postings->end(), h);
+
+            if (it == postings->end() || *it != h)
+            {
+                postings->insert(it, h);
+            }
+        }
     }
-    externalLogger->setLogLevel(logLevel);
 }
 
-void MegaApiImpl::setLoggerClass(MegaLogger *megaLogger)
+void MegaNameIndex::removeGrams(handle h, const string &name)
 {
-    if(!externalLogger)
+    for (size_t i = 0; i + GRAM <= name.size(); i++)
     {
-        externalLogger = new ExternalLogger();
+        gram_map::iterator git = grams.find(gram(name.data() + i));
+
+        if (git == grams.end())
+        {
+            continue;
+        }
+
+        handle_vector *postings = &git->second;
+        handle_vector::iterator it = building ? std::find(postings->begin(), postings->end(), h)
+                                              : std::lower_bound(postings->begin(), postings->end(), h);
+
+        if (it != postings->end() && *it == h)
+        {
+            postings->erase(it);
+        }
+
+        if (postings->empty())
+        {
+            grams.erase(git);
+        }
     }
-    externalLogger->setMegaLogger(megaLogger);
 }
 
-void MegaApiImpl::log(int logLevel, const char *message, const char *filename, int line)
+void MegaNameIndex::add(Node *n)
 {
-    if(!externalLogger)
+    if (n->attrstring)
     {
+        n->decrypt();
+    }
+
+    attr_map::const_iterator it;
+
+    if (n->type > FOLDERNODE || n->attrstring
+     || (it = n->attrs.map.find('n')) == n->attrs.map.end() || !it->second.size())
+    {
+        remove(n->nodehandle);
         return;
     }
 
-    externalLogger->postLog(logLevel, message, filename, line);
-}
+    string name;
+    lowercase(it->second.c_str(), &name);
 
-char* MegaApiImpl::getBase64PwKey(const char *password)
-{
-	if(!password) return NULL;
+    entry_map::iterator eit = entries.find(n->nodehandle);
 
-	byte pwkey[SymmCipher::KEYLENGTH];
-	error e = client->pw_key(password,pwkey);
-	if(e)
-		return NULL;
+    if (eit != entries.end())
+    {
+        if (eit->second.name == name)
+        {
+            return;
+        }
 
-	char* buf = new char[SymmCipher::KEYLENGTH*4/3+4];
-	Base64::btoa((byte *)pwkey, SymmCipher::KEYLENGTH, buf);
-	return buf;
+        removeGrams(n->nodehandle, eit->second.name);
+    }
+    else
+    {
+        eit = entries.insert(pair<handle, Entry>(n->nodehandle, Entry())).first;
+        eit->second.h = n->nodehandle;
+    }
+
+    eit->second.name.swap(name);
+    addGrams(n->nodehandle, eit->second.name);
+
+    if (table)
+    {
+        dirty.insert(n->nodehandle);
+    }
 }
 
-char* MegaApiImpl::getStringHash(const char* base64pwkey, const char* inBuf)
+void MegaNameIndex::remove(handle h)
 {
-	if(!base64pwkey || !inBuf) return NULL;
-
-	char pwkey[SymmCipher::KEYLENGTH];
-	Base64::atob(base64pwkey, (byte *)pwkey, sizeof pwkey);
+    entry_map::iterator it = entries.find(h);
 
-	SymmCipher key;
-	key.setkey((byte*)pwkey);
+    if (it == entries.end())
+    {
+        return;
+    }
 
-    uint64_t strhash;
-	string neBuf = inBuf;
+    removeGrams(h, it->second.name);
 
-    strhash = client->stringhash64(&neBuf, &key);
+    if (table && it->second.dbid)
+    {
+        deleted.push_back(it->second.dbid);
+    }
 
-	char* buf = new char[8*4/3+4];
-    Base64::btoa((byte*)&strhash, 8, buf);
-    return buf;
+    dirty.erase(h);
+    entries.erase(it);
 }
 
-void MegaApiImpl::getSessionTransferURL(const char *path, MegaRequestListener *listener)
+bool MegaNameIndex::contains(handle h) const
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_SESSION_TRANSFER_URL);
-    request->setText(path);
-    request->setListener(listener);
-    requestQueue.push(request);
-    waiter->notify();
+    return entries.find(h) != entries.end();
 }
 
-MegaHandle MegaApiImpl::base32ToHandle(const char *base32Handle)
+void MegaNameIndex::prune(node_map *nodes)
 {
-	if(!base32Handle) return INVALID_HANDLE;
+    handle_vector gone;
 
-	handle h = 0;
-	Base32::atob(base32Handle,(byte*)&h, MegaClient::USERHANDLE);
-	return h;
+    for (entry_map::iterator it = entries.begin(); it != entries.end(); it++)
+    {
+        if (nodes->find(it->first) == nodes->end())
+        {
+            gone.push_back(it->first);
+        }
+    }
+
+    for (handle_vector::iterator it = gone.begin(); it != gone.end(); it++)
+    {
+        remove(*it);
+    }
 }
 
-const char* MegaApiImpl::ebcEncryptKey(const char* encryptionKey, const char* plainKey)
+void MegaNameIndex::find(const char *query, int matchType, handle_vector *results) const
 {
-	if(!encryptionKey || !plainKey) return NULL;
+    string q;
+    lowercase(query, &q);
 
-	char pwkey[SymmCipher::KEYLENGTH];
-	Base64::atob(encryptionKey, (byte *)pwkey, sizeof pwkey);
+    if (matchType == MegaApi::SEARCH_EXTENSION)
+    {
+        if (q.size() && q[0] == '.')
+        {
+            q.erase(0, 1);
+        }
 
-	SymmCipher key;
-	key.setkey((byte*)pwkey);
+        if (!q.size())
+        {
+            return;
+        }
 
-	char plkey[SymmCipher::KEYLENGTH];
-	Base64::atob(plainKey, (byte*)plkey, sizeof plkey);
-	key.ecb_encrypt((byte*)plkey);
+        q.insert(0, ".");
+    }
 
-	char* buf = new char[SymmCipher::KEYLENGTH*4/3+4];
-	Base64::btoa((byte*)plkey, SymmCipher::KEYLENGTH, buf);
-	return buf;
-}
+    if (q.size() < GRAM)
+    {
+        for (entry_map::const_iterator it = entries.begin(); it != entries.end(); it++)
+        {
+            if (matches(it->second.name, q, matchType))
+            {
+                results->push_back(it->first);
+            }
+        }
 
-handle MegaApiImpl::base64ToHandle(const char* base64Handle)
-{
-	if(!base64Handle) return UNDEF;
+        return;
+    }
 
-	handle h = 0;
-	Base64::atob(base64Handle,(byte*)&h,MegaClient::NODEHANDLE);
-    return h;
-}
+    // candidates: the shortest postings list of the query's trigrams
+    const handle_vector *candidates = NULL;
 
-char *MegaApiImpl::handleToBase64(MegaHandle handle)
-{
-    char *base64Handle = new char[12];
-    Base64::btoa((byte*)&(handle),MegaClient::NODEHANDLE,base64Handle);
-    return base64Handle;
-}
+    for (size_t i = 0; i + GRAM <= q.size(); i++)
+    {
+        gram_map::const_iterator it = grams.find(gram(q.data() + i));
 
-char *MegaApiImpl::userHandleToBase64(MegaHandle handle)
-{
-    char *base64Handle = new char[14];
-    Base64::btoa((byte*)&(handle),MegaClient::USERHANDLE,base64Handle);
-    return base64Handle;
+        if (it == grams.end())
+        {
+            return;
+        }
+
+        if (!candidates || it->second.size() < candidates->size())
+        {
+            candidates = &it->second;
+        }
+    }
+
+    for (handle_vector::const_iterator it = candidates->begin(); it != candidates->end(); it++)
+    {
+        entry_map::const_iterator eit = entries.find(*it);
+
+        if (eit != entries.end() && matches(eit->second.name, q, matchType))
+        {
+            results->push_back(*it);
+        }
+    }
 }
 
-void MegaApiImpl::retryPendingConnections(bool disconnect, bool includexfers, MegaRequestListener *listener)
+void MegaNameIndex::beginBuild()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_RETRY_PENDING_CONNECTIONS);
-	request->setFlag(disconnect);
-	request->setNumber(includexfers);
-	request->setListener(listener);
-	requestQueue.push(request);
-    waiter->notify();
+    building = true;
 }
 
-void MegaApiImpl::addEntropy(char *data, unsigned int size)
+void MegaNameIndex::endBuild()
 {
-    if(PrnGen::rng.CanIncorporateEntropy())
-        PrnGen::rng.IncorporateEntropy((const byte*)data, size);
+    for (gram_map::iterator it = grams.begin(); it != grams.end(); it++)
+    {
+        handle_vector *postings = &it->second;
 
-#ifdef USE_SODIUM
-    if(EdDSA::rng.CanIncorporateEntropy())
-        EdDSA::rng.IncorporateEntropy((const byte*)data, size);
-#endif
+        std::sort(postings->begin(), postings->end());
+        postings->erase(std::unique(postings->begin(), postings->end()), postings->end());
+    }
 
-#if (!defined(_WIN32) && !defined(USE_CURL_PUBLIC_KEY_PINNING)) || defined(WINDOWS_PHONE)
-    RAND_seed(data, size);
-#endif
+    building = false;
 }
 
-void MegaApiImpl::fastLogin(const char* email, const char *stringHash, const char *base64pwkey, MegaRequestListener *listener)
+bool MegaNameIndex::open(DbTable *table, SymmCipher *key, handle scsn)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
-	request->setEmail(email);
-	request->setPassword(stringHash);
-	request->setPrivateKey(base64pwkey);
-	requestQueue.push(request);
-    waiter->notify();
+    clear();
+
+    this->table = table;
+    this->key = key;
+
+    handle stored = UNDEF;
+    uint32_t id;
+    string data;
+
+    beginBuild();
+    table->rewind();
+
+    while (table->next(&id, &data, key))
+    {
+        if (!(id & 15))
+        {
+            if (data.size() == sizeof stored)
+            {
+                memcpy(&stored, data.data(), sizeof stored);
+            }
+            continue;
+        }
+
+        Entry e;
+
+        if (data.size() <= sizeof e.h)
+        {
+            continue;
+        }
+
+        memcpy(&e.h, data.data(), sizeof e.h);
+        e.name.assign(data, sizeof e.h, string::npos);
+        e.dbid = id;
+
+        pair<entry_map::iterator, bool> ins = entries.insert(pair<handle, Entry>(e.h, e));
+
+        if (ins.second)
+        {
+            addGrams(e.h, e.name);
+        }
+    }
+
+    if (ISUNDEF(stored) || stored != scsn)
+    {
+        entries.clear();
+        grams.clear();
+        table->truncate();
+        endBuild();
+        return false;
+    }
+
+    endBuild();
+    savedscsn = scsn;
+
+    return true;
 }
 
-void MegaApiImpl::fastLogin(const char *session, MegaRequestListener *listener)
+void MegaNameIndex::flush(handle scsn)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
-    request->setSessionKey(session);
-    requestQueue.push(request);
-    waiter->notify();
+    if (!table || (dirty.empty() && deleted.empty() && scsn == savedscsn))
+    {
+        return;
+    }
+
+    table->begin();
+
+    for (vector<int32_t>::iterator it = deleted.begin(); it != deleted.end(); it++)
+    {
+        table->del(*it);
+    }
+
+    for (handle_set::iterator it = dirty.begin(); it != dirty.end(); it++)
+    {
+        entry_map::iterator eit = entries.find(*it);
+
+        if (eit != entries.end())
+        {
+            table->put(1, &eit->second, key);
+        }
+    }
+
+    table->put(0, (char*)&scsn, sizeof scsn);
+    table->commit();
+
+    dirty.clear();
+    deleted.clear();
+    savedscsn = scsn;
 }
 
-void MegaApiImpl::killSession(MegaHandle sessionHandle, MegaRequestListener *listener)
+void MegaNameIndex::clear(bool removeTable)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_KILL_SESSION, listener);
-    request->setNodeHandle(sessionHandle);
-    requestQueue.push(request);
-    waiter->notify();
+    entries.clear();
+    grams.clear();
+    dirty.clear();
+    deleted.clear();
+    building = false;
+
+    if (table)
+    {
+        if (removeTable)
+        {
+            table->remove();
+        }
+
+        delete table;
+        table = NULL;
+    }
+
+    key = NULL;
+    savedscsn = UNDEF;
 }
 
-void MegaApiImpl::getUserData(MegaRequestListener *listener)
+MegaStreamingRing::MegaStreamingRing(char **buffers, int count, size_t size)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    bufferSize = size;
+    owned = !buffers;
+
+    for (int i = 0; size && i < count; i++)
+    {
+        this->buffers.push_back(owned ? new char[size] : buffers[i]);
+        available.push_back(i);
+    }
+
+    lent.resize(this->buffers.size(), false);
+    overflowPos = 0;
+    finishing = false;
+    finished = false;
+    lastUpdate = 0;
 }
 
-void MegaApiImpl::getUserData(MegaUser *user, MegaRequestListener *listener)
+MegaStreamingRing::~MegaStreamingRing()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
-    request->setFlag(true);
-    if(user)
+    if (owned)
     {
-        request->setEmail(user->getEmail());
+        for (unsigned i = 0; i < buffers.size(); i++)
+        {
+            delete [] buffers[i];
+        }
     }
-
-    requestQueue.push(request);
-    waiter->notify();
 }
 
-void MegaApiImpl::getUserData(const char *user, MegaRequestListener *listener)
+MegaFileHandlePrivate::MegaFileHandlePrivate(MegaApiImpl *api, MegaNode *node)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
-    request->setFlag(true);
-    request->setEmail(user);
-    requestQueue.push(request);
-    waiter->notify();
+    this->api = api;
+    this->node = node->copy();
 }
 
-void MegaApiImpl::login(const char *login, const char *password, MegaRequestListener *listener)
+MegaFileHandlePrivate::~MegaFileHandlePrivate()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
-	request->setEmail(login);
-	request->setPassword(password);
-	requestQueue.push(request);
-    waiter->notify();
+    api->closeFile(this);
+    delete node;
 }
 
-char *MegaApiImpl::dumpSession()
+MegaHandle MegaFileHandlePrivate::getNodeHandle() const
 {
-    sdkMutex.lock();
-    byte session[MAX_SESSION_LENGTH];
-    char* buf = NULL;
-    int size;
-    size = client->dumpsession(session, sizeof session);
-    if (size > 0)
-    {
-        buf = new char[sizeof(session) * 4 / 3 + 4];
-        Base64::btoa(session, size, buf);
-    }
+    return node->getHandle();
+}
 
-    sdkMutex.unlock();
-    return buf;
+long long MegaFileHandlePrivate::getSize() const
+{
+    return node->getSize();
 }
 
-char *MegaApiImpl::dumpXMPPSession()
+MegaFileRead::MegaFileRead(MegaFileHandlePrivate *file, m_off_t offset, m_off_t size)
 {
-    sdkMutex.lock();
-    char* buf = NULL;
+    this->file = file;
+    range = pair<m_off_t, m_off_t>(offset, size);
+    receiving = false;
+}
 
-    if (client->loggedin())
+void MegaFileRead::onTransferStart(MegaApi *api, MegaTransfer *transfer)
+{
+    for (unsigned i = 0; i < listeners.size(); i++)
     {
-        buf = new char[MAX_SESSION_LENGTH * 4 / 3 + 4];
-        Base64::btoa((const byte *)client->sid.data(), client->sid.size(), buf);
+        listeners[i]->onTransferStart(api, transfer);
     }
-
-    sdkMutex.unlock();
-    return buf;
 }
 
-void MegaApiImpl::createAccount(const char* email, const char* password, const char* name, MegaRequestListener *listener)
+void MegaFileRead::onTransferUpdate(MegaApi *api, MegaTransfer *transfer)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_ACCOUNT, listener);
-	request->setEmail(email);
-	request->setPassword(password);
-	request->setName(name);
-	requestQueue.push(request);
-    waiter->notify();
+    for (unsigned i = 0; i < listeners.size(); i++)
+    {
+        if (active[i])
+        {
+            listeners[i]->onTransferUpdate(api, transfer);
+        }
+    }
 }
 
-void MegaApiImpl::fastCreateAccount(const char* email, const char *base64pwkey, const char* name, MegaRequestListener *listener)
+void MegaFileRead::onTransferTemporaryError(MegaApi *api, MegaTransfer *transfer, MegaError *e)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_ACCOUNT, listener);
-	request->setEmail(email);
-	request->setPrivateKey(base64pwkey);
-	request->setName(name);
-	requestQueue.push(request);
-    waiter->notify();
+    for (unsigned i = 0; i < listeners.size(); i++)
+    {
+        listeners[i]->onTransferTemporaryError(api, transfer, e);
+    }
 }
 
-void MegaApiImpl::querySignupLink(const char* link, MegaRequestListener *listener)
+bool MegaFileRead::onTransferData(MegaApi *api, MegaTransfer *transfer, char *buffer, size_t size)
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_QUERY_SIGNUP_LINK, listener);
-	request->setLink(link);
-	requestQueue.push(request);
-    waiter->notify();
+    bool result = false;
+
+    // no more listeners can join
+    receiving = true;
+
+    for (unsigned i = 0; i < listeners.size(); i++)
+    {
+        if (active[i])
+        {
+            active[i] = listeners[i]->onTransferData(api, transfer, buffer, size);
+            result |= active[i];
+        }
+    }
+
+    return result;
 }
 
-void MegaApiImpl::confirmAccount(const char* link, const char *password, MegaRequestListener *listener)
+void MegaFileRead::onTransferFinish(MegaApi *api, MegaTransfer *transfer, MegaError *e)
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CONFIRM_ACCOUNT, listener);
-	request->setLink(link);
-	request->setPassword(password);
-	requestQueue.push(request);
-    waiter->notify();
+    if (file)
+    {
+        map<pair<m_off_t, m_off_t>, MegaFileRead *>::iterator it = file->reads.find(range);
+        if (it != file->reads.end() && it->second == this)
+        {
+            file->reads.erase(it);
+        }
+    }
+
+    for (unsigned i = 0; i < listeners.size(); i++)
+    {
+        listeners[i]->onTransferFinish(api, transfer, e);
+    }
+
+    delete this;
 }
 
-void MegaApiImpl::fastConfirmAccount(const char* link, const char *base64pwkey, MegaRequestListener *listener)
+#ifndef _WIN32
+MegaHTTPConnection::MegaHTTPConnection(MegaHTTPServer *server, int fd)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CONFIRM_ACCOUNT, listener);
-	request->setLink(link);
-	request->setPrivateKey(base64pwkey);
-	requestQueue.push(request);
-    waiter->notify();
+    mutex.init(false);
+    this->server = server;
+    this->fd = fd;
+    outputOffset = 0;
+    outputBytes = 0;
+    streaming = false;
+    failed = false;
+    closed = false;
+    responding = false;
+    keepAlive = false;
+    node = NULL;
+    streamPos = 0;
+    streamEnd = 0;
 }
 
-void MegaApiImpl::setProxySettings(MegaProxy *proxySettings)
+MegaHTTPConnection::~MegaHTTPConnection()
 {
-    Proxy localProxySettings;
-    localProxySettings.setProxyType(proxySettings->getProxyType());
+    delete node;
+    close(fd);
+}
 
-    string url;
-    if(proxySettings->getProxyURL())
-        url = proxySettings->getProxyURL();
+bool MegaHTTPConnection::send(const char *data, size_t len)
+{
+    struct iovec iov[16];
+    int iovcnt = 0;
 
-    string localurl;
+    for (deque<string>::iterator it = output.begin(); it != output.end() && iovcnt < 15; it++)
+    {
+        size_t offset = iovcnt ? 0 : outputOffset;
+        iov[iovcnt].iov_base = (char *)it->data() + offset;
+        iov[iovcnt].iov_len = it->size() - offset;
+        iovcnt++;
+    }
 
-#if defined(WINDOWS_PHONE) || (defined(_WIN32) && defined(USE_CURL))
-    localurl = url;
-#else
-    fsAccess->path2local(&url, &localurl);
-#endif
+    // the new data only goes out after everything queued before
+    bool direct = len && iovcnt == (int)output.size();
+    if (direct)
+    {
+        iov[iovcnt].iov_base = (char *)data;
+        iov[iovcnt].iov_len = len;
+        iovcnt++;
+    }
 
-    localProxySettings.setProxyURL(&localurl);
+    size_t written = 0;
 
-    if(proxySettings->credentialsNeeded())
+    if (iovcnt)
     {
-        string username;
-        if(proxySettings->getUsername())
-            username = proxySettings->getUsername();
+        ssize_t r = writev(fd, iov, iovcnt);
 
-        string localusername;
+        if (r < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                LOG_debug << "HTTP connection write failed: " << errno;
+                failed = true;
+                return false;
+            }
+        }
+        else
+        {
+            written = r;
+        }
+    }
 
-#if defined(WINDOWS_PHONE) || (defined(_WIN32) && defined(USE_CURL))
-        localusername = username;
-#else
-        fsAccess->path2local(&username, &localusername);
-#endif
+    outputBytes -= std::min(written, outputBytes);
 
-        string password;
-        if(proxySettings->getPassword())
-            password = proxySettings->getPassword();
+    while (written && output.size())
+    {
+        size_t remaining = output.front().size() - outputOffset;
 
-        string localpassword;
+        if (written < remaining)
+        {
+            outputOffset += written;
+            written = 0;
+            break;
+        }
 
-#if defined(WINDOWS_PHONE) || (defined(_WIN32) && defined(USE_CURL))
-        localpassword = password;
-#else
-        fsAccess->path2local(&password, &localpassword);
-#endif
+        written -= remaining;
+        output.pop_front();
+        outputOffset = 0;
+    }
 
-        localProxySettings.setCredentials(&localusername, &localpassword);
+    if (len && written < len)
+    {
+        if (!direct)
+        {
+            written = 0;
+        }
+
+        output.push_back(string(data + written, len - written));
+        outputBytes += len - written;
     }
 
-    sdkMutex.lock();
-    httpio->setproxy(&localProxySettings);
-    sdkMutex.unlock();
+    return true;
 }
 
-MegaProxy *MegaApiImpl::getAutoProxySettings()
+bool MegaHTTPConnection::onTransferData(MegaApi *, MegaTransfer *, char *buffer, size_t size)
 {
-    MegaProxy *proxySettings = new MegaProxy;
-    sdkMutex.lock();
-    Proxy *localProxySettings = httpio->getautoproxy();
-    sdkMutex.unlock();
-    proxySettings->setProxyType(localProxySettings->getProxyType());
-    if(localProxySettings->getProxyType() == Proxy::CUSTOM)
+    mutex.lock();
+
+    // returning false aborts the read
+    if (closed || failed)
     {
-        string localProxyURL = localProxySettings->getProxyURL();
-        string proxyURL;
-        fsAccess->local2path(&localProxyURL, &proxyURL);
-        proxySettings->setProxyURL(proxyURL.c_str());
+        mutex.unlock();
+        return false;
     }
 
-    delete localProxySettings;
-    return proxySettings;
+    bool result = send(buffer, size);
+
+    if (outputBytes && server)
+    {
+        server->notify();
+    }
+
+    mutex.unlock();
+    return result;
 }
 
-void MegaApiImpl::loop()
+void MegaHTTPConnection::onTransferFinish(MegaApi *, MegaTransfer *, MegaError *e)
 {
-#if (WINDOWS_PHONE || TARGET_OS_IPHONE)
-    // Workaround to get the IP of valid DNS servers on Windows Phone/iOS
-    string servers;
+    mutex.lock();
+    streaming = false;
 
-    while (true)
+    if (e->getErrorCode() && !closed)
     {
-    #ifdef WINDOWS_PHONE
-        client->httpio->getMEGADNSservers(&servers);
-    #else
-        __res_state res;
-        if(res_ninit(&res) == 0)
-        {
-            union res_sockaddr_union u[MAXNS];
-            int nscount = res_getservers(&res, u, MAXNS);
-
-            for(int i = 0; i < nscount; i++)
-            {
-                char straddr[INET6_ADDRSTRLEN];
-                straddr[0] = 0;
-
-                if(u[i].sin.sin_family == PF_INET)
-                {
-                    mega_inet_ntop(PF_INET, &u[i].sin.sin_addr, straddr, sizeof(straddr));
-                }
-
-                if(u[i].sin6.sin6_family == PF_INET6)
-                {
-                    mega_inet_ntop(PF_INET6, &u[i].sin6.sin6_addr, straddr, sizeof(straddr));
-                }
-
-                if(straddr[0])
-                {
-                    if (servers.size())
-                    {
-                        servers.append(",");
-                    }
-                    servers.append(straddr);
-                }
-            }
-
-            res_ndestroy(&res);
-        }
-    #endif
-
-        if (servers.size())
-            break;
-
-    #ifdef WINDOWS_PHONE
-        std::this_thread::sleep_for(std::chrono::seconds(1));
-    #else
-        sleep(1);
-    #endif
+        LOG_warn << "HTTP connection stream failed: " << e->getErrorCode();
+        failed = true;
     }
 
-    LOG_debug << "Using MEGA DNS servers " << servers;
-    httpio->setdnsservers(servers.c_str());
-
-#elif _WIN32
-    httpio->lock();
-#endif
-
-    while(true)
-	{
-        int r = client->wait();
-        if(r & Waiter::NEEDEXEC)
-        {
-            sendPendingTransfers();
-            sendPendingRequests();
-            if(threadExit)
-                break;
-
-            sdkMutex.lock();
-            client->exec();
-            sdkMutex.unlock();
-        }
-	}
-
-    sdkMutex.lock();
-    delete client;
+    // the server was stopped while this read was in progress
+    if (!server)
+    {
+        mutex.unlock();
+        delete this;
+        return;
+    }
 
-	//It doesn't seem fully safe to delete those objects :-/
-    // delete httpio;
-    // delete waiter;
-    // delete fsAccess;
-    sdkMutex.unlock();
+    server->notify();
+    mutex.unlock();
 }
 
-
-void MegaApiImpl::createFolder(const char *name, MegaNode *parent, MegaRequestListener *listener)
+MegaHTTPServer::MegaHTTPServer(MegaApiImpl *api)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_FOLDER, listener);
-    if(parent) request->setParentHandle(parent->getHandle());
-	request->setName(name);
-	requestQueue.push(request);
-    waiter->notify();
+    mutex.init(false);
+    this->api = api;
+    listenFd = -1;
+    wakeFds[0] = wakeFds[1] = -1;
+    port = 0;
+    exiting = false;
 }
 
-void MegaApiImpl::moveNode(MegaNode *node, MegaNode *newParent, MegaRequestListener *listener)
+MegaHTTPServer::~MegaHTTPServer()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-    if(newParent) request->setParentHandle(newParent->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+    stop();
 }
 
-void MegaApiImpl::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener *listener)
+bool MegaHTTPServer::start(int port, bool localOnly)
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
-    if(node)
+    if (listenFd >= 0 || port <= 0 || port > 65535)
     {
-        if(node->isPublic())
-        {
-            request->setPublicNode(node);
-        }
-        else
-        {
-            request->setNodeHandle(node->getHandle());
-        }
+        return false;
     }
-    if(target) request->setParentHandle(target->getHandle());
-	requestQueue.push(request);
-	waiter->notify();
-}
 
-void MegaApiImpl::copyNode(MegaNode *node, MegaNode *target, const char *newName, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
-    if(node)
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
     {
-        if(node->isPublic())
-        {
-            request->setPublicNode(node);
-        }
-        else
-        {
-            request->setNodeHandle(node->getHandle());
-        }
+        LOG_err << "Unable to create the HTTP server socket: " << errno;
+        return false;
     }
-    if(target) request->setParentHandle(target->getHandle());
-    request->setName(newName);
-    requestQueue.push(request);
-    waiter->notify();
-}
 
-void MegaApiImpl::renameNode(MegaNode *node, const char *newName, MegaRequestListener *listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_RENAME, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-	request->setName(newName);
-	requestQueue.push(request);
-    waiter->notify();
-}
+    int yes = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof yes);
 
-void MegaApiImpl::remove(MegaNode *node, MegaRequestListener *listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
-}
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((unsigned short)port);
+    addr.sin_addr.s_addr = htonl(localOnly ? INADDR_LOOPBACK : INADDR_ANY);
 
-void MegaApiImpl::cleanRubbishBin(MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CLEAN_RUBBISH_BIN, listener);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    if (bind(fd, (struct sockaddr *)&addr, sizeof addr) || listen(fd, 16) || pipe(wakeFds))
+    {
+        LOG_err << "Unable to start the HTTP server on port " << port << ": " << errno;
+        close(fd);
+        return false;
+    }
 
-void MegaApiImpl::sendFileToUser(MegaNode *node, MegaUser *user, MegaRequestListener *listener)
-{
-	return sendFileToUser(node, user ? user->getEmail() : NULL, listener);
-}
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(wakeFds[0], F_SETFL, fcntl(wakeFds[0], F_GETFL) | O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, fcntl(wakeFds[1], F_GETFL) | O_NONBLOCK);
 
-void MegaApiImpl::sendFileToUser(MegaNode *node, const char* email, MegaRequestListener *listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-    request->setEmail(email);
-	requestQueue.push(request);
-    waiter->notify();
-}
+    listenFd = fd;
+    this->port = port;
+    exiting = false;
+    thread.start(threadEntryPoint, this);
 
-void MegaApiImpl::share(MegaNode* node, MegaUser *user, int access, MegaRequestListener *listener)
-{
-    return share(node, user ? user->getEmail() : NULL, access, listener);
+    LOG_info << "HTTP server listening on port " << port;
+    return true;
 }
 
-void MegaApiImpl::share(MegaNode *node, const char* email, int access, MegaRequestListener *listener)
+void MegaHTTPServer::stop()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SHARE, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-	request->setEmail(email);
-	request->setAccess(access);
-	requestQueue.push(request);
-    waiter->notify();
-}
+    if (listenFd < 0)
+    {
+        return;
+    }
 
-void MegaApiImpl::loginToFolder(const char* megaFolderLink, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
-	request->setLink(megaFolderLink);
-    request->setEmail("FOLDER");
-	requestQueue.push(request);
-    waiter->notify();
-}
+    mutex.lock();
+    exiting = true;
+    mutex.unlock();
 
-void MegaApiImpl::importFileLink(const char* megaFileLink, MegaNode *parent, MegaRequestListener *listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_IMPORT_LINK, listener);
-	if(parent) request->setParentHandle(parent->getHandle());
-	request->setLink(megaFileLink);
-	requestQueue.push(request);
-    waiter->notify();
-}
+    notify();
+    thread.join();
 
-void MegaApiImpl::getPublicNode(const char* megaFileLink, MegaRequestListener *listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PUBLIC_NODE, listener);
-	request->setLink(megaFileLink);
-	requestQueue.push(request);
-    waiter->notify();
-}
+    // connections with a read in progress are deleted when it finishes,
+    // which, being closed, they make happen with the next data received
+    for (list<MegaHTTPConnection *>::iterator it = connections.begin(); it != connections.end(); it++)
+    {
+        MegaHTTPConnection *c = *it;
 
-void MegaApiImpl::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
-{
-	getNodeAttribute(node, 0, dstFilePath, listener);
-}
+        c->mutex.lock();
+        c->closed = true;
+        c->server = NULL;
+        bool streaming = c->streaming;
+        c->mutex.unlock();
 
-void MegaApiImpl::cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener)
-{
-	cancelGetNodeAttribute(node, 0, listener);
-}
+        if (!streaming)
+        {
+            delete c;
+        }
+    }
+    connections.clear();
 
-void MegaApiImpl::setThumbnail(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
-{
-	setNodeAttribute(node, 0, srcFilePath, listener);
-}
+    close(listenFd);
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    listenFd = -1;
+    wakeFds[0] = wakeFds[1] = -1;
+    port = 0;
 
-void MegaApiImpl::getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
-{
-	getNodeAttribute(node, 1, dstFilePath, listener);
+    LOG_info << "HTTP server stopped";
 }
 
-void MegaApiImpl::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
+int MegaHTTPServer::getPort()
 {
-	cancelGetNodeAttribute(node, 1, listener);
+    return port;
 }
 
-void MegaApiImpl::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
+void MegaHTTPServer::allow(MegaHandle h)
 {
-	setNodeAttribute(node, 1, srcFilePath, listener);
+    mutex.lock();
+    allowed.insert(h);
+    mutex.unlock();
 }
 
-void MegaApiImpl::getUserAvatar(MegaUser* user, const char *dstFilePath, MegaRequestListener *listener)
+void MegaHTTPServer::notify()
 {
-    getUserAttr(user, MegaApi::USER_ATTR_AVATAR, dstFilePath, listener);
-}
+    char c = 0;
 
-void MegaApiImpl::setAvatar(const char *dstFilePath, MegaRequestListener *listener)
-{
-    setUserAttr(MegaApi::USER_ATTR_AVATAR, dstFilePath, listener);
+    if (write(wakeFds[1], &c, 1) < 0)
+    {
+        // the pipe is full, the server thread is awake already
+    }
 }
 
-void MegaApiImpl::getUserAttribute(MegaUser* user, int type, MegaRequestListener *listener)
+void *MegaHTTPServer::threadEntryPoint(void *param)
 {
-    getUserAttr(user, type ? type : -1, NULL, listener);
-}
+    struct sigaction noaction;
+    memset(&noaction, 0, sizeof(noaction));
+    noaction.sa_handler = SIG_IGN;
+    ::sigaction(SIGPIPE, &noaction, 0);
 
-void MegaApiImpl::setUserAttribute(int type, const char *value, MegaRequestListener *listener)
-{
-    setUserAttr(type ? type : -1, value, listener);
+    ((MegaHTTPServer *)param)->loop();
+    return 0;
 }
 
-void MegaApiImpl::setCustomNodeAttribute(MegaNode *node, const char *attrName, const char *value, MegaRequestListener *listener)
+void MegaHTTPServer::loop()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_NODE, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-    request->setName(attrName);
-    request->setText(value);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    vector<struct pollfd> fds;
+    char buf[4096];
 
-void MegaApiImpl::exportNode(MegaNode *node, int64_t expireTime, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-    request->setNumber(expireTime);
-    request->setAccess(1);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    for (;;)
+    {
+        mutex.lock();
+        bool exit = exiting;
+        mutex.unlock();
 
-void MegaApiImpl::disableExport(MegaNode *node, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT, listener);
-    if(node) request->setNodeHandle(node->getHandle());
-    request->setAccess(0);
-    requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::fetchNodes(MegaRequestListener *listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES, listener);
-	requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::getPricing(MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PRICING, listener);
-    requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::getPaymentId(handle productHandle, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PAYMENT_ID, listener);
-    request->setNodeHandle(productHandle);
-    requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::upgradeAccount(MegaHandle productHandle, int paymentMethod, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_UPGRADE_ACCOUNT, listener);
-    request->setNodeHandle(productHandle);
-    request->setNumber(paymentMethod);
-    requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::submitPurchaseReceipt(int gateway, const char *receipt, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT, listener);
-    request->setNumber(gateway);
-    request->setText(receipt);
-    requestQueue.push(request);
-    waiter->notify();
-}
+        if (exit)
+        {
+            break;
+        }
 
-void MegaApiImpl::creditCardStore(const char* address1, const char* address2, const char* city,
-                                  const char* province, const char* country, const char *postalcode,
-                                  const char* firstname, const char* lastname, const char* creditcard,
-                                  const char* expire_month, const char* expire_year, const char* cv2,
-                                  MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_STORE, listener);
-    string email;
+        fds.resize(2 + connections.size());
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        fds[1].fd = wakeFds[0];
+        fds[1].events = POLLIN;
 
-    sdkMutex.lock();
-    User *u = client->finduser(client->me);
-    if (u)
-    {
-        email = u->email;
-    }
-    sdkMutex.unlock();
+        size_t i = 2;
+        for (list<MegaHTTPConnection *>::iterator it = connections.begin(); it != connections.end(); it++, i++)
+        {
+            MegaHTTPConnection *c = *it;
 
-    if (email.size())
-    {
-        string saddress1, saddress2, scity, sprovince, scountry, spostalcode;
-        string sfirstname, slastname, screditcard, sexpire_month, sexpire_year, scv2;
+            c->mutex.lock();
+            fds[i].fd = c->fd;
+            fds[i].events = (c->input.size() <= MAXHEADERSIZE ? POLLIN : 0) | (c->outputBytes ? POLLOUT : 0);
+            c->mutex.unlock();
+        }
 
-        if (address1)
+        if (poll(&fds[0], fds.size(), -1) < 0)
         {
-           saddress1 = address1;
+            if (errno != EINTR)
+            {
+                LOG_err << "HTTP server poll failed: " << errno;
+                break;
+            }
+            continue;
         }
 
-        if (address2)
+        if (fds[1].revents)
         {
-            saddress2 = address2;
+            while (read(wakeFds[0], buf, sizeof buf) > 0);
         }
 
-        if (city)
+        if (fds[0].revents & POLLIN)
         {
-            scity = city;
+            int fd;
+
+            while ((fd = accept(listenFd, NULL, NULL)) >= 0)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                connections.push_back(new MegaHTTPConnection(this, fd));
+            }
         }
 
-        if (province)
+        // connections accepted above were not polled yet
+        i = 2;
+        for (list<MegaHTTPConnection *>::iterator it = connections.begin(); it != connections.end() && i < fds.size(); it++, i++)
         {
-            sprovince = province;
+            MegaHTTPConnection *c = *it;
+
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR))
+            {
+                ssize_t r = recv(c->fd, buf, sizeof buf, 0);
+
+                if (r > 0)
+                {
+                    c->input.append(buf, r);
+                }
+                else if (!r || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                    c->mutex.lock();
+                    c->closed = true;
+                    c->mutex.unlock();
+                }
+            }
+
+            if (fds[i].revents & POLLOUT)
+            {
+                c->mutex.lock();
+                c->send(NULL, 0);
+                c->mutex.unlock();
+            }
         }
 
-        if (country)
+        for (list<MegaHTTPConnection *>::iterator it = connections.begin(); it != connections.end(); )
         {
-            scountry = country;
+            MegaHTTPConnection *c = *it;
+
+            c->mutex.lock();
+            if (c->failed)
+            {
+                c->closed = true;
+            }
+            bool closed = c->closed;
+            bool streaming = c->streaming;
+            c->mutex.unlock();
+
+            if (closed)
+            {
+                if (!streaming)
+                {
+                    delete c;
+                    connections.erase(it++);
+                    continue;
+                }
+            }
+            else if (c->responding)
+            {
+                continueResponse(c);
+            }
+            else
+            {
+                processRequest(c);
+            }
+
+            it++;
         }
+    }
+}
 
-        if (postalcode)
+void MegaHTTPServer::sendStatus(MegaHTTPConnection *c, int status, const char *reason, const char *headers)
+{
+    ostringstream response;
+
+    response << "HTTP/1.1 " << status << " " << reason << "\r\n"
+             << "Content-Length: 0\r\n"
+             << (headers ? headers : "")
+             << "Connection: " << (c->keepAlive ? "keep-alive" : "close") << "\r\n\r\n";
+
+    c->mutex.lock();
+    c->output.push_back(response.str());
+    c->outputBytes += c->output.back().size();
+    c->send(NULL, 0);
+    c->mutex.unlock();
+
+    c->responding = true;
+    c->streamPos = c->streamEnd = 0;
+}
+
+void MegaHTTPServer::processRequest(MegaHTTPConnection *c)
+{
+    size_t end = c->input.find("\r\n\r\n");
+
+    if (end == string::npos)
+    {
+        if (c->input.size() > MAXHEADERSIZE)
         {
-            spostalcode = postalcode;
+            c->input.clear();
+            c->keepAlive = false;
+            sendStatus(c, 400, "Bad Request");
+            continueResponse(c);
         }
+        return;
+    }
 
-        if (firstname)
+    string header = c->input.substr(0, end);
+    c->input.erase(0, end + 4);
+
+    istringstream lines(header);
+    string line, method, target, version;
+
+    getline(lines, line);
+    istringstream requestLine(line);
+    requestLine >> method >> target >> version;
+
+    c->keepAlive = (version == "HTTP/1.1");
+
+    string range;
+    while (getline(lines, line))
+    {
+        size_t colon = line.find(':');
+        if (colon == string::npos)
         {
-            sfirstname = firstname;
+            continue;
         }
 
-        if (lastname)
+        string name = line.substr(0, colon);
+        string value = line.substr(colon + 1);
+        transform(name.begin(), name.end(), name.begin(), ::tolower);
+        value.erase(0, value.find_first_not_of(" \t"));
+        value.erase(value.find_last_not_of(" \t\r") + 1);
+
+        if (name == "connection")
         {
-            slastname = lastname;
+            transform(value.begin(), value.end(), value.begin(), ::tolower);
+            if (value == "close")
+            {
+                c->keepAlive = false;
+            }
+            else if (value == "keep-alive")
+            {
+                c->keepAlive = true;
+            }
         }
-
-        if (creditcard)
+        else if (name == "range")
         {
-            screditcard = creditcard;
-            screditcard.erase(remove_if(screditcard.begin(), screditcard.end(),
-                                     not1(ptr_fun(static_cast<int(*)(int)>(isdigit)))), screditcard.end());
+            range = value;
         }
+    }
 
-        if (expire_month)
+    if (version.compare(0, 5, "HTTP/") || !target.size() || target[0] != '/')
+    {
+        c->input.clear();
+        c->keepAlive = false;
+        sendStatus(c, 400, "Bad Request");
+        continueResponse(c);
+        return;
+    }
+
+    bool head = (method == "HEAD");
+    if (!head && method != "GET")
+    {
+        sendStatus(c, 405, "Method Not Allowed", "Allow: GET, HEAD\r\n");
+        continueResponse(c);
+        return;
+    }
+
+    // /<node handle>/<name>
+    size_t slash = target.find('/', 1);
+    handle h = MegaApiImpl::base64ToHandle(target.substr(1, slash == string::npos ? string::npos : slash - 1).c_str());
+
+    mutex.lock();
+    bool isAllowed = allowed.find(h) != allowed.end();
+    mutex.unlock();
+
+    MegaNode *node = isAllowed ? api->getNodeByHandle(h) : NULL;
+    if (!node || node->getType() != MegaNode::TYPE_FILE)
+    {
+        delete node;
+        sendStatus(c, 404, "Not Found");
+        continueResponse(c);
+        return;
+    }
+
+    int64_t size = node->getSize();
+    int64_t start = 0;
+    int64_t last = size - 1;
+    bool partial = false;
+
+    // single byte ranges only, multiple ranges are answered with the whole file
+    if (!range.compare(0, 6, "bytes=") && range.find(',') == string::npos)
+    {
+        string spec = range.substr(6);
+        size_t dash = spec.find('-');
+
+        if (dash != string::npos && spec.find_first_not_of("0123456789-") == string::npos)
         {
-            sexpire_month = expire_month;
+            string first = spec.substr(0, dash);
+            string second = spec.substr(dash + 1);
+
+            if (first.size())
+            {
+                start = atoll(first.c_str());
+                if (second.size())
+                {
+                    last = std::min(last, (int64_t)atoll(second.c_str()));
+                }
+                partial = true;
+            }
+            else if (second.size())
+            {
+                start = size - std::min(size, (int64_t)atoll(second.c_str()));
+                partial = true;
+            }
+
+            if (partial && (start >= size || start > last))
+            {
+                ostringstream contentRange;
+                contentRange << "Content-Range: bytes */" << size << "\r\n";
+
+                delete node;
+                sendStatus(c, 416, "Range Not Satisfiable", contentRange.str().c_str());
+                continueResponse(c);
+                return;
+            }
         }
+    }
 
-        if (expire_year)
+    int64_t len = size ? last - start + 1 : 0;
+
+    ostringstream response;
+    response << "HTTP/1.1 " << (partial ? "206 Partial Content" : "200 OK") << "\r\n"
+             << "Content-Type: " << contentType(node->getName()) << "\r\n"
+             << "Content-Length: " << len << "\r\n"
+             << "Accept-Ranges: bytes\r\n";
+    if (partial)
+    {
+        response << "Content-Range: bytes " << start << "-" << last << "/" << size << "\r\n";
+    }
+    response << "Connection: " << (c->keepAlive ? "keep-alive" : "close") << "\r\n\r\n";
+
+    LOG_debug << "HTTP " << method << " " << target << " " << start << "-" << (start + len) << "/" << size;
+
+    c->mutex.lock();
+    c->output.push_back(response.str());
+    c->outputBytes += c->output.back().size();
+
+    // with data to follow, the headers go out with its first part
+    if (head || !len)
+    {
+        c->send(NULL, 0);
+    }
+    c->mutex.unlock();
+
+    c->responding = true;
+    c->node = node;
+    c->streamPos = start;
+    c->streamEnd = head ? start : start + len;
+
+    continueResponse(c);
+}
+
+void MegaHTTPServer::continueResponse(MegaHTTPConnection *c)
+{
+    c->mutex.lock();
+
+    if (c->streaming || c->closed)
+    {
+        c->mutex.unlock();
+        return;
+    }
+
+    if (c->streamPos < c->streamEnd)
+    {
+        // wait for the client to take the previous window
+        if (c->outputBytes >= (size_t)WINDOWSIZE)
         {
-            sexpire_year = expire_year;
+            c->mutex.unlock();
+            return;
         }
 
-        if (cv2)
+        int64_t pos = c->streamPos;
+        int64_t len = c->streamEnd - pos;
+        if (len > WINDOWSIZE)
         {
-            scv2 = cv2;
+            len = WINDOWSIZE;
         }
 
-        int tam = 256 + sfirstname.size() + slastname.size() + screditcard.size()
-                + sexpire_month.size() + sexpire_year.size() + scv2.size() + saddress1.size()
-                + saddress2.size() + scity.size() + sprovince.size() + spostalcode.size()
-                + scountry.size() + email.size();
+        c->streaming = true;
+        c->streamPos += len;
+        c->mutex.unlock();
 
-        char *ccplain = new char[tam];
-        snprintf(ccplain, tam, "{\"first_name\":\"%s\",\"last_name\":\"%s\","
-                "\"card_number\":\"%s\","
-                "\"expiry_date_month\":\"%s\",\"expiry_date_year\":\"%s\","
-                "\"cv2\":\"%s\",\"address1\":\"%s\","
-                "\"address2\":\"%s\",\"city\":\"%s\","
-                "\"province\":\"%s\",\"postal_code\":\"%s\","
-                "\"country_code\":\"%s\",\"email_address\":\"%s\"}", sfirstname.c_str(), slastname.c_str(),
-                 screditcard.c_str(), sexpire_month.c_str(), sexpire_year.c_str(), scv2.c_str(), saddress1.c_str(),
-                 saddress2.c_str(), scity.c_str(), sprovince.c_str(), spostalcode.c_str(), scountry.c_str(), email.c_str());
+        api->startStreaming(c->node, pos, len, c);
+        return;
+    }
 
-        request->setText((const char* )ccplain);
-        delete [] ccplain;
+    // the response is complete once it has been written out
+    if (c->outputBytes)
+    {
+        c->mutex.unlock();
+        return;
     }
 
-    requestQueue.push(request);
-    waiter->notify();
-}
+    if (!c->keepAlive)
+    {
+        c->closed = true;
+    }
+    bool closed = c->closed;
+    c->mutex.unlock();
 
-void MegaApiImpl::creditCardQuerySubscriptions(MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS, listener);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    c->responding = false;
+    delete c->node;
+    c->node = NULL;
 
-void MegaApiImpl::creditCardCancelSubscriptions(const char* reason, MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS, listener);
-    request->setText(reason);
-    requestQueue.push(request);
-    waiter->notify();
+    if (!closed)
+    {
+        processRequest(c);
+    }
 }
 
-void MegaApiImpl::getPaymentMethods(MegaRequestListener *listener)
+const char *MegaHTTPServer::contentType(const char *name)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PAYMENT_METHODS, listener);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    static const char *const types[][2] = {
+        { "mp4", "video/mp4" }, { "m4v", "video/mp4" }, { "mkv", "video/x-matroska" },
+        { "webm", "video/webm" }, { "avi", "video/x-msvideo" }, { "mov", "video/quicktime" },
+        { "mp3", "audio/mpeg" }, { "m4a", "audio/mp4" }, { "ogg", "audio/ogg" },
+        { "flac", "audio/flac" }, { "wav", "audio/wav" }, { "jpg", "image/jpeg" },
+        { "jpeg", "image/jpeg" }, { "png", "image/png" }, { "gif", "image/gif" },
+        { "pdf", "application/pdf" }, { "txt", "text/plain" }, { "html", "text/html" }
+    };
 
-char *MegaApiImpl::exportMasterKey()
-{
-    sdkMutex.lock();
-    char* buf = NULL;
+    const char *ext = name ? strrchr(name, '.') : NULL;
 
-    if(client->loggedin())
+    if (ext)
     {
-        buf = new char[SymmCipher::KEYLENGTH * 4 / 3 + 4];
-        Base64::btoa(client->key.key, SymmCipher::KEYLENGTH, buf);
+        for (size_t i = 0; i < sizeof types / sizeof *types; i++)
+        {
+            if (!strcasecmp(ext + 1, types[i][0]))
+            {
+                return types[i][1];
+            }
+        }
     }
 
-    sdkMutex.unlock();
-    return buf;
+    return "application/octet-stream";
 }
+#endif
 
-void MegaApiImpl::getAccountDetails(bool storage, bool transfer, bool pro, bool sessions, bool purchases, bool transactions, MegaRequestListener *listener)
+MegaPwKeyDerivation::MegaPwKeyDerivation(MegaRequestPrivate *request, MegaWaiter *waiter)
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ACCOUNT_DETAILS, listener);
-	int numDetails = 0;
-	if(storage) numDetails |= 0x01;
-    if(transfer) numDetails |= 0x02;
-	if(pro) numDetails |= 0x04;
-	if(transactions) numDetails |= 0x08;
-	if(purchases) numDetails |= 0x10;
-	if(sessions) numDetails |= 0x20;
-	request->setNumDetails(numDetails);
+    this->request = request;
+    this->waiter = waiter;
+    e = API_OK;
+    done = false;
+    mutex.init(false);
+    thread.start(threadEntryPoint, this);
+}
 
-	requestQueue.push(request);
-    waiter->notify();
+MegaPwKeyDerivation::~MegaPwKeyDerivation()
+{
+    thread.join();
+    memset(pwkey, 0, sizeof pwkey);
+    memset(newpwkey, 0, sizeof newpwkey);
 }
 
-void MegaApiImpl::changePassword(const char *oldPassword, const char *newPassword, MegaRequestListener *listener)
+bool MegaPwKeyDerivation::needed(MegaRequestPrivate *request)
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CHANGE_PW, listener);
-	request->setPassword(oldPassword);
-	request->setNewPassword(newPassword);
-	requestQueue.push(request);
-    waiter->notify();
+    switch (request->getType())
+    {
+        case MegaRequest::TYPE_LOGIN:
+            // a plain email and password login, see sendPendingRequests
+            return !request->getLink() && !request->getSessionKey() && !request->getPrivateKey()
+                    && request->getEmail() && request->getPassword();
+
+        case MegaRequest::TYPE_CHANGE_PW:
+            return request->getPassword() && request->getNewPassword();
+
+        default:
+            return false;
+    }
 }
 
-void MegaApiImpl::logout(MegaRequestListener *listener)
+bool MegaPwKeyDerivation::isDone()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT, listener);
-    request->setFlag(true);
-	requestQueue.push(request);
-    waiter->notify();
+    mutex.lock();
+    bool d = done;
+    mutex.unlock();
+    return d;
 }
 
-void MegaApiImpl::localLogout(MegaRequestListener *listener)
+void *MegaPwKeyDerivation::threadEntryPoint(void *param)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT, listener);
-    request->setFlag(false);
-    requestQueue.push(request);
-    waiter->notify();
+    MegaPwKeyDerivation *derivation = (MegaPwKeyDerivation *)param;
+    MegaRequestPrivate *request = derivation->request;
+
+    error e = MegaClient::pw_key(request->getPassword(), derivation->pwkey);
+    if (!e && request->getType() == MegaRequest::TYPE_CHANGE_PW)
+    {
+        e = MegaClient::pw_key(request->getNewPassword(), derivation->newpwkey);
+    }
+
+    derivation->mutex.lock();
+    derivation->e = e;
+    derivation->done = true;
+    derivation->mutex.unlock();
+
+    derivation->waiter->notify();
+    return NULL;
 }
 
-void MegaApiImpl::submitFeedback(int rating, const char *comment, MegaRequestListener *listener)
+MegaCallbackEvent::MegaCallbackEvent(int type)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SUBMIT_FEEDBACK, listener);
-    request->setText(comment);
-    request->setNumber(rating);
-    requestQueue.push(request);
-    waiter->notify();
+    this->type = type;
+    request = NULL;
+    transfer = NULL;
+    error = NULL;
+    users = NULL;
+    contactRequests = NULL;
+    nodes = NULL;
+    progress = NULL;
+#ifdef ENABLE_SYNC
+    sync = NULL;
+    syncEvent = NULL;
+#endif
+    state = 0;
+    queued = MegaSdkMutex::now();
+    refs = 1;
 }
 
-void MegaApiImpl::reportEvent(const char *details, MegaRequestListener *listener)
+MegaCallbackEvent::~MegaCallbackEvent()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REPORT_EVENT, listener);
-    request->setText(details);
-    requestQueue.push(request);
-    waiter->notify();
+    delete request;
+    delete transfer;
+    delete error;
+    delete users;
+    delete contactRequests;
+    delete nodes;
+    delete progress;
+#ifdef ENABLE_SYNC
+    delete sync;
+    delete syncEvent;
+#endif
 }
 
-void MegaApiImpl::sendEvent(int eventType, const char *message, MegaRequestListener *listener)
+MegaCallbackExecutor::MegaCallbackExecutor(MegaApi *api)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SEND_EVENT, listener);
-    request->setNumber(eventType);
-    request->setText(message);
-    requestQueue.push(request);
-    waiter->notify();
+    this->api = api;
+    thread = NULL;
+    mutex.init(false);
+    deliverMutex.init(true);
+    ready.init(0);
+    space.init(0);
+    enabled = false;
+    running = false;
+    stopping = false;
+    producerWaiting = false;
+    maxPending = 0;
+    maxQueued = 0;
+    delivered = 0;
+    backpressureWaits = 0;
+    listenerTime = 0;
+    maxListenerTime = 0;
+    maxDelay = 0;
 }
 
-void MegaApiImpl::getNodeAttribute(MegaNode *node, int type, const char *dstFilePath, MegaRequestListener *listener)
+MegaCallbackExecutor::~MegaCallbackExecutor()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_ATTR_FILE, listener);
-    if(dstFilePath)
-    {
-        string path(dstFilePath);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
+    stop();
+}
 
-        int c = path[path.size()-1];
-        if((c=='/') || (c == '\\'))
-        {
-            const char *base64Handle = node->getBase64Handle();
-            path.append(base64Handle);
-            path.push_back('0' + type);
-            path.append(".jpg");
-            delete [] base64Handle;
-        }
+void MegaCallbackExecutor::start(int maxPending)
+{
+    mutex.lock();
+    this->maxPending = maxPending;
+    enabled = true;
 
-        request->setFile(path.c_str());
-    }
+    if (!running)
+    {
+        running = true;
+        stopping = false;
+        mutex.unlock();
 
-    request->setParamType(type);
-    if(node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+        thread = new MegaThread();
+        thread->start(threadEntryPoint, this);
+        return;
+    }
+    mutex.unlock();
 }
 
-void MegaApiImpl::cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener)
+void MegaCallbackExecutor::disable()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_ATTR_FILE, listener);
-	request->setParamType(type);
-	if (node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-	waiter->notify();
+    mutex.lock();
+    enabled = false;
+    mutex.unlock();
 }
 
-void MegaApiImpl::setNodeAttribute(MegaNode *node, int type, const char *srcFilePath, MegaRequestListener *listener)
+bool MegaCallbackExecutor::isEnabled()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_FILE, listener);
-	request->setFile(srcFilePath);
-    request->setParamType(type);
-    if(node) request->setNodeHandle(node->getHandle());
-	requestQueue.push(request);
-    waiter->notify();
+    return enabled;
 }
 
-void MegaApiImpl::getUserAttr(MegaUser *user, int type, const char *dstFilePath, MegaRequestListener *listener)
+void MegaCallbackExecutor::stop()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_ATTR_USER, listener);
-
-    if (type == MegaApi::USER_ATTR_AVATAR && dstFilePath)
+    mutex.lock();
+    enabled = false;
+    if (!running)
     {
-        string path(dstFilePath);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-
-        int c = path[path.size()-1];
-        if((c=='/') || (c == '\\'))
-        {
-            const char *email = user->getEmail();
-            path.append(email);
-            path.push_back('0' + type);
-            path.append(".jpg");
-            delete [] email;
-        }
-
-        request->setFile(path.c_str());
+        mutex.unlock();
+        return;
     }
 
-    request->setParamType(type);
-    if(user)
+    stopping = true;
+    if (producerWaiting)
     {
-        request->setEmail(user->getEmail());
+        producerWaiting = false;
+        space.release();
     }
-	requestQueue.push(request);
-    waiter->notify();
+    mutex.unlock();
+
+    ready.release();
+    thread->join();
+    delete thread;
+    thread = NULL;
+
+    mutex.lock();
+    running = false;
+    mutex.unlock();
 }
 
-void MegaApiImpl::setUserAttr(int type, const char *srcFilePath, MegaRequestListener *listener)
+void MegaCallbackExecutor::add(MegaCallbackEvent *event, int kind, void *listener)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_USER, listener);
-    if(type == MegaApi::USER_ATTR_AVATAR)
+    if (!listener)
     {
-        request->setFile(srcFilePath);
+        return;
     }
-    else
+
+    Entry entry;
+    entry.event = event;
+    entry.kind = kind;
+    entry.listener = listener;
+
+    mutex.lock();
+    event->refs++;
+    queue.push_back(entry);
+    if ((long long)queue.size() > maxQueued)
     {
-        request->setText(srcFilePath);
+        maxQueued = queue.size();
     }
+    mutex.unlock();
 
-    request->setParamType(type);
-    requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::addContact(const char* email, MegaRequestListener* listener)
-{
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_CONTACT, listener);
-	request->setEmail(email);
-	requestQueue.push(request);
-    waiter->notify();
+    ready.release();
 }
 
-void MegaApiImpl::inviteContact(const char *email, const char *message,int action, MegaRequestListener *listener)
+void MegaCallbackExecutor::done(MegaCallbackEvent *event)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_INVITE_CONTACT, listener);
-    request->setNumber(action);
-    request->setEmail(email);
-    request->setText(message);
-    requestQueue.push(request);
-    waiter->notify();
+    mutex.lock();
+    release(event);
+    mutex.unlock();
 }
 
-void MegaApiImpl::replyContactRequest(MegaContactRequest *r, int action, MegaRequestListener *listener)
+// (with the mutex held)
+void MegaCallbackExecutor::release(MegaCallbackEvent *event)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REPLY_CONTACT_REQUEST, listener);
-    if(r)
+    if (!--event->refs)
     {
-        request->setNodeHandle(r->getHandle());
+        delete event;
     }
-
-    request->setNumber(action);
-    requestQueue.push(request);
-    waiter->notify();
 }
 
-void MegaApiImpl::removeContact(MegaUser *user, MegaRequestListener* listener)
+void MegaCallbackExecutor::waitForSpace()
 {
-	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_CONTACT, listener);
-    if(user)
+    mutex.lock();
+    while (running && !stopping && maxPending > 0 && (int)queue.size() >= maxPending)
     {
-        request->setEmail(user->getEmail());
+        producerWaiting = true;
+        backpressureWaits++;
+        mutex.unlock();
+        space.wait();
+        mutex.lock();
     }
-
-	requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::pauseTransfers(bool pause, int direction, MegaRequestListener* listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_PAUSE_TRANSFERS, listener);
-    request->setFlag(pause);
-    request->setNumber(direction);
-    requestQueue.push(request);
-    waiter->notify();
+    mutex.unlock();
 }
 
-bool MegaApiImpl::areTransfersPaused(int direction)
+void MegaCallbackExecutor::removeListener(void *listener)
 {
-    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+    mutex.lock();
+    for (deque<Entry>::iterator it = queue.begin(); it != queue.end(); )
     {
-        return false;
+        if (it->listener == listener)
+        {
+            release(it->event);
+            it = queue.erase(it);
+        }
+        else
+        {
+            it++;
+        }
     }
 
-    bool result;
-    sdkMutex.lock();
-    if(direction == MegaTransfer::TYPE_DOWNLOAD)
+    if (producerWaiting && (int)queue.size() < maxPending)
     {
-        result = client->xferpaused[GET];
+        producerWaiting = false;
+        space.release();
     }
-    else
+
+    bool wait = running;
+    mutex.unlock();
+
+    // the listener may be in the middle of a callback
+    if (wait)
     {
-        result = client->xferpaused[PUT];
+        deliverMutex.lock();
+        deliverMutex.unlock();
     }
-    sdkMutex.unlock();
-    return result;
 }
 
-//-1 -> AUTO, 0 -> NONE, >0 -> b/s
-void MegaApiImpl::setUploadLimit(int bpslimit)
+long long MegaCallbackExecutor::getStats(int type)
 {
-    client->putmbpscap = bpslimit;
-}
+    long long result;
 
-void MegaApiImpl::setDownloadMethod(int method)
-{
-    switch(method)
+    mutex.lock();
+    switch (type)
     {
-        case MegaApi::TRANSFER_METHOD_NORMAL:
-            client->usealtdownport = false;
-            client->autodownport = false;
+        case MegaApi::CALLBACK_STATS_QUEUED:
+            result = queue.size();
             break;
-        case MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT:
-            client->usealtdownport = true;
-            client->autodownport = false;
+        case MegaApi::CALLBACK_STATS_MAX_QUEUED:
+            result = maxQueued;
             break;
-        case MegaApi::TRANSFER_METHOD_AUTO:
-            client->autodownport = true;
+        case MegaApi::CALLBACK_STATS_DELIVERED:
+            result = delivered;
             break;
-        case MegaApi::TRANSFER_METHOD_AUTO_NORMAL:
-            client->usealtdownport = false;
-            client->autodownport = true;
+        case MegaApi::CALLBACK_STATS_BACKPRESSURE_WAITS:
+            result = backpressureWaits;
             break;
-        case MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE:
-            client->usealtdownport = true;
-            client->autodownport = true;
+        case MegaApi::CALLBACK_STATS_LISTENER_TIME:
+            result = listenerTime;
             break;
-        default:
+        case MegaApi::CALLBACK_STATS_LISTENER_TIME_MAX:
+            result = maxListenerTime;
             break;
+        case MegaApi::CALLBACK_STATS_DELAY_MAX:
+            result = maxDelay;
+            break;
+        default:
+            result = -1;
     }
+    mutex.unlock();
+
+    return result;
 }
 
-void MegaApiImpl::setUploadMethod(int method)
+template <class L>
+static void deliverRequest(MegaApi *api, L *listener, MegaCallbackEvent *event)
 {
-    switch(method)
+    switch (event->type)
     {
-        case MegaApi::TRANSFER_METHOD_NORMAL:
-            client->usealtupport = false;
-            client->autoupport = false;
-            break;
-        case MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT:
-            client->usealtupport = true;
-            client->autoupport = false;
+        case MegaCallbackEvent::REQUEST_START:
+            listener->onRequestStart(api, event->request);
             break;
-        case MegaApi::TRANSFER_METHOD_AUTO:
-            client->autoupport = true;
+        case MegaCallbackEvent::REQUEST_FINISH:
+            listener->onRequestFinish(api, event->request, event->error);
             break;
-        case MegaApi::TRANSFER_METHOD_AUTO_NORMAL:
-            client->usealtupport = false;
-            client->autoupport = true;
+        case MegaCallbackEvent::REQUEST_UPDATE:
+            listener->onRequestUpdate(api, event->request);
             break;
-        case MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE:
-            client->usealtupport = true;
-            client->autoupport = true;
-            break;
-        default:
+        case MegaCallbackEvent::REQUEST_TEMPORARY_ERROR:
+            listener->onRequestTemporaryError(api, event->request, event->error);
             break;
     }
 }
 
-int MegaApiImpl::getDownloadMethod()
+template <class L>
+static void deliverTransfer(MegaApi *api, L *listener, MegaCallbackEvent *event)
 {
-    if (client->autodownport)
+    switch (event->type)
     {
-        if(client->usealtdownport)
-        {
-            return MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE;
-        }
-        else
-        {
-            return MegaApi::TRANSFER_METHOD_AUTO_NORMAL;
-        }
+        case MegaCallbackEvent::TRANSFER_START:
+            listener->onTransferStart(api, event->transfer);
+            break;
+        case MegaCallbackEvent::TRANSFER_FINISH:
+            listener->onTransferFinish(api, event->transfer, event->error);
+            break;
+        case MegaCallbackEvent::TRANSFER_UPDATE:
+            listener->onTransferUpdate(api, event->transfer);
+            break;
+        case MegaCallbackEvent::TRANSFER_TEMPORARY_ERROR:
+            listener->onTransferTemporaryError(api, event->transfer, event->error);
+            break;
+        case MegaCallbackEvent::TRANSFERS_PROGRESS:
+            listener->onTransfersProgress(api, event->progress);
+            break;
     }
+}
 
-    if (client->usealtdownport)
+template <class L>
+static void deliverGlobal(MegaApi *api, L *listener, MegaCallbackEvent *event)
+{
+    switch (event->type)
     {
-        return MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT;
+        case MegaCallbackEvent::USERS_UPDATE:
+            listener->onUsersUpdate(api, event->users);
+            break;
+        case MegaCallbackEvent::CONTACT_REQUESTS_UPDATE:
+            listener->onContactRequestsUpdate(api, event->contactRequests);
+            break;
+        case MegaCallbackEvent::NODES_UPDATE:
+            listener->onNodesUpdate(api, event->nodes);
+            break;
+        case MegaCallbackEvent::ACCOUNT_UPDATE:
+            listener->onAccountUpdate(api);
+            break;
+        case MegaCallbackEvent::RELOAD_NEEDED:
+            listener->onReloadNeeded(api);
+            break;
+#ifdef ENABLE_SYNC
+        case MegaCallbackEvent::GLOBAL_SYNC_STATE_CHANGED:
+            listener->onGlobalSyncStateChanged(api);
+            break;
+#endif
     }
-
-    return MegaApi::TRANSFER_METHOD_NORMAL;
 }
 
-int MegaApiImpl::getUploadMethod()
+#ifdef ENABLE_SYNC
+template <class L>
+static void deliverSync(MegaApi *api, L *listener, MegaCallbackEvent *event)
 {
-    if (client->autoupport)
+    switch (event->type)
     {
-        if(client->usealtupport)
-        {
-            return MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE;
-        }
-        else
-        {
-            return MegaApi::TRANSFER_METHOD_AUTO_NORMAL;
-        }
+        case MegaCallbackEvent::SYNC_STATE_CHANGED:
+            listener->onSyncStateChanged(api, event->sync);
+            break;
+        case MegaCallbackEvent::SYNC_EVENT:
+            listener->onSyncEvent(api, event->sync, event->syncEvent);
+            break;
+        case MegaCallbackEvent::SYNC_FILE_STATE_CHANGED:
+            listener->onSyncFileStateChanged(api, event->sync, event->path.c_str(), event->state);
+            break;
     }
+}
+#endif
 
-    if (client->usealtupport)
+void MegaCallbackExecutor::deliver(Entry *entry)
+{
+    MegaCallbackEvent *event = entry->event;
+
+    // the copies of finished requests and transfers get the time of their
+    // first delivery
+    if (event->type == MegaCallbackEvent::REQUEST_FINISH
+            && !event->request->getTiming(MegaRequest::TIMING_CALLBACK))
     {
-        return MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT;
+        ((MegaRequestPrivate *)event->request)->setTiming(MegaRequest::TIMING_CALLBACK);
+    }
+    else if (event->type == MegaCallbackEvent::TRANSFER_FINISH
+            && !event->transfer->getTiming(MegaTransfer::TIMING_CALLBACK))
+    {
+        ((MegaTransferPrivate *)event->transfer)->setTiming(MegaTransfer::TIMING_CALLBACK);
     }
 
-    return MegaApi::TRANSFER_METHOD_NORMAL;
+    switch (entry->kind)
+    {
+        case LISTENER:
+        {
+            MegaListener *listener = (MegaListener *)entry->listener;
+            deliverRequest(api, listener, event);
+            deliverTransfer(api, listener, event);
+            deliverGlobal(api, listener, event);
+#ifdef ENABLE_SYNC
+            deliverSync(api, listener, event);
+#endif
+            break;
+        }
+        case REQUEST_LISTENER:
+            deliverRequest(api, (MegaRequestListener *)entry->listener, event);
+            break;
+        case TRANSFER_LISTENER:
+            deliverTransfer(api, (MegaTransferListener *)entry->listener, event);
+            break;
+        case GLOBAL_LISTENER:
+            deliverGlobal(api, (MegaGlobalListener *)entry->listener, event);
+            break;
+#ifdef ENABLE_SYNC
+        case SYNC_LISTENER:
+            deliverSync(api, (MegaSyncListener *)entry->listener, event);
+            break;
+#endif
+    }
 }
 
-MegaTransferList *MegaApiImpl::getTransfers()
+void MegaCallbackExecutor::run()
 {
-    sdkMutex.lock();
-
-    vector<MegaTransfer *> transfers;
-    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    for (;;)
     {
-        for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
+        ready.wait();
+
+        // the entry is popped with the delivery lock held, so that
+        // removeListener() can't return while it's being delivered
+        deliverMutex.lock();
+        mutex.lock();
+
+        if (queue.empty())
         {
-            Transfer *t = it->second;
-            if(transferMap.find(t->tag) == transferMap.end())
+            bool finished = stopping;
+            mutex.unlock();
+            deliverMutex.unlock();
+
+            if (finished)
             {
-                continue;
+                return;
             }
-            MegaTransferPrivate* transfer = transferMap.at(t->tag);
-            transfers.push_back(transfer);
+            continue;
         }
-    }
-
-    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
-
-    sdkMutex.unlock();
-    return result;
-}
-
-MegaTransfer *MegaApiImpl::getTransferByTag(int transferTag)
-{
-    MegaTransfer* value = NULL;
-    sdkMutex.lock();
 
-    if(transferMap.find(transferTag) == transferMap.end())
-    {
-        sdkMutex.unlock();
-        return NULL;
-    }
+        Entry entry = queue.front();
+        queue.pop_front();
 
-    value = transferMap.at(transferTag)->copy();
-    sdkMutex.unlock();
-    return value;
-}
+        if (producerWaiting && (int)queue.size() < maxPending)
+        {
+            producerWaiting = false;
+            space.release();
+        }
+        mutex.unlock();
 
-MegaTransferList *MegaApiImpl::getTransfers(int type)
-{
-    if(type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD)
-    {
-        return new MegaTransferListPrivate();
-    }
+        long long start = MegaSdkMutex::now();
+        deliver(&entry);
+        long long elapsed = MegaSdkMutex::now() - start;
 
-    sdkMutex.lock();
+        deliverMutex.unlock();
 
-    vector<MegaTransfer *> transfers;
-    for (transfer_map::iterator it = client->transfers[type].begin(); it != client->transfers[type].end(); it++)
-    {
-        Transfer *t = it->second;
-        if(transferMap.find(t->tag) == transferMap.end())
+        mutex.lock();
+        delivered++;
+        listenerTime += elapsed;
+        if (elapsed > maxListenerTime)
         {
-            continue;
+            maxListenerTime = elapsed;
         }
-        MegaTransferPrivate* transfer = transferMap.at(t->tag);
-        transfers.push_back(transfer);
+        if (start - entry.event->queued > maxDelay)
+        {
+            maxDelay = start - entry.event->queued;
+        }
+        if (elapsed >= MegaSdkMutex::SLOWLOCK)
+        {
+            LOG_debug << "Slow listener: " << elapsed << " us";
+        }
+        release(entry.event);
+        mutex.unlock();
     }
+}
 
-    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+void *MegaCallbackExecutor::threadEntryPoint(void *param)
+{
+    ((MegaCallbackExecutor *)param)->run();
+    return NULL;
+}
 
-    sdkMutex.unlock();
-    return result;
+MegaSdkMutex::MegaSdkMutex()
+{
+    memset(&stats, 0, sizeof stats);
+    depth = 0;
+    lockedAt = 0;
 }
 
-MegaTransferList *MegaApiImpl::getChildTransfers(int transferTag)
+void MegaSdkMutex::init()
 {
-    sdkMutex.lock();
+    mutex.init();
+    statsMutex.init(false);
+}
 
-    if(transferMap.find(transferTag) == transferMap.end())
+long long MegaSdkMutex::now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (counter.QuadPart / frequency.QuadPart) * 1000000
+            + (counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#else
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000000LL + tv.tv_usec;
+#endif
+}
+
+void MegaSdkMutex::recordWait(long long waited, bool shared)
+{
+    statsMutex.lock();
+    if (shared)
     {
-        sdkMutex.unlock();
-        return new MegaTransferListPrivate();
+        stats.sharedLocks++;
     }
-
-    MegaTransfer *transfer = transferMap.at(transferTag);
-    if(!transfer->isFolderTransfer())
+    else
     {
-        sdkMutex.unlock();
-        return new MegaTransferListPrivate();
+        stats.exclusiveLocks++;
     }
-
-    vector<MegaTransfer *> transfers;
-    for(std::map<int, MegaTransferPrivate *>::iterator it = transferMap.begin(); it != transferMap.end(); it++)
+    stats.waitTime += waited;
+    if (waited > stats.maxWaitTime)
     {
-        MegaTransferPrivate *t = it->second;
-        if(t->getFolderTransferTag() == transferTag)
-        {
-            transfers.push_back(transfer);
-        }
+        stats.maxWaitTime = waited;
     }
+    statsMutex.unlock();
 
-    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
-
-    sdkMutex.unlock();
-    return result;
+    if (waited > SLOWLOCK)
+    {
+        LOG_warn << "Waited " << waited / 1000 << " ms for the " << (shared ? "shared" : "exclusive") << " SDK lock";
+    }
 }
 
-void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime, int folderTransferTag, MegaTransferListener *listener)
+void MegaSdkMutex::lock()
 {
-    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, listener);
-    if(localPath)
-    {
-        string path(localPath);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-        transfer->setPath(path.data());
-    }
+    long long start = now();
+    mutex.lock();
 
-    if(parent)
+    if (!depth++)
     {
-        transfer->setParentHandle(parent->getHandle());
+        lockedAt = now();
+        recordWait(lockedAt - start, false);
     }
+}
 
-    transfer->setMaxRetries(maxRetries);
-
-    if(fileName)
+void MegaSdkMutex::unlock()
+{
+    if (!--depth)
     {
-        transfer->setFileName(fileName);
-    }
+        long long held = now() - lockedAt;
 
-    transfer->setTime(mtime);
+        statsMutex.lock();
+        stats.holdTime += held;
+        if (held > stats.maxHoldTime)
+        {
+            stats.maxHoldTime = held;
+        }
+        statsMutex.unlock();
 
-    if(folderTransferTag)
-    {
-        transfer->setFolderTransferTag(folderTransferTag);
+        if (held > SLOWLOCK)
+        {
+            LOG_warn << "SDK lock held exclusively for " << held / 1000 << " ms";
+        }
     }
 
-	transferQueue.push(transfer);
-    waiter->notify();
+    mutex.unlock();
 }
 
-void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, MegaTransferListener *listener)
-{ return startUpload(localPath, parent, (const char *)NULL, -1, 0, listener); }
+void MegaSdkMutex::lockShared()
+{
+    long long start = now();
+    mutex.lockshared();
+    recordWait(now() - start, true);
+}
 
-void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, int64_t mtime, MegaTransferListener *listener)
-{ return startUpload(localPath, parent, (const char *)NULL, mtime, 0, listener); }
+void MegaSdkMutex::unlockShared()
+{
+    mutex.unlockshared();
+}
 
-void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener)
-{ return startUpload(localPath, parent, fileName, -1, 0, listener); }
+void MegaSdkMutex::getStats(Stats *s)
+{
+    statsMutex.lock();
+    *s = stats;
+    statsMutex.unlock();
+}
 
-void MegaApiImpl::startDownload(MegaNode *node, const char* localPath, long startPos, long endPos, MegaTransferListener *listener)
+DbTable* MegaDbAccess::open(FileSystemAccess *fsAccess, string *name)
 {
-	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
+    DbTable *table = DBACCESS_CLASS::open(fsAccess, name);
 
-    if(localPath)
+    if (!table)
     {
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        string path(localPath);
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-        localPath = path.data();
-#endif
-
-        int c = localPath[strlen(localPath)-1];
-        if((c=='/') || (c == '\\')) transfer->setParentPath(localPath);
-        else transfer->setPath(localPath);
+        return NULL;
     }
 
-    if(node)
-    {
-        transfer->setNodeHandle(node->getHandle());
-        if(node->isPublic())
-            transfer->setPublicNode(node);
-    }
-	transfer->setStartPos(startPos);
-	transfer->setEndPos(endPos);
-	transfer->setMaxRetries(maxRetries);
+    return new AsyncDbTable(table, new MegaThread, new MegaMutex, new MegaSemaphore, new MegaSemaphore, new MegaSemaphore);
+}
 
-	transferQueue.push(transfer);
-	waiter->notify();
+MegaRequestMap::iterator::iterator()
+{
+    slot = NULL;
+    last = NULL;
 }
 
-void MegaApiImpl::startDownload(MegaNode *node, const char* localFolder, MegaTransferListener *listener)
-{ startDownload(node, localFolder, 0, 0, listener); }
+MegaRequestMap::iterator::iterator(value_type *s, value_type *l)
+{
+    slot = s;
+    last = l;
+    skip();
+}
 
-void MegaApiImpl::cancelTransfer(MegaTransfer *t, MegaRequestListener *listener)
+// advance to the next occupied slot (or end)
+void MegaRequestMap::iterator::skip()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
-    if(t)
+    while (slot < last && slot->first < 0)
     {
-        request->setTransferTag(t->getTag());
+        slot++;
     }
-    requestQueue.push(request);
-    waiter->notify();
 }
 
-void MegaApiImpl::cancelTransferByTag(int transferTag, MegaRequestListener *listener)
+MegaRequestMap::iterator& MegaRequestMap::iterator::operator++()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
-    request->setTransferTag(transferTag);
-    requestQueue.push(request);
-    waiter->notify();
+    slot++;
+    skip();
+    return *this;
 }
 
-void MegaApiImpl::cancelTransfers(int direction, MegaRequestListener *listener)
+MegaRequestMap::iterator MegaRequestMap::iterator::operator++(int)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFERS, listener);
-    request->setParamType(direction);
-    requestQueue.push(request);
-    waiter->notify();
+    iterator it = *this;
+    ++*this;
+    return it;
 }
 
-void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener)
+MegaRequestMap::MegaRequestMap()
 {
-	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
-	if(node && !node->isPublic())
-	{
-		transfer->setNodeHandle(node->getHandle());
-	}
-	else
-	{
-		transfer->setPublicNode(node);
-	}
+    slots = NULL;
+    mask = 0;
+    count = 0;
+    used = 0;
+}
 
-	transfer->setStartPos(startPos);
-	transfer->setEndPos(startPos + size - 1);
-	transfer->setMaxRetries(maxRetries);
-	transferQueue.push(transfer);
-	waiter->notify();
+MegaRequestMap::~MegaRequestMap()
+{
+    delete [] slots;
 }
 
-#ifdef ENABLE_SYNC
+// tags are sequential, spread them over the table (Fibonacci hashing)
+size_t MegaRequestMap::hash(int tag)
+{
+    return (size_t)((uint32_t)tag * 2654435769U);
+}
 
-//Move local files inside synced folders to the "Rubbish" folder.
-bool MegaApiImpl::moveToLocalDebris(const char *path)
+MegaRequestMap::iterator MegaRequestMap::begin()
 {
-    sdkMutex.lock();
+    return iterator(slots, slots ? slots + mask + 1 : NULL);
+}
 
-    string utf8path = path;
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(utf8path.c_str()) && ((utf8path.size()<2) || utf8path.compare(0, 2, "\\\\")))
-            utf8path.insert(0, "\\\\?\\");
-#endif
+MegaRequestMap::iterator MegaRequestMap::end()
+{
+    value_type *last = slots ? slots + mask + 1 : NULL;
 
-    string localpath;
-    fsAccess->path2local(&utf8path, &localpath);
+    return iterator(last, last);
+}
 
-    Sync *sync = NULL;
-    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+MegaRequestMap::value_type *MegaRequestMap::lookup(int tag) const
+{
+    if (!count || tag < 0)
     {
-        string *localroot = &((*it)->localroot.localname);
-        if(((localroot->size()+fsAccess->localseparator.size())<localpath.size()) &&
-            !memcmp(localroot->data(), localpath.data(), localroot->size()) &&
-            !memcmp(fsAccess->localseparator.data(), localpath.data()+localroot->size(), fsAccess->localseparator.size()))
+        return NULL;
+    }
+
+    for (size_t i = hash(tag) & mask; ; i = (i + 1) & mask)
+    {
+        if (slots[i].first == tag)
         {
-            sync = (*it);
-            break;
+            return slots + i;
+        }
+
+        if (slots[i].first == EMPTYSLOT)
+        {
+            return NULL;
         }
     }
+}
 
-    if(!sync)
+MegaRequestMap::iterator MegaRequestMap::find(int tag)
+{
+    value_type *s = lookup(tag);
+
+    if (!s)
     {
-        sdkMutex.unlock();
-        return false;
+        return end();
     }
 
-    bool result = sync->movetolocaldebris(&localpath);
-    sdkMutex.unlock();
+    return iterator(s, slots + mask + 1);
+}
 
-    return result;
+MegaRequestPrivate *MegaRequestMap::at(int tag) const
+{
+    value_type *s = lookup(tag);
+
+    return s ? s->second : NULL;
 }
 
-int MegaApiImpl::syncPathState(string* path)
+MegaRequestPrivate *&MegaRequestMap::operator[](int tag)
 {
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-    string prefix("\\\\?\\");
-    string localPrefix;
-    fsAccess->path2local(&prefix, &localPrefix);
-    path->append("", 1);
-    if(!PathIsRelativeW((LPCWSTR)path->data()) && (path->size()<4 || memcmp(path->data(), localPrefix.data(), 4)))
+    value_type *s = lookup(tag);
+
+    if (s)
     {
-        path->insert(0, localPrefix);
+        return s->second;
     }
-    path->resize(path->size() - 1);
-#endif
 
-    int state = MegaApi::STATE_NONE;
-    sdkMutex.lock();
-    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+    // keep the load factor (including deleted slots) below 3/4
+    if ((used + 1) * 4 > (mask + 1) * 3)
     {
-        Sync *sync = (*it);
-        unsigned int ssize = sync->localroot.localname.size();
-        if(path->size() < ssize || memcmp(path->data(), sync->localroot.localname.data(), ssize))
-            continue;
-
-        if(path->size() == ssize)
-        {
-            state = sync->localroot.ts;
-            break;
-        }
-        else if(!memcmp(path->data()+ssize, client->fsaccess->localseparator.data(), client->fsaccess->localseparator.size()))
-        {
-            LocalNode* l = sync->localnodebypath(NULL, path);
-            if(l)
-                state = l->ts;
-            else
-                state = MegaApi::STATE_IGNORED;
-            break;
-        }
+        rehash(count + 1);
     }
-    sdkMutex.unlock();
-    return state;
-}
 
+    value_type *tomb = NULL;
+    size_t i;
 
-MegaNode *MegaApiImpl::getSyncedNode(string *path)
-{
-    sdkMutex.lock();
-    MegaNode *node = NULL;
-    for (sync_list::iterator it = client->syncs.begin(); (it != client->syncs.end()) && (node == NULL); it++)
+    for (i = hash(tag) & mask; slots[i].first != EMPTYSLOT; i = (i + 1) & mask)
     {
-        Sync *sync = (*it);
-        if(path->size() == sync->localroot.localname.size() &&
-                !memcmp(path->data(), sync->localroot.localname.data(), path->size()))
+        if (!tomb && slots[i].first == DELETEDSLOT)
         {
-            node = MegaNodePrivate::fromNode(sync->localroot.node);
-            break;
+            tomb = slots + i;
         }
+    }
 
-        LocalNode * localNode = sync->localnodebypath(NULL, path);
-        if(localNode) node = MegaNodePrivate::fromNode(localNode->node);
+    if (tomb)
+    {
+        s = tomb;
     }
-    sdkMutex.unlock();
-    return node;
+    else
+    {
+        s = slots + i;
+        used++;
+    }
+
+    s->first = tag;
+    s->second = NULL;
+    count++;
+
+    return s->second;
 }
 
-void MegaApiImpl::syncFolder(const char *localFolder, MegaNode *megaFolder, MegaRequestListener *listener)
+size_t MegaRequestMap::erase(int tag)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
-    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
-    if(localFolder)
+    value_type *s = lookup(tag);
+
+    if (!s)
     {
-        string path(localFolder);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-        request->setFile(path.data());
+        return 0;
     }
 
-    request->setListener(listener);
-    requestQueue.push(request);
-    waiter->notify();
+    s->first = DELETEDSLOT;
+    s->second = NULL;
+    count--;
+
+    return 1;
 }
 
-void MegaApiImpl::resumeSync(const char *localFolder, long long localfp, MegaNode *megaFolder, MegaRequestListener* listener)
+// resize to hold at least n elements at a load factor of at most 1/2 and
+// drop deleted slots
+void MegaRequestMap::rehash(size_t n)
 {
-    sdkMutex.lock();
-
-#ifdef __APPLE__
-    localfp = 0;
-#endif
-
-    LOG_debug << "Resume sync";
+    size_t newsize = MINSLOTS;
 
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
-    request->setListener(listener);
-    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
-    if(localFolder)
+    while (newsize < n * 2)
     {
-        string path(localFolder);
-#if defined(_WIN32) && !defined(WINDOWS_PHONE)
-        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
-            path.insert(0, "\\\\?\\");
-#endif
-        request->setFile(path.data());
+        newsize <<= 1;
     }
-    request->setNumber(localfp);
 
-    int nextTag = client->nextreqtag();
-    request->setTag(nextTag);
-    requestMap[nextTag]=request;
-    error e = API_OK;
-    fireOnRequestStart(request);
+    value_type *oldslots = slots;
+    size_t oldsize = slots ? mask + 1 : 0;
 
-    const char *localPath = request->getFile();
-    Node *node = client->nodebyhandle(request->getNodeHandle());
-    if(!node || (node->type==FILENODE) || !localPath)
+    slots = new value_type[newsize];
+    mask = newsize - 1;
+    used = count;
+
+    for (size_t i = newsize; i--; )
     {
-        e = API_EARGS;
+        slots[i].first = EMPTYSLOT;
+        slots[i].second = NULL;
     }
-    else
+
+    for (size_t i = 0; i < oldsize; i++)
     {
-        string utf8name(localPath);
-        string localname;
-        client->fsaccess->path2local(&utf8name, &localname);
-        e = client->addsync(&localname, DEBRISFOLDER, NULL, node, localfp, -nextTag);
-        if(!e)
+        if (oldslots[i].first >= 0)
         {
-            MegaSyncPrivate *sync = new MegaSyncPrivate(client->syncs.back());
-            sync->setListener(request->getSyncListener());
-            syncMap[-nextTag] = sync;
+            size_t j;
 
-            request->setNumber(client->syncs.back()->fsfp);
+            for (j = hash(oldslots[i].first) & mask; slots[j].first != EMPTYSLOT; j = (j + 1) & mask);
+
+            slots[j] = oldslots[i];
         }
     }
 
-    fireOnRequestFinish(request, MegaError(e));
-    sdkMutex.unlock();
+    delete [] oldslots;
 }
 
-void MegaApiImpl::removeSync(handle nodehandle, MegaRequestListener* listener)
+#ifdef ENABLE_SYNC
+SyncStateIndex::SyncStateIndex()
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
-    request->setNodeHandle(nodehandle);
-    request->setFlag(true);
-    requestQueue.push(request);
-    waiter->notify();
+    for (unsigned i = 0; i < NUMSHARDS; i++)
+    {
+        shards[i].mutex.init();
+    }
 }
 
-void MegaApiImpl::disableSync(handle nodehandle, MegaRequestListener *listener)
+// FNV-1a
+SyncStateIndex::Shard *SyncStateIndex::shard(const string& path)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
-    request->setNodeHandle(nodehandle);
-    request->setFlag(false);
-    requestQueue.push(request);
-    waiter->notify();
-}
+    uint32_t h = 2166136261U;
 
-int MegaApiImpl::getNumActiveSyncs()
-{
-    sdkMutex.lock();
-    int num = client->syncs.size();
-    sdkMutex.unlock();
-    return num;
-}
+    for (size_t i = 0; i < path.size(); i++)
+    {
+        h = (h ^ (byte)path[i]) * 16777619U;
+    }
 
-void MegaApiImpl::stopSyncs(MegaRequestListener *listener)
-{
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNCS, listener);
-    requestQueue.push(request);
-    waiter->notify();
+    return &shards[h % NUMSHARDS];
 }
 
-bool MegaApiImpl::isSynced(MegaNode *n)
+void SyncStateIndex::set(const string& path, int state)
 {
-    if(!n) return false;
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node)
-    {
-        sdkMutex.unlock();
-        return false;
-    }
+    Shard *s = shard(path);
 
-    bool result = (node->localnode!=NULL);
-    sdkMutex.unlock();
-    return result;
+    s->mutex.lock();
+    s->states[path] = state;
+    s->mutex.unlock();
 }
 
-void MegaApiImpl::setExcludedNames(vector<string> *excludedNames)
+bool SyncStateIndex::get(const string& path, int* state)
 {
-    sdkMutex.lock();
-    if(!excludedNames)
-    {
-        this->excludedNames.clear();
-        sdkMutex.unlock();
-        return;
-    }
+    Shard *s = shard(path);
 
-    for(unsigned int i=0; i<excludedNames->size(); i++)
+    s->mutex.lockshared();
+    map<string, int>::iterator it = s->states.find(path);
+    bool found = it != s->states.end();
+
+    if (found)
     {
-        LOG_debug << "Excluded name: " << excludedNames->at(i);
+        *state = it->second;
     }
 
-    this->excludedNames = *excludedNames;
-    sdkMutex.unlock();
+    s->mutex.unlockshared();
+    return found;
 }
 
-void MegaApiImpl::setExclusionLowerSizeLimit(long long limit)
+void SyncStateIndex::erase(const string& path)
 {
-    syncLowerSizeLimit = limit;
+    Shard *s = shard(path);
+
+    s->mutex.lock();
+    s->states.erase(path);
+    s->mutex.unlock();
 }
+#endif
 
-void MegaApiImpl::setExclusionUpperSizeLimit(long long limit)
+MegaThreadRunner::MegaThreadRunner(int threads)
 {
-    syncUpperSizeLimit = limit;
+    this->threads = threads;
 }
 
-string MegaApiImpl::getLocalPath(MegaNode *n)
+void MegaThreadRunner::run(unsigned n, void (*job)(unsigned, void*), void* param)
 {
-    if(!n) return string();
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node || !node->localnode)
+    Batch batch;
+    batch.mutex.init(false);
+    batch.next = 0;
+    batch.n = n;
+    batch.job = job;
+    batch.param = param;
+
+    int count = (n < (unsigned)threads) ? n : threads;
+    MegaThread *workers = new MegaThread[count];
+
+    for (int i = 0; i < count; i++)
     {
-        sdkMutex.unlock();
-        return string();
+        workers[i].start(threadEntryPoint, &batch);
     }
 
-    string result;
-    node->localnode->getlocalpath(&result, true);
-    result.append("", 1);
-    sdkMutex.unlock();
-    return result;
-}
-
-#endif
+    for (int i = 0; i < count; i++)
+    {
+        workers[i].join();
+    }
 
-int MegaApiImpl::getNumPendingUploads()
-{
-    return pendingUploads;
+    delete [] workers;
 }
 
-int MegaApiImpl::getNumPendingDownloads()
+void *MegaThreadRunner::threadEntryPoint(void *param)
 {
-    return pendingDownloads;
-}
+    Batch *batch = (Batch *)param;
 
-int MegaApiImpl::getTotalUploads()
-{
-    return totalUploads;
-}
+    for (;;)
+    {
+        batch->mutex.lock();
+        unsigned i = batch->next++;
+        batch->mutex.unlock();
 
-int MegaApiImpl::getTotalDownloads()
-{
-    return totalDownloads;
-}
+        if (i >= batch->n)
+        {
+            return NULL;
+        }
 
-void MegaApiImpl::resetTotalDownloads()
-{
-    totalDownloads = 0;
+        batch->job(i, batch->param);
+    }
 }
 
-void MegaApiImpl::resetTotalUploads()
+MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent)
 {
-    totalUploads = 0;
+	init(api, appKey, processor, basePath, userAgent);
 }
 
-MegaNode *MegaApiImpl::getRootNode()
+MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent)
 {
-    sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[0]));
-    sdkMutex.unlock();
-	return result;
+	init(api, appKey, NULL, basePath, userAgent);
 }
 
-MegaNode* MegaApiImpl::getInboxNode()
+MegaApiImpl::MegaApiImpl(MegaApi *api, const char *appKey, const char *basePath, const char *userAgent, int fseventsfd)
 {
-    sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[1]));
-    sdkMutex.unlock();
-	return result;
+	init(api, appKey, NULL, basePath, userAgent, fseventsfd);
 }
 
-MegaNode* MegaApiImpl::getRubbishNode()
+void MegaApiImpl::init(MegaApi *api, const char *appKey, MegaGfxProcessor* processor, const char *basePath, const char *userAgent, int fseventsfd)
 {
-    sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[2]));
-    sdkMutex.unlock();
-	return result;
-}
+    this->api = api;
 
-bool MegaApiImpl::userComparatorDefaultASC (User *i, User *j)
-{
-	if(strcasecmp(i->email.c_str(), j->email.c_str())<=0) return 1;
-    return 0;
-}
+    sdkMutex.init();
+    viewsMutex.init(false);
+    maxRetries = 10;
+	currentTransfer = NULL;
+    pendingUploads = 0;
+    pendingDownloads = 0;
+    totalUploads = 0;
+    totalDownloads = 0;
+    client = NULL;
+    decryptionRunner = NULL;
+    cryptoRunner = NULL;
+    scanRunner = NULL;
+    threadPool = NULL;
+    httpServer = NULL;
+    pwKeyDerivation = NULL;
+    callbackExecutor = new MegaCallbackExecutor(api);
+    streamingBuffersReleased = false;
+    nameIndex = NULL;
+    nodeUpdateWindow = 0;
+    nodeUpdateMaxBatch = 0;
+    nodeUpdateDeadline = NEVER;
+    transferUpdateInterval = 1;
+    transfersProgressInterval = 0;
+    transfersProgressDeadline = NEVER;
+    transferSequence = 0;
+    uploadQueueLimit = 0;
+    numQueuedUploads = 0;
+    persistTransfers = false;
+    prefetchDispatchTag = 0;
+    waiting = false;
+    waitingRequest = false;
+    totalDownloadedBytes = 0;
+    totalUploadedBytes = 0;
+    activeRequest = NULL;
+    activeTransfer = NULL;
+    activeError = NULL;
+    activeNodes = NULL;
+    activeUsers = NULL;
+    syncLowerSizeLimit = 0;
+    syncUpperSizeLimit = 0;
+    downloadSpeed = 0;
+    uploadSpeed = 0;
+    uploadPartialBytes = 0;
+    downloadPartialBytes = 0;
 
-char *MegaApiImpl::escapeFsIncompatible(const char *filename)
-{
-    if(!filename)
+    httpio = new MegaHttpIO();
+    waiter = new MegaWaiter();
+
+#ifndef __APPLE__
+    (void)fseventsfd;
+    fsAccess = new MegaFileSystemAccess();
+#else
+    fsAccess = new MegaFileSystemAccess(fseventsfd);
+#endif
+
+    string faCachePath;
+
+	if (basePath)
+	{
+		string sBasePath = basePath;
+		int lastIndex = sBasePath.size() - 1;
+		if (sBasePath[lastIndex] != '/' && sBasePath[lastIndex] != '\\')
+		{
+			string utf8Separator;
+			fsAccess->local2path(&fsAccess->localseparator, &utf8Separator);
+			sBasePath.append(utf8Separator);
+		}
+		dbAccess = new MegaDbAccess(&sBasePath);
+		faCachePath = sBasePath + "facache";
+	}
+	else dbAccess = NULL;
+
+	gfxAccess = NULL;
+	if(processor)
+	{
+		GfxProcExternal *externalGfx = new GfxProcExternal();
+		externalGfx->setProcessor(processor);
+		gfxAccess = externalGfx;
+	}
+	else
+	{
+		gfxAccess = new MegaGfxProc();
+	}
+
+	if(!userAgent)
+	{
+		userAgent = "";
+	}
+
+    client = new MegaClient(this, waiter, httpio, fsAccess, dbAccess, gfxAccess, appKey, userAgent);
+
+    if (!processor)
     {
-        return NULL;
+        // the external processor is not assumed to be thread-safe
+        GfxProc *procs[GFXTHREADS];
+        Thread *threads[GFXTHREADS];
+
+        for (int i = 0; i < GFXTHREADS; i++)
+        {
+            procs[i] = new MegaGfxProc();
+            threads[i] = new MegaThread();
+        }
+
+        gfxAccess->startworkers(GFXTHREADS, procs, threads, new MegaMutex(), new MegaSemaphore());
     }
-    string name = filename;
-    client->fsaccess->escapefsincompatible(&name);
-    return MegaApi::strdup(name.c_str());
-}
 
-char *MegaApiImpl::unescapeFsIncompatible(const char *name)
-{
-    if(!name)
+    if (faCachePath.size())
     {
-        return NULL;
+        string localFaCachePath;
+        fsAccess->path2local(&faCachePath, &localFaCachePath);
+        client->facache = new FileAttributeCache(fsAccess, &localFaCachePath, FACACHESIZE);
     }
-    string filename = name;
-    client->fsaccess->unescapefsincompatible(&filename);
-    return MegaApi::strdup(filename.c_str());
+
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+    httpio->unlock();
+#endif
+
+    //Start blocking thread
+	threadExit = 0;
+    thread.start(threadEntryPoint, this);
 }
 
-bool MegaApiImpl::createThumbnail(const char *imagePath, const char *dstPath)
+MegaApiImpl::~MegaApiImpl()
 {
-    if (!gfxAccess)
+#ifndef _WIN32
+    delete httpServer;
+#endif
+
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_DELETE);
+    if (requestQueue.push(request))
     {
-        return false;
+        waiter->notify();
     }
+    thread.join();
+    delete callbackExecutor;
+    delete pwKeyDerivation;
+    delete decryptionRunner;
+    delete cryptoRunner;
+    delete scanRunner;
+    delete threadPool;
+    delete nameIndex;
+    clearNodeUpdates();
 
-    string utf8ImagePath = imagePath;
-    string localImagePath;
-    fsAccess->path2local(&utf8ImagePath, &localImagePath);
-
-    string utf8DstPath = dstPath;
-    string localDstPath;
-    fsAccess->path2local(&utf8DstPath, &localDstPath);
-
-    sdkMutex.lock();
-    bool result = gfxAccess->savefa(&localImagePath, GfxProc::THUMBNAIL120X120, &localDstPath);
-    sdkMutex.unlock();
-
-    return result;
+    for (map<int, MegaStreamingRing *>::iterator it = streamingRings.begin(); it != streamingRings.end(); it++)
+    {
+        delete it->second;
+    }
 }
 
-bool MegaApiImpl::createPreview(const char *imagePath, const char *dstPath)
+// shared access for read-only getters - while node decryption is deferred
+// the first access to a node decrypts it, so the lock is taken exclusively
+// until it completes
+bool MegaApiImpl::lockRead()
 {
-    if (!gfxAccess)
+    sdkMutex.lockShared();
+
+    // lookups may load paged nodes
+    if (!client->nodesdeferred && !client->pagednodes)
     {
         return false;
     }
 
-    string utf8ImagePath = imagePath;
-    string localImagePath;
-    fsAccess->path2local(&utf8ImagePath, &localImagePath);
-
-    string utf8DstPath = dstPath;
-    string localDstPath;
-    fsAccess->path2local(&utf8DstPath, &localDstPath);
-
+    sdkMutex.unlockShared();
     sdkMutex.lock();
-    bool result = gfxAccess->savefa(&localImagePath, GfxProc::PREVIEW1000x1000, &localDstPath);
-    sdkMutex.unlock();
-
-    return result;
+    return true;
 }
 
-bool MegaApiImpl::isOnline()
+void MegaApiImpl::unlockRead(bool exclusive)
 {
-    return !client->httpio->noinetds;
+    if (exclusive)
+    {
+        sdkMutex.unlock();
+    }
+    else
+    {
+        sdkMutex.unlockShared();
+    }
 }
 
-MegaUserList* MegaApiImpl::getContacts()
+int MegaApiImpl::isLoggedIn()
 {
-    sdkMutex.lock();
+    bool exclusive = lockRead();
+    int result = client->loggedin();
+    unlockRead(exclusive);
+	return result;
+}
 
-	vector<User*> vUsers;
-	for (user_map::iterator it = client->users.begin() ; it != client->users.end() ; it++ )
+char* MegaApiImpl::getMyEmail()
+{
+	User* u;
+    bool exclusive = lockRead();
+	if (!client->loggedin() || !(u = client->finduser(client->me)))
 	{
-		User *u = &(it->second);
-        vector<User *>::iterator i = std::lower_bound(vUsers.begin(), vUsers.end(), u, MegaApiImpl::userComparatorDefaultASC);
-		vUsers.insert(i, u);
+		unlockRead(exclusive);
+		return NULL;
 	}
-    MegaUserList *userList = new MegaUserListPrivate(vUsers.data(), vUsers.size());
-
-    sdkMutex.unlock();
 
-	return userList;
+    char *result = MegaApi::strdup(u->email.c_str());
+    unlockRead(exclusive);
+    return result;
 }
 
-
-MegaUser* MegaApiImpl::getContact(const char* email)
+char *MegaApiImpl::getMyUserHandle()
 {
     sdkMutex.lock();
-	MegaUser *user = MegaUserPrivate::fromUser(client->finduser(email, 0));
+    if (ISUNDEF(client->me))
+    {
+        sdkMutex.unlock();
+        return NULL;
+    }
+
+    char buf[12];
+    Base64::btoa((const byte*)&client->me, MegaClient::USERHANDLE, buf);
+    char *result = MegaApi::strdup(buf);
     sdkMutex.unlock();
-	return user;
+    return result;
 }
 
-
-MegaNodeList* MegaApiImpl::getInShares(MegaUser *megaUser)
+char *MegaApiImpl::getMyXMPPJid()
 {
-    if(!megaUser) return new MegaNodeListPrivate();
-
     sdkMutex.lock();
-    vector<Node*> vNodes;
-    User *user = client->finduser(megaUser->getEmail(), 0);
-    if(!user)
+    if (ISUNDEF(client->me))
     {
         sdkMutex.unlock();
-        return new MegaNodeListPrivate();
+        return NULL;
     }
 
-	for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
-	{
-        Node *n;
-        if ((n = client->nodebyhandle(*sit)) && !n->parent)
-            vNodes.push_back(n);
-	}
-    MegaNodeList *nodeList;
-    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    else nodeList = new MegaNodeListPrivate();
+    char jid[16];
+    Base32::btoa((const byte *)&client->me, MegaClient::USERHANDLE, jid);
+    char *result = MegaApi::strdup(jid);
 
     sdkMutex.unlock();
-	return nodeList;
+    return result;
 }
 
-MegaNodeList* MegaApiImpl::getInShares()
+void MegaApiImpl::setLogLevel(int logLevel)
 {
-    sdkMutex.lock();
+    if(!externalLogger)
+    {
+        externalLogger = new ExternalLogger();
+    }
+    externalLogger->setLogLevel(logLevel);
+}
 
-    vector<Node*> vNodes;
-	for(user_map::iterator it = client->users.begin(); it != client->users.end(); it++)
-	{
-		User *user = &(it->second);
-		Node *n;
-
-		for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
-		{
-            if ((n = client->nodebyhandle(*sit)) && !n->parent)
-				vNodes.push_back(n);
-		}
-	}
-
-    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    sdkMutex.unlock();
-	return nodeList;
+void MegaApiImpl::setEventBackend(int backend)
+{
+#ifndef _WIN32
+    PosixWaiter::defaultbackend = (backend == MegaApi::EVENT_BACKEND_NATIVE)
+            ? PosixWaiter::nativebackend() : PosixWaiter::BACKEND_SELECT;
+#else
+    WinWaiter::defaultbackend = (backend == MegaApi::EVENT_BACKEND_NATIVE)
+            ? WinWaiter::BACKEND_IOCP : WinWaiter::BACKEND_EVENTS;
+#endif
 }
 
-MegaShareList* MegaApiImpl::getInSharesList()
+void MegaApiImpl::setLoggerClass(MegaLogger *megaLogger)
 {
-    sdkMutex.lock();
-
-    vector<Share*> vShares;
-    handle_vector vHandles;
-
-    for(user_map::iterator it = client->users.begin(); it != client->users.end(); it++)
+    if(!externalLogger)
     {
-        User *user = &(it->second);
-        Node *n;
-
-        for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
-        {
-            if ((n = client->nodebyhandle(*sit)) && !n->parent)
-            {
-                vShares.push_back(n->inshare);
-                vHandles.push_back(n->nodehandle);
-            }
-        }
+        externalLogger = new ExternalLogger();
     }
-
-    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
-    sdkMutex.unlock();
-    return shareList;
+    externalLogger->setMegaLogger(megaLogger);
 }
 
-bool MegaApiImpl::isPendingShare(MegaNode *megaNode)
+void MegaApiImpl::setAsyncLogging(bool enable, int maxQueued)
 {
-    if(!megaNode) return false;
-
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node)
+    if(!externalLogger)
     {
-        sdkMutex.unlock();
-        return false;
+        externalLogger = new ExternalLogger();
     }
-
-    bool result = (node->pendingshares != NULL);
-    sdkMutex.unlock();
-
-    return result;
+    externalLogger->setAsync(enable, maxQueued);
 }
 
-MegaShareList *MegaApiImpl::getOutShares()
+long long MegaApiImpl::getDroppedLogs()
 {
-    sdkMutex.lock();
-
-    OutShareProcessor shareProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
-    MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
-
-	sdkMutex.unlock();
-	return shareList;
+    return externalLogger ? externalLogger->getDropped() : 0;
 }
 
-MegaShareList* MegaApiImpl::getOutShares(MegaNode *megaNode)
+void MegaApiImpl::log(int logLevel, const char *message, const char *filename, int line)
 {
-    if(!megaNode) return new MegaShareListPrivate();
-
-    sdkMutex.lock();
-	Node *node = client->nodebyhandle(megaNode->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return new MegaShareListPrivate();
-	}
-
-    if(!node->outshares)
+    if(!externalLogger)
     {
-        sdkMutex.unlock();
-        return new MegaShareListPrivate();
+        return;
     }
 
-	vector<Share*> vShares;
-	vector<handle> vHandles;
-
-    for (share_map::iterator it = node->outshares->begin(); it != node->outshares->end(); it++)
-	{
-		vShares.push_back(it->second);
-		vHandles.push_back(node->nodehandle);
-	}
-
-    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
-    sdkMutex.unlock();
-    return shareList;
+    externalLogger->postLog(logLevel, message, filename, line);
 }
 
-MegaShareList *MegaApiImpl::getPendingOutShares()
+char* MegaApiImpl::getBase64PwKey(const char *password)
 {
-    sdkMutex.lock();
+	if(!password) return NULL;
 
-    PendingOutShareProcessor shareProcessor;
-    processTree(client->nodebyhandle(client->rootnodes[0]), &shareProcessor, true);
-    MegaShareList *shareList = new MegaShareListPrivate(shareProcessor.getShares().data(), shareProcessor.getHandles().data(), shareProcessor.getShares().size());
+	byte pwkey[SymmCipher::KEYLENGTH];
+	error e = client->pw_key(password,pwkey);
+	if(e)
+		return NULL;
 
-    sdkMutex.unlock();
-    return shareList;
+	char* buf = new char[SymmCipher::KEYLENGTH*4/3+4];
+	Base64::btoa((byte *)pwkey, SymmCipher::KEYLENGTH, buf);
+	return buf;
 }
 
-MegaShareList *MegaApiImpl::getPendingOutShares(MegaNode *megaNode)
+MegaStringList *MegaApiImpl::getBase64PwKeys(MegaStringList *passwords, int threads)
 {
-    if(!megaNode)
+    if (!passwords)
     {
-        return new MegaShareListPrivate();
+        return NULL;
     }
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node || !node->pendingshares)
+    int n = passwords->size();
+    if (!n)
     {
-        sdkMutex.unlock();
-        return new MegaShareListPrivate();
+        return new MegaStringListPrivate();
     }
 
-    vector<Share*> vShares;
-    vector<handle> vHandles;
-
-    for (share_map::iterator it = node->pendingshares->begin(); it != node->pendingshares->end(); it++)
+    vector<const char *> list(n);
+    vector<byte> keys(n * SymmCipher::KEYLENGTH);
+    vector<error> errors(n);
+    for (int i = 0; i < n; i++)
     {
-        vShares.push_back(it->second);
-        vHandles.push_back(node->nodehandle);
+        list[i] = passwords->get(i) ? passwords->get(i) : "";
     }
 
-    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
-    sdkMutex.unlock();
-    return shareList;
-}
+    MegaThreadRunner runner(threads > 1 ? threads : 1);
+    MegaClient::pw_keys(threads > 1 ? &runner : NULL, n, &list[0], &keys[0], &errors[0]);
 
-MegaContactRequestList *MegaApiImpl::getIncomingContactRequests()
-{
-    sdkMutex.lock();
-    vector<PendingContactRequest*> vContactRequests;
-    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
+    char **result = new char*[n];
+    for (int i = 0; i < n; i++)
     {
-        if(!it->second->isoutgoing)
+        result[i] = new char[SymmCipher::KEYLENGTH * 4 / 3 + 4];
+        if (errors[i])
         {
-            vContactRequests.push_back(it->second);
+            result[i][0] = 0;
+        }
+        else
+        {
+            Base64::btoa(&keys[i * SymmCipher::KEYLENGTH], SymmCipher::KEYLENGTH, result[i]);
         }
     }
 
-    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
-    sdkMutex.unlock();
+    MegaStringList *keyList = new MegaStringListPrivate(result, n);
+    delete [] result;
+    return keyList;
+}
 
-    return requestList;
+char* MegaApiImpl::getStringHash(const char* base64pwkey, const char* inBuf)
+{
+	if(!base64pwkey || !inBuf) return NULL;
+
+	char pwkey[SymmCipher::KEYLENGTH];
+	Base64::atob(base64pwkey, (byte *)pwkey, sizeof pwkey);
+
+	SymmCipher key;
+	key.setkey((byte*)pwkey);
+
+    uint64_t strhash;
+	string neBuf = inBuf;
+
+    strhash = client->stringhash64(&neBuf, &key);
+
+	char* buf = new char[8*4/3+4];
+    Base64::btoa((byte*)&strhash, 8, buf);
+    return buf;
 }
 
-MegaContactRequestList *MegaApiImpl::getOutgoingContactRequests()
+void MegaApiImpl::getSessionTransferURL(const char *path, MegaRequestListener *listener)
 {
-    sdkMutex.lock();
-    vector<PendingContactRequest*> vContactRequests;
-    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_SESSION_TRANSFER_URL);
+    request->setText(path);
+    request->setListener(listener);
+    if (requestQueue.push(request))
     {
-        if(it->second->isoutgoing)
-        {
-            vContactRequests.push_back(it->second);
-        }
+        waiter->notify();
     }
+}
 
-    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
-    sdkMutex.unlock();
+MegaHandle MegaApiImpl::base32ToHandle(const char *base32Handle)
+{
+	if(!base32Handle) return INVALID_HANDLE;
 
-    return requestList;
+	handle h = 0;
+	Base32::atob(base32Handle,(byte*)&h, MegaClient::USERHANDLE);
+	return h;
 }
 
-int MegaApiImpl::getAccess(MegaNode* megaNode)
+const char* MegaApiImpl::ebcEncryptKey(const char* encryptionKey, const char* plainKey)
 {
-    if(!megaNode) return MegaShare::ACCESS_UNKNOWN;
+	if(!encryptionKey || !plainKey) return NULL;
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-    if(!node)
-    {
-        sdkMutex.unlock();
-        return MegaShare::ACCESS_UNKNOWN;
-    }
+	char pwkey[SymmCipher::KEYLENGTH];
+	Base64::atob(encryptionKey, (byte *)pwkey, sizeof pwkey);
 
-    if (!client->loggedin())
-    {
-        sdkMutex.unlock();
-        return MegaShare::ACCESS_READ;
-    }
+	SymmCipher key;
+	key.setkey((byte*)pwkey);
 
-    if(node->type > FOLDERNODE)
-    {
-        sdkMutex.unlock();
-        return MegaShare::ACCESS_OWNER;
-    }
+	char plkey[SymmCipher::KEYLENGTH];
+	Base64::atob(plainKey, (byte*)plkey, sizeof plkey);
+	key.ecb_encrypt((byte*)plkey);
 
-    Node *n = node;
-    accesslevel_t a = OWNER;
-    while (n)
-    {
-        if (n->inshare) { a = n->inshare->access; break; }
-        n = n->parent;
-    }
+	char* buf = new char[SymmCipher::KEYLENGTH*4/3+4];
+	Base64::btoa((byte*)plkey, SymmCipher::KEYLENGTH, buf);
+	return buf;
+}
 
-    sdkMutex.unlock();
+handle MegaApiImpl::base64ToHandle(const char* base64Handle)
+{
+	if(!base64Handle) return UNDEF;
 
-    switch(a)
-    {
-        case RDONLY: return MegaShare::ACCESS_READ;
-        case RDWR: return MegaShare::ACCESS_READWRITE;
-        case FULL: return MegaShare::ACCESS_FULL;
-        default: return MegaShare::ACCESS_OWNER;
-    }
+	handle h = 0;
+	Base64::atob(base64Handle,(byte*)&h,MegaClient::NODEHANDLE);
+    return h;
 }
 
-bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool recursive)
+char *MegaApiImpl::handleToBase64(MegaHandle handle)
 {
-	if(!n) return true;
-	if(!processor) return false;
+    char *base64Handle = new char[12];
+    Base64::btoa((byte*)&(handle),MegaClient::NODEHANDLE,base64Handle);
+    return base64Handle;
+}
 
-    sdkMutex.lock();
-	Node *node = client->nodebyhandle(n->getHandle());
-	if(!node)
+char *MegaApiImpl::userHandleToBase64(MegaHandle handle)
+{
+    char *base64Handle = new char[14];
+    Base64::btoa((byte*)&(handle),MegaClient::USERHANDLE,base64Handle);
+    return base64Handle;
+}
+
+void MegaApiImpl::retryPendingConnections(bool disconnect, bool includexfers, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_RETRY_PENDING_CONNECTIONS);
+	request->setFlag(disconnect);
+	request->setNumber(includexfers);
+	request->setListener(listener);
+	if (requestQueue.push(request))
 	{
-        sdkMutex.unlock();
-		return true;
+	    waiter->notify();
 	}
+}
 
-	if (node->type != FILENODE)
-	{
-		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
-		{
-			MegaNode *megaNode = MegaNodePrivate::fromNode(*it++);
-			if(recursive)
-			{
-				if(!processMegaTree(megaNode,processor))
-				{
-					delete megaNode;
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-			else
-			{
-				if(!processor->processMegaNode(megaNode))
-				{
-					delete megaNode;
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-			delete megaNode;
-		}
-	}
-	bool result = processor->processMegaNode(n);
-
+void MegaApiImpl::setNetworkBatching(int maxDelayMs)
+{
+    sdkMutex.lock();
+    client->deferlimit = maxDelayMs > 0 ? (maxDelayMs + 99) / 100 : 0;
     sdkMutex.unlock();
-    return result;
+    waiter->notify();
 }
 
-MegaNode *MegaApiImpl::createPublicFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime, MegaHandle parentHandle, const char* auth)
+void MegaApiImpl::addEntropy(char *data, unsigned int size)
 {
-    string nodekey;
-    string attrstring;
-    nodekey.resize(strlen(key) * 3 / 4 + 3);
-    nodekey.resize(Base64::atob(key, (byte *)nodekey.data(), nodekey.size()));
-    return new MegaNodePrivate(name, FILENODE, size, mtime, mtime, handle, &nodekey, &attrstring, parentHandle, auth);
+    if(PrnGen::rng.CanIncorporateEntropy())
+        PrnGen::rng.IncorporateEntropy((const byte*)data, size);
+
+#ifdef USE_SODIUM
+    if(EdDSA::rng.CanIncorporateEntropy())
+        EdDSA::rng.IncorporateEntropy((const byte*)data, size);
+#endif
+
+#if (!defined(_WIN32) && !defined(USE_CURL_PUBLIC_KEY_PINNING)) || defined(WINDOWS_PHONE)
+    RAND_seed(data, size);
+#endif
 }
 
-MegaNode *MegaApiImpl::createPublicFolderNode(MegaHandle handle, const char *name, MegaHandle parentHandle, const char *auth)
+void MegaApiImpl::fastLogin(const char* email, const char *stringHash, const char *base64pwkey, MegaRequestListener *listener)
 {
-    string nodekey;
-    string attrstring;
-    return new MegaNodePrivate(name, FOLDERNODE, 0, 0, 0, handle, &nodekey, &attrstring, parentHandle, auth);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
+	request->setEmail(email);
+	request->setPassword(stringHash);
+	request->setPrivateKey(base64pwkey);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-void MegaApiImpl::loadBalancing(const char* service, MegaRequestListener *listener)
+void MegaApiImpl::fastLogin(const char *session, MegaRequestListener *listener)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOAD_BALANCING, listener);
-    request->setName(service);
-    requestQueue.push(request);
-    waiter->notify();
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
+    request->setSessionKey(session);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-const char *MegaApiImpl::getVersion()
+void MegaApiImpl::killSession(MegaHandle sessionHandle, MegaRequestListener *listener)
 {
-    return client->version();
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_KILL_SESSION, listener);
+    request->setNodeHandle(sessionHandle);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-const char *MegaApiImpl::getUserAgent()
+void MegaApiImpl::getUserData(MegaRequestListener *listener)
 {
-    return client->useragent.c_str();
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::changeApiUrl(const char *apiURL, bool disablepkp)
+void MegaApiImpl::getUserData(MegaUser *user, MegaRequestListener *listener)
 {
-    sdkMutex.lock();
-    MegaClient::APIURL = apiURL;
-    if(disablepkp)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
+    request->setFlag(true);
+    if(user)
     {
-        MegaClient::disablepkp = true;
+        request->setEmail(user->getEmail());
+    }
+
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
     }
-    client->abortbackoff();
-    client->disconnect();
-    sdkMutex.unlock();
 }
 
-bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursive)
+void MegaApiImpl::getUserData(const char *user, MegaRequestListener *listener)
 {
-	if(!node) return 1;
-	if(!processor) return 0;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_USER_DATA, listener);
+    request->setFlag(true);
+    request->setEmail(user);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    sdkMutex.lock();
-	node = client->nodebyhandle(node->nodehandle);
-	if(!node)
+void MegaApiImpl::login(const char *login, const char *password, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
+	request->setEmail(login);
+	request->setPassword(password);
+	if (requestQueue.push(request))
 	{
-        sdkMutex.unlock();
-		return 1;
+	    waiter->notify();
 	}
+}
 
-	if (node->type != FILENODE)
-	{
-		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
-		{
-			if(recursive)
-			{
-				if(!processTree(*it++,processor))
-				{
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-			else
-			{
-				if(!processor->processNode(*it++))
-				{
-                    sdkMutex.unlock();
-					return 0;
-				}
-			}
-		}
-	}
-	bool result = processor->processNode(node);
+char *MegaApiImpl::dumpSession()
+{
+    sdkMutex.lock();
+    byte session[MAX_SESSION_LENGTH];
+    char* buf = NULL;
+    int size;
+    size = client->dumpsession(session, sizeof session);
+    if (size > 0)
+    {
+        buf = new char[sizeof(session) * 4 / 3 + 4];
+        Base64::btoa(session, size, buf);
+    }
 
     sdkMutex.unlock();
-	return result;
+    return buf;
 }
 
-MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, bool recursive)
+char *MegaApiImpl::dumpXMPPSession()
 {
-    if(!n || !searchString) return new MegaNodeListPrivate();
     sdkMutex.lock();
-	Node *node = client->nodebyhandle(n->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return new MegaNodeListPrivate();
-	}
-
-	SearchTreeProcessor searchProcessor(searchString);
-	processTree(node, &searchProcessor, recursive);
-    vector<Node *>& vNodes = searchProcessor.getResults();
+    char* buf = NULL;
 
-    MegaNodeList *nodeList;
-    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
-    else nodeList = new MegaNodeListPrivate();
+    if (client->loggedin())
+    {
+        buf = new char[MAX_SESSION_LENGTH * 4 / 3 + 4];
+        Base64::btoa((const byte *)client->sid.data(), client->sid.size(), buf);
+    }
 
     sdkMutex.unlock();
+    return buf;
+}
 
-    return nodeList;
+void MegaApiImpl::createAccount(const char* email, const char* password, const char* name, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_ACCOUNT, listener);
+	request->setEmail(email);
+	request->setPassword(password);
+	request->setName(name);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-long long MegaApiImpl::getSize(MegaNode *n)
+void MegaApiImpl::fastCreateAccount(const char* email, const char *base64pwkey, const char* name, MegaRequestListener *listener)
 {
-    if(!n) return 0;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_ACCOUNT, listener);
+	request->setEmail(email);
+	request->setPrivateKey(base64pwkey);
+	request->setName(name);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node)
-    {
-        sdkMutex.unlock();
-        return 0;
-    }
-    SizeProcessor sizeProcessor;
-    processTree(node, &sizeProcessor);
-    long long result = sizeProcessor.getTotalBytes();
-    sdkMutex.unlock();
+void MegaApiImpl::querySignupLink(const char* link, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_QUERY_SIGNUP_LINK, listener);
+	request->setLink(link);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    return result;
+void MegaApiImpl::confirmAccount(const char* link, const char *password, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CONFIRM_ACCOUNT, listener);
+	request->setLink(link);
+	request->setPassword(password);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-char *MegaApiImpl::getFingerprint(const char *filePath)
+void MegaApiImpl::fastConfirmAccount(const char* link, const char *base64pwkey, MegaRequestListener *listener)
 {
-    if(!filePath) return NULL;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CONFIRM_ACCOUNT, listener);
+	request->setLink(link);
+	request->setPrivateKey(base64pwkey);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    string path = filePath;
-    string localpath;
-    fsAccess->path2local(&path, &localpath);
+void MegaApiImpl::setProxySettings(MegaProxy *proxySettings)
+{
+    Proxy localProxySettings;
+    localProxySettings.setProxyType(proxySettings->getProxyType());
 
-    FileAccess *fa = fsAccess->newfileaccess();
-    if(!fa->fopen(&localpath, true, false))
-        return NULL;
+    string url;
+    if(proxySettings->getProxyURL())
+        url = proxySettings->getProxyURL();
 
-    FileFingerprint fp;
-    fp.genfingerprint(fa);
-    m_off_t size = fa->size;
-    delete fa;
-    if(fp.size < 0)
-        return NULL;
+    string localurl;
 
-    string fingerprint;
-    fp.serializefingerprint(&fingerprint);
+#if defined(WINDOWS_PHONE) || (defined(_WIN32) && defined(USE_CURL))
+    localurl = url;
+#else
+    fsAccess->path2local(&url, &localurl);
+#endif
 
-    char bsize[sizeof(size)+1];
-    int l = Serialize64::serialize((byte *)bsize, size);
-    char *buf = new char[l * 4 / 3 + 4];
-    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+    localProxySettings.setProxyURL(&localurl);
 
-    string result(1, ssize);
-    result.append(buf);
-    result.append(fingerprint);
-    delete [] buf;
+    if(proxySettings->credentialsNeeded())
+    {
+        string username;
+        if(proxySettings->getUsername())
+            username = proxySettings->getUsername();
 
-    return MegaApi::strdup(result.c_str());
-}
+        string localusername;
 
-char *MegaApiImpl::getFingerprint(MegaNode *n)
-{
-    if(!n) return NULL;
+#if defined(WINDOWS_PHONE) || (defined(_WIN32) && defined(USE_CURL))
+        localusername = username;
+#else
+        fsAccess->path2local(&username, &localusername);
+#endif
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
-    {
-        sdkMutex.unlock();
-        return NULL;
+        string password;
+        if(proxySettings->getPassword())
+            password = proxySettings->getPassword();
+
+        string localpassword;
+
+#if defined(WINDOWS_PHONE) || (defined(_WIN32) && defined(USE_CURL))
+        localpassword = password;
+#else
+        fsAccess->path2local(&password, &localpassword);
+#endif
+
+        localProxySettings.setCredentials(&localusername, &localpassword);
     }
 
-    string fingerprint;
-    node->serializefingerprint(&fingerprint);
-    m_off_t size = node->size;
+    sdkMutex.lock();
+    httpio->setproxy(&localProxySettings);
     sdkMutex.unlock();
+}
 
-    char bsize[sizeof(size)+1];
-    int l = Serialize64::serialize((byte *)bsize, size);
-    char *buf = new char[l * 4 / 3 + 4];
-    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
-    string result(1, ssize);
-    result.append(buf);
-    result.append(fingerprint);
-    delete [] buf;
+MegaProxy *MegaApiImpl::getAutoProxySettings()
+{
+    MegaProxy *proxySettings = new MegaProxy;
+    sdkMutex.lock();
+    Proxy *localProxySettings = httpio->getautoproxy();
+    sdkMutex.unlock();
+    proxySettings->setProxyType(localProxySettings->getProxyType());
+    if(localProxySettings->getProxyType() == Proxy::CUSTOM)
+    {
+        string localProxyURL = localProxySettings->getProxyURL();
+        string proxyURL;
+        fsAccess->local2path(&localProxyURL, &proxyURL);
+        proxySettings->setProxyURL(proxyURL.c_str());
+    }
 
-    return MegaApi::strdup(result.c_str());
+    delete localProxySettings;
+    return proxySettings;
 }
 
-char *MegaApiImpl::getFingerprint(MegaInputStream *inputStream, int64_t mtime)
+void MegaApiImpl::loop()
 {
-    if(!inputStream) return NULL;
+#if (WINDOWS_PHONE || TARGET_OS_IPHONE)
+    // Workaround to get the IP of valid DNS servers on Windows Phone/iOS
+    string servers;
 
-    ExternalInputStream is(inputStream);
-    m_off_t size = is.size();
-    if(size < 0)
-        return NULL;
+    while (true)
+    {
+    #ifdef WINDOWS_PHONE
+        client->httpio->getMEGADNSservers(&servers);
+    #else
+        __res_state res;
+        if(res_ninit(&res) == 0)
+        {
+            union res_sockaddr_union u[MAXNS];
+            int nscount = res_getservers(&res, u, MAXNS);
 
-    FileFingerprint fp;
-    fp.genfingerprint(&is, mtime);
+            for(int i = 0; i < nscount; i++)
+            {
+                char straddr[INET6_ADDRSTRLEN];
+                straddr[0] = 0;
 
-    if(fp.size < 0)
-        return NULL;
+                if(u[i].sin.sin_family == PF_INET)
+                {
+                    mega_inet_ntop(PF_INET, &u[i].sin.sin_addr, straddr, sizeof(straddr));
+                }
 
-    string fingerprint;
-    fp.serializefingerprint(&fingerprint);
+                if(u[i].sin6.sin6_family == PF_INET6)
+                {
+                    mega_inet_ntop(PF_INET6, &u[i].sin6.sin6_addr, straddr, sizeof(straddr));
+                }
 
-    char bsize[sizeof(size)+1];
-    int l = Serialize64::serialize((byte *)bsize, size);
-    char *buf = new char[l * 4 / 3 + 4];
-    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+                if(straddr[0])
+                {
+                    if (servers.size())
+                    {
+                        servers.append(",");
+                    }
+                    servers.append(straddr);
+                }
+            }
 
-    string result(1, ssize);
-    result.append(buf);
-    result.append(fingerprint);
-    delete [] buf;
+            res_ndestroy(&res);
+        }
+    #endif
 
-    return MegaApi::strdup(result.c_str());
-}
+        if (servers.size())
+            break;
 
-MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint)
-{
-    if(!fingerprint) return NULL;
+    #ifdef WINDOWS_PHONE
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+    #else
+        sleep(1);
+    #endif
+    }
 
-    MegaNode *result;
-    sdkMutex.lock();
-    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint));
-    sdkMutex.unlock();
-    return result;
-}
+    LOG_debug << "Using MEGA DNS servers " << servers;
+    httpio->setdnsservers(servers.c_str());
 
-MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint, MegaNode* parent)
-{
-    if(!fingerprint) return NULL;
+#elif _WIN32
+    httpio->lock();
+#endif
+
+    while(true)
+	{
+        int r = client->wait();
+        if(r & Waiter::NEEDEXEC)
+        {
+            // let slow listeners catch up
+            callbackExecutor->waitForSpace();
+
+            sendPendingTransfers();
+            sendPendingUploads();
+            promoteQueuedUploads();
+            sendPendingRequests();
+            if(threadExit)
+                break;
+
+            sdkMutex.lock();
+            int64_t execstart = Metrics::now();
+            client->exec();
+            client->metrics.observe(Metrics::LOOP_TIME, "", (Metrics::now() - execstart) / 1000.0);
+
+            if (queueWrites.size() || queueDeletes.size())
+            {
+                client->cachequeuedtransfers(&queueWrites, &queueDeletes);
+            }
+
+            // coalescing window of held back node updates elapsed
+            if (EVER(nodeUpdateDeadline) && nodeUpdateDeadline <= Waiter::ds)
+            {
+                flushNodeUpdates();
+            }
+
+            if (EVER(transfersProgressDeadline) && transfersProgressDeadline <= Waiter::ds)
+            {
+                fireOnTransfersProgress();
+            }
+
+            if (streamingBuffersReleased)
+            {
+                streamingBuffersReleased = false;
+                deliverStreamingOverflow();
+            }
+            sdkMutex.unlock();
+        }
+	}
 
-    MegaNode *result;
     sdkMutex.lock();
-    Node *p = NULL;
-    if(parent)
-    {
-        p = client->nodebyhandle(parent->getHandle());
-    }
 
-    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint, p));
+    // stop the gfx workers before they can notify a deleted waiter
+    delete gfxAccess;
+    gfxAccess = NULL;
+
+    delete client;
+
+	//It doesn't seem fully safe to delete those objects :-/
+    // delete httpio;
+    // delete waiter;
+    // delete fsAccess;
     sdkMutex.unlock();
-    return result;
 }
 
-bool MegaApiImpl::hasFingerprint(const char *fingerprint)
+
+void MegaApiImpl::createFolder(const char *name, MegaNode *parent, MegaRequestListener *listener)
 {
-    return (getNodeByFingerprintInternal(fingerprint) != NULL);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREATE_FOLDER, listener);
+    if(parent) request->setParentHandle(parent->getHandle());
+	request->setName(name);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-char *MegaApiImpl::getCRC(const char *filePath)
+void MegaApiImpl::moveNode(MegaNode *node, MegaNode *newParent, MegaRequestListener *listener)
 {
-    if(!filePath) return NULL;
-
-    string path = filePath;
-    string localpath;
-    fsAccess->path2local(&path, &localpath);
-
-    FileAccess *fa = fsAccess->newfileaccess();
-    if(!fa->fopen(&localpath, true, false))
-        return NULL;
-
-    FileFingerprint fp;
-    fp.genfingerprint(fa);
-    delete fa;
-    if(fp.size < 0)
-        return NULL;
-
-    string result;
-    result.resize((sizeof fp.crc) * 4 / 3 + 4);
-    result.resize(Base64::btoa((const byte *)fp.crc, sizeof fp.crc, (char*)result.c_str()));
-    return MegaApi::strdup(result.c_str());
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    if(newParent) request->setParentHandle(newParent->getHandle());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-char *MegaApiImpl::getCRCFromFingerprint(const char *fingerprint)
+void MegaApiImpl::moveNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener)
 {
-    if(!fingerprint || !fingerprint[0]) return NULL;
-    
-    m_off_t size = 0;
-    unsigned int fsize = strlen(fingerprint);
-    unsigned int ssize = fingerprint[0] - 'A';
-    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
-        return NULL;
-    
-    int len =  sizeof(size) + 1;
-    byte *buf = new byte[len];
-    Base64::atob(fingerprint + 1, buf, len);
-    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
-    delete [] buf;
-    if(l <= 0)
-        return NULL;
-    
-    string sfingerprint = fingerprint + ssize + 1;
-    
-    FileFingerprint fp;
-    if(!fp.unserializefingerprint(&sfingerprint))
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE_NODES, listener);
+    request->setNodeHandles(nodes);
+    if(newParent) request->setParentHandle(newParent->getHandle());
+    if (requestQueue.push(request))
     {
-        return NULL;
+        waiter->notify();
     }
-    
-    string result;
-    result.resize((sizeof fp.crc) * 4 / 3 + 4);
-    result.resize(Base64::btoa((const byte *)fp.crc, sizeof fp.crc,(char*)result.c_str()));
-    return MegaApi::strdup(result.c_str());
 }
 
-char *MegaApiImpl::getCRC(MegaNode *n)
+void MegaApiImpl::copyNodes(MegaNodeList *nodes, MegaNode *newParent, MegaRequestListener *listener)
 {
-    if(!n) return NULL;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY_NODES, listener);
+    request->setNodeHandles(nodes);
+    if(newParent) request->setParentHandle(newParent->getHandle());
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
+void MegaApiImpl::copyNode(MegaNode *node, MegaNode* target, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
+    if(node)
     {
-        sdkMutex.unlock();
-        return NULL;
+        if(node->isPublic())
+        {
+            request->setPublicNode(node);
+        }
+        else
+        {
+            request->setNodeHandle(node->getHandle());
+        }
     }
+    if(target) request->setParentHandle(target->getHandle());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    string result;
-    result.resize((sizeof node->crc) * 4 / 3 + 4);
-    result.resize(Base64::btoa((const byte *)node->crc, sizeof node->crc, (char*)result.c_str()));
+void MegaApiImpl::copyNode(MegaNode *node, MegaNode *target, const char *newName, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
+    if(node)
+    {
+        if(node->isPublic())
+        {
+            request->setPublicNode(node);
+        }
+        else
+        {
+            request->setNodeHandle(node->getHandle());
+        }
+    }
+    if(target) request->setParentHandle(target->getHandle());
+    request->setName(newName);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    sdkMutex.unlock();
-    return MegaApi::strdup(result.c_str());
+void MegaApiImpl::renameNode(MegaNode *node, const char *newName, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_RENAME, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+	request->setName(newName);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
+void MegaApiImpl::remove(MegaNode *node, MegaRequestListener *listener)
 {
-    if(!parent) return NULL;
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(parent->getHandle());
-    if(!node || node->type == FILENODE)
+void MegaApiImpl::removeNodes(MegaNodeList *nodes, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_NODES, listener);
+    request->setNodeHandles(nodes);
+    if (requestQueue.push(request))
     {
-        sdkMutex.unlock();
-        return NULL;
+        waiter->notify();
     }
+}
 
-    byte binarycrc[sizeof(node->crc)];
-    Base64::atob(crc, binarycrc, sizeof(binarycrc));
-
-    for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
+void MegaApiImpl::cleanRubbishBin(MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CLEAN_RUBBISH_BIN, listener);
+    if (requestQueue.push(request))
     {
-        Node *child = (*it);
-        if(!memcmp(child->crc, binarycrc, sizeof(node->crc)))
-        {
-            MegaNode *result = MegaNodePrivate::fromNode(child);
-            sdkMutex.unlock();
-            return result;
-        }
+        waiter->notify();
     }
+}
 
-    sdkMutex.unlock();
-    return NULL;
+void MegaApiImpl::sendFileToUser(MegaNode *node, MegaUser *user, MegaRequestListener *listener)
+{
+	return sendFileToUser(node, user ? user->getEmail() : NULL, listener);
 }
 
-SearchTreeProcessor::SearchTreeProcessor(const char *search) { this->search = search; }
+void MegaApiImpl::sendFileToUser(MegaNode *node, const char* email, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_COPY, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    request->setEmail(email);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-#if defined(_WIN32) || defined(__APPLE__)
+void MegaApiImpl::share(MegaNode* node, MegaUser *user, int access, MegaRequestListener *listener)
+{
+    return share(node, user ? user->getEmail() : NULL, access, listener);
+}
 
-char *strcasestr(const char *string, const char *substring)
+void MegaApiImpl::share(MegaNode *node, const char* email, int access, MegaRequestListener *listener)
 {
-	int i, j;
-	for (i = 0; string[i]; i++)
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SHARE, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+	request->setEmail(email);
+	request->setAccess(access);
+	if (requestQueue.push(request))
 	{
-		for (j = 0; substring[j]; j++)
-		{
-			unsigned char c1 = string[i + j];
-			if (!c1)
-				return NULL;
+	    waiter->notify();
+	}
+}
 
-			unsigned char c2 = substring[j];
-			if (toupper(c1) != toupper(c2))
-				break;
-		}
+void MegaApiImpl::loginToFolder(const char* megaFolderLink, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGIN, listener);
+	request->setLink(megaFolderLink);
+    request->setEmail("FOLDER");
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-		if (!substring[j])
-			return (char *)string + i;
+void MegaApiImpl::importFileLink(const char* megaFileLink, MegaNode *parent, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_IMPORT_LINK, listener);
+	if(parent) request->setParentHandle(parent->getHandle());
+	request->setLink(megaFileLink);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
 	}
-	return NULL;
 }
 
-#endif
+void MegaApiImpl::getPublicNode(const char* megaFileLink, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PUBLIC_NODE, listener);
+	request->setLink(megaFileLink);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-bool SearchTreeProcessor::processNode(Node* node)
+void MegaApiImpl::getThumbnail(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
 {
-	if(!node) return true;
-	if(!search) return false;
+	getNodeAttribute(node, 0, dstFilePath, listener);
+}
 
-	if(strcasestr(node->displayname(), search)!=NULL)
-		results.push_back(node);
+void MegaApiImpl::cancelGetThumbnail(MegaNode* node, MegaRequestListener *listener)
+{
+	cancelGetNodeAttribute(node, 0, listener);
+}
 
-	return true;
+void MegaApiImpl::setThumbnail(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
+{
+	setNodeAttribute(node, 0, srcFilePath, listener);
 }
 
-vector<Node *> &SearchTreeProcessor::getResults()
+void MegaApiImpl::getPreview(MegaNode* node, const char *dstFilePath, MegaRequestListener *listener)
 {
-	return results;
+	getNodeAttribute(node, 1, dstFilePath, listener);
 }
 
-SizeProcessor::SizeProcessor()
+void MegaApiImpl::cancelGetPreview(MegaNode* node, MegaRequestListener *listener)
 {
-    totalBytes=0;
+	cancelGetNodeAttribute(node, 1, listener);
 }
 
-bool SizeProcessor::processNode(Node *node)
+void MegaApiImpl::setPreview(MegaNode* node, const char *srcFilePath, MegaRequestListener *listener)
 {
-    if(node->type == FILENODE)
-        totalBytes += node->size;
-    return true;
+	setNodeAttribute(node, 1, srcFilePath, listener);
 }
 
-long long SizeProcessor::getTotalBytes()
+void MegaApiImpl::getUserAvatar(MegaUser* user, const char *dstFilePath, MegaRequestListener *listener)
 {
-    return totalBytes;
+    getUserAttr(user, MegaApi::USER_ATTR_AVATAR, dstFilePath, listener);
 }
 
-void MegaApiImpl::transfer_added(Transfer *t)
+void MegaApiImpl::setAvatar(const char *dstFilePath, MegaRequestListener *listener)
 {
-	MegaTransferPrivate *transfer = currentTransfer;
-    if(!transfer)
-    {
-        transfer = new MegaTransferPrivate(t->type);
-        transfer->setSyncTransfer(true);
-    }
+    setUserAttr(MegaApi::USER_ATTR_AVATAR, dstFilePath, listener);
+}
 
-	currentTransfer = NULL;
-    transfer->setTransfer(t);
-    transfer->setTotalBytes(t->size);
-    transfer->setTag(t->tag);
-	transferMap[t->tag]=transfer;
+void MegaApiImpl::getUserAttribute(MegaUser* user, int type, MegaRequestListener *listener)
+{
+    getUserAttr(user, type ? type : -1, NULL, listener);
+}
 
-    if (t->type == GET)
+void MegaApiImpl::setUserAttribute(int type, const char *value, MegaRequestListener *listener)
+{
+    setUserAttr(type ? type : -1, value, listener);
+}
+
+void MegaApiImpl::setCustomNodeAttribute(MegaNode *node, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_NODE, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    request->setName(attrName);
+    request->setText(value);
+    if (requestQueue.push(request))
     {
-        totalDownloads++;
-        pendingDownloads++;
+        waiter->notify();
     }
-    else
+}
+
+void MegaApiImpl::setCustomNodesAttribute(MegaNodeList *nodes, const char *attrName, const char *value, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_NODES, listener);
+    request->setNodeHandles(nodes);
+    request->setName(attrName);
+    request->setText(value);
+    if (requestQueue.push(request))
     {
-        totalUploads++;
-        pendingUploads++;
+        waiter->notify();
     }
-
-    fireOnTransferStart(transfer);
 }
 
-void MegaApiImpl::transfer_removed(Transfer *t)
+void MegaApiImpl::exportNode(MegaNode *node, int64_t expireTime, MegaRequestListener *listener)
 {
-    if(transferMap.find(t->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(t->tag);
-    if(!transfer)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    request->setNumber(expireTime);
+    request->setAccess(1);
+    if (requestQueue.push(request))
     {
-        return;
+        waiter->notify();
     }
+}
 
-    if (t->type == GET)
+void MegaApiImpl::disableExport(MegaNode *node, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_EXPORT, listener);
+    if(node) request->setNodeHandle(node->getHandle());
+    request->setAccess(0);
+    if (requestQueue.push(request))
     {
-        if(pendingDownloads > 0)
-            pendingDownloads--;
-
-        if(totalDownloads > 0)
-            totalDownloads--;
+        waiter->notify();
     }
-    else
-    {
-        if(pendingUploads > 0)
-            pendingUploads--;
+}
 
-        if(totalUploads > 0)
-            totalUploads--;
-    }
-
-    fireOnTransferFinish(transfer, MegaError(transfer->getLastErrorCode()));
+void MegaApiImpl::fetchNodes(MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES, listener);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-void MegaApiImpl::transfer_prepare(Transfer *t)
+void MegaApiImpl::getPricing(MegaRequestListener *listener)
 {
-    if(transferMap.find(t->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PRICING, listener);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-	if (t->type == GET)
-		transfer->setNodeHandle(t->files.back()->h);
+void MegaApiImpl::getPaymentId(handle productHandle, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PAYMENT_ID, listener);
+    request->setNodeHandle(productHandle);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    string path;
-    fsAccess->local2path(&(t->files.back()->localname), &path);
-    transfer->setPath(path.c_str());
-    transfer->setTotalBytes(t->size);
+void MegaApiImpl::upgradeAccount(MegaHandle productHandle, int paymentMethod, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_UPGRADE_ACCOUNT, listener);
+    request->setNodeHandle(productHandle);
+    request->setNumber(paymentMethod);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    LOG_info << "Transfer (" << transfer->getTransferString() << ") starting. File: " << transfer->getFileName();
+void MegaApiImpl::submitPurchaseReceipt(int gateway, const char *receipt, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT, listener);
+    request->setNumber(gateway);
+    request->setText(receipt);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::transfer_update(Transfer *tr)
+void MegaApiImpl::creditCardStore(const char* address1, const char* address2, const char* city,
+                                  const char* province, const char* country, const char *postalcode,
+                                  const char* firstname, const char* lastname, const char* creditcard,
+                                  const char* expire_month, const char* expire_year, const char* cv2,
+                                  MegaRequestListener *listener)
 {
-    if(transferMap.find(tr->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
-    if(!transfer)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_STORE, listener);
+    string email;
+
+    sdkMutex.lock();
+    User *u = client->finduser(client->me);
+    if (u)
     {
-        return;
+        email = u->email;
     }
+    sdkMutex.unlock();
 
-    if(tr->slot)
+    if (email.size())
     {
-        if((transfer->getUpdateTime() != Waiter::ds) || !tr->slot->progressreported || (tr->slot->progressreported == tr->size))
+        string saddress1, saddress2, scity, sprovince, scountry, spostalcode;
+        string sfirstname, slastname, screditcard, sexpire_month, sexpire_year, scv2;
+
+        if (address1)
         {
-            if(!transfer->getStartTime())
-            {
-                transfer->setStartTime(Waiter::ds);
-            }
+           saddress1 = address1;
+        }
 
-            m_off_t deltaSize = tr->slot->progressreported - transfer->getTransferredBytes();
-            transfer->setDeltaSize(deltaSize);
+        if (address2)
+        {
+            saddress2 = address2;
+        }
 
-            dstime currentTime = Waiter::ds;
-            long long speed = 0;
-            if(tr->type == GET)
-            {
-                totalDownloadedBytes += deltaSize;
+        if (city)
+        {
+            scity = city;
+        }
 
-                while(downloadBytes.size())
-                {
-                    dstime deltaTime = currentTime - downloadTimes[0];
-                    if(deltaTime <= 50)
-                    {
-                        break;
-                    }
+        if (province)
+        {
+            sprovince = province;
+        }
 
-                    downloadPartialBytes -= downloadBytes[0];
-                    downloadBytes.erase(downloadBytes.begin());
-                    downloadTimes.erase(downloadTimes.begin());
-                }
+        if (country)
+        {
+            scountry = country;
+        }
 
-                downloadBytes.push_back(deltaSize);
-                downloadTimes.push_back(currentTime);
-                downloadPartialBytes += deltaSize;
+        if (postalcode)
+        {
+            spostalcode = postalcode;
+        }
 
-                downloadSpeed = (downloadPartialBytes * 10) / 50;
-                speed = downloadSpeed;
-            }
-            else
-            {
-                totalUploadedBytes += deltaSize;
+        if (firstname)
+        {
+            sfirstname = firstname;
+        }
 
-                while(uploadBytes.size())
-                {
-                    dstime deltaTime = currentTime - uploadTimes[0];
-                    if(deltaTime <= 50)
-                    {
-                        break;
-                    }
+        if (lastname)
+        {
+            slastname = lastname;
+        }
 
-                    uploadPartialBytes -= uploadBytes[0];
-                    uploadBytes.erase(uploadBytes.begin());
-                    uploadTimes.erase(uploadTimes.begin());
-                }
+        if (creditcard)
+        {
+            screditcard = creditcard;
+            screditcard.erase(remove_if(screditcard.begin(), screditcard.end(),
+                                     not1(ptr_fun(static_cast<int(*)(int)>(isdigit)))), screditcard.end());
+        }
 
-                uploadBytes.push_back(deltaSize);
-                uploadTimes.push_back(currentTime);
-                uploadPartialBytes += deltaSize;
+        if (expire_month)
+        {
+            sexpire_month = expire_month;
+        }
 
-                uploadSpeed = (uploadPartialBytes * 10) / 50;
-                speed = uploadSpeed;
-            }
+        if (expire_year)
+        {
+            sexpire_year = expire_year;
+        }
 
-            transfer->setTransferredBytes(tr->slot->progressreported);
+        if (cv2)
+        {
+            scv2 = cv2;
+        }
 
-            if(currentTime < transfer->getStartTime())
-                transfer->setStartTime(currentTime);
+        int tam = 256 + sfirstname.size() + slastname.size() + screditcard.size()
+                + sexpire_month.size() + sexpire_year.size() + scv2.size() + saddress1.size()
+                + saddress2.size() + scity.size() + sprovince.size() + spostalcode.size()
+                + scountry.size() + email.size();
 
-            transfer->setSpeed(speed);
-            transfer->setUpdateTime(currentTime);
+        char *ccplain = new char[tam];
+        snprintf(ccplain, tam, "{\"first_name\":\"%s\",\"last_name\":\"%s\","
+                "\"card_number\":\"%s\","
+                "\"expiry_date_month\":\"%s\",\"expiry_date_year\":\"%s\","
+                "\"cv2\":\"%s\",\"address1\":\"%s\","
+                "\"address2\":\"%s\",\"city\":\"%s\","
+                "\"province\":\"%s\",\"postal_code\":\"%s\","
+                "\"country_code\":\"%s\",\"email_address\":\"%s\"}", sfirstname.c_str(), slastname.c_str(),
+                 screditcard.c_str(), sexpire_month.c_str(), sexpire_year.c_str(), scv2.c_str(), saddress1.c_str(),
+                 saddress2.c_str(), scity.c_str(), sprovince.c_str(), spostalcode.c_str(), scountry.c_str(), email.c_str());
 
-            fireOnTransferUpdate(transfer);
-        }
-	}
+        request->setText((const char* )ccplain);
+        delete [] ccplain;
+    }
+
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::transfer_failed(Transfer* tr, error e)
+void MegaApiImpl::creditCardQuerySubscriptions(MegaRequestListener *listener)
 {
-    if(transferMap.find(tr->tag) == transferMap.end()) return;
-    MegaError megaError(e);
-    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
-    transfer->setUpdateTime(Waiter::ds);
-    transfer->setDeltaSize(0);
-    transfer->setSpeed(0);
-    transfer->setLastErrorCode(e);
-    fireOnTransferTemporaryError(transfer, megaError);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS, listener);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::transfer_limit(Transfer* t)
+void MegaApiImpl::creditCardCancelSubscriptions(const char* reason, MegaRequestListener *listener)
 {
-    if(transferMap.find(t->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(t->tag);
-    transfer->setUpdateTime(Waiter::ds);
-    transfer->setDeltaSize(0);
-    transfer->setSpeed(0);
-    fireOnTransferTemporaryError(transfer, MegaError(API_EOVERQUOTA));
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS, listener);
+    request->setText(reason);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::transfer_complete(Transfer* tr)
+void MegaApiImpl::getPaymentMethods(MegaRequestListener *listener)
 {
-    if(transferMap.find(tr->tag) == transferMap.end()) return;
-    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
-
-    dstime currentTime = Waiter::ds;
-    if(!transfer->getStartTime())
-        transfer->setStartTime(currentTime);
-    if(currentTime<transfer->getStartTime())
-        transfer->setStartTime(currentTime);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_PAYMENT_METHODS, listener);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    transfer->setUpdateTime(currentTime);
+char *MegaApiImpl::exportMasterKey()
+{
+    sdkMutex.lock();
+    char* buf = NULL;
 
-    if(tr->size != transfer->getTransferredBytes())
+    if(client->loggedin())
     {
-        long long speed = 0;
-        long long deltaTime = currentTime-transfer->getStartTime();
-        if(deltaTime<=0)
-            deltaTime = 1;
-        if(transfer->getTotalBytes()>0)
-            speed = (10*transfer->getTotalBytes())/deltaTime;
-
-        transfer->setSpeed(speed);
-        transfer->setDeltaSize(tr->size - transfer->getTransferredBytes());
-        if(tr->type == GET)
-            totalDownloadedBytes += transfer->getDeltaSize();
-        else
-            totalUploadedBytes += transfer->getDeltaSize();
+        buf = new char[SymmCipher::KEYLENGTH * 4 / 3 + 4];
+        Base64::btoa(client->key.key, SymmCipher::KEYLENGTH, buf);
+    }
 
-        transfer->setTransferredBytes(tr->size);
-    }
+    sdkMutex.unlock();
+    return buf;
+}
 
-    if (tr->type == GET)
-    {
-        if(pendingDownloads > 0)
-            pendingDownloads--;
+void MegaApiImpl::getAccountDetails(bool storage, bool transfer, bool pro, bool sessions, bool purchases, bool transactions, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ACCOUNT_DETAILS, listener);
+	int numDetails = 0;
+	if(storage) numDetails |= 0x01;
+    if(transfer) numDetails |= 0x02;
+	if(pro) numDetails |= 0x04;
+	if(transactions) numDetails |= 0x08;
+	if(purchases) numDetails |= 0x10;
+	if(sessions) numDetails |= 0x20;
+	request->setNumDetails(numDetails);
 
-        string path;
-        fsAccess->local2path(&tr->localfilename, &path);
-        transfer->setPath(path.c_str());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-        fireOnTransferFinish(transfer, MegaError(API_OK));
-    }
-    else
+void MegaApiImpl::setAccountDetailsCacheTtl(int seconds)
+{
+    sdkMutex.lock();
+    client->accountcachettl = seconds > 0 ? seconds * 10 : 0;
+    if (!client->accountcachettl)
     {
-        if(tr->size != transfer->getTransferredBytes())
-        {
-            fireOnTransferUpdate(transfer);
-        }
+        client->invalidateaccountdetails();
     }
+    sdkMutex.unlock();
 }
 
-dstime MegaApiImpl::pread_failure(error e, int retry, void* param)
+void MegaApiImpl::changePassword(const char *oldPassword, const char *newPassword, MegaRequestListener *listener)
 {
-	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
-	transfer->setUpdateTime(Waiter::ds);
-	transfer->setDeltaSize(0);
-	transfer->setSpeed(0);
-	transfer->setLastBytes(NULL);
-	if (retry < transfer->getMaxRetries())
-	{
-        fireOnTransferTemporaryError(transfer, MegaError(e));
-		return (dstime)(retry*10);
-	}
-	else
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CHANGE_PW, listener);
+	request->setPassword(oldPassword);
+	request->setNewPassword(newPassword);
+	if (requestQueue.push(request))
 	{
-        fireOnTransferFinish(transfer, MegaError(e));
-		return ~(dstime)0;
+	    waiter->notify();
 	}
 }
 
-bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t, void* param)
+void MegaApiImpl::logout(MegaRequestListener *listener)
 {
-	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
-	transfer->setUpdateTime(Waiter::ds);
-    transfer->setLastBytes((char *)buffer);
-    transfer->setDeltaSize(len);
-    totalDownloadedBytes += len;
-	transfer->setTransferredBytes(transfer->getTransferredBytes()+len);
-
-	bool end = (transfer->getTransferredBytes() == transfer->getTotalBytes());
-    fireOnTransferUpdate(transfer);
-    if(!fireOnTransferData(transfer) || end)
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT, listener);
+    request->setFlag(true);
+	if (requestQueue.push(request))
 	{
-        fireOnTransferFinish(transfer, end ? MegaError(API_OK) : MegaError(API_EINCOMPLETE));
-		return end;
+	    waiter->notify();
 	}
-    return true;
 }
 
-void MegaApiImpl::reportevent_result(error e)
+void MegaApiImpl::localLogout(MegaRequestListener *listener)
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_REPORT_EVENT)) return;
-
-    fireOnRequestFinish(request, megaError);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT, listener);
+    request->setFlag(false);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::loadbalancing_result(string *servers, error e)
+void MegaApiImpl::submitFeedback(int rating, const char *comment, MegaRequestListener *listener)
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_LOAD_BALANCING)) return;
-
-    if(!e)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SUBMIT_FEEDBACK, listener);
+    request->setText(comment);
+    request->setNumber(rating);
+    if (requestQueue.push(request))
     {
-        request->setText(servers->c_str());
+        waiter->notify();
     }
-    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::sessions_killed(handle, error e)
+void MegaApiImpl::reportEvent(const char *details, MegaRequestListener *listener)
 {
-    MegaError megaError(e);
-
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_KILL_SESSION)) return;
-
-    fireOnRequestFinish(request, megaError);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REPORT_EVENT, listener);
+    request->setText(details);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::cleanrubbishbin_result(error e)
+void MegaApiImpl::sendEvent(int eventType, const char *message, MegaRequestListener *listener)
 {
-    MegaError megaError(e);
-
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CLEAN_RUBBISH_BIN)) return;
-
-    fireOnRequestFinish(request, megaError);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SEND_EVENT, listener);
+    request->setNumber(eventType);
+    request->setText(message);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-#ifdef ENABLE_SYNC
-void MegaApiImpl::syncupdate_state(Sync *sync, syncstate_t newstate)
+void MegaApiImpl::getNodeAttribute(MegaNode *node, int type, const char *dstFilePath, MegaRequestListener *listener)
 {
-    LOG_debug << "Sync state change: " << newstate << " Path: " << sync->localroot.name;
-    client->abortbackoff(false);
-
-    if(newstate == SYNC_FAILED)
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_ATTR_FILE, listener);
+    if(dstFilePath)
     {
-        MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+        string path(dstFilePath);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
 
-        if(sync->localroot.node)
+        int c = path[path.size()-1];
+        if((c=='/') || (c == '\\'))
         {
-            request->setNodeHandle(sync->localroot.node->nodehandle);
+            const char *base64Handle = node->getBase64Handle();
+            path.append(base64Handle);
+            path.push_back('0' + type);
+            path.append(".jpg");
+            delete [] base64Handle;
         }
 
-        int nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-        requestMap[nextTag]=request;
-        fireOnRequestFinish(request, MegaError(sync->errorcode));
+        request->setFile(path.c_str());
     }
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-    megaSync->setState(newstate);
-
-    fireOnSyncStateChanged(megaSync);
+    request->setParamType(type);
+    if(node) request->setNodeHandle(node->getHandle());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-void MegaApiImpl::syncupdate_scanning(bool scanning)
+void MegaApiImpl::prefetchThumbnails(MegaNodeList *nodes, int priority, MegaRequestListener *listener)
 {
-    if(client)
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_PREFETCH_THUMBNAILS, listener);
+    request->setNodeHandles(nodes);
+    request->setNumber(priority);
+    if (requestQueue.push(request))
     {
-        client->abortbackoff(false);
-        client->syncscanstate = scanning;
+        waiter->notify();
     }
-    fireOnGlobalSyncStateChanged();
 }
 
-void MegaApiImpl::syncupdate_local_folder_addition(Sync *sync, LocalNode *localNode, const char* path)
+void MegaApiImpl::cancelGetNodeAttribute(MegaNode *node, int type, MegaRequestListener *listener)
 {
-    LOG_debug << "Sync - local folder addition detected: " << path;
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_ATTR_FILE, listener);
+	request->setParamType(type);
+	if (node) request->setNodeHandle(node->getHandle());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_ADITION);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+void MegaApiImpl::setNodeAttribute(MegaNode *node, int type, const char *srcFilePath, MegaRequestListener *listener)
+{
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_FILE, listener);
+	request->setFile(srcFilePath);
+    request->setParamType(type);
+    if(node) request->setNodeHandle(node->getHandle());
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-void MegaApiImpl::syncupdate_local_folder_deletion(Sync *sync, LocalNode *localNode)
+void MegaApiImpl::getUserAttr(MegaUser *user, int type, const char *dstFilePath, MegaRequestListener *listener)
 {
-    client->abortbackoff(false);
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_GET_ATTR_USER, listener);
 
-    string local;
-    string path;
-    localNode->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-    LOG_debug << "Sync - local folder deletion detected: " << path.c_str();
+    if (type == MegaApi::USER_ATTR_AVATAR && dstFilePath)
+    {
+        string path(dstFilePath);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+        int c = path[path.size()-1];
+        if((c=='/') || (c == '\\'))
+        {
+            const char *email = user->getEmail();
+            path.append(email);
+            path.push_back('0' + type);
+            path.append(".jpg");
+            delete [] email;
+        }
 
+        request->setFile(path.c_str());
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_DELETION);
-    event->setPath(path.c_str());
-    fireOnSyncEvent(megaSync, event);
+    request->setParamType(type);
+    if(user)
+    {
+        request->setEmail(user->getEmail());
+    }
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-void MegaApiImpl::syncupdate_local_file_addition(Sync *sync, LocalNode *localNode, const char* path)
+void MegaApiImpl::setUserAttr(int type, const char *srcFilePath, MegaRequestListener *listener)
 {
-    LOG_debug << "Sync - local file addition detected: " << path;
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_USER, listener);
+    if(type == MegaApi::USER_ATTR_AVATAR)
+    {
+        request->setFile(srcFilePath);
+    }
+    else
+    {
+        request->setText(srcFilePath);
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_ADDITION);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+    request->setParamType(type);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::syncupdate_local_file_deletion(Sync *sync, LocalNode *localNode)
+void MegaApiImpl::addContact(const char* email, MegaRequestListener* listener)
 {
-    client->abortbackoff(false);
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_CONTACT, listener);
+	request->setEmail(email);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
+}
 
-    string local;
-    string path;
-    localNode->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-    LOG_debug << "Sync - local file deletion detected: " << path.c_str();
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_DELETION);
-    event->setPath(path.c_str());
-    fireOnSyncEvent(megaSync, event);
-}
-
-void MegaApiImpl::syncupdate_local_file_change(Sync *sync, LocalNode *localNode, const char* path)
+void MegaApiImpl::inviteContact(const char *email, const char *message,int action, MegaRequestListener *listener)
 {
-    LOG_debug << "Sync - local file change detected: " << path;
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_CHANGED);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_INVITE_CONTACT, listener);
+    request->setNumber(action);
+    request->setEmail(email);
+    request->setText(message);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::syncupdate_local_move(Sync *sync, LocalNode *localNode, const char *to)
+void MegaApiImpl::replyContactRequest(MegaContactRequest *r, int action, MegaRequestListener *listener)
 {
-    client->abortbackoff(false);
-
-    string local;
-    string path;
-    localNode->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-    LOG_debug << "Sync - local rename/move " << path.c_str() << " -> " << to;
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REPLY_CONTACT_REQUEST, listener);
+    if(r)
+    {
+        request->setNodeHandle(r->getHandle());
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_MOVE);
-    event->setPath(path.c_str());
-    event->setNewPath(to);
-    fireOnSyncEvent(megaSync, event);
+    request->setNumber(action);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::syncupdate_get(Sync *sync, Node* node, const char *path)
+void MegaApiImpl::removeContact(MegaUser *user, MegaRequestListener* listener)
 {
-    LOG_debug << "Sync - requesting file " << path;
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+	MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_CONTACT, listener);
+    if(user)
+    {
+        request->setEmail(user->getEmail());
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_GET);
-    event->setNodeHandle(node->nodehandle);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+	if (requestQueue.push(request))
+	{
+	    waiter->notify();
+	}
 }
 
-void MegaApiImpl::syncupdate_put(Sync *sync, LocalNode *localNode, const char *path)
+void MegaApiImpl::pauseTransfers(bool pause, int direction, MegaRequestListener* listener)
 {
-    LOG_debug << "Sync - sending file " << path;
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_PUT);
-    event->setPath(path);
-    fireOnSyncEvent(megaSync, event);
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_PAUSE_TRANSFERS, listener);
+    request->setFlag(pause);
+    request->setNumber(direction);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::syncupdate_remote_file_addition(Sync *sync, Node *n)
+bool MegaApiImpl::areTransfersPaused(int direction)
 {
-    LOG_debug << "Sync - remote file addition detected " << n->displayname();
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+    {
+        return false;
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_ADDITION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
+    bool result;
+    sdkMutex.lock();
+    if(direction == MegaTransfer::TYPE_DOWNLOAD)
+    {
+        result = client->xferpaused[GET];
+    }
+    else
+    {
+        result = client->xferpaused[PUT];
+    }
+    sdkMutex.unlock();
+    return result;
 }
 
-void MegaApiImpl::syncupdate_remote_file_deletion(Sync *sync, Node *n)
+//-1 -> AUTO, 0 -> NONE, >0 -> b/s
+void MegaApiImpl::setUploadLimit(int bpslimit)
 {
-    LOG_debug << "Sync - remote file deletion detected " << n->displayname();
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_DELETION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
+    client->putmbpscap = bpslimit;
 }
 
-void MegaApiImpl::syncupdate_remote_folder_addition(Sync *sync, Node *n)
+void MegaApiImpl::setTransferConnections(int direction, int minConnections, int maxConnections)
 {
-    LOG_debug << "Sync - remote folder addition detected " << n->displayname();
-    client->abortbackoff(false);
+    if((direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+            || minConnections < 1 || maxConnections < minConnections || maxConnections > MAXCONNECTIONS)
+    {
+        return;
+    }
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    direction_t d = (direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT;
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_ADDITION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
+    sdkMutex.lock();
+    client->minconnections[d] = minConnections;
+    client->maxconnections[d] = maxConnections;
+
+    // initial count of new transfers
+    if(client->connections[d] < minConnections)
+    {
+        client->connections[d] = minConnections;
+    }
+    else if(client->connections[d] > maxConnections)
+    {
+        client->connections[d] = maxConnections;
+    }
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::syncupdate_remote_folder_deletion(Sync *sync, Node *n)
+void MegaApiImpl::setTransferLimits(int direction, int maxTransfers, long long maxBytesInFlight, int maxConnections)
 {
-    LOG_debug << "Sync - remote folder deletion detected " << n->displayname();
-    client->abortbackoff(false);
+    if((direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
+            || maxTransfers < 0 || maxBytesInFlight < 0 || maxConnections < 0)
+    {
+        return;
+    }
 
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    direction_t d = (direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT;
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_DELETION);
-    event->setNodeHandle(n->nodehandle);
-    fireOnSyncEvent(megaSync, event);
+    sdkMutex.lock();
+    client->maxtransfers[d] = maxTransfers;
+    client->maxinflight[d] = maxBytesInFlight;
+    client->maxxferconnections[d] = maxConnections;
+
+    // start more transfers right away if the limits were raised
+    client->dispatchmore(d);
+    sdkMutex.unlock();
+    waiter->notify();
 }
 
-void MegaApiImpl::syncupdate_remote_copy(Sync *, const char *name)
+void MegaApiImpl::setUploadNodeBatching(bool enable)
 {
-    LOG_debug << "Sync - creating remote file " << name << " by copying existing remote file";
-    client->abortbackoff(false);
+    sdkMutex.lock();
+    client->batchuploadnodes = enable;
+    if (!enable && client->numuploadnodes)
+    {
+        client->senduploadnodes();
+    }
+    sdkMutex.unlock();
+    waiter->notify();
 }
 
-void MegaApiImpl::syncupdate_remote_move(Sync *sync, Node *n, Node *prevparent)
+void MegaApiImpl::setUploadQueueLimit(int limit)
 {
-    LOG_debug << "Sync - remote move " << n->displayname() <<
-                 " from " << (prevparent ? prevparent->displayname() : "?") <<
-                 " to " << (n->parent ? n->parent->displayname() : "?");
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    if (limit < 0)
+    {
+        return;
+    }
 
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_MOVE);
-    event->setNodeHandle(n->nodehandle);
-    event->setPrevParent(prevparent ? prevparent->nodehandle : UNDEF);
-    fireOnSyncEvent(megaSync, event);
+    sdkMutex.lock();
+    uploadQueueLimit = limit;
+    sdkMutex.unlock();
+    waiter->notify();
 }
 
-void MegaApiImpl::syncupdate_remote_rename(Sync *sync, Node *n, const char *prevname)
+void MegaApiImpl::setPersistentTransferQueue(bool enable)
 {
-    LOG_debug << "Sync - remote rename from " << prevname << " to " << n->displayname();
-    client->abortbackoff(false);
-
-    if(syncMap.find(sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
-
-    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_RENAME);
-    event->setNodeHandle(n->nodehandle);
-    event->setPrevName(prevname);
-    fireOnSyncEvent(megaSync, event);
+    sdkMutex.lock();
+    persistTransfers = enable;
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::syncupdate_treestate(LocalNode *l)
+void MegaApiImpl::setDownloadWriteBuffer(long long maxBufferedBytes)
 {
-    string local;
-    string path;
-    l->getlocalpath(&local, true);
-    fsAccess->local2path(&local, &path);
-
-    if(syncMap.find(l->sync->tag) == syncMap.end()) return;
-    MegaSyncPrivate* megaSync = syncMap.at(l->sync->tag);
+    if (maxBufferedBytes < 0)
+    {
+        return;
+    }
 
-    fireOnFileSyncStateChanged(megaSync, path.data(), (int)l->ts);
+    sdkMutex.lock();
+    client->writebackmax = maxBufferedBytes;
+    sdkMutex.unlock();
 }
 
-bool MegaApiImpl::sync_syncable(Node *node)
+void MegaApiImpl::setBandwidthLimit(int direction, long long bytesPerSecond)
 {
-    if(node->type == FILENODE && !is_syncable(node->size))
+    if((direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD) || bytesPerSecond < 0)
     {
-        return false;
+        return;
     }
 
-    const char *name = node->displayname();
-    sdkMutex.unlock();
-    bool result = is_syncable(name);
     sdkMutex.lock();
-    return result;
+    client->httpio->shaper.setlimit((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT, bytesPerSecond);
+    sdkMutex.unlock();
 }
 
-bool MegaApiImpl::sync_syncable(const char *name, string *localpath, string *)
+void MegaApiImpl::setBandwidthClassLimit(int direction, int priority, long long bytesPerSecond)
 {
-    static FileAccess* f = fsAccess->newfileaccess();
-    if(f->fopen(localpath) && !is_syncable(f->size))
+    if((direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD) || bytesPerSecond < 0
+            || priority < MegaTransfer::PRIORITY_INTERACTIVE || priority > MegaTransfer::PRIORITY_BACKGROUND)
     {
-        return false;
+        return;
     }
 
-    sdkMutex.unlock();
-    bool result =  is_syncable(name);
     sdkMutex.lock();
-    return result;
+    client->httpio->shaper.setclasslimit((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT, priority, bytesPerSecond);
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::syncupdate_local_lockretry(bool waiting)
+void MegaApiImpl::addBandwidthSchedule(int direction, int startMinute, int endMinute, long long bytesPerSecond)
 {
-    if (waiting)
+    if((direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD) || bytesPerSecond < 0
+            || startMinute < 0 || startMinute >= 1440 || endMinute < 0 || endMinute > 1440)
     {
-        LOG_debug << "Sync - waiting for local filesystem lock";
-    }
-    else
-    {
-        LOG_debug << "Sync - local filesystem lock issue resolved, continuing...";
-        client->abortbackoff(false);
+        return;
     }
 
-    this->waiting = waiting;
-    this->fireOnGlobalSyncStateChanged();
+    sdkMutex.lock();
+    client->httpio->shaper.addschedule((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT, startMinute, endMinute, bytesPerSecond);
+    sdkMutex.unlock();
 }
-#endif
 
-
-// user addition/update (users never get deleted)
-void MegaApiImpl::users_updated(User** u, int count)
+void MegaApiImpl::clearBandwidthSchedules(int direction)
 {
-    if(!count)
+    if(direction != MegaTransfer::TYPE_DOWNLOAD && direction != MegaTransfer::TYPE_UPLOAD)
     {
         return;
     }
 
-    MegaUserList *userList = NULL;
-    if(u != NULL)
-    {
-        userList = new MegaUserListPrivate(u, count);
-        fireOnUsersUpdate(userList);
-    }
-    else
-    {
-        fireOnUsersUpdate(NULL);
-    }
-    delete userList;
+    sdkMutex.lock();
+    client->httpio->shaper.clearschedules((direction == MegaTransfer::TYPE_DOWNLOAD) ? GET : PUT);
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::account_updated()
+void MegaApiImpl::setNodeDecryptionThreads(int threads)
 {
-    fireOnAccountUpdate();
+    sdkMutex.lock();
+    delete decryptionRunner;
+    decryptionRunner = (threads > 1) ? new MegaThreadRunner(threads) : NULL;
+    client->workers = decryptionRunner ? (ParallelRunner *)decryptionRunner : threadPool;
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::pcrs_updated(PendingContactRequest **r, int count)
+void MegaApiImpl::setTransferCryptoThreads(int threads)
 {
-    if(!count)
-    {
-        return;
-    }
+    sdkMutex.lock();
+    delete cryptoRunner;
+    cryptoRunner = (threads > 1) ? new MegaThreadRunner(threads) : NULL;
+    client->cryptoworkers = cryptoRunner ? (ParallelRunner *)cryptoRunner : threadPool;
+    sdkMutex.unlock();
+}
 
-    MegaContactRequestList *requestList = NULL;
-    if(r != NULL)
-    {
-        requestList = new MegaContactRequestListPrivate(r, count);
-        fireOnContactRequestsUpdate(requestList);
-    }
-    else
-    {
-        fireOnContactRequestsUpdate(NULL);
-    }
-    delete requestList;
+void MegaApiImpl::setSyncScanThreads(int threads)
+{
+    sdkMutex.lock();
+    delete scanRunner;
+    scanRunner = (threads > 1) ? new MegaThreadRunner(threads) : NULL;
+    client->scanworkers = scanRunner;
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::setattr_result(handle h, error e)
+void MegaApiImpl::setWorkerThreads(int threads)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if (!request || ((request->getType() != MegaRequest::TYPE_RENAME)
-            && request->getType() != MegaRequest::TYPE_SET_ATTR_NODE))
+    sdkMutex.lock();
+    delete threadPool;
+    threadPool = NULL;
+
+    if (threads > 0)
     {
-        return;
+        Thread **workers = new Thread*[threads];
+        Mutex **mutexes = new Mutex*[threads];
+
+        for (int i = 0; i < threads; i++)
+        {
+            workers[i] = new MegaThread;
+            mutexes[i] = new MegaMutex;
+        }
+
+        threadPool = new ThreadPool(threads, workers, mutexes, new MegaMutex, new MegaSemaphore, new MegaSemaphore, waiter);
+
+        delete [] workers;
+        delete [] mutexes;
     }
 
-	request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
+    client->threadpool = threadPool;
+    client->workers = decryptionRunner ? (ParallelRunner *)decryptionRunner : threadPool;
+    client->cryptoworkers = cryptoRunner ? (ParallelRunner *)cryptoRunner : threadPool;
+    client->scanworkers = scanRunner ? (ParallelRunner *)scanRunner : threadPool;
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::rename_result(handle h, error e)
+void MegaApiImpl::setNodeUpdateCoalescing(int milliseconds, int maxBatchSize)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_MOVE)) return;
+    sdkMutex.lock();
+    nodeUpdateWindow = (milliseconds > 0) ? (milliseconds + 99) / 100 : 0;
+    nodeUpdateMaxBatch = (maxBatchSize > 0) ? maxBatchSize : 0;
 
-    request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
+    if (!nodeUpdateWindow)
+    {
+        flushNodeUpdates();
+    }
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::unlink_result(handle h, error e)
+void MegaApiImpl::setTransferUpdateInterval(int ms)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_REMOVE)) return;
+    sdkMutex.lock();
+    transferUpdateInterval = (ms > 0) ? (ms + 99) / 100 : 1;
+    sdkMutex.unlock();
+}
 
-    request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
+void MegaApiImpl::setTransfersProgressInterval(int ms)
+{
+    sdkMutex.lock();
+    transfersProgressInterval = (ms > 0) ? (ms + 99) / 100 : 0;
+    transfersProgressDeadline = (transfersProgressInterval && !transferMap.empty()) ? Waiter::ds + transfersProgressInterval : NEVER;
+    updateAppWakeup();
+    sdkMutex.unlock();
+    waiter->notify();
 }
 
-void MegaApiImpl::fetchnodes_result(error e)
+void MegaApiImpl::enableNameIndex(bool enable)
 {
-    MegaError megaError(e);
-    MegaRequestPrivate* request;
-    if (!client->restag)
+    sdkMutex.lock();
+    if (enable && !nameIndex)
     {
-        request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES);
-        fireOnRequestFinish(request, megaError);
-        return;
+        nameIndex = new MegaNameIndex();
+        if (client->nodebyhandle(client->rootnodes[0]))
+        {
+            buildNameIndex();
+        }
     }
-
-    if (requestMap.find(client->restag) == requestMap.end())
+    else if (!enable && nameIndex)
     {
-        return;
+        nameIndex->clear(true);
+        delete nameIndex;
+        nameIndex = NULL;
     }
-    request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_FETCH_NODES))
+    sdkMutex.unlock();
+}
+
+bool MegaApiImpl::isNameIndexEnabled()
+{
+    return nameIndex != NULL;
+}
+
+// the scsn the client state corresponds to (see MegaClient::notifypurge)
+handle MegaApiImpl::currentScsn()
+{
+    handle scsn = client->cachedscsn;
+
+    if (*client->scsn)
     {
-        return;
+        Base64::atob(client->scsn, (byte*)&scsn, sizeof scsn);
     }
 
-    fireOnRequestFinish(request, megaError);
+    return scsn;
 }
 
-void MegaApiImpl::putnodes_result(error e, targettype_t t, NewNode* nn)
+void MegaApiImpl::buildNameIndex()
 {
-    handle h = UNDEF;
-    Node *n = NULL;
+    handle scsn = currentScsn();
+    bool loaded = false;
+    string dbname;
 
-    if(!e && t != USER_HANDLE)
+    nameIndex->clear();
+
+    if (client->dbaccess && client->sctablename(&dbname))
     {
-        if(client->nodenotify.size())
-        {
-            n = client->nodenotify.back();
-        }
+        dbname.append("_names");
 
-        if(n)
+        DbTable *table = client->dbaccess->open(client->fsaccess, &dbname);
+        if (table)
         {
-            n->applykey();
-            n->setattr();
-            h = n->nodehandle;
+            loaded = nameIndex->open(table, &client->key, scsn);
         }
     }
 
-	MegaError megaError(e);
-    if(transferMap.find(client->restag) != transferMap.end())
+    // a saved index only lacks nodes that are not in it at all, as it is
+    // only loaded if it matches the cached state
+    nameIndex->beginBuild();
+    for (node_map::iterator it = client->nodes.begin(); it != client->nodes.end(); it++)
     {
-        MegaTransferPrivate* transfer = transferMap.at(client->restag);
-        if(transfer->getType() == MegaTransfer::TYPE_DOWNLOAD)
-        {
-            return;
-        }
-
-        if(pendingUploads > 0)
+        if (!loaded || !nameIndex->contains(it->first))
         {
-            pendingUploads--;
+            nameIndex->add(it->second);
         }
+    }
+    nameIndex->endBuild();
 
-        transfer->setNodeHandle(h);
-        fireOnTransferFinish(transfer, megaError);
-        delete [] nn;
-        return;
+    if (loaded)
+    {
+        nameIndex->prune(&client->nodes);
     }
 
-	if(requestMap.find(client->restag) == requestMap.end()) return;
-	MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_CREATE_FOLDER) &&
-                    (request->getType() != MegaRequest::TYPE_COPY))) return;
+    nameIndex->flush(scsn);
 
-	request->setNodeHandle(h);
-    fireOnRequestFinish(request, megaError);
-	delete [] nn;
+    LOG_debug << "Name index " << (loaded ? "loaded" : "built") << " with " << nameIndex->size() << " names";
 }
 
-void MegaApiImpl::share_result(error e)
+void MegaApiImpl::setDownloadMethod(int method)
 {
-	MegaError megaError(e);
-
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_EXPORT) &&
-                    (request->getType() != MegaRequest::TYPE_SHARE))) return;
-
-    //exportnode_result will be called to end the request.
-	if(request->getType() == MegaRequest::TYPE_EXPORT)
-		return;
-
-    fireOnRequestFinish(request, megaError);
+    switch(method)
+    {
+        case MegaApi::TRANSFER_METHOD_NORMAL:
+            client->usealtdownport = false;
+            client->autodownport = false;
+            break;
+        case MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT:
+            client->usealtdownport = true;
+            client->autodownport = false;
+            break;
+        case MegaApi::TRANSFER_METHOD_AUTO:
+            client->autodownport = true;
+            break;
+        case MegaApi::TRANSFER_METHOD_AUTO_NORMAL:
+            client->usealtdownport = false;
+            client->autodownport = true;
+            break;
+        case MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE:
+            client->usealtdownport = true;
+            client->autodownport = true;
+            break;
+        default:
+            break;
+    }
 }
 
-void MegaApiImpl::share_result(int, error)
+bool MegaApiImpl::setHttp2(bool enable)
 {
-    //The other callback will be called at the end of the request
+    return httpio->sethttp2(enable);
 }
 
-void MegaApiImpl::setpcr_result(handle h, error e, opcactions_t action)
+bool MegaApiImpl::setRequestCompression(bool enable)
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_INVITE_CONTACT) return;
+    sdkMutex.lock();
+    bool result = httpio->setcompression(enable);
+    sdkMutex.unlock();
 
-    if (e)
+    return result;
+}
+
+void MegaApiImpl::setCallbackThread(bool enable, int maxPending)
+{
+    sdkMutex.lock();
+    if (enable)
     {
-        LOG_debug << "Outgoing pending contact request failed (" << megaError.getErrorString() << ")";
+        callbackExecutor->start(maxPending);
     }
     else
     {
-        if (h == UNDEF)
-        {
-            // must have been deleted
-            LOG_debug << "Outgoing pending contact request " << (action == OPCA_DELETE ? "deleted" : "reminded") << " successfully";
-        }
-        else
-        {
-            char buffer[12];
-            Base64::btoa((byte*)&h, sizeof(h), buffer);
-            LOG_debug << "Outgoing pending contact request succeeded, id: " << buffer;
-        }
+        callbackExecutor->disable();
     }
+    sdkMutex.unlock();
 
-    request->setNodeHandle(h);
-    request->setNumber(action);
-    fireOnRequestFinish(request, megaError);
+    // deliver what was queued (listeners may need the SDK mutex)
+    if (!enable)
+    {
+        callbackExecutor->stop();
+    }
 }
 
-void MegaApiImpl::updatepcr_result(error e, ipcactions_t action)
+long long MegaApiImpl::getCallbackStats(int type)
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_REPLY_CONTACT_REQUEST) return;
+    return callbackExecutor->getStats(type);
+}
 
-    if (e)
-    {
-        LOG_debug << "Incoming pending contact request update failed (" << megaError.getErrorString() << ")";
-    }
-    else
+long long MegaApiImpl::getCompressionStats(int type)
+{
+    long long result;
+
+    sdkMutex.lock();
+    switch (type)
     {
-        string labels[3] = {"accepted", "denied", "ignored"};
-        LOG_debug << "Incoming pending contact request successfully " << labels[(int)action];
+        case MegaApi::COMPRESSION_STATS_SENT_SAVED:
+            result = httpio->compressionsavedout;
+            break;
+        case MegaApi::COMPRESSION_STATS_RECEIVED_SAVED:
+            result = httpio->compressionsavedin;
+            break;
+        default:
+            result = -1;
     }
+    sdkMutex.unlock();
 
-    request->setNumber(action);
-    fireOnRequestFinish(request, megaError);
+    return result;
 }
 
-void MegaApiImpl::fa_complete(Node* n, fatype type, const char* data, uint32_t len)
+char *MegaApiImpl::getStorageHostStats()
 {
-    int tag = client->restag;
-    while(tag)
-    {
-        if(requestMap.find(tag) == requestMap.end()) return;
-        MegaRequestPrivate* request = requestMap.at(tag);
-        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE)) return;
+    string json;
 
-        tag = request->getNumber();
+    sdkMutex.lock();
+    client->hoststats.getjson(&json);
+    sdkMutex.unlock();
 
-        FileAccess *f = client->fsaccess->newfileaccess();
-        string filePath(request->getFile());
-        string localPath;
-        fsAccess->path2local(&filePath, &localPath);
+    return MegaApi::strdup(json.c_str());
+}
 
-        totalDownloadedBytes += len;
+char *MegaApiImpl::getMetrics()
+{
+    string text;
 
-        fsAccess->unlinklocal(&localPath);
-        if(!f->fopen(&localPath, false, true))
-        {
-            delete f;
-            fireOnRequestFinish(request, MegaError(API_EWRITE));
-            continue;
-        }
+    sdkMutex.lock();
+    client->metrics.set(Metrics::QUEUE_DEPTH, "callbacks", (double)callbackExecutor->getStats(MegaApi::CALLBACK_STATS_QUEUED));
+    client->getmetrics(&text);
+    sdkMutex.unlock();
 
-        if(!f->fwrite((const byte*)data, len, 0))
-        {
-            delete f;
-            fireOnRequestFinish(request, MegaError(API_EWRITE));
-            continue;
-        }
+    return MegaApi::strdup(text.c_str());
+}
 
-        delete f;
-        fireOnRequestFinish(request, MegaError(API_OK));
+void MegaApiImpl::setTracing(bool enable, int maxEvents)
+{
+    sdkMutex.lock();
+    if (enable)
+    {
+        client->tracer.enable(maxEvents > 0 ? maxEvents : 1);
+    }
+    else
+    {
+        client->tracer.disable();
     }
+    sdkMutex.unlock();
 }
 
-int MegaApiImpl::fa_failed(handle, fatype, int retries, error e)
+char *MegaApiImpl::getTrace()
 {
-    int tag = client->restag;
-    while(tag)
+    string json;
+
+    sdkMutex.lock();
+    client->tracer.getjson(&json);
+    sdkMutex.unlock();
+
+    return MegaApi::strdup(json.c_str());
+}
+
+void MegaApiImpl::setWatchdog(int thresholdMs)
+{
+    sdkMutex.lock();
+    client->tracer.setwatchdog(&client->metrics, thresholdMs);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setUploadMethod(int method)
+{
+    switch(method)
     {
-        if(requestMap.find(tag) == requestMap.end()) return 1;
-        MegaRequestPrivate* request = requestMap.at(tag);
-        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE))
-            return 1;
+        case MegaApi::TRANSFER_METHOD_NORMAL:
+            client->usealtupport = false;
+            client->autoupport = false;
+            break;
+        case MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT:
+            client->usealtupport = true;
+            client->autoupport = false;
+            break;
+        case MegaApi::TRANSFER_METHOD_AUTO:
+            client->autoupport = true;
+            break;
+        case MegaApi::TRANSFER_METHOD_AUTO_NORMAL:
+            client->usealtupport = false;
+            client->autoupport = true;
+            break;
+        case MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE:
+            client->usealtupport = true;
+            client->autoupport = true;
+            break;
+        default:
+            break;
+    }
+}
 
-        tag = request->getNumber();
-        if(retries >= 2)
+int MegaApiImpl::getDownloadMethod()
+{
+    if (client->autodownport)
+    {
+        if(client->usealtdownport)
         {
-            fireOnRequestFinish(request, MegaError(e));
+            return MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE;
         }
         else
         {
-            fireOnRequestTemporaryError(request, MegaError(e));
+            return MegaApi::TRANSFER_METHOD_AUTO_NORMAL;
         }
     }
 
-    return (retries >= 2);
+    if (client->usealtdownport)
+    {
+        return MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT;
+    }
+
+    return MegaApi::TRANSFER_METHOD_NORMAL;
 }
 
-void MegaApiImpl::putfa_result(handle, fatype, error e)
+int MegaApiImpl::getUploadMethod()
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
-        return;
+    if (client->autoupport)
+    {
+        if(client->usealtupport)
+        {
+            return MegaApi::TRANSFER_METHOD_AUTO_ALTERNATIVE;
+        }
+        else
+        {
+            return MegaApi::TRANSFER_METHOD_AUTO_NORMAL;
+        }
+    }
 
-    fireOnRequestFinish(request, megaError);
+    if (client->usealtupport)
+    {
+        return MegaApi::TRANSFER_METHOD_ALTERNATIVE_PORT;
+    }
+
+    return MegaApi::TRANSFER_METHOD_NORMAL;
 }
 
-void MegaApiImpl::putfa_result(handle, fatype, const char *)
+MegaTransferList *MegaApiImpl::getTransfers()
 {
-    MegaError megaError(API_OK);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
-        return;
+    bool exclusive = lockRead();
 
-    fireOnRequestFinish(request, megaError);
+    vector<MegaTransfer *> transfers;
+    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    {
+        for (transfer_map::iterator it = client->transfers[d].begin(); it != client->transfers[d].end(); it++)
+        {
+            Transfer *t = it->second;
+            if(transferMap.find(t->tag) == transferMap.end())
+            {
+                continue;
+            }
+            MegaTransferPrivate* transfer = transferMap.at(t->tag);
+            transfers.push_back(transfer);
+        }
+    }
+
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::enumeratequotaitems_result(handle product, unsigned prolevel, unsigned gbstorage, unsigned gbtransfer, unsigned months, unsigned amount, const char* currency, const char* description, const char* iosid, const char* androidid)
+MegaTransfer *MegaApiImpl::getTransferByTag(int transferTag)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
-                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
+    MegaTransfer* value = NULL;
+    bool exclusive = lockRead();
+
+    if(transferMap.find(transferTag) == transferMap.end())
     {
-        return;
+        unlockRead(exclusive);
+        return NULL;
     }
 
-    request->addProduct(product, prolevel, gbstorage, gbtransfer, months, amount, currency, description, iosid, androidid);
+    value = transferMap.at(transferTag)->copy();
+    unlockRead(exclusive);
+    return value;
 }
 
-void MegaApiImpl::enumeratequotaitems_result(error e)
+MegaTransferList *MegaApiImpl::getTransfers(int type)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
-                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
+    if(type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD)
     {
-        return;
+        return new MegaTransferListPrivate();
     }
 
-    if(request->getType() == MegaRequest::TYPE_GET_PRICING)
-    {
-        fireOnRequestFinish(request, MegaError(e));
-    }
-    else
-    {
-        MegaPricing *pricing = request->getPricing();
-        int i;
-        for(i = 0; i < pricing->getNumProducts(); i++)
-        {
-            if(pricing->getHandle(i) == request->getNodeHandle())
-            {
-                requestMap.erase(request->getTag());
-                int nextTag = client->nextreqtag();
-                request->setTag(nextTag);
-                requestMap[nextTag]=request;
-                client->purchase_additem(0, request->getNodeHandle(), pricing->getAmount(i),
-                                         pricing->getCurrency(i), 0, NULL, NULL);
-                break;
-            }
-        }
+    bool exclusive = lockRead();
 
-        if(i == pricing->getNumProducts())
+    vector<MegaTransfer *> transfers;
+    for (transfer_map::iterator it = client->transfers[type].begin(); it != client->transfers[type].end(); it++)
+    {
+        Transfer *t = it->second;
+        if(transferMap.find(t->tag) == transferMap.end())
         {
-            fireOnRequestFinish(request, MegaError(API_ENOENT));
+            continue;
         }
-        delete pricing;
+        MegaTransferPrivate* transfer = transferMap.at(t->tag);
+        transfers.push_back(transfer);
     }
+
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::additem_result(error e)
+// transfers of the engine in order of tag, type -1 for both
+MegaTransferList *MegaApiImpl::getTransfers(int type, int fromTag, int limit)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
-                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT))) return;
-
-    if(e != API_OK)
+    if ((type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD && type != -1) || limit <= 0)
     {
-        client->purchase_begin();
-        fireOnRequestFinish(request, MegaError(e));
-        return;
+        return new MegaTransferListPrivate();
     }
 
-    if(request->getType() == MegaRequest::TYPE_GET_PAYMENT_ID)
+    bool exclusive = lockRead();
+
+    vector<MegaTransfer *> transfers;
+    for (map<int, MegaTransferPrivate *>::iterator it = transferMap.upper_bound(fromTag); it != transferMap.end() && (int)transfers.size() < limit; it++)
     {
-        char saleid[16];
-        Base64::btoa((byte *)&client->purchase_basket.back(), 8, saleid);
-        request->setLink(saleid);
-        client->purchase_begin();
-        fireOnRequestFinish(request, MegaError(API_OK));
-        return;
+        MegaTransferPrivate *transfer = it->second;
+        if (transfer->getTransfer() && (type == -1 || transfer->getType() == type))
+        {
+            transfers.push_back(transfer);
+        }
     }
 
-    //MegaRequest::TYPE_UPGRADE_ACCOUNT
-    int method = request->getNumber();
-    client->purchase_checkout(method);
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
+
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::checkout_result(const char *errortype, error e)
+int MegaApiImpl::getNumTransfers(int type)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)) return;
+    if (type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD)
+    {
+        return 0;
+    }
 
-    if(!errortype)
+    bool exclusive = lockRead();
+    int result = (int)client->transfers[type].size();
+    unlockRead(exclusive);
+    return result;
+}
+
+int MegaApiImpl::getNumTransfersInProgress(int type)
+{
+    if (type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD)
     {
-        fireOnRequestFinish(request, MegaError(e));
-        return;
+        return 0;
     }
 
-    if(!strcmp(errortype, "FP"))
+    bool exclusive = lockRead();
+
+    int result = 0;
+    for (transferslot_list::iterator it = client->tslots.begin(); it != client->tslots.end(); it++)
     {
-        fireOnRequestFinish(request, MegaError(e - 100));
-        return;
+        if ((*it)->transfer->type == type)
+        {
+            result++;
+        }
     }
 
-    fireOnRequestFinish(request, MegaError(MegaError::PAYMENT_EGENERIC));
-    return;
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::submitpurchasereceipt_result(error e)
+long long MegaApiImpl::getTransfersSequence()
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT)) return;
-
-    fireOnRequestFinish(request, MegaError(e));
+    bool exclusive = lockRead();
+    long long result = transferSequence;
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::creditcardquerysubscriptions_result(int number, error e)
+// transfers of the engine in order of their last change
+MegaTransferList *MegaApiImpl::getTransfersChangedSince(long long sequence)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS)) return;
-
-    request->setNumber(number);
-    fireOnRequestFinish(request, MegaError(e));
-}
+    bool exclusive = lockRead();
 
-void MegaApiImpl::creditcardcancelsubscriptions_result(error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS)) return;
-
-    fireOnRequestFinish(request, MegaError(e));
-}
-void MegaApiImpl::getpaymentmethods_result(int methods, error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_PAYMENT_METHODS)) return;
-
-    request->setNumber(methods);
-    fireOnRequestFinish(request, MegaError(e));
-}
-
-void MegaApiImpl::userfeedbackstore_result(error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_FEEDBACK)) return;
-
-    fireOnRequestFinish(request, MegaError(e));
-}
-
-void MegaApiImpl::sendevent_result(error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SEND_EVENT)) return;
-
-    fireOnRequestFinish(request, MegaError(e));
-}
+    vector<MegaTransfer *> transfers;
+    for (map<long long, int>::iterator it = transferChanges.upper_bound(sequence); it != transferChanges.end(); it++)
+    {
+        map<int, MegaTransferPrivate *>::iterator t = transferMap.find(it->second);
+        if (t != transferMap.end() && t->second->getTransfer())
+        {
+            transfers.push_back(t->second);
+        }
+    }
 
-void MegaApiImpl::creditcardstore_result(error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_STORE)) return;
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
 
-    fireOnRequestFinish(request, MegaError(e));
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::copysession_result(string *session, error e)
+MegaTransferList *MegaApiImpl::getChildTransfers(int transferTag)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_SESSION_TRANSFER_URL)) return;
+    bool exclusive = lockRead();
 
-    const char *path = request->getText();
-    string *data = NULL;
-    if(e == API_OK)
+    if(transferMap.find(transferTag) == transferMap.end())
     {
-        data = client->sessiontransferdata(path, session);
+        unlockRead(exclusive);
+        return new MegaTransferListPrivate();
     }
 
-    if(data)
+    MegaTransfer *transfer = transferMap.at(transferTag);
+    if(!transfer->isFolderTransfer())
     {
-        data->insert(0, "https://mega.nz/#sitetransfer!");
+        unlockRead(exclusive);
+        return new MegaTransferListPrivate();
     }
-    else
+
+    vector<MegaTransfer *> transfers;
+    for(std::map<int, MegaTransferPrivate *>::iterator it = transferMap.begin(); it != transferMap.end(); it++)
     {
-        data = new string("https://mega.nz/#");
-        if(path)
+        MegaTransferPrivate *t = it->second;
+        if(t->getFolderTransferTag() == transferTag)
         {
-            data->append(path);
+            transfers.push_back(transfer);
         }
     }
 
-    request->setLink(data->c_str());
-    delete data;
-
-    fireOnRequestFinish(request, MegaError(e));
-}
-
-void MegaApiImpl::clearing()
-{
+    MegaTransferList *result = new MegaTransferListPrivate(transfers.data(), transfers.size());
 
+    unlockRead(exclusive);
+    return result;
 }
 
-void MegaApiImpl::notify_retry(dstime dsdelta)
+void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, const char *fileName, int64_t mtime, int folderTransferTag, MegaTransferListener *listener)
 {
-#ifdef ENABLE_SYNC
-    bool previousFlag = waitingRequest;
-#endif
-
-    if(!dsdelta)
-        waitingRequest = false;
-    else if(dsdelta > 10)
-        waitingRequest = true;
-
-#ifdef ENABLE_SYNC
-    if(previousFlag != waitingRequest)
-        fireOnGlobalSyncStateChanged();
-#endif
+    MegaTransferPrivate* transfer = createUpload(localPath, parent ? parent->getHandle() : INVALID_HANDLE,
+                                                 fileName, mtime, folderTransferTag, listener);
+	if (transferQueue.push(transfer))
+	{
+	    waiter->notify();
+	}
 }
 
-// callback for non-EAGAIN request-level errors
-// retrying is futile
-// this can occur e.g. with syntactically malformed requests (due to a bug) or due to an invalid application key
-void MegaApiImpl::request_error(error e)
+void MegaApiImpl::startUploadWithFingerprint(const char *localPath, MegaNode *parent, const char *fingerprint, const char *fileName, int64_t mtime, MegaTransferListener *listener)
 {
-    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT);
-    request->setFlag(false);
-    request->setParamType(e);
+    MegaTransferPrivate* transfer = createUpload(localPath, parent ? parent->getHandle() : INVALID_HANDLE,
+                                                 fileName, mtime, 0, listener);
 
-    if (e == API_ESSL && client->sslfakeissuer.size())
+    // an unparsable fingerprint just means that the file is read as usual
+    FileFingerprint fp;
+    if (parseFingerprint(fingerprint, &fp))
     {
-        request->setText(client->sslfakeissuer.c_str());
+        transfer->setKnownFingerprint(&fp);
     }
 
-    requestQueue.push(request);
-    waiter->notify();
-}
-
-void MegaApiImpl::request_response_progress(m_off_t currentProgress, m_off_t totalProgress)
-{
-    if(requestMap.size() == 1)
+    if (transferQueue.push(transfer))
     {
-        MegaRequestPrivate *request = requestMap.begin()->second;
-        if(request && request->getType() == MegaRequest::TYPE_FETCH_NODES)
-        {
-            if(request->getTransferredBytes() != currentProgress)
-            {
-                request->setTransferredBytes(currentProgress);
-                if(totalProgress != -1)
-                {
-                    request->setTotalBytes(totalProgress);
-                }
-                fireOnRequestUpdate(request);
-            }
-        }
+        waiter->notify();
     }
 }
 
-// login result
-void MegaApiImpl::login_result(error result)
+void MegaApiImpl::startUploads(MegaUploadBatch *uploads, bool copyDuplicates, MegaTransferListener *listener)
 {
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_LOGIN)) return;
-
-    fireOnRequestFinish(request, megaError);
-}
+    if (!uploads || !uploads->size())
+    {
+        return;
+    }
 
-void MegaApiImpl::logout_result(error e)
-{
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_LOGOUT)) return;
+    UploadBatch *batch = new UploadBatch;
+    batch->copyDuplicates = copyDuplicates;
+    batch->transfers.reserve(uploads->size());
 
-    if(!e)
+    for (int i = 0; i < uploads->size(); i++)
     {
-        requestMap.erase(request->getTag());
-
-        error preverror = (error)request->getParamType();
-        while(!requestMap.empty())
-        {
-            std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-            if(it->second) fireOnRequestFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
-        }
+        batch->transfers.push_back(createUpload(uploads->getLocalPath(i), uploads->getParentHandle(i),
+                                                uploads->getFileName(i), uploads->getTime(i), 0, listener));
 
-        while(!transferMap.empty())
+        FileFingerprint fp;
+        if (parseFingerprint(uploads->getFingerprint(i), &fp))
         {
-            std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
-            if(it->second) fireOnTransferFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
+            batch->transfers.back()->setKnownFingerprint(&fp);
         }
-
-        pendingUploads = 0;
-        pendingDownloads = 0;
-        totalUploads = 0;
-        totalDownloads = 0;
-        waiting = false;
-        waitingRequest = false;
-        excludedNames.clear();
-        syncLowerSizeLimit = 0;
-        syncUpperSizeLimit = 0;
-        uploadSpeed = 0;
-        downloadSpeed = 0;
-        downloadTimes.clear();
-        downloadBytes.clear();
-        uploadTimes.clear();
-        uploadBytes.clear();
-        uploadPartialBytes = 0;
-        downloadPartialBytes = 0;
-
-        fireOnRequestFinish(request, MegaError(preverror));
-        return;
     }
-    fireOnRequestFinish(request,MegaError(e));
-}
-
-void MegaApiImpl::userdata_result(string *name, string* pubk, string* privk, handle bjid, error result)
-{
-    MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
 
-    if(result == API_OK)
+    if (uploadBatchQueue.push(batch))
     {
-        char jid[16];
-        Base32::btoa((byte *)&bjid, MegaClient::USERHANDLE, jid);
-
-        request->setPassword(pubk->c_str());
-        request->setPrivateKey(privk->c_str());
-        request->setName(name->c_str());
-        request->setText(jid);
+        waiter->notify();
     }
-    fireOnRequestFinish(request, megaError);
 }
 
-void MegaApiImpl::pubkey_result(User *u)
+MegaTransferPrivate *MegaApiImpl::createUpload(const char *localPath, MegaHandle parentHandle, const char *fileName, int64_t mtime, int folderTransferTag, MegaTransferListener *listener)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
-
-    if(!u)
+    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, listener);
+    if(localPath)
     {
-        fireOnRequestFinish(request, MegaError(API_ENOENT));
-        return;
+        string path(localPath);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
+        transfer->setPath(path.data());
     }
 
-    if(!u->pubk.isvalid())
+    if(parentHandle != INVALID_HANDLE)
     {
-        fireOnRequestFinish(request, MegaError(API_EACCESS));
-        return;
+        transfer->setParentHandle(parentHandle);
     }
 
-    string key;
-    u->pubk.serializekey(&key, AsymmCipher::PUBKEY);
-    char pubkbuf[AsymmCipher::MAXKEYLENGTH * 4 / 3 + 4];
-    Base64::btoa((byte *)key.data(), key.size(), pubkbuf);
-    request->setPassword(pubkbuf);
+    transfer->setMaxRetries(maxRetries);
 
-    char jid[16];
-    Base32::btoa((byte *)&u->userhandle, MegaClient::USERHANDLE, jid);
-    request->setText(jid);
+    if(fileName)
+    {
+        transfer->setFileName(fileName);
+    }
 
-    if(u->email.size())
+    transfer->setTime(mtime);
+
+    if(folderTransferTag)
     {
-        request->setEmail(u->email.c_str());
+        transfer->setFolderTransferTag(folderTransferTag);
     }
 
-    fireOnRequestFinish(request, MegaError(API_OK));
+    return transfer;
 }
 
-// password change result
-void MegaApiImpl::changepw_result(error result)
-{
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_CHANGE_PW) return;
+void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, MegaTransferListener *listener)
+{ return startUpload(localPath, parent, (const char *)NULL, -1, 0, listener); }
 
-    fireOnRequestFinish(request, megaError);
-}
+void MegaApiImpl::startUpload(const char *localPath, MegaNode *parent, int64_t mtime, MegaTransferListener *listener)
+{ return startUpload(localPath, parent, (const char *)NULL, mtime, 0, listener); }
 
-// node export failed
-void MegaApiImpl::exportnode_result(error result)
+void MegaApiImpl::startUpload(const char* localPath, MegaNode* parent, const char* fileName, MegaTransferListener *listener)
+{ return startUpload(localPath, parent, fileName, -1, 0, listener); }
+
+void MegaApiImpl::startDownload(MegaNode *node, const char* localPath, long startPos, long endPos, MegaTransferListener *listener)
 {
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
 
-    fireOnRequestFinish(request, megaError);
-}
+    if(localPath)
+    {
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        string path(localPath);
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+        localPath = path.data();
+#endif
 
-void MegaApiImpl::exportnode_result(handle h, handle ph)
-{
-    Node* n;
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+        int c = localPath[strlen(localPath)-1];
+        if((c=='/') || (c == '\\')) transfer->setParentPath(localPath);
+        else transfer->setPath(localPath);
+    }
 
-    if ((n = client->nodebyhandle(h)))
+    if(node)
     {
-        char node[9];
-        char key[FILENODEKEYLENGTH*4/3+3];
+        transfer->setNodeHandle(node->getHandle());
+        if(node->isPublic())
+            transfer->setPublicNode(node);
+    }
+	transfer->setStartPos(startPos);
+	transfer->setEndPos(endPos);
+	transfer->setMaxRetries(maxRetries);
 
-        Base64::btoa((byte*)&ph,MegaClient::NODEHANDLE,node);
+	if (transferQueue.push(transfer))
+	{
+	    waiter->notify();
+	}
+}
 
-        // the key
-        if (n->type == FILENODE)
-        {
-            if(n->nodekey.size()>=FILENODEKEYLENGTH)
-                Base64::btoa((const byte*)n->nodekey.data(),FILENODEKEYLENGTH,key);
-            else
-                key[0]=0;
-        }
-        else if (n->sharekey) Base64::btoa(n->sharekey->key,FOLDERNODEKEYLENGTH,key);
-        else
-        {
-            fireOnRequestFinish(request, MegaError(MegaError::API_EKEY));
-            return;
-        }
+void MegaApiImpl::startDownload(MegaNode *node, const char* localFolder, MegaTransferListener *listener)
+{ startDownload(node, localFolder, 0, 0, listener); }
 
-        string link = "https://mega.nz/#";
-        link += (n->type ? "F" : "");
-        link += "!";
-        link += node;
-        link += "!";
-        link += key;
-        request->setLink(link.c_str());
-        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+// files of a folder upload (see MegaFolderUploadController)
+void MegaApiImpl::startUploads(UploadBatch *batch)
+{
+    for (size_t i = 0; i < batch->transfers.size(); i++)
+    {
+        batch->transfers[i]->setMaxRetries(maxRetries);
     }
-    else
+
+    if (uploadBatchQueue.push(batch))
     {
-        request->setNodeHandle(UNDEF);
-        fireOnRequestFinish(request, MegaError(MegaError::API_ENOENT));
+        waiter->notify();
     }
 }
 
-// the requested link could not be opened
-void MegaApiImpl::openfilelink_result(error result)
+// files of a folder download (see MegaFolderDownloadController)
+void MegaApiImpl::startDownload(MegaHandle nodeHandle, const char *parentPath, int folderTransferTag, MegaTransferListener *listener)
 {
-	MegaError megaError(result);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
+    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
+    transfer->setParentPath(parentPath);
+    transfer->setNodeHandle(nodeHandle);
+    transfer->setFolderTransferTag(folderTransferTag);
+    transfer->setMaxRetries(maxRetries);
 
-    fireOnRequestFinish(request, megaError);
+    if (transferQueue.push(transfer))
+    {
+        waiter->notify();
+    }
 }
 
-// the requested link was opened successfully
-// (it is the application's responsibility to delete n!)
-void MegaApiImpl::openfilelink_result(handle ph, const byte* key, m_off_t size, string* a, string*, int)
+void MegaApiImpl::cancelTransfer(MegaTransfer *t, MegaRequestListener *listener)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
-
-	if (!client->loggedin() && (request->getType() == MegaRequest::TYPE_IMPORT_LINK))
-	{
-        fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
-		return;
-	}
-
-    string attrstring;
-    string fileName;
-    string keystring;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
+    if(t)
+    {
+        request->setTransferTag(t->getTag());
+    }
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    attrstring.resize(a->length()*4/3+4);
-    attrstring.resize(Base64::btoa((const byte *)a->data(),a->length(), (char *)attrstring.data()));
+void MegaApiImpl::cancelTransferByTag(int transferTag, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFER, listener);
+    request->setTransferTag(transferTag);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    m_time_t mtime = 0;
+void MegaApiImpl::setTransferPriority(int transferTag, int priority, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_SET_TRANSFER_PRIORITY, listener);
+    request->setTransferTag(transferTag);
+    request->setNumber(priority);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    SymmCipher nodeKey;
-    keystring.assign((char*)key,FILENODEKEYLENGTH);
-    nodeKey.setkey(key, FILENODE);
+void MegaApiImpl::moveTransferToFirst(int transferTag, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE_TRANSFER, listener);
+    request->setTransferTag(transferTag);
+    request->setFlag(true);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-    byte *buf = Node::decryptattr(&nodeKey,attrstring.c_str(),attrstring.size());
-    if(buf)
+void MegaApiImpl::moveTransferToLast(int transferTag, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE_TRANSFER, listener);
+    request->setTransferTag(transferTag);
+    request->setFlag(false);
+    request->setNumber(0);
+    if (requestQueue.push(request))
     {
-        JSON json;
-        nameid name;
-        string* t;
-        AttrMap attrs;
+        waiter->notify();
+    }
+}
 
-        json.begin((char*)buf+5);
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
-            JSON::unescape(t);
+void MegaApiImpl::moveTransferBefore(int transferTag, int nextTransferTag, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_MOVE_TRANSFER, listener);
+    request->setTransferTag(transferTag);
+    request->setFlag(false);
+    request->setNumber(nextTransferTag);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-        delete[] buf;
+void MegaApiImpl::cancelTransfers(int direction, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_CANCEL_TRANSFERS, listener);
+    request->setParamType(direction);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
-        attr_map::iterator it;
-        it = attrs.map.find('n');
-        if (it == attrs.map.end()) fileName = "CRYPTO_ERROR";
-        else if (!it->second.size()) fileName = "BLANK";
-        else fileName = it->second.c_str();
+void MegaApiImpl::startDownloadToStream(MegaNode *node, MegaOutputStream *stream, MegaTransferListener *listener)
+{
+    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
 
-        it = attrs.map.find('c');
-        if(it != attrs.map.end())
+    if (node)
+    {
+        transfer->setNodeHandle(node->getHandle());
+        if (node->isPublic())
         {
-            FileFingerprint ffp;
-            if(ffp.unserializefingerprint(&it->second))
-            {
-                mtime = ffp.mtime;
-            }
+            transfer->setPublicNode(node);
         }
     }
-    else fileName = "CRYPTO_ERROR";
 
-	if(request->getType() == MegaRequest::TYPE_IMPORT_LINK)
-	{
-		NewNode* newnode = new NewNode[1];
+    transfer->setOutputStream(stream);
+    transfer->setMaxRetries(maxRetries);
 
-		// set up new node as folder node
-		newnode->source = NEW_PUBLIC;
-		newnode->type = FILENODE;
-		newnode->nodehandle = ph;
-        newnode->parenthandle = UNDEF;
-		newnode->nodekey.assign((char*)key,FILENODEKEYLENGTH);
-        newnode->attrstring = new string(*a);
+    if (transferQueue.push(transfer))
+    {
+        waiter->notify();
+    }
+}
 
-		// add node
-        requestMap.erase(request->getTag());
-        int nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-        requestMap[nextTag]=request;
-        client->putnodes(request->getParentHandle(), newnode, 1);
+void MegaApiImpl::startStreaming(MegaNode* node, m_off_t startPos, m_off_t size, MegaTransferListener *listener)
+{
+	MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
+	if(node && !node->isPublic())
+	{
+		transfer->setNodeHandle(node->getHandle());
 	}
 	else
 	{
-        request->setPublicNode(new MegaNodePrivate(fileName.c_str(), FILENODE, size, 0, mtime, ph, &keystring, a));
-        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+		transfer->setPublicNode(node);
 	}
-}
 
-// reload needed
-void MegaApiImpl::reload(const char*)
-{
-    fireOnReloadNeeded();
+	transfer->setStartPos(startPos);
+	transfer->setEndPos(startPos + size - 1);
+	transfer->setMaxRetries(maxRetries);
+	if (transferQueue.push(transfer))
+	{
+	    waiter->notify();
+	}
 }
 
-// nodes have been modified
-// (nodes with their removed flag set will be deleted immediately after returning from this call,
-// at which point their pointers will become invalid at that point.)
-void MegaApiImpl::nodes_updated(Node** n, int count)
+void MegaApiImpl::startStreamingToBuffers(MegaNode *node, m_off_t startPos, m_off_t size, char **buffers, int numBuffers, size_t bufferSize, MegaTransferListener *listener)
 {
-    if(!count)
+    MegaTransferPrivate* transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD, listener);
+    if (node && !node->isPublic())
     {
-        return;
+        transfer->setNodeHandle(node->getHandle());
     }
-
-    MegaNodeList *nodeList = NULL;
-    if(n != NULL)
+    else
     {
-        nodeList = new MegaNodeListPrivate(n, count);
-        fireOnNodesUpdate(nodeList);
+        transfer->setPublicNode(node);
     }
-    else
+
+    transfer->setStartPos(startPos);
+    transfer->setEndPos(startPos + size - 1);
+    transfer->setMaxRetries(maxRetries);
+    transfer->setStreamingRing(new MegaStreamingRing(buffers, numBuffers, bufferSize));
+    if (transferQueue.push(transfer))
     {
-        fireOnNodesUpdate(NULL);
+        waiter->notify();
     }
-    delete nodeList;
 }
 
-void MegaApiImpl::account_details(AccountDetails*, bool, bool, bool, bool, bool, bool)
+void MegaApiImpl::releaseStreamingBuffer(int transferTag, int buffer)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
+    sdkMutex.lock();
 
-	int numDetails = request->getNumDetails();
-	numDetails--;
-	request->setNumDetails(numDetails);
-	if(!numDetails)
+    map<int, MegaStreamingRing *>::iterator it = streamingRings.find(transferTag);
+    if (it != streamingRings.end() && buffer >= 0 && buffer < (int)it->second->buffers.size() && it->second->lent[buffer])
     {
-        if(!request->getAccountDetails()->storage_max)
-            fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
-        else
-            fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+        MegaStreamingRing *ring = it->second;
+
+        ring->lent[buffer] = false;
+        ring->available.push_back(buffer);
+
+        if (ring->finished)
+        {
+            if (ring->available.size() == ring->buffers.size())
+            {
+                streamingRings.erase(it);
+                delete ring;
+            }
+        }
+        else if (ring->overflow.size())
+        {
+            // the SDK thread delivers the waiting data
+            streamingBuffersReleased = true;
+            waiter->notify();
+        }
     }
+
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::account_details(AccountDetails*, error e)
+MegaFileHandle *MegaApiImpl::openFile(MegaNode *node)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
+    if (!node || node->getType() != MegaNode::TYPE_FILE)
+    {
+        return NULL;
+    }
 
-    fireOnRequestFinish(request, megaError);
-}
+    sdkMutex.lock();
+    if (node->isPublic())
+    {
+        SymmCipher cipher;
+        cipher.setkey(node->getNodeKey());
+        client->preadopen(node->getHandle(), &cipher,
+                          MemAccess::get<int64_t>((const char*)node->getNodeKey()->data() + SymmCipher::KEYLENGTH));
+    }
+    else
+    {
+        Node *n = client->nodebyhandle(node->getHandle());
+        if (!n || n->type != FILENODE)
+        {
+            sdkMutex.unlock();
+            return NULL;
+        }
 
-void MegaApiImpl::invite_result(error e)
-{
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_ADD_CONTACT) &&
-                    (request->getType() != MegaRequest::TYPE_REMOVE_CONTACT))) return;
+        client->preadopen(n);
+    }
 
-    fireOnRequestFinish(request, megaError);
+    MegaFileHandlePrivate *file = new MegaFileHandlePrivate(this, node);
+    sdkMutex.unlock();
+
+    // fetch the tempurl now
+    waiter->notify();
+    return file;
 }
 
-void MegaApiImpl::putua_result(error e)
+void MegaApiImpl::readFile(MegaFileHandle *file, int64_t offset, int64_t size, MegaTransferListener *listener)
 {
-    MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_SET_ATTR_USER)) return;
+    MegaFileHandlePrivate *f = (MegaFileHandlePrivate *)file;
+    if (!f || !listener)
+    {
+        return;
+    }
 
-    fireOnRequestFinish(request, megaError);
-}
+    pair<m_off_t, m_off_t> range(offset, size);
 
-void MegaApiImpl::getua_result(error e)
-{
-	MegaError megaError(e);
-	if(requestMap.find(client->restag) == requestMap.end()) return;
-	MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
+    sdkMutex.lock();
+    map<pair<m_off_t, m_off_t>, MegaFileRead *>::iterator it = f->reads.find(range);
+    if (it != f->reads.end() && !it->second->receiving)
+    {
+        it->second->listeners.push_back(listener);
+        it->second->active.push_back(true);
+        sdkMutex.unlock();
+        return;
+    }
 
-    fireOnRequestFinish(request, megaError);
+    // only the first of the overlapping identical reads can be joined
+    MegaFileRead *read = new MegaFileRead(it == f->reads.end() ? f : NULL, offset, size);
+    read->listeners.push_back(listener);
+    read->active.push_back(true);
+    if (it == f->reads.end())
+    {
+        f->reads[range] = read;
+    }
+    sdkMutex.unlock();
+
+    startStreaming(f->node, offset, size, read);
 }
 
-void MegaApiImpl::getua_result(byte* data, unsigned len)
+void MegaApiImpl::closeFile(MegaFileHandlePrivate *file)
 {
-	if(requestMap.find(client->restag) == requestMap.end()) return;
-	MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
-
-    if(request->getParamType() == MegaApi::USER_ATTR_AVATAR)
+    sdkMutex.lock();
+    for (map<pair<m_off_t, m_off_t>, MegaFileRead *>::iterator it = file->reads.begin(); it != file->reads.end(); it++)
     {
-        if (len)
-        {
-            FileAccess *f = client->fsaccess->newfileaccess();
-            string filePath(request->getFile());
-            string localPath;
-            fsAccess->path2local(&filePath, &localPath);
+        it->second->file = NULL;
+    }
+    file->reads.clear();
 
-            totalDownloadedBytes += len;
+    client->preadclose(file->node->getHandle(), !file->node->isPublic());
+    sdkMutex.unlock();
+}
 
-            fsAccess->unlinklocal(&localPath);
-            if(!f->fopen(&localPath, false, true))
-            {
-                delete f;
-                fireOnRequestFinish(request, MegaError(API_EWRITE));
-                return;
-            }
+void MegaApiImpl::prefetch(MegaNode *node, int64_t offset, int64_t size, int priority)
+{
+    if (!node || node->getType() != MegaNode::TYPE_FILE)
+    {
+        return;
+    }
 
-            if(!f->fwrite((const byte*)data, len, 0))
-            {
-                delete f;
-                fireOnRequestFinish(request, MegaError(API_EWRITE));
-                return;
-            }
+    bool idle = priority == MegaTransfer::PRIORITY_BACKGROUND;
 
-            delete f;
-        }
-        else    // no data for the avatar
-        {
-            fireOnRequestFinish(request, MegaError(API_ENOENT));
-            return;
-        }
+    sdkMutex.lock();
+    if (node->isPublic())
+    {
+        SymmCipher cipher;
+        cipher.setkey(node->getNodeKey());
+        client->prefetch(node->getHandle(), &cipher,
+                         MemAccess::get<int64_t>((const char*)node->getNodeKey()->data() + SymmCipher::KEYLENGTH),
+                         offset, size, idle);
     }
     else
     {
-        string str((const char*)data,len);
-        request->setText(str.c_str());
+        Node *n = client->nodebyhandle(node->getHandle());
+        if (n && n->type == FILENODE)
+        {
+            client->prefetch(n, offset, size, idle);
+        }
     }
-    fireOnRequestFinish(request, MegaError(API_OK));
-}
+    sdkMutex.unlock();
 
-// user attribute update notification
-void MegaApiImpl::userattr_update(User*, int, const char*)
-{
+    waiter->notify();
 }
 
-void MegaApiImpl::ephemeral_result(error e)
+void MegaApiImpl::cancelPrefetch(MegaNode *node)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+    if (!node)
+    {
+        return;
+    }
 
-    fireOnRequestFinish(request, megaError);
+    sdkMutex.lock();
+    if (node->isPublic())
+    {
+        client->prefetchabort(node->getHandle());
+    }
+    else
+    {
+        Node *n = client->nodebyhandle(node->getHandle());
+        if (n)
+        {
+            client->prefetchabort(n);
+        }
+    }
+    sdkMutex.unlock();
 }
 
-void MegaApiImpl::ephemeral_result(handle, const byte*)
+void MegaApiImpl::fillStreamingBuffers(MegaTransferPrivate *transfer, MegaStreamingRing *ring, const char *data, m_off_t len, m_off_t pos)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+    // new data must not overtake the data already waiting
+    if (ring->overflow.size())
+    {
+        ring->overflow.append(data, len);
+        return;
+    }
 
-    requestMap.erase(request->getTag());
-    int nextTag = client->nextreqtag();
-    request->setTag(nextTag);
-    requestMap[nextTag] = request;
+    while (len && ring->available.size())
+    {
+        int i = ring->available.front();
+        size_t l = (len < (m_off_t)ring->bufferSize) ? (size_t)len : ring->bufferSize;
 
-	byte pwkey[SymmCipher::KEYLENGTH];
-    if(!request->getPrivateKey())
-		client->pw_key(request->getPassword(),pwkey);
-	else
-		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
+        ring->available.pop_front();
+        ring->lent[i] = true;
+        memcpy(ring->buffers[i], data, l);
+        fireOnTransferBuffer(transfer, i, pos, l);
 
-    client->sendsignuplink(request->getEmail(),request->getName(),pwkey);
+        data += l;
+        pos += l;
+        len -= l;
+    }
+
+    if (len)
+    {
+        ring->overflow.assign(data, len);
+        ring->overflowPos = pos;
+    }
 }
 
-void MegaApiImpl::sendsignuplink_result(error e)
+void MegaApiImpl::deliverStreamingOverflow()
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
-
-    requestMap.erase(request->getTag());
-    while(!requestMap.empty())
+    // callbacks can release buffers and delete rings
+    vector<int> tags;
+    for (map<int, MegaStreamingRing *>::iterator it = streamingRings.begin(); it != streamingRings.end(); it++)
     {
-        std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-        if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
+        if (it->second->overflow.size() && it->second->available.size())
+        {
+            tags.push_back(it->first);
+        }
     }
 
-    while(!transferMap.empty())
+    for (unsigned i = 0; i < tags.size(); i++)
     {
-        std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
-        if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
-    }
+        map<int, MegaStreamingRing *>::iterator it = streamingRings.find(tags[i]);
+        map<int, MegaTransferPrivate *>::iterator t = transferMap.find(tags[i]);
+        if (it == streamingRings.end() || t == transferMap.end())
+        {
+            continue;
+        }
 
-    client->locallogout();
-    fireOnRequestFinish(request, megaError);
-}
+        MegaStreamingRing *ring = it->second;
+        string pending;
 
-void MegaApiImpl::querysignuplink_result(error e)
-{
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
+        pending.swap(ring->overflow);
+        fillStreamingBuffers(t->second, ring, pending.data(), pending.size(), ring->overflowPos);
 
-    fireOnRequestFinish(request, megaError);
+        if (ring->finishing && !ring->overflow.size())
+        {
+            fireOnTransferFinish(t->second, MegaError(API_OK));
+        }
+    }
 }
 
-void MegaApiImpl::querysignuplink_result(handle, const char* email, const char* name, const byte* pwc, const byte*, const byte* c, size_t len)
+#ifdef ENABLE_SYNC
+
+//Move local files inside synced folders to the "Rubbish" folder.
+bool MegaApiImpl::moveToLocalDebris(const char *path)
 {
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
-                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
+    sdkMutex.lock();
 
-	request->setEmail(email);
-	request->setName(name);
+    string utf8path = path;
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(utf8path.c_str()) && ((utf8path.size()<2) || utf8path.compare(0, 2, "\\\\")))
+            utf8path.insert(0, "\\\\?\\");
+#endif
 
-	if(request->getType() == MegaRequest::TYPE_QUERY_SIGNUP_LINK)
-	{
-        fireOnRequestFinish(request, MegaError(API_OK));
-		return;
-	}
+    string localpath;
+    fsAccess->path2local(&utf8path, &localpath);
 
-	string signupemail = email;
-	string signupcode;
-	signupcode.assign((char*)c,len);
+    Sync *sync = NULL;
+    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+    {
+        string *localroot = &((*it)->localroot.localname);
+        if(((localroot->size()+fsAccess->localseparator.size())<localpath.size()) &&
+            !memcmp(localroot->data(), localpath.data(), localroot->size()) &&
+            !memcmp(fsAccess->localseparator.data(), localpath.data()+localroot->size(), fsAccess->localseparator.size()))
+        {
+            sync = (*it);
+            break;
+        }
+    }
 
-	byte signuppwchallenge[SymmCipher::KEYLENGTH];
-	byte signupencryptedmasterkey[SymmCipher::KEYLENGTH];
+    if(!sync)
+    {
+        sdkMutex.unlock();
+        return false;
+    }
 
-	memcpy(signuppwchallenge,pwc,sizeof signuppwchallenge);
-	memcpy(signupencryptedmasterkey,pwc,sizeof signupencryptedmasterkey);
+    bool result = sync->movetolocaldebris(&localpath);
+    sdkMutex.unlock();
 
-	byte pwkey[SymmCipher::KEYLENGTH];
-    if(!request->getPrivateKey())
-		client->pw_key(request->getPassword(),pwkey);
-	else
-		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
+    return result;
+}
 
-	// verify correctness of supplied signup password
-	SymmCipher pwcipher(pwkey);
-	pwcipher.ecb_decrypt(signuppwchallenge);
+int MegaApiImpl::syncPathState(string* path)
+{
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+    string prefix("\\\\?\\");
+    string localPrefix;
+    fsAccess->path2local(&prefix, &localPrefix);
+    path->append("", 1);
+    if(!PathIsRelativeW((LPCWSTR)path->data()) && (path->size()<4 || memcmp(path->data(), localPrefix.data(), 4)))
+    {
+        path->insert(0, localPrefix);
+    }
+    path->resize(path->size() - 1);
+#endif
 
-	if (*(uint64_t*)(signuppwchallenge+4))
-	{
-        fireOnRequestFinish(request, MegaError(API_ENOENT));
-	}
-	else
-	{
-		// decrypt and set master key, then proceed with the confirmation
-		pwcipher.ecb_decrypt(signupencryptedmasterkey);
-		client->key.setkey(signupencryptedmasterkey);
+    // paths with a known state are answered without the SDK lock, the
+    // others (e.g. ignored files or short names) are looked up in the syncs
+    int state;
+    if (syncStateIndex.get(*path, &state))
+    {
+        return state;
+    }
 
-        requestMap.erase(request->getTag());
-        int nextTag = client->nextreqtag();
-        request->setTag(nextTag);
-        requestMap[nextTag] = request;
+    state = MegaApi::STATE_NONE;
+    sdkMutex.lock();
+    for (sync_list::iterator it = client->syncs.begin(); it != client->syncs.end(); it++)
+    {
+        Sync *sync = (*it);
+        unsigned int ssize = sync->localroot.localname.size();
+        if(path->size() < ssize || memcmp(path->data(), sync->localroot.localname.data(), ssize))
+            continue;
 
-		client->confirmsignuplink((const byte*)signupcode.data(),signupcode.size(),MegaClient::stringhash64(&signupemail,&pwcipher));
-	}
+        if(path->size() == ssize)
+        {
+            state = sync->localroot.ts;
+            break;
+        }
+        else if(!memcmp(path->data()+ssize, client->fsaccess->localseparator.data(), client->fsaccess->localseparator.size()))
+        {
+            LocalNode* l = sync->localnodebypath(NULL, path);
+            if(l)
+                state = l->ts;
+            else
+                state = MegaApi::STATE_IGNORED;
+            break;
+        }
+    }
+    sdkMutex.unlock();
+    return state;
 }
 
-void MegaApiImpl::confirmsignuplink_result(error e)
+
+MegaNode *MegaApiImpl::getSyncedNode(string *path)
 {
-	MegaError megaError(e);
-    if(requestMap.find(client->restag) == requestMap.end()) return;
-    MegaRequestPrivate* request = requestMap.at(client->restag);
-    if(!request) return;
+    sdkMutex.lock();
+    MegaNode *node = NULL;
+    for (sync_list::iterator it = client->syncs.begin(); (it != client->syncs.end()) && (node == NULL); it++)
+    {
+        Sync *sync = (*it);
+        if(path->size() == sync->localroot.localname.size() &&
+                !memcmp(path->data(), sync->localroot.localname.data(), path->size()))
+        {
+            node = MegaNodePrivate::fromNode(sync->localroot.node);
+            break;
+        }
 
-    fireOnRequestFinish(request, megaError);
+        LocalNode * localNode = sync->localnodebypath(NULL, path);
+        if(localNode) node = MegaNodePrivate::fromNode(localNode->node);
+    }
+    sdkMutex.unlock();
+    return node;
 }
 
-void MegaApiImpl::setkeypair_result(error e)
+void MegaApiImpl::syncFolder(const char *localFolder, MegaNode *megaFolder, MegaRequestListener *listener)
 {
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
+    if(localFolder)
+    {
+        string path(localFolder);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
+        request->setFile(path.data());
+    }
 
+    request->setListener(listener);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::checkfile_result(handle h, error e)
+void MegaApiImpl::resumeSync(const char *localFolder, long long localfp, MegaNode *megaFolder, MegaRequestListener* listener)
 {
-    if(e)
+    sdkMutex.lock();
+
+#ifdef __APPLE__
+    localfp = 0;
+#endif
+
+    LOG_debug << "Resume sync";
+
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+    request->setListener(listener);
+    if(megaFolder) request->setNodeHandle(megaFolder->getHandle());
+    if(localFolder)
     {
-        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
-        {
-            MegaTransferPrivate *transfer = iter->second;
-            if(transfer->getNodeHandle() == h)
-                fireOnTransferTemporaryError(transfer, MegaError(e));
-        }
+        string path(localFolder);
+#if defined(_WIN32) && !defined(WINDOWS_PHONE)
+        if(!PathIsRelativeA(path.c_str()) && ((path.size()<2) || path.compare(0, 2, "\\\\")))
+            path.insert(0, "\\\\?\\");
+#endif
+        request->setFile(path.data());
     }
-}
+    request->setNumber(localfp);
 
-void MegaApiImpl::checkfile_result(handle h, error e, byte*, m_off_t, m_time_t, m_time_t, string*, string*, string*)
-{
-    if(e)
+    int nextTag = client->nextreqtag();
+    request->setTag(nextTag);
+    requestMap[nextTag]=request;
+    error e = API_OK;
+    fireOnRequestStart(request);
+
+    const char *localPath = request->getFile();
+    Node *node = client->nodebyhandle(request->getNodeHandle());
+    if(!node || (node->type==FILENODE) || !localPath)
     {
-        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
+        e = API_EARGS;
+    }
+    else
+    {
+        string utf8name(localPath);
+        string localname;
+        client->fsaccess->path2local(&utf8name, &localname);
+        e = client->addsync(&localname, DEBRISFOLDER, NULL, node, localfp, -nextTag);
+        if(!e)
         {
-            MegaTransferPrivate *transfer = iter->second;
-            if(transfer->getNodeHandle() == h)
-                fireOnTransferTemporaryError(transfer, MegaError(e));
+            MegaSyncPrivate *sync = new MegaSyncPrivate(client->syncs.back());
+            sync->setListener(request->getSyncListener());
+            syncMap[-nextTag] = sync;
+
+            request->setNumber(client->syncs.back()->fsfp);
         }
     }
-}
-
-void MegaApiImpl::addListener(MegaListener* listener)
-{
-    if(!listener) return;
 
-    sdkMutex.lock();
-    listeners.insert(listener);
+    fireOnRequestFinish(request, MegaError(e));
     sdkMutex.unlock();
 }
 
-void MegaApiImpl::addRequestListener(MegaRequestListener* listener)
+void MegaApiImpl::removeSync(handle nodehandle, MegaRequestListener* listener)
 {
-    if(!listener) return;
-
-    sdkMutex.lock();
-    requestListeners.insert(listener);
-    sdkMutex.unlock();
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
+    request->setNodeHandle(nodehandle);
+    request->setFlag(true);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::addTransferListener(MegaTransferListener* listener)
+void MegaApiImpl::disableSync(handle nodehandle, MegaRequestListener *listener)
 {
-    if(!listener) return;
-
-    sdkMutex.lock();
-    transferListeners.insert(listener);
-    sdkMutex.unlock();
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNC, listener);
+    request->setNodeHandle(nodehandle);
+    request->setFlag(false);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
 }
 
-void MegaApiImpl::addGlobalListener(MegaGlobalListener* listener)
+int MegaApiImpl::getNumActiveSyncs()
 {
-    if(!listener) return;
-
     sdkMutex.lock();
-    globalListeners.insert(listener);
+    int num = client->syncs.size();
     sdkMutex.unlock();
+    return num;
 }
 
-#ifdef ENABLE_SYNC
-void MegaApiImpl::addSyncListener(MegaSyncListener *listener)
+void MegaApiImpl::stopSyncs(MegaRequestListener *listener)
 {
-    if(!listener) return;
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_REMOVE_SYNCS, listener);
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
 
+bool MegaApiImpl::isSynced(MegaNode *n)
+{
+    if(!n) return false;
     sdkMutex.lock();
-    syncListeners.insert(listener);
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node)
+    {
+        sdkMutex.unlock();
+        return false;
+    }
+
+    bool result = (node->localnode!=NULL);
     sdkMutex.unlock();
+    return result;
 }
 
-void MegaApiImpl::removeSyncListener(MegaSyncListener *listener)
+void MegaApiImpl::setExcludedNames(vector<string> *excludedNames)
 {
-    if(!listener) return;
-
     sdkMutex.lock();
-    syncListeners.erase(listener);
-
-    std::map<int, MegaSyncPrivate*>::iterator it = syncMap.begin();
-    while(it != syncMap.end())
+    if(!excludedNames)
     {
-        MegaSyncPrivate* sync = it->second;
-        if(sync->getListener() == listener)
-            sync->setListener(NULL);
+        this->excludedNames.clear();
+        sdkMutex.unlock();
+        return;
+    }
 
-        it++;
+    for(unsigned int i=0; i<excludedNames->size(); i++)
+    {
+        LOG_debug << "Excluded name: " << excludedNames->at(i);
     }
-    requestQueue.removeListener(listener);
 
+    this->excludedNames = *excludedNames;
     sdkMutex.unlock();
 }
-#endif
 
-void MegaApiImpl::removeListener(MegaListener* listener)
+void MegaApiImpl::setExclusionLowerSizeLimit(long long limit)
 {
-    if(!listener) return;
-
-    sdkMutex.lock();
-    listeners.erase(listener);
-    sdkMutex.unlock();
+    syncLowerSizeLimit = limit;
 }
 
-void MegaApiImpl::removeRequestListener(MegaRequestListener* listener)
+void MegaApiImpl::setExclusionUpperSizeLimit(long long limit)
 {
-    if(!listener) return;
+    syncUpperSizeLimit = limit;
+}
 
+string MegaApiImpl::getLocalPath(MegaNode *n)
+{
+    if(!n) return string();
     sdkMutex.lock();
-    requestListeners.erase(listener);
-
-    std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
-    while(it != requestMap.end())
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node || !node->localnode)
     {
-        MegaRequestPrivate* request = it->second;
-        if(request->getListener() == listener)
-            request->setListener(NULL);
-
-        it++;
+        sdkMutex.unlock();
+        return string();
     }
 
-    requestQueue.removeListener(listener);
+    string result;
+    node->localnode->getlocalpath(&result, true);
+    result.append("", 1);
     sdkMutex.unlock();
+    return result;
 }
 
-void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
-{
-    if(!listener) return;
+#endif
 
-    sdkMutex.lock();
-    transferListeners.erase(listener);
-    sdkMutex.unlock();
+int MegaApiImpl::getNumPendingUploads()
+{
+    return pendingUploads + numQueuedUploads;
 }
 
-void MegaApiImpl::removeGlobalListener(MegaGlobalListener* listener)
+int MegaApiImpl::getNumPendingDownloads()
 {
-    if(!listener) return;
-
-    sdkMutex.lock();
-    globalListeners.erase(listener);
-    sdkMutex.unlock();
+    return pendingDownloads;
 }
 
-MegaRequest *MegaApiImpl::getCurrentRequest()
+int MegaApiImpl::getTotalUploads()
 {
-    return activeRequest;
+    return totalUploads;
 }
 
-MegaTransfer *MegaApiImpl::getCurrentTransfer()
+int MegaApiImpl::getTotalDownloads()
 {
-    return activeTransfer;
+    return totalDownloads;
 }
 
-MegaError *MegaApiImpl::getCurrentError()
+void MegaApiImpl::resetTotalDownloads()
 {
-    return activeError;
+    totalDownloads = 0;
 }
 
-MegaNodeList *MegaApiImpl::getCurrentNodes()
+void MegaApiImpl::resetTotalUploads()
 {
-    return activeNodes;
+    totalUploads = 0;
 }
 
-MegaUserList *MegaApiImpl::getCurrentUsers()
+MegaNode *MegaApiImpl::getRootNode()
 {
-    return activeUsers;
+    bool exclusive = lockRead();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[0]));
+    unlockRead(exclusive);
+	return result;
 }
 
-void MegaApiImpl::fireOnRequestStart(MegaRequestPrivate *request)
+MegaNode* MegaApiImpl::getInboxNode()
 {
-    activeRequest = request;
-    LOG_info << "Request (" << request->getRequestString() << ") starting";
-	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-		(*it)->onRequestStart(api, request);
-
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onRequestStart(api, request);
-
-	MegaRequestListener* listener = request->getListener();
-	if(listener) listener->onRequestStart(api, request);
-	activeRequest = NULL;
+    bool exclusive = lockRead();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[1]));
+    unlockRead(exclusive);
+	return result;
 }
 
+MegaNode* MegaApiImpl::getRubbishNode()
+{
+    bool exclusive = lockRead();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(client->rootnodes[2]));
+    unlockRead(exclusive);
+	return result;
+}
 
-void MegaApiImpl::fireOnRequestFinish(MegaRequestPrivate *request, MegaError e)
+bool MegaApiImpl::userComparatorDefaultASC (User *i, User *j)
 {
-	MegaError *megaError = new MegaError(e);
-	activeRequest = request;
-	activeError = megaError;
+	if(strcasecmp(i->email.c_str(), j->email.c_str())<=0) return 1;
+    return 0;
+}
 
-    if(e.getErrorCode())
+char *MegaApiImpl::escapeFsIncompatible(const char *filename)
+{
+    if(!filename)
     {
-        LOG_warn << "Request (" << request->getRequestString() << ") finished with error: " << e.getErrorString();
+        return NULL;
     }
-    else
+    string name = filename;
+    client->fsaccess->escapefsincompatible(&name);
+    return MegaApi::strdup(name.c_str());
+}
+
+char *MegaApiImpl::unescapeFsIncompatible(const char *name)
+{
+    if(!name)
     {
-        LOG_info << "Request (" << request->getRequestString() << ") finished";
+        return NULL;
     }
+    string filename = name;
+    client->fsaccess->unescapefsincompatible(&filename);
+    return MegaApi::strdup(filename.c_str());
+}
 
-	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-		(*it)->onRequestFinish(api, request, megaError);
+bool MegaApiImpl::createThumbnail(const char *imagePath, const char *dstPath)
+{
+    if (!gfxAccess)
+    {
+        return false;
+    }
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onRequestFinish(api, request, megaError);
+    string utf8ImagePath = imagePath;
+    string localImagePath;
+    fsAccess->path2local(&utf8ImagePath, &localImagePath);
 
-	MegaRequestListener* listener = request->getListener();
-	if(listener) listener->onRequestFinish(api, request, megaError);
+    string utf8DstPath = dstPath;
+    string localDstPath;
+    fsAccess->path2local(&utf8DstPath, &localDstPath);
 
-    requestMap.erase(request->getTag());
+    sdkMutex.lock();
+    bool result = gfxAccess->savefa(&localImagePath, GfxProc::THUMBNAIL120X120, &localDstPath);
+    sdkMutex.unlock();
 
-	activeRequest = NULL;
-	activeError = NULL;
-	delete request;
-    delete megaError;
+    return result;
 }
 
-void MegaApiImpl::fireOnRequestUpdate(MegaRequestPrivate *request)
+bool MegaApiImpl::createPreview(const char *imagePath, const char *dstPath)
 {
-    activeRequest = request;
+    if (!gfxAccess)
+    {
+        return false;
+    }
 
-    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-        (*it)->onRequestUpdate(api, request);
+    string utf8ImagePath = imagePath;
+    string localImagePath;
+    fsAccess->path2local(&utf8ImagePath, &localImagePath);
 
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onRequestUpdate(api, request);
+    string utf8DstPath = dstPath;
+    string localDstPath;
+    fsAccess->path2local(&utf8DstPath, &localDstPath);
 
-    MegaRequestListener* listener = request->getListener();
-    if(listener) listener->onRequestUpdate(api, request);
+    sdkMutex.lock();
+    bool result = gfxAccess->savefa(&localImagePath, GfxProc::PREVIEW1000x1000, &localDstPath);
+    sdkMutex.unlock();
 
-    activeRequest = NULL;
+    return result;
 }
 
-void MegaApiImpl::fireOnRequestTemporaryError(MegaRequestPrivate *request, MegaError e)
+bool MegaApiImpl::isOnline()
 {
-	MegaError *megaError = new MegaError(e);
-	activeRequest = request;
-	activeError = megaError;
-
-    request->setNumRetry(request->getNumRetry() + 1);
+    return !client->httpio->noinetds;
+}
 
-	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
-		(*it)->onRequestTemporaryError(api, request, megaError);
+MegaUserList* MegaApiImpl::getContacts()
+{
+    bool exclusive = lockRead();
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onRequestTemporaryError(api, request, megaError);
+	vector<User*> vUsers;
+	for (user_map::iterator it = client->users.begin() ; it != client->users.end() ; it++ )
+	{
+		User *u = &*it;
+        vector<User *>::iterator i = std::lower_bound(vUsers.begin(), vUsers.end(), u, MegaApiImpl::userComparatorDefaultASC);
+		vUsers.insert(i, u);
+	}
+    MegaUserList *userList = new MegaUserListPrivate(vUsers.data(), vUsers.size());
 
-	MegaRequestListener* listener = request->getListener();
-	if(listener) listener->onRequestTemporaryError(api, request, megaError);
+    unlockRead(exclusive);
 
-	activeRequest = NULL;
-	activeError = NULL;
-	delete megaError;
+	return userList;
 }
 
-void MegaApiImpl::fireOnTransferStart(MegaTransferPrivate *transfer)
+
+MegaUser* MegaApiImpl::getContact(const char* email)
 {
-	activeTransfer = transfer;
+    bool exclusive = lockRead();
+	MegaUser *user = MegaUserPrivate::fromUser(client->finduser(email, 0));
+    unlockRead(exclusive);
+	return user;
+}
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferStart(api, transfer);
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferStart(api, transfer);
+MegaNodeList* MegaApiImpl::getInShares(MegaUser *megaUser)
+{
+    if(!megaUser) return new MegaNodeListPrivate();
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferStart(api, transfer);
+    bool exclusive = lockRead();
+    vector<Node*> vNodes;
+    User *user = client->finduser(megaUser->getEmail(), 0);
+    if(!user)
+    {
+        unlockRead(exclusive);
+        return new MegaNodeListPrivate();
+    }
 
-	activeTransfer = NULL;
+	for (handle_set::iterator sit = user->sharing.begin(); sit != user->sharing.end(); sit++)
+	{
+        Node *n;
+        if ((n = client->nodebyhandle(*sit)) && !n->parent)
+            vNodes.push_back(n);
+	}
+    MegaNodeList *nodeList;
+    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    else nodeList = new MegaNodeListPrivate();
+
+    unlockRead(exclusive);
+	return nodeList;
 }
 
-void MegaApiImpl::fireOnTransferFinish(MegaTransferPrivate *transfer, MegaError e)
+MegaNodeList* MegaApiImpl::getInShares()
 {
-	MegaError *megaError = new MegaError(e);
-	activeTransfer = transfer;
-	activeError = megaError;
+    bool exclusive = lockRead();
 
-    if(e.getErrorCode())
-    {
-        LOG_warn << "Transfer (" << transfer->getTransferString() << ") finished with error: " << e.getErrorString()
-                    << " File: " << transfer->getFileName();
-    }
-    else
+    vector<Node*> vNodes;
+    Node *n;
+
+    for (handle_set::iterator it = client->insharenodes.begin(); it != client->insharenodes.end(); it++)
     {
-        LOG_info << "Transfer (" << transfer->getTransferString() << ") finished. File: " << transfer->getFileName();
+        if ((n = client->nodebyhandle(*it)) && !n->parent)
+        {
+            vNodes.push_back(n);
+        }
     }
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferFinish(api, transfer, megaError);
+    MegaNodeList *nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    unlockRead(exclusive);
+	return nodeList;
+}
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferFinish(api, transfer, megaError);
+MegaShareList* MegaApiImpl::getInSharesList()
+{
+    bool exclusive = lockRead();
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferFinish(api, transfer, megaError);
+    vector<Share*> vShares;
+    handle_vector vHandles;
+    Node *n;
 
-    transferMap.erase(transfer->getTag());
+    for (handle_set::iterator it = client->insharenodes.begin(); it != client->insharenodes.end(); it++)
+    {
+        if ((n = client->nodebyhandle(*it)) && !n->parent)
+        {
+            vShares.push_back(n->inshare());
+            vHandles.push_back(n->nodehandle);
+        }
+    }
 
-	activeTransfer = NULL;
-	activeError = NULL;
-	delete transfer;
-	delete megaError;
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
+    unlockRead(exclusive);
+    return shareList;
 }
 
-void MegaApiImpl::fireOnTransferTemporaryError(MegaTransferPrivate *transfer, MegaError e)
+bool MegaApiImpl::isPendingShare(MegaNode *megaNode)
 {
-	MegaError *megaError = new MegaError(e);
-	activeTransfer = transfer;
-	activeError = megaError;
+    if(!megaNode) return false;
 
-    transfer->setNumRetry(transfer->getNumRetry() + 1);
+    sdkMutex.lock();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node)
+    {
+        sdkMutex.unlock();
+        return false;
+    }
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferTemporaryError(api, transfer, megaError);
+    bool result = (node->pendingshares() != NULL);
+    sdkMutex.unlock();
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferTemporaryError(api, transfer, megaError);
+    return result;
+}
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferTemporaryError(api, transfer, megaError);
+// shares of the nodes below the root (not in the rubbish bin or the inbox)
+static void getRootShares(MegaClient *client, handle_set *index, bool pending, vector<Share *> *shares, vector<handle> *handles)
+{
+    Node *root = client->nodebyhandle(client->rootnodes[0]);
+    Node *n;
 
-	activeTransfer = NULL;
-	activeError = NULL;
-    delete megaError;
-}
+    for (handle_set::iterator it = index->begin(); root && it != index->end(); it++)
+    {
+        if (!(n = client->nodebyhandle(*it)) || !n->isbelow(root))
+        {
+            continue;
+        }
 
-MegaClient *MegaApiImpl::getMegaClient()
-{
-    return client;
+        share_map *nodeShares = pending ? n->pendingshares() : n->outshares();
+
+        for (share_map::iterator sit = nodeShares->begin(); sit != nodeShares->end(); sit++)
+        {
+            shares->push_back(sit->second);
+            handles->push_back(n->nodehandle);
+        }
+    }
 }
 
-void MegaApiImpl::fireOnTransferUpdate(MegaTransferPrivate *transfer)
+MegaShareList *MegaApiImpl::getOutShares()
 {
-	activeTransfer = transfer;
+    bool exclusive = lockRead();
 
-	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
-		(*it)->onTransferUpdate(api, transfer);
-
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onTransferUpdate(api, transfer);
+    vector<Share *> vShares;
+    vector<handle> vHandles;
 
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener) listener->onTransferUpdate(api, transfer);
+    getRootShares(client, &client->outsharenodes, false, &vShares, &vHandles);
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
 
-	activeTransfer = NULL;
+    unlockRead(exclusive);
+	return shareList;
 }
 
-bool MegaApiImpl::fireOnTransferData(MegaTransferPrivate *transfer)
+MegaShareList* MegaApiImpl::getOutShares(MegaNode *megaNode)
 {
-	activeTransfer = transfer;
-	bool result = false;
-	MegaTransferListener* listener = transfer->getListener();
-	if(listener)
-		result = listener->onTransferData(api, transfer, transfer->getLastBytes(), transfer->getDeltaSize());
-
-	activeTransfer = NULL;
-	return result;
-}
+    if(!megaNode) return new MegaShareListPrivate();
 
-void MegaApiImpl::fireOnUsersUpdate(MegaUserList *users)
-{
-	activeUsers = users;
+    bool exclusive = lockRead();
+	Node *node = client->nodebyhandle(megaNode->getHandle());
+	if(!node)
+	{
+        unlockRead(exclusive);
+        return new MegaShareListPrivate();
+	}
 
-	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    if(!node->outshares())
     {
-        (*it)->onUsersUpdate(api, users);
-    }
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-    {
-        (*it)->onUsersUpdate(api, users);
+        unlockRead(exclusive);
+        return new MegaShareListPrivate();
     }
 
-    activeUsers = NULL;
+	vector<Share*> vShares;
+	vector<handle> vHandles;
+
+    for (share_map::iterator it = node->outshares()->begin(); it != node->outshares()->end(); it++)
+	{
+		vShares.push_back(it->second);
+		vHandles.push_back(node->nodehandle);
+	}
+
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
+    unlockRead(exclusive);
+    return shareList;
 }
 
-void MegaApiImpl::fireOnContactRequestsUpdate(MegaContactRequestList *requests)
+MegaShareList *MegaApiImpl::getPendingOutShares()
 {
-    activeContactRequests = requests;
+    bool exclusive = lockRead();
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-    {
-        (*it)->onContactRequestsUpdate(api, requests);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-    {
-        (*it)->onContactRequestsUpdate(api, requests);
-    }
+    vector<Share *> vShares;
+    vector<handle> vHandles;
 
-    activeContactRequests = NULL;
+    getRootShares(client, &client->pendingsharenodes, true, &vShares, &vHandles);
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
+
+    unlockRead(exclusive);
+    return shareList;
 }
 
-void MegaApiImpl::fireOnNodesUpdate(MegaNodeList *nodes)
+MegaShareList *MegaApiImpl::getPendingOutShares(MegaNode *megaNode)
 {
-	activeNodes = nodes;
-
-	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    if(!megaNode)
     {
-        (*it)->onNodesUpdate(api, nodes);
+        return new MegaShareListPrivate();
     }
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node || !node->pendingshares())
     {
-        (*it)->onNodesUpdate(api, nodes);
+        unlockRead(exclusive);
+        return new MegaShareListPrivate();
     }
 
-    activeNodes = NULL;
-}
+    vector<Share*> vShares;
+    vector<handle> vHandles;
 
-void MegaApiImpl::fireOnAccountUpdate()
-{
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-    {
-        (*it)->onAccountUpdate(api);
-    }
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    for (share_map::iterator it = node->pendingshares()->begin(); it != node->pendingshares()->end(); it++)
     {
-        (*it)->onAccountUpdate(api);
+        vShares.push_back(it->second);
+        vHandles.push_back(node->nodehandle);
     }
-}
-
-void MegaApiImpl::fireOnReloadNeeded()
-{
-	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-		(*it)->onReloadNeeded(api);
 
-	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-		(*it)->onReloadNeeded(api);
+    MegaShareList *shareList = new MegaShareListPrivate(vShares.data(), vHandles.data(), vShares.size());
+    unlockRead(exclusive);
+    return shareList;
 }
 
-#ifdef ENABLE_SYNC
-void MegaApiImpl::fireOnSyncStateChanged(MegaSyncPrivate *sync)
+MegaContactRequestList *MegaApiImpl::getIncomingContactRequests()
 {
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onSyncStateChanged(api, sync);
-
-    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
-        (*it)->onSyncStateChanged(api, sync);
-
-    MegaSyncListener* listener = sync->getListener();
-    if(listener)
+    sdkMutex.lock();
+    vector<PendingContactRequest*> vContactRequests;
+    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
     {
-        listener->onSyncStateChanged(api, sync);
+        if(!it->second->isoutgoing)
+        {
+            vContactRequests.push_back(it->second);
+        }
     }
-}
 
-void MegaApiImpl::fireOnSyncEvent(MegaSyncPrivate *sync, MegaSyncEvent *event)
-{
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onSyncEvent(api, sync, event);
+    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
+    sdkMutex.unlock();
 
-    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
-        (*it)->onSyncEvent(api, sync, event);
+    return requestList;
+}
 
-    MegaSyncListener* listener = sync->getListener();
-    if(listener)
+MegaContactRequestList *MegaApiImpl::getOutgoingContactRequests()
+{
+    sdkMutex.lock();
+    vector<PendingContactRequest*> vContactRequests;
+    for (handlepcr_map::iterator it = client->pcrindex.begin(); it != client->pcrindex.end(); it++)
     {
-        listener->onSyncEvent(api, sync, event);
+        if(it->second->isoutgoing)
+        {
+            vContactRequests.push_back(it->second);
+        }
     }
 
-    delete event;
-}
-
-void MegaApiImpl::fireOnGlobalSyncStateChanged()
-{
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onGlobalSyncStateChanged(api);
+    MegaContactRequestList *requestList = new MegaContactRequestListPrivate(vContactRequests.data(), vContactRequests.size());
+    sdkMutex.unlock();
 
-    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
-        (*it)->onGlobalSyncStateChanged(api);
+    return requestList;
 }
 
-void MegaApiImpl::fireOnFileSyncStateChanged(MegaSyncPrivate *sync, const char *filePath, int newState)
+int MegaApiImpl::getAccess(MegaNode* megaNode)
 {
-    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
-        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
-
-    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
-        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+    if(!megaNode) return MegaShare::ACCESS_UNKNOWN;
 
-    MegaSyncListener* listener = sync->getListener();
-    if(listener)
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+    if(!node)
     {
-        listener->onSyncFileStateChanged(api, sync, filePath, newState);
+        unlockRead(exclusive);
+        return MegaShare::ACCESS_UNKNOWN;
     }
-}
-
-#endif
 
-MegaError MegaApiImpl::checkAccess(MegaNode* megaNode, int level)
-{
-    if(!megaNode || level < MegaShare::ACCESS_UNKNOWN || level > MegaShare::ACCESS_OWNER)
+    if (!client->loggedin())
     {
-        return MegaError(API_EARGS);
+        unlockRead(exclusive);
+        return MegaShare::ACCESS_READ;
     }
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return MegaError(API_ENOENT);
-	}
+    if(node->type > FOLDERNODE)
+    {
+        unlockRead(exclusive);
+        return MegaShare::ACCESS_OWNER;
+    }
 
+    Node *n = node;
     accesslevel_t a = OWNER;
-    switch(level)
+    while (n)
     {
-    	case MegaShare::ACCESS_UNKNOWN:
-    	case MegaShare::ACCESS_READ:
-    		a = RDONLY;
-    		break;
-    	case MegaShare::ACCESS_READWRITE:
-    		a = RDWR;
-    		break;
-    	case MegaShare::ACCESS_FULL:
-    		a = FULL;
-    		break;
-    	case MegaShare::ACCESS_OWNER:
-    		a = OWNER;
-    		break;
+        if (n->inshare()) { a = n->inshare()->access; break; }
+        n = n->parent;
     }
 
-	MegaError e(client->checkaccess(node, a) ? API_OK : API_EACCESS);
-    sdkMutex.unlock();
+    unlockRead(exclusive);
 
-	return e;
+    switch(a)
+    {
+        case RDONLY: return MegaShare::ACCESS_READ;
+        case RDWR: return MegaShare::ACCESS_READWRITE;
+        case FULL: return MegaShare::ACCESS_FULL;
+        default: return MegaShare::ACCESS_OWNER;
+    }
 }
 
-MegaError MegaApiImpl::checkMove(MegaNode* megaNode, MegaNode* targetNode)
+bool MegaApiImpl::processMegaTree(MegaNode* n, MegaTreeProcessor* processor, bool recursive)
 {
-	if(!megaNode || !targetNode) return MegaError(API_EARGS);
+	if(!n) return true;
+	if(!processor) return false;
 
     sdkMutex.lock();
-    Node *node = client->nodebyhandle(megaNode->getHandle());
-	Node *target = client->nodebyhandle(targetNode->getHandle());
-	if(!node || !target)
+	Node *node = client->nodebyhandle(n->getHandle());
+	if(!node)
 	{
         sdkMutex.unlock();
-        return MegaError(API_ENOENT);
+		return true;
 	}
 
-	MegaError e(client->checkmove(node,target));
-    sdkMutex.unlock();
-
-    return e;
-}
-
-bool MegaApiImpl::isFilesystemAvailable()
-{
-    sdkMutex.lock();
-    bool result = client->nodebyhandle(client->rootnodes[0]) != NULL;
-    sdkMutex.unlock();
-    return result;
-}
-
-bool MegaApiImpl::nodeComparatorDefaultASC (Node *i, Node *j)
-{
-    if(i->type < j->type) return 0;
-    if(i->type > j->type) return 1;
-    if(strcasecmp(i->displayname(), j->displayname())<=0) return 1;
-	return 0;
-}
-
-bool MegaApiImpl::nodeComparatorDefaultDESC (Node *i, Node *j)
-{
-    if(i->type < j->type) return 1;
-    if(i->type > j->type) return 0;
-    if(strcasecmp(i->displayname(), j->displayname())<=0) return 0;
-	return 1;
-}
-
-bool MegaApiImpl::nodeComparatorSizeASC (Node *i, Node *j)
-{ if(i->size < j->size) return 1; return 0;}
-bool MegaApiImpl::nodeComparatorSizeDESC (Node *i, Node *j)
-{ if(i->size < j->size) return 0; return 1;}
-
-bool MegaApiImpl::nodeComparatorCreationASC  (Node *i, Node *j)
-{ if(i->ctime < j->ctime) return 1; return 0;}
-bool MegaApiImpl::nodeComparatorCreationDESC  (Node *i, Node *j)
-{ if(i->ctime < j->ctime) return 0; return 1;}
-
-bool MegaApiImpl::nodeComparatorModificationASC  (Node *i, Node *j)
-{ if(i->mtime < j->mtime) return 1; return 0;}
-bool MegaApiImpl::nodeComparatorModificationDESC  (Node *i, Node *j)
-{ if(i->mtime < j->mtime) return 0; return 1;}
-
-bool MegaApiImpl::nodeComparatorAlphabeticalASC  (Node *i, Node *j)
-{ if(strcasecmp(i->displayname(), j->displayname())<=0) return 1; return 0; }
-bool MegaApiImpl::nodeComparatorAlphabeticalDESC  (Node *i, Node *j)
-{ if(strcasecmp(i->displayname(), j->displayname())<=0) return 0; return 1; }
-
-int MegaApiImpl::getNumChildren(MegaNode* p)
-{
-	if (!p) return 0;
-
-	sdkMutex.lock();
-	Node *parent = client->nodebyhandle(p->getHandle());
-	if (!parent)
+	if (node->type != FILENODE)
 	{
-		sdkMutex.unlock();
-		return 0;
+		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
+		{
+			MegaNode *megaNode = MegaNodePrivate::fromNode(*it++);
+			if(recursive)
+			{
+				if(!processMegaTree(megaNode,processor))
+				{
+					delete megaNode;
+                    sdkMutex.unlock();
+					return 0;
+				}
+			}
+			else
+			{
+				if(!processor->processMegaNode(megaNode))
+				{
+					delete megaNode;
+                    sdkMutex.unlock();
+					return 0;
+				}
+			}
+			delete megaNode;
+		}
 	}
+	bool result = processor->processMegaNode(n);
 
-	int numChildren = parent->children.size();
-	sdkMutex.unlock();
-
-	return numChildren;
+    sdkMutex.unlock();
+    return result;
 }
 
-int MegaApiImpl::getNumChildFiles(MegaNode* p)
+bool MegaApiImpl::processNodeViews(MegaNode* n, MegaNodeViewProcessor* processor, bool recursive)
 {
-	if (!p) return 0;
+    if(!n) return true;
+    if(!processor) return false;
 
-	sdkMutex.lock();
-	Node *parent = client->nodebyhandle(p->getHandle());
-	if (!parent)
-	{
-		sdkMutex.unlock();
-		return 0;
-	}
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node)
+    {
+        unlockRead(exclusive);
+        return true;
+    }
 
-	int numFiles = 0;
-	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-	{
-		if ((*it)->type == FILENODE)
-			numFiles++;
-	}
-	sdkMutex.unlock();
+    MegaNodeViewPrivate view;
+    bool result = processViewTree(node, &view, processor, recursive);
+    unlockRead(exclusive);
 
-	return numFiles;
+    return result;
 }
 
-int MegaApiImpl::getNumChildFolders(MegaNode* p)
+// same order as processMegaTree(): children (or subtrees) first, then the node
+bool MegaApiImpl::processViewTree(Node* node, MegaNodeViewPrivate* view, MegaNodeViewProcessor* processor, bool recursive)
 {
-	if (!p) return 0;
-
-	sdkMutex.lock();
-	Node *parent = client->nodebyhandle(p->getHandle());
-	if (!parent)
-	{
-		sdkMutex.unlock();
-		return 0;
-	}
-
-	int numFolders = 0;
-	for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
-	{
-		if ((*it)->type != FILENODE)
-			numFolders++;
-	}
-	sdkMutex.unlock();
+    if (node->type != FILENODE)
+    {
+        for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
+        {
+            if(recursive)
+            {
+                if(!processViewTree(*it, view, processor, true))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                view->setNode(*it);
+                if(!processor->processNodeView(view))
+                {
+                    return false;
+                }
+            }
+        }
+    }
 
-	return numFolders;
+    view->setNode(node);
+    return processor->processNodeView(view);
 }
 
-
-MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
+bool MegaApiImpl::processChildViews(MegaNode* p, MegaNodeViewProcessor* processor, int order)
 {
-    if(!p) return new MegaNodeListPrivate();
+    if(!p) return true;
+    if(!processor) return false;
 
-    sdkMutex.lock();
+    bool exclusive = lockRead();
     Node *parent = client->nodebyhandle(p->getHandle());
-	if(!parent)
-	{
-        sdkMutex.unlock();
-        return new MegaNodeListPrivate();
-	}
+    if(!parent)
+    {
+        unlockRead(exclusive);
+        return true;
+    }
 
-    vector<Node *> childrenNodes;
+    MegaNodeViewPrivate view;
+    bool result = true;
 
     if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
-	{
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-            childrenNodes.push_back(*it++);
-	}
-	else
-	{
-        bool (*comp)(Node*, Node*);
-		switch(order)
-		{
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-		}
-
-		for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
-		{
-            Node *n = *it++;
-            vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-					childrenNodes.end(), n, comp);
-            childrenNodes.insert(i, n);
-		}
-	}
-    sdkMutex.unlock();
+    {
+        for (node_list::iterator it = parent->children.begin(); result && it != parent->children.end(); it++)
+        {
+            view.setNode(*it);
+            result = processor->processNodeView(&view);
+        }
+    }
+    else
+    {
+        const node_vector *children = getSortedChildren(parent, order);
+        for (node_vector::const_iterator it = children->begin(); result && it != children->end(); it++)
+        {
+            view.setNode(*it);
+            result = processor->processNodeView(&view);
+        }
+    }
 
-    if(childrenNodes.size()) return new MegaNodeListPrivate(childrenNodes.data(), childrenNodes.size());
-    else return new MegaNodeListPrivate();
+    unlockRead(exclusive);
+    return result;
 }
 
-int MegaApiImpl::getIndex(MegaNode *n, int order)
+// the children of the node that match, each followed by its matches if
+// recursive - stops once cap matches were collected
+void MegaApiImpl::queryTree(Node *node, const NodeQueryFilter *filter, bool recursive, size_t cap, handle_vector *results)
 {
-    if(!n)
+    for (NodeChildren::const_iterator it = node->children.begin(); it != node->children.end() && results->size() < cap; it++)
     {
-        return -1;
+        if (filter->matches(*it))
+        {
+            results->push_back((*it)->nodehandle);
+        }
+
+        if (recursive && (*it)->type != FILENODE)
+        {
+            queryTree(*it, filter, recursive, cap, results);
+        }
     }
+}
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-    if(!node)
+// runs on the query threads: one child of the queried node and its subtree
+void MegaApiImpl::queryJob(unsigned i, void *param)
+{
+    QueryJob *job = (QueryJob *)param;
+    Node *node = (*job->roots)[i];
+    handle_vector *results = &job->results[i];
+
+    if (job->filter->matches(node))
     {
-        sdkMutex.unlock();
-        return -1;
+        results->push_back(node->nodehandle);
     }
 
-    Node *parent = node->parent;
-    if(!parent)
+    if (job->recursive && node->type != FILENODE)
     {
-        sdkMutex.unlock();
-        return -1;
+        queryTree(node, job->filter, job->recursive, job->cap, results);
     }
+}
 
-
-    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
+MegaHandleList *MegaApiImpl::queryNodes(MegaNode *n, MegaNodeQuery *query, int offset, int limit)
+{
+    if (!n || !query || offset < 0)
     {
-        sdkMutex.unlock();
-        return 0;
+        return new MegaHandleListPrivate();
     }
 
-    bool (*comp)(Node*, Node*);
-    switch(order)
+    NodeQueryFilter filter(query);
+    bool recursive = !query->isChildrenOnly();
+    size_t cap = (limit > 0) ? size_t(offset) + limit : ~(size_t)0;
+    handle_vector results;
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if (node)
     {
-        case MegaApi::ORDER_DEFAULT_ASC: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
-        case MegaApi::ORDER_DEFAULT_DESC: comp = MegaApiImpl::nodeComparatorDefaultDESC; break;
-        case MegaApi::ORDER_SIZE_ASC: comp = MegaApiImpl::nodeComparatorSizeASC; break;
-        case MegaApi::ORDER_SIZE_DESC: comp = MegaApiImpl::nodeComparatorSizeDESC; break;
-        case MegaApi::ORDER_CREATION_ASC: comp = MegaApiImpl::nodeComparatorCreationASC; break;
-        case MegaApi::ORDER_CREATION_DESC: comp = MegaApiImpl::nodeComparatorCreationDESC; break;
-        case MegaApi::ORDER_MODIFICATION_ASC: comp = MegaApiImpl::nodeComparatorModificationASC; break;
-        case MegaApi::ORDER_MODIFICATION_DESC: comp = MegaApiImpl::nodeComparatorModificationDESC; break;
-        case MegaApi::ORDER_ALPHABETICAL_ASC: comp = MegaApiImpl::nodeComparatorAlphabeticalASC; break;
-        case MegaApi::ORDER_ALPHABETICAL_DESC: comp = MegaApiImpl::nodeComparatorAlphabeticalDESC; break;
-        default: comp = MegaApiImpl::nodeComparatorDefaultASC; break;
+        if (exclusive)
+        {
+            // load and decrypt the subtree first, the threads must only
+            // read nodes
+            client->loadtree(node);
+            client->decryptnodes(node);
+        }
+
+        if (recursive && node->children.folders() > 1)
+        {
+            QueryJob job;
+            node_vector roots(node->children.begin(), node->children.end());
+
+            job.roots = &roots;
+            job.filter = &filter;
+            job.recursive = recursive;
+            job.cap = cap;
+            job.results.resize(roots.size());
+
+            MegaThreadRunner runner(QUERYTHREADS);
+            runner.run(roots.size(), queryJob, &job);
+
+            // concatenate in children order for a stable pagination
+            for (unsigned i = 0; i < job.results.size() && results.size() < cap; i++)
+            {
+                results.insert(results.end(), job.results[i].begin(), job.results[i].end());
+            }
+        }
+        else
+        {
+            queryTree(node, &filter, recursive, cap, &results);
+        }
     }
+    unlockRead(exclusive);
 
-    vector<Node *> childrenNodes;
-    for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); )
+    if ((size_t)offset >= results.size())
     {
-        Node *temp = *it++;
-        vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-                childrenNodes.end(), temp, comp);
-        childrenNodes.insert(i, temp);
+        return new MegaHandleListPrivate();
     }
 
-    vector<Node *>::iterator i = std::lower_bound(childrenNodes.begin(),
-            childrenNodes.end(), node, comp);
+    size_t count = std::min(results.size(), cap) - offset;
+    return new MegaHandleListPrivate(&results[offset], int(count));
+}
 
-    sdkMutex.unlock();
-    return i - childrenNodes.begin();
+MegaNode *MegaApiImpl::createPublicFileNode(MegaHandle handle, const char *key, const char *name, m_off_t size, m_off_t mtime, MegaHandle parentHandle, const char* auth)
+{
+    string nodekey;
+    string attrstring;
+    nodekey.resize(strlen(key) * 3 / 4 + 3);
+    nodekey.resize(Base64::atob(key, (byte *)nodekey.data(), nodekey.size()));
+    return new MegaNodePrivate(name, FILENODE, size, mtime, mtime, handle, &nodekey, &attrstring, parentHandle, auth);
 }
 
-MegaNode *MegaApiImpl::getChildNode(MegaNode *parent, const char* name)
+MegaNode *MegaApiImpl::createPublicFolderNode(MegaHandle handle, const char *name, MegaHandle parentHandle, const char *auth)
 {
-    if(!parent || !name)
+    string nodekey;
+    string attrstring;
+    return new MegaNodePrivate(name, FOLDERNODE, 0, 0, 0, handle, &nodekey, &attrstring, parentHandle, auth);
+}
+
+void MegaApiImpl::loadBalancing(const char* service, MegaRequestListener *listener)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOAD_BALANCING, listener);
+    request->setName(service);
+    if (requestQueue.push(request))
     {
-        return NULL;
+        waiter->notify();
     }
-
-    sdkMutex.lock();
-    Node *parentNode = client->nodebyhandle(parent->getHandle());
-	if(!parentNode)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
-
-    MegaNode *node = MegaNodePrivate::fromNode(client->childnodebyname(parentNode, name));
-    sdkMutex.unlock();
-    return node;
 }
 
-Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint)
+const char *MegaApiImpl::getVersion()
 {
-    if(!fingerprint || !fingerprint[0]) return NULL;
-
-    m_off_t size = 0;
-    unsigned int fsize = strlen(fingerprint);
-    unsigned int ssize = fingerprint[0] - 'A';
-    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
-        return NULL;
-
-    int len =  sizeof(size) + 1;
-    byte *buf = new byte[len];
-    Base64::atob(fingerprint + 1, buf, len);
-    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
-    delete [] buf;
-    if(l <= 0)
-        return NULL;
-
-    string sfingerprint = fingerprint + ssize + 1;
-
-    FileFingerprint fp;
-    if(!fp.unserializefingerprint(&sfingerprint))
-        return NULL;
+    return client->version();
+}
 
-    fp.size = size;
+const char *MegaApiImpl::getUserAgent()
+{
+    return client->useragent.c_str();
+}
 
+void MegaApiImpl::changeApiUrl(const char *apiURL, bool disablepkp)
+{
     sdkMutex.lock();
-    Node *n  = client->nodebyfingerprint(&fp);
+    MegaClient::APIURL = apiURL;
+    if(disablepkp)
+    {
+        MegaClient::disablepkp = true;
+    }
+    client->abortbackoff();
+    client->disconnect();
     sdkMutex.unlock();
-
-    return n;
 }
 
-Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint, Node *parent)
+bool MegaApiImpl::processTree(Node* node, TreeProcessor* processor, bool recursive)
 {
-    if(!fingerprint || !fingerprint[0]) return NULL;
+	if(!node) return 1;
+	if(!processor) return 0;
 
-    m_off_t size = 0;
-    unsigned int fsize = strlen(fingerprint);
-    unsigned int ssize = fingerprint[0] - 'A';
-    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
-        return NULL;
+    sdkMutex.lock();
+	node = client->nodebyhandle(node->nodehandle);
+	if(!node)
+	{
+        sdkMutex.unlock();
+		return 1;
+	}
 
-    int len =  sizeof(size) + 1;
-    byte *buf = new byte[len];
-    Base64::atob(fingerprint + 1, buf, len);
-    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
-    delete [] buf;
-    if(l <= 0)
-        return NULL;
+	if (node->type != FILENODE)
+	{
+		for (node_list::iterator it = node->children.begin(); it != node->children.end(); )
+		{
+			if(recursive)
+			{
+				if(!processTree(*it++,processor))
+				{
+                    sdkMutex.unlock();
+					return 0;
+				}
+			}
+			else
+			{
+				if(!processor->processNode(*it++))
+				{
+                    sdkMutex.unlock();
+					return 0;
+				}
+			}
+		}
+	}
+	bool result = processor->processNode(node);
 
-    string sfingerprint = fingerprint + ssize + 1;
+    sdkMutex.unlock();
+	return result;
+}
 
-    FileFingerprint fp;
-    if(!fp.unserializefingerprint(&sfingerprint))
-        return NULL;
+MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, bool recursive)
+{
+    return search(n, searchString, MegaApi::SEARCH_SUBSTRING, 0, recursive);
+}
+
+MegaNodeList* MegaApiImpl::search(MegaNode* n, const char* searchString, int matchType, int limit, bool recursive)
+{
+    if(!n || !searchString) return new MegaNodeListPrivate();
+
+    bool exclusive = lockRead();
+    if (nameIndex)
+    {
+        MegaNodeList *nodeList;
+        Node *node = client->nodebyhandle(n->getHandle());
+        if (node) nodeList = searchIndexed(node, searchString, matchType, limit, recursive);
+        else nodeList = new MegaNodeListPrivate();
 
-    fp.size = size;
+        unlockRead(exclusive);
+        return nodeList;
+    }
+    unlockRead(exclusive);
 
     sdkMutex.lock();
-    Node *n  = client->nodebyfingerprint(&fp);
-    if(n && parent && n->parent != parent)
+	Node *node = client->nodebyhandle(n->getHandle());
+	if(!node)
+	{
+        sdkMutex.unlock();
+        return new MegaNodeListPrivate();
+	}
+
+	SearchTreeProcessor searchProcessor(searchString, matchType, limit);
+	processTree(node, &searchProcessor, recursive);
+    vector<Node *>& vNodes = searchProcessor.getResults();
+
+    MegaNodeList *nodeList;
+    if(vNodes.size()) nodeList = new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+    else nodeList = new MegaNodeListPrivate();
+
+    sdkMutex.unlock();
+
+    return nodeList;
+}
+
+// matches from the name index restricted to the nodes processTree() would
+// visit: the node itself and its children or, if recursive, its subtree
+MegaNodeList* MegaApiImpl::searchIndexed(Node *node, const char *searchString, int matchType, int limit, bool recursive)
+{
+    handle_vector matches;
+    nameIndex->find(searchString, matchType, &matches);
+
+    vector<Node *> vNodes;
+    for (handle_vector::iterator it = matches.begin(); it != matches.end(); it++)
     {
-        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+        Node *n = client->nodebyhandle(*it);
+        if (!n)
         {
-            Node* node = (*it);
-            if(*((FileFingerprint *)node) == *((FileFingerprint *)n))
+            continue;
+        }
+
+        bool inside = (n == node || n->parent == node);
+        if (!inside && recursive)
+        {
+            for (Node *p = n->parent; p && !inside; p = p->parent)
+            {
+                inside = (p == node);
+            }
+        }
+
+        if (inside)
+        {
+            vNodes.push_back(n);
+            if (limit > 0 && vNodes.size() >= (size_t)limit)
+            {
+                break;
+            }
+        }
+    }
+
+    return new MegaNodeListPrivate(vNodes.data(), vNodes.size());
+}
+
+long long MegaApiImpl::getSize(MegaNode *n)
+{
+    if(!n) return 0;
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node)
+    {
+        unlockRead(exclusive);
+        return 0;
+    }
+    long long result = node->subtree.storage;
+    unlockRead(exclusive);
+
+    return result;
+}
+
+int MegaApiImpl::getNumTreeFiles(MegaNode *n)
+{
+    if(!n) return 0;
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+    int result = node ? node->subtree.files : 0;
+    unlockRead(exclusive);
+
+    return result;
+}
+
+long long MegaApiImpl::getMemoryUsage(int type)
+{
+    NodeMemoryUsage usage;
+
+    bool exclusive = lockRead();
+    client->nodememoryusage(&usage);
+    unlockRead(exclusive);
+
+    switch (type)
+    {
+        case MegaApi::MEMORY_TOTAL:
+            return usage.total();
+        case MegaApi::MEMORY_NODES:
+            return usage.nodes;
+        case MegaApi::MEMORY_NODE_INDEX:
+            return usage.nodeindex;
+        case MegaApi::MEMORY_FINGERPRINTS:
+            return usage.fingerprints;
+        case MegaApi::MEMORY_ATTRIBUTES:
+            return usage.attrs;
+        case MegaApi::MEMORY_STRINGS:
+            return usage.strings;
+        case MegaApi::MEMORY_CHILDREN:
+            return usage.children;
+        case MegaApi::MEMORY_SHARING:
+            return usage.sharing;
+        default:
+            return -1;
+    }
+}
+
+long long MegaApiImpl::getTransferBufferPoolStats(int type)
+{
+    long long result;
+
+    sdkMutex.lock();
+    ChunkBufferPool *pool = &client->chunkbuffers;
+
+    switch (type)
+    {
+        case MegaApi::BUFFER_POOL_REQUESTS:
+            result = pool->requests;
+            break;
+        case MegaApi::BUFFER_POOL_HITS:
+            result = pool->hits;
+            break;
+        case MegaApi::BUFFER_POOL_IN_USE:
+            result = pool->inuse;
+            break;
+        case MegaApi::BUFFER_POOL_IDLE:
+            result = pool->idle;
+            break;
+        case MegaApi::BUFFER_POOL_PEAK:
+            result = pool->peak;
+            break;
+        default:
+            result = -1;
+    }
+    sdkMutex.unlock();
+
+    return result;
+}
+
+void MegaApiImpl::setStreamingCacheSize(long long bytes)
+{
+    if (bytes < 0)
+    {
+        return;
+    }
+
+    sdkMutex.lock();
+    client->drcache.setmaxbytes(bytes);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setStreamingConnections(int connections)
+{
+    if (connections < 1)
+    {
+        return;
+    }
+
+    sdkMutex.lock();
+    client->drconnections = connections;
+    sdkMutex.unlock();
+}
+
+bool MegaApiImpl::httpServerStart(bool localOnly, int port)
+{
+#ifndef _WIN32
+    if (httpServer)
+    {
+        return httpServer->getPort() == port;
+    }
+
+    httpServer = new MegaHTTPServer(this);
+    if (!httpServer->start(port, localOnly))
+    {
+        delete httpServer;
+        httpServer = NULL;
+        return false;
+    }
+    return true;
+#else
+    LOG_warn << "The HTTP server is not available on this platform";
+    return false;
+#endif
+}
+
+void MegaApiImpl::httpServerStop()
+{
+#ifndef _WIN32
+    delete httpServer;
+    httpServer = NULL;
+#endif
+}
+
+int MegaApiImpl::httpServerIsRunning()
+{
+#ifndef _WIN32
+    return httpServer ? httpServer->getPort() : 0;
+#else
+    return 0;
+#endif
+}
+
+char *MegaApiImpl::httpServerGetLocalLink(MegaNode *node)
+{
+#ifndef _WIN32
+    if (!httpServer || !node || node->getType() != MegaNode::TYPE_FILE)
+    {
+        return NULL;
+    }
+
+    httpServer->allow(node->getHandle());
+
+    char *base64Handle = handleToBase64(node->getHandle());
+    ostringstream link;
+    link << "http://127.0.0.1:" << httpServer->getPort() << "/" << base64Handle << "/";
+    delete [] base64Handle;
+
+    for (const char *p = node->getName(); p && *p; p++)
+    {
+        unsigned char ch = *p;
+        if (isalnum(ch) || strchr("-._~", ch))
+        {
+            link << ch;
+        }
+        else
+        {
+            link << '%' << "0123456789ABCDEF"[ch >> 4] << "0123456789ABCDEF"[ch & 15];
+        }
+    }
+
+    return MegaApi::strdup(link.str().c_str());
+#else
+    return NULL;
+#endif
+}
+
+long long MegaApiImpl::getStreamingCacheStats(int type)
+{
+    long long result;
+
+    sdkMutex.lock();
+    DirectReadCache *cache = &client->drcache;
+
+    switch (type)
+    {
+        case MegaApi::STREAMING_CACHE_HITS:
+            result = cache->hits;
+            break;
+        case MegaApi::STREAMING_CACHE_MISSES:
+            result = cache->misses;
+            break;
+        case MegaApi::STREAMING_CACHE_SIZE:
+            result = cache->bytes;
+            break;
+        default:
+            result = -1;
+    }
+    sdkMutex.unlock();
+
+    return result;
+}
+
+long long MegaApiImpl::getKeyResolutionStats(int type)
+{
+    long long result;
+
+    sdkMutex.lock();
+    switch (type)
+    {
+        case MegaApi::KEY_STATS_RSA_DECRYPTIONS:
+            result = client->rsadecrypts;
+            break;
+        case MegaApi::KEY_STATS_RSA_PARALLEL:
+            result = client->rsaparallel;
+            break;
+        case MegaApi::KEY_STATS_RSA_CACHE_HITS:
+            result = client->rsacachehits;
+            break;
+        case MegaApi::KEY_STATS_TIME:
+            result = client->keytime;
+            break;
+        default:
+            result = -1;
+    }
+    sdkMutex.unlock();
+
+    return result;
+}
+
+long long MegaApiImpl::onLowMemory(int level)
+{
+    long long freed;
+
+    if (level != MegaApi::LOW_MEMORY_MODERATE && level != MegaApi::LOW_MEMORY_CRITICAL)
+    {
+        return 0;
+    }
+
+    sdkMutex.lock();
+    freed = pathCache.allocated();
+    pathCache.clear();
+    freed += client->trimmemory(level == MegaApi::LOW_MEMORY_CRITICAL ? MegaClient::TRIM_ALL
+                                                                       : MegaClient::TRIM_CACHES);
+    sdkMutex.unlock();
+
+    return freed;
+}
+
+void MegaApiImpl::setNodePaging(bool enable)
+{
+    sdkMutex.lock();
+    client->pagednodes = enable;
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::setOfflineStartup(bool enable)
+{
+    sdkMutex.lock();
+    client->offlinestart = enable;
+    sdkMutex.unlock();
+}
+
+int MegaApiImpl::getNumTreeFolders(MegaNode *n)
+{
+    if(!n) return 0;
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+    int result = (node && node->type != FILENODE) ? node->subtree.folders - 1 : 0;
+    unlockRead(exclusive);
+
+    return result;
+}
+
+char *MegaApiImpl::getFingerprint(const char *filePath)
+{
+    if(!filePath) return NULL;
+
+    string path = filePath;
+    string localpath;
+    fsAccess->path2local(&path, &localpath);
+
+    FileAccess *fa = fsAccess->newfileaccess();
+    if(!fa->fopen(&localpath, true, false))
+        return NULL;
+
+    FileFingerprint fp;
+    fp.genfingerprint(fa);
+    m_off_t size = fa->size;
+    delete fa;
+    if(fp.size < 0)
+        return NULL;
+
+    string fingerprint;
+    fp.serializefingerprint(&fingerprint);
+
+    char bsize[sizeof(size)+1];
+    int l = Serialize64::serialize((byte *)bsize, size);
+    char *buf = new char[l * 4 / 3 + 4];
+    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+
+    string result(1, ssize);
+    result.append(buf);
+    result.append(fingerprint);
+    delete [] buf;
+
+    return MegaApi::strdup(result.c_str());
+}
+
+char *MegaApiImpl::getFingerprint(MegaNode *n)
+{
+    if(!n) return NULL;
+
+    sdkMutex.lock();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
+    {
+        sdkMutex.unlock();
+        return NULL;
+    }
+
+    string result;
+    getNodeFingerprint(node, &result);
+    sdkMutex.unlock();
+
+    return MegaApi::strdup(result.c_str());
+}
+
+// size-prefixed fingerprint as returned by getFingerprint()
+void MegaApiImpl::getNodeFingerprint(Node *node, string *result)
+{
+    string fingerprint;
+    node->serializefingerprint(&fingerprint);
+    m_off_t size = node->size;
+
+    char bsize[sizeof(size)+1];
+    int l = Serialize64::serialize((byte *)bsize, size);
+    char *buf = new char[l * 4 / 3 + 4];
+    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+    result->assign(1, ssize);
+    result->append(buf);
+    result->append(fingerprint);
+    delete [] buf;
+}
+
+// the reverse of getNodeFingerprint()
+bool MegaApiImpl::parseFingerprint(const char *fingerprint, FileFingerprint *fp)
+{
+    if(!fingerprint || !fingerprint[0]) return false;
+
+    m_off_t size = 0;
+    unsigned int fsize = strlen(fingerprint);
+    unsigned int ssize = fingerprint[0] - 'A';
+    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
+        return false;
+
+    int len =  sizeof(size) + 1;
+    byte *buf = new byte[len];
+    Base64::atob(fingerprint + 1, buf, len);
+    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
+    delete [] buf;
+    if(l <= 0)
+        return false;
+
+    string sfingerprint = fingerprint + ssize + 1;
+
+    if(!fp->unserializefingerprint(&sfingerprint))
+        return false;
+
+    fp->size = size;
+    return true;
+}
+
+char *MegaApiImpl::getFingerprint(MegaInputStream *inputStream, int64_t mtime)
+{
+    if(!inputStream) return NULL;
+
+    ExternalInputStream is(inputStream);
+    m_off_t size = is.size();
+    if(size < 0)
+        return NULL;
+
+    FileFingerprint fp;
+    fp.genfingerprint(&is, mtime);
+
+    if(fp.size < 0)
+        return NULL;
+
+    string fingerprint;
+    fp.serializefingerprint(&fingerprint);
+
+    char bsize[sizeof(size)+1];
+    int l = Serialize64::serialize((byte *)bsize, size);
+    char *buf = new char[l * 4 / 3 + 4];
+    char ssize = 'A' + Base64::btoa((const byte *)bsize, l, buf);
+
+    string result(1, ssize);
+    result.append(buf);
+    result.append(fingerprint);
+    delete [] buf;
+
+    return MegaApi::strdup(result.c_str());
+}
+
+MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint)
+{
+    if(!fingerprint) return NULL;
+
+    MegaNode *result;
+    sdkMutex.lock();
+    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint));
+    sdkMutex.unlock();
+    return result;
+}
+
+MegaNode *MegaApiImpl::getNodeByFingerprint(const char *fingerprint, MegaNode* parent)
+{
+    if(!fingerprint) return NULL;
+
+    MegaNode *result;
+    sdkMutex.lock();
+    Node *p = NULL;
+    if(parent)
+    {
+        p = client->nodebyhandle(parent->getHandle());
+    }
+
+    result = MegaNodePrivate::fromNode(getNodeByFingerprintInternal(fingerprint, p));
+    sdkMutex.unlock();
+    return result;
+}
+
+bool MegaApiImpl::hasFingerprint(const char *fingerprint)
+{
+    return (getNodeByFingerprintInternal(fingerprint) != NULL);
+}
+
+char *MegaApiImpl::getCRC(const char *filePath)
+{
+    if(!filePath) return NULL;
+
+    string path = filePath;
+    string localpath;
+    fsAccess->path2local(&path, &localpath);
+
+    FileAccess *fa = fsAccess->newfileaccess();
+    if(!fa->fopen(&localpath, true, false))
+        return NULL;
+
+    FileFingerprint fp;
+    fp.genfingerprint(fa);
+    delete fa;
+    if(fp.size < 0)
+        return NULL;
+
+    string result;
+    result.resize((sizeof fp.crc) * 4 / 3 + 4);
+    result.resize(Base64::btoa((const byte *)fp.crc, sizeof fp.crc, (char*)result.c_str()));
+    return MegaApi::strdup(result.c_str());
+}
+
+char *MegaApiImpl::getCRCFromFingerprint(const char *fingerprint)
+{
+    if(!fingerprint || !fingerprint[0]) return NULL;
+    
+    m_off_t size = 0;
+    unsigned int fsize = strlen(fingerprint);
+    unsigned int ssize = fingerprint[0] - 'A';
+    if(ssize > (sizeof(size) * 4 / 3 + 4) || fsize <= (ssize + 1))
+        return NULL;
+    
+    int len =  sizeof(size) + 1;
+    byte *buf = new byte[len];
+    Base64::atob(fingerprint + 1, buf, len);
+    int l = Serialize64::unserialize(buf, len, (uint64_t *)&size);
+    delete [] buf;
+    if(l <= 0)
+        return NULL;
+    
+    string sfingerprint = fingerprint + ssize + 1;
+    
+    FileFingerprint fp;
+    if(!fp.unserializefingerprint(&sfingerprint))
+    {
+        return NULL;
+    }
+    
+    string result;
+    result.resize((sizeof fp.crc) * 4 / 3 + 4);
+    result.resize(Base64::btoa((const byte *)fp.crc, sizeof fp.crc,(char*)result.c_str()));
+    return MegaApi::strdup(result.c_str());
+}
+
+char *MegaApiImpl::getCRC(MegaNode *n)
+{
+    if(!n) return NULL;
+
+    sdkMutex.lock();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node || node->type != FILENODE || node->size < 0 || !node->isvalid)
+    {
+        sdkMutex.unlock();
+        return NULL;
+    }
+
+    string result;
+    result.resize((sizeof node->crc) * 4 / 3 + 4);
+    result.resize(Base64::btoa((const byte *)node->crc, sizeof node->crc, (char*)result.c_str()));
+
+    sdkMutex.unlock();
+    return MegaApi::strdup(result.c_str());
+}
+
+MegaNode *MegaApiImpl::getNodeByCRC(const char *crc, MegaNode *parent)
+{
+    if(!parent) return NULL;
+
+    sdkMutex.lock();
+    Node *node = client->nodebyhandle(parent->getHandle());
+    if(!node || node->type == FILENODE)
+    {
+        sdkMutex.unlock();
+        return NULL;
+    }
+
+    byte binarycrc[sizeof(node->crc)];
+    Base64::atob(crc, binarycrc, sizeof(binarycrc));
+
+    for (node_list::iterator it = node->children.begin(); it != node->children.end(); it++)
+    {
+        Node *child = (*it);
+        if(!memcmp(child->crc, binarycrc, sizeof(node->crc)))
+        {
+            MegaNode *result = MegaNodePrivate::fromNode(child);
+            sdkMutex.unlock();
+            return result;
+        }
+    }
+
+    sdkMutex.unlock();
+    return NULL;
+}
+
+SearchTreeProcessor::SearchTreeProcessor(const char *search, int matchType, int limit)
+{
+    this->search = search;
+    this->matchType = matchType;
+    this->limit = limit;
+}
+
+#if defined(_WIN32) || defined(__APPLE__)
+
+char *strcasestr(const char *string, const char *substring)
+{
+	int i, j;
+	for (i = 0; string[i]; i++)
+	{
+		for (j = 0; substring[j]; j++)
+		{
+			unsigned char c1 = string[i + j];
+			if (!c1)
+				return NULL;
+
+			unsigned char c2 = substring[j];
+			if (toupper(c1) != toupper(c2))
+				break;
+		}
+
+		if (!substring[j])
+			return (char *)string + i;
+	}
+	return NULL;
+}
+
+#endif
+
+bool SearchTreeProcessor::matches(const char *name, const char *search, int matchType)
+{
+    switch (matchType)
+    {
+        case MegaApi::SEARCH_PREFIX:
+            return !strncasecmp(name, search, strlen(search));
+
+        case MegaApi::SEARCH_EXTENSION:
+        {
+            const char *ext = (*search == '.') ? search + 1 : search;
+            size_t namelen = strlen(name);
+            size_t extlen = strlen(ext);
+            return extlen && namelen > extlen + 1 && name[namelen - extlen - 1] == '.'
+                    && !strcasecmp(name + namelen - extlen, ext);
+        }
+
+        default:
+            return strcasestr(name, search) != NULL;
+    }
+}
+
+bool SearchTreeProcessor::processNode(Node* node)
+{
+	if(!node) return true;
+	if(!search) return false;
+
+	if(matches(node->displayname(), search, matchType))
+		results.push_back(node);
+
+    // a false return stops the tree exploration
+    return limit <= 0 || results.size() < (size_t)limit;
+}
+
+vector<Node *> &SearchTreeProcessor::getResults()
+{
+	return results;
+}
+
+NodeQueryFilter::NodeQueryFilter(MegaNodeQuery *query)
+{
+    type = query->getType();
+    hasName = (query->getName() != NULL);
+    name = hasName ? query->getName() : "";
+    matchType = query->getMatchType();
+    minSize = query->getMinSize();
+    maxSize = query->getMaxSize();
+    minCtime = query->getMinCreationTime();
+    maxCtime = query->getMaxCreationTime();
+    minMtime = query->getMinModificationTime();
+    maxMtime = query->getMaxModificationTime();
+    thumbnail = query->getThumbnail();
+    preview = query->getPreview();
+    shareState = query->getShareState();
+}
+
+// cheap integer checks first, the name last
+bool NodeQueryFilter::matches(Node *node) const
+{
+    if (type >= 0 && node->type != type)
+    {
+        return false;
+    }
+
+    if (minSize >= 0 || maxSize >= 0 || minMtime >= 0 || maxMtime >= 0)
+    {
+        if (node->type != FILENODE
+                || (minSize >= 0 && node->size < minSize)
+                || (maxSize >= 0 && node->size > maxSize)
+                || (minMtime >= 0 && node->mtime < minMtime)
+                || (maxMtime >= 0 && node->mtime > maxMtime))
+        {
+            return false;
+        }
+    }
+
+    if ((minCtime >= 0 && node->ctime < minCtime) || (maxCtime >= 0 && node->ctime > maxCtime))
+    {
+        return false;
+    }
+
+    if ((thumbnail >= 0 && (node->hasfileattribute(0) != 0) != (thumbnail != 0))
+            || (preview >= 0 && (node->hasfileattribute(1) != 0) != (preview != 0)))
+    {
+        return false;
+    }
+
+    if (shareState != MegaNodeQuery::SHARE_ANY)
+    {
+        // same definitions as MegaNode::isOutShare, isInShare and isExported
+        share_map *outshares = node->outshares();
+        bool outshare = outshares && (outshares->size() > 1 || outshares->begin()->second->user);
+        bool inshare = node->inshare() && !node->parent;
+        bool exported = node->plink() != NULL;
+
+        switch (shareState)
+        {
+            case MegaNodeQuery::SHARE_NONE:
+                if (outshare || inshare || exported) return false;
+                break;
+            case MegaNodeQuery::SHARE_OUTSHARE:
+                if (!outshare) return false;
+                break;
+            case MegaNodeQuery::SHARE_INSHARE:
+                if (!inshare) return false;
+                break;
+            case MegaNodeQuery::SHARE_EXPORTED:
+                if (!exported) return false;
+                break;
+        }
+    }
+
+    return !hasName || SearchTreeProcessor::matches(node->displayname(), name.c_str(), matchType);
+}
+
+SizeProcessor::SizeProcessor()
+{
+    totalBytes=0;
+}
+
+bool SizeProcessor::processNode(Node *node)
+{
+    if(node->type == FILENODE)
+        totalBytes += node->size;
+    return true;
+}
+
+long long SizeProcessor::getTotalBytes()
+{
+    return totalBytes;
+}
+
+void MegaApiImpl::transfer_added(Transfer *t)
+{
+	MegaTransferPrivate *transfer = currentTransfer;
+    if(!transfer)
+    {
+        transfer = new MegaTransferPrivate(t->type);
+        transfer->setSyncTransfer(true);
+    }
+
+	currentTransfer = NULL;
+    transfer->setTransfer(t);
+    transfer->setTotalBytes(t->size);
+    transfer->setTag(t->tag);
+	transferMap[t->tag]=transfer;
+
+    if (t->type == GET)
+    {
+        totalDownloads++;
+        pendingDownloads++;
+    }
+    else
+    {
+        totalUploads++;
+        pendingUploads++;
+    }
+
+    fireOnTransferStart(transfer);
+}
+
+void MegaApiImpl::transfer_removed(Transfer *t)
+{
+    if(transferMap.find(t->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+    if(!transfer)
+    {
+        return;
+    }
+
+    if (t->type == GET)
+    {
+        if(pendingDownloads > 0)
+            pendingDownloads--;
+
+        if(totalDownloads > 0)
+            totalDownloads--;
+    }
+    else
+    {
+        if(pendingUploads > 0)
+            pendingUploads--;
+
+        if(totalUploads > 0)
+            totalUploads--;
+    }
+
+    fireOnTransferFinish(transfer, MegaError(transfer->getLastErrorCode()));
+}
+
+void MegaApiImpl::transfer_prepare(Transfer *t)
+{
+    if(transferMap.find(t->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+
+	if (t->type == GET)
+		transfer->setNodeHandle(t->files.back()->h);
+
+    transfer->setTiming(MegaTransfer::TIMING_STARTED);
+
+    string path;
+    fsAccess->local2path(&(t->files.back()->localname), &path);
+    transfer->setPath(path.c_str());
+    transfer->setTotalBytes(t->size);
+
+    LOG_info << "Transfer (" << transfer->getTransferString() << ") starting. File: " << transfer->getFileName();
+}
+
+void MegaApiImpl::transfer_update(Transfer *tr)
+{
+    if(transferMap.find(tr->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
+    if(!transfer)
+    {
+        return;
+    }
+
+    if(tr->slot)
+    {
+        if((Waiter::ds - transfer->getUpdateTime() >= transferUpdateInterval) || !tr->slot->progressreported || (tr->slot->progressreported == tr->size))
+        {
+            if(!transfer->getStartTime())
+            {
+                transfer->setStartTime(Waiter::ds);
+            }
+
+            m_off_t deltaSize = tr->slot->progressreported - transfer->getTransferredBytes();
+            transfer->setDeltaSize(deltaSize);
+
+            dstime currentTime = Waiter::ds;
+            long long speed = 0;
+            if(tr->type == GET)
+            {
+                totalDownloadedBytes += deltaSize;
+
+                while(downloadBytes.size())
+                {
+                    dstime deltaTime = currentTime - downloadTimes[0];
+                    if(deltaTime <= 50)
+                    {
+                        break;
+                    }
+
+                    downloadPartialBytes -= downloadBytes[0];
+                    downloadBytes.erase(downloadBytes.begin());
+                    downloadTimes.erase(downloadTimes.begin());
+                }
+
+                downloadBytes.push_back(deltaSize);
+                downloadTimes.push_back(currentTime);
+                downloadPartialBytes += deltaSize;
+
+                downloadSpeed = (downloadPartialBytes * 10) / 50;
+                speed = downloadSpeed;
+            }
+            else
+            {
+                totalUploadedBytes += deltaSize;
+
+                while(uploadBytes.size())
+                {
+                    dstime deltaTime = currentTime - uploadTimes[0];
+                    if(deltaTime <= 50)
+                    {
+                        break;
+                    }
+
+                    uploadPartialBytes -= uploadBytes[0];
+                    uploadBytes.erase(uploadBytes.begin());
+                    uploadTimes.erase(uploadTimes.begin());
+                }
+
+                uploadBytes.push_back(deltaSize);
+                uploadTimes.push_back(currentTime);
+                uploadPartialBytes += deltaSize;
+
+                uploadSpeed = (uploadPartialBytes * 10) / 50;
+                speed = uploadSpeed;
+            }
+
+            transfer->setTransferredBytes(tr->slot->progressreported);
+
+            if(currentTime < transfer->getStartTime())
+                transfer->setStartTime(currentTime);
+
+            transfer->setSpeed(speed);
+            transfer->setUpdateTime(currentTime);
+
+            fireOnTransferUpdate(transfer);
+        }
+	}
+}
+
+void MegaApiImpl::transfer_failed(Transfer* tr, error e)
+{
+    if(transferMap.find(tr->tag) == transferMap.end()) return;
+    MegaError megaError(e);
+    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
+    transfer->setUpdateTime(Waiter::ds);
+    transfer->setDeltaSize(0);
+    transfer->setSpeed(0);
+    transfer->setLastErrorCode(e);
+    fireOnTransferTemporaryError(transfer, megaError);
+}
+
+void MegaApiImpl::transfer_limit(Transfer* t)
+{
+    if(transferMap.find(t->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(t->tag);
+    transfer->setUpdateTime(Waiter::ds);
+    transfer->setDeltaSize(0);
+    transfer->setSpeed(0);
+    fireOnTransferTemporaryError(transfer, MegaError(API_EOVERQUOTA));
+}
+
+void MegaApiImpl::transfer_complete(Transfer* tr)
+{
+    if(transferMap.find(tr->tag) == transferMap.end()) return;
+    MegaTransferPrivate* transfer = transferMap.at(tr->tag);
+
+    dstime currentTime = Waiter::ds;
+    if(!transfer->getStartTime())
+        transfer->setStartTime(currentTime);
+    if(currentTime<transfer->getStartTime())
+        transfer->setStartTime(currentTime);
+
+    transfer->setUpdateTime(currentTime);
+
+    if(tr->size != transfer->getTransferredBytes())
+    {
+        long long speed = 0;
+        long long deltaTime = currentTime-transfer->getStartTime();
+        if(deltaTime<=0)
+            deltaTime = 1;
+        if(transfer->getTotalBytes()>0)
+            speed = (10*transfer->getTotalBytes())/deltaTime;
+
+        transfer->setSpeed(speed);
+        transfer->setDeltaSize(tr->size - transfer->getTransferredBytes());
+        if(tr->type == GET)
+            totalDownloadedBytes += transfer->getDeltaSize();
+        else
+            totalUploadedBytes += transfer->getDeltaSize();
+
+        transfer->setTransferredBytes(tr->size);
+    }
+
+    if (tr->type == GET)
+    {
+        if(pendingDownloads > 0)
+            pendingDownloads--;
+
+        string path;
+        fsAccess->local2path(&tr->localfilename, &path);
+        transfer->setPath(path.c_str());
+
+        fireOnTransferFinish(transfer, MegaError(API_OK));
+    }
+    else
+    {
+        if(tr->size != transfer->getTransferredBytes())
+        {
+            fireOnTransferUpdate(transfer);
+        }
+    }
+}
+
+dstime MegaApiImpl::pread_failure(error e, int retry, void* param)
+{
+	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
+	transfer->setUpdateTime(Waiter::ds);
+	transfer->setDeltaSize(0);
+	transfer->setSpeed(0);
+	transfer->setLastBytes(NULL);
+	if (retry < transfer->getMaxRetries())
+	{
+        fireOnTransferTemporaryError(transfer, MegaError(e));
+		return (dstime)(retry*10);
+	}
+	else
+	{
+        fireOnTransferFinish(transfer, MegaError(e));
+		return ~(dstime)0;
+	}
+}
+
+bool MegaApiImpl::pread_data(byte *buffer, m_off_t len, m_off_t pos, void* param)
+{
+	MegaTransferPrivate *transfer = (MegaTransferPrivate *)param;
+    MegaStreamingRing *ring = transfer->getStreamingRing();
+	transfer->setUpdateTime(Waiter::ds);
+    transfer->setLastBytes(ring ? NULL : (char *)buffer);
+    transfer->setDeltaSize(len);
+    totalDownloadedBytes += len;
+	transfer->setTransferredBytes(transfer->getTransferredBytes()+len);
+
+	bool end = (transfer->getTransferredBytes() == transfer->getTotalBytes());
+
+    if (ring)
+    {
+        fillStreamingBuffers(transfer, ring, (const char *)buffer, len, pos);
+
+        // progress is reported apart from the data, at most once per second
+        if (end || Waiter::ds - ring->lastUpdate >= 10)
+        {
+            ring->lastUpdate = Waiter::ds;
+            fireOnTransferUpdate(transfer);
+        }
+
+        if (end)
+        {
+            if (ring->overflow.size())
+            {
+                ring->finishing = true;
+            }
+            else
+            {
+                fireOnTransferFinish(transfer, MegaError(API_OK));
+            }
+        }
+        return true;
+    }
+
+    if (transferUpdateInterval <= 1)
+    {
+        fireOnTransferUpdate(transfer);
+    }
+    else if (end || Waiter::ds - transfer->getReportedTime() >= transferUpdateInterval)
+    {
+        // throttled: the update carries the bytes since the previous one,
+        // the data itself goes to onTransferData only
+        transfer->setLastBytes(NULL);
+        transfer->setDeltaSize(transfer->getTransferredBytes() - transfer->getReportedBytes());
+        transfer->setReported(transfer->getTransferredBytes(), Waiter::ds);
+        fireOnTransferUpdate(transfer);
+        transfer->setLastBytes((char *)buffer);
+        transfer->setDeltaSize(len);
+    }
+
+    if(!fireOnTransferData(transfer) || end)
+	{
+        fireOnTransferFinish(transfer, end ? MegaError(API_OK) : MegaError(API_EINCOMPLETE));
+		return end;
+	}
+    return true;
+}
+
+void MegaApiImpl::reportevent_result(error e)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_REPORT_EVENT)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::loadbalancing_result(string *servers, error e)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_LOAD_BALANCING)) return;
+
+    if(!e)
+    {
+        request->setText(servers->c_str());
+    }
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::sessions_killed(handle, error e)
+{
+    MegaError megaError(e);
+
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_KILL_SESSION)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::cleanrubbishbin_result(error e)
+{
+    MegaError megaError(e);
+
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CLEAN_RUBBISH_BIN)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+#ifdef ENABLE_SYNC
+void MegaApiImpl::syncupdate_state(Sync *sync, syncstate_t newstate)
+{
+    LOG_debug << "Sync state change: " << newstate << " Path: " << sync->localroot.name;
+    client->abortbackoff(false);
+
+    if(newstate == SYNC_FAILED)
+    {
+        MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_ADD_SYNC);
+
+        if(sync->localroot.node)
+        {
+            request->setNodeHandle(sync->localroot.node->nodehandle);
+        }
+
+        int nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+        requestMap[nextTag]=request;
+        fireOnRequestFinish(request, MegaError(sync->errorcode));
+    }
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+    megaSync->setState(newstate);
+
+    fireOnSyncStateChanged(megaSync);
+}
+
+void MegaApiImpl::syncupdate_scanning(bool scanning)
+{
+    if(client)
+    {
+        client->abortbackoff(false);
+        client->syncscanstate = scanning;
+    }
+    fireOnGlobalSyncStateChanged();
+}
+
+void MegaApiImpl::syncupdate_local_folder_addition(Sync *sync, LocalNode *localNode, const char* path)
+{
+    LOG_debug << "Sync - local folder addition detected: " << path;
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_ADITION);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_local_folder_deletion(Sync *sync, LocalNode *localNode)
+{
+    client->abortbackoff(false);
+
+    string local;
+    string path;
+    localNode->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+    LOG_debug << "Sync - local folder deletion detected: " << path.c_str();
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FOLDER_DELETION);
+    event->setPath(path.c_str());
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_local_file_addition(Sync *sync, LocalNode *localNode, const char* path)
+{
+    LOG_debug << "Sync - local file addition detected: " << path;
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_ADDITION);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_local_file_deletion(Sync *sync, LocalNode *localNode)
+{
+    client->abortbackoff(false);
+
+    string local;
+    string path;
+    localNode->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+    LOG_debug << "Sync - local file deletion detected: " << path.c_str();
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_DELETION);
+    event->setPath(path.c_str());
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_local_file_change(Sync *sync, LocalNode *localNode, const char* path)
+{
+    LOG_debug << "Sync - local file change detected: " << path;
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_FILE_CHANGED);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_local_move(Sync *sync, LocalNode *localNode, const char *to)
+{
+    client->abortbackoff(false);
+
+    string local;
+    string path;
+    localNode->getlocalpath(&local, true);
+    fsAccess->local2path(&local, &path);
+    LOG_debug << "Sync - local rename/move " << path.c_str() << " -> " << to;
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_LOCAL_MOVE);
+    event->setPath(path.c_str());
+    event->setNewPath(to);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_get(Sync *sync, Node* node, const char *path)
+{
+    LOG_debug << "Sync - requesting file " << path;
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_GET);
+    event->setNodeHandle(node->nodehandle);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_put(Sync *sync, LocalNode *localNode, const char *path)
+{
+    LOG_debug << "Sync - sending file " << path;
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_FILE_PUT);
+    event->setPath(path);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_remote_file_addition(Sync *sync, Node *n)
+{
+    LOG_debug << "Sync - remote file addition detected " << n->displayname();
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_ADDITION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_remote_file_deletion(Sync *sync, Node *n)
+{
+    LOG_debug << "Sync - remote file deletion detected " << n->displayname();
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FILE_DELETION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_remote_folder_addition(Sync *sync, Node *n)
+{
+    LOG_debug << "Sync - remote folder addition detected " << n->displayname();
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_ADDITION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_remote_folder_deletion(Sync *sync, Node *n)
+{
+    LOG_debug << "Sync - remote folder deletion detected " << n->displayname();
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_FOLDER_DELETION);
+    event->setNodeHandle(n->nodehandle);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_remote_copy(Sync *, const char *name)
+{
+    LOG_debug << "Sync - creating remote file " << name << " by copying existing remote file";
+    client->abortbackoff(false);
+}
+
+void MegaApiImpl::syncupdate_remote_move(Sync *sync, Node *n, Node *prevparent)
+{
+    LOG_debug << "Sync - remote move " << n->displayname() <<
+                 " from " << (prevparent ? prevparent->displayname() : "?") <<
+                 " to " << (n->parent ? n->parent->displayname() : "?");
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_MOVE);
+    event->setNodeHandle(n->nodehandle);
+    event->setPrevParent(prevparent ? prevparent->nodehandle : UNDEF);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_remote_rename(Sync *sync, Node *n, const char *prevname)
+{
+    LOG_debug << "Sync - remote rename from " << prevname << " to " << n->displayname();
+    client->abortbackoff(false);
+
+    if(syncMap.find(sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(sync->tag);
+
+    MegaSyncEventPrivate *event = new MegaSyncEventPrivate(MegaSyncEvent::TYPE_REMOTE_RENAME);
+    event->setNodeHandle(n->nodehandle);
+    event->setPrevName(prevname);
+    fireOnSyncEvent(megaSync, event);
+}
+
+void MegaApiImpl::syncupdate_treestate(LocalNode *l)
+{
+    string local;
+    string path;
+    l->getlocalpath(&local, true);
+    syncStateIndex.set(local, (int)l->ts);
+    fsAccess->local2path(&local, &path);
+
+    if(syncMap.find(l->sync->tag) == syncMap.end()) return;
+    MegaSyncPrivate* megaSync = syncMap.at(l->sync->tag);
+
+    fireOnFileSyncStateChanged(megaSync, path.data(), (int)l->ts);
+}
+
+void MegaApiImpl::syncupdate_local_unlink(LocalNode *l, bool subtree)
+{
+    string local;
+    l->getlocalpath(&local, true);
+    unindexSyncPaths(l, &local, subtree);
+}
+
+// forget the state of the path, and of the paths below it if subtree is set
+void MegaApiImpl::unindexSyncPaths(LocalNode *l, string *localpath, bool subtree)
+{
+    syncStateIndex.erase(*localpath);
+
+    if (!subtree)
+    {
+        return;
+    }
+
+    size_t len = localpath->size();
+
+    for (localnode_map::iterator it = l->children.begin(); it != l->children.end(); it++)
+    {
+        localpath->append(client->fsaccess->localseparator);
+        localpath->append(it->second->localname);
+        unindexSyncPaths(it->second, localpath, true);
+        localpath->resize(len);
+    }
+}
+
+bool MegaApiImpl::sync_syncable(Node *node)
+{
+    if(node->type == FILENODE && !is_syncable(node->size))
+    {
+        return false;
+    }
+
+    const char *name = node->displayname();
+    sdkMutex.unlock();
+    bool result = is_syncable(name);
+    sdkMutex.lock();
+    return result;
+}
+
+bool MegaApiImpl::sync_syncable(const char *name, string *localpath, string *)
+{
+    static FileAccess* f = fsAccess->newfileaccess();
+    if(f->fopen(localpath) && !is_syncable(f->size))
+    {
+        return false;
+    }
+
+    sdkMutex.unlock();
+    bool result =  is_syncable(name);
+    sdkMutex.lock();
+    return result;
+}
+
+void MegaApiImpl::syncupdate_local_lockretry(bool waiting)
+{
+    if (waiting)
+    {
+        LOG_debug << "Sync - waiting for local filesystem lock";
+    }
+    else
+    {
+        LOG_debug << "Sync - local filesystem lock issue resolved, continuing...";
+        client->abortbackoff(false);
+    }
+
+    this->waiting = waiting;
+    this->fireOnGlobalSyncStateChanged();
+}
+#endif
+
+
+// user addition/update (users never get deleted)
+void MegaApiImpl::users_updated(User** u, int count)
+{
+    if(!count)
+    {
+        return;
+    }
+
+    MegaUserList *userList = NULL;
+    if(u != NULL)
+    {
+        userList = new MegaUserListPrivate(u, count);
+        fireOnUsersUpdate(userList);
+    }
+    else
+    {
+        fireOnUsersUpdate(NULL);
+    }
+    delete userList;
+}
+
+void MegaApiImpl::account_updated()
+{
+    fireOnAccountUpdate();
+}
+
+void MegaApiImpl::pcrs_updated(PendingContactRequest **r, int count)
+{
+    if(!count)
+    {
+        return;
+    }
+
+    MegaContactRequestList *requestList = NULL;
+    if(r != NULL)
+    {
+        requestList = new MegaContactRequestListPrivate(r, count);
+        fireOnContactRequestsUpdate(requestList);
+    }
+    else
+    {
+        fireOnContactRequestsUpdate(NULL);
+    }
+    delete requestList;
+}
+
+void MegaApiImpl::setattr_result(handle h, error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if (request && request->getType() == MegaRequest::TYPE_SET_ATTR_NODES)
+    {
+        return bulkNodeResult(request, h, e);
+    }
+
+    if (!request || ((request->getType() != MegaRequest::TYPE_RENAME)
+            && request->getType() != MegaRequest::TYPE_SET_ATTR_NODE))
+    {
+        return;
+    }
+
+	request->setNodeHandle(h);
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::rename_result(handle h, error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(request && request->getType() == MegaRequest::TYPE_MOVE_NODES) return bulkNodeResult(request, h, e);
+    if(!request || (request->getType() != MegaRequest::TYPE_MOVE)) return;
+
+    request->setNodeHandle(h);
+    fireOnRequestFinish(request, megaError);
+}
+
+vector<bool> MegaApiImpl::nestedNodes(MegaClient *client, const handle_vector &handles)
+{
+    set<handle> listed(handles.begin(), handles.end());
+    vector<bool> nested(handles.size(), false);
+
+    for (size_t i = 0; i < handles.size(); i++)
+    {
+        Node *node = client->nodebyhandle(handles[i]);
+
+        for (Node *p = node ? node->parent : NULL; p; p = p->parent)
+        {
+            if (listed.find(p->nodehandle) != listed.end())
+            {
+                nested[i] = true;
+                break;
+            }
+        }
+    }
+
+    return nested;
+}
+
+// a node of a bulk request is done: the request finishes with the last one
+void MegaApiImpl::bulkNodeResult(MegaRequestPrivate *request, handle h, error e)
+{
+    request->setNodeResult(h, e);
+
+    if (!request->hasPendingNodes())
+    {
+        fireOnRequestFinish(request, MegaError(API_OK));
+    }
+}
+
+void MegaApiImpl::unlink_result(handle h, error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(request && request->getType() == MegaRequest::TYPE_REMOVE_NODES) return bulkNodeResult(request, h, e);
+    if(!request || (request->getType() != MegaRequest::TYPE_REMOVE)) return;
+
+    request->setNodeHandle(h);
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::fetchnodes_result(error e)
+{
+    MegaError megaError(e);
+    MegaRequestPrivate* request;
+
+    if (!e)
+    {
+        restoreQueuedTransfers();
+    }
+
+    if (!client->restag)
+    {
+        request = new MegaRequestPrivate(MegaRequest::TYPE_FETCH_NODES);
+        fireOnRequestFinish(request, megaError);
+        return;
+    }
+
+    if (requestMap.find(client->restag) == requestMap.end())
+    {
+        return;
+    }
+    request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_FETCH_NODES))
+    {
+        return;
+    }
+
+    fireOnRequestFinish(request, megaError);
+}
+
+// the tree is being built while the response arrives - let the app show it
+void MegaApiImpl::fetchnodes_partial()
+{
+    for (MegaRequestMap::iterator it = requestMap.begin(); it != requestMap.end(); it++)
+    {
+        MegaRequestPrivate *request = it->second;
+        if (request && request->getType() == MegaRequest::TYPE_FETCH_NODES)
+        {
+            request->setFlag(true);
+            fireOnRequestUpdate(request);
+        }
+    }
+}
+
+void MegaApiImpl::putnodes_result(error e, targettype_t t, NewNode* nn)
+{
+    handle h = UNDEF;
+    Node *n = NULL;
+
+    if(!e && t != USER_HANDLE)
+    {
+        if(nn && nn->source == NEW_UPLOAD && nn->added)
+        {
+            // uploads put in batches report their node separately
+            n = client->nodebyhandle(nn->nodehandle);
+        }
+        else if(client->nodenotify.size())
+        {
+            n = client->nodenotify.back();
+        }
+
+        if(n)
+        {
+            n->applykey();
+            n->setattr();
+            h = n->nodehandle;
+        }
+    }
+
+    map<int, MegaFolderUploadController *>::iterator fit = folderUploadTrees.find(client->restag);
+    if(fit != folderUploadTrees.end())
+    {
+        MegaFolderUploadController *uploader = fit->second;
+        folderUploadTrees.erase(fit);
+        uploader->onTreeCreated(client->restag, e, nn);
+        return;
+    }
+
+	MegaError megaError(e);
+    if(transferMap.find(client->restag) != transferMap.end())
+    {
+        MegaTransferPrivate* transfer = transferMap.at(client->restag);
+        if(transfer->getType() == MegaTransfer::TYPE_DOWNLOAD)
+        {
+            return;
+        }
+
+        if(pendingUploads > 0)
+        {
+            pendingUploads--;
+        }
+
+        transfer->setNodeHandle(h);
+        fireOnTransferFinish(transfer, megaError);
+        delete [] nn;
+        return;
+    }
+
+	if(requestMap.find(client->restag) == requestMap.end()) return;
+	MegaRequestPrivate* request = requestMap.at(client->restag);
+
+    // the roots of the copied trees keep the handles of their sources
+    if(request && request->getType() == MegaRequest::TYPE_COPY_NODES)
+    {
+        for (long long i = 0; nn && i < request->getNumber(); i++)
+        {
+            if (ISUNDEF(nn[i].parenthandle))
+            {
+                request->setNodeResult(nn[i].nodehandle, nn[i].added ? API_OK : (e ? e : API_EINCOMPLETE));
+            }
+        }
+
+        delete [] nn;
+        return bulkNodeResult(request, UNDEF, API_OK);
+    }
+
+    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_CREATE_FOLDER) &&
+                    (request->getType() != MegaRequest::TYPE_COPY))) return;
+
+	request->setNodeHandle(h);
+    fireOnRequestFinish(request, megaError);
+	delete [] nn;
+}
+
+void MegaApiImpl::share_result(error e)
+{
+	MegaError megaError(e);
+
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_EXPORT) &&
+                    (request->getType() != MegaRequest::TYPE_SHARE))) return;
+
+    //exportnode_result will be called to end the request.
+	if(request->getType() == MegaRequest::TYPE_EXPORT)
+		return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::share_result(int, error)
+{
+    //The other callback will be called at the end of the request
+}
+
+void MegaApiImpl::setpcr_result(handle h, error e, opcactions_t action)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_INVITE_CONTACT) return;
+
+    if (e)
+    {
+        LOG_debug << "Outgoing pending contact request failed (" << megaError.getErrorString() << ")";
+    }
+    else
+    {
+        if (h == UNDEF)
+        {
+            // must have been deleted
+            LOG_debug << "Outgoing pending contact request " << (action == OPCA_DELETE ? "deleted" : "reminded") << " successfully";
+        }
+        else
+        {
+            char buffer[12];
+            Base64::btoa((byte*)&h, sizeof(h), buffer);
+            LOG_debug << "Outgoing pending contact request succeeded, id: " << buffer;
+        }
+    }
+
+    request->setNodeHandle(h);
+    request->setNumber(action);
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::updatepcr_result(error e, ipcactions_t action)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_REPLY_CONTACT_REQUEST) return;
+
+    if (e)
+    {
+        LOG_debug << "Incoming pending contact request update failed (" << megaError.getErrorString() << ")";
+    }
+    else
+    {
+        string labels[3] = {"accepted", "denied", "ignored"};
+        LOG_debug << "Incoming pending contact request successfully " << labels[(int)action];
+    }
+
+    request->setNumber(action);
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::fa_complete(Node* n, fatype type, const char* data, uint32_t len)
+{
+    int tag = client->restag;
+    while(tag)
+    {
+        if(requestMap.find(tag) == requestMap.end()) return;
+        MegaRequestPrivate* request = requestMap.at(tag);
+        if(request && request->getType() == MegaRequest::TYPE_PREFETCH_THUMBNAILS)
+        {
+            // the thumbnail is in the cache now, continue with the requests that joined the fetch
+            tag = prefetchedThumbnail(request, n->nodehandle, true);
+            continue;
+        }
+
+        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE)) return;
+
+        tag = request->getNumber();
+
+        FileAccess *f = client->fsaccess->newfileaccess();
+        string filePath(request->getFile());
+        string localPath;
+        fsAccess->path2local(&filePath, &localPath);
+
+        totalDownloadedBytes += len;
+
+        fsAccess->unlinklocal(&localPath);
+        if(!f->fopen(&localPath, false, true))
+        {
+            delete f;
+            fireOnRequestFinish(request, MegaError(API_EWRITE));
+            continue;
+        }
+
+        if(!f->fwrite((const byte*)data, len, 0))
+        {
+            delete f;
+            fireOnRequestFinish(request, MegaError(API_EWRITE));
+            continue;
+        }
+
+        delete f;
+        fireOnRequestFinish(request, MegaError(API_OK));
+    }
+}
+
+int MegaApiImpl::fa_failed(handle h, fatype, int retries, error e)
+{
+    int tag = client->restag;
+    while(tag)
+    {
+        if(requestMap.find(tag) == requestMap.end()) return 1;
+        MegaRequestPrivate* request = requestMap.at(tag);
+        if(request && request->getType() == MegaRequest::TYPE_PREFETCH_THUMBNAILS)
+        {
+            if(retries >= 2)
+            {
+                tag = prefetchedThumbnail(request, h, false);
+            }
+            else
+            {
+                map<handle, int>::iterator it = prefetchWaiters.find(h);
+                tag = (it != prefetchWaiters.end()) ? it->second : 0;
+            }
+            continue;
+        }
+
+        if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_FILE))
+            return 1;
+
+        tag = request->getNumber();
+        if(retries >= 2)
+        {
+            fireOnRequestFinish(request, MegaError(e));
+        }
+        else
+        {
+            fireOnRequestTemporaryError(request, MegaError(e));
+        }
+    }
+
+    return (retries >= 2);
+}
+
+int MegaApiImpl::prefetchedThumbnail(MegaRequestPrivate *request, handle h, bool available)
+{
+    int waiterTag = 0;
+    map<handle, int>::iterator it = prefetchWaiters.find(h);
+    if(it != prefetchWaiters.end())
+    {
+        waiterTag = it->second;
+        prefetchWaiters.erase(it);
+    }
+
+    thumbnailPrefetches.erase(h);
+
+    request->setNodeHandle(h);
+    request->setFlag(available);
+    request->setTransferredBytes(request->getTransferredBytes() + 1);
+    if(!available)
+    {
+        request->setNumDetails(request->getNumDetails() + 1);
+    }
+
+    fireOnRequestUpdate(request);
+
+    if(request->getTag() != prefetchDispatchTag && request->getTransferredBytes() == request->getTotalBytes())
+    {
+        fireOnRequestFinish(request, MegaError(API_OK));
+    }
+
+    return waiterTag;
+}
+
+void MegaApiImpl::putfa_result(handle, fatype, error e)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
+        return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::putfa_result(handle, fatype, const char *)
+{
+    MegaError megaError(API_OK);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_SET_ATTR_FILE)
+        return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::enumeratequotaitems_result(handle product, unsigned prolevel, unsigned gbstorage, unsigned gbtransfer, unsigned months, unsigned amount, const char* currency, const char* description, const char* iosid, const char* androidid)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
+                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
+    {
+        return;
+    }
+
+    request->addProduct(product, prolevel, gbstorage, gbtransfer, months, amount, currency, description, iosid, androidid);
+}
+
+void MegaApiImpl::enumeratequotaitems_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PRICING) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
+                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)))
+    {
+        return;
+    }
+
+    if(request->getType() == MegaRequest::TYPE_GET_PRICING)
+    {
+        fireOnRequestFinish(request, MegaError(e));
+    }
+    else
+    {
+        MegaPricing *pricing = request->getPricing();
+        int i;
+        for(i = 0; i < pricing->getNumProducts(); i++)
+        {
+            if(pricing->getHandle(i) == request->getNodeHandle())
+            {
+                requestMap.erase(request->getTag());
+                int nextTag = client->nextreqtag();
+                request->setTag(nextTag);
+                requestMap[nextTag]=request;
+                client->purchase_additem(0, request->getNodeHandle(), pricing->getAmount(i),
+                                         pricing->getCurrency(i), 0, NULL, NULL);
+                break;
+            }
+        }
+
+        if(i == pricing->getNumProducts())
+        {
+            fireOnRequestFinish(request, MegaError(API_ENOENT));
+        }
+        delete pricing;
+    }
+}
+
+void MegaApiImpl::additem_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_GET_PAYMENT_ID) &&
+                    (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT))) return;
+
+    if(e != API_OK)
+    {
+        client->purchase_begin();
+        fireOnRequestFinish(request, MegaError(e));
+        return;
+    }
+
+    if(request->getType() == MegaRequest::TYPE_GET_PAYMENT_ID)
+    {
+        char saleid[16];
+        Base64::btoa((byte *)&client->purchase_basket.back(), 8, saleid);
+        request->setLink(saleid);
+        client->purchase_begin();
+        fireOnRequestFinish(request, MegaError(API_OK));
+        return;
+    }
+
+    //MegaRequest::TYPE_UPGRADE_ACCOUNT
+    int method = request->getNumber();
+    client->purchase_checkout(method);
+}
+
+void MegaApiImpl::checkout_result(const char *errortype, error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_UPGRADE_ACCOUNT)) return;
+
+    if(!errortype)
+    {
+        fireOnRequestFinish(request, MegaError(e));
+        return;
+    }
+
+    if(!strcmp(errortype, "FP"))
+    {
+        fireOnRequestFinish(request, MegaError(e - 100));
+        return;
+    }
+
+    fireOnRequestFinish(request, MegaError(MegaError::PAYMENT_EGENERIC));
+    return;
+}
+
+void MegaApiImpl::submitpurchasereceipt_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_PURCHASE_RECEIPT)) return;
+
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::creditcardquerysubscriptions_result(int number, error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_QUERY_SUBSCRIPTIONS)) return;
+
+    request->setNumber(number);
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::creditcardcancelsubscriptions_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_CANCEL_SUBSCRIPTIONS)) return;
+
+    fireOnRequestFinish(request, MegaError(e));
+}
+void MegaApiImpl::getpaymentmethods_result(int methods, error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_PAYMENT_METHODS)) return;
+
+    request->setNumber(methods);
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::userfeedbackstore_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SUBMIT_FEEDBACK)) return;
+
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::sendevent_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SEND_EVENT)) return;
+
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::creditcardstore_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_CREDIT_CARD_STORE)) return;
+
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::copysession_result(string *session, error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_SESSION_TRANSFER_URL)) return;
+
+    const char *path = request->getText();
+    string *data = NULL;
+    if(e == API_OK)
+    {
+        data = client->sessiontransferdata(path, session);
+    }
+
+    if(data)
+    {
+        data->insert(0, "https://mega.nz/#sitetransfer!");
+    }
+    else
+    {
+        data = new string("https://mega.nz/#");
+        if(path)
+        {
+            data->append(path);
+        }
+    }
+
+    request->setLink(data->c_str());
+    delete data;
+
+    fireOnRequestFinish(request, MegaError(e));
+}
+
+void MegaApiImpl::clearing()
+{
+
+}
+
+void MegaApiImpl::notify_retry(dstime dsdelta)
+{
+#ifdef ENABLE_SYNC
+    bool previousFlag = waitingRequest;
+#endif
+
+    if(!dsdelta)
+        waitingRequest = false;
+    else if(dsdelta > 10)
+        waitingRequest = true;
+
+#ifdef ENABLE_SYNC
+    if(previousFlag != waitingRequest)
+        fireOnGlobalSyncStateChanged();
+#endif
+}
+
+// callback for non-EAGAIN request-level errors
+// retrying is futile
+// this can occur e.g. with syntactically malformed requests (due to a bug) or due to an invalid application key
+void MegaApiImpl::request_error(error e)
+{
+    MegaRequestPrivate *request = new MegaRequestPrivate(MegaRequest::TYPE_LOGOUT);
+    request->setFlag(false);
+    request->setParamType(e);
+
+    if (e == API_ESSL && client->sslfakeissuer.size())
+    {
+        request->setText(client->sslfakeissuer.c_str());
+    }
+
+    if (requestQueue.push(request))
+    {
+        waiter->notify();
+    }
+}
+
+// the first command of a request keeps its sending time, the last one its
+// response time
+void MegaApiImpl::command_response(int tag, int64_t sent, int64_t received)
+{
+    MegaRequestMap::iterator it = requestMap.find(tag);
+
+    if (it == requestMap.end() || !it->second)
+    {
+        return;
+    }
+
+    if (!it->second->getTiming(MegaRequest::TIMING_SENT))
+    {
+        it->second->setTiming(MegaRequest::TIMING_SENT, sent);
+    }
+
+    it->second->setTiming(MegaRequest::TIMING_RECEIVED, received);
+}
+
+void MegaApiImpl::request_response_progress(m_off_t currentProgress, m_off_t totalProgress)
+{
+    if(requestMap.size() == 1)
+    {
+        MegaRequestPrivate *request = requestMap.begin()->second;
+        if(request && request->getType() == MegaRequest::TYPE_FETCH_NODES)
+        {
+            if(request->getTransferredBytes() != currentProgress)
+            {
+                request->setTransferredBytes(currentProgress);
+                if(totalProgress != -1)
+                {
+                    request->setTotalBytes(totalProgress);
+                }
+                fireOnRequestUpdate(request);
+            }
+        }
+    }
+}
+
+// login result
+void MegaApiImpl::login_result(error result)
+{
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_LOGIN)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::logout_result(error e)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_LOGOUT)) return;
+
+    if(!e)
+    {
+        requestMap.erase(request->getTag());
+
+        error preverror = (error)request->getParamType();
+        while(!requestMap.empty())
+        {
+            MegaRequestMap::iterator it=requestMap.begin();
+            if(it->second) fireOnRequestFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
+        }
+
+        abortQueuedUploads(preverror ? preverror : API_EACCESS);
+
+        while(!transferMap.empty())
+        {
+            std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
+            if(it->second) fireOnTransferFinish(it->second, MegaError(preverror ? preverror : API_EACCESS));
+        }
+
+        pendingUploads = 0;
+        pendingDownloads = 0;
+        totalUploads = 0;
+        totalDownloads = 0;
+        waiting = false;
+        waitingRequest = false;
+        excludedNames.clear();
+        syncLowerSizeLimit = 0;
+        syncUpperSizeLimit = 0;
+        uploadSpeed = 0;
+        downloadSpeed = 0;
+        downloadTimes.clear();
+        downloadBytes.clear();
+        uploadTimes.clear();
+        uploadBytes.clear();
+        uploadPartialBytes = 0;
+        downloadPartialBytes = 0;
+
+        if (nameIndex)
+        {
+            // a full logout ends the session and its cached state
+            nameIndex->clear(request->getFlag());
+        }
+
+        clearNodeUpdates();
+
+        fireOnRequestFinish(request, MegaError(preverror));
+        return;
+    }
+    fireOnRequestFinish(request,MegaError(e));
+}
+
+void MegaApiImpl::userdata_result(string *name, string* pubk, string* privk, handle bjid, error result)
+{
+    MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
+
+    if(result == API_OK)
+    {
+        char jid[16];
+        Base32::btoa((byte *)&bjid, MegaClient::USERHANDLE, jid);
+
+        request->setPassword(pubk->c_str());
+        request->setPrivateKey(privk->c_str());
+        request->setName(name->c_str());
+        request->setText(jid);
+    }
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::pubkey_result(User *u)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_USER_DATA)) return;
+
+    if(!u)
+    {
+        fireOnRequestFinish(request, MegaError(API_ENOENT));
+        return;
+    }
+
+    if(!u->pubk.isvalid())
+    {
+        fireOnRequestFinish(request, MegaError(API_EACCESS));
+        return;
+    }
+
+    string key;
+    u->pubk.serializekey(&key, AsymmCipher::PUBKEY);
+    char pubkbuf[AsymmCipher::MAXKEYLENGTH * 4 / 3 + 4];
+    Base64::btoa((byte *)key.data(), key.size(), pubkbuf);
+    request->setPassword(pubkbuf);
+
+    char jid[16];
+    Base32::btoa((byte *)&u->userhandle, MegaClient::USERHANDLE, jid);
+    request->setText(jid);
+
+    if(u->email.size())
+    {
+        request->setEmail(u->email.c_str());
+    }
+
+    fireOnRequestFinish(request, MegaError(API_OK));
+}
+
+// password change result
+void MegaApiImpl::changepw_result(error result)
+{
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_CHANGE_PW) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+// node export failed
+void MegaApiImpl::exportnode_result(error result)
+{
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::exportnode_result(handle h, handle ph)
+{
+    Node* n;
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || request->getType() != MegaRequest::TYPE_EXPORT) return;
+
+    if ((n = client->nodebyhandle(h)))
+    {
+        char node[9];
+        char key[FILENODEKEYLENGTH*4/3+3];
+
+        Base64::btoa((byte*)&ph,MegaClient::NODEHANDLE,node);
+
+        // the key
+        if (n->type == FILENODE)
+        {
+            if(n->nodekey.size()>=FILENODEKEYLENGTH)
+                Base64::btoa((const byte*)n->nodekey.data(),FILENODEKEYLENGTH,key);
+            else
+                key[0]=0;
+        }
+        else if (n->sharekey()) Base64::btoa(n->sharekey()->key,FOLDERNODEKEYLENGTH,key);
+        else
+        {
+            fireOnRequestFinish(request, MegaError(MegaError::API_EKEY));
+            return;
+        }
+
+        string link = "https://mega.nz/#";
+        link += (n->type ? "F" : "");
+        link += "!";
+        link += node;
+        link += "!";
+        link += key;
+        request->setLink(link.c_str());
+        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+    }
+    else
+    {
+        request->setNodeHandle(UNDEF);
+        fireOnRequestFinish(request, MegaError(MegaError::API_ENOENT));
+    }
+}
+
+// the requested link could not be opened
+void MegaApiImpl::openfilelink_result(error result)
+{
+	MegaError megaError(result);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+// the requested link was opened successfully
+// (it is the application's responsibility to delete n!)
+void MegaApiImpl::openfilelink_result(handle ph, const byte* key, m_off_t size, string* a, string*, int)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_IMPORT_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_GET_PUBLIC_NODE))) return;
+
+	if (!client->loggedin() && (request->getType() == MegaRequest::TYPE_IMPORT_LINK))
+	{
+        fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
+		return;
+	}
+
+    string attrstring;
+    string fileName;
+    string keystring;
+
+    attrstring.resize(a->length()*4/3+4);
+    attrstring.resize(Base64::btoa((const byte *)a->data(),a->length(), (char *)attrstring.data()));
+
+    m_time_t mtime = 0;
+
+    SymmCipher nodeKey;
+    keystring.assign((char*)key,FILENODEKEYLENGTH);
+    nodeKey.setkey(key, FILENODE);
+
+    byte *buf = Node::decryptattr(&nodeKey,attrstring.c_str(),attrstring.size());
+    if(buf)
+    {
+        JSON json;
+        nameid name;
+        string* t;
+        AttrMap attrs;
+
+        json.begin((char*)buf+5);
+        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+            JSON::unescape(t);
+
+        delete[] buf;
+
+        attr_map::iterator it;
+        it = attrs.map.find('n');
+        if (it == attrs.map.end()) fileName = "CRYPTO_ERROR";
+        else if (!it->second.size()) fileName = "BLANK";
+        else fileName = it->second.c_str();
+
+        it = attrs.map.find('c');
+        if(it != attrs.map.end())
+        {
+            FileFingerprint ffp;
+            if(ffp.unserializefingerprint(&it->second))
+            {
+                mtime = ffp.mtime;
+            }
+        }
+    }
+    else fileName = "CRYPTO_ERROR";
+
+	if(request->getType() == MegaRequest::TYPE_IMPORT_LINK)
+	{
+		NewNode* newnode = new NewNode[1];
+
+		// set up new node as folder node
+		newnode->source = NEW_PUBLIC;
+		newnode->type = FILENODE;
+		newnode->nodehandle = ph;
+        newnode->parenthandle = UNDEF;
+		newnode->nodekey.assign((char*)key,FILENODEKEYLENGTH);
+        newnode->attrstring = new string(*a);
+
+		// add node
+        requestMap.erase(request->getTag());
+        int nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+        requestMap[nextTag]=request;
+        client->putnodes(request->getParentHandle(), newnode, 1);
+	}
+	else
+	{
+        request->setPublicNode(new MegaNodePrivate(fileName.c_str(), FILENODE, size, 0, mtime, ph, &keystring, a));
+        fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+	}
+}
+
+// reload needed
+void MegaApiImpl::reload(const char*)
+{
+    fireOnReloadNeeded();
+}
+
+// nodes have been modified
+// (nodes with their removed flag set will be deleted immediately after returning from this call,
+// at which point their pointers will become invalid at that point.)
+void MegaApiImpl::nodes_updated(Node** n, int count)
+{
+    if(!count)
+    {
+        return;
+    }
+
+    // names and locations changed: cached path resolutions may be stale
+    if (n == NULL)
+    {
+        pathCache.clear();
+    }
+    else
+    {
+        for (int i = 0; i < count; i++)
+        {
+            if (n[i]->changed.parent || n[i]->changed.attrs || n[i]->changed.removed || n[i]->changed.inshare)
+            {
+                pathCache.clear();
+                break;
+            }
+        }
+    }
+
+    if (nameIndex)
+    {
+        if (n == NULL)
+        {
+            buildNameIndex();
+        }
+        else
+        {
+            for (int i = 0; i < count; i++)
+            {
+                if (n[i]->changed.removed)
+                {
+                    removeFromNameIndex(n[i]);
+                }
+                else
+                {
+                    nameIndex->add(n[i]);
+                }
+            }
+
+            nameIndex->flush(currentScsn());
+        }
+    }
+
+    if (n == NULL)
+    {
+        // updates held back refer to the previous state
+        flushNodeUpdates();
+        fireOnNodesUpdate(NULL);
+        return;
+    }
+
+    if (!nodeUpdateWindow && pendingNodeOrder.empty())
+    {
+        MegaNodeList *nodeList = new MegaNodeListPrivate(n, count);
+        fireOnNodesUpdate(nodeList);
+        delete nodeList;
+        return;
+    }
+
+    // removed nodes are deleted after this call, so take snapshots now
+    for (int i = 0; i < count; i++)
+    {
+        MegaNodePrivate *node = (MegaNodePrivate *)MegaNodePrivate::fromNode(n[i]);
+        MegaNodePrivate *&pending = pendingNodeUpdates[n[i]->nodehandle];
+
+        if (pending)
+        {
+            node->mergeChanges(pending);
+            delete pending;
+        }
+        else
+        {
+            pendingNodeOrder.push_back(n[i]->nodehandle);
+        }
+
+        pending = node;
+
+        if (nodeUpdateMaxBatch && (int)pendingNodeOrder.size() >= nodeUpdateMaxBatch)
+        {
+            flushNodeUpdates();
+        }
+    }
+
+    if (!nodeUpdateWindow)
+    {
+        flushNodeUpdates();
+    }
+    else if (!pendingNodeOrder.empty() && !EVER(nodeUpdateDeadline))
+    {
+        // the window starts with the first held back update
+        nodeUpdateDeadline = Waiter::ds + nodeUpdateWindow;
+        updateAppWakeup();
+    }
+}
+
+// a removed node is reported alone for its whole subtree
+void MegaApiImpl::removeFromNameIndex(Node *n)
+{
+    node_vector pending(1, n);
+
+    while (pending.size())
+    {
+        n = pending.back();
+        pending.pop_back();
+
+        nameIndex->remove(n->nodehandle);
+
+        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        {
+            pending.push_back(*it);
+        }
+    }
+}
+
+void MegaApiImpl::updateAppWakeup()
+{
+    client->appwakeup = (nodeUpdateDeadline < transfersProgressDeadline) ? nodeUpdateDeadline : transfersProgressDeadline;
+}
+
+void MegaApiImpl::flushNodeUpdates()
+{
+    nodeUpdateDeadline = NEVER;
+    updateAppWakeup();
+
+    if (pendingNodeOrder.empty())
+    {
+        return;
+    }
+
+    vector<MegaNode*> nodes;
+    nodes.reserve(pendingNodeOrder.size());
+
+    for (unsigned i = 0; i < pendingNodeOrder.size(); i++)
+    {
+        nodes.push_back(pendingNodeUpdates[pendingNodeOrder[i]]);
+    }
+
+    pendingNodeUpdates.clear();
+    pendingNodeOrder.clear();
+
+    MegaNodeList *nodeList = new MegaNodeListPrivate(&nodes);
+    fireOnNodesUpdate(nodeList);
+    delete nodeList;
+}
+
+void MegaApiImpl::clearNodeUpdates()
+{
+    for (map<handle, MegaNodePrivate*>::iterator it = pendingNodeUpdates.begin(); it != pendingNodeUpdates.end(); it++)
+    {
+        delete it->second;
+    }
+
+    pendingNodeUpdates.clear();
+    pendingNodeOrder.clear();
+}
+
+void MegaApiImpl::account_details(AccountDetails*, bool, bool, bool, bool, bool, bool)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
+
+	int numDetails = request->getNumDetails();
+	numDetails--;
+	request->setNumDetails(numDetails);
+	if(!numDetails)
+    {
+        if(!request->getAccountDetails()->storage_max)
+            fireOnRequestFinish(request, MegaError(MegaError::API_EACCESS));
+        else
+            fireOnRequestFinish(request, MegaError(MegaError::API_OK));
+    }
+}
+
+void MegaApiImpl::account_details(AccountDetails*, error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_ACCOUNT_DETAILS)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::invite_result(error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_ADD_CONTACT) &&
+                    (request->getType() != MegaRequest::TYPE_REMOVE_CONTACT))) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::putua_result(error e)
+{
+    MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_SET_ATTR_USER)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::getua_result(error e)
+{
+	MegaError megaError(e);
+	if(requestMap.find(client->restag) == requestMap.end()) return;
+	MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::getua_result(byte* data, unsigned len)
+{
+	if(requestMap.find(client->restag) == requestMap.end()) return;
+	MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || (request->getType() != MegaRequest::TYPE_GET_ATTR_USER)) return;
+
+    if(request->getParamType() == MegaApi::USER_ATTR_AVATAR)
+    {
+        if (len)
+        {
+            FileAccess *f = client->fsaccess->newfileaccess();
+            string filePath(request->getFile());
+            string localPath;
+            fsAccess->path2local(&filePath, &localPath);
+
+            totalDownloadedBytes += len;
+
+            fsAccess->unlinklocal(&localPath);
+            if(!f->fopen(&localPath, false, true))
+            {
+                delete f;
+                fireOnRequestFinish(request, MegaError(API_EWRITE));
+                return;
+            }
+
+            if(!f->fwrite((const byte*)data, len, 0))
+            {
+                delete f;
+                fireOnRequestFinish(request, MegaError(API_EWRITE));
+                return;
+            }
+
+            delete f;
+        }
+        else    // no data for the avatar
+        {
+            fireOnRequestFinish(request, MegaError(API_ENOENT));
+            return;
+        }
+    }
+    else
+    {
+        string str((const char*)data,len);
+        request->setText(str.c_str());
+    }
+    fireOnRequestFinish(request, MegaError(API_OK));
+}
+
+// user attribute update notification
+void MegaApiImpl::userattr_update(User*, int, const char*)
+{
+}
+
+void MegaApiImpl::ephemeral_result(error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::ephemeral_result(handle, const byte*)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+
+    requestMap.erase(request->getTag());
+    int nextTag = client->nextreqtag();
+    request->setTag(nextTag);
+    requestMap[nextTag] = request;
+
+	byte pwkey[SymmCipher::KEYLENGTH];
+    if(!request->getPrivateKey())
+		client->pw_key(request->getPassword(),pwkey);
+	else
+		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
+
+    client->sendsignuplink(request->getEmail(),request->getName(),pwkey);
+}
+
+void MegaApiImpl::sendsignuplink_result(error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_CREATE_ACCOUNT))) return;
+
+    requestMap.erase(request->getTag());
+    while(!requestMap.empty())
+    {
+        MegaRequestMap::iterator it=requestMap.begin();
+        if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
+    }
+
+    while(!transferMap.empty())
+    {
+        std::map<int, MegaTransferPrivate *>::iterator it=transferMap.begin();
+        if(it->second) fireOnTransferFinish(it->second, MegaError(MegaError::API_EACCESS));
+    }
+
+    client->locallogout();
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::querysignuplink_result(error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::querysignuplink_result(handle, const char* email, const char* name, const byte* pwc, const byte*, const byte* c, size_t len)
+{
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request || ((request->getType() != MegaRequest::TYPE_QUERY_SIGNUP_LINK) &&
+                    (request->getType() != MegaRequest::TYPE_CONFIRM_ACCOUNT))) return;
+
+	request->setEmail(email);
+	request->setName(name);
+
+	if(request->getType() == MegaRequest::TYPE_QUERY_SIGNUP_LINK)
+	{
+        fireOnRequestFinish(request, MegaError(API_OK));
+		return;
+	}
+
+	string signupemail = email;
+	string signupcode;
+	signupcode.assign((char*)c,len);
+
+	byte signuppwchallenge[SymmCipher::KEYLENGTH];
+	byte signupencryptedmasterkey[SymmCipher::KEYLENGTH];
+
+	memcpy(signuppwchallenge,pwc,sizeof signuppwchallenge);
+	memcpy(signupencryptedmasterkey,pwc,sizeof signupencryptedmasterkey);
+
+	byte pwkey[SymmCipher::KEYLENGTH];
+    if(!request->getPrivateKey())
+		client->pw_key(request->getPassword(),pwkey);
+	else
+		Base64::atob(request->getPrivateKey(), (byte *)pwkey, sizeof pwkey);
+
+	// verify correctness of supplied signup password
+	SymmCipher pwcipher(pwkey);
+	pwcipher.ecb_decrypt(signuppwchallenge);
+
+	if (*(uint64_t*)(signuppwchallenge+4))
+	{
+        fireOnRequestFinish(request, MegaError(API_ENOENT));
+	}
+	else
+	{
+		// decrypt and set master key, then proceed with the confirmation
+		pwcipher.ecb_decrypt(signupencryptedmasterkey);
+		client->key.setkey(signupencryptedmasterkey);
+
+        requestMap.erase(request->getTag());
+        int nextTag = client->nextreqtag();
+        request->setTag(nextTag);
+        requestMap[nextTag] = request;
+
+		client->confirmsignuplink((const byte*)signupcode.data(),signupcode.size(),MegaClient::stringhash64(&signupemail,&pwcipher));
+	}
+}
+
+void MegaApiImpl::confirmsignuplink_result(error e)
+{
+	MegaError megaError(e);
+    if(requestMap.find(client->restag) == requestMap.end()) return;
+    MegaRequestPrivate* request = requestMap.at(client->restag);
+    if(!request) return;
+
+    fireOnRequestFinish(request, megaError);
+}
+
+void MegaApiImpl::setkeypair_result(error e)
+{
+
+}
+
+void MegaApiImpl::checkfile_result(handle h, error e)
+{
+    if(e)
+    {
+        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
+        {
+            MegaTransferPrivate *transfer = iter->second;
+            if(transfer->getNodeHandle() == h)
+                fireOnTransferTemporaryError(transfer, MegaError(e));
+        }
+    }
+}
+
+void MegaApiImpl::checkfile_result(handle h, error e, byte*, m_off_t, m_time_t, m_time_t, string*, string*, string*)
+{
+    if(e)
+    {
+        for(std::map<int, MegaTransferPrivate *>::iterator iter = transferMap.begin(); iter != transferMap.end(); iter++)
+        {
+            MegaTransferPrivate *transfer = iter->second;
+            if(transfer->getNodeHandle() == h)
+                fireOnTransferTemporaryError(transfer, MegaError(e));
+        }
+    }
+}
+
+void MegaApiImpl::addListener(MegaListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    listeners.insert(listener);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::addRequestListener(MegaRequestListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    requestListeners.insert(listener);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::addTransferListener(MegaTransferListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    transferListeners.insert(listener);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::addGlobalListener(MegaGlobalListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    globalListeners.insert(listener);
+    sdkMutex.unlock();
+}
+
+#ifdef ENABLE_SYNC
+void MegaApiImpl::addSyncListener(MegaSyncListener *listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    syncListeners.insert(listener);
+    sdkMutex.unlock();
+}
+
+void MegaApiImpl::removeSyncListener(MegaSyncListener *listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    syncListeners.erase(listener);
+
+    std::map<int, MegaSyncPrivate*>::iterator it = syncMap.begin();
+    while(it != syncMap.end())
+    {
+        MegaSyncPrivate* sync = it->second;
+        if(sync->getListener() == listener)
+            sync->setListener(NULL);
+
+        it++;
+    }
+    requestQueue.removeListener(listener);
+
+    sdkMutex.unlock();
+
+    callbackExecutor->removeListener(listener);
+}
+#endif
+
+void MegaApiImpl::removeListener(MegaListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    listeners.erase(listener);
+    sdkMutex.unlock();
+
+    callbackExecutor->removeListener(listener);
+}
+
+void MegaApiImpl::removeRequestListener(MegaRequestListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    requestListeners.erase(listener);
+
+    MegaRequestMap::iterator it=requestMap.begin();
+    while(it != requestMap.end())
+    {
+        MegaRequestPrivate* request = it->second;
+        if(request->getListener() == listener)
+            request->setListener(NULL);
+
+        it++;
+    }
+
+    requestQueue.removeListener(listener);
+    sdkMutex.unlock();
+
+    callbackExecutor->removeListener(listener);
+}
+
+void MegaApiImpl::removeTransferListener(MegaTransferListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    transferListeners.erase(listener);
+    sdkMutex.unlock();
+
+    callbackExecutor->removeListener(listener);
+}
+
+void MegaApiImpl::removeGlobalListener(MegaGlobalListener* listener)
+{
+    if(!listener) return;
+
+    sdkMutex.lock();
+    globalListeners.erase(listener);
+    sdkMutex.unlock();
+
+    callbackExecutor->removeListener(listener);
+}
+
+MegaRequest *MegaApiImpl::getCurrentRequest()
+{
+    return activeRequest;
+}
+
+MegaTransfer *MegaApiImpl::getCurrentTransfer()
+{
+    return activeTransfer;
+}
+
+MegaError *MegaApiImpl::getCurrentError()
+{
+    return activeError;
+}
+
+MegaNodeList *MegaApiImpl::getCurrentNodes()
+{
+    return activeNodes;
+}
+
+MegaUserList *MegaApiImpl::getCurrentUsers()
+{
+    return activeUsers;
+}
+
+void MegaApiImpl::queueRequestCallback(MegaCallbackEvent *event, MegaRequestPrivate *request)
+{
+    callbackExecutor->add(event, MegaCallbackExecutor::REQUEST_LISTENER, requestListeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::LISTENER, listeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::REQUEST_LISTENER, request->getListener());
+    callbackExecutor->done(event);
+}
+
+void MegaApiImpl::queueTransferCallback(MegaCallbackEvent *event, MegaTransferPrivate *transfer)
+{
+    callbackExecutor->add(event, MegaCallbackExecutor::TRANSFER_LISTENER, transferListeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::LISTENER, listeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::TRANSFER_LISTENER, transfer->getListener());
+    callbackExecutor->done(event);
+}
+
+void MegaApiImpl::queueGlobalCallback(MegaCallbackEvent *event)
+{
+    callbackExecutor->add(event, MegaCallbackExecutor::GLOBAL_LISTENER, globalListeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::LISTENER, listeners);
+    callbackExecutor->done(event);
+}
+
+#ifdef ENABLE_SYNC
+void MegaApiImpl::queueSyncCallback(MegaCallbackEvent *event, MegaSyncPrivate *sync)
+{
+    callbackExecutor->add(event, MegaCallbackExecutor::LISTENER, listeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::SYNC_LISTENER, syncListeners);
+    callbackExecutor->add(event, MegaCallbackExecutor::SYNC_LISTENER, sync->getListener());
+    callbackExecutor->done(event);
+}
+#endif
+
+void MegaApiImpl::fireOnRequestStart(MegaRequestPrivate *request)
+{
+    TraceSpan span(&client->tracer, "onRequestStart");
+
+    LOG_info << "Request (" << request->getRequestString() << ") starting";
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::REQUEST_START);
+        event->request = request->copy();
+        queueRequestCallback(event, request);
+        return;
+    }
+
+    activeRequest = request;
+	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+		(*it)->onRequestStart(api, request);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onRequestStart(api, request);
+
+	MegaRequestListener* listener = request->getListener();
+	if(listener) listener->onRequestStart(api, request);
+	activeRequest = NULL;
+}
+
+
+void MegaApiImpl::fireOnRequestFinish(MegaRequestPrivate *request, MegaError e)
+{
+    TraceSpan span(&client->tracer, "onRequestFinish");
+
+    request->setTiming(MegaRequest::TIMING_PROCESSED);
+
+    if(e.getErrorCode())
+    {
+        LOG_warn << "Request (" << request->getRequestString() << ") finished with error: " << e.getErrorString();
+    }
+    else
+    {
+        LOG_info << "Request (" << request->getRequestString() << ") finished";
+    }
+
+    // the request is finished with: the event takes it over instead of a copy
+    if (callbackExecutor->isEnabled())
+    {
+        requestMap.erase(request->getTag());
+
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::REQUEST_FINISH);
+        event->request = request;
+        event->error = new MegaError(e);
+        queueRequestCallback(event, request);
+        return;
+    }
+
+    MegaError megaError(e);
+    activeRequest = request;
+    activeError = &megaError;
+
+    request->setTiming(MegaRequest::TIMING_CALLBACK);
+
+    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+        (*it)->onRequestFinish(api, request, &megaError);
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onRequestFinish(api, request, &megaError);
+
+    MegaRequestListener* listener = request->getListener();
+    if(listener) listener->onRequestFinish(api, request, &megaError);
+
+    requestMap.erase(request->getTag());
+
+    activeRequest = NULL;
+    activeError = NULL;
+    delete request;
+}
+
+void MegaApiImpl::fireOnRequestUpdate(MegaRequestPrivate *request)
+{
+    TraceSpan span(&client->tracer, "onRequestUpdate");
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::REQUEST_UPDATE);
+        event->request = request->copy();
+        queueRequestCallback(event, request);
+        return;
+    }
+
+    activeRequest = request;
+
+    for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+        (*it)->onRequestUpdate(api, request);
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onRequestUpdate(api, request);
+
+    MegaRequestListener* listener = request->getListener();
+    if(listener) listener->onRequestUpdate(api, request);
+
+    activeRequest = NULL;
+}
+
+void MegaApiImpl::fireOnRequestTemporaryError(MegaRequestPrivate *request, MegaError e)
+{
+	MegaError *megaError = new MegaError(e);
+	activeRequest = request;
+	activeError = megaError;
+
+    request->setNumRetry(request->getNumRetry() + 1);
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::REQUEST_TEMPORARY_ERROR);
+        event->request = request->copy();
+        event->error = megaError->copy();
+        queueRequestCallback(event, request);
+
+        activeRequest = NULL;
+        activeError = NULL;
+        delete megaError;
+        return;
+    }
+
+	for(set<MegaRequestListener *>::iterator it = requestListeners.begin(); it != requestListeners.end() ; it++)
+		(*it)->onRequestTemporaryError(api, request, megaError);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onRequestTemporaryError(api, request, megaError);
+
+	MegaRequestListener* listener = request->getListener();
+	if(listener) listener->onRequestTemporaryError(api, request, megaError);
+
+	activeRequest = NULL;
+	activeError = NULL;
+	delete megaError;
+}
+
+void MegaApiImpl::fireOnTransferStart(MegaTransferPrivate *transfer)
+{
+    TraceSpan span(&client->tracer, "onTransferStart");
+
+    touchTransfer(transfer);
+
+    if (transfersProgressInterval && !EVER(transfersProgressDeadline))
+    {
+        transfersProgressDeadline = Waiter::ds + transfersProgressInterval;
+        updateAppWakeup();
+    }
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::TRANSFER_START);
+        event->transfer = transfer->copy();
+        queueTransferCallback(event, transfer);
+        return;
+    }
+
+	activeTransfer = transfer;
+
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferStart(api, transfer);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferStart(api, transfer);
+
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferStart(api, transfer);
+
+	activeTransfer = NULL;
+}
+
+void MegaApiImpl::fireOnTransferFinish(MegaTransferPrivate *transfer, MegaError e)
+{
+    TraceSpan span(&client->tracer, "onTransferFinish");
+
+    transfer->setTiming(MegaTransfer::TIMING_FINISHED);
+    unpersistTransfer(transfer);
+
+	MegaError *megaError = new MegaError(e);
+	activeTransfer = transfer;
+	activeError = megaError;
+
+    if(e.getErrorCode())
+    {
+        LOG_warn << "Transfer (" << transfer->getTransferString() << ") finished with error: " << e.getErrorString()
+                    << " File: " << transfer->getFileName();
+    }
+    else
+    {
+        LOG_info << "Transfer (" << transfer->getTransferString() << ") finished. File: " << transfer->getFileName();
+    }
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::TRANSFER_FINISH);
+        event->transfer = transfer->copy();
+        event->error = megaError->copy();
+        queueTransferCallback(event, transfer);
+    }
+    else
+    {
+        transfer->setTiming(MegaTransfer::TIMING_CALLBACK);
+
+        for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+            (*it)->onTransferFinish(api, transfer, megaError);
+
+        for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+            (*it)->onTransferFinish(api, transfer, megaError);
+
+        MegaTransferListener* listener = transfer->getListener();
+        if(listener) listener->onTransferFinish(api, transfer, megaError);
+    }
+
+    MegaStreamingRing *ring = transfer->getStreamingRing();
+    if (ring)
+    {
+        // lent buffers stay valid until released
+        ring->finished = true;
+        ring->overflow.clear();
+        if (ring->available.size() == ring->buffers.size())
+        {
+            if (transfer->getTag() >= 0)
+            {
+                streamingRings.erase(transfer->getTag());
+            }
+            delete ring;
+        }
+    }
+
+    transferMap.erase(transfer->getTag());
+    transferChanges.erase(transfer->getUpdateSequence());
+
+	activeTransfer = NULL;
+	activeError = NULL;
+	delete transfer;
+	delete megaError;
+}
+
+void MegaApiImpl::fireOnTransferTemporaryError(MegaTransferPrivate *transfer, MegaError e)
+{
+    touchTransfer(transfer);
+
+	MegaError *megaError = new MegaError(e);
+	activeTransfer = transfer;
+	activeError = megaError;
+
+    transfer->setNumRetry(transfer->getNumRetry() + 1);
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::TRANSFER_TEMPORARY_ERROR);
+        event->transfer = transfer->copy();
+        event->error = megaError->copy();
+        queueTransferCallback(event, transfer);
+
+        activeTransfer = NULL;
+        activeError = NULL;
+        delete megaError;
+        return;
+    }
+
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferTemporaryError(api, transfer, megaError);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferTemporaryError(api, transfer, megaError);
+
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferTemporaryError(api, transfer, megaError);
+
+	activeTransfer = NULL;
+	activeError = NULL;
+    delete megaError;
+}
+
+void MegaApiImpl::fireOnTransfersProgress()
+{
+    TraceSpan span(&client->tracer, "onTransfersProgress");
+
+    MegaTransferProgressPrivate *progress = new MegaTransferProgressPrivate();
+
+    for (map<int, MegaTransferPrivate *>::iterator it = transferMap.begin(); it != transferMap.end(); it++)
+    {
+        MegaTransferPrivate *transfer = it->second;
+        int type = transfer->getType();
+        if (transfer->isFolderTransfer() || (type != MegaTransfer::TYPE_DOWNLOAD && type != MegaTransfer::TYPE_UPLOAD))
+        {
+            continue;
+        }
+
+        // updates of the transfer may be throttled, take its current progress
+        Transfer *tr = transfer->getTransfer();
+        progress->numTransfers[type]++;
+        progress->transferredBytes[type] += (tr && tr->slot) ? tr->slot->progressreported : transfer->getTransferredBytes();
+        progress->totalBytes[type] += transfer->getTotalBytes();
+    }
+
+    progress->speed[MegaTransfer::TYPE_DOWNLOAD] = progress->numTransfers[MegaTransfer::TYPE_DOWNLOAD] ? downloadSpeed : 0;
+    progress->speed[MegaTransfer::TYPE_UPLOAD] = progress->numTransfers[MegaTransfer::TYPE_UPLOAD] ? uploadSpeed : 0;
+
+    // keep going while there are transfers, the last event reports none
+    transfersProgressDeadline = (transfersProgressInterval && !transferMap.empty()) ? Waiter::ds + transfersProgressInterval : NEVER;
+    updateAppWakeup();
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::TRANSFERS_PROGRESS);
+        event->progress = progress;
+        callbackExecutor->add(event, MegaCallbackExecutor::TRANSFER_LISTENER, transferListeners);
+        callbackExecutor->add(event, MegaCallbackExecutor::LISTENER, listeners);
+        callbackExecutor->done(event);
+        return;
+    }
+
+    for (set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end(); it++)
+    {
+        (*it)->onTransfersProgress(api, progress);
+    }
+
+    for (set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end(); it++)
+    {
+        (*it)->onTransfersProgress(api, progress);
+    }
+
+    delete progress;
+}
+
+// moves the transfer to the end of transferChanges
+void MegaApiImpl::touchTransfer(MegaTransferPrivate *transfer)
+{
+    if (transfer->getUpdateSequence())
+    {
+        transferChanges.erase(transfer->getUpdateSequence());
+    }
+
+    transfer->setUpdateSequence(++transferSequence);
+    transferChanges[transferSequence] = transfer->getTag();
+}
+
+MegaClient *MegaApiImpl::getMegaClient()
+{
+    return client;
+}
+
+void MegaApiImpl::fireOnTransferUpdate(MegaTransferPrivate *transfer)
+{
+    TraceSpan span(&client->tracer, "onTransferUpdate");
+
+    touchTransfer(transfer);
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::TRANSFER_UPDATE);
+        event->transfer = transfer->copy();
+        queueTransferCallback(event, transfer);
+        return;
+    }
+
+	activeTransfer = transfer;
+
+	for(set<MegaTransferListener *>::iterator it = transferListeners.begin(); it != transferListeners.end() ; it++)
+		(*it)->onTransferUpdate(api, transfer);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onTransferUpdate(api, transfer);
+
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener) listener->onTransferUpdate(api, transfer);
+
+	activeTransfer = NULL;
+}
+
+bool MegaApiImpl::fireOnTransferData(MegaTransferPrivate *transfer)
+{
+	activeTransfer = transfer;
+	bool result = false;
+	MegaTransferListener* listener = transfer->getListener();
+	if(listener)
+		result = listener->onTransferData(api, transfer, transfer->getLastBytes(), transfer->getDeltaSize());
+
+	activeTransfer = NULL;
+	return result;
+}
+
+void MegaApiImpl::fireOnTransferBuffer(MegaTransferPrivate *transfer, int buffer, m_off_t position, size_t size)
+{
+    activeTransfer = transfer;
+    MegaTransferListener* listener = transfer->getListener();
+    if (listener)
+    {
+        listener->onTransferBuffer(api, transfer, buffer, transfer->getStreamingRing()->buffers[buffer], position, size);
+    }
+    activeTransfer = NULL;
+}
+
+void MegaApiImpl::fireOnUsersUpdate(MegaUserList *users)
+{
+    TraceSpan span(&client->tracer, "onUsersUpdate");
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::USERS_UPDATE);
+        event->users = users ? users->copy() : NULL;
+        queueGlobalCallback(event);
+        return;
+    }
+
+	activeUsers = users;
+
+	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onUsersUpdate(api, users);
+    }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onUsersUpdate(api, users);
+    }
+
+    activeUsers = NULL;
+}
+
+void MegaApiImpl::fireOnContactRequestsUpdate(MegaContactRequestList *requests)
+{
+    TraceSpan span(&client->tracer, "onContactRequestsUpdate");
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::CONTACT_REQUESTS_UPDATE);
+        event->contactRequests = requests ? requests->copy() : NULL;
+        queueGlobalCallback(event);
+        return;
+    }
+
+    activeContactRequests = requests;
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onContactRequestsUpdate(api, requests);
+    }
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onContactRequestsUpdate(api, requests);
+    }
+
+    activeContactRequests = NULL;
+}
+
+void MegaApiImpl::fireOnNodesUpdate(MegaNodeList *nodes)
+{
+    TraceSpan span(&client->tracer, "onNodesUpdate");
+
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::NODES_UPDATE);
+        event->nodes = nodes ? nodes->copy() : NULL;
+        queueGlobalCallback(event);
+        return;
+    }
+
+	activeNodes = nodes;
+
+	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onNodesUpdate(api, nodes);
+    }
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onNodesUpdate(api, nodes);
+    }
+
+    activeNodes = NULL;
+}
+
+void MegaApiImpl::fireOnAccountUpdate()
+{
+    if (callbackExecutor->isEnabled())
+    {
+        queueGlobalCallback(new MegaCallbackEvent(MegaCallbackEvent::ACCOUNT_UPDATE));
+        return;
+    }
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+    {
+        (*it)->onAccountUpdate(api);
+    }
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+    {
+        (*it)->onAccountUpdate(api);
+    }
+}
+
+void MegaApiImpl::fireOnReloadNeeded()
+{
+    if (callbackExecutor->isEnabled())
+    {
+        queueGlobalCallback(new MegaCallbackEvent(MegaCallbackEvent::RELOAD_NEEDED));
+        return;
+    }
+
+	for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+		(*it)->onReloadNeeded(api);
+
+	for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+		(*it)->onReloadNeeded(api);
+}
+
+#ifdef ENABLE_SYNC
+void MegaApiImpl::fireOnSyncStateChanged(MegaSyncPrivate *sync)
+{
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::SYNC_STATE_CHANGED);
+        event->sync = sync->copy();
+        queueSyncCallback(event, sync);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncStateChanged(api, sync);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncStateChanged(api, sync);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncStateChanged(api, sync);
+    }
+}
+
+void MegaApiImpl::fireOnSyncEvent(MegaSyncPrivate *sync, MegaSyncEvent *event)
+{
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *callback = new MegaCallbackEvent(MegaCallbackEvent::SYNC_EVENT);
+        callback->sync = sync->copy();
+        callback->syncEvent = event;
+        queueSyncCallback(callback, sync);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncEvent(api, sync, event);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncEvent(api, sync, event);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncEvent(api, sync, event);
+    }
+
+    delete event;
+}
+
+void MegaApiImpl::fireOnGlobalSyncStateChanged()
+{
+    if (callbackExecutor->isEnabled())
+    {
+        queueGlobalCallback(new MegaCallbackEvent(MegaCallbackEvent::GLOBAL_SYNC_STATE_CHANGED));
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onGlobalSyncStateChanged(api);
+
+    for(set<MegaGlobalListener *>::iterator it = globalListeners.begin(); it != globalListeners.end() ; it++)
+        (*it)->onGlobalSyncStateChanged(api);
+}
+
+void MegaApiImpl::fireOnFileSyncStateChanged(MegaSyncPrivate *sync, const char *filePath, int newState)
+{
+    if (callbackExecutor->isEnabled())
+    {
+        MegaCallbackEvent *event = new MegaCallbackEvent(MegaCallbackEvent::SYNC_FILE_STATE_CHANGED);
+        event->sync = sync->copy();
+        event->path = filePath ? filePath : "";
+        event->state = newState;
+        queueSyncCallback(event, sync);
+        return;
+    }
+
+    for(set<MegaListener *>::iterator it = listeners.begin(); it != listeners.end() ; it++)
+        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+
+    for(set<MegaSyncListener *>::iterator it = syncListeners.begin(); it != syncListeners.end() ; it++)
+        (*it)->onSyncFileStateChanged(api, sync, filePath, newState);
+
+    MegaSyncListener* listener = sync->getListener();
+    if(listener)
+    {
+        listener->onSyncFileStateChanged(api, sync, filePath, newState);
+    }
+}
+
+#endif
+
+MegaError MegaApiImpl::checkAccess(MegaNode* megaNode, int level)
+{
+    if(!megaNode || level < MegaShare::ACCESS_UNKNOWN || level > MegaShare::ACCESS_OWNER)
+    {
+        return MegaError(API_EARGS);
+    }
+
+    sdkMutex.lock();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+	if(!node)
+	{
+        sdkMutex.unlock();
+        return MegaError(API_ENOENT);
+	}
+
+    accesslevel_t a = OWNER;
+    switch(level)
+    {
+    	case MegaShare::ACCESS_UNKNOWN:
+    	case MegaShare::ACCESS_READ:
+    		a = RDONLY;
+    		break;
+    	case MegaShare::ACCESS_READWRITE:
+    		a = RDWR;
+    		break;
+    	case MegaShare::ACCESS_FULL:
+    		a = FULL;
+    		break;
+    	case MegaShare::ACCESS_OWNER:
+    		a = OWNER;
+    		break;
+    }
+
+	MegaError e(client->checkaccess(node, a) ? API_OK : API_EACCESS);
+    sdkMutex.unlock();
+
+	return e;
+}
+
+MegaError MegaApiImpl::checkMove(MegaNode* megaNode, MegaNode* targetNode)
+{
+	if(!megaNode || !targetNode) return MegaError(API_EARGS);
+
+    sdkMutex.lock();
+    Node *node = client->nodebyhandle(megaNode->getHandle());
+	Node *target = client->nodebyhandle(targetNode->getHandle());
+	if(!node || !target)
+	{
+        sdkMutex.unlock();
+        return MegaError(API_ENOENT);
+	}
+
+	MegaError e(client->checkmove(node,target));
+    sdkMutex.unlock();
+
+    return e;
+}
+
+bool MegaApiImpl::isFilesystemAvailable()
+{
+    sdkMutex.lock();
+    bool result = client->nodebyhandle(client->rootnodes[0]) != NULL;
+    sdkMutex.unlock();
+    return result;
+}
+
+// strict orderings, ties broken by node handle so that sorted views are
+// deterministic and getIndex() can binary search them
+bool MegaApiImpl::nodeComparatorDefaultASC (Node *i, Node *j)
+{
+    if(i->type < j->type) return 0;
+    if(i->type > j->type) return 1;
+    int cmp = strcasecmp(i->displayname(), j->displayname());
+    if(cmp) return cmp < 0;
+    return i->nodehandle < j->nodehandle;
+}
+
+bool MegaApiImpl::nodeComparatorDefaultDESC (Node *i, Node *j)
+{
+    if(i->type < j->type) return 1;
+    if(i->type > j->type) return 0;
+    int cmp = strcasecmp(i->displayname(), j->displayname());
+    if(cmp) return cmp > 0;
+    return i->nodehandle < j->nodehandle;
+}
+
+bool MegaApiImpl::nodeComparatorSizeASC (Node *i, Node *j)
+{ if(i->size != j->size) return i->size < j->size; return i->nodehandle < j->nodehandle; }
+bool MegaApiImpl::nodeComparatorSizeDESC (Node *i, Node *j)
+{ if(i->size != j->size) return i->size > j->size; return i->nodehandle < j->nodehandle; }
+
+bool MegaApiImpl::nodeComparatorCreationASC  (Node *i, Node *j)
+{ if(i->ctime != j->ctime) return i->ctime < j->ctime; return i->nodehandle < j->nodehandle; }
+bool MegaApiImpl::nodeComparatorCreationDESC  (Node *i, Node *j)
+{ if(i->ctime != j->ctime) return i->ctime > j->ctime; return i->nodehandle < j->nodehandle; }
+
+bool MegaApiImpl::nodeComparatorModificationASC  (Node *i, Node *j)
+{ if(i->mtime != j->mtime) return i->mtime < j->mtime; return i->nodehandle < j->nodehandle; }
+bool MegaApiImpl::nodeComparatorModificationDESC  (Node *i, Node *j)
+{ if(i->mtime != j->mtime) return i->mtime > j->mtime; return i->nodehandle < j->nodehandle; }
+
+bool MegaApiImpl::nodeComparatorAlphabeticalASC  (Node *i, Node *j)
+{
+    int cmp = strcasecmp(i->displayname(), j->displayname());
+    if(cmp) return cmp < 0;
+    return i->nodehandle < j->nodehandle;
+}
+
+bool MegaApiImpl::nodeComparatorAlphabeticalDESC  (Node *i, Node *j)
+{
+    int cmp = strcasecmp(i->displayname(), j->displayname());
+    if(cmp) return cmp > 0;
+    return i->nodehandle < j->nodehandle;
+}
+
+NodeChildren::comparator MegaApiImpl::getComparator(int order)
+{
+    switch(order)
+    {
+        case MegaApi::ORDER_DEFAULT_ASC: return MegaApiImpl::nodeComparatorDefaultASC;
+        case MegaApi::ORDER_DEFAULT_DESC: return MegaApiImpl::nodeComparatorDefaultDESC;
+        case MegaApi::ORDER_SIZE_ASC: return MegaApiImpl::nodeComparatorSizeASC;
+        case MegaApi::ORDER_SIZE_DESC: return MegaApiImpl::nodeComparatorSizeDESC;
+        case MegaApi::ORDER_CREATION_ASC: return MegaApiImpl::nodeComparatorCreationASC;
+        case MegaApi::ORDER_CREATION_DESC: return MegaApiImpl::nodeComparatorCreationDESC;
+        case MegaApi::ORDER_MODIFICATION_ASC: return MegaApiImpl::nodeComparatorModificationASC;
+        case MegaApi::ORDER_MODIFICATION_DESC: return MegaApiImpl::nodeComparatorModificationDESC;
+        case MegaApi::ORDER_ALPHABETICAL_ASC: return MegaApiImpl::nodeComparatorAlphabeticalASC;
+        case MegaApi::ORDER_ALPHABETICAL_DESC: return MegaApiImpl::nodeComparatorAlphabeticalDESC;
+        default: return MegaApiImpl::nodeComparatorDefaultASC;
+    }
+}
+
+// sorted view of the children of a folder, built once per order and kept by
+// the folder until its children change
+// views are built under the shared SDK lock, so building is serialized by
+// viewsMutex; existing views are only discarded under the exclusive lock
+const node_vector *MegaApiImpl::getSortedChildren(Node *parent, int order)
+{
+    client->loadchildren(parent);
+
+    if (client->nodesdeferred)
+    {
+        // the exclusive lock is held (see lockRead()) - decrypt before
+        // sorting so that names do not change under the comparator
+        client->decryptchildren(parent);
+    }
+
+    viewsMutex.lock();
+    const node_vector *view = parent->children.sorted(order, getComparator(order));
+    viewsMutex.unlock();
+
+    return view;
+}
+
+// child counts are maintained by NodeChildren and need no decryption, but
+// paged out children have to be loaded first
+int MegaApiImpl::getNumChildren(MegaNode* p)
+{
+	if (!p) return 0;
+
+	bool exclusive = lockRead();
+	Node *parent = client->nodebyhandle(p->getHandle());
+	if (parent) client->loadchildren(parent);
+	int numChildren = parent ? int(parent->children.size()) : 0;
+	unlockRead(exclusive);
+
+	return numChildren;
+}
+
+int MegaApiImpl::getNumChildFiles(MegaNode* p)
+{
+	if (!p) return 0;
+
+	bool exclusive = lockRead();
+	Node *parent = client->nodebyhandle(p->getHandle());
+	if (parent) client->loadchildren(parent);
+	int numFiles = parent ? int(parent->children.files()) : 0;
+	unlockRead(exclusive);
+
+	return numFiles;
+}
+
+int MegaApiImpl::getNumChildFolders(MegaNode* p)
+{
+	if (!p) return 0;
+
+	bool exclusive = lockRead();
+	Node *parent = client->nodebyhandle(p->getHandle());
+	if (parent) client->loadchildren(parent);
+	int numFolders = parent ? int(parent->children.folders()) : 0;
+	unlockRead(exclusive);
+
+	return numFolders;
+}
+
+
+MegaNodeList *MegaApiImpl::getChildren(MegaNode* p, int order)
+{
+    if(!p) return new MegaNodeListPrivate();
+
+    return getChildWindow(p->getHandle(), order, 0, INT_MAX);
+}
+
+MegaNodeList *MegaApiImpl::getChildren(MegaNode *p, int order, int offset, int limit)
+{
+    if(!p) return new MegaNodeListPrivate();
+
+    return getChildWindow(p->getHandle(), order, offset, limit);
+}
+
+MegaNodeList *MegaApiImpl::getChildWindow(MegaHandle parentHandle, int order, int offset, int limit)
+{
+    if(offset < 0 || limit <= 0) return new MegaNodeListPrivate();
+
+    bool exclusive = lockRead();
+    Node *parent = client->nodebyhandle(parentHandle);
+    if(parent)
+    {
+        client->loadchildren(parent);
+    }
+
+    if(!parent || (size_t)offset >= parent->children.size())
+    {
+        unlockRead(exclusive);
+        return new MegaNodeListPrivate();
+    }
+
+    size_t count = parent->children.size() - offset;
+    if(count > (size_t)limit) count = limit;
+
+    vector<Node *> childrenNodes;
+
+    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
+    {
+        childrenNodes.assign(parent->children.begin() + offset, parent->children.begin() + offset + count);
+    }
+    else
+    {
+        const node_vector *view = getSortedChildren(parent, order);
+        childrenNodes.assign(view->begin() + offset, view->begin() + offset + count);
+    }
+
+    // copy the nodes while the lock still protects them
+    MegaNodeList *nodeList = new MegaNodeListPrivate(childrenNodes.data(), childrenNodes.size());
+    unlockRead(exclusive);
+
+    return nodeList;
+}
+
+MegaChildrenCursor *MegaApiImpl::getChildrenCursor(MegaNode *p, int order)
+{
+    if(!p) return NULL;
+
+    return new MegaChildrenCursorPrivate(this, p->getHandle(), order);
+}
+
+// the nodes are copied under a single acquisition of the lock, so the
+// snapshot is consistent with one scsn
+MegaNodeSnapshot *MegaApiImpl::getNodeSnapshot(MegaNode *n, int order)
+{
+    vector<Node *> roots;
+
+    bool exclusive = lockRead();
+
+    if (n)
+    {
+        Node *node = client->nodebyhandle(n->getHandle());
+        if (!node)
+        {
+            unlockRead(exclusive);
+            return NULL;
+        }
+
+        roots.push_back(node);
+    }
+    else
+    {
+        for (unsigned i = 0; i < sizeof client->rootnodes / sizeof *client->rootnodes; i++)
+        {
+            Node *node = client->nodebyhandle(client->rootnodes[i]);
+            if (node)
+            {
+                roots.push_back(node);
+            }
+        }
+    }
+
+    if (exclusive)
+    {
+        // paged out nodes have to be loaded to be part of the snapshot
+        for (size_t i = 0; i < roots.size(); i++)
+        {
+            client->loadtree(roots[i]);
+        }
+    }
+
+    MegaNodeSnapshot *snapshot = new MegaNodeSnapshotPrivate(this, client->scsn, &roots, order);
+    unlockRead(exclusive);
+
+    return snapshot;
+}
+
+int MegaApiImpl::getIndex(MegaNode *n, int order)
+{
+    if(!n)
+    {
+        return -1;
+    }
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+    if(!node)
+    {
+        unlockRead(exclusive);
+        return -1;
+    }
+
+    Node *parent = node->parent;
+    if(!parent)
+    {
+        unlockRead(exclusive);
+        return -1;
+    }
+
+
+    if(!order || order> MegaApi::ORDER_ALPHABETICAL_DESC)
+    {
+        unlockRead(exclusive);
+        return 0;
+    }
+
+    const node_vector *view = getSortedChildren(parent, order);
+    node_vector::const_iterator it = std::lower_bound(view->begin(), view->end(), node, getComparator(order));
+    int index = it - view->begin();
+
+    unlockRead(exclusive);
+    return index;
+}
+
+MegaNode *MegaApiImpl::getChildNode(MegaNode *parent, const char* name)
+{
+    if(!parent || !name)
+    {
+        return NULL;
+    }
+
+    sdkMutex.lock();
+    Node *parentNode = client->nodebyhandle(parent->getHandle());
+	if(!parentNode)
+	{
+        sdkMutex.unlock();
+        return NULL;
+	}
+
+    MegaNode *node = MegaNodePrivate::fromNode(client->childnodebyname(parentNode, name));
+    sdkMutex.unlock();
+    return node;
+}
+
+Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint)
+{
+    FileFingerprint fp;
+    if(!parseFingerprint(fingerprint, &fp))
+        return NULL;
+
+    sdkMutex.lock();
+    Node *n  = client->nodebyfingerprint(&fp);
+    sdkMutex.unlock();
+
+    return n;
+}
+
+Node *MegaApiImpl::getNodeByFingerprintInternal(const char *fingerprint, Node *parent)
+{
+    FileFingerprint fp;
+    if(!parseFingerprint(fingerprint, &fp))
+        return NULL;
+
+    sdkMutex.lock();
+    Node *n  = client->nodebyfingerprint(&fp);
+    if(n && parent && n->parent != parent)
+    {
+        for (node_list::iterator it = parent->children.begin(); it != parent->children.end(); it++)
+        {
+            Node* node = (*it);
+            if(*((FileFingerprint *)node) == *((FileFingerprint *)n))
+            {
+                n = node;
+                break;
+            }
+        }
+    }
+    sdkMutex.unlock();
+
+    return n;
+}
+
+MegaNode* MegaApiImpl::getParentNode(MegaNode* n)
+{
+    if(!n) return NULL;
+
+    bool exclusive = lockRead();
+    Node *node = client->nodebyhandle(n->getHandle());
+	if(!node)
+	{
+        unlockRead(exclusive);
+        return NULL;
+	}
+
+    MegaNode *result = MegaNodePrivate::fromNode(node->parent);
+    unlockRead(exclusive);
+
+	return result;
+}
+
+char* MegaApiImpl::getNodePath(MegaNode *node)
+{
+    if(!node) return NULL;
+
+    sdkMutex.lock();
+    Node *n = client->nodebyhandle(node->getHandle());
+    if(!n)
+	{
+        sdkMutex.unlock();
+        return NULL;
+	}
+
+	string path;
+    if (pathCache.findPath(n->nodehandle, &path))
+    {
+        sdkMutex.unlock();
+        return stringToArray(path);
+    }
+
+    // paths with undecrypted names are not cached
+    handle h = n->nodehandle;
+    bool cacheable = true;
+	if (n->nodehandle == client->rootnodes[0])
+	{
+		path = "/";
+        sdkMutex.unlock();
+        return stringToArray(path);
+	}
+
+	while (n)
+	{
+        if (n->attrstring)
+        {
+            cacheable = false;
+        }
+
+		switch (n->type)
+		{
+		case FOLDERNODE:
+			path.insert(0,n->displayname());
+
+			if (n->inshare())
+			{
+				path.insert(0,":");
+				if (n->inshare()->user) path.insert(0,n->inshare()->user->email);
+				else path.insert(0,"UNKNOWN");
+                if (cacheable) pathCache.addPath(h, &path);
+                sdkMutex.unlock();
+                return stringToArray(path);
+			}
+			break;
+
+		case INCOMINGNODE:
+			path.insert(0,"//in");
+            if (cacheable) pathCache.addPath(h, &path);
+            sdkMutex.unlock();
+            return stringToArray(path);
+
+		case ROOTNODE:
+            if (cacheable) pathCache.addPath(h, &path);
+            sdkMutex.unlock();
+            return stringToArray(path);
+
+		case RUBBISHNODE:
+			path.insert(0,"//bin");
+            if (cacheable) pathCache.addPath(h, &path);
+            sdkMutex.unlock();
+            return stringToArray(path);
+
+		case TYPE_UNKNOWN:
+		case FILENODE:
+			path.insert(0,n->displayname());
+		}
+
+		path.insert(0,"/");
+
+        n = n->parent;
+	}
+    if (cacheable) pathCache.addPath(h, &path);
+    sdkMutex.unlock();
+    return stringToArray(path);
+}
+
+MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
+{
+    if(!path) return NULL;
+
+    sdkMutex.lock();
+    Node *cwd = NULL;
+    if(node) cwd = client->nodebyhandle(node->getHandle());
+
+    // absolute paths don't depend on the working folder
+    const char *fullPath = path;
+    handle cwdHandle = (cwd && *path != '/') ? cwd->nodehandle : UNDEF;
+    handle cachedHandle;
+    Node *cached;
+    if (pathCache.findNode(cwdHandle, fullPath, &cachedHandle) && (cached = client->nodebyhandle(cachedHandle)))
+    {
+        MegaNode *result = MegaNodePrivate::fromNode(cached);
+        sdkMutex.unlock();
+        return result;
+    }
+
+	vector<string> c;
+	string s;
+	int l = 0;
+	const char* bptr = path;
+	int remote = 0;
+	Node* n;
+	Node* nn;
+
+	// split path by / or :
+	do {
+		if (!l)
+		{
+			if (*path >= 0)
+			{
+				if (*path == '\\')
+				{
+                    if (path > bptr)
+                    {
+                        s.append(bptr, path - bptr);
+                    }
+
+					bptr = ++path;
+
+					if (*bptr == 0)
+					{
+						c.push_back(s);
+						break;
+					}
+
+					path++;
+					continue;
+				}
+
+				if (*path == '/' || *path == ':' || !*path)
+				{
+					if (*path == ':')
+					{
+						if (c.size())
+						{
+                            sdkMutex.unlock();
+                            return NULL;
+						}
+						remote = 1;
+					}
+
+                    if (path > bptr)
+                    {
+                        s.append(bptr, path - bptr);
+                    }
+
+                    bptr = path + 1;
+
+					c.push_back(s);
+
+					s.erase();
+				}
+			}
+            else if ((*path & 0xf0) == 0xe0)
+            {
+                l = 1;
+            }
+            else if ((*path & 0xf8) == 0xf0)
+            {
+                l = 2;
+            }
+            else if ((*path & 0xfc) == 0xf8)
+            {
+                l = 3;
+            }
+            else if ((*path & 0xfe) == 0xfc)
+            {
+                l = 4;
+            }
+		}
+        else
+        {
+            l--;
+        }
+	} while (*path++);
+
+	if (l)
+	{
+        sdkMutex.unlock();
+        return NULL;
+	}
+
+	if (remote)
+	{
+        // target: user inbox - it's not a node - return NULL
+		if (c.size() == 2 && !c[1].size())
+		{
+            sdkMutex.unlock();
+            return NULL;
+		}
+
+		User* u;
+
+        if ((u = client->finduser(c[0].c_str())))
+        {
+            // locate matching share from this user
+            handle_set::iterator sit;
+            string name;
+            for (sit = u->sharing.begin(); sit != u->sharing.end(); sit++)
+            {
+                if ((n = client->nodebyhandle(*sit)))
+                {
+                    if(!name.size())
+                    {
+                        name =  c[1];
+                        n->client->fsaccess->normalize(&name);
+                    }
+
+                    if (!strcmp(name.c_str(), n->displayname()))
+                    {
+                        l = 2;
+                        break;
+                    }
+                }
+            }
+        }
+
+		if (!l)
+		{
+            sdkMutex.unlock();
+            return NULL;
+		}
+	}
+	else
+	{
+		// path starting with /
+		if (c.size() > 1 && !c[0].size())
+		{
+			// path starting with //
+			if (c.size() > 2 && !c[1].size())
+			{
+                if (c[2] == "in")
+                {
+                    n = client->nodebyhandle(client->rootnodes[1]);
+                }
+                else if (c[2] == "bin")
+                {
+                    n = client->nodebyhandle(client->rootnodes[2]);
+                }
+				else
+				{
+                    sdkMutex.unlock();
+                    return NULL;
+				}
+
+				l = 3;
+			}
+			else
+			{
+				n = client->nodebyhandle(client->rootnodes[0]);
+				l = 1;
+			}
+		}
+        else
+        {
+            n = cwd;
+        }
+	}
+
+	// parse relative path
+	while (n && l < (int)c.size())
+	{
+		if (c[l] != ".")
+		{
+			if (c[l] == "..")
+			{
+                if (n->parent)
+                {
+                    n = n->parent;
+                }
+			}
+			else
+			{
+				// locate child node (explicit ambiguity resolution: not implemented)
+				if (c[l].size())
+				{
+                    nn = client->childnodebyname(n, c[l].c_str());
+
+					if (!nn)
+					{
+                        sdkMutex.unlock();
+                        return NULL;
+					}
+
+					n = nn;
+				}
+			}
+		}
+
+		l++;
+	}
+
+    if (n)
+    {
+        pathCache.addNode(cwdHandle, fullPath, n->nodehandle);
+    }
+
+    MegaNode *result = MegaNodePrivate::fromNode(n);
+    sdkMutex.unlock();
+    return result;
+}
+
+MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
+{
+	if(handle == UNDEF) return NULL;
+    bool exclusive = lockRead();
+    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
+    unlockRead(exclusive);
+    return result;
+}
+
+MegaContactRequest *MegaApiImpl::getContactRequestByHandle(MegaHandle handle)
+{
+    sdkMutex.lock();
+    if(client->pcrindex.find(handle) == client->pcrindex.end())
+    {
+        sdkMutex.unlock();
+        return NULL;
+    }
+    MegaContactRequest* request = MegaContactRequestPrivate::fromContactRequest(client->pcrindex.at(handle));
+    sdkMutex.unlock();
+    return request;
+}
+
+void MegaApiImpl::sendPendingTransfers()
+{
+    MegaTransferPrivate *transfer;
+    error e;
+    int nextTag;
+
+    while((transfer = transferQueue.pop()))
+    {
+        sdkMutex.lock();
+        transfer->setTiming(MegaTransfer::TIMING_DISPATCHED);
+        e = API_OK;
+        nextTag = client->nextreqtag();
+
+        switch(transfer->getType())
+        {
+            case MegaTransfer::TYPE_UPLOAD:
+            {
+                if (uploadsQueued())
+                {
+                    queueUpload(transfer, false);
+                    break;
+                }
+
+                const char* localPath = transfer->getPath();
+                const char* fileName = transfer->getFileName();
+                int64_t mtime = transfer->getTime();
+                Node *parent = client->nodebyhandle(transfer->getParentHandle());
+
+                if(!localPath || !parent || !fileName || !(*fileName))
+                {
+                    e = API_EARGS;
+                    break;
+                }
+
+                string tmpString = localPath;
+                string wLocalPath;
+                client->fsaccess->path2local(&tmpString, &wLocalPath);
+
+                FileAccess *fa = fsAccess->newfileaccess();
+                if(!fa->fopen(&wLocalPath, true, false))
+                {
+                    e = API_EREAD;
+                    break;
+                }
+
+                nodetype_t type = fa->type;
+
+                // a fingerprint passed by the app spares reading the file
+                // again, unless it has changed since
+                FileFingerprint *fp = transfer->getKnownFingerprint();
+                if (fp && (fp->size != fa->size || fp->mtime != fa->mtime))
+                {
+                    fp = NULL;
+                }
+
+                delete fa;
+
+                if(type == FILENODE)
+                {
+                    persistTransfer(transfer, fp, false);
+
+                    string wFileName = fileName;
+                    MegaFilePut *f = new MegaFilePut(client, &wLocalPath, &wFileName, transfer->getParentHandle(), "", mtime);
+                    if (fp)
+                    {
+                        *(FileFingerprint *)f = *fp;
+                    }
+                    startFilePut(transfer, f, nextTag);
+                }
+                else
+                {
+                    transferMap[nextTag]=transfer;
+                    transfer->setTag(nextTag);
+                    MegaFolderUploadController *uploader = new MegaFolderUploadController(this, transfer);
+                    uploader->start();
+                }
+                break;
+            }
+            case MegaTransfer::TYPE_DOWNLOAD:
+            {
+                handle nodehandle = transfer->getNodeHandle();
+				Node *node = client->nodebyhandle(nodehandle);
+                MegaNode *publicNode = transfer->getPublicNode();
+                const char *parentPath = transfer->getParentPath();
+                const char *fileName = transfer->getFileName();
+                if(!node && !publicNode) { e = API_EARGS; break; }
+
+                currentTransfer=transfer;
+                if (transfer->getOutputStream())
+                {
+                    if ((node && node->type != FILENODE) || (!node && publicNode->getType() != MegaNode::TYPE_FILE))
+                    {
+                        currentTransfer = NULL;
+                        e = API_EARGS;
+                        break;
+                    }
+
+                    MegaFileGet *f = node ? new MegaFileGet(client, node, string())
+                                          : new MegaFileGet(client, publicNode, string());
+
+                    transfer->setFileName(f->name.c_str());
+                    f->setOutputStream(transfer->getOutputStream());
+                    client->startxfer(GET, f);
+                }
+                else if(parentPath || fileName)
+                {
+                    string name;
+                    string securename;
+                    string path;
+
+					if(parentPath)
+					{
+						path = parentPath;
+					}
+					else
+					{
+						string separator;
+						client->fsaccess->local2path(&client->fsaccess->localseparator, &separator);
+						path = ".";
+						path.append(separator);
+					}
+
+					MegaFileGet *f;
+
+					if(node)
+					{
+						if(!fileName)
+                        {
+                            attr_map::iterator ait = node->attrs.map.find('n');
+                            if(ait == node->attrs.map.end())
+                            {
+                                name = "CRYPTO_ERROR";
+                            }
+                            else if(!ait->second.size())
+                            {
+                                name = "BLANK";
+                            }
+                            else
+                            {
+                                name = ait->second;
+                            }
+                        }
+                        else
+                        {
+                            name = fileName;
+                        }
+
+                        client->fsaccess->name2local(&name);
+                        client->fsaccess->local2path(&name, &securename);
+                        path += securename;
+
+                        if (node->type != FILENODE)
+                        {
+                            transfer->setPath(path.c_str());
+                            transferMap[nextTag]=transfer;
+                            transfer->setTag(nextTag);
+                            currentTransfer=NULL;
+                            MegaFolderDownloadController *downloader = new MegaFolderDownloadController(this, transfer);
+                            downloader->start();
+                            break;
+                        }
+
+                        if (!transfer->getQueueRecord())
+                        {
+                            persistTransfer(transfer, NULL, false);
+                        }
+
+						f = new MegaFileGet(client, node, path);
+					}
+					else
+					{
+						if(!transfer->getFileName())
+                            name = publicNode->getName();
+                        else
+                            name = transfer->getFileName();
+
+                        client->fsaccess->name2local(&name);
+                        client->fsaccess->local2path(&name, &securename);
+                        path += securename;
+						f = new MegaFileGet(client, publicNode, path);
+					}
+
+					transfer->setPath(path.c_str());
+                    bool ok = client->startxfer(GET, f, true);
+                    if(transfer->getTag() == -1)
+                    {
+                        //Already existing transfer
+                        if (ok)
+                        {
+                            //Set the transfer as regular
+                            transfer_map::iterator it = client->transfers[GET].find(f);
+                            if(it != client->transfers[GET].end())
+                            {
+                                int previousTag = it->second->tag;
+                                if(transferMap.find(previousTag) != transferMap.end())
+                                {
+                                    MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
+                                    previousTransfer->setSyncTransfer(false);
+                                }
+                            }
+                        }
+                        else
+                        {
+                            //Already existing transfer
+                            transferMap[nextTag]=transfer;
+                            transfer->setTag(nextTag);
+                            fireOnTransferStart(transfer);
+                            fireOnTransferFinish(transfer, MegaError(API_EEXIST));
+                        }
+                    }
+                }
+                else
+                {
+                	m_off_t startPos = transfer->getStartPos();
+                	m_off_t endPos = transfer->getEndPos();
+                	if(startPos < 0 || endPos < 0 || startPos > endPos) { e = API_EARGS; break; }
+                    if (transfer->getStreamingRing() && !transfer->getStreamingRing()->buffers.size()) { e = API_EARGS; break; }
+                	if(node)
+                	{
+                        transfer->setFileName(node->displayname());
+                		if(startPos >= node->size || endPos >= node->size)
+                		{ e = API_EARGS; break; }
+
+                		m_off_t totalBytes = endPos - startPos + 1;
+                	    transferMap[nextTag]=transfer;
+						transfer->setTotalBytes(totalBytes);
+						transfer->setTag(nextTag);
+                        if (transfer->getStreamingRing())
+                        {
+                            streamingRings[nextTag] = transfer->getStreamingRing();
+                        }
+                        fireOnTransferStart(transfer);
+                	    client->pread(node, startPos, totalBytes, transfer);
+                	    waiter->notify();
+                	}
+                	else
+                	{
+                        transfer->setFileName(publicNode->getName());
+                        if(startPos >= publicNode->getSize() || endPos >= publicNode->getSize())
+                        { e = API_EARGS; break; }
+
+                        m_off_t totalBytes = endPos - startPos + 1;
+                        transferMap[nextTag]=transfer;
+                        transfer->setTotalBytes(totalBytes);
+                        transfer->setTag(nextTag);
+                        if (transfer->getStreamingRing())
+                        {
+                            streamingRings[nextTag] = transfer->getStreamingRing();
+                        }
+                        fireOnTransferStart(transfer);
+                        SymmCipher cipher;
+                        cipher.setkey(publicNode->getNodeKey());
+                        client->pread(publicNode->getHandle(), &cipher,
+                            MemAccess::get<int64_t>((const char*)publicNode->getNodeKey()->data() + SymmCipher::KEYLENGTH),
+                                      startPos, totalBytes, transfer);
+                        waiter->notify();
+                	}
+                }
+
+                currentTransfer=NULL;
+				break;
+			}
+		}
+
+		if(e)
+            fireOnTransferFinish(transfer, MegaError(e));
+
+        sdkMutex.unlock();
+    }
+}
+
+void MegaApiImpl::startFilePut(MegaTransferPrivate *transfer, MegaFilePut *f, int nextTag)
+{
+    currentTransfer = transfer;
+
+    bool started = client->startxfer(PUT, f, true);
+    if(!started)
+    {
+        if(!f->isvalid)
+        {
+            //Unable to read the file
+            transfer->setSyncTransfer(false);
+            transferMap[nextTag]=transfer;
+            transfer->setTag(nextTag);
+            fireOnTransferStart(transfer);
+            fireOnTransferFinish(transfer, MegaError(API_EREAD));
+        }
+        else
+        {
+            //Already existing transfer
+            transferMap[nextTag]=transfer;
+            transfer->setTag(nextTag);
+            fireOnTransferStart(transfer);
+            fireOnTransferFinish(transfer, MegaError(API_EEXIST));
+        }
+    }
+    else if(transfer->getTag() == -1)
+    {
+        //Already existing transfer
+        //Delete the new one and set the transfer as regular
+        transfer_map::iterator it = client->transfers[PUT].find(f);
+        if(it != client->transfers[PUT].end())
+        {
+            int previousTag = it->second->tag;
+            if(transferMap.find(previousTag) != transferMap.end())
             {
-                n = node;
-                break;
+                MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
+                previousTransfer->setSyncTransfer(false);
+                delete transfer;
             }
         }
     }
-    sdkMutex.unlock();
 
-    return n;
+    currentTransfer = NULL;
 }
 
-MegaNode* MegaApiImpl::getParentNode(MegaNode* n)
+// runs on the fingerprinting threads: open the local file and fingerprint it
+void MegaApiImpl::fingerprintUpload(unsigned i, void *param)
 {
-    if(!n) return NULL;
+    UploadJob *job = &(*(vector<UploadJob> *)param)[i];
+    const char *localPath = job->transfer->getPath();
 
-    sdkMutex.lock();
-    Node *node = client->nodebyhandle(n->getHandle());
-	if(!node)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
+    job->type = TYPE_UNKNOWN;
+    job->e = API_OK;
 
-    MegaNode *result = MegaNodePrivate::fromNode(node->parent);
-    sdkMutex.unlock();
+    if (!localPath)
+    {
+        job->e = API_EARGS;
+        return;
+    }
 
-	return result;
+    string tmpString = localPath;
+    job->fsaccess->path2local(&tmpString, &job->localname);
+
+    FileAccess *fa = job->fsaccess->newfileaccess();
+    if (!fa->fopen(&job->localname, true, false))
+    {
+        job->e = API_EREAD;
+    }
+    else
+    {
+        job->type = fa->type;
+
+        // a known fingerprint is kept while size and mtime match
+        if (job->type == FILENODE && (!job->fingerprint.isvalid || job->fingerprint.size != fa->size
+                                      || job->fingerprint.mtime != fa->mtime))
+        {
+            job->fingerprint.genfingerprint(fa);
+        }
+    }
+    delete fa;
 }
 
-char* MegaApiImpl::getNodePath(MegaNode *node)
+// start the batches of uploads submitted with startUploads(): the files are
+// fingerprinted in parallel without holding the SDK lock, then all
+// transfers are started under a single lock
+void MegaApiImpl::sendPendingUploads()
 {
-    if(!node) return NULL;
-
-    sdkMutex.lock();
-    Node *n = client->nodebyhandle(node->getHandle());
-    if(!n)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
+    UploadBatch *batch;
 
-	string path;
-	if (n->nodehandle == client->rootnodes[0])
-	{
-		path = "/";
-        sdkMutex.unlock();
-        return stringToArray(path);
-	}
+    while ((batch = uploadBatchQueue.pop()))
+    {
+        if (uploadQueueLimit)
+        {
+            sdkMutex.lock();
 
-	while (n)
-	{
-		switch (n->type)
-		{
-		case FOLDERNODE:
-			path.insert(0,n->displayname());
+            size_t i = 0;
 
-			if (n->inshare)
-			{
-				path.insert(0,":");
-				if (n->inshare->user) path.insert(0,n->inshare->user->email);
-				else path.insert(0,"UNKNOWN");
-                sdkMutex.unlock();
-                return stringToArray(path);
-			}
-			break;
+            // the part of the batch there is room for starts now
+            if (!queuedUploads.size())
+            {
+                size_t running = client->transfers[PUT].size();
 
-		case INCOMINGNODE:
-			path.insert(0,"//in");
-            sdkMutex.unlock();
-            return stringToArray(path);
+                while (i < batch->transfers.size() && running + i < uploadQueueLimit)
+                {
+                    i++;
+                }
+            }
 
-		case ROOTNODE:
-            sdkMutex.unlock();
-            return stringToArray(path);
+            for (size_t j = i; j < batch->transfers.size(); j++)
+            {
+                queueUpload(batch->transfers[j], batch->copyDuplicates);
+            }
 
-		case RUBBISHNODE:
-			path.insert(0,"//bin");
+            batch->transfers.resize(i);
             sdkMutex.unlock();
-            return stringToArray(path);
-
-		case TYPE_UNKNOWN:
-		case FILENODE:
-			path.insert(0,n->displayname());
-		}
 
-		path.insert(0,"/");
+            if (!i)
+            {
+                delete batch;
+                continue;
+            }
+        }
 
-        n = n->parent;
-	}
-    sdkMutex.unlock();
-    return stringToArray(path);
+        processUploadBatch(batch);
+    }
 }
 
-MegaNode* MegaApiImpl::getNodeByPath(const char *path, MegaNode* node)
+// fingerprint the files of the batch in parallel, start them under a single
+// lock (the batch is deleted)
+void MegaApiImpl::processUploadBatch(UploadBatch *batch)
 {
-    if(!path) return NULL;
-
-    sdkMutex.lock();
-    Node *cwd = NULL;
-    if(node) cwd = client->nodebyhandle(node->getHandle());
-
-	vector<string> c;
-	string s;
-	int l = 0;
-	const char* bptr = path;
-	int remote = 0;
-	Node* n;
-	Node* nn;
-
-	// split path by / or :
-	do {
-		if (!l)
-		{
-			if (*path >= 0)
-			{
-				if (*path == '\\')
-				{
-                    if (path > bptr)
-                    {
-                        s.append(bptr, path - bptr);
-                    }
-
-					bptr = ++path;
-
-					if (*bptr == 0)
-					{
-						c.push_back(s);
-						break;
-					}
+    unsigned n = batch->transfers.size();
+    vector<UploadJob> jobs(n);
 
-					path++;
-					continue;
-				}
-
-				if (*path == '/' || *path == ':' || !*path)
-				{
-					if (*path == ':')
-					{
-						if (c.size())
-						{
-                            sdkMutex.unlock();
-                            return NULL;
-						}
-						remote = 1;
-					}
-
-                    if (path > bptr)
-                    {
-                        s.append(bptr, path - bptr);
-                    }
-
-                    bptr = path + 1;
-
-					c.push_back(s);
+    for (unsigned i = 0; i < n; i++)
+    {
+        jobs[i].transfer = batch->transfers[i];
+        jobs[i].fsaccess = fsAccess;
 
-					s.erase();
-				}
-			}
-            else if ((*path & 0xf0) == 0xe0)
-            {
-                l = 1;
-            }
-            else if ((*path & 0xf8) == 0xf0)
-            {
-                l = 2;
-            }
-            else if ((*path & 0xfc) == 0xf8)
-            {
-                l = 3;
-            }
-            else if ((*path & 0xfe) == 0xfc)
-            {
-                l = 4;
-            }
-		}
-        else
+        if (i < batch->fingerprints.size())
         {
-            l--;
+            jobs[i].fingerprint = batch->fingerprints[i];
         }
-	} while (*path++);
+        else if (batch->transfers[i]->getKnownFingerprint())
+        {
+            jobs[i].fingerprint = *batch->transfers[i]->getKnownFingerprint();
+        }
+    }
 
-	if (l)
-	{
-        sdkMutex.unlock();
-        return NULL;
-	}
+    if (n > 1)
+    {
+        MegaThreadRunner runner(FINGERPRINTTHREADS);
+        runner.run(n, fingerprintUpload, &jobs);
+    }
+    else
+    {
+        fingerprintUpload(0, &jobs);
+    }
 
-	if (remote)
-	{
-        // target: user inbox - it's not a node - return NULL
-		if (c.size() == 2 && !c[1].size())
-		{
-            sdkMutex.unlock();
-            return NULL;
-		}
+    client->abortbackoff(false);
 
-		User* u;
+    sdkMutex.lock();
+    for (unsigned i = 0; i < n; i++)
+    {
+        UploadJob *job = &jobs[i];
+        MegaTransferPrivate *transfer = job->transfer;
+        const char *fileName = transfer->getFileName();
+        Node *parent = client->nodebyhandle(transfer->getParentHandle());
+        int nextTag = client->nextreqtag();
 
-        if ((u = client->finduser(c[0].c_str())))
+        if (!job->transfer->getPath() || !parent || !fileName || !(*fileName))
         {
-            // locate matching share from this user
-            handle_set::iterator sit;
-            string name;
-            for (sit = u->sharing.begin(); sit != u->sharing.end(); sit++)
-            {
-                if ((n = client->nodebyhandle(*sit)))
-                {
-                    if(!name.size())
-                    {
-                        name =  c[1];
-                        n->client->fsaccess->normalize(&name);
-                    }
+            fireOnTransferFinish(transfer, MegaError(API_EARGS));
+            continue;
+        }
 
-                    if (!strcmp(name.c_str(), n->displayname()))
-                    {
-                        l = 2;
-                        break;
-                    }
-                }
-            }
+        if (job->e)
+        {
+            fireOnTransferFinish(transfer, MegaError(job->e));
+            continue;
         }
 
-		if (!l)
-		{
-            sdkMutex.unlock();
-            return NULL;
-		}
-	}
-	else
-	{
-		// path starting with /
-		if (c.size() > 1 && !c[0].size())
-		{
-			// path starting with //
-			if (c.size() > 2 && !c[1].size())
-			{
-                if (c[2] == "in")
-                {
-                    n = client->nodebyhandle(client->rootnodes[1]);
-                }
-                else if (c[2] == "bin")
-                {
-                    n = client->nodebyhandle(client->rootnodes[2]);
-                }
-				else
-				{
-                    sdkMutex.unlock();
-                    return NULL;
-				}
+        if (job->type != FILENODE)
+        {
+            transferMap[nextTag]=transfer;
+            transfer->setTag(nextTag);
+            MegaFolderUploadController *uploader = new MegaFolderUploadController(this, transfer);
+            uploader->start();
+            continue;
+        }
 
-				l = 3;
-			}
-			else
-			{
-				n = client->nodebyhandle(client->rootnodes[0]);
-				l = 1;
-			}
-		}
-        else
+        Node *duplicate = NULL;
+        if (batch->copyDuplicates && job->fingerprint.isvalid)
         {
-            n = cwd;
+            duplicate = client->nodebyfingerprint(&job->fingerprint);
         }
-	}
 
-	// parse relative path
-	while (n && l < (int)c.size())
-	{
-		if (c[l] != ".")
-		{
-			if (c[l] == "..")
-			{
-                if (n->parent)
-                {
-                    n = n->parent;
-                }
-			}
-			else
-			{
-				// locate child node (explicit ambiguity resolution: not implemented)
-				if (c[l].size())
-				{
-                    nn = client->childnodebyname(n, c[l].c_str());
+        if (!duplicate)
+        {
+            // restored records already hold an unchanged fingerprint
+            if (!transfer->getQueueRecord() || i >= batch->fingerprints.size()
+                    || !(batch->fingerprints[i] == job->fingerprint))
+            {
+                persistTransfer(transfer, &job->fingerprint, batch->copyDuplicates);
+            }
 
-					if (!nn)
-					{
-                        sdkMutex.unlock();
-                        return NULL;
-					}
+            string wFileName = fileName;
+            MegaFilePut *f = new MegaFilePut(client, &job->localname, &wFileName, transfer->getParentHandle(), "", transfer->getTime());
+            *(FileFingerprint *)f = job->fingerprint;
+            startFilePut(transfer, f, nextTag);
+            continue;
+        }
 
-					n = nn;
-				}
-			}
-		}
+        transferMap[nextTag]=transfer;
+        transfer->setTag(nextTag);
+        transfer->setTotalBytes(duplicate->size);
+        fireOnTransferStart(transfer);
 
-		l++;
-	}
+        if (duplicate->parent == parent && !strcmp(duplicate->displayname(), fileName))
+        {
+            // already there
+            transfer->setTransferredBytes(duplicate->size);
+            transfer->setDeltaSize(duplicate->size);
+            fireOnTransferFinish(transfer, MegaError(API_OK));
+            continue;
+        }
 
-    MegaNode *result = MegaNodePrivate::fromNode(n);
+        MegaNode *node = MegaNodePrivate::fromNode(duplicate);
+        MegaNode *target = MegaNodePrivate::fromNode(parent);
+        copyNode(node, target, fileName, new MegaUploadCopyListener(this, transfer));
+        delete target;
+        delete node;
+    }
     sdkMutex.unlock();
-    return result;
+
+    delete batch;
 }
 
-MegaNode* MegaApiImpl::getNodeByHandle(handle handle)
+// new uploads queue behind the parked ones
+bool MegaApiImpl::uploadsQueued()
 {
-	if(handle == UNDEF) return NULL;
-    sdkMutex.lock();
-    MegaNode *result = MegaNodePrivate::fromNode(client->nodebyhandle(handle));
-    sdkMutex.unlock();
-    return result;
+    return uploadQueueLimit && (queuedUploads.size() || client->transfers[PUT].size() >= uploadQueueLimit);
 }
 
-MegaContactRequest *MegaApiImpl::getContactRequestByHandle(MegaHandle handle)
+void MegaApiImpl::queueUpload(MegaTransferPrivate *transfer, bool copyDuplicates)
+{
+    QueuedUpload u;
+
+    if (transfer->getPath())
+    {
+        u.localPath = transfer->getPath();
+    }
+
+    if (transfer->getFileName())
+    {
+        u.fileName = transfer->getFileName();
+    }
+
+    u.parentHandle = transfer->getParentHandle();
+    u.mtime = transfer->getTime();
+    u.folderTransferTag = transfer->getFolderTransferTag();
+    u.listener = transfer->getListener();
+    u.copyDuplicates = copyDuplicates;
+
+    // a fingerprint passed by the app is checked against the file once the
+    // upload is promoted
+    if (transfer->getKnownFingerprint())
+    {
+        u.fingerprint = *transfer->getKnownFingerprint();
+    }
+
+    if (!transfer->getQueueRecord())
+    {
+        persistTransfer(transfer, transfer->getKnownFingerprint(), copyDuplicates);
+    }
+
+    u.record = transfer->getQueueRecord();
+
+    queuedUploads.push_back(u);
+    numQueuedUploads++;
+
+    delete transfer;
+}
+
+// parked uploads with the same duplicate handling start as one batch
+void MegaApiImpl::promoteQueuedUploads()
 {
+    if (!queuedUploads.size())
+    {
+        return;
+    }
+
+    UploadBatch *batch = NULL;
+
     sdkMutex.lock();
-    if(client->pcrindex.find(handle) == client->pcrindex.end())
+    size_t running = client->transfers[PUT].size();
+
+    while (queuedUploads.size() && (!uploadQueueLimit || running < uploadQueueLimit)
+           && (!batch || batch->copyDuplicates == queuedUploads.front().copyDuplicates))
     {
-        sdkMutex.unlock();
-        return NULL;
+        QueuedUpload *u = &queuedUploads.front();
+
+        if (!batch)
+        {
+            batch = new UploadBatch;
+            batch->copyDuplicates = u->copyDuplicates;
+        }
+
+        batch->transfers.push_back(createUpload(u->localPath.size() ? u->localPath.c_str() : NULL, u->parentHandle,
+                                                u->fileName.size() ? u->fileName.c_str() : NULL, u->mtime,
+                                                u->folderTransferTag, u->listener));
+        batch->transfers.back()->setQueueRecord(u->record);
+        batch->fingerprints.push_back(u->fingerprint);
+        queuedUploads.pop_front();
+        numQueuedUploads--;
+        running++;
     }
-    MegaContactRequest* request = MegaContactRequestPrivate::fromContactRequest(client->pcrindex.at(handle));
     sdkMutex.unlock();
-    return request;
+
+    if (batch)
+    {
+        processUploadBatch(batch);
+    }
 }
 
-void MegaApiImpl::sendPendingTransfers()
+// the parked uploads start and finish right away (the SDK lock must be held)
+void MegaApiImpl::abortQueuedUploads(error e)
 {
-    MegaTransferPrivate *transfer;
-    error e;
-    int nextTag;
+    while (queuedUploads.size())
+    {
+        QueuedUpload *u = &queuedUploads.front();
+        MegaTransferPrivate *transfer = createUpload(u->localPath.size() ? u->localPath.c_str() : NULL, u->parentHandle,
+                                                     u->fileName.size() ? u->fileName.c_str() : NULL, u->mtime,
+                                                     u->folderTransferTag, u->listener);
+        int nextTag = client->nextreqtag();
 
-    while((transfer = transferQueue.pop()))
+        transfer->setQueueRecord(u->record);
+        queuedUploads.pop_front();
+        numQueuedUploads--;
+
+        transferMap[nextTag] = transfer;
+        transfer->setTag(nextTag);
+        fireOnTransferStart(transfer);
+        fireOnTransferFinish(transfer, MegaError(e));
+    }
+}
+
+// flags of a queued transfer record
+enum { QUEUED_COPYDUPLICATES = 1, QUEUED_PATH = 2, QUEUED_FILENAME = 4, QUEUED_FINGERPRINT = 8 };
+
+static void appendQueuedString(string *d, const char *value)
+{
+    uint32_t len = value ? strlen(value) : 0;
+
+    d->append((const char*)&len, sizeof len);
+    d->append(value ? value : "", len);
+}
+
+static bool readQueuedString(const char **ptr, const char *end, string *value)
+{
+    if (end - *ptr < (long)sizeof(uint32_t))
     {
-        sdkMutex.lock();
-        e = API_OK;
-        nextTag = client->nextreqtag();
+        return false;
+    }
 
-        switch(transfer->getType())
+    uint32_t len = MemAccess::get<uint32_t>(*ptr);
+    *ptr += sizeof len;
+
+    if ((uint32_t)(end - *ptr) < len)
+    {
+        return false;
+    }
+
+    value->assign(*ptr, len);
+    *ptr += len;
+    return true;
+}
+
+// record: type, flags, parent (upload) or node (download) handle, mtime,
+// local path (upload) or parent path (download), name, fingerprint (size,
+// mtime, sparse CRC) - written after the next exec() (the SDK lock must be
+// held)
+void MegaApiImpl::persistTransfer(MegaTransferPrivate *transfer, FileFingerprint *fingerprint, bool copyDuplicates)
+{
+    if (!persistTransfers || transfer->getFolderTransferTag() || transfer->isSyncTransfer()
+            || transfer->getPublicNode() || transfer->getOutputStream() || transfer->getStreamingRing())
+    {
+        return;
+    }
+
+    uint32_t id = transfer->getQueueRecord();
+
+    if (!id)
+    {
+        if (!(id = client->reservequeuedtransfer()))
         {
-            case MegaTransfer::TYPE_UPLOAD:
-            {
-                const char* localPath = transfer->getPath();
-                const char* fileName = transfer->getFileName();
-                int64_t mtime = transfer->getTime();
-                Node *parent = client->nodebyhandle(transfer->getParentHandle());
+            return;
+        }
 
-                if(!localPath || !parent || !fileName || !(*fileName))
-                {
-                    e = API_EARGS;
-                    break;
-                }
+        transfer->setQueueRecord(id);
+    }
 
-                string tmpString = localPath;
-                string wLocalPath;
-                client->fsaccess->path2local(&tmpString, &wLocalPath);
+    bool upload = transfer->getType() == MegaTransfer::TYPE_UPLOAD;
+    const char *path = upload ? transfer->getPath() : transfer->getParentPath();
+    const char *fileName = transfer->getFileName();
+    handle h = upload ? transfer->getParentHandle() : transfer->getNodeHandle();
+    int64_t mtime = transfer->getTime();
+    char flags = (copyDuplicates ? QUEUED_COPYDUPLICATES : 0) | (path ? QUEUED_PATH : 0)
+               | (fileName ? QUEUED_FILENAME : 0) | (fingerprint && fingerprint->isvalid ? QUEUED_FINGERPRINT : 0);
+    string *d = &queueWrites[id];
 
-                FileAccess *fa = fsAccess->newfileaccess();
-                if(!fa->fopen(&wLocalPath, true, false))
-                {
-                    e = API_EREAD;
-                    break;
-                }
+    d->clear();
+    d->append(1, (char)transfer->getType());
+    d->append(1, flags);
+    d->append((const char*)&h, sizeof h);
+    d->append((const char*)&mtime, sizeof mtime);
+    appendQueuedString(d, path);
+    appendQueuedString(d, fileName);
 
-                nodetype_t type = fa->type;
-                delete fa;
+    if (flags & QUEUED_FINGERPRINT)
+    {
+        int64_t fpmtime = fingerprint->mtime;
 
-                if(type == FILENODE)
-                {
-                    currentTransfer = transfer;
-                    string wFileName = fileName;
-                    MegaFilePut *f = new MegaFilePut(client, &wLocalPath, &wFileName, transfer->getParentHandle(), "", mtime);
+        d->append((const char*)&fingerprint->size, sizeof fingerprint->size);
+        d->append((const char*)&fpmtime, sizeof fpmtime);
+        d->append((const char*)fingerprint->crc, sizeof fingerprint->crc);
+    }
+}
 
-                    bool started = client->startxfer(PUT, f, true);
-                    if(!started)
-                    {
-                        if(!f->isvalid)
-                        {
-                            //Unable to read the file
-                            transfer->setSyncTransfer(false);
-                            transferMap[nextTag]=transfer;
-                            transfer->setTag(nextTag);
-                            fireOnTransferStart(transfer);
-                            fireOnTransferFinish(transfer, MegaError(API_EREAD));
-                        }
-                        else
-                        {
-                            //Already existing transfer
-                            transferMap[nextTag]=transfer;
-                            transfer->setTag(nextTag);
-                            fireOnTransferStart(transfer);
-                            fireOnTransferFinish(transfer, MegaError(API_EEXIST));
-                        }
-                    }
-                    else if(transfer->getTag() == -1)
-                    {
-                        //Already existing transfer
-                        //Delete the new one and set the transfer as regular
-                        transfer_map::iterator it = client->transfers[PUT].find(f);
-                        if(it != client->transfers[PUT].end())
-                        {
-                            int previousTag = it->second->tag;
-                            if(transferMap.find(previousTag) != transferMap.end())
-                            {
-                                MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
-                                previousTransfer->setSyncTransfer(false);
-                                delete transfer;
-                            }
-                        }
-                    }
-                    currentTransfer=NULL;
-                }
-                else
-                {
-                    transferMap[nextTag]=transfer;
-                    transfer->setTag(nextTag);
-                    MegaFolderUploadController *uploader = new MegaFolderUploadController(this, transfer);
-                    uploader->start();
-                }
-                break;
-            }
-            case MegaTransfer::TYPE_DOWNLOAD:
-            {
-                handle nodehandle = transfer->getNodeHandle();
-				Node *node = client->nodebyhandle(nodehandle);
-                MegaNode *publicNode = transfer->getPublicNode();
-                const char *parentPath = transfer->getParentPath();
-                const char *fileName = transfer->getFileName();
-                if(!node && !publicNode) { e = API_EARGS; break; }
+void MegaApiImpl::unpersistTransfer(MegaTransferPrivate *transfer)
+{
+    uint32_t id = transfer->getQueueRecord();
 
-                currentTransfer=transfer;
-                if(parentPath || fileName)
-                {
-                    string name;
-                    string securename;
-                    string path;
+    if (id)
+    {
+        queueWrites.erase(id);
+        queueDeletes.push_back(id);
+        transfer->setQueueRecord(0);
+    }
+}
 
-					if(parentPath)
-					{
-						path = parentPath;
-					}
-					else
-					{
-						string separator;
-						client->fsaccess->local2path(&client->fsaccess->localseparator, &separator);
-						path = ".";
-						path.append(separator);
-					}
+// the recorded uploads join the compact upload queue with their
+// fingerprints (and start in batches from there), the downloads are queued
+// as if just started - records that can not be parsed, or all of them if
+// the queue is not to be kept, are deleted
+void MegaApiImpl::restoreQueuedTransfers()
+{
+    map<uint32_t, string> records;
+    int uploads = 0;
+    int downloads = 0;
 
-					MegaFileGet *f;
+    records.swap(client->queuedtransfers);
 
-					if(node)
-					{
-						if(!fileName)
-                        {
-                            attr_map::iterator ait = node->attrs.map.find('n');
-                            if(ait == node->attrs.map.end())
-                            {
-                                name = "CRYPTO_ERROR";
-                            }
-                            else if(!ait->second.size())
-                            {
-                                name = "BLANK";
-                            }
-                            else
-                            {
-                                name = ait->second;
-                            }
-                        }
-                        else
-                        {
-                            name = fileName;
-                        }
+    for (map<uint32_t, string>::iterator it = records.begin(); it != records.end(); it++)
+    {
+        const char *ptr = it->second.data();
+        const char *end = ptr + it->second.size();
+        string path;
+        string fileName;
+        FileFingerprint fingerprint;
+        int type;
+        char flags;
+        handle h;
+        int64_t mtime;
+
+        if (!persistTransfers
+                || end - ptr < (long)(2 + sizeof h + sizeof mtime))
+        {
+            queueDeletes.push_back(it->first);
+            continue;
+        }
 
-                        client->fsaccess->name2local(&name);
-                        client->fsaccess->local2path(&name, &securename);
-                        path += securename;
-						f = new MegaFileGet(client, node, path);
-					}
-					else
-					{
-						if(!transfer->getFileName())
-                            name = publicNode->getName();
-                        else
-                            name = transfer->getFileName();
+        type = *ptr++;
+        flags = *ptr++;
+        h = MemAccess::get<handle>(ptr);
+        ptr += sizeof h;
+        mtime = MemAccess::get<int64_t>(ptr);
+        ptr += sizeof mtime;
 
-                        client->fsaccess->name2local(&name);
-                        client->fsaccess->local2path(&name, &securename);
-                        path += securename;
-						f = new MegaFileGet(client, publicNode, path);
-					}
+        if (!readQueuedString(&ptr, end, &path) || !readQueuedString(&ptr, end, &fileName)
+                || (type != MegaTransfer::TYPE_UPLOAD && type != MegaTransfer::TYPE_DOWNLOAD))
+        {
+            queueDeletes.push_back(it->first);
+            continue;
+        }
 
-					transfer->setPath(path.c_str());
-                    bool ok = client->startxfer(GET, f, true);
-                    if(transfer->getTag() == -1)
-                    {
-                        //Already existing transfer
-                        if (ok)
-                        {
-                            //Set the transfer as regular
-                            transfer_map::iterator it = client->transfers[GET].find(f);
-                            if(it != client->transfers[GET].end())
-                            {
-                                int previousTag = it->second->tag;
-                                if(transferMap.find(previousTag) != transferMap.end())
-                                {
-                                    MegaTransferPrivate* previousTransfer = transferMap.at(previousTag);
-                                    previousTransfer->setSyncTransfer(false);
-                                }
-                            }
-                        }
-                        else
-                        {
-                            //Already existing transfer
-                            transferMap[nextTag]=transfer;
-                            transfer->setTag(nextTag);
-                            fireOnTransferStart(transfer);
-                            fireOnTransferFinish(transfer, MegaError(API_EEXIST));
-                        }
-                    }
-                }
-                else
-                {
-                	m_off_t startPos = transfer->getStartPos();
-                	m_off_t endPos = transfer->getEndPos();
-                	if(startPos < 0 || endPos < 0 || startPos > endPos) { e = API_EARGS; break; }
-                	if(node)
-                	{
-                        transfer->setFileName(node->displayname());
-                		if(startPos >= node->size || endPos >= node->size)
-                		{ e = API_EARGS; break; }
+        if (flags & QUEUED_FINGERPRINT)
+        {
+            if (end - ptr < (long)(sizeof fingerprint.size + sizeof(int64_t) + sizeof fingerprint.crc))
+            {
+                queueDeletes.push_back(it->first);
+                continue;
+            }
 
-                		m_off_t totalBytes = endPos - startPos + 1;
-                	    transferMap[nextTag]=transfer;
-						transfer->setTotalBytes(totalBytes);
-						transfer->setTag(nextTag);
-                        fireOnTransferStart(transfer);
-                	    client->pread(node, startPos, totalBytes, transfer);
-                	    waiter->notify();
-                	}
-                	else
-                	{
-                        transfer->setFileName(publicNode->getName());
-                        if(startPos >= publicNode->getSize() || endPos >= publicNode->getSize())
-                        { e = API_EARGS; break; }
+            fingerprint.size = MemAccess::get<m_off_t>(ptr);
+            ptr += sizeof fingerprint.size;
+            fingerprint.mtime = MemAccess::get<int64_t>(ptr);
+            ptr += sizeof(int64_t);
+            memcpy(fingerprint.crc, ptr, sizeof fingerprint.crc);
+            fingerprint.isvalid = true;
+        }
 
-                        m_off_t totalBytes = endPos - startPos + 1;
-                        transferMap[nextTag]=transfer;
-                        transfer->setTotalBytes(totalBytes);
-                        transfer->setTag(nextTag);
-                        fireOnTransferStart(transfer);
-                        SymmCipher cipher;
-                        cipher.setkey(publicNode->getNodeKey());
-                        client->pread(publicNode->getHandle(), &cipher,
-                            MemAccess::get<int64_t>((const char*)publicNode->getNodeKey()->data() + SymmCipher::KEYLENGTH),
-                                      startPos, totalBytes, transfer);
-                        waiter->notify();
-                	}
-                }
+        if (type == MegaTransfer::TYPE_UPLOAD)
+        {
+            QueuedUpload u;
+
+            u.localPath = path;
+            u.fileName = fileName;
+            u.parentHandle = h;
+            u.mtime = mtime;
+            u.folderTransferTag = 0;
+            u.listener = NULL;
+            u.copyDuplicates = (flags & QUEUED_COPYDUPLICATES) != 0;
+            u.record = it->first;
+            u.fingerprint = fingerprint;
+
+            queuedUploads.push_back(u);
+            numQueuedUploads++;
+            uploads++;
+        }
+        else
+        {
+            MegaTransferPrivate *transfer = new MegaTransferPrivate(MegaTransfer::TYPE_DOWNLOAD);
 
-                currentTransfer=NULL;
-				break;
-			}
-		}
+            if (flags & QUEUED_PATH)
+            {
+                transfer->setParentPath(path.c_str());
+            }
 
-		if(e)
-            fireOnTransferFinish(transfer, MegaError(e));
+            if (flags & QUEUED_FILENAME)
+            {
+                transfer->setFileName(fileName.c_str());
+            }
 
-        sdkMutex.unlock();
+            transfer->setNodeHandle(h);
+            transfer->setMaxRetries(maxRetries);
+            transfer->setQueueRecord(it->first);
+            transferQueue.push(transfer);
+            downloads++;
+        }
+    }
+
+    if (uploads || downloads)
+    {
+        LOG_info << "Queued transfers restored: " << uploads << " uploads, " << downloads << " downloads";
+        waiter->notify();
+    }
+}
+
+MegaUploadCopyListener::MegaUploadCopyListener(MegaApiImpl *megaApi, MegaTransferPrivate *transfer)
+{
+    this->megaApi = megaApi;
+    this->transfer = transfer;
+}
+
+void MegaUploadCopyListener::onRequestFinish(MegaApi *, MegaRequest *, MegaError *e)
+{
+    if (!e->getErrorCode())
+    {
+        transfer->setTransferredBytes(transfer->getTotalBytes());
+        transfer->setDeltaSize(transfer->getTotalBytes());
     }
+
+    megaApi->fireOnTransferFinish(transfer, MegaError(e->getErrorCode()));
+    delete this;
 }
 
 void MegaApiImpl::removeRecursively(const char *path)
@@ -8279,6 +14624,21 @@ void MegaApiImpl::sendPendingRequests()
 
 	while((request = requestQueue.pop()))
 	{
+        // password keys are derived off this thread, the queue waits for them
+        if (MegaPwKeyDerivation::needed(request))
+        {
+            if (!pwKeyDerivation)
+            {
+                pwKeyDerivation = new MegaPwKeyDerivation(request, waiter);
+            }
+
+            if (!pwKeyDerivation->isDone())
+            {
+                requestQueue.push_front(request);
+                break;
+            }
+        }
+
         if(!nextTag)
         {
             client->abortbackoff(false);
@@ -8287,6 +14647,7 @@ void MegaApiImpl::sendPendingRequests()
 		sdkMutex.lock();
 		nextTag = client->nextreqtag();
         request->setTag(nextTag);
+        request->setTiming(MegaRequest::TIMING_DISPATCHED);
 		requestMap[nextTag]=request;
 		e = API_OK;
 
@@ -8318,7 +14679,7 @@ void MegaApiImpl::sendPendingRequests()
             requestMap.erase(request->getTag());
             while(!requestMap.empty())
             {
-                std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+                MegaRequestMap::iterator it=requestMap.begin();
                 if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
             }
 
@@ -8354,7 +14715,19 @@ void MegaApiImpl::sendPendingRequests()
             else if(login && password)
             {
                 byte pwkey[SymmCipher::KEYLENGTH];
-                if((e = client->pw_key(password,pwkey))) break;
+                if (pwKeyDerivation && pwKeyDerivation->request == request)
+                {
+                    e = pwKeyDerivation->e;
+                    memcpy(pwkey, pwKeyDerivation->pwkey, sizeof pwkey);
+                    delete pwKeyDerivation;
+                    pwKeyDerivation = NULL;
+                }
+                else
+                {
+                    e = client->pw_key(password, pwkey);
+                }
+
+                if(e) break;
                 client->login(slogin.c_str(), pwkey);
             }
             else
@@ -8502,7 +14875,7 @@ void MegaApiImpl::sendPendingRequests()
 
                 if (target)
                 {
-                    client->putnodes(target->nodehandle,tc.nn,nc);
+                    client->putnodestree(target->nodehandle,tc.nn,nc);
                 }
                 else
                 {
@@ -8521,6 +14894,7 @@ void MegaApiImpl::sendPendingRequests()
 
             string sname = newName;
             fsAccess->normalize(&sname);
+            client->recordnodedelta(node);
             node->attrs.map['n'] = sname;
             e = client->setattr(node);
             break;
@@ -8628,8 +15002,20 @@ void MegaApiImpl::sendPendingRequests()
 
 			byte pwkey[SymmCipher::KEYLENGTH];
 			byte newpwkey[SymmCipher::KEYLENGTH];
-			if((e = client->pw_key(oldPassword, pwkey))) { e = API_EARGS; break; }
-			if((e = client->pw_key(newPassword, newpwkey))) { e = API_EARGS; break; }
+            if (pwKeyDerivation && pwKeyDerivation->request == request)
+            {
+                e = pwKeyDerivation->e;
+                memcpy(pwkey, pwKeyDerivation->pwkey, sizeof pwkey);
+                memcpy(newpwkey, pwKeyDerivation->newpwkey, sizeof newpwkey);
+                delete pwKeyDerivation;
+                pwKeyDerivation = NULL;
+                if (e) { e = API_EARGS; break; }
+            }
+            else
+            {
+                if((e = client->pw_key(oldPassword, pwkey))) { e = API_EARGS; break; }
+                if((e = client->pw_key(newPassword, newpwkey))) { e = API_EARGS; break; }
+            }
 			e = client->changepw(pwkey, newpwkey);
 			break;
 		}
@@ -8661,6 +15047,23 @@ void MegaApiImpl::sendPendingRequests()
                 e = API_OK;
                 int prevtag = client->restag;
                 MegaRequestPrivate* req = NULL;
+
+                // joining a prefetch: the chain starts at its first waiter
+                if(requestMap.find(prevtag) != requestMap.end() && requestMap.at(prevtag)
+                        && requestMap.at(prevtag)->getType() == MegaRequest::TYPE_PREFETCH_THUMBNAILS)
+                {
+                    map<handle, int>::iterator it = prefetchWaiters.find(node->nodehandle);
+                    if(it == prefetchWaiters.end())
+                    {
+                        prefetchWaiters[node->nodehandle] = request->getTag();
+                        prevtag = 0;
+                    }
+                    else
+                    {
+                        prevtag = it->second;
+                    }
+                }
+
                 while(prevtag)
                 {
                     if(requestMap.find(prevtag) == requestMap.end())
@@ -8890,49 +15293,282 @@ void MegaApiImpl::sendPendingRequests()
                 e = API_EREAD;
                 break;
             }
-            delete f;
+            delete f;
+
+            client->putfa(node->nodehandle, type, node->nodecipher(), attributedata);
+            //attributedata is not deleted because putfa takes its ownership
+            break;
+        }
+        case MegaRequest::TYPE_SET_ATTR_NODE:
+        {
+            Node *node = client->nodebyhandle(request->getNodeHandle());
+            const char* attrName = request->getName();
+            const char* attrValue = request->getText();
+
+            if (!node || !attrName || !attrName[0] || strlen(attrName) > 7)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            if (!client->checkaccess(node, FULL))
+            {
+                e = API_EACCESS;
+                break;
+            }
+
+            string sname = attrName;
+            fsAccess->normalize(&sname);
+            sname.insert(0, "_");
+            nameid attr = AttrMap::string2nameid(sname.c_str());
+
+            if (attrValue)
+            {
+                string svalue = attrValue;
+                fsAccess->normalize(&svalue);
+                node->attrs.map[attr] = svalue;
+            }
+            else
+            {
+                node->attrs.map.erase(attr);
+            }
+
+            e = client->setattr(node);
+            break;
+        }
+        case MegaRequest::TYPE_MOVE_NODES:
+        {
+            Node *newParent = client->nodebyhandle(request->getParentHandle());
+            const handle_vector& handles = request->getNodeHandles();
+            if (!newParent || !handles.size()) { e = API_EARGS; break; }
+
+            request->initNodeResults();
+
+            for (size_t i = 0; i < handles.size(); i++)
+            {
+                Node *node = client->nodebyhandle(handles[i]);
+                error ne = node ? client->checkmove(node, newParent) : API_ENOENT;
+
+                if (!ne && node->parent != newParent)
+                {
+                    // the result arrives in rename_result()
+                    if (!(ne = client->rename(node, newParent)))
+                    {
+                        continue;
+                    }
+                }
+
+                request->setNodeResult(handles[i], ne);
+            }
+
+            if (!request->hasPendingNodes())
+            {
+                fireOnRequestFinish(request, MegaError(API_OK));
+            }
+            break;
+        }
+        case MegaRequest::TYPE_COPY_NODES:
+        {
+            Node *target = client->nodebyhandle(request->getParentHandle());
+            const handle_vector& handles = request->getNodeHandles();
+            if (!target || !handles.size()) { e = API_EARGS; break; }
+            if (!client->checkaccess(target, RDWR)) { e = API_EACCESS; break; }
+
+            request->initNodeResults();
+
+            vector<bool> nested = nestedNodes(client, handles);
+            vector<Node *> roots;
+            set<handle> rootHandles;
+
+            for (size_t i = 0; i < handles.size(); i++)
+            {
+                Node *node = client->nodebyhandle(handles[i]);
+
+                if (!node || nested[i])
+                {
+                    request->setNodeResult(handles[i], node ? API_EARGS : API_ENOENT);
+                }
+                else if (rootHandles.insert(handles[i]).second)
+                {
+                    roots.push_back(node);
+                }
+            }
+
+            if (!roots.size())
+            {
+                fireOnRequestFinish(request, MegaError(API_OK));
+                break;
+            }
+
+            // all the trees in a single array, each one with its root first
+            TreeProcCopy tc;
+
+            for (size_t i = 0; i < roots.size(); i++)
+            {
+                client->proctree(roots[i], &tc);
+            }
+
+            unsigned nc = tc.nc;
+            tc.allocnodes();
+
+            for (size_t i = 0; i < roots.size(); i++)
+            {
+                client->proctree(roots[i], &tc);
+            }
+
+            for (unsigned i = 0; i < nc; i++)
+            {
+                if (rootHandles.find(tc.nn[i].nodehandle) != rootHandles.end())
+                {
+                    tc.nn[i].parenthandle = UNDEF;
+                }
+            }
+
+            // the size of the array for putnodes_result()
+            request->setNumber(nc);
+            client->putnodestree(target->nodehandle, tc.nn, nc);
+            break;
+        }
+        case MegaRequest::TYPE_REMOVE_NODES:
+        {
+            const handle_vector& handles = request->getNodeHandles();
+            if (!handles.size()) { e = API_EARGS; break; }
+
+            request->initNodeResults();
+
+            // nodes below others are removed with them
+            vector<bool> nested = nestedNodes(client, handles);
+
+            for (size_t i = 0; i < handles.size(); i++)
+            {
+                if (nested[i])
+                {
+                    request->setNodeResult(handles[i], API_OK);
+                }
+            }
+
+            for (size_t i = 0; i < handles.size(); i++)
+            {
+                if (nested[i])
+                {
+                    continue;
+                }
+
+                Node *node = client->nodebyhandle(handles[i]);
+                error ne = node ? client->unlink(node) : API_ENOENT;
+
+                // the result arrives in unlink_result()
+                if (ne)
+                {
+                    request->setNodeResult(handles[i], ne);
+                }
+            }
 
-            client->putfa(node->nodehandle, type, node->nodecipher(), attributedata);
-            //attributedata is not deleted because putfa takes its ownership
+            if (!request->hasPendingNodes())
+            {
+                fireOnRequestFinish(request, MegaError(API_OK));
+            }
             break;
         }
-        case MegaRequest::TYPE_SET_ATTR_NODE:
+        case MegaRequest::TYPE_SET_ATTR_NODES:
         {
-            Node *node = client->nodebyhandle(request->getNodeHandle());
+            const handle_vector& handles = request->getNodeHandles();
             const char* attrName = request->getName();
             const char* attrValue = request->getText();
 
-            if (!node || !attrName || !attrName[0] || strlen(attrName) > 7)
+            if (!handles.size() || !attrName || !attrName[0] || strlen(attrName) > 7)
             {
                 e = API_EARGS;
                 break;
             }
 
-            if (!client->checkaccess(node, FULL))
-            {
-                e = API_EACCESS;
-                break;
-            }
-
             string sname = attrName;
             fsAccess->normalize(&sname);
             sname.insert(0, "_");
             nameid attr = AttrMap::string2nameid(sname.c_str());
 
+            string svalue;
             if (attrValue)
             {
-                string svalue = attrValue;
+                svalue = attrValue;
                 fsAccess->normalize(&svalue);
-                node->attrs.map[attr] = svalue;
             }
-            else
+
+            request->initNodeResults();
+
+            for (size_t i = 0; i < handles.size(); i++)
             {
-                node->attrs.map.erase(attr);
+                Node *node = client->nodebyhandle(handles[i]);
+                error ne = !node ? API_ENOENT : (client->checkaccess(node, FULL) ? API_OK : API_EACCESS);
+
+                if (!ne)
+                {
+                    if (attrValue)
+                    {
+                        node->attrs.map[attr] = svalue;
+                    }
+                    else
+                    {
+                        node->attrs.map.erase(attr);
+                    }
+
+                    // the result arrives in setattr_result()
+                    if (!(ne = client->setattr(node)))
+                    {
+                        continue;
+                    }
+                }
+
+                request->setNodeResult(handles[i], ne);
             }
 
-            e = client->setattr(node);
+            if (!request->hasPendingNodes())
+            {
+                fireOnRequestFinish(request, MegaError(API_OK));
+            }
             break;
         }
+		case MegaRequest::TYPE_PREFETCH_THUMBNAILS:
+		{
+			if (!client->facache) { e = API_EACCESS; break; }
+
+			const handle_vector& handles = request->getNodeHandles();
+			bool background = request->getNumber() == MegaApi::PREFETCH_PRIORITY_BACKGROUND;
+			int tag = request->getTag();
+
+			request->setTotalBytes(0);
+			request->setTransferredBytes(0);
+			request->setNumDetails(0);
+			prefetchDispatchTag = tag;
+
+			for (size_t i = 0; i < handles.size(); i++)
+			{
+				Node *node = client->nodebyhandle(handles[i]);
+				if (!node) continue;
+
+				map<handle, int>::iterator pit = thumbnailPrefetches.find(node->nodehandle);
+				if (pit != thumbnailPrefetches.end() && requestMap.find(pit->second) != requestMap.end()) continue;
+
+				// registered first: cached thumbnails are completed from getfa()
+				thumbnailPrefetches[node->nodehandle] = tag;
+				request->setTotalBytes(request->getTotalBytes() + 1);
+
+				if (client->getfa(node, MegaApi::ATTR_TYPE_THUMBNAIL, 0, background) != API_OK)
+				{
+					// no thumbnail or already being fetched
+					thumbnailPrefetches.erase(node->nodehandle);
+					request->setTotalBytes(request->getTotalBytes() - 1);
+				}
+			}
+
+			prefetchDispatchTag = 0;
+
+			if (request->getTransferredBytes() == request->getTotalBytes())
+			{
+				fireOnRequestFinish(request, MegaError(API_OK));
+			}
+			break;
+		}
 		case MegaRequest::TYPE_CANCEL_ATTR_FILE:
 		{
 			int type = request->getParamType();
@@ -8940,10 +15576,21 @@ void MegaApiImpl::sendPendingRequests()
 
 			if (!node) { e = API_EARGS; break; }
 
-			e = client->getfa(node, type, 1);
+			// a prefetch keeps fetching the thumbnail, only the requests waiting for it are cancelled
+			map<handle, int>::iterator pit = thumbnailPrefetches.find(node->nodehandle);
+			if (type == MegaApi::ATTR_TYPE_THUMBNAIL && pit != thumbnailPrefetches.end()
+					&& requestMap.find(pit->second) != requestMap.end())
+			{
+				e = prefetchWaiters.erase(node->nodehandle) ? API_OK : API_ENOENT;
+			}
+			else
+			{
+				e = client->getfa(node, type, 1);
+			}
+
 			if (!e)
 			{
-				std::map<int, MegaRequestPrivate*>::iterator it = requestMap.begin();
+				MegaRequestMap::iterator it = requestMap.begin();
 				while(it != requestMap.end())
 				{
 					MegaRequestPrivate *r = it->second;
@@ -9106,7 +15753,7 @@ void MegaApiImpl::sendPendingRequests()
             requestMap.erase(request->getTag());
             while(!requestMap.empty())
             {
-                std::map<int,MegaRequestPrivate*>::iterator it=requestMap.begin();
+                MegaRequestMap::iterator it=requestMap.begin();
                 if(it->second) fireOnRequestFinish(it->second, MegaError(MegaError::API_EACCESS));
             }
 
@@ -9207,12 +15854,77 @@ void MegaApiImpl::sendPendingRequests()
             fireOnRequestFinish(request, MegaError(API_OK));
             break;
         }
+        case MegaRequest::TYPE_SET_TRANSFER_PRIORITY:
+        {
+            int priority = (int)request->getNumber();
+            if (priority < MegaTransfer::PRIORITY_INTERACTIVE || priority > MegaTransfer::PRIORITY_BACKGROUND)
+            {
+                e = API_EARGS;
+                break;
+            }
+
+            map<int, MegaTransferPrivate *>::iterator it = transferMap.find(request->getTransferTag());
+            Transfer *transfer = (it != transferMap.end()) ? it->second->getTransfer() : NULL;
+            if (!transfer || !transfer->queued)
+            {
+                e = API_ENOENT;
+                break;
+            }
+
+            if (transfer->priority != priority)
+            {
+                client->queuetransfer(transfer, (transferpriority_t)priority);
+            }
+            fireOnRequestFinish(request, MegaError(API_OK));
+            break;
+        }
+        case MegaRequest::TYPE_MOVE_TRANSFER:
+        {
+            map<int, MegaTransferPrivate *>::iterator it = transferMap.find(request->getTransferTag());
+            Transfer *transfer = (it != transferMap.end()) ? it->second->getTransfer() : NULL;
+            if (!transfer || !transfer->queued)
+            {
+                e = API_ENOENT;
+                break;
+            }
+
+            int nextTag = (int)request->getNumber();
+            if (request->getFlag() || !nextTag)
+            {
+                client->queuetransfer(transfer, transfer->priority, request->getFlag());
+            }
+            else
+            {
+                it = transferMap.find(nextTag);
+                Transfer *next = (it != transferMap.end()) ? it->second->getTransfer() : NULL;
+                if (!next || !next->queued)
+                {
+                    e = API_ENOENT;
+                    break;
+                }
+
+                if (next->type != transfer->type)
+                {
+                    e = API_EARGS;
+                    break;
+                }
+
+                client->movetransferbefore(transfer, next);
+            }
+            fireOnRequestFinish(request, MegaError(API_OK));
+            break;
+        }
         case MegaRequest::TYPE_CANCEL_TRANSFERS:
         {
             int direction = request->getParamType();
             if((direction != MegaTransfer::TYPE_DOWNLOAD) && (direction != MegaTransfer::TYPE_UPLOAD))
                 { e = API_EARGS; break; }
 
+            if (direction == MegaTransfer::TYPE_UPLOAD)
+            {
+                abortQueuedUploads(API_EINCOMPLETE);
+            }
+
             for (transfer_map::iterator it = client->transfers[direction].begin() ; it != client->transfers[direction].end() ; )
             {
                 Transfer *transfer = it->second;
@@ -9582,18 +16294,7 @@ void MegaApiImpl::update()
     sdkMutex.lock();
 
     LOG_debug << "PendingCS? " << (client->pendingcs != NULL);
-    if(client->curfa == client->newfa.end())
-    {
-        LOG_debug << "PendingFA? 0";
-    }
-    else
-    {
-        HttpReqCommandPutFA* fa = *client->curfa;
-        if(fa)
-        {
-            LOG_debug << "PendingFA? " << client->newfa.size() << " STATUS: " << fa->status;
-        }
-    }
+    LOG_debug << "PendingFA? " << client->newfa.size() << " ACTIVE: " << client->activefa.size();
 
     LOG_debug << "FLAGS: " << client->syncactivity << " " << client->syncadded
               << " " << client->syncdownrequired << " " << client->syncdownretry
@@ -9672,142 +16373,288 @@ void TreeProcCopy::proc(MegaClient* client, Node* n)
 	else nc++;
 }
 
-TransferQueue::TransferQueue()
+void RequestQueue::removeListener(MegaRequestListener *listener)
 {
-    mutex.init(false);
+    mutex.lock();
+    drain();
+
+    std::deque<MegaRequestPrivate *>::iterator it = items.begin();
+    while(it != items.end())
+    {
+        MegaRequestPrivate *request = (*it);
+        if(request->getListener()==listener)
+            request->setListener(NULL);
+        it++;
+    }
+
+    mutex.unlock();
 }
 
-void TransferQueue::push(MegaTransferPrivate *transfer)
+#ifdef ENABLE_SYNC
+void RequestQueue::removeListener(MegaSyncListener *listener)
 {
     mutex.lock();
-    transfers.push_back(transfer);
+    drain();
+
+    std::deque<MegaRequestPrivate *>::iterator it = items.begin();
+    while(it != items.end())
+    {
+        MegaRequestPrivate *request = (*it);
+        if(request->getSyncListener()==listener)
+            request->setSyncListener(NULL);
+        it++;
+    }
+
     mutex.unlock();
 }
+#endif
 
-void TransferQueue::push_front(MegaTransferPrivate *transfer)
+MegaHashSignatureImpl::MegaHashSignatureImpl(const char *base64Key)
 {
-    mutex.lock();
-    transfers.push_front(transfer);
-    mutex.unlock();
+    hashSignature = new HashSignature(new Hash());
+    asymmCypher = new AsymmCipher();
+
+    string pubks;
+    int len = strlen(base64Key)/4*3+3;
+    pubks.resize(len);
+    pubks.resize(Base64::atob(base64Key, (byte *)pubks.data(), len));
+    asymmCypher->setkey(AsymmCipher::PUBKEY,(byte*)pubks.data(), pubks.size());
+}
+
+MegaHashSignatureImpl::~MegaHashSignatureImpl()
+{
+    delete hashSignature;
+    delete asymmCypher;
 }
 
-MegaTransferPrivate *TransferQueue::pop()
+void MegaHashSignatureImpl::init()
 {
-    mutex.lock();
-    if(transfers.empty())
-    {
-        mutex.unlock();
-        return NULL;
-    }
-    MegaTransferPrivate *transfer = transfers.front();
-    transfers.pop_front();
-    mutex.unlock();
-    return transfer;
+    hashSignature->get(asymmCypher, NULL, 0);
+}
+
+void MegaHashSignatureImpl::add(const char *data, unsigned size)
+{
+    hashSignature->add((const byte *)data, size);
+}
+
+bool MegaHashSignatureImpl::checkSignature(const char *base64Signature)
+{
+    char signature[512];
+    int l = Base64::atob(base64Signature, (byte *)signature, sizeof(signature));
+    if(l != sizeof(signature))
+        return false;
+
+    return hashSignature->check(asymmCypher, (const byte *)signature, sizeof(signature));
 }
 
-RequestQueue::RequestQueue()
+SharedFolderLink::SharedFolderLink(MegaFolderLinkStoreImpl *store, const string &id, const char *link)
 {
+    this->store = store;
+    this->id = id;
+    snapshot = NULL;
+    refs = 0;
+    state = MegaFolderLinkSession::STATE_LOADING;
+    waiters = 0;
+
     mutex.init(false);
+    loaded.init(0);
+
+    api = new MegaApi(store->appKey.c_str(), (const char *)NULL, store->userAgent.size() ? store->userAgent.c_str() : NULL);
+    api->loginToFolder(link, this);
 }
 
-void RequestQueue::push(MegaRequestPrivate *request)
+SharedFolderLink::~SharedFolderLink()
 {
-    mutex.lock();
-    requests.push_back(request);
-    mutex.unlock();
+    delete api;
+    delete snapshot;
+}
+
+// login, then fetchnodes - the snapshot is taken before the folder is
+// reported as ready
+void SharedFolderLink::onRequestFinish(MegaApi *api, MegaRequest *request, MegaError *e)
+{
+    if (e->getErrorCode())
+    {
+        LOG_warn << "Unable to load a shared folder link: " << e->getErrorString();
+        finish(MegaFolderLinkSession::STATE_FAILED);
+        return;
+    }
+
+    if (request->getType() == MegaRequest::TYPE_LOGIN)
+    {
+        api->fetchNodes(this);
+    }
+    else if (request->getType() == MegaRequest::TYPE_FETCH_NODES)
+    {
+        snapshot = api->getNodeSnapshot(NULL);
+        LOG_debug << "Shared folder link loaded: " << snapshot->getNumNodes() << " nodes";
+        finish(MegaFolderLinkSession::STATE_READY);
+    }
 }
 
-void RequestQueue::push_front(MegaRequestPrivate *request)
+int SharedFolderLink::getState()
 {
     mutex.lock();
-    requests.push_front(request);
+    int s = state;
     mutex.unlock();
+
+    return s;
 }
 
-MegaRequestPrivate *RequestQueue::pop()
+int SharedFolderLink::waitReady()
 {
     mutex.lock();
-    if(requests.empty())
+    bool loading = state == MegaFolderLinkSession::STATE_LOADING;
+    if (loading)
     {
-        mutex.unlock();
-        return NULL;
+        waiters++;
     }
-    MegaRequestPrivate *request = requests.front();
-    requests.pop_front();
     mutex.unlock();
-    return request;
+
+    if (loading)
+    {
+        loaded.wait();
+    }
+
+    return getState();
 }
 
-void RequestQueue::removeListener(MegaRequestListener *listener)
+void SharedFolderLink::finish(int state)
 {
     mutex.lock();
+    this->state = state;
+    int n = waiters;
+    waiters = 0;
+    mutex.unlock();
 
-    std::deque<MegaRequestPrivate *>::iterator it = requests.begin();
-    while(it != requests.end())
+    while (n--)
     {
-        MegaRequestPrivate *request = (*it);
-        if(request->getListener()==listener)
-            request->setListener(NULL);
-        it++;
+        loaded.release();
     }
+}
 
-    mutex.unlock();
+MegaFolderLinkSessionPrivate::MegaFolderLinkSessionPrivate(SharedFolderLink *folder)
+{
+    this->folder = folder;
 }
 
-#ifdef ENABLE_SYNC
-void RequestQueue::removeListener(MegaSyncListener *listener)
+MegaFolderLinkSessionPrivate::~MegaFolderLinkSessionPrivate()
 {
-    mutex.lock();
+    folder->store->release(folder);
+}
+
+int MegaFolderLinkSessionPrivate::getState()
+{
+    return folder->getState();
+}
+
+int MegaFolderLinkSessionPrivate::waitReady()
+{
+    return folder->waitReady();
+}
+
+MegaNodeSnapshot *MegaFolderLinkSessionPrivate::getNodes()
+{
+    return folder->getState() == STATE_READY ? folder->snapshot : NULL;
+}
+
+void MegaFolderLinkSessionPrivate::startStreaming(MegaNode *node, int64_t startPos, int64_t size, MegaTransferListener *listener)
+{
+    folder->api->startStreaming(node, startPos, size, listener);
+}
+
+MegaFolderLinkStoreImpl::MegaFolderLinkStoreImpl(const char *appKey, const char *userAgent)
+{
+    this->appKey = appKey ? appKey : "";
+    this->userAgent = userAgent ? userAgent : "";
+
+    mutex.init(false);
+}
 
-    std::deque<MegaRequestPrivate *>::iterator it = requests.begin();
-    while(it != requests.end())
+MegaFolderLinkStoreImpl::~MegaFolderLinkStoreImpl()
+{
+    for (map<string, SharedFolderLink *>::iterator it = folders.begin(); it != folders.end(); it++)
     {
-        MegaRequestPrivate *request = (*it);
-        if(request->getSyncListener()==listener)
-            request->setSyncListener(NULL);
-        it++;
+        delete it->second;
     }
 
-    mutex.unlock();
+    for (set<SharedFolderLink *>::iterator it = orphans.begin(); it != orphans.end(); it++)
+    {
+        delete *it;
+    }
 }
-#endif
 
-MegaHashSignatureImpl::MegaHashSignatureImpl(const char *base64Key)
+// links to the same folder differ in their prefix only
+MegaFolderLinkSession *MegaFolderLinkStoreImpl::openSession(const char *megaFolderLink)
 {
-    hashSignature = new HashSignature(new Hash());
-    asymmCypher = new AsymmCipher();
+    if (!megaFolderLink)
+    {
+        return NULL;
+    }
+
+    const char *id = strchr(megaFolderLink, '#');
+    string key = id ? id : megaFolderLink;
+
+    mutex.lock();
+
+    map<string, SharedFolderLink *>::iterator it = folders.find(key);
+
+    if (it != folders.end() && it->second->getState() == MegaFolderLinkSession::STATE_FAILED)
+    {
+        orphans.insert(it->second);
+        folders.erase(it);
+        it = folders.end();
+    }
+
+    if (it == folders.end())
+    {
+        it = folders.insert(pair<string, SharedFolderLink *>(key, new SharedFolderLink(this, key, megaFolderLink))).first;
+    }
+
+    SharedFolderLink *folder = it->second;
+    folder->refs++;
+
+    mutex.unlock();
 
-    string pubks;
-    int len = strlen(base64Key)/4*3+3;
-    pubks.resize(len);
-    pubks.resize(Base64::atob(base64Key, (byte *)pubks.data(), len));
-    asymmCypher->setkey(AsymmCipher::PUBKEY,(byte*)pubks.data(), pubks.size());
+    return new MegaFolderLinkSessionPrivate(folder);
 }
 
-MegaHashSignatureImpl::~MegaHashSignatureImpl()
+int MegaFolderLinkStoreImpl::getNumFolders()
 {
-    delete hashSignature;
-    delete asymmCypher;
-}
+    mutex.lock();
+    int n = int(folders.size() + orphans.size());
+    mutex.unlock();
 
-void MegaHashSignatureImpl::init()
-{
-    hashSignature->get(asymmCypher, NULL, 0);
+    return n;
 }
 
-void MegaHashSignatureImpl::add(const char *data, unsigned size)
+// the folder's MegaApi is deleted outside of the lock
+void MegaFolderLinkStoreImpl::release(SharedFolderLink *folder)
 {
-    hashSignature->add((const byte *)data, size);
-}
+    mutex.lock();
 
-bool MegaHashSignatureImpl::checkSignature(const char *base64Signature)
-{
-    char signature[512];
-    int l = Base64::atob(base64Signature, (byte *)signature, sizeof(signature));
-    if(l != sizeof(signature))
-        return false;
+    bool last = !--folder->refs;
 
-    return hashSignature->check(asymmCypher, (const byte *)signature, sizeof(signature));
+    if (last)
+    {
+        map<string, SharedFolderLink *>::iterator it = folders.find(folder->id);
+
+        if (it != folders.end() && it->second == folder)
+        {
+            folders.erase(it);
+        }
+        else
+        {
+            orphans.erase(folder);
+        }
+    }
+
+    mutex.unlock();
+
+    if (last)
+    {
+        delete folder;
+    }
 }
 
 int MegaAccountDetailsPrivate::getProLevel()
@@ -9955,6 +16802,14 @@ ExternalLogger::ExternalLogger()
 {
 	mutex.init(true);
 	this->megaLogger = NULL;
+    queueMutex.init(false);
+    ready.init(0);
+    thread = NULL;
+    first = 0;
+    count = 0;
+    async = false;
+    exiting = false;
+    dropped = 0;
 	SimpleLogger::setOutputClass(this);
 
     //Initialize outputSettings map
@@ -9968,7 +16823,10 @@ ExternalLogger::ExternalLogger()
 
 void ExternalLogger::setMegaLogger(MegaLogger *logger)
 {
+    // a logger being replaced must not receive any more queued logs
+    mutex.lock();
 	this->megaLogger = logger;
+    mutex.unlock();
 }
 
 void ExternalLogger::setLogLevel(int logLevel)
@@ -10013,6 +16871,43 @@ void ExternalLogger::log(const char *time, int loglevel, const char *source, con
 		message = "";
 	}
 
+    // fatal logs precede an abort, don't leave them in the queue
+    if (async && loglevel != logFatal)
+    {
+        bool wakeup = false;
+
+        queueMutex.lock();
+        if (async)
+        {
+            if (count < ring.size())
+            {
+                Record &record = ring[(first + count) % ring.size()];
+                record.time.assign(time);
+                record.level = loglevel;
+                record.source.assign(source);
+                record.message.assign(message);
+                wakeup = !count++;
+            }
+            else
+            {
+                dropped++;
+            }
+            queueMutex.unlock();
+
+            if (wakeup)
+            {
+                ready.release();
+            }
+            return;
+        }
+        queueMutex.unlock();
+    }
+
+    deliver(time, loglevel, source, message);
+}
+
+void ExternalLogger::deliver(const char *time, int loglevel, const char *source, const char *message)
+{
 	mutex.lock();
 	if(megaLogger)
 	{
@@ -10025,67 +16920,101 @@ void ExternalLogger::log(const char *time, int loglevel, const char *source, con
 	mutex.unlock();
 }
 
-
-OutShareProcessor::OutShareProcessor()
-{
-
-}
-
-bool OutShareProcessor::processNode(Node *node)
+void ExternalLogger::setAsync(bool enable, int maxQueued)
 {
-    if(!node->outshares)
+    if (enable)
     {
-        return true;
+        queueMutex.lock();
+        if (!thread)
+        {
+            ring.resize(maxQueued > 0 ? maxQueued : 1);
+            first = 0;
+            count = 0;
+            exiting = false;
+            async = true;
+            thread = new MegaThread();
+            thread->start(threadEntryPoint, this);
+        }
+        queueMutex.unlock();
+        return;
     }
 
-    for (share_map::iterator it = node->outshares->begin(); it != node->outshares->end(); it++)
-	{
-		shares.push_back(it->second);
-		handles.push_back(node->nodehandle);
-	}
+    queueMutex.lock();
+    MegaThread *t = thread;
+    thread = NULL;
+    async = false;
+    exiting = true;
+    queueMutex.unlock();
 
-	return true;
+    if (t)
+    {
+        // the thread delivers the queued logs before exiting
+        ready.release();
+        t->join();
+        delete t;
+    }
 }
 
-vector<Share *> &OutShareProcessor::getShares()
+long long ExternalLogger::getDropped()
 {
-	return shares;
+    queueMutex.lock();
+    long long result = dropped;
+    queueMutex.unlock();
+    return result;
 }
 
-vector<handle> &OutShareProcessor::getHandles()
+void *ExternalLogger::threadEntryPoint(void *param)
 {
-	return handles;
+    ((ExternalLogger *)param)->drain();
+    return NULL;
 }
 
-PendingOutShareProcessor::PendingOutShareProcessor()
+void ExternalLogger::drain()
 {
+    Record record;
+    long long reported = 0;
 
-}
-
-bool PendingOutShareProcessor::processNode(Node *node)
-{
-    if(!node->pendingshares)
+    for (;;)
     {
-        return true;
-    }
+        ready.wait();
 
-    for (share_map::iterator it = node->pendingshares->begin(); it != node->pendingshares->end(); it++)
-    {
-        shares.push_back(it->second);
-        handles.push_back(node->nodehandle);
-    }
+        for (;;)
+        {
+            long long lost;
 
-    return true;
-}
+            queueMutex.lock();
+            if (!count)
+            {
+                bool finished = exiting;
+                queueMutex.unlock();
+                if (finished)
+                {
+                    return;
+                }
+                break;
+            }
 
-vector<Share *> &PendingOutShareProcessor::getShares()
-{
-    return shares;
-}
+            Record &next = ring[first];
+            record.time.swap(next.time);
+            record.level = next.level;
+            record.source.swap(next.source);
+            record.message.swap(next.message);
+            first = (first + 1) % ring.size();
+            count--;
+            lost = dropped;
+            queueMutex.unlock();
+
+            if (lost != reported)
+            {
+                ostringstream oss;
+                oss << (lost - reported) << " log messages dropped";
+                deliver(record.time.c_str(), logWarning, "", oss.str().c_str());
+                reported = lost;
+            }
 
-vector<handle> &PendingOutShareProcessor::getHandles()
-{
-    return handles;
+            deliver(record.time.c_str(), record.level, record.source.c_str(), record.message.c_str());
+        }
+    }
 }
 
 MegaPricingPrivate::~MegaPricingPrivate()
@@ -10232,6 +17161,11 @@ MegaSyncPrivate::MegaSyncPrivate(Sync *sync)
     this->fingerprint = sync->fsfp;
     this->state = sync->state;
     this->listener = NULL;
+
+    for (int type = 0; type <= MegaApi::SYNC_STATS_SYNCUP_MAX; type++)
+    {
+        stats.push_back(MegaApiImpl::getSyncStats(sync, type));
+    }
 }
 
 MegaSyncPrivate::MegaSyncPrivate(MegaSyncPrivate *sync)
@@ -10242,6 +17176,7 @@ MegaSyncPrivate::MegaSyncPrivate(MegaSyncPrivate *sync)
     this->setLocalFingerprint(sync->getLocalFingerprint());
     this->setState(sync->getState());
     this->setListener(sync->getListener());
+    this->stats = sync->stats;
 }
 
 MegaSyncPrivate::~MegaSyncPrivate()
@@ -10306,6 +17241,16 @@ MegaSyncListener *MegaSyncPrivate::getListener()
     return this->listener;
 }
 
+long long MegaSyncPrivate::getStats(int type) const
+{
+    if (type < 0 || type >= (int)stats.size())
+    {
+        return -1;
+    }
+
+    return stats[type];
+}
+
 int MegaSyncPrivate::getState() const
 {
     return state;
@@ -10354,522 +17299,892 @@ const char *MegaSyncEventPrivate::getPath() const
 
 MegaHandle MegaSyncEventPrivate::getNodeHandle() const
 {
-    return nodeHandle;
+    return nodeHandle;
+}
+
+const char *MegaSyncEventPrivate::getNewPath() const
+{
+    return newPath;
+}
+
+const char *MegaSyncEventPrivate::getPrevName() const
+{
+    return prevName;
+}
+
+MegaHandle MegaSyncEventPrivate::getPrevParent() const
+{
+    return prevParent;
+}
+
+void MegaSyncEventPrivate::setPath(const char *path)
+{
+    if(this->path)
+    {
+        delete [] this->path;
+    }
+    this->path =  MegaApi::strdup(path);
+}
+
+void MegaSyncEventPrivate::setNodeHandle(MegaHandle nodeHandle)
+{
+    this->nodeHandle = nodeHandle;
+}
+
+void MegaSyncEventPrivate::setNewPath(const char *newPath)
+{
+    if(this->newPath)
+    {
+        delete [] this->newPath;
+    }
+    this->newPath =  MegaApi::strdup(newPath);
+}
+
+void MegaSyncEventPrivate::setPrevName(const char *prevName)
+{
+    if(this->prevName)
+    {
+        delete [] this->prevName;
+    }
+    this->prevName =  MegaApi::strdup(prevName);
+}
+
+void MegaSyncEventPrivate::setPrevParent(MegaHandle prevParent)
+{
+    this->prevParent = prevParent;
+}
+
+#endif
+
+
+MegaAccountBalance *MegaAccountBalancePrivate::fromAccountBalance(const AccountBalance *balance)
+{
+    return new MegaAccountBalancePrivate(balance);
+}
+
+MegaAccountBalancePrivate::~MegaAccountBalancePrivate()
+{
+
+}
+
+MegaAccountBalance *MegaAccountBalancePrivate::copy()
+{
+    return new MegaAccountBalancePrivate(&balance);
+}
+
+double MegaAccountBalancePrivate::getAmount() const
+{
+    return balance.amount;
+}
+
+char *MegaAccountBalancePrivate::getCurrency() const
+{
+    return MegaApi::strdup(balance.currency);
+}
+
+MegaAccountBalancePrivate::MegaAccountBalancePrivate(const AccountBalance *balance)
+{
+    this->balance = *balance;
+}
+
+MegaAccountSession *MegaAccountSessionPrivate::fromAccountSession(const AccountSession *session)
+{
+    return new MegaAccountSessionPrivate(session);
+}
+
+MegaAccountSessionPrivate::~MegaAccountSessionPrivate()
+{
+
+}
+
+MegaAccountSession *MegaAccountSessionPrivate::copy()
+{
+    return new MegaAccountSessionPrivate(&session);
+}
+
+int64_t MegaAccountSessionPrivate::getCreationTimestamp() const
+{
+    return session.timestamp;
+}
+
+int64_t MegaAccountSessionPrivate::getMostRecentUsage() const
+{
+    return session.mru;
+}
+
+char *MegaAccountSessionPrivate::getUserAgent() const
+{
+    return MegaApi::strdup(session.useragent.c_str());
+}
+
+char *MegaAccountSessionPrivate::getIP() const
+{
+    return MegaApi::strdup(session.ip.c_str());
+}
+
+char *MegaAccountSessionPrivate::getCountry() const
+{
+    return MegaApi::strdup(session.country);
+}
+
+bool MegaAccountSessionPrivate::isCurrent() const
+{
+    return session.current;
+}
+
+bool MegaAccountSessionPrivate::isAlive() const
+{
+    return session.alive;
+}
+
+MegaHandle MegaAccountSessionPrivate::getHandle() const
+{
+    return session.id;
+}
+
+MegaAccountSessionPrivate::MegaAccountSessionPrivate(const AccountSession *session)
+{
+    this->session = *session;
+}
+
+
+MegaAccountPurchase *MegaAccountPurchasePrivate::fromAccountPurchase(const AccountPurchase *purchase)
+{
+    return new MegaAccountPurchasePrivate(purchase);
 }
 
-const char *MegaSyncEventPrivate::getNewPath() const
+MegaAccountPurchasePrivate::~MegaAccountPurchasePrivate()
 {
-    return newPath;
+
 }
 
-const char *MegaSyncEventPrivate::getPrevName() const
+MegaAccountPurchase *MegaAccountPurchasePrivate::copy()
 {
-    return prevName;
+    return new MegaAccountPurchasePrivate(&purchase);
 }
 
-MegaHandle MegaSyncEventPrivate::getPrevParent() const
+int64_t MegaAccountPurchasePrivate::getTimestamp() const
 {
-    return prevParent;
+    return purchase.timestamp;
 }
 
-void MegaSyncEventPrivate::setPath(const char *path)
+char *MegaAccountPurchasePrivate::getHandle() const
 {
-    if(this->path)
-    {
-        delete [] this->path;
-    }
-    this->path =  MegaApi::strdup(path);
+    return MegaApi::strdup(purchase.handle);
 }
 
-void MegaSyncEventPrivate::setNodeHandle(MegaHandle nodeHandle)
+char *MegaAccountPurchasePrivate::getCurrency() const
 {
-    this->nodeHandle = nodeHandle;
+    return MegaApi::strdup(purchase.currency);
 }
 
-void MegaSyncEventPrivate::setNewPath(const char *newPath)
+double MegaAccountPurchasePrivate::getAmount() const
 {
-    if(this->newPath)
-    {
-        delete [] this->newPath;
-    }
-    this->newPath =  MegaApi::strdup(newPath);
+    return purchase.amount;
 }
 
-void MegaSyncEventPrivate::setPrevName(const char *prevName)
+int MegaAccountPurchasePrivate::getMethod() const
 {
-    if(this->prevName)
-    {
-        delete [] this->prevName;
-    }
-    this->prevName =  MegaApi::strdup(prevName);
+    return purchase.method;
 }
 
-void MegaSyncEventPrivate::setPrevParent(MegaHandle prevParent)
+MegaAccountPurchasePrivate::MegaAccountPurchasePrivate(const AccountPurchase *purchase)
 {
-    this->prevParent = prevParent;
+    this->purchase = *purchase;
 }
 
-#endif
-
 
-MegaAccountBalance *MegaAccountBalancePrivate::fromAccountBalance(const AccountBalance *balance)
+MegaAccountTransaction *MegaAccountTransactionPrivate::fromAccountTransaction(const AccountTransaction *transaction)
 {
-    return new MegaAccountBalancePrivate(balance);
+    return new MegaAccountTransactionPrivate(transaction);
 }
 
-MegaAccountBalancePrivate::~MegaAccountBalancePrivate()
+MegaAccountTransactionPrivate::~MegaAccountTransactionPrivate()
 {
 
 }
 
-MegaAccountBalance *MegaAccountBalancePrivate::copy()
+MegaAccountTransaction *MegaAccountTransactionPrivate::copy()
 {
-    return new MegaAccountBalancePrivate(&balance);
+    return new MegaAccountTransactionPrivate(&transaction);
 }
 
-double MegaAccountBalancePrivate::getAmount() const
+int64_t MegaAccountTransactionPrivate::getTimestamp() const
 {
-    return balance.amount;
+    return transaction.timestamp;
 }
 
-char *MegaAccountBalancePrivate::getCurrency() const
+char *MegaAccountTransactionPrivate::getHandle() const
 {
-    return MegaApi::strdup(balance.currency);
+    return MegaApi::strdup(transaction.handle);
 }
 
-MegaAccountBalancePrivate::MegaAccountBalancePrivate(const AccountBalance *balance)
+char *MegaAccountTransactionPrivate::getCurrency() const
 {
-    this->balance = *balance;
+    return MegaApi::strdup(transaction.currency);
 }
 
-MegaAccountSession *MegaAccountSessionPrivate::fromAccountSession(const AccountSession *session)
+double MegaAccountTransactionPrivate::getAmount() const
 {
-    return new MegaAccountSessionPrivate(session);
+    return transaction.delta;
 }
 
-MegaAccountSessionPrivate::~MegaAccountSessionPrivate()
+MegaAccountTransactionPrivate::MegaAccountTransactionPrivate(const AccountTransaction *transaction)
 {
-
+    this->transaction = *transaction;
 }
 
-MegaAccountSession *MegaAccountSessionPrivate::copy()
+
+
+ExternalInputStream::ExternalInputStream(MegaInputStream *inputStream)
 {
-    return new MegaAccountSessionPrivate(&session);
+    this->inputStream = inputStream;
 }
 
-int64_t MegaAccountSessionPrivate::getCreationTimestamp() const
+m_off_t ExternalInputStream::size()
 {
-    return session.timestamp;
+    return inputStream->getSize();
 }
 
-int64_t MegaAccountSessionPrivate::getMostRecentUsage() const
+bool ExternalInputStream::read(byte *buffer, unsigned size)
 {
-    return session.mru;
+    return inputStream->read((char *)buffer, size);
 }
 
-char *MegaAccountSessionPrivate::getUserAgent() const
+ExternalOutputStream::ExternalOutputStream(MegaOutputStream *outputStream)
 {
-    return MegaApi::strdup(session.useragent.c_str());
+    this->outputStream = outputStream;
 }
 
-char *MegaAccountSessionPrivate::getIP() const
+bool ExternalOutputStream::write(const byte *buffer, unsigned size, m_off_t)
 {
-    return MegaApi::strdup(session.ip.c_str());
+    return outputStream->write((const char *)buffer, size);
 }
 
-char *MegaAccountSessionPrivate::getCountry() const
+
+FileInputStream::FileInputStream(FileAccess *fileAccess)
 {
-    return MegaApi::strdup(session.country);
+    this->fileAccess = fileAccess;
+    this->offset = 0;
 }
 
-bool MegaAccountSessionPrivate::isCurrent() const
+m_off_t FileInputStream::size()
 {
-    return session.current;
+    return fileAccess->size;
 }
 
-bool MegaAccountSessionPrivate::isAlive() const
+bool FileInputStream::read(byte *buffer, unsigned size)
 {
-    return session.alive;
+    if (!buffer)
+    {
+        if ((offset + size) <= fileAccess->size)
+        {
+            offset += size;
+            return true;
+        }
+
+        LOG_warn << "Invalid seek on FileInputStream";
+        return false;
+    }
+
+    if (fileAccess->sysread(buffer, size, offset))
+    {
+        offset += size;
+        return true;
+    }
+
+    LOG_warn << "Invalid read on FileInputStream";
+    return false;
 }
 
-MegaHandle MegaAccountSessionPrivate::getHandle() const
+FileInputStream::~FileInputStream()
 {
-    return session.id;
+
 }
 
-MegaAccountSessionPrivate::MegaAccountSessionPrivate(const AccountSession *session)
+
+// lists the local tree breadth-first, with its own FileSystemAccess (the
+// client's one isn't thread-safe)
+struct MegaFolderUploadController::ScanTask : public ThreadPool::Task
 {
-    this->session = *session;
+    MegaFolderUploadController *controller;
+
+    void run()
+    {
+        MegaFileSystemAccess fsaccess;
+
+        for (size_t i = 0; i < controller->folders.size(); i++)
+        {
+            controller->scan(&fsaccess, i);
+        }
+    }
+
+    void completed()
+    {
+        controller->onScanned();
+    }
+};
+
+MegaFolderUploadController::MegaFolderUploadController(MegaApiImpl *megaApi, MegaTransferPrivate *transfer)
+{
+    this->megaApi = megaApi;
+    this->client = megaApi->getMegaClient();
+    this->parenthandle = transfer->getParentHandle();
+    this->transfer = transfer;
+    this->followsymlinks = client->followsymlinks;
+    this->creatingFolders = false;
+    this->submitted = false;
+    this->pendingTransfers = 0;
+    this->tag = transfer->getTag();
 }
 
+void MegaFolderUploadController::start()
+{
+    transfer->setFolderTransferTag(-1);
+    transfer->setStartTime(Waiter::ds);
+    megaApi->fireOnTransferStart(transfer);
+
+    if (!client->nodebyhandle(parenthandle))
+    {
+        megaApi->fireOnTransferFinish(transfer, MegaError(API_EARGS));
+        delete this;
+        return;
+    }
+
+    FolderEntry root;
+    root.path = transfer->getPath();
+    root.name = transfer->getFileName();
+    root.parent = -1;
+    root.h = UNDEF;
+    root.firstFolder = root.numFolders = root.firstFile = root.numFiles = 0;
+    client->fsaccess->normalize(&root.name);
+    folders.push_back(root);
 
-MegaAccountPurchase *MegaAccountPurchasePrivate::fromAccountPurchase(const AccountPurchase *purchase)
+    ScanTask *task = new ScanTask;
+    task->controller = this;
+
+    if (client->threadpool)
+    {
+        client->threadpool->submit(task);
+    }
+    else
+    {
+        task->run();
+        task->completed();
+        delete task;
+    }
+}
+
+// on the worker thread
+void MegaFolderUploadController::scan(FileSystemAccess *fsaccess, size_t folder)
 {
-    return new MegaAccountPurchasePrivate(purchase);
+    string localpath;
+    string localname;
+    nodetype_t type = TYPE_UNKNOWN;
+
+    fsaccess->path2local(&folders[folder].path, &localpath);
+    folders[folder].firstFolder = folders.size();
+    folders[folder].firstFile = files.size();
+
+    DirAccess *da = fsaccess->newdiraccess();
+    if (da->dopen(&localpath, NULL, false))
+    {
+        size_t t = localpath.size();
+
+        while (da->dnext(&localpath, &localname, followsymlinks, &type))
+        {
+            if (t)
+            {
+                localpath.append(fsaccess->localseparator);
+            }
+
+            localpath.append(localname);
+
+            m_off_t size = -1;
+            m_time_t mtime;
+            handle fsid;
+
+            // the listing usually tells the type and size without opening
+            if (type == TYPE_UNKNOWN || (type == FILENODE && !da->dstat(&size, &mtime, &fsid)))
+            {
+                FileAccess *fa = fsaccess->newfileaccess();
+
+                if (fa->fopen(&localpath, true, false))
+                {
+                    type = fa->type;
+                    size = fa->size;
+                }
+
+                delete fa;
+            }
+
+            if (type == FILENODE || type == FOLDERNODE)
+            {
+                string name = localname;
+                string path;
+
+                fsaccess->local2name(&name);
+                fsaccess->normalize(&name);
+                fsaccess->local2path(&localpath, &path);
+
+                if (type == FILENODE)
+                {
+                    FileEntry f;
+                    f.path = path;
+                    f.name = name;
+                    f.size = size;
+                    f.exists = false;
+                    files.push_back(f);
+                }
+                else
+                {
+                    FolderEntry f;
+                    f.path = path;
+                    f.name = name;
+                    f.parent = (int)folder;
+                    f.h = UNDEF;
+                    f.firstFolder = f.numFolders = f.firstFile = f.numFiles = 0;
+                    folders.push_back(f);
+                }
+            }
+
+            localpath.resize(t);
+            type = TYPE_UNKNOWN;
+        }
+    }
+
+    delete da;
+
+    folders[folder].numFolders = folders.size() - folders[folder].firstFolder;
+    folders[folder].numFiles = files.size() - folders[folder].firstFile;
 }
 
-MegaAccountPurchasePrivate::~MegaAccountPurchasePrivate()
-{
+// match the tree with the existing remote folders and files, then create
+// the missing folders: one putnodes tree per existing parent
+void MegaFolderUploadController::onScanned()
+{
+    Node *parent = client->nodebyhandle(parenthandle);
+
+    if (!parent)
+    {
+        megaApi->fireOnTransferFinish(transfer, MegaError(API_EARGS));
+        delete this;
+        return;
+    }
+
+    for (size_t i = 0; i < parent->children.size(); i++)
+    {
+        Node *child = parent->children[i];
+
+        if (child->type == FOLDERNODE && folders[0].name == child->displayname())
+        {
+            folders[0].h = child->nodehandle;
+            break;
+        }
+    }
+
+    for (size_t i = 0; i < folders.size(); i++)
+    {
+        Node *n = ISUNDEF(folders[i].h) ? NULL : client->nodebyhandle(folders[i].h);
+
+        if (!n || !n->children.size())
+        {
+            continue;
+        }
+
+        map<string, Node *> remoteFolders;
+        map<string, Node *> remoteFiles;
+
+        for (size_t j = 0; j < n->children.size(); j++)
+        {
+            Node *child = n->children[j];
+            (child->type == FILENODE ? remoteFiles : remoteFolders).insert(pair<string, Node *>(child->displayname(), child));
+        }
+
+        for (size_t j = folders[i].firstFolder; j < folders[i].firstFolder + folders[i].numFolders; j++)
+        {
+            map<string, Node *>::iterator it = remoteFolders.find(folders[j].name);
+
+            if (it != remoteFolders.end())
+            {
+                folders[j].h = it->second->nodehandle;
+            }
+        }
+
+        for (size_t j = folders[i].firstFile; j < folders[i].firstFile + folders[i].numFiles; j++)
+        {
+            map<string, Node *>::iterator it = remoteFiles.find(files[j].name);
+
+            files[j].exists = it != remoteFiles.end() && it->second->size == files[j].size;
+        }
+    }
+
+    // the nearest existing ancestor of each missing folder (its parents are
+    // earlier in the list)
+    vector<handle> targets(folders.size(), UNDEF);
+    map<handle, vector<int> > groups;
+
+    for (size_t i = 0; i < folders.size(); i++)
+    {
+        if (ISUNDEF(folders[i].h))
+        {
+            int p = folders[i].parent;
+
+            targets[i] = (p < 0) ? parenthandle : (ISUNDEF(folders[p].h) ? targets[p] : folders[p].h);
+            groups[targets[i]].push_back((int)i);
+        }
+    }
+
+    // results can arrive before all trees are sent
+    creatingFolders = true;
 
-}
+    for (map<handle, vector<int> >::iterator it = groups.begin(); it != groups.end(); it++)
+    {
+        vector<int> *indexes = &it->second;
+        NewNode *newnodes = new NewNode[indexes->size()];
 
-MegaAccountPurchase *MegaAccountPurchasePrivate::copy()
-{
-    return new MegaAccountPurchasePrivate(&purchase);
-}
+        for (size_t j = 0; j < indexes->size(); j++)
+        {
+            FolderEntry *f = &folders[(*indexes)[j]];
+            NewNode *nn = newnodes + j;
+            SymmCipher key;
+            AttrMap attrs;
+            string attrstring;
+            byte buf[FOLDERNODEKEYLENGTH];
+
+            // new folders are identified by their index + 1 within the tree
+            nn->source = NEW_NODE;
+            nn->type = FOLDERNODE;
+            nn->nodehandle = (*indexes)[j] + 1;
+            nn->parenthandle = (f->parent < 0 || !ISUNDEF(folders[f->parent].h)) ? UNDEF : (handle)(f->parent + 1);
+
+            PrnGen::genblock(buf, FOLDERNODEKEYLENGTH);
+            nn->nodekey.assign((char *)buf, FOLDERNODEKEYLENGTH);
+            key.setkey(buf);
+
+            attrs.map['n'] = f->name;
+            attrs.getjson(&attrstring);
+            nn->attrstring = new string;
+            client->makeattr(&key, nn->attrstring, attrstring.c_str());
+        }
 
-int64_t MegaAccountPurchasePrivate::getTimestamp() const
-{
-    return purchase.timestamp;
-}
+        int treeTag = client->nextreqtag();
 
-char *MegaAccountPurchasePrivate::getHandle() const
-{
-    return MegaApi::strdup(purchase.handle);
-}
+        trees[treeTag] = *indexes;
+        megaApi->folderUploadTrees[treeTag] = this;
+        client->putnodestree(it->first, newnodes, indexes->size());
+    }
 
-char *MegaAccountPurchasePrivate::getCurrency() const
-{
-    return MegaApi::strdup(purchase.currency);
-}
+    LOG_debug << "Folder upload: " << files.size() << " files in " << folders.size() << " folders, "
+              << groups.size() << " folder trees to create";
 
-double MegaAccountPurchasePrivate::getAmount() const
-{
-    return purchase.amount;
-}
+    creatingFolders = false;
 
-int MegaAccountPurchasePrivate::getMethod() const
-{
-    return purchase.method;
+    if (!trees.size())
+    {
+        startUploads();
+    }
 }
 
-MegaAccountPurchasePrivate::MegaAccountPurchasePrivate(const AccountPurchase *purchase)
+void MegaFolderUploadController::onTreeCreated(int treeTag, error e, NewNode *nn)
 {
-    this->purchase = *purchase;
-}
+    map<int, vector<int> >::iterator it = trees.find(treeTag);
 
+    if (e)
+    {
+        LOG_warn << "Unable to create folders of the upload: " << e;
+    }
 
-MegaAccountTransaction *MegaAccountTransactionPrivate::fromAccountTransaction(const AccountTransaction *transaction)
-{
-    return new MegaAccountTransactionPrivate(transaction);
-}
+    for (size_t i = 0; i < it->second.size(); i++)
+    {
+        if (nn[i].added)
+        {
+            folders[it->second[i]].h = nn[i].addedhandle;
+        }
+    }
 
-MegaAccountTransactionPrivate::~MegaAccountTransactionPrivate()
-{
+    delete [] nn;
+    trees.erase(it);
 
+    if (!trees.size() && !creatingFolders)
+    {
+        startUploads();
+    }
 }
 
-MegaAccountTransaction *MegaAccountTransactionPrivate::copy()
+// files in folders that couldn't be created are left out
+void MegaFolderUploadController::startUploads()
 {
-    return new MegaAccountTransactionPrivate(&transaction);
-}
+    UploadBatch *batch = new UploadBatch;
+    batch->copyDuplicates = true;
 
-int64_t MegaAccountTransactionPrivate::getTimestamp() const
-{
-    return transaction.timestamp;
-}
+    for (size_t i = 0; i < folders.size(); i++)
+    {
+        if (ISUNDEF(folders[i].h))
+        {
+            continue;
+        }
 
-char *MegaAccountTransactionPrivate::getHandle() const
-{
-    return MegaApi::strdup(transaction.handle);
-}
+        for (size_t j = folders[i].firstFile; j < folders[i].firstFile + folders[i].numFiles; j++)
+        {
+            FileEntry *f = &files[j];
 
-char *MegaAccountTransactionPrivate::getCurrency() const
-{
-    return MegaApi::strdup(transaction.currency);
-}
+            MegaTransferPrivate* t = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, this);
+            t->setPath(f->path.c_str());
+            t->setParentHandle(folders[i].h);
+            t->setFileName(f->name.c_str());
+            t->setTime(-1);
+            t->setFolderTransferTag(tag);
+            pendingTransfers++;
 
-double MegaAccountTransactionPrivate::getAmount() const
-{
-    return transaction.delta;
-}
+            if (!f->exists)
+            {
+                batch->transfers.push_back(t);
+                continue;
+            }
 
-MegaAccountTransactionPrivate::MegaAccountTransactionPrivate(const AccountTransaction *transaction)
-{
-    this->transaction = *transaction;
-}
+            // already uploaded
+            int nextTag = client->nextreqtag();
+            t->setTag(nextTag);
+            t->setTotalBytes(f->size);
+            megaApi->transferMap[nextTag] = t;
+            megaApi->fireOnTransferStart(t);
 
+            t->setTransferredBytes(f->size);
+            t->setDeltaSize(f->size);
+            megaApi->fireOnTransferFinish(t, MegaError(API_OK));
+        }
+    }
 
+    if (batch->transfers.size())
+    {
+        megaApi->startUploads(batch);
+    }
+    else
+    {
+        delete batch;
+    }
 
-ExternalInputStream::ExternalInputStream(MegaInputStream *inputStream)
-{
-    this->inputStream = inputStream;
+    submitted = true;
+    checkCompletion();
 }
 
-m_off_t ExternalInputStream::size()
+void MegaFolderUploadController::checkCompletion()
 {
-    return inputStream->getSize();
+    if(submitted && !pendingTransfers)
+    {
+        LOG_debug << "Folder transfer finished - " << transfer->getTransferredBytes() << " of " << transfer->getTotalBytes();
+        megaApi->fireOnTransferFinish(transfer, MegaError(API_OK));
+        delete this;
+    }
 }
 
-bool ExternalInputStream::read(byte *buffer, unsigned size)
+void MegaFolderUploadController::onTransferStart(MegaApi *, MegaTransfer *t)
 {
-    return inputStream->read((char *)buffer, size);
+    transfer->setTotalBytes(transfer->getTotalBytes() + t->getTotalBytes());
+    transfer->setUpdateTime(Waiter::ds);
+    megaApi->fireOnTransferUpdate(transfer);
 }
 
-
-FileInputStream::FileInputStream(FileAccess *fileAccess)
+void MegaFolderUploadController::onTransferUpdate(MegaApi *, MegaTransfer *t)
 {
-    this->fileAccess = fileAccess;
-    this->offset = 0;
+    transfer->setTransferredBytes(transfer->getTransferredBytes() + t->getDeltaSize());
+    transfer->setUpdateTime(Waiter::ds);
+    transfer->setSpeed(t->getSpeed());
+    megaApi->fireOnTransferUpdate(transfer);
 }
 
-m_off_t FileInputStream::size()
+void MegaFolderUploadController::onTransferFinish(MegaApi *, MegaTransfer *t, MegaError *)
 {
-    return fileAccess->size;
+    pendingTransfers--;
+    transfer->setTransferredBytes(transfer->getTransferredBytes() + t->getDeltaSize());
+    transfer->setUpdateTime(Waiter::ds);
+
+    if(t->getSpeed())
+    {
+        transfer->setSpeed(t->getSpeed());
+    }
+
+    megaApi->fireOnTransferUpdate(transfer);
+    checkCompletion();
 }
 
-bool FileInputStream::read(byte *buffer, unsigned size)
+// creates the local folders, with its own FileSystemAccess (the client's
+// one isn't thread-safe) - existing folders are fine
+struct MegaFolderDownloadController::FolderTask : public ThreadPool::Task
 {
-    if (!buffer)
+    MegaFolderDownloadController *controller;
+    error e;
+
+    void run()
     {
-        if ((offset + size) <= fileAccess->size)
+        MegaFileSystemAccess fsaccess;
+
+        e = API_OK;
+
+        for (size_t i = 0; i < controller->folders.size(); i++)
         {
-            offset += size;
-            return true;
-        }
+            string localpath;
+            fsaccess.path2local(&controller->folders[i], &localpath);
 
-        LOG_warn << "Invalid seek on FileInputStream";
-        return false;
+            if (!fsaccess.mkdirlocal(&localpath, false) && !fsaccess.target_exists)
+            {
+                LOG_warn << "Unable to create folder: " << controller->folders[i];
+
+                // nothing can be downloaded without the target folder
+                if (!i)
+                {
+                    e = API_EWRITE;
+                    return;
+                }
+            }
+        }
     }
 
-    if (fileAccess->sysread(buffer, size, offset))
+    void completed()
     {
-        offset += size;
-        return true;
+        controller->onFoldersCreated(e);
     }
+};
 
-    LOG_warn << "Invalid read on FileInputStream";
-    return false;
-}
-
-FileInputStream::~FileInputStream()
-{
-
-}
-
-
-MegaFolderUploadController::MegaFolderUploadController(MegaApiImpl *megaApi, MegaTransferPrivate *transfer)
+MegaFolderDownloadController::MegaFolderDownloadController(MegaApiImpl *megaApi, MegaTransferPrivate *transfer)
 {
     this->megaApi = megaApi;
     this->client = megaApi->getMegaClient();
-    this->parenthandle = transfer->getParentHandle();
-    this->name = transfer->getFileName();
     this->transfer = transfer;
-    this->listener = transfer->getListener();
-    this->recursive = 0;
-    this->pendingTransfers = 0;
     this->tag = transfer->getTag();
+    this->pendingTransfers = 0;
+    this->finished = 0;
+    this->prefetched = 0;
 }
 
-void MegaFolderUploadController::start()
+void MegaFolderDownloadController::start()
 {
+    Node *node = client->nodebyhandle(transfer->getNodeHandle());
+    string path = transfer->getPath();
+
+    client->fsaccess->local2path(&client->fsaccess->localseparator, &separator);
+    scan(node, &path);
+
+    m_off_t totalBytes = 0;
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        totalBytes += files[i].size;
+    }
+
     transfer->setFolderTransferTag(-1);
+    transfer->setTotalBytes(totalBytes);
     transfer->setStartTime(Waiter::ds);
     megaApi->fireOnTransferStart(transfer);
 
-    MegaNode *parent = megaApi->getNodeByHandle(parenthandle);
-    if(!parent)
+    FolderTask *task = new FolderTask;
+    task->controller = this;
+
+    if (client->threadpool)
     {
-        megaApi->fireOnTransferFinish(transfer, MegaError(API_EARGS));
-        delete this;
+        client->threadpool->submit(task);
     }
     else
     {
-        string path = transfer->getPath();
-        string localpath;
-        client->fsaccess->path2local(&path, &localpath);
+        task->run();
+        task->completed();
+        delete task;
+    }
+}
 
-        MegaNode *child = megaApi->getChildNode(parent, name);
+void MegaFolderDownloadController::scan(Node *node, const string *path)
+{
+    unsigned folder = folders.size();
+    folders.push_back(*path);
+
+    for (size_t i = 0; i < node->children.size(); i++)
+    {
+        Node *child = node->children[i];
 
-        if(!child || !child->isFolder())
+        if (child->type == FILENODE)
         {
-            pendingFolders.push_back(localpath);
-            megaApi->createFolder(name, parent, this);
+            FileEntry f;
+            f.h = child->nodehandle;
+            f.size = child->size;
+            f.folder = folder;
+            files.push_back(f);
         }
         else
         {
-            pendingFolders.push_front(localpath);
-            onFolderAvailable(child->getHandle());
-        }
+            string name = child->displayname();
+            string securename;
+            client->fsaccess->name2local(&name);
+            client->fsaccess->local2path(&name, &securename);
 
-        delete child;
-        delete parent;
+            string childPath = *path + separator + securename;
+            scan(child, &childPath);
+        }
     }
 }
 
-void MegaFolderUploadController::onFolderAvailable(MegaHandle handle)
+bool MegaFolderDownloadController::smaller(const FileEntry &a, const FileEntry &b)
 {
-    recursive++;
-    string localPath = pendingFolders.front();
-    pendingFolders.pop_front();
-
-    MegaNode *parent = megaApi->getNodeByHandle(handle);
+    return a.size < b.size;
+}
 
-    string localname;
-    DirAccess* da;
-    da = client->fsaccess->newdiraccess();
-    if (da->dopen(&localPath, NULL, false))
+// small files first: many of them share the connections at once, the large
+// ones follow with their full chunk pipelines
+void MegaFolderDownloadController::onFoldersCreated(error e)
+{
+    if (e)
     {
-        size_t t = localPath.size();
-
-        while (da->dnext(&localPath, &localname, client->followsymlinks))
-        {
-            if (t)
-            {
-                localPath.append(client->fsaccess->localseparator);
-            }
-
-            localPath.append(localname);
-
-            FileAccess *fa = client->fsaccess->newfileaccess();
-            if(fa->fopen(&localPath, true, false))
-            {
-                string name = localname;
-                client->fsaccess->local2name(&name);
+        LOG_err << "Unable to create the target folder of the download: " << transfer->getPath();
+        megaApi->fireOnTransferFinish(transfer, MegaError(e));
+        delete this;
+        return;
+    }
 
-                if(fa->type == FILENODE)
-                {
-                    pendingTransfers++;
-                    MegaNode *child = megaApi->getChildNode(parent, name.c_str());
-                    if(!child || child->isFolder() || (fa->size != child->getSize()))
-                    {                        
-                        FileFingerprint fp;
-                        fp.genfingerprint(fa);
-                        Node *node = client->nodebyfingerprint(&fp);
-                        if(!node)
-                        {
-                            string utf8path;
-                            client->fsaccess->local2path(&localPath, &utf8path);
-                            megaApi->startUpload(utf8path.c_str(), parent, (const char *)NULL, -1, tag, this);
-                        }
-                        else
-                        {
-                            string utf8path;
-                            client->fsaccess->local2path(&localPath, &utf8path);
-                            #if defined(_WIN32) && !defined(WINDOWS_PHONE)
-                                    if(!PathIsRelativeA(utf8path.c_str()) && ((utf8path.size()<2) || utf8path.compare(0, 2, "\\\\")))
-                                        utf8path.insert(0, "\\\\?\\");
-                            #endif
-
-                            int nextTag = client->nextreqtag();
-                            MegaTransferPrivate* t = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, this);
-                            t->setPath(utf8path.c_str());
-                            t->setParentHandle(parent->getHandle());
-                            t->setTag(nextTag);
-                            t->setFolderTransferTag(tag);
-                            t->setTotalBytes(node->size);
-                            megaApi->transferMap[nextTag] = t;
-                            pendingSkippedTransfers.push_back(t);
-                            megaApi->fireOnTransferStart(t);
-
-                            MegaNode *duplicate = MegaNodePrivate::fromNode(node);
-                            megaApi->copyNode(duplicate, parent, name.c_str(), this);
-                            delete duplicate;
-                        }
-                    }
-                    else
-                    {
-                        string utf8path;
-                        client->fsaccess->local2path(&localPath, &utf8path);
-                        #if defined(_WIN32) && !defined(WINDOWS_PHONE)
-                                if(!PathIsRelativeA(utf8path.c_str()) && ((utf8path.size()<2) || utf8path.compare(0, 2, "\\\\")))
-                                    utf8path.insert(0, "\\\\?\\");
-                        #endif
-
-                        int nextTag = client->nextreqtag();
-                        MegaTransferPrivate* t = new MegaTransferPrivate(MegaTransfer::TYPE_UPLOAD, this);
-                        t->setPath(utf8path.data());
-                        t->setParentHandle(parent->getHandle());
-                        t->setTag(nextTag);
-                        t->setFolderTransferTag(tag);
-                        t->setTotalBytes(child->getSize());
-                        megaApi->transferMap[nextTag] = t;
-                        megaApi->fireOnTransferStart(t);
-
-                        t->setTransferredBytes(child->getSize());
-                        t->setDeltaSize(child->getSize());
-                        megaApi->fireOnTransferFinish(t, MegaError(API_OK));
-                    }
+    std::stable_sort(files.begin(), files.end(), smaller);
+    prefetch();
 
-                    delete child;
-                }
-                else
-                {
-                    MegaNode *child = megaApi->getChildNode(parent, name.c_str());
-                    if(!child || !child->isFolder())
-                    {
-                        pendingFolders.push_back(localPath);
-                        megaApi->createFolder(name.c_str(), parent, this);
-                    }
-                    else
-                    {
-                        pendingFolders.push_front(localPath);
-                        onFolderAvailable(child->getHandle());
-                    }
-                    delete child;
-                }
-            }
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        string parentPath = folders[files[i].folder] + separator;
 
-            localPath.resize(t);
-            delete fa;
-        }
+        pendingTransfers++;
+        megaApi->startDownload(files[i].h, parentPath.c_str(), tag, this);
     }
 
-    delete da;
-    delete parent;
-    recursive--;
-
+    LOG_debug << "Folder download started - " << files.size() << " files in " << folders.size() << " folders";
     checkCompletion();
 }
 
-void MegaFolderUploadController::checkCompletion()
+void MegaFolderDownloadController::prefetch()
 {
-    if(!recursive && !pendingFolders.size() && !pendingTransfers && !pendingSkippedTransfers.size())
+    handle_vector batch;
+
+    while (prefetched < files.size() && batch.size() < TEMPURLBATCH)
     {
-        LOG_debug << "Folder transfer finished - " << transfer->getTransferredBytes() << " of " << transfer->getTotalBytes();
-        megaApi->fireOnTransferFinish(transfer, MegaError(API_OK));
-        delete this;
+        batch.push_back(files[prefetched++].h);
     }
-}
 
-void MegaFolderUploadController::onRequestFinish(MegaApi *, MegaRequest *request, MegaError *e)
-{
-    int type = request->getType();
-    int errorCode = e->getErrorCode();
-
-    if(type == MegaRequest::TYPE_CREATE_FOLDER)
+    if (batch.size())
     {
-        if(!errorCode)
-        {
-            onFolderAvailable(request->getNodeHandle());
-        }
-        else
-        {
-            pendingFolders.pop_front();
-            checkCompletion();
-        }
+        client->prefetchtempurls(&batch);
     }
-    else if(type == MegaRequest::TYPE_COPY)
-    {
-        Node *node = client->nodebyhandle(request->getNodeHandle());
+}
 
-        MegaTransferPrivate *t = pendingSkippedTransfers.front();
-        t->setTransferredBytes(node->size);
-        t->setDeltaSize(node->size);
-        megaApi->fireOnTransferFinish(t, MegaError(API_OK));
-        pendingSkippedTransfers.pop_front();
-        checkCompletion();
+void MegaFolderDownloadController::checkCompletion()
+{
+    if (!pendingTransfers)
+    {
+        LOG_debug << "Folder transfer finished - " << transfer->getTransferredBytes() << " of " << transfer->getTotalBytes();
+        megaApi->fireOnTransferFinish(transfer, MegaError(API_OK));
+        delete this;
     }
 }
 
-void MegaFolderUploadController::onTransferStart(MegaApi *, MegaTransfer *t)
+// the total size of the folder is known from the start
+void MegaFolderDownloadController::onTransferStart(MegaApi *, MegaTransfer *)
 {
-    transfer->setTotalBytes(transfer->getTotalBytes() + t->getTotalBytes());
-    transfer->setUpdateTime(Waiter::ds);
-    megaApi->fireOnTransferUpdate(transfer);
 }
 
-void MegaFolderUploadController::onTransferUpdate(MegaApi *, MegaTransfer *t)
+void MegaFolderDownloadController::onTransferUpdate(MegaApi *, MegaTransfer *t)
 {
     transfer->setTransferredBytes(transfer->getTransferredBytes() + t->getDeltaSize());
     transfer->setUpdateTime(Waiter::ds);
@@ -10877,9 +18192,16 @@ void MegaFolderUploadController::onTransferUpdate(MegaApi *, MegaTransfer *t)
     megaApi->fireOnTransferUpdate(transfer);
 }
 
-void MegaFolderUploadController::onTransferFinish(MegaApi *, MegaTransfer *t, MegaError *)
+void MegaFolderDownloadController::onTransferFinish(MegaApi *, MegaTransfer *t, MegaError *)
 {
     pendingTransfers--;
+    finished++;
+
+    if (prefetched < files.size() && finished + TEMPURLBATCH / 2 >= prefetched)
+    {
+        prefetch();
+    }
+
     transfer->setTransferredBytes(transfer->getTransferredBytes() + t->getDeltaSize());
     transfer->setUpdateTime(Waiter::ds);
 
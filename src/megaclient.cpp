@@ -44,6 +44,9 @@ const char* const MegaClient::SYNCDEBRISFOLDERNAME = "SyncDebris";
 // exported link marker
 const char* const MegaClient::EXPORTEDLINK = "EXP";
 
+// node snapshot file format version
+const char MegaClient::SNAPSHOTMAGIC[] = "MEGASNP1";
+
 // public key to send payment details
 const char MegaClient::PAYMENT_PUBKEY[] =
         "CADB-9t4WSMCs6we8CNcAmq97_bP-eXa9pn7SwGPxXpTuScijDrLf_ooneCQnnRBDvE"
@@ -70,6 +73,8 @@ bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, in
     if (sl > 4 * FILENODEKEYLENGTH / 3 + 1)
     {
         // RSA-encrypted key - decrypt and update on the server to save space & client CPU time
+        string wrapped(sk, sl);
+
         sl = sl / 4 * 3 + 3;
 
         if (sl > 4096)
@@ -77,19 +82,25 @@ bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, in
             return false;
         }
 
-        byte* buf = new byte[sl];
+        if (!cachedrsakey(&wrapped, tk, tl))
+        {
+            byte* buf = new byte[sl];
 
-        sl = Base64::atob(sk, buf, sl);
+            sl = Base64::atob(sk, buf, sl);
+
+            // decrypt and set session ID for subsequent API communication
+            if (!asymkey.decrypt(buf, sl, tk, tl))
+            {
+                delete[] buf;
+                LOG_warn << "Corrupt or invalid RSA node key";
+                return false;
+            }
 
-        // decrypt and set session ID for subsequent API communication
-        if (!asymkey.decrypt(buf, sl, tk, tl))
-        {
             delete[] buf;
-            LOG_warn << "Corrupt or invalid RSA node key";
-            return false;
-        }
 
-        delete[] buf;
+            rsadecrypts++;
+            cachersakey(&wrapped, tk, tl);
+        }
 
         if (!ISUNDEF(node))
         {
@@ -117,6 +128,105 @@ bool MegaClient::decryptkey(const char* sk, byte* tk, int tl, SymmCipher* sc, in
     return true;
 }
 
+// the decrypted key, if cached with at least the requested length (a
+// shorter decryption is a prefix of a longer one)
+bool MegaClient::cachedrsakey(const string* wrapped, byte* tk, int tl)
+{
+    map<string, string>::iterator it = rsakeys.find(*wrapped);
+
+    if (it == rsakeys.end() || it->second.size() < (size_t)tl)
+    {
+        return false;
+    }
+
+    memcpy(tk, it->second.data(), tl);
+    rsacachehits++;
+
+    return true;
+}
+
+SymmCipher* MegaClient::getnodecipher(Node* n)
+{
+    map<handle, unsigned>::iterator it = nodecipherslots.find(n->nodehandle);
+    NodeCipher* nc;
+
+    if (it != nodecipherslots.end())
+    {
+        nc = &nodeciphers[it->second];
+
+        if (nc->key == n->nodekey)
+        {
+            nc->lastuse = ++nodecipheruse;
+            return &nc->cipher;
+        }
+    }
+    else
+    {
+        // evict the least recently used slot
+        unsigned slot = 0;
+
+        for (unsigned i = 1; i < MAXNODECIPHERS; i++)
+        {
+            if (nodeciphers[i].lastuse < nodeciphers[slot].lastuse)
+            {
+                slot = i;
+            }
+        }
+
+        nc = &nodeciphers[slot];
+
+        if (nc->h != UNDEF)
+        {
+            nodecipherslots.erase(nc->h);
+        }
+
+        nc->h = n->nodehandle;
+        nodecipherslots[nc->h] = slot;
+    }
+
+    if (!nc->cipher.setkey(&n->nodekey))
+    {
+        nodecipherslots.erase(nc->h);
+        nc->h = UNDEF;
+        nc->key.clear();
+        nc->lastuse = 0;
+
+        return NULL;
+    }
+
+    nc->key = n->nodekey;
+    nc->lastuse = ++nodecipheruse;
+
+    return &nc->cipher;
+}
+
+void MegaClient::clearnodeciphers()
+{
+    for (unsigned i = 0; i < MAXNODECIPHERS; i++)
+    {
+        nodeciphers[i].h = UNDEF;
+        nodeciphers[i].key.clear();
+        nodeciphers[i].lastuse = 0;
+    }
+
+    nodecipherslots.clear();
+}
+
+void MegaClient::cachersakey(const string* wrapped, const byte* tk, int tl)
+{
+    if (rsakeys.size() >= MAXRSAKEYS)
+    {
+        rsakeys.clear();
+    }
+
+    string& key = rsakeys[*wrapped];
+
+    if (key.size() < (size_t)tl)
+    {
+        key.assign((const char*)tk, tl);
+    }
+}
+
 // apply queued new shares
 void MegaClient::mergenewshares(bool notify)
 {
@@ -140,7 +250,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
 
     if ((n = nodebyhandle(s->h)))
     {
-        if (!n->sharekey && s->have_key)
+        if (!n->sharekey() && s->have_key)
         {
             // setting an outbound sharekey requires node authentication
             // unless coming from a trusted source (the local cache)
@@ -169,7 +279,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
 
             if (auth)
             {
-                n->sharekey = new SymmCipher(s->key);
+                n->sharingstate()->sharekey = new SymmCipher(s->key);
                 skreceived = true;
             }
         }
@@ -180,46 +290,46 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
             if (s->outgoing)
             {
                 bool found = false;
-                if (n->outshares)
+                if (n->outshares())
                 {
                     // outgoing share to user u deleted
-                    if (n->outshares->erase(s->peer) && notify)
+                    if (n->outshares()->erase(s->peer) && notify)
                     {
                         found = true;
                         n->changed.outshares = true;
                         notifynode(n);
                     }
 
-                    if (!n->outshares->size())
+                    if (!n->outshares()->size())
                     {
-                        delete n->outshares;
-                        n->outshares = NULL;
+                        delete n->outshares();
+                        n->sharingstate()->outshares = NULL;
                     }
                 }
-                if (n->pendingshares && !found && s->pending)
+                if (n->pendingshares() && !found && s->pending)
                 {
                     // delete the pending share
-                    if (n->pendingshares->erase(s->pending) && notify)
+                    if (n->pendingshares()->erase(s->pending) && notify)
                     {
                         found = true;
                         n->changed.pendingshares = true;
                         notifynode(n);
                     }
 
-                    if (!n->pendingshares->size())
+                    if (!n->pendingshares()->size())
                     {
-                        delete n->pendingshares;
-                        n->pendingshares = NULL;
+                        delete n->pendingshares();
+                        n->sharingstate()->pendingshares = NULL;
                     }
                 }
 
                 // Erase sharekey if no outgoing shares (incl pending) exist
-                if (!n->outshares && !n->pendingshares)
+                if (!n->outshares() && !n->pendingshares())
                 {
                     rewriteforeignkeys(n);
 
-                    delete n->sharekey;
-                    n->sharekey = NULL;
+                    delete n->sharekey();
+                    n->sharingstate()->sharekey = NULL;
                 }
             }
             else
@@ -227,16 +337,15 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
                 // incoming share deleted - remove tree
                 if (!n->parent)
                 {
-                    TreeProcDel td;
-                    proctree(n, &td, true);
+                    deltree(n, true);
                 }
                 else
                 {
-                    if (n->inshare)
+                    if (n->inshare())
                     {
-                        n->inshare->user->sharing.erase(n->nodehandle);
-                        notifyuser(n->inshare->user);
-                        n->inshare = NULL;
+                        n->inshare()->user->sharing.erase(n->nodehandle);
+                        notifyuser(n->inshare()->user);
+                        n->sharingstate()->inshare = NULL;
                     }
                 }
             }
@@ -256,49 +365,49 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
                         if (!ISUNDEF(s->pending))
                         {
                             // Pending share
-                            if (!n->pendingshares)
+                            if (!n->pendingshares())
                             {
-                                n->pendingshares = new share_map;
+                                n->sharingstate()->pendingshares = new share_map;
                             }
 
-                            sharep = &((*n->pendingshares)[s->pending]);
+                            sharep = &((*n->pendingshares())[s->pending]);
 
                             if (*sharep && s->upgrade_pending_to_full)
                             {
                                 // This is currently a pending share that needs to be upgraded to a full share
                                 // erase from pending shares & delete the pending share list if needed
-                                if (n->pendingshares->erase(s->pending) && notify)
+                                if (n->pendingshares()->erase(s->pending) && notify)
                                 {
                                     n->changed.pendingshares = true;
                                     notifynode(n);
                                 }
-                                if (!n->pendingshares->size())
+                                if (!n->pendingshares()->size())
                                 {
-                                    delete n->pendingshares;
-                                    n->pendingshares = NULL;
+                                    delete n->pendingshares();
+                                    n->sharingstate()->pendingshares = NULL;
                                 }
                                 // clear this so we can fall through to below and have it re-create the share in
                                 // the outshares list
                                 s->pending = UNDEF;
 
                                 // create the outshares list if needed
-                                if (!n->outshares)
+                                if (!n->outshares())
                                 {
-                                    n->outshares = new share_map();
+                                    n->sharingstate()->outshares = new share_map();
                                 }
 
-                                sharep = &((*n->outshares)[s->peer]);
+                                sharep = &((*n->outshares())[s->peer]);
                             }
                         }
                         else
                         {
                             // Normal outshare
-                            if (!n->outshares)
+                            if (!n->outshares())
                             {
-                                n->outshares = new share_map();
+                                n->sharingstate()->outshares = new share_map();
                             }
 
-                            sharep = &((*n->outshares)[s->peer]);
+                            sharep = &((*n->outshares())[s->peer]);
                         }
 
                         // modification of existing share or new share
@@ -342,14 +451,14 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
                         if (!checkaccess(n, OWNERPRELOGIN))
                         {
                             // modification of existing share or new share
-                            if (n->inshare)
+                            if (n->inshare())
                             {
-                                n->inshare->update(s->access, s->ts);
+                                n->inshare()->update(s->access, s->ts);
                             }
                             else
                             {
-                                n->inshare = new Share(finduser(s->peer, 1), s->access, s->ts, NULL);
-                                n->inshare->user->sharing.insert(n->nodehandle);
+                                n->sharingstate()->inshare = new Share(finduser(s->peer, 1), s->access, s->ts, NULL);
+                                n->inshare()->user->sharing.insert(n->nodehandle);
                             }
 
                             if (notify)
@@ -379,7 +488,7 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
             }
         }
 #ifdef ENABLE_SYNC
-        if (n->inshare && s->access != FULL)
+        if (n->inshare() && s->access != FULL)
         {
             // check if the low(ered) access level is affecting any syncs
             // a) have we just cut off full access to a subtree of a sync?
@@ -405,6 +514,122 @@ void MegaClient::mergenewshare(NewShare *s, bool notify)
 
         }
 #endif
+
+        if ((n = nodebyhandle(s->h)))
+        {
+            indexshares(n);
+        }
+    }
+}
+
+// the share root's key went with the share itself
+void MegaClient::queuesharekeys(handle sh)
+{
+    Node* n = nodebyhandle(sh);
+
+    if (!n)
+    {
+        return;
+    }
+
+    sharekeyuploads.push_back(ShareKeyUpload());
+    sharekeyuploads.back().sh = sh;
+
+    loadchildren(n);
+
+    for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+    {
+        sharekeyuploads.back().pending.push_back((*it)->nodehandle);
+    }
+
+    LOG_debug << "Uploading the node keys of a share of " << n->subtree.files + n->subtree.folders << " nodes in slices";
+}
+
+// nodes that were moved out of the share or deleted in the meantime are
+// skipped, those added to it carry their share keys already
+void MegaClient::execsharekeys()
+{
+    if (sharekeyinflight || sharekeyuploads.empty())
+    {
+        return;
+    }
+
+    ShareKeyUpload* upload = &sharekeyuploads.front();
+    Node* sn = nodebyhandle(upload->sh);
+
+    if (!sn || !sn->sharekey())
+    {
+        sharekeyuploads.pop_front();
+        return;
+    }
+
+    ShareNodeKeys snk;
+    unsigned count = 0;
+
+    while (count < SHAREKEYSLICE && upload->pending.size())
+    {
+        Node* n = nodebyhandle(upload->pending.back());
+
+        upload->pending.pop_back();
+
+        if (!n || !n->isbelow(sn))
+        {
+            continue;
+        }
+
+        if (n->type != FILENODE)
+        {
+            loadchildren(n);
+
+            for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+            {
+                upload->pending.push_back((*it)->nodehandle);
+            }
+        }
+
+        snk.add(n, sn, 1);
+        count++;
+    }
+
+    if (count)
+    {
+        reqs.add(new CommandShareNodeKeys(this, &snk));
+        sharekeyinflight = true;
+    }
+
+    if (upload->pending.empty())
+    {
+        sharekeyuploads.pop_front();
+    }
+}
+
+void MegaClient::indexshares(Node* n)
+{
+    if (n->outshares())
+    {
+        outsharenodes.insert(n->nodehandle);
+    }
+    else
+    {
+        outsharenodes.erase(n->nodehandle);
+    }
+
+    if (n->pendingshares())
+    {
+        pendingsharenodes.insert(n->nodehandle);
+    }
+    else
+    {
+        pendingsharenodes.erase(n->nodehandle);
+    }
+
+    if (n->inshare())
+    {
+        insharenodes.insert(n->nodehandle);
+    }
+    else
+    {
+        insharenodes.erase(n->nodehandle);
     }
 }
 
@@ -548,6 +773,160 @@ bool MegaClient::warnlevel()
     return warned ? (warned = false) | true : false;
 }
 
+// lazy mode: decrypt a node subtree (all nodes if NULL) - once all nodes are
+// decrypted, decryption reverts to being eager
+void MegaClient::decryptnodes(Node* n)
+{
+    if (!n)
+    {
+        for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+        {
+            it->second->decrypt();
+        }
+
+        nodesdeferred = false;
+        return;
+    }
+
+    node_vector pending;
+
+    pending.push_back(n);
+
+    while (pending.size())
+    {
+        n = pending.back();
+        pending.pop_back();
+
+        n->decrypt();
+
+        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        {
+            pending.push_back(*it);
+        }
+    }
+}
+
+// lazy mode: decrypt the immediate children of a folder
+void MegaClient::decryptchildren(Node* n)
+{
+    for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+    {
+        (*it)->decrypt();
+    }
+}
+
+void MegaClient::nodememoryusage(NodeMemoryUsage* m)
+{
+    m->nodes = nodeslab.allocated();
+    m->nodeindex = nodes.allocated();
+    m->fingerprints = fingerprints.allocated();
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+
+        m->attrs += n->attrs.map.allocated();
+
+        m->strings += stringallocated(&n->nodekey) + stringallocated(&n->fileattrstring);
+
+        if (n->attrstring)
+        {
+            m->strings += sizeof(string) + stringallocated(n->attrstring);
+        }
+
+        m->children += n->children.allocated();
+
+        if (n->sharing)
+        {
+            m->sharing += sizeof(NodeSharing);
+
+            // approximation: share objects only, not the maps' tree nodes
+            if (n->sharing->outshares)
+            {
+                m->sharing += n->sharing->outshares->size() * sizeof(Share);
+            }
+
+            if (n->sharing->pendingshares)
+            {
+                m->sharing += n->sharing->pendingshares->size() * sizeof(Share);
+            }
+
+            if (n->sharing->inshare)
+            {
+                m->sharing += sizeof(Share);
+            }
+
+            if (n->sharing->sharekey)
+            {
+                m->sharing += sizeof(SymmCipher);
+            }
+
+            if (n->sharing->plink)
+            {
+                m->sharing += sizeof(PublicLink);
+            }
+        }
+    }
+}
+
+m_off_t MegaClient::trimmemory(int level)
+{
+    m_off_t freed = 0;
+
+    if (level < TRIM_CACHES)
+    {
+        return 0;
+    }
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        size_t size = it->second->children.allocated();
+
+        it->second->children.invalidate();
+        freed += size - it->second->children.allocated();
+    }
+
+    // approximate per-entry overhead of the map's tree nodes
+    for (map<string, string>::iterator it = rsakeys.begin(); it != rsakeys.end(); it++)
+    {
+        freed += sizeof(*it) + 4 * sizeof(void*) + stringallocated(&it->first) + stringallocated(&it->second);
+    }
+
+    rsakeys.clear();
+
+    freed += chunkbuffers.idle;
+    chunkbuffers.clear();
+
+    if (level >= TRIM_ALL)
+    {
+        freed += drcache.bytes;
+        drcache.clear();
+
+        if (nodepaging)
+        {
+            NodeMemoryUsage before, after;
+            unsigned limit = nodecachelimit;
+
+            nodememoryusage(&before);
+
+            nodecachelimit = 0;
+            trimnodes();
+            nodecachelimit = limit;
+
+            nodememoryusage(&after);
+
+            if (before.total() > after.total())
+            {
+                freed += before.total() - after.total();
+            }
+        }
+    }
+
+    LOG_info << "Memory trimmed (level " << level << "): " << freed << " bytes";
+
+    return freed;
+}
+
 // returns the first matching child node by UTF-8 name (does not resolve name clashes)
 Node* MegaClient::childnodebyname(Node* p, const char* name)
 {
@@ -555,15 +934,14 @@ Node* MegaClient::childnodebyname(Node* p, const char* name)
 
     fsaccess->normalize(&nname);
 
-    for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+    loadchildren(p);
+
+    if (nodesdeferred)
     {
-        if (!strcmp(nname.c_str(), (*it)->displayname()))
-        {
-            return *it;
-        }
+        decryptchildren(p);
     }
 
-    return NULL;
+    return p->children.childbyname(nname.c_str());
 }
 
 void MegaClient::init()
@@ -601,27 +979,70 @@ void MegaClient::init()
     delete pendingsc;
     pendingsc = NULL;
 
+    delete nextsc;
+    nextsc = NULL;
 
     btcs.reset();
+    btfastcs.reset();
     btsc.reset();
     btpfa.reset();
 
     jsonsc.pos = NULL;
     insca = false;
+    scpackets = 0;
+    scwaitseen = false;
+    catchingup = false;
     scnotifyurl.clear();
     *scsn = 0;
 }
 
 MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, DbAccess* d, GfxProc* g, const char* k, const char* u)
+    : nodeslab(Node::ALLOCSIZE, NODESLABCHUNK)
 {
     sctable = NULL;
+    tctable = NULL;
     me = UNDEF;
     followsymlinks = false;
+    lazydecrypt = false;
+    nodesdeferred = false;
+    pagednodes = false;
+    nodecachelimit = NODECACHELIMIT;
+    nodepaging = false;
+    snapshotnodes = false;
+    sccommitted = false;
+    workers = NULL;
+    cryptoworkers = NULL;
+    facache = NULL;
+    scanworkers = NULL;
+    threadpool = NULL;
+    rsadecrypts = 0;
+    rsaparallel = 0;
+    rsacachehits = 0;
+    keytime = 0;
+    nodecipheruse = 0;
+    clearnodeciphers();
     usealtdownport = false;
     usealtupport = false;
     autodownport = true;
     autoupport = true;
     fetchingnodes = false;
+    nodestreampartial = false;
+    nodestreampaging = false;
+    offlinestart = false;
+    accountcachettl = 600;
+    accountcacheparts = 0;
+    accountcachetime = 0;
+    accountcachelocal = 0;
+    csbatchuntil = 0;
+    deferlimit = 0;
+    deferredsince = 0;
+    txwindowuntil = 0;
+    sharekeyinflight = false;
+    appwakeup = NEVER;
+
+    batchuploadnodes = false;
+    uploadnodesds = 0;
+    numuploadnodes = 0;
 
 #ifdef ENABLE_SYNC
     syncscanstate = false;
@@ -630,9 +1051,16 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
 #endif
 
     pendingcs = NULL;
+    pendingfastcs = NULL;
     pendingsc = NULL;
+    nextsc = NULL;
+    csstarted = 0;
+    fastcsstarted = 0;
+    scarrived = 0;
+    ressent = 0;
+    resreceived = 0;
+    tracer.setwatchdog(&metrics, STALLTHRESHOLD);
 
-    curfa = newfa.end();
     xferpaused[PUT] = false;
     xferpaused[GET] = false;
     putmbpscap = 0;
@@ -663,6 +1091,16 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
     connections[PUT] = 3;
     connections[GET] = 4;
 
+    minconnections[PUT] = maxconnections[PUT] = connections[PUT];
+    minconnections[GET] = maxconnections[GET] = connections[GET];
+
+    maxtransfers[PUT] = maxtransfers[GET] = 0;
+    maxinflight[PUT] = maxinflight[GET] = 0;
+    maxxferconnections[PUT] = maxxferconnections[GET] = 0;
+    writebackmax = 0;
+    sinkmtime = 0;
+    drconnections = 1;
+
     int i;
 
     // initialize random client application instance ID (for detecting own
@@ -678,6 +1116,11 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
         reqid[i] = 'a' + PrnGen::genuint32(26);
     }
 
+    for (i = sizeof fastreqid; i--; )
+    {
+        fastreqid[i] = 'a' + PrnGen::genuint32(26);
+    }
+
     nextuh = 0;  
     reqtag = 0;
 
@@ -705,39 +1148,345 @@ MegaClient::MegaClient(MegaApp* a, Waiter* w, HttpIO* h, FileSystemAccess* f, Db
 
 MegaClient::~MegaClient()
 {
+    if (snapshotnodes)
+    {
+        writesnapshot();
+    }
+
     locallogout();
 
     delete pendingcs;
+    delete pendingfastcs;
     delete pendingsc;
+    delete nextsc;
     delete badhostcs;
     delete loadbalancingcs;
     delete sctable;
+    delete tctable;
     delete dbaccess;
+    delete facache;
 }
 
 // nonblocking state machine executing all operations currently in progress
-void MegaClient::exec()
+// increment a unique request ID
+static void incrementreqid(char* id, int len)
 {
-    WAIT_CLASS::bumpds();
-
-    if (httpio->inetisback())
+    for (int i = len; i--; )
     {
-        LOG_info << "Internet connectivity returned - resetting all backoff timers";
-        abortbackoff();
-    }
+        if (id[i]++ < 'z')
+        {
+            break;
+        }
 
-    if (EVER(httpio->lastdata) && !pendingcs && Waiter::ds >= httpio->lastdata + HttpIO::NETWORKTIMEOUT)
-    {
-        disconnect();
+        id[i] = 'a';
     }
+}
 
-    // successful network operation with a failed transfer chunk: increment error count
-    // and continue transfers
-    if (httpio->success && chunkfailed)
+// read the complete node objects of an in-flight fetchnodes response in
+// batches of up to NODESTREAMBATCH and drop them from the receive buffer, so
+// that the tree is built as the data arrives and the full response is never
+// held in memory - decryptable nodes are also written to the statecache
+// batch by batch (initsc() then only writes the rest)
+void MegaClient::procnodestream()
+{
+    const char* element;
+    size_t len;
+    string batch;
+    node_vector added;
+    bool more = true;
+
+    while (more && !nodestream.failed)
     {
-        chunkfailed = false;
+        bool started = nodestream.started;
+        unsigned count = 0;
 
-        for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+        batch.clear();
+
+        while ((more = nodestream.next(pendingcs->data(), pendingcs->size(), &element, &len)))
+        {
+            batch.append(batch.size() ? "," : "[");
+            batch.append(element, len);
+
+            if (++count == NODESTREAMBATCH)
+            {
+                break;
+            }
+        }
+
+        if (!nodestream.started)
+        {
+            return;
+        }
+
+        if (!started)
+        {
+            LOG_debug << "Processing the nodes of the fetchnodes response as they arrive";
+            purgenodesusersabortsc();
+
+            // the cache is rebuilt from scratch (and lacks an scsn until
+            // initsc(), so an interrupted fetch is never resumed from it)
+            if (sctable)
+            {
+                sctable->truncate();
+            }
+
+            // the tree can be browsed before the response is complete, so
+            // lazy decryption must already happen on access
+            if (lazydecrypt)
+            {
+                nodesdeferred = true;
+            }
+
+            nodestreampartial = false;
+
+            // a folder link is decrypted with a single key, so its file
+            // nodes are complete as written and can be evicted right away
+            nodestreampaging = pagednodes && sctable && loggedin() == NOTLOGGEDIN;
+            nodepaging = nodestreampaging;
+        }
+
+        if (batch.size())
+        {
+            JSON j;
+
+            batch.append("]");
+            j.begin(batch.c_str());
+
+            added.clear();
+
+            if (!readnodes(&j, 0, PUTNODES_APP, NULL, 0, 0, &added))
+            {
+                LOG_err << "Invalid node in the fetchnodes response";
+                nodestream.failed = true;
+            }
+            else
+            {
+                cachenodestream(&added);
+
+                if (nodestreampaging)
+                {
+                    trimnodes();
+                }
+            }
+        }
+
+        pendingcs->purge(nodestream.release());
+
+        // the response lists each tree top-down, so the upper levels are
+        // linked by now and grow with every batch
+        if (!nodestreampartial && !nodestream.finished && !nodestream.failed && nodestreamroots())
+        {
+            nodestreampartial = true;
+            app->fetchnodes_partial();
+        }
+    }
+
+    if (nodestream.finished)
+    {
+        // nodes that arrived before their parent (in an earlier batch)
+        Node* p;
+
+        for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+        {
+            if (!it->second->parent && (p = nodebyhandle(it->second->parenthandle)))
+            {
+                it->second->setparent(p);
+            }
+        }
+
+        // evicted nodes can be looked up by handle from now on
+        nodestreampaging = false;
+    }
+}
+
+// the root node of a folder link, or the root, inbox and rubbish bin of an
+// account
+bool MegaClient::nodestreamroots()
+{
+    for (int i = loggedin() == NOTLOGGEDIN ? 1 : sizeof rootnodes / sizeof *rootnodes; i--; )
+    {
+        if (!nodebyhandle(rootnodes[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// decrypt a batch of streamed nodes and write those that are complete: with
+// their attributes decrypted and their parent (if any) present - nodes that
+// receive shares or keys later in the response are rewritten by initsc()
+void MegaClient::cachenodestream(node_vector* added)
+{
+    if (!lazydecrypt)
+    {
+        applykeysparallel(added);
+    }
+
+    if (!sctable)
+    {
+        return;
+    }
+
+    bool complete = true;
+
+    sctable->begin();
+
+    for (node_vector::iterator it = added->begin(); complete && it != added->end(); it++)
+    {
+        Node* n = *it;
+
+        if (!n->attrstring && (n->parent || ISUNDEF(n->parenthandle)))
+        {
+            complete = sctable->putbatched(CACHEDNODE, n, &key);
+        }
+    }
+
+    complete = sctable->flushbatch() && complete;
+
+    if (complete)
+    {
+        sccommit();
+    }
+    else
+    {
+        sctable->abort();
+        finalizesc(false);
+    }
+}
+
+// parallel client-server channel: while pendingcs is in flight, the
+// independent commands queued behind it go out on a request of their own
+// (with its own idempotent ID sequence)
+void MegaClient::execfastcs()
+{
+    if (pendingfastcs)
+    {
+        switch (pendingfastcs->status)
+        {
+            case REQ_SUCCESS:
+                if (*pendingfastcs->in.c_str() == '[')
+                {
+                    ressent = fastcsstarted;
+                    resreceived = Metrics::now();
+                    fastreq.observe(&metrics, (resreceived - ressent) / 1000.0);
+                    json.begin(pendingfastcs->in.c_str());
+                    fastreq.procresult(this);
+                    ressent = resreceived = 0;
+
+                    delete pendingfastcs;
+                    pendingfastcs = NULL;
+
+                    incrementreqid(fastreqid, sizeof fastreqid);
+                    btfastcs.reset();
+                    break;
+                }
+
+                if (pendingfastcs->in != "-3" && pendingfastcs->in != "-4")
+                {
+                    error e = (error)atoi(pendingfastcs->in.c_str());
+                    app->request_error(e ? e : API_EINTERNAL);
+                }
+
+                // fall through
+            case REQ_FAILURE:
+                if (pendingfastcs->gzipped && (pendingfastcs->httpstatus == 400 || pendingfastcs->httpstatus == 415))
+                {
+                    LOG_warn << "Compressed API request rejected, no longer compressing requests";
+                    httpio->compressrequests = false;
+                }
+
+                // retry the same commands with the same ID
+                delete pendingfastcs;
+                pendingfastcs = NULL;
+                btfastcs.backoff();
+
+            default:
+                ;
+        }
+
+        if (pendingfastcs)
+        {
+            return;
+        }
+    }
+
+    if (!btfastcs.armed())
+    {
+        return;
+    }
+
+    if (!fastreq.cmdspending())
+    {
+        if (!pendingcs || !auth.size())
+        {
+            return;
+        }
+
+        reqs.extractindependent(&fastreq);
+
+        if (!fastreq.cmdspending())
+        {
+            return;
+        }
+
+        LOG_debug << "Sending " << fastreq.cmdspending() << " independent command(s) ahead of the pending request";
+    }
+
+    pendingfastcs = new HttpReq();
+
+    fastreq.get(pendingfastcs->out);
+
+    pendingfastcs->posturl = APIURL;
+
+    pendingfastcs->posturl.append("cs?id=");
+    pendingfastcs->posturl.append(fastreqid, sizeof fastreqid);
+    pendingfastcs->posturl.append(auth);
+    pendingfastcs->posturl.append(appkey);
+
+    pendingfastcs->type = REQ_JSON;
+
+    pendingfastcs->post(this);
+    fastcsstarted = Metrics::now();
+}
+
+void MegaClient::exec()
+{
+    TraceSpan span(&tracer, "exec");
+
+    WAIT_CLASS::bumpds();
+
+    if (gfx)
+    {
+        gfx->checkjobs();
+    }
+
+    if (threadpool)
+    {
+        threadpool->complete();
+    }
+
+    execsharekeys();
+
+    if (httpio->inetisback())
+    {
+        LOG_info << "Internet connectivity returned - resetting all backoff timers";
+        abortbackoff();
+    }
+
+    if (EVER(httpio->lastdata) && !pendingcs && Waiter::ds >= httpio->lastdata + HttpIO::NETWORKTIMEOUT)
+    {
+        disconnect();
+    }
+
+    // successful network operation with a failed transfer chunk: increment error count
+    // and continue transfers
+    if (httpio->success && chunkfailed)
+    {
+        chunkfailed = false;
+
+        for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
         {
             if ((*it)->failure)
             {
@@ -748,11 +1497,24 @@ void MegaClient::exec()
         }
     }
 
+    for (list<HttpReq*>::iterator it = warmupreqs.begin(); it != warmupreqs.end(); )
+    {
+        if ((*it)->status == REQ_SUCCESS || (*it)->status == REQ_FAILURE)
+        {
+            delete *it;
+            warmupreqs.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
     do {
-        // file attribute puts (handled sequentially as a FIFO)
-        if (curfa != newfa.end())
+        // file attribute puts (up to MAXACTIVEFA in flight)
+        for (putfa_list::iterator it = activefa.begin(); it != activefa.end(); )
         {
-            HttpReqCommandPutFA* fa = *curfa;
+            HttpReqCommandPutFA* fa = *it;
 
             switch (fa->status)
             {
@@ -767,16 +1529,16 @@ void MegaClient::exec()
 
                         Node* n;
                         handle h;
-                        handlepair_set::iterator it;
+                        handlepair_set::iterator uit;
 
                         // do we have a valid upload handle?
                         h = fa->th;
 
-                        it = uhnh.lower_bound(pair<handle, handle>(h, 0));
+                        uit = uhnh.lower_bound(pair<handle, handle>(h, 0));
 
-                        if (it != uhnh.end() && it->first == h)
+                        if (uit != uhnh.end() && uit->first == h)
                         {
-                            h = it->second;
+                            h = uit->second;
                         }
 
                         // are we updating a live node? issue command directly.
@@ -795,37 +1557,33 @@ void MegaClient::exec()
                         }
 
                         delete fa;
-                        newfa.erase(curfa);
-                        LOG_debug << "Remaining file attributes in upload queue: " << newfa.size();
+                        activefa.erase(it++);
+                        LOG_debug << "Remaining file attributes in upload queue: " << newfa.size() + activefa.size();
+                        btpfa.reset();
                     }
                     else
                     {
+                        // send it again
                         LOG_warn << "Wrong attribute response: " << fa->in.size();
+                        newfa.splice(newfa.begin(), activefa, it++);
                     }
-
-                    btpfa.reset();
-                    curfa = newfa.end();
                     break;
 
                 case REQ_FAILURE:
                     // repeat request with exponential backoff
                     LOG_warn << "Error setting file attribute";
-                    curfa = newfa.end();
+                    newfa.splice(newfa.begin(), activefa, it++);
                     btpfa.backoff();
+                    break;
 
                 default:
-                    ;
+                    it++;
             }
         }
 
-        if (newfa.size() && curfa == newfa.end() && btpfa.armed())
+        if (newfa.size() && activefa.size() < MAXACTIVEFA && btpfa.armed())
         {
-            // dispatch most recent file attribute put
-            curfa = newfa.begin();
-
-            LOG_debug << "Adding file attribute to the request queue";
-            (*curfa)->status = REQ_INFLIGHT;
-            reqs.add(*curfa);
+            sendfa();
         }
 
         if (fafcs.size())
@@ -840,50 +1598,58 @@ void MegaClient::exec()
             {
                 fc = cit->second;
 
-                // is this request currently in flight?
-                switch (fc->req.status)
+                for (int i = 0; i < FileAttributeFetchChannel::MAXREQS; i++)
                 {
-                    case REQ_SUCCESS:
-                        fc->parse(this, cit->first, true);
+                    HttpReq* req = fc->req + i;
 
-                        // notify app in case some attributes were not returned, then redispatch
-                        fc->failed(this);
-                        fc->bt.reset();
-                        break;
+                    // is this request currently in flight?
+                    switch (req->status)
+                    {
+                        case REQ_SUCCESS:
+                            fc->parse(this, i, true);
 
-                    case REQ_INFLIGHT:
-                        if (fc->inbytes != fc->req.in.size())
-                        {
-                            httpio->lock();
-                            fc->parse(this, cit->first, false);
-                            httpio->unlock();
+                            // notify app in case some attributes were not returned
+                            fc->failed(this, i);
+                            fc->bt.reset();
+                            req->status = REQ_READY;
+                            break;
 
-                            fc->timeout.backoff(100);
+                        case REQ_INFLIGHT:
+                            if (fc->inbytes[i] != req->in.size())
+                            {
+                                httpio->lock();
+                                fc->parse(this, i, false);
+                                httpio->unlock();
 
-                            fc->inbytes = fc->req.in.size();
-                        }
+                                fc->timeout[i].backoff(100);
 
-                        if (!fc->timeout.armed()) break;
+                                fc->inbytes[i] = req->in.size();
+                            }
 
-                        // timeout! fall through...
-                        fc->req.disconnect();
-                    case REQ_FAILURE:
-                        fc->failed(this);
-                        fc->bt.backoff();
-                        fc->urltime = 0;
-                    default:
-                        ;
+                            if (!fc->timeout[i].armed()) break;
+
+                            // timeout! fall through...
+                            req->disconnect();
+                        case REQ_FAILURE:
+                            fc->failed(this, i);
+                            fc->bt.backoff();
+                            fc->urltime = 0;
+                            req->status = REQ_READY;
+                        default:
+                            ;
+                    }
                 }
 
-                if (fc->req.status != REQ_INFLIGHT && fc->bt.armed() && (fc->fafs[1].size() || fc->fafs[0].size()))
+                // dispatch fresh fetches to idle slots, most recent first
+                // (background ones wait for a transmission window)
+                if (fc->fafs[0].size() && !fc->urlpending && fc->bt.armed()
+                 && (fc->urgent() || txwindow()))
                 {
-                    fc->req.in.clear();
-
                     if (Waiter::ds - fc->urltime > 600)
                     {
                         // fetches pending for this unconnected channel - dispatch fresh connection
                         reqs.add(new CommandGetFA(cit->first, fc->fahref, httpio->chunkedok));
-                        fc->req.status = REQ_INFLIGHT;
+                        fc->urlpending = true;
                     }
                     else
                     {
@@ -910,11 +1676,29 @@ void MegaClient::exec()
                         {
                             app->request_response_progress(pendingcs->bufpos, pendingcs->contentlength);
                         }
+
+                        if (!nodestream.finished)
+                        {
+                            procnodestream();
+                        }
                         break;
 
                     case REQ_SUCCESS:
                         app->request_response_progress(pendingcs->bufpos, -1);
 
+                        if (nodestream.started)
+                        {
+                            // read the remaining nodes and restore the rest
+                            // of the response (with an empty node array)
+                            if (!nodestream.finished)
+                            {
+                                procnodestream();
+                            }
+
+                            pendingcs->in.replace(0, pendingcs->inpurge, nodestream.head);
+                            pendingcs->inpurge = 0;
+                        }
+
                         if (pendingcs->in != "-3" && pendingcs->in != "-4")
                         {
                             if (*pendingcs->in.c_str() == '[')
@@ -926,24 +1710,20 @@ void MegaClient::exec()
                                 }
 
                                 // request succeeded, process result array
+                                ressent = csstarted;
+                                resreceived = Metrics::now();
+                                reqs.observe(&metrics, (resreceived - ressent) / 1000.0);
                                 json.begin(pendingcs->in.c_str());
                                 reqs.procresult(this);
+                                ressent = resreceived = 0;
+
+                                nodestream.reset(-1);
 
                                 delete pendingcs;
                                 pendingcs = NULL;
 
                                 // increment unique request ID
-                                for (int i = sizeof reqid; i--; )
-                                {
-                                    if (reqid[i]++ < 'z')
-                                    {
-                                        break;
-                                    }
-                                    else
-                                    {
-                                        reqid[i] = 'a';
-                                    }
-                                }
+                                incrementreqid(reqid, sizeof reqid);
                             }
                             else
                             {
@@ -977,6 +1757,12 @@ void MegaClient::exec()
                             break;
                         }
 
+                        if (pendingcs->gzipped && (pendingcs->httpstatus == 400 || pendingcs->httpstatus == 415))
+                        {
+                            LOG_warn << "Compressed API request rejected, no longer compressing requests";
+                            httpio->compressrequests = false;
+                        }
+
                         // failure, repeat with capped exponential backoff
                         app->request_response_progress(pendingcs->bufpos, -1);
 
@@ -1004,8 +1790,22 @@ void MegaClient::exec()
                     reqs.nextRequest();
                 }
 
-                if (reqs.cmdspending())
+                if (reqs.cmdspending() && Waiter::ds < csbatchuntil)
+                {
+                    // startup batch still open
+                }
+                else if (reqs.cmdspending() && reqs.deferrable() && !txwindow())
+                {
+                    // only non-urgent commands, held back
+                }
+                else if (reqs.cmdspending())
                 {
+                    if (csbatchuntil)
+                    {
+                        reqs.movestreamablelast();
+                        csbatchuntil = 0;
+                    }
+
                     pendingcs = new HttpReq();
 
                     reqs.get(pendingcs->out);
@@ -1019,7 +1819,11 @@ void MegaClient::exec()
 
                     pendingcs->type = REQ_JSON;
 
+                    nodestream.reset(httpio->streamingok ? reqs.streamindex() : -1);
+                    pendingcs->streaming = !nodestream.finished;
+
                     pendingcs->post(this);
+                    csstarted = Metrics::now();
 
                     reqs.nextRequest();
                     continue;
@@ -1027,11 +1831,18 @@ void MegaClient::exec()
                 else
                 {
                     btcs.reset();
+
+                    if (Waiter::ds >= csbatchuntil)
+                    {
+                        csbatchuntil = 0;
+                    }
                 }
             }
             break;
         }
 
+        execfastcs();
+
         // handle API server-client requests
         if (!jsonsc.pos && pendingsc)
         {
@@ -1056,6 +1867,11 @@ void MegaClient::exec()
                         {
                             jsonsc.begin(pendingsc->in.c_str());
                             jsonsc.enterobject();
+                            scarrived = Metrics::now();
+                            scpackets = 0;
+                            scwaitseen = false;
+
+                            prefetchsc();
                             break;
                         }
                         else
@@ -1092,6 +1908,9 @@ void MegaClient::exec()
 
                         btsc.backoff();
 
+                        // do not hold back what was caught up with so far
+                        catchingup = false;
+
                     default:
                         ;
                 }
@@ -1115,11 +1934,30 @@ void MegaClient::exec()
             // FIXME: reload in case of bad JSON
             if (procsc())
             {
+                metrics.observe(Metrics::ACTIONPACKET_LAG, "", (Metrics::now() - scarrived) / 1000.0);
+
                 // completed - initiate next SC request
                 delete pendingsc;
                 pendingsc = NULL;
 
                 btsc.reset();
+
+                // or carry on with the one already issued, unless the scsn
+                // has changed or the updates have been caught up with since
+                if (nextsc)
+                {
+                    if (nextscsn == scsn && !scnotifyurl.size())
+                    {
+                        pendingsc = nextsc;
+                        jsonsc.pos = NULL;
+                    }
+                    else
+                    {
+                        delete nextsc;
+                    }
+
+                    nextsc = NULL;
+                }
             }
 #ifdef ENABLE_SYNC
             else
@@ -1207,8 +2045,10 @@ void MegaClient::exec()
         }
 
         // fill transfer slots from the queue
+        TraceSpan dispatchspan(&tracer, "dispatch");
         dispatchmore(PUT);
         dispatchmore(GET);
+        dispatchspan.end();
 
         slotit = tslots.begin();
 
@@ -1225,7 +2065,23 @@ void MegaClient::exec()
             }
         }
 
+        // put the nodes of completed uploads once the batch is old enough or
+        // no more uploads are running
+        if (numuploadnodes)
+        {
+            transferslot_list::iterator it;
+
+            for (it = tslots.begin(); it != tslots.end() && (*it)->transfer->type != PUT; it++);
+
+            if (it == tslots.end() || Waiter::ds >= uploadnodesds + UPLOADBATCHDS)
+            {
+                senduploadnodes();
+            }
+        }
+
 #ifdef ENABLE_SYNC
+        TraceSpan syncspan(&tracer, "syncs");
+
         // verify filesystem fingerprints, disable deviating syncs
         // (this covers mountovers, some device removals and some failures)
         sync_list::iterator it;
@@ -1318,10 +2174,14 @@ void MegaClient::exec()
                                 if (sync->dirnotify->notifyq[q].size())
                                 {
                                     dstime dsretry;
+                                    clock_t start = clock();
 
                                     syncops = true;
 
-                                    if ((dsretry = sync->procscanq(q)))
+                                    dsretry = sync->procscanq(q);
+                                    sync->metrics.scantime += (uint64_t)(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+
+                                    if (dsretry)
                                     {
                                         // we resume processing after dsretry has elapsed
                                         // (to avoid open-after-creation races with e.g. MS Office)
@@ -1346,7 +2206,9 @@ void MegaClient::exec()
                                         LOG_debug << "Pending MEGA nodes: " << synccreate.size();
                                         if (!syncadding)
                                         {
+                                            clock_t start = clock();
                                             syncup(&sync->localroot, &nds);
+                                            sync->metrics.syncup.add(start);
                                             sync->cachenodes();
                                         }
 
@@ -1360,11 +2222,13 @@ void MegaClient::exec()
                                 if (sync->state == SYNC_INITIALSCAN && q == DirNotify::DIREVENTS && !sync->dirnotify->notifyq[q].size())
                                 {
                                     sync->changestate(SYNC_ACTIVE);
+                                    sync->metrics.fullscands = Waiter::ds - sync->metrics.fullscanstart;
 
                                     // scan for items that were deleted while the sync was stopped
                                     // FIXME: defer this until RETRY queue is processed
                                     sync->scanseqno++;
                                     sync->deletemissing(&sync->localroot);
+                                    sync->prunefingerprints();
                                 }
 
                                 if (!syncfslockretry && sync->dirnotify->notifyq[DirNotify::RETRY].size())
@@ -1461,7 +2325,11 @@ void MegaClient::exec()
 
                             if ((*it)->state == SYNC_ACTIVE && !syncscanstate)
                             {
-                                if (!syncdown(&(*it)->localroot, &localpath, true))
+                                clock_t start = clock();
+                                bool done = syncdown(&(*it)->localroot, &localpath, true);
+                                (*it)->metrics.syncdown.add(start);
+
+                                if (!done)
                                 {
                                     // a local filesystem item was locked - schedule periodic retry
                                     // and force a full rescan afterwards as the local item may
@@ -1536,8 +2404,7 @@ void MegaClient::exec()
                                         << syncadded << syncfslockretry << synccreate.size();
                             syncops = false;
 
-                            // FIXME: only syncup for subtrees that were actually
-                            // updated to reduce CPU load
+                            // (only subtrees flagged dirty are descended into)
                             for (it = syncs.begin(); it != syncs.end(); it++)
                             {
                                 if (((*it)->state == SYNC_ACTIVE || (*it)->state == SYNC_INITIALSCAN)
@@ -1545,7 +2412,9 @@ void MegaClient::exec()
                                  && !(*it)->dirnotify->notifyq[DirNotify::RETRY].size()
                                  && !syncadding)
                                 {
+                                    clock_t start = clock();
                                     syncup(&(*it)->localroot, &nds);
+                                    (*it)->metrics.syncup.add(start);
                                     (*it)->cachenodes();
                                 }
                             }
@@ -1586,8 +2455,12 @@ void MegaClient::exec()
                                     {
                                         if (sync->fullscan)
                                         {
+                                            LOG_debug << "Rescan complete. Files matched from listings: " << sync->scanlisted;
+                                            sync->metrics.fullscands = Waiter::ds - sync->metrics.fullscanstart;
+
                                             // recursively delete all LocalNodes that were deleted (not moved or renamed!)
                                             sync->deletemissing(&sync->localroot);
+                                            sync->prunefingerprints();
                                             sync->cachenodes();
                                         }
 
@@ -1602,13 +2475,17 @@ void MegaClient::exec()
                                                 LOG_warn << "Sync scan failed";
                                                 syncscanfailed = true;
 
+                                                // (set before scanning: scan() matches unchanged
+                                                // files from the listing right away)
+                                                sync->fullscan = true;
+                                                sync->scanseqno++;
+                                                sync->metrics.fullscans++;
+                                                sync->metrics.fullscanstart = Waiter::ds;
+
                                                 sync->scan(&sync->localroot.localname, NULL);
                                                 sync->dirnotify->error = false;
                                                 fsaccess->notifyerr = false;
 
-                                                sync->fullscan = true;
-                                                sync->scanseqno++;
-
                                                 syncscanbt.backoff(10 + totalnodes / 128);
                                             }
                                         }
@@ -1664,7 +2541,11 @@ void MegaClient::exec()
                         string localpath = (*it)->localroot.localname;
                         if ((*it)->state == SYNC_ACTIVE || (*it)->state == SYNC_INITIALSCAN)
                         {
-                            if (!syncdown(&(*it)->localroot, &localpath, true))
+                            clock_t start = clock();
+                            bool done = syncdown(&(*it)->localroot, &localpath, true);
+                            (*it)->metrics.syncdown.add(start);
+
+                            if (!done)
                             {
                                 // a local filesystem item was locked - schedule periodic retry
                                 // and force a full rescan afterwards as the local item may
@@ -1703,10 +2584,13 @@ void MegaClient::exec()
                 }
             }
         }
+
+        syncspan.end();
 #endif
 
         notifypurge();
-    } while (httpio->doio() || execdirectreads() || (!pendingcs && reqs.cmdspending() && btcs.armed()));
+    } while (doio() || execdirectreads() || (!pendingcs && reqs.cmdspending() && btcs.armed()
+                                             && !(deferredsince && reqs.deferrable())));
 
     if (!badhostcs && badhosts.size())
     {
@@ -1749,22 +2633,36 @@ int MegaClient::wait()
             nds = Waiter::ds;
         }
 
-        nexttransferretry(PUT, &nds);
-        nexttransferretry(GET, &nds);
-
-        // retry transferslots
-        for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+        // transfers and transferslots with a retry due
+        if (transfertimers.expire())
         {
-            if (!(*it)->retrybt.armed())
-            {
-                (*it)->retrybt.update(&nds);
-            }
+            nds = Waiter::ds;
+        }
+        else if (transfertimers.nextds() < nds)
+        {
+            nds = transfertimers.nextds();
         }
 
         // retry failed client-server requests
         if (!pendingcs)
         {
             btcs.update(&nds);
+
+            if (csbatchuntil > Waiter::ds && csbatchuntil < nds && reqs.cmdspending())
+            {
+                nds = csbatchuntil;
+            }
+        }
+
+        // held back non-urgent requests
+        if (deferredsince && deferredsince + deferlimit < nds)
+        {
+            nds = deferredsince + deferlimit;
+        }
+
+        if (!pendingfastcs && fastreq.cmdspending())
+        {
+            btfastcs.update(&nds);
         }
 
         // retry failed server-client requests
@@ -1773,8 +2671,14 @@ int MegaClient::wait()
             btsc.update(&nds);
         }
 
+        // a pipelined server-client request that completed in the meantime
+        if (pendingsc && !jsonsc.pos && (pendingsc->status == REQ_SUCCESS || pendingsc->status == REQ_FAILURE))
+        {
+            nds = Waiter::ds;
+        }
+
         // retry failed file attribute puts
-        if (curfa == newfa.end())
+        if (newfa.size() && activefa.size() < MAXACTIVEFA)
         {
             btpfa.update(&nds);
         }
@@ -1782,13 +2686,19 @@ int MegaClient::wait()
         // retry failed file attribute gets
         for (fafc_map::iterator cit = fafcs.begin(); cit != fafcs.end(); cit++)
         {
-            if (cit->second->req.status == REQ_INFLIGHT)
+            FileAttributeFetchChannel* fc = cit->second;
+
+            for (int i = FileAttributeFetchChannel::MAXREQS; i--; )
             {
-                cit->second->timeout.update(&nds);
+                if (fc->req[i].status == REQ_INFLIGHT)
+                {
+                    fc->timeout[i].update(&nds);
+                }
             }
-            else if (cit->second->fafs[1].size() || cit->second->fafs[0].size())
+
+            if (fc->fafs[0].size() && !fc->urlpending && (!deferredsince || fc->urgent()))
             {
-                cit->second->bt.update(&nds);
+                fc->bt.update(&nds);
             }
         }
 
@@ -1833,6 +2743,21 @@ int MegaClient::wait()
         {
             syncnaglebt.update(&nds);
         }
+
+        // coalesced LocalNode cache writes (flushed by exec() while syncs
+        // are being processed)
+        if (!syncdownretry && !syncadding && statecurrent && !syncdownrequired && !syncfsopsfailed)
+        {
+            for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
+            {
+                dstime flushds = (*it)->nextcacheflush();
+
+                if (flushds < nds)
+                {
+                    nds = flushds > Waiter::ds ? flushds : Waiter::ds;
+                }
+            }
+        }
 #endif
 
         // detect stuck network
@@ -1845,6 +2770,18 @@ int MegaClient::wait()
                 nds = timeout;
             }
         }
+
+        // batched upload nodes due
+        if (numuploadnodes && uploadnodesds + UPLOADBATCHDS < nds)
+        {
+            nds = uploadnodesds + UPLOADBATCHDS;
+        }
+
+        // application-scheduled wakeup
+        if (appwakeup < nds)
+        {
+            nds = appwakeup > Waiter::ds ? appwakeup : Waiter::ds;
+        }
     }
 
     // immediate action required?
@@ -1903,19 +2840,24 @@ bool MegaClient::abortbackoff(bool includexfers)
         r = true;
     }
 
+    if (btfastcs.arm())
+    {
+        r = true;
+    }
+
     if (!pendingsc && btsc.arm())
     {
         r = true;
     }
 
-    if (curfa == newfa.end() && btpfa.arm())
+    if (newfa.size() && activefa.size() < MAXACTIVEFA && btpfa.arm())
     {
         r = true;
     }
 
     for (fafc_map::iterator it = fafcs.begin(); it != fafcs.end(); it++)
     {
-        if (it->second->req.status != REQ_INFLIGHT && it->second->bt.arm())
+        if (it->second->fafs[0].size() && !it->second->urlpending && it->second->bt.arm())
         {
             r = true;
         }
@@ -1930,43 +2872,46 @@ bool MegaClient::abortbackoff(bool includexfers)
 bool MegaClient::dispatch(direction_t d)
 {
     // do we have any transfer slots available?
-    if (!slotavail())
+    if (!slotavail(d))
     {
         LOG_verbose << "No slots available";
         return false;
     }
 
     // file attribute jam? halt uploads.
-    if (d == PUT && newfa.size() > 32)
+    if (d == PUT && newfa.size() + activefa.size() > 32)
     {
-        LOG_warn << "Attribute queue full: " << newfa.size();
+        LOG_warn << "Attribute queue full: " << newfa.size() + activefa.size();
         return false;
     }
 
-    transfer_map::iterator nextit;
+    Transfer* nextt;
     TransferSlot *ts = NULL;
 
     for (;;)
     {
-        nextit = transfers[d].end();
+        nextt = NULL;
 
-        for (transfer_map::iterator it = transfers[d].begin(); it != transfers[d].end(); it++)
+        // first inactive transfer ready for (re)start, in priority order
+        for (int p = 0; !nextt && p < NUMPRIORITIES; p++)
         {
-            if (!it->second->slot && it->second->bt.armed()
-             && (nextit == transfers[d].end()
-              || it->second->bt.retryin() < nextit->second->bt.retryin()))
+            for (transfer_list::iterator it = transferqueue[d][p].begin(); it != transferqueue[d][p].end(); it++)
             {
-                nextit = it;
+                if (!(*it)->slot && (*it)->bt.armed())
+                {
+                    nextt = *it;
+                    break;
+                }
             }
         }
 
         // no inactive transfers ready?
-        if (nextit == transfers[d].end())
+        if (!nextt)
         {
             return false;
         }
 
-        if (!nextit->second->localfilename.size())
+        if (!nextt->localfilename.size())
         {
             // this is a fresh transfer rather than the resumption of a partly
             // completed and deferred one
@@ -1975,8 +2920,8 @@ bool MegaClient::dispatch(direction_t d)
                 // generate fresh random encryption key/CTR IV for this file
                 byte keyctriv[SymmCipher::KEYLENGTH + sizeof(int64_t)];
                 PrnGen::genblock(keyctriv, sizeof keyctriv);
-                nextit->second->key.setkey(keyctriv);
-                nextit->second->ctriv = MemAccess::get<uint64_t>((const char*)keyctriv + SymmCipher::KEYLENGTH);
+                nextt->key.setkey(keyctriv);
+                nextt->ctriv = MemAccess::get<uint64_t>((const char*)keyctriv + SymmCipher::KEYLENGTH);
             }
             else
             {
@@ -1985,7 +2930,7 @@ bool MegaClient::dispatch(direction_t d)
                 const byte* k = NULL;
 
                 // locate suitable template file
-                for (file_list::iterator it = nextit->second->files.begin(); it != nextit->second->files.end(); it++)
+                for (file_list::iterator it = nextt->files.begin(); it != nextt->files.end(); it++)
                 {
                     if ((*it)->hprivate)
                     {
@@ -1994,20 +2939,20 @@ bool MegaClient::dispatch(direction_t d)
                         if ((n = nodebyhandle((*it)->h)) && n->type == FILENODE)
                         {
                             k = (const byte*)n->nodekey.data();
-                            nextit->second->size = n->size;
+                            nextt->size = n->size;
                         }
                     }
                     else
                     {
                         k = (*it)->filekey;
-                        nextit->second->size = (*it)->size;
+                        nextt->size = (*it)->size;
                     }
 
                     if (k)
                     {
-                        nextit->second->key.setkey(k, FILENODE);
-                        nextit->second->ctriv = MemAccess::get<int64_t>((const char*)k + SymmCipher::KEYLENGTH);
-                        nextit->second->metamac = MemAccess::get<int64_t>((const char*)k + SymmCipher::KEYLENGTH + sizeof(int64_t));
+                        nextt->key.setkey(k, FILENODE);
+                        nextt->ctriv = MemAccess::get<int64_t>((const char*)k + SymmCipher::KEYLENGTH);
+                        nextt->metamac = MemAccess::get<int64_t>((const char*)k + SymmCipher::KEYLENGTH + sizeof(int64_t));
 
                         // FIXME: re-add support for partial transfers
                         break;
@@ -2020,74 +2965,103 @@ bool MegaClient::dispatch(direction_t d)
                 }
             }
 
-            nextit->second->localfilename.clear();
+            // partial downloads restored from the transfer cache continue in
+            // their previous temp file
+            nextt->localfilename = nextt->cachedlocalfilename;
+            nextt->cachedlocalfilename.clear();
 
             // set file localnames (ultimate target) and one transfer-wide temp
-            // localname
-            for (file_list::iterator it = nextit->second->files.begin();
-                 !nextit->second->localfilename.size() && it != nextit->second->files.end(); it++)
+            // localname (none for a sink)
+            for (file_list::iterator it = nextt->files.begin();
+                 !nextt->sink && !nextt->localfilename.size() && it != nextt->files.end(); it++)
             {
                 (*it)->prepare();
             }
 
             // app-side transfer preparations (populate localname, create thumbnail...)
-            app->transfer_prepare(nextit->second);
+            app->transfer_prepare(nextt);
         }
 
-        // verify that a local path was given and start/resume transfer
-        if (nextit->second->localfilename.size())
+        // verify that a local path (or a sink) was given and start/resume
+        // transfer
+        if (nextt->localfilename.size() || nextt->sink)
         {
             // allocate transfer slot
-            ts = new TransferSlot(nextit->second);
+            ts = new TransferSlot(nextt);
+
+            // partial downloads continue in their existing temp file
+            if (d == GET && !nextt->sink && nextt->chunkmacs.size() && !ts->fa->fopen(&nextt->localfilename, true, true))
+            {
+                LOG_warn << "Partial download lost, restarting";
+                nextt->clearmacs();
+            }
 
             // try to open file (PUT transfers: open in nonblocking mode)
             if ((d == PUT)
-              ? ts->fa->fopen(&nextit->second->localfilename)
-              : ts->fa->fopen(&nextit->second->localfilename, false, true))
+              ? ts->fa->fopen(&nextt->localfilename)
+              : (nextt->sink || nextt->chunkmacs.size() || ts->fa->fopen(&nextt->localfilename, false, true)))
             {
                 handle h = UNDEF;
                 bool hprivate = true;
                 const char *auth = NULL;
 
-                nextit->second->pos = 0;
+                nextt->pos = 0;
 
                 // always (re)start upload from scratch
                 if (d == PUT)
                 {
-                    nextit->second->size = ts->fa->size;
-                    nextit->second->chunkmacs.clear();
+                    nextt->size = ts->fa->size;
+                    nextt->clearmacs();
 
                     // create thumbnail/preview imagery, if applicable (FIXME: do not re-create upon restart)
-                    if (gfx && nextit->second->localfilename.size() && !nextit->second->uploadhandle)
+                    if (gfx && nextt->localfilename.size() && !nextt->uploadhandle)
                     {
-                        nextit->second->uploadhandle = getuploadhandle();
+                        nextt->uploadhandle = getuploadhandle();
 
-                        if (gfx->isgfx(&nextit->second->localfilename))
+                        if (gfx->isgfx(&nextt->localfilename))
                         {
                             // we want all imagery to be safely tucked away before completing the upload, so we bump minfa
-                            nextit->second->minfa += gfx->gendimensionsputfa(ts->fa, &nextit->second->localfilename, nextit->second->uploadhandle, &nextit->second->key);
+                            nextt->minfa += gfx->gendimensionsputfa(ts->fa, &nextt->localfilename, nextt->uploadhandle, &nextt->key);
                         }
                     }
                 }
                 else
                 {
                     // downloads resume at the end of the last contiguous completed block
-                    for (chunkmac_map::iterator it = nextit->second->chunkmacs.begin();
-                         it != nextit->second->chunkmacs.end(); it++)
+                    for (chunkmac_map::iterator it = nextt->chunkmacs.begin();
+                         it != nextt->chunkmacs.end(); it++)
                     {
-                        if (nextit->second->pos != it->first)
+                        if (nextt->pos != it->first)
                         {
                             break;
                         }
 
-                        if (nextit->second->size)
+                        if (nextt->size)
                         {
-                            nextit->second->pos = ChunkedHash::chunkceil(nextit->second->pos);
+                            nextt->pos = ChunkedHash::chunkceil(nextt->pos);
                         }
                     }
 
-                    for (file_list::iterator it = nextit->second->files.begin();
-                         it != nextit->second->files.end(); it++)
+                    // (a sink has received the data up to pos after a retry)
+                    if ((!nextt->sink && nextt->pos > ts->fa->size) || (nextt->size && nextt->pos >= nextt->size))
+                    {
+                        LOG_warn << "Partial download truncated, restarting";
+                        nextt->pos = 0;
+                        nextt->clearmacs();
+                    }
+
+                    // data already in the temp file counts as completed
+                    ts->progresscompleted = ts->progressreported = nextt->pos;
+                    ts->progresscached = nextt->pos;
+                    ts->writepos = nextt->pos;
+
+                    if (writebackmax && !nextt->sink && !nextt->pos && nextt->size)
+                    {
+                        ts->fa->preallocate(nextt->size);
+                    }
+
+                    for (file_list::iterator it = nextt->files.begin();
+                         it != nextt->files.end(); it++)
                     {
                         if (!(*it)->hprivate || nodebyhandle((*it)->h))
                         {
@@ -2099,16 +3073,40 @@ bool MegaClient::dispatch(direction_t d)
                     }
                 }
 
-                // dispatch request for temporary source/target URL
-                reqs.add((ts->pendingcmd = (d == PUT)
-                          ? (Command*)new CommandPutFile(ts, putmbpscap)
-                          : (Command*)new CommandGetFile(ts, NULL, h, hprivate, auth)));
+                // dispatch request for temporary source/target URL, unless
+                // a recent one is cached
+                if (d == PUT)
+                {
+                    reqs.add((ts->pendingcmd = new CommandPutFile(ts, putmbpscap)));
+                }
+                else
+                {
+                    const string* url = NULL;
+                    m_off_t size;
+
+                    if (h != UNDEF)
+                    {
+                        ts->tempurlh = h;
+                        encodehandletype(&ts->tempurlh, hprivate || auth);
+                        url = tempurls.get(ts->tempurlh, &size);
+                    }
+
+                    if (url && size == nextt->size)
+                    {
+                        ts->tempurl = *url;
+                        ts->starttime = ts->lastdata = waiter->ds;
+                    }
+                    else
+                    {
+                        reqs.add((ts->pendingcmd = new CommandGetFile(ts, NULL, h, hprivate, auth)));
+                    }
+                }
 
                 ts->slots_it = tslots.insert(tslots.begin(), ts);
 
                 // notify the app about the starting transfer
-                for (file_list::iterator it = nextit->second->files.begin();
-                     it != nextit->second->files.end(); it++)
+                for (file_list::iterator it = nextt->files.begin();
+                     it != nextt->files.end(); it++)
                 {
                     (*it)->start();
                 }
@@ -2120,7 +3118,7 @@ bool MegaClient::dispatch(direction_t d)
         LOG_warn << "Error dispatching transfer";
 
         // file didn't open - fail & defer
-        nextit->second->failed(API_EREAD);
+        nextt->failed(API_EREAD);
     }
 }
 
@@ -2137,6 +3135,28 @@ handle MegaClient::getuploadhandle()
 }
 
 // do we have an upload that is still waiting for file attributes before being completed?
+void MegaClient::dropfa(handle th, int count)
+{
+    handletransfer_map::iterator htit = faputcompletion.find(th);
+
+    if (htit != faputcompletion.end())
+    {
+        // the upload is waiting for them
+        htit->second->minfa -= count;
+        checkfacompletion(th);
+        return;
+    }
+
+    for (transfer_map::iterator it = transfers[PUT].begin(); it != transfers[PUT].end(); it++)
+    {
+        if (it->second->uploadhandle == th)
+        {
+            it->second->minfa -= count;
+            return;
+        }
+    }
+}
+
 void MegaClient::checkfacompletion(handle th, Transfer* t)
 {
     if (th)
@@ -2175,6 +3195,7 @@ void MegaClient::checkfacompletion(handle th, Transfer* t)
 
                 transfers[t->type].erase(t->transfers_it);
                 t->transfers_it = transfers[t->type].end();
+                unqueuetransfer(t);
 
                 delete t->slot;
                 t->slot = NULL;
@@ -2205,20 +3226,36 @@ void MegaClient::freeq(direction_t d)
     }
 }
 
-// determine next scheduled transfer retry
-// FIXME: make this an ordered set and only check the first element instead of
-// scanning the full map!
-void MegaClient::nexttransferretry(direction_t d, dstime* dsmin)
+void MegaClient::queuetransfer(Transfer* t, transferpriority_t p, bool front)
+{
+    unqueuetransfer(t);
+
+    t->priority = p;
+    t->queue_it = transferqueue[t->type][p].insert(front ? transferqueue[t->type][p].begin()
+                                                         : transferqueue[t->type][p].end(), t);
+    t->queued = true;
+}
+
+void MegaClient::movetransferbefore(Transfer* t, Transfer* next)
 {
-    for (transfer_map::iterator it = transfers[d].begin(); it != transfers[d].end(); it++)
+    if (t == next || t->type != next->type || !next->queued)
     {
-        if ((!it->second->slot || !it->second->slot->fa)
-         && it->second->bt.nextset()
-         && it->second->bt.nextset() >= Waiter::ds
-         && it->second->bt.nextset() < *dsmin)
-        {
-            *dsmin = it->second->bt.nextset();
-        }
+        return;
+    }
+
+    unqueuetransfer(t);
+
+    t->priority = next->priority;
+    t->queue_it = transferqueue[t->type][t->priority].insert(next->queue_it, t);
+    t->queued = true;
+}
+
+void MegaClient::unqueuetransfer(Transfer* t)
+{
+    if (t->queued)
+    {
+        transferqueue[t->type][t->priority].erase(t->queue_it);
+        t->queued = false;
     }
 }
 
@@ -2231,24 +3268,37 @@ void MegaClient::disconnect()
         pendingcs->disconnect();
     }
 
+    if (pendingfastcs)
+    {
+        pendingfastcs->disconnect();
+    }
+
     if (pendingsc)
     {
         pendingsc->disconnect();
     }
 
+    if (nextsc)
+    {
+        nextsc->disconnect();
+    }
+
     for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
     {
         (*it)->disconnect();
     }
 
-    for (putfa_list::iterator it = newfa.begin(); it != newfa.end(); it++)
+    for (putfa_list::iterator it = activefa.begin(); it != activefa.end(); it++)
     {
         (*it)->disconnect();
     }
 
     for (fafc_map::iterator it = fafcs.begin(); it != fafcs.end(); it++)
     {
-        it->second->req.disconnect();
+        for (int i = FileAttributeFetchChannel::MAXREQS; i--; )
+        {
+            it->second->req[i].disconnect();
+        }
     }
 
     httpio->lastdata = NEVER;
@@ -2264,6 +3314,8 @@ void MegaClient::logout()
             sctable->remove();
         }
 
+        purgetransfercache();
+
 #ifdef ENABLE_SYNC
         for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
         {
@@ -2299,20 +3351,70 @@ void MegaClient::locallogout()
     freeq(GET);
     freeq(PUT);
 
+    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    {
+        for (transfer_map::iterator it = cachedtransfers[d].begin(); it != cachedtransfers[d].end(); )
+        {
+            delete it++->second;
+        }
+
+        cachedtransfers[d].clear();
+    }
+
+    queuedtransfers.clear();
+
+    delete tctable;
+    tctable = NULL;
+
     purgenodesusersabortsc();
 
     reqs.clear();
 
+    // their remaining slices were dropped with the requests
+    for (set<PutNodesTree*>::iterator it = putnodestrees.begin(); it != putnodestrees.end(); it++)
+    {
+        delete[] (*it)->nn;
+        delete *it;
+    }
+
+    putnodestrees.clear();
+
     delete pendingcs;
     pendingcs = NULL;
 
+    nodestream.reset(-1);
+
+    fastreq.clear();
+
+    delete pendingfastcs;
+    pendingfastcs = NULL;
+
+    csbatchuntil = 0;
+    deferredsince = 0;
+
+    sharekeyuploads.clear();
+    sharekeyinflight = false;
+
+    for (list<HttpReq*>::iterator it = warmupreqs.begin(); it != warmupreqs.end(); it++)
+    {
+        delete *it;
+    }
+
+    warmupreqs.clear();
+
     for (putfa_list::iterator it = newfa.begin(); it != newfa.end(); it++)
     {
         delete *it;
     }
 
     newfa.clear();
-    curfa = newfa.end();
+
+    for (putfa_list::iterator it = activefa.begin(); it != activefa.end(); it++)
+    {
+        delete *it;
+    }
+
+    activefa.clear();
     xferpaused[PUT] = false;
     xferpaused[GET] = false;
     putmbpscap = 0;
@@ -2335,6 +3437,26 @@ void MegaClient::locallogout()
 
     pendingfa.clear();
 
+    for (map<handle, vector<pair<NewNode*, int> > >::iterator it = uploadnodes.begin(); it != uploadnodes.end(); it++)
+    {
+        for (unsigned i = 0; i < it->second.size(); i++)
+        {
+            delete[] it->second[i].first;
+        }
+    }
+
+    uploadnodes.clear();
+    numuploadnodes = 0;
+
+    // no transfers left: free the idle chunk buffers
+    chunkbuffers.clear();
+
+    // decrypted data must not survive the session
+    drcache.clear();
+    tempurls.clear();
+    rsakeys.clear();
+    clearnodeciphers();
+
     // erase master key & session ID
     key.setkey(SymmCipher::zeroiv);
     memset((char*)auth.c_str(), 0, auth.size());
@@ -2360,9 +3482,82 @@ const char *MegaClient::version()
             "." TOSTRING(MEGA_MICRO_VERSION);
 }
 
+// at the end of an sc response: enter, stay in or leave catch-up mode -
+// returns true while the purge of the accumulated notifications (and the
+// statecache commit) is to be deferred to a later response
+bool MegaClient::catchup()
+{
+    bool backlog = !scwaitseen && !fetchingnodes && (catchingup || scpackets >= CATCHUPPACKETS);
+
+#ifdef ENABLE_SYNC
+    // syncs rely on a purge after every response
+    if (syncs.size())
+    {
+        backlog = false;
+    }
+#endif
+
+    if (backlog != catchingup)
+    {
+        if (backlog)
+        {
+            LOG_debug << "Catching up with queued server-client updates";
+        }
+        else
+        {
+            LOG_debug << "Caught up - applying " << nodenotify.size() << " node updates";
+        }
+
+        catchingup = backlog;
+    }
+
+    return catchingup;
+}
+
+// a response that has not caught up with the server (no "w" element after
+// the action packets) ends with the scsn for the next request, which can
+// then be issued right away - its response is only processed after this one
+void MegaClient::prefetchsc()
+{
+    static const char snelement[] = "\"sn\":\"";
+    const string& in = pendingsc->in;
+
+    if (nextsc || scnotifyurl.size())
+    {
+        return;
+    }
+
+    size_t sn = in.rfind(snelement);
+    size_t a = in.rfind(']');
+
+    if (sn == string::npos || a == string::npos || a > sn || in.find("\"w\":\"", a) != string::npos)
+    {
+        return;
+    }
+
+    size_t start = sn + sizeof snelement - 1;
+    size_t end = in.find('"', start);
+
+    if (end == string::npos || end - start >= sizeof scsn)
+    {
+        return;
+    }
+
+    nextscsn.assign(in, start, end - start);
+
+    nextsc = new HttpReq();
+    nextsc->posturl = APIURL;
+    nextsc->posturl.append("sc?sn=");
+    nextsc->posturl.append(nextscsn);
+    nextsc->posturl.append(auth);
+    nextsc->type = REQ_JSON;
+    nextsc->post(this);
+}
+
 // process server-client request
 bool MegaClient::procsc()
 {
+    TraceSpan span(&tracer, "procsc");
     nameid name;
 
 #ifdef ENABLE_SYNC
@@ -2386,8 +3581,9 @@ bool MegaClient::procsc()
                             notifypurge();
                             if (sctable)
                             {
-                                sctable->commit();
+                                sccommit();
                                 sctable->begin();
+                                sccommitted = !nodenotify.size();
                             }
 
                             fetchingnodes = false;
@@ -2410,17 +3606,25 @@ bool MegaClient::procsc()
                         LOG_debug << "Local filesystem up to date";
                     }
                 
+                    scwaitseen = true;
                     jsonsc.storeobject(&scnotifyurl);
                     break;
 
                 case MAKENAMEID2('s', 'n'):
                     // the sn element is guaranteed to be the last in sequence
                     setscsn(&jsonsc);
+
+                    if (catchup())
+                    {
+                        break;
+                    }
+
                     notifypurge();
                     if (sctable)
                     {
-                        sctable->commit();
+                        sccommit();
                         sctable->begin();
+                        sccommitted = !nodenotify.size();
                     }
                     break;
                     
@@ -2449,6 +3653,8 @@ bool MegaClient::procsc()
         {
             if (jsonsc.enterobject())
             {
+                scpackets++;
+
                 // the "a" attribute is guaranteed to be the first in the object
                 if (jsonsc.getnameid() == 'a')
                 {
@@ -2571,6 +3777,7 @@ bool MegaClient::procsc()
                             case MAKENAMEID4('p', 's', 't', 's'):
                                 if (sc_upgrade())
                                 {
+                                    invalidateaccountdetails();
                                     app->account_updated();
                                 }
                                 break;
@@ -2627,14 +3834,23 @@ bool MegaClient::procsc()
 // subsequent server-client commands.)
 // initsc() is called after all initial decryption has been performed, so we
 // are tolerant towards incomplete/faulty nodes.
+// if the nodes were streamed, those already written by cachenodestream() are
+// skipped unless they have since received shares, keys or links
 void MegaClient::initsc()
 {
+    AllocScope allocscope(AllocTags::CACHE);
+
     if (sctable)
     {
         bool complete;
+        bool streamed = nodestream.started;
 
         sctable->begin();
-        sctable->truncate();
+
+        if (!streamed)
+        {
+            sctable->truncate();
+        }
 
         // 1. write current scsn
         handle tscsn;
@@ -2643,14 +3859,19 @@ void MegaClient::initsc()
 
         if (complete)
         {
+            // session state for offline startup
+            cachesession();
+
             // 2. write all users
             for (user_map::iterator it = users.begin(); it != users.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDUSER, &it->second, &key)))
+                if (!(complete = sctable->putbatched(CACHEDUSER, &*it, &key)))
                 {
                     break;
                 }
             }
+
+            complete = sctable->flushbatch() && complete;
         }
 
         if (complete)
@@ -2658,11 +3879,18 @@ void MegaClient::initsc()
             // 3. write new or modified nodes, purge deleted nodes
             for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDNODE, it->second, &key)))
+                if (streamed && it->second->dbid && !it->second->sharing)
+                {
+                    continue;
+                }
+
+                if (!(complete = sctable->putbatched(CACHEDNODE, it->second, &key)))
                 {
                     break;
                 }
             }
+
+            complete = sctable->flushbatch() && complete;
         }
 
         if (complete)
@@ -2670,33 +3898,35 @@ void MegaClient::initsc()
             // 4. write new or modified pcrs, purge deleted pcrs
             for (handlepcr_map::iterator it = pcrindex.begin(); it != pcrindex.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDPCR, it->second, &key)))
+                if (!(complete = sctable->putbatched(CACHEDPCR, it->second, &key)))
                 {
                     break;
                 }
             }
+
+            complete = sctable->flushbatch() && complete;
         }
 
         LOG_debug << "Saving SCSN " << scsn << " with " << nodes.size() << " nodes and " << users.size() << " users to local cache (" << complete << ")";
         finalizesc(complete);
+
+        // all nodes are cached now, evictions start with the next
+        // notifypurge()
+        nodepaging = pagednodes && complete;
     }
 }
 
 // erase and and fill user's local state cache
 void MegaClient::updatesc()
 {
+    AllocScope allocscope(AllocTags::CACHE);
+
+    // cachedscsn tracks the stored scsn, so a write-behind table needs
+    // not be read back here
     if (sctable)
     {
-        string t;
-
-        sctable->get(CACHEDSCSN, &t);
-
-        if (t.size() != sizeof cachedscsn)
+        if (ISUNDEF(cachedscsn))
         {
-            if (t.size())
-            {
-                LOG_err << "Invalid scsn size";
-            }
             return;
         }
 
@@ -2712,16 +3942,29 @@ void MegaClient::updatesc()
             // 2. write new or update modified users
             for (user_vector::iterator it = usernotify.begin(); it != usernotify.end(); it++)
             {
-                if (!(complete = sctable->put(CACHEDUSER, *it, &key)))
+                if (!(complete = sctable->putbatched(CACHEDUSER, *it, &key)))
                 {
                     break;
                 }
             }
+
+            complete = sctable->flushbatch() && complete;
         }
 
         if (complete)
         {
-            // 3. write new or modified nodes, purge deleted nodes
+            // 3. write new or modified nodes, purge deleted nodes (in batches,
+            // along with the descendants of removed subtrees)
+            vector<uint32_t> deleted;
+
+            for (node_vector::iterator it = nodepurge.begin(); it != nodepurge.end(); it++)
+            {
+                if ((*it)->dbid)
+                {
+                    deleted.push_back((*it)->dbid);
+                }
+            }
+
             for (node_vector::iterator it = nodenotify.begin(); it != nodenotify.end(); it++)
             {
                 char base64[12];
@@ -2730,21 +3973,25 @@ void MegaClient::updatesc()
                     if ((*it)->dbid)
                     {
                         LOG_verbose << "Removing node from database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
-                        if (!(complete = sctable->del((*it)->dbid)))
-                        {
-                            break;
-                        }
+                        deleted.push_back((*it)->dbid);
                     }
                 }
                 else
                 {
                     LOG_verbose << "Adding node to database: " << (Base64::btoa((byte*)&((*it)->nodehandle),MegaClient::NODEHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->put(CACHEDNODE, *it, &key)))
+                    if (!(complete = sctable->putbatched(CACHEDNODE, *it, &key)))
                     {
                         break;
                     }
                 }
             }
+
+            complete = sctable->flushbatch() && complete;
+
+            if (complete && deleted.size())
+            {
+                complete = sctable->delbatch(deleted.size(), &deleted[0]);
+            }
         }
 
         if (complete)
@@ -2767,12 +4014,14 @@ void MegaClient::updatesc()
                 else if (!(*it)->removed())
                 {
                     LOG_verbose << "Adding pcr to database: " << (Base64::btoa((byte*)&((*it)->id),MegaClient::PCRHANDLE,base64) ? base64 : "");
-                    if (!(complete = sctable->put(CACHEDPCR, *it, &key)))
+                    if (!(complete = sctable->putbatched(CACHEDPCR, *it, &key)))
                     {
                         break;
                     }
                 }
             }
+
+            complete = sctable->flushbatch() && complete;
         }
 
         LOG_debug << "Saving SCSN " << scsn << " with " << nodenotify.size() << " modified nodes and " << usernotify.size() << " users to local cache (" << complete << ")";
@@ -2795,11 +4044,18 @@ void MegaClient::finalizesc(bool complete)
 
         delete sctable;
         sctable = NULL;
+
+        if (nodepaging)
+        {
+            // evicted nodes are gone with the cache
+            nodepaging = false;
+            app->reload("Local node cache lost");
+        }
     }
 }
 
 // queue node file attribute for retrieval or cancel retrieval
-error MegaClient::getfa(Node* n, fatype t, int cancel)
+error MegaClient::getfa(Node* n, fatype t, int cancel, bool background)
 {
     // locate this file attribute type in the nodes's attribute string
     handle fah;
@@ -2829,31 +4085,30 @@ error MegaClient::getfa(Node* n, fatype t, int cancel)
 
     int c = atoi(n->fileattrstring.c_str() + pp);
 
+    if (!cancel && facache)
+    {
+        string data;
+        SymmCipher* cipher;
+
+        if (facache->get(fah, &data) && !(data.size() & (SymmCipher::BLOCKSIZE - 1))
+         && (cipher = n->nodecipher()))
+        {
+            LOG_debug << "File attribute served from the local cache";
+            cipher->cbc_decrypt((byte*)data.data(), data.size());
+            restag = reqtag;
+            app->fa_complete(n, t, data.data(), data.size());
+            return API_OK;
+        }
+    }
+
     if (cancel)
     {
         // cancel pending request
         fafc_map::iterator cit;
 
-        if ((cit = fafcs.find(c)) != fafcs.end())
+        if ((cit = fafcs.find(c)) != fafcs.end() && cit->second->cancel(fah))
         {
-            faf_map::iterator it;
-
-            for (int i = 2; i--; )
-            {
-                if ((it = cit->second->fafs[i].find(fah)) != cit->second->fafs[i].end())
-                {
-                    delete it->second;
-                    cit->second->fafs[i].erase(it);
-
-                    // none left: tear down connection
-                    if (!cit->second->fafs[1].size() && cit->second->req.status == REQ_INFLIGHT)
-                    {
-                        cit->second->req.disconnect();
-                    }
-
-                    return API_OK;
-                }
-            }
+            return API_OK;
         }
 
         return API_ENOENT;
@@ -2878,9 +4133,20 @@ error MegaClient::getfa(Node* n, fatype t, int cancel)
             if (!*fafp)
             {
                 *fafp = new FileAttributeFetch(n->nodehandle, t, reqtag);
+
+                if (!background)
+                {
+                    (*fafp)->seq = ++(*fafcp)->seq;
+                }
             }
             else
             {
+                // requested again: move ahead of older fetches
+                if (!background)
+                {
+                    (*fafp)->seq = ++(*fafcp)->seq;
+                }
+
                 restag = (*fafp)->tag;
                 return API_EEXIST;
             }
@@ -2923,32 +4189,60 @@ void MegaClient::putfa(handle th, fatype t, SymmCipher* key, string* data)
     newfa.push_back(new HttpReqCommandPutFA(this, th, t, data));
     LOG_debug << "File attribute added to queue - " << th << " : " << newfa.size();
 
-    // no other file attribute storage request currently in progress? POST this one.
-    if (curfa == newfa.end())
+    // room for more file attribute storage requests? send this one.
+    if (activefa.size() < MAXACTIVEFA && btpfa.armed())
     {
-        curfa = newfa.begin();
-        reqs.add(*curfa);
+        sendfa();
     }
 }
 
-// has the limit of concurrent transfer tslots been reached?
-bool MegaClient::slotavail() const
+void MegaClient::sendfa()
 {
-    return tslots.size() < MAXTRANSFERS;
+    while (newfa.size() && activefa.size() < MAXACTIVEFA)
+    {
+        HttpReqCommandPutFA* fa = newfa.front();
+
+        LOG_debug << "Adding file attribute to the request queue";
+        fa->status = REQ_INFLIGHT;
+        activefa.splice(activefa.end(), newfa, newfa.begin());
+        reqs.add(fa);
+    }
 }
 
-// returns 1 if more transfers of the requested type can be dispatched
-// (back-to-back overlap pipelining)
+// has the limit of concurrent transfer tslots been reached?
+bool MegaClient::slotavail(direction_t d) const
+{
+    if (!maxtransfers[d])
+    {
+        return tslots.size() < MAXTRANSFERS;
+    }
+
+    unsigned n = 0;
+
+    for (transferslot_list::const_iterator it = tslots.begin(); it != tslots.end(); it++)
+    {
+        if ((*it)->transfer->type == d)
+        {
+            n++;
+        }
+    }
+
+    return n < maxtransfers[d];
+}
+
+// returns 1 if more transfers of the requested type can be dispatched
+// (back-to-back overlap pipelining)
 // FIXME: support overlapped partial reads (and support partial reads in the
 // first place)
 bool MegaClient::moretransfers(direction_t d)
 {
-    m_off_t c = 0, r = 0;
+    m_off_t c = 0, r = 0, bpds = 0;
     dstime t = 0;
     int total = 0;
+    unsigned conns = 0;
 
     // don't dispatch if all tslots busy
-    if (!slotavail())
+    if (!slotavail(d))
     {
         return false;
     }
@@ -2962,14 +4256,32 @@ bool MegaClient::moretransfers(direction_t d)
             if ((*it)->starttime)
             {
                 t += Waiter::ds - (*it)->starttime;
+
+                // aggregate speed of the transfers running for 5+ seconds
+                if (Waiter::ds - (*it)->starttime > 50)
+                {
+                    bpds += (*it)->progressreported / (Waiter::ds - (*it)->starttime);
+                }
             }
 
             c += (*it)->progressreported;
             r += (*it)->transfer->size - (*it)->progressreported;
+            conns += (*it)->connections;
             total++;
         }
     }
 
+    if (maxxferconnections[d] && conns >= maxxferconnections[d])
+    {
+        return false;
+    }
+
+    if (maxinflight[d])
+    {
+        // keep the configured amount, or two seconds of data, in flight
+        return r < maxinflight[d] || r < bpds * 20;
+    }
+
     // always blindly dispatch transfers up to MINPIPELINE
     if (r < MINPIPELINE)
     {
@@ -3039,6 +4351,8 @@ void MegaClient::sc_updatenode()
 
                     if ((n = nodebyhandle(h)))
                     {
+                        recordnodedelta(n);
+
                         if (u)
                         {
                             n->owner = u;
@@ -3081,6 +4395,8 @@ void MegaClient::sc_updatenode()
 // read tree object (nodes and users)
 void MegaClient::readtree(JSON* j)
 {
+    TraceSpan span(&tracer, "readtree");
+
     if (j->enterobject())
     {
         for (;;)
@@ -3356,7 +4672,7 @@ void MegaClient::sc_keys()
             case 'h':
                 // security feature: we only distribute node keys for our own
                 // outgoing shares
-                if (!ISUNDEF(h = jsonsc.gethandle()) && (n = nodebyhandle(h)) && n->sharekey && !n->inshare)
+                if (!ISUNDEF(h = jsonsc.gethandle()) && (n = nodebyhandle(h)) && n->sharekey() && !n->inshare())
                 {
                     kshares.push_back(n);
                 }
@@ -3887,23 +5203,23 @@ void MegaClient::sc_ph()
             {
                 if (deleted)        // deletion
                 {
-                    if (n->plink)
+                    if (n->plink())
                     {
-                        delete n->plink;
-                        n->plink = NULL;
+                        delete n->plink();
+                        n->sharingstate()->plink = NULL;
                     }
                 }
                 else
                 {
-                    if (!n->plink)  // creation
+                    if (!n->plink())  // creation
                     {
-                        n->plink = new PublicLink(ph, ets, takendown);
+                        n->sharingstate()->plink = new PublicLink(ph, ets, takendown);
                     }
                     else            // update
                     {
-                        n->plink->ph = ph;
-                        n->plink->ets = ets;
-                        n->plink->takendown = takendown;
+                        n->plink()->ph = ph;
+                        n->plink()->ets = ets;
+                        n->plink()->takendown = takendown;
                     }
                 }
 
@@ -3932,8 +5248,35 @@ void MegaClient::sc_ph()
 // purge removed nodes after notification
 void MegaClient::notifypurge(void)
 {
+    TraceSpan span(&tracer, "notifypurge");
     int i, t;
 
+    if (catchingup && nodenotify.size() + nodepurge.size() < CATCHUPMAXNOTIFY)
+    {
+        return;
+    }
+
+    // nodes of removed subtrees that were resurrected since (server-client
+    // move) are notified like any other
+    if (nodepurge.size())
+    {
+        node_vector::iterator kept = nodepurge.begin();
+
+        for (node_vector::iterator it = nodepurge.begin(); it != nodepurge.end(); it++)
+        {
+            if ((*it)->changed.removed)
+            {
+                *kept++ = *it;
+            }
+            else
+            {
+                nodenotify.push_back(*it);
+            }
+        }
+
+        nodepurge.erase(kept, nodepurge.end());
+    }
+
     handle tscsn = cachedscsn;
 
     if (*scsn) Base64::atob(scsn, (byte*)&tscsn, sizeof tscsn);
@@ -3991,10 +5334,10 @@ void MegaClient::notifypurge(void)
             if (n->changed.removed)
             {
                 // remove inbound share
-                if (n->inshare)
+                if (n->inshare())
                 {
-                    n->inshare->user->sharing.erase(n->nodehandle);
-                    notifyuser(n->inshare->user);
+                    n->inshare()->user->sharing.erase(n->nodehandle);
+                    notifyuser(n->inshare()->user);
                 }
 
                 nodes.erase(n->nodehandle);
@@ -4009,6 +5352,29 @@ void MegaClient::notifypurge(void)
         }
 
         nodenotify.clear();
+        nodedeltas.clear();
+    }
+
+    // descendants of removed subtrees, parents first: each one has already
+    // been detached by the destructor of its parent
+    if (nodepurge.size())
+    {
+        for (node_vector::iterator it = nodepurge.begin(); it != nodepurge.end(); it++)
+        {
+            Node* n = *it;
+
+            if (n->inshare())
+            {
+                n->inshare()->user->sharing.erase(n->nodehandle);
+                notifyuser(n->inshare()->user);
+            }
+
+            nodes.erase(n->nodehandle);
+            delete n;
+        }
+
+        LOG_debug << "Purged " << nodepurge.size() << " nodes of removed subtrees";
+        nodepurge.clear();
     }
 
     if ((t = pcrnotify.size()))
@@ -4055,6 +5421,11 @@ void MegaClient::notifypurge(void)
 
         usernotify.clear();
     }
+
+    if (nodepaging)
+    {
+        trimnodes();
+    }
 }
 
 // return node pointer derived from node handle
@@ -4064,12 +5435,178 @@ Node* MegaClient::nodebyhandle(handle h)
 
     if ((it = nodes.find(h)) != nodes.end())
     {
-        return it->second;
+        Node* n = it->second;
+
+        if (n->type == FILENODE && n->paged_it != pagedlru.end())
+        {
+            pagedlru.splice(pagedlru.end(), pagedlru, n->paged_it);
+        }
+
+        return n;
+    }
+
+    // the nodes of a stream being received are new (evicted ones are
+    // found through their parent only)
+    if (nodepaging && !ISUNDEF(h) && !nodestreampaging)
+    {
+        string value;
+
+        sctable->indexvalue(h, &key, &value);
+        loadnodes(DbTable::COLUMN_NODEHANDLE, &value);
+
+        if ((it = nodes.find(h)) != nodes.end())
+        {
+            return it->second;
+        }
     }
 
     return NULL;
 }
 
+// paged mode: read a cached node record - evicted nodes are still counted
+// in their ancestors' subtree totals, so these are not incremented again
+Node* MegaClient::loadnode(uint32_t id)
+{
+    string data;
+    node_vector dp;
+    node_map::iterator it;
+    Node* n;
+    handle h;
+
+    if (!sctable->get(id, &data) || !PaddedCBC::decrypt(&data, &key))
+    {
+        LOG_err << "Unable to read cached node " << id;
+        return NULL;
+    }
+
+    if (ISUNDEF(h = Node::recordhandle(&data)))
+    {
+        return NULL;
+    }
+
+    if ((it = nodes.find(h)) != nodes.end())
+    {
+        return it->second;
+    }
+
+    if (!(n = Node::unserialize(this, &data, &dp)))
+    {
+        LOG_err << "Failed - node record read error";
+        return NULL;
+    }
+
+    n->dbid = id;
+    memset(&n->changed, 0, sizeof n->changed);
+
+    for (Node* a = n->parent; a; a = a->parent)
+    {
+        a->subtree -= n->subtree;
+    }
+
+    return n;
+}
+
+void MegaClient::loadnodes(int column, const string* value)
+{
+    vector<uint32_t> ids;
+
+    if (sctable->lookup(column, value, &ids))
+    {
+        for (unsigned i = 0; i < ids.size(); i++)
+        {
+            loadnode(ids[i]);
+        }
+    }
+}
+
+void MegaClient::loadchildren(Node* n)
+{
+    if (nodepaging && n->childrenpaged)
+    {
+        string value;
+
+        sctable->indexvalue(n->nodehandle, &key, &value);
+        loadnodes(DbTable::COLUMN_PARENTHANDLE, &value);
+
+        n->childrenpaged = false;
+    }
+}
+
+void MegaClient::loadtree(Node* n)
+{
+    node_vector pending;
+
+    if (!nodepaging)
+    {
+        return;
+    }
+
+    pending.push_back(n);
+
+    while (pending.size())
+    {
+        n = pending.back();
+        pending.pop_back();
+
+        loadchildren(n);
+
+        for (node_list::iterator it = n->children.begin(); it != n->children.end(); it++)
+        {
+            if ((*it)->type != FILENODE)
+            {
+                pending.push_back(*it);
+            }
+        }
+    }
+}
+
+// evict least recently used file nodes that are fully represented by their
+// statecache record and not referenced from elsewhere
+void MegaClient::trimnodes()
+{
+    set<handle> shared;
+
+    if (!sctable || pagedlru.size() <= nodecachelimit)
+    {
+        return;
+    }
+
+    // shares read from the cache, but not merged yet
+    for (newshare_list::iterator it = newshares.begin(); it != newshares.end(); it++)
+    {
+        shared.insert((*it)->h);
+    }
+
+    size_t examined = pagedlru.size();
+
+    while (pagedlru.size() > nodecachelimit && examined--)
+    {
+        Node* n = pagedlru.front();
+
+        if (!n->dbid || !n->parent || n->notified || n->sharing || n->attrstring || n->appdata
+         || hdrns.find(n->nodehandle) != hdrns.end() || shared.count(n->nodehandle)
+#ifdef ENABLE_SYNC
+         || n->localnode || n->syncget
+         || n->todebris_it != todebris.end() || n->tounlink_it != tounlink.end()
+#endif
+           )
+        {
+            pagedlru.splice(pagedlru.end(), pagedlru, n->paged_it);
+            continue;
+        }
+
+        // keep the evicted node counted in the subtree totals
+        for (Node* a = n->parent; a; a = a->parent)
+        {
+            a->subtree += n->subtree;
+        }
+
+        n->parent->childrenpaged = true;
+        nodes.erase(n->nodehandle);
+        delete n;
+    }
+}
+
 // server-client deletion
 Node* MegaClient::sc_deltree()
 {
@@ -4091,8 +5628,7 @@ Node* MegaClient::sc_deltree()
             case EOO:
                 if (n)
                 {
-                    TreeProcDel td;
-                    proctree(n, &td);
+                    deltree(n);
                 }
                 return n;
 
@@ -4151,6 +5687,8 @@ error MegaClient::setattr(Node* n, const char** newattr, const char *prevattr)
         return API_EKEY;
     }
 
+    recordnodedelta(n, prevattr);
+
     if (newattr)
     {
         while (*newattr)
@@ -4160,6 +5698,11 @@ error MegaClient::setattr(Node* n, const char** newattr, const char *prevattr)
         }
     }
 
+    if (n->parent)
+    {
+        n->parent->children.invalidate();
+    }
+
     n->changed.attrs = true;
     notifynode(n);
 
@@ -4174,129 +5717,360 @@ void MegaClient::putnodes(handle h, NewNode* newnodes, int numnodes)
     reqs.add(new CommandPutNodes(this, h, NULL, newnodes, numnodes, reqtag));
 }
 
-// drop nodes into a user's inbox (must have RSA keypair)
-void MegaClient::putnodes(const char* user, NewNode* newnodes, int numnodes)
+void MegaClient::queueuploadnode(handle th, NewNode* nn, int ctag)
 {
-    User* u;
+    if (!numuploadnodes)
+    {
+        uploadnodesds = Waiter::ds;
+    }
 
-    restag = reqtag;
+    uploadnodes[th].push_back(pair<NewNode*, int>(nn, ctag));
 
-    if (!(u = finduser(user, 1)))
+    if (++numuploadnodes >= MAX_NEWNODES)
     {
-        return app->putnodes_result(API_EARGS, USER_HANDLE, newnodes);
+        senduploadnodes();
     }
-
-    queuepubkeyreq(u, new PubKeyActionPutNodes(newnodes, numnodes, reqtag));
 }
 
-// returns 1 if node has accesslevel a or better, 0 otherwise
-int MegaClient::checkaccess(Node* n, accesslevel_t a)
+// one putnodes per target folder; CommandPutNodes reports each node to the
+// transfer it belongs to
+void MegaClient::senduploadnodes()
 {
-    // folder link access is always read-only - ignore login status during
-    // initial tree fetch
-    if ((a < OWNERPRELOGIN) && !loggedin())
+    for (map<handle, vector<pair<NewNode*, int> > >::iterator it = uploadnodes.begin(); it != uploadnodes.end(); it++)
     {
-        return a == RDONLY;
-    }
+        vector<pair<NewNode*, int> >& queued = it->second;
+        NewNode* nn = new NewNode[queued.size()];
+        vector<int> tags;
 
-    // trace back to root node (always full access) or share node
-    while (n)
-    {
-        if (n->inshare)
+        for (unsigned i = 0; i < queued.size(); i++)
         {
-            return n->inshare->access >= a;
-        }
+            // take over the attribute string
+            nn[i] = *queued[i].first;
+            queued[i].first->attrstring = NULL;
+            delete[] queued[i].first;
 
-        if (!n->parent)
-        {
-            return n->type > FOLDERNODE;
+            tags.push_back(queued[i].second);
         }
 
-        n = n->parent;
+        LOG_debug << "Putting " << queued.size() << " uploaded files";
+
+        reqs.add(new CommandPutNodes(this, it->first, nn, queued.size(), &tags));
     }
 
-    return 0;
+    uploadnodes.clear();
+    numuploadnodes = 0;
 }
 
-// returns API_OK if a move operation is permitted, API_EACCESS or
-// API_ECIRCULAR otherwise
-error MegaClient::checkmove(Node* fn, Node* tn)
+// drop nodes into a user's inbox (must have RSA keypair)
+PutNodesTree::PutNodesTree(handle h, NewNode* newnodes, int n, int ctag, int maxslice)
 {
-    // condition #1: cannot move top-level node, must have full access to fn's
-    // parent
-    if (!fn->parent || !checkaccess(fn->parent, FULL))
-    {
-        return API_EACCESS;
-    }
+    map<handle, int> index;
+    vector<int> parent(n);
+    vector<vector<int> > children(n);
+    deque<int> roots;
 
-    // condition #2: target must be folder
-    if (tn->type == FILENODE)
-    {
-        return API_EACCESS;
-    }
+    target = h;
+    nn = newnodes;
+    numnodes = n;
+    tag = ctag;
+    inflight = 0;
+    e = API_OK;
+    created.assign(n, UNDEF);
 
-    // condition #3: must have write access to target
-    if (!checkaccess(tn, RDWR))
+    for (int i = 0; i < n; i++)
     {
-        return API_EACCESS;
-    }
+        map<handle, int>::iterator it = ISUNDEF(nn[i].parenthandle) ? index.end() : index.find(nn[i].parenthandle);
 
-    // condition #4: tn must not be below fn (would create circular linkage)
-    for (;;)
-    {
-        if (tn == fn)
+        if (it == index.end())
         {
-            return API_ECIRCULAR;
+            parent[i] = -1;
+            roots.push_back(i);
         }
-
-        if (tn->inshare || !tn->parent)
+        else
         {
-            break;
+            parent[i] = it->second;
+            children[it->second].push_back(i);
         }
 
-        tn = tn->parent;
+        index[nn[i].nodehandle] = i;
     }
 
-    // condition #5: fn and tn must be in the same tree (same ultimate parent
-    // node or shared by the same user)
-    for (;;)
+    // depth-first from each root until the slice is full - the unvisited
+    // nodes become the roots of further slices
+    while (roots.size())
     {
-        if (fn->inshare || !fn->parent)
+        vector<int> stack(1, roots.front());
+
+        roots.pop_front();
+
+        slices.push_back(Slice());
+
+        Slice* s = &slices.back();
+
+        s->parent = parent[stack[0]];
+        s->retries = 0;
+        s->sent = false;
+
+        while (stack.size())
         {
-            break;
-        }
+            int i = stack.back();
 
-        fn = fn->parent;
-    }
+            stack.pop_back();
 
-    // moves within the same tree or between the user's own trees are permitted
-    if (fn == tn || (!fn->inshare && !tn->inshare))
-    {
-        return API_OK;
+            if ((int)s->nodes.size() >= maxslice)
+            {
+                roots.push_back(i);
+                continue;
+            }
+
+            s->nodes.push_back(i);
+
+            for (int j = children[i].size(); j--; )
+            {
+                stack.push_back(children[i][j]);
+            }
+        }
     }
+}
 
-    // moves between inbound shares from the same user are permitted
-    if (fn->inshare && tn->inshare && fn->inshare->user == tn->inshare->user)
+void MegaClient::putnodestree(handle h, NewNode* newnodes, int numnodes)
+{
+    if (numnodes <= MAX_NEWNODES)
     {
-        return API_OK;
+        return putnodes(h, newnodes, numnodes);
     }
 
-    return API_EACCESS;
+    PutNodesTree* t = new PutNodesTree(h, newnodes, numnodes, reqtag, MAX_NEWNODES);
+
+    LOG_debug << "Putting " << numnodes << " nodes in " << t->slices.size() << " slices";
+
+    putnodestrees.insert(t);
+    sendtreeslices(t);
 }
 
-// move node to new parent node (for changing the filename, use setattr and
-// modify the 'n' attribute)
-error MegaClient::rename(Node* n, Node* p, syncdel_t syncdel, handle prevparent)
+void MegaClient::sendtreeslices(PutNodesTree* t)
 {
-    error e;
-
-    if ((e = checkmove(n, p)))
+    for (unsigned i = 0; i < t->slices.size() && t->inflight < MAXTREESLICES; i++)
     {
-        return e;
-    }
+        PutNodesTree::Slice* s = &t->slices[i];
+        handle th = (s->parent < 0) ? t->target : t->created[s->parent];
 
-    if (n->setparent(p))
-    {
+        if (s->sent || ISUNDEF(th))
+        {
+            continue;
+        }
+
+        // the command owns a copy, so that the slice can be sent again
+        NewNode* nn = new NewNode[s->nodes.size()];
+
+        for (unsigned j = 0; j < s->nodes.size(); j++)
+        {
+            NewNode* o = t->nn + s->nodes[j];
+
+            nn[j] = *o;
+            nn[j].attrstring = o->attrstring ? new string(*o->attrstring) : NULL;
+        }
+
+        // the root goes into the target of the command
+        nn[0].parenthandle = UNDEF;
+
+        CommandPutNodes* c = new CommandPutNodes(this, th, NULL, nn, s->nodes.size(), t->tag);
+
+        c->tree = t;
+        c->slice = i;
+        reqs.add(c);
+
+        s->sent = true;
+        t->inflight++;
+    }
+}
+
+void MegaClient::putnodestree_result(PutNodesTree* t, int slice, NewNode* nn, error e)
+{
+    PutNodesTree::Slice* s = &t->slices[slice];
+
+    t->inflight--;
+
+    if (e)
+    {
+        if ((e == API_EAGAIN || e == API_ERATELIMIT) && s->retries < MAXSLICERETRIES)
+        {
+            LOG_debug << "Retrying slice " << slice << " of putnodes tree: " << e;
+            s->retries++;
+            s->sent = false;
+        }
+        else
+        {
+            LOG_warn << "Slice " << slice << " of putnodes tree failed: " << e;
+
+            if (!t->e)
+            {
+                t->e = e;
+            }
+        }
+    }
+    else
+    {
+        for (unsigned j = 0; j < s->nodes.size(); j++)
+        {
+            if (nn[j].added)
+            {
+                t->nn[s->nodes[j]].added = true;
+                t->nn[s->nodes[j]].addedhandle = t->created[s->nodes[j]] = nn[j].addedhandle;
+            }
+        }
+    }
+
+    delete[] nn;
+
+    sendtreeslices(t);
+
+    if (!t->inflight)
+    {
+        // slices below a failed one can't be sent
+        if (!t->e)
+        {
+            for (unsigned i = 0; i < t->slices.size(); i++)
+            {
+                if (!t->slices[i].sent)
+                {
+                    t->e = API_EINCOMPLETE;
+                    break;
+                }
+            }
+        }
+
+        putnodestrees.erase(t);
+        restag = t->tag;
+        app->putnodes_result(t->e, NODE_HANDLE, t->nn);
+        delete t;
+    }
+}
+
+void MegaClient::putnodes(const char* user, NewNode* newnodes, int numnodes)
+{
+    User* u;
+
+    restag = reqtag;
+
+    if (!(u = finduser(user, 1)))
+    {
+        return app->putnodes_result(API_EARGS, USER_HANDLE, newnodes);
+    }
+
+    queuepubkeyreq(u, new PubKeyActionPutNodes(newnodes, numnodes, reqtag));
+}
+
+// returns 1 if node has accesslevel a or better, 0 otherwise
+int MegaClient::checkaccess(Node* n, accesslevel_t a)
+{
+    // folder link access is always read-only - ignore login status during
+    // initial tree fetch
+    if ((a < OWNERPRELOGIN) && !loggedin())
+    {
+        return a == RDONLY;
+    }
+
+    // trace back to root node (always full access) or share node
+    while (n)
+    {
+        if (n->inshare())
+        {
+            return n->inshare()->access >= a;
+        }
+
+        if (!n->parent)
+        {
+            return n->type > FOLDERNODE;
+        }
+
+        n = n->parent;
+    }
+
+    return 0;
+}
+
+// returns API_OK if a move operation is permitted, API_EACCESS or
+// API_ECIRCULAR otherwise
+error MegaClient::checkmove(Node* fn, Node* tn)
+{
+    // condition #1: cannot move top-level node, must have full access to fn's
+    // parent
+    if (!fn->parent || !checkaccess(fn->parent, FULL))
+    {
+        return API_EACCESS;
+    }
+
+    // condition #2: target must be folder
+    if (tn->type == FILENODE)
+    {
+        return API_EACCESS;
+    }
+
+    // condition #3: must have write access to target
+    if (!checkaccess(tn, RDWR))
+    {
+        return API_EACCESS;
+    }
+
+    // condition #4: tn must not be below fn (would create circular linkage)
+    for (;;)
+    {
+        if (tn == fn)
+        {
+            return API_ECIRCULAR;
+        }
+
+        if (tn->inshare() || !tn->parent)
+        {
+            break;
+        }
+
+        tn = tn->parent;
+    }
+
+    // condition #5: fn and tn must be in the same tree (same ultimate parent
+    // node or shared by the same user)
+    for (;;)
+    {
+        if (fn->inshare() || !fn->parent)
+        {
+            break;
+        }
+
+        fn = fn->parent;
+    }
+
+    // moves within the same tree or between the user's own trees are permitted
+    if (fn == tn || (!fn->inshare() && !tn->inshare()))
+    {
+        return API_OK;
+    }
+
+    // moves between inbound shares from the same user are permitted
+    if (fn->inshare() && tn->inshare() && fn->inshare()->user == tn->inshare()->user)
+    {
+        return API_OK;
+    }
+
+    return API_EACCESS;
+}
+
+// move node to new parent node (for changing the filename, use setattr and
+// modify the 'n' attribute)
+error MegaClient::rename(Node* n, Node* p, syncdel_t syncdel, handle prevparent)
+{
+    error e;
+
+    if ((e = checkmove(n, p)))
+    {
+        return e;
+    }
+
+    recordnodedelta(n);
+
+    if (n->setparent(p))
+    {
         n->changed.parent = true;
         notifynode(n);
 
@@ -4312,7 +6086,7 @@ error MegaClient::rename(Node* n, Node* p, syncdel_t syncdel, handle prevparent)
 // delete node tree
 error MegaClient::unlink(Node* n)
 {
-    if (!n->inshare && !checkaccess(n, FULL))
+    if (!n->inshare() && !checkaccess(n, FULL))
     {
         return API_EACCESS;
     }
@@ -4321,8 +6095,7 @@ error MegaClient::unlink(Node* n)
 
     mergenewshares(1);
 
-    TreeProcDel td;
-    proctree(n, &td);
+    deltree(n);
 
     return API_OK;
 }
@@ -4417,7 +6190,7 @@ char* MegaClient::str_to_a32(const char* str, int* len)
 }
 
 // compute UTF-8 password hash
-error MegaClient::pw_key(const char* utf8pw, byte* key) const
+error MegaClient::pw_key(const char* utf8pw, byte* key)
 {
     int t;
     char* pw;
@@ -4428,32 +6201,59 @@ error MegaClient::pw_key(const char* utf8pw, byte* key) const
     }
 
     int n = (t + 15) / 16;
-    SymmCipher* keys = new SymmCipher[n];
+    byte* keys = new byte[n * SymmCipher::KEYLENGTH];
 
-    for (int i = 0; i < n; i++)
-    {
-        int valid = (i != (n - 1)) ? SymmCipher::BLOCKSIZE : (t - SymmCipher::BLOCKSIZE * i);
-        memcpy(key, pw + i * SymmCipher::BLOCKSIZE, valid);
-        memset(key + valid, 0, SymmCipher::BLOCKSIZE - valid);
-        keys[i].setkey(key);
-    }
+    // the password in NUL-padded blocks
+    memcpy(keys, pw, t);
+    memset(keys + t, 0, n * SymmCipher::KEYLENGTH - t);
 
     memcpy(key, "\x93\xC4\x67\xE3\x7D\xB0\xC7\xA4\xD1\xBE\x3F\x81\x01\x52\xCB\x56", SymmCipher::BLOCKSIZE);
 
-    for (int r = 65536; r--; )
-    {
-        for (int i = 0; i < n; i++)
-        {
-            keys[i].ecb_encrypt(key);
-        }
-    }
+    SymmCipher::encryptrounds(keys, n, key, 65536);
 
+    memset(keys, 0, n * SymmCipher::KEYLENGTH);
     delete[] keys;
     delete[] pw;
 
     return API_OK;
 }
 
+struct PwKeyJob
+{
+    const char* const* passwords;
+    byte* keys;
+    error* errors;
+};
+
+static void pwkeyjob(unsigned i, void* param)
+{
+    PwKeyJob* job = (PwKeyJob*)param;
+
+    job->errors[i] = MegaClient::pw_key(job->passwords[i], job->keys + i * SymmCipher::KEYLENGTH);
+}
+
+// derive the keys of several passwords, in parallel if workers are given
+void MegaClient::pw_keys(ParallelRunner* workers, unsigned n, const char* const* passwords, byte* keys, error* errors)
+{
+    PwKeyJob job;
+
+    job.passwords = passwords;
+    job.keys = keys;
+    job.errors = errors;
+
+    if (n > 1 && workers)
+    {
+        workers->run(n, pwkeyjob, &job);
+    }
+    else
+    {
+        for (unsigned i = 0; i < n; i++)
+        {
+            pwkeyjob(i, &job);
+        }
+    }
+}
+
 void MegaClient::loadbalancing(const char* service)
 {
     loadbalancingreqs.push(new CommandLoadBalancing(this, service));
@@ -4494,8 +6294,10 @@ uint64_t MegaClient::stringhash64(string* s, SymmCipher* c)
 }
 
 // read and add/verify node array
-int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn, int nnsize, int tag)
+int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn, int nnsize, int tag, node_vector* added)
 {
+    AllocScope allocscope(AllocTags::NODES);
+
     if (!j->enterarray())
     {
         return 0;
@@ -4513,6 +6315,7 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
         const char* k = NULL;
         const char* fa = NULL;
         const char *sk = NULL;
+        size_t alen = 0, klen = 0;
         accesslevel_t rl = ACCESS_UNKNOWN;
         m_off_t s = NEVER;
         m_time_t ts = -1, sts = -1;
@@ -4540,11 +6343,11 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
                     break;
 
                 case 'a':   // attributes
-                    a = j->getvalue();
+                    a = j->getvalue(&alen);
                     break;
 
                 case 'k':   // key(s)
-                    k = j->getvalue();
+                    k = j->getvalue(&klen);
                     break;
 
                 case 's':   // file size
@@ -4648,6 +6451,8 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
                 {
                     Node* p;
 
+                    recordnodedelta(n);
+
                     if ((p = nodebyhandle(ph)))
                     {
                         n->setparent(p);
@@ -4695,10 +6500,6 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
                     }
                 }
 
-                string fas;
-
-                Node::copystring(&fas, fa);
-
                 // fallback timestamps
                 if (!(ts + 1))
                 {
@@ -4710,13 +6511,18 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
                     sts = ts;
                 }
 
-                n = new Node(this, &dp, h, ph, t, s, u, fas.c_str(), ts);
+                // the values are copied straight from the response
+                n = new (this) Node(this, &dp, h, ph, t, s, u, fa, ts);
 
                 n->tag = tag;
 
-                n->attrstring = new string;
-                Node::copystring(n->attrstring, a);
-                Node::copystring(&n->nodekey, k);
+                n->attrstring = a ? new string(a, alen) : new string;
+                n->nodekey.assign(k ? k : "", klen);
+
+                if (added)
+                {
+                    added->push_back(n);
+                }
 
                 if (!ISUNDEF(su))
                 {
@@ -4726,6 +6532,12 @@ int MegaClient::readnodes(JSON* j, int notify, putsource_t source, NewNode* nn,
                 if (nn && nni >= 0 && nni < nnsize)
                 {
                     nn[nni].added = true;
+                    nn[nni].addedhandle = h;
+
+                    if (nn[nni].source == NEW_UPLOAD)
+                    {
+                        nn[nni].nodehandle = h;
+                    }
 
 #ifdef ENABLE_SYNC
                     if (source == PUTNODES_SYNC)
@@ -5162,15 +6974,15 @@ void MegaClient::procph(JSON *j)
                         n = nodebyhandle(h);
                         if (n)
                         {
-                            if (!n->plink)
+                            if (!n->plink())
                             {
-                                n->plink = new PublicLink(ph, ets, takendown);
+                                n->sharingstate()->plink = new PublicLink(ph, ets, takendown);
                             }
                             else
                             {
-                                n->plink->ph = ph;
-                                n->plink->ets = ets;
-                                n->plink->takendown = takendown;
+                                n->plink()->ph = ph;
+                                n->plink()->ets = ets;
+                                n->plink()->takendown = takendown;
                             }
 
                             notifynode(n);
@@ -5194,50 +7006,286 @@ void MegaClient::procph(JSON *j)
     }
 }
 
-int MegaClient::applykeys()
+// a node key to unwrap and the node's attributes to decrypt on a worker
+struct NodeKeyJob
 {
-    int t = 0;
+    Node* node;
 
-    // FIXME: rather than iterating through the whole node set, maintain subset
-    // with missing keys
-    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    // encrypted key within node->nodekey and the cipher that unwraps it (or
+    // the RSA key, for RSA-encrypted keys)
+    const char* k;
+    SymmCipher* sc;
+    AsymmCipher* rsa;
+
+    byte key[FILENODEKEYLENGTH];
+    bool keyok;
+
+    // decrypted attribute string or NULL
+    byte* attrs;
+};
+
+// worker side: only touches its own jobs and private ciphers
+static void applykeysbatch(unsigned batch, void* param)
+{
+    vector<NodeKeyJob>* jobs = (vector<NodeKeyJob>*)param;
+    SymmCipher unwrap;
+    SymmCipher* sc = NULL;
+    vector<Node*> attrnodes;
+    vector<const byte*> attrkeys;
+    vector<NodeKeyJob*> attrjobs;
+    size_t end = (batch + 1) * (size_t)MegaClient::PARALLELKEYBATCH;
+
+    if (end > jobs->size())
     {
-        if (it->second->applykey())
-        {
-            t++;
-        }
+        end = jobs->size();
     }
 
-    if (sharekeyrewrite.size())
+    for (size_t i = batch * (size_t)MegaClient::PARALLELKEYBATCH; i < end; i++)
     {
-        reqs.add(new CommandShareKeyUpdate(this, &sharekeyrewrite));
-        sharekeyrewrite.clear();
+        NodeKeyJob* j = &(*jobs)[i];
+        Node* n = j->node;
+        int keylength = (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+
+        if (j->sc != sc)
+        {
+            sc = j->sc;
+            unwrap.setkey(sc->key);
+        }
+
+        if (!(j->keyok = Base64::atob(j->k, j->key, keylength) == keylength))
+        {
+            continue;
+        }
+
+        unwrap.ecb_decrypt(j->key, keylength);
+
+        if (n->attrstring)
+        {
+            attrnodes.push_back(n);
+            attrkeys.push_back(j->key);
+            attrjobs.push_back(j);
+        }
     }
 
-    if (nodekeyrewrite.size())
+    // the batch's attributes in one go
+    if (attrnodes.size())
     {
-        reqs.add(new CommandNodeKeyUpdate(this, &nodekeyrewrite));
-        nodekeyrewrite.clear();
-    }
+        vector<byte*> attrs(attrnodes.size());
 
-    return t;
+        Node::decryptattrs(attrnodes.size(), &attrnodes[0], &attrkeys[0], &attrs[0]);
+
+        for (size_t i = 0; i < attrjobs.size(); i++)
+        {
+            attrjobs[i]->attrs = attrs[i];
+        }
+    }
 }
 
-// user/contact list
-bool MegaClient::readusers(JSON* j)
+// worker side: one RSA-encrypted node key (the RSA key is only read)
+static void applyrsakey(unsigned i, void* param)
 {
-    if (!j->enterarray())
+    NodeKeyJob* j = &(*(vector<NodeKeyJob>*)param)[i];
+    Node* n = j->node;
+    int keylength = (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+    size_t l = strcspn(j->k, "\"/") / 4 * 3 + 3;
+    byte* buf = new byte[l];
+
+    l = Base64::atob(j->k, buf, (int)l);
+    j->keyok = j->rsa->decrypt(buf, (int)l, j->key, keylength) != 0;
+    delete[] buf;
+
+    if (j->keyok && n->attrstring)
     {
-        return 0;
+        SymmCipher nodecipher;
+
+        nodecipher.setkey(j->key, n->type);
+        j->attrs = Node::decryptattr(&nodecipher, n->attrstring->c_str(), n->attrstring->size());
     }
+}
 
-    while (j->enterobject())
-    {
-        handle uh = 0;
-        visibility_t v = VISIBILITY_UNKNOWN;    // new share objects do not override existing visibility
-        m_time_t ts = 0;
-        const char* m = NULL;
-        nameid name;
+// three stages: key lookup on this thread, unwrapping and attribute
+// decryption on the workers, then key and attribute assignment (which
+// touches the fingerprint index and parents' name indexes) on this thread
+// again - RSA-encrypted keys that are not cached get a job each
+int MegaClient::applykeysparallel(node_vector* subset)
+{
+    vector<NodeKeyJob> jobs, rsajobs;
+    int t = 0;
+    node_map::iterator it = nodes.begin();
+    size_t i = 0;
+
+    for (;;)
+    {
+        NodeKeyJob j;
+
+        if (subset ? i == subset->size() : it == nodes.end())
+        {
+            break;
+        }
+
+        j.node = subset ? (*subset)[i++] : (it++)->second;
+
+        if (!(j.k = j.node->findkey(&j.sc)))
+        {
+            continue;
+        }
+
+        size_t l = strcspn(j.k, "\"/");
+
+        j.rsa = NULL;
+        j.keyok = false;
+        j.attrs = NULL;
+
+        if (l > 4 * FILENODEKEYLENGTH / 3 + 1)
+        {
+            if (l / 4 * 3 + 3 > 4096 || rsakeys.find(string(j.k, l)) != rsakeys.end())
+            {
+                // oversized (rejected) or cached
+                if (j.node->applykey())
+                {
+                    t++;
+                }
+
+                continue;
+            }
+
+            j.rsa = &asymkey;
+            rsajobs.push_back(j);
+            continue;
+        }
+
+        jobs.push_back(j);
+    }
+
+    if (!jobs.size() && !rsajobs.size())
+    {
+        return t;
+    }
+
+    unsigned batches = (jobs.size() + PARALLELKEYBATCH - 1) / PARALLELKEYBATCH;
+
+    if (!workers || jobs.size() < MINPARALLELKEYS)
+    {
+        for (unsigned i = 0; i < batches; i++)
+        {
+            applykeysbatch(i, &jobs);
+        }
+    }
+    else
+    {
+        LOG_debug << "Decrypting " << jobs.size() << " nodes in parallel";
+
+        workers->run(batches, applykeysbatch, &jobs);
+    }
+
+    if (!workers || rsajobs.size() < MINPARALLELRSAKEYS)
+    {
+        for (unsigned i = 0; i < rsajobs.size(); i++)
+        {
+            applyrsakey(i, &rsajobs);
+        }
+    }
+    else
+    {
+        LOG_debug << "Decrypting " << rsajobs.size() << " RSA node keys in parallel";
+
+        workers->run(rsajobs.size(), applyrsakey, &rsajobs);
+        rsaparallel += rsajobs.size();
+    }
+
+    for (vector<NodeKeyJob>::iterator it = rsajobs.begin(); it != rsajobs.end(); it++)
+    {
+        rsadecrypts++;
+
+        if (it->keyok)
+        {
+            string wrapped(it->k, strcspn(it->k, "\"/"));
+
+            cachersakey(&wrapped, it->key, (it->node->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+            nodekeyrewrite.push_back(it->node->nodehandle);
+        }
+    }
+
+    jobs.insert(jobs.end(), rsajobs.begin(), rsajobs.end());
+
+    for (vector<NodeKeyJob>::iterator it = jobs.begin(); it != jobs.end(); it++)
+    {
+        Node* n = it->node;
+
+        t++;
+
+        if (!it->keyok)
+        {
+            LOG_warn << (it->rsa ? "Corrupt or invalid RSA node key" : "Corrupt or invalid symmetric node key");
+            continue;
+        }
+
+        n->nodekey.assign((const char*)it->key, (n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+
+        if (n->parent)
+        {
+            n->parent->children.invalidate();
+        }
+
+        if (it->attrs)
+        {
+            n->setattr(it->attrs);
+            delete[] it->attrs;
+        }
+    }
+
+    return t;
+}
+
+int MegaClient::applykeys()
+{
+    int t = 0;
+    clock_t start = clock();
+
+    // lazy mode: nodes are decrypted on first access instead
+    if (lazydecrypt && (fetchingnodes || nodesdeferred))
+    {
+        nodesdeferred = true;
+    }
+    else
+    {
+        // FIXME: rather than iterating through the whole node set, maintain subset
+        // with missing keys
+        t = applykeysparallel();
+    }
+
+    if (sharekeyrewrite.size())
+    {
+        reqs.add(new CommandShareKeyUpdate(this, &sharekeyrewrite));
+        sharekeyrewrite.clear();
+    }
+
+    if (nodekeyrewrite.size())
+    {
+        reqs.add(new CommandNodeKeyUpdate(this, &nodekeyrewrite));
+        nodekeyrewrite.clear();
+    }
+
+    keytime += (uint64_t)(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+
+    return t;
+}
+
+// user/contact list
+bool MegaClient::readusers(JSON* j)
+{
+    if (!j->enterarray())
+    {
+        return 0;
+    }
+
+    while (j->enterobject())
+    {
+        handle uh = 0;
+        visibility_t v = VISIBILITY_UNKNOWN;    // new share objects do not override existing visibility
+        m_time_t ts = 0;
+        const char* m = NULL;
+        nameid name;
 
         while ((name = j->getnameid()) != EOO)
         {
@@ -5428,6 +7476,14 @@ void MegaClient::login(const byte* session, int size)
             cachedscsn = MemAccess::get<handle>(t.data());
         }
 
+        if (offlinestart && !ISUNDEF(cachedscsn) && restoresession())
+        {
+            LOG_info << "Session resumed from the local cache";
+            restag = reqtag;
+            app->login_result(API_OK);
+            return;
+        }
+
         byte sek[SymmCipher::KEYLENGTH];
         PrnGen::genblock(sek, sizeof sek);
 
@@ -5551,159 +7607,423 @@ void MegaClient::opensctable()
     {
         string dbname;
 
-        dbname.resize((SIDLEN - sizeof key.key) * 4 / 3 + 3);
-        dbname.resize(Base64::btoa((const byte*)sid.data() + sizeof key.key, SIDLEN - sizeof key.key, (char*)dbname.c_str()));
+        if (sctablename(&dbname))
+        {
+            sctable = dbaccess->open(fsaccess, &dbname);
+        }
+        else if (pagednodes && loggedin() == NOTLOGGEDIN && !ISUNDEF(rootnodes[0]))
+        {
+            // a folder link has no session to resume from - its table only
+            // backs paged mode and is rebuilt by every fetchnodes
+            dbname.resize(NODEHANDLE * 4 / 3 + 4);
+            dbname.resize(Base64::btoa((const byte*)&rootnodes[0], NODEHANDLE, (char*)dbname.c_str()));
+            dbname.insert(0, "folder_");
 
-        sctable = dbaccess->open(fsaccess, &dbname);
+            sctable = dbaccess->open(fsaccess, &dbname);
+        }
     }
+
+    opentctable();
 }
 
-// verify a static symmetric password challenge
-int MegaClient::checktsid(byte* sidbuf, unsigned len)
+void MegaClient::opentctable()
 {
-    if (len != SIDLEN)
+    string dbname;
+
+    if (dbaccess && !tctable && sctablename(&dbname))
     {
-        return 0;
-    }
+        dbname.append("_transfers");
 
-    key.ecb_encrypt(sidbuf);
+        if ((tctable = dbaccess->open(fsaccess, &dbname)))
+        {
+            uint32_t id;
+            string data;
+            Transfer* t;
+            vector<uint32_t> invalid;
 
-    return !memcmp(sidbuf, sidbuf + SIDLEN - SymmCipher::KEYLENGTH, SymmCipher::KEYLENGTH);
-}
+            tctable->rewind();
 
-// locate user by e-mail address or ASCII handle
-User* MegaClient::finduser(const char* uid, int add)
-{
-    // null user for folder links?
-    if (!uid || !*uid)
-    {
-        return NULL;
+            while (tctable->next(&id, &data, &key))
+            {
+                if ((id & 15) == CACHEDTRANSFER && (t = Transfer::unserialize(this, &data, &cachedtransfers[GET])))
+                {
+                    t->dbid = id;
+                }
+                else if ((id & 15) == CACHEDQUEUEDTRANSFER)
+                {
+                    queuedtransfers[id].swap(data);
+                }
+                else
+                {
+                    invalid.push_back(id);
+                }
+            }
+
+            tctable->begin();
+
+            for (unsigned i = 0; i < invalid.size(); i++)
+            {
+                tctable->del(invalid[i]);
+            }
+
+            tctable->commit();
+
+            LOG_info << "Partial downloads restored from cache: " << cachedtransfers[GET].size();
+            LOG_info << "Queued transfers restored from cache: " << queuedtransfers.size();
+        }
     }
+}
 
-    if (!strchr(uid, '@'))
+void MegaClient::cachetransfer(Transfer* t)
+{
+    if (tctable && t->type == GET && !t->sink && t->chunkmacs.size())
     {
-        // not an e-mail address: must be ASCII handle
-        handle uh;
+        tctable->begin();
 
-        if (Base64::atob(uid, (byte*)&uh, sizeof uh) == sizeof uh)
+        if (tctable->put(CACHEDTRANSFER, t, &key))
         {
-            return finduser(uh, add);
+            tctable->commit();
+        }
+        else
+        {
+            tctable->abort();
         }
-
-        return NULL;
     }
+}
 
-    string nuid;
-    User* u;
-
-    // convert e-mail address to lowercase (ASCII only)
-    Node::copystring(&nuid, uid);
-    transform(nuid.begin(), nuid.end(), nuid.begin(), ::tolower);
-
-    um_map::iterator it = umindex.find(nuid);
-
-    if (it == umindex.end())
+void MegaClient::uncachetransfer(Transfer* t)
+{
+    if (t->dbid)
     {
-        if (!add)
+        if (tctable)
         {
-            return NULL;
+            tctable->del(t->dbid);
         }
 
-        // add user by lowercase e-mail address
-        u = &users[++userid];
-        u->uid = nuid;
-        Node::copystring(&u->email, uid);
-        umindex[nuid] = userid;
-
-        return u;
+        t->dbid = 0;
     }
-    else
+}
+
+// the serialized form is kept by the caller
+struct QueuedTransferRecord : public Cachable
+{
+    string* data;
+
+    bool serialize(string* d)
     {
-        return &users[it->second];
+        d->append(*data);
+        return true;
     }
+};
+
+uint32_t MegaClient::reservequeuedtransfer()
+{
+    return tctable ? tctable->reserveid(CACHEDQUEUEDTRANSFER) : 0;
 }
 
-// locate user by binary handle
-User* MegaClient::finduser(handle uh, int add)
+// writes and deletes are consumed even if the transaction fails
+void MegaClient::cachequeuedtransfers(map<uint32_t, string>* writes, vector<uint32_t>* deletes)
 {
-    if (!uh)
+    if (tctable && (writes->size() || deletes->size()))
     {
-        return NULL;
-    }
+        QueuedTransferRecord record;
+        bool ok = true;
 
-    char uid1[12];
-    Base64::btoa((byte*)&uh, sizeof uh, uid1);
-    uid1[11] = 0;
+        tctable->begin();
 
-    User* u;
-    uh_map::iterator it = uhindex.find(uh);
+        for (map<uint32_t, string>::iterator it = writes->begin(); ok && it != writes->end(); it++)
+        {
+            record.dbid = it->first;
+            record.data = &it->second;
+            ok = tctable->putbatched(CACHEDQUEUEDTRANSFER, &record, &key);
+        }
 
-    if (it == uhindex.end())
-    {
-        if (!add)
+        ok = tctable->flushbatch() && ok;
+
+        for (unsigned i = 0; ok && i < deletes->size(); i += DbTable::DELBATCH)
         {
-            return NULL;
+            unsigned n = deletes->size() - i;
+
+            ok = tctable->delbatch(n < DbTable::DELBATCH ? n : DbTable::DELBATCH, &(*deletes)[i]);
         }
 
-        // add user by binary handle
-        u = &users[++userid];
+        if (ok)
+        {
+            tctable->commit();
+        }
+        else
+        {
+            LOG_err << "Unable to update the queued transfer records";
+            tctable->abort();
+        }
+    }
 
-        char uid[12];
-        Base64::btoa((byte*)&uh, sizeof uh, uid);
-        u->uid.assign(uid, 11);
+    writes->clear();
+    deletes->clear();
+}
 
-        uhindex[uh] = userid;
-        u->userhandle = uh;
+// the temp files of partial downloads are discarded along with the transfers
+void MegaClient::purgetransfercache()
+{
+    for (int d = GET; d == GET || d == PUT; d += PUT - GET)
+    {
+        for (transfer_map::iterator it = transfers[d].begin(); it != transfers[d].end(); it++)
+        {
+            it->second->dbid = 0;
+        }
 
-        return u;
+        for (transfer_map::iterator it = cachedtransfers[d].begin(); it != cachedtransfers[d].end(); it++)
+        {
+            it->second->dbid = 0;
+        }
     }
-    else
+
+    queuedtransfers.clear();
+
+    if (tctable)
     {
-        return &users[it->second];
+        tctable->remove();
     }
 }
 
-// add missing mapping (handle or email)
-// reduce uid to ASCII uh if only known by email
-void MegaClient::mapuser(handle uh, const char* email)
+bool MegaClient::sctablename(string* dbname)
 {
-    if (!*email)
+    if (sid.size() < SIDLEN)
     {
-        return;
+        dbname->clear();
+        return false;
     }
 
-    User* u;
-    string nuid;
+    dbname->resize((SIDLEN - sizeof key.key) * 4 / 3 + 3);
+    dbname->resize(Base64::btoa((const byte*)sid.data() + sizeof key.key, SIDLEN - sizeof key.key, (char*)dbname->c_str()));
 
-    Node::copystring(&nuid, email);
-    transform(nuid.begin(), nuid.end(), nuid.begin(), ::tolower);
+    return true;
+}
 
-    // does user uh exist?
-    uh_map::iterator hit = uhindex.find(uh);
+// the record has an id of its own below the range of Cachable records, so
+// that it is stored as is (it can not be encrypted with the master key)
+void MegaClient::cachesession()
+{
+    if (!sctable || loggedin() != FULLACCOUNT)
+    {
+        return;
+    }
 
-    if (hit != uhindex.end())
+    if (!offlinestart)
     {
-        // yes: add email reference
-        u = &users[hit->second];
+        sctable->del(CACHEDSESSION);
+        return;
+    }
+
+    string data((const char*)key.key, sizeof key.key);
+    SymmCipher cipher;
+
+    data.append((const char*)&me, sizeof me);
+    data.append(1, (char)sessionkey.size());
+    data.append(sessionkey);
+    asymkey.serializekey(&data, AsymmCipher::PRIVKEY);
+
+    sessioncipher(&cipher);
+    PaddedCBC::encrypt(&data, &cipher);
+
+    sctable->put(CACHEDSESSION, &data);
+}
+
+bool MegaClient::restoresession()
+{
+    string data;
+    SymmCipher cipher;
+
+    sessioncipher(&cipher);
+
+    if (!sctable->get(CACHEDSESSION, &data) || !PaddedCBC::decrypt(&data, &cipher)
+            || data.size() < sizeof key.key + sizeof me + 1)
+    {
+        return false;
+    }
+
+    const char* ptr = data.data() + sizeof key.key;
+    const char* end = data.data() + data.size();
+    handle h = MemAccess::get<handle>(ptr);
+    unsigned seklen = (byte)ptr[sizeof h];
+
+    ptr += sizeof h + 1;
+
+    if ((unsigned)(end - ptr) < seklen
+     || !asymkey.setkey(AsymmCipher::PRIVKEY, (const byte*)ptr + seklen, end - ptr - seklen))
+    {
+        LOG_warn << "Invalid cached session";
+        return false;
+    }
+
+    sessionkey.assign(ptr, seklen);
+    key.setkey((const byte*)data.data());
+    me = h;
+
+    return true;
+}
+
+void MegaClient::sessioncipher(SymmCipher* cipher)
+{
+    HashSHA256 hash;
+    string digest;
+
+    hash.add((const byte*)sid.data(), sid.size());
+    hash.get(&digest);
+
+    cipher->setkey((const byte*)digest.data());
+}
+
+// verify a static symmetric password challenge
+int MegaClient::checktsid(byte* sidbuf, unsigned len)
+{
+    if (len != SIDLEN)
+    {
+        return 0;
+    }
+
+    key.ecb_encrypt(sidbuf);
+
+    return !memcmp(sidbuf, sidbuf + SIDLEN - SymmCipher::KEYLENGTH, SymmCipher::KEYLENGTH);
+}
+
+// locate user by e-mail address or ASCII handle
+User* MegaClient::finduser(const char* uid, int add)
+{
+    // null user for folder links?
+    if (!uid || !*uid)
+    {
+        return NULL;
+    }
+
+    if (!strchr(uid, '@'))
+    {
+        // not an e-mail address: must be ASCII handle
+        handle uh;
+
+        if (Base64::atob(uid, (byte*)&uh, sizeof uh) == sizeof uh)
+        {
+            return finduser(uh, add);
+        }
+
+        return NULL;
+    }
+
+    string nuid;
+    User* u;
+
+    // convert e-mail address to lowercase (ASCII only)
+    Node::copystring(&nuid, uid);
+    transform(nuid.begin(), nuid.end(), nuid.begin(), ::tolower);
+
+    int id = umindex.find(nuid);
+
+    if (!id)
+    {
+        if (!add)
+        {
+            return NULL;
+        }
+
+        // add user by lowercase e-mail address
+        users.push_back(User());
+        u = &users.back();
+        userid = int(users.size());
+        u->uid = nuid;
+        Node::copystring(&u->email, uid);
+        umindex.set(nuid, userid);
+
+        return u;
+    }
+    else
+    {
+        return &users[id - 1];
+    }
+}
+
+// locate user by binary handle
+User* MegaClient::finduser(handle uh, int add)
+{
+    if (!uh)
+    {
+        return NULL;
+    }
+
+    char uid1[12];
+    Base64::btoa((byte*)&uh, sizeof uh, uid1);
+    uid1[11] = 0;
+
+    User* u;
+    int id = uhindex.find(uh);
+
+    if (!id)
+    {
+        if (!add)
+        {
+            return NULL;
+        }
+
+        // add user by binary handle
+        users.push_back(User());
+        u = &users.back();
+        userid = int(users.size());
+
+        char uid[12];
+        Base64::btoa((byte*)&uh, sizeof uh, uid);
+        u->uid.assign(uid, 11);
+
+        uhindex.set(uh, userid);
+        u->userhandle = uh;
+
+        return u;
+    }
+    else
+    {
+        return &users[id - 1];
+    }
+}
+
+// add missing mapping (handle or email)
+// reduce uid to ASCII uh if only known by email
+void MegaClient::mapuser(handle uh, const char* email)
+{
+    if (!*email)
+    {
+        return;
+    }
+
+    User* u;
+    string nuid;
+
+    Node::copystring(&nuid, email);
+    transform(nuid.begin(), nuid.end(), nuid.begin(), ::tolower);
+
+    // does user uh exist?
+    int id = uhindex.find(uh);
+
+    if (id)
+    {
+        // yes: add email reference
+        u = &users[id - 1];
 
         if (!u->email.size())
         {
             Node::copystring(&u->email, email);
-            umindex[nuid] = hit->second;
+            umindex.set(nuid, id);
         }
 
         return;
     }
 
     // does user email exist?
-    um_map::iterator mit = umindex.find(nuid);
+    id = umindex.find(nuid);
 
-    if (mit != umindex.end())
+    if (id)
     {
         // yes: add uh reference
-        u = &users[mit->second];
+        u = &users[id - 1];
 
-        uhindex[uh] = mit->second;
+        uhindex.set(uh, id);
         u->userhandle = uh;
 
         char uid[12];
@@ -5774,10 +8094,12 @@ void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares)
 {
     if (n->type != FILENODE)
     {
+        loadchildren(n);
+
         for (node_list::iterator it = n->children.begin(); it != n->children.end(); )
         {
             Node *child = *it++;
-            if (!(skipinshares && child->inshare))
+            if (!(skipinshares && child->inshare()))
             {
                 proctree(child, tp, skipinshares);
             }
@@ -5787,6 +8109,53 @@ void MegaClient::proctree(Node* n, TreeProc* tp, bool skipinshares)
     tp->proc(this, n);
 }
 
+// mark a subtree as removed without recursion: the root is notified, its
+// descendants are queued in nodepurge (unless already notified)
+void MegaClient::deltree(Node* n, bool skipinshares)
+{
+    node_vector pending;
+
+    recordnodedelta(n);
+
+    n->changed.removed = true;
+    notifynode(n);
+
+    pending.push_back(n);
+
+    while (pending.size())
+    {
+        Node* p = pending.back();
+        pending.pop_back();
+
+        if (p->type == FILENODE)
+        {
+            continue;
+        }
+
+        loadchildren(p);
+
+        for (node_list::iterator it = p->children.begin(); it != p->children.end(); it++)
+        {
+            Node* child = *it;
+
+            if (skipinshares && child->inshare())
+            {
+                continue;
+            }
+
+            child->changed.removed = true;
+
+            if (!child->notified)
+            {
+                child->notified = true;
+                nodepurge.push_back(child);
+            }
+
+            pending.push_back(child);
+        }
+    }
+}
+
 // queue PubKeyAction request to be triggered upon availability of the user's
 // public key
 void MegaClient::queuepubkeyreq(User* u, PubKeyAction* pka)
@@ -5825,8 +8194,8 @@ void MegaClient::rewriteforeignkeys(Node* n)
 // otherwise, queue and request public key if not already pending
 void MegaClient::setshare(Node* n, const char* user, accesslevel_t a, const char* personal_representation)
 {
-    int total = n->outshares ? n->outshares->size() : 0;
-    total += n->pendingshares ? n->pendingshares->size() : 0;
+    int total = n->outshares() ? n->outshares()->size() : 0;
+    total += n->pendingshares() ? n->pendingshares()->size() : 0;
     if (a == ACCESS_UNKNOWN && total == 1)
     {
         // rewrite keys of foreign nodes located in the outbound share that is getting canceled
@@ -6084,8 +8453,25 @@ void MegaClient::getua(User* u, const char* an)
 }
 
 // queue node for notification
+// only the state before the first change is kept
+void MegaClient::recordnodedelta(Node* n, const char* prevname)
+{
+    if (fetchingnodes || nodedeltas.find(n->nodehandle) != nodedeltas.end())
+    {
+        return;
+    }
+
+    NodeDelta* delta = &nodedeltas[n->nodehandle];
+
+    delta->parenthandle = n->parent ? n->parent->nodehandle : n->parenthandle;
+    delta->name = prevname ? prevname : n->displayname();
+    delta->storage = n->subtree.storage;
+}
+
 void MegaClient::notifynode(Node* n)
 {
+    sccommitted = false;
+
     n->applykey();
 
     if (n->tag && !n->changed.removed && n->attrstring)
@@ -6124,6 +8510,22 @@ void MegaClient::notifynode(Node* n)
     }
 
 #ifdef ENABLE_SYNC
+    // flag the LocalNode subtrees affected by this change: the node's own
+    // LocalNode and the nearest synced folder it is (now) located in
+    if (n->localnode && n->localnode != (LocalNode*)~0)
+    {
+        n->localnode->setdirty();
+    }
+
+    for (Node* p = n->parent; p; p = p->parent)
+    {
+        if (p->localnode && p->localnode != (LocalNode*)~0)
+        {
+            p->localnode->setdirty();
+            break;
+        }
+    }
+
     // is this a synced node that was moved to a non-synced location? queue for
     // deletion from LocalNodes.
     if (n->localnode && n->localnode->parent && n->parent && !n->parent->localnode)
@@ -6318,7 +8720,7 @@ void MegaClient::procsnk(JSON* j)
 
             Node* sn = nodebyhandle(sh);
 
-            if (sn && sn->sharekey && checkaccess(sn, OWNER))
+            if (sn && sn->sharekey() && checkaccess(sn, OWNER))
             {
                 Node* n = nodebyhandle(nh);
 
@@ -6326,7 +8728,7 @@ void MegaClient::procsnk(JSON* j)
                 {
                     byte keybuf[FILENODEKEYLENGTH];
 
-                    sn->sharekey->ecb_encrypt((byte*)n->nodekey.data(), keybuf, n->nodekey.size());
+                    sn->sharekey()->ecb_encrypt((byte*)n->nodekey.data(), keybuf, n->nodekey.size());
 
                     reqs.add(new CommandSingleKeyCR(sh, nh, keybuf, n->nodekey.size()));
                 }
@@ -6401,7 +8803,7 @@ void MegaClient::cr_response(node_vector* shares, node_vector* nodes, JSON* sele
     // shares
     for (si = shares->size(); si--; )
     {
-        if ((*shares)[si] && ((*shares)[si]->inshare || !(*shares)[si]->sharekey))
+        if ((*shares)[si] && ((*shares)[si]->inshare() || !(*shares)[si]->sharekey()))
         {
             LOG_warn << "Attempt to obtain node key for invalid/third-party share foiled";
             (*shares)[si] = NULL;
@@ -6473,7 +8875,7 @@ void MegaClient::cr_response(node_vector* shares, node_vector* nodes, JSON* sele
                 {
                     if (setkey == (int)n->nodekey.size())
                     {
-                        sn->sharekey->ecb_decrypt(keybuf, n->nodekey.size());
+                        sn->sharekey()->ecb_decrypt(keybuf, n->nodekey.size());
                         n->setkey(keybuf);
                         setkey = -1;
                     }
@@ -6481,7 +8883,7 @@ void MegaClient::cr_response(node_vector* shares, node_vector* nodes, JSON* sele
                 else
                 {
                     n->applykey();
-                    if (sn->sharekey && n->nodekey.size() ==
+                    if (sn->sharekey() && n->nodekey.size() ==
                             ((n->type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH))
                     {
                         unsigned nsi, nni;
@@ -6492,7 +8894,7 @@ void MegaClient::cr_response(node_vector* shares, node_vector* nodes, JSON* sele
                         sprintf(buf, "\",%u,%u,\"", nsi, nni);
 
                         // generate & queue share nodekey
-                        sn->sharekey->ecb_encrypt((byte*)n->nodekey.data(), keybuf, n->nodekey.size());
+                        sn->sharekey()->ecb_encrypt((byte*)n->nodekey.data(), keybuf, n->nodekey.size());
                         Base64::btoa(keybuf, n->nodekey.size(), strchr(buf + 7, 0));
                         crkeys.append(buf);
                     }
@@ -6520,6 +8922,41 @@ void MegaClient::getaccountdetails(AccountDetails* ad, bool storage,
                                    bool transfer, bool pro, bool transactions,
                                    bool purchases, bool sessions)
 {
+    int parts = (storage ? 1 : 0) | (transfer ? 2 : 0) | (pro ? 4 : 0);
+
+    // quota queries are answered from the cache while it's fresh
+    if (!transactions && !purchases && !sessions && accountcachettl
+            && parts && (accountcacheparts & parts) == parts
+            && Waiter::ds - accountcachetime < accountcachettl)
+    {
+        *ad = accountcache;
+
+        if ((accountcacheparts & 1) && !fetchingnodes)
+        {
+            ad->storage_used += localstorage() - accountcachelocal;
+
+            for (int i = 0; i < (int)(sizeof rootnodes / sizeof *rootnodes); i++)
+            {
+                Node* n;
+                handlestorage_map::iterator it = ad->storage.find(rootnodes[i]);
+
+                if (it != ad->storage.end() && (n = nodebyhandle(rootnodes[i])))
+                {
+                    it->second.bytes = n->subtree.storage;
+                    it->second.files = n->subtree.files;
+                    it->second.folders = n->subtree.folders - 1;
+                }
+            }
+        }
+
+        LOG_debug << "Account details served from the cache";
+
+        restag = reqtag;
+        app->account_details(ad, (accountcacheparts & 1) != 0, (accountcacheparts & 2) != 0,
+                             (accountcacheparts & 4) != 0, false, false, false);
+        return;
+    }
+
     reqs.add(new CommandGetUserQuota(this, ad, storage, transfer, pro));
 
     if (transactions)
@@ -6538,14 +8975,56 @@ void MegaClient::getaccountdetails(AccountDetails* ad, bool storage,
     }
 }
 
+// keep the quota part of fetched account details
+void MegaClient::cacheaccountdetails(AccountDetails* ad, bool storage, bool transfer, bool pro)
+{
+    accountcache = *ad;
+    accountcache.sessions.clear();
+    accountcache.purchases.clear();
+    accountcache.transactions.clear();
+
+    accountcacheparts = (storage ? 1 : 0) | (transfer ? 2 : 0) | (pro ? 4 : 0);
+    accountcachetime = Waiter::ds;
+    accountcachelocal = fetchingnodes ? 0 : localstorage();
+
+    // the local tree can't keep the storage figures current yet
+    if (fetchingnodes)
+    {
+        accountcacheparts &= ~1;
+    }
+}
+
+void MegaClient::invalidateaccountdetails()
+{
+    accountcacheparts = 0;
+}
+
+// storage used by the nodes under the root nodes, as known locally
+m_off_t MegaClient::localstorage()
+{
+    m_off_t total = 0;
+
+    for (int i = 0; i < (int)(sizeof rootnodes / sizeof *rootnodes); i++)
+    {
+        Node* n = nodebyhandle(rootnodes[i]);
+
+        if (n)
+        {
+            total += n->subtree.storage;
+        }
+    }
+
+    return total;
+}
+
 // export node link
 error MegaClient::exportnode(Node* n, int del, m_time_t ets)
 {
-    if (n->plink && !del && !n->plink->takendown
-            && (ets == n->plink->ets) && !n->plink->isExpired())
+    if (n->plink() && !del && !n->plink()->takendown
+            && (ets == n->plink()->ets) && !n->plink()->isExpired())
     {
         restag = reqtag;
-        app->exportnode_result(n->nodehandle, n->plink->ph);
+        app->exportnode_result(n->nodehandle, n->plink()->ph);
         return API_OK;
     }
 
@@ -6796,21 +9275,58 @@ int MegaClient::inited25519()
 }
 #endif
 
+// records are read in batches of NODESTREAMBATCH and decrypted on the
+// workers, then unserialized and linked on this thread
 bool MegaClient::fetchsc(DbTable* sctable)
 {
-    uint32_t id;
-    string data;
+    AllocScope allocscope(AllocTags::CACHE);
+
+    uint32_t ids[NODESTREAMBATCH];
+    bool ok[NODESTREAMBATCH];
+    vector<string> records(NODESTREAMBATCH);
+    unsigned count = 0, i = 0;
     Node* n;
     User* u;
     PendingContactRequest* pcr;
     node_vector dp;
+    node_vector rewrite;
 
     LOG_info << "Loading session from local cache";
 
+    // node records are skipped if the nodes could be read from a snapshot
+    bool snapshot = !sctable->reindex && readsnapshot(&dp);
+
     sctable->rewind();
 
-    while (sctable->next(&id, &data, &key))
+    for (;;)
     {
+        if (i == count)
+        {
+            // paged mode: keep the resident file nodes bounded while
+            // loading (except during a one-time upgrade, which needs all
+            // of them)
+            if (pagednodes && count && rewrite.empty() && !sctable->reindex)
+            {
+                trimnodes();
+            }
+
+            if (!(count = sctable->nextbatch(NODESTREAMBATCH, ids, &records[0], ok, &key, workers, snapshot ? CACHEDNODE : -1)))
+            {
+                break;
+            }
+
+            i = 0;
+        }
+
+        // an undecryptable record ends the cache as read so far
+        if (!ok[i])
+        {
+            break;
+        }
+
+        uint32_t id = ids[i];
+        string& data = records[i++];
+
         switch (id & 15)
         {
             case CACHEDSCSN:
@@ -6824,6 +9340,12 @@ bool MegaClient::fetchsc(DbTable* sctable)
                 if ((n = Node::unserialize(this, &data, &dp)))
                 {
                     n->dbid = id;
+
+                    // legacy format or lacking the lookup columns
+                    if (sctable->reindex || Node::legacyrecord(&data))
+                    {
+                        rewrite.push_back(n);
+                    }
                 }
                 else
                 {
@@ -6868,10 +9390,259 @@ bool MegaClient::fetchsc(DbTable* sctable)
 
     mergenewshares(0);
 
-    return true;
-}
+    // migrate node records written in the legacy format or before the
+    // table had lookup columns
+    if (rewrite.size())
+    {
+        LOG_info << "Upgrading " << rewrite.size() << " cached nodes";
 
-void MegaClient::fetchnodes()
+        sctable->begin();
+
+        bool complete = true;
+
+        for (node_vector::iterator it = rewrite.begin(); complete && it != rewrite.end(); it++)
+        {
+            complete = sctable->putbatched(CACHEDNODE, *it, &key);
+        }
+
+        if (sctable->flushbatch() && complete)
+        {
+            sccommit();
+            sctable->reindex = false;
+        }
+        else
+        {
+            LOG_err << "Failed to upgrade cached nodes";
+            sctable->abort();
+        }
+    }
+
+    // evicted nodes must be found through the lookup columns
+    if (pagednodes && !sctable->reindex)
+    {
+        nodepaging = true;
+        trimnodes();
+    }
+
+    return true;
+}
+
+// AES-CTR under a key derived from the master key, in slices of
+// SNAPSHOTCHUNK whose MACs are condensed as for files - the payload is
+// padded to the block size
+void MegaClient::snapshotcrypt(string* payload, handle nonce, byte* mac, bool encrypt)
+{
+    byte buf[SymmCipher::BLOCKSIZE] = "nodesnapshotkey";
+
+    key.ecb_encrypt(buf);
+
+    SymmCipher snapshotkey(buf);
+
+    memset(mac, 0, SymmCipher::BLOCKSIZE);
+
+    for (size_t pos = 0; pos < payload->size(); pos += SNAPSHOTCHUNK)
+    {
+        size_t len = payload->size() - pos;
+
+        snapshotkey.ctr_crypt((byte*)payload->data() + pos, len < SNAPSHOTCHUNK ? (unsigned)len : SNAPSHOTCHUNK,
+                              pos, nonce, buf, encrypt);
+
+        SymmCipher::xorblock(buf, mac);
+        snapshotkey.ecb_encrypt(mac);
+    }
+}
+
+// written through a temporary file, so that an interrupted write leaves no
+// snapshot behind
+void MegaClient::writesnapshot()
+{
+    string path, tmppath, localpath, localtmppath;
+
+    if (!sctable || !sccommitted || nodepaging || nodenotify.size() || ISUNDEF(cachedscsn) || !sctable->sidecar(&path))
+    {
+        return;
+    }
+
+    string data(SNAPSHOTHEADER, 0);
+    unsigned count = 0;
+
+    for (node_map::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        Node* n = it->second;
+        size_t p = data.size();
+
+        if (!n->dbid)
+        {
+            continue;
+        }
+
+        data.resize(p + 2 * sizeof(uint32_t));
+
+        if (!n->serialize(&data))
+        {
+            data.resize(p);
+            continue;
+        }
+
+        MemAccess::set<uint32_t>((byte*)data.data() + p, n->dbid);
+        MemAccess::set<uint32_t>((byte*)data.data() + p + sizeof(uint32_t), (uint32_t)(data.size() - p - 2 * sizeof(uint32_t)));
+        count++;
+    }
+
+    string payload = data.substr(SNAPSHOTHEADER);
+    handle nonce;
+    byte mac[SymmCipher::BLOCKSIZE];
+
+    data.resize(SNAPSHOTHEADER);
+    payload.resize((payload.size() + SymmCipher::BLOCKSIZE - 1) & - SymmCipher::BLOCKSIZE);
+
+    PrnGen::genblock((byte*)&nonce, sizeof nonce);
+    snapshotcrypt(&payload, nonce, mac, true);
+
+    memcpy((char*)data.data(), SNAPSHOTMAGIC, 8);
+    MemAccess::set<handle>((byte*)data.data() + 8, cachedscsn);
+    MemAccess::set<handle>((byte*)data.data() + 16, nonce);
+    MemAccess::set<uint64_t>((byte*)data.data() + 24, payload.size());
+    memcpy((char*)data.data() + 32, mac, sizeof mac);
+
+    tmppath = path + ".tmp";
+    fsaccess->path2local(&path, &localpath);
+    fsaccess->path2local(&tmppath, &localtmppath);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool written = false;
+
+    fsaccess->unlinklocal(&localtmppath);
+
+    if (fa->fopen(&localtmppath, false, true))
+    {
+        written = fa->fwrite((const byte*)data.data(), SNAPSHOTHEADER, 0);
+
+        for (size_t pos = 0; written && pos < payload.size(); pos += SNAPSHOTCHUNK)
+        {
+            size_t len = payload.size() - pos;
+
+            written = fa->fwrite((const byte*)payload.data() + pos, len < SNAPSHOTCHUNK ? (unsigned)len : SNAPSHOTCHUNK,
+                                 SNAPSHOTHEADER + pos);
+        }
+    }
+
+    delete fa;
+
+    if (written && fsaccess->renamelocal(&localtmppath, &localpath, true))
+    {
+        LOG_info << "Node snapshot written: " << count << " nodes, " << payload.size() << " bytes";
+    }
+    else
+    {
+        LOG_warn << "Unable to write node snapshot";
+        fsaccess->unlinklocal(&localtmppath);
+    }
+}
+
+// read and remove the snapshot - false if there is none, or if it does not
+// match the statecache, in which case no node has been created
+bool MegaClient::readsnapshot(node_vector* dp)
+{
+    string path, localpath, data;
+
+    if (!snapshotnodes || pagednodes || !sctable->sidecar(&path))
+    {
+        return false;
+    }
+
+    fsaccess->path2local(&path, &localpath);
+
+    FileAccess* fa = fsaccess->newfileaccess();
+    bool read = false;
+
+    if (fa->fopen(&localpath, true, false) && fa->size >= SNAPSHOTHEADER)
+    {
+        data.resize((size_t)fa->size);
+        read = true;
+
+        for (size_t pos = 0; read && pos < data.size(); pos += SNAPSHOTCHUNK)
+        {
+            size_t len = data.size() - pos;
+
+            read = fa->frawread((byte*)data.data() + pos, len < SNAPSHOTCHUNK ? (unsigned)len : SNAPSHOTCHUNK, pos);
+        }
+    }
+
+    delete fa;
+
+    if (!read)
+    {
+        return false;
+    }
+
+    // consumed: the statecache moves on from here
+    fsaccess->unlinklocal(&localpath);
+
+    string payload = data.substr(SNAPSHOTHEADER);
+    byte mac[SymmCipher::BLOCKSIZE];
+
+    if (memcmp(data.data(), SNAPSHOTMAGIC, 8)
+     || MemAccess::get<handle>(data.data() + 8) != cachedscsn
+     || MemAccess::get<uint64_t>(data.data() + 24) != payload.size()
+     || (payload.size() & (SymmCipher::BLOCKSIZE - 1)))
+    {
+        LOG_warn << "Outdated or invalid node snapshot";
+        return false;
+    }
+
+    snapshotcrypt(&payload, MemAccess::get<handle>(data.data() + 16), mac, false);
+
+    if (memcmp(mac, data.data() + 32, sizeof mac))
+    {
+        LOG_err << "Node snapshot MAC mismatch";
+        return false;
+    }
+
+    const char* ptr = payload.data();
+    const char* end = ptr + payload.size();
+    string record;
+    unsigned count = 0;
+    Node* n;
+
+    // the block padding is shorter than a record header
+    while (ptr + 2 * sizeof(uint32_t) <= end)
+    {
+        uint32_t dbid = MemAccess::get<uint32_t>(ptr);
+        uint32_t len = MemAccess::get<uint32_t>(ptr + sizeof(uint32_t));
+
+        ptr += 2 * sizeof(uint32_t);
+
+        if (!dbid)
+        {
+            break;
+        }
+
+        if (ptr + len > end)
+        {
+            LOG_err << "Truncated node snapshot";
+            return false;
+        }
+
+        record.assign(ptr, len);
+        ptr += len;
+
+        if (!(n = Node::unserialize(this, &record, dp)))
+        {
+            LOG_err << "Failed - node snapshot record read error";
+            return false;
+        }
+
+        n->dbid = dbid;
+        count++;
+    }
+
+    LOG_info << "Node snapshot read: " << count << " nodes";
+
+    return true;
+}
+
+void MegaClient::fetchnodes()
 {
     opensctable();
 
@@ -6896,7 +9667,11 @@ void MegaClient::fetchnodes()
             memset(&(it->second->changed), 0, sizeof it->second->changed);
         }
 
+        // not written by initsc() on caches from before
+        cachesession();
+
         sctable->begin();
+        sccommitted = true;
 
         Base64::btoa((byte*)&cachedscsn, sizeof cachedscsn, scsn);
         LOG_info << "Session loaded from local cache. SCSN: " << scsn;
@@ -6908,9 +9683,12 @@ void MegaClient::fetchnodes()
         // prevent the processing of previous sc requests
         delete pendingsc;
         pendingsc = NULL;
+        delete nextsc;
+        nextsc = NULL;
         jsonsc.pos = NULL;
         scnotifyurl.clear();
         insca = false;
+        catchingup = false;
         btsc.reset();
 
         // don't allow to start new sc requests yet
@@ -6924,6 +9702,55 @@ void MegaClient::fetchnodes()
 #endif
 
         reqs.add(new CommandFetchNodes(this));
+
+        warmup();
+    }
+}
+
+// the response of the storage server doesn't matter - the connection stays
+// in the HttpIO's pool and the DNS entry and TLS session in its caches
+void MegaClient::warmup()
+{
+    vector<string> urls;
+
+    hoststats.recent(&urls, WARMUPHOSTS);
+
+    for (unsigned i = 0; i < urls.size(); i++)
+    {
+        HttpReq* req = new HttpReq(true);
+
+        req->posturl = urls[i];
+        req->post(this);
+
+        warmupreqs.push_back(req);
+    }
+
+    if (urls.size())
+    {
+        LOG_debug << "Connecting to " << urls.size() << " storage servers ahead of the transfers";
+    }
+}
+
+// the transfers find the URLs in the cache when they start (see dispatch())
+void MegaClient::prefetchtempurls(handle_vector* handles)
+{
+    for (handle_vector::iterator it = handles->begin(); it != handles->end(); it++)
+    {
+        Node* n = nodebyhandle(*it);
+        handle h = *it;
+        m_off_t size;
+
+        if (!n || n->type != FILENODE || n->nodekey.size() < FILENODEKEYLENGTH)
+        {
+            continue;
+        }
+
+        encodehandletype(&h, true);
+
+        if (!tempurls.get(h, &size))
+        {
+            reqs.add(new CommandGetFile(NULL, (byte*)n->nodekey.data(), n->nodehandle, true, NULL, true));
+        }
     }
 }
 
@@ -6952,6 +9779,15 @@ void MegaClient::purgenodesusersabortsc()
     }
 
     nodes.clear();
+    nodesdeferred = false;
+    pagedlru.clear();
+    nodepaging = false;
+
+    // return the node slab's chunks to the heap
+    if (!nodeslab.release())
+    {
+        LOG_warn << "Node slab still in use: " << nodeslab.inuse;
+    }
 
 #ifdef ENABLE_SYNC
     todebris.clear();
@@ -6980,9 +9816,13 @@ void MegaClient::purgenodesusersabortsc()
     newshares.clear();
 
     nodenotify.clear();
+    nodedeltas.clear();
+    nodepurge.clear();
     usernotify.clear();
+    invalidateaccountdetails();
     pcrnotify.clear();
     users.clear();
+    userid = 0;
     uhindex.clear();
     umindex.clear();
     pcrindex.clear();
@@ -6995,54 +9835,257 @@ void MegaClient::purgenodesusersabortsc()
         pendingsc->disconnect();
     }
 
-    init();
+    init();
+}
+
+// request direct read by node pointer
+void MegaClient::pread(Node* n, m_off_t count, m_off_t offset, void* appdata)
+{
+    queueread(n->nodehandle, true, n->nodecipher(), MemAccess::get<int64_t>((const char*)n->nodekey.data() + SymmCipher::KEYLENGTH), count, offset, appdata);
+}
+
+// request direct read by exported handle / key
+void MegaClient::pread(handle ph, SymmCipher* key, int64_t ctriv, m_off_t count, m_off_t offset, void* appdata)
+{
+    queueread(ph, false, key, ctriv, count, offset, appdata);
+}
+
+// since only the first six bytes of a handle are in use, we use the seventh to encode its type
+void MegaClient::encodehandletype(handle* hp, bool p)
+{
+    if (p)
+    {
+        ((char*)hp)[NODEHANDLE] = 1;
+    }
+}
+
+bool MegaClient::isprivatehandle(handle* hp)
+{
+    return ((char*)hp)[NODEHANDLE] != 0;
+}
+
+void MegaClient::queueread(handle h, bool p, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, void* appdata)
+{
+    handledrn_map::iterator it;
+
+    encodehandletype(&h, p);
+
+    m_off_t readahead = drcache.access(h, offset, count ? offset + count : -1);
+
+    // serve the cached beginning of the range
+    const string* block;
+
+    while ((block = drcache.get(h, offset / DirectReadCache::BLOCKSIZE)))
+    {
+        m_off_t skip = offset % DirectReadCache::BLOCKSIZE;
+        m_off_t l = (m_off_t)block->size() - skip;
+
+        if (l <= 0)
+        {
+            break;
+        }
+
+        if (count && l > count)
+        {
+            l = count;
+        }
+
+        if (!app->pread_data((byte*)block->data() + skip, l, offset, appdata))
+        {
+            return;
+        }
+
+        offset += l;
+
+        if (count)
+        {
+            if (!(count -= l))
+            {
+                return;
+            }
+        }
+        else if (block->size() < DirectReadCache::BLOCKSIZE)
+        {
+            // end of file
+            return;
+        }
+    }
+
+    it = hdrns.find(h);
+
+    if (it == hdrns.end())
+    {
+        // this handle is not being accessed yet: insert
+        it = hdrns.insert(hdrns.end(), pair<handle, DirectReadNode*>(h, new DirectReadNode(this, h, p, key, ctriv)));
+        it->second->hdrn_it = it;
+        it->second->enqueue(offset, count, reqtag, appdata)->readahead = readahead;
+        it->second->dispatch();
+    }
+    else
+    {
+        DirectReadNode* drn = it->second;
+
+        drn->enqueue(offset, count, reqtag, appdata)->readahead = readahead;
+
+        // idle node of an open handle
+        if (!drn->tempurl.size() && !drn->pendingcmd && drn->dsdrn_it == dsdrns.end())
+        {
+            drn->dispatch();
+        }
+    }
+}
+
+void MegaClient::prefetch(Node* n, m_off_t offset, m_off_t count, bool idle)
+{
+    queueprefetch(n->nodehandle, true, n->nodecipher(), MemAccess::get<int64_t>((const char*)n->nodekey.data() + SymmCipher::KEYLENGTH), offset, count, idle);
+}
+
+void MegaClient::prefetch(handle ph, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, bool idle)
+{
+    queueprefetch(ph, false, key, ctriv, offset, count, idle);
+}
+
+void MegaClient::prefetchabort(Node* n)
+{
+    abortprefetches(n->nodehandle, true);
+}
+
+void MegaClient::prefetchabort(handle ph)
+{
+    abortprefetches(ph, false);
+}
+
+void MegaClient::queueprefetch(handle h, bool p, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, bool idle)
+{
+    handledrn_map::iterator it;
+    m_off_t budget = drcache.maxbytes() / 2;
+
+    if (count <= 0 || offset < 0 || !budget)
+    {
+        return;
+    }
+
+    if (count > budget)
+    {
+        count = budget;
+    }
+
+    encodehandletype(&h, p);
+
+    // skip the cached beginning of the range
+    const string* block;
+
+    while (count > 0 && (block = drcache.get(h, offset / DirectReadCache::BLOCKSIZE)))
+    {
+        m_off_t l = (m_off_t)block->size() - offset % DirectReadCache::BLOCKSIZE;
+
+        if (l <= 0 || block->size() < DirectReadCache::BLOCKSIZE)
+        {
+            // end of file
+            return;
+        }
+
+        offset += l;
+        count -= l;
+    }
+
+    if (count <= 0)
+    {
+        return;
+    }
+
+    DirectRead* dr;
+
+    if ((it = hdrns.find(h)) == hdrns.end())
+    {
+        it = hdrns.insert(hdrns.end(), pair<handle, DirectReadNode*>(h, new DirectReadNode(this, h, p, key, ctriv)));
+        it->second->hdrn_it = it;
+        dr = it->second->enqueue(offset, count, reqtag, NULL);
+        it->second->dispatch();
+    }
+    else
+    {
+        DirectReadNode* drn = it->second;
+
+        dr = drn->enqueue(offset, count, reqtag, NULL);
+
+        if (!drn->tempurl.size() && !drn->pendingcmd && drn->dsdrn_it == dsdrns.end())
+        {
+            drn->dispatch();
+        }
+    }
+
+    dr->prefetch = true;
+    dr->idle = idle;
 }
 
-// request direct read by node pointer
-void MegaClient::pread(Node* n, m_off_t count, m_off_t offset, void* appdata)
+void MegaClient::abortprefetches(handle h, bool p)
 {
-    queueread(n->nodehandle, true, n->nodecipher(), MemAccess::get<int64_t>((const char*)n->nodekey.data() + SymmCipher::KEYLENGTH), count, offset, appdata);
-}
+    handledrn_map::iterator it;
 
-// request direct read by exported handle / key
-void MegaClient::pread(handle ph, SymmCipher* key, int64_t ctriv, m_off_t count, m_off_t offset, void* appdata)
-{
-    queueread(ph, false, key, ctriv, count, offset, appdata);
-}
+    encodehandletype(&h, p);
 
-// since only the first six bytes of a handle are in use, we use the seventh to encode its type
-void MegaClient::encodehandletype(handle* hp, bool p)
-{
-    if (p)
+    if ((it = hdrns.find(h)) != hdrns.end())
     {
-        ((char*)hp)[NODEHANDLE] = 1;
+        DirectReadNode* drn = it->second;
+
+        for (dr_list::iterator it = drn->reads.begin(); it != drn->reads.end(); )
+        {
+            if ((*it)->prefetch)
+            {
+                delete *(it++);
+            }
+            else it++;
+        }
     }
 }
 
-bool MegaClient::isprivatehandle(handle* hp)
+void MegaClient::preadopen(Node* n)
 {
-    return ((char*)hp)[NODEHANDLE] != 0;
+    openreads(n->nodehandle, true, n->nodecipher(), MemAccess::get<int64_t>((const char*)n->nodekey.data() + SymmCipher::KEYLENGTH));
 }
 
-void MegaClient::queueread(handle h, bool p, SymmCipher* key, int64_t ctriv, m_off_t offset, m_off_t count, void* appdata)
+void MegaClient::preadopen(handle ph, SymmCipher* key, int64_t ctriv)
+{
+    openreads(ph, false, key, ctriv);
+}
+
+// the node is created right away to have the tempurl ready for the first read
+void MegaClient::openreads(handle h, bool p, SymmCipher* key, int64_t ctriv)
 {
     handledrn_map::iterator it;
 
     encodehandletype(&h, p);
 
-    it = hdrns.find(h);
-
-    if (it == hdrns.end())
+    if ((it = hdrns.find(h)) == hdrns.end())
     {
-        // this handle is not being accessed yet: insert
         it = hdrns.insert(hdrns.end(), pair<handle, DirectReadNode*>(h, new DirectReadNode(this, h, p, key, ctriv)));
         it->second->hdrn_it = it;
-        it->second->enqueue(offset, count, reqtag, appdata);
+        it->second->pins++;
         it->second->dispatch();
     }
     else
     {
-        it->second->enqueue(offset, count, reqtag, appdata);
+        it->second->pins++;
+    }
+}
+
+// by handle, as the node may be gone by now
+void MegaClient::preadclose(handle h, bool p)
+{
+    handledrn_map::iterator it;
+
+    encodehandletype(&h, p);
+
+    if ((it = hdrns.find(h)) != hdrns.end() && it->second->pins)
+    {
+        DirectReadNode* drn = it->second;
+
+        // with reads in progress, the node expires as usual
+        if (!--drn->pins && drn->reads.empty())
+        {
+            delete drn;
+        }
     }
 }
 
@@ -7073,7 +10116,11 @@ void MegaClient::abortreads(handle h, bool p, m_off_t offset, m_off_t count)
         {
             if ((offset < 0 || offset == (*it)->offset) && (count < 0 || count == (*it)->count))
             {
-                app->pread_failure(API_EINCOMPLETE, (*it)->drn->retries, (*it)->appdata);
+                // reads that are only reading ahead have already completed
+                if (!(*it)->delivered && !(*it)->prefetch)
+                {
+                    app->pread_failure(API_EINCOMPLETE, (*it)->drn->retries, (*it)->appdata);
+                }
 
                 delete *(it++);
             }
@@ -7090,16 +10137,48 @@ bool MegaClient::execdirectreads()
 
     if (drq.size() < MAXDRSLOTS)
     {
+        bool waiting = false;
+        dr_list::iterator it;
+
         // fill slots
-        for (dr_list::iterator it = drq.begin(); it != drq.end(); it++)
+        for (it = drq.begin(); it != drq.end(); it++)
         {
-            if (!(*it)->drs)
+            if (!(*it)->drs && !(*it)->idle)
             {
                 drs = new DirectReadSlot(*it);
                 (*it)->drs = drs;
                 r = true;
 
-                if (drq.size() >= MAXDRSLOTS) break;
+                if (drq.size() >= MAXDRSLOTS)
+                {
+                    waiting = true;
+                    break;
+                }
+            }
+        }
+
+        // then idle prefetches
+        if (!waiting)
+        {
+            int idleslots = 0;
+
+            for (drs_list::iterator sit = drss.begin(); sit != drss.end(); sit++)
+            {
+                if ((*sit)->dr->idle)
+                {
+                    idleslots++;
+                }
+            }
+
+            for (it = drq.begin(); it != drq.end() && idleslots < MAXIDLEPREFETCHSLOTS; it++)
+            {
+                if (!(*it)->drs && (*it)->idle)
+                {
+                    drs = new DirectReadSlot(*it);
+                    (*it)->drs = drs;
+                    idleslots++;
+                    r = true;
+                }
             }
         }
     }
@@ -7136,6 +10215,8 @@ void MegaClient::updateputs()
 // (FIXME: perform the same check for local paths!)
 error MegaClient::addsync(string* rootpath, const char* debris, string* localdebris, Node* remotenode, fsfp_t fsfp, int tag)
 {
+    AllocScope allocscope(AllocTags::SYNC);
+
 #ifdef ENABLE_SYNC
     // cannot sync files, rubbish bins or inboxes
     if (remotenode->type != FOLDERNODE && remotenode->type != ROOTNODE)
@@ -7176,11 +10257,11 @@ error MegaClient::addsync(string* rootpath, const char* debris, string* localdeb
             }
         }
         
-        if (n->inshare && !inshare)
+        if (n->inshare() && !inshare)
         {
             // we need FULL access to sync
             // FIXME: allow downsyncing from RDONLY and limited syncing to RDWR shares
-            if (n->inshare->access != FULL) return API_EACCESS;
+            if (n->inshare()->access != FULL) return API_EACCESS;
 
             inshare = true;
         }
@@ -7192,13 +10273,13 @@ error MegaClient::addsync(string* rootpath, const char* debris, string* localdeb
         // are no access restrictions in place anywhere in the sync's tree
         for (user_map::iterator uit = users.begin(); uit != users.end(); uit++)
         {
-            User* u = &uit->second;
+            User* u = &*uit;
 
             if (u->sharing.size())
             {
                 for (handle_set::iterator sit = u->sharing.begin(); sit != u->sharing.end(); sit++)
                 {
-                    if ((n = nodebyhandle(*sit)) && n->inshare && n->inshare->access != FULL)
+                    if ((n = nodebyhandle(*sit)) && n->inshare() && n->inshare()->access != FULL)
                     {
                         do {
                             if (n == remotenode)
@@ -7237,6 +10318,11 @@ error MegaClient::addsync(string* rootpath, const char* debris, string* localdeb
             fsaccess->local2path(rootpath, &utf8path);
             LOG_debug << "Adding sync: " << utf8path;
 
+            if (nodesdeferred)
+            {
+                decryptnodes(remotenode);
+            }
+
             Sync* sync = new Sync(this, rootpath, debris, localdebris, remotenode, fsfp, inshare, tag);
 
             if (sync->scan(rootpath, fa))
@@ -7345,12 +10431,22 @@ void MegaClient::addchild(remotenode_map* nchildren, string* name, Node* n, list
 // returns false if any local fs op failed transiently
 bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 {
+    AllocScope allocscope(AllocTags::SYNC);
+
     // only use for LocalNodes with a corresponding and properly linked Node
     if (l->type != FOLDERNODE || !l->node || (l->parent && l->node->parent->localnode != l->parent))
     {
         return true;
     }
 
+    // nothing changed in this subtree since the last pass
+    if (!(l->dirty & LocalNode::DIRTY_SYNCDOWN))
+    {
+        return true;
+    }
+
+    l->dirty &= ~LocalNode::DIRTY_SYNCDOWN;
+
     list<string> strings;
     remotenode_map nchildren;
     remotenode_map::iterator rit;
@@ -7361,6 +10457,13 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
     // remote children by name
     string localname;
 
+    loadchildren(l->node);
+
+    if (nodesdeferred)
+    {
+        decryptchildren(l->node);
+    }
+
     // build child hash - nameclash resolution: use newest/largest version
     for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
     {
@@ -7601,6 +10704,31 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
                 delete f;
                 rit->second->localnode = NULL;
 
+                // the content may already be in one of the syncs (e.g. a
+                // file duplicated or reorganised remotely): copy it locally,
+                // the copy is then picked up by the scan like any new file
+                LocalNode* dup;
+                if (download && !rit->second->syncget && (dup = localnodebyfingerprint(rit->second)))
+                {
+                    string duppath;
+
+                    dup->getlocalpath(&duppath);
+
+                    if (fsaccess->copylocal(&duppath, localpath, rit->second->mtime))
+                    {
+                        LOG_debug << "File copied from a local file with the same content: " << dup->name;
+                        fsaccess->local2path(localpath, &localname);
+                        app->syncupdate_get(l->sync, rit->second, localname.c_str());
+                        syncactivity = true;
+                        download = false;
+                    }
+                    else
+                    {
+                        LOG_debug << "Local copy failed, downloading instead";
+                        fsaccess->unlinklocal(localpath);
+                    }
+                }
+
                 // start fetching this node, unless fetch is already in progress
                 // FIXME: to cover renames that occur during the
                 // download, reconstruct localname in complete()
@@ -7613,6 +10741,7 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
                     rit->second->syncget = new SyncFileGet(l->sync, rit->second, localpath);
                     nextreqtag();
                     startxfer(GET, rit->second->syncget);
+                    l->sync->metrics.downloads++;
                     syncactivity = true;
                 }
             }
@@ -7658,6 +10787,12 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
         localpath->resize(t);
     }
 
+    if (!success)
+    {
+        // retry this subtree
+        l->setdirty(LocalNode::DIRTY_SYNCDOWN);
+    }
+
     return success;
 }
 
@@ -7671,8 +10806,18 @@ bool MegaClient::syncdown(LocalNode* l, string* localpath, bool rubbish)
 // for creation
 bool MegaClient::syncup(LocalNode* l, dstime* nds)
 {
+    AllocScope allocscope(AllocTags::SYNC);
+
     bool insync = true;
 
+    // nothing changed in this subtree since the last pass
+    if (!(l->dirty & LocalNode::DIRTY_SYNCUP))
+    {
+        return true;
+    }
+
+    l->dirty &= ~LocalNode::DIRTY_SYNCUP;
+
     list<string> strings;
     remotenode_map nchildren;
     remotenode_map::iterator rit;
@@ -7685,6 +10830,13 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
 
     if (l->node)
     {
+        loadchildren(l->node);
+
+        if (nodesdeferred)
+        {
+            decryptchildren(l->node);
+        }
+
         // corresponding remote node present: build child hash - nameclash
         // resolution: use newest version
         for (node_list::iterator it = l->node->children.begin(); it != l->node->children.end(); it++)
@@ -7950,6 +11102,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                     // recurse into directories of equal name
                     if (!syncup(ll, nds))
                     {
+                        l->setdirty(LocalNode::DIRTY_SYNCUP);
                         return false;
                     }
                     continue;
@@ -7977,6 +11130,8 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                     *nds = ll->nagleds;
                 }
 
+                ll->setdirty(LocalNode::DIRTY_SYNCUP);
+
                 continue;
             }
             else
@@ -8012,6 +11167,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
                         *nds = ll->nagleds;
                     }
 
+                    ll->setdirty(LocalNode::DIRTY_SYNCUP);
                     continue;
                 }
 
@@ -8092,6 +11248,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
             if (synccreate.size() >= MAX_NEWNODES)
             {
                 LOG_warn << "Stopping syncup due to MAX_NEWNODES";
+                ll->setdirty(LocalNode::DIRTY_SYNCUP);
                 return false;
             }
         }
@@ -8100,6 +11257,7 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
         {
             if (!syncup(ll, nds))
             {
+                l->setdirty(LocalNode::DIRTY_SYNCUP);
                 return false;
             }
         }
@@ -8118,7 +11276,9 @@ bool MegaClient::syncup(LocalNode* l, dstime* nds)
 void MegaClient::syncupdate()
 {
     // split synccreate[] in separate subtrees and send off to putnodes() for
-    // creation on the server
+    // creation on the server - subtrees beneath the same existing folder
+    // share one putnodes(), deeper levels reference their new parent by its
+    // temporary handle (the syncid)
     unsigned i, start, end;
     SymmCipher tkey;
     string tattrstring;
@@ -8128,6 +11288,11 @@ void MegaClient::syncupdate()
     NewNode* nnp;
     LocalNode* l;
 
+    // subtree boundaries, grouped by target folder in order of appearance
+    typedef vector<pair<unsigned, unsigned> > subtree_vector;
+    map<Node*, subtree_vector> subtrees;
+    node_vector targets;
+
     for (start = 0; start < synccreate.size(); start = end)
     {
         // determine length of distinct subtree beneath existing node
@@ -8139,73 +11304,111 @@ void MegaClient::syncupdate()
             }
         }
 
+        // add nodes unless parent node has been deleted
+        if (!(n = synccreate[start]->parent->node))
+        {
+            continue;
+        }
+
+        subtree_vector* st = &subtrees[n];
+
+        if (st->empty())
+        {
+            targets.push_back(n);
+        }
+
+        st->push_back(pair<unsigned, unsigned>(start, end));
+    }
+
+    for (node_vector::iterator tit = targets.begin(); tit != targets.end(); tit++)
+    {
+        subtree_vector* st = &subtrees[*tit];
+        unsigned count = 0;
+
+        for (subtree_vector::iterator sit = st->begin(); sit != st->end(); sit++)
+        {
+            count += sit->second - sit->first;
+        }
+
         // add nodes that can be created immediately: folders & existing files;
         // start uploads of new files
-        nn = nnp = new NewNode[end - start];
+        nn = nnp = new NewNode[count];
 
-        for (i = start; i < end; i++)
+        for (subtree_vector::iterator sit = st->begin(); sit != st->end(); sit++)
         {
-            n = NULL;
-            l = synccreate[i];
-
-            if (l->type == FOLDERNODE || (n = nodebyfingerprint(l)))
+            for (i = sit->first; i < sit->second; i++)
             {
-                // create remote folder or copy file if it already exists
-                nnp->source = NEW_NODE;
-                nnp->type = l->type;
-                nnp->syncid = l->syncid;
-                nnp->localnode = l;
-                l->newnode = nnp;
-                nnp->nodehandle = n ? n->nodehandle : l->syncid;
-                nnp->parenthandle = i > start ? l->parent->syncid : UNDEF;
+                n = NULL;
+                l = synccreate[i];
 
-                if (n)
+                if (l->type == FOLDERNODE || (n = nodebyfingerprint(l)))
                 {
-                    // overwriting an existing remote node? send it to SyncDebris.
-                    if (l->node && l->node->parent && l->node->parent->localnode)
+                    // create remote folder or copy file if it already exists
+                    nnp->source = NEW_NODE;
+                    nnp->type = l->type;
+                    nnp->syncid = l->syncid;
+                    nnp->localnode = l;
+                    l->newnode = nnp;
+                    nnp->nodehandle = n ? n->nodehandle : l->syncid;
+                    nnp->parenthandle = i > sit->first ? l->parent->syncid : UNDEF;
+
+                    if (n)
+                    {
+                        // overwriting an existing remote node? send it to SyncDebris.
+                        if (l->node && l->node->parent && l->node->parent->localnode)
+                        {
+                            movetosyncdebris(l->node, l->sync->inshare);
+                        }
+
+                        // this is a file - copy, use original key & attributes
+                        // FIXME: move instead of creating a copy if it is in
+                        // rubbish to reduce node creation load
+                        nnp->nodekey = n->nodekey;
+                        tattrs.map = n->attrs.map;
+
+                        app->syncupdate_remote_copy(l->sync, l->name.c_str());
+                    }
+                    else
                     {
-                        movetosyncdebris(l->node, l->sync->inshare);
+                        // this is a folder - create, use fresh key & attributes
+                        nnp->nodekey.resize(FOLDERNODEKEYLENGTH);
+                        PrnGen::genblock((byte*)nnp->nodekey.data(), FOLDERNODEKEYLENGTH);
+                        tattrs.map.clear();
                     }
 
-                    // this is a file - copy, use original key & attributes
-                    // FIXME: move instead of creating a copy if it is in
-                    // rubbish to reduce node creation load
-                    nnp->nodekey = n->nodekey;
-                    tattrs.map = n->attrs.map;
+                    // set new name, encrypt and attach attributes
+                    tattrs.map['n'] = l->name;
+                    tattrs.getjson(&tattrstring);
+                    tkey.setkey((const byte*)nnp->nodekey.data(), nnp->type);
+                    nnp->attrstring = new string;
+                    makeattr(&tkey, nnp->attrstring, tattrstring.c_str());
 
-                    app->syncupdate_remote_copy(l->sync, l->name.c_str());
+                    l->treestate(TREESTATE_SYNCING);
+                    nnp++;
                 }
-                else
+                else if (l->type == FILENODE)
                 {
-                    // this is a folder - create, use fresh key & attributes
-                    nnp->nodekey.resize(FOLDERNODEKEYLENGTH);
-                    PrnGen::genblock((byte*)nnp->nodekey.data(), FOLDERNODEKEYLENGTH);
-                    tattrs.map.clear();
-                }
-
-                // set new name, encrypt and attach attributes
-                tattrs.map['n'] = l->name;
-                tattrs.getjson(&tattrstring);
-                tkey.setkey((const byte*)nnp->nodekey.data(), nnp->type);
-                nnp->attrstring = new string;
-                makeattr(&tkey, nnp->attrstring, tattrstring.c_str());
+                    if (!l->parent->node && l->parent->newnode)
+                    {
+                        // the folder is being created in this batch: upload
+                        // once it exists (its creation re-flags the subtree)
+                        l->created = false;
+                        continue;
+                    }
 
-                l->treestate(TREESTATE_SYNCING);
-                nnp++;
-            }
-            else if (l->type == FILENODE)
-            {
-                l->treestate(TREESTATE_PENDING);
+                    l->treestate(TREESTATE_PENDING);
 
-                // the overwrite will happen upon PUT completion
-                string tmppath, tmplocalpath;
+                    // the overwrite will happen upon PUT completion
+                    string tmppath, tmplocalpath;
 
-                nextreqtag();
-                startxfer(PUT, l);
+                    nextreqtag();
+                    startxfer(PUT, l);
+                    l->sync->metrics.uploads++;
 
-                l->getlocalpath(&tmplocalpath, true);
-                fsaccess->local2path(&tmplocalpath, &tmppath);
-                app->syncupdate_put(l->sync, l, tmppath.c_str());
+                    l->getlocalpath(&tmplocalpath, true);
+                    fsaccess->local2path(&tmplocalpath, &tmppath);
+                    app->syncupdate_put(l->sync, l, tmppath.c_str());
+                }
             }
         }
 
@@ -8215,19 +11418,16 @@ void MegaClient::syncupdate()
         }
         else
         {
-            // add nodes unless parent node has been deleted
-            if (synccreate[start]->parent->node)
-            {
-                syncadding++;
+            syncadding++;
+            synccreate[st->front().first]->sync->metrics.putnodespending++;
 
-                reqs.add(new CommandPutNodes(this,
-                                                synccreate[start]->parent->node->nodehandle,
-                                                NULL, nn, nnp - nn,
-                                                synccreate[start]->sync->tag,
-                                                PUTNODES_SYNC));
+            reqs.add(new CommandPutNodes(this,
+                                            (*tit)->nodehandle,
+                                            NULL, nn, nnp - nn,
+                                            synccreate[st->front().first]->sync->tag,
+                                            PUTNODES_SYNC));
 
-                syncactivity = true;
-            }
+            syncactivity = true;
         }
     }
 
@@ -8243,6 +11443,12 @@ void MegaClient::putnodes_sync_result(error e, NewNode* nn, int nni)
         Node* n;
         if (nn[nni].type == FILENODE && !nn[nni].added)
         {
+            // have syncup() reconsider the file
+            if (nn[nni].localnode)
+            {
+                nn[nni].localnode->setdirty(LocalNode::DIRTY_SYNCUP);
+            }
+
             if ((n = nodebyhandle(nn[nni].nodehandle)))
             {
                 if (n->fingerprint_it != fingerprints.end())
@@ -8269,6 +11475,16 @@ void MegaClient::putnodes_sync_result(error e, NewNode* nn, int nni)
 
     syncadding--;
 
+    // (the command was tagged with the sync's tag)
+    for (sync_list::iterator it = syncs.begin(); it != syncs.end(); it++)
+    {
+        if ((*it)->tag == restag && (*it)->metrics.putnodespending)
+        {
+            (*it)->metrics.putnodespending--;
+            break;
+        }
+    }
+
     syncactivity = true;
 }
 
@@ -8281,6 +11497,8 @@ void MegaClient::movetosyncdebris(Node* dn, bool unlink)
     // detach node from LocalNode
     if (dn->localnode)
     {
+        dn->localnode->sync->metrics.remotedebris++;
+        dn->localnode->setdirty();
         dn->tag = dn->localnode->sync->tag;
         dn->localnode->node = NULL;
         dn->localnode = NULL;
@@ -8417,7 +11635,15 @@ void MegaClient::execmovetosyncdebris()
         {
             while ((n = n->parent) && n->syncdeleted == SYNCDEL_NONE);
 
-            if (!n)
+            if (n && (*it)->syncdeleted == SYNCDEL_DELETED
+             && (n->syncdeleted == SYNCDEL_DELETED || n->syncdeleted == SYNCDEL_INFLIGHT))
+            {
+                // an ancestor was queued later: it carries this node along
+                // and reports it once moved
+                (*it)->todebris_it = todebris.end();
+                todebris.erase(it++);
+            }
+            else if (!n)
             {
                 n = *it;
 
@@ -8557,6 +11783,13 @@ bool MegaClient::startxfer(direction_t d, File* f, bool skipdupes)
             }
         }
 
+        // downloads to a sink are never shared: a unique (negative) mtime
+        // keeps them apart in transfers[GET] and cachedtransfers[GET]
+        if (d == GET && f->sink)
+        {
+            f->mtime = --sinkmtime;
+        }
+
         Transfer* t;
         transfer_map::iterator it = transfers[d].find(f);
 
@@ -8582,11 +11815,43 @@ bool MegaClient::startxfer(direction_t d, File* f, bool skipdupes)
         }
         else
         {
-            t = new Transfer(this, d);
-            *(FileFingerprint*)t = *(FileFingerprint*)f;
-            t->size = f->size;
+            t = NULL;
+
+            // resume a partial download of the same file key from a previous
+            // session
+            if (d == GET && (it = cachedtransfers[d].find(f)) != cachedtransfers[d].end())
+            {
+                Node* n;
+                const byte* k = f->hprivate
+                        ? ((n = nodebyhandle(f->h)) && n->type == FILENODE ? (const byte*)n->nodekey.data() : NULL)
+                        : f->filekey;
+
+                t = it->second;
+                cachedtransfers[d].erase(it);
+
+                if (k && !memcmp(k, t->filekey, sizeof t->filekey))
+                {
+                    LOG_debug << "Resuming cached transfer: " << f->name;
+                }
+                else
+                {
+                    uncachetransfer(t);
+                    delete t;
+                    t = NULL;
+                }
+            }
+
+            if (!t)
+            {
+                t = new Transfer(this, d);
+                *(FileFingerprint*)t = *(FileFingerprint*)f;
+                t->size = f->size;
+                t->sink = f->sink;
+            }
+
             t->tag = reqtag;
             t->transfers_it = transfers[d].insert(pair<FileFingerprint*, Transfer*>((FileFingerprint*)t, t)).first;
+            queuetransfer(t, PRIORITY_NORMAL);
             app->transfer_added(t);
         }
 
@@ -8612,6 +11877,7 @@ void MegaClient::stopxfer(File* f)
         // last file for this transfer removed? shut down transfer.
         if (!transfer->files.size())
         {
+            uncachetransfer(transfer);
             app->transfer_removed(transfer);
             delete transfer;
         }
@@ -8662,24 +11928,88 @@ void MegaClient::pausexfers(direction_t d, bool pause, bool hard)
 
 Node* MegaClient::nodebyfingerprint(FileFingerprint* fingerprint)
 {
-    fingerprint_set::iterator it;
+    // fingerprints are part of the encrypted attributes
+    if (nodesdeferred)
+    {
+        decryptnodes();
+    }
+
+    if (nodepaging && fingerprint->isvalid)
+    {
+        string value;
+
+        sctable->indexvalue(fingerprint, &key, &value);
+        loadnodes(DbTable::COLUMN_FINGERPRINT, &value);
+    }
+
+    uint64_t tolerancehits = fingerprints.tolerancehits;
+    Node* n = fingerprints.find(fingerprint);
+
+    if (n && fingerprints.tolerancehits != tolerancehits)
+    {
+        LOG_debug << "Fingerprint matched within mtime tolerance: " << fingerprint->mtime << " " << n->mtime;
+    }
+
+    return n;
+}
+
+#ifdef ENABLE_SYNC
+// synced files are found through the fingerprint index of their nodes: a
+// LocalNode qualifies if it was last fingerprinted with its node's content
+// and the file hasn't changed since
+LocalNode* MegaClient::localnodebyfingerprint(Node* n)
+{
+    node_vector nodes;
+
+    fingerprints.findall(n, &nodes);
 
-    if ((it = fingerprints.find(fingerprint)) != fingerprints.end())
+    for (node_vector::iterator it = nodes.begin(); it != nodes.end(); it++)
     {
-        return (Node*)*it;
+        LocalNode* ll = (*it)->localnode;
+
+        if (*it == n || !ll || ll == (LocalNode*)~0 || ll->type != FILENODE
+                || ll->transfer || ll->sync->state != SYNC_ACTIVE
+                || ll->size != n->size || memcmp(ll->crc, n->crc, sizeof ll->crc))
+        {
+            continue;
+        }
+
+        string localpath;
+        FileAccess* fa = fsaccess->newfileaccess();
+
+        ll->getlocalpath(&localpath);
+
+        bool unchanged = fa->fopen(&localpath, true, false) && fa->size == ll->size && fa->mtime == ll->mtime;
+
+        delete fa;
+
+        if (unchanged)
+        {
+            return ll;
+        }
     }
 
     return NULL;
 }
+#endif
 
 // a chunk transfer request failed: record failed protocol & host
 void MegaClient::setchunkfailed(string* url)
 {
+    hoststats.failure(*url);
+
     if (!chunkfailed && url->size() > 19)
     {
         chunkfailed = true;
         httpio->success = false;
 
+        // a host that keeps failing is reported once per
+        // HostStats::REPORTINTERVAL
+        if (!hoststats.report(*url))
+        {
+            return;
+        }
+
         // record protocol and hostname
         if (badhosts.size())
         {
@@ -8698,6 +12028,71 @@ void MegaClient::setchunkfailed(string* url)
     }
 }
 
+bool MegaClient::doio()
+{
+    TraceSpan span(&tracer, "httpio");
+
+    return httpio->doio();
+}
+
+void MegaClient::sccommit()
+{
+    TraceSpan span(&tracer, "dbcommit");
+    AllocScope allocscope(AllocTags::CACHE);
+    int64_t start = Metrics::now();
+
+    sctable->commit();
+
+    metrics.observe(Metrics::DB_COMMIT_TIME, "", (Metrics::now() - start) / 1000.0);
+}
+
+void MegaClient::getmetrics(string* text)
+{
+    static const char* directions[] = { "download", "upload" };
+    unsigned slots[2] = { 0, 0 };
+
+    for (transferslot_list::iterator it = tslots.begin(); it != tslots.end(); it++)
+    {
+        slots[(*it)->transfer->type]++;
+    }
+
+    for (int d = GET; d <= PUT; d++)
+    {
+        metrics.set(Metrics::TRANSFER_SLOTS, directions[d], slots[d]);
+        metrics.set(Metrics::QUEUE_DEPTH, d == GET ? "downloads" : "uploads", (double)(transfers[d].size() - slots[d]));
+    }
+
+    metrics.set(Metrics::QUEUE_DEPTH, "commands", reqs.cmdspending() + fastreq.cmdspending());
+    metrics.set(Metrics::QUEUE_DEPTH, "file_attributes", (double)newfa.size());
+    metrics.set(Metrics::QUEUE_DEPTH, "node_notifications", (double)nodenotify.size());
+
+    if (threadpool)
+    {
+        ThreadPool::Stats stats;
+
+        threadpool->getstats(&stats);
+        metrics.set(Metrics::QUEUE_DEPTH, "pool_tasks", stats.queued);
+        metrics.set(Metrics::POOL_TASKS, "submitted", (double)stats.submitted);
+        metrics.set(Metrics::POOL_TASKS, "stolen", (double)stats.stolen);
+        metrics.set(Metrics::POOL_TASKS, "finished", (double)stats.finished);
+        metrics.set(Metrics::POOL_BUSY_TIME, "", stats.busytime / 1000.0);
+    }
+
+    if (AllocTags::enabled())
+    {
+        for (int t = 0; t < AllocTags::NUMTAGS; t++)
+        {
+            AllocTags::Counters c;
+
+            AllocTags::get((AllocTags::tag_t)t, &c);
+            metrics.set(Metrics::ALLOC_BYTES, AllocTags::name((AllocTags::tag_t)t), (double)c.inuse);
+            metrics.set(Metrics::ALLOC_COUNT, AllocTags::name((AllocTags::tag_t)t), (double)c.allocs);
+        }
+    }
+
+    metrics.gettext(text);
+}
+
 bool MegaClient::toggledebug()
 {
      SimpleLogger::setLogLevel((SimpleLogger::logCurrentLevel >= logDebug) ? logWarning : logDebug);
@@ -8709,6 +12104,35 @@ bool MegaClient::debugstate()
     return SimpleLogger::logCurrentLevel >= logDebug;
 }
 
+// a transmission window is open while the radio is still active after
+// received data, or for a while once the oldest held back request has
+// waited for deferlimit, so that everything pending is sent together
+bool MegaClient::txwindow()
+{
+    if (!deferlimit
+     || (httpio->lastdata != NEVER && Waiter::ds - httpio->lastdata < RADIOTAILDS)
+     || Waiter::ds < txwindowuntil)
+    {
+        deferredsince = 0;
+        return true;
+    }
+
+    if (!deferredsince)
+    {
+        deferredsince = Waiter::ds;
+        return false;
+    }
+
+    if (Waiter::ds - deferredsince >= deferlimit)
+    {
+        deferredsince = 0;
+        txwindowuntil = Waiter::ds + RADIOTAILDS;
+        return true;
+    }
+
+    return false;
+}
+
 void MegaClient::reportevent(const char* event, const char* details)
 {
     LOG_err << "SERVER REPORT: " << event << " DETAILS: " << details;
@@ -35,8 +35,7 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
            nodetype_t t, m_off_t s, handle u, const char* fa, m_time_t ts)
 {
     client = cclient;
-    outshares = NULL;
-    pendingshares = NULL;
+    sharing = NULL;
     tag = 0;
     appdata = NULL;
 
@@ -44,6 +43,7 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
     parenthandle = ph;
 
     parent = NULL;
+    childrenpaged = false;
 
 #ifdef ENABLE_SYNC
     localnode = NULL;
@@ -63,11 +63,17 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
 
     ctime = ts;
 
-    inshare = NULL;
-    sharekey = NULL;
     foreignkey = false;
 
-    plink = NULL;
+    if (type == FILENODE)
+    {
+        subtree.storage = size;
+        subtree.files = 1;
+    }
+    else
+    {
+        subtree.folders = 1;
+    }
 
     memset(&changed,-1,sizeof changed);
     changed.removed = false;
@@ -104,6 +110,73 @@ Node::Node(MegaClient* cclient, node_vector* dp, handle h, handle ph,
         if (type == FILENODE)
         {
             fingerprint_it = client->fingerprints.end();
+
+            if (client->pagednodes)
+            {
+                paged_it = client->pagedlru.insert(client->pagedlru.end(), this);
+            }
+            else
+            {
+                paged_it = client->pagedlru.end();
+            }
+        }
+    }
+}
+
+NodeSharing* Node::sharingstate()
+{
+    if (!sharing)
+    {
+        sharing = new NodeSharing;
+    }
+
+    return sharing;
+}
+
+const size_t Node::ALLOCSIZE = sizeof(Node::AllocHeader) + sizeof(Node);
+
+void* Node::operator new(size_t size, MegaClient* client)
+{
+    AllocHeader* h;
+
+    if (client && size + sizeof *h <= client->nodeslab.size())
+    {
+        h = (AllocHeader*)client->nodeslab.alloc();
+        h->slab = &client->nodeslab;
+    }
+    else
+    {
+        h = (AllocHeader*)::operator new(size + sizeof *h);
+        h->slab = NULL;
+    }
+
+    return h + 1;
+}
+
+void* Node::operator new(size_t size)
+{
+    return operator new(size, (MegaClient*)NULL);
+}
+
+// only invoked if the constructor throws
+void Node::operator delete(void* p, MegaClient*)
+{
+    operator delete(p);
+}
+
+void Node::operator delete(void* p)
+{
+    if (p)
+    {
+        AllocHeader* h = (AllocHeader*)p - 1;
+
+        if (h->slab)
+        {
+            h->slab->free(h);
+        }
+        else
+        {
+            ::operator delete(h);
         }
     }
 }
@@ -119,6 +192,11 @@ Node::~Node()
         client->fingerprints.erase(fingerprint_it);
     }
 
+    if (type == FILENODE && paged_it != client->pagedlru.end())
+    {
+        client->pagedlru.erase(paged_it);
+    }
+
 #ifdef ENABLE_SYNC
     // remove from todebris node_set
     if (todebris_it != client->todebris.end())
@@ -133,31 +211,26 @@ Node::~Node()
     }
 #endif
 
-    if (outshares)
-    {
-        // delete outshares, including pointers from users for this node
-        for (share_map::iterator it = outshares->begin(); it != outshares->end(); it++)
-        {
-            delete it->second;
-        }
-        delete outshares;
-    }
-
-    if (pendingshares)
+    // delete shares (including pointers from users for this node), share key
+    // and public link
+    if (sharing)
     {
-        // delete pending shares
-        for (share_map::iterator it = pendingshares->begin(); it != pendingshares->end(); it++)
-        {
-            delete it->second;
-        }
-        delete pendingshares;
+        client->outsharenodes.erase(nodehandle);
+        client->pendingsharenodes.erase(nodehandle);
+        client->insharenodes.erase(nodehandle);
     }
 
+    delete sharing;
 
     // remove from parent's children
     if (parent)
     {
-        parent->children.erase(child_it);
+        parent->children.remove(this);
+
+        for (Node* a = parent; a; a = a->parent)
+        {
+            a->subtree -= subtree;
+        }
     }
 
     // delete child-parent associations (normally not used, as nodes are
@@ -167,16 +240,13 @@ Node::~Node()
         (*it)->parent = NULL;
     }
 
-    delete plink;
-    delete inshare;
-    delete sharekey;
-
 #ifdef ENABLE_SYNC
     // sync: remove reference from local filesystem node
     if (localnode)
     {
         localnode->deleted = true;
         localnode->node = NULL;
+        localnode->setdirty();
     }
 
     // in case this node is currently being transferred for syncing: abort transfer
@@ -199,6 +269,8 @@ void Node::setkey(const byte* newkey)
 // mismatch vector
 Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
 {
+    AllocScope allocscope(AllocTags::NODES);
+
     handle h, ph;
     nodetype_t t;
     m_off_t s;
@@ -214,6 +286,11 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
     int i;
     char isExported = '\0';
 
+    if (!legacyrecord(d))
+    {
+        return unserializecompact(client, ptr + sizeof s, end, dp);
+    }
+
     if (ptr + sizeof s + 2 * MegaClient::NODEHANDLE + MegaClient::USERHANDLE + 2 * sizeof ts + sizeof ll > end)
     {
         return NULL;
@@ -313,7 +390,7 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
         skey = NULL;
     }
 
-    n = new Node(client, dp, h, ph, t, s, u, fa, ts);
+    n = new (client) Node(client, dp, h, ph, t, s, u, fa, ts);
 
     if (k)
     {
@@ -349,7 +426,10 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
 
         plink = new PublicLink(ph, ets, takendown);
     }
-    n->plink = plink;
+    if (plink)
+    {
+        n->sharingstate()->plink = plink;
+    }
 
     n->setfingerprint();
 
@@ -363,239 +443,595 @@ Node* Node::unserialize(MegaClient* client, string* d, node_vector* dp)
     }
 }
 
-// serialize node - nodes with pending or RSA keys are unsupported
-bool Node::serialize(string* d)
+bool Node::legacyrecord(const string* d)
 {
-    // do not serialize encrypted nodes
-    if (attrstring)
-    {
-        LOG_warn << "Trying to serialize an encrypted node";
+    return d->size() < sizeof COMPACTRECORD
+        || MemAccess::get<m_off_t>(d->data()) != COMPACTRECORD;
+}
 
-        //Last attempt to decrypt the node
-        applykey();
-        setattr();
+handle Node::recordhandle(const string* d)
+{
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+    handle h = 0;
+    uint64_t s;
 
-        if (attrstring)
+    if (legacyrecord(d))
+    {
+        ptr += sizeof(m_off_t);
+    }
+    else
+    {
+        ptr += sizeof COMPACTRECORD + 2;
+
+        if (ptr > end || (ptr[-1] == FILENODE && !Serialize64::unserialize(&ptr, end, &s)))
         {
-            LOG_err << "Skipping undecryptable node";
-            return false;
+            return UNDEF;
         }
     }
 
-    switch (type)
+    if (ptr + MegaClient::NODEHANDLE > end)
     {
-        case FILENODE:
-            if ((int)nodekey.size() != FILENODEKEYLENGTH)
-            {
-                return false;
-            }
-            break;
+        return UNDEF;
+    }
 
-        case FOLDERNODE:
-            if ((int)nodekey.size() != FOLDERNODEKEYLENGTH)
-            {
-                return false;
-            }
-            break;
+    memcpy((char*)&h, ptr, MegaClient::NODEHANDLE);
 
-        default:
-            if (nodekey.size())
-            {
-                return false;
-            }
-    }
+    return h;
+}
 
-    unsigned short ll;
-    short numshares;
+// compact record: COMPACTRECORD, presence bits, type, size (files only),
+// node handle, parent handle, owner (unless it is the account owner),
+// creation time, node key, file attributes, shares (timestamps relative to
+// the creation time), attributes and the public link
+Node* Node::unserializecompact(MegaClient* client, const char* ptr, const char* end, node_vector* dp)
+{
+    AllocScope allocscope(AllocTags::NODES);
+
+    nodetype_t t;
     m_off_t s;
+    handle h = 0, ph = UNDEF, u = client->me;
+    const byte* k = NULL;
+    const char* fa = NULL;
+    const byte* skey = NULL;
+    uint64_t v, numshares = 0, falen = 0;
+    m_time_t ts;
+    char flags;
+    Node* n;
 
-    s = type ? -type : size;
+    if (ptr + 2 > end)
+    {
+        return NULL;
+    }
 
-    d->append((char*)&s, sizeof s);
+    flags = *ptr++;
+    t = (nodetype_t)*ptr++;
 
-    d->append((char*)&nodehandle, MegaClient::NODEHANDLE);
+    if (t < FILENODE || t > RUBBISHNODE)
+    {
+        return NULL;
+    }
 
-    if (parent)
+    if (t == FILENODE)
     {
-        d->append((char*)&parent->nodehandle, MegaClient::NODEHANDLE);
+        if (!Serialize64::unserialize(&ptr, end, &v))
+        {
+            return NULL;
+        }
+
+        s = (m_off_t)v;
     }
     else
     {
-        d->append("\0\0\0\0\0", MegaClient::NODEHANDLE);
+        s = -t;
     }
 
-    d->append((char*)&owner, MegaClient::USERHANDLE);
+    if (ptr + MegaClient::NODEHANDLE > end)
+    {
+        return NULL;
+    }
 
-    // FIXME: use Serialize64
-    time_t ts = 0;
-    d->append((char*)&ts, sizeof(ts));
+    memcpy((char*)&h, ptr, MegaClient::NODEHANDLE);
+    ptr += MegaClient::NODEHANDLE;
 
-    ts = ctime;
-    d->append((char*)&ts, sizeof(ts));
+    if (flags & COMPACT_PARENT)
+    {
+        if (ptr + MegaClient::NODEHANDLE > end)
+        {
+            return NULL;
+        }
 
-    d->append(nodekey);
+        ph = 0;
+        memcpy((char*)&ph, ptr, MegaClient::NODEHANDLE);
+        ptr += MegaClient::NODEHANDLE;
+    }
 
-    if (type == FILENODE)
+    if (flags & COMPACT_OWNER)
     {
-        ll = (short)fileattrstring.size() + 1;
-        d->append((char*)&ll, sizeof ll);
-        d->append(fileattrstring.c_str(), ll);
-    }
+        if (ptr + MegaClient::USERHANDLE > end)
+        {
+            return NULL;
+        }
 
-    char isExported = plink ? 1 : 0;
-    d->append((char*)&isExported, 1);
-    d->append("\0\0\0\0\0\0", 7);
+        memcpy((char*)&u, ptr, MegaClient::USERHANDLE);
+        ptr += MegaClient::USERHANDLE;
+    }
 
-    if (inshare)
+    if (!Serialize64::unserialize(&ptr, end, &v))
     {
-        numshares = -1;
+        return NULL;
     }
-    else
+
+    ts = (m_time_t)v;
+
+    if (t == FILENODE || t == FOLDERNODE)
     {
-        numshares = 0;
-        if (outshares)
+        int keylen = (t == FILENODE) ? FILENODEKEYLENGTH + 0 : FOLDERNODEKEYLENGTH + 0;
+
+        if (ptr + keylen > end)
         {
-            numshares += (short)outshares->size();
+            return NULL;
         }
-        if (pendingshares)
+
+        k = (const byte*)ptr;
+        ptr += keylen;
+    }
+
+    if (flags & COMPACT_FILEATTRS)
+    {
+        if (!Serialize64::unserialize(&ptr, end, &falen) || falen > (uint64_t)(end - ptr))
         {
-            numshares += (short)pendingshares->size();
+            return NULL;
         }
-    }
 
-    d->append((char*)&numshares, sizeof numshares);
+        fa = ptr;
+        ptr += falen;
+    }
 
-    if (numshares)
+    if (flags & COMPACT_SHARES)
     {
-        d->append((char*)sharekey->key, SymmCipher::KEYLENGTH);
+        if (ptr + SymmCipher::KEYLENGTH > end)
+        {
+            return NULL;
+        }
 
-        if (inshare)
+        skey = (const byte*)ptr;
+        ptr += SymmCipher::KEYLENGTH;
+
+        if (flags & COMPACT_INSHARE)
         {
-            inshare->serialize(d);
+            numshares = 1;
         }
-        else
+        else if (!Serialize64::unserialize(&ptr, end, &numshares))
         {
-            if (outshares)
-            {
-                for (share_map::iterator it = outshares->begin(); it != outshares->end(); it++)
-                {
-                    it->second->serialize(d);
-                }
-            }
-            if (pendingshares)
-            {
-                for (share_map::iterator it = pendingshares->begin(); it != pendingshares->end(); it++)
-                {
-                    it->second->serialize(d);
-                }
-            }
+            return NULL;
         }
     }
 
-    attrs.serialize(d);
+    n = new (client) Node(client, dp, h, ph, t, s, u, NULL, ts);
 
-    if (isExported)
+    if (fa)
     {
-        d->append((char*) &plink->ph, MegaClient::NODEHANDLE);
-        d->append((char*) &plink->ets, sizeof(plink->ets));
-        d->append((char*) &plink->takendown, sizeof(plink->takendown));
+        n->fileattrstring.assign(fa, (size_t)falen);
     }
 
-    return true;
-}
-
-// copy remainder of quoted string (no unescaping, use for base64 data only)
-void Node::copystring(string* s, const char* p)
-{
-    if (p)
+    if (k)
     {
-        const char* pp;
-
-        if ((pp = strchr(p, '"')))
-        {
-            s->assign(p, pp - p);
-        }
-        else
-        {
-            *s = p;
-        }
+        n->setkey(k);
     }
-    else
+
+    // read inshare, outshares, or pending shares
+    while (numshares && Share::unserialize(client, (flags & COMPACT_INSHARE) ? -1 : 0,
+                                           h, skey, &ptr, end, ts))
     {
-        s->clear();
+        numshares--;
     }
-}
 
-// decrypt attrstring and check magic number prefix
-byte* Node::decryptattr(SymmCipher* key, const char* attrstring, int attrstrlen)
-{
-    if (attrstrlen)
+    if (numshares || ptr >= end)
     {
-        int l = attrstrlen * 3 / 4 + 3;
-        byte* buf = new byte[l];
+        return NULL;
+    }
 
-        l = Base64::atob(attrstring, buf, l);
+    ptr = n->attrs.unserialize(ptr);
 
-        if (!(l & (SymmCipher::BLOCKSIZE - 1)))
+    if (flags & COMPACT_PLINK)
+    {
+        handle lph = 0;
+
+        if (ptr + MegaClient::NODEHANDLE > end)
         {
-            key->cbc_decrypt(buf, l);
+            return NULL;
+        }
 
-            if (!memcmp(buf, "MEGA{\"", 6))
-            {
-                return buf;
-            }
+        memcpy((char*)&lph, ptr, MegaClient::NODEHANDLE);
+        ptr += MegaClient::NODEHANDLE;
+
+        if (!Serialize64::unserialize(&ptr, end, &v))
+        {
+            return NULL;
         }
 
-        delete[] buf;
+        n->sharingstate()->plink = new PublicLink(lph, (m_time_t)v, (flags & COMPACT_TAKENDOWN) != 0);
     }
 
-    return NULL;
+    n->setfingerprint();
+
+    return (ptr == end) ? n : NULL;
 }
 
-// return temporary SymmCipher for this nodekey
-SymmCipher* Node::nodecipher()
+// serialize node - nodes with pending or RSA keys are unsupported
+bool Node::dbcolumns(DbColumns* c)
 {
-    if (client->tmpcipher.setkey(&nodekey))
-    {
-        return &client->tmpcipher;
-    }
+    c->nodehandle = nodehandle;
+    c->parenthandle = parent ? parent->nodehandle : parenthandle;
+    c->type = type;
+    c->fingerprint = (type == FILENODE && isvalid) ? (FileFingerprint*)this : NULL;
 
-    return NULL;
+    return true;
 }
 
-// decrypt attributes and build attribute hash
-void Node::setattr()
+bool Node::serialize(string* d)
 {
-    byte* buf;
-    SymmCipher* cipher;
+    // do not serialize encrypted nodes
+    if (attrstring)
+    {
+        if (!client->nodesdeferred)
+        {
+            LOG_warn << "Trying to serialize an encrypted node";
+        }
+
+        //Last attempt to decrypt the node
+        decrypt();
+
+        if (attrstring)
+        {
+            LOG_err << "Skipping undecryptable node";
+            return false;
+        }
+    }
+
+    switch (type)
+    {
+        case FILENODE:
+            if ((int)nodekey.size() != FILENODEKEYLENGTH)
+            {
+                return false;
+            }
+            break;
+
+        case FOLDERNODE:
+            if ((int)nodekey.size() != FOLDERNODEKEYLENGTH)
+            {
+                return false;
+            }
+            break;
+
+        default:
+            if (nodekey.size())
+            {
+                return false;
+            }
+    }
+
+    m_off_t marker = COMPACTRECORD;
+    char flags = 0;
+    char t = (char)type;
+    size_t numshares = 0;
+
+    if (parent)
+    {
+        flags |= COMPACT_PARENT;
+    }
+
+    if (owner != client->me)
+    {
+        flags |= COMPACT_OWNER;
+    }
+
+    if (type == FILENODE && fileattrstring.size())
+    {
+        flags |= COMPACT_FILEATTRS;
+    }
+
+    if (inshare())
+    {
+        flags |= COMPACT_SHARES | COMPACT_INSHARE;
+    }
+    else
+    {
+        if (outshares())
+        {
+            numshares += outshares()->size();
+        }
+        if (pendingshares())
+        {
+            numshares += pendingshares()->size();
+        }
+        if (numshares)
+        {
+            flags |= COMPACT_SHARES;
+        }
+    }
+
+    if (plink())
+    {
+        flags |= COMPACT_PLINK;
+
+        if (plink()->takendown)
+        {
+            flags |= COMPACT_TAKENDOWN;
+        }
+    }
+
+    d->append((char*)&marker, sizeof marker);
+    d->append(&flags, 1);
+    d->append(&t, 1);
 
-    if (attrstring && (cipher = nodecipher()) && (buf = decryptattr(cipher, attrstring->c_str(), attrstring->size())))
+    if (type == FILENODE)
     {
-        JSON json;
-        nameid name;
-        string* t;
+        Serialize64::serialize(d, size);
+    }
 
-        json.begin((char*)buf + 5);
+    d->append((char*)&nodehandle, MegaClient::NODEHANDLE);
+
+    if (parent)
+    {
+        d->append((char*)&parent->nodehandle, MegaClient::NODEHANDLE);
+    }
 
-        while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+    if (flags & COMPACT_OWNER)
+    {
+        d->append((char*)&owner, MegaClient::USERHANDLE);
+    }
+
+    Serialize64::serialize(d, ctime);
+
+    d->append(nodekey);
+
+    if (flags & COMPACT_FILEATTRS)
+    {
+        Serialize64::serialize(d, fileattrstring.size());
+        d->append(fileattrstring);
+    }
+
+    if (flags & COMPACT_SHARES)
+    {
+        d->append((char*)sharekey()->key, SymmCipher::KEYLENGTH);
+
+        if (inshare())
+        {
+            inshare()->serialize(d, ctime);
+        }
+        else
         {
-            JSON::unescape(t);
+            Serialize64::serialize(d, numshares);
 
-            if (name == 'n')
+            if (outshares())
             {
-                client->fsaccess->normalize(t);
+                for (share_map::iterator it = outshares()->begin(); it != outshares()->end(); it++)
+                {
+                    it->second->serialize(d, ctime);
+                }
             }
+            if (pendingshares())
+            {
+                for (share_map::iterator it = pendingshares()->begin(); it != pendingshares()->end(); it++)
+                {
+                    it->second->serialize(d, ctime);
+                }
+            }
+        }
+    }
+
+    attrs.serialize(d);
+
+    if (flags & COMPACT_PLINK)
+    {
+        d->append((char*)&plink()->ph, MegaClient::NODEHANDLE);
+        Serialize64::serialize(d, plink()->ets);
+    }
+
+    return true;
+}
+
+// copy remainder of quoted string (no unescaping, use for base64 data only)
+void Node::copystring(string* s, const char* p)
+{
+    if (p)
+    {
+        const char* pp;
+
+        if ((pp = strchr(p, '"')))
+        {
+            s->assign(p, pp - p);
         }
+        else
+        {
+            *s = p;
+        }
+    }
+    else
+    {
+        s->clear();
+    }
+}
+
+// decrypt attrstring and check magic number prefix
+byte* Node::decryptattr(SymmCipher* key, const char* attrstring, int attrstrlen)
+{
+    if (attrstrlen)
+    {
+        byte* buf = new byte[attrstrlen * 3 / 4 + 3];
 
-        setfingerprint();
+        if (decryptattr(key, attrstring, attrstrlen, buf))
+        {
+            return buf;
+        }
 
         delete[] buf;
+    }
 
-        delete attrstring;
-        attrstring = NULL;
+    return NULL;
+}
+
+bool Node::decryptattr(SymmCipher* key, const char* attrstring, int attrstrlen, byte* buf)
+{
+    if (attrstrlen)
+    {
+        int l = Base64::atob(attrstring, attrstrlen, buf, attrstrlen * 3 / 4 + 3);
+
+        if (!(l & (SymmCipher::BLOCKSIZE - 1)))
+        {
+            key->cbc_decrypt(buf, l);
+
+            return !memcmp(buf, "MEGA{\"", 6);
+        }
+    }
+
+    return false;
+}
+
+void Node::decryptattrs(unsigned n, Node* const* nodes, const byte* const* nodekeys, byte** out)
+{
+    vector<byte> keys(n * SymmCipher::KEYLENGTH + 1);
+    vector<const byte*> keyptrs;
+    vector<byte*> bufs;
+    vector<unsigned> lens;
+    vector<unsigned> index;
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        Node* node = nodes[i];
+
+        out[i] = NULL;
+
+        if (!node->attrstring || !node->attrstring->size())
+        {
+            continue;
+        }
+
+        int l = node->attrstring->size() * 3 / 4 + 3;
+        byte* buf = new byte[l];
+
+        l = Base64::atob(node->attrstring->data(), node->attrstring->size(), buf, l);
+
+        if (!l || (l & (SymmCipher::BLOCKSIZE - 1)))
+        {
+            delete[] buf;
+            continue;
+        }
+
+        // file keys fold their second half in, as in SymmCipher::setkey()
+        byte* key = &keys[i * SymmCipher::KEYLENGTH];
+
+        memcpy(key, nodekeys[i], SymmCipher::KEYLENGTH);
+
+        if (node->type == FILENODE)
+        {
+            SymmCipher::xorblock(nodekeys[i] + SymmCipher::KEYLENGTH, key);
+        }
+
+        keyptrs.push_back(key);
+        bufs.push_back(buf);
+        lens.push_back(l);
+        index.push_back(i);
+    }
+
+    if (!bufs.size())
+    {
+        return;
+    }
+
+    SymmCipher::cbc_decrypt(bufs.size(), &keyptrs[0], &bufs[0], &lens[0]);
+
+    for (unsigned i = 0; i < bufs.size(); i++)
+    {
+        if (!memcmp(bufs[i], "MEGA{\"", 6))
+        {
+            out[index[i]] = bufs[i];
+        }
+        else
+        {
+            delete[] bufs[i];
+        }
     }
 }
 
+// return SymmCipher for this nodekey (valid until the next call)
+SymmCipher* Node::nodecipher()
+{
+    return client->getnodecipher(this);
+}
+
+// decrypt attributes and build attribute hash
+void Node::setattr()
+{
+    AllocScope allocscope(AllocTags::ATTRS);
+
+    SymmCipher* cipher;
+
+    // the name may change
+    if (parent)
+    {
+        parent->children.invalidate();
+    }
+
+    if (attrstring && (cipher = nodecipher()))
+    {
+        byte stackbuf[ATTRSTACKBUF];
+        int l = attrstring->size() * 3 / 4 + 3;
+        byte* buf = (l <= ATTRSTACKBUF) ? stackbuf : new byte[l];
+
+        if (decryptattr(cipher, attrstring->c_str(), attrstring->size(), buf))
+        {
+            setattr(buf);
+        }
+
+        if (buf != stackbuf)
+        {
+            delete[] buf;
+        }
+    }
+}
+
+// build attribute hash from the decrypted attribute string
+void Node::setattr(byte* buf)
+{
+    AllocScope allocscope(AllocTags::ATTRS);
+
+    JSON json;
+    nameid name;
+    string* t;
+
+    json.begin((char*)buf + 5);
+
+    while ((name = json.getnameid()) != EOO && json.storeobject((t = &attrs.map[name])))
+    {
+        JSON::unescape(t);
+
+        if (name == 'n')
+        {
+            client->fsaccess->normalize(t);
+        }
+    }
+
+    setfingerprint();
+
+    delete attrstring;
+    attrstring = NULL;
+}
+
+// deferred (lazy) or retried decryption of key and attributes
+bool Node::decrypt()
+{
+    if (attrstring && !applykey())
+    {
+        setattr();
+    }
+
+    return !attrstring;
+}
+
 // if present, configure FileFingerprint from attributes
 // otherwise, the file's fingerprint is derived from the file's mtime/size/key
 void Node::setfingerprint()
@@ -632,6 +1068,12 @@ void Node::setfingerprint()
 // return file/folder name or special status strings
 const char* Node::displayname() const
 {
+    // decryption deferred at fetchnodes time
+    if (attrstring && client->nodesdeferred)
+    {
+        const_cast<Node*>(this)->decrypt();
+    }
+
     // not yet decrypted
     if (attrstring)
     {
@@ -688,8 +1130,9 @@ int Node::hasfileattribute(fatype t) const
     return fileattrstring.find(buf) + 1;
 }
 
-// attempt to apply node key - sets nodekey to a raw key if successful
-bool Node::applykey()
+// locate the encrypted key usable by this client and the cipher that unwraps
+// it - NULL if the key was already applied or is not available (yet)
+const char* Node::findkey(SymmCipher** keycipher)
 {
     int keylength = (type == FILENODE)
                    ? FILENODEKEYLENGTH + 0
@@ -704,7 +1147,7 @@ bool Node::applykey()
 
     if (nodekey.size() == keylength || !nodekey.size())
     {
-        return false;
+        return NULL;
     }
 
     int l = -1;
@@ -739,121 +1182,526 @@ bool Node::applykey()
 
                 // this is a share node handle - check if we have node and the
                 // share key
-                if (!(n = client->nodebyhandle(h)) || !n->sharekey)
+                if (!(n = client->nodebyhandle(h)) || !n->sharekey())
                 {
                     continue;
                 }
 
-                sc = n->sharekey;
+                sc = n->sharekey();
+
+                // this key will be rewritten when the node leaves the outbound share
+                foreignkey = true;
+            }
+        }
+
+        k = nodekey.c_str() + t;
+        break;
+    }
+
+    // no: found => personal key, use directly
+    // otherwise, no suitable key available yet - bail (it might arrive soon)
+    if (!k)
+    {
+        if (l < 0)
+        {
+            k = nodekey.c_str();
+        }
+        else
+        {
+            return NULL;
+        }
+    }
+
+    *keycipher = sc;
+
+    return k;
+}
+
+// attempt to apply node key - sets nodekey to a raw key if successful
+bool Node::applykey()
+{
+    SymmCipher* sc;
+    const char* k = findkey(&sc);
+
+    if (!k)
+    {
+        return false;
+    }
+
+    int keylength = (type == FILENODE)
+                   ? FILENODEKEYLENGTH + 0
+                   : FOLDERNODEKEYLENGTH + 0;
+
+    byte key[FILENODEKEYLENGTH];
+
+    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    {
+        nodekey.assign((const char*)key, keylength);
+        setattr();
+    }
+
+    return true;
+}
+
+// returns whether node was moved
+bool Node::setparent(Node* p)
+{
+    if (p == parent)
+    {
+        return false;
+    }
+
+    if (parent)
+    {
+        parent->children.remove(this);
+
+        for (Node* a = parent; a; a = a->parent)
+        {
+            a->subtree -= subtree;
+        }
+    }
+
+#ifdef ENABLE_SYNC
+    Node *oldparent = parent;
+#endif
+
+    parent = p;
+
+    if (parent)
+    {
+        parent->children.add(this);
+
+        for (Node* a = parent; a; a = a->parent)
+        {
+            a->subtree += subtree;
+        }
+    }
+
+#ifdef ENABLE_SYNC
+    // if we are moving an entire sync, don't cancel GET transfers
+    if (!localnode || localnode->parent)
+    {
+        // if the new location is not synced, cancel all GET transfers
+        while (p)
+        {
+            if (p->localnode)
+            {
+                break;
+            }
+
+            p = p->parent;
+        }
+
+        if (!p)
+        {
+            TreeProcDelSyncGet tdsg;
+            client->proctree(this, &tdsg);
+        }
+    }
+
+    if (oldparent && oldparent->localnode)
+    {
+        oldparent->localnode->treestate(oldparent->localnode->checkstate());
+    }
+#endif
+
+    return true;
+}
+
+// returns 1 if n is under p, 0 otherwise
+bool Node::isbelow(Node* p) const
+{
+    const Node* n = this;
+
+    for (;;)
+    {
+        if (!n)
+        {
+            return false;
+        }
+
+        if (n == p)
+        {
+            return true;
+        }
+
+        n = n->parent;
+    }
+}
+
+NodeChildren::NodeChildren()
+{
+    views = NULL;
+    numfiles = 0;
+    numfolders = 0;
+}
+
+NodeChildren::~NodeChildren()
+{
+    delete views;
+}
+
+void NodeChildren::dropviews()
+{
+    if (views)
+    {
+        delete views;
+        views = NULL;
+    }
+}
+
+const node_vector* NodeChildren::sorted(int order, comparator comp)
+{
+    if (views)
+    {
+        view_map::iterator it = views->find(order);
+
+        if (it != views->end())
+        {
+            return &it->second;
+        }
+    }
+
+    node_vector v(nodes);
+    std::sort(v.begin(), v.end(), comp);
+
+    if (!views)
+    {
+        views = new view_map;
+    }
+
+    node_vector* view = &(*views)[order];
+    view->swap(v);
+
+    return view;
+}
+
+void NodeChildren::add(Node* n)
+{
+    dropviews();
+
+    n->child_index = nodes.size();
+    nodes.push_back(n);
+
+    if (n->type == FILENODE)
+    {
+        numfiles++;
+    }
+    else
+    {
+        numfolders++;
+    }
+
+    if (indexed())
+    {
+        // keep the index load factor at or below 1/2
+        if (nodes.size() * 2 > index.size())
+        {
+            invalidate();
+        }
+        else
+        {
+            const string* name = childname(n);
+
+            if (name)
+            {
+                indexadd(n, namehash(name->data(), name->size()));
+            }
+        }
+    }
+}
+
+void NodeChildren::remove(Node* n)
+{
+    size_t i = n->child_index;
+
+    if (i >= nodes.size() || nodes[i] != n)
+    {
+        LOG_err << "Child not found in parent " << n->nodehandle;
+        return;
+    }
+
+    dropviews();
+
+    if (indexed())
+    {
+        indexremove(n);
+    }
+
+    if (i + 1 < nodes.size())
+    {
+        nodes[i] = nodes.back();
+        nodes[i]->child_index = i;
+    }
+
+    nodes.pop_back();
+
+    if (n->type == FILENODE)
+    {
+        numfiles--;
+    }
+    else
+    {
+        numfolders--;
+    }
+}
+
+void NodeChildren::invalidate()
+{
+    if (indexed())
+    {
+        vector<nameslot>().swap(index);
+    }
+
+    dropviews();
+}
+
+size_t NodeChildren::allocated() const
+{
+    size_t size = nodes.capacity() * sizeof(Node*) + index.capacity() * sizeof(nameslot);
+
+    if (views)
+    {
+        // approximate per-entry overhead of the map's tree nodes
+        size += sizeof(view_map);
+
+        for (view_map::const_iterator it = views->begin(); it != views->end(); it++)
+        {
+            size += sizeof(view_map::value_type) + 4 * sizeof(void*) + it->second.capacity() * sizeof(Node*);
+        }
+    }
+
+    return size;
+}
+
+// FNV-1a
+uint32_t NodeChildren::namehash(const char* name, size_t len)
+{
+    uint32_t h = 2166136261U;
+
+    while (len--)
+    {
+        h ^= (byte)*name++;
+        h *= 16777619U;
+    }
+
+    return h;
+}
+
+const string* NodeChildren::childname(const Node* n)
+{
+    if (n->attrstring)
+    {
+        return NULL;
+    }
+
+    attr_map::const_iterator it = n->attrs.map.find('n');
+
+    if (it == n->attrs.map.end() || !it->second.size())
+    {
+        return NULL;
+    }
+
+    return &it->second;
+}
+
+void NodeChildren::buildindex()
+{
+    size_t size = MININDEXED * 2;
+
+    while (size < nodes.size() * 4)
+    {
+        size <<= 1;
+    }
+
+    index.assign(size, nameslot(0, (Node*)NULL));
+
+    for (node_vector::iterator it = nodes.begin(); it != nodes.end(); it++)
+    {
+        const string* name = childname(*it);
+
+        if (name)
+        {
+            indexadd(*it, namehash(name->data(), name->size()));
+        }
+    }
+}
+
+void NodeChildren::indexadd(Node* n, uint32_t h)
+{
+    size_t mask = index.size() - 1;
+    size_t i;
+
+    for (i = h & mask; index[i].second; i = (i + 1) & mask);
+
+    index[i].first = h;
+    index[i].second = n;
+}
+
+// backward-shift deletion keeps probe sequences intact without tombstones
+void NodeChildren::indexremove(Node* n)
+{
+    size_t mask = index.size() - 1;
+    size_t i = 0;
+    bool found = false;
+    const string* name = childname(n);
 
-                // this key will be rewritten when the node leaves the outbound share
-                foreignkey = true;
+    if (name)
+    {
+        for (i = namehash(name->data(), name->size()) & mask; index[i].second; i = (i + 1) & mask)
+        {
+            if (index[i].second == n)
+            {
+                found = true;
+                break;
             }
         }
-
-        k = nodekey.c_str() + t;
-        break;
     }
 
-    // no: found => personal key, use directly
-    // otherwise, no suitable key available yet - bail (it might arrive soon)
-    if (!k)
+    if (!found)
     {
-        if (l < 0)
+        // renamed without invalidation or never indexed
+        for (i = 0; i <= mask; i++)
         {
-            k = nodekey.c_str();
+            if (index[i].second == n)
+            {
+                found = true;
+                break;
+            }
         }
-        else
+
+        if (!found)
         {
-            return false;
+            return;
         }
     }
 
-    byte key[FILENODEKEYLENGTH];
-
-    if (client->decryptkey(k, key, keylength, sc, 0, nodehandle))
+    for (size_t j = (i + 1) & mask; index[j].second; j = (j + 1) & mask)
     {
-        nodekey.assign((const char*)key, keylength);
-        setattr();
+        size_t home = index[j].first & mask;
+
+        // move entry j into the hole at i unless its home lies cyclically in (i, j]
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            index[i] = index[j];
+            i = j;
+        }
     }
 
-    return true;
+    index[i].first = 0;
+    index[i].second = NULL;
 }
 
-// returns whether node was moved
-bool Node::setparent(Node* p)
+Node* NodeChildren::childbyname(const char* name)
 {
-    if (p == parent)
-    {
-        return false;
-    }
+    size_t len = strlen(name);
 
-    if (parent)
+    if (nodes.size() < MININDEXED || !len)
     {
-        parent->children.erase(child_it);
-    }
-
-#ifdef ENABLE_SYNC
-    Node *oldparent = parent;
-#endif
+        for (node_vector::iterator it = nodes.begin(); it != nodes.end(); it++)
+        {
+            if (!strcmp(name, (*it)->displayname()))
+            {
+                return *it;
+            }
+        }
 
-    parent = p;
+        return NULL;
+    }
 
-    if (parent)
+    if (!indexed())
     {
-        child_it = parent->children.insert(parent->children.end(), this);
+        buildindex();
     }
 
-#ifdef ENABLE_SYNC
-    // if we are moving an entire sync, don't cancel GET transfers
-    if (!localnode || localnode->parent)
+    uint32_t h = namehash(name, len);
+    size_t mask = index.size() - 1;
+
+    for (size_t i = h & mask; index[i].second; i = (i + 1) & mask)
     {
-        // if the new location is not synced, cancel all GET transfers
-        while (p)
+        if (index[i].first == h)
         {
-            if (p->localnode)
+            const string* cname = childname(index[i].second);
+
+            if (cname && *cname == name)
             {
-                break;
+                return index[i].second;
             }
-
-            p = p->parent;
         }
+    }
 
-        if (!p)
+    return NULL;
+}
+
+NodeSharing::NodeSharing()
+{
+    inshare = NULL;
+    outshares = NULL;
+    pendingshares = NULL;
+    sharekey = NULL;
+    plink = NULL;
+}
+
+NodeSharing::~NodeSharing()
+{
+    if (outshares)
+    {
+        for (share_map::iterator it = outshares->begin(); it != outshares->end(); it++)
         {
-            TreeProcDelSyncGet tdsg;
-            client->proctree(this, &tdsg);
+            delete it->second;
         }
+        delete outshares;
     }
 
-    if (oldparent && oldparent->localnode)
+    if (pendingshares)
     {
-        oldparent->localnode->treestate(oldparent->localnode->checkstate());
+        for (share_map::iterator it = pendingshares->begin(); it != pendingshares->end(); it++)
+        {
+            delete it->second;
+        }
+        delete pendingshares;
     }
-#endif
 
-    return true;
+    delete plink;
+    delete inshare;
+    delete sharekey;
 }
 
-// returns 1 if n is under p, 0 otherwise
-bool Node::isbelow(Node* p) const
+NodeCounter::NodeCounter()
 {
-    const Node* n = this;
+    storage = 0;
+    files = 0;
+    folders = 0;
+}
 
-    for (;;)
-    {
-        if (!n)
-        {
-            return false;
-        }
+void NodeCounter::operator+=(const NodeCounter& c)
+{
+    storage += c.storage;
+    files += c.files;
+    folders += c.folders;
+}
 
-        if (n == p)
-        {
-            return true;
-        }
+void NodeCounter::operator-=(const NodeCounter& c)
+{
+    storage -= c.storage;
+    files -= c.files;
+    folders -= c.folders;
+}
 
-        n = n->parent;
-    }
+NodeMemoryUsage::NodeMemoryUsage()
+{
+    nodes = 0;
+    nodeindex = 0;
+    fingerprints = 0;
+    attrs = 0;
+    strings = 0;
+    children = 0;
+    sharing = 0;
+}
+
+size_t NodeMemoryUsage::total() const
+{
+    return nodes + nodeindex + fingerprints + attrs + strings + children + sharing;
 }
 
 NodeCore::NodeCore()
@@ -886,6 +1734,180 @@ bool PublicLink::isExpired()
 }
 
 #ifdef ENABLE_SYNC
+LocalNodeChildren::LocalNodeChildren()
+{
+    indexcount = 0;
+}
+
+LocalNodeChildren::iterator LocalNodeChildren::find(const string* name)
+{
+    if (nodes.size() < NodeChildren::MININDEXED)
+    {
+        return nodes.find(name);
+    }
+
+    if (!indexed())
+    {
+        buildindex();
+    }
+
+    size_t i = indexfind(name, NodeChildren::namehash(name->data(), name->size()));
+
+    return i == index.size() ? nodes.end() : index[i].second;
+}
+
+void LocalNodeChildren::set(const string* name, LocalNode* l)
+{
+    pair<iterator, bool> r = nodes.insert(pair<const string*, LocalNode*>(name, l));
+
+    if (!r.second)
+    {
+        // name taken: the new child supersedes the old one (the key string
+        // now belongs to the new child)
+        if (indexed())
+        {
+            indexremove(r.first, NodeChildren::namehash(name->data(), name->size()));
+        }
+
+        nodes.erase(r.first);
+        r = nodes.insert(pair<const string*, LocalNode*>(name, l));
+    }
+
+    if (indexed())
+    {
+        if ((indexcount + 1) * 2 > index.size())
+        {
+            buildindex();
+        }
+
+        indexadd(r.first, NodeChildren::namehash(name->data(), name->size()));
+    }
+}
+
+void LocalNodeChildren::erase(const string* name)
+{
+    iterator it;
+
+    if (indexed())
+    {
+        uint32_t h = NodeChildren::namehash(name->data(), name->size());
+        size_t i = indexfind(name, h);
+
+        if (i == index.size())
+        {
+            return;
+        }
+
+        it = index[i].second;
+        indexremove(it, h);
+    }
+    else if ((it = nodes.find(name)) == nodes.end())
+    {
+        return;
+    }
+
+    nodes.erase(it);
+
+    if (nodes.empty())
+    {
+        index.clear();
+        indexcount = 0;
+    }
+}
+
+void LocalNodeChildren::buildindex()
+{
+    size_t size = NodeChildren::MININDEXED * 2;
+
+    while (size < nodes.size() * 4)
+    {
+        size <<= 1;
+    }
+
+    // carry the cached hashes over when growing
+    vector<nameslot> old;
+    old.swap(index);
+
+    index.assign(size, nameslot(0, nodes.end()));
+    indexcount = 0;
+
+    if (old.size())
+    {
+        for (vector<nameslot>::iterator it = old.begin(); it != old.end(); it++)
+        {
+            if (it->second != nodes.end())
+            {
+                indexadd(it->second, it->first);
+            }
+        }
+    }
+    else
+    {
+        for (iterator it = nodes.begin(); it != nodes.end(); it++)
+        {
+            indexadd(it, NodeChildren::namehash(it->first->data(), it->first->size()));
+        }
+    }
+}
+
+void LocalNodeChildren::indexadd(iterator it, uint32_t h)
+{
+    size_t mask = index.size() - 1;
+    size_t i;
+
+    for (i = h & mask; index[i].second != nodes.end(); i = (i + 1) & mask);
+
+    index[i].first = h;
+    index[i].second = it;
+    indexcount++;
+}
+
+// backward-shift deletion, as in NodeChildren::indexremove()
+void LocalNodeChildren::indexremove(iterator it, uint32_t h)
+{
+    size_t mask = index.size() - 1;
+    size_t i;
+
+    for (i = h & mask; index[i].second != it; i = (i + 1) & mask)
+    {
+        if (index[i].second == nodes.end())
+        {
+            return;
+        }
+    }
+
+    for (size_t j = (i + 1) & mask; index[j].second != nodes.end(); j = (j + 1) & mask)
+    {
+        size_t home = index[j].first & mask;
+
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            index[i] = index[j];
+            i = j;
+        }
+    }
+
+    index[i].first = 0;
+    index[i].second = nodes.end();
+    indexcount--;
+}
+
+// slot holding name or index.size()
+size_t LocalNodeChildren::indexfind(const string* name, uint32_t h) const
+{
+    size_t mask = index.size() - 1;
+
+    for (size_t i = h & mask; index[i].second != nodes.end(); i = (i + 1) & mask)
+    {
+        if (index[i].first == h && *index[i].second->first == *name)
+        {
+            return i;
+        }
+    }
+
+    return index.size();
+}
+
 // set, change or remove LocalNode's parent and name/localname/slocalname.
 // newlocalpath must be a full path and must not point to an empty string.
 // no shortname allowed as the last path component.
@@ -896,6 +1918,13 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
     int nc = 0;
     Sync* oldsync = NULL;
 
+    // a rename or move changes the paths of the whole subtree (removals are
+    // reported node by node by the destructor)
+    if (parent && !newnode && newparent)
+    {
+        sync->client->app->syncupdate_local_unlink(this, true);
+    }
+
     if (parent)
     {
         // remove existing child linkage
@@ -905,6 +1934,8 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
         {
             parent->schildren.erase(&slocalname);
         }
+
+        parent->setdirty();
     }
 
     if (newlocalpath)
@@ -1008,13 +2039,15 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
         }
 
         // (we don't construct a UTF-8 or sname for the root path)
-        parent->children[&localname] = this;
+        parent->children.set(&localname, this);
 
         if (sync->client->fsaccess->getsname(newlocalpath, &slocalname))
         {
-            parent->schildren[&slocalname] = this;
+            parent->schildren.set(&slocalname, this);
         }
 
+        setdirty();
+
         treestate(TREESTATE_NONE);
 
         if (todelete)
@@ -1036,8 +2069,8 @@ void LocalNode::setnameparent(LocalNode* newparent, string* newlocalpath)
         if (oldsync)
         {
             // update local cache if there is a sync change
-            oldsync->cachenodes();
-            sync->cachenodes();
+            oldsync->cachenodes(true);
+            sync->cachenodes(true);
         }
     }
 
@@ -1065,6 +2098,8 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
     syncxfer = true;
     newnode = NULL;
     parent_dbid = 0;
+    dbcrc = 0;
+    dirty = 0;
 
     ts = TREESTATE_NONE;
     dts = TREESTATE_NONE;
@@ -1083,6 +2118,8 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
         localname = *cfullpath;
     }
 
+    setdirty();
+
     scanseqno = sync->scanseqno;
 
     // mark fsid as not valid
@@ -1099,6 +2136,16 @@ void LocalNode::init(Sync* csync, nodetype_t ctype, LocalNode* cparent, string*
     sync->localnodes[type]++;
 }
 
+void LocalNode::setdirty(int bits)
+{
+    // (always walks to the root: a pass in progress clears a folder's flag
+    // before it visits the children)
+    for (LocalNode* l = this; l; l = l->parent)
+    {
+        l->dirty |= bits;
+    }
+}
+
 // update treestates back to the root LocalNode, inform app about changes
 void LocalNode::treestate(treestate_t newts)
 {
@@ -1163,6 +2210,11 @@ void LocalNode::setnode(Node* cnode)
         node->localnode = NULL;
     }
 
+    if (node != cnode)
+    {
+        setdirty();
+    }
+
     deleted = false;
 
     node = cnode;
@@ -1225,6 +2277,8 @@ void LocalNode::setfsid(handle newfsid)
 
 LocalNode::~LocalNode()
 {
+    sync->client->app->syncupdate_local_unlink(this, false);
+
     if (sync->state == SYNC_ACTIVE || sync->state == SYNC_INITIALSCAN)
     {
         sync->statecachedel(this);
@@ -1290,11 +2344,8 @@ LocalNode::~LocalNode()
         setnameparent(NULL, NULL);
     }
 
-    for (localnode_map::iterator it = children.begin(); it != children.end(); )
-    {
-        delete it++->second;
-    }
-
+    // the node goes first, so that a deleted subtree is moved to SyncDebris
+    // as a whole instead of one node per child
     if (node)
     {
         // move associated node to SyncDebris unless the sync is currently
@@ -1308,6 +2359,11 @@ LocalNode::~LocalNode()
             sync->client->movetosyncdebris(node, sync->inshare);
         }
     }
+
+    for (localnode_map::iterator it = children.begin(); it != children.end(); )
+    {
+        delete it++->second;
+    }
 }
 
 void LocalNode::getlocalpath(string* path, bool sdisable) const
@@ -1363,7 +2419,7 @@ void LocalNode::getlocalsubpath(string* path) const
 // locate child by localname or slocalname
 LocalNode* LocalNode::childbyname(string* localname)
 {
-    localnode_map::iterator it;
+    LocalNodeChildren::iterator it;
 
     if ((it = children.find(localname)) == children.end() && (it = schildren.find(localname)) == schildren.end())
     {
@@ -1412,6 +2468,12 @@ void LocalNode::completed(Transfer* t, LocalNode*)
     File::completed(t, this);
 }
 
+// upload stopped or failed: have syncup() reconsider this file
+void LocalNode::terminated()
+{
+    setdirty(DIRTY_SYNCUP);
+}
+
 // serialize/unserialize the following LocalNode properties:
 // - type/size
 // - fsid
@@ -1452,8 +2514,31 @@ bool LocalNode::serialize(string* d)
     return true;
 }
 
+// records the CRC32 of the serialized record and returns true if it differs
+// from the one last stored (or nothing has been stored yet)
+bool LocalNode::cachechanged(const string* d)
+{
+    HashCRC32 hash;
+    byte buf[4];
+
+    hash.add((const byte*)d->data(), d->size());
+    hash.get(buf);
+
+    uint32_t crc = MemAccess::get<uint32_t>((const char*)buf);
+
+    if (dbid && crc == dbcrc)
+    {
+        return false;
+    }
+
+    dbcrc = crc;
+    return true;
+}
+
 LocalNode* LocalNode::unserialize(Sync* sync, string* d)
 {
+    AllocScope allocscope(AllocTags::SYNC);
+
     if (d->size() < sizeof(m_off_t)         // type/size combo
                   + sizeof(handle)          // fsid
                   + sizeof(uint32_t)        // parent dbid
@@ -0,0 +1,463 @@
+/**
+ * @file nodemap.cpp
+ * @brief Hash indexes of nodes by node handle and by fingerprint
+ *
+ * (c) 2013-2014 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/nodemap.h"
+#include "mega/node.h"
+#include "mega/logging.h"
+
+namespace mega {
+
+NodeHandleMap::iterator::iterator()
+{
+    slot = NULL;
+    last = NULL;
+}
+
+NodeHandleMap::iterator::iterator(value_type* s, value_type* l)
+{
+    slot = s;
+    last = l;
+    skip();
+}
+
+// advance to the next occupied slot (or end)
+void NodeHandleMap::iterator::skip()
+{
+    while (slot < last && (slot->first == EMPTYSLOT || slot->first == DELETEDSLOT))
+    {
+        slot++;
+    }
+}
+
+NodeHandleMap::iterator& NodeHandleMap::iterator::operator++()
+{
+    slot++;
+    skip();
+    return *this;
+}
+
+NodeHandleMap::iterator NodeHandleMap::iterator::operator++(int)
+{
+    iterator it = *this;
+    ++*this;
+    return it;
+}
+
+NodeHandleMap::NodeHandleMap()
+{
+    slots = NULL;
+    mask = 0;
+    count = 0;
+    used = 0;
+}
+
+NodeHandleMap::~NodeHandleMap()
+{
+    delete[] slots;
+}
+
+// node handles are random, but fold the upper bits in to be safe with
+// handles that only differ in their high bytes
+size_t NodeHandleMap::hash(handle h)
+{
+    h ^= h >> 29;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    h ^= h >> 32;
+
+    return (size_t)h;
+}
+
+NodeHandleMap::iterator NodeHandleMap::begin()
+{
+    return iterator(slots, slots ? slots + mask + 1 : NULL);
+}
+
+NodeHandleMap::iterator NodeHandleMap::end()
+{
+    value_type* last = slots ? slots + mask + 1 : NULL;
+
+    return iterator(last, last);
+}
+
+NodeHandleMap::value_type* NodeHandleMap::lookup(handle h) const
+{
+    if (!count)
+    {
+        return NULL;
+    }
+
+    for (size_t i = hash(h) & mask; ; i = (i + 1) & mask)
+    {
+        if (slots[i].first == h)
+        {
+            return slots + i;
+        }
+
+        if (slots[i].first == EMPTYSLOT)
+        {
+            return NULL;
+        }
+    }
+}
+
+NodeHandleMap::iterator NodeHandleMap::find(handle h)
+{
+    value_type* s = lookup(h);
+
+    if (!s)
+    {
+        return end();
+    }
+
+    return iterator(s, slots + mask + 1);
+}
+
+Node*& NodeHandleMap::operator[](handle h)
+{
+    value_type* s = lookup(h);
+
+    if (s)
+    {
+        return s->second;
+    }
+
+    // keep the load factor (including deleted slots) below 3/4
+    if ((used + 1) * 4 > (mask + 1) * 3)
+    {
+        rehash(count + 1);
+    }
+
+    value_type* tomb = NULL;
+    size_t i;
+
+    for (i = hash(h) & mask; slots[i].first != EMPTYSLOT; i = (i + 1) & mask)
+    {
+        if (!tomb && slots[i].first == DELETEDSLOT)
+        {
+            tomb = slots + i;
+        }
+    }
+
+    if (tomb)
+    {
+        s = tomb;
+    }
+    else
+    {
+        s = slots + i;
+        used++;
+    }
+
+    s->first = h;
+    s->second = NULL;
+    count++;
+
+    return s->second;
+}
+
+size_t NodeHandleMap::erase(handle h)
+{
+    value_type* s = lookup(h);
+
+    if (!s)
+    {
+        return 0;
+    }
+
+    s->first = DELETEDSLOT;
+    s->second = NULL;
+    count--;
+
+    return 1;
+}
+
+void NodeHandleMap::erase(iterator it)
+{
+    if (it.slot && it.slot < it.last)
+    {
+        it.slot->first = DELETEDSLOT;
+        it.slot->second = NULL;
+        count--;
+    }
+}
+
+void NodeHandleMap::clear()
+{
+    delete[] slots;
+    slots = NULL;
+    mask = 0;
+    count = 0;
+    used = 0;
+}
+
+void NodeHandleMap::reserve(size_t n)
+{
+    if (n * 4 > (mask + 1) * 3 || !slots)
+    {
+        rehash(n);
+    }
+}
+
+size_t NodeHandleMap::allocated() const
+{
+    return slots ? (mask + 1) * sizeof(value_type) : 0;
+}
+
+// resize to hold at least n elements at a load factor of at most 1/2 and drop
+// deleted slots
+void NodeHandleMap::rehash(size_t n)
+{
+    size_t newsize = MINSLOTS;
+
+    while (newsize < n * 2)
+    {
+        newsize <<= 1;
+    }
+
+    value_type* oldslots = slots;
+    size_t oldsize = slots ? mask + 1 : 0;
+
+    slots = new value_type[newsize];
+    mask = newsize - 1;
+    used = count;
+
+    for (size_t i = newsize; i--; )
+    {
+        slots[i].first = EMPTYSLOT;
+        slots[i].second = NULL;
+    }
+
+    for (size_t i = 0; i < oldsize; i++)
+    {
+        if (oldslots[i].first != EMPTYSLOT && oldslots[i].first != DELETEDSLOT)
+        {
+            size_t j;
+
+            for (j = hash(oldslots[i].first) & mask; slots[j].first != EMPTYSLOT; j = (j + 1) & mask);
+
+            slots[j] = oldslots[i];
+        }
+    }
+
+    delete[] oldslots;
+}
+
+FingerprintIndex::FingerprintIndex()
+{
+    slots = NULL;
+    mask = 0;
+    count = 0;
+    lookups = 0;
+    hits = 0;
+    tolerancehits = 0;
+}
+
+FingerprintIndex::~FingerprintIndex()
+{
+    delete[] slots;
+}
+
+FingerprintIndex::iterator FingerprintIndex::end() const
+{
+    iterator it;
+    it.slot = ~(size_t)0;
+    return it;
+}
+
+// mtime is deliberately not part of the hash, as lookups tolerate deviations
+size_t FingerprintIndex::hash(const FileFingerprint* fp)
+{
+    uint64_t h = (uint64_t)fp->size;
+
+    for (int i = 0; i < 4; i++)
+    {
+        h = (h ^ (uint32_t)fp->crc[i]) * 0x100000001b3ULL;
+    }
+
+    h ^= h >> 31;
+
+    return (size_t)h;
+}
+
+void FingerprintIndex::place(Node* n)
+{
+    size_t i;
+
+    for (i = hash(n) & mask; slots[i]; i = (i + 1) & mask);
+
+    slots[i] = n;
+    n->fingerprint_it.slot = i;
+}
+
+FingerprintIndex::iterator FingerprintIndex::insert(FileFingerprint* fp)
+{
+    Node* n = (Node*)fp;
+
+    // keep the load factor at or below 1/2
+    if ((count + 1) * 2 > (slots ? mask + 1 : 0))
+    {
+        rehash(count + 1);
+    }
+
+    place(n);
+    count++;
+
+    return n->fingerprint_it;
+}
+
+// backward-shift deletion: entries following the vacated slot move up (and
+// their owners' fingerprint_it with them) unless that would take them before
+// their home slot
+void FingerprintIndex::erase(iterator it)
+{
+    size_t i = it.slot;
+
+    if (!slots || i > mask || !slots[i])
+    {
+        return;
+    }
+
+    slots[i]->fingerprint_it = end();
+
+    for (size_t j = (i + 1) & mask; slots[j]; j = (j + 1) & mask)
+    {
+        size_t home = hash(slots[j]) & mask;
+
+        if (((j - home) & mask) >= ((j - i) & mask))
+        {
+            slots[i] = slots[j];
+            slots[i]->fingerprint_it.slot = i;
+            i = j;
+        }
+    }
+
+    slots[i] = NULL;
+    count--;
+}
+
+void FingerprintIndex::clear()
+{
+    if (slots)
+    {
+        for (size_t i = 0; i <= mask; i++)
+        {
+            if (slots[i])
+            {
+                slots[i]->fingerprint_it = end();
+            }
+        }
+    }
+
+    delete[] slots;
+    slots = NULL;
+    mask = 0;
+    count = 0;
+}
+
+Node* FingerprintIndex::find(FileFingerprint* fp)
+{
+    Node* tolerated = NULL;
+
+    lookups++;
+
+    if (!count)
+    {
+        return NULL;
+    }
+
+    for (size_t i = hash(fp) & mask; slots[i]; i = (i + 1) & mask)
+    {
+        Node* n = slots[i];
+
+        if (n->size == fp->size && !memcmp(n->crc, fp->crc, sizeof n->crc))
+        {
+            if (n->mtime == fp->mtime)
+            {
+                hits++;
+                return n;
+            }
+
+            if (!tolerated && *fp == *(FileFingerprint*)n)
+            {
+                tolerated = n;
+            }
+        }
+    }
+
+    if (tolerated)
+    {
+        hits++;
+        tolerancehits++;
+    }
+
+    return tolerated;
+}
+
+void FingerprintIndex::findall(FileFingerprint* fp, node_vector* nodes)
+{
+    if (!count)
+    {
+        return;
+    }
+
+    for (size_t i = hash(fp) & mask; slots[i]; i = (i + 1) & mask)
+    {
+        Node* n = slots[i];
+
+        if (n->size == fp->size && !memcmp(n->crc, fp->crc, sizeof n->crc))
+        {
+            nodes->push_back(n);
+        }
+    }
+}
+
+size_t FingerprintIndex::allocated() const
+{
+    return slots ? (mask + 1) * sizeof(Node*) : 0;
+}
+
+void FingerprintIndex::rehash(size_t n)
+{
+    size_t newsize = MINSLOTS;
+
+    while (newsize < n * 4)
+    {
+        newsize <<= 1;
+    }
+
+    Node** oldslots = slots;
+    size_t oldsize = slots ? mask + 1 : 0;
+
+    slots = new Node*[newsize];
+    mask = newsize - 1;
+    memset(slots, 0, newsize * sizeof *slots);
+
+    for (size_t i = 0; i < oldsize; i++)
+    {
+        if (oldslots[i])
+        {
+            place(oldslots[i]);
+        }
+    }
+
+    delete[] oldslots;
+}
+} // namespace
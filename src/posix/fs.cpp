@@ -27,6 +27,11 @@
 #include <sys/utsname.h>
 #include <sys/ioctl.h>
 
+#if defined(__linux__) && !defined(FICLONE)
+// from linux/fs.h, which clashes with sys/mount.h
+#define FICLONE _IOW(0x94, 9, int)
+#endif
+
 namespace mega {
 PosixFileAccess::PosixFileAccess()
 {
@@ -121,6 +126,17 @@ bool PosixFileAccess::fwrite(const byte* data, unsigned len, m_off_t pos)
 #endif
 }
 
+// fallocate() fails on filesystems without native support instead of
+// writing zeros like posix_fallocate()
+bool PosixFileAccess::preallocate(m_off_t len)
+{
+#if defined(__linux__) && defined(FALLOC_FL_KEEP_SIZE)
+    return !fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, len);
+#else
+    return false;
+#endif
+}
+
 bool PosixFileAccess::fopen(string* f, bool read, bool write)
 {
     struct stat statbuf;
@@ -202,6 +218,18 @@ PosixFileSystemAccess::PosixFileSystemAccess(int fseventsfd)
     }
 #endif
 
+#ifdef USE_FANOTIFY
+    // fails without CAP_SYS_ADMIN or on kernels without directory handle
+    // and name reporting - inotify is used then
+    fanotifyfd = fanotify_init(FAN_CLASS_NOTIF | FAN_CLOEXEC | FAN_NONBLOCK | FAN_REPORT_DFID_NAME, O_RDONLY | O_LARGEFILE);
+    fanotifyfromsync = NULL;
+
+    if (fanotifyfd >= 0)
+    {
+        notifyfailed = false;
+    }
+#endif
+
 #ifdef __MACH__
 #if __LP64__
     typedef struct fsevent_clone_args {
@@ -278,6 +306,13 @@ PosixFileSystemAccess::~PosixFileSystemAccess()
     {
         close(notifyfd);
     }
+
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0)
+    {
+        close(fanotifyfd);
+    }
+#endif
 }
 
 // wake up from filesystem updates
@@ -292,13 +327,188 @@ void PosixFileSystemAccess::addevents(Waiter* w, int flags)
 
         pw->bumpmaxfd(notifyfd);
     }
+
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0)
+    {
+        PosixWaiter* pw = (PosixWaiter*)w;
+
+        FD_SET(fanotifyfd, &pw->rfds);
+        FD_SET(fanotifyfd, &pw->ignorefds);
+
+        pw->bumpmaxfd(fanotifyfd);
+    }
+#endif
+}
+
+#if defined(ENABLE_SYNC) && defined(USE_FANOTIFY)
+// resolve the directory handle of an event through the first sync on the
+// same filesystem and match the path against the fanotify syncs
+Sync* PosixFileSystemAccess::fanotifypath(fanotify_event_info_fid* fid, string* relpath)
+{
+    file_handle* fh = (file_handle*)fid->handle;
+    const char* name = (const char*)fh->f_handle + fh->handle_bytes;
+    string path;
+    sync_list::iterator it;
+
+    for (it = client->syncs.begin(); it != client->syncs.end(); it++)
+    {
+        PosixDirNotify* dn = (PosixDirNotify*)(*it)->dirnotify;
+
+        if (!dn->fanotify || memcmp(dn->fsid, &fid->fsid, sizeof dn->fsid))
+        {
+            continue;
+        }
+
+        if (!path.size())
+        {
+            char procpath[32];
+            char buf[PATH_MAX];
+            ssize_t len;
+            int fd;
+
+            // the directory may have been deleted in the meantime
+            if ((fd = open_by_handle_at(dn->mountfd, fh, O_PATH)) < 0)
+            {
+                return NULL;
+            }
+
+            sprintf(procpath, "/proc/self/fd/%d", fd);
+            len = readlink(procpath, buf, sizeof buf);
+            close(fd);
+
+            if (len <= 0 || len >= (ssize_t)sizeof buf)
+            {
+                return NULL;
+            }
+
+            path.assign(buf, len);
+
+            if (strcmp(name, "."))
+            {
+                path.append("/");
+                path.append(name);
+            }
+        }
+
+        size_t rsize = dn->realbasepath.size();
+        size_t isize = dn->ignore.size();
+
+        // strictly below the sync root and not in its debris folder
+        if (path.size() > rsize + 1
+         && !memcmp(path.data(), dn->realbasepath.data(), rsize)
+         && path[rsize] == '/'
+         && (path.size() < rsize + 1 + isize
+          || memcmp(path.data() + rsize + 1, dn->ignore.data(), isize)
+          || (path.size() > rsize + 1 + isize && path[rsize + 1 + isize] != '/')))
+        {
+            relpath->assign(path, rsize + 1, string::npos);
+            return *it;
+        }
+    }
+
+    return NULL;
 }
 
+// notify a pending move source that was not followed by its target
+void PosixFileSystemAccess::fanotifyflush(int* r)
+{
+    if (fanotifyfromsync)
+    {
+        fanotifyfromsync->dirnotify->notify(DirNotify::DIREVENTS,
+                                            &fanotifyfromsync->localroot,
+                                            fanotifyfrom.data(),
+                                            fanotifyfrom.size());
+
+        fanotifyfromsync = NULL;
+        *r |= Waiter::NEEDEXEC;
+    }
+}
+#endif
+
 // read all pending inotify events and queue them for processing
 int PosixFileSystemAccess::checkevents(Waiter* w)
 {
     int r = 0;
 #ifdef ENABLE_SYNC
+#ifdef USE_FANOTIFY
+    if (fanotifyfd >= 0 && FD_ISSET(fanotifyfd, &((PosixWaiter*)w)->rfds))
+    {
+        char buf[65536] __attribute__((aligned(__alignof__(fanotify_event_metadata))));
+        fanotify_event_metadata* m;
+        ssize_t l, len;
+
+        while ((l = read(fanotifyfd, buf, sizeof buf)) > 0)
+        {
+            len = l;
+
+            for (m = (fanotify_event_metadata*)buf; FAN_EVENT_OK(m, len); m = FAN_EVENT_NEXT(m, len))
+            {
+                if (m->vers != FANOTIFY_METADATA_VERSION)
+                {
+                    notifyerr = true;
+                    break;
+                }
+
+                if (m->mask & FAN_Q_OVERFLOW)
+                {
+                    notifyerr = true;
+                    continue;
+                }
+
+                fanotify_event_info_fid* fid = (fanotify_event_info_fid*)(m + 1);
+
+                if ((char*)(fid + 1) > (char*)m + m->event_len
+                 || fid->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID_NAME)
+                {
+                    continue;
+                }
+
+                // as with inotify, new files are picked up when closed
+                if ((m->mask & (FAN_CREATE | FAN_ONDIR)) == FAN_CREATE
+                 || !(m->mask & (FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE)))
+                {
+                    continue;
+                }
+
+                string relpath;
+                Sync* sync = fanotifypath(fid, &relpath);
+
+                if (m->mask & FAN_MOVED_FROM)
+                {
+                    fanotifyflush(&r);
+
+                    if (sync)
+                    {
+                        fanotifyfromsync = sync;
+                        fanotifyfrom = relpath;
+                    }
+
+                    continue;
+                }
+
+                // the move target supersedes its source
+                if ((m->mask & FAN_MOVED_TO) && sync)
+                {
+                    fanotifyfromsync = NULL;
+                }
+                else
+                {
+                    fanotifyflush(&r);
+                }
+
+                if (sync)
+                {
+                    sync->dirnotify->notify(DirNotify::DIREVENTS, &sync->localroot, relpath.data(), relpath.size());
+                    r |= Waiter::NEEDEXEC;
+                }
+            }
+        }
+
+        fanotifyflush(&r);
+    }
+#endif
+
 #ifdef USE_INOTIFY
     PosixWaiter* pw = (PosixWaiter*)w;
     string *ignore;
@@ -619,6 +829,29 @@ bool PosixFileSystemAccess::copylocal(string* oldname, string* newname, m_time_t
     int sfd, tfd;
     ssize_t t = -1;
 
+#ifdef __linux__
+    // a copy-on-write clone shares the data blocks (btrfs, XFS), other
+    // filesystems get a regular copy below
+    if ((sfd = open(oldname->c_str(), O_RDONLY)) >= 0)
+    {
+        if ((tfd = open(newname->c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600)) >= 0)
+        {
+            if (!ioctl(tfd, FICLONE, sfd))
+            {
+                LOG_verbose << "Copying via clone";
+                t = 0;
+            }
+
+            close(tfd);
+        }
+
+        close(sfd);
+    }
+
+    if (t)
+    {
+#endif
+
 #ifdef HAVE_SENDFILE
     // Linux-specific - kernel 2.6.33+ required
     if ((sfd = open(oldname->c_str(), O_RDONLY | O_DIRECT)) >= 0)
@@ -650,6 +883,9 @@ bool PosixFileSystemAccess::copylocal(string* oldname, string* newname, m_time_t
 
         close(sfd);
     }
+#ifdef __linux__
+    }
+#endif
 
     if (!t)
     {
@@ -858,6 +1094,11 @@ PosixDirNotify::PosixDirNotify(string* localbasepath, string* ignore) : DirNotif
     failed = false;
 #endif
 
+#ifdef USE_FANOTIFY
+    fanotify = false;
+    mountfd = -1;
+#endif
+
 #ifdef __MACH__
     failed = false;
 #endif
@@ -865,12 +1106,32 @@ PosixDirNotify::PosixDirNotify(string* localbasepath, string* ignore) : DirNotif
     fsaccess = NULL;
 }
 
+#ifdef USE_FANOTIFY
+PosixDirNotify::~PosixDirNotify()
+{
+    if (mountfd >= 0)
+    {
+        close(mountfd);
+    }
+}
+#endif
+
 void PosixDirNotify::addnotify(LocalNode* l, string* path)
 {
 #ifdef ENABLE_SYNC
 #ifdef USE_INOTIFY
     int wd;
 
+    l->dirnotifytag = (handle)-1;
+
+#ifdef USE_FANOTIFY
+    // covered by the filesystem-wide mark
+    if (fanotify)
+    {
+        return;
+    }
+#endif
+
     wd = inotify_add_watch(fsaccess->notifyfd, path->c_str(),
                            IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
                            | IN_CLOSE_WRITE | IN_EXCL_UNLINK | IN_ONLYDIR);
@@ -922,6 +1183,53 @@ DirNotify* PosixFileSystemAccess::newdirnotify(string* localpath, string* ignore
 
     dirnotify->fsaccess = this;
 
+#ifdef USE_FANOTIFY
+    struct statfs statfsbuf;
+    char* rp;
+
+    // one mark covers the whole filesystem (adding it again for further
+    // syncs on it is harmless) - events are resolved to paths through
+    // open_by_handle_at(), which must be permitted as well
+    if (fanotifyfd >= 0 && (rp = realpath(localpath->c_str(), NULL)))
+    {
+        dirnotify->realbasepath = rp;
+        free(rp);
+
+        if (!statfs(dirnotify->realbasepath.c_str(), &statfsbuf)
+         && (dirnotify->mountfd = open(dirnotify->realbasepath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)) >= 0)
+        {
+            char buf[sizeof(file_handle) + MAX_HANDLE_SZ];
+            file_handle* fh = (file_handle*)buf;
+            int mountid, fd = -1;
+
+            fh->handle_bytes = MAX_HANDLE_SZ;
+
+            if (!name_to_handle_at(AT_FDCWD, dirnotify->realbasepath.c_str(), fh, &mountid, 0)
+             && (fd = open_by_handle_at(dirnotify->mountfd, fh, O_PATH)) >= 0
+             && !fanotify_mark(fanotifyfd, FAN_MARK_ADD | FAN_MARK_FILESYSTEM,
+                               FAN_CREATE | FAN_DELETE | FAN_MOVED_FROM | FAN_MOVED_TO | FAN_CLOSE_WRITE | FAN_ONDIR,
+                               AT_FDCWD, dirnotify->realbasepath.c_str()))
+            {
+                memcpy(dirnotify->fsid, &statfsbuf.f_fsid, sizeof dirnotify->fsid);
+                dirnotify->fanotify = true;
+                dirnotify->failed = false;
+
+                LOG_debug << "Using fanotify for " << dirnotify->realbasepath;
+            }
+            else
+            {
+                close(dirnotify->mountfd);
+                dirnotify->mountfd = -1;
+            }
+
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+        }
+    }
+#endif
+
     return dirnotify;
 }
 
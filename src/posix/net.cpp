@@ -25,8 +25,47 @@
 #define IPV6_RETRY_INTERVAL_DS 72000
 #define DNS_CACHE_TIMEOUT_DS 18000
 
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
 namespace mega {
 
+CURLSH* CurlHttpIO::curlsh = NULL;
+int CurlHttpIO::curlshusers = 0;
+
+// one lock per kind of data in the share, taken from the threads of all
+// instances
+#ifdef _WIN32
+static CRITICAL_SECTION sharelocks[CURL_LOCK_DATA_LAST];
+#else
+static pthread_mutex_t sharelocks[CURL_LOCK_DATA_LAST];
+#endif
+
+void CurlHttpIO::share_lock(CURL*, curl_lock_data data, curl_lock_access, void*)
+{
+    if (data >= 0 && data < CURL_LOCK_DATA_LAST)
+    {
+#ifdef _WIN32
+        EnterCriticalSection(&sharelocks[data]);
+#else
+        pthread_mutex_lock(&sharelocks[data]);
+#endif
+    }
+}
+
+void CurlHttpIO::share_unlock(CURL*, curl_lock_data data, void*)
+{
+    if (data >= 0 && data < CURL_LOCK_DATA_LAST)
+    {
+#ifdef _WIN32
+        LeaveCriticalSection(&sharelocks[data]);
+#else
+        pthread_mutex_unlock(&sharelocks[data]);
+#endif
+    }
+}
+
 CurlHttpIO::CurlHttpIO()
 {
     curl_version_info_data* data = curl_version_info(CURLVERSION_NOW);
@@ -60,6 +99,14 @@ CurlHttpIO::CurlHttpIO()
     curlipv6 = data->features & CURL_VERSION_IPV6;
     LOG_debug << "IPv6 enabled: " << curlipv6;
 
+#if defined(CURL_VERSION_HTTP2) && LIBCURL_VERSION_NUM >= 0x072b00
+    curlhttp2 = data->features & CURL_VERSION_HTTP2;
+#else
+    curlhttp2 = false;
+#endif
+    http2 = false;
+    http2multiplex = false;
+
     reset = false;
     statechange = false;
 
@@ -83,11 +130,30 @@ CurlHttpIO::CurlHttpIO()
     curl_multi_setopt(curlm, CURLMOPT_TIMERDATA, this);
     curltimeoutms = -1;
     arestimeoutds = -1;
+#elif !defined(_WIN32)
+    curl_multi_setopt(curlm, CURLMOPT_SOCKETFUNCTION, socket_callback);
+    curl_multi_setopt(curlm, CURLMOPT_SOCKETDATA, this);
 #endif
 
-    curlsh = curl_share_init();
-    curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
-    curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    // the first instance sets up the share for all of them (instances are
+    // created and destroyed one at a time, as curl_global_init() requires)
+    if (!curlshusers++)
+    {
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        {
+#ifdef _WIN32
+            InitializeCriticalSection(&sharelocks[i]);
+#else
+            pthread_mutex_init(&sharelocks[i], NULL);
+#endif
+        }
+
+        curlsh = curl_share_init();
+        curl_share_setopt(curlsh, CURLSHOPT_LOCKFUNC, share_lock);
+        curl_share_setopt(curlsh, CURLSHOPT_UNLOCKFUNC, share_unlock);
+        curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+        curl_share_setopt(curlsh, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    }
 
     contenttypejson = curl_slist_append(NULL, "Content-Type: application/json");
     contenttypejson = curl_slist_append(contenttypejson, "Expect:");
@@ -336,6 +402,21 @@ CurlHttpIO::~CurlHttpIO()
     curl_multi_cleanup(curlm);
     ares_destroy(ares);
 
+    if (!--curlshusers)
+    {
+        curl_share_cleanup(curlsh);
+        curlsh = NULL;
+
+        for (int i = 0; i < CURL_LOCK_DATA_LAST; i++)
+        {
+#ifdef _WIN32
+            DeleteCriticalSection(&sharelocks[i]);
+#else
+            pthread_mutex_destroy(&sharelocks[i]);
+#endif
+        }
+    }
+
     curl_global_cleanup();
     ares_library_cleanup();
 }
@@ -345,6 +426,18 @@ void CurlHttpIO::setuseragent(string* u)
     useragent = *u;
 }
 
+bool CurlHttpIO::sethttp2(bool enable)
+{
+    if (enable && !curlhttp2)
+    {
+        LOG_warn << "HTTP/2 not supported by libcurl";
+        return false;
+    }
+
+    http2 = enable;
+    return true;
+}
+
 void CurlHttpIO::setdnsservers(const char* servers)
 {
     if (servers)
@@ -385,12 +478,22 @@ void CurlHttpIO::disconnect()
         }
     }
     curlsockets.clear();
+#elif !defined(_WIN32)
+    // the sockets are closed, drop their waiter registrations on the next
+    // addevents()
+    for (std::map<int, int>::iterator it = pollsockets.begin(); it != pollsockets.end(); it++)
+    {
+        pollchanged.insert(it->first);
+    }
+    pollsockets.clear();
 #endif
 
     lastdnspurge = Waiter::ds + DNS_CACHE_TIMEOUT_DS / 2;
     dnscache.clear();
 
     curlm = curl_multi_init();
+    http2multiplex = false;
+
     struct ares_options options;
     options.tries = 2;
     ares_init_options(&ares, &options, ARES_OPT_TRIES);
@@ -402,6 +505,9 @@ void CurlHttpIO::disconnect()
     curl_multi_setopt(curlm, CURLMOPT_TIMERDATA, this);
     curltimeoutms = -1;
     arestimeoutds = -1;
+#elif !defined(_WIN32)
+    curl_multi_setopt(curlm, CURLMOPT_SOCKETFUNCTION, socket_callback);
+    curl_multi_setopt(curlm, CURLMOPT_SOCKETDATA, this);
 #endif
 
     if (dnsservers.size())
@@ -421,15 +527,25 @@ void CurlHttpIO::addevents(Waiter* w, int)
     waiter = (WAIT_CLASS*)w;
 
 #if !defined(_WIN32) || defined(WINDOWS_PHONE)
-    int t;
-    curl_multi_fdset(curlm, &waiter->rfds, &waiter->wfds, &waiter->efds, &t);
-    waiter->bumpmaxfd(t);
-
     long curltimeoutms, arestimeoutds;
-    curl_multi_timeout(curlm, &curltimeoutms);
 
-    t = ares_fds(ares, &waiter->rfds, &waiter->wfds);
-    waiter->bumpmaxfd(t);
+#ifndef _WIN32
+    if (waiter->persistent())
+    {
+        addpollevents();
+    }
+    else
+#endif
+    {
+        int t;
+        curl_multi_fdset(curlm, &waiter->rfds, &waiter->wfds, &waiter->efds, &t);
+        waiter->bumpmaxfd(t);
+
+        t = ares_fds(ares, &waiter->rfds, &waiter->wfds);
+        waiter->bumpmaxfd(t);
+    }
+
+    curl_multi_timeout(curlm, &curltimeoutms);
 #else
     addaresevents(waiter);
     addcurlevents(waiter);
@@ -467,8 +583,94 @@ void CurlHttpIO::addevents(Waiter* w, int)
     {
         arestimeoutds = -1;
     }
+
+    // check the bandwidth budget of shaped connections again shortly
+    if (!shaperpaused.empty() && waiter->maxds > 1)
+    {
+        waiter->maxds = 1;
+    }
 }
 
+#ifndef _WIN32
+// update the waiter registrations: curl sockets changed by socket_callback()
+// since the last call and the (at most ARES_GETSOCK_MAXNUM) c-ares sockets
+void CurlHttpIO::addpollevents()
+{
+    for (std::set<int>::iterator it = pollchanged.begin(); it != pollchanged.end(); it++)
+    {
+        std::map<int, int>::iterator sit = pollsockets.find(*it);
+        waiter->watch(*it, sit == pollsockets.end() ? 0 : sit->second);
+    }
+    pollchanged.clear();
+
+    ares_socket_t socks[ARES_GETSOCK_MAXNUM];
+    int bitmask = ares_getsock(ares, socks, ARES_GETSOCK_MAXNUM);
+    std::map<int, int> current;
+
+    for (int i = 0; i < ARES_GETSOCK_MAXNUM; i++)
+    {
+        int events = (ARES_GETSOCK_READABLE(bitmask, i) ? PosixWaiter::WATCHREAD : 0)
+                   | (ARES_GETSOCK_WRITABLE(bitmask, i) ? PosixWaiter::WATCHWRITE : 0);
+
+        if (events)
+        {
+            current[socks[i]] |= events;
+        }
+    }
+
+    for (std::map<int, int>::iterator it = pollares.begin(); it != pollares.end(); it++)
+    {
+        if (!current.count(it->first))
+        {
+            waiter->watch(it->first, 0);
+        }
+    }
+
+    for (std::map<int, int>::iterator it = current.begin(); it != current.end(); it++)
+    {
+        std::map<int, int>::iterator ait = pollares.find(it->first);
+
+        if (ait == pollares.end() || ait->second != it->second)
+        {
+            waiter->watch(it->first, it->second);
+        }
+    }
+
+    pollares.swap(current);
+}
+
+// hand the ready c-ares sockets to c-ares (plus its timeouts) and collect
+// the ready curl sockets - only the fds that actually fired are visited
+void CurlHttpIO::pollready(std::vector<std::pair<int, int> >* curlready)
+{
+    for (std::map<int, int>::iterator it = waiter->readyfds.begin(); it != waiter->readyfds.end(); )
+    {
+        int fd = it->first;
+        int events = it->second;
+
+        if (pollares.count(fd))
+        {
+            ares_process_fd(ares,
+                            (events & PosixWaiter::WATCHREAD) ? fd : ARES_SOCKET_BAD,
+                            (events & PosixWaiter::WATCHWRITE) ? fd : ARES_SOCKET_BAD);
+        }
+        else if (pollsockets.count(fd))
+        {
+            curlready->push_back(*it);
+        }
+        else
+        {
+            it++;
+            continue;
+        }
+
+        waiter->readyfds.erase(it++);
+    }
+
+    ares_process_fd(ares, ARES_SOCKET_BAD, ARES_SOCKET_BAD);
+}
+#endif
+
 void CurlHttpIO::proxy_ready_callback(void* arg, int status, int, hostent* host)
 {
     // the name of a proxy has been resolved
@@ -758,12 +960,21 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
     {
         LOG_debug << "[sending " << (data ? len : req->out->size()) << " bytes of raw data]";
     }
+    else if (req->gzipped)
+    {
+        LOG_debug << "[sending " << req->out->size() << " bytes of compressed data]";
+    }
     else
     {
         LOG_debug << "Sending: " << *req->out;
     }
 
     httpctx->headers = clone_curl_slist(req->type == REQ_JSON ? httpio->contenttypejson : httpio->contenttypebinary);
+
+    if (req->gzipped)
+    {
+        httpctx->headers = curl_slist_append(httpctx->headers, "Content-Encoding: gzip");
+    }
     httpctx->posturl = req->posturl;
 
 
@@ -771,6 +982,10 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
     {
         LOG_debug << "Using the hostname instead of the IP";
     }
+    else if (httpio->resolveaddresses(httpctx))
+    {
+        LOG_debug << "Passing the IP of the hostname to cURL";
+    }
     else if(httpctx->hostip.size())
     {
         LOG_debug << "Using the IP of the hostname";
@@ -783,6 +998,8 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         req->status = REQ_FAILURE;
         req->httpiohandle = NULL;
         curl_slist_free_all(httpctx->headers);
+        curl_slist_free_all(httpctx->resolve);
+        httpctx->resolve = NULL;
 
         httpctx->req = NULL;
         if(!httpctx->ares_pending)
@@ -796,6 +1013,15 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
 
     CURL* curl;
 
+#if LIBCURL_VERSION_NUM >= 0x072b00
+    // (un)set multiplexing lazily, sethttp2() may be called from other threads
+    if (httpio->http2 != httpio->http2multiplex)
+    {
+        curl_multi_setopt(httpio->curlm, CURLMOPT_PIPELINING, httpio->http2 ? CURLPIPE_MULTIPLEX : CURLPIPE_NOTHING);
+        httpio->http2multiplex = httpio->http2;
+    }
+#endif
+
     if ((curl = curl_easy_init()))
     {
         curl_easy_setopt(curl, CURLOPT_POST, 1);
@@ -807,6 +1033,14 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
             curl_easy_setopt(curl, CURLOPT_READDATA, (void*)req);                     
             curl_slist_append(httpctx->headers, "Transfer-Encoding: chunked");
         }
+        else if (req->shapedir == PUT && httpio->shaper.limited(PUT, req->shapeclass))
+        {
+            // feed the data at the shaped rate
+            httpctx->sent = 0;
+            curl_easy_setopt(curl, CURLOPT_READFUNCTION, read_shaped);
+            curl_easy_setopt(curl, CURLOPT_READDATA, (void*)httpctx);
+            curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data ? len : req->out->size());
+        }
         else
         {
             curl_easy_setopt(curl, CURLOPT_POSTFIELDS, data ? data : req->out->data());
@@ -817,6 +1051,13 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_HTTPHEADER, httpctx->headers);
         curl_easy_setopt(curl, CURLOPT_ENCODING, "");
         curl_easy_setopt(curl, CURLOPT_SHARE, httpio->curlsh);
+
+#if LIBCURL_VERSION_NUM >= 0x073b00
+        if (httpctx->resolve)
+        {
+            curl_easy_setopt(curl, CURLOPT_RESOLVE, httpctx->resolve);
+        }
+#endif
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
         curl_easy_setopt(curl, CURLOPT_WRITEDATA, (void*)req);
         curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, check_header);
@@ -826,6 +1067,25 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_NOSIGNAL, true);
         curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, 10L);
 
+#if LIBCURL_VERSION_NUM >= 0x071900
+        // keep idle connections in cURL's pool (and their NAT mappings)
+        // alive, so that they can still be reused after a quiet period
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPIDLE, 60L);
+        curl_easy_setopt(curl, CURLOPT_TCP_KEEPINTVL, 30L);
+#endif
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+        if (httpio->http2)
+        {
+            // ALPN for https, an h2c upgrade offer for http - servers that
+            // decline keep talking HTTP/1.1; wait for a connection that may
+            // multiplex rather than opening a new one
+            curl_easy_setopt(curl, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2_0);
+            curl_easy_setopt(curl, CURLOPT_PIPEWAIT, 1L);
+        }
+#endif
+
 #if !defined(USE_CURL_PUBLIC_KEY_PINNING) || defined(WINDOWS_PHONE)
         curl_easy_setopt(curl, CURLOPT_SSL_CTX_FUNCTION, ssl_ctx_function);
         curl_easy_setopt(curl, CURLOPT_SSL_CTX_DATA, (void*)req);
@@ -853,9 +1113,14 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         curl_easy_setopt(curl, CURLOPT_CAINFO, NULL);
         curl_easy_setopt(curl, CURLOPT_CAPATH, NULL);
 
-        curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_callback);
-        curl_easy_setopt(curl, CURLOPT_DEBUGDATA, (void*)req);
-        curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+        // cURL calls the debug callback for all the traffic in verbose mode,
+        // only enable it if its output is going to be logged
+        if (LOG_enabled(logMax))
+        {
+            curl_easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_callback);
+            curl_easy_setopt(curl, CURLOPT_DEBUGDATA, (void*)req);
+            curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
+        }
 
         if (httpio->proxyip.size())
         {
@@ -892,6 +1157,8 @@ void CurlHttpIO::send_request(CurlHttpContext* httpctx)
         req->status = REQ_FAILURE;
         req->httpiohandle = NULL;
         curl_slist_free_all(httpctx->headers);
+        curl_slist_free_all(httpctx->resolve);
+        httpctx->resolve = NULL;
 
         httpctx->req = NULL;
         if(!httpctx->ares_pending)
@@ -1086,7 +1353,10 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
     httpctx->data = data;
     httpctx->headers = NULL;
     httpctx->isIPv6 = false;
+    httpctx->resolve = NULL;
+    httpctx->raceipv6first = false;
     httpctx->ares_pending = 0;
+    httpctx->sent = 0;
 
     req->outbuf.append(req->chunkedout);
     req->chunkedout.clear();
@@ -1232,6 +1502,95 @@ void CurlHttpIO::post(HttpReq* req, const char* data, unsigned len)
     ares_gethostbyname(ares, httpctx->hostname.c_str(), PF_INET, ares_completed_callback, httpctx);
 }
 
+// hand the resolved address to cURL via CURLOPT_RESOLVE rather than putting
+// it into the URL: the connection keeps the hostname, so SNI is sent and the
+// TLS session cache shared through curlsh is keyed by host, which lets
+// sessions (and tickets) be resumed across IP changes and disconnect()
+// with fresh IPv6 and IPv4 addresses for the host, both are passed: cURL
+// connects to the preferred family first and starts the other one if that
+// hasn't succeeded within 200 ms (RFC 8305)
+bool CurlHttpIO::resolveaddresses(CurlHttpContext* httpctx)
+{
+#if LIBCURL_VERSION_NUM >= 0x073b00
+    if (!httpctx->hostip.size())
+    {
+        return false;
+    }
+
+    std::ostringstream hostport, addrs;
+    hostport << httpctx->hostname << ":" << httpctx->port;
+    addrs << hostport.str() << ":";
+
+    map<string, CurlDNSEntry>::iterator it = dnscache.find(httpctx->hostname);
+    CurlDNSEntry* entry = it == dnscache.end() ? NULL : &it->second;
+
+    httpctx->raceipv6first = false;
+
+    if (entry && ipv6requestsenabled && ipv6available()
+     && entry->ipv6.size() && Waiter::ds - entry->ipv6timestamp < DNS_CACHE_TIMEOUT_DS
+     && entry->ipv4.size() && Waiter::ds - entry->ipv4timestamp < DNS_CACHE_TIMEOUT_DS)
+    {
+        httpctx->raceipv6first = !entry->ipv6losttime || Waiter::ds - entry->ipv6losttime > IPV6_RETRY_INTERVAL_DS;
+
+        if (httpctx->raceipv6first)
+        {
+            addrs << "[" << entry->ipv6 << "]," << entry->ipv4;
+        }
+        else
+        {
+            addrs << entry->ipv4 << ",[" << entry->ipv6 << "]";
+        }
+    }
+    else
+    {
+        addrs << httpctx->hostip;
+    }
+
+    // replace what a previous request put into the shared cURL DNS cache
+    curl_slist_free_all(httpctx->resolve);
+    httpctx->resolve = curl_slist_append(NULL, ("-" + hostport.str()).c_str());
+    httpctx->resolve = curl_slist_append(httpctx->resolve, addrs.str().c_str());
+
+    return true;
+#else
+    (void)httpctx;
+    return false;
+#endif
+}
+
+// record which family served the request, for the order of the next race and
+// for the IPv6/IPv4 fallback handling of failures
+void CurlHttpIO::racecompleted(CurlHttpContext* httpctx, CURL* curl, bool connected)
+{
+    char* ip = NULL;
+
+    if (curl_easy_getinfo(curl, CURLINFO_PRIMARY_IP, &ip) != CURLE_OK || !ip || !*ip)
+    {
+        return;
+    }
+
+    httpctx->isIPv6 = strchr(ip, ':') != NULL;
+
+    CurlDNSEntry& entry = dnscache[httpctx->hostname];
+
+    if (!connected)
+    {
+        if (httpctx->isIPv6)
+        {
+            entry.ipv6losttime = Waiter::ds;
+        }
+    }
+    else if (httpctx->isIPv6)
+    {
+        entry.ipv6losttime = 0;
+    }
+    else if (httpctx->raceipv6first)
+    {
+        LOG_debug << "IPv4 won the connection race to " << httpctx->hostname;
+        entry.ipv6losttime = Waiter::ds;
+    }
+}
+
 void CurlHttpIO::setproxy(Proxy* proxy)
 {
     // clear the previous proxy IP
@@ -1289,11 +1648,15 @@ void CurlHttpIO::cancel(HttpReq* req)
     {
         CurlHttpContext* httpctx = (CurlHttpContext*)req->httpiohandle;
 
+        shaperpaused.erase(httpctx);
+
         if (httpctx->curl)
         {
             curl_multi_remove_handle(curlm, httpctx->curl);
             curl_easy_cleanup(httpctx->curl);
             curl_slist_free_all(httpctx->headers);
+            curl_slist_free_all(httpctx->resolve);
+            httpctx->resolve = NULL;
         }
 
         httpctx->req = NULL;
@@ -1339,6 +1702,15 @@ bool CurlHttpIO::doio()
 
 
 #if !defined(_WIN32) || defined(WINDOWS_PHONE)
+#ifndef _WIN32
+    std::vector<std::pair<int, int> > curlready;
+
+    if (waiter && waiter->persistent())
+    {
+        pollready(&curlready);
+    }
+    else
+#endif
     if (waiter)
     {
         ares_process(ares, &waiter->rfds, &waiter->wfds);
@@ -1353,8 +1725,28 @@ bool CurlHttpIO::doio()
     }
 #endif
 
+    resumeshaped();
+
 #if !defined(_WIN32) || defined(WINDOWS_PHONE)
-    curl_multi_perform(curlm, &dummy);
+#ifndef _WIN32
+    if (waiter && waiter->persistent())
+    {
+        for (unsigned i = 0; i < curlready.size(); i++)
+        {
+            curl_multi_socket_action(curlm, curlready[i].first,
+                                     ((curlready[i].second & PosixWaiter::WATCHREAD) ? CURL_CSELECT_IN : 0)
+                                   | ((curlready[i].second & PosixWaiter::WATCHWRITE) ? CURL_CSELECT_OUT : 0),
+                                     &dummy);
+        }
+
+        // expired timers, including those of new and resumed requests
+        curl_multi_socket_action(curlm, CURL_SOCKET_TIMEOUT, 0, &dummy);
+    }
+    else
+#endif
+    {
+        curl_multi_perform(curlm, &dummy);
+    }
 #else
     curl_multi_socket_all(curlm, &dummy);
 #endif
@@ -1391,18 +1783,57 @@ bool CurlHttpIO::doio()
                     }
                 }
 
-                // check httpstatus and response length
+                // check httpstatus and response length (streamed responses
+                // have been purged while arriving, bufpos counts all data)
                 req->status = (req->httpstatus == 200
                             && (req->contentlength < 0
-                             || req->contentlength == (req->buf ? req->bufpos : (int)req->in.size())))
+                             || req->contentlength == (req->buf || req->streaming ? req->bufpos : (int)req->in.size())))
                              ? REQ_SUCCESS : REQ_FAILURE;
 
                 if (req->status == REQ_SUCCESS)
                 {
                     lastdata = Waiter::ds;
+
+                    // cURL counts the response body before decoding it
+                    double received;
+
+                    if (req->type == REQ_JSON && !req->buf
+                     && curl_easy_getinfo(msg->easy_handle, CURLINFO_SIZE_DOWNLOAD, &received) == CURLE_OK
+                     && req->bufpos > received)
+                    {
+                        compressionsavedin += req->bufpos - (m_off_t)received;
+                    }
+
+                    // TCP handshake (zero on reused connections)
+                    double connected, resolved;
+
+                    if (curl_easy_getinfo(msg->easy_handle, CURLINFO_CONNECT_TIME, &connected) == CURLE_OK
+                     && curl_easy_getinfo(msg->easy_handle, CURLINFO_NAMELOOKUP_TIME, &resolved) == CURLE_OK
+                     && connected > resolved)
+                    {
+                        req->rtt = (int)((connected - resolved) * 1000 + 0.5);
+                    }
                 }
 
                 success = true;
+
+                if (req->httpiohandle && ((CurlHttpContext*)req->httpiohandle)->resolve)
+                {
+                    racecompleted((CurlHttpContext*)req->httpiohandle, msg->easy_handle, req->httpstatus != 0);
+                }
+
+#if LIBCURL_VERSION_NUM >= 0x072b00
+                // broken HTTP/2 framing: go back to HTTP/1.1 for good
+                if (http2 && (msg->data.result == CURLE_HTTP2
+#if LIBCURL_VERSION_NUM >= 0x073100
+                           || msg->data.result == CURLE_HTTP2_STREAM
+#endif
+                             ))
+                {
+                    LOG_warn << "HTTP/2 error, falling back to HTTP/1.1";
+                    http2 = false;
+                }
+#endif
             }
             else
             {
@@ -1449,6 +1880,8 @@ bool CurlHttpIO::doio()
                             curl_multi_remove_handle(curlm, msg->easy_handle);
                             curl_easy_cleanup(msg->easy_handle);
                             curl_slist_free_all(httpctx->headers);
+                            curl_slist_free_all(httpctx->resolve);
+                            httpctx->resolve = NULL;
                             httpctx->headers = NULL;
                             httpctx->curl = NULL;
                             req->httpio = this;
@@ -1489,6 +1922,8 @@ bool CurlHttpIO::doio()
             if(httpctx)
             {
                 curl_slist_free_all(httpctx->headers);
+                curl_slist_free_all(httpctx->resolve);
+                httpctx->resolve = NULL;
                 req->httpiohandle = NULL;
 
                 httpctx->req = NULL;
@@ -1589,8 +2024,103 @@ size_t CurlHttpIO::read_data(void* ptr, size_t size, size_t nmemb, void* source)
     return nread;
 }
 
+// shaped upload data: send what the bandwidth budget allows, pause while
+// there is none
+size_t CurlHttpIO::read_shaped(void* ptr, size_t size, size_t nmemb, void* source)
+{
+    CurlHttpContext* httpctx = (CurlHttpContext*)source;
+    HttpReq* req = httpctx->req;
+
+    if (!req)
+    {
+        return CURL_READFUNC_ABORT;
+    }
+
+    const char* data = httpctx->data ? httpctx->data : req->out->data();
+    size_t len = httpctx->data ? httpctx->len : req->out->size();
+    m_off_t n = len - httpctx->sent;
+
+    if (n > (m_off_t)(size * nmemb))
+    {
+        n = size * nmemb;
+    }
+
+    if (!n)
+    {
+        return 0;
+    }
+
+    m_off_t a = httpctx->httpio->shaper.available(PUT, req->shapeclass);
+
+    if (!a)
+    {
+        httpctx->httpio->shaperpaused.insert(httpctx);
+        return CURL_READFUNC_PAUSE;
+    }
+
+    if (n > a)
+    {
+        n = a;
+    }
+
+    memcpy(ptr, data + httpctx->sent, n);
+    httpctx->sent += n;
+    httpctx->httpio->shaper.consume(PUT, req->shapeclass, n);
+
+    return n;
+}
+
+// resume the paused connections that have a bandwidth budget again (cURL may
+// call the data callbacks right away)
+void CurlHttpIO::resumeshaped()
+{
+    if (shaperpaused.empty())
+    {
+        return;
+    }
+
+    std::set<CurlHttpContext*> paused;
+    paused.swap(shaperpaused);
+
+    for (std::set<CurlHttpContext*>::iterator it = paused.begin(); it != paused.end(); it++)
+    {
+        CurlHttpContext* httpctx = *it;
+
+        if (httpctx->req && httpctx->curl)
+        {
+            if (shaper.available((direction_t)httpctx->req->shapedir, httpctx->req->shapeclass))
+            {
+                curl_easy_pause(httpctx->curl, CURLPAUSE_CONT);
+            }
+            else
+            {
+                shaperpaused.insert(httpctx);
+            }
+        }
+    }
+}
+
 size_t CurlHttpIO::write_data(void* ptr, size_t size, size_t nmemb, void* target)
 {
+    HttpReq* req = (HttpReq*)target;
+
+    if (req->httpio && req->shapedir == GET && size * nmemb)
+    {
+        CurlHttpIO* httpio = (CurlHttpIO*)req->httpio;
+
+        if (httpio->shaper.limited(GET, req->shapeclass))
+        {
+            // cURL delivers the same data again after the connection is resumed
+            if (!httpio->shaper.available(GET, req->shapeclass))
+            {
+                httpio->shaperpaused.insert((CurlHttpContext*)req->httpiohandle);
+                return CURL_WRITEFUNC_PAUSE;
+            }
+
+            httpio->shaper.consume(GET, req->shapeclass, size * nmemb);
+        }
+    }
+
     if(((HttpReq*)target)->httpio)
     {
         if (((HttpReq*)target)->chunked)
@@ -1680,6 +2210,25 @@ int CurlHttpIO::timer_callback(CURLM *, long timeout_ms, void *userp)
     LOG_debug << "Setting cURL timeout to " << timeout_ms << " ms";
     return 0;
 }
+#elif !defined(_WIN32)
+int CurlHttpIO::socket_callback(CURL *, curl_socket_t s, int what, void *userp, void *)
+{
+    CurlHttpIO *httpio = (CurlHttpIO *)userp;
+
+    if (what == CURL_POLL_REMOVE)
+    {
+        httpio->pollsockets.erase(s);
+    }
+    else
+    {
+        httpio->pollsockets[s] = ((what & CURL_POLL_IN) ? PosixWaiter::WATCHREAD : 0)
+                               | ((what & CURL_POLL_OUT) ? PosixWaiter::WATCHWRITE : 0);
+    }
+
+    httpio->pollchanged.insert(s);
+
+    return 0;
+}
 #endif
 
 #if !defined(USE_CURL_PUBLIC_KEY_PINNING) || defined(WINDOWS_PHONE)
@@ -1780,6 +2329,7 @@ CurlDNSEntry::CurlDNSEntry()
 {
     ipv4timestamp = 0;
     ipv6timestamp = 0;
+    ipv6losttime = 0;
 }
 
 #if defined(_WIN32) && !defined(WINDOWS_PHONE)
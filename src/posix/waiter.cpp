@@ -20,6 +20,19 @@
  */
 
 #include "mega.h"
+#include <limits.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#define HAVE_EPOLL 1
+#define HAVE_EVENTFD 1
+#endif
+
+#if defined(__APPLE__) || defined(__FreeBSD__) || defined(__NetBSD__) || defined(__OpenBSD__) || defined(__DragonFly__)
+#include <sys/event.h>
+#define HAVE_KQUEUE 1
+#endif
 
 #ifdef __APPLE__
 #define CLOCK_MONOTONIC 0
@@ -40,21 +53,113 @@ int clock_gettime(int, struct timespec* t)
 namespace mega {
 dstime Waiter::ds;
 
+int PosixWaiter::defaultbackend = PosixWaiter::BACKEND_SELECT;
+const int PosixWaiter::WATCHREAD;
+const int PosixWaiter::WATCHWRITE;
+
+// maximum number of events retrieved per epoll_wait() / kevent()
+static const int MAXPOLLEVENTS = 256;
+
 PosixWaiter::PosixWaiter()
 {
+    m_pipe[0] = m_pipe[1] = -1;
+
+#ifdef HAVE_EVENTFD
+    // a single counter descriptor instead of a pipe pair
+    m_pipe[0] = m_pipe[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+
     // pipe to be able to leave the select() call
-    if (pipe(m_pipe) < 0)
+    if (m_pipe[0] < 0)
+    {
+        if (pipe(m_pipe) < 0)
+        {
+            LOG_fatal << "Error creating pipe";
+            exit(EXIT_FAILURE);
+        }
+
+        if (fcntl(m_pipe[0], F_SETFL, O_NONBLOCK) < 0)
+        {
+            LOG_err << "fcntl error";
+        }
+    }
+
+    notified = 0;
+    maxfd = -1;
+    pollfd = -1;
+
+    initbackend(defaultbackend);
+}
+
+PosixWaiter::~PosixWaiter()
+{
+    if (pollfd >= 0)
     {
-        LOG_fatal << "Error creating pipe";
-        exit(EXIT_FAILURE);
+        close(pollfd);
     }
 
-    if (fcntl(m_pipe[0], F_SETFL, O_NONBLOCK) < 0)
+    close(m_pipe[0]);
+
+    if (m_pipe[1] != m_pipe[0])
     {
-        LOG_err << "fcntl error";
+        close(m_pipe[1]);
     }
+}
 
-    maxfd = -1;
+int PosixWaiter::nativebackend()
+{
+#if defined(HAVE_EPOLL)
+    return BACKEND_EPOLL;
+#elif defined(HAVE_KQUEUE)
+    return BACKEND_KQUEUE;
+#else
+    return BACKEND_SELECT;
+#endif
+}
+
+void PosixWaiter::initbackend(int b)
+{
+    backend = BACKEND_SELECT;
+
+#ifdef HAVE_EPOLL
+    if (b == BACKEND_EPOLL)
+    {
+        pollfd = epoll_create(MAXPOLLEVENTS);
+    }
+#endif
+
+#ifdef HAVE_KQUEUE
+    if (b == BACKEND_KQUEUE)
+    {
+        pollfd = kqueue();
+    }
+#endif
+
+    if (b == BACKEND_SELECT)
+    {
+        return;
+    }
+
+    if (pollfd < 0)
+    {
+        LOG_warn << "Event backend " << b << " not available, using select()";
+        return;
+    }
+
+    fcntl(pollfd, F_SETFD, FD_CLOEXEC);
+    backend = b;
+
+    // the notification pipe stays registered
+    if (!setwatch(m_pipe[0], 0, WATCHREAD))
+    {
+        LOG_err << "Unable to watch the notification pipe, using select()";
+        close(pollfd);
+        pollfd = -1;
+        backend = BACKEND_SELECT;
+        return;
+    }
+
+    LOG_debug << "Using event backend " << backend;
 }
 
 void PosixWaiter::init(dstime ds)
@@ -100,6 +205,299 @@ bool PosixWaiter::fd_filter(int nfds, fd_set* fds, fd_set* ignorefds) const
     return false;
 }
 
+// change the backend registration of fd from oldevents to newevents
+// a closed fd silently loses its registration, and its number may have been
+// reused since - retry as add or modify accordingly
+bool PosixWaiter::setwatch(int fd, int oldevents, int newevents)
+{
+#ifdef HAVE_EPOLL
+    if (backend == BACKEND_EPOLL)
+    {
+        if (!newevents)
+        {
+            epoll_ctl(pollfd, EPOLL_CTL_DEL, fd, NULL);
+            return true;
+        }
+
+        epoll_event ev;
+        memset(&ev, 0, sizeof ev);
+        ev.events = ((newevents & WATCHREAD) ? EPOLLIN : 0) | ((newevents & WATCHWRITE) ? EPOLLOUT : 0);
+        ev.data.fd = fd;
+
+        int op = oldevents ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+
+        if (!epoll_ctl(pollfd, op, fd, &ev))
+        {
+            return true;
+        }
+
+        if (errno != ENOENT && errno != EEXIST)
+        {
+            return false;
+        }
+
+        return !epoll_ctl(pollfd, op == EPOLL_CTL_ADD ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    }
+#endif
+
+#ifdef HAVE_KQUEUE
+    if (backend == BACKEND_KQUEUE)
+    {
+        static const int filters[2] = { EVFILT_READ, EVFILT_WRITE };
+        static const int flags[2] = { WATCHREAD, WATCHWRITE };
+        bool ok = true;
+
+        for (int i = 0; i < 2; i++)
+        {
+            struct kevent kev;
+
+            // EV_ADD of an existing filter just updates it
+            if (newevents & flags[i])
+            {
+                EV_SET(&kev, fd, filters[i], EV_ADD, 0, 0, NULL);
+
+                if (kevent(pollfd, &kev, 1, NULL, 0, NULL) < 0)
+                {
+                    ok = false;
+                }
+            }
+            else if (oldevents & flags[i])
+            {
+                EV_SET(&kev, fd, filters[i], EV_DELETE, 0, 0, NULL);
+                kevent(pollfd, &kev, 1, NULL, 0, NULL);
+            }
+        }
+
+        return ok;
+    }
+#endif
+
+    (void)fd;
+    (void)oldevents;
+    (void)newevents;
+    return false;
+}
+
+void PosixWaiter::watch(int fd, int events)
+{
+    if (!persistent())
+    {
+        return;
+    }
+
+    map<int, int>::iterator it = watched.find(fd);
+    map<int, int>::iterator mit = mirrored.find(fd);
+    int other = mit == mirrored.end() ? 0 : mit->second;
+    int oldevents = (it == watched.end() ? 0 : it->second) | other;
+
+    if (events)
+    {
+        watched[fd] = events;
+    }
+    else if (it != watched.end())
+    {
+        watched.erase(it);
+    }
+
+    readyfds.erase(fd);
+
+    if (oldevents != (events | other) && !setwatch(fd, oldevents, events | other))
+    {
+        LOG_err << "Unable to watch fd " << fd << " errno: " << errno;
+    }
+}
+
+// carry the fds set in rfds/wfds by the fd_set consumers over into the
+// backend registrations, touching only those that changed since the last
+// wait()
+void PosixWaiter::mirrorfdsets()
+{
+    map<int, int> now;
+
+    for (int fd = 0; fd <= maxfd; fd++)
+    {
+        int events = (FD_ISSET(fd, &rfds) ? WATCHREAD : 0) | (FD_ISSET(fd, &wfds) ? WATCHWRITE : 0);
+
+        if (events)
+        {
+            now[fd] = events;
+        }
+    }
+
+    set<int> changed;
+
+    for (map<int, int>::iterator it = mirrored.begin(); it != mirrored.end(); it++)
+    {
+        map<int, int>::iterator nit = now.find(it->first);
+
+        if (nit == now.end() || nit->second != it->second)
+        {
+            changed.insert(it->first);
+        }
+    }
+
+    for (map<int, int>::iterator it = now.begin(); it != now.end(); it++)
+    {
+        if (!mirrored.count(it->first))
+        {
+            changed.insert(it->first);
+        }
+    }
+
+    for (set<int>::iterator it = changed.begin(); it != changed.end(); it++)
+    {
+        map<int, int>::iterator wit = watched.find(*it);
+        map<int, int>::iterator oit = mirrored.find(*it);
+        map<int, int>::iterator nit = now.find(*it);
+        int w = wit == watched.end() ? 0 : wit->second;
+        int oldevents = w | (oit == mirrored.end() ? 0 : oit->second);
+        int newevents = w | (nit == now.end() ? 0 : nit->second);
+
+        unpollable.erase(*it);
+
+        if (oldevents != newevents && !setwatch(*it, oldevents, newevents) && newevents)
+        {
+            unpollable.insert(*it);
+        }
+    }
+
+    mirrored.swap(now);
+}
+
+// record the readiness of fd, returns true if it warrants an exec()
+bool PosixWaiter::report(int fd, int events)
+{
+    if (fd == m_pipe[0])
+    {
+        return true;
+    }
+
+    bool trigger = false;
+    map<int, int>::iterator it = watched.find(fd);
+
+    if (it != watched.end() && (events & it->second))
+    {
+        readyfds[fd] |= events & it->second;
+        trigger = true;
+    }
+
+    it = mirrored.find(fd);
+
+    if (it != mirrored.end() && (events & it->second))
+    {
+        if (events & it->second & WATCHREAD)
+        {
+            FD_SET(fd, &rfds);
+        }
+
+        if (events & it->second & WATCHWRITE)
+        {
+            FD_SET(fd, &wfds);
+        }
+
+        if (!FD_ISSET(fd, &ignorefds))
+        {
+            trigger = true;
+        }
+    }
+
+    return trigger;
+}
+
+// epoll / kqueue flavour of wait()
+int PosixWaiter::pollwait()
+{
+    int timeoutms = -1;
+    int numfd = -1;
+    bool trigger = false;
+
+    mirrorfdsets();
+
+    FD_ZERO(&rfds);
+    FD_ZERO(&wfds);
+    FD_ZERO(&efds);
+    readyfds.clear();
+
+    if (maxds + 1)
+    {
+        timeoutms = maxds < (dstime)(INT_MAX / 100) ? (int)maxds * 100 : INT_MAX;
+    }
+
+    if (!unpollable.empty())
+    {
+        timeoutms = 0;
+    }
+
+#ifdef HAVE_EPOLL
+    if (backend == BACKEND_EPOLL)
+    {
+        epoll_event events[MAXPOLLEVENTS];
+
+        numfd = epoll_wait(pollfd, events, MAXPOLLEVENTS, timeoutms);
+
+        for (int i = 0; i < numfd; i++)
+        {
+            int e = events[i].events;
+            int ready = ((e & (EPOLLIN | EPOLLHUP | EPOLLERR)) ? WATCHREAD : 0)
+                      | ((e & (EPOLLOUT | EPOLLHUP | EPOLLERR)) ? WATCHWRITE : 0);
+
+            if (report(events[i].data.fd, ready))
+            {
+                trigger = true;
+            }
+        }
+    }
+#endif
+
+#ifdef HAVE_KQUEUE
+    if (backend == BACKEND_KQUEUE)
+    {
+        struct kevent events[MAXPOLLEVENTS];
+        timespec ts;
+
+        if (timeoutms >= 0)
+        {
+            ts.tv_sec = timeoutms / 1000;
+            ts.tv_nsec = (timeoutms % 1000) * 1000000L;
+        }
+
+        numfd = kevent(pollfd, NULL, 0, events, MAXPOLLEVENTS, timeoutms >= 0 ? &ts : NULL);
+
+        for (int i = 0; i < numfd; i++)
+        {
+            int ready = events[i].filter == EVFILT_READ ? WATCHREAD
+                      : (events[i].filter == EVFILT_WRITE ? WATCHWRITE : 0);
+
+            if (report((int)events[i].ident, ready))
+            {
+                trigger = true;
+            }
+        }
+    }
+#endif
+
+    for (set<int>::iterator it = unpollable.begin(); it != unpollable.end(); it++)
+    {
+        if (report(*it, mirrored[*it]))
+        {
+            trigger = true;
+        }
+    }
+
+    if (clearnotify())
+    {
+        trigger = true;
+    }
+
+    // timeout or error
+    if (numfd <= 0 && unpollable.empty())
+    {
+        return NEEDEXEC;
+    }
+
+    return trigger ? NEEDEXEC : 0;
+}
+
 // wait for supplied events (sockets, filesystem changes), plus timeout + application events
 // maxds specifies the maximum amount of time to wait in deciseconds (or ~0 if no timeout scheduled)
 // returns application-specific bitmask. bit 0 set indicates that exec() needs to be called.
@@ -108,6 +506,11 @@ int PosixWaiter::wait()
     int numfd;
     timeval tv;
 
+    if (persistent())
+    {
+        return pollwait();
+    }
+
     //Pipe added to rfds to be able to leave select() when needed
     FD_SET(m_pipe[0], &rfds);
     bumpmaxfd(m_pipe[0]);
@@ -122,12 +525,8 @@ int PosixWaiter::wait()
 
     numfd = select(maxfd + 1, &rfds, &wfds, &efds, maxds + 1 ? &tv : NULL);
 
-    // empty pipe
-    uint8_t buf;
-    while (read(m_pipe[0], &buf, sizeof buf) > 0);
-
-    // timeout or error
-    if (numfd <= 0)
+    // notified, timeout or error
+    if (clearnotify() || numfd <= 0)
     {
         return NEEDEXEC;
     }
@@ -138,8 +537,46 @@ int PosixWaiter::wait()
          || fd_filter(maxfd + 1, &efds, &ignorefds)) ? NEEDEXEC : 0;
 }
 
+// wakeups are coalesced: while one is pending, further calls (e.g. one per
+// queued request) cost no system call
 void PosixWaiter::notify()
 {
+    if (!__sync_bool_compare_and_swap(&notified, 0, 1))
+    {
+        return;
+    }
+
+#ifdef HAVE_EVENTFD
+    if (m_pipe[1] == m_pipe[0])
+    {
+        uint64_t one = 1;
+        write(m_pipe[1], &one, sizeof one);
+        return;
+    }
+#endif
+
     write(m_pipe[1], "0", 1);
 }
+
+// the flag is cleared first, so a notify() racing with the read writes
+// again - it also reports notifications that arrived after the descriptor
+// was polled, which the readiness alone would miss
+bool PosixWaiter::clearnotify()
+{
+    bool wasnotified = __sync_fetch_and_and(&notified, 0) != 0;
+
+#ifdef HAVE_EVENTFD
+    if (m_pipe[1] == m_pipe[0])
+    {
+        uint64_t count;
+        read(m_pipe[0], &count, sizeof count);
+        return wasnotified;
+    }
+#endif
+
+    uint8_t buf;
+    while (read(m_pipe[0], &buf, sizeof buf) > 0);
+
+    return wasnotified;
+}
 } // namespace
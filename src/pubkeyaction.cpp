@@ -68,12 +68,12 @@ void PubKeyActionSendShareKey::proc(MegaClient* client, User* u)
     Node* n;
 
     // only the share owner distributes share keys
-    if (u && u->pubk.isvalid() && (n = client->nodebyhandle(sh)) && n->sharekey && client->checkaccess(n, OWNER))
+    if (u && u->pubk.isvalid() && (n = client->nodebyhandle(sh)) && n->sharekey() && client->checkaccess(n, OWNER))
     {
         int t;
         byte buf[AsymmCipher::MAXKEYLENGTH];
 
-        if ((t = u->pubk.encrypt(n->sharekey->key, SymmCipher::KEYLENGTH, buf, sizeof buf)))
+        if ((t = u->pubk.encrypt(n->sharekey()->key, SymmCipher::KEYLENGTH, buf, sizeof buf)))
         {
             client->reqs.add(new CommandShareKeyUpdate(client, sh, u->uid.c_str(), buf, t));
         }
@@ -92,14 +92,14 @@ void PubKeyActionCreateShare::proc(MegaClient* client, User* u)
     }
 
     // do we already have a share key for this node?
-    if ((newshare = !n->sharekey))
+    if ((newshare = !n->sharekey()))
     {
         // no: create
         byte key[SymmCipher::KEYLENGTH];
 
         PrnGen::genblock(key, sizeof key);
 
-        n->sharekey = new SymmCipher(key);
+        n->sharingstate()->sharekey = new SymmCipher(key);
     }
 
     // we have all ingredients ready: the target user's public key, the share
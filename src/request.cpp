@@ -22,6 +22,7 @@
 #include "mega/request.h"
 #include "mega/command.h"
 #include "mega/logging.h"
+#include "mega/utils.h"
 
 namespace mega {
 void Request::add(Command* c)
@@ -36,6 +37,8 @@ int Request::cmdspending() const
 
 void Request::get(string* req) const
 {
+    AllocScope allocscope(AllocTags::JSON);
+
     // concatenate all command objects, resulting in an API request
     *req = "[";
 
@@ -51,6 +54,8 @@ void Request::get(string* req) const
 
 void Request::procresult(MegaClient* client)
 {
+    AllocScope allocscope(AllocTags::JSON);
+
     if (!client->json.enterarray())
     {
         LOG_err << "Invalid response from server";
@@ -60,6 +65,11 @@ void Request::procresult(MegaClient* client)
     {
         client->restag = cmds[i]->tag;
 
+        if (client->ressent)
+        {
+            client->app->command_response(client->restag, client->ressent, client->resreceived);
+        }
+
         cmds[i]->client = client;
 
         if (client->json.enterobject())
@@ -106,6 +116,101 @@ void Request::clear()
     cmds.clear();
 }
 
+void Request::moveindependent(Request* target)
+{
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < cmds.size(); i++)
+    {
+        if (cmds[i]->independent && !cmds[i]->persistent)
+        {
+            target->add(cmds[i]);
+        }
+        else
+        {
+            cmds[kept++] = cmds[i];
+        }
+    }
+
+    cmds.resize(kept);
+}
+
+int Request::streamindex() const
+{
+    for (int i = 0; i < (int)cmds.size(); i++)
+    {
+        if (cmds[i]->streamable)
+        {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool Request::deferrable() const
+{
+    for (int i = 0; i < (int)cmds.size(); i++)
+    {
+        if (!cmds[i]->deferrable)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void Request::movestreamablelast()
+{
+    vector<Command*> streamable;
+    unsigned kept = 0;
+
+    for (unsigned i = 0; i < cmds.size(); i++)
+    {
+        if (cmds[i]->streamable)
+        {
+            streamable.push_back(cmds[i]);
+        }
+        else
+        {
+            cmds[kept++] = cmds[i];
+        }
+    }
+
+    cmds.resize(kept);
+    cmds.insert(cmds.end(), streamable.begin(), streamable.end());
+}
+
+void Request::observe(Metrics* metrics, double ms) const
+{
+    for (int i = 0; i < (int)cmds.size(); i++)
+    {
+        metrics->observe(Metrics::REQUEST_TIME, cmds[i]->name, ms);
+    }
+}
+
+// from the newest queued command back, as long as the command may pass them
+bool Request::coalesce(Command* c)
+{
+    for (int i = (int)cmds.size(); i--; )
+    {
+        int r = cmds[i]->coalesce(c);
+
+        if (r > 0)
+        {
+            return true;
+        }
+
+        if (r < 0)
+        {
+            return false;
+        }
+    }
+
+    return false;
+}
+
 RequestDispatcher::RequestDispatcher()
 {
     r = 0;
@@ -126,6 +231,13 @@ void RequestDispatcher::nextRequest()
 
 void RequestDispatcher::add(Command *c)
 {
+    // (commands waiting in the secondary buffer keep their order)
+    if (reqbuf.empty() && !c->persistent && reqs[r].coalesce(c))
+    {
+        delete c;
+        return;
+    }
+
     if(reqs[r].cmdspending() < MAX_COMMANDS)
     {
         reqs[r].add(c);
@@ -152,6 +264,31 @@ void RequestDispatcher::procresult(MegaClient *client)
     reqs[r ^ 1].procresult(client);
 }
 
+void RequestDispatcher::observe(Metrics* metrics, double ms) const
+{
+    reqs[r ^ 1].observe(metrics, ms);
+}
+
+void RequestDispatcher::extractindependent(Request* target)
+{
+    reqs[r].moveindependent(target);
+}
+
+int RequestDispatcher::streamindex() const
+{
+    return reqs[r].streamindex();
+}
+
+bool RequestDispatcher::deferrable() const
+{
+    return reqs[r].deferrable();
+}
+
+void RequestDispatcher::movestreamablelast()
+{
+    reqs[r].movestreamablelast();
+}
+
 void RequestDispatcher::clear()
 {
     for (int i = sizeof(reqs)/sizeof(*reqs); i--; )
@@ -53,4 +53,25 @@ int Serialize64::unserialize(byte* b, int blen, uint64_t* v)
 
     return *b + 1;
 }
+
+void Serialize64::serialize(string* d, uint64_t v)
+{
+    byte buf[sizeof v + 1];
+
+    d->append((char*)buf, serialize(buf, v));
+}
+
+bool Serialize64::unserialize(const char** ptr, const char* end, uint64_t* v)
+{
+    int l;
+
+    if (*ptr >= end || (l = unserialize((byte*)*ptr, (int)(end - *ptr), v)) < 0)
+    {
+        return false;
+    }
+
+    *ptr += l;
+
+    return true;
+}
 } // namespace
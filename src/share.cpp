@@ -20,6 +20,7 @@
  */
 
 #include "mega/share.h"
+#include "mega/serialize64.h"
 
 namespace mega {
 Share::Share(User* u, accesslevel_t a, m_time_t t, PendingContactRequest* pending)
@@ -72,6 +73,82 @@ bool Share::unserialize(MegaClient* client, int direction, handle h,
     return true;
 }
 
+// presence flags, access level, peer, pending contact request and the
+// zigzag-encoded timestamp delta
+void Share::serialize(string* d, m_time_t base)
+{
+    char flags = (user ? 1 : 0) | (pcr ? 2 : 0);
+    char a = (char)access;
+    int64_t delta = ts - base;
+
+    d->append(&flags, 1);
+    d->append(&a, 1);
+
+    if (user)
+    {
+        d->append((char*)&user->userhandle, sizeof user->userhandle);
+    }
+
+    if (pcr)
+    {
+        d->append((char*)&pcr->id, sizeof pcr->id);
+    }
+
+    Serialize64::serialize(d, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+}
+
+bool Share::unserialize(MegaClient* client, int direction, handle h,
+                        const byte* key, const char** ptr, const char* end, m_time_t base)
+{
+    const char* p = *ptr;
+    handle peer = 0;
+    handle ph = UNDEF;
+    uint64_t delta;
+
+    if (p + 2 > end)
+    {
+        return false;
+    }
+
+    char flags = p[0];
+    accesslevel_t a = (accesslevel_t)p[1];
+    p += 2;
+
+    if (flags & 1)
+    {
+        if (p + sizeof peer > end)
+        {
+            return false;
+        }
+
+        peer = MemAccess::get<handle>(p);
+        p += sizeof peer;
+    }
+
+    if (flags & 2)
+    {
+        if (p + sizeof ph > end)
+        {
+            return false;
+        }
+
+        ph = MemAccess::get<handle>(p);
+        p += sizeof ph;
+    }
+
+    if (!Serialize64::unserialize(&p, end, &delta))
+    {
+        return false;
+    }
+
+    client->newshares.push_back(new NewShare(h, direction, peer, a,
+                                             base + ((int64_t)(delta >> 1) ^ -(int64_t)(delta & 1)),
+                                             key, NULL, ph));
+    *ptr = p;
+
+    return true;
+}
+
 void Share::update(accesslevel_t a, m_time_t t, PendingContactRequest* pending)
 {
     access = a;
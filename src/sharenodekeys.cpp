@@ -63,11 +63,11 @@ void ShareNodeKeys::add(NodeCore* n, Node* sn, int specific, const byte* item, i
 
     // emit all share nodekeys for known shares
     do {
-        if (sn->sharekey)
+        if (sn->sharekey())
         {
             sprintf(buf, ",%d,%d,\"", addshare(sn), (int)items.size());
 
-            sn->sharekey->ecb_encrypt((byte*)n->nodekey.data(), key, n->nodekey.size());
+            sn->sharekey()->ecb_encrypt((byte*)n->nodekey.data(), key, n->nodekey.size());
 
             ptr = strchr(buf + 5, 0);
             ptr += Base64::btoa(key, n->nodekey.size(), ptr);
@@ -97,6 +97,15 @@ void ShareNodeKeys::get(Command* c)
 {
     if (keys.size())
     {
+        size_t estimate = 16 + keys.size() + shares.size() * 12;
+
+        for (unsigned i = 0; i < items.size(); i++)
+        {
+            estimate += items[i].size() * 4 / 3 + 4;
+        }
+
+        c->reserve(estimate);
+
         c->beginarray("cr");
 
         // emit share node handles
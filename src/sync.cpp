@@ -29,6 +29,35 @@
 #include "mega/base64.h"
 
 namespace mega {
+SyncMetrics::SyncMetrics()
+{
+    scanitems = 0;
+    scantime = 0;
+    fullscans = 0;
+    fullscanstart = 0;
+    fullscands = 0;
+    putnodespending = 0;
+    uploads = 0;
+    downloads = 0;
+    localdebris = 0;
+    remotedebris = 0;
+
+    memset(&syncdown, 0, sizeof syncdown);
+    memset(&syncup, 0, sizeof syncup);
+}
+
+void SyncMetrics::PassTimes::add(clock_t start)
+{
+    last = (uint64_t)(clock() - start) * 1000000 / CLOCKS_PER_SEC;
+    total += last;
+    passes++;
+
+    if (last > max)
+    {
+        max = last;
+    }
+}
+
 // new Syncs are automatically inserted into the session's syncs list
 // and a full read of the subtree is initiated
 Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
@@ -48,6 +77,23 @@ Sync::Sync(MegaClient* cclient, string* crootpath, const char* cdebris,
     state = SYNC_INITIALSCAN;
     statecachetable = NULL;
 
+    metrics.fullscans++;
+    metrics.fullscanstart = Waiter::ds;
+
+    prefetchpending = 0;
+    scanprefetched = 0;
+    scanfingerprints = 0;
+    scanlistings = 0;
+    scanlisted = 0;
+    fingerprinthits = 0;
+
+    cacheflushds = 0;
+    cachechanges = 0;
+    cacheputs = 0;
+    cacheskipped = 0;
+    cachedels = 0;
+    cachebytes = 0;
+
     fullscan = true;
     scanseqno = 0;
 
@@ -152,6 +198,7 @@ void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_map* tmap, st
         Node* node = l->node;
         handle fsid = l->fsid;
         m_off_t size = l->size;
+        uint32_t dbcrc = l->dbcrc;
 
         // clear localname to force newnode = true in setnameparent
         l->localname.clear();
@@ -160,6 +207,7 @@ void Sync::addstatecachechildren(uint32_t parent_dbid, idlocalnode_map* tmap, st
 
         l->parent_dbid = parent_dbid;
         l->size = size;
+        l->dbcrc = dbcrc;
         l->setfsid(fsid);
         l->setnode(node);
 
@@ -186,9 +234,27 @@ bool Sync::readstatecache()
         // bulk-load cached nodes into tmap
         while (statecachetable->next(&cid, &cachedata, &client->key))
         {
-            if ((l = LocalNode::unserialize(this, &cachedata)))
+            if ((cid & 15) == MegaClient::CACHEDFINGERPRINT)
+            {
+                CachedFingerprint f;
+
+                if (f.unserialize(&cachedata))
+                {
+                    CachedFingerprint* c = &fingerprints[f.fsid];
+
+                    *(FileFingerprint*)c = f;
+                    c->fsid = f.fsid;
+                    c->dbid = cid;
+                }
+                else
+                {
+                    LOG_err << "Failed - fingerprint record read error";
+                }
+            }
+            else if ((l = LocalNode::unserialize(this, &cachedata)))
             {
                 l->dbid = cid;
+                l->cachechanged(&cachedata);
                 tmap.insert(pair<int32_t,LocalNode*>(l->parent_dbid,l));
             }
         }
@@ -219,6 +285,7 @@ void Sync::statecachedel(LocalNode* l)
     if (l->dbid)
     {
         deleteq.insert(l->dbid);
+        cachechanges++;
     }
 }
 
@@ -236,25 +303,67 @@ void Sync::statecacheadd(LocalNode* l)
     }
 
     insertq.insert(l);
+    cachechanges++;
+
+    // changed LocalNodes need to be reconciled
+    l->setdirty();
 }
 
-void Sync::cachenodes()
+dstime Sync::nextcacheflush()
 {
-    if (statecachetable && (state == SYNC_ACTIVE || (state == SYNC_INITIALSCAN && insertq.size() > 100)) && (deleteq.size() || insertq.size()))
+    if (!statecachetable || state != SYNC_ACTIVE || (!deleteq.size() && !insertq.size() && !fingerprintq.size()))
     {
+        return NEVER;
+    }
+
+    return cacheflushds + CACHEFLUSHDS;
+}
+
+void Sync::cachenodes(bool force)
+{
+    AllocScope allocscope(AllocTags::CACHE);
+
+    if (statecachetable && (state == SYNC_ACTIVE || (state == SYNC_INITIALSCAN && insertq.size() + fingerprintq.size() > 100))
+     && (deleteq.size() || insertq.size() || fingerprintq.size()))
+    {
+        // coalesce bursts of changes: a LocalNode that is queued repeatedly
+        // within the window is written once
+        if (!force && state == SYNC_ACTIVE
+         && deleteq.size() + insertq.size() + fingerprintq.size() < CACHEFLUSHMAX
+         && Waiter::ds < cacheflushds + CACHEFLUSHDS)
+        {
+            return;
+        }
+
+        cacheflushds = Waiter::ds;
+
         LOG_debug << "Saving LocalNode database with " << insertq.size() << " additions and " << deleteq.size() << " deletions";
         statecachetable->begin();
 
+        m_off_t bytes = statecachetable->byteswritten;
+        m_off_t puts = 0, skipped = 0;
+
         // deletions
         for (set<int32_t>::iterator it = deleteq.begin(); it != deleteq.end(); it++)
         {
             statecachetable->del(*it);
         }
 
+        cachedels += deleteq.size();
         deleteq.clear();
 
+        // fingerprints
+        for (set<CachedFingerprint*>::iterator it = fingerprintq.begin(); it != fingerprintq.end(); it++)
+        {
+            statecachetable->putbatched(MegaClient::CACHEDFINGERPRINT, *it, &client->key);
+        }
+
+        puts += fingerprintq.size();
+        fingerprintq.clear();
+
         // additions - we iterate until completion or until we get stuck
         bool added;
+        string record;
 
         do {
             added = false;
@@ -263,7 +372,20 @@ void Sync::cachenodes()
             {
                 if ((*it)->parent->dbid || (*it)->parent == &localroot)
                 {
-                    statecachetable->put(MegaClient::CACHEDLOCALNODE, *it, &client->key);
+                    // records that were merely touched (rescans, state
+                    // updates) serialize as before and are not rewritten
+                    record.clear();
+
+                    if (!(*it)->serialize(&record) || (*it)->cachechanged(&record))
+                    {
+                        statecachetable->putbatched(MegaClient::CACHEDLOCALNODE, *it, &client->key);
+                        puts++;
+                    }
+                    else
+                    {
+                        skipped++;
+                    }
+
                     insertq.erase(it++);
                     added = true;
                 }
@@ -271,8 +393,19 @@ void Sync::cachenodes()
             }
         } while (added);
 
+        statecachetable->flushbatch();
+
         statecachetable->commit();
 
+        bytes = statecachetable->byteswritten - bytes;
+
+        cacheputs += puts;
+        cacheskipped += skipped;
+        cachebytes += bytes;
+
+        LOG_debug << "LocalNode records written: " << puts << " (" << bytes << " bytes), unchanged: " << skipped
+                  << " - total bytes per change: " << (cachechanges ? cachebytes / cachechanges : 0);
+
         if (insertq.size())
         {
             LOG_err << "LocalNode caching did not complete";
@@ -284,6 +417,12 @@ void Sync::changestate(syncstate_t newstate)
 {
     if (newstate != state)
     {
+        // write out changes still held back by cachenodes()
+        if (state == SYNC_ACTIVE)
+        {
+            cachenodes(true);
+        }
+
         client->app->syncupdate_state(this, newstate);
 
         state = newstate;
@@ -395,6 +534,8 @@ LocalNode* Sync::localnodebypath(LocalNode* l, string* localpath, LocalNode** pa
 // localpath must be prefixed with Sync
 bool Sync::scan(string* localpath, FileAccess* fa)
 {
+    AllocScope allocscope(AllocTags::SYNC);
+
     if (localpath->size() < localdebris.size()
      || memcmp(localpath->data(), localdebris.data(), localdebris.size())
      || (localpath->size() != localdebris.size()
@@ -402,21 +543,60 @@ bool Sync::scan(string* localpath, FileAccess* fa)
                 client->fsaccess->localseparator.data(),
                 client->fsaccess->localseparator.size())))
     {
-        DirAccess* da;
+        DirAccess* da = NULL;
         string localname, name;
+        vector<string> names;
         bool success;
 
-        da = client->fsaccess->newdiraccess();
+        // use the listing obtained by the scan workers, if still current
+        ScanPrefetch* prefetch = prefetchedentry(localpath, fa);
+
+        if (prefetch && prefetch->listed)
+        {
+            names.swap(prefetch->names);
+            prefetch->listed = false;
+            scanlistings++;
+            success = true;
+        }
+        else
+        {
+            da = client->fsaccess->newdiraccess();
+            success = da->dopen(localpath, fa, false);
+        }
 
         // scan the dir, mark all items with a unique identifier
-        if ((success = da->dopen(localpath, fa, false)))
+        if (success)
         {
             size_t t = localpath->size();
 
-            while (da->dnext(localpath, &localname, client->followsymlinks))
+            // known children keep their converted names
+            LocalNode* dir = (*localpath == localroot.localname) ? &localroot : localnodebypath(NULL, localpath);
+            localnode_map::iterator it;
+            LocalNode* known;
+            nodetype_t type = TYPE_UNKNOWN;
+            m_off_t size;
+            m_time_t mtime;
+            handle fsid;
+            size_t i = 0;
+
+            while (da ? da->dnext(localpath, &localname, client->followsymlinks, &type) : i < names.size())
             {
-                name = localname;
-                client->fsaccess->local2name(&name);
+                if (!da)
+                {
+                    localname.swap(names[i++]);
+                }
+
+                if (dir && (it = dir->children.find(&localname)) != dir->children.end())
+                {
+                    known = it->second;
+                    name = known->name;
+                }
+                else
+                {
+                    known = NULL;
+                    name = localname;
+                    client->fsaccess->local2name(&name);
+                }
 
                 // check if this record is to be ignored
                 if (client->app->sync_syncable(name.c_str(), localpath, &localname))
@@ -437,7 +617,23 @@ bool Sync::scan(string* localpath, FileAccess* fa)
                                 client->fsaccess->localseparator.size())))
                     {
                         LocalNode *l = NULL;
-                        if (initializing)
+
+                        // during initial/rescan, a file that the listing reports
+                        // unchanged is matched without opening it (as checkpath()
+                        // would after opening it)
+                        if (known && (initializing || fullscan)
+                         && known->type == FILENODE && type == FILENODE
+                         && da && da->dstat(&size, &mtime, &fsid)
+                         && fsid == known->fsid && size == known->size && mtime == known->mtime)
+                        {
+                            l = known;
+                            l->deleted = false;
+                            l->setnotseen(0);
+                            l->scanseqno = scanseqno;
+                            localbytes += l->size;
+                            scanlisted++;
+                        }
+                        else if (initializing)
                         {
                             // preload all cached LocalNodes
                             l = checkpath(NULL, localpath);
@@ -555,12 +751,10 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
 
     LOG_verbose << "Scanning: " << path;
 
-    // postpone moving nodes into nonexistent parents
-    if (parent && !parent->node)
-    {
-        LOG_warn << "Parent doesn't exist yet: " << path;
-        return (LocalNode*)~0;
-    }
+    // new items below folders that are still being created remotely are
+    // added right away (syncup() creates them in the same putnodes), but
+    // moving nodes into nonexistent parents is postponed
+    bool parentpending = parent && !parent->node;
 
     // attempt to open/type this file
     fa = client->fsaccess->newfileaccess();
@@ -652,6 +846,12 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                                             delete it->second;
                                         }
                                     }
+                                    else if (parentpending)
+                                    {
+                                        LOG_warn << "Parent doesn't exist yet: " << path;
+                                        delete fa;
+                                        return (LocalNode*)~0;
+                                    }
                                     else
                                     {
                                         LOG_debug << "File move/overwrite detected";
@@ -694,7 +894,7 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
 
                             m_off_t dsize = l->size > 0 ? l->size : 0;
 
-                            if (l->genfingerprint(fa) && l->size >= 0)
+                            if (genfingerprint(l, fa, localname ? localpath : &tmppath) && l->size >= 0)
                             {
                                 localbytes -= dsize - l->size;
                             }
@@ -748,6 +948,13 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                     && ((it->second->type != FILENODE)
                         || (it->second->mtime == fa->mtime && it->second->size == fa->size)))
                 {
+                    if (parentpending)
+                    {
+                        LOG_warn << "Parent doesn't exist yet: " << path;
+                        delete fa;
+                        return (LocalNode*)~0;
+                    }
+
                     LOG_debug << "Move detected by fsid in checkpath. Type: " << it->second->type;
                     client->app->syncupdate_local_move(this, it->second, path.c_str());
 
@@ -827,7 +1034,7 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
                         localbytes -= l->size;
                     }
 
-                    if (l->genfingerprint(fa))
+                    if (genfingerprint(l, fa, localname ? localpath : &tmppath))
                     {
                         changed = true;
                         l->bumpnagleds();
@@ -904,19 +1111,357 @@ LocalNode* Sync::checkpath(LocalNode* l, string* localpath, string* localname)
     return l;
 }
 
+struct ScanPrefetchBatch
+{
+    FileSystemAccess* fsaccess;
+    bool followsymlinks;
+
+    // read-only while the workers run
+    const map<handle, Sync::CachedFingerprint>* fingerprints;
+    vector<Sync::ScanPrefetch*> entries;
+};
+
+// open, fingerprint and list the next queued items on the scan workers
+void Sync::prefetchscan(int q)
+{
+    if (!client->scanworkers || initializing)
+    {
+        return;
+    }
+
+    ScanPrefetchBatch batch;
+    notify_deque::iterator it;
+
+    prefetched.clear();
+
+    batch.fsaccess = client->fsaccess;
+    batch.followsymlinks = client->followsymlinks;
+    batch.fingerprints = &fingerprints;
+
+    for (it = dirnotify->notifyq[q].begin(); it != dirnotify->notifyq[q].end() && prefetchpending < SCANPREFETCH; it++)
+    {
+        prefetchpending++;
+
+        if (it->localnode == (LocalNode*)~0)
+        {
+            continue;
+        }
+
+        // full path as constructed by checkpath()
+        string path;
+
+        if (it->localnode)
+        {
+            it->localnode->getlocalpath(&path);
+        }
+
+        if (it->path.size())
+        {
+            if (path.size())
+            {
+                path.append(client->fsaccess->localseparator);
+            }
+
+            path.append(it->path);
+        }
+
+        ScanPrefetch* p = &prefetched[path];
+
+        if (p->path.size())
+        {
+            // queued more than once
+            continue;
+        }
+
+        p->path = path;
+
+        LocalNode* l = localnodebypath(it->localnode, &it->path);
+
+        if (l && l->type == FILENODE)
+        {
+            p->known = true;
+            p->knownfsid = l->fsid;
+            p->knownsize = l->size;
+            p->knownmtime = l->mtime;
+        }
+
+        batch.entries.push_back(p);
+    }
+
+    if (batch.entries.size() < 2)
+    {
+        // not worth a batch
+        prefetched.clear();
+        prefetchpending = 0;
+        return;
+    }
+
+    dstime start = Waiter::ds;
+
+    client->scanworkers->run(batch.entries.size(), prefetchjob, &batch);
+
+    scanprefetched += batch.entries.size();
+
+    LOG_debug << "Scan batch: " << batch.entries.size() << " items in " << (Waiter::ds - start)
+              << " ds - prefetched: " << scanprefetched << " fingerprints used: " << scanfingerprints
+              << " listings used: " << scanlistings << " queued: " << dirnotify->notifyq[q].size();
+}
+
+// runs on a worker: must not touch the Sync or its LocalNodes
+void Sync::prefetchjob(unsigned i, void* param)
+{
+    ScanPrefetchBatch* batch = (ScanPrefetchBatch*)param;
+    ScanPrefetch* p = batch->entries[i];
+    FileAccess* fa = batch->fsaccess->newfileaccess();
+
+    if ((p->opened = fa->fopen(&p->path, true, false)))
+    {
+        p->type = fa->type;
+        p->fsid = fa->fsid;
+        p->fsidvalid = fa->fsidvalid;
+        p->size = fa->size;
+        p->mtime = fa->mtime;
+
+        if (fa->type == FILENODE)
+        {
+            map<handle, CachedFingerprint>::const_iterator it;
+
+            // unchanged files are not fingerprinted by checkpath() either,
+            // and cached fingerprints are used there
+            if ((!p->known || !fa->fsidvalid || p->knownfsid != fa->fsid
+              || p->knownsize != fa->size || p->knownmtime != fa->mtime)
+             && (!fa->fsidvalid || (it = batch->fingerprints->find(fa->fsid)) == batch->fingerprints->end()
+              || it->second.size != fa->size || it->second.mtime != fa->mtime))
+            {
+                p->fingerprint.genfingerprint(fa);
+            }
+        }
+        else
+        {
+            DirAccess* da = batch->fsaccess->newdiraccess();
+            string path = p->path;
+            string name;
+
+            if ((p->listed = da->dopen(&path, fa, false)))
+            {
+                while (da->dnext(&path, &name, batch->followsymlinks))
+                {
+                    p->names.push_back(name);
+                }
+            }
+
+            delete da;
+        }
+    }
+
+    delete fa;
+}
+
+Sync::ScanPrefetch* Sync::prefetchedentry(string* localpath, FileAccess* fa)
+{
+    map<string, ScanPrefetch>::iterator it;
+
+    if (!prefetched.size() || (it = prefetched.find(*localpath)) == prefetched.end())
+    {
+        return NULL;
+    }
+
+    ScanPrefetch* p = &it->second;
+
+    if (!p->opened || p->type != fa->type || p->size != fa->size || p->mtime != fa->mtime
+     || p->fsidvalid != fa->fsidvalid || (fa->fsidvalid && p->fsid != fa->fsid))
+    {
+        return NULL;
+    }
+
+    return p;
+}
+
+bool Sync::genfingerprint(LocalNode* l, FileAccess* fa, string* localpath)
+{
+    ScanPrefetch* p = prefetchedentry(localpath, fa);
+    FileFingerprint* fp;
+
+    if (p && p->fingerprint.isvalid && p->fingerprint.size >= 0)
+    {
+        fp = &p->fingerprint;
+        scanfingerprints++;
+    }
+    else if ((fp = cachedfingerprint(fa)))
+    {
+        fingerprinthits++;
+    }
+    else
+    {
+        bool changed = l->genfingerprint(fa);
+
+        if (l->isvalid && l->size >= 0)
+        {
+            addfingerprint(fa, l);
+        }
+
+        return changed;
+    }
+
+    bool changed = !l->isvalid || l->size != fp->size || l->mtime != fp->mtime
+                || memcmp(l->crc, fp->crc, sizeof l->crc);
+
+    l->size = fp->size;
+    l->mtime = fp->mtime;
+    memcpy(l->crc, fp->crc, sizeof l->crc);
+    l->isvalid = true;
+
+    if (p && fp == &p->fingerprint)
+    {
+        addfingerprint(fa, fp);
+
+        // consumed
+        fp->isvalid = false;
+    }
+
+    return changed;
+}
+
+Sync::CachedFingerprint* Sync::cachedfingerprint(FileAccess* fa)
+{
+    map<handle, CachedFingerprint>::iterator it;
+
+    if (!fa->fsidvalid || (it = fingerprints.find(fa->fsid)) == fingerprints.end())
+    {
+        return NULL;
+    }
+
+    if (!it->second.isvalid || it->second.size != fa->size || it->second.mtime != fa->mtime)
+    {
+        return NULL;
+    }
+
+    return &it->second;
+}
+
+void Sync::addfingerprint(FileAccess* fa, FileFingerprint* fp)
+{
+    if (!fa->fsidvalid)
+    {
+        return;
+    }
+
+    CachedFingerprint* c = &fingerprints[fa->fsid];
+
+    if (c->isvalid && c->size == fp->size && c->mtime == fp->mtime && !memcmp(c->crc, fp->crc, sizeof c->crc))
+    {
+        return;
+    }
+
+    *(FileFingerprint*)c = *fp;
+    c->fsid = fa->fsid;
+
+    if (statecachetable && state != SYNC_CANCELED)
+    {
+        fingerprintq.insert(c);
+    }
+}
+
+void Sync::prunefingerprints()
+{
+    size_t pruned = 0;
+
+    for (map<handle, CachedFingerprint>::iterator it = fingerprints.begin(); it != fingerprints.end(); )
+    {
+        if (client->fsidnode.find(it->first) == client->fsidnode.end())
+        {
+            fingerprintq.erase(&it->second);
+
+            if (it->second.dbid)
+            {
+                deleteq.insert(it->second.dbid);
+            }
+
+            fingerprints.erase(it++);
+            pruned++;
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    if (pruned)
+    {
+        LOG_debug << "Cached fingerprints pruned: " << pruned << " remaining: " << fingerprints.size();
+    }
+}
+
+// fsid, size, sparse CRC, mtime
+bool Sync::CachedFingerprint::serialize(string* d)
+{
+    d->append((const char*)&fsid, sizeof fsid);
+    d->append((const char*)&size, sizeof size);
+    d->append((const char*)crc, sizeof crc);
+
+    byte buf[sizeof mtime + 1];
+
+    d->append((const char*)buf, Serialize64::serialize(buf, mtime));
+
+    return true;
+}
+
+bool Sync::CachedFingerprint::unserialize(string* d)
+{
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+    uint64_t t;
+
+    if (ptr + sizeof fsid + sizeof size + sizeof crc >= end)
+    {
+        return false;
+    }
+
+    fsid = MemAccess::get<handle>(ptr);
+    ptr += sizeof fsid;
+
+    size = MemAccess::get<m_off_t>(ptr);
+    ptr += sizeof size;
+
+    memcpy(crc, ptr, sizeof crc);
+    ptr += sizeof crc;
+
+    if (Serialize64::unserialize((byte*)ptr, end - ptr, &t) < 0)
+    {
+        return false;
+    }
+
+    mtime = t;
+    isvalid = true;
+
+    return true;
+}
+
 // add or refresh local filesystem item from scan stack, add items to scan stack
-// returns 0 if a parent node is missing, ~0 if control should be yielded, or the time
+// returns 0 if a move has to wait for its parent node, ~0 if control should be yielded, or the time
 // until a retry should be made (300 ms minimum latency).
 dstime Sync::procscanq(int q)
 {
+    AllocScope allocscope(AllocTags::SYNC);
+
     size_t t = dirnotify->notifyq[q].size();
     dstime dsmin = Waiter::ds - 3;
     LocalNode* l;
 
+    if (prefetchpending > dirnotify->notifyq[DirNotify::DIREVENTS].size())
+    {
+        prefetchpending = 0;
+    }
+
     while (t--)
     {
         LOG_verbose << "Scanning... Remaining files: " << t;
 
+        if (q == DirNotify::DIREVENTS && !prefetchpending)
+        {
+            prefetchscan(q);
+        }
+
         if (dirnotify->notifyq[q].front().timestamp > dsmin)
         {
             LOG_verbose << "Scanning postponed. Modification too recent";
@@ -941,13 +1486,28 @@ dstime Sync::procscanq(int q)
             LOG_debug << "Notification skipped: " << utf8path;
         }
 
-        dirnotify->notifyq[q].pop_front();
+        dirnotify->pop((DirNotify::notifyqueue)q);
+        metrics.scanitems++;
 
+        // with prefetching, control is returned after each batch instead
+        if (q == DirNotify::DIREVENTS && prefetchpending)
+        {
+            if (!--prefetchpending)
+            {
+                prefetched.clear();
+                break;
+            }
+        }
         // we return control to the application in case a filenode was added
         // (in order to avoid lengthy blocking episodes due to multiple
         // consecutive fingerprint calculations)
+        else if (l && l != (LocalNode*)~0 && l->type == FILENODE)
+        {
+            break;
+        }
+
         // or if new nodes are being added due to a copy/delete operation
-        if ((l && l != (LocalNode*)~0 && l->type == FILENODE) || client->syncadding)
+        if (client->syncadding)
         {
             break;
         }
@@ -960,9 +1520,19 @@ dstime Sync::procscanq(int q)
             client->syncactivity = true;
         }
     }
-    else if (!dirnotify->notifyq[!q].size())
+    else
     {
-        cachenodes();
+        if (q == DirNotify::DIREVENTS && dirnotify->coalesced + dirnotify->collapsed)
+        {
+            LOG_debug << "Notifications received: " << dirnotify->notifications
+                      << " duplicates dropped: " << dirnotify->coalesced
+                      << " covered by folder scans: " << dirnotify->collapsed;
+        }
+
+        if (!dirnotify->notifyq[!q].size())
+        {
+            cachenodes();
+        }
     }
 
     return ~0;
@@ -1027,6 +1597,7 @@ bool Sync::movetolocaldebris(string* localpath)
         if (client->fsaccess->renamelocal(localpath, &localdebris, false))
         {
             localdebris.resize(t);
+            metrics.localdebris++;
             return true;
         }
 
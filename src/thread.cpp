@@ -0,0 +1,377 @@
+/**
+ * @file thread.cpp
+ * @brief Thread pool on top of the threading abstraction
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mega/thread.h"
+#include "mega/waiter.h"
+#include "mega/utils.h"
+
+namespace mega {
+// jobs of a run() call, picked by index in turn by the caller and the
+// helper tasks - freed by whichever of them lets go of it last
+struct ThreadPool::Batch
+{
+    void (*job)(unsigned, void*);
+    void* param;
+    unsigned n;
+
+    // guarded by the pool's mutex
+    unsigned next;
+    unsigned done;
+    unsigned refs;
+    bool waiting;
+};
+
+struct ThreadPool::BatchTask : public ThreadPool::Task
+{
+    ThreadPool* pool;
+    Batch* batch;
+
+    void run()
+    {
+        pool->runbatch(batch);
+    }
+
+    // helpers that never ran (e.g. discarded by the pool's destructor)
+    // still hold their reference
+    ~BatchTask()
+    {
+        pool->releasebatch(batch);
+    }
+};
+
+ThreadPool::ThreadPool(unsigned n, Thread** threads, Mutex** workermutexes, Mutex* m, Semaphore* r, Semaphore* b, Waiter* w)
+{
+    mutex = m;
+    ready = r;
+    batchdone = b;
+    waiter = w;
+
+    mutex->init(false);
+    ready->init(0);
+    batchdone->init(0);
+
+    nextworker = 0;
+    stopping = false;
+    memset(&stats, 0, sizeof stats);
+
+    workers.resize(n);
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        workers[i].pool = this;
+        workers[i].index = i;
+        workers[i].thread = threads[i];
+        workers[i].mutex = workermutexes[i];
+        workers[i].mutex->init(false);
+    }
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        threads[i]->start(workerentry, &workers[i]);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    mutex->lock();
+    stopping = true;
+    mutex->unlock();
+
+    for (unsigned i = workers.size(); i--; )
+    {
+        ready->release();
+    }
+
+    for (unsigned i = 0; i < workers.size(); i++)
+    {
+        workers[i].thread->join();
+        delete workers[i].thread;
+    }
+
+    for (unsigned i = 0; i < workers.size(); i++)
+    {
+        for (int p = 0; p < NUMPRIORITIES; p++)
+        {
+            for (deque<Task*>::iterator it = workers[i].queues[p].begin(); it != workers[i].queues[p].end(); it++)
+            {
+                delete *it;
+            }
+        }
+
+        delete workers[i].mutex;
+    }
+
+    for (deque<Task*>::iterator it = finished.begin(); it != finished.end(); it++)
+    {
+        delete *it;
+    }
+
+    delete mutex;
+    delete ready;
+    delete batchdone;
+}
+
+unsigned ThreadPool::size() const
+{
+    return (unsigned)workers.size();
+}
+
+// without workers, the task runs right away (its completion still waits
+// for complete())
+void ThreadPool::submit(Task* t, int priority)
+{
+    if (priority < 0 || priority >= NUMPRIORITIES)
+    {
+        priority = PRIORITY_NORMAL;
+    }
+
+    if (!workers.size())
+    {
+        t->run();
+
+        mutex->lock();
+        stats.submitted++;
+        stats.finished++;
+        finished.push_back(t);
+        mutex->unlock();
+        return;
+    }
+
+    mutex->lock();
+    Worker* w = &workers[nextworker++ % workers.size()];
+    stats.submitted++;
+    stats.queued++;
+    mutex->unlock();
+
+    w->mutex->lock();
+    w->queues[priority].push_back(t);
+    w->mutex->unlock();
+
+    ready->release();
+}
+
+void ThreadPool::complete()
+{
+    deque<Task*> done;
+
+    mutex->lock();
+    done.swap(finished);
+    mutex->unlock();
+
+    while (done.size())
+    {
+        Task* t = done.front();
+        done.pop_front();
+
+        t->completed();
+        delete t;
+    }
+}
+
+void ThreadPool::run(unsigned n, void (*job)(unsigned, void*), void* param)
+{
+    if (!n)
+    {
+        return;
+    }
+
+    unsigned helpers = (n - 1 < workers.size()) ? n - 1 : (unsigned)workers.size();
+
+    Batch* batch = new Batch;
+
+    batch->job = job;
+    batch->param = param;
+    batch->n = n;
+    batch->next = 0;
+    batch->done = 0;
+    batch->refs = helpers + 1;
+    batch->waiting = false;
+
+    for (unsigned i = 0; i < helpers; i++)
+    {
+        BatchTask* t = new BatchTask;
+
+        t->pool = this;
+        t->batch = batch;
+        submit(t, PRIORITY_HIGH);
+    }
+
+    runbatch(batch);
+
+    // wait for the jobs still running on the workers
+    mutex->lock();
+    bool wait = batch->done < batch->n;
+    batch->waiting = wait;
+    mutex->unlock();
+
+    if (wait)
+    {
+        batchdone->wait();
+    }
+
+    releasebatch(batch);
+}
+
+// only a helper can finish the last job while the caller is waiting
+void ThreadPool::runbatch(Batch* batch)
+{
+    for (;;)
+    {
+        mutex->lock();
+        unsigned i = batch->next++;
+        mutex->unlock();
+
+        if (i >= batch->n)
+        {
+            return;
+        }
+
+        batch->job(i, batch->param);
+
+        mutex->lock();
+        bool last = ++batch->done == batch->n && batch->waiting;
+        mutex->unlock();
+
+        if (last)
+        {
+            batchdone->release();
+        }
+    }
+}
+
+void ThreadPool::releasebatch(Batch* batch)
+{
+    mutex->lock();
+    bool last = !--batch->refs;
+    mutex->unlock();
+
+    if (last)
+    {
+        delete batch;
+    }
+}
+
+void ThreadPool::getstats(Stats* s)
+{
+    mutex->lock();
+    *s = stats;
+    mutex->unlock();
+}
+
+// the worker's own queue from the front, then the others' from the back,
+// priority by priority
+ThreadPool::Task* ThreadPool::take(unsigned index, bool* stolen)
+{
+    for (int p = 0; p < NUMPRIORITIES; p++)
+    {
+        for (unsigned i = 0; i < workers.size(); i++)
+        {
+            Worker* w = &workers[(index + i) % workers.size()];
+            Task* t = NULL;
+
+            w->mutex->lock();
+
+            if (w->queues[p].size())
+            {
+                if (i)
+                {
+                    t = w->queues[p].back();
+                    w->queues[p].pop_back();
+                }
+                else
+                {
+                    t = w->queues[p].front();
+                    w->queues[p].pop_front();
+                }
+            }
+
+            w->mutex->unlock();
+
+            if (t)
+            {
+                *stolen = i != 0;
+                return t;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void* ThreadPool::workerentry(void* param)
+{
+    Worker* w = (Worker*)param;
+
+    w->pool->work(w);
+    return NULL;
+}
+
+void ThreadPool::work(Worker* w)
+{
+    for (;;)
+    {
+        ready->wait();
+
+        mutex->lock();
+
+        if (stopping)
+        {
+            mutex->unlock();
+            return;
+        }
+
+        mutex->unlock();
+
+        // every release of ready is matched by a queued task, but another
+        // worker may take it from a queue this one has already passed
+        Task* t;
+        bool stolen;
+
+        while (!(t = take(w->index, &stolen)));
+
+        mutex->lock();
+        stats.queued--;
+        stats.running++;
+
+        if (stolen)
+        {
+            stats.stolen++;
+        }
+
+        mutex->unlock();
+
+        int64_t start = Metrics::now();
+
+        t->run();
+
+        int64_t elapsed = Metrics::now() - start;
+
+        mutex->lock();
+        stats.running--;
+        stats.finished++;
+        stats.busytime += elapsed;
+        finished.push_back(t);
+        mutex->unlock();
+
+        waiter->notify();
+    }
+}
+} // namespace
@@ -77,4 +77,88 @@ CppMutex::~CppMutex()
 	delete rmutex;
 }
 
+
+CppSharedMutex::CppSharedMutex()
+{
+    rmutex = NULL;
+}
+
+void CppSharedMutex::init()
+{
+    if (!rmutex)
+    {
+        rmutex = new std::recursive_mutex;
+    }
+}
+
+void CppSharedMutex::lock()
+{
+    rmutex->lock();
+}
+
+void CppSharedMutex::unlock()
+{
+    rmutex->unlock();
+}
+
+void CppSharedMutex::lockshared()
+{
+    rmutex->lock();
+}
+
+void CppSharedMutex::unlockshared()
+{
+    rmutex->unlock();
+}
+
+CppSharedMutex::~CppSharedMutex()
+{
+    delete rmutex;
+}
+
+
+CppSemaphore::CppSemaphore()
+{
+    mutex = NULL;
+    cond = NULL;
+    count = 0;
+}
+
+void CppSemaphore::init(unsigned initial)
+{
+    if (mutex)
+    {
+        return;
+    }
+
+    mutex = new std::mutex;
+    cond = new std::condition_variable;
+    count = initial;
+}
+
+void CppSemaphore::release()
+{
+    std::lock_guard<std::mutex> guard(*mutex);
+    count++;
+    cond->notify_one();
+}
+
+void CppSemaphore::wait()
+{
+    std::unique_lock<std::mutex> guard(*mutex);
+
+    while (!count)
+    {
+        cond->wait(guard);
+    }
+
+    count--;
+}
+
+CppSemaphore::~CppSemaphore()
+{
+    delete cond;
+    delete mutex;
+}
+
 } // namespace
@@ -91,6 +91,172 @@ PosixMutex::~PosixMutex()
 }
 
 
+PosixSharedMutex::PosixSharedMutex()
+{
+    rwlock = NULL;
+    owned = false;
+    depth = 0;
+}
+
+void PosixSharedMutex::init()
+{
+    if (rwlock)
+    {
+        return;
+    }
+
+    rwlock = new pthread_rwlock_t;
+
+#ifdef __GLIBC__
+    // glibc prefers readers by default, which can starve the writer under a
+    // steady stream of readers - recursive shared requests never reach the
+    // rwlock, so preferring writers cannot deadlock
+    pthread_rwlockattr_t rwattr;
+    pthread_rwlockattr_init(&rwattr);
+    pthread_rwlockattr_setkind_np(&rwattr, PTHREAD_RWLOCK_PREFER_WRITER_NONRECURSIVE_NP);
+    pthread_rwlock_init(rwlock, &rwattr);
+    pthread_rwlockattr_destroy(&rwattr);
+#else
+    pthread_rwlock_init(rwlock, NULL);
+#endif
+    pthread_key_create(&readers, NULL);
+}
+
+// only the owner itself sets owned for its own thread id, so a stale value
+// seen by another thread never matches
+bool PosixSharedMutex::ownedbyself()
+{
+    return owned && pthread_equal(owner, pthread_self());
+}
+
+void PosixSharedMutex::lock()
+{
+    if (ownedbyself())
+    {
+        depth++;
+        return;
+    }
+
+    pthread_rwlock_wrlock(rwlock);
+    owner = pthread_self();
+    owned = true;
+    depth = 1;
+}
+
+void PosixSharedMutex::unlock()
+{
+    if (--depth)
+    {
+        return;
+    }
+
+    owned = false;
+    pthread_rwlock_unlock(rwlock);
+}
+
+void PosixSharedMutex::lockshared()
+{
+    // a shared request by the exclusive owner nests in the exclusive hold
+    if (ownedbyself())
+    {
+        depth++;
+        return;
+    }
+
+    intptr_t n = (intptr_t)pthread_getspecific(readers);
+
+    if (!n)
+    {
+        pthread_rwlock_rdlock(rwlock);
+    }
+
+    pthread_setspecific(readers, (void*)(n + 1));
+}
+
+void PosixSharedMutex::unlockshared()
+{
+    intptr_t n = (intptr_t)pthread_getspecific(readers);
+
+    if (!n)
+    {
+        // taken while holding the lock exclusively
+        unlock();
+        return;
+    }
+
+    pthread_setspecific(readers, (void*)(n - 1));
+
+    if (n == 1)
+    {
+        pthread_rwlock_unlock(rwlock);
+    }
+}
+
+PosixSharedMutex::~PosixSharedMutex()
+{
+    if (rwlock)
+    {
+        pthread_rwlock_destroy(rwlock);
+        pthread_key_delete(readers);
+        delete rwlock;
+    }
+}
+
+
+PosixSemaphore::PosixSemaphore()
+{
+    mutex = NULL;
+    cond = NULL;
+    count = 0;
+}
+
+void PosixSemaphore::init(unsigned initial)
+{
+    if (mutex)
+    {
+        return;
+    }
+
+    mutex = new pthread_mutex_t;
+    cond = new pthread_cond_t;
+    pthread_mutex_init(mutex, NULL);
+    pthread_cond_init(cond, NULL);
+    count = initial;
+}
+
+void PosixSemaphore::release()
+{
+    pthread_mutex_lock(mutex);
+    count++;
+    pthread_cond_signal(cond);
+    pthread_mutex_unlock(mutex);
+}
+
+void PosixSemaphore::wait()
+{
+    pthread_mutex_lock(mutex);
+
+    while (!count)
+    {
+        pthread_cond_wait(cond, mutex);
+    }
+
+    count--;
+    pthread_mutex_unlock(mutex);
+}
+
+PosixSemaphore::~PosixSemaphore()
+{
+    if (mutex)
+    {
+        pthread_cond_destroy(cond);
+        pthread_mutex_destroy(mutex);
+        delete cond;
+        delete mutex;
+    }
+}
+
+
 } // namespace
 
 #endif
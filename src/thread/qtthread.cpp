@@ -82,4 +82,73 @@ QtMutex::~QtMutex()
     delete mutex;
 }
 
+
+QtSharedMutex::QtSharedMutex()
+{
+    rwlock = NULL;
+}
+
+void QtSharedMutex::init()
+{
+    if (!rwlock)
+    {
+        // recursive mode also lets the writer take read locks
+        rwlock = new QReadWriteLock(QReadWriteLock::Recursive);
+    }
+}
+
+void QtSharedMutex::lock()
+{
+    rwlock->lockForWrite();
+}
+
+void QtSharedMutex::unlock()
+{
+    rwlock->unlock();
+}
+
+void QtSharedMutex::lockshared()
+{
+    rwlock->lockForRead();
+}
+
+void QtSharedMutex::unlockshared()
+{
+    rwlock->unlock();
+}
+
+QtSharedMutex::~QtSharedMutex()
+{
+    delete rwlock;
+}
+
+
+QtSemaphore::QtSemaphore()
+{
+    semaphore = NULL;
+}
+
+void QtSemaphore::init(unsigned count)
+{
+    if (!semaphore)
+    {
+        semaphore = new QSemaphore(count);
+    }
+}
+
+void QtSemaphore::release()
+{
+    semaphore->release();
+}
+
+void QtSemaphore::wait()
+{
+    semaphore->acquire();
+}
+
+QtSemaphore::~QtSemaphore()
+{
+    delete semaphore;
+}
+
 } // namespace
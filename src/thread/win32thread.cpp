@@ -79,4 +79,72 @@ Win32Mutex::~Win32Mutex()
 	DeleteCriticalSection(&mutex);
 }
 
+
+Win32SharedMutex::Win32SharedMutex()
+{
+    InitializeCriticalSection(&mutex);
+}
+
+void Win32SharedMutex::init()
+{
+
+}
+
+void Win32SharedMutex::lock()
+{
+    EnterCriticalSection(&mutex);
+}
+
+void Win32SharedMutex::unlock()
+{
+    LeaveCriticalSection(&mutex);
+}
+
+void Win32SharedMutex::lockshared()
+{
+    EnterCriticalSection(&mutex);
+}
+
+void Win32SharedMutex::unlockshared()
+{
+    LeaveCriticalSection(&mutex);
+}
+
+Win32SharedMutex::~Win32SharedMutex()
+{
+    DeleteCriticalSection(&mutex);
+}
+
+
+Win32Semaphore::Win32Semaphore()
+{
+    semaphore = NULL;
+}
+
+void Win32Semaphore::init(unsigned count)
+{
+    if (!semaphore)
+    {
+        semaphore = CreateSemaphore(NULL, count, 0x7fffffff, NULL);
+    }
+}
+
+void Win32Semaphore::release()
+{
+    ReleaseSemaphore(semaphore, 1, NULL);
+}
+
+void Win32Semaphore::wait()
+{
+    WaitForSingleObject(semaphore, INFINITE);
+}
+
+Win32Semaphore::~Win32Semaphore()
+{
+    if (semaphore)
+    {
+        CloseHandle(semaphore);
+    }
+}
+
 } // namespace
@@ -27,7 +27,7 @@
 #include "mega/logging.h"
 
 namespace mega {
-Transfer::Transfer(MegaClient* cclient, direction_t ctype)
+Transfer::Transfer(MegaClient* cclient, direction_t ctype) : bt(&cclient->transfertimers)
 {
     type = ctype;
     client = cclient;
@@ -38,8 +38,13 @@ Transfer::Transfer(MegaClient* cclient, direction_t ctype)
     pos = 0;
     ctriv = 0;
     metamac = 0;
+    metamacpos = 0;
+    memset(metamacstate, 0, sizeof metamacstate);
     tag = 0;
     slot = NULL;
+    sink = NULL;
+    priority = PRIORITY_NORMAL;
+    queued = false;
     
     faputcompletion_it = client->faputcompletion.end();
 }
@@ -63,10 +68,172 @@ Transfer::~Transfer()
         client->transfers[type].erase(transfers_it);
     }
 
+    client->unqueuetransfer(this);
+
     if (slot)
     {
         delete slot;
     }
+
+    // the temp file of a partial download is kept only if it can be resumed
+    // from the transfer cache
+    if (type == GET && !dbid && chunkmacs.size())
+    {
+        if (localfilename.size())
+        {
+            client->fsaccess->unlinklocal(&localfilename);
+        }
+        else if (cachedlocalfilename.size())
+        {
+            client->fsaccess->unlinklocal(&cachedlocalfilename);
+        }
+    }
+}
+
+void Transfer::clearmacs()
+{
+    chunkmacs.clear();
+    metamacpos = 0;
+    memset(metamacstate, 0, sizeof metamacstate);
+}
+
+// serialize the state of a partial download: fingerprint, keys, temp file,
+// the MACs of the chunks written to it and the meta MAC folding state
+bool Transfer::serialize(string* d)
+{
+    if (type != GET || !localfilename.size())
+    {
+        return false;
+    }
+
+    unsigned short ll = localfilename.size();
+    uint32_t nmacs = chunkmacs.size();
+
+    d->append((const char*)&size, sizeof size);
+    d->append((const char*)&mtime, sizeof mtime);
+    d->append((const char*)crc, sizeof crc);
+    d->append(1, (char)isvalid);
+
+    d->append((const char*)filekey, sizeof filekey);
+    d->append((const char*)&ctriv, sizeof ctriv);
+    d->append((const char*)&metamac, sizeof metamac);
+
+    d->append((const char*)&ll, sizeof ll);
+    d->append(localfilename.data(), ll);
+
+    d->append((const char*)&nmacs, sizeof nmacs);
+
+    for (chunkmac_map::iterator it = chunkmacs.begin(); it != chunkmacs.end(); it++)
+    {
+        d->append((const char*)&it->first, sizeof it->first);
+        d->append((const char*)it->second.mac, sizeof it->second.mac);
+    }
+
+    d->append((const char*)&metamacpos, sizeof metamacpos);
+    d->append((const char*)metamacstate, sizeof metamacstate);
+
+    return true;
+}
+
+// restore a partial download into the given map, NULL if the record is
+// invalid or a duplicate
+Transfer* Transfer::unserialize(MegaClient* client, string* d, transfer_map* transfers)
+{
+    const char* ptr = d->data();
+    const char* end = ptr + d->size();
+
+    if (ptr + sizeof(m_off_t) + sizeof(m_time_t) + 4 * sizeof(int32_t) + 1
+            + FILENODEKEYLENGTH + 2 * sizeof(int64_t) + sizeof(unsigned short) > end)
+    {
+        LOG_err << "Transfer unserialization failed - short data";
+        return NULL;
+    }
+
+    Transfer* t = new Transfer(client, GET);
+
+    t->size = MemAccess::get<m_off_t>(ptr);
+    ptr += sizeof(m_off_t);
+
+    t->mtime = MemAccess::get<m_time_t>(ptr);
+    ptr += sizeof(m_time_t);
+
+    memcpy(t->crc, ptr, sizeof t->crc);
+    ptr += sizeof t->crc;
+
+    t->isvalid = *ptr++ != 0;
+
+    memcpy(t->filekey, ptr, sizeof t->filekey);
+    ptr += sizeof t->filekey;
+
+    t->ctriv = MemAccess::get<int64_t>(ptr);
+    ptr += sizeof(int64_t);
+
+    t->metamac = MemAccess::get<int64_t>(ptr);
+    ptr += sizeof(int64_t);
+
+    unsigned short ll = MemAccess::get<unsigned short>(ptr);
+    ptr += sizeof ll;
+
+    if (ptr + ll + sizeof(uint32_t) > end)
+    {
+        LOG_err << "Transfer unserialization failed - temp file name too long";
+        delete t;
+        return NULL;
+    }
+
+    t->cachedlocalfilename.assign(ptr, ll);
+    ptr += ll;
+
+    uint32_t nmacs = MemAccess::get<uint32_t>(ptr);
+    ptr += sizeof nmacs;
+
+    // records written before the meta MAC state was persisted lack it
+    size_t macbytes = nmacs * (sizeof(m_off_t) + sizeof(ChunkMAC));
+    bool hasmetamac = (size_t)(end - ptr) == macbytes + sizeof(m_off_t) + sizeof t->metamacstate;
+
+    if ((size_t)(end - ptr) != macbytes && !hasmetamac)
+    {
+        LOG_err << "Transfer unserialization failed - chunk MAC count mismatch";
+        delete t;
+        return NULL;
+    }
+
+    while (nmacs--)
+    {
+        m_off_t pos = MemAccess::get<m_off_t>(ptr);
+        ptr += sizeof pos;
+
+        memcpy(t->chunkmacs[pos].mac, ptr, sizeof(ChunkMAC));
+        ptr += sizeof(ChunkMAC);
+    }
+
+    if (hasmetamac)
+    {
+        m_off_t metamacpos = MemAccess::get<m_off_t>(ptr);
+        ptr += sizeof metamacpos;
+
+        // the folded prefix must end at the boundary of a known chunk
+        if (metamacpos > 0
+                && ChunkedHash::chunkceil(ChunkedHash::chunkfloor(metamacpos - 1)) == metamacpos
+                && t->chunkmacs.find(ChunkedHash::chunkfloor(metamacpos - 1)) != t->chunkmacs.end())
+        {
+            t->metamacpos = metamacpos;
+            memcpy(t->metamacstate, ptr, sizeof t->metamacstate);
+        }
+    }
+
+    t->key.setkey(t->filekey, FILENODE);
+    t->transfers_it = client->transfers[GET].end();
+
+    if (!transfers->insert(pair<FileFingerprint*, Transfer*>((FileFingerprint*)t, t)).second)
+    {
+        LOG_warn << "Duplicate cached transfer";
+        t->clearmacs();
+        delete t;
+        return NULL;
+    }
+
+    return t;
 }
 
 // transfer attempt failed, notify all related files, collect request on
@@ -79,6 +246,12 @@ void Transfer::failed(error e)
 
     bt.backoff();
 
+    // the cached quota figures are out of date
+    if (e == API_EOVERQUOTA)
+    {
+        client->invalidateaccountdetails();
+    }
+
     client->app->transfer_failed(this, e);
 
     for (file_list::iterator it = files.begin(); it != files.end(); it++)
@@ -92,6 +265,9 @@ void Transfer::failed(error e)
     if (defer)
     {
         failcount++;
+
+        // the partial download is resumed upon retry
+        client->cachetransfer(this);
         delete slot;
 
         LOG_debug << "Deferring transfer " << failcount;
@@ -100,6 +276,7 @@ void Transfer::failed(error e)
     {
         LOG_debug << "Removing transfer";
 
+        client->uncachetransfer(this);
         client->app->transfer_removed(this);
         delete this;
     }
@@ -118,10 +295,23 @@ void Transfer::complete()
         string localname;
         bool success;
 
+        // the download is complete: its partial state is obsolete
+        client->uncachetransfer(this);
+        clearmacs();
+
         // disconnect temp file from slot...
         delete slot->fa;
         slot->fa = NULL;
 
+        // ...unless the data went to a sink, which has received all of it
+        if (sink)
+        {
+            completefiles();
+            client->app->transfer_complete(this);
+            delete this;
+            return;
+        }
+
         // FIXME: multiple overwrite race conditions below (make copies
         // from open file instead of closing/reopening!)
 
@@ -461,6 +651,7 @@ DirectReadNode::DirectReadNode(MegaClient* cclient, handle ch, bool cp, SymmCiph
 
     retries = 0;
     size = 0;
+    pins = 0;
     
     pendingcmd = NULL;
     
@@ -494,10 +685,15 @@ void DirectReadNode::dispatch()
         pendingcmd = NULL;
     }
     
-    if (reads.empty())
+    if (reads.empty() && !pins)
     {
         delete this;
     }
+    else if (reads.empty() && tempurl.size())
+    {
+        // idle node of an open handle: the next read fetches a fresh tempurl
+        tempurl.clear();
+    }
     else
     {
         for (dr_list::iterator it = reads.begin(); it != reads.end(); it++)
@@ -506,6 +702,14 @@ void DirectReadNode::dispatch()
             assert(!(*it)->drs);
         }
 
+        const string* url = client->tempurls.get(hdrn_it->first, &size);
+
+        if (url)
+        {
+            tempurl = *url;
+            return cmdresult(API_OK);
+        }
+
         pendingcmd = new CommandDirectRead(this);
 
         client->reqs.add(pendingcmd);
@@ -520,8 +724,16 @@ void DirectReadNode::retry(error e)
     retries++;
 
     // signal failure to app , obtain minimum desired retry time
-    for (dr_list::iterator it = reads.begin(); it != reads.end(); it++)
+    for (dr_list::iterator it = reads.begin(); it != reads.end(); )
     {
+        // the app has its data already, only the request went on (prefetches
+        // are not retried)
+        if ((*it)->delivered || (*it)->prefetch)
+        {
+            delete *(it++);
+            continue;
+        }
+
         (*it)->abort();
 
         retryds = client->app->pread_failure(e, retries, (*it)->appdata);
@@ -530,6 +742,8 @@ void DirectReadNode::retry(error e)
         {
             minretryds = retryds;
         }
+
+        it++;
     }
 
     if (!minretryds)
@@ -544,6 +758,14 @@ void DirectReadNode::retry(error e)
             // delayed retry desired
             schedule(minretryds);
         }
+        else if (pins)
+        {
+            // cancellation desired, but the node stays for its open handles
+            while (reads.size())
+            {
+                delete reads.front();
+            }
+        }
         else
         {
             // cancellation desired
@@ -589,15 +811,45 @@ void DirectReadNode::schedule(dstime deltads)
     }
 }
 
-void DirectReadNode::enqueue(m_off_t offset, m_off_t count, int reqtag, void* appdata)
+DirectRead* DirectReadNode::enqueue(m_off_t offset, m_off_t count, int reqtag, void* appdata)
 {
-    new DirectRead(this, count, offset, reqtag, appdata);
+    return new DirectRead(this, count, offset, reqtag, appdata);
 }
 
 bool DirectReadSlot::doio()
 {
-    if (req->status == REQ_INFLIGHT || req->status == REQ_SUCCESS)
+    for (unsigned i = 0; i < reqs.size(); i++)
     {
+        if (reqs[i]->status == REQ_FAILURE)
+        {
+            if (reqs[i]->httpstatus == 403 || reqs[i]->httpstatus == 404)
+            {
+                // expired URL: the retry must fetch a fresh one
+                dr->drn->client->tempurls.invalidate(dr->drn->hdrn_it->first);
+            }
+
+            if (delivered)
+            {
+                // only the read-ahead was lost
+                delete dr;
+                return false;
+            }
+
+            // a failure triggers a complete abort and retry of all pending reads for this node
+            dr->drn->retry(API_EREAD);
+            return false;
+        }
+    }
+
+    for (;;)
+    {
+        HttpReq* req = reqs.front();
+
+        if (req->status != REQ_INFLIGHT && req->status != REQ_SUCCESS)
+        {
+            return false;
+        }
+
         if (req->in.size())
         {
             int r, l, t;
@@ -634,45 +886,172 @@ bool DirectReadSlot::doio()
                 dr->drn->symmcipher.ctr_crypt((byte*)req->in.data() + l, req->in.size() - l, pos + l, dr->drn->ctriv, NULL, false);
             }
 
-            if (dr->drn->client->app->pread_data((byte*)req->in.data(), t, pos, dr->appdata))
+            if (!delivered && !deliver(req->in.data(), pos, t))
             {
-                pos += t;
-
-                req->in.clear();
-                req->contentlength -= t;
-                req->bufpos = 0;               
+                return false;
             }
-            else
+
+            if (caching)
             {
-                // app-requested abort
-                delete dr;
-                return false;
+                cachedata(req->in.data(), t);
             }
+
+            pos += t;
+
+            req->in.clear();
+            req->contentlength -= t;
+            req->bufpos = 0;
         }
 
-        if (req->status == REQ_SUCCESS)
+        if (req->status != REQ_SUCCESS)
         {
-            dr->drn->schedule(3000);
+            return false;
+        }
+
+        dr->drn->schedule(3000);
+
+        if (reqs.size() == 1 && (!end || nextpos >= end))
+        {
+            // short last block of the file
+            if (caching && block.size() && pos == dr->drn->size)
+            {
+                dr->drn->client->drcache.put(dr->drn->h, blockpos / DirectReadCache::BLOCKSIZE, block.data(), block.size());
+            }
 
             // remove and delete completed read request, then remove slot
             delete dr;
             return true;
         }
+
+        // continue with the buffered data of the next part
+        delete req;
+        reqs.pop_front();
+        request();
+    }
+}
+
+bool DirectReadSlot::deliver(const char* data, m_off_t datapos, m_off_t len)
+{
+    MegaClient* client = dr->drn->client;
+    m_off_t to = datapos + len;
+
+    // riders can leave while iterating
+    vector<DirectRead*> reads(riders);
+    reads.insert(reads.begin(), dr);
+
+    for (unsigned i = 0; i < reads.size(); i++)
+    {
+        DirectRead* r = reads[i];
+
+        if (r->delivered)
+        {
+            continue;
+        }
+
+        m_off_t from = r->offset + r->done;
+        m_off_t upto = to;
+
+        if (from < datapos)
+        {
+            from = datapos;
+        }
+
+        if (r->count && upto >= r->offset + r->count)
+        {
+            upto = r->offset + r->count;
+        }
+
+        if (upto > from)
+        {
+            if (!r->prefetch && !client->app->pread_data((byte*)data + (from - datapos), upto - from, from, r->appdata))
+            {
+                // app-requested abort
+                bool primary = (r == dr);
+
+                delete r;
+
+                if (primary)
+                {
+                    return false;
+                }
+
+                continue;
+            }
+
+            r->done = upto - r->offset;
+        }
+
+        if (r->count && r->done >= r->count)
+        {
+            r->delivered = true;
+
+            if (r != dr)
+            {
+                delete r;
+            }
+        }
     }
-    else if (req->status == REQ_FAILURE)
+
+    delivered = dr->delivered && riders.empty();
+
+    return true;
+}
+
+void DirectReadSlot::detach(DirectRead* r)
+{
+    for (unsigned i = 0; i < riders.size(); i++)
     {
-        // a failure triggers a complete abort and retry of all pending reads for this node
-        dr->drn->retry(API_EREAD);
+        if (riders[i] == r)
+        {
+            riders.erase(riders.begin() + i);
+            break;
+        }
     }
+}
+
+// pass completed blocks of decrypted data to the cache
+void DirectReadSlot::cachedata(const char* data, unsigned len)
+{
+    DirectReadCache* cache = &dr->drn->client->drcache;
+
+    while (len)
+    {
+        unsigned l = DirectReadCache::BLOCKSIZE - block.size();
+
+        if (l > len)
+        {
+            l = len;
+        }
+
+        block.append(data, l);
+        data += l;
+        len -= l;
 
-    return false;
+        if (block.size() == DirectReadCache::BLOCKSIZE)
+        {
+            cache->put(dr->drn->h, blockpos / DirectReadCache::BLOCKSIZE, block.data(), block.size());
+            blockpos += block.size();
+            block.clear();
+        }
+    }
 }
 
 // abort active read, remove from pending queue
 void DirectRead::abort()
 {
-    delete drs;
-    drs = NULL;
+    if (drs)
+    {
+        if (drs->dr == this)
+        {
+            delete drs;
+        }
+        else
+        {
+            drs->detach(this);
+        }
+
+        drs = NULL;
+    }
 
     if (drq_it != drn->client->drq.end())
     {
@@ -691,6 +1070,11 @@ DirectRead::DirectRead(DirectReadNode* cdrn, m_off_t ccount, m_off_t coffset, in
     appdata = cappdata;
 
     drs = NULL;
+    readahead = 0;
+    done = 0;
+    delivered = false;
+    prefetch = false;
+    idle = false;
 
     reads_it = drn->reads.insert(drn->reads.end(), this);
     
@@ -719,34 +1103,124 @@ DirectRead::~DirectRead()
 // request DirectRead's range via tempurl
 DirectReadSlot::DirectReadSlot(DirectRead* cdr)
 {
-    char buf[128];
-
     dr = cdr;
 
-    pos = dr->offset;
+    DirectReadNode* drn = dr->drn;
+
+    pos = dr->offset + dr->done;
+    end = dr->count ? dr->offset + dr->count : 0;
+    delivered = false;
+
+    // take the queued reads that continue the range along
+    if (end)
+    {
+        bool merged;
+
+        do {
+            merged = false;
+
+            for (dr_list::iterator it = drn->reads.begin(); it != drn->reads.end(); it++)
+            {
+                DirectRead* r = *it;
+                m_off_t start = r->offset + r->done;
+
+                if (r != dr && !r->drs && r->count && r->drq_it != drn->client->drq.end()
+                 && start >= pos && start <= end)
+                {
+                    r->drs = this;
+                    riders.push_back(r);
+
+                    if (r->offset + r->count > end)
+                    {
+                        end = r->offset + r->count;
+                    }
+
+                    merged = true;
+                }
+            }
+        } while (merged);
+
+        if (riders.size())
+        {
+            LOG_debug << "Direct read of " << (end - pos) << " bytes serves " << (riders.size() + 1) << " reads";
+        }
+    }
+
+    // with caching, whole blocks are requested, plus the read-ahead
+    if ((caching = drn->client->drcache.maxbytes() && drn->size > 0))
+    {
+        pos -= pos % DirectReadCache::BLOCKSIZE;
 
-    req = new HttpReq(true);
+        if (end)
+        {
+            end += dr->readahead + DirectReadCache::BLOCKSIZE - 1;
+            end -= end % DirectReadCache::BLOCKSIZE;
 
-    sprintf(buf,"/%" PRIu64 "-", dr->offset);
+            if (end >= drn->size)
+            {
+                end = 0;
+            }
+        }
+    }
+
+    blockpos = pos;
 
-    if (dr->count)
+    // parallel parts need a bounded range
+    if (drn->client->drconnections > 1 && !end && drn->size > pos)
     {
-        sprintf(strchr(buf, 0), "%" PRIu64, dr->offset + dr->count - 1);
+        end = drn->size;
     }
 
-    req->posturl = dr->drn->tempurl;
-    req->posturl.append(buf);
-    req->type = REQ_BINARY;
+    nextpos = pos;
 
-    req->post(dr->drn->client);
+    request();
 
     drs_it = dr->drn->client->drss.insert(dr->drn->client->drss.end(), this);
 }
 
+void DirectReadSlot::request()
+{
+    MegaClient* client = dr->drn->client;
+    unsigned maxreqs = (end && client->drconnections > 1) ? client->drconnections : 1;
+
+    while (reqs.size() < maxreqs && (reqs.empty() || nextpos < end))
+    {
+        char buf[128];
+        m_off_t npos = (maxreqs > 1 && nextpos + PARTSIZE < end) ? nextpos + PARTSIZE : end;
+
+        HttpReq* req = new HttpReq(true);
+
+        sprintf(buf,"/%" PRIu64 "-", nextpos);
+
+        if (npos)
+        {
+            sprintf(strchr(buf, 0), "%" PRIu64, npos - 1);
+        }
+
+        req->posturl = dr->drn->tempurl;
+        req->posturl.append(buf);
+        req->type = REQ_BINARY;
+
+        req->post(client);
+
+        reqs.push_back(req);
+        nextpos = npos;
+    }
+}
+
 DirectReadSlot::~DirectReadSlot()
 {
     dr->drn->client->drss.erase(drs_it);
 
-    delete req;
+    // unfinished riders get a slot of their own
+    for (unsigned i = 0; i < riders.size(); i++)
+    {
+        riders[i]->drs = NULL;
+    }
+
+    for (unsigned i = 0; i < reqs.size(); i++)
+    {
+        delete reqs[i];
+    }
 }
 } // namespace
@@ -28,9 +28,81 @@
 #include "mega/megaapp.h"
 #include "mega/utils.h"
 #include "mega/logging.h"
+#include "mega/thread.h"
 
 namespace mega {
-TransferSlot::TransferSlot(Transfer* ctransfer)
+// reads and encrypts chunks ahead (uploads) or writes buffered ones
+// (downloads) on a worker - the buffers come from and return to the
+// client's pool on the client thread
+struct TransferSlot::IoTask : public ThreadPool::Task
+{
+    // NULL once the slot is gone: the task then closes the file
+    TransferSlot* slot;
+    FileAccess* fa;
+    ChunkBufferPool* pool;
+    direction_t type;
+
+    // upload key (the cipher objects are not thread-safe)
+    byte key[SymmCipher::KEYLENGTH];
+    int64_t ctriv;
+
+    vector<pair<m_off_t, WriteBackChunk> > chunks;
+
+    // chunks processed successfully, and whether a failed read may succeed
+    // later
+    unsigned done;
+    bool retry;
+
+    void run()
+    {
+        SymmCipher cipher;
+
+        if (type == PUT)
+        {
+            cipher.setkey(key);
+        }
+
+        for (done = 0; done < chunks.size(); done++)
+        {
+            WriteBackChunk* c = &chunks[done].second;
+
+            if (type == PUT)
+            {
+                if (!fa->frawread(c->buf, c->len, chunks[done].first))
+                {
+                    retry = fa->retry;
+                    break;
+                }
+
+                memset(c->buf + c->len, 0, (-(int)c->len) & (SymmCipher::BLOCKSIZE - 1));
+
+                // as HttpReqUL::crypt()
+                HttpReqXfer::cryptspan(&cipher, c->buf, c->len, chunks[done].first, ctriv, &c->macs, true);
+            }
+            else if (!fa->fwrite(c->buf, c->len, chunks[done].first))
+            {
+                break;
+            }
+        }
+    }
+
+    void completed()
+    {
+        if (slot)
+        {
+            return slot->iodone(this);
+        }
+
+        delete fa;
+
+        for (unsigned i = 0; i < chunks.size(); i++)
+        {
+            pool->release(chunks[i].second.buf, chunks[i].second.capacity);
+        }
+    }
+};
+
+TransferSlot::TransferSlot(Transfer* ctransfer) : retrybt(&ctransfer->client->transfertimers)
 {
     starttime = 0;
     progressreported = 0;
@@ -38,6 +110,18 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
     lastdata = Waiter::ds;
     errorcount = 0;
 
+    cachetime = Waiter::ds;
+    progresscached = 0;
+
+    writebackbytes = 0;
+    writepos = 0;
+
+    iotask = NULL;
+    readpos = 0;
+    ioerror = API_OK;
+    ioretryds = 0;
+    finishing = false;
+
     failure = false;
     retrying = false;
     
@@ -45,11 +129,41 @@ TransferSlot::TransferSlot(Transfer* ctransfer)
 
     reqs = NULL;
     pendingcmd = NULL;
+    tempurlh = UNDEF;
 
     transfer = ctransfer;
     transfer->slot = this;
 
-    connections = transfer->size > 131072 ? transfer->client->connections[transfer->type] : 1;
+    MegaClient* client = transfer->client;
+
+    if (transfer->size > 131072)
+    {
+        minconnections = client->minconnections[transfer->type];
+        connections = client->maxconnections[transfer->type];
+        activeconnections = client->connections[transfer->type];
+
+        if (activeconnections > connections)
+        {
+            activeconnections = connections;
+        }
+
+        if (activeconnections < minconnections)
+        {
+            activeconnections = minconnections;
+        }
+    }
+    else
+    {
+        minconnections = connections = activeconnections = 1;
+    }
+
+    adapttime = 0;
+    requestsize = 0;
+    requesttime = 0;
+    adaptprogress = 0;
+    adaptrate = 0;
+    adapterrors = 0;
+    adaptstep = 0;
 
     reqs = new HttpReqXfer*[connections]();
 
@@ -80,11 +194,39 @@ TransferSlot::~TransferSlot()
         pendingcmd->cancel();
     }
 
+    // a running task still uses the file and closes it when done, the
+    // chunks it writes aren't recorded for resumption
+    if (iotask)
+    {
+        iotask->slot = NULL;
+        fa = NULL;
+    }
+
+    for (map<m_off_t, WriteBackChunk>::iterator it = readahead.begin(); it != readahead.end(); it++)
+    {
+        transfer->client->chunkbuffers.release(it->second.buf, it->second.capacity);
+    }
+
+    // buffered chunks are kept for resumption (a sink is not written to
+    // once the slot goes away) - written here, a task would outlive the slot
+    if (fa && !transfer->sink)
+    {
+        flushwriteback(true, true);
+    }
+    else
+    {
+        for (map<m_off_t, WriteBackChunk>::iterator it = writeback.begin(); it != writeback.end(); it++)
+        {
+            transfer->client->chunkbuffers.release(it->second.buf, it->second.capacity);
+        }
+    }
+
     if (fa)
     {
         delete fa;
 
-        if ((transfer->type == GET) && transfer->localfilename.size())
+        // keep partial downloads for resumption (see ~Transfer())
+        if ((transfer->type == GET) && transfer->localfilename.size() && transfer->chunkmacs.empty())
         {
             transfer->client->fsaccess->unlinklocal(&transfer->localfilename);
         }
@@ -100,27 +242,71 @@ TransferSlot::~TransferSlot()
 
 void TransferSlot::toggleport(HttpReqXfer *req)
 {
-    if (!memcmp(req->posturl.c_str(), "http:", 5))
+    toggleport(&req->posturl, true);
+}
+
+void TransferSlot::toggleport(string* url, bool log)
+{
+    if (!memcmp(url->c_str(), "http:", 5))
     {
-       size_t portendindex = req->posturl.find("/", 8);
-       size_t portstartindex = req->posturl.find(":", 8);
+       size_t portendindex = url->find("/", 8);
+       size_t portstartindex = url->find(":", 8);
 
        if (portendindex != string::npos)
        {
            if (portstartindex == string::npos)
            {
-               LOG_debug << "Enabling alternative port for chunk";
-               req->posturl.insert(portendindex, ":8080");
+               if (log)
+               {
+                   LOG_debug << "Enabling alternative port for chunk";
+               }
+
+               url->insert(portendindex, ":8080");
            }
            else
            {
-               LOG_debug << "Disabling alternative port for chunk";
-               req->posturl.erase(portstartindex, portendindex - portstartindex);
+               if (log)
+               {
+                   LOG_debug << "Disabling alternative port for chunk";
+               }
+
+               url->erase(portstartindex, portendindex - portstartindex);
            }
        }
     }
 }
 
+// URL of the most recent chunk request, or NULL
+const string* TransferSlot::posturl()
+{
+    for (int i = connections; i--; )
+    {
+        if (reqs[i] && reqs[i]->posturl.size())
+        {
+            return &reqs[i]->posturl;
+        }
+    }
+
+    return NULL;
+}
+
+// switching ports is pointless if the other port of the host has been
+// failing as well
+bool TransferSlot::altportdegraded(const string& url)
+{
+    string alt = url;
+
+    toggleport(&alt, false);
+
+    if (alt != url && transfer->client->hoststats.degraded(alt))
+    {
+        LOG_debug << "Not changing the port, " << HostStats::hostof(alt) << " is failing as well";
+        return true;
+    }
+
+    return false;
+}
+
 // abort all HTTP connections
 void TransferSlot::disconnect()
 {
@@ -133,18 +319,283 @@ void TransferSlot::disconnect()
     }
 }
 
+bool TransferSlot::storechunk(HttpReqDL* req)
+{
+    WriteBackChunk& c = writeback[req->dlpos];
+
+    c.len = req->bufpos;
+    c.buf = req->detach(&transfer->key, transfer->ctriv, &c.capacity);
+    c.macs.swap(req->chunkmacs);
+
+    writebackbytes += c.len;
+
+    return flushwriteback(false);
+}
+
+// write the buffered chunks that continue the current sequential run, and
+// the lowest ones while over the cap (or until none are left)
+bool TransferSlot::flushwriteback(bool all, bool sync)
+{
+    MegaClient* client = transfer->client;
+    map<m_off_t, WriteBackChunk>::iterator it;
+
+    // asynchronously, the chunks are handed to a task in the same order (the
+    // completion of the running one flushes again)
+    IoTask* task = NULL;
+    m_off_t bytes = writebackbytes;
+
+    if (iotask)
+    {
+        return true;
+    }
+
+    while (writeback.size())
+    {
+        if ((it = writeback.find(writepos)) == writeback.end())
+        {
+            if (transfer->sink || (!all && bytes <= client->writebackmax))
+            {
+                break;
+            }
+
+            it = writeback.begin();
+        }
+
+        if (!sync && asyncio())
+        {
+            if (!task)
+            {
+                task = new IoTask;
+                task->type = GET;
+            }
+
+            task->chunks.push_back(*it);
+            writepos = it->first + it->second.len;
+            bytes -= it->second.len;
+            writeback.erase(it);
+            continue;
+        }
+
+        if (transfer->sink)
+        {
+            if (!transfer->sink->write(it->second.buf, it->second.len, it->first))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            fa->fwrite(it->second.buf, it->second.len, it->first);
+        }
+
+        // chunk MACs only cover written data (see Transfer::serialize())
+        for (chunkmac_map::iterator m = it->second.macs.begin(); m != it->second.macs.end(); m++)
+        {
+            transfer->chunkmacs[m->first] = m->second;
+        }
+
+        writepos = it->first + it->second.len;
+        writebackbytes -= it->second.len;
+        bytes = writebackbytes;
+
+        client->chunkbuffers.release(it->second.buf, it->second.capacity);
+        writeback.erase(it);
+    }
+
+    if (task)
+    {
+        task->slot = this;
+        task->fa = fa;
+        task->pool = &client->chunkbuffers;
+        task->done = 0;
+        task->retry = false;
+
+        iotask = task;
+        client->threadpool->submit(task);
+    }
+
+    return true;
+}
+
+// file I/O on the workers (never to a sink, which the app writes in order)
+bool TransferSlot::asyncio() const
+{
+    return transfer->client->threadpool && !transfer->sink;
+}
+
+// read and encrypt the chunks that follow the ones already prepared, up to
+// two per connection (see MAXPREPARED)
+void TransferSlot::startread()
+{
+    MegaClient* client = transfer->client;
+
+    if (iotask || Waiter::ds < ioretryds)
+    {
+        return;
+    }
+
+    if (readpos < transfer->pos)
+    {
+        readpos = transfer->pos;
+    }
+
+    // chunks behind the transfer's position won't be sent anymore
+    while (readahead.size() && readahead.begin()->first < transfer->pos)
+    {
+        client->chunkbuffers.release(readahead.begin()->second.buf, readahead.begin()->second.capacity);
+        readahead.erase(readahead.begin());
+    }
+
+    IoTask* task = NULL;
+    m_off_t prepared = 0;
+
+    for (map<m_off_t, WriteBackChunk>::iterator it = readahead.begin(); it != readahead.end(); it++)
+    {
+        prepared += it->second.len;
+    }
+
+    while (readpos < transfer->size)
+    {
+        unsigned count = readahead.size() + (task ? task->chunks.size() : 0);
+        m_off_t npos = requestend(readpos);
+
+        if (count >= 2 * (unsigned)connections
+         || (count >= (unsigned)connections && prepared + npos - readpos > MAXPREPARED))
+        {
+            break;
+        }
+
+        WriteBackChunk c;
+
+        c.len = (unsigned)(npos - readpos);
+        c.buf = client->chunkbuffers.get(c.len + ((-(int)c.len) & (SymmCipher::BLOCKSIZE - 1)), &c.capacity);
+
+        if (!task)
+        {
+            task = new IoTask;
+            task->type = PUT;
+        }
+
+        task->chunks.push_back(pair<m_off_t, WriteBackChunk>(readpos, c));
+        prepared += c.len;
+        readpos = npos;
+    }
+
+    if (task)
+    {
+        memcpy(task->key, transfer->key.key, sizeof task->key);
+        task->ctriv = transfer->ctriv;
+
+        task->slot = this;
+        task->fa = fa;
+        task->pool = &client->chunkbuffers;
+        task->done = 0;
+        task->retry = false;
+
+        iotask = task;
+        client->threadpool->submit(task);
+    }
+}
+
+// on the client thread: errors are only recorded here, doio() acts on them
+void TransferSlot::iodone(IoTask* task)
+{
+    MegaClient* client = transfer->client;
+
+    iotask = NULL;
+
+    for (unsigned i = 0; i < task->chunks.size(); i++)
+    {
+        WriteBackChunk* c = &task->chunks[i].second;
+
+        if (i >= task->done)
+        {
+            client->chunkbuffers.release(c->buf, c->capacity);
+        }
+        else if (task->type == PUT)
+        {
+            readahead[task->chunks[i].first] = *c;
+        }
+        else
+        {
+            // chunk MACs only cover written data (see Transfer::serialize())
+            for (chunkmac_map::iterator m = c->macs.begin(); m != c->macs.end(); m++)
+            {
+                transfer->chunkmacs[m->first] = m->second;
+            }
+            client->chunkbuffers.release(c->buf, c->capacity);
+        }
+
+        if (task->type == GET)
+        {
+            writebackbytes -= c->len;
+        }
+    }
+
+    if (task->done < task->chunks.size())
+    {
+        if (task->type == GET)
+        {
+            LOG_err << "Error writing download chunk at " << task->chunks[task->done].first;
+            ioerror = API_EWRITE;
+        }
+        else if (task->retry)
+        {
+            // read the chunks again shortly
+            readpos = task->chunks[task->done].first;
+            ioretryds = Waiter::ds + 2;
+        }
+        else
+        {
+            LOG_err << "Error reading upload chunk at " << task->chunks[task->done].first;
+            ioerror = API_EREAD;
+        }
+    }
+    else if (task->type == GET && writeback.size())
+    {
+        flushwriteback(finishing);
+    }
+    else if (task->type == PUT)
+    {
+        // keep the queue of prepared chunks filled
+        startread();
+    }
+}
+
 // coalesce block macs into file mac
+// (CBC-MAC of the chunk MACs in file order)
 int64_t TransferSlot::macsmac(chunkmac_map* macs)
 {
-    byte mac[SymmCipher::BLOCKSIZE] = { 0 };
+    byte mac[SymmCipher::BLOCKSIZE];
+    chunkmac_map::iterator it;
+
+    if (macs == &transfer->chunkmacs)
+    {
+        foldmacs();
 
-    for (chunkmac_map::iterator it = macs->begin(); it != macs->end(); it++)
+        memcpy(mac, transfer->metamacstate, sizeof mac);
+        it = macs->lower_bound(transfer->metamacpos);
+    }
+    else
+    {
+        memset(mac, 0, sizeof mac);
+        it = macs->begin();
+    }
+
+    for (; it != macs->end(); it++)
     {
         SymmCipher::xorblock(it->second.mac, mac);
         transfer->key.ecb_encrypt(mac);
     }
 
-    macs->clear();
+    if (macs == &transfer->chunkmacs)
+    {
+        transfer->clearmacs();
+    }
+    else
+    {
+        macs->clear();
+    }
 
     uint32_t* m = (uint32_t*)mac;
 
@@ -154,9 +605,24 @@ int64_t TransferSlot::macsmac(chunkmac_map* macs)
     return MemAccess::get<int64_t>((const char*)mac);
 }
 
+void TransferSlot::foldmacs()
+{
+    chunkmac_map::iterator it;
+
+    while ((it = transfer->chunkmacs.find(transfer->metamacpos)) != transfer->chunkmacs.end())
+    {
+        SymmCipher::xorblock(it->second.mac, transfer->metamacstate);
+        transfer->key.ecb_encrypt(transfer->metamacstate);
+        transfer->metamacpos = ChunkedHash::chunkceil(transfer->metamacpos);
+    }
+}
+
 // file transfer state machine
 void TransferSlot::doio(MegaClient* client)
 {
+    TraceSpan span(&client->tracer, "transferslot");
+    AllocScope allocscope(AllocTags::TRANSFERS);
+
     if (!fa)
     {
         // this is a pending completion, retry every 200 ms by default
@@ -168,6 +634,32 @@ void TransferSlot::doio(MegaClient* client)
 
     retrying = false;
 
+    if (ioerror)
+    {
+        error e = ioerror;
+
+        ioerror = API_OK;
+        return transfer->failed(e);
+    }
+
+    if (finishing)
+    {
+        flushwriteback(true);
+
+        if (iotask)
+        {
+            return;
+        }
+
+        // verify meta MAC
+        if (macsmac(&transfer->chunkmacs) == transfer->metamac)
+        {
+            return transfer->complete();
+        }
+
+        return transfer->failed(API_EKEY);
+    }
+
     if (!tempurl.size())
     {
         return;
@@ -181,6 +673,26 @@ void TransferSlot::doio(MegaClient* client)
         return transfer->failed(API_EFAILED);
     }
 
+    // uploads: chunks read in this pass, crypted before posting
+    vector<HttpReqXfer*> pending;
+    bool sealed = false;
+
+    if (transfer->type == GET)
+    {
+        for (int i = connections; i--; )
+        {
+            if (reqs[i] && reqs[i]->status == REQ_SUCCESS && !reqs[i]->crypted
+                    && reqs[i]->size == reqs[i]->bufpos)
+            {
+                pending.push_back(reqs[i]);
+            }
+        }
+
+        // finalize() skips the crypt step for these
+        cryptchunks(client, &pending);
+        pending.clear();
+    }
+
     for (int i = connections; i--; )
     {
         if (reqs[i])
@@ -199,6 +711,8 @@ void TransferSlot::doio(MegaClient* client)
                     if (transfer->type == PUT)
                     {
                         errorcount = 0;
+                        client->hoststats.success(reqs[i], reqs[i]->size);
+                        client->metrics.inc(Metrics::TRANSFER_BYTES, "upload", (double)reqs[i]->size);
 
                         // completed put transfers are signalled through the
                         // return of the upload token
@@ -220,8 +734,26 @@ void TransferSlot::doio(MegaClient* client)
 
                             progresscompleted -= reqs[i]->size;
 
+                            error e = (error)atoi(reqs[i]->in.c_str());
+
+                            if (e == API_ETOOMANYCONNECTIONS && activeconnections > minconnections)
+                            {
+                                // back off and resend the chunk
+                                activeconnections /= 2;
+
+                                if (activeconnections < minconnections)
+                                {
+                                    activeconnections = minconnections;
+                                }
+
+                                LOG_warn << "Too many connections, reducing to " << activeconnections;
+                                adapterrors++;
+                                reqs[i]->status = REQ_PREPARED;
+                                break;
+                            }
+
                             // fail with returned error
-                            return transfer->failed((error)atoi(reqs[i]->in.c_str()));
+                            return transfer->failed(e);
                         }
                     }
                     else
@@ -229,13 +761,35 @@ void TransferSlot::doio(MegaClient* client)
                         if (reqs[i]->size == reqs[i]->bufpos)
                         {
                             errorcount = 0;
+                            client->hoststats.success(reqs[i], reqs[i]->size);
+                            client->metrics.inc(Metrics::TRANSFER_BYTES, "download", (double)reqs[i]->size);
+
+                            if (client->writebackmax || transfer->sink || asyncio())
+                            {
+                                if (!storechunk((HttpReqDL*)reqs[i]))
+                                {
+                                    LOG_warn << "Download data refused by its sink";
+                                    return transfer->failed(API_EWRITE);
+                                }
+                            }
+                            else
+                            {
+                                reqs[i]->finalize(fa, &transfer->key, &transfer->chunkmacs, transfer->ctriv, 0, -1);
+                            }
 
-                            reqs[i]->finalize(fa, &transfer->key, &transfer->chunkmacs, transfer->ctriv, 0, -1);
+                            foldmacs();
 
                             if (progresscompleted == transfer->size)
                             {
+                                flushwriteback(true);
+
+                                // the last writes complete in a later pass
+                                if (iotask)
+                                {
+                                    finishing = true;
+                                }
                                 // verify meta MAC
-                                if (!progresscompleted || (macsmac(&transfer->chunkmacs) == transfer->metamac))
+                                else if (!progresscompleted || (macsmac(&transfer->chunkmacs) == transfer->metamac))
                                 {
                                     return transfer->complete();
                                 }
@@ -266,20 +820,29 @@ void TransferSlot::doio(MegaClient* client)
                         // fixed ten-minute retry intervals
                         backoff = 6000;
                     }
+                    else if (transfer->type == GET && tempurlh != UNDEF
+                             && (reqs[i]->httpstatus == 403 || reqs[i]->httpstatus == 404))
+                    {
+                        // expired URL: retry with a fresh one
+                        client->tempurls.invalidate(tempurlh);
+                        return transfer->failed(API_EAGAIN);
+                    }
                     else
                     {
+                        adapterrors++;
+
                         if (!failure)
                         {
                             failure = true;
                             bool changeport = false;
 
-                            if (transfer->type == GET && client->autodownport)
+                            if (transfer->type == GET && client->autodownport && !altportdegraded(reqs[i]->posturl))
                             {
                                 LOG_debug << "Automatically changing download port";
                                 client->usealtdownport = !client->usealtdownport;
                                 changeport = true;
                             }
-                            else if (transfer->type == PUT && client->autoupport)
+                            else if (transfer->type == PUT && client->autoupport && !altportdegraded(reqs[i]->posturl))
                             {
                                 LOG_debug << "Automatically changing upload port";
                                 client->usealtupport = !client->usealtupport;
@@ -303,22 +866,24 @@ void TransferSlot::doio(MegaClient* client)
             }
         }
 
+        // connections beyond the active count finish their chunk, but don't
+        // start new ones
         if (!failure)
         {
-            if (!reqs[i] || (reqs[i]->status == REQ_READY))
+            // (downloads hold off while too much data waits for writing)
+            if (i < activeconnections && (!reqs[i] || (reqs[i]->status == REQ_READY))
+                    && !(transfer->type == GET && asyncio() && writebackbytes > MAXQUEUEDWRITES))
             {
-                m_off_t npos = ChunkedHash::chunkceil(transfer->pos);
-
-                if (npos > transfer->size)
-                {
-                    npos = transfer->size;
-                }
+                m_off_t npos = requestend(transfer->pos);
 
                 if ((npos > transfer->pos) || !transfer->size)
                 {
                     if (!reqs[i])
                     {
-                        reqs[i] = transfer->type == PUT ? (HttpReqXfer*)new HttpReqUL() : (HttpReqXfer*)new HttpReqDL();
+                        reqs[i] = transfer->type == PUT ? (HttpReqXfer*)new HttpReqUL(&client->chunkbuffers)
+                                                     : (HttpReqXfer*)new HttpReqDL(&client->chunkbuffers);
+                        reqs[i]->shapedir = transfer->type;
+                        reqs[i]->shapeclass = transfer->priority;
                     }
 
                     string finaltempurl = tempurl;
@@ -342,9 +907,48 @@ void TransferSlot::doio(MegaClient* client)
                         }
                     }
 
-                    if (reqs[i]->prepare(fa, finaltempurl.c_str(), &transfer->key,
-                                         &transfer->chunkmacs, transfer->ctriv,
-                                         transfer->pos, npos))
+                    bool prepared;
+
+                    if (transfer->type == PUT && asyncio() && npos > transfer->pos)
+                    {
+                        map<m_off_t, WriteBackChunk>::iterator it = readahead.find(transfer->pos);
+
+                        // the connection waits for the chunk to be prepared
+                        if (it == readahead.end())
+                        {
+                            startread();
+                            continue;
+                        }
+
+                        // already encrypted, posted right away (prepared
+                        // with the request size of the time)
+                        npos = transfer->pos + it->second.len;
+
+                        ((HttpReqUL*)reqs[i])->adopt(it->second.buf, it->second.capacity, &it->second.macs,
+                                                     finaltempurl.c_str(), transfer->pos, npos);
+                        ((HttpReqUL*)reqs[i])->seal(&transfer->chunkmacs);
+                        readahead.erase(it);
+                        startread();
+
+                        sealed = true;
+                        prepared = true;
+                    }
+                    else if (transfer->type == PUT)
+                    {
+                        // crypted and posted after the loop
+                        if ((prepared = ((HttpReqUL*)reqs[i])->read(fa, finaltempurl.c_str(), transfer->pos, npos)))
+                        {
+                            pending.push_back(reqs[i]);
+                        }
+                    }
+                    else
+                    {
+                        prepared = reqs[i]->prepare(fa, finaltempurl.c_str(), &transfer->key,
+                                                    &transfer->chunkmacs, transfer->ctriv,
+                                                    transfer->pos, npos);
+                    }
+
+                    if (prepared)
                     {
                         reqs[i]->status = REQ_PREPARED;
                         transfer->pos = npos;
@@ -367,13 +971,32 @@ void TransferSlot::doio(MegaClient* client)
                 }
             }
 
-            if (reqs[i] && (reqs[i]->status == REQ_PREPARED))
+            if (reqs[i] && (reqs[i]->status == REQ_PREPARED)
+                    && (transfer->type == GET || reqs[i]->crypted))
             {
-                reqs[i]->post(client);
+                reqs[i]->send(client);
             }
         }
     }
 
+    if (pending.size())
+    {
+        cryptchunks(client, &pending);
+
+        for (unsigned i = 0; i < pending.size(); i++)
+        {
+            ((HttpReqUL*)pending[i])->seal(&transfer->chunkmacs);
+            pending[i]->send(client);
+        }
+
+        sealed = true;
+    }
+
+    if (sealed)
+    {
+        foldmacs();
+    }
+
     p += progresscompleted;
 
     if (p != progressreported)
@@ -384,18 +1007,31 @@ void TransferSlot::doio(MegaClient* client)
         progress();
     }
 
+    if (transfer->type == GET && progresscompleted != progresscached
+            && Waiter::ds - cachetime >= CACHEINTERVAL)
+    {
+        progresscached = progresscompleted;
+        cachetime = Waiter::ds;
+        client->cachetransfer(transfer);
+    }
+
+    adaptconnections(p);
+    adaptrequestsize();
+
     if (Waiter::ds - lastdata >= XFERTIMEOUT && !failure)
     {
         failure = true;
         bool changeport = false;
+        const string* url = posturl();
+        bool altdegraded = url && altportdegraded(*url);
 
-        if (transfer->type == GET && client->autodownport)
+        if (transfer->type == GET && client->autodownport && !altdegraded)
         {
             LOG_debug << "Automatically changing download port due to a timeout";
             client->usealtdownport = !client->usealtdownport;
             changeport = true;
         }
-        else if (transfer->type == PUT && client->autoupport)
+        else if (transfer->type == PUT && client->autoupport && !altdegraded)
         {
             LOG_debug << "Automatically changing upload port due to a timeout";
             client->usealtupport = !client->usealtupport;
@@ -433,6 +1069,158 @@ void TransferSlot::doio(MegaClient* client)
     }
 }
 
+struct ChunkCryptJob
+{
+    vector<HttpReqXfer*>* reqs;
+    const byte* key;
+    uint64_t ctriv;
+};
+
+// the cipher objects are not thread-safe: every chunk gets its own
+void TransferSlot::cryptchunk(unsigned i, void* param)
+{
+    ChunkCryptJob* job = (ChunkCryptJob*)param;
+    SymmCipher key;
+
+    key.setkey(job->key);
+    (*job->reqs)[i]->crypt(&key, job->ctriv);
+}
+
+// crypt() the requests, on the crypto workers if there are several of them,
+// or at least with their MACs interleaved
+void TransferSlot::cryptchunks(MegaClient* client, vector<HttpReqXfer*>* chunks)
+{
+    if (chunks->size() > 1 && client->cryptoworkers)
+    {
+        ChunkCryptJob job;
+
+        job.reqs = chunks;
+        job.key = transfer->key.key;
+        job.ctriv = transfer->ctriv;
+
+        client->cryptoworkers->run(chunks->size(), cryptchunk, &job);
+    }
+    else
+    {
+        HttpReqXfer::crypt(chunks, &transfer->key, transfer->ctriv);
+    }
+}
+
+// hill climbing on the goodput: add a connection while that doesn't make
+// the transfer slower, step back if it does, halve on failures (and hold
+// for a while after any decrease)
+void TransferSlot::adaptconnections(m_off_t p)
+{
+    if (minconnections >= connections)
+    {
+        return;
+    }
+
+    if (!adapttime)
+    {
+        adapttime = Waiter::ds;
+        adaptprogress = p;
+        return;
+    }
+
+    dstime elapsed = Waiter::ds - adapttime;
+
+    if (elapsed < ADAPTINTERVAL)
+    {
+        return;
+    }
+
+    m_off_t rate = (p - adaptprogress) / elapsed;
+    int previous = activeconnections;
+    const string* url = posturl();
+
+    if (adapterrors)
+    {
+        activeconnections /= 2;
+        adaptstep = -ADAPTHOLD;
+    }
+    else if (adaptstep > 0 && rate * 10 < adaptrate * 9)
+    {
+        activeconnections--;
+        adaptstep = -ADAPTHOLD;
+    }
+    else if (adaptstep < 0)
+    {
+        adaptstep++;
+    }
+    else if (activeconnections < connections
+             && !(url && transfer->client->hoststats.degraded(*url)))
+    {
+        // (no more connections to a host that keeps failing)
+        activeconnections++;
+        adaptstep = 1;
+    }
+    else
+    {
+        adaptstep = 0;
+    }
+
+    if (activeconnections < minconnections)
+    {
+        activeconnections = minconnections;
+    }
+
+    if (activeconnections != previous)
+    {
+        LOG_debug << "Transfer connections: " << previous << " -> " << activeconnections
+                  << " (" << rate * 10 << " B/s, " << adapterrors << " errors)";
+    }
+
+    adapttime = Waiter::ds;
+    adaptprogress = p;
+    adaptrate = rate;
+    adapterrors = 0;
+}
+
+void TransferSlot::adaptrequestsize()
+{
+    if (Waiter::ds - requesttime < ADAPTINTERVAL)
+    {
+        return;
+    }
+
+    requesttime = Waiter::ds;
+
+    const string* url = posturl();
+    const HostStats::Host* host = url ? transfer->client->hoststats.find(*url) : NULL;
+
+    if (!host || host->rtt < 0 || host->throughput < 0)
+    {
+        return;
+    }
+
+    m_off_t size = host->throughput * host->rtt / 1000 * REQUESTBDPS;
+
+    if (size > MAXREQUESTSIZE)
+    {
+        size = MAXREQUESTSIZE;
+    }
+
+    if (size / 1048576 != requestsize / 1048576)
+    {
+        LOG_debug << "Transfer request size: " << requestsize << " -> " << size
+                  << " (" << host->throughput << " B/s, " << host->rtt << " ms)";
+    }
+
+    requestsize = size;
+}
+
+m_off_t TransferSlot::requestend(m_off_t pos)
+{
+    m_off_t npos = pos;
+
+    do {
+        npos = ChunkedHash::chunkceil(npos);
+    } while (npos - pos < requestsize && npos < transfer->size);
+
+    return npos > transfer->size ? transfer->size : npos;
+}
+
 // transfer progress notification to app and related files
 void TransferSlot::progress()
 {
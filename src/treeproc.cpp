@@ -71,13 +71,6 @@ void TreeProcDU::proc(MegaClient*, Node* n)
     }
 }
 
-// mark node as removed and notify
-void TreeProcDel::proc(MegaClient* client, Node* n)
-{
-    n->changed.removed = true;
-    client->notifynode(n);
-}
-
 void TreeProcApplyKey::proc(MegaClient *client, Node *n)
 {
     if (n->attrstring)
@@ -141,4 +141,196 @@ void User::set(visibility_t v, m_time_t ct)
     show = v;
     ctime = ct;
 }
+
+UserHandleIndex::UserHandleIndex()
+{
+    count = 0;
+}
+
+// user handles are random, fold the upper bits in anyway
+size_t UserHandleIndex::hash(handle uh)
+{
+    uh ^= uh >> 29;
+    uh *= 0xbf58476d1ce4e5b9ULL;
+    uh ^= uh >> 32;
+
+    return (size_t)uh;
+}
+
+int UserHandleIndex::find(handle uh) const
+{
+    if (!count)
+    {
+        return 0;
+    }
+
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = hash(uh) & mask; slots[i].userid; i = (i + 1) & mask)
+    {
+        if (slots[i].uh == uh)
+        {
+            return slots[i].userid;
+        }
+    }
+
+    return 0;
+}
+
+void UserHandleIndex::set(handle uh, int userid)
+{
+    // keep the load factor below 3/4
+    if ((count + 1) * 4 > slots.size() * 3)
+    {
+        rehash();
+    }
+
+    size_t mask = slots.size() - 1;
+    size_t i;
+
+    for (i = hash(uh) & mask; slots[i].userid; i = (i + 1) & mask)
+    {
+        if (slots[i].uh == uh)
+        {
+            slots[i].userid = userid;
+            return;
+        }
+    }
+
+    slots[i].uh = uh;
+    slots[i].userid = userid;
+    count++;
+}
+
+void UserHandleIndex::clear()
+{
+    slots.clear();
+    count = 0;
+}
+
+void UserHandleIndex::rehash()
+{
+    vector<Slot> oldslots;
+    Slot empty;
+
+    empty.uh = UNDEF;
+    empty.userid = 0;
+
+    oldslots.swap(slots);
+    slots.resize(oldslots.size() ? oldslots.size() * 2 : MINSLOTS, empty);
+
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = 0; i < oldslots.size(); i++)
+    {
+        if (oldslots[i].userid)
+        {
+            size_t j;
+
+            for (j = hash(oldslots[i].uh) & mask; slots[j].userid; j = (j + 1) & mask);
+
+            slots[j] = oldslots[i];
+        }
+    }
+}
+
+UserEmailIndex::UserEmailIndex()
+{
+    count = 0;
+}
+
+// FNV-1a
+size_t UserEmailIndex::hash(const string& email)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < email.size(); i++)
+    {
+        h ^= (unsigned char)email[i];
+        h *= 0x100000001b3ULL;
+    }
+
+    return (size_t)(h ^ h >> 32);
+}
+
+int UserEmailIndex::find(const string& email) const
+{
+    if (!count)
+    {
+        return 0;
+    }
+
+    size_t h = hash(email);
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = h & mask; slots[i].userid; i = (i + 1) & mask)
+    {
+        if (slots[i].hash == h && slots[i].email == email)
+        {
+            return slots[i].userid;
+        }
+    }
+
+    return 0;
+}
+
+void UserEmailIndex::set(const string& email, int userid)
+{
+    if ((count + 1) * 4 > slots.size() * 3)
+    {
+        rehash();
+    }
+
+    size_t h = hash(email);
+    size_t mask = slots.size() - 1;
+    size_t i;
+
+    for (i = h & mask; slots[i].userid; i = (i + 1) & mask)
+    {
+        if (slots[i].hash == h && slots[i].email == email)
+        {
+            slots[i].userid = userid;
+            return;
+        }
+    }
+
+    slots[i].email = email;
+    slots[i].hash = h;
+    slots[i].userid = userid;
+    count++;
+}
+
+void UserEmailIndex::clear()
+{
+    slots.clear();
+    count = 0;
+}
+
+void UserEmailIndex::rehash()
+{
+    vector<Slot> oldslots;
+    Slot empty;
+
+    empty.hash = 0;
+    empty.userid = 0;
+
+    oldslots.swap(slots);
+    slots.resize(oldslots.size() ? oldslots.size() * 2 : MINSLOTS, empty);
+
+    size_t mask = slots.size() - 1;
+
+    for (size_t i = 0; i < oldslots.size(); i++)
+    {
+        if (oldslots[i].userid)
+        {
+            size_t j;
+
+            for (j = oldslots[i].hash & mask; slots[j].userid; j = (j + 1) & mask);
+
+            slots[j].email.swap(oldslots[i].email);
+            slots[j].hash = oldslots[i].hash;
+            slots[j].userid = oldslots[i].userid;
+        }
+    }
+}
 } // namespace
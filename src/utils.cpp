@@ -20,6 +20,11 @@
  */
 
 #include "mega/utils.h"
+#include "mega/logging.h"
+
+#ifdef ENABLE_ALLOC_TAGS
+#include <new>
+#endif
 
 namespace mega {
 Cachable::Cachable()
@@ -340,6 +345,424 @@ bool PayCrypter::hybridEncrypt(const string *cleartext, const byte *pubkdata, in
     return true;
 }
 
+SlabAllocator::SlabAllocator(size_t size, size_t count)
+{
+    // blocks must be able to hold the free list link and keep 64-bit alignment
+    blocksize = (size < sizeof(void*) ? sizeof(void*) : size);
+    blocksize = (blocksize + sizeof(uint64_t) - 1) & ~(sizeof(uint64_t) - 1);
+    blocksperchunk = count ? count : 1;
+    chunkused = blocksperchunk;
+    freelist = NULL;
+    inuse = 0;
+    allocs = 0;
+    frees = 0;
+}
+
+SlabAllocator::~SlabAllocator()
+{
+    for (size_t i = chunks.size(); i--; )
+    {
+        delete[] chunks[i];
+    }
+}
+
+void* SlabAllocator::alloc()
+{
+    void* p;
+
+    if (freelist)
+    {
+        p = freelist;
+        freelist = *(void**)p;
+    }
+    else
+    {
+        if (chunkused == blocksperchunk)
+        {
+            chunks.push_back(new char[blocksize * blocksperchunk]);
+            chunkused = 0;
+        }
+
+        p = chunks.back() + blocksize * chunkused++;
+    }
+
+    inuse++;
+    allocs++;
+
+    return p;
+}
+
+void SlabAllocator::free(void* p)
+{
+    if (p)
+    {
+        *(void**)p = freelist;
+        freelist = p;
+
+        inuse--;
+        frees++;
+    }
+}
+
+bool SlabAllocator::release()
+{
+    if (inuse)
+    {
+        return false;
+    }
+
+    for (size_t i = chunks.size(); i--; )
+    {
+        delete[] chunks[i];
+    }
+
+    chunks.clear();
+    chunkused = blocksperchunk;
+    freelist = NULL;
+
+    return true;
+}
+
+size_t SlabAllocator::allocated() const
+{
+    return chunks.size() * blocksize * blocksperchunk;
+}
+
+const double Metrics::bucketbounds[NUMBUCKETS] = { 1, 2.5, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 10000 };
+
+const Metrics::Info Metrics::info[NUMMETRICS] = {
+    { "mega_api_request_duration_ms", "histogram", "command", "Time from sending an API request to its response" },
+    { "mega_actionpacket_lag_ms", "histogram", NULL, "Time from receiving server-client packets to processing them" },
+    { "mega_transfer_bytes_total", "counter", "direction", "Bytes of completed transfer chunks" },
+    { "mega_transfer_slots", "gauge", "direction", "Active transfer slots" },
+    { "mega_db_commit_duration_ms", "histogram", NULL, "Time of a commit of the local cache" },
+    { "mega_loop_duration_ms", "histogram", NULL, "Time of an iteration of the client loop" },
+    { "mega_phase_duration_ms", "histogram", "phase", "Time of a phase of the client loop or a listener callback" },
+    { "mega_queue_depth", "gauge", "queue", "Items waiting in a queue" },
+    { "mega_alloc_bytes", "gauge", "subsystem", "Heap bytes in use" },
+    { "mega_alloc_total", "counter", "subsystem", "Heap allocations" },
+    { "mega_pool_tasks_total", "counter", "event", "Tasks submitted to, stolen by and finished on the workers of the thread pool" },
+    { "mega_pool_busy_ms_total", "counter", NULL, "Time spent running tasks of the thread pool" }
+};
+
+Metrics::Series::Series()
+{
+    value = 0;
+    count = 0;
+    memset(buckets, 0, sizeof buckets);
+}
+
+void Metrics::inc(metric_t m, const char* label, double value)
+{
+    series[m][label].value += value;
+}
+
+void Metrics::set(metric_t m, const char* label, double value)
+{
+    series[m][label].value = value;
+}
+
+void Metrics::observe(metric_t m, const char* label, double ms)
+{
+    Series& s = series[m][label];
+
+    s.value += ms;
+    s.count++;
+
+    for (int i = 0; i < NUMBUCKETS; i++)
+    {
+        if (ms <= bucketbounds[i])
+        {
+            s.buckets[i]++;
+            break;
+        }
+    }
+}
+
+void Metrics::gettext(string* text) const
+{
+    char buf[256];
+
+    text->clear();
+
+    for (int m = 0; m < NUMMETRICS; m++)
+    {
+        const Info& mi = info[m];
+        bool histogram = !strcmp(mi.type, "histogram");
+
+        snprintf(buf, sizeof buf, "# HELP %s %s\n# TYPE %s %s\n", mi.name, mi.help, mi.name, mi.type);
+        text->append(buf);
+
+        for (map<string, Series>::const_iterator it = series[m].begin(); it != series[m].end(); it++)
+        {
+            const Series& s = it->second;
+
+            // label pair, empty for metrics without a label
+            string labels;
+
+            if (mi.label && it->first.size())
+            {
+                labels.append(mi.label);
+                labels.append("=\"");
+                labels.append(it->first);
+                labels.append("\"");
+            }
+
+            if (!histogram)
+            {
+                snprintf(buf, sizeof buf, "%s%s%s%s %.15g\n", mi.name,
+                         labels.size() ? "{" : "", labels.c_str(), labels.size() ? "}" : "", s.value);
+                text->append(buf);
+                continue;
+            }
+
+            uint64_t cumulative = 0;
+
+            for (int i = 0; i < NUMBUCKETS; i++)
+            {
+                cumulative += s.buckets[i];
+                snprintf(buf, sizeof buf, "%s_bucket{%s%sle=\"%g\"} %" PRIu64 "\n", mi.name,
+                         labels.c_str(), labels.size() ? "," : "", bucketbounds[i], cumulative);
+                text->append(buf);
+            }
+
+            snprintf(buf, sizeof buf, "%s_bucket{%s%sle=\"+Inf\"} %" PRIu64 "\n", mi.name,
+                     labels.c_str(), labels.size() ? "," : "", s.count);
+            text->append(buf);
+
+            snprintf(buf, sizeof buf, "%s_sum%s%s%s %.15g\n%s_count%s%s%s %" PRIu64 "\n",
+                     mi.name, labels.size() ? "{" : "", labels.c_str(), labels.size() ? "}" : "", s.value,
+                     mi.name, labels.size() ? "{" : "", labels.c_str(), labels.size() ? "}" : "", s.count);
+            text->append(buf);
+        }
+    }
+}
+
+int64_t Metrics::now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter, frequency;
+    QueryPerformanceCounter(&counter);
+    QueryPerformanceFrequency(&frequency);
+    return (counter.QuadPart / frequency.QuadPart) * 1000000
+            + (counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+#else
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * (int64_t)1000000 + tv.tv_usec;
+#endif
+}
+
+Tracer::Tracer()
+{
+    next = 0;
+    count = 0;
+    slowthreshold = 0;
+    metrics = NULL;
+    enabled = false;
+    timing = false;
+}
+
+void Tracer::enable(size_t capacity)
+{
+    events.clear();
+    events.resize(capacity ? capacity : 1);
+    next = 0;
+    count = 0;
+    enabled = true;
+    timing = true;
+}
+
+void Tracer::disable()
+{
+    enabled = false;
+    timing = slowthreshold > 0;
+}
+
+void Tracer::setwatchdog(Metrics* m, int ms)
+{
+    metrics = m;
+    slowthreshold = ms > 0 ? ms * (int64_t)1000 : 0;
+    timing = enabled || slowthreshold > 0;
+}
+
+void Tracer::record(const char* name, int64_t start, int64_t duration)
+{
+    if (slowthreshold)
+    {
+        if (metrics)
+        {
+            metrics->observe(Metrics::PHASE_TIME, name, duration / 1000.0);
+        }
+
+        if (duration >= slowthreshold)
+        {
+            LOG_warn << "Stall: phase=" << name << " ms=" << duration / 1000
+                     << " threshold_ms=" << slowthreshold / 1000;
+        }
+    }
+
+    if (!enabled)
+    {
+        return;
+    }
+
+    Event& e = events[next];
+
+    e.name = name;
+    e.start = start;
+    e.duration = duration;
+
+    next = (next + 1) % events.size();
+
+    if (count < events.size())
+    {
+        count++;
+    }
+}
+
+void Tracer::getjson(string* json) const
+{
+    char buf[256];
+
+    *json = "{\"traceEvents\":[";
+
+    // oldest first
+    for (size_t i = 0; i < count; i++)
+    {
+        const Event& e = events[(next + events.size() - count + i) % events.size()];
+
+        snprintf(buf, sizeof buf,
+                 "%s{\"name\":\"%s\",\"cat\":\"mega\",\"ph\":\"X\",\"ts\":%" PRId64 ",\"dur\":%" PRId64 ",\"pid\":1,\"tid\":1}",
+                 i ? "," : "", e.name, e.start, e.duration);
+        json->append(buf);
+    }
+
+    json->append("],\"displayTimeUnit\":\"ms\"}");
+}
+
+static const char* alloctagnames[AllocTags::NUMTAGS] = {
+    "other", "nodes", "attrs", "json", "http", "transfers", "sync", "cache"
+};
+
+#ifdef ENABLE_ALLOC_TAGS
+#ifdef _MSC_VER
+#define ALLOC_TLS __declspec(thread)
+#else
+#define ALLOC_TLS __thread
+#endif
+
+static ALLOC_TLS int alloccurrent;
+static volatile int64_t allocinuse[AllocTags::NUMTAGS];
+static volatile int64_t allocallocs[AllocTags::NUMTAGS];
+static volatile int64_t allocbytes[AllocTags::NUMTAGS];
+
+// precedes every block, keeps the block maximally aligned
+union AllocHeader
+{
+    struct
+    {
+        size_t size;
+        int tag;
+    } h;
+
+    long double align;
+};
+
+static inline void allocadd(volatile int64_t* counter, int64_t value)
+{
+#ifdef _MSC_VER
+    InterlockedExchangeAdd64((volatile LONGLONG*)counter, value);
+#else
+    __sync_fetch_and_add(counter, value);
+#endif
+}
+
+static void* tagalloc(size_t size)
+{
+    AllocHeader* h = (AllocHeader*)malloc(sizeof(AllocHeader) + size);
+
+    if (!h)
+    {
+        return NULL;
+    }
+
+    h->h.size = size;
+    h->h.tag = alloccurrent;
+
+    allocadd(&allocinuse[h->h.tag], size);
+    allocadd(&allocallocs[h->h.tag], 1);
+    allocadd(&allocbytes[h->h.tag], size);
+
+    return h + 1;
+}
+
+static void tagfree(void* p)
+{
+    if (p)
+    {
+        AllocHeader* h = (AllocHeader*)p - 1;
+
+        allocadd(&allocinuse[h->h.tag], -(int64_t)h->h.size);
+        free(h);
+    }
+}
+
+bool AllocTags::enabled()
+{
+    return true;
+}
+
+AllocTags::tag_t AllocTags::swap(tag_t tag)
+{
+    tag_t previous = (tag_t)alloccurrent;
+
+    alloccurrent = tag;
+
+    return previous;
+}
+
+void AllocTags::get(tag_t tag, Counters* c)
+{
+    c->inuse = allocinuse[tag];
+    c->allocs = allocallocs[tag];
+    c->bytes = allocbytes[tag];
+}
+#else
+bool AllocTags::enabled()
+{
+    return false;
+}
+
+AllocTags::tag_t AllocTags::swap(tag_t)
+{
+    return OTHER;
+}
+
+void AllocTags::get(tag_t, Counters* c)
+{
+    memset(c, 0, sizeof *c);
+}
+#endif
+
+const char* AllocTags::name(tag_t tag)
+{
+    return alloctagnames[tag];
+}
+
+size_t stringallocated(const string* s)
+{
+    const char* p = s->data();
+
+    // short string optimization: buffer inside the object
+    if (p >= (const char*)s && p < (const char*)(s + 1))
+    {
+        return 0;
+    }
+
+    return s->capacity() + 1;
+}
+
 #ifdef _WIN32
 int mega_snprintf(char *s, size_t n, const char *format, ...)
 {
@@ -361,3 +784,52 @@ int mega_snprintf(char *s, size_t n, const char *format, ...)
 #endif
 
 } // namespace
+
+#ifdef ENABLE_ALLOC_TAGS
+void* operator new(size_t size)
+{
+    void* p = mega::tagalloc(size);
+
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) throw()
+{
+    return mega::tagalloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) throw()
+{
+    return mega::tagalloc(size);
+}
+
+void operator delete(void* p) throw()
+{
+    mega::tagfree(p);
+}
+
+void operator delete[](void* p) throw()
+{
+    mega::tagfree(p);
+}
+
+void operator delete(void* p, const std::nothrow_t&) throw()
+{
+    mega::tagfree(p);
+}
+
+void operator delete[](void* p, const std::nothrow_t&) throw()
+{
+    mega::tagfree(p);
+}
+#endif
@@ -221,13 +221,13 @@ bool WinFileAccess::fopen(string* name, bool read, bool write)
     }
 
     hFile = CreateFile2((LPCWSTR)name->data(),
-                        read ? GENERIC_READ : GENERIC_WRITE,
+                        read ? (write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ) : GENERIC_WRITE,
                         FILE_SHARE_WRITE | FILE_SHARE_READ,
                         read ? OPEN_EXISTING : OPEN_ALWAYS,
                         &ex);
 #else
     hFile = CreateFileW((LPCWSTR)name->data(),
-                        read ? GENERIC_READ : GENERIC_WRITE,
+                        read ? (write ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ) : GENERIC_WRITE,
                         FILE_SHARE_WRITE | FILE_SHARE_READ,
                         NULL,
                         read ? OPEN_EXISTING : OPEN_ALWAYS,
@@ -307,6 +307,7 @@ WinFileSystemAccess::WinFileSystemAccess()
     notifyfailed = false;
 
     pendingevents = 0;
+    waiter = NULL;
 
     localseparator.assign((char*)L"\\", sizeof(wchar_t));
 }
@@ -345,8 +346,10 @@ bool WinFileSystemAccess::istransientorexists(DWORD e)
 void WinFileSystemAccess::addevents(Waiter* w, int)
 {
 #ifndef WINDOWS_PHONE
-    // overlapped completion wakes up WaitForMultipleObjectsEx()
-    ((WinWaiter*)w)->pendingfsevents = pendingevents;
+    // overlapped completion wakes up WaitForMultipleObjectsEx() (or is
+    // queued to the completion port of subsequently created notifiers)
+    waiter = (WinWaiter*)w;
+    waiter->pendingfsevents = pendingevents;
 #endif
 }
 
@@ -820,6 +823,19 @@ VOID CALLBACK WinDirNotify::completion(DWORD dwErrorCode, DWORD dwBytes, LPOVERL
 #endif
 }
 
+void WinDirNotify::completed(DWORD dwBytes)
+{
+#ifndef WINDOWS_PHONE
+    DWORD bytes;
+
+    if (GetOverlappedResult(hDirectory, &overlapped, &bytes, FALSE)
+     || GetLastError() != ERROR_OPERATION_ABORTED)
+    {
+        process(dwBytes);
+    }
+#endif
+}
+
 void WinDirNotify::process(DWORD dwBytes)
 {
 #ifndef WINDOWS_PHONE
@@ -880,7 +896,7 @@ void WinDirNotify::readchanges()
                             | FILE_NOTIFY_CHANGE_LAST_WRITE
                             | FILE_NOTIFY_CHANGE_SIZE
                             | FILE_NOTIFY_CHANGE_CREATION,
-                              &dwBytes, &overlapped, completion))
+                              &dwBytes, &overlapped, iocpkey ? NULL : completion))
     {
         failed = false;
     }
@@ -902,8 +918,11 @@ void WinDirNotify::readchanges()
 #endif
 }
 
-WinDirNotify::WinDirNotify(string* localbasepath, string* ignore) : DirNotify(localbasepath, ignore)
+WinDirNotify::WinDirNotify(string* localbasepath, string* ignore, WinWaiter* w) : DirNotify(localbasepath, ignore)
 {
+    waiter = w;
+    iocpkey = 0;
+
 #ifndef WINDOWS_PHONE
     ZeroMemory(&overlapped, sizeof(overlapped));
 
@@ -928,6 +947,12 @@ WinDirNotify::WinDirNotify(string* localbasepath, string* ignore) : DirNotify(lo
     {
         failed = false;
 
+        if (waiter && (iocpkey = waiter->associate(hDirectory, this)))
+        {
+            // completion packets identify the notifier by their key
+            overlapped.hEvent = NULL;
+        }
+
         readchanges();
     }
     else
@@ -942,6 +967,12 @@ WinDirNotify::WinDirNotify(string* localbasepath, string* ignore) : DirNotify(lo
 WinDirNotify::~WinDirNotify()
 {
 #ifndef WINDOWS_PHONE
+    if (iocpkey)
+    {
+        // the aborted read's packet will be ignored
+        waiter->dissociate(iocpkey);
+    }
+
     if (hDirectory != INVALID_HANDLE_VALUE)
     {
         CloseHandle(hDirectory);
@@ -961,7 +992,7 @@ DirAccess* WinFileSystemAccess::newdiraccess()
 
 DirNotify* WinFileSystemAccess::newdirnotify(string* localpath, string* ignore)
 {
-    return new WinDirNotify(localpath, ignore);
+    return new WinDirNotify(localpath, ignore, waiter);
 }
 
 bool WinFileSystemAccess::issyncsupported(string *localpath)
@@ -995,6 +1026,42 @@ bool WinFileSystemAccess::issyncsupported(string *localpath)
 
 bool WinDirAccess::dopen(string* name, FileAccess* f, bool glob)
 {
+#ifdef USE_BULK_DIRINFO
+    if (!glob)
+    {
+        name->append("", 1);
+        hDirectory = CreateFileW((LPCWSTR)name->data(), FILE_LIST_DIRECTORY,
+                                 FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                 NULL, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, NULL);
+        name->resize(name->size() - 1);
+
+        if (hDirectory != INVALID_HANDLE_VALUE)
+        {
+            dirinfobuf = new LONGLONG[DIRINFOBUFSIZE / sizeof(LONGLONG)];
+
+            // an empty directory still lists . and .. - failure means that
+            // the filesystem does not support this information class
+            if (nextdirinfo(true))
+            {
+                if (f && ((WinFileAccess*)f)->hFind != INVALID_HANDLE_VALUE)
+                {
+                    FindClose(((WinFileAccess*)f)->hFind);
+                    ((WinFileAccess*)f)->hFind = INVALID_HANDLE_VALUE;
+                }
+
+                return true;
+            }
+
+            LOG_debug << "Bulk directory listing not available. Error code: " << GetLastError();
+
+            delete[] dirinfobuf;
+            dirinfobuf = NULL;
+            CloseHandle(hDirectory);
+            hDirectory = INVALID_HANDLE_VALUE;
+        }
+    }
+#endif
+
     if (f)
     {
         if ((hFind = ((WinFileAccess*)f)->hFind) != INVALID_HANDLE_VALUE)
@@ -1056,9 +1123,79 @@ bool WinDirAccess::dopen(string* name, FileAccess* f, bool glob)
     return true;
 }
 
+#ifdef USE_BULK_DIRINFO
+// fetch the next buffer of records (first: restart the listing)
+bool WinDirAccess::nextdirinfo(bool first)
+{
+    if (!GetFileInformationByHandleEx(hDirectory,
+                                      first ? FileIdBothDirectoryRestartInfo : FileIdBothDirectoryInfo,
+                                      dirinfobuf, DIRINFOBUFSIZE))
+    {
+        dirinfo = NULL;
+        return false;
+    }
+
+    dirinfo = (FILE_ID_BOTH_DIR_INFO*)dirinfobuf;
+    return true;
+}
+#endif
+
 // FIXME: implement followsymlinks
 bool WinDirAccess::dnext(string* path, string* name, bool followsymlinks, nodetype_t* type)
 {
+    statvalid = false;
+
+#ifdef USE_BULK_DIRINFO
+    if (hDirectory != INVALID_HANDLE_VALUE)
+    {
+        for (;;)
+        {
+            if (!dirinfo && !nextdirinfo(false))
+            {
+                return false;
+            }
+
+            FILE_ID_BOTH_DIR_INFO* info = dirinfo;
+            const wchar_t* fname = info->FileName;
+            size_t fnamelen = info->FileNameLength / sizeof(wchar_t);
+
+            dirinfo = info->NextEntryOffset
+                    ? (FILE_ID_BOTH_DIR_INFO*)((char*)info + info->NextEntryOffset)
+                    : NULL;
+
+            if (WinFileAccess::skipattributes(info->FileAttributes)
+             || ((info->FileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+              && *fname == '.'
+              && (fnamelen == 1 || (fnamelen == 2 && fname[1] == '.'))))
+            {
+                continue;
+            }
+
+            name->assign((char*)fname, fnamelen * sizeof(wchar_t));
+
+            if (type)
+            {
+                *type = (info->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? FOLDERNODE : FILENODE;
+            }
+
+            // (filesystems without stable file IDs report zero)
+            if ((statvalid = info->FileId.QuadPart != 0))
+            {
+                FILETIME ft;
+
+                ft.dwLowDateTime = info->LastWriteTime.LowPart;
+                ft.dwHighDateTime = info->LastWriteTime.HighPart;
+
+                statsize = info->EndOfFile.QuadPart;
+                statmtime = FileTime_to_POSIX(&ft);
+                statfsid = (handle)info->FileId.QuadPart;
+            }
+
+            return true;
+        }
+    }
+#endif
+
     for (;;)
     {
         if (ffdvalid
@@ -1086,10 +1223,31 @@ bool WinDirAccess::dnext(string* path, string* name, bool followsymlinks, nodety
     }
 }
 
+bool WinDirAccess::dstat(m_off_t* size, m_time_t* mtime, handle* fsid)
+{
+    if (!statvalid)
+    {
+        return false;
+    }
+
+    *size = statsize;
+    *mtime = statmtime;
+    *fsid = statfsid;
+
+    return true;
+}
+
 WinDirAccess::WinDirAccess()
 {
     ffdvalid = false;
     hFind = INVALID_HANDLE_VALUE;
+    statvalid = false;
+
+#ifdef USE_BULK_DIRINFO
+    hDirectory = INVALID_HANDLE_VALUE;
+    dirinfobuf = NULL;
+    dirinfo = NULL;
+#endif
 }
 
 WinDirAccess::~WinDirAccess()
@@ -1098,5 +1256,14 @@ WinDirAccess::~WinDirAccess()
     {
         FindClose(hFind);
     }
+
+#ifdef USE_BULK_DIRINFO
+    if (hDirectory != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(hDirectory);
+    }
+
+    delete[] dirinfobuf;
+#endif
 }
 } // namespace
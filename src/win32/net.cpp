@@ -36,8 +36,12 @@ WinHttpIO::WinHttpIO()
     hWakeupEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
 
     waiter = NULL;
+    wakeupflags = 0;
     
     chunkedok = false;
+
+    // data is received asynchronously into space set aside by reserveput()
+    streamingok = false;
 }
 
 WinHttpIO::~WinHttpIO()
@@ -229,6 +233,11 @@ Proxy* WinHttpIO::getautoproxy()
 void WinHttpIO::httpevent()
 {
     SetEvent(hWakeupEvent);
+
+    if (waiter && waiter->backend == WinWaiter::BACKEND_IOCP)
+    {
+        waiter->post(wakeupflags);
+    }
 }
 
 // (WinHTTP unfortunately uses threads, hence the need for a mutex)
@@ -251,7 +260,22 @@ void WinHttpIO::addevents(Waiter* cwaiter, int flags)
     // (we are on Vista or greater)
     if (pGTC) chunkedok = true;
 
-    waiter->addhandle(hWakeupEvent, flags);
+    if (waiter->backend == WinWaiter::BACKEND_IOCP)
+    {
+        // events are posted by httpevent() - only catch up with a wakeup
+        // that happened before the port was in use
+        wakeupflags = flags;
+
+        if (WaitForSingleObject(hWakeupEvent, 0) == WAIT_OBJECT_0)
+        {
+            waiter->post(flags);
+        }
+    }
+    else
+    {
+        waiter->addhandle(hWakeupEvent, flags);
+    }
+
     waiter->pcsHTTP = &csHTTP;
 }
 
@@ -323,6 +347,11 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                 if (req->status == REQ_SUCCESS)
                 {
                     httpio->lastdata = Waiter::ds;
+
+                    if (httpctx->gzip && req->bufpos > (m_off_t)httpctx->z.total_in)
+                    {
+                        httpio->compressionsavedin += req->bufpos - httpctx->z.total_in;
+                    }
                 }
                 httpio->success = true;
             }
@@ -450,7 +479,7 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                                                 &contentEncoding,
                                                 &contentEncodingSize,
                                                 WINHTTP_NO_HEADER_INDEX)
-                                    && !wcscmp(contentEncoding, L"gzip");
+                                    && (!wcscmp(contentEncoding, L"gzip") || !wcscmp(contentEncoding, L"deflate"));
 
                         if (httpctx->gzip)
                         {
@@ -462,7 +491,8 @@ VOID CALLBACK WinHttpIO::asynccallback(HINTERNET hInternet, DWORD_PTR dwContext,
                             httpctx->z.avail_in = 0;
                             httpctx->z.next_in = Z_NULL;
 
-                            inflateInit2(&httpctx->z, MAX_WBITS+16);
+                            // +32: detect the gzip or zlib wrapper
+                            inflateInit2(&httpctx->z, MAX_WBITS+32);
 
                             req->in.resize(contentLength);
                             httpctx->z.avail_out = contentLength;
@@ -602,6 +632,10 @@ void WinHttpIO::post(HttpReq* req, const char* data, unsigned len)
     {
         LOG_debug << "[sending " << (data ? len : req->out->size()) << " bytes of raw data]";
     }
+    else if (req->gzipped)
+    {
+        LOG_debug << "[sending " << req->out->size() << " bytes of compressed data]";
+    }
     else
     {
         LOG_debug << "Sending: " << *req->out;
@@ -666,7 +700,9 @@ void WinHttpIO::post(HttpReq* req, const char* data, unsigned len)
                                          0);
 
                 LPCWSTR pwszHeaders = req->type == REQ_JSON || !req->buf
-                                    ? L"Content-Type: application/json\r\nAccept-Encoding: gzip"
+                                    ? (req->gzipped
+                                       ? L"Content-Type: application/json\r\nAccept-Encoding: gzip, deflate\r\nContent-Encoding: gzip"
+                                       : L"Content-Type: application/json\r\nAccept-Encoding: gzip, deflate")
                                     : L"Content-Type: application/octet-stream";
 
                 // data is sent in HTTP_POST_CHUNK_SIZE instalments to ensure
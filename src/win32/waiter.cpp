@@ -26,9 +26,12 @@ namespace mega {
 dstime Waiter::ds;
 
 PGTC pGTC;
+static PGQCSEX pGQCSEx;
 static ULONGLONG tickhigh;
 static DWORD prevt;
 
+int WinWaiter::defaultbackend = WinWaiter::BACKEND_EVENTS;
+
 WinWaiter::WinWaiter()
 {
     if (!pGTC) pGTC = (PGTC)GetProcAddress(GetModuleHandle(TEXT("kernel32.dll")), "GetTickCount64");
@@ -41,6 +44,37 @@ WinWaiter::WinWaiter()
 
     pcsHTTP = NULL;
     externalEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    iocp = NULL;
+    nexttarget = 1;
+    backend = BACKEND_EVENTS;
+
+    if (defaultbackend == BACKEND_IOCP)
+    {
+        if (!pGQCSEx)
+        {
+            pGQCSEx = (PGQCSEX)GetProcAddress(GetModuleHandle(TEXT("kernel32.dll")), "GetQueuedCompletionStatusEx");
+        }
+
+        if (pGQCSEx && (iocp = CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1)))
+        {
+            backend = BACKEND_IOCP;
+        }
+        else
+        {
+            LOG_warn << "I/O completion port not available, waiting for events";
+        }
+    }
+}
+
+WinWaiter::~WinWaiter()
+{
+    if (iocp)
+    {
+        CloseHandle(iocp);
+    }
+
+    CloseHandle(externalEvent);
 }
 
 // update monotonously increasing timestamp in deciseconds
@@ -74,6 +108,11 @@ void Waiter::bumpds()
 // network layer)
 int WinWaiter::wait()
 {
+    if (backend == BACKEND_IOCP)
+    {
+        return iocpwait();
+    }
+
     int r = 0;
 
     // only allow interaction of asynccallback() with the main process while
@@ -118,6 +157,141 @@ bool WinWaiter::addhandle(HANDLE handle, int flag)
 
 void WinWaiter::notify()
 {
-    SetEvent(externalEvent);
+    if (backend == BACKEND_IOCP)
+    {
+        post(NEEDEXEC);
+    }
+    else
+    {
+        SetEvent(externalEvent);
+    }
+}
+
+void WinWaiter::post(int flag)
+{
+    if (!iocp || !PostQueuedCompletionStatus(iocp, (DWORD)flag, 0, NULL))
+    {
+        SetEvent(externalEvent);
+    }
+}
+
+VOID CALLBACK WinWaiter::handlesignaled(PVOID param, BOOLEAN)
+{
+    HandleWait* hw = (HandleWait*)param;
+
+    PostQueuedCompletionStatus(hw->waiter->iocp, (DWORD)hw->flag, 0, NULL);
+}
+
+ULONG_PTR WinWaiter::associate(HANDLE handle, WinIOCompletion* target)
+{
+    if (backend != BACKEND_IOCP)
+    {
+        return 0;
+    }
+
+    ULONG_PTR key = nexttarget++;
+
+    if (CreateIoCompletionPort(handle, iocp, key, 0) != iocp)
+    {
+        LOG_warn << "Unable to associate handle with the completion port: " << GetLastError();
+        return 0;
+    }
+
+    targets[key] = target;
+
+    return key;
+}
+
+void WinWaiter::dissociate(ULONG_PTR key)
+{
+    targets.erase(key);
+}
+
+// wait for packets on the completion port: wakeups (key 0, the flags in
+// the byte count) and completions of associated handles - late completions
+// of dissociated handles (e.g. aborted reads of closed handles) are dropped
+// without touching their OVERLAPPED
+int WinWaiter::iocpwait()
+{
+    int r = 0;
+    DWORD timeout = maxds * 100;
+
+    handlewaits.resize(handles.size());
+
+    for (unsigned i = 0; i < handles.size(); i++)
+    {
+        handlewaits[i].waiter = this;
+        handlewaits[i].flag = flags[i];
+
+        if (!RegisterWaitForSingleObject(&handlewaits[i].wait, handles[i], handlesignaled,
+                                         &handlewaits[i], INFINITE, WT_EXECUTEONLYONCE | WT_EXECUTEINWAITTHREAD))
+        {
+            handlewaits[i].wait = NULL;
+            r |= flags[i];
+            timeout = 0;
+        }
+    }
+
+    // the external event may still have been signaled by a post() that failed
+    if (WaitForSingleObject(externalEvent, 0) == WAIT_OBJECT_0)
+    {
+        r |= NEEDEXEC;
+        timeout = 0;
+    }
+
+    if (pcsHTTP)
+    {
+        LeaveCriticalSection(pcsHTTP);
+    }
+
+    WinOverlappedEntry entries[MAXENTRIES];
+    ULONG numentries = 0;
+
+    // alertable: completion routines of other overlapped I/O still run
+    BOOL dequeued = pGQCSEx(iocp, entries, MAXENTRIES, &numentries, timeout, TRUE);
+
+    // returns after running callbacks have finished
+    for (unsigned i = 0; i < handlewaits.size(); i++)
+    {
+        if (handlewaits[i].wait)
+        {
+            UnregisterWaitEx(handlewaits[i].wait, INVALID_HANDLE_VALUE);
+        }
+    }
+
+    if (pcsHTTP)
+    {
+        EnterCriticalSection(pcsHTTP);
+    }
+
+    if (!dequeued)
+    {
+        // timeout or completion routine
+        r |= NEEDEXEC;
+        numentries = 0;
+    }
+
+    for (ULONG i = 0; i < numentries; i++)
+    {
+        if (!entries[i].lpCompletionKey)
+        {
+            r |= (int)entries[i].dwNumberOfBytesTransferred;
+        }
+        else
+        {
+            map<ULONG_PTR, WinIOCompletion*>::iterator it = targets.find(entries[i].lpCompletionKey);
+
+            if (it != targets.end())
+            {
+                it->second->completed(entries[i].dwNumberOfBytesTransferred);
+                r |= NEEDEXEC;
+            }
+        }
+    }
+
+    handles.clear();
+    flags.clear();
+
+    return r;
 }
 } // namespace
@@ -0,0 +1,111 @@
+/**
+ * @file tests/bench_command.cpp
+ * @brief Micro-benchmark of building large API commands
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_command [milliseconds per measurement] [nodes]
+//
+// Prints one CSV record per command:
+// command,nodes,bytes,iterations,us_per_command
+// (the client is never logged in and nothing is sent)
+
+#include "mega.h"
+#include <chrono>
+#include <functional>
+
+using namespace mega;
+using namespace std;
+
+static double mintime = 0.5;
+
+// runs fn until mintime has elapsed (after one warm-up call), fn returns the
+// size of the built command
+static void bench(const char* command, unsigned nodes, const function<size_t()>& fn)
+{
+    size_t bytes = fn();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double elapsed;
+    uint64_t iterations = 0;
+
+    do {
+        fn();
+        iterations++;
+
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < mintime);
+
+    printf("%s,%u,%u,%llu,%.1f\n", command, nodes, (unsigned)bytes,
+           (unsigned long long)iterations, elapsed * 1e6 / iterations);
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned numnodes = MegaClient::MAX_NEWNODES;
+
+    if (argc > 1)
+    {
+        mintime = atoi(argv[1]) / 1000.0;
+    }
+
+    if (argc > 2)
+    {
+        numnodes = atoi(argv[2]);
+    }
+
+    MegaClient client(new MegaApp, new WAIT_CLASS, new HTTPIO_CLASS, new FSACCESS_CLASS,
+                      NULL, NULL, "bench", "bench_command");
+
+    // new folders and uploads with typical attribute sizes (a name and a
+    // fingerprint)
+    NewNode* nn = new NewNode[numnodes];
+    byte buf[FILENODEKEYLENGTH];
+
+    for (unsigned i = 0; i < numnodes; i++)
+    {
+        PrnGen::genblock(buf, sizeof buf);
+
+        nn[i].source = (i & 1) ? NEW_UPLOAD : NEW_NODE;
+        nn[i].type = (i & 1) ? FILENODE : FOLDERNODE;
+        nn[i].nodehandle = i;
+        nn[i].parenthandle = UNDEF;
+        nn[i].nodekey.assign((char*)buf, (i & 1) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH);
+        nn[i].attrstring = new string(112, 0);
+        PrnGen::genblock((byte*)nn[i].attrstring->data(), (int)nn[i].attrstring->size());
+
+        if (i & 1)
+        {
+            PrnGen::genblock(nn[i].uploadtoken, sizeof nn[i].uploadtoken);
+            nn[i].uploadhandle = i;
+        }
+    }
+
+    printf("command,nodes,bytes,iterations,us_per_command\n");
+
+    bench("putnodes", numnodes, [&]() {
+        CommandPutNodes c(&client, UNDEF, NULL, nn, numnodes, 0, PUTNODES_APP);
+        return strlen(c.getstring());
+    });
+
+    // the putnodes command does not own the nodes
+    delete[] nn;
+
+    return 0;
+}
@@ -0,0 +1,207 @@
+/**
+ * @file tests/bench_crypto.cpp
+ * @brief Micro-benchmarks of the crypto and hashing hot paths
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_crypto [milliseconds per measurement] [filter]
+//
+// Prints one CSV record per primitive and buffer size:
+// backend,primitive,bytes,iterations,ns_per_op,mb_per_s
+// (mb_per_s is 0 for primitives without a meaningful byte count)
+
+#include "mega.h"
+#include <chrono>
+#include <functional>
+
+using namespace mega;
+using namespace std;
+
+static double mintime = 0.5;
+static const char* filter = NULL;
+
+#ifdef USE_OPENSSL_CRYPTO
+static const char* backend = "openssl";
+#else
+static const char* backend = "cryptopp";
+#endif
+
+// runs fn until mintime has elapsed (after one warm-up call) and reports
+// the average per call
+static void bench(const char* primitive, size_t bytes, const function<void()>& fn)
+{
+    if (filter && !strstr(primitive, filter))
+    {
+        return;
+    }
+
+    fn();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double elapsed;
+    uint64_t iterations = 0;
+    uint64_t batch = 1;
+
+    do {
+        for (uint64_t i = 0; i < batch; i++)
+        {
+            fn();
+        }
+
+        iterations += batch;
+
+        if (batch < 65536)
+        {
+            batch *= 2;
+        }
+
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < mintime);
+
+    double ns = elapsed * 1e9 / iterations;
+
+    printf("%s,%s,%u,%llu,%.1f,%.1f\n", backend, primitive, (unsigned)bytes,
+           (unsigned long long)iterations, ns, bytes ? bytes * iterations / elapsed / 1e6 : 0.0);
+    fflush(stdout);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        mintime = atoi(argv[1]) / 1000.0;
+    }
+
+    if (argc > 2)
+    {
+        filter = argv[2];
+    }
+
+    static const unsigned sizes[] = { 16, 256, 4096, 65536, 1048576 };
+    const unsigned numsizes = sizeof sizes / sizeof *sizes;
+
+    byte keydata[SymmCipher::KEYLENGTH];
+    PrnGen::genblock(keydata, sizeof keydata);
+
+    SymmCipher key(keydata);
+    string buf(sizes[numsizes - 1] + SymmCipher::BLOCKSIZE, 0);
+    PrnGen::genblock((byte*)buf.data(), (int)buf.size());
+    byte* data = (byte*)buf.data();
+    byte mac[SymmCipher::BLOCKSIZE];
+
+    printf("backend,primitive,bytes,iterations,ns_per_op,mb_per_s\n");
+
+    for (unsigned i = 0; i < numsizes; i++)
+    {
+        unsigned size = sizes[i];
+
+        bench("ecb_encrypt", size, [&]() { key.ecb_encrypt(data, NULL, size); });
+        bench("ctr_crypt", size, [&]() { key.ctr_crypt(data, size, 0, 0, NULL, true); });
+        bench("ctr_crypt_mac", size, [&]() { key.ctr_crypt(data, size, 0, 0, mac, true); });
+        bench("ctr_decrypt_mac", size, [&]() { key.ctr_crypt(data, size, 0, 0, mac, false); });
+        bench("cbc_decrypt", size, [&]() { key.cbc_decrypt(data, size); });
+
+        bench("sha256", size, [&]() {
+            HashSHA256 h;
+            string digest;
+            h.add(data, size);
+            h.get(&digest);
+        });
+
+        bench("crc32", size, [&]() {
+            HashCRC32 h;
+            h.add(data, size);
+            h.get(mac);
+        });
+    }
+
+    // 1 MB hashed incrementally in 4 KB pieces, as when fingerprinting a
+    // file, labelled with the CRC32 implementation in use
+    bench(HashCRC32::hwsupported() ? "crc32_stream_hw" : "crc32_stream_sw", 1048576, [&]() {
+        HashCRC32 h;
+
+        for (unsigned j = 0; j < 256; j++)
+        {
+            h.add(data + j * 4096, 4096);
+        }
+
+        h.get(mac);
+    });
+
+    // node attributes: a fresh node key and a short CBC decryption per node
+    const unsigned attrsizes[] = { 64, 256 };
+    byte nodekey[FILENODEKEYLENGTH];
+    PrnGen::genblock(nodekey, sizeof nodekey);
+
+    for (unsigned i = 0; i < sizeof attrsizes / sizeof *attrsizes; i++)
+    {
+        unsigned size = attrsizes[i];
+
+        bench("attr_decrypt", size, [&]() {
+            SymmCipher attrkey;
+            attrkey.setkey(nodekey, FILENODE);
+            attrkey.cbc_decrypt(data, size);
+        });
+    }
+
+    // meta MAC over the chunk MACs of 1 MB, 64 MB and 1 GB files, the same
+    // computation as TransferSlot::macsmac()
+    chunkmac_map macs;
+    const unsigned chunks[] = { 8, 71, 1031 };
+
+    for (unsigned i = 0; i < sizeof chunks / sizeof *chunks; i++)
+    {
+        macs.clear();
+
+        for (unsigned j = 0; j < chunks[i]; j++)
+        {
+            memcpy(macs[j * 1048576].mac, data + j % 4096 * SymmCipher::BLOCKSIZE, SymmCipher::BLOCKSIZE);
+        }
+
+        bench("macsmac", chunks[i] * SymmCipher::BLOCKSIZE, [&]() {
+            byte m[SymmCipher::BLOCKSIZE] = { 0 };
+
+            for (chunkmac_map::iterator it = macs.begin(); it != macs.end(); it++)
+            {
+                SymmCipher::xorblock(it->second.mac, m);
+                key.ecb_encrypt(m);
+            }
+        });
+    }
+
+    bench("pw_key", 0, [&]() { MegaClient::pw_key("correct horse battery staple", mac); });
+
+    // RSA-2048 (as in account keys): share and node key decryption
+    AsymmCipher rsa, rsapub;
+    CryptoPP::Integer pubk[AsymmCipher::PUBKEY];
+    byte ciphertext[AsymmCipher::MAXKEYLENGTH];
+    byte plain[SymmCipher::KEYLENGTH];
+
+    if (!filter || strstr("rsa_decrypt", filter))
+    {
+        rsa.genkeypair(rsa.key, pubk, 2048);
+        rsapub.key[AsymmCipher::PUB_PQ] = pubk[AsymmCipher::PUB_PQ];
+        rsapub.key[AsymmCipher::PUB_E] = pubk[AsymmCipher::PUB_E];
+
+        int len = rsapub.encrypt(keydata, sizeof keydata, ciphertext, sizeof ciphertext);
+
+        bench("rsa_decrypt", 0, [&]() { rsa.decrypt(ciphertext, len, plain, sizeof plain); });
+    }
+
+    return 0;
+}
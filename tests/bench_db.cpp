@@ -0,0 +1,420 @@
+/**
+ * @file tests/bench_db.cpp
+ * @brief Benchmark of the configured DB access layer on statecache-like tables
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_db [records] [record bytes] [directory]
+//
+// Prints one CSV record per pass:
+// backend,pass,records,record_bytes,ops,ops_per_s,p50_us,p90_us,p99_us,max_us,disk_bytes
+//
+// Latencies are per operation, except for update_burst, where an operation
+// is one transaction of BURST updates. disk_bytes is the size of the
+// table's files after the pass.
+//
+// The backend is the one selected at configure time (--with-sqlite,
+// --with-db or --with-lmdb) - build once per backend to compare them. The
+// table is created in the given directory (default: the current one) and
+// removed at the end.
+
+#include "mega.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace mega;
+using namespace std;
+
+#if defined(USE_LMDB)
+static const char* backend = "lmdb";
+#elif defined(USE_BDB)
+static const char* backend = "bdb";
+#else
+static const char* backend = "sqlite";
+#endif
+
+static unsigned numrecords = 100000;
+static unsigned recordsize = 256;
+
+// updates per update_burst transaction, operations per mixed transaction
+// and share of writes among them
+static const unsigned BURST = 100;
+static const unsigned MIXEDWRITES = 5;
+
+static FileSystemAccess* fsaccess;
+static string dir;
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// total size of the files the backend created for the table (their names
+// contain the table name, whatever the layer's naming scheme)
+static m_off_t disksize()
+{
+    string pattern = dir + "*bench_db*";
+    string localpattern, name;
+    nodetype_t type;
+    m_off_t total = 0;
+
+    fsaccess->path2local(&pattern, &localpattern);
+
+    DirAccess* da = fsaccess->newdiraccess();
+
+    if (da->dopen(&localpattern, NULL, true))
+    {
+        while (da->dnext(&localpattern, &name, true, &type))
+        {
+            FileAccess* fa = fsaccess->newfileaccess();
+
+            if (type == FILENODE && fa->fopen(&name, true, false))
+            {
+                total += fa->size;
+            }
+
+            delete fa;
+        }
+    }
+
+    delete da;
+
+    return total;
+}
+
+static double percentile(vector<double>* latencies, double p)
+{
+    if (!latencies->size())
+    {
+        return 0;
+    }
+
+    size_t i = (size_t)(p * (latencies->size() - 1));
+
+    nth_element(latencies->begin(), latencies->begin() + i, latencies->end());
+
+    return (*latencies)[i] * 1e6;
+}
+
+static void report(const char* pass, vector<double>* latencies, double start)
+{
+    double elapsed = now() - start;
+    unsigned ops = (unsigned)latencies->size();
+    double maxlatency = ops ? *max_element(latencies->begin(), latencies->end()) * 1e6 : 0;
+
+    printf("%s,%s,%u,%u,%u,%.0f,%.2f,%.2f,%.2f,%.2f,%lld\n", backend, pass, numrecords, recordsize, ops,
+           elapsed > 0 ? ops / elapsed : 0.0,
+           percentile(latencies, 0.5), percentile(latencies, 0.9), percentile(latencies, 0.99), maxlatency,
+           (long long)disksize());
+    fflush(stdout);
+
+    latencies->clear();
+}
+
+// ids as assigned by DbTable (IDSPACING apart, with the record type in the
+// low bits)
+static uint32_t id(unsigned i)
+{
+    return (i + 1) << 4 | MegaClient::CACHEDNODE;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        numrecords = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        recordsize = atoi(argv[2]);
+    }
+
+    if (argc > 3)
+    {
+        dir = argv[3];
+
+        if (dir.size() && dir[dir.size() - 1] != '/')
+        {
+            dir.append("/");
+        }
+    }
+
+    if (!numrecords || !recordsize)
+    {
+        fprintf(stderr, "Usage: %s [records] [record bytes] [directory]\n", argv[0]);
+        return 1;
+    }
+
+    FSACCESS_CLASS fsa;
+    DBACCESS_CLASS dbaccess(&dir);
+    string name = "bench_db";
+
+    fsaccess = &fsa;
+
+    DbTable* table = dbaccess.open(fsaccess, &name);
+
+    if (!table)
+    {
+        fprintf(stderr, "Unable to open a table in %s\n", dir.size() ? dir.c_str() : ".");
+        return 1;
+    }
+
+    table->begin();
+    table->truncate();
+    table->commit();
+
+    // incompressible records (as encrypted ones are) with the lookup
+    // columns of file nodes in folders of ten
+    byte keydata[SymmCipher::KEYLENGTH];
+    PrnGen::genblock(keydata, sizeof keydata);
+    SymmCipher key(keydata);
+
+    string data(recordsize + numrecords, 0);
+    PrnGen::genblock((byte*)data.data(), (int)data.size());
+
+    vector<string> records(DbTable::PUTBATCH);
+    vector<DbIndex> columns(numrecords);
+    vector<uint32_t> ids(numrecords);
+    vector<double> latencies;
+
+    latencies.reserve(numrecords);
+
+    for (unsigned i = 0; i < numrecords; i++)
+    {
+        ids[i] = id(i);
+        table->indexvalue((handle)i, &key, &columns[i].nodehandle);
+        table->indexvalue((handle)(i / 10), &key, &columns[i].parenthandle);
+        columns[i].type = FILENODE;
+        columns[i].set = true;
+    }
+
+    printf("backend,pass,records,record_bytes,ops,ops_per_s,p50_us,p90_us,p99_us,max_us,disk_bytes\n");
+
+    // bulk load in a single transaction (the commit is part of the last
+    // operation)
+    double start = now();
+    double t;
+
+    table->begin();
+
+    for (unsigned i = 0; i < numrecords; i++)
+    {
+        t = now();
+        table->put(ids[i], (char*)data.data() + i, recordsize, &columns[i]);
+
+        if (i == numrecords - 1)
+        {
+            table->commit();
+        }
+
+        latencies.push_back(now() - t);
+    }
+
+    report("put", &latencies, start);
+
+    // the same records again, through putbatch() as DbTable::flushbatch()
+    // writes them - one operation per batch
+    start = now();
+
+    table->begin();
+
+    for (unsigned i = 0; i < numrecords; i += DbTable::PUTBATCH)
+    {
+        unsigned count = numrecords - i < DbTable::PUTBATCH ? numrecords - i : DbTable::PUTBATCH;
+
+        for (unsigned j = 0; j < count; j++)
+        {
+            records[j].assign(data, i + j, recordsize);
+        }
+
+        t = now();
+        table->putbatch(count, &ids[i], &records[0], &columns[i]);
+        latencies.push_back(now() - t);
+    }
+
+    table->commit();
+    report("putbatch", &latencies, start);
+
+    vector<unsigned> order(numrecords);
+
+    for (unsigned i = 0; i < numrecords; i++)
+    {
+        order[i] = i;
+    }
+
+    random_shuffle(order.begin(), order.end());
+
+    string record;
+    unsigned found = 0;
+
+    start = now();
+
+    for (unsigned i = 0; i < numrecords; i++)
+    {
+        t = now();
+        found += table->get(ids[order[i]], &record);
+        latencies.push_back(now() - t);
+    }
+
+    report("get", &latencies, start);
+
+    uint32_t index;
+    unsigned scanned = 0;
+
+    start = now();
+
+    table->rewind();
+
+    for (;;)
+    {
+        t = now();
+
+        if (!table->next(&index, &record))
+        {
+            break;
+        }
+
+        latencies.push_back(now() - t);
+        scanned++;
+    }
+
+    report("scan", &latencies, start);
+
+    vector<uint32_t> matches;
+    unsigned folders = (numrecords + 9) / 10;
+
+    start = now();
+
+    for (unsigned i = 0; i < folders; i++)
+    {
+        matches.clear();
+
+        t = now();
+        table->lookup(DbTable::COLUMN_PARENTHANDLE, &columns[order[i] / 10 * 10].parenthandle, &matches);
+        latencies.push_back(now() - t);
+    }
+
+    report("lookup_parent", &latencies, start);
+
+    // bursts of random updates, one transaction each, as the client
+    // commits a batch of action packets
+    unsigned updates = min(numrecords, 100 * BURST);
+
+    start = now();
+
+    for (unsigned i = 0; i < updates; i += BURST)
+    {
+        t = now();
+
+        table->begin();
+
+        for (unsigned j = i; j < i + BURST && j < updates; j++)
+        {
+            table->put(ids[order[j]], (char*)data.data() + order[j] + 1, recordsize, &columns[order[j]]);
+        }
+
+        table->commit();
+
+        latencies.push_back(now() - t);
+    }
+
+    report("update_burst", &latencies, start);
+
+    // single updates without an enclosing transaction, each one durable
+    updates = min(numrecords, 1000u);
+
+    start = now();
+
+    for (unsigned i = 0; i < updates; i++)
+    {
+        t = now();
+        table->put(ids[order[i]], (char*)data.data() + order[i], recordsize, &columns[order[i]]);
+        latencies.push_back(now() - t);
+    }
+
+    report("put_autocommit", &latencies, start);
+
+    // random reads with writes interleaved in the same transactions, as
+    // sync and on-demand node loading do while action packets are applied
+    unsigned mixed = min(numrecords, 100 * BURST);
+    unsigned mixedfound = 0, mixedreads = 0;
+
+    start = now();
+
+    for (unsigned i = 0; i < mixed; i++)
+    {
+        unsigned r = order[(i * 7919) % numrecords];
+
+        if (!(i % BURST))
+        {
+            table->begin();
+        }
+
+        t = now();
+
+        if (i % MIXEDWRITES)
+        {
+            mixedfound += table->get(ids[r], &record);
+            mixedreads++;
+        }
+        else
+        {
+            table->put(ids[r], (char*)data.data() + r, recordsize, &columns[r]);
+        }
+
+        if (i % BURST == BURST - 1 || i == mixed - 1)
+        {
+            table->commit();
+        }
+
+        latencies.push_back(now() - t);
+    }
+
+    report("mixed", &latencies, start);
+
+    start = now();
+
+    table->begin();
+
+    for (unsigned i = 0; i < numrecords; i++)
+    {
+        t = now();
+        table->del(ids[order[i]]);
+
+        if (i == numrecords - 1)
+        {
+            table->commit();
+        }
+
+        latencies.push_back(now() - t);
+    }
+
+    report("del", &latencies, start);
+
+    if (found != numrecords || scanned != numrecords || mixedfound != mixedreads)
+    {
+        fprintf(stderr, "Inconsistent table: %u of %u records found, %u scanned, %u of %u found while writing\n",
+                found, numrecords, scanned, mixedfound, mixedreads);
+    }
+
+    table->remove();
+    delete table;
+
+    return found == numrecords && scanned == numrecords && mixedfound == mixedreads ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file tests/bench_gfx.cpp
+ * @brief Benchmark of thumbnail and preview generation
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_gfx [iterations] image...
+//
+// Prints one CSV record per image and file attribute type:
+// file,type,bytes,iterations,ms_per_image,peak_kb
+//
+// Each measurement runs in a child process of its own, so that peak_kb
+// (the child's peak resident set size, including what it shares with the
+// parent) is not carried over from earlier measurements.
+// The graphics processor is the one selected at configure time
+// (--with-freeimage); the generated JPEGs are written to bench_gfx.jpg in
+// the current directory, which is removed at the end.
+
+#include "mega.h"
+#include <chrono>
+#include <sys/resource.h>
+#include <sys/wait.h>
+
+using namespace mega;
+using namespace std;
+
+static const char* types[] = { "thumbnail", "preview" };
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// runs in the child: generate the attribute iterations times and write the
+// seconds per image and the JPEG size to fd
+static void measure(GfxProc* gfx, string* localpath, GfxProc::meta_t type, unsigned iterations, int fd)
+{
+    string dst = "bench_gfx.jpg";
+    string localdst;
+    double result[2] = { -1, 0 };
+
+    gfx->client->fsaccess->path2local(&dst, &localdst);
+
+    double start = now();
+
+    for (unsigned i = 0; i < iterations; i++)
+    {
+        if (!gfx->savefa(localpath, type, &localdst))
+        {
+            iterations = 0;
+            break;
+        }
+    }
+
+    if (iterations)
+    {
+        result[0] = (now() - start) / iterations;
+
+        FileAccess* fa = gfx->client->fsaccess->newfileaccess();
+
+        if (fa->fopen(&localdst, true, false))
+        {
+            result[1] = (double)fa->size;
+        }
+
+        delete fa;
+    }
+
+    gfx->client->fsaccess->unlinklocal(&localdst);
+
+    if (write(fd, result, sizeof result) != sizeof result)
+    {
+        _exit(1);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned iterations = 5;
+    int first = 1;
+
+    if (argc > 1 && atoi(argv[1]) > 0)
+    {
+        iterations = atoi(argv[1]);
+        first = 2;
+    }
+
+    if (first >= argc)
+    {
+        fprintf(stderr, "Usage: %s [iterations] image...\n", argv[0]);
+        return 1;
+    }
+
+#ifdef GFX_CLASS
+    GfxProc* gfx = new GFX_CLASS;
+#else
+    GfxProc* gfx = NULL;
+#endif
+
+    if (!gfx)
+    {
+        fprintf(stderr, "No graphics processor configured\n");
+        return 1;
+    }
+
+    MegaClient client(new MegaApp, new WAIT_CLASS, new HTTPIO_CLASS, new FSACCESS_CLASS,
+                      NULL, gfx, "bench", "bench_gfx");
+
+    printf("file,type,bytes,iterations,ms_per_image,peak_kb\n");
+
+    for (int i = first; i < argc; i++)
+    {
+        string path = argv[i];
+        string localpath;
+
+        client.fsaccess->path2local(&path, &localpath);
+
+        for (int type = GfxProc::THUMBNAIL120X120; type <= GfxProc::PREVIEW1000x1000; type++)
+        {
+            int fds[2];
+
+            if (pipe(fds))
+            {
+                perror("pipe");
+                return 1;
+            }
+
+            fflush(stdout);
+
+            pid_t pid = fork();
+
+            if (!pid)
+            {
+                close(fds[0]);
+                measure(gfx, &localpath, (GfxProc::meta_t)type, iterations, fds[1]);
+                _exit(0);
+            }
+
+            close(fds[1]);
+
+            double result[2] = { -1, 0 };
+            struct rusage usage;
+            int status;
+
+            if (read(fds[0], result, sizeof result) != sizeof result)
+            {
+                result[0] = -1;
+            }
+
+            close(fds[0]);
+
+            if (pid < 0 || wait4(pid, &status, 0, &usage) != pid)
+            {
+                perror("fork");
+                return 1;
+            }
+
+            if (result[0] < 0)
+            {
+                printf("%s,%s,0,0,,\n", argv[i], types[type]);
+            }
+            else
+            {
+                // (ru_maxrss is in bytes on macOS)
+#ifdef __APPLE__
+                long peak = usage.ru_maxrss / 1024;
+#else
+                long peak = usage.ru_maxrss;
+#endif
+                printf("%s,%s,%.0f,%u,%.2f,%ld\n", argv[i], types[type], result[1], iterations,
+                       result[0] * 1e3, peak);
+            }
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,247 @@
+/**
+ * @file tests/bench_json.cpp
+ * @brief Micro-benchmark of JSON field dispatch on node and action packet payloads
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_json [milliseconds per measurement] [payload file]
+//
+// Prints one CSV record per payload and pass:
+// payload,pass,bytes,iterations,us_per_pass,mb_per_s
+//
+// Without a payload file, a synthetic fetchnodes "f" array and a synthetic
+// action packet "a" array are used. A recorded payload must be a JSON array
+// of nodes (the value of "f") or of action packets (the value of "a").
+
+#include "mega.h"
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <sstream>
+
+using namespace mega;
+using namespace std;
+
+static double mintime = 0.5;
+
+static void bench(const char* payload, const char* pass, size_t bytes, const function<void()>& fn)
+{
+    fn();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double elapsed;
+    uint64_t iterations = 0;
+
+    do {
+        fn();
+        iterations++;
+
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < mintime);
+
+    printf("%s,%s,%u,%llu,%.1f,%.1f\n", payload, pass, (unsigned)bytes, (unsigned long long)iterations,
+           elapsed * 1e6 / iterations, bytes * iterations / elapsed / 1e6);
+    fflush(stdout);
+}
+
+static string b64(size_t len)
+{
+    string bin(len, 0), s(len * 4 / 3 + 4, 0);
+
+    PrnGen::genblock((byte*)bin.data(), (int)len);
+    s.resize(Base64::btoa((const byte*)bin.data(), (int)len, (char*)s.data()));
+
+    return s;
+}
+
+static string node(int i)
+{
+    ostringstream o;
+
+    o << "{\"h\":\"" << b64(6) << "\",\"p\":\"" << b64(6) << "\",\"u\":\"" << b64(8)
+      << "\",\"t\":" << (i % 10 ? 0 : 1) << ",\"a\":\"" << b64(96) << "\",\"k\":\"" << b64(8)
+      << ":" << b64(i % 10 ? 32 : 16) << "\"";
+
+    if (i % 10)
+    {
+        o << ",\"s\":" << 1000 + i * 7919 << ",\"fa\":\"" << i % 900 << ":0*" << b64(8)
+          << "/" << i % 900 << ":1*" << b64(8) << "\"";
+    }
+
+    o << ",\"ts\":" << 1500000000 + i << "}";
+
+    return o.str();
+}
+
+// the fields and accessors of MegaClient::readnodes()
+static void readnodes(JSON* j)
+{
+    j->enterarray();
+
+    while (j->enterobject())
+    {
+        nameid name;
+
+        while ((name = j->getnameid()) != EOO)
+        {
+            switch (name)
+            {
+                case 'h':
+                case 'p':
+                    j->gethandle();
+                    break;
+
+                case 'u':
+                case MAKENAMEID2('s', 'u'):
+                    j->gethandle(MegaClient::USERHANDLE);
+                    break;
+
+                case 't':
+                case 's':
+                case 'i':
+                case 'r':
+                case MAKENAMEID2('t', 's'):
+                case MAKENAMEID3('s', 't', 's'):
+                    j->getint();
+                    break;
+
+                case 'a':
+                case 'k':
+                case MAKENAMEID2('f', 'a'):
+                case MAKENAMEID2('s', 'k'):
+                    j->getvalue();
+                    break;
+
+                default:
+                    j->storeobject();
+            }
+        }
+    }
+
+    j->leavearray();
+}
+
+// the dispatch of MegaClient::procsc(): the action name first, everything
+// else skipped
+static void procsc(JSON* j)
+{
+    j->enterarray();
+
+    while (j->enterobject())
+    {
+        nameid name;
+
+        while ((name = j->getnameid()) != EOO)
+        {
+            if (name == 'a')
+            {
+                j->getnameid(j->getvalue());
+            }
+            else
+            {
+                j->storeobject();
+            }
+        }
+    }
+
+    j->leavearray();
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 1)
+    {
+        mintime = atoi(argv[1]) / 1000.0;
+    }
+
+    string f, sc;
+
+    if (argc > 2)
+    {
+        ifstream in(argv[2], ios::binary);
+        ostringstream o;
+
+        o << in.rdbuf();
+        f = sc = o.str();
+    }
+    else
+    {
+        f = "[";
+        sc = "[";
+
+        for (int i = 0; i < 100000; i++)
+        {
+            f.append(i ? "," : "");
+            f.append(node(i));
+        }
+
+        for (int i = 0; i < 20000; i++)
+        {
+            sc.append(i ? "," : "");
+
+            switch (i % 4)
+            {
+                case 0:
+                    sc.append("{\"a\":\"t\",\"t\":{\"f\":[" + node(i) + "]},\"ou\":\"" + b64(8) + "\"}");
+                    break;
+
+                case 1:
+                    sc.append("{\"a\":\"u\",\"n\":\"" + b64(6) + "\",\"u\":\"" + b64(8) + "\",\"at\":\"" + b64(96) + "\",\"ts\":1500000000}");
+                    break;
+
+                case 2:
+                    sc.append("{\"a\":\"d\",\"n\":\"" + b64(6) + "\",\"ou\":\"" + b64(8) + "\"}");
+                    break;
+
+                default:
+                    sc.append("{\"a\":\"ua\",\"st\":\"" + b64(12) + "\",\"u\":\"" + b64(8) + "\",\"ua\":[\"+a\"],\"v\":[\"" + b64(6) + "\"]}");
+            }
+        }
+
+        f.append("]");
+        sc.append("]");
+    }
+
+    printf("payload,pass,bytes,iterations,us_per_pass,mb_per_s\n");
+
+    bench("f", "readnodes", f.size(), [&]() {
+        JSON j;
+        j.begin(f.c_str());
+        readnodes(&j);
+    });
+
+    bench("f", "skip", f.size(), [&]() {
+        JSON j;
+        j.begin(f.c_str());
+        j.storeobject();
+    });
+
+    bench("sc", "procsc", sc.size(), [&]() {
+        JSON j;
+        j.begin(sc.c_str());
+        procsc(&j);
+    });
+
+    bench("sc", "skip", sc.size(), [&]() {
+        JSON j;
+        j.begin(sc.c_str());
+        j.storeobject();
+    });
+
+    return 0;
+}
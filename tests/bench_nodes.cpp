@@ -0,0 +1,538 @@
+/**
+ * @file tests/bench_nodes.cpp
+ * @brief Benchmark of node tree loading, lookups and traversals
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_nodes [nodes] [fan-out] [directory]
+//
+// Prints one CSV record per pass:
+// nodes,fanout,pass,operations,ms,us_per_op,allocs,alloc_mb
+//
+// A synthetic account of the given size is generated offline: a fetchnodes
+// "f" array with valid keys and attributes, in which every folder has up to
+// fan-out children and every tenth child is a folder (fan-out 1 yields a
+// single deep chain). The nodes are loaded through readnodes(), decrypted,
+// looked up, listed, searched and, if a DB access layer was configured,
+// written to and read back from a state cache table in the given directory.
+// allocs and alloc_mb count the heap allocations made during each pass.
+// With a library configured with --enable-alloc-tags, the heap in use by
+// subsystem with the whole tree loaded is also written to stderr.
+
+#include "mega.h"
+#include <chrono>
+#include <new>
+
+using namespace mega;
+using namespace std;
+
+#ifdef ENABLE_ALLOC_TAGS
+// the library counts the allocations (by subsystem, see subsystems())
+static uint64_t allocs, allocbytes;
+
+static void countallocs()
+{
+    allocs = allocbytes = 0;
+
+    for (int t = 0; t < AllocTags::NUMTAGS; t++)
+    {
+        AllocTags::Counters c;
+
+        AllocTags::get((AllocTags::tag_t)t, &c);
+        allocs += c.allocs;
+        allocbytes += c.bytes;
+    }
+}
+
+static void subsystems()
+{
+    fprintf(stderr, "subsystem,inuse_mb,allocs\n");
+
+    for (int t = 0; t < AllocTags::NUMTAGS; t++)
+    {
+        AllocTags::Counters c;
+
+        AllocTags::get((AllocTags::tag_t)t, &c);
+        fprintf(stderr, "%s,%.1f,%llu\n", AllocTags::name((AllocTags::tag_t)t), c.inuse / 1e6,
+                (unsigned long long)c.allocs);
+    }
+}
+#else
+// (not thread-safe - the passes run on the main thread only)
+static uint64_t allocs, allocbytes;
+
+static void countallocs() { }
+static void subsystems() { }
+
+void* operator new(size_t size)
+{
+    allocs++;
+    allocbytes += size;
+
+    void* p = malloc(size ? size : 1);
+
+    if (!p)
+    {
+        throw bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void* p) throw()
+{
+    free(p);
+}
+#endif
+
+static unsigned numnodes = 100000;
+static unsigned fanout = 100;
+
+static double start;
+static uint64_t startallocs, startallocbytes;
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void begin()
+{
+    countallocs();
+    startallocs = allocs;
+    startallocbytes = allocbytes;
+    start = now();
+}
+
+static void end(const char* pass, size_t operations)
+{
+    double elapsed = now() - start;
+
+    countallocs();
+    printf("%u,%u,%s,%u,%.1f,%.3f,%llu,%.1f\n", numnodes, fanout, pass, (unsigned)operations, elapsed * 1e3,
+           operations ? elapsed * 1e6 / operations : 0, (unsigned long long)(allocs - startallocs),
+           (allocbytes - startallocbytes) / 1e6);
+    fflush(stdout);
+}
+
+static string b64(const byte* data, int len)
+{
+    string s(len * 4 / 3 + 4, 0);
+
+    s.resize(Base64::btoa(data, len, (char*)s.data()));
+
+    return s;
+}
+
+static string b64handle(handle h, int len)
+{
+    return b64((const byte*)&h, len);
+}
+
+// the node's key encrypted to the master key and its attributes encrypted
+// to the node's key, as the API returns them
+static void node(MegaClient* client, string* json, handle h, handle ph, nodetype_t type, unsigned i)
+{
+    char buf[64];
+    byte keydata[FILENODEKEYLENGTH];
+    int keylength = (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+    string nodekey, attrs, attrstring;
+    SymmCipher cipher;
+
+    PrnGen::genblock(keydata, keylength);
+    nodekey.assign((const char*)keydata, keylength);
+    cipher.setkey(&nodekey);
+
+    if (type == FILENODE)
+    {
+        FileFingerprint fp;
+
+        fp.size = 1000 + i * 7919ull % 100000000;
+        fp.mtime = 1500000000 + i;
+        PrnGen::genblock((byte*)fp.crc, sizeof fp.crc);
+        fp.isvalid = true;
+
+        string c;
+        fp.serializefingerprint(&c);
+
+        sprintf(buf, "\"n\":\"file%u.txt\",\"c\":\"", i);
+        attrs = buf + c + "\"";
+    }
+    else
+    {
+        sprintf(buf, "\"n\":\"folder%u\"", i);
+        attrs = buf;
+    }
+
+    client->makeattr(&cipher, &attrstring, attrs.c_str());
+    client->key.ecb_encrypt(keydata, keydata, keylength);
+
+    if (json->size() > 1)
+    {
+        json->append(",");
+    }
+
+    json->append("{\"h\":\"");
+    json->append(b64handle(h, MegaClient::NODEHANDLE));
+    json->append("\",\"p\":\"");
+    json->append(b64handle(ph, MegaClient::NODEHANDLE));
+    json->append("\",\"u\":\"");
+    json->append(b64handle(client->me, MegaClient::USERHANDLE));
+    sprintf(buf, "\",\"t\":%d,\"a\":\"", type);
+    json->append(buf);
+    json->append(b64((const byte*)attrstring.data(), (int)attrstring.size()));
+    json->append("\",\"k\":\"");
+    json->append(b64handle(client->me, MegaClient::USERHANDLE));
+    json->append(":");
+    json->append(b64(keydata, keylength));
+    json->append("\"");
+
+    if (type == FILENODE)
+    {
+        sprintf(buf, ",\"s\":%llu", 1000 + i * 7919ull % 100000000);
+        json->append(buf);
+    }
+
+    sprintf(buf, ",\"ts\":%u}", 1500000000 + i);
+    json->append(buf);
+}
+
+static MegaClient* newclient(const byte* masterkey, handle me)
+{
+    MegaClient* client = new MegaClient(new MegaApp, new WAIT_CLASS, new HTTPIO_CLASS, new FSACCESS_CLASS,
+                                        NULL, NULL, "bench", "bench_nodes");
+
+    client->key.setkey(masterkey);
+    client->me = me;
+
+    return client;
+}
+
+static bool alphabetical(Node* i, Node* j)
+{
+    int cmp = strcasecmp(i->displayname(), j->displayname());
+
+    if (cmp)
+    {
+        return cmp < 0;
+    }
+
+    return i->nodehandle < j->nodehandle;
+}
+
+// depth-first with an explicit stack (deep chains would overflow the call
+// stack)
+static size_t search(Node* root, const char* pattern, node_vector* result)
+{
+    node_vector stack(1, root);
+    size_t visited = 0;
+
+    while (stack.size())
+    {
+        Node* n = stack.back();
+
+        stack.pop_back();
+        visited++;
+
+        if (strstr(n->displayname(), pattern))
+        {
+            result->push_back(n);
+        }
+
+        stack.insert(stack.end(), n->children.begin(), n->children.end());
+    }
+
+    return visited;
+}
+
+static void path(Node* n, node_vector* ancestors, string* result)
+{
+    ancestors->clear();
+    result->clear();
+
+    for (; n && n->parent; n = n->parent)
+    {
+        ancestors->push_back(n);
+    }
+
+    for (size_t i = ancestors->size(); i--; )
+    {
+        result->append("/");
+        result->append((*ancestors)[i]->displayname());
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    string dir;
+
+    if (argc > 1)
+    {
+        numnodes = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        fanout = atoi(argv[2]);
+    }
+
+    if (argc > 3)
+    {
+        dir = argv[3];
+
+        if (dir.size() && dir[dir.size() - 1] != '/')
+        {
+            dir.append("/");
+        }
+    }
+
+    if (!numnodes || !fanout)
+    {
+        fprintf(stderr, "Usage: %s [nodes] [fan-out] [directory]\n", argv[0]);
+        return 1;
+    }
+
+    byte masterkey[SymmCipher::KEYLENGTH];
+    PrnGen::genblock(masterkey, sizeof masterkey);
+
+    handle me = 0x0123456789abcdefull;
+    MegaClient* client = newclient(masterkey, me);
+
+    // breadth-first: the children of folders[p] are appended until it has
+    // fan-out of them, the first of every ten being a folder
+    string json = "[";
+    vector<handle> folders;
+    size_t p = 0;
+    unsigned numchildren = 0;
+    handle root = 1;
+
+    json.append("{\"h\":\"");
+    json.append(b64handle(root, MegaClient::NODEHANDLE));
+    json.append("\",\"t\":2,\"ts\":1500000000}");
+    folders.push_back(root);
+
+    for (unsigned i = 1; i < numnodes; i++)
+    {
+        if (numchildren == fanout)
+        {
+            p++;
+            numchildren = 0;
+        }
+
+        nodetype_t type = (numchildren % 10) ? FILENODE : FOLDERNODE;
+
+        node(client, &json, i + 1, folders[p], type, i);
+
+        if (type == FOLDERNODE)
+        {
+            folders.push_back(i + 1);
+        }
+
+        numchildren++;
+    }
+
+    json.append("]");
+
+    printf("nodes,fanout,pass,operations,ms,us_per_op,allocs,alloc_mb\n");
+
+    JSON j;
+    node_vector added;
+
+    added.reserve(numnodes);
+    j.begin(json.c_str());
+
+    begin();
+    client->readnodes(&j, 0, PUTNODES_APP, NULL, 0, 0, &added);
+    end("readnodes", added.size());
+
+    string().swap(json);
+
+    begin();
+    client->applykeys();
+    end("applykeys", added.size());
+
+    // random picks, drawn before the passes
+    size_t numpicks = min((size_t)numnodes, (size_t)1000000);
+    vector<Node*> picks(numpicks);
+    vector<Node*> files;
+
+    srand(1);
+
+    for (size_t i = 0; i < numpicks; i++)
+    {
+        picks[i] = added[((size_t)rand() * RAND_MAX + rand()) % added.size()];
+    }
+
+    for (size_t i = 0; i < numpicks; i++)
+    {
+        if (picks[i]->type == FILENODE)
+        {
+            files.push_back(picks[i]);
+        }
+    }
+
+    size_t found = 0;
+
+    begin();
+
+    for (size_t i = 0; i < numpicks; i++)
+    {
+        found += client->nodebyhandle(picks[i]->nodehandle) != NULL;
+    }
+
+    end("nodebyhandle", numpicks);
+
+    for (int pass = 0; pass < 2; pass++)
+    {
+        begin();
+
+        for (size_t i = 0; i < folders.size(); i++)
+        {
+            Node* n = client->nodebyhandle(folders[i]);
+
+            found += n->children.sorted(0, alphabetical)->size();
+        }
+
+        end(pass ? "children_cached" : "children_sorted", folders.size());
+    }
+
+    begin();
+
+    for (size_t i = 0; i < numpicks; i++)
+    {
+        Node* n = picks[i];
+
+        if (n->parent)
+        {
+            found += n->parent->children.childbyname(n->displayname()) == n;
+        }
+    }
+
+    end("childbyname", numpicks);
+
+    node_vector result;
+
+    begin();
+    size_t visited = search(client->nodebyhandle(root), "7", &result);
+    end("search", visited);
+
+    found += result.size();
+
+    string nodepath;
+    node_vector ancestors;
+
+    begin();
+
+    for (size_t i = 0; i < numpicks; i++)
+    {
+        path(picks[i], &ancestors, &nodepath);
+        found += nodepath.size();
+    }
+
+    end("nodepath", numpicks);
+
+    begin();
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        FileFingerprint fp = *files[i];
+
+        found += client->nodebyfingerprint(&fp) != NULL;
+    }
+
+    end("nodebyfingerprint", files.size());
+
+#ifdef DBACCESS_CLASS
+    DBACCESS_CLASS dbaccess(&dir);
+    string name = "bench_nodes";
+    DbTable* table = dbaccess.open(client->fsaccess, &name);
+
+    if (!table)
+    {
+        fprintf(stderr, "Unable to open a table in %s\n", dir.size() ? dir.c_str() : ".");
+        return 1;
+    }
+
+    table->begin();
+    table->truncate();
+
+    begin();
+
+    for (size_t i = 0; i < added.size(); i++)
+    {
+        table->putbatched(MegaClient::CACHEDNODE, added[i], &client->key);
+    }
+
+    table->flushbatch();
+    table->commit();
+    end("cachewrite", added.size());
+
+    // the node loop of fetchsc(): batched reads and decryption, then the
+    // parent linkage of nodes that arrived before their parents
+    MegaClient* cached = newclient(masterkey, me);
+    const unsigned batch = MegaClient::NODESTREAMBATCH;
+    vector<uint32_t> ids(batch);
+    vector<string> records(batch);
+    bool ok[MegaClient::NODESTREAMBATCH];
+    node_vector dp;
+    unsigned count;
+
+    begin();
+
+    table->rewind();
+
+    while ((count = table->nextbatch(batch, &ids[0], &records[0], ok, &cached->key, NULL)))
+    {
+        for (unsigned i = 0; i < count; i++)
+        {
+            Node* n;
+
+            if (ok[i] && (n = Node::unserialize(cached, &records[i], &dp)))
+            {
+                n->dbid = ids[i];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < dp.size(); i++)
+    {
+        Node* n;
+
+        if ((n = cached->nodebyhandle(dp[i]->parenthandle)))
+        {
+            dp[i]->setparent(n);
+        }
+    }
+
+    end("cacheread", cached->nodes.size());
+
+    delete cached;
+
+    table->remove();
+    delete table;
+#endif
+
+    subsystems();
+
+    begin();
+    delete client;
+    end("teardown", added.size());
+
+    // (keeps the lookups from being optimized away)
+    return found ? 0 : 1;
+}
@@ -0,0 +1,161 @@
+/**
+ * @file tests/bench_requests.cpp
+ * @brief Micro-benchmark of the bookkeeping of MegaApi requests
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_requests [milliseconds per measurement] [requests in flight]
+//
+// Prints one CSV record per stage of the lifecycle of a request:
+// stage,in_flight,iterations,ns_per_request
+//
+// create: a setNodeAttribute()-style request with its string parameters
+// map_std / map_hash: registering the request by tag, looking it up twice
+// per response (as the MegaApp callbacks do) and removing it, with the
+// given number of other requests in flight, in a map<int, ...> and in
+// MegaRequestMap
+// finish_copy / finish_handoff: queueing the finished request for the
+// callback thread as a copy, and handing it over instead
+
+#include "mega.h"
+#include "megaapi_impl.h"
+#include <chrono>
+#include <functional>
+
+using namespace mega;
+using namespace std;
+
+static double mintime = 0.5;
+
+static void bench(const char* stage, unsigned inflight, const function<void()>& fn)
+{
+    fn();
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    double elapsed;
+    uint64_t iterations = 0;
+
+    do {
+        fn();
+        iterations++;
+
+        elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    } while (elapsed < mintime);
+
+    printf("%s,%u,%llu,%.1f\n", stage, inflight, (unsigned long long)iterations, elapsed * 1e9 / iterations);
+    fflush(stdout);
+}
+
+static MegaRequestPrivate* newrequest(int tag)
+{
+    MegaRequestPrivate* request = new MegaRequestPrivate(MegaRequest::TYPE_SET_ATTR_NODE);
+
+    request->setTag(tag);
+    request->setNodeHandle(tag);
+    request->setName("bench_attribute");
+    request->setText("bench attribute value");
+
+    return request;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned inflight = 1000;
+
+    if (argc > 1)
+    {
+        mintime = atoi(argv[1]) / 1000.0;
+    }
+
+    if (argc > 2)
+    {
+        inflight = atoi(argv[2]);
+    }
+
+    printf("stage,in_flight,iterations,ns_per_request\n");
+
+    bench("create", 0, [] {
+        delete newrequest(1);
+    });
+
+    // a sliding window of requests: the oldest one finishes as the next one
+    // is sent
+    MegaRequestPrivate* request = newrequest(1);
+    map<int, MegaRequestPrivate*> stdmap;
+    MegaRequestMap hashmap;
+    int tag = 1;
+
+    for (unsigned i = 0; i < inflight; i++, tag++)
+    {
+        stdmap[tag] = request;
+        hashmap[tag] = request;
+    }
+
+    int oldest = 1;
+
+    bench("map_std", inflight, [&] {
+        stdmap[tag++] = request;
+
+        if (stdmap.find(oldest) != stdmap.end() && stdmap.at(oldest) != request)
+        {
+            abort();
+        }
+
+        stdmap.erase(oldest++);
+    });
+
+    tag = inflight + 1;
+    oldest = 1;
+
+    bench("map_hash", inflight, [&] {
+        hashmap[tag++] = request;
+
+        if (hashmap.find(oldest) != hashmap.end() && hashmap.at(oldest) != request)
+        {
+            abort();
+        }
+
+        hashmap.erase(oldest++);
+    });
+
+    delete request;
+
+    bench("finish_copy", 0, [] {
+        MegaRequestPrivate* request = newrequest(1);
+        MegaError* error = new MegaError(MegaError::API_OK);
+        MegaCallbackEvent* event = new MegaCallbackEvent(MegaCallbackEvent::REQUEST_FINISH);
+
+        event->request = request->copy();
+        event->error = error->copy();
+
+        delete event;
+        delete error;
+        delete request;
+    });
+
+    bench("finish_handoff", 0, [] {
+        MegaCallbackEvent* event = new MegaCallbackEvent(MegaCallbackEvent::REQUEST_FINISH);
+
+        event->request = newrequest(1);
+        event->error = new MegaError(MegaError::API_OK);
+
+        delete event;
+    });
+
+    return 0;
+}
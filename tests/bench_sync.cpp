@@ -0,0 +1,436 @@
+/**
+ * @file tests/bench_sync.cpp
+ * @brief Benchmark of the sync engine on an unchanged tree
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_sync [files] [files per folder] [directory] [idle seconds]
+//
+// Prints one CSV record per pass:
+// files,folders,pass,operations,seconds,cpu_seconds,us_per_op
+//
+// A local tree of small files (bench_sync/d<folder>/f<file>.dat in the given
+// directory) is written and a matching remote tree with the same
+// fingerprints is generated offline, so that syncing one to the other
+// transfers nothing and the sync engine's own cost is measured: the initial
+// scan, the processing of a filesystem notification for every file, forced
+// syncdown()/syncup() passes and the CPU spent while idle. MockHttpIO stands
+// in for the network. The local tree is removed at the end.
+
+#include "mega.h"
+#include "mockhttpio.h"
+#include <chrono>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace mega;
+using namespace std;
+
+static unsigned numfiles = 10000;
+static unsigned numfolders;
+
+static double cputime()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void report(const char* pass, m_off_t operations, double seconds, double cpu)
+{
+    printf("%u,%u,%s,%lld,%.3f,%.3f,%.2f\n", numfiles, numfolders, pass, (long long)operations, seconds, cpu,
+           operations ? seconds * 1e6 / operations : 0);
+    fflush(stdout);
+}
+
+#ifdef ENABLE_SYNC
+static string b64(const byte* data, int len)
+{
+    string s(len * 4 / 3 + 4, 0);
+
+    s.resize(Base64::btoa(data, len, (char*)s.data()));
+
+    return s;
+}
+
+static string b64handle(handle h, int len)
+{
+    return b64((const byte*)&h, len);
+}
+
+// the node as the API returns it in a fetchnodes "f" array (files carry the
+// fingerprint of their local counterpart)
+static void node(MegaClient* client, string* json, handle h, handle ph, nodetype_t type, const char* name,
+                 FileFingerprint* fp)
+{
+    char buf[64];
+    byte keydata[FILENODEKEYLENGTH];
+    int keylength = (type == FILENODE) ? FILENODEKEYLENGTH : FOLDERNODEKEYLENGTH;
+    string nodekey, attrs, attrstring;
+    SymmCipher cipher;
+
+    PrnGen::genblock(keydata, keylength);
+    nodekey.assign((const char*)keydata, keylength);
+    cipher.setkey(&nodekey);
+
+    attrs = string("\"n\":\"") + name + "\"";
+
+    if (fp)
+    {
+        string c;
+
+        fp->serializefingerprint(&c);
+        attrs += ",\"c\":\"" + c + "\"";
+    }
+
+    client->makeattr(&cipher, &attrstring, attrs.c_str());
+    client->key.ecb_encrypt(keydata, keydata, keylength);
+
+    if (json->size() > 1)
+    {
+        json->append(",");
+    }
+
+    json->append("{\"h\":\"");
+    json->append(b64handle(h, MegaClient::NODEHANDLE));
+
+    if (ph != UNDEF)
+    {
+        json->append("\",\"p\":\"");
+        json->append(b64handle(ph, MegaClient::NODEHANDLE));
+    }
+
+    json->append("\",\"u\":\"");
+    json->append(b64handle(client->me, MegaClient::USERHANDLE));
+    sprintf(buf, "\",\"t\":%d,\"a\":\"", type);
+    json->append(buf);
+    json->append(b64((const byte*)attrstring.data(), (int)attrstring.size()));
+    json->append("\",\"k\":\"");
+    json->append(b64handle(client->me, MegaClient::USERHANDLE));
+    json->append(":");
+    json->append(b64(keydata, keylength));
+    json->append("\"");
+
+    if (fp)
+    {
+        sprintf(buf, ",\"s\":%lld", (long long)fp->size);
+        json->append(buf);
+    }
+
+    json->append(",\"ts\":1500000000}");
+}
+
+// nothing left to do: scan queues empty, no pending syncdown()/syncup()
+static bool settled(MegaClient* client, Sync* sync)
+{
+    return sync->state == SYNC_ACTIVE
+        && !sync->dirnotify->notifyq[DirNotify::DIREVENTS].size()
+        && !sync->dirnotify->notifyq[DirNotify::RETRY].size()
+        && !client->syncactivity && !client->syncops && !client->syncnagleretry;
+}
+
+// run the client until the sync has settled, returns the number of exec()
+// calls (0 on failure or timeout)
+static unsigned runsync(MegaClient* client, Sync* sync)
+{
+    double timeout = now() + 600;
+    unsigned execs = 0;
+
+    do {
+        if (sync->state == SYNC_FAILED || sync->state == SYNC_CANCELED || now() > timeout)
+        {
+            return 0;
+        }
+
+        Waiter::bumpds();
+        client->exec();
+        execs++;
+
+        // (waiting for the upload delay or a retry)
+        if (client->syncnagleretry)
+        {
+            usleep(10000);
+        }
+    } while (!settled(client, sync));
+
+    return execs;
+}
+#endif
+
+int main(int argc, char* argv[])
+{
+    unsigned perfolder = 100;
+    double idle = 10;
+    string dir;
+
+    if (argc > 1)
+    {
+        numfiles = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        perfolder = atoi(argv[2]);
+    }
+
+    if (argc > 3)
+    {
+        dir = argv[3];
+
+        if (dir.size() && dir[dir.size() - 1] != '/')
+        {
+            dir.append("/");
+        }
+    }
+
+    if (argc > 4)
+    {
+        idle = atof(argv[4]);
+    }
+
+    if (!numfiles || !perfolder || idle < 0)
+    {
+        fprintf(stderr, "Usage: %s [files] [files per folder] [directory] [idle seconds]\n", argv[0]);
+        return 1;
+    }
+
+#ifndef ENABLE_SYNC
+    fprintf(stderr, "Sync support not enabled\n");
+    return 1;
+#else
+    numfolders = (numfiles + perfolder - 1) / perfolder;
+
+    srand(1);
+
+    MegaClient* client = new MegaClient(new MegaApp, new WAIT_CLASS, new MockHttpIO, new FSACCESS_CLASS,
+                                        NULL, NULL, "bench", "bench_sync");
+    byte masterkey[SymmCipher::KEYLENGTH];
+    FileSystemAccess* fsaccess = client->fsaccess;
+
+    PrnGen::genblock(masterkey, sizeof masterkey);
+    client->key.setkey(masterkey);
+    client->me = 0x123456789ABCull;
+
+    // local tree, and the remote tree from its fingerprints
+    string root = dir + "bench_sync";
+    string localroot, path, localpath;
+    vector<string> localfiles, localfolders;
+    string json = "[";
+    handle h = 1, folderhandle = UNDEF;
+    char name[32];
+    byte data[4096];
+
+    fsaccess->path2local(&root, &localroot);
+
+    if (!fsaccess->mkdirlocal(&localroot))
+    {
+        fprintf(stderr, "Unable to create %s\n", root.c_str());
+        return 1;
+    }
+
+    node(client, &json, h++, UNDEF, ROOTNODE, "", NULL);
+
+    for (unsigned i = 0; i < numfiles; i++)
+    {
+        unsigned folder = i / perfolder;
+
+        if (!(i % perfolder))
+        {
+            sprintf(name, "d%u", folder);
+            path = root + "/" + name;
+            fsaccess->path2local(&path, &localpath);
+
+            if (!fsaccess->mkdirlocal(&localpath))
+            {
+                fprintf(stderr, "Unable to create %s\n", path.c_str());
+                return 1;
+            }
+
+            localfolders.push_back(localpath);
+            folderhandle = h++;
+            node(client, &json, folderhandle, 1, FOLDERNODE, name, NULL);
+        }
+
+        sprintf(name, "d%u/f%u.dat", folder, i);
+        path = root + "/" + name;
+
+        size_t size = 1 + rand() % sizeof data;
+        FILE* fp = fopen(path.c_str(), "wb");
+
+        PrnGen::genblock(data, size);
+
+        if (!fp || fwrite(data, size, 1, fp) != 1 || fclose(fp))
+        {
+            fprintf(stderr, "Unable to write %s\n", path.c_str());
+            return 1;
+        }
+
+        fsaccess->path2local(&path, &localpath);
+        localfiles.push_back(localpath);
+
+        FileAccess* fa = fsaccess->newfileaccess();
+        FileFingerprint fingerprint;
+
+        if (!fa->fopen(&localpath, true, false) || !fingerprint.genfingerprint(fa))
+        {
+            fprintf(stderr, "Unable to read %s\n", path.c_str());
+            return 1;
+        }
+
+        delete fa;
+
+        sprintf(name, "f%u.dat", i);
+        node(client, &json, h++, folderhandle, FILENODE, name, &fingerprint);
+    }
+
+    json.append("]");
+
+    JSON j;
+
+    j.begin(json.c_str());
+    j.enterarray();
+    client->readnodes(&j, 0);
+    client->applykeys();
+
+    Node* remoteroot = client->nodebyhandle(1);
+
+    // the initial scan: addsync() and the notifications it queues
+    client->statecurrent = true;
+
+    double start = now();
+    double cpu = cputime();
+
+    if (!remoteroot || client->addsync(&localroot, DEBRISFOLDER, NULL, remoteroot) != API_OK)
+    {
+        fprintf(stderr, "Unable to add the sync\n");
+        return 1;
+    }
+
+    Sync* sync = client->syncs.back();
+    int status = 0;
+
+    printf("files,folders,pass,operations,seconds,cpu_seconds,us_per_op\n");
+
+    if (!runsync(client, sync))
+    {
+        fprintf(stderr, "Initial scan failed\n");
+        status = 1;
+    }
+    else
+    {
+        report("initialscan", sync->metrics.scanitems, now() - start, cputime() - cpu);
+
+        // a notification for every file, as if all of them had been touched
+        m_off_t scanitems = sync->metrics.scanitems;
+
+        start = now();
+        cpu = cputime();
+
+        for (unsigned i = 0; i < numfiles; i++)
+        {
+            sprintf(name, "d%u/f%u.dat", i / perfolder, i);
+            path = name;
+            fsaccess->path2local(&path, &localpath);
+            sync->dirnotify->notify(DirNotify::DIREVENTS, &sync->localroot, localpath.data(), localpath.size(), true);
+        }
+
+        if (!runsync(client, sync))
+        {
+            fprintf(stderr, "Notification processing failed\n");
+            status = 1;
+        }
+        else
+        {
+            report("notifications", sync->metrics.scanitems - scanitems, now() - start, cputime() - cpu);
+
+            // forced passes over the unchanged tree
+            SyncMetrics before = sync->metrics;
+            unsigned passes = 100;
+
+            start = now();
+            cpu = cputime();
+
+            for (unsigned i = 0; i < passes; i++)
+            {
+                client->syncactivity = true;
+                runsync(client, sync);
+            }
+
+            double elapsed = now() - start;
+
+            cpu = cputime() - cpu;
+
+            m_off_t downpasses = sync->metrics.syncdown.passes - before.syncdown.passes;
+            m_off_t uppasses = sync->metrics.syncup.passes - before.syncup.passes;
+
+            double downtime = (sync->metrics.syncdown.total - before.syncdown.total) / 1e6;
+            double uptime = (sync->metrics.syncup.total - before.syncup.total) / 1e6;
+
+            // (the pass times are processor time)
+            report("syncdown", downpasses, downtime, downtime);
+            report("syncup", uppasses, uptime, uptime);
+            report("forcedpasses", passes, elapsed, cpu);
+
+            // steady state
+            unsigned execs = 0;
+
+            start = now();
+            cpu = cputime();
+
+            while (now() - start < idle)
+            {
+                Waiter::bumpds();
+                client->exec();
+                execs++;
+                usleep(10000);
+            }
+
+            report("idle", execs, now() - start, cputime() - cpu);
+        }
+    }
+
+    client->delsync(sync, false);
+    Waiter::bumpds();
+    client->exec();
+
+    for (size_t i = 0; i < localfiles.size(); i++)
+    {
+        fsaccess->unlinklocal(&localfiles[i]);
+    }
+
+    for (size_t i = 0; i < localfolders.size(); i++)
+    {
+        fsaccess->rmdirlocal(&localfolders[i]);
+    }
+
+    path = root + "/" + DEBRISFOLDER;
+    fsaccess->path2local(&path, &localpath);
+    fsaccess->rmdirlocal(&localpath);
+    fsaccess->rmdirlocal(&localroot);
+
+    return status;
+#endif
+}
@@ -0,0 +1,282 @@
+/**
+ * @file tests/bench_transfers.cpp
+ * @brief Benchmark of uploads and downloads against a loopback storage server
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+// Usage: bench_transfers [megabytes] [bandwidth MB/s] [latency ms] [error rate] [directory]
+//
+// Prints one CSV record per direction, file size and connection count:
+// direction,bytes,connections,seconds,mb_per_s,cpu_s_per_gb,requests,kb_per_request,failures
+//
+// A file of random data is uploaded and downloaded again through the
+// complete client stack (TransferSlot, chunk encryption and MACs, local file
+// I/O) with MockHttpIO in place of the network: bandwidth (0: unlimited) is
+// shared by the connections in flight, latency delays every request and the
+// given fraction of the chunk requests fails. Each transfer runs with 1, 2,
+// 4 and 8 connections, for a 1 MB file (chunks of 128 to 512 KB) and for the
+// given size (mostly 1 MB chunks). The file and the downloaded copy are
+// written to the given directory and removed at the end.
+
+#include "mega.h"
+#include "mockhttpio.h"
+#include <chrono>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace mega;
+using namespace std;
+
+static bool done, transferfailed;
+static byte ultoken[NewNode::UPLOADTOKENLEN + 1];
+static byte filekey[FILENODEKEYLENGTH];
+
+struct BenchFile : public File
+{
+    // downloads go to a temporary file first (see Transfer::complete())
+    void prepare()
+    {
+        string suffix;
+
+        transfer->client->fsaccess->tmpnamelocal(&suffix);
+        transfer->localfilename = localname + suffix;
+    }
+
+    // uploads: keep the token and key instead of creating a node
+    void completed(Transfer* t, LocalNode*)
+    {
+        if (t->type == PUT)
+        {
+            memcpy(ultoken, t->ultoken, sizeof ultoken);
+            memcpy(filekey, t->filekey, sizeof filekey);
+        }
+
+        done = true;
+        delete this;
+    }
+
+    void terminated()
+    {
+        done = transferfailed = true;
+        delete this;
+    }
+};
+
+static double cputime()
+{
+    struct rusage usage;
+
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6
+         + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+}
+
+static double now()
+{
+    return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// run the client until the transfer is done, sleeping while the simulated
+// network has nothing to deliver
+static bool transfer(MegaClient* client, MockHttpIO* httpio, direction_t d, BenchFile* f, m_off_t size, int connections)
+{
+    client->connections[d] = client->minconnections[d] = client->maxconnections[d] = (unsigned char)connections;
+
+    uint64_t requests = httpio->requests;
+    uint64_t failures = httpio->failures;
+    double cpu = cputime();
+    double start = now();
+
+    done = transferfailed = false;
+
+    if (!client->startxfer(d, f))
+    {
+        delete f;
+        return false;
+    }
+
+    while (!done)
+    {
+        Waiter::bumpds();
+        client->exec();
+
+        double wait = httpio->nextevent();
+
+        if (wait)
+        {
+            usleep(wait < 0 || wait > 0.01 ? 10000 : (useconds_t)(wait * 1e6));
+        }
+    }
+
+    double elapsed = now() - start;
+
+    cpu = cputime() - cpu;
+    requests = httpio->requests - requests;
+
+    printf("%s,%lld,%d,%.3f,%.1f,%.2f,%llu,%.0f,%llu\n", d == PUT ? "upload" : "download", (long long)size,
+           connections, elapsed, size / elapsed / 1e6, cpu * 1e9 / size, (unsigned long long)requests,
+           requests ? size / 1024.0 / requests : 0, (unsigned long long)(httpio->failures - failures));
+    fflush(stdout);
+
+    return !transferfailed;
+}
+
+int main(int argc, char* argv[])
+{
+    m_off_t megabytes = 64;
+    string dir;
+
+    MockHttpIO* httpio = new MockHttpIO;
+
+    httpio->latency = 0.02;
+
+    if (argc > 1)
+    {
+        megabytes = atoi(argv[1]);
+    }
+
+    if (argc > 2)
+    {
+        httpio->bandwidth = (m_off_t)(atof(argv[2]) * 1e6);
+    }
+
+    if (argc > 3)
+    {
+        httpio->latency = atof(argv[3]) / 1e3;
+    }
+
+    if (argc > 4)
+    {
+        httpio->errorrate = atof(argv[4]);
+    }
+
+    if (argc > 5)
+    {
+        dir = argv[5];
+
+        if (dir.size() && dir[dir.size() - 1] != '/')
+        {
+            dir.append("/");
+        }
+    }
+
+    if (megabytes <= 0 || httpio->bandwidth < 0 || httpio->latency < 0 || httpio->errorrate < 0 || httpio->errorrate >= 1)
+    {
+        fprintf(stderr, "Usage: %s [megabytes] [bandwidth MB/s] [latency ms] [error rate] [directory]\n", argv[0]);
+        return 1;
+    }
+
+    srand(1);
+
+    MegaClient client(new MegaApp, new WAIT_CLASS, httpio, new FSACCESS_CLASS, NULL, NULL, "bench", "bench_transfers");
+
+    string path = dir + "bench_transfers.dat";
+    string getpath = dir + "bench_transfers.get";
+    string localpath, localgetpath;
+
+    client.fsaccess->path2local(&path, &localpath);
+    client.fsaccess->path2local(&getpath, &localgetpath);
+
+    printf("direction,bytes,connections,seconds,mb_per_s,cpu_s_per_gb,requests,kb_per_request,failures\n");
+
+    m_off_t sizes[] = { 1, megabytes };
+    int status = 0;
+
+    for (int s = 0; s < 2 && !status; s++)
+    {
+        if (s && sizes[s] == sizes[0])
+        {
+            break;
+        }
+
+        m_off_t size = sizes[s] << 20;
+        FILE* fp = fopen(path.c_str(), "wb");
+        byte block[65536];
+
+        for (m_off_t pos = 0; fp && pos < size; pos += sizeof block)
+        {
+            PrnGen::genblock(block, sizeof block);
+
+            if (fwrite(block, sizeof block, 1, fp) != 1)
+            {
+                fclose(fp);
+                fp = NULL;
+            }
+        }
+
+        if (!fp || fclose(fp))
+        {
+            fprintf(stderr, "Unable to write %s\n", path.c_str());
+            return 1;
+        }
+
+        for (int connections = 1; connections <= 8 && !status; connections *= 2)
+        {
+            BenchFile* f = new BenchFile;
+
+            f->localname = localpath;
+            f->name = "bench_transfers.dat";
+            f->h = UNDEF;
+
+            if (!transfer(&client, httpio, PUT, f, size, connections))
+            {
+                fprintf(stderr, "Upload failed\n");
+                status = 1;
+                break;
+            }
+
+            // download through the tempurl cache, which spares the API
+            // request for the URL
+            const string* url = httpio->uploadurl(ultoken);
+            handle h = connections;
+
+            if (!url)
+            {
+                fprintf(stderr, "Upload not stored\n");
+                status = 1;
+                break;
+            }
+
+            client.encodehandletype(&h, false);
+            client.tempurls.put(h, url, size);
+
+            f = new BenchFile;
+
+            f->localname = localgetpath;
+            f->name = "bench_transfers.get";
+            f->h = connections;
+            f->hprivate = false;
+            f->size = size;
+            memcpy(f->filekey, filekey, sizeof f->filekey);
+
+            if (!transfer(&client, httpio, GET, f, size, connections))
+            {
+                fprintf(stderr, "Download failed\n");
+                status = 1;
+            }
+
+            client.fsaccess->unlinklocal(&localgetpath);
+            httpio->clear();
+        }
+    }
+
+    client.fsaccess->unlinklocal(&localpath);
+
+    return status;
+}
@@ -0,0 +1,408 @@
+/**
+ * @file tests/mockhttpio.cpp
+ * @brief Loopback HttpIO with a simulated API and storage server
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#include "mockhttpio.h"
+#include <chrono>
+
+namespace mega {
+static const char* STORAGEURL = "http://loopback.invalid/";
+
+MockHttpIO::MockHttpIO()
+{
+    bandwidth = 0;
+    connbandwidth = 0;
+    latency = 0;
+    errorrate = 0;
+
+    requests = 0;
+    failures = 0;
+    bytesin = 0;
+    bytesout = 0;
+
+    nextid = 0;
+    lasttime = now();
+}
+
+MockHttpIO::~MockHttpIO()
+{
+    while (inflight.size())
+    {
+        cancel(inflight.front()->req);
+    }
+}
+
+double MockHttpIO::now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// one result per command of the request: the upload URL of a file of the
+// requested size for "u", 0 otherwise
+void MockHttpIO::api(const string* body, string* response)
+{
+    JSON json;
+
+    json.begin(body->c_str());
+    response->assign("[");
+
+    if (json.enterarray())
+    {
+        while (json.enterobject())
+        {
+            string a;
+            m_off_t s = 0;
+            nameid name;
+
+            while ((name = json.getnameid()) != EOO)
+            {
+                if (name == 'a')
+                {
+                    json.storeobject(&a);
+                }
+                else if (name == 's')
+                {
+                    s = json.getint();
+                }
+                else
+                {
+                    json.storeobject();
+                }
+            }
+
+            if (response->size() > 1)
+            {
+                response->append(",");
+            }
+
+            if (a == "u")
+            {
+                char buf[64];
+
+                snprintf(buf, sizeof buf, "%sul%u", STORAGEURL, ++nextid);
+
+                File* f = &files[buf];
+
+                f->size = s;
+                f->received = 0;
+
+                response->append("{\"p\":\"");
+                response->append(buf);
+                response->append("\"}");
+            }
+            else
+            {
+                response->append("0");
+            }
+        }
+    }
+
+    response->append("]");
+}
+
+void MockHttpIO::post(HttpReq* req, const char* data, unsigned len)
+{
+    Request* r = new Request;
+
+    r->req = req;
+    r->data = NULL;
+    r->len = 0;
+    r->done = 0;
+    r->credit = 0;
+    r->pos = -1;
+    r->start = now() + latency;
+    r->fail = false;
+    r->hold = false;
+
+    req->in.clear();
+    req->httpstatus = 0;
+    req->status = REQ_INFLIGHT;
+    req->httpiohandle = r;
+
+    if (!req->posturl.compare(0, MegaClient::APIURL.size(), MegaClient::APIURL))
+    {
+        if (req->posturl.find("cs?", MegaClient::APIURL.size()) == string::npos)
+        {
+            r->hold = true;
+        }
+        else if (data)
+        {
+            string body(data, len);
+
+            api(&body, &r->response);
+        }
+        else
+        {
+            api(req->out, &r->response);
+        }
+    }
+    else
+    {
+        // <file URL>/<position> uploads, <file URL>/<first>-<last> downloads
+        // (the alternative port is ignored)
+        string url = req->posturl;
+        size_t port = url.find(":8080");
+
+        if (port != string::npos)
+        {
+            url.erase(port, 5);
+        }
+
+        size_t slash = url.rfind('/');
+        string range = url.substr(slash + 1);
+
+        r->url = url.substr(0, slash);
+
+        map<string, File>::iterator it = files.find(r->url);
+        size_t dash = range.find('-');
+
+        requests++;
+        r->fail = (double)rand() / RAND_MAX < errorrate || it == files.end();
+
+        if (dash == string::npos)
+        {
+            r->pos = atoll(range.c_str());
+            r->data = data ? data : req->out->data();
+            r->len = data ? len : (unsigned)req->out->size();
+        }
+        else if (!r->fail)
+        {
+            m_off_t first = atoll(range.c_str());
+            m_off_t last = atoll(range.c_str() + dash + 1);
+
+            if (first <= last && last < (m_off_t)it->second.data.size())
+            {
+                r->response.assign(it->second.data, (size_t)first, (size_t)(last - first + 1));
+            }
+            else
+            {
+                r->fail = true;
+            }
+        }
+    }
+
+    inflight.push_back(r);
+}
+
+void MockHttpIO::cancel(HttpReq* req)
+{
+    if (!req->httpiohandle)
+    {
+        return;
+    }
+
+    Request* r = (Request*)req->httpiohandle;
+
+    inflight.remove(r);
+    delete r;
+
+    req->httpstatus = 0;
+    req->status = REQ_FAILURE;
+    req->httpiohandle = NULL;
+}
+
+m_off_t MockHttpIO::postpos(void* handle)
+{
+    Request* r = (Request*)handle;
+
+    return r->pos < 0 ? 0 : r->done;
+}
+
+const string* MockHttpIO::uploadurl(const byte* token)
+{
+    string key((const char*)token, NewNode::UPLOADTOKENLEN);
+    map<string, string>::iterator it = tokens.find(key);
+
+    return it == tokens.end() ? NULL : &it->second;
+}
+
+void MockHttpIO::clear()
+{
+    files.clear();
+    tokens.clear();
+}
+
+double MockHttpIO::nextevent()
+{
+    double t = now();
+    double next = -1;
+
+    for (request_list::iterator it = inflight.begin(); it != inflight.end(); it++)
+    {
+        if ((*it)->hold)
+        {
+            continue;
+        }
+
+        // bandwidth-limited transfers progress in small steps
+        double wait = (*it)->start > t ? (*it)->start - t : ((bandwidth || connbandwidth) ? 0.001 : 0);
+
+        if (next < 0 || wait < next)
+        {
+            next = wait;
+        }
+    }
+
+    return next;
+}
+
+// store the upload chunk and respond with the upload token once the file
+// is complete
+void MockHttpIO::complete(Request* r)
+{
+    HttpReq* req = r->req;
+
+    if (r->fail)
+    {
+        failures++;
+        req->httpstatus = 500;
+        req->status = REQ_FAILURE;
+    }
+    else
+    {
+        if (r->pos >= 0)
+        {
+            File* f = &files[r->url];
+
+            if (f->data.size() < (size_t)(r->pos + r->len))
+            {
+                f->data.resize((size_t)(r->pos + r->len));
+            }
+
+            memcpy((char*)f->data.data() + r->pos, r->data, r->len);
+
+            if (f->chunks.insert(r->pos).second)
+            {
+                f->received += r->len;
+            }
+
+            if (f->received == f->size)
+            {
+                byte token[NewNode::UPLOADTOKENLEN];
+
+                PrnGen::genblock(token, sizeof token);
+                tokens[string((const char*)token, sizeof token)] = r->url;
+
+                r->response.resize(sizeof token * 4 / 3 + 4);
+                r->response.resize(Base64::btoa(token, sizeof token, (char*)r->response.data()));
+            }
+
+            bytesin += r->len;
+        }
+
+        // (download data was delivered while it was being transferred)
+        if (r->pos >= 0 || !r->url.size())
+        {
+            req->put((void*)r->response.data(), (unsigned)r->response.size());
+        }
+
+        req->httpstatus = 200;
+        req->status = REQ_SUCCESS;
+        lastdata = Waiter::ds;
+    }
+
+    success = true;
+    req->httpio = NULL;
+    req->httpiohandle = NULL;
+
+    inetstatus(req->status == REQ_SUCCESS);
+}
+
+// advance the in-flight requests by the time elapsed since the last call:
+// the bandwidth is split evenly among the requests past their latency
+bool MockHttpIO::doio()
+{
+    double t = now();
+    double elapsed = t - lasttime;
+    bool statechange = false;
+    unsigned active = 0;
+
+    lasttime = t;
+
+    for (request_list::iterator it = inflight.begin(); it != inflight.end(); it++)
+    {
+        if (!(*it)->hold && (*it)->start <= t)
+        {
+            active++;
+        }
+    }
+
+    double share = -1;
+
+    if (bandwidth && active)
+    {
+        share = (double)bandwidth * elapsed / active;
+    }
+
+    if (connbandwidth && (share < 0 || connbandwidth * elapsed < share))
+    {
+        share = connbandwidth * elapsed;
+    }
+
+    for (request_list::iterator it = inflight.begin(); it != inflight.end(); )
+    {
+        Request* r = *it;
+
+        if (r->hold || r->start > t)
+        {
+            it++;
+            continue;
+        }
+
+        // API requests take the latency only
+        m_off_t total = r->url.size() ? (r->pos >= 0 ? r->len : (m_off_t)r->response.size()) : 0;
+        m_off_t n = total - r->done;
+
+        if (share >= 0 && r->url.size())
+        {
+            r->credit += share;
+
+            if (n > (m_off_t)r->credit)
+            {
+                n = (m_off_t)r->credit;
+            }
+
+            r->credit -= n;
+        }
+
+        if (n > 0 && r->pos < 0 && r->url.size())
+        {
+            r->req->put((void*)(r->response.data() + r->done), (unsigned)n);
+            bytesout += n;
+        }
+
+        r->done += n;
+
+        if (r->done == total)
+        {
+            it = inflight.erase(it);
+            complete(r);
+            delete r;
+            statechange = true;
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    return statechange;
+}
+} // namespace
@@ -0,0 +1,121 @@
+/**
+ * @file tests/mockhttpio.h
+ * @brief Loopback HttpIO with a simulated API and storage server
+ *
+ * (c) 2013-2016 by Mega Limited, Auckland, New Zealand
+ *
+ * This file is part of the MEGA SDK - Client Access Engine.
+ *
+ * Applications using the MEGA API must present a valid application key
+ * and comply with the the rules set forth in the Terms of Service.
+ *
+ * The MEGA SDK is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * @copyright Simplified (2-clause) BSD License.
+ *
+ * You should have received a copy of the license along with this
+ * program.
+ */
+
+#ifndef MEGA_MOCKHTTPIO_H
+#define MEGA_MOCKHTTPIO_H 1
+
+#include "mega.h"
+
+namespace mega {
+// serves requests in memory instead of the network: the API answers "u"
+// (upload URL) commands and 0 to everything else, the storage server
+// accepts encrypted upload chunks and serves them back as download ranges
+// at the configured bandwidth, latency and error rate - the passage of time
+// is simulated by doio() from the wall clock, so the caller must keep
+// calling it (see nextevent())
+struct MockHttpIO : public HttpIO
+{
+    // bytes per second shared by all requests in flight and per request
+    // (0: unlimited)
+    m_off_t bandwidth;
+    m_off_t connbandwidth;
+
+    // seconds until the first byte of each request
+    double latency;
+
+    // fraction of the storage requests that fail with HTTP 500
+    double errorrate;
+
+    // storage requests, failed ones, and bytes received / sent by the server
+    uint64_t requests;
+    uint64_t failures;
+    m_off_t bytesin;
+    m_off_t bytesout;
+
+    // storage URL of a completed upload by its upload token (can be used
+    // as download URL), or NULL
+    const string* uploadurl(const byte*);
+
+    // drop all stored files
+    void clear();
+
+    // seconds until doio() has something to do (0: now, < 0: idle)
+    double nextevent();
+
+    void post(HttpReq*, const char* = NULL, unsigned = 0);
+    void cancel(HttpReq*);
+    void sendchunked(HttpReq*) { }
+    m_off_t postpos(void*);
+    bool doio(void);
+    void setuseragent(string*) { }
+    void addevents(Waiter*, int) { }
+
+    MockHttpIO();
+    ~MockHttpIO();
+
+private:
+    struct Request
+    {
+        HttpReq* req;
+
+        // upload chunk / response body and bytes transferred so far
+        const char* data;
+        unsigned len;
+        string response;
+        m_off_t done;
+        double credit;
+
+        // storage file, upload position (-1: download or API)
+        string url;
+        m_off_t pos;
+
+        double start;
+        bool fail;
+
+        // long-polling requests never complete
+        bool hold;
+    };
+
+    typedef list<Request*> request_list;
+    request_list inflight;
+
+    struct File
+    {
+        string data;
+        m_off_t size;
+        set<m_off_t> chunks;
+        m_off_t received;
+    };
+
+    map<string, File> files;
+    map<string, string> tokens;
+
+    unsigned nextid;
+    double lasttime;
+
+    static double now();
+
+    void api(const string*, string*);
+    void complete(Request*);
+};
+} // namespace
+
+#endif
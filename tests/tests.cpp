@@ -38,6 +38,227 @@ TEST(JSON, storeobject) {
     j.storeobject(&in_str);
 }
 
+// the block-wise string scan must agree with a bytewise one at any alignment
+TEST(JSON, skipstring) {
+    const string body = "0123456789abcdefghijklmnopqrstuv\\\"wxyz\\\\0123456789abcdefghijklmnop\\";
+
+    for (size_t len = 0; len <= body.size(); len++)
+    {
+        for (size_t offset = 0; offset < 16; offset++)
+        {
+            for (int quoted = 0; quoted < 2; quoted++)
+            {
+                string buf(offset, ' ');
+                buf.append(body, 0, len);
+
+                if (quoted)
+                {
+                    buf.append("\",\"next\"");
+                }
+
+                const char* start = buf.c_str() + offset;
+                const char* expected = start;
+                bool escaped = false;
+
+                while (*expected && (escaped || *expected != '"'))
+                {
+                    escaped = *expected == '\\' && !escaped;
+                    expected++;
+                }
+
+                ASSERT_EQ(expected, JSON::skipstring(start)) << len << " " << offset << " " << quoted;
+            }
+        }
+    }
+
+    JSON j;
+    string s;
+    j.begin("[\"a\\\"]\",{\"k\":\"}\\\\\"}]");
+    ASSERT_TRUE(j.enterarray());
+    ASSERT_TRUE(j.storeobject(&s));
+    ASSERT_EQ("a\\\"]", s);
+    ASSERT_TRUE(j.storeobject(&s));
+    ASSERT_EQ("{\"k\":\"}\\\\\"}", s);
+}
+
+TEST(JSON, getvalue) {
+    JSON j;
+    size_t len;
+    j.begin("{\"a\":\"xyz\",\"s\":-12,\"k\":\"\",\"o\":{\"b\":[1]}}");
+    ASSERT_TRUE(j.enterobject());
+
+    ASSERT_EQ('a', j.getnameid());
+    ASSERT_EQ(0, strncmp(j.getvalue(&len), "xyz", 3));
+    ASSERT_EQ(3u, len);
+
+    ASSERT_EQ('s', j.getnameid());
+    ASSERT_EQ(0, strncmp(j.getvalue(&len), "-12", 3));
+    ASSERT_EQ(3u, len);
+
+    ASSERT_EQ('k', j.getnameid());
+    j.getvalue(&len);
+    ASSERT_EQ(0u, len);
+
+    ASSERT_EQ('o', j.getnameid());
+    ASSERT_EQ(0, strncmp(j.getvalue(&len), "{\"b\":[1]}", len));
+    ASSERT_EQ(9u, len);
+}
+
+// binary arguments and elements are encoded in place
+TEST(Command, binary) {
+    byte data[33];
+    char b64[48];
+
+    for (unsigned i = 0; i < sizeof data; i++)
+    {
+        data[i] = (byte)(i * 37);
+    }
+
+    for (int len = 0; len <= (int)sizeof data; len++)
+    {
+        Command c;
+        Base64::btoa(data, len, b64);
+
+        c.cmd("x");
+        c.arg("k", data, len);
+        c.beginarray("e");
+        c.element(data, len);
+        c.element(data, len);
+        c.endarray();
+
+        ASSERT_EQ(string("\"a\":\"x\",\"k\":\"") + b64 + "\",\"e\":[\"" + b64 + "\",\"" + b64 + "\"]", c.getstring());
+    }
+}
+
+// every node in exactly one slice, internal parents within the slice and
+// the root's parent in an earlier one
+TEST(PutNodesTree, slices) {
+    const int n = 40;
+    NewNode nn[n];
+
+    for (int i = 0; i < n; i++)
+    {
+        nn[i].nodehandle = 100 + i;
+        nn[i].parenthandle = i ? 100 + (i - 1) / 3 : UNDEF;
+    }
+
+    PutNodesTree t(UNDEF, nn, n, 0, 7);
+    vector<int> slice(n, -1);
+
+    for (unsigned i = 0; i < t.slices.size(); i++)
+    {
+        const PutNodesTree::Slice& s = t.slices[i];
+
+        ASSERT_GE(7u, s.nodes.size());
+        ASSERT_EQ(s.parent, s.nodes[0] ? (s.nodes[0] - 1) / 3 : -1);
+
+        if (s.parent >= 0)
+        {
+            ASSERT_GT((int)i, slice[s.parent]);
+            ASSERT_LE(0, slice[s.parent]);
+        }
+
+        for (unsigned j = 0; j < s.nodes.size(); j++)
+        {
+            int k = s.nodes[j];
+
+            ASSERT_EQ(-1, slice[k]);
+            slice[k] = i;
+
+            if (j)
+            {
+                ASSERT_EQ((int)i, slice[(k - 1) / 3]);
+            }
+        }
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        ASSERT_LE(0, slice[i]);
+    }
+}
+
+// feed a response in small pieces, dropping the released data like
+// HttpReq::purge() does
+TEST(JSONSplitter, pieces) {
+    const string response = "[0,{\"x\":{\"f\":[1]},\"f\" : [{\"h\":\"a]}\\\"\"},[{}],{\"h\":\"b\"}],\"ok\":[]},-9]";
+
+    for (size_t step = 1; step < 8; step++)
+    {
+        JSONSplitter js;
+        string buf, elements;
+        const char* element;
+        size_t len;
+
+        js.reset(1);
+
+        for (size_t i = 0; i < response.size(); i += step)
+        {
+            buf.append(response, i, step);
+
+            while (js.next(buf.data(), buf.size(), &element, &len))
+            {
+                elements.append(element, len).append(";");
+            }
+
+            buf.erase(0, js.release());
+        }
+
+        ASSERT_TRUE(js.started);
+        ASSERT_TRUE(js.finished);
+        ASSERT_EQ("{\"h\":\"a]}\\\"\"};[{}];{\"h\":\"b\"};", elements);
+        ASSERT_EQ("[0,{\"x\":{\"f\":[1]},\"f\" : [],\"ok\":[]},-9]", js.head + buf);
+    }
+}
+
+// block-wise and bytewise coding must agree at every length and stop at
+// the first character outside the alphabet
+TEST(Base64, blocks) {
+    byte data[100];
+    byte decoded[100];
+    char encoded[140];
+
+    for (unsigned i = 0; i < sizeof data; i++)
+    {
+        data[i] = (byte)(i * 151 + 7);
+    }
+
+    for (int len = 0; len <= (int)sizeof data; len++)
+    {
+        int l = Base64::btoa(data, len, encoded);
+
+        ASSERT_EQ((len * 4 + 2) / 3, l);
+        ASSERT_EQ(len, Base64::atob(encoded, decoded, sizeof decoded));
+        ASSERT_EQ(0, memcmp(data, decoded, len));
+        ASSERT_EQ(len, Base64::atob(encoded, l, decoded, sizeof decoded));
+        ASSERT_EQ(0, memcmp(data, decoded, len));
+
+        for (int i = 0; i < l; i++)
+        {
+            ASSERT_NE((char*)NULL, strchr("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_", encoded[i]));
+        }
+    }
+
+    Base64::btoa(data, 60, encoded);
+    encoded[40] = '"';
+    ASSERT_EQ(30, Base64::atob(encoded, 80, decoded, sizeof decoded));
+    ASSERT_EQ(30, Base64::atob(encoded, decoded, sizeof decoded));
+    ASSERT_EQ(24, Base64::atob(encoded, 32, decoded, sizeof decoded));
+}
+
+TEST(AttrMap, string2nameid) {
+    ASSERT_EQ((nameid)0, AttrMap::string2nameid(NULL));
+    ASSERT_EQ((nameid)0, AttrMap::string2nameid(""));
+    ASSERT_EQ((nameid)'n', AttrMap::string2nameid("n"));
+    ASSERT_EQ(MAKENAMEID3('s', 't', 's'), AttrMap::string2nameid("sts"));
+    ASSERT_EQ(MAKENAMEID8('a', 'b', 'c', 'd', 'e', 'f', 'g', 'h'), AttrMap::string2nameid("abcdefgh"));
+    ASSERT_EQ((nameid)0, AttrMap::string2nameid("abcdefghi"));
+
+    JSON j;
+    j.begin("\"abcdefg\":1");
+    ASSERT_EQ(j.getnameid(), AttrMap::string2nameid("abcdefg"));
+}
+
 // Test 64-bit int serialization/unserialization
 TEST(Serialize64, serialize) {
     uint64_t in = 0xDEADBEEF;
@@ -49,6 +270,548 @@ TEST(Serialize64, serialize) {
     ASSERT_EQ(in, out);
 }
 
+TEST(Serialize64, string) {
+    const uint64_t in[] = { 0, 1, 0x1234, 1500000000, ~(uint64_t)0 };
+    string d;
+    uint64_t out;
+
+    for (unsigned i = 0; i < sizeof in / sizeof *in; i++)
+    {
+        Serialize64::serialize(&d, in[i]);
+    }
+
+    ASSERT_EQ(1 + 2 + 3 + 5 + 9, (int)d.size());
+
+    const char* ptr = d.data();
+    const char* end = ptr + d.size();
+
+    for (unsigned i = 0; i < sizeof in / sizeof *in; i++)
+    {
+        ASSERT_TRUE(Serialize64::unserialize(&ptr, end, &out));
+        ASSERT_EQ(in[i], out);
+    }
+
+    ASSERT_TRUE(ptr == end);
+    ASSERT_FALSE(Serialize64::unserialize(&ptr, end, &out));
+
+    // truncated value
+    ptr = d.data() + d.size() - 9;
+    ASSERT_FALSE(Serialize64::unserialize(&ptr, end - 1, &out));
+}
+
+// Test node handle hash index insertion, lookup, erasure and iteration
+TEST(NodeHandleMap, insertfinderase) {
+    NodeHandleMap m;
+    Node* n = (Node*)&m;
+    const int count = 10000;
+
+    for (int i = 0; i < count; i++)
+    {
+        m[(handle)i * 0x10001] = n + i;
+    }
+
+    ASSERT_EQ((size_t)count, m.size());
+
+    for (int i = 0; i < count; i += 2)
+    {
+        ASSERT_EQ(1u, m.erase((handle)i * 0x10001));
+    }
+
+    ASSERT_EQ(0u, m.erase(0));
+    ASSERT_EQ((size_t)count / 2, m.size());
+
+    // UNDEF is never indexed
+    ASSERT_TRUE(m.find(UNDEF) == m.end());
+    ASSERT_EQ(0u, m.erase(UNDEF));
+
+    for (int i = 0; i < count; i++)
+    {
+        NodeHandleMap::iterator it = m.find((handle)i * 0x10001);
+
+        if (i & 1)
+        {
+            ASSERT_TRUE(it != m.end());
+            ASSERT_EQ(n + i, it->second);
+        }
+        else
+        {
+            ASSERT_TRUE(it == m.end());
+        }
+    }
+
+    size_t seen = 0;
+
+    for (NodeHandleMap::iterator it = m.begin(); it != m.end(); it++)
+    {
+        ASSERT_EQ((handle)(it->second - n) * 0x10001, it->first);
+        seen++;
+    }
+
+    ASSERT_EQ(m.size(), seen);
+
+    m.clear();
+    ASSERT_TRUE(m.begin() == m.end());
+    ASSERT_TRUE(m.find(1) == m.end());
+}
+
+// Test slab block recycling and chunk release
+TEST(SlabAllocator, allocfree) {
+    SlabAllocator slab(24, 16);
+    vector<void*> blocks;
+
+    for (int i = 0; i < 100; i++)
+    {
+        void* p = slab.alloc();
+        ASSERT_EQ(0u, (size_t)p % sizeof(uint64_t));
+        memset(p, i, 24);
+        blocks.push_back(p);
+    }
+
+    ASSERT_EQ(100u, slab.inuse);
+    ASSERT_FALSE(slab.release());
+
+    void* last = blocks.back();
+    slab.free(last);
+    blocks.pop_back();
+    ASSERT_EQ(last, slab.alloc());
+    blocks.push_back(last);
+
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        slab.free(blocks[i]);
+    }
+
+    ASSERT_EQ(0u, slab.inuse);
+    ASSERT_EQ(slab.allocs, slab.frees);
+    ASSERT_TRUE(slab.release());
+    ASSERT_EQ(0u, slab.allocated());
+}
+
+// per-block CTR + CBC-MAC as specified, to check the batched implementation
+static void ctr_crypt_ref(SymmCipher* key, byte* data, unsigned len, m_off_t pos,
+                          SymmCipher::ctr_iv ctriv, byte* mac, bool encrypt)
+{
+    byte ctr[SymmCipher::BLOCKSIZE], tmp[SymmCipher::BLOCKSIZE];
+
+    MemAccess::set<int64_t>(ctr, ctriv);
+    SymmCipher::setint64(pos / SymmCipher::BLOCKSIZE, ctr + sizeof ctriv);
+
+    memcpy(mac, ctr, sizeof ctriv);
+    memcpy(mac + sizeof ctriv, ctr, sizeof ctriv);
+
+    while ((int)len > 0)
+    {
+        if (encrypt)
+        {
+            SymmCipher::xorblock(data, mac);
+            key->ecb_encrypt(mac);
+        }
+
+        key->ecb_encrypt(ctr, tmp);
+        SymmCipher::xorblock(tmp, data);
+
+        if (!encrypt)
+        {
+            SymmCipher::xorblock(data, mac, len < (unsigned)SymmCipher::BLOCKSIZE ? len : SymmCipher::BLOCKSIZE);
+            key->ecb_encrypt(mac);
+        }
+
+        len -= SymmCipher::BLOCKSIZE;
+        data += SymmCipher::BLOCKSIZE;
+
+        SymmCipher::incblock(ctr);
+    }
+}
+
+// Test CTR encryption / decryption and chunk MACs against the per-block
+// reference
+TEST(SymmCipher, ctr_crypt) {
+    byte keydata[SymmCipher::KEYLENGTH];
+    SymmCipher key;
+    const unsigned size = 1048576;
+    string plain, buf, ref;
+    byte mac[SymmCipher::BLOCKSIZE], refmac[SymmCipher::BLOCKSIZE];
+    unsigned lens[] = { 1, 15, 16, 17, 511, 512, 513, 1000, size - 3, size };
+
+    for (unsigned i = 0; i < sizeof keydata; i++)
+    {
+        keydata[i] = (byte)(i * 7 + 1);
+    }
+
+    key.setkey(keydata);
+
+    for (unsigned i = 0; i < size + SymmCipher::BLOCKSIZE; i++)
+    {
+        plain.append(1, (char)(i * 31 + (i >> 8)));
+    }
+
+    for (unsigned i = 0; i < sizeof lens / sizeof *lens; i++)
+    {
+        unsigned len = lens[i];
+        unsigned padded = (len + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE;
+
+        // encryption: NUL-padded plaintext
+        buf.assign(plain, 0, len);
+        buf.resize(padded);
+        ref = buf;
+
+        key.ctr_crypt((byte*)buf.data(), len, 65536, 0x0123456789abcdefULL, mac, true);
+        ctr_crypt_ref(&key, (byte*)ref.data(), len, 65536, 0x0123456789abcdefULL, refmac, true);
+
+        ASSERT_EQ(ref, buf);
+        ASSERT_EQ(0, memcmp(mac, refmac, sizeof mac));
+
+        // decryption: arbitrary padding
+        buf.append(plain.data() + len, SymmCipher::BLOCKSIZE);
+        ref = buf;
+
+        key.ctr_crypt((byte*)buf.data(), len, 65536, 0x0123456789abcdefULL, mac, false);
+        ctr_crypt_ref(&key, (byte*)ref.data(), len, 65536, 0x0123456789abcdefULL, refmac, false);
+
+        ASSERT_EQ(0, memcmp(buf.data(), plain.data(), len));
+        ASSERT_EQ(0, memcmp(buf.data(), ref.data(), len));
+        ASSERT_EQ(0, memcmp(mac, refmac, sizeof mac));
+    }
+}
+
+// Test the interleaved multi-chunk CTR + MAC against one chunk at a time
+TEST(SymmCipher, ctr_crypt_chunks) {
+    byte keydata[SymmCipher::KEYLENGTH] = { 3, 1, 4, 1, 5, 9, 2, 6, 5, 3, 5, 8, 9, 7, 9, 3 };
+    SymmCipher key;
+    const unsigned n = 11;
+    unsigned lens[n] = { 131072, 262144, 0, 17, 131072, 393216, 1000, 16, 524288, 131072, 5 };
+    m_off_t pos[n];
+    string plain[n], ref[n], buf[n];
+    byte* bufs[n];
+    byte* macs[n];
+    byte macbuf[n][SymmCipher::BLOCKSIZE], refmac[SymmCipher::BLOCKSIZE];
+    m_off_t p = 0;
+
+    key.setkey(keydata);
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        pos[i] = p;
+        p += (lens[i] + SymmCipher::BLOCKSIZE - 1) & -SymmCipher::BLOCKSIZE;
+
+        for (unsigned j = 0; j < lens[i]; j++)
+        {
+            plain[i].append(1, (char)(i + j * 13));
+        }
+
+        plain[i].resize(lens[i] + SymmCipher::BLOCKSIZE);
+        macs[i] = macbuf[i];
+    }
+
+    for (int encrypt = 0; encrypt < 2; encrypt++)
+    {
+        for (unsigned i = 0; i < n; i++)
+        {
+            buf[i] = ref[i] = plain[i];
+            bufs[i] = (byte*)buf[i].data();
+        }
+
+        key.ctr_crypt(n, bufs, lens, pos, 0xfedcba9876543210ULL, macs, encrypt != 0);
+
+        for (unsigned i = 0; i < n; i++)
+        {
+            key.ctr_crypt((byte*)ref[i].data(), lens[i], pos[i], 0xfedcba9876543210ULL, refmac, encrypt != 0);
+
+            ASSERT_EQ(0, memcmp(buf[i].data(), ref[i].data(), lens[i]));
+            ASSERT_EQ(0, memcmp(macs[i], refmac, sizeof refmac));
+        }
+    }
+}
+
+TEST(SymmCipher, cbc_decrypt_batch) {
+    const unsigned n = 9;
+    byte keydata[n][SymmCipher::KEYLENGTH];
+    const byte* keys[n];
+    string buf[n], ref[n];
+    byte* bufs[n];
+    unsigned lens[n];
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        lens[i] = i * i * SymmCipher::BLOCKSIZE;
+
+        for (unsigned j = 0; j < SymmCipher::KEYLENGTH; j++)
+        {
+            keydata[i][j] = (byte)(i * 17 + j * 5);
+        }
+
+        for (unsigned j = 0; j < lens[i]; j++)
+        {
+            buf[i].append(1, (char)(i * 13 + j * 7));
+        }
+
+        SymmCipher key(keydata[i]);
+
+        ref[i] = buf[i];
+        key.cbc_decrypt((byte*)ref[i].data(), lens[i]);
+
+        keys[i] = keydata[i];
+        bufs[i] = (byte*)buf[i].data();
+    }
+
+    SymmCipher::cbc_decrypt(n, keys, bufs, lens);
+
+    for (unsigned i = 0; i < n; i++)
+    {
+        ASSERT_EQ(ref[i], buf[i]);
+    }
+}
+
+// published test vectors, which every crypto backend must reproduce
+TEST(Crypto, knownanswers) {
+    // FIPS-197 C.1
+    byte ecbkey[] = { 0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f };
+    byte ecbplain[] = { 0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xaa, 0xbb, 0xcc, 0xdd, 0xee, 0xff };
+    byte ecbcipher[] = { 0x69, 0xc4, 0xe0, 0xd8, 0x6a, 0x7b, 0x04, 0x30, 0xd8, 0xcd, 0xb7, 0x80, 0x70, 0xb4, 0xc5, 0x5a };
+
+    // SP 800-38A F.2.1
+    byte cbckey[] = { 0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c };
+    byte cbcplain[] = { 0x6b, 0xc1, 0xbe, 0xe2, 0x2e, 0x40, 0x9f, 0x96, 0xe9, 0x3d, 0x7e, 0x11, 0x73, 0x93, 0x17, 0x2a };
+    byte cbccipher[] = { 0x76, 0x49, 0xab, 0xac, 0x81, 0x19, 0xb2, 0x46, 0xce, 0xe9, 0x8e, 0x9b, 0x12, 0xe9, 0x19, 0x7d };
+
+    byte sha256abc[] = { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+                         0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad };
+    byte sha512abc[] = { 0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba, 0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+                         0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2, 0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+                         0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8, 0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+                         0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e, 0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f };
+
+    // CRC-32 check value 0xcbf43926, emitted little-endian
+    byte crc123456789[] = { 0x26, 0x39, 0xf4, 0xcb };
+
+    SymmCipher key(ecbkey);
+    byte block[SymmCipher::BLOCKSIZE];
+
+    memcpy(block, ecbplain, sizeof block);
+    key.ecb_encrypt(block);
+    ASSERT_EQ(0, memcmp(block, ecbcipher, sizeof block));
+    key.ecb_decrypt(block);
+    ASSERT_EQ(0, memcmp(block, ecbplain, sizeof block));
+
+    key.setkey(cbckey);
+    memcpy(block, cbcplain, sizeof block);
+    key.cbc_encrypt(block, sizeof block, ecbkey);
+    ASSERT_EQ(0, memcmp(block, cbccipher, sizeof block));
+    key.cbc_decrypt(block, sizeof block, ecbkey);
+    ASSERT_EQ(0, memcmp(block, cbcplain, sizeof block));
+
+    // hashes restart after get()
+    HashSHA256 sha256;
+    Hash sha512;
+    HashCRC32 crc32;
+    string digest;
+    byte crc[4];
+
+    for (int i = 0; i < 2; i++)
+    {
+        sha256.add((const byte*)"abc", 3);
+        sha256.get(&digest);
+        ASSERT_EQ(string((const char*)sha256abc, sizeof sha256abc), digest);
+
+        sha512.add((const byte*)"a", 1);
+        sha512.add((const byte*)"bc", 2);
+        sha512.get(&digest);
+        ASSERT_EQ(string((const char*)sha512abc, sizeof sha512abc), digest);
+
+        crc32.add((const byte*)"123456789", 9);
+        crc32.get(crc);
+        ASSERT_EQ(0, memcmp(crc, crc123456789, sizeof crc));
+    }
+}
+
+// bitwise reference, little-endian output
+static void crc32_ref(const byte* data, unsigned len, byte* out)
+{
+    uint32_t crc = ~0U;
+
+    while (len--)
+    {
+        crc ^= *data++;
+
+        for (int i = 0; i < 8; i++)
+        {
+            crc = (crc >> 1) ^ (0xedb88320 & (0 - (crc & 1)));
+        }
+    }
+
+    crc = ~crc;
+
+    for (int i = 0; i < 4; i++)
+    {
+        out[i] = (byte)(crc >> (8 * i));
+    }
+}
+
+TEST(HashCRC32, incremental) {
+    HashCRC32 crc32;
+    string data;
+    byte crc[4], ref[4];
+
+    for (unsigned i = 0; i < 4096; i++)
+    {
+        data.append(1, (char)(i * 131 + (i >> 5)));
+    }
+
+    for (unsigned len = 0; len < 1100; len += 7)
+    {
+        crc32_ref((const byte*)data.data() + 1, len, ref);
+
+        for (unsigned split = 0; split <= len; split += 61)
+        {
+            crc32.add((const byte*)data.data() + 1, split);
+            crc32.add((const byte*)data.data() + 1 + split, len - split);
+            crc32.get(crc);
+
+            ASSERT_EQ(0, memcmp(crc, ref, sizeof crc));
+        }
+    }
+}
+
+TEST(HttpReq, purge) {
+    HttpReq req;
+    string expected;
+    char chunk[100];
+
+    // consume all but the last 10 bytes after every chunk
+    for (int i = 0; i < 1000; i++)
+    {
+        memset(chunk, 'a' + i % 26, sizeof chunk);
+        req.put(chunk, sizeof chunk, true);
+        expected.append(chunk, sizeof chunk);
+
+        ASSERT_EQ(expected.size(), req.size());
+        ASSERT_EQ(0, memcmp(expected.data(), req.data(), expected.size()));
+
+        req.purge(req.size() - 10);
+        expected.erase(0, expected.size() - 10);
+
+        // purged data is dropped lazily, but never accumulates
+        ASSERT_LE(req.in.size(), 2 * (expected.size() + sizeof chunk));
+    }
+
+    ASSERT_EQ(100000, req.bufpos);
+}
+
+TEST(HostStats, degraded) {
+    HostStats stats;
+    HttpReq req;
+    string url = "http://gfs1.userstorage.mega.co.nz:8080/dl/abc";
+
+    ASSERT_EQ("gfs1.userstorage.mega.co.nz:8080", HostStats::hostof(url));
+    ASSERT_EQ("gfs1.userstorage.mega.co.nz", HostStats::hostof("https://gfs1.userstorage.mega.co.nz/ul/x"));
+
+    Waiter::ds = 1000;
+    req.posturl = url;
+    req.posttime = 990;
+    req.rtt = 40;
+    stats.success(&req, 1000000);
+
+    ASSERT_FALSE(stats.degraded(url));
+    ASSERT_EQ(1000000, stats.find(url)->throughput);
+    ASSERT_EQ(40, stats.find(url)->rtt);
+
+    stats.failure(url);
+    ASSERT_FALSE(stats.degraded(url));
+
+    Waiter::ds++;
+    stats.failure(url);
+    ASSERT_TRUE(stats.degraded(url));
+    ASSERT_FALSE(stats.degraded("http://gfs1.userstorage.mega.co.nz/dl/abc"));
+
+    // reported at most once per interval
+    ASSERT_TRUE(stats.report(url));
+    ASSERT_FALSE(stats.report(url));
+    Waiter::ds += HostStats::REPORTINTERVAL;
+    ASSERT_TRUE(stats.report(url));
+
+    Waiter::ds++;
+    stats.success(&req, 1000);
+    ASSERT_FALSE(stats.degraded(url));
+}
+
+TEST(Request, moveindependent) {
+    Request queued, fast;
+    Command* cmds[5];
+    string out;
+
+    for (int i = 0; i < 5; i++)
+    {
+        cmds[i] = new Command;
+        cmds[i]->cmd(i & 1 ? "uga" : "p");
+        cmds[i]->independent = i & 1;
+    }
+
+    cmds[3]->persistent = true;
+
+    for (int i = 0; i < 5; i++)
+    {
+        queued.add(cmds[i]);
+    }
+
+    queued.moveindependent(&fast);
+
+    ASSERT_EQ(4, queued.cmdspending());
+    ASSERT_EQ(1, fast.cmdspending());
+
+    queued.get(&out);
+    ASSERT_EQ("[{\"a\":\"p\"},{\"a\":\"p\"},{\"a\":\"uga\"},{\"a\":\"p\"}]", out);
+
+    fast.clear();
+    queued.clear();
+    delete cmds[3];
+}
+
+#ifndef _WIN32
+TEST(PosixWaiter, watch) {
+    PosixWaiter::defaultbackend = PosixWaiter::nativebackend();
+    PosixWaiter waiter;
+    PosixWaiter::defaultbackend = PosixWaiter::BACKEND_SELECT;
+
+    if (!waiter.persistent())
+    {
+        cout << "No native event backend on this platform" << endl;
+        return;
+    }
+
+    int sv[2];
+    ASSERT_EQ(0, socketpair(AF_UNIX, SOCK_STREAM, 0, sv));
+
+    waiter.watch(sv[0], PosixWaiter::WATCHREAD);
+
+    Waiter::bumpds();
+    waiter.init(0);
+    waiter.wait();
+    ASSERT_EQ(0u, waiter.readyfds.size());
+
+    ASSERT_EQ(1, write(sv[1], "x", 1));
+    waiter.init(10);
+    ASSERT_EQ(Waiter::NEEDEXEC, waiter.wait());
+    ASSERT_EQ(PosixWaiter::WATCHREAD, waiter.readyfds[sv[0]]);
+
+    waiter.watch(sv[0], PosixWaiter::WATCHWRITE);
+    waiter.init(10);
+    waiter.wait();
+    ASSERT_EQ(PosixWaiter::WATCHWRITE, waiter.readyfds[sv[0]]);
+
+    // fd_set consumers keep working alongside the registrations
+    waiter.watch(sv[0], 0);
+    waiter.init(10);
+    FD_SET(sv[0], &waiter.rfds);
+    waiter.bumpmaxfd(sv[0]);
+    ASSERT_EQ(Waiter::NEEDEXEC, waiter.wait());
+    ASSERT_TRUE(FD_ISSET(sv[0], &waiter.rfds));
+    ASSERT_EQ(0u, waiter.readyfds.size());
+
+    close(sv[0]);
+    close(sv[1]);
+}
+#endif
+
 int main (int argc, char *argv[])
 {
     InitGoogleTest(&argc, argv);